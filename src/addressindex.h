@@ -8,6 +8,7 @@
 
 #include <uint256.h>
 #include <amount.h>
+#include <saltedhasher.h>
 
 struct CMempoolAddressDelta
 {
@@ -56,6 +57,18 @@ struct CMempoolAddressDeltaKey
     }
 };
 
+/** The <address hash, address type> pair used to look up all mempool deltas of an address */
+typedef std::pair<uint160, int> CMempoolAddressKey;
+
+template<>
+struct SaltedHasherImpl<CMempoolAddressKey>
+{
+    static std::size_t CalcHash(const CMempoolAddressKey& v, uint64_t k0, uint64_t k1)
+    {
+        return CSipHasher(k0, k1).Write(v.first.begin(), v.first.size()).Write((uint64_t)v.second).Finalize();
+    }
+};
+
 struct CMempoolAddressDeltaKeyCompare
 {
     bool operator()(const CMempoolAddressDeltaKey& a, const CMempoolAddressDeltaKey& b) const {
@@ -9,13 +9,16 @@
 #include <netaddress.h>
 #include <protocol.h>
 #include <random.h>
+#include <saltedhasher.h>
 #include <sync.h>
 #include <timedata.h>
 #include <util.h>
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -182,6 +185,67 @@ public:
 //! the maximum number of tried addr collisions to store
 #define ADDRMAN_SET_TRIED_COLLISION_SIZE 10
 
+template<>
+struct SaltedHasherImpl<CService>
+{
+    static std::size_t CalcHash(const CService& v, uint64_t k0, uint64_t k1)
+    {
+        return v.GetSaltedHash(k0, k1);
+    }
+};
+
+/**
+ * The occupied positions (bucket * ADDRMAN_BUCKET_SIZE + position) of a "new" or "tried" table, so that a random
+ * occupied position can be picked in constant time instead of probing the table until a non-empty one is hit, which
+ * takes long when the table is mostly empty.
+ */
+template<int BUCKET_COUNT>
+class CAddrManPositions
+{
+private:
+    std::vector<int> vPositions;
+
+    //! index of each position in vPositions, -1 if it is not occupied
+    int vIndex[BUCKET_COUNT * ADDRMAN_BUCKET_SIZE];
+
+public:
+    CAddrManPositions() { Clear(); }
+
+    void Clear()
+    {
+        vPositions.clear();
+        std::fill(std::begin(vIndex), std::end(vIndex), -1);
+    }
+
+    void Insert(int nBucket, int nBucketPos)
+    {
+        int nPos = nBucket * ADDRMAN_BUCKET_SIZE + nBucketPos;
+        assert(vIndex[nPos] == -1);
+        vIndex[nPos] = vPositions.size();
+        vPositions.push_back(nPos);
+    }
+
+    void Erase(int nBucket, int nBucketPos)
+    {
+        int nPos = nBucket * ADDRMAN_BUCKET_SIZE + nBucketPos;
+        int nIndex = vIndex[nPos];
+        assert(nIndex != -1);
+        vIndex[vPositions.back()] = nIndex;
+        vPositions[nIndex] = vPositions.back();
+        vPositions.pop_back();
+        vIndex[nPos] = -1;
+    }
+
+    size_t size() const { return vPositions.size(); }
+
+    //! The nIndex'th occupied position, as bucket and position in the bucket
+    std::pair<int, int> Get(size_t nIndex) const
+    {
+        int nPos = vPositions[nIndex];
+        return std::make_pair(nPos / ADDRMAN_BUCKET_SIZE, nPos % ADDRMAN_BUCKET_SIZE);
+    }
+};
+
 /**
  * Stochastical (IP) address manager
  */
@@ -195,10 +259,10 @@ private:
     int nIdCount;
 
     //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo;
+    std::unordered_map<int, CAddrInfo> mapInfo;
 
     //! find an nId based on its network address
-    std::map<CService, int> mapAddr;
+    std::unordered_map<CService, int, StaticSaltedHasher> mapAddr;
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom;
@@ -209,12 +273,18 @@ private:
     //! list of "tried" buckets
     int vvTried[ADDRMAN_TRIED_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! occupied positions of vvTried
+    CAddrManPositions<ADDRMAN_TRIED_BUCKET_COUNT> triedPositions;
+
     //! number of (unique) "new" entries
     int nNew;
 
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! occupied positions of vvNew
+    CAddrManPositions<ADDRMAN_NEW_BUCKET_COUNT> newPositions;
+
     //! last time Good was called (memory only)
     int64_t nLastGood;
 
@@ -241,6 +311,10 @@ protected:
     //! Swap two elements in vRandom.
     void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2);
 
+    //! Set a position in the "new" or "tried" table to nId (-1 to empty it). All changes to vvNew and vvTried go through these.
+    void SetNew(int nUBucket, int nUBucketPos, int nId);
+    void SetTried(int nKBucket, int nKBucketPos, int nId);
+
     //! Move an entry from the "new" table(s) to the "tried" table
     void MakeTried(CAddrInfo& info, int nId);
 
@@ -410,7 +484,7 @@ public:
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
                 if (vvNew[nUBucket][nUBucketPos] == -1) {
-                    vvNew[nUBucket][nUBucketPos] = n;
+                    SetNew(nUBucket, nUBucketPos, n);
                     info.nRefCount++;
                 }
             }
@@ -430,7 +504,7 @@ public:
                 vRandom.push_back(nIdCount);
                 mapInfo[nIdCount] = info;
                 mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
+                SetTried(nKBucket, nKBucketPos, nIdCount);
                 nIdCount++;
             } else {
                 nLost++;
@@ -450,7 +524,7 @@ public:
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
-                        vvNew[bucket][nUBucketPos] = nIndex;
+                        SetNew(bucket, nUBucketPos, nIndex);
                     }
                 }
             }
@@ -458,9 +532,9 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
+        for (auto it = mapInfo.begin(); it != mapInfo.end(); ) {
             if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
+                auto itCopy = it++;
                 Delete(itCopy->first);
                 nLostUnk++;
             } else {
@@ -489,6 +563,8 @@ public:
                 vvTried[bucket][entry] = -1;
             }
         }
+        newPositions.Clear();
+        triedPositions.Clear();
 
         nIdCount = 0;
         nTried = 0;
@@ -0,0 +1,125 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <addrman.h>
+#include <bench/bench.h>
+#include <random.h>
+#include <util.h>
+
+#include <vector>
+
+// Roughly what a long running node accumulates from addr messages
+static const size_t NUM_SOURCES = 256;
+static const size_t NUM_ADDRESSES_PER_SOURCE = 64;
+
+static std::vector<CAddress> vAddresses[NUM_SOURCES];
+static std::vector<CNetAddr> vSources;
+
+static CNetAddr RandomIPv4(FastRandomContext& rng)
+{
+    struct in_addr addr;
+    addr.s_addr = (uint32_t)rng.rand32();
+    return CNetAddr(addr);
+}
+
+static void CreateAddresses()
+{
+    if (!vSources.empty()) {
+        return;
+    }
+
+    FastRandomContext rng(true);
+    for (size_t source = 0; source < NUM_SOURCES; source++) {
+        vSources.emplace_back(RandomIPv4(rng));
+        for (size_t addr = 0; addr < NUM_ADDRESSES_PER_SOURCE; addr++) {
+            CAddress address(CService(RandomIPv4(rng), 9999), NODE_NETWORK);
+            address.nTime = GetAdjustedTime();
+            vAddresses[source].push_back(address);
+        }
+    }
+}
+
+static void AddAddressesToAddrMan(CAddrMan& addrman)
+{
+    for (size_t source = 0; source < NUM_SOURCES; source++) {
+        addrman.Add(vAddresses[source], vSources[source]);
+    }
+}
+
+static void FillAddrMan(CAddrMan& addrman)
+{
+    CreateAddresses();
+    AddAddressesToAddrMan(addrman);
+}
+
+static void AddrManAdd(benchmark::State& state)
+{
+    CreateAddresses();
+
+    while (state.KeepRunning()) {
+        CAddrMan addrman;
+        AddAddressesToAddrMan(addrman);
+        addrman.Clear();
+    }
+}
+
+static void AddrManSelect(benchmark::State& state)
+{
+    CAddrMan addrman;
+    FillAddrMan(addrman);
+
+    while (state.KeepRunning()) {
+        const auto& address = addrman.Select();
+        assert(address.GetPort() > 0);
+    }
+}
+
+// A mostly empty table, like shortly after startup, is where probing for an occupied position took longest
+static void AddrManSelectSparse(benchmark::State& state)
+{
+    CAddrMan addrman;
+    CreateAddresses();
+    addrman.Add(vAddresses[0], vSources[0]);
+
+    while (state.KeepRunning()) {
+        const auto& address = addrman.Select();
+        assert(address.GetPort() > 0);
+    }
+}
+
+static void AddrManGood(benchmark::State& state)
+{
+    /* Create many CAddrMan objects - one to be modified at each loop iteration.
+     * This is necessary because the CAddrMan::Good() method modifies the
+     * object, affecting the timing of subsequent calls to the same method and
+     * we want to do the same amount of work in every loop iteration. */
+
+    const uint64_t numLoops = state.m_num_iters * (state.m_num_warmup + state.m_num_evals);
+
+    std::vector<CAddrMan> addrmans(numLoops);
+    for (auto& addrman : addrmans) {
+        FillAddrMan(addrman);
+    }
+
+    auto markSomeAsGood = [](CAddrMan& addrman) {
+        for (size_t source = 0; source < NUM_SOURCES; source++) {
+            for (size_t addr = 0; addr < NUM_ADDRESSES_PER_SOURCE; addr++) {
+                if (addr == source % NUM_ADDRESSES_PER_SOURCE) {
+                    addrman.Good(vAddresses[source][addr]);
+                }
+            }
+        }
+    };
+
+    uint64_t i = 0;
+    while (state.KeepRunning()) {
+        markSomeAsGood(addrmans.at(i));
+        ++i;
+    }
+}
+
+BENCHMARK(AddrManAdd, 5);
+BENCHMARK(AddrManSelect, 1000000);
+BENCHMARK(AddrManSelectSparse, 1000000);
+BENCHMARK(AddrManGood, 2);
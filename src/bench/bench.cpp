@@ -4,42 +4,111 @@
 
 #include <bench/bench.h>
 
+#include <univalue.h>
+
 #include <assert.h>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <memory>
 #include <regex>
 #include <numeric>
 
-void benchmark::ConsolePrinter::header()
+// two-sided 95% quantiles of Student's t-distribution for 1 to 30 degrees of freedom, the normal one beyond
+static const double T_DISTRIBUTION_95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double Quantile(const std::vector<double>& sorted, double q)
 {
-    std::cout << "# Benchmark, evals, iterations, total, min, max, median" << std::endl;
+    double pos = q * (sorted.size() - 1);
+    size_t lower = (size_t)pos;
+    if (lower + 1 >= sorted.size()) {
+        return sorted.back();
+    }
+    return sorted[lower] + (pos - lower) * (sorted[lower + 1] - sorted[lower]);
 }
 
-void benchmark::ConsolePrinter::result(const State& state)
+benchmark::Statistics benchmark::ComputeStatistics(std::vector<double> results)
 {
-    auto results = state.m_elapsed_results;
+    Statistics stats;
+    if (results.empty()) {
+        return stats;
+    }
+
     std::sort(results.begin(), results.end());
+    stats.min = results.front();
+    stats.max = results.back();
+    stats.median = Quantile(results, 0.5);
 
-    double total = state.m_num_iters * std::accumulate(results.begin(), results.end(), 0.0);
+    const double q1 = Quantile(results, 0.25);
+    const double q3 = Quantile(results, 0.75);
+    const double low_fence = q1 - 1.5 * (q3 - q1);
+    const double high_fence = q3 + 1.5 * (q3 - q1);
 
-    double front = 0;
-    double back = 0;
-    double median = 0;
+    std::vector<double> kept;
+    for (double result : results) {
+        if (result >= low_fence && result <= high_fence) {
+            kept.push_back(result);
+        }
+    }
+    stats.outliers = results.size() - kept.size();
+
+    stats.mean = std::accumulate(kept.begin(), kept.end(), 0.0) / kept.size();
+    stats.ci95_low = stats.ci95_high = stats.mean;
+    if (kept.size() > 1) {
+        double sum_squares = 0;
+        for (double result : kept) {
+            sum_squares += (result - stats.mean) * (result - stats.mean);
+        }
+        stats.stddev = std::sqrt(sum_squares / (kept.size() - 1));
 
-    if (!results.empty()) {
-        front = results.front();
-        back = results.back();
+        const size_t df = kept.size() - 1;
+        const double t = df <= sizeof(T_DISTRIBUTION_95) / sizeof(T_DISTRIBUTION_95[0]) ? T_DISTRIBUTION_95[df - 1] : 1.96;
+        const double half_width = t * stats.stddev / std::sqrt((double)kept.size());
+        stats.ci95_low = stats.mean - half_width;
+        stats.ci95_high = stats.mean + half_width;
+    }
+    return stats;
+}
 
-        size_t mid = results.size() / 2;
-        median = results[mid];
-        if (0 == results.size() % 2) {
-            median = (results[mid] + results[mid + 1]) / 2;
+// The available counters of the measured evaluations, per iteration
+static std::vector<std::pair<const char*, double>> CountersPerIteration(const benchmark::State& state)
+{
+    std::vector<std::pair<const char*, double>> ret;
+    if (!state.m_perf || state.m_elapsed_results.empty()) {
+        return ret;
+    }
+    const double iterations = (double)state.m_num_iters * state.m_elapsed_results.size();
+    for (int i = 0; i < benchmark::PerfCounters::COUNTER_COUNT; i++) {
+        auto counter = (benchmark::PerfCounters::Counter)i;
+        if (state.m_perf->IsAvailable(counter)) {
+            ret.emplace_back(benchmark::PerfCounters::Name(counter), state.m_perf_totals[i] / iterations);
         }
     }
+    return ret;
+}
+
+void benchmark::ConsolePrinter::header()
+{
+    std::cout << "# Benchmark, evals, iterations, total, min, max, median, mean, ci95 (+-), outliers[, counters per iteration]" << std::endl;
+}
+
+void benchmark::ConsolePrinter::result(const State& state)
+{
+    const Statistics stats = ComputeStatistics(state.m_elapsed_results);
+    double total = state.m_num_iters * std::accumulate(state.m_elapsed_results.begin(), state.m_elapsed_results.end(), 0.0);
 
     std::cout << std::setprecision(6);
-    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << front << ", " << back << ", " << median << std::endl;
+    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << stats.min << ", " << stats.max << ", " << stats.median
+              << ", " << stats.mean << ", " << (stats.ci95_high - stats.mean) << ", " << stats.outliers;
+    for (const auto& counter : CountersPerIteration(state)) {
+        std::cout << ", " << counter.first << ": " << counter.second;
+    }
+    std::cout << std::endl;
 }
 
 void benchmark::ConsolePrinter::footer() {}
@@ -81,6 +150,52 @@ void benchmark::PlotlyPrinter::footer()
               << "</script></body></html>";
 }
 
+void benchmark::JSONPrinter::header()
+{
+    std::cout << "{\"benchmarks\": [" << std::endl;
+}
+
+void benchmark::JSONPrinter::result(const State& state)
+{
+    const Statistics stats = ComputeStatistics(state.m_elapsed_results);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("name", state.m_name);
+    obj.pushKV("evals", (uint64_t)state.m_num_evals);
+    obj.pushKV("warmup", (uint64_t)state.m_num_warmup);
+    obj.pushKV("iterations", (uint64_t)state.m_num_iters);
+    obj.pushKV("min", stats.min);
+    obj.pushKV("max", stats.max);
+    obj.pushKV("median", stats.median);
+    obj.pushKV("mean", stats.mean);
+    obj.pushKV("stddev", stats.stddev);
+    obj.pushKV("ci95_low", stats.ci95_low);
+    obj.pushKV("ci95_high", stats.ci95_high);
+    obj.pushKV("outliers", (uint64_t)stats.outliers);
+    UniValue results(UniValue::VARR);
+    for (double result : state.m_elapsed_results) {
+        results.push_back(result);
+    }
+    obj.pushKV("results", results);
+    const auto counters = CountersPerIteration(state);
+    if (!counters.empty()) {
+        UniValue countersObj(UniValue::VOBJ);
+        for (const auto& counter : counters) {
+            countersObj.pushKV(counter.first, counter.second);
+        }
+        obj.pushKV("counters_per_iteration", countersObj);
+    }
+
+    // print every result as soon as it is known, so an interrupted run still leaves the finished ones
+    std::cout << (m_first ? "" : ",\n") << obj.write(2);
+    m_first = false;
+}
+
+void benchmark::JSONPrinter::footer()
+{
+    std::cout << std::endl << "]}" << std::endl;
+}
+
 
 benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::benchmarks()
 {
@@ -93,7 +208,8 @@ benchmark::BenchRunner::BenchRunner(std::string name, benchmark::BenchFunction f
     benchmarks().insert(std::make_pair(name, Bench{func, num_iters_for_one_second}));
 }
 
-void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only)
+void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only,
+                                    uint64_t num_warmup, bool perf_counters)
 {
     if (!std::ratio_less_equal<benchmark::clock::period, std::micro>::value) {
         std::cerr << "WARNING: Clock precision is worse than microsecond - benchmarks may be less accurate!\n";
@@ -105,6 +221,14 @@ void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double
     std::regex reFilter(filter);
     std::smatch baseMatch;
 
+    std::unique_ptr<PerfCounters> perf;
+    if (perf_counters && !is_list_only) {
+        perf.reset(new PerfCounters());
+        if (!perf->IsAvailable(PerfCounters::CYCLES)) {
+            std::cerr << "WARNING: Hardware performance counters are not available, only allocations are counted.\n";
+        }
+    }
+
     printer.header();
 
     for (const auto& p : benchmarks()) {
@@ -116,7 +240,7 @@ void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double
         if (0 == num_iters) {
             num_iters = 1;
         }
-        State state(p.first, num_evals, num_iters, printer);
+        State state(p.first, num_evals, num_iters, printer, num_warmup, perf.get());
         if (!is_list_only) {
             p.second.func(state);
         }
@@ -129,8 +253,17 @@ void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double
 bool benchmark::State::UpdateTimer(const benchmark::time_point current_time)
 {
     if (m_start_time != time_point()) {
-        std::chrono::duration<double> diff = current_time - m_start_time;
-        m_elapsed_results.push_back(diff.count() / m_num_iters);
+        const bool fWarmup = m_num_evals_done++ < m_num_warmup;
+        if (m_perf && !fWarmup) {
+            const PerfCounters::Values values = m_perf->Read();
+            for (size_t i = 0; i < values.size(); i++) {
+                m_perf_totals[i] += values[i] - m_perf_start[i];
+            }
+        }
+        if (!fWarmup) {
+            std::chrono::duration<double> diff = current_time - m_start_time;
+            m_elapsed_results.push_back(diff.count() / m_num_iters);
+        }
 
         if (m_elapsed_results.size() == m_num_evals) {
             return false;
@@ -138,5 +271,8 @@ bool benchmark::State::UpdateTimer(const benchmark::time_point current_time)
     }
 
     m_num_iters_left = m_num_iters - 1;
+    if (m_perf) {
+        m_perf_start = m_perf->Read();
+    }
     return true;
 }
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_BENCH_BENCH_H
 #define BITCOIN_BENCH_BENCH_H
 
+#include <bench/perf.h>
+
 #include <functional>
 #include <limits>
 #include <map>
@@ -58,13 +60,25 @@ public:
     uint64_t m_num_iters_left;
     const uint64_t m_num_iters;
     const uint64_t m_num_evals;
+    //! Evaluations run before the measured ones and discarded, so caches and allocators are warmed up.
+    //! A benchmark which prepares state for every iteration in advance has to prepare (m_num_warmup + m_num_evals) * m_num_iters.
+    const uint64_t m_num_warmup;
+    uint64_t m_num_evals_done{0};
     std::vector<double> m_elapsed_results;
     time_point m_start_time;
 
+    //! nullptr unless counters were requested. m_perf_totals sums up the measured evaluations.
+    const PerfCounters* m_perf;
+    PerfCounters::Values m_perf_start;
+    PerfCounters::Values m_perf_totals;
+
     bool UpdateTimer(time_point finish_time);
 
-    State(std::string name, uint64_t num_evals, double num_iters, Printer& printer) : m_name(name), m_num_iters_left(0), m_num_iters(num_iters), m_num_evals(num_evals)
+    State(std::string name, uint64_t num_evals, double num_iters, Printer& printer, uint64_t num_warmup = 0, const PerfCounters* perf = nullptr) :
+        m_name(name), m_num_iters_left(0), m_num_iters(num_iters), m_num_evals(num_evals), m_num_warmup(num_warmup), m_perf(perf)
     {
+        m_perf_start.fill(0);
+        m_perf_totals.fill(0);
     }
 
     inline bool KeepRunning()
@@ -82,6 +96,25 @@ public:
 
 typedef std::function<void(State&)> BenchFunction;
 
+/**
+ * Summary of the per iteration times of the evaluations of a benchmark. Results outside 1.5 inter-quartile ranges of
+ * the quartiles (Tukey's fences) count as outliers and are left out of the mean, the standard deviation and the 95%
+ * confidence interval of the mean.
+ */
+struct Statistics
+{
+    double min = 0;
+    double max = 0;
+    double median = 0;
+    double mean = 0;
+    double stddev = 0;
+    double ci95_low = 0;
+    double ci95_high = 0;
+    size_t outliers = 0;
+};
+
+Statistics ComputeStatistics(std::vector<double> results);
+
 class BenchRunner
 {
     struct Bench {
@@ -94,7 +127,8 @@ class BenchRunner
 public:
     BenchRunner(std::string name, BenchFunction func, uint64_t num_iters_for_one_second);
 
-    static void RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only);
+    static void RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only,
+                       uint64_t num_warmup = 0, bool perf_counters = false);
 };
 
 // interface to output benchmark results.
@@ -107,7 +141,7 @@ public:
     virtual void footer() = 0;
 };
 
-// default printer to console, shows min, max, median.
+// default printer to console, shows min, max, median, mean with its confidence interval and the counters per iteration.
 class ConsolePrinter : public Printer
 {
 public:
@@ -116,6 +150,18 @@ public:
     void footer();
 };
 
+// all results, statistics and counters as one JSON document, for tracking regressions between versions
+class JSONPrinter : public Printer
+{
+public:
+    void header();
+    void result(const State& state);
+    void footer();
+
+private:
+    bool m_first{true};
+};
+
 // creates box plot with plotly.js
 class PlotlyPrinter : public Printer
 {
@@ -5,7 +5,9 @@
 #include <bench/bench.h>
 
 #include <crypto/sha256.h>
+#include <crypto/x11.h>
 #include <key.h>
+#include <script/sigcache.h>
 #include <stacktraces.h>
 #include <validation.h>
 #include <util.h>
@@ -18,6 +20,7 @@
 #include <bls/bls.h>
 
 static const int64_t DEFAULT_BENCH_EVALUATIONS = 5;
+static const int64_t DEFAULT_BENCH_WARMUP = 1;
 static const char* DEFAULT_BENCH_FILTER = ".*";
 static const char* DEFAULT_BENCH_SCALING = "1.0";
 static const char* DEFAULT_BENCH_PRINTER = "console";
@@ -42,9 +45,11 @@ static void SetupBenchArgs()
     gArgs.AddArg("-?", "Print this help message and exit", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-list", "List benchmarks without executing them. Can be combined with -scaling and -filter", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-evals=<n>", strprintf("Number of measurement evaluations to perform. (default: %u)", DEFAULT_BENCH_EVALUATIONS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-warmup=<n>", strprintf("Number of evaluations to perform and discard before the measured ones. (default: %u)", DEFAULT_BENCH_WARMUP), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-perfcounters", "Count heap allocations (and their bytes) and, where perf_event is available (Linux), cpu cycles, instructions, cache and branch misses per iteration", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-filter=<regex>", strprintf("Regular expression filter to select benchmark by name (default: %s)", DEFAULT_BENCH_FILTER), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-scaling=<n>", strprintf("Scaling factor for benchmark's runtime (default: %u)", DEFAULT_BENCH_SCALING), false, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-printer=(console|plot)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-printer=(console|plot|json)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph. json: Print all results and statistics as JSON (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-plotlyurl=<uri>", strprintf("URL to use for plotly.js (default: %s)", DEFAULT_PLOT_PLOTLYURL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-width=<x>", strprintf("Plot width in pixel (default: %u)", DEFAULT_PLOT_WIDTH), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-height=<x>", strprintf("Plot height in pixel (default: %u)", DEFAULT_PLOT_HEIGHT), false, OptionsCategory::OPTIONS);
@@ -65,6 +70,7 @@ int main(int argc, char** argv)
     const fs::path bench_datadir{SetDataDir()};
 
     SHA256AutoDetect();
+    X11AutoDetect();
 
     RegisterPrettySignalHandlers();
     RegisterPrettyTerminateHander();
@@ -72,6 +78,7 @@ int main(int argc, char** argv)
     RandomInit();
     ECC_Start();
     ECCVerifyHandle verifyHandle;
+    InitSignatureCache();
 
     BLSInit();
     InitBLSTests();
@@ -79,6 +86,8 @@ int main(int argc, char** argv)
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
     int64_t evaluations = gArgs.GetArg("-evals", DEFAULT_BENCH_EVALUATIONS);
+    int64_t warmup = std::max<int64_t>(0, gArgs.GetArg("-warmup", DEFAULT_BENCH_WARMUP));
+    bool perf_counters = gArgs.GetBoolArg("-perfcounters", false);
     std::string regex_filter = gArgs.GetArg("-filter", DEFAULT_BENCH_FILTER);
     std::string scaling_str = gArgs.GetArg("-scaling", DEFAULT_BENCH_SCALING);
     bool is_list_only = gArgs.GetBoolArg("-list", false);
@@ -93,9 +102,11 @@ int main(int argc, char** argv)
             gArgs.GetArg("-plot-plotlyurl", DEFAULT_PLOT_PLOTLYURL),
             gArgs.GetArg("-plot-width", DEFAULT_PLOT_WIDTH),
             gArgs.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
+    } else if ("json" == printer_arg) {
+        printer.reset(new benchmark::JSONPrinter());
     }
 
-    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
+    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only, warmup, perf_counters);
 
     fs::remove_all(bench_datadir);
 
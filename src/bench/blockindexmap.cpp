@@ -0,0 +1,91 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <blockindexmap.h>
+#include <random.h>
+
+#include <unordered_map>
+
+// About a tenth of the mainnet block index
+static const size_t BLOCK_INDEX_SIZE = 150 * 1000;
+
+struct BenchBlockHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+
+static std::vector<uint256> RandomHashes()
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> hashes(BLOCK_INDEX_SIZE);
+    for (auto& hash : hashes) {
+        hash = rng.rand256();
+    }
+    return hashes;
+}
+
+// Building the index at startup, per entry plus the separate allocation the unordered_map needs
+static void BlockIndexMap_Insert(benchmark::State& state)
+{
+    auto hashes = RandomHashes();
+    while (state.KeepRunning()) {
+        CBlockIndexMap map;
+        for (const auto& hash : hashes) {
+            map.emplace(hash);
+        }
+        assert(map.size() == hashes.size());
+    }
+}
+
+static void BlockIndexUnorderedMap_Insert(benchmark::State& state)
+{
+    auto hashes = RandomHashes();
+    while (state.KeepRunning()) {
+        std::unordered_map<uint256, CBlockIndex*, BenchBlockHasher> map;
+        for (const auto& hash : hashes) {
+            CBlockIndex* pindex = new CBlockIndex();
+            pindex->phashBlock = &map.emplace(hash, pindex).first->first;
+        }
+        assert(map.size() == hashes.size());
+        for (const auto& item : map) {
+            delete item.second;
+        }
+    }
+}
+
+// LookupBlockIndex in random order, as for headers, invs and the wallet
+static void BlockIndexMap_Lookup(benchmark::State& state)
+{
+    auto hashes = RandomHashes();
+    CBlockIndexMap map;
+    for (const auto& hash : hashes) {
+        map.emplace(hash);
+    }
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        auto it = map.find(hashes[(i++ * 7919) % hashes.size()]);
+        assert(it != map.end());
+    }
+}
+
+static void BlockIndexUnorderedMap_Lookup(benchmark::State& state)
+{
+    auto hashes = RandomHashes();
+    std::unordered_map<uint256, CBlockIndex*, BenchBlockHasher> map;
+    std::vector<CBlockIndex> indexes(hashes.size());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        map.emplace(hashes[i], &indexes[i]);
+    }
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        auto it = map.find(hashes[(i++ * 7919) % hashes.size()]);
+        assert(it != map.end());
+    }
+}
+
+BENCHMARK(BlockIndexMap_Insert, 5);
+BENCHMARK(BlockIndexUnorderedMap_Insert, 5);
+BENCHMARK(BlockIndexMap_Lookup, 1000 * 1000);
+BENCHMARK(BlockIndexUnorderedMap_Lookup, 1000 * 1000);
@@ -0,0 +1,59 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bloom.h>
+#include <pubkey.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+
+#include <vector>
+
+// Matches the transactions of a block against the filters of many SPV peers, like serving a filtered block to each
+// of them does. Every filter watches a few addresses of its own and updates itself with matched outpoints.
+static void BloomFilterIsRelevantAndUpdate(benchmark::State& state)
+{
+    const int nFilters = 200;
+    const int nTxs = 1000;
+    const int nAddressesPerFilter = 20;
+
+    std::vector<CBloomFilter> filters;
+    for (int i = 0; i < nFilters; i++) {
+        CBloomFilter filter(1000, 0.0001, i, BLOOM_UPDATE_ALL);
+        for (int j = 0; j < nAddressesPerFilter; j++) {
+            uint160 hash;
+            *hash.begin() = (unsigned char)i;
+            *(hash.begin() + 1) = (unsigned char)j;
+            filter.insert(std::vector<unsigned char>(hash.begin(), hash.end()));
+        }
+        filters.emplace_back(std::move(filter));
+    }
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < nTxs; i++) {
+        uint160 hash;
+        *hash.begin() = (unsigned char)(i % nFilters);
+        *(hash.begin() + 1) = (unsigned char)(i % 251);
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(uint256S(std::to_string(i)), 0));
+        tx.vout.emplace_back(COIN, GetScriptForDestination(CKeyID(hash)));
+        *(hash.begin() + 2) = 1;
+        *(hash.begin() + 3) = (unsigned char)(i >> 8);
+        tx.vout.emplace_back(COIN, GetScriptForDestination(CKeyID(hash)));
+        txs.emplace_back(MakeTransactionRef(tx));
+    }
+
+    uint64_t nMatches = 0;
+    while (state.KeepRunning()) {
+        for (const auto& filterIn : filters) {
+            CBloomFilter filter(filterIn);
+            for (const auto& tx : txs) {
+                nMatches += filter.IsRelevantAndUpdate(*tx);
+            }
+        }
+    }
+    assert(nMatches > 0);
+}
+
+BENCHMARK(BloomFilterIsRelevantAndUpdate, 5);
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 #include <random.h>
+#include <bls/bls_batchverifier.h>
 #include <bls/bls_worker.h>
 #include <utiltime.h>
 
@@ -358,6 +359,183 @@ static void BLS_Verify_BatchedParallel(benchmark::State& state)
     }
 }
 
+// Simulates a burst of islocks signed by a few quorums, as received by CInstantSendManager
+struct ISLockBurst {
+    std::vector<CBLSPublicKey> quorumPubKeys;
+    std::vector<size_t> quorumIdx;
+    std::vector<uint256> msgHashes;
+    BLSSignatureVector sigs;
+    std::vector<bool> invalid;
+};
+
+static void BuildISLockBurst(size_t quorumCount, size_t count, size_t invalidCount, ISLockBurst& burst)
+{
+    std::vector<CBLSSecretKey> quorumSecKeys(quorumCount);
+    burst.quorumPubKeys.resize(quorumCount);
+    for (size_t i = 0; i < quorumCount; i++) {
+        quorumSecKeys[i].MakeNewKey();
+        burst.quorumPubKeys[i] = quorumSecKeys[i].GetPublicKey();
+    }
+
+    burst.invalid.resize(count);
+    for (size_t i = 0; i < invalidCount; i++) {
+        burst.invalid[i] = true;
+    }
+    Shuffle(burst.invalid.begin(), burst.invalid.end(), FastRandomContext());
+
+    burst.quorumIdx.resize(count);
+    burst.msgHashes.resize(count);
+    burst.sigs.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        burst.quorumIdx[i] = i % quorumCount;
+        burst.msgHashes[i] = GetRandHash();
+        burst.sigs[i] = quorumSecKeys[burst.quorumIdx[i]].Sign(burst.msgHashes[i]);
+        if (burst.invalid[i]) {
+            CBLSSecretKey s;
+            s.MakeNewKey();
+            burst.sigs[i] = s.Sign(burst.msgHashes[i]);
+        }
+    }
+}
+
+static void CheckISLockBurstResult(const ISLockBurst& burst, const std::set<size_t>& badMessages)
+{
+    for (size_t i = 0; i < burst.invalid.size(); i++) {
+        if (burst.invalid[i] != (badMessages.count(i) != 0)) {
+            std::cout << "unexpected verification result" << std::endl;
+            assert(false);
+        }
+    }
+}
+
+static void BLS_Verify_ISLockBurst_Sequential(benchmark::State& state)
+{
+    ISLockBurst burst;
+    BuildISLockBurst(4, 128, 2, burst);
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        CBLSBatchVerifier<size_t, size_t> batchVerifier(false, true, 8);
+        for (size_t i = 0; i < burst.sigs.size(); i++) {
+            batchVerifier.PushMessage(i % 32, i, burst.msgHashes[i], burst.sigs[i], burst.quorumPubKeys[burst.quorumIdx[i]]);
+        }
+        batchVerifier.Verify();
+        CheckISLockBurstResult(burst, batchVerifier.badMessages);
+    }
+}
+
+static void BLS_Verify_ISLockBurst_Parallel(benchmark::State& state)
+{
+    ISLockBurst burst;
+    BuildISLockBurst(4, 128, 2, burst);
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        CBLSParallelBatchVerifier<size_t, size_t, size_t> batchVerifier(blsWorker, false, true, 8);
+        for (size_t i = 0; i < burst.sigs.size(); i++) {
+            batchVerifier.PushMessage(burst.quorumIdx[i], i % 32, i, burst.msgHashes[i], burst.sigs[i], burst.quorumPubKeys[burst.quorumIdx[i]]);
+        }
+        batchVerifier.Verify();
+        CheckISLockBurstResult(burst, batchVerifier.badMessages);
+    }
+}
+
+// Simulates the quorum signatures of a block which contains commitments for multiple LLMQ types
+static void BLS_Verify_BlockCommitments(bool batched, benchmark::State& state)
+{
+    BLSPublicKeyVector pubKeys;
+    BLSSecretKeyVector secKeys;
+    BLSSignatureVector sigs;
+    std::vector<uint256> msgHashes;
+    std::vector<bool> invalid;
+    BuildTestVectors(4, 0, pubKeys, secKeys, sigs, msgHashes, invalid);
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        bool valid = true;
+        if (batched) {
+            CBLSBatchVerifier<uint256, uint256> batchVerifier(true, false);
+            for (size_t i = 0; i < sigs.size(); i++) {
+                batchVerifier.PushMessage(msgHashes[i], msgHashes[i], msgHashes[i], sigs[i], pubKeys[i]);
+            }
+            batchVerifier.Verify();
+            valid = batchVerifier.badSources.empty();
+        } else {
+            for (size_t i = 0; i < sigs.size() && valid; i++) {
+                valid = sigs[i].VerifyInsecure(pubKeys[i], msgHashes[i]);
+            }
+        }
+        assert(valid);
+    }
+}
+
+static void BLS_Verify_BlockCommitments_Individual(benchmark::State& state)
+{
+    BLS_Verify_BlockCommitments(false, state);
+}
+
+static void BLS_Verify_BlockCommitments_Batched(benchmark::State& state)
+{
+    BLS_Verify_BlockCommitments(true, state);
+}
+
+static void BuildSerializedSigs(size_t count, std::vector<std::vector<uint8_t>>& vecSigs)
+{
+    vecSigs.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        vecSigs[i] = sk.Sign(GetRandHash()).ToByteVector();
+    }
+}
+
+// Decompression of lazy signatures which were not seen before, e.g. sig shares
+static void BLS_LazySignature_Decompress(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> vecSigs;
+    BuildSerializedSigs(1000, vecSigs);
+
+    // Benchmark.
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        if (i == 0) {
+            CBLSDecompressionCache::Clear();
+        }
+        CBLSLazySignature sig;
+        sig.SetBuf(vecSigs[i].data());
+        if (!sig.Get().IsValid()) {
+            assert(false);
+        }
+        i = (i + 1) % vecSigs.size();
+    }
+}
+
+// Decompression of lazy signatures which were decompressed before, e.g. recovered sigs or islocks received from
+// multiple peers
+static void BLS_LazySignature_Decompress_Cached(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> vecSigs;
+    BuildSerializedSigs(1000, vecSigs);
+
+    CBLSDecompressionCache::Clear();
+    for (const auto& vecSig : vecSigs) {
+        CBLSLazySignature sig;
+        sig.SetBuf(vecSig.data());
+        sig.Get();
+    }
+
+    // Benchmark.
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CBLSLazySignature sig;
+        sig.SetBuf(vecSigs[i].data());
+        if (!sig.Get().IsValid()) {
+            assert(false);
+        }
+        i = (i + 1) % vecSigs.size();
+    }
+}
+
 BENCHMARK(BLS_PubKeyAggregate_Normal, 700 * 1000)
 BENCHMARK(BLS_SecKeyAggregate_Normal, 1300 * 1000)
 BENCHMARK(BLS_SignatureAggregate_Normal, 300 * 1000)
@@ -372,3 +550,9 @@ BENCHMARK(BLS_Verify_LargeAggregatedBlock1000, 1)
 BENCHMARK(BLS_Verify_LargeAggregatedBlock1000PreVerified, 7)
 BENCHMARK(BLS_Verify_Batched, 500)
 BENCHMARK(BLS_Verify_BatchedParallel, 1000)
+BENCHMARK(BLS_Verify_ISLockBurst_Sequential, 5)
+BENCHMARK(BLS_Verify_ISLockBurst_Parallel, 5)
+BENCHMARK(BLS_Verify_BlockCommitments_Individual, 100)
+BENCHMARK(BLS_Verify_BlockCommitments_Batched, 100)
+BENCHMARK(BLS_LazySignature_Decompress, 2000)
+BENCHMARK(BLS_LazySignature_Decompress_Cached, 100 * 1000)
@@ -4,7 +4,9 @@
 
 #include <bench/bench.h>
 #include <random.h>
+#include <bls/bls_ies.h>
 #include <bls/bls_worker.h>
+#include <version.h>
 
 extern CBLSWorker blsWorker;
 
@@ -19,6 +21,7 @@ struct DKG
 {
     std::vector<Member> members;
     std::vector<CBLSId> ids;
+    BLSPublicKeyVector operatorKeys;
 
     std::vector<BLSVerificationVectorPtr> receivedVvecs;
     BLSSecretKeyVector receivedSkShares;
@@ -35,6 +38,10 @@ struct DKG
             WriteLE64(id.begin(), i + 1);
             members.push_back({id, {}, {}});
             ids.emplace_back(id);
+
+            CBLSSecretKey sk;
+            sk.MakeNewKey();
+            operatorKeys.emplace_back(sk.GetPublicKey());
         }
 
         for (int i = 0; i < quorumSize; i++) {
@@ -76,6 +83,22 @@ struct DKG
         }
     }
 
+    void Bench_EncryptContributions(benchmark::State& state, bool parallel)
+    {
+        const auto& skShares = members[0].skShares;
+        while (state.KeepRunning()) {
+            CBLSIESMultiRecipientObjects<CBLSSecretKey> encrypted;
+            if (parallel) {
+                assert(blsWorker.EncryptContributions(operatorKeys, skShares, PROTOCOL_VERSION, encrypted));
+            } else {
+                encrypted.InitEncrypt(members.size());
+                for (size_t i = 0; i < members.size(); i++) {
+                    assert(encrypted.Encrypt(i, operatorKeys[i], skShares[i], PROTOCOL_VERSION));
+                }
+            }
+        }
+    }
+
     void VerifyContributionShares(size_t whoAmI, const std::set<size_t>& invalidIndexes, bool parallel, bool aggregated)
     {
         auto result = blsWorker.VerifyContributionShares(members[whoAmI].id, receivedVvecs, receivedSkShares, parallel, aggregated);
@@ -158,6 +181,25 @@ BENCH_BuildQuorumVerificationVectors(parallel, 400, true, 8)
 
 
 
+#define BENCH_EncryptContributions(name, quorumSize, parallel, num_iters_for_one_second) \
+    static void BLSDKG_EncryptContributions_##name##_##quorumSize(benchmark::State& state) \
+    { \
+        InitIfNeeded(); \
+        dkg##quorumSize->Bench_EncryptContributions(state, parallel); \
+    } \
+    BENCHMARK(BLSDKG_EncryptContributions_##name##_##quorumSize, num_iters_for_one_second)
+
+BENCH_EncryptContributions(simple, 10, false, 300)
+BENCH_EncryptContributions(simple, 100, false, 30)
+BENCH_EncryptContributions(simple, 400, false, 8)
+BENCH_EncryptContributions(parallel, 10, true, 600)
+BENCH_EncryptContributions(parallel, 100, true, 100)
+BENCH_EncryptContributions(parallel, 400, true, 25)
+
+///////////////////////////////
+
+
+
 #define BENCH_VerifyContributionShares(name, quorumSize, invalidCount, parallel, aggregated, num_iters_for_one_second) \
     static void BLSDKG_VerifyContributionShares_##name##_##quorumSize(benchmark::State& state) \
     { \
@@ -84,4 +84,51 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// IBD-like access pattern on a large cache: every "block" creates a child cache
+// which adds new coins and spends some of the coins of the previous blocks, the
+// child is then flushed into the large cache, which is in turn flushed (and
+// released) once it holds many coins.
+static void CCoinsCachingLargeCacheIBD(benchmark::State& state)
+{
+    const int NUM_BLOCKS = 100;
+    const int NUM_TXS_PER_BLOCK = 500;
+    const int NUM_OUTPUTS_PER_TX = 4;
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache coinsTip(&coinsDummy);
+
+    CMutableTransaction tx;
+    tx.vout.resize(NUM_OUTPUTS_PER_TX);
+    for (auto& out : tx.vout) {
+        out.nValue = 1 * CENT;
+        out.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+
+    uint32_t nLockTime = 0;
+    while (state.KeepRunning()) {
+        std::vector<uint256> prevHashes;
+        for (int nBlock = 0; nBlock < NUM_BLOCKS; nBlock++) {
+            CCoinsViewCache view(&coinsTip);
+            std::vector<uint256> blockHashes;
+            blockHashes.reserve(NUM_TXS_PER_BLOCK);
+            for (int i = 0; i < NUM_TXS_PER_BLOCK; i++) {
+                tx.nLockTime = nLockTime++;
+                CTransaction txNew(tx);
+                AddCoins(view, txNew, nBlock);
+                blockHashes.emplace_back(txNew.GetHash());
+            }
+            // spend half of the outputs of the previous block
+            for (const uint256& hash : prevHashes) {
+                for (uint32_t n = 0; n < NUM_OUTPUTS_PER_TX; n += 2) {
+                    view.SpendCoin(COutPoint(hash, n));
+                }
+            }
+            view.Flush();
+            prevHashes = std::move(blockHashes);
+        }
+        coinsTip.Flush();
+    }
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCachingLargeCacheIBD, 2);
@@ -5,17 +5,23 @@
 #include <bench/bench.h>
 
 #include <chainparams.h>
+#include <checkqueue.h>
+#include <key.h>
+#include <policy/policy.h>
+#include <script/standard.h>
 #include <validation.h>
 #include <streams.h>
 #include <consensus/validation.h>
 
+#include <boost/thread/thread.hpp>
+
 #include <bench/data/block813851.raw.h>
 
 // These are the two major time-sinks which happen after we have fully received
 // a block off the wire, but before we can relay the block on to peers using
 // compact block relay.
 
-static void DeserializeBlockTest(benchmark::State& state)
+static void DeserializeBlock(benchmark::State& state, bool fArena)
 {
     CDataStream stream((const char*)raw_bench::block813851,
             (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
@@ -23,6 +29,10 @@ static void DeserializeBlockTest(benchmark::State& state)
     char a = '\0';
     stream.write(&a, 1); // Prevent compaction
 
+    std::unique_ptr<CTransactionArenaScope> arenaScope;
+    if (fArena) {
+        arenaScope.reset(new CTransactionArenaScope());
+    }
     while (state.KeepRunning()) {
         CBlock block;
         stream >> block;
@@ -30,6 +40,10 @@ static void DeserializeBlockTest(benchmark::State& state)
     }
 }
 
+static void DeserializeBlockTest(benchmark::State& state) { DeserializeBlock(state, false); }
+// with the transactions in a CTransactionArena, as for blocks received from peers, VerifyDB and reindex
+static void DeserializeBlockTest_Arena(benchmark::State& state) { DeserializeBlock(state, true); }
+
 static void DeserializeAndCheckBlockTest(benchmark::State& state)
 {
     CDataStream stream((const char*)raw_bench::block813851,
@@ -50,5 +64,115 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+static CBlock DeserializeBenchBlock()
+{
+    CDataStream stream((const char*)raw_bench::block813851,
+            (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+    return block;
+}
+
+// GetHash() of an unchanged block, as repeated by validation, relay and RPC, against a header that changed in between
+static void BlockGetHash_Cached(benchmark::State& state)
+{
+    CBlock block = DeserializeBenchBlock();
+    while (state.KeepRunning()) {
+        assert(!block.GetHash().IsNull());
+    }
+}
+
+static void BlockGetHash_Changed(benchmark::State& state)
+{
+    CBlock block = DeserializeBenchBlock();
+    while (state.KeepRunning()) {
+        block.nNonce++;
+        assert(!block.GetHash().IsNull());
+    }
+}
+
+// Serialized size of a block, with the sizes cached in CTransaction and by walking all transactions
+static void BlockSerializeSize_Cached(benchmark::State& state)
+{
+    CBlock block = DeserializeBenchBlock();
+    while (state.KeepRunning()) {
+        assert(::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION) == sizeof(raw_bench::block813851));
+    }
+}
+
+static void BlockSerializeSize_Walk(benchmark::State& state)
+{
+    CBlock block = DeserializeBenchBlock();
+    std::vector<CMutableTransaction> txs;
+    for (const auto& tx : block.vtx) {
+        txs.emplace_back(*tx);
+    }
+    while (state.KeepRunning()) {
+        size_t nSize = ::GetSerializeSize(block.GetBlockHeader(), SER_NETWORK, PROTOCOL_VERSION);
+        nSize += ::GetSerializeSize(txs, SER_NETWORK, PROTOCOL_VERSION);
+        assert(nSize == sizeof(raw_bench::block813851));
+    }
+}
+
+// Script checks of a CoinJoin sized transaction on the script check threads, with one job per input as CheckInputs()
+// creates them or with the P2PKH spends batched by CSigBatchCollector as ConnectBlock() does
+static void CheckCoinJoinInputs(benchmark::State& state, bool fBatched)
+{
+    const size_t nInputs = 200;
+    const int nHashType = SIGHASH_ALL | SIGHASH_ANYONECANPAY;
+
+    CMutableTransaction mtx;
+    std::vector<CKey> keys(nInputs);
+    std::vector<CTxOut> prevouts;
+    for (size_t i = 0; i < nInputs; i++) {
+        keys[i].MakeNewKey(true);
+        prevouts.emplace_back(100001, GetScriptForDestination(keys[i].GetPubKey().GetID()));
+        mtx.vin.emplace_back(COutPoint(::SerializeHash((int)i), 0));
+        mtx.vout.emplace_back(100000, GetScriptForDestination(keys[i].GetPubKey().GetID()));
+    }
+    for (size_t i = 0; i < nInputs; i++) {
+        std::vector<unsigned char> sig;
+        keys[i].Sign(SignatureHash(prevouts[i].scriptPubKey, mtx, i, nHashType, prevouts[i].nValue, SigVersion::BASE), sig);
+        sig.push_back((unsigned char)nHashType);
+        mtx.vin[i].scriptSig << sig << ToByteVector(keys[i].GetPubKey());
+    }
+    const CTransaction tx(mtx);
+    PrecomputedTransactionData txdata(tx);
+
+    CCheckQueue<CScriptCheck> queue(128);
+    boost::thread_group tg;
+    for (int i = 0; i < 2; i++) {
+        tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CScriptCheck> control(&queue);
+        std::vector<CScriptCheck> vChecks;
+        vChecks.reserve(nInputs);
+        for (size_t i = 0; i < nInputs; i++) {
+            vChecks.emplace_back(prevouts[i], tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, false, &txdata);
+        }
+        if (fBatched) {
+            CSigBatchCollector sigBatch;
+            sigBatch.Add(vChecks);
+            sigBatch.Flush(vChecks);
+        }
+        control.Add(vChecks);
+        assert(control.Wait());
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void CheckCoinJoinInputs_PerInput(benchmark::State& state) { CheckCoinJoinInputs(state, false); }
+static void CheckCoinJoinInputs_Batched(benchmark::State& state) { CheckCoinJoinInputs(state, true); }
+
 BENCHMARK(DeserializeBlockTest, 130);
+BENCHMARK(DeserializeBlockTest_Arena, 130);
 BENCHMARK(DeserializeAndCheckBlockTest, 160);
+BENCHMARK(BlockGetHash_Cached, 1000 * 1000);
+BENCHMARK(BlockGetHash_Changed, 20 * 1000);
+BENCHMARK(BlockSerializeSize_Cached, 20 * 1000);
+BENCHMARK(BlockSerializeSize_Walk, 500);
+BENCHMARK(CheckCoinJoinInputs_PerInput, 10);
+BENCHMARK(CheckCoinJoinInputs_Batched, 10);
@@ -104,5 +104,47 @@ static void BnBExhaustion(benchmark::State& state)
     }
 }
 
+//! Number of UTXOs of a large wallet, e.g. one which receives many small payouts
+static const int LARGE_WALLET_UTXOS = 500000;
+
+static std::vector<CInputCoin> MakeLargeWalletPool()
+{
+    FastRandomContext rand(true);
+    std::vector<CInputCoin> utxo_pool;
+    utxo_pool.reserve(LARGE_WALLET_UTXOS);
+    for (int i = 0; i < LARGE_WALLET_UTXOS; ++i) {
+        add_coin(10000 + rand.randrange(CENT), 0, utxo_pool);
+        utxo_pool.back().outpoint.n = i; // so all coins are different
+    }
+    return utxo_pool;
+}
+
+// Sorting a large wallet's UTXOs and computing the prefix sums, which is done once per selection pool
+static void CoinSelectionIndexLargeWallet(benchmark::State& state)
+{
+    const std::vector<CInputCoin> utxo_pool = MakeLargeWalletPool();
+
+    while (state.KeepRunning()) {
+        CoinSelectionIndex index(utxo_pool);
+        assert(index.size() == utxo_pool.size());
+    }
+}
+
+// Selecting from an existing index of a large wallet's UTXOs for a range of targets
+static void BnBLargeWallet(benchmark::State& state)
+{
+    const CoinSelectionIndex index(MakeLargeWalletPool());
+    CoinSet selection;
+    CAmount value_ret = 0;
+
+    while (state.KeepRunning()) {
+        for (CAmount target = 1 * COIN; target <= 10 * COIN; target += 1 * COIN) {
+            SelectCoinsBnB(index, target, 1000, selection, value_ret, 0);
+        }
+    }
+}
+
 BENCHMARK(CoinSelection, 650);
 BENCHMARK(BnBExhaustion, 650);
+BENCHMARK(CoinSelectionIndexLargeWallet, 20);
+BENCHMARK(BnBLargeWallet, 20);
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <compressor.h>
+#include <key.h>
+#include <script/standard.h>
+#include <streams.h>
+
+// Writes a coin paying to script and reads it back, like a coin flushed to and loaded from the chainstate
+static void CoinRoundtrip(benchmark::State& state, const CScript& script)
+{
+    Coin coin(CTxOut(COIN, script), 1000, false);
+    while (state.KeepRunning()) {
+        CDataStream ss(SER_DISK, 0);
+        ss << coin;
+        Coin coin2;
+        ss >> coin2;
+        assert(coin2.out.scriptPubKey.size() == script.size());
+    }
+}
+
+static CPubKey GetBenchPubKey(bool fCompressed)
+{
+    CKey key;
+    key.MakeNewKey(fCompressed);
+    return key.GetPubKey();
+}
+
+static void CompressCoin_P2PKH(benchmark::State& state)
+{
+    CoinRoundtrip(state, GetScriptForDestination(GetBenchPubKey(true).GetID()));
+}
+
+static void CompressCoin_P2SH(benchmark::State& state)
+{
+    CoinRoundtrip(state, GetScriptForDestination(CScriptID(CScript() << OP_TRUE)));
+}
+
+static void CompressCoin_P2PK(benchmark::State& state)
+{
+    CoinRoundtrip(state, GetScriptForRawPubKey(GetBenchPubKey(true)));
+}
+
+static void CompressCoin_P2PKUncompressed(benchmark::State& state)
+{
+    CoinRoundtrip(state, GetScriptForRawPubKey(GetBenchPubKey(false)));
+}
+
+static void CompressCoin_P2PKUncompressedStoredAsIs(benchmark::State& state)
+{
+    fStoreP2PKUncompressed = true;
+    CoinRoundtrip(state, GetScriptForRawPubKey(GetBenchPubKey(false)));
+    fStoreP2PKUncompressed = DEFAULT_STORE_P2PK_UNCOMPRESSED;
+}
+
+BENCHMARK(CompressCoin_P2PKH, 2 * 1000 * 1000)
+BENCHMARK(CompressCoin_P2SH, 2 * 1000 * 1000)
+BENCHMARK(CompressCoin_P2PK, 2 * 1000 * 1000)
+BENCHMARK(CompressCoin_P2PKUncompressed, 20 * 1000)
+BENCHMARK(CompressCoin_P2PKUncompressedStoredAsIs, 2 * 1000 * 1000)
@@ -15,6 +15,7 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
+#include <crypto/x11.h>
 
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
@@ -77,6 +78,64 @@ static void HASH_SHA256D64_1024(benchmark::State& state)
     }
 }
 
+// Txid sized messages, hashed one by one and all together
+static const size_t MULTI_COUNT = 1000;
+
+static void MultiMessages(std::vector<std::vector<uint8_t>>& msgs, std::vector<const uint8_t*>& ptrs, std::vector<size_t>& lens)
+{
+    FastRandomContext rng(true);
+    msgs.resize(MULTI_COUNT);
+    for (auto& msg : msgs) {
+        msg.resize(200 + rng.randrange(150));
+        ptrs.emplace_back(msg.data());
+        lens.emplace_back(msg.size());
+    }
+}
+
+static void HASH_DSHA256_1000x250b(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> msgs;
+    std::vector<const uint8_t*> ptrs;
+    std::vector<size_t> lens;
+    MultiMessages(msgs, ptrs, lens);
+    std::vector<uint8_t> out(CSHA256::OUTPUT_SIZE * MULTI_COUNT);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < MULTI_COUNT; i++) {
+            CHash256().Write(ptrs[i], lens[i]).Finalize(out.data() + i * CSHA256::OUTPUT_SIZE);
+        }
+    }
+}
+
+static void HASH_SHA256_64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1024; i++) {
+            CSHA256().Write(in.data() + 64 * i, 64).Finalize(in.data() + 32 * i);
+        }
+    }
+}
+
+static void HASH_SHA256S64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256S64(in.data(), in.data(), 1024);
+    }
+}
+
+static void HASH_SHA256DMulti_1000x250b(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> msgs;
+    std::vector<const uint8_t*> ptrs;
+    std::vector<size_t> lens;
+    MultiMessages(msgs, ptrs, lens);
+    std::vector<uint8_t> out(CSHA256::OUTPUT_SIZE * MULTI_COUNT);
+    while (state.KeepRunning()) {
+        SHA256DMulti(out.data(), ptrs.data(), lens.data(), MULTI_COUNT);
+    }
+}
+
 static void HASH_SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -210,6 +269,28 @@ static void HASH_X11_2048b_single(benchmark::State& state)
         hash = HashX11(in.begin(), in.end());
 }
 
+static void HASH_X11_Shavite512_64b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64,0);
+    while (state.KeepRunning())
+        X11Shavite512_64(in.data(), in.data());
+}
+
+static void HASH_X11_Echo512_64b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64,0);
+    while (state.KeepRunning())
+        X11Echo512_64(in.data(), in.data());
+}
+
+static void HASH_X11_Headers_1000(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80 * 1000,0);
+    std::vector<uint256> out(1000);
+    while (state.KeepRunning())
+        HashX11Headers(out.data(), in.data(), 1000);
+}
+
 BENCHMARK(HASH_RIPEMD160, 440);
 BENCHMARK(HASH_SHA1, 570);
 BENCHMARK(HASH_SHA256, 340);
@@ -221,6 +302,10 @@ BENCHMARK(HASH_SHA256_0032b, 4 * 1000 * 1000);
 BENCHMARK(HASH_DSHA256_0032b, 2 * 1000 * 1000);
 BENCHMARK(HASH_SipHash_0032b, 35 * 1000 * 1000);
 BENCHMARK(HASH_SHA256D64_1024, 7400);
+BENCHMARK(HASH_DSHA256_1000x250b, 1000);
+BENCHMARK(HASH_SHA256_64_1024, 7400);
+BENCHMARK(HASH_SHA256S64_1024, 7400);
+BENCHMARK(HASH_SHA256DMulti_1000x250b, 1000);
 
 BENCHMARK(HASH_DSHA256_0032b_single, 2000 * 1000);
 BENCHMARK(HASH_DSHA256_0080b_single, 1500 * 1000);
@@ -234,5 +319,8 @@ BENCHMARK(HASH_X11_0128b_single, 60 * 1000);
 BENCHMARK(HASH_X11_0512b_single, 50 * 1000);
 BENCHMARK(HASH_X11_1024b_single, 50 * 1000);
 BENCHMARK(HASH_X11_2048b_single, 50 * 1000);
+BENCHMARK(HASH_X11_Shavite512_64b, 700 * 1000);
+BENCHMARK(HASH_X11_Echo512_64b, 500 * 1000);
+BENCHMARK(HASH_X11_Headers_1000, 65);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,42 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <streams.h>
+#include <uint256.h>
+#include <version.h>
+
+// Roughly the size of a small p2p message or a LevelDB value (inv, islock, sig share)
+static const size_t OBJECT_COUNT = 8;
+
+// Builds a stream, serializes a few hashes into it and reads them back, like a received message or a db value
+template <typename Stream>
+static void DataStreamRoundtrip(benchmark::State& state)
+{
+    uint256 hash = uint256S("0x7ac1d6e5a1f1cb25c2d4dfcac7bac2e3f08d4a8cc6e0b1c211d702f9c3a54b1e");
+    while (state.KeepRunning()) {
+        Stream ss(SER_NETWORK, PROTOCOL_VERSION);
+        for (size_t i = 0; i < OBJECT_COUNT; i++) {
+            ss << hash;
+        }
+        uint256 tmp;
+        for (size_t i = 0; i < OBJECT_COUNT; i++) {
+            ss >> tmp;
+        }
+        assert(tmp == hash);
+    }
+}
+
+static void DataStream_ZeroAfterFree(benchmark::State& state)
+{
+    DataStreamRoundtrip<CDataStream>(state);
+}
+
+static void DataStream_Public(benchmark::State& state)
+{
+    DataStreamRoundtrip<CPublicDataStream>(state);
+}
+
+BENCHMARK(DataStream_ZeroAfterFree, 500 * 1000)
+BENCHMARK(DataStream_Public, 500 * 1000)
@@ -0,0 +1,60 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <vector>
+
+// Writes batches of hash keyed entries into a memory database which already holds many of them, and looks up
+// existing and missing keys in between, similar to the llmq and evo databases. Run once per tuning profile.
+static void DBWrapperProfile(benchmark::State& state, const std::string& strProfile)
+{
+    const int nInitialEntries = 50000;
+    const int nBatchSize = 100;
+    const int nReads = 1000;
+
+    CDBWrapper db("", 8 << 20, *GetDBProfile(strProfile), true /* fMemory */);
+    FastRandomContext rand(true);
+    std::vector<uint256> keys;
+    const std::vector<unsigned char> value(100, 0x42);
+
+    auto writeBatch = [&](int nCount) {
+        CDBBatch batch(db);
+        for (int i = 0; i < nCount; i++) {
+            keys.emplace_back(rand.rand256());
+            batch.Write(keys.back(), value);
+        }
+        db.WriteBatch(batch);
+    };
+    for (int i = 0; i < nInitialEntries; i += nBatchSize) {
+        writeBatch(nBatchSize);
+    }
+
+    std::vector<unsigned char> valueRet;
+    while (state.KeepRunning()) {
+        writeBatch(nBatchSize);
+        for (int i = 0; i < nReads; i++) {
+            if (i % 2) {
+                assert(db.Read(keys[rand.randrange(keys.size())], valueRet));
+            } else {
+                assert(!db.Exists(rand.rand256()));
+            }
+        }
+    }
+}
+
+static void DBWrapperProfileDefault(benchmark::State& state) { DBWrapperProfile(state, "default"); }
+static void DBWrapperProfileReadHeavy(benchmark::State& state) { DBWrapperProfile(state, "readheavy"); }
+static void DBWrapperProfileWriteHeavy(benchmark::State& state) { DBWrapperProfile(state, "writeheavy"); }
+static void DBWrapperProfileCompressed(benchmark::State& state) { DBWrapperProfile(state, "compressed"); }
+static void DBWrapperProfileSmall(benchmark::State& state) { DBWrapperProfile(state, "small"); }
+
+BENCHMARK(DBWrapperProfileDefault, 20);
+BENCHMARK(DBWrapperProfileReadHeavy, 20);
+BENCHMARK(DBWrapperProfileWriteHeavy, 20);
+BENCHMARK(DBWrapperProfileCompressed, 20);
+BENCHMARK(DBWrapperProfileSmall, 20);
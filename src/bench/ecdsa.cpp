@@ -5,6 +5,11 @@
 #include <bench/bench.h>
 
 #include <key.h>
+#include <policy/policy.h>
+#include <script/interpreter.h>
+#include <script/sigcache.h>
+#include <script/standard.h>
+#include <validation.h>
 
 static void ECDSASign(benchmark::State& state)
 {
@@ -72,6 +77,49 @@ static void ECDSAVerify_LargeBlock(benchmark::State& state)
     }
 }
 
+// Spend of a P2PKH output as in CoinJoin transactions, verified by the interpreter or by the P2PKH fast path of
+// CScriptCheck. The difference is the overhead of the interpreter on top of the ECDSA verification.
+static void P2PKHVerify(benchmark::State& state, bool fInterpreter)
+{
+    std::vector<CScript> scriptPubKeys;
+    std::vector<CTransaction> txs;
+    txs.reserve(100);
+    for (size_t i = 0; i < 100; i++) {
+        CKey k;
+        k.MakeNewKey(true);
+        scriptPubKeys.emplace_back(GetScriptForDestination(k.GetPubKey().GetID()));
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.hash = ::SerializeHash((int)i);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1;
+        tx.vout[0].scriptPubKey = scriptPubKeys.back();
+        std::vector<unsigned char> sig;
+        k.Sign(SignatureHash(scriptPubKeys.back(), tx, 0, SIGHASH_ALL | SIGHASH_ANYONECANPAY, 0, SigVersion::BASE), sig);
+        sig.push_back((unsigned char)(SIGHASH_ALL | SIGHASH_ANYONECANPAY));
+        tx.vin[0].scriptSig << sig << ToByteVector(k.GetPubKey());
+        txs.emplace_back(tx);
+    }
+    std::vector<PrecomputedTransactionData> txdata(txs.begin(), txs.end());
+
+    // Benchmark.
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CTxOut txout(0, scriptPubKeys[i]);
+        if (fInterpreter) {
+            assert(VerifyScript(txs[i].vin[0].scriptSig, txout.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, CachingTransactionSignatureChecker(&txs[i], 0, 0, txdata[i], false)));
+        } else {
+            assert(CScriptCheck(txout, txs[i], 0, STANDARD_SCRIPT_VERIFY_FLAGS, false, &txdata[i]).VerifyP2PKHSignature());
+        }
+        i = (i + 1) % txs.size();
+    }
+}
+
+static void P2PKHVerify_Interpreter(benchmark::State& state) { P2PKHVerify(state, true); }
+static void P2PKHVerify_FastPath(benchmark::State& state) { P2PKHVerify(state, false); }
+
 BENCHMARK(ECDSASign, 22 * 1000)
 BENCHMARK(ECDSAVerify, 15 * 1000)
 BENCHMARK(ECDSAVerify_LargeBlock, 15)
+BENCHMARK(P2PKHVerify_Interpreter, 15 * 1000)
+BENCHMARK(P2PKHVerify_FastPath, 15 * 1000)
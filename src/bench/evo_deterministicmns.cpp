@@ -0,0 +1,471 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <consensus/validation.h>
+#include <evo/cbtx.h>
+#include <evo/deterministicmns.h>
+#include <evo/evodb.h>
+#include <evo/providertx.h>
+#include <evo/simplifiedmns.h>
+#include <evo/specialtx.h>
+#include <llmq/quorums_commitment.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <scheduler.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <deque>
+
+// The MNs are registered over the first blocks of the chain, which are followed by blocks with churn. The chain starts
+// at a height which is a multiple of the DKG intervals of all LLMQ types and ends after the first LLMQ_400_60 quorum
+static const int START_HEIGHT = 1399680;
+static const int REGISTRATION_BLOCKS = 100;
+static const int CHURN_BLOCKS = 200;
+
+// churn per block
+static const int NEW_MNS_PER_BLOCK = 5;
+static const int SERVICE_UPDATES_PER_BLOCK = 20;
+static const int REVOCATIONS_PER_BLOCK = 2;
+static const int SPENT_COLLATERALS_PER_BLOCK = 2;
+// members of each LLMQ_50_60 quorum which failed the DKG and get PoSe punished by its commitment
+static const int FAILED_DKG_MEMBERS = 5;
+
+/**
+ * A synthetic DIP3 chain with mnCount masternodes, processed by a CDeterministicMNManager (installed as the global
+ * deterministicMNManager) on top of an in-memory CEvoDB. None of the special transactions are signed, as
+ * BuildNewListFromBlock does not verify them.
+ */
+class SyntheticMNChain
+{
+private:
+    struct BlockIndexEntry {
+        uint256 hash;
+        CBlockIndex index;
+    };
+
+    CScheduler scheduler;
+    CEvoDB evoDb{1 << 20, true, true};
+    CCoinsView coinsDummy;
+
+    // references to the entries stay valid when more entries are added at the end
+    std::deque<BlockIndexEntry> vIndexes;
+
+    FastRandomContext rng{true};
+    // registered MNs with their collaterals, for the churn of the next blocks
+    std::vector<std::pair<uint256, COutPoint>> vMNs;
+    CBLSPublicKey nextOperatorKey;
+    CBLSPublicKey operatorKeyStep;
+    uint32_t nextAddr{0};
+    // hashes of all created blocks, by height - START_HEIGHT
+    std::vector<uint256> vBlockHashes;
+
+public:
+    CCoinsViewCache view{&coinsDummy};
+
+    explicit SyntheticMNChain(size_t mnCount)
+    {
+        SelectParams(CBaseChainParams::MAIN);
+        // ProcessBlock signals list changes
+        GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+        deterministicMNManager.reset(new CDeterministicMNManager(evoDb));
+
+        // consecutive operator keys differ by a fixed key, which is much cheaper than creating new keys
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        nextOperatorKey = sk.GetPublicKey();
+        sk.MakeNewKey();
+        operatorKeyStep = sk.GetPublicKey();
+
+        // the first block, for which the list is empty
+        AddIndex(CreateBlock({}));
+
+        for (int i = 0; i < REGISTRATION_BLOCKS; i++) {
+            std::vector<CTransactionRef> txs;
+            for (size_t j = i * mnCount / REGISTRATION_BLOCKS; j < (i + 1) * mnCount / REGISTRATION_BLOCKS; j++) {
+                txs.emplace_back(CreateProRegTx());
+            }
+            ConnectBlock(CreateBlock(txs));
+        }
+        for (int i = 0; i < CHURN_BLOCKS; i++) {
+            ConnectBlock(CreateChurnBlock());
+        }
+    }
+
+    ~SyntheticMNChain()
+    {
+        deterministicMNManager.reset();
+        GetMainSignals().UnregisterBackgroundSignalScheduler();
+    }
+
+    const CBlockIndex* Tip() const
+    {
+        return &vIndexes.back().index;
+    }
+
+    const CBlockIndex* GetIndex(int nHeight) const
+    {
+        return &vIndexes.at(nHeight - START_HEIGHT).index;
+    }
+
+    /** A block with the churn of a live network: new MNs, service updates, revoked operator keys, spent collaterals
+     * and once per DKG interval of LLMQ_50_60 a commitment which PoSe punishes some of the quorum members. The block
+     * is created on top of the last created one, which does not need to be connected yet */
+    CBlock CreateChurnBlock()
+    {
+        std::vector<CTransactionRef> txs;
+        for (int i = 0; i < NEW_MNS_PER_BLOCK; i++) {
+            txs.emplace_back(CreateProRegTx());
+        }
+        for (int i = 0; i < SERVICE_UPDATES_PER_BLOCK; i++) {
+            CProUpServTx proTx;
+            proTx.proTxHash = vMNs[rng.randrange(vMNs.size())].first;
+            proTx.addr = NextAddr();
+            txs.emplace_back(CreateSpecialTx(TRANSACTION_PROVIDER_UPDATE_SERVICE, proTx));
+        }
+        for (int i = 0; i < REVOCATIONS_PER_BLOCK; i++) {
+            CProUpRevTx proTx;
+            proTx.proTxHash = vMNs[rng.randrange(vMNs.size())].first;
+            proTx.nReason = CProUpRevTx::REASON_TERMINATION_OF_SERVICE;
+            txs.emplace_back(CreateSpecialTx(TRANSACTION_PROVIDER_UPDATE_REVOKE, proTx));
+        }
+        for (int i = 0; i < SPENT_COLLATERALS_PER_BLOCK; i++) {
+            size_t idx = rng.randrange(vMNs.size());
+            CMutableTransaction tx;
+            tx.vin.emplace_back(vMNs[idx].second);
+            tx.vout.emplace_back(1000 * COIN, CScript() << OP_TRUE);
+            txs.emplace_back(MakeTransactionRef(std::move(tx)));
+            vMNs[idx] = vMNs.back();
+            vMNs.pop_back();
+        }
+
+        const auto& params = Params().GetConsensus().llmqs.at(Consensus::LLMQ_50_60);
+        int nHeight = START_HEIGHT + (int)vBlockHashes.size();
+        if (nHeight % params.dkgInterval == params.dkgMiningWindowStart) {
+            int quorumHeight = nHeight - params.dkgMiningWindowStart;
+            llmq::CFinalCommitmentTxPayload qc;
+            qc.nHeight = nHeight;
+            qc.commitment = llmq::CFinalCommitment(params, vBlockHashes.at(quorumHeight - START_HEIGHT));
+            std::fill(qc.commitment.signers.begin(), qc.commitment.signers.end(), true);
+            std::fill(qc.commitment.validMembers.begin(), qc.commitment.validMembers.end(), true);
+            for (int i = 0; i < FAILED_DKG_MEMBERS; i++) {
+                qc.commitment.validMembers[rng.randrange(params.size)] = false;
+            }
+            txs.emplace_back(CreateSpecialTx(TRANSACTION_QUORUM_COMMITMENT, qc));
+        }
+
+        return CreateBlock(txs);
+    }
+
+    // Blocks must be connected in the order they were created
+    void ConnectBlock(const CBlock& block)
+    {
+        const CBlockIndex* pindex = AddIndex(block);
+        LOCK(cs_main);
+        CValidationState state;
+        bool fValid = deterministicMNManager->ProcessBlock(block, pindex, state, view, false);
+        assert(fValid);
+        deterministicMNManager->UpdatedBlockTip(pindex);
+    }
+
+private:
+    CService NextAddr()
+    {
+        struct in_addr addr;
+        addr.s_addr = htonl(0x0a000000 + nextAddr++);
+        return CService(CNetAddr(addr), 9999);
+    }
+
+    template<typename ProTx>
+    CTransactionRef CreateSpecialTx(uint16_t nType, const ProTx& proTx)
+    {
+        CMutableTransaction tx;
+        tx.nVersion = 3;
+        tx.nType = nType;
+        SetTxPayload(tx, proTx);
+        return MakeTransactionRef(std::move(tx));
+    }
+
+    CTransactionRef CreateProRegTx()
+    {
+        CProRegTx proTx;
+        proTx.collateralOutpoint.n = 0;
+        proTx.addr = NextAddr();
+        proTx.keyIDOwner = CKeyID(uint160(rng.randbytes(20)));
+        proTx.pubKeyOperator = nextOperatorKey;
+        proTx.keyIDVoting = proTx.keyIDOwner;
+        proTx.scriptPayout = CScript() << OP_DUP << OP_HASH160 << ToByteVector(proTx.keyIDOwner) << OP_EQUALVERIFY << OP_CHECKSIG;
+        nextOperatorKey.AggregateInsecure(operatorKeyStep);
+
+        CMutableTransaction tx;
+        tx.nVersion = 3;
+        tx.nType = TRANSACTION_PROVIDER_REGISTER;
+        tx.vout.emplace_back(1000 * COIN, proTx.scriptPayout);
+        SetTxPayload(tx, proTx);
+        auto txRef = MakeTransactionRef(std::move(tx));
+        vMNs.emplace_back(txRef->GetHash(), COutPoint(txRef->GetHash(), 0));
+        return txRef;
+    }
+
+    CBlock CreateBlock(const std::vector<CTransactionRef>& txs)
+    {
+        int nHeight = START_HEIGHT + (int)vBlockHashes.size();
+        CBlock block;
+        block.nVersion = 4;
+        block.hashPrevBlock = vBlockHashes.empty() ? uint256() : vBlockHashes.back();
+        // before the start of the DIP0020 deployment, so that its version bits state is known without looking at blocks
+        // below the first one
+        block.nTime = 1600000000 + (nHeight - START_HEIGHT) * 150;
+
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+        coinbase.vout.emplace_back(0, CScript() << OP_TRUE);
+        block.vtx.emplace_back(MakeTransactionRef(std::move(coinbase)));
+        block.vtx.insert(block.vtx.end(), txs.begin(), txs.end());
+
+        vBlockHashes.emplace_back(block.GetHash());
+        return block;
+    }
+
+    const CBlockIndex* AddIndex(const CBlock& block)
+    {
+        assert(vBlockHashes.at(vIndexes.size()) == block.GetHash());
+        vIndexes.emplace_back();
+        auto& entry = vIndexes.back();
+        entry.hash = vBlockHashes[vIndexes.size() - 1];
+        entry.index.phashBlock = &entry.hash;
+        entry.index.nHeight = START_HEIGHT + (int)vIndexes.size() - 1;
+        entry.index.nTime = block.nTime;
+        entry.index.pprev = vIndexes.size() > 1 ? &vIndexes[vIndexes.size() - 2].index : nullptr;
+        entry.index.BuildSkip();
+        return &entry.index;
+    }
+};
+
+// Builds (but does not store) the list of a new block, as done for block templates and by CalcCbTxMerkleRootMNList
+static void DMN_BuildNewListFromBlock(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    CBlock block = chain.CreateChurnBlock();
+
+    while (state.KeepRunning()) {
+        LOCK(deterministicMNManager->cs);
+        CValidationState validationState;
+        CDeterministicMNList mnList;
+        bool fValid = deterministicMNManager->BuildNewListFromBlock(block, chain.Tip(), validationState, chain.view, mnList, false);
+        assert(fValid);
+    }
+}
+
+// Connects one block per iteration, which also writes its diff to the (in-memory) CEvoDB
+static void DMN_ProcessBlock(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    std::vector<CBlock> blocks;
+    for (uint64_t i = 0; i < state.m_num_iters * (state.m_num_warmup + state.m_num_evals); i++) {
+        blocks.emplace_back(chain.CreateChurnBlock());
+    }
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        chain.ConnectBlock(blocks.at(i++));
+    }
+}
+
+// The lists of older blocks are rebuilt from the closest snapshot and the diffs up to the block
+static void DMN_GetListForBlock(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    FastRandomContext rng(true);
+
+    while (state.KeepRunning()) {
+        const CBlockIndex* pindex = chain.Tip()->GetAncestor(chain.Tip()->nHeight - rng.randrange(CHURN_BLOCKS));
+        auto mnList = deterministicMNManager->GetListForBlock(pindex);
+        assert(mnList.GetHeight() == pindex->nHeight);
+    }
+}
+
+// The merkle root of the simplified list is updated incrementally from the one of the previous call
+static void DMN_CalcCbTxMerkleRootMNList(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    CBlock block = chain.CreateChurnBlock();
+
+    while (state.KeepRunning()) {
+        uint256 merkleRoot;
+        CValidationState validationState;
+        bool fValid = CalcCbTxMerkleRootMNList(block, chain.Tip(), merkleRoot, validationState, chain.view);
+        assert(fValid);
+    }
+}
+
+// What BuildSimplifiedMNListDiff does for the MN part of a MNLISTDIFF. The quorums part and the coinbase need the block
+// index and the blocks on disk and are not covered here
+static void DMN_BuildSimplifiedMNListDiff(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    const CBlockIndex* pindexBase = chain.Tip()->GetAncestor(chain.Tip()->nHeight - CHURN_BLOCKS / 2);
+
+    while (state.KeepRunning()) {
+        LOCK(deterministicMNManager->cs);
+        auto baseMNList = deterministicMNManager->GetListForBlock(pindexBase);
+        auto mnList = deterministicMNManager->GetListForBlock(chain.Tip());
+        auto mnListDiff = baseMNList.BuildSimplifiedDiff(mnList);
+        assert(!mnListDiff.mnList.empty());
+    }
+}
+
+// What GetAllQuorumMembers does when the members of the quorum are not cached yet (CLLMQUtils caches them per quorum)
+static void DMN_GetAllQuorumMembers(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    const auto& params = Params().GetConsensus().llmqs.at(Consensus::LLMQ_400_60);
+    const CBlockIndex* pindexQuorum = chain.GetIndex(START_HEIGHT + params.dkgInterval);
+    auto modifier = ::SerializeHash(std::make_pair(params.type, pindexQuorum->GetBlockHash()));
+
+    while (state.KeepRunning()) {
+        auto mnList = deterministicMNManager->GetListForBlock(pindexQuorum);
+        auto members = mnList.CalculateQuorum(params.size, modifier);
+        assert(members.size() == (size_t)params.size);
+    }
+}
+
+// Keeps the lists of all churn blocks alive, like the snapshot caches of CDeterministicMNManager do. The lists share
+// most of their (immer) nodes, run with -perfcounters to see the memory allocated for each set of snapshots
+static void DMN_ListSnapshots(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    int nFirstHeight = chain.Tip()->nHeight - CHURN_BLOCKS;
+    auto baseMNList = deterministicMNManager->GetListForBlock(chain.GetIndex(nFirstHeight));
+    std::vector<CDeterministicMNListDiff> diffs;
+    {
+        auto prevMNList = baseMNList;
+        for (int nHeight = nFirstHeight + 1; nHeight <= chain.Tip()->nHeight; nHeight++) {
+            auto mnList = deterministicMNManager->GetListForBlock(chain.GetIndex(nHeight));
+            diffs.emplace_back(prevMNList.BuildDiff(mnList));
+            prevMNList = mnList;
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::vector<CDeterministicMNList> snapshots;
+        snapshots.reserve(diffs.size());
+        const CDeterministicMNList* mnList = &baseMNList;
+        for (size_t i = 0; i < diffs.size(); i++) {
+            snapshots.emplace_back(mnList->ApplyDiff(chain.GetIndex(nFirstHeight + 1 + (int)i), diffs[i]));
+            mnList = &snapshots.back();
+        }
+    }
+}
+
+// Iterates over the valid MNs of the tip list, as done by the payment and quorum selection and by the GUI
+static void DMN_ForEachMN(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+
+    while (state.KeepRunning()) {
+        size_t nCount = 0;
+        mnList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
+            nCount += dmn->pdmnState->nPoSePenalty == 0;
+        });
+        assert(nCount <= mnCount);
+    }
+}
+
+// Same as DMN_ForEachMN, but through the struct-of-arrays view of the list
+static void DMN_ListViewIteration(benchmark::State& state, size_t mnCount)
+{
+    SyntheticMNChain chain(mnCount);
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+
+    while (state.KeepRunning()) {
+        auto view = mnList.GetView();
+        size_t nCount = 0;
+        for (size_t i = 0; i < view->size(); i++) {
+            nCount += view->IsValid(i) && view->IsConfirmed(i);
+        }
+        assert(nCount <= mnCount);
+    }
+}
+
+// Applies the updates of a block to a copy of a map with mnCount entries while the maps of the previous blocks stay
+// alive, to compare the memory policy of CDeterministicMNList with the default one of immer
+template <typename MemoryPolicy>
+static void DMN_ImmerMapUpdate(benchmark::State& state, size_t mnCount)
+{
+    typedef immer::map<uint256, CDeterministicMNCPtr, std::hash<uint256>, std::equal_to<uint256>, MemoryPolicy> Map;
+    FastRandomContext rng(true);
+    std::vector<uint256> keys;
+    Map map;
+    auto dmn = std::make_shared<CDeterministicMN>(0);
+    for (size_t i = 0; i < mnCount; i++) {
+        keys.emplace_back(rng.rand256());
+        map = map.set(keys.back(), dmn);
+    }
+
+    std::deque<Map> prevMaps;
+    while (state.KeepRunning()) {
+        Map newMap = map;
+        for (int i = 0; i < SERVICE_UPDATES_PER_BLOCK + NEW_MNS_PER_BLOCK; i++) {
+            newMap = newMap.set(keys[rng.randrange(keys.size())], dmn);
+        }
+        prevMaps.emplace_back(map);
+        if (prevMaps.size() > (size_t)CHURN_BLOCKS) {
+            prevMaps.pop_front();
+        }
+        map = std::move(newMap);
+    }
+}
+
+static void DMN_BuildNewListFromBlock_10k(benchmark::State& state) { DMN_BuildNewListFromBlock(state, 10000); }
+static void DMN_BuildNewListFromBlock_50k(benchmark::State& state) { DMN_BuildNewListFromBlock(state, 50000); }
+static void DMN_ProcessBlock_10k(benchmark::State& state) { DMN_ProcessBlock(state, 10000); }
+static void DMN_ProcessBlock_50k(benchmark::State& state) { DMN_ProcessBlock(state, 50000); }
+static void DMN_GetListForBlock_10k(benchmark::State& state) { DMN_GetListForBlock(state, 10000); }
+static void DMN_GetListForBlock_50k(benchmark::State& state) { DMN_GetListForBlock(state, 50000); }
+static void DMN_CalcCbTxMerkleRootMNList_10k(benchmark::State& state) { DMN_CalcCbTxMerkleRootMNList(state, 10000); }
+static void DMN_CalcCbTxMerkleRootMNList_50k(benchmark::State& state) { DMN_CalcCbTxMerkleRootMNList(state, 50000); }
+static void DMN_BuildSimplifiedMNListDiff_10k(benchmark::State& state) { DMN_BuildSimplifiedMNListDiff(state, 10000); }
+static void DMN_BuildSimplifiedMNListDiff_50k(benchmark::State& state) { DMN_BuildSimplifiedMNListDiff(state, 50000); }
+static void DMN_GetAllQuorumMembers_5k(benchmark::State& state) { DMN_GetAllQuorumMembers(state, 5000); }
+static void DMN_GetAllQuorumMembers_10k(benchmark::State& state) { DMN_GetAllQuorumMembers(state, 10000); }
+static void DMN_GetAllQuorumMembers_20k(benchmark::State& state) { DMN_GetAllQuorumMembers(state, 20000); }
+static void DMN_GetAllQuorumMembers_50k(benchmark::State& state) { DMN_GetAllQuorumMembers(state, 50000); }
+static void DMN_ListSnapshots_10k(benchmark::State& state) { DMN_ListSnapshots(state, 10000); }
+static void DMN_ListSnapshots_50k(benchmark::State& state) { DMN_ListSnapshots(state, 50000); }
+static void DMN_ForEachMN_10k(benchmark::State& state) { DMN_ForEachMN(state, 10000); }
+static void DMN_ForEachMN_50k(benchmark::State& state) { DMN_ForEachMN(state, 50000); }
+static void DMN_ListViewIteration_10k(benchmark::State& state) { DMN_ListViewIteration(state, 10000); }
+static void DMN_ListViewIteration_50k(benchmark::State& state) { DMN_ListViewIteration(state, 50000); }
+static void DMN_ImmerMapUpdate_10k(benchmark::State& state) { DMN_ImmerMapUpdate<CDeterministicMNListMemoryPolicy>(state, 10000); }
+static void DMN_ImmerMapUpdate_10k_DefaultPolicy(benchmark::State& state) { DMN_ImmerMapUpdate<immer::default_memory_policy>(state, 10000); }
+
+BENCHMARK(DMN_BuildNewListFromBlock_10k, 200);
+BENCHMARK(DMN_BuildNewListFromBlock_50k, 40);
+BENCHMARK(DMN_ProcessBlock_10k, 100);
+BENCHMARK(DMN_ProcessBlock_50k, 20);
+BENCHMARK(DMN_GetListForBlock_10k, 1000);
+BENCHMARK(DMN_GetListForBlock_50k, 1000);
+BENCHMARK(DMN_CalcCbTxMerkleRootMNList_10k, 100);
+BENCHMARK(DMN_CalcCbTxMerkleRootMNList_50k, 20);
+BENCHMARK(DMN_BuildSimplifiedMNListDiff_10k, 50);
+BENCHMARK(DMN_BuildSimplifiedMNListDiff_50k, 10);
+BENCHMARK(DMN_GetAllQuorumMembers_5k, 40);
+BENCHMARK(DMN_GetAllQuorumMembers_10k, 20);
+BENCHMARK(DMN_GetAllQuorumMembers_20k, 10);
+BENCHMARK(DMN_GetAllQuorumMembers_50k, 5);
+BENCHMARK(DMN_ListSnapshots_10k, 20);
+BENCHMARK(DMN_ListSnapshots_50k, 20);
+BENCHMARK(DMN_ForEachMN_10k, 200);
+BENCHMARK(DMN_ForEachMN_50k, 50);
+BENCHMARK(DMN_ListViewIteration_10k, 200);
+BENCHMARK(DMN_ListViewIteration_50k, 50);
+BENCHMARK(DMN_ImmerMapUpdate_10k, 5000);
+BENCHMARK(DMN_ImmerMapUpdate_10k_DefaultPolicy, 5000);
@@ -0,0 +1,409 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <consensus/validation.h>
+#include <evo/deterministicmns.h>
+#include <evo/evodb.h>
+#include <evo/providertx.h>
+#include <evo/specialtx.h>
+#include <flat-database.h>
+#include <governance/governance.h>
+#include <governance/governance-db.h>
+#include <governance/governance-vote.h>
+#include <governance/governance-votedb.h>
+#include <key.h>
+#include <key_io.h>
+#include <masternode/masternode-sync.h>
+#include <net.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <scheduler.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+// Roughly a superblock cycle on mainnet: every masternode votes on every proposal, which gives about 100k votes
+static const int MN_COUNT = 3000;
+static const int PROPOSAL_COUNT = 34;
+
+// DIP3 is active at this height on mainnet
+static const int REGISTRATION_HEIGHT = 1399681;
+
+// Share of the votes of an object a syncing peer already has in Governance_SyncSingleObjVotesSketch
+static const int SKETCH_KNOWN_PERCENT = 95;
+
+/**
+ * The MNs, proposals and signed votes used by all benchmarks. Signing 100k votes takes a while, so they are only
+ * created once per process.
+ */
+struct GovernanceData
+{
+    // registers all MNs, on top of a block with the hash hashPrevBlock
+    CBlock registrationBlock;
+    std::vector<CGovernanceObject> proposals;
+    // votes of all MNs, by proposal
+    std::vector<std::vector<CGovernanceVote>> votes;
+};
+
+static const GovernanceData& GetGovernanceData()
+{
+    static std::unique_ptr<GovernanceData> data;
+    if (data) {
+        return *data;
+    }
+
+    SelectParams(CBaseChainParams::MAIN);
+    data.reset(new GovernanceData());
+    FastRandomContext rng(true);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << REGISTRATION_HEIGHT << OP_0;
+    coinbase.vout.emplace_back(0, CScript() << OP_TRUE);
+    data->registrationBlock.nVersion = 4;
+    data->registrationBlock.hashPrevBlock = rng.rand256();
+    data->registrationBlock.nTime = 1600000000;
+    data->registrationBlock.vtx.emplace_back(MakeTransactionRef(std::move(coinbase)));
+
+    // consecutive operator keys differ by a fixed key, which is much cheaper than creating new keys
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+    CBLSPublicKey operatorKey = sk.GetPublicKey();
+    sk.MakeNewKey();
+    CBLSPublicKey operatorKeyStep = sk.GetPublicKey();
+
+    struct MN {
+        COutPoint collateralOutpoint;
+        CKey votingKey;
+        CKeyID votingKeyID;
+    };
+    std::vector<MN> vMNs;
+    for (int i = 0; i < MN_COUNT; i++) {
+        CKey votingKey;
+        votingKey.MakeNewKey(true);
+
+        struct in_addr addr;
+        addr.s_addr = htonl(0x0a000000 + i);
+
+        // unsigned, as BuildNewListFromBlock does not verify ProRegTxs
+        CProRegTx proTx;
+        proTx.collateralOutpoint.n = 0;
+        proTx.addr = CService(CNetAddr(addr), 9999);
+        proTx.keyIDOwner = CKeyID(uint160(rng.randbytes(20)));
+        proTx.pubKeyOperator = operatorKey;
+        proTx.keyIDVoting = votingKey.GetPubKey().GetID();
+        proTx.scriptPayout = CScript() << OP_DUP << OP_HASH160 << ToByteVector(proTx.keyIDOwner) << OP_EQUALVERIFY << OP_CHECKSIG;
+        operatorKey.AggregateInsecure(operatorKeyStep);
+
+        CMutableTransaction tx;
+        tx.nVersion = 3;
+        tx.nType = TRANSACTION_PROVIDER_REGISTER;
+        tx.vout.emplace_back(1000 * COIN, proTx.scriptPayout);
+        SetTxPayload(tx, proTx);
+        auto txRef = MakeTransactionRef(std::move(tx));
+        vMNs.push_back({COutPoint(txRef->GetHash(), 0), votingKey, proTx.keyIDVoting});
+        data->registrationBlock.vtx.emplace_back(txRef);
+    }
+
+    int64_t nNow = GetAdjustedTime();
+    data->proposals.reserve(PROPOSAL_COUNT);
+    data->votes.resize(PROPOSAL_COUNT);
+    for (int i = 0; i < PROPOSAL_COUNT; i++) {
+        UniValue proposal(UniValue::VOBJ);
+        proposal.pushKV("type", GOVERNANCE_OBJECT_PROPOSAL);
+        proposal.pushKV("name", strprintf("proposal-%d", i));
+        proposal.pushKV("start_epoch", nNow - 7 * 24 * 60 * 60);
+        proposal.pushKV("end_epoch", nNow + 30 * 24 * 60 * 60);
+        proposal.pushKV("payment_amount", 100);
+        proposal.pushKV("payment_address", EncodeDestination(CKeyID(uint160(rng.randbytes(20)))));
+        proposal.pushKV("url", strprintf("https://www.dashcentral.org/p/proposal-%d", i));
+        data->proposals.emplace_back(uint256(), 1, nNow - 7 * 24 * 60 * 60, rng.rand256(), HexStr(proposal.write()));
+
+        const uint256 nHash = data->proposals.back().GetHash();
+        for (const auto& mn : vMNs) {
+            // mostly yes votes, so that no proposal gets deleted by its votes
+            uint64_t nRand = rng.randrange(10);
+            vote_outcome_enum_t eOutcome = nRand < 6 ? VOTE_OUTCOME_YES : nRand < 9 ? VOTE_OUTCOME_NO : VOTE_OUTCOME_ABSTAIN;
+            CGovernanceVote vote(mn.collateralOutpoint, nHash, VOTE_SIGNAL_FUNDING, eOutcome);
+            vote.SetTime(nNow - 2 * 60 * 60 + rng.randrange(60 * 60));
+            bool fSigned = vote.Sign(mn.votingKey, mn.votingKeyID);
+            assert(fSigned);
+            data->votes[i].emplace_back(vote);
+        }
+    }
+
+    return *data;
+}
+
+/**
+ * Installs a CDeterministicMNManager (on top of an in-memory CEvoDB) with all MNs of GetGovernanceData() registered
+ * at the chain tip and marks the node as synced, so that the governance manager accepts, cleans and syncs objects and
+ * votes. The global governance manager is used, as the governance objects refer to it.
+ */
+class GovernanceSetup
+{
+private:
+    CScheduler scheduler;
+    CEvoDB evoDb{1 << 20, true, true};
+    CCoinsView coinsDummy;
+    uint256 hashes[2];
+    CBlockIndex indexes[2];
+
+public:
+    const GovernanceData& data;
+    CConnman connman{0x1337, 0x1337};
+
+    GovernanceSetup() : data(GetGovernanceData())
+    {
+        // ProcessBlock signals list changes, ProcessVote signals new votes
+        GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+        deterministicMNManager.reset(new CDeterministicMNManager(evoDb));
+
+        // the block below the registration block, for which the list is empty
+        hashes[0] = data.registrationBlock.hashPrevBlock;
+        hashes[1] = data.registrationBlock.GetHash();
+        for (int i = 0; i < 2; i++) {
+            indexes[i].phashBlock = &hashes[i];
+            indexes[i].nHeight = REGISTRATION_HEIGHT - 1 + i;
+            indexes[i].nTime = data.registrationBlock.nTime - 150 + i * 150;
+            indexes[i].pprev = i > 0 ? &indexes[i - 1] : nullptr;
+            indexes[i].BuildSkip();
+        }
+        {
+            LOCK(cs_main);
+            CCoinsViewCache view(&coinsDummy);
+            CValidationState state;
+            bool fValid = deterministicMNManager->ProcessBlock(data.registrationBlock, &indexes[1], state, view, false);
+            assert(fValid);
+            deterministicMNManager->UpdatedBlockTip(&indexes[1]);
+        }
+        assert(deterministicMNManager->GetListAtChainTip().GetAllMNsCount() == (size_t)MN_COUNT);
+
+        masternodeSync.Reset(true, false);
+        masternodeSync.SwitchToNextAsset(connman);
+        masternodeSync.SwitchToNextAsset(connman);
+        assert(masternodeSync.IsSynced());
+    }
+
+    ~GovernanceSetup()
+    {
+        governance.CloseCache();
+        governance.Clear();
+        fs::remove(GetDataDir() / "governance.dat");
+        masternodeSync.Reset(true, false);
+        deterministicMNManager.reset();
+        GetMainSignals().UnregisterBackgroundSignalScheduler();
+    }
+
+    /** Writes all proposals (and their votes) to the governance db and loads them, as on startup */
+    void LoadObjects(bool fWithVotes)
+    {
+        governance.CloseCache();
+        governance.Clear();
+        {
+            CGovernanceDb db(1 << 20, false, true);
+            CDBBatch batch(db);
+            for (int i = 0; i < PROPOSAL_COUNT; i++) {
+                db.WriteObject(batch, data.proposals[i]);
+                if (fWithVotes) {
+                    for (const auto& vote : data.votes[i]) {
+                        db.WriteVote(batch, vote);
+                    }
+                }
+            }
+            db.WriteState(batch, CGovernanceManager::StateWithoutObjects(governance));
+            db.WriteVersion(batch);
+            db.WriteBatch(batch);
+        }
+        bool fLoaded = governance.LoadCache(false);
+        assert(fLoaded);
+        governance.InitOnLoad();
+        assert(governance.GetVoteCount() == (fWithVotes ? MN_COUNT * PROPOSAL_COUNT : 0));
+    }
+};
+
+static void Governance_VoteFileAddVote(benchmark::State& state)
+{
+    const GovernanceData& data = GetGovernanceData();
+
+    while (state.KeepRunning()) {
+        for (const auto& votes : data.votes) {
+            CGovernanceObjectVoteFile fileVotes;
+            for (const auto& vote : votes) {
+                fileVotes.AddVote(vote);
+            }
+            assert(fileVotes.GetVoteCount() == MN_COUNT);
+        }
+    }
+}
+
+// All votes of a superblock cycle arriving at a node which has all proposals. Every vote is checked, including its
+// signature, indexed and written to the governance db.
+static void Governance_ProcessVote(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(false);
+
+    CDataStream ssWithoutVotes(SER_DISK, CLIENT_VERSION);
+    ssWithoutVotes << governance;
+
+    while (state.KeepRunning()) {
+        // forget the votes of the previous iteration
+        CDataStream ss(ssWithoutVotes);
+        ss >> governance;
+        governance.InitOnLoad();
+
+        for (const auto& votes : setup.data.votes) {
+            for (const auto& vote : votes) {
+                CGovernanceException exception;
+                bool fAccepted = governance.ProcessVoteAndRelay(vote, exception, setup.connman);
+                assert(fAccepted);
+            }
+        }
+    }
+}
+
+// Rebuilding the vote index and queueing all objects for the next UpdateCachesAndClean, as done after loading
+static void Governance_InitOnLoad(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+
+    while (state.KeepRunning()) {
+        governance.InitOnLoad();
+    }
+}
+
+// UpdateCachesAndClean only looks at objects which changed, InitOnLoad makes it check all of them (as after loading)
+static void Governance_UpdateCachesAndClean(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+
+    while (state.KeepRunning()) {
+        governance.InitOnLoad();
+        governance.UpdateCachesAndClean();
+    }
+    assert(governance.GetVoteCount() == MN_COUNT * PROPOSAL_COUNT);
+}
+
+static void Governance_LoadCache(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+
+    while (state.KeepRunning()) {
+        governance.CloseCache();
+        bool fLoaded = governance.LoadCache(false);
+        assert(fLoaded);
+    }
+}
+
+// Wiping the db on load makes FlushCache write all objects and votes again, as for -resetgovernance and the migration
+// from governance.dat
+static void Governance_FlushCacheAll(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+
+    while (state.KeepRunning()) {
+        governance.CloseCache();
+        bool fLoaded = governance.LoadCache(true);
+        assert(fLoaded);
+    }
+}
+
+// governance.dat is only read to migrate it into the governance db, but CFlatDB is still used for the other caches
+static void Governance_FlatDBDump(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+    CFlatDB<CGovernanceManager> flatdb("governance.dat", "magicGovernanceCache");
+
+    while (state.KeepRunning()) {
+        bool fDumped = flatdb.Dump(governance);
+        assert(fDumped);
+    }
+}
+
+static void Governance_FlatDBLoad(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+    CFlatDB<CGovernanceManager> flatdb("governance.dat", "magicGovernanceCache");
+    bool fDumped = flatdb.Dump(governance);
+    assert(fDumped);
+
+    while (state.KeepRunning()) {
+        bool fLoaded = flatdb.Load(governance);
+        assert(fLoaded);
+    }
+    assert(governance.HaveObjectForHash(setup.data.proposals[0].GetHash()));
+}
+
+// A peer without any votes asks for the votes of a single proposal, with an empty filter
+static void Governance_SyncSingleObjVotes(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+
+    CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+    node.SetSendVersion(PROTOCOL_VERSION);
+
+    CBloomFilter filter;
+    filter.clear();
+    const uint256 nProp = setup.data.proposals[0].GetHash();
+
+    while (state.KeepRunning()) {
+        governance.SyncSingleObjVotes(&node, nProp, filter, setup.connman);
+
+        LOCK(node.cs_inventory);
+        assert(node.vInventoryOtherToSend.size() == (size_t)MN_COUNT);
+        node.vInventoryOtherToSend.clear();
+    }
+}
+
+// A peer which misses some of the votes of a single proposal asks for them with a sketch of the votes it has
+static void Governance_SyncSingleObjVotesSketch(benchmark::State& state)
+{
+    GovernanceSetup setup;
+    setup.LoadObjects(true);
+
+    CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+    node.SetSendVersion(PROTOCOL_VERSION);
+
+    // sized like the sketches of RequestGovernanceObject
+    const auto& votes = setup.data.votes[0];
+    size_t nKnown = votes.size() * SKETCH_KNOWN_PERCENT / 100;
+    CGovernanceVoteSketch sketch(std::max<size_t>(64, nKnown / 8), GetRand(std::numeric_limits<uint64_t>::max()));
+    for (size_t i = 0; i < nKnown; i++) {
+        sketch.Insert(votes[i].GetHash());
+    }
+    const uint256 nProp = setup.data.proposals[0].GetHash();
+
+    while (state.KeepRunning()) {
+        governance.SyncSingleObjVotes(&node, nProp, sketch, setup.connman);
+
+        LOCK(node.cs_inventory);
+        assert(node.vInventoryOtherToSend.size() == votes.size() - nKnown);
+        node.vInventoryOtherToSend.clear();
+    }
+}
+
+BENCHMARK(Governance_VoteFileAddVote, 1);
+BENCHMARK(Governance_ProcessVote, 1);
+BENCHMARK(Governance_InitOnLoad, 1);
+BENCHMARK(Governance_UpdateCachesAndClean, 1);
+BENCHMARK(Governance_LoadCache, 1);
+BENCHMARK(Governance_FlushCacheAll, 1);
+BENCHMARK(Governance_FlatDBDump, 1);
+BENCHMARK(Governance_FlatDBLoad, 1);
+BENCHMARK(Governance_SyncSingleObjVotes, 1);
+BENCHMARK(Governance_SyncSingleObjVotesSketch, 1);
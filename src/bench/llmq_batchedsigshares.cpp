@@ -0,0 +1,84 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_utils.h>
+#include <random.h>
+#include <streams.h>
+#include <version.h>
+
+// Simulates a full QBSIGSHARES message (MAX_MSGS_TOTAL_BATCHED_SIGS shares), spread over a few sessions
+static const size_t BATCH_COUNT = 8;
+static const uint16_t SHARES_PER_BATCH = 50;
+
+static std::vector<unsigned char> BuildMessage()
+{
+    std::vector<llmq::CBatchedSigShares> msgs(BATCH_COUNT);
+    for (size_t i = 0; i < msgs.size(); i++) {
+        msgs[i].sessionId = (uint32_t)i;
+        for (uint16_t j = 0; j < SHARES_PER_BATCH; j++) {
+            msgs[i].sigShares.emplace_back(j, CBLSLazySignature());
+        }
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << msgs;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+// What ProcessMessageBatchedSigShares did before CBatchedSigSharesView: fully deserialize all batches, then copy each
+// share into a CSigShare and re-hash its key
+static void BatchedSigShares_Deserialize(benchmark::State& state)
+{
+    auto buf = BuildMessage();
+    auto quorumHash = GetRandHash();
+    auto id = GetRandHash();
+    auto msgHash = GetRandHash();
+
+    while (state.KeepRunning()) {
+        std::vector<llmq::CBatchedSigShares> msgs;
+        SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(buf.data(), buf.size())) >> msgs;
+        for (const auto& bs : msgs) {
+            for (const auto& p : bs.sigShares) {
+                llmq::CSigShare sigShare;
+                sigShare.llmqType = Consensus::LLMQ_400_60;
+                sigShare.quorumHash = quorumHash;
+                sigShare.quorumMember = p.first;
+                sigShare.id = id;
+                sigShare.msgHash = msgHash;
+                sigShare.sigShare = p.second;
+                sigShare.UpdateKey();
+            }
+        }
+    }
+}
+
+static void BatchedSigShares_View(benchmark::State& state)
+{
+    auto buf = BuildMessage();
+    auto quorumHash = GetRandHash();
+    auto id = GetRandHash();
+    auto msgHash = GetRandHash();
+    auto signHash = llmq::CLLMQUtils::BuildSignHash(Consensus::LLMQ_400_60, quorumHash, id, msgHash);
+
+    while (state.KeepRunning()) {
+        std::vector<llmq::CBatchedSigSharesView> msgs;
+        SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(buf.data(), buf.size())) >> msgs;
+        for (const auto& bs : msgs) {
+            for (size_t i = 0; i < bs.size(); i++) {
+                llmq::CSigShare sigShare;
+                sigShare.llmqType = Consensus::LLMQ_400_60;
+                sigShare.quorumHash = quorumHash;
+                sigShare.quorumMember = bs.GetQuorumMember(i);
+                sigShare.id = id;
+                sigShare.msgHash = msgHash;
+                bs.GetSigShare(i, sigShare.sigShare);
+                sigShare.key = llmq::SigShareKey(signHash, sigShare.quorumMember);
+            }
+        }
+    }
+}
+
+BENCHMARK(BatchedSigShares_Deserialize, 300)
+BENCHMARK(BatchedSigShares_View, 300)
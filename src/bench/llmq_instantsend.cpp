@@ -0,0 +1,260 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bls/bls_batchverifier.h>
+#include <bls/bls_worker.h>
+#include <chainparams.h>
+#include <evo/deterministicmns.h>
+#include <llmq/quorums.h>
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_utils.h>
+#include <masternode/activemasternode.h>
+#include <random.h>
+#include <streams.h>
+#include <version.h>
+
+extern CBLSWorker blsWorker;
+
+using namespace llmq;
+
+// Must match INPUTLOCK_REQUESTID_PREFIX in quorums_instantsend.cpp
+static const std::string INPUTLOCK_REQUESTID_PREFIX = "inlock";
+
+/**
+ * An InstantSend quorum with all of its members simulated in this process. Every member has its own CQuorum object
+ * holding its secret key share, while "quorum" is the quorum as seen by a node which is not a member. That node
+ * receives the sig shares, recovers the signatures and verifies the resulting ISLOCKs.
+ */
+struct SimulatedQuorum
+{
+    const Consensus::LLMQParams& params;
+    std::vector<CDeterministicMNCPtr> members;
+    std::vector<CQuorumCPtr> memberQuorums;
+    CQuorumCPtr quorum;
+
+    explicit SimulatedQuorum(const Consensus::LLMQParams& _params) : params(_params)
+    {
+        BLSIdVector ids;
+        for (int i = 0; i < params.size; i++) {
+            auto dmn = std::make_shared<CDeterministicMN>(i);
+            dmn->proTxHash = GetRandHash();
+            ids.emplace_back(dmn->proTxHash);
+            members.emplace_back(dmn);
+        }
+
+        // a DKG in which all members behaved
+        std::vector<BLSVerificationVectorPtr> vvecs(params.size);
+        std::vector<BLSSecretKeyVector> skContributions(params.size);
+        for (int i = 0; i < params.size; i++) {
+            blsWorker.GenerateContributions(params.threshold, ids, vvecs[i], skContributions[i]);
+        }
+        auto quorumVvec = blsWorker.BuildQuorumVerificationVector(vvecs);
+
+        CFinalCommitment qc(params, GetRandHash());
+        std::fill(qc.signers.begin(), qc.signers.end(), true);
+        std::fill(qc.validMembers.begin(), qc.validMembers.end(), true);
+        qc.quorumPublicKey = (*quorumVvec)[0];
+        qc.quorumVvecHash = ::SerializeHash(*quorumVvec);
+
+        quorum = MakeQuorum(qc, *quorumVvec, CBLSSecretKey());
+        for (int i = 0; i < params.size; i++) {
+            BLSSecretKeyVector skShares;
+            for (int j = 0; j < params.size; j++) {
+                skShares.emplace_back(skContributions[j][i]);
+            }
+            activeMasternodeInfo.proTxHash = members[i]->proTxHash;
+            memberQuorums.emplace_back(MakeQuorum(qc, *quorumVvec, blsWorker.AggregateSecretKeys(skShares)));
+        }
+        activeMasternodeInfo.proTxHash = uint256();
+    }
+
+private:
+    CQuorumCPtr MakeQuorum(const CFinalCommitment& qc, const BLSVerificationVector& quorumVvec, const CBLSSecretKey& skShare)
+    {
+        auto q = std::make_shared<CQuorum>(params, blsWorker);
+        q->Init(qc, nullptr, uint256(), members);
+        bool fValid = q->SetVerificationVector(quorumVvec);
+        if (skShare.IsValid()) {
+            // checks the share against the quorum member given by activeMasternodeInfo
+            fValid &= q->SetSecretKeyShare(skShare);
+        }
+        assert(fValid);
+        return q;
+    }
+};
+
+// A signing session as started by CInstantSendManager, for an input lock or an ISLOCK
+struct SigningRequest
+{
+    uint256 id;
+    uint256 msgHash;
+};
+
+/**
+ * Signs all requests by all members and recovers the signatures on the receiving node. Every member sends its sig
+ * shares in a single QBSIGSHARES message with one batch per session, the fake connection between them and the
+ * receiving node is the serialization of that message. The receiving node parses the messages with
+ * CBatchedSigSharesView, verifies the shares of every member in its own batch on the BLS workers (see
+ * CSigSharesManager::ProcessPendingSigShares) and recovers every signature from the first threshold shares (see
+ * CSigSharesManager::TryRecoverSig).
+ */
+static std::vector<CRecoveredSig> SignAndRecover(const SimulatedQuorum& sq, CSigSharesManager& sigSharesManager, const std::vector<SigningRequest>& requests)
+{
+    std::vector<std::vector<unsigned char>> messages;
+    for (size_t i = 0; i < sq.members.size(); i++) {
+        activeMasternodeInfo.proTxHash = sq.members[i]->proTxHash;
+        std::vector<CBatchedSigShares> batches(requests.size());
+        for (size_t j = 0; j < requests.size(); j++) {
+            CSigShare sigShare = sigSharesManager.CreateSigShare(sq.memberQuorums[i], requests[j].id, requests[j].msgHash);
+            assert(sigShare.sigShare.Get().IsValid());
+            batches[j].sessionId = (uint32_t)j;
+            batches[j].sigShares.emplace_back(sigShare.quorumMember, sigShare.sigShare);
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << batches;
+        messages.emplace_back(ss.begin(), ss.end());
+    }
+    activeMasternodeInfo.proTxHash = uint256();
+
+    std::vector<CSigShare> pendingSigShares;
+    pendingSigShares.reserve(sq.members.size() * requests.size());
+    for (const auto& msg : messages) {
+        std::vector<CBatchedSigSharesView> batches;
+        SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(msg.data(), msg.size())) >> batches;
+        for (const auto& batch : batches) {
+            const auto& request = requests.at(batch.sessionId);
+            for (size_t i = 0; i < batch.size(); i++) {
+                CSigShare sigShare;
+                sigShare.llmqType = sq.params.type;
+                sigShare.quorumHash = sq.quorum->qc.quorumHash;
+                sigShare.quorumMember = batch.GetQuorumMember(i);
+                sigShare.id = request.id;
+                sigShare.msgHash = request.msgHash;
+                batch.GetSigShare(i, sigShare.sigShare);
+                pendingSigShares.emplace_back(std::move(sigShare));
+            }
+        }
+    }
+    CSigShare::UpdateKeys(pendingSigShares);
+
+    // the member index doubles as the NodeId of the member's connection
+    CBLSParallelBatchVerifier<NodeId, SigShareKey, NodeId> batchVerifier(blsWorker, false, true, requests.size());
+    for (const auto& sigShare : pendingSigShares) {
+        NodeId nodeId = sigShare.quorumMember;
+        batchVerifier.PushMessage(nodeId, nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), sq.quorum->GetPubKeyShare(sigShare.quorumMember));
+    }
+    batchVerifier.Verify();
+    assert(batchVerifier.badSources.empty());
+
+    SigShareMap<CSigShare> sigShares;
+    for (const auto& sigShare : pendingSigShares) {
+        sigShares.Add(sigShare.GetKey(), sigShare);
+    }
+
+    std::vector<CRecoveredSig> recoveredSigs;
+    recoveredSigs.reserve(requests.size());
+    for (const auto& request : requests) {
+        auto signHash = CLLMQUtils::BuildSignHash(sq.params.type, sq.quorum->qc.quorumHash, request.id, request.msgHash);
+        auto sessionSigShares = sigShares.GetAllForSignHash(signHash);
+        assert(sessionSigShares && sessionSigShares->size() >= (size_t)sq.params.threshold);
+
+        std::vector<CBLSSignature> sigSharesForRecovery;
+        std::vector<CBLSId> idsForRecovery;
+        for (auto it = sessionSigShares->begin(); it != sessionSigShares->end() && sigSharesForRecovery.size() < (size_t)sq.params.threshold; ++it) {
+            sigSharesForRecovery.emplace_back(it->second.sigShare.Get());
+            idsForRecovery.emplace_back(sq.members[it->second.quorumMember]->proTxHash);
+        }
+        CBLSSignature sig;
+        bool fRecovered = sig.Recover(sigSharesForRecovery, idsForRecovery);
+        assert(fRecovered);
+
+        CRecoveredSig recSig;
+        recSig.llmqType = sq.params.type;
+        recSig.quorumHash = sq.quorum->qc.quorumHash;
+        recSig.id = request.id;
+        recSig.msgHash = request.msgHash;
+        recSig.sig.Set(sig);
+        recSig.UpdateHash();
+        recoveredSigs.emplace_back(std::move(recSig));
+    }
+    return recoveredSigs;
+}
+
+/**
+ * Locks txCount transactions with inputCount inputs each: all inputs are locked first (one signing session per input),
+ * then the ISLOCKs are signed. The ISLOCKs are then relayed to another node and verified there in batches, as in
+ * CInstantSendManager::ProcessPendingInstantSendLocks.
+ */
+static void LockTransactions(const SimulatedQuorum& sq, CSigSharesManager& sigSharesManager, FastRandomContext& rng, size_t txCount, size_t inputCount)
+{
+    std::vector<CInstantSendLock> islocks(txCount);
+    std::vector<SigningRequest> inputRequests;
+    for (auto& islock : islocks) {
+        islock.txid = rng.rand256();
+        for (size_t i = 0; i < inputCount; i++) {
+            islock.inputs.emplace_back(rng.rand256(), 0);
+            inputRequests.push_back({::SerializeHash(std::make_pair(INPUTLOCK_REQUESTID_PREFIX, islock.inputs.back())), islock.txid});
+        }
+    }
+    SignAndRecover(sq, sigSharesManager, inputRequests);
+
+    std::vector<SigningRequest> islockRequests;
+    for (const auto& islock : islocks) {
+        islockRequests.push_back({islock.GetRequestId(), islock.txid});
+    }
+    auto islockSigs = SignAndRecover(sq, sigSharesManager, islockRequests);
+    for (size_t i = 0; i < islocks.size(); i++) {
+        islocks[i].sig = islockSigs[i].sig;
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << islocks;
+    std::vector<CInstantSendLock> receivedISLocks;
+    ss >> receivedISLocks;
+
+    CBLSParallelBatchVerifier<NodeId, uint256, uint256> batchVerifier(blsWorker, false, true, 8);
+    for (const auto& islock : receivedISLocks) {
+        uint256 signHash = CLLMQUtils::BuildSignHash(sq.params.type, sq.quorum->qc.quorumHash, islock.GetRequestId(), islock.txid);
+        batchVerifier.PushMessage(sq.quorum->qc.quorumHash, 0, ::SerializeHash(islock), signHash, islock.sig.Get(), sq.quorum->qc.quorumPublicKey);
+    }
+    batchVerifier.Verify();
+    assert(batchVerifier.badMessages.empty());
+}
+
+// Every iteration locks txCount transactions, so the per iteration figures are the latency of a single ISLOCK (for a
+// txCount of 1) or the time to process a burst of txCount transactions
+static void LLMQ_InstantSend(benchmark::State& state, size_t txCount, size_t inputCount)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const auto& params = Params().GetConsensus().llmqs.at(Params().GetConsensus().llmqTypeInstantSend);
+
+    SimulatedQuorum sq(params);
+    CSigSharesManager sigSharesManager(blsWorker);
+    FastRandomContext rng(true);
+
+    while (state.KeepRunning()) {
+        LockTransactions(sq, sigSharesManager, rng, txCount, inputCount);
+    }
+}
+
+static void LLMQ_InstantSend_1Tx_1Input(benchmark::State& state)
+{
+    LLMQ_InstantSend(state, 1, 1);
+}
+
+static void LLMQ_InstantSend_1Tx_4Inputs(benchmark::State& state)
+{
+    LLMQ_InstantSend(state, 1, 4);
+}
+
+static void LLMQ_InstantSend_32Tx_2Inputs(benchmark::State& state)
+{
+    LLMQ_InstantSend(state, 32, 2);
+}
+
+BENCHMARK(LLMQ_InstantSend_1Tx_1Input, 5)
+BENCHMARK(LLMQ_InstantSend_1Tx_4Inputs, 2)
+BENCHMARK(LLMQ_InstantSend_32Tx_2Inputs, 1)
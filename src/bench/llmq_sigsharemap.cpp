@@ -0,0 +1,105 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <llmq/quorums_signing_shares.h>
+#include <random.h>
+
+// Number of members of the largest LLMQ type
+static const uint16_t QUORUM_SIZE = 400;
+
+static std::vector<uint256> BuildSignHashes(size_t sessionCount)
+{
+    std::vector<uint256> signHashes(sessionCount);
+    for (auto& signHash : signHashes) {
+        signHash = GetRandHash();
+    }
+    return signHashes;
+}
+
+static void FillMap(llmq::SigShareMap<int64_t>& m, const std::vector<uint256>& signHashes)
+{
+    for (const auto& signHash : signHashes) {
+        for (uint16_t i = 0; i < QUORUM_SIZE; i++) {
+            m.Add(std::make_pair(signHash, i), i);
+        }
+    }
+}
+
+static void SigShareMap_Insert(benchmark::State& state)
+{
+    auto signHashes = BuildSignHashes(10);
+
+    while (state.KeepRunning()) {
+        llmq::SigShareMap<int64_t> m;
+        FillMap(m, signHashes);
+    }
+}
+
+static void SigShareMap_Iterate(benchmark::State& state)
+{
+    auto signHashes = BuildSignHashes(10);
+    llmq::SigShareMap<int64_t> m;
+    FillMap(m, signHashes);
+
+    int64_t sum = 0;
+    while (state.KeepRunning()) {
+        m.ForEach([&](const llmq::SigShareKey& k, int64_t v) {
+            sum += v;
+        });
+    }
+    assert(sum != 0);
+}
+
+static void SigShareMap_Get(benchmark::State& state)
+{
+    auto signHashes = BuildSignHashes(10);
+    llmq::SigShareMap<int64_t> m;
+    FillMap(m, signHashes);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        auto k = std::make_pair(signHashes[i % signHashes.size()], (uint16_t)(i % QUORUM_SIZE));
+        assert(m.Get(k) != nullptr);
+        i++;
+    }
+}
+
+static void SigShareMap_EraseIf(benchmark::State& state)
+{
+    auto signHashes = BuildSignHashes(10);
+
+    while (state.KeepRunning()) {
+        llmq::SigShareMap<int64_t> m;
+        FillMap(m, signHashes);
+        // erase every second entry and then the rest, so that both partial and full session removal are covered
+        m.EraseIf([](const llmq::SigShareKey& k, int64_t v) {
+            return (v % 2) == 0;
+        });
+        m.EraseIf([](const llmq::SigShareKey& k, int64_t v) {
+            return true;
+        });
+        assert(m.Empty());
+    }
+}
+
+static void SigShareMap_EraseAllForSignHash(benchmark::State& state)
+{
+    auto signHashes = BuildSignHashes(10);
+
+    while (state.KeepRunning()) {
+        llmq::SigShareMap<int64_t> m;
+        FillMap(m, signHashes);
+        for (const auto& signHash : signHashes) {
+            m.EraseAllForSignHash(signHash);
+        }
+        assert(m.Empty());
+    }
+}
+
+BENCHMARK(SigShareMap_Insert, 500)
+BENCHMARK(SigShareMap_Iterate, 2000)
+BENCHMARK(SigShareMap_Get, 5 * 1000 * 1000)
+BENCHMARK(SigShareMap_EraseIf, 300)
+BENCHMARK(SigShareMap_EraseAllForSignHash, 500)
@@ -0,0 +1,67 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <script/standard.h>
+#include <txmempool.h>
+
+#include <vector>
+
+// Adds transactions to the mempool (with -addressindex and -spentindex style bookkeeping), queries the deltas of a
+// few addresses and removes all transactions again. Most outputs go to a small set of addresses and every 10th one
+// goes to the same "hot" address, similar to exchange wallets.
+static void MempoolAddressIndex(benchmark::State& state)
+{
+    const int nTxs = 2000;
+    const int nAddresses = 100;
+
+    std::vector<CScript> scripts;
+    std::vector<std::pair<uint160, int>> queries;
+    for (int i = 0; i < nAddresses; i++) {
+        uint160 hash;
+        *hash.begin() = (unsigned char)i;
+        *(hash.begin() + 1) = (unsigned char)(i >> 8);
+        scripts.emplace_back(GetScriptForDestination(CKeyID(hash)));
+        if (i < 10) {
+            queries.emplace_back(hash, 1);
+        }
+    }
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction funding;
+        funding.nLockTime = i;
+        funding.vout.emplace_back(10 * COIN, scripts[i % nAddresses]);
+        AddCoins(coins, funding, 1);
+
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(funding.GetHash(), 0));
+        tx.vout.emplace_back(5 * COIN, scripts[(i * 7) % nAddresses]);
+        tx.vout.emplace_back(4 * COIN, scripts[i % 10 == 0 ? 0 : (i * 13) % nAddresses]);
+        txs.emplace_back(MakeTransactionRef(tx));
+    }
+
+    CTxMemPool pool;
+    LockPoints lp;
+    while (state.KeepRunning()) {
+        LOCK(pool.cs);
+        for (const auto& tx : txs) {
+            CTxMemPoolEntry entry(tx, 1000, 0, 1, false, 1, lp);
+            pool.addUnchecked(tx->GetHash(), entry);
+            pool.addAddressIndex(entry, coins);
+            pool.addSpentIndex(entry, coins);
+        }
+        std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> results;
+        pool.getAddressIndex(queries, results);
+        assert(!results.empty());
+        for (const auto& tx : txs) {
+            pool.removeRecursive(*tx);
+        }
+    }
+}
+
+BENCHMARK(MempoolAddressIndex, 10);
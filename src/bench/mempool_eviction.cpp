@@ -112,4 +112,38 @@ static void MempoolEviction(benchmark::State& state)
     }
 }
 
+// Mine the first half of a long chain of transactions (as created by repeated
+// CoinJoin or InstantSend spends) while its tail stays in the mempool, which
+// exercises the package statistics updates of the remaining descendants.
+static void MempoolChainRemoveForBlock(benchmark::State& state)
+{
+    const int CHAIN_LENGTH = 100;
+
+    std::vector<CTransactionRef> vChain;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    for (int i = 0; i < CHAIN_LENGTH; i++) {
+        vChain.emplace_back(MakeTransactionRef(tx));
+        tx.vin[0].prevout = COutPoint(vChain.back()->GetHash(), 0);
+        tx.vout[0].nValue -= 1000;
+    }
+    const std::vector<CTransactionRef> vBlock(vChain.begin(), vChain.begin() + CHAIN_LENGTH / 2);
+
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    while (state.KeepRunning()) {
+        for (const auto& ptx : vChain) {
+            AddTx(*ptx, 1000LL, pool);
+        }
+        pool.removeForBlock(vBlock, 1);
+        pool.clear();
+    }
+}
+
 BENCHMARK(MempoolEviction, 41000);
+BENCHMARK(MempoolChainRemoveForBlock, 20);
@@ -7,6 +7,11 @@
 #include <uint256.h>
 #include <random.h>
 #include <consensus/merkle.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <version.h>
+
+#include <bench/data/block813851.raw.h>
 
 static void MerkleRoot(benchmark::State& state)
 {
@@ -23,4 +28,61 @@ static void MerkleRoot(benchmark::State& state)
     }
 }
 
+// Reads through a CDataStream without exposing its buffer, like a file, so that every txid is hashed on its own
+class UnbatchedReader
+{
+    CDataStream& stream;
+
+public:
+    explicit UnbatchedReader(CDataStream& _stream) : stream(_stream) {}
+
+    template<typename T>
+    UnbatchedReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    int GetType() const { return stream.GetType(); }
+    int GetVersion() const { return stream.GetVersion(); }
+    void read(char* pch, size_t nSize) { stream.read(pch, nSize); }
+};
+
+// Deserializing a block (which computes all txids) and its merkle root, with the txids hashed together or one by one
+template<bool fBatched>
+static void BlockTxidsMerkleRoot(benchmark::State& state)
+{
+    CDataStream stream((const char*)raw_bench::block813851,
+            (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        if (fBatched) {
+            stream >> block;
+        } else {
+            UnbatchedReader reader(stream);
+            reader >> block;
+        }
+        assert(stream.Rewind(sizeof(raw_bench::block813851)));
+        bool mutated;
+        uint256 root = BlockMerkleRoot(block, &mutated);
+        assert(root == block.hashMerkleRoot);
+    }
+}
+
+static void BlockTxidsMerkleRoot_Batched(benchmark::State& state)
+{
+    BlockTxidsMerkleRoot<true>(state);
+}
+
+static void BlockTxidsMerkleRoot_Unbatched(benchmark::State& state)
+{
+    BlockTxidsMerkleRoot<false>(state);
+}
+
 BENCHMARK(MerkleRoot, 800);
+BENCHMARK(BlockTxidsMerkleRoot_Batched, 100);
+BENCHMARK(BlockTxidsMerkleRoot_Unbatched, 100);
@@ -0,0 +1,39 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <miner.h>
+#include <util.h>
+
+// Each iteration searches kNonces nonces of a header with a mainnet difficulty target, so no solution is found.
+// kNonces / time per iteration gives the X11 hashes/s, of a single core and of all cores.
+static constexpr uint32_t kNonces = 1 << 16;
+
+static void SolveBlockHeader(benchmark::State& state, int nThreads)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    CBlockHeader header = chainParams->GenesisBlock().GetBlockHeader();
+    header.nBits = 0x1b0404cb;
+
+    while (state.KeepRunning()) {
+        header.nNonce = 0;
+        uint64_t nMaxTries = kNonces;
+        bool fSolved = SolveBlockHeader(header, chainParams->GetConsensus(), kNonces, nMaxTries, nThreads);
+        assert(!fSolved);
+    }
+}
+
+static void SolveBlockHeader_1Thread(benchmark::State& state)
+{
+    SolveBlockHeader(state, 1);
+}
+
+static void SolveBlockHeader_AllCores(benchmark::State& state)
+{
+    SolveBlockHeader(state, GetNumCores());
+}
+
+BENCHMARK(SolveBlockHeader_1Thread, 1);
+BENCHMARK(SolveBlockHeader_AllCores, 1);
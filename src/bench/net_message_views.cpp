@@ -0,0 +1,189 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_signing_shares.h>
+#include <protocol.h>
+#include <random.h>
+#include <streams.h>
+#include <version.h>
+
+// Sizes of the messages in the mix, roughly what a masternode sees per received message of each type
+static const size_t INV_COUNT = 35;
+static const size_t ISLOCK_INPUTS = 2;
+static const size_t SIGSESANN_COUNT = 10;
+static const size_t SIGSHARESINV_COUNT = 10;
+static const size_t SIGSHARESINV_SIZE = 60;
+
+template<typename T>
+static std::vector<unsigned char> Serialize(const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+static SpanReader MakeReader(const std::vector<unsigned char>& buf)
+{
+    return SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(buf.data(), buf.size()));
+}
+
+static std::vector<unsigned char> BuildInv(size_t count)
+{
+    std::vector<CInv> vInv;
+    for (size_t i = 0; i < count; i++) {
+        vInv.emplace_back(i % 2 ? MSG_TX : MSG_ISLOCK, GetRandHash());
+    }
+    return Serialize(vInv);
+}
+
+static std::vector<unsigned char> BuildISLock()
+{
+    llmq::CInstantSendLock islock;
+    for (size_t i = 0; i < ISLOCK_INPUTS; i++) {
+        islock.inputs.emplace_back(GetRandHash(), (uint32_t)i);
+    }
+    islock.txid = GetRandHash();
+    return Serialize(islock);
+}
+
+static std::vector<unsigned char> BuildSigSesAnns()
+{
+    std::vector<llmq::CSigSesAnn> anns(SIGSESANN_COUNT);
+    for (size_t i = 0; i < anns.size(); i++) {
+        anns[i].sessionId = (uint32_t)i;
+        anns[i].llmqType = Consensus::LLMQ_50_60;
+        anns[i].quorumHash = GetRandHash();
+        anns[i].id = GetRandHash();
+        anns[i].msgHash = GetRandHash();
+    }
+    return Serialize(anns);
+}
+
+static std::vector<unsigned char> BuildSigSharesInvs()
+{
+    std::vector<llmq::CSigSharesInv> invs(SIGSHARESINV_COUNT);
+    for (size_t i = 0; i < invs.size(); i++) {
+        invs[i].sessionId = (uint32_t)i;
+        invs[i].Init(SIGSHARESINV_SIZE);
+        invs[i].Set((uint16_t)(i % SIGSHARESINV_SIZE), true);
+    }
+    return Serialize(invs);
+}
+
+static void Inv_Deserialize(benchmark::State& state)
+{
+    auto buf = BuildInv(INV_COUNT);
+    while (state.KeepRunning()) {
+        std::vector<CInv> vInv;
+        MakeReader(buf) >> vInv;
+        for (const auto& inv : vInv) {
+            assert(inv.IsKnownType());
+        }
+    }
+}
+
+static void Inv_Reader(benchmark::State& state)
+{
+    auto buf = BuildInv(INV_COUNT);
+    while (state.KeepRunning()) {
+        SpanReader reader = MakeReader(buf);
+        VectorElementReader<CInv> invReader(reader, CInv::SERIALIZED_SIZE);
+        CInv inv;
+        while (invReader.Next(inv)) {
+            assert(inv.IsKnownType());
+        }
+    }
+}
+
+// Duplicate ISLOCKs: what is needed to find out that we know the lock already
+static void ISLock_DeserializeHash(benchmark::State& state)
+{
+    auto buf = BuildISLock();
+    while (state.KeepRunning()) {
+        auto islock = std::make_shared<llmq::CInstantSendLock>();
+        MakeReader(buf) >> *islock;
+        auto hash = ::SerializeHash(*islock);
+        assert(!hash.IsNull());
+    }
+}
+
+static void ISLock_ViewHash(benchmark::State& state)
+{
+    auto buf = BuildISLock();
+    while (state.KeepRunning()) {
+        llmq::CInstantSendLockView view;
+        MakeReader(buf) >> view;
+        auto hash = view.GetHash();
+        assert(!hash.IsNull());
+    }
+}
+
+// One message of each type above, deserialized the way ProcessMessage used to and the way it does now
+static void MessageMix_Deserialize(benchmark::State& state)
+{
+    auto bufInv = BuildInv(INV_COUNT);
+    auto bufISLock = BuildISLock();
+    auto bufAnns = BuildSigSesAnns();
+    auto bufInvs = BuildSigSharesInvs();
+    while (state.KeepRunning()) {
+        std::vector<CInv> vInv;
+        MakeReader(bufInv) >> vInv;
+        auto islock = std::make_shared<llmq::CInstantSendLock>();
+        MakeReader(bufISLock) >> *islock;
+        auto hash = ::SerializeHash(*islock);
+        std::vector<llmq::CSigSesAnn> anns;
+        MakeReader(bufAnns) >> anns;
+        std::vector<llmq::CSigSharesInv> invs;
+        MakeReader(bufInvs) >> invs;
+        assert(vInv.size() + anns.size() + invs.size() != 0 && !hash.IsNull());
+    }
+}
+
+static void MessageMix_Views(benchmark::State& state)
+{
+    auto bufInv = BuildInv(INV_COUNT);
+    auto bufISLock = BuildISLock();
+    auto bufAnns = BuildSigSesAnns();
+    auto bufInvs = BuildSigSharesInvs();
+    while (state.KeepRunning()) {
+        size_t count = 0;
+        {
+            SpanReader reader = MakeReader(bufInv);
+            VectorElementReader<CInv> invReader(reader, CInv::SERIALIZED_SIZE);
+            CInv inv;
+            while (invReader.Next(inv)) {
+                count++;
+            }
+        }
+        llmq::CInstantSendLockView view;
+        MakeReader(bufISLock) >> view;
+        auto hash = view.GetHash();
+        {
+            SpanReader reader = MakeReader(bufAnns);
+            VectorElementReader<llmq::CSigSesAnn> annReader(reader, llmq::CSigSesAnn::MIN_SERIALIZED_SIZE);
+            llmq::CSigSesAnn ann;
+            while (annReader.Next(ann)) {
+                count++;
+            }
+        }
+        {
+            SpanReader reader = MakeReader(bufInvs);
+            VectorElementReader<llmq::CSigSharesInv> invReader(reader, llmq::CSigSharesInv::MIN_SERIALIZED_SIZE);
+            llmq::CSigSharesInv inv;
+            while (invReader.Next(inv)) {
+                count++;
+            }
+        }
+        assert(count != 0 && !hash.IsNull());
+    }
+}
+
+BENCHMARK(Inv_Deserialize, 50 * 1000)
+BENCHMARK(Inv_Reader, 50 * 1000)
+BENCHMARK(ISLock_DeserializeHash, 200 * 1000)
+BENCHMARK(ISLock_ViewHash, 200 * 1000)
+BENCHMARK(MessageMix_Deserialize, 20 * 1000)
+BENCHMARK(MessageMix_Views, 20 * 1000)
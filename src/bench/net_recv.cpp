@@ -0,0 +1,52 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <net.h>
+#include <protocol.h>
+#include <streams.h>
+
+#include <vector>
+
+static void AppendMessage(CDataStream& traffic, const char* pszCommand, size_t nPayloadSize)
+{
+    CMessageHeader hdr(Params().MessageStart(), pszCommand, nPayloadSize);
+    traffic << hdr;
+    std::vector<char> payload(nPayloadSize, 0x42);
+    traffic.write(payload.data(), payload.size());
+}
+
+// Feeds a mix of small (inv), medium (tx) and large (block) messages through CNode::ReceiveMsgBytes in chunks of the
+// size SocketRecvData reads at once. The node (and with it all received messages) is destroyed after every batch,
+// which hands the receive buffers back to CNetMessageBufferPool for the next batch.
+static void NetReceiveMessages(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    CDataStream traffic(SER_NETWORK, PROTOCOL_VERSION);
+    for (int i = 0; i < 20; i++) {
+        for (int j = 0; j < 20; j++) {
+            AppendMessage(traffic, NetMsgType::INV, 37);
+        }
+        for (int j = 0; j < 5; j++) {
+            AppendMessage(traffic, NetMsgType::TX, 250);
+        }
+        AppendMessage(traffic, NetMsgType::BLOCK, 50 * 1024);
+    }
+
+    const size_t nChunkSize = 0x10000;
+    CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+    while (state.KeepRunning()) {
+        CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+        for (size_t nPos = 0; nPos < traffic.size(); nPos += nChunkSize) {
+            bool complete;
+            bool ret = node.ReceiveMsgBytes(traffic.data() + nPos, std::min(nChunkSize, traffic.size() - nPos), complete);
+            assert(ret);
+        }
+    }
+}
+
+BENCHMARK(NetReceiveMessages, 100);
@@ -0,0 +1,145 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/dash-config.h>
+#endif
+
+#include <bench/perf.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef HAVE_PERF_EVENT_OPEN
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Heap allocations of all threads, only counted while a PerfCounters object exists so that plain runs don't pay for it
+static std::atomic<bool> g_count_allocations{false};
+static std::atomic<uint64_t> g_allocations{0};
+static std::atomic<uint64_t> g_allocated_bytes{0};
+
+void* operator new(std::size_t size)
+{
+    if (g_count_allocations.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    // malloc(0) may return nullptr, but operator new must return a unique pointer
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace benchmark {
+
+#ifdef HAVE_PERF_EVENT_OPEN
+static int OpenCounter(uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // this thread, on any cpu
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return fd;
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+    m_fds.fill(-1);
+#ifdef HAVE_PERF_EVENT_OPEN
+    m_fds[CYCLES] = OpenCounter(PERF_COUNT_HW_CPU_CYCLES);
+    m_fds[INSTRUCTIONS] = OpenCounter(PERF_COUNT_HW_INSTRUCTIONS);
+    m_fds[CACHE_MISSES] = OpenCounter(PERF_COUNT_HW_CACHE_MISSES);
+    m_fds[BRANCH_MISSES] = OpenCounter(PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    g_count_allocations = true;
+}
+
+PerfCounters::~PerfCounters()
+{
+    g_count_allocations = false;
+#ifdef HAVE_PERF_EVENT_OPEN
+    for (int fd : m_fds) {
+        if (fd != -1) close(fd);
+    }
+#endif
+}
+
+const char* PerfCounters::Name(Counter counter)
+{
+    switch (counter) {
+    case CYCLES: return "cycles";
+    case INSTRUCTIONS: return "instructions";
+    case CACHE_MISSES: return "cache_misses";
+    case BRANCH_MISSES: return "branch_misses";
+    case ALLOCATIONS: return "allocations";
+    case ALLOCATED_BYTES: return "allocated_bytes";
+    case COUNTER_COUNT: break;
+    }
+    return "unknown";
+}
+
+bool PerfCounters::IsAvailable(Counter counter) const
+{
+    return counter >= ALLOCATIONS || m_fds[counter] != -1;
+}
+
+PerfCounters::Values PerfCounters::Read() const
+{
+    Values values;
+    values.fill(0);
+#ifdef HAVE_PERF_EVENT_OPEN
+    for (size_t i = 0; i < m_fds.size(); i++) {
+        uint64_t value;
+        if (m_fds[i] != -1 && read(m_fds[i], &value, sizeof(value)) == sizeof(value)) {
+            values[i] = value;
+        }
+    }
+#endif
+    values[ALLOCATIONS] = g_allocations.load(std::memory_order_relaxed);
+    values[ALLOCATED_BYTES] = g_allocated_bytes.load(std::memory_order_relaxed);
+    return values;
+}
+
+} // namespace benchmark
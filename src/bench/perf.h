@@ -0,0 +1,52 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_PERF_H
+#define BITCOIN_BENCH_PERF_H
+
+#include <array>
+#include <stdint.h>
+
+namespace benchmark {
+
+/**
+ * Hardware counters (through perf_event on Linux) and heap allocations of the thread running the benchmarks. They are
+ * read before and after every evaluation, so the totals only cover the timed loops.
+ */
+class PerfCounters
+{
+public:
+    enum Counter {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        ALLOCATIONS,
+        ALLOCATED_BYTES,
+        COUNTER_COUNT
+    };
+    typedef std::array<uint64_t, COUNTER_COUNT> Values;
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    static const char* Name(Counter counter);
+
+    //! Whether the counter could be opened. Hardware counters are missing outside Linux, in most VMs and when
+    //! kernel.perf_event_paranoid does not allow them; allocations and allocated bytes are always
+    //! counted.
+    bool IsAvailable(Counter counter) const;
+
+    Values Read() const;
+
+private:
+    std::array<int, ALLOCATIONS> m_fds;
+};
+
+} // namespace benchmark
+
+#endif // BITCOIN_BENCH_PERF_H
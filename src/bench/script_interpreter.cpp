@@ -0,0 +1,128 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <key.h>
+#include <policy/policy.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+
+// Scripts which don't check signatures, so the time is spent in the interpreter loop and on the stack. They stay
+// just below MAX_OPS_PER_SCRIPT.
+
+static CScript StackOpsScript()
+{
+    CScript script;
+    script << OP_1 << OP_2 << OP_3;
+    for (int i = 0; i < 25; i++) {
+        script << OP_ROT << OP_2DUP << OP_SWAP << OP_DROP << OP_OVER << OP_NIP << OP_TUCK << OP_2DROP;
+    }
+    return script;
+}
+
+static CScript ArithmeticScript()
+{
+    CScript script;
+    script << OP_0;
+    for (int i = 0; i < 40; i++) {
+        script << i << OP_ADD << OP_DUP << OP_ABS << OP_SUB << i << OP_ADD;
+    }
+    return script;
+}
+
+static CScript PushDataScript()
+{
+    CScript script;
+    for (int i = 0; i < 100; i++) {
+        // Sizes of signatures, compressed and uncompressed pubkeys and hashes are all stored inline
+        script << std::vector<unsigned char>(20 + (i % 4) * 15, (unsigned char)i) << OP_DROP;
+    }
+    return script;
+}
+
+static CScript HashScript()
+{
+    CScript script;
+    script << std::vector<unsigned char>(33, 1);
+    for (int i = 0; i < 100; i++) {
+        script << (i % 2 ? OP_HASH160 : OP_SHA256);
+    }
+    return script;
+}
+
+static void EvalScriptBench(benchmark::State& state, const CScript& script)
+{
+    BaseSignatureChecker checker;
+    while (state.KeepRunning()) {
+        CScriptStack stack;
+        ScriptError err;
+        bool ret = EvalScript(stack, script, STANDARD_SCRIPT_VERIFY_FLAGS, checker, SigVersion::BASE, &err);
+        assert(ret && err == SCRIPT_ERR_OK);
+    }
+}
+
+static void ScriptEval_StackOps(benchmark::State& state) { EvalScriptBench(state, StackOpsScript()); }
+static void ScriptEval_Arithmetic(benchmark::State& state) { EvalScriptBench(state, ArithmeticScript()); }
+static void ScriptEval_PushData(benchmark::State& state) { EvalScriptBench(state, PushDataScript()); }
+static void ScriptEval_Hash(benchmark::State& state) { EvalScriptBench(state, HashScript()); }
+
+// Same as ScriptEval_PushData, but through the EvalScript() overload for stacks of std::vector
+static void ScriptEval_PushData_VectorStack(benchmark::State& state)
+{
+    const CScript script = PushDataScript();
+    BaseSignatureChecker checker;
+    while (state.KeepRunning()) {
+        std::vector<std::vector<unsigned char>> stack;
+        ScriptError err;
+        bool ret = EvalScript(stack, script, STANDARD_SCRIPT_VERIFY_FLAGS, checker, SigVersion::BASE, &err);
+        assert(ret && err == SCRIPT_ERR_OK);
+    }
+}
+
+// Full verification of a bare 2-of-3 multisig spend, including signature checks
+static void ScriptVerify_Multisig(benchmark::State& state)
+{
+    std::vector<CKey> keys(3);
+    std::vector<CPubKey> pubkeys;
+    for (auto& key : keys) {
+        key.MakeNewKey(true);
+        pubkeys.emplace_back(key.GetPubKey());
+    }
+    const CScript scriptPubKey = GetScriptForMultisig(2, pubkeys);
+
+    CMutableTransaction txCredit;
+    txCredit.vin.resize(1);
+    txCredit.vout.resize(1);
+    txCredit.vout[0].scriptPubKey = scriptPubKey;
+    txCredit.vout[0].nValue = 1;
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(txCredit.GetHash(), 0);
+    txSpend.vout.resize(1);
+    txSpend.vout[0].nValue = 1;
+
+    uint256 hash = SignatureHash(scriptPubKey, txSpend, 0, SIGHASH_ALL, 1, SigVersion::BASE);
+    txSpend.vin[0].scriptSig << OP_0;
+    for (size_t i = 0; i < 2; i++) {
+        std::vector<unsigned char> sig;
+        keys[i].Sign(hash, sig);
+        sig.push_back((unsigned char)SIGHASH_ALL);
+        txSpend.vin[0].scriptSig << sig;
+    }
+    const CTransaction tx(txSpend);
+
+    while (state.KeepRunning()) {
+        ScriptError err;
+        bool ret = VerifyScript(tx.vin[0].scriptSig, scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0, 1), &err);
+        assert(ret && err == SCRIPT_ERR_OK);
+    }
+}
+
+BENCHMARK(ScriptEval_StackOps, 20 * 1000)
+BENCHMARK(ScriptEval_Arithmetic, 10 * 1000)
+BENCHMARK(ScriptEval_PushData, 20 * 1000)
+BENCHMARK(ScriptEval_PushData_VectorStack, 20 * 1000)
+BENCHMARK(ScriptEval_Hash, 10 * 1000)
+BENCHMARK(ScriptVerify_Multisig, 2 * 1000)
@@ -47,7 +47,8 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
 
 
 
-ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
+ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                                              const std::vector<std::pair<uint256, CTransactionRef>>& islocked_txn) {
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
         return READ_STATUS_INVALID;
     if (cmpctblock.shorttxids.size() + cmpctblock.prefilledtxn.size() > MaxBlockSize() / MIN_TRANSACTION_SIZE)
@@ -133,36 +134,45 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     }
     }
 
-    for (size_t i = 0; i < extra_txn.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(extra_txn[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = extra_txn[i].second;
-                have_txn[idit->second]  = true;
-                mempool_count++;
-                extra_count++;
-            } else {
-                // If we find two mempool/extra txn that match the short id, just
-                // request it.
-                // This should be rare enough that the extra bandwidth doesn't matter,
-                // but eating a round-trip due to FillBlock failure would be annoying
-                // Note that we don't want duplication between extra_txn and mempool to
-                // trigger this case, so we compare hashes first
-                if (txn_available[idit->second] &&
-                        txn_available[idit->second]->GetHash() != extra_txn[i].second->GetHash()) {
-                    txn_available[idit->second].reset();
-                    mempool_count--;
-                    extra_count--;
+    // Looks up extra transactions which are not (or no longer) in the mempool. Each source has its own counter so that
+    // callers can tell where reconstructed transactions came from
+    auto fillFromExtraTxn = [&](const std::vector<std::pair<uint256, CTransactionRef>>& txs, size_t& source_count) {
+        for (size_t i = 0; i < txs.size(); i++) {
+            // Though ideally we'd continue scanning for the two-txn-match-shortid case,
+            // the performance win of an early exit here is too good to pass up and worth
+            // the extra risk.
+            if (mempool_count == shorttxids.size())
+                break;
+            if (!txs[i].second)
+                continue;
+            uint64_t shortid = cmpctblock.GetShortID(txs[i].first);
+            std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
+            if (idit != shorttxids.end()) {
+                if (!have_txn[idit->second]) {
+                    txn_available[idit->second] = txs[i].second;
+                    have_txn[idit->second]  = true;
+                    mempool_count++;
+                    source_count++;
+                } else {
+                    // If we find two mempool/extra txn that match the short id, just
+                    // request it.
+                    // This should be rare enough that the extra bandwidth doesn't matter,
+                    // but eating a round-trip due to FillBlock failure would be annoying
+                    // Note that we don't want duplication between extra_txn and mempool to
+                    // trigger this case, so we compare hashes first
+                    if (txn_available[idit->second] &&
+                            txn_available[idit->second]->GetHash() != txs[i].second->GetHash()) {
+                        txn_available[idit->second].reset();
+                        mempool_count--;
+                        // The first match might have come from the mempool, so the per-source counter is
+                        // left alone here and only serves as a lower bound
+                    }
                 }
             }
         }
-        // Though ideally we'd continue scanning for the two-txn-match-shortid case,
-        // the performance win of an early exit here is too good to pass up and worth
-        // the extra risk.
-        if (mempool_count == shorttxids.size())
-            break;
-    }
+    };
+    fillFromExtraTxn(extra_txn, extra_count);
+    fillFromExtraTxn(islocked_txn, islock_count);
 
     LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, SER_NETWORK, PROTOCOL_VERSION));
 
@@ -209,7 +219,7 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_CHECKBLOCK_FAILED;
     }
 
-    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
+    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool and %lu from islocked pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, islock_count, vtx_missing.size());
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing) {
             LogPrint(BCLog::CMPCTBLOCK, "Reconstructed block %s required tx %s\n", hash.ToString(), tx->GetHash().ToString());
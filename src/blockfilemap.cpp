@@ -0,0 +1,102 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+
+#include <util.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<CBlockFileMapCache> g_block_file_maps;
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    if (size != 0) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+}
+
+static CBlockFileMapCache::MappingPtr MapFile(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        LogPrintf("%s -- unable to open file %s\n", __func__, path.string());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the file descriptor is closed
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("%s -- unable to map file %s\n", __func__, path.string());
+        return nullptr;
+    }
+    return std::make_shared<const CMappedBlockFile>(static_cast<const unsigned char*>(p), (size_t)st.st_size);
+#else
+    return nullptr;
+#endif
+}
+
+CBlockFileMapCache::MappingPtr CBlockFileMapCache::Get(const fs::path& path, int nFile, bool fUndo)
+{
+    FileKey key(fUndo, nFile);
+    {
+        LOCK(cs);
+        auto it = mapFiles.find(key);
+        if (it != mapFiles.end()) {
+            lruList.splice(lruList.begin(), lruList, it->second);
+            return it->second->second;
+        }
+    }
+
+    // map without holding cs, if another thread maps the same file concurrently the first mapping wins
+    MappingPtr mapping = MapFile(path);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    LOCK(cs);
+    auto it = mapFiles.find(key);
+    if (it != mapFiles.end()) {
+        return it->second->second;
+    }
+    lruList.emplace_front(key, mapping);
+    mapFiles.emplace(key, lruList.begin());
+    while (lruList.size() > maxFiles) {
+        mapFiles.erase(lruList.back().first);
+        lruList.pop_back();
+    }
+    return mapping;
+}
+
+void CBlockFileMapCache::Remove(int nFile)
+{
+    LOCK(cs);
+    for (bool fUndo : {false, true}) {
+        auto it = mapFiles.find(FileKey(fUndo, nFile));
+        if (it != mapFiles.end()) {
+            lruList.erase(it->second);
+            mapFiles.erase(it);
+        }
+    }
+}
+
+void CBlockFileMapCache::Clear()
+{
+    LOCK(cs);
+    mapFiles.clear();
+    lruList.clear();
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include <fs.h>
+#include <span.h>
+#include <sync.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+
+/** A read-only memory mapping of a whole block (blk?????.dat) or undo (rev?????.dat) file */
+class CMappedBlockFile
+{
+private:
+    const unsigned char* data;
+    size_t size;
+
+public:
+    CMappedBlockFile(const unsigned char* _data, size_t _size) : data(_data), size(_size) {}
+    ~CMappedBlockFile();
+
+    CMappedBlockFile(const CMappedBlockFile&) = delete;
+    CMappedBlockFile& operator=(const CMappedBlockFile&) = delete;
+
+    /** Returns the mapped bytes [pos, pos + len) or an empty span if the range is not (completely) mapped */
+    Span<const unsigned char> GetRange(size_t pos, size_t len) const
+    {
+        if (pos > size || len > size - pos) {
+            return Span<const unsigned char>();
+        }
+        return Span<const unsigned char>(data + pos, len);
+    }
+};
+
+/**
+ * Keeps up to maxFiles block and undo files memory mapped for reading, evicting the least recently used ones.
+ * File descriptors are closed right after mapping, so this does not keep any files open.
+ *
+ * Only files which are not written to anymore (except appending undo data) may be mapped, as truncating a mapped
+ * file would make accesses to the truncated part fault. Files must be removed from the cache before deleting them.
+ */
+class CBlockFileMapCache
+{
+public:
+    typedef std::shared_ptr<const CMappedBlockFile> MappingPtr;
+
+private:
+    // (fUndo, nFile)
+    typedef std::pair<bool, int> FileKey;
+
+    CCriticalSection cs;
+    const size_t maxFiles;
+    // most recently used mapping at the front
+    std::list<std::pair<FileKey, MappingPtr>> lruList;
+    std::map<FileKey, std::list<std::pair<FileKey, MappingPtr>>::iterator> mapFiles;
+
+public:
+    explicit CBlockFileMapCache(size_t _maxFiles) : maxFiles(_maxFiles) {}
+
+    /** Returns the mapping of the given file, mapping it if necessary. Returns nullptr if mapping failed. */
+    MappingPtr Get(const fs::path& path, int nFile, bool fUndo);
+    /** Unmaps the block and undo files of nFile. Mappings still in use by readers stay valid until released. */
+    void Remove(int nFile);
+    void Clear();
+};
+
+extern std::unique_ptr<CBlockFileMapCache> g_block_file_maps;
+
+#endif // BITCOIN_BLOCKFILEMAP_H
@@ -3,10 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <blockfilter.h>
+#include <evo/providertx.h>
+#include <evo/specialtx.h>
 #include <hash.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
+#include <script/standard.h>
 #include <streams.h>
+#include <version.h>
 
 /// SerType used to serialize parameters in GCS filter encoding.
 static constexpr int GCS_SER_TYPE = SER_NETWORK;
@@ -200,6 +204,62 @@ bool GCSFilter::MatchAny(const ElementSet& elements) const
     return MatchInternal(queries.data(), queries.size());
 }
 
+/**
+ * Dash special transactions carry scripts, keys and outpoints in their payload
+ * instead of (or in addition to) their outputs. Add the ones a wallet may be
+ * watching: payout scripts, the owner and voting key ids as P2PKH scripts and
+ * the serialized external collateral outpoint.
+ */
+static void ExtractSpecialTxFilterElements(const CTransaction& tx, GCSFilter::ElementSet& elements)
+{
+    if (tx.nVersion != 3) {
+        return;
+    }
+
+    auto addScript = [&](const CScript& script) {
+        if (!script.empty() && script[0] != OP_RETURN) {
+            elements.emplace(script.begin(), script.end());
+        }
+    };
+    auto addKeyID = [&](const CKeyID& keyID) {
+        addScript(GetScriptForDestination(keyID));
+    };
+
+    switch (tx.nType) {
+    case TRANSACTION_PROVIDER_REGISTER: {
+        CProRegTx proTx;
+        if (GetTxPayload(tx, proTx)) {
+            addScript(proTx.scriptPayout);
+            addKeyID(proTx.keyIDOwner);
+            addKeyID(proTx.keyIDVoting);
+            if (!proTx.collateralOutpoint.hash.IsNull()) {
+                CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                ss << proTx.collateralOutpoint;
+                elements.emplace(ss.begin(), ss.end());
+            }
+        }
+        break;
+    }
+    case TRANSACTION_PROVIDER_UPDATE_SERVICE: {
+        CProUpServTx proTx;
+        if (GetTxPayload(tx, proTx)) {
+            addScript(proTx.scriptOperatorPayout);
+        }
+        break;
+    }
+    case TRANSACTION_PROVIDER_UPDATE_REGISTRAR: {
+        CProUpRegTx proTx;
+        if (GetTxPayload(tx, proTx)) {
+            addScript(proTx.scriptPayout);
+            addKeyID(proTx.keyIDVoting);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
 static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
                                                  const CBlockUndo& block_undo)
 {
@@ -211,6 +271,7 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
             if (script.empty() || script[0] == OP_RETURN) continue;
             elements.emplace(script.begin(), script.end());
         }
+        ExtractSpecialTxFilterElements(*tx, elements);
     }
 
     for (const CTxUndo& tx_undo : block_undo.vtxundo) {
@@ -224,6 +285,21 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
     return elements;
 }
 
+BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
+                         std::vector<unsigned char> filter)
+    : m_filter_type(filter_type), m_block_hash(block_hash)
+{
+    switch (m_filter_type) {
+    case BlockFilterType::BASIC_FILTER:
+        m_filter = GCSFilter(m_block_hash.GetUint64(0), m_block_hash.GetUint64(1),
+                             BASIC_FILTER_P, BASIC_FILTER_M, std::move(filter));
+        break;
+
+    default:
+        throw std::invalid_argument("unknown filter_type");
+    }
+}
+
 BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo)
     : m_filter_type(filter_type), m_block_hash(block.GetHash())
 {
@@ -88,12 +88,18 @@ enum BlockFilterType : uint8_t
 class BlockFilter
 {
 private:
-    BlockFilterType m_filter_type;
+    BlockFilterType m_filter_type{BlockFilterType::BASIC_FILTER};
     uint256 m_block_hash;
     GCSFilter m_filter;
 
 public:
 
+    BlockFilter() = default;
+
+    // Reconstruct a BlockFilter from parts.
+    BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
+                std::vector<unsigned char> filter);
+
     // Construct a new BlockFilter of the specified type from a block.
     BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo);
 
@@ -107,6 +113,8 @@ public:
     }
 
     // Compute the filter hash.
+    const uint256& GetBlockHash() const { return m_block_hash; }
+
     uint256 GetHash() const;
 
     // Compute the filter header given the previous one.
@@ -0,0 +1,56 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockindexmap.h>
+
+#include <memusage.h>
+
+CBlockIndexMap::Slot& CBlockIndexMap::FindSlot(const uint256& hash)
+{
+    // The low bits of the hash select the slot, the high ones are the tag which saves looking at most other entries
+    const uint64_t nCheapHash = hash.GetCheapHash();
+    const uint32_t nTag = (uint32_t)(nCheapHash >> 32);
+    const size_t nMask = vSlots.size() - 1;
+    for (size_t i = nCheapHash & nMask; ; i = (i + 1) & nMask) {
+        Slot& slot = vSlots[i];
+        if (!slot.nPos || (slot.nTag == nTag && GetEntry(slot.nPos - 1).item.first == hash)) {
+            return slot;
+        }
+    }
+}
+
+void CBlockIndexMap::Rehash(size_t nSlots)
+{
+    vSlots.assign(nSlots, Slot{0, 0});
+    for (uint32_t nPos = 0; nPos < nSize; nPos++) {
+        const uint256& hash = GetEntry(nPos).item.first;
+        Slot& slot = FindSlot(hash);
+        slot.nTag = (uint32_t)(hash.GetCheapHash() >> 32);
+        slot.nPos = nPos + 1;
+    }
+}
+
+CBlockIndexMap::Entry* CBlockIndexMap::Allocate()
+{
+    if ((nSize & (CHUNK_SIZE - 1)) == 0) {
+        vChunks.emplace_back(new EntryStorage[CHUNK_SIZE]);
+    }
+    return &GetEntry(nSize++);
+}
+
+void CBlockIndexMap::clear()
+{
+    for (uint32_t nPos = 0; nPos < nSize; nPos++) {
+        GetEntry(nPos).~Entry();
+    }
+    nSize = 0;
+    std::vector<std::unique_ptr<EntryStorage[]>>().swap(vChunks);
+    std::vector<Slot>().swap(vSlots);
+}
+
+size_t CBlockIndexMap::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(vSlots) + memusage::DynamicUsage(vChunks) +
+           vChunks.size() * memusage::MallocUsage(CHUNK_SIZE * sizeof(EntryStorage));
+}
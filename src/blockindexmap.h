@@ -0,0 +1,136 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKINDEXMAP_H
+#define BITCOIN_BLOCKINDEXMAP_H
+
+#include <chain.h>
+#include <uint256.h>
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * The map of all block index entries. It replaces an unordered_map<uint256, CBlockIndex*> of separately allocated
+ * entries: the CBlockIndex objects are stored together with their hash in chunks owned by the map, and found through
+ * an open addressing table which only holds a tag of the hash and the position of the entry.
+ *
+ * Entries are never removed individually and their addresses never change, so phashBlock (which points to the hash
+ * stored with the entry) and pointers to the entries stay valid until the map is cleared. Iteration is in insertion
+ * order.
+ */
+class CBlockIndexMap
+{
+public:
+    typedef std::pair<const uint256, CBlockIndex*> value_type;
+
+private:
+    struct Entry {
+        CBlockIndex index;
+        value_type item;
+
+        template<typename... Args>
+        explicit Entry(const uint256& hash, Args&&... args) : index(std::forward<Args>(args)...), item(hash, &index) {}
+    };
+    typedef typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type EntryStorage;
+
+    //! 2^CHUNK_BITS entries per chunk
+    static const int CHUNK_BITS = 12;
+    static const uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+    static const uint32_t INITIAL_SLOTS = 1 << 10;
+
+    //! nPos is the position of the entry plus one, so that a zeroed slot is empty
+    struct Slot {
+        uint32_t nTag;
+        uint32_t nPos;
+    };
+
+    std::vector<std::unique_ptr<EntryStorage[]>> vChunks;
+    std::vector<Slot> vSlots;
+    uint32_t nSize{0};
+
+    Entry& GetEntry(uint32_t nPos) const
+    {
+        return *reinterpret_cast<Entry*>(&vChunks[nPos >> CHUNK_BITS][nPos & (CHUNK_SIZE - 1)]);
+    }
+
+    //! The slot of the entry with this hash, or the empty slot where it would be inserted
+    Slot& FindSlot(const uint256& hash);
+    const Slot& FindSlot(const uint256& hash) const { return const_cast<CBlockIndexMap*>(this)->FindSlot(hash); }
+    void Rehash(size_t nSlots);
+    Entry* Allocate();
+
+public:
+    class iterator
+    {
+        friend class CBlockIndexMap;
+
+        const CBlockIndexMap* map;
+        uint32_t nPos;
+
+        iterator(const CBlockIndexMap* _map, uint32_t _nPos) : map(_map), nPos(_nPos) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef CBlockIndexMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        reference operator*() const { return map->GetEntry(nPos).item; }
+        pointer operator->() const { return &map->GetEntry(nPos).item; }
+        iterator& operator++() { nPos++; return *this; }
+        iterator operator++(int) { iterator ret = *this; nPos++; return ret; }
+        bool operator==(const iterator& other) const { return nPos == other.nPos; }
+        bool operator!=(const iterator& other) const { return nPos != other.nPos; }
+    };
+    typedef iterator const_iterator;
+
+    CBlockIndexMap() = default;
+    ~CBlockIndexMap() { clear(); }
+
+    CBlockIndexMap(const CBlockIndexMap&) = delete;
+    CBlockIndexMap& operator=(const CBlockIndexMap&) = delete;
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, nSize); }
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const uint256& hash) const
+    {
+        if (vSlots.empty()) return end();
+        const Slot& slot = FindSlot(hash);
+        return slot.nPos ? iterator(this, slot.nPos - 1) : end();
+    }
+
+    size_t count(const uint256& hash) const { return find(hash) != end() ? 1 : 0; }
+
+    /** Insert an entry constructed from args, with phashBlock set, unless there is one with this hash already */
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(const uint256& hash, Args&&... args)
+    {
+        if ((size_t)(nSize + 1) * 10 > vSlots.size() * 7) {
+            Rehash(vSlots.empty() ? INITIAL_SLOTS : 2 * vSlots.size());
+        }
+        Slot& slot = FindSlot(hash);
+        if (slot.nPos) {
+            return std::make_pair(iterator(this, slot.nPos - 1), false);
+        }
+        Entry* entry = new (Allocate()) Entry(hash, std::forward<Args>(args)...);
+        entry->index.phashBlock = &entry->item.first;
+        slot.nTag = (uint32_t)(hash.GetCheapHash() >> 32);
+        slot.nPos = nSize;
+        return std::make_pair(iterator(this, nSize - 1), true);
+    }
+
+    void clear();
+
+    //! Memory used by the entries and the table
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // BITCOIN_BLOCKINDEXMAP_H
@@ -0,0 +1,88 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockview.h>
+
+#include <hash.h>
+#include <streams.h>
+#include <version.h>
+
+// Skips one transaction, following CTransaction::SerializationOp
+static void SkipTransaction(SpanReader& s)
+{
+    int32_t n32bitVersion;
+    s >> n32bitVersion;
+    int16_t nVersion = (int16_t)(n32bitVersion & 0xffff);
+    int16_t nType = (int16_t)((n32bitVersion >> 16) & 0xffff);
+
+    uint64_t nInputs = ReadCompactSize(s);
+    for (uint64_t i = 0; i < nInputs; i++) {
+        s.ignore(32 + 4); // prevout
+        s.ignore(ReadCompactSize(s)); // scriptSig
+        s.ignore(4); // nSequence
+    }
+    uint64_t nOutputs = ReadCompactSize(s);
+    for (uint64_t i = 0; i < nOutputs; i++) {
+        s.ignore(8); // nValue
+        s.ignore(ReadCompactSize(s)); // scriptPubKey
+    }
+    s.ignore(4); // nLockTime
+    if (nVersion == 3 && nType != TRANSACTION_NORMAL) {
+        s.ignore(ReadCompactSize(s)); // vExtraPayload
+    }
+}
+
+CBlockView::CBlockView(std::vector<unsigned char>&& vDataIn) :
+    vData(std::move(vDataIn))
+{
+    SpanReader s(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(vData.data(), vData.size()));
+    s >> header;
+
+    uint64_t nTx = ReadCompactSize(s);
+    // every transaction takes at least 10 bytes, don't reserve for counts which can't fit
+    vTxRanges.reserve(std::min<uint64_t>(nTx, s.size() / 10));
+    for (uint64_t i = 0; i < nTx; i++) {
+        uint32_t nBegin = vData.size() - s.size();
+        SkipTransaction(s);
+        vTxRanges.emplace_back(nBegin, (uint32_t)(vData.size() - s.size()));
+    }
+    if (!s.empty()) {
+        throw std::ios_base::failure("CBlockView: trailing data after the last transaction");
+    }
+    vTxHashes.resize(vTxRanges.size());
+}
+
+Span<const unsigned char> CBlockView::GetTxData(size_t idx) const
+{
+    assert(idx < vTxRanges.size());
+    const auto& range = vTxRanges[idx];
+    return Span<const unsigned char>(vData.data() + range.first, range.second - range.first);
+}
+
+const uint256& CBlockView::GetTxHash(size_t idx) const
+{
+    assert(idx < vTxRanges.size());
+    // a real txid is never null, so null marks a txid which was not hashed yet
+    if (vTxHashes[idx].IsNull()) {
+        auto txData = GetTxData(idx);
+        vTxHashes[idx] = Hash(txData.data(), txData.data() + txData.size());
+    }
+    return vTxHashes[idx];
+}
+
+CTransactionRef CBlockView::GetTx(size_t idx) const
+{
+    auto txData = GetTxData(idx);
+    CMutableTransaction tx;
+    SpanReader(SER_NETWORK, PROTOCOL_VERSION, txData) >> tx;
+    // the range of the transaction was found by walking over exactly the fields deserialized here
+    return std::make_shared<const CTransaction>(std::move(tx), GetTxHash(idx), (unsigned int)txData.size());
+}
+
+CBlock CBlockView::GetBlock() const
+{
+    CBlock block;
+    SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(vData.data(), vData.size())) >> block;
+    return block;
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKVIEW_H
+#define BITCOIN_BLOCKVIEW_H
+
+#include <primitives/block.h>
+#include <span.h>
+
+#include <vector>
+
+/**
+ * Read-only view of a serialized block, for callers which only need the header, the txids or a few transactions.
+ *
+ * Construction parses the header and walks over the transactions to find where each of them starts and ends, without
+ * building any CTransaction. As a block can't contain segwit data, a txid is the double SHA256 of the transaction's
+ * serialization, so txids are hashed from the buffer the first time they are requested and cached afterwards.
+ * Transactions are only deserialized when explicitly asked for with GetTx.
+ *
+ * Not thread-safe, as even the const methods fill the txid cache.
+ */
+class CBlockView
+{
+private:
+    std::vector<unsigned char> vData;
+    CBlockHeader header;
+    // begin and end offset of every transaction in vData
+    std::vector<std::pair<uint32_t, uint32_t>> vTxRanges;
+    mutable std::vector<uint256> vTxHashes;
+
+public:
+    /** Takes the serialized block. Throws std::ios_base::failure if it is not a well-formed block */
+    explicit CBlockView(std::vector<unsigned char>&& vDataIn);
+
+    const CBlockHeader& GetHeader() const { return header; }
+    size_t GetSerializeSize() const { return vData.size(); }
+    const std::vector<unsigned char>& GetData() const { return vData; }
+
+    size_t GetTxCount() const { return vTxRanges.size(); }
+    const uint256& GetTxHash(size_t idx) const;
+    Span<const unsigned char> GetTxData(size_t idx) const;
+    CTransactionRef GetTx(size_t idx) const;
+
+    /** Deserializes the complete block */
+    CBlock GetBlock() const;
+};
+
+#endif // BITCOIN_BLOCKVIEW_H
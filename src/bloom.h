@@ -107,6 +107,13 @@ public:
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
+
+    friend bool operator==(const CBloomFilter& a, const CBloomFilter& b)
+    {
+        return a.nHashFuncs == b.nHashFuncs && a.nTweak == b.nTweak && a.nFlags == b.nFlags &&
+               a.isFull == b.isFull && a.isEmpty == b.isEmpty && a.vData == b.vData;
+    }
+    friend bool operator!=(const CBloomFilter& a, const CBloomFilter& b) { return !(a == b); }
 };
 
 /**
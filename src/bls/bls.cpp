@@ -8,10 +8,13 @@
 #include <tinyformat.h>
 
 #ifndef BUILD_BITCOIN_INTERNAL
+#include <memusage.h>
 #include <support/allocators/mt_pooled_secure.h>
+#include <unordered_lru_cache.h>
 #endif
 
 #include <assert.h>
+#include <limits>
 #include <string.h>
 
 static std::unique_ptr<bls::CoreMPL> pSchemeLegacy(new bls::LegacySchemeMPL);
@@ -349,6 +352,80 @@ bool CBLSSignature::Recover(const std::vector<CBLSSignature>& sigs, const std::v
 
 #ifndef BUILD_BITCOIN_INTERNAL
 
+namespace {
+struct DecompressionCacheHasher
+{
+    const uint64_t k0{GetRand(std::numeric_limits<uint64_t>::max())};
+    const uint64_t k1{GetRand(std::numeric_limits<uint64_t>::max())};
+
+    size_t operator()(const uint256& v) const
+    {
+        return SipHashUint256(k0, k1, v);
+    }
+};
+
+struct DecompressionCache
+{
+    std::mutex mutex;
+    unordered_lru_cache<uint256, CBLSPublicKey, DecompressionCacheHasher> pubKeys{CBLSDecompressionCache::MAX_PUBKEYS};
+    unordered_lru_cache<uint256, CBLSSignature, DecompressionCacheHasher> sigs{CBLSDecompressionCache::MAX_SIGS};
+};
+} // namespace
+
+static DecompressionCache& GetDecompressionCache()
+{
+    // static variable in function scope ensures it's initialized when first accessed
+    static DecompressionCache cache;
+    return cache;
+}
+
+bool CBLSDecompressionCache::Get(const uint256& hash, CBLSPublicKey& objRet)
+{
+    auto& cache = GetDecompressionCache();
+    std::unique_lock<std::mutex> l(cache.mutex);
+    return cache.pubKeys.get(hash, objRet);
+}
+
+bool CBLSDecompressionCache::Get(const uint256& hash, CBLSSignature& objRet)
+{
+    auto& cache = GetDecompressionCache();
+    std::unique_lock<std::mutex> l(cache.mutex);
+    return cache.sigs.get(hash, objRet);
+}
+
+void CBLSDecompressionCache::Put(const uint256& hash, const CBLSPublicKey& obj)
+{
+    auto& cache = GetDecompressionCache();
+    std::unique_lock<std::mutex> l(cache.mutex);
+    cache.pubKeys.insert(hash, obj);
+}
+
+void CBLSDecompressionCache::Put(const uint256& hash, const CBLSSignature& obj)
+{
+    auto& cache = GetDecompressionCache();
+    std::unique_lock<std::mutex> l(cache.mutex);
+    cache.sigs.insert(hash, obj);
+}
+
+size_t CBLSDecompressionCache::GetMemoryUsage()
+{
+    // key, object and access counter plus the unordered_map node overhead (next pointer and cached hash)
+    static const size_t pubKeyEntrySize = memusage::MallocUsage(sizeof(uint256) + sizeof(CBLSPublicKey) + sizeof(int64_t) + 2 * sizeof(void*));
+    static const size_t sigEntrySize = memusage::MallocUsage(sizeof(uint256) + sizeof(CBLSSignature) + sizeof(int64_t) + 2 * sizeof(void*));
+
+    auto& cache = GetDecompressionCache();
+    std::unique_lock<std::mutex> l(cache.mutex);
+    return cache.pubKeys.size() * (pubKeyEntrySize + sizeof(void*)) + cache.sigs.size() * (sigEntrySize + sizeof(void*));
+}
+
+void CBLSDecompressionCache::Clear()
+{
+    auto& cache = GetDecompressionCache();
+    std::unique_lock<std::mutex> l(cache.mutex);
+    cache.pubKeys.clear();
+    cache.sigs.clear();
+}
+
 static std::once_flag init_flag;
 static mt_pooled_secure_allocator<uint8_t>* secure_allocator_instance;
 static void create_secure_allocator()
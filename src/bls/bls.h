@@ -293,6 +293,31 @@ public:
 };
 
 #ifndef BUILD_BITCOIN_INTERNAL
+// Process wide and bounded cache of decompressed (deserialized and malleability checked) public keys and signatures,
+// keyed by the hash of the serialized object. It's used by CBLSLazyWrapper, so that objects which are received or
+// copied multiple times (e.g. recovered sigs and islocks received from multiple peers) are only decompressed once.
+// Lazy objects are always created with fLegacyDefault, so the serialized form is sufficient as key.
+// Secret keys are cheap to deserialize and should not be kept around longer than needed, so they are never cached.
+class CBLSDecompressionCache
+{
+public:
+    static const size_t MAX_PUBKEYS = 8192;
+    static const size_t MAX_SIGS = 8192;
+
+    static bool Get(const uint256& hash, CBLSPublicKey& objRet);
+    static bool Get(const uint256& hash, CBLSSignature& objRet);
+    template<typename BLSObject>
+    static bool Get(const uint256& hash, BLSObject& objRet) { return false; }
+
+    static void Put(const uint256& hash, const CBLSPublicKey& obj);
+    static void Put(const uint256& hash, const CBLSSignature& obj);
+    template<typename BLSObject>
+    static void Put(const uint256& hash, const BLSObject& obj) {}
+
+    static size_t GetMemoryUsage();
+    static void Clear();
+};
+
 template<typename BLSObject>
 class CBLSLazyWrapper
 {
@@ -369,6 +394,16 @@ public:
         hash.SetNull();
     }
 
+    // Sets the serialized form, buf must point to BLSObject::SerSize bytes
+    void SetBuf(const uint8_t* buf)
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        std::copy(buf, buf + BLSObject::SerSize, vecBytes.begin());
+        bufValid = true;
+        objInitialized = false;
+        hash.SetNull();
+    }
+
     void Set(const BLSObject& _obj)
     {
         std::unique_lock<std::mutex> l(mutex);
@@ -385,6 +420,15 @@ public:
             return invalidObj;
         }
         if (!objInitialized) {
+            if (hash.IsNull()) {
+                CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+                ss.write((const char*)vecBytes.data(), vecBytes.size());
+                hash = ss.GetHash();
+            }
+            if (CBLSDecompressionCache::Get(hash, obj)) {
+                objInitialized = true;
+                return obj;
+            }
             obj.SetByteVector(vecBytes);
             if (!obj.CheckMalleable(vecBytes)) {
                 bufValid = false;
@@ -392,6 +436,9 @@ public:
                 obj = invalidObj;
             } else {
                 objInitialized = true;
+                if (obj.IsValid()) {
+                    CBLSDecompressionCache::Put(hash, obj);
+                }
             }
         }
         return obj;
@@ -6,7 +6,9 @@
 #define DASH_CRYPTO_BLS_BATCHVERIFIER_H
 
 #include <bls/bls.h>
+#include <bls/bls_worker.h>
 
+#include <list>
 #include <map>
 #include <vector>
 
@@ -97,29 +99,58 @@ public:
                 badSources.emplace(p.first);
 
                 if (perMessageFallback) {
-                    // revert to per-message verification
-                    if (p.second.size() == 1) {
-                        // no need to re-verify a single message
-                        badMessages.emplace(p.second[0]->second.msgId);
-                    } else {
-                        for (const auto& msgIt : p.second) {
-                            if (badMessages.count(msgIt->first)) {
-                                // same message might be invalid from different source, so no need to re-verify it
-                                continue;
-                            }
-
-                            const auto& msg = msgIt->second;
-                            if (!msg.sig.VerifyInsecure(msg.pubKey, msg.msgHash)) {
-                                badMessages.emplace(msg.msgId);
-                            }
-                        }
-                    }
+                    // we already know that the whole batch of this source is invalid, so no need to re-verify it
+                    FindBadMessages(p.second, 0, p.second.size(), true);
                 }
             }
         }
     }
 
 private:
+    // Finds the invalid messages in the given range by splitting it in halves and verifying each half in batched form.
+    // When only a few messages of a large batch are invalid, this requires far fewer pairings than verifying every
+    // message individually. knownInvalid must only be true if the whole range is already known to be invalid
+    void FindBadMessages(const std::vector<MessageMapIterator>& msgIts, size_t start, size_t count, bool knownInvalid)
+    {
+        if (count == 0) {
+            return;
+        }
+
+        if (count == 1) {
+            const auto& msg = msgIts[start]->second;
+            if (badMessages.count(msg.msgId)) {
+                // same message might be invalid from different source, so no need to re-verify it
+                return;
+            }
+            if (knownInvalid || !msg.sig.VerifyInsecure(msg.pubKey, msg.msgHash)) {
+                badMessages.emplace(msg.msgId);
+            }
+            return;
+        }
+
+        if (!knownInvalid && VerifyRange(msgIts, start, count)) {
+            return;
+        }
+
+        size_t half = count / 2;
+        if (VerifyRange(msgIts, start, half)) {
+            // the first half is fine, so the invalid message(s) must be in the second half
+            FindBadMessages(msgIts, start + half, count - half, true);
+        } else {
+            FindBadMessages(msgIts, start, half, true);
+            FindBadMessages(msgIts, start + half, count - half, false);
+        }
+    }
+
+    bool VerifyRange(const std::vector<MessageMapIterator>& msgIts, size_t start, size_t count)
+    {
+        std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
+        for (size_t i = start; i < start + count; i++) {
+            byMessageHash[msgIts[i]->second.msgHash].emplace_back(msgIts[i]);
+        }
+        return VerifyBatch(byMessageHash);
+    }
+
     // All Verify methods take ownership of the passed byMessageHash map and thus might modify the map. This is to avoid
     // unnecessary copies
 
@@ -237,4 +268,93 @@ private:
     }
 };
 
+// Distributes messages over multiple CBLSBatchVerifier batches and verifies these in parallel on the BLS worker
+// threads. Messages are grouped into batches by a caller provided key (e.g. the quorum hash) and each batch holds at
+// most maxBatchSize messages. Results of all batches are merged into badSources and badMessages
+template<typename SourceId, typename MessageId, typename BatchKey>
+class CBLSParallelBatchVerifier
+{
+private:
+    typedef CBLSBatchVerifier<SourceId, MessageId> BatchVerifier;
+
+    CBLSWorker& worker;
+    bool secureVerification;
+    bool perMessageFallback;
+    size_t maxBatchSize;
+
+    struct Batch {
+        BatchVerifier verifier;
+        size_t count{0};
+
+        Batch(bool _secureVerification, bool _perMessageFallback) :
+                verifier(_secureVerification, _perMessageFallback) {}
+    };
+
+    // a std::list is used as CBLSBatchVerifier internally holds iterators into its own maps and thus must not be moved
+    std::list<Batch> batches;
+    std::map<BatchKey, Batch*> openBatches;
+    std::set<SourceId> sources;
+
+public:
+    std::set<SourceId> badSources;
+    std::set<MessageId> badMessages;
+
+public:
+    CBLSParallelBatchVerifier(CBLSWorker& _worker, bool _secureVerification, bool _perMessageFallback, size_t _maxBatchSize) :
+            worker(_worker),
+            secureVerification(_secureVerification),
+            perMessageFallback(_perMessageFallback),
+            maxBatchSize(_maxBatchSize)
+    {
+        assert(maxBatchSize != 0);
+    }
+
+    void PushMessage(const BatchKey& batchKey, const SourceId& sourceId, const MessageId& msgId, const uint256& msgHash, const CBLSSignature& sig, const CBLSPublicKey& pubKey)
+    {
+        auto& batch = openBatches[batchKey];
+        if (batch == nullptr || batch->count >= maxBatchSize) {
+            batches.emplace_back(secureVerification, perMessageFallback);
+            batch = &batches.back();
+        }
+        batch->verifier.PushMessage(sourceId, msgId, msgHash, sig, pubKey);
+        batch->count++;
+        sources.emplace(sourceId);
+    }
+
+    size_t GetBatchCount() const
+    {
+        return batches.size();
+    }
+
+    size_t GetUniqueSourceCount() const
+    {
+        return sources.size();
+    }
+
+    void Verify()
+    {
+        if (batches.size() == 1) {
+            // no need to involve the worker threads
+            batches.front().verifier.Verify();
+        } else {
+            std::vector<std::future<void>> futures;
+            futures.reserve(batches.size());
+            for (auto& batch : batches) {
+                auto* v = &batch.verifier;
+                futures.emplace_back(worker.AsyncRun([v]() {
+                    v->Verify();
+                }));
+            }
+            for (auto& f : futures) {
+                f.get();
+            }
+        }
+
+        for (const auto& batch : batches) {
+            badSources.insert(batch.verifier.badSources.begin(), batch.verifier.badSources.end());
+            badMessages.insert(batch.verifier.badMessages.begin(), batch.verifier.badMessages.end());
+        }
+    }
+};
+
 #endif //DASH_CRYPTO_BLS_BATCHVERIFIER_H
@@ -72,6 +72,24 @@ void CBLSWorker::Stop()
     workerPool.stop(true);
 }
 
+size_t CBLSWorker::GetWorkerCount()
+{
+    return (size_t)workerPool.size();
+}
+
+std::future<void> CBLSWorker::AsyncRun(std::function<void()> job)
+{
+    if (workerPool.size() == 0) {
+        std::promise<void> p;
+        job();
+        p.set_value();
+        return p.get_future();
+    }
+    return workerPool.push([job](int threadId) {
+        job();
+    });
+}
+
 bool CBLSWorker::GenerateContributions(int quorumThreshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skSharesRet)
 {
     BLSSecretKeyVectorPtr svec = std::make_shared<BLSSecretKeyVector>((size_t)quorumThreshold);
@@ -118,6 +136,41 @@ bool CBLSWorker::GenerateContributions(int quorumThreshold, const BLSIdVector& i
     return success;
 }
 
+bool CBLSWorker::EncryptContributions(const BLSPublicKeyVector& recipients, const BLSSecretKeyVector& skShares, int nVersion,
+                                      CBLSIESMultiRecipientObjects<CBLSSecretKey>& encryptedRet)
+{
+    if (recipients.size() != skShares.size()) {
+        return false;
+    }
+
+    encryptedRet.InitEncrypt(recipients.size());
+
+    std::list<std::future<bool> > futures;
+    size_t batchSize = 8;
+
+    // every job only writes the blobs of its own batch
+    for (size_t i = 0; i < recipients.size(); i += batchSize) {
+        size_t start = i;
+        size_t count = std::min(batchSize, recipients.size() - start);
+        auto f = [&, start, count](int threadId) {
+            for (size_t j = start; j < start + count; j++) {
+                if (!encryptedRet.Encrypt(j, recipients[j], skShares[j], nVersion)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        futures.emplace_back(workerPool.push(f));
+    }
+    bool success = true;
+    for (auto& f : futures) {
+        if (!f.get()) {
+            success = false;
+        }
+    }
+    return success;
+}
+
 // aggregates a single vector of BLS objects in parallel
 // the input vector is split into batches and each batch is aggregated in parallel
 // when enough batches are finished to form a new batch, the new batch is queued for further parallel aggregation
@@ -6,8 +6,10 @@
 #define DASH_CRYPTO_BLS_WORKER_H
 
 #include <bls/bls.h>
+#include <bls/bls_ies.h>
 
 #include <ctpl.h>
+#include <memusage.h>
 
 #include <future>
 #include <mutex>
@@ -56,8 +58,20 @@ public:
     void Start();
     void Stop();
 
+    size_t GetWorkerCount();
+
+    // Runs a generic job on the worker pool. Used by callers which implement their own batching (e.g. with
+    // CBLSBatchVerifier) and only want to spread these batches over the worker threads. If the worker pool
+    // was not started (e.g. in unit tests), the job is executed synchronously
+    std::future<void> AsyncRun(std::function<void()> job);
+
     bool GenerateContributions(int threshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skSharesRet);
 
+    // Encrypts skShares[i] for recipients[i]. The ECDH and AES encryption of every recipient only depend on the
+    // ephemeral key and IVs prepared upfront by InitEncrypt, so batches of recipients are encrypted in parallel
+    bool EncryptContributions(const BLSPublicKeyVector& recipients, const BLSSecretKeyVector& skShares, int nVersion,
+                              CBLSIESMultiRecipientObjects<CBLSSecretKey>& encryptedRet);
+
     // The following functions are all used to aggregate verification (public key) vectors
     // Inputs are in the following form:
     //   [
@@ -180,7 +194,27 @@ public:
         });
     }
 
+    // Memory used by the cached results. Verification vectors are only counted once they are built
+    size_t DynamicMemoryUsage()
+    {
+        std::lock_guard<std::mutex> lock(cacheCs);
+        size_t usage = CacheDynamicUsage(vvecCache) + CacheDynamicUsage(secretKeyShareCache) + CacheDynamicUsage(publicKeyShareCache);
+        for (const auto& p : vvecCache) {
+            if (p.second.wait_for(std::chrono::seconds(0)) == std::future_status::ready && p.second.get()) {
+                usage += memusage::DynamicUsage(p.second.get()) + memusage::DynamicUsage(*p.second.get());
+            }
+        }
+        return usage;
+    }
+
 private:
+    template <typename T>
+    static size_t CacheDynamicUsage(const std::map<uint256, std::shared_future<T> >& cache)
+    {
+        // every future has its shared state on the heap
+        return memusage::DynamicUsage(cache) + cache.size() * memusage::MallocUsage(sizeof(T) + sizeof(memusage::stl_shared_counter));
+    }
+
     template <typename T, typename Builder>
     T GetOrBuild(const uint256& cacheKey, std::map<uint256, std::shared_future<T> >& cache, Builder&& builder)
     {
@@ -5,10 +5,12 @@
 #ifndef BITCOIN_CACHEMAP_H
 #define BITCOIN_CACHEMAP_H
 
-#include <map>
+#include <functional>
 #include <list>
 #include <cstddef>
+#include <unordered_map>
 
+#include <memusage.h>
 #include <serialize.h>
 
 /**
@@ -41,8 +43,12 @@ struct CacheItem
 
 /**
  * Map like container that keeps the N most recently added items
+ *
+ * Items are kept in a list ordered by insertion time and indexed by a hash map, so that all
+ * operations except RebuildIndex are O(1). The serialized format only consists of the max
+ * size and the item list.
  */
-template<typename K, typename V, typename Size = uint32_t>
+template<typename K, typename V, typename Size = uint32_t, typename Hasher = std::hash<K>>
 class CacheMap
 {
 public:
@@ -56,7 +62,7 @@ public:
 
     typedef typename list_t::const_iterator list_cit;
 
-    typedef std::map<K, list_it> map_t;
+    typedef std::unordered_map<K, list_it, Hasher> map_t;
 
     typedef typename map_t::iterator map_it;
 
@@ -76,7 +82,7 @@ public:
           mapIndex()
     {}
 
-    CacheMap(const CacheMap<K,V>& other)
+    CacheMap(const CacheMap& other)
         : nMaxSize(other.nMaxSize),
           listItems(other.listItems),
           mapIndex()
@@ -146,7 +152,13 @@ public:
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    /** Memory used by the list and the index, not including memory owned by the keys and values themselves */
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(listItems) + memusage::DynamicUsage(mapIndex);
+    }
+
+    CacheMap& operator=(const CacheMap& other)
     {
         nMaxSize = other.nMaxSize;
         listItems = other.listItems;
@@ -180,6 +192,7 @@ private:
     void RebuildIndex()
     {
         mapIndex.clear();
+        mapIndex.reserve(listItems.size());
         for(list_it it = listItems.begin(); it != listItems.end(); ++it) {
             mapIndex.emplace(it->key, it);
         }
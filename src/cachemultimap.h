@@ -6,18 +6,24 @@
 #define BITCOIN_CACHEMULTIMAP_H
 
 #include <cstddef>
+#include <functional>
 #include <map>
 #include <list>
 #include <set>
+#include <unordered_map>
 
+#include <memusage.h>
 #include <serialize.h>
 
 #include <cachemap.h>
 
 /**
  * Map like container that keeps the N most recently added items
+ *
+ * Same as CacheMap, but multiple (distinct) values can be stored for the same key. They are
+ * returned ordered by value.
  */
-template<typename K, typename V, typename Size = uint32_t>
+template<typename K, typename V, typename Size = uint32_t, typename Hasher = std::hash<K>>
 class CacheMultiMap
 {
 public:
@@ -37,7 +43,7 @@ public:
 
     typedef typename it_map_t::const_iterator it_map_cit;
 
-    typedef std::map<K, it_map_t> map_t;
+    typedef std::unordered_map<K, it_map_t, Hasher> map_t;
 
     typedef typename map_t::iterator map_it;
 
@@ -57,7 +63,7 @@ public:
           mapIndex()
     {}
 
-    CacheMultiMap(const CacheMap<K,V>& other)
+    CacheMultiMap(const CacheMultiMap& other)
         : nMaxSize(other.nMaxSize),
           listItems(other.listItems),
           mapIndex()
@@ -184,7 +190,15 @@ public:
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    /** Memory used by the list and the indexes, not including memory owned by the keys and values themselves */
+    size_t DynamicMemoryUsage() const
+    {
+        // every item has exactly one entry in one of the per key maps
+        return memusage::DynamicUsage(listItems) + memusage::DynamicUsage(mapIndex) +
+               memusage::MallocUsage(sizeof(memusage::stl_tree_node<typename it_map_t::value_type>)) * listItems.size();
+    }
+
+    CacheMultiMap& operator=(const CacheMultiMap& other)
     {
         nMaxSize = other.nMaxSize;
         listItems = other.listItems;
@@ -223,7 +237,7 @@ private:
             mapIt.erase(item.value);
 
             if(mapIt.empty()) {
-                mapIndex.erase(item.key);
+                mapIndex.erase(mit);
             }
         }
 
@@ -8,6 +8,10 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,13 +29,32 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker (and the master) owns a slot with its own deque of checks,
+  * protected by its own mutex. Added checks are spread over the slots, each
+  * worker takes batches from the back of its own deque and steals from the
+  * front of the other deques when it runs out of work. This avoids that all
+  * workers contend on a single mutex for every batch. The sleep mutex is only
+  * taken when workers run out of work or the master has to be woken up.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
-    boost::mutex mutex;
+    //! A deque of checks owned by one worker, which others may steal from
+    struct WorkSlot {
+        std::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! Number of slots, workers beyond that share slots with others
+    static const int MAX_SLOTS = 64;
+
+    //! The slots, slot 0 belongs to the master
+    std::vector<std::unique_ptr<WorkSlot>> vSlots;
+
+    //! Mutex for sleeping workers and the master, only used together with the condition variables
+    boost::mutex mutexSleep;
 
     //! Worker threads block on this when out of work
     boost::condition_variable condWorker;
@@ -39,87 +62,122 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of worker threads (excluding the master) which called Thread().
+    std::atomic<int> nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of workers (excluding the master) that are about to sleep or sleeping.
+    std::atomic<int> nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
+
+    //! Number of verifications which are in one of the deques. May be temporarily negative while checks are added.
+    std::atomic<int> nQueued;
+
+    //! Used to spread small additions over the slots
+    std::atomic<unsigned int> nNextSlot;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    int NumActiveSlots() const
+    {
+        return std::min(nWorkers.load() + 1, MAX_SLOTS);
+    }
+
+    /** Move up to nBatchSize checks from slot into vChecks, from the back for the owner and from the front for thieves. */
+    bool TakeFromSlot(WorkSlot& slot, bool fOwner, std::vector<T>& vChecks)
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (slot.checks.empty()) {
+            return false;
+        }
+        // Take half of the remaining checks, so the owner and thieves finish approximately simultaneously
+        const unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)(slot.checks.size() + 1) / 2));
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            // swap instead of copying, so the slot's mutex is held as shortly as possible
+            if (fOwner) {
+                vChecks[i].swap(slot.checks.back());
+                slot.checks.pop_back();
+            } else {
+                vChecks[i].swap(slot.checks.front());
+                slot.checks.pop_front();
+            }
+        }
+        nQueued -= nNow;
+        return true;
+    }
+
+    /** Get a batch of work, first from our own slot, then from the others. */
+    bool TakeWork(int nSlot, std::vector<T>& vChecks)
+    {
+        if (TakeFromSlot(*vSlots[nSlot], true, vChecks)) {
+            return true;
+        }
+        const int nActive = NumActiveSlots();
+        for (int i = 1; i < nActive; i++) {
+            if (TakeFromSlot(*vSlots[(nSlot + i) % nActive], false, vChecks)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(int nSlot, bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
+            if (!TakeWork(nSlot, vChecks)) {
+                if (nQueued > 0) {
+                    // some checks were just added or stolen by someone else, look again
+                    continue;
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
+                boost::unique_lock<boost::mutex> lock(mutexSleep);
+                if (fMaster) {
+                    if (nTodo == 0) {
+                        // all checks are done (and destructed), return the result and reset the status for new work later
+                        return fAllOk.exchange(true);
+                    }
+                    if (nQueued <= 0) {
+                        condMaster.wait(lock);
                     }
+                } else {
                     nIdle++;
-                    cond.wait(lock); // wait
+                    // Add() increments nQueued before looking at nIdle, so we either see the new checks or get notified
+                    if (nQueued <= 0) {
+                        condWorker.wait(lock);
+                    }
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
+            // Check whether we need to do work at all
+            bool fOk = fAllOk;
             // execute work
             for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
+            const unsigned int nNow = vChecks.size();
+            // destruct the checks before reporting them as done, Wait() must only return once they are all gone
             vChecks.clear();
+            if (!fOk) {
+                fAllOk = false;
+            }
+            if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutexSleep);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
@@ -128,33 +186,58 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nIdle(0), fAllOk(true), nTodo(0), nQueued(0), nNextSlot(0), nBatchSize(nBatchSizeIn)
+    {
+        vSlots.reserve(MAX_SLOTS);
+        for (int i = 0; i < MAX_SLOTS; i++) {
+            vSlots.emplace_back(new WorkSlot());
+        }
+    }
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        const int nWorker = nWorkers++;
+        // slot 0 belongs to the master
+        Loop(1 + nWorker % (MAX_SLOTS - 1));
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vChecks.empty()) {
+            return;
         }
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        // Spread the checks over the slots in contiguous ranges, starting at a rotating slot so that many small
+        // additions are spread as well
+        const unsigned int nActive = NumActiveSlots();
+        const unsigned int nParts = std::min<unsigned int>(nActive, vChecks.size());
+        const unsigned int nFirstSlot = nNextSlot.fetch_add(nParts);
+        size_t nPos = 0;
+        for (unsigned int nPart = 0; nPart < nParts; nPart++) {
+            const size_t nEnd = vChecks.size() * (nPart + 1) / nParts;
+            WorkSlot& slot = *vSlots[(nFirstSlot + nPart) % nActive];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            for (; nPos < nEnd; nPos++) {
+                slot.checks.emplace_back();
+                slot.checks.back().swap(vChecks[nPos]);
+            }
+        }
+        nQueued += vChecks.size();
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutexSleep);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
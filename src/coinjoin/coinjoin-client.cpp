@@ -11,6 +11,7 @@
 #include <masternode/masternode-payments.h>
 #include <masternode/masternode-sync.h>
 #include <masternode/masternode-meta.h>
+#include <memusage.h>
 #include <netmessagemaker.h>
 #include <script/sign.h>
 #include <txmempool.h>
@@ -28,7 +29,7 @@ std::map<const std::string, std::shared_ptr<CCoinJoinClientManager>> coinJoinCli
 CCoinJoinClientQueueManager coinJoinClientQueueManager;
 
 
-void CCoinJoinClientQueueManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61)
+void CCoinJoinClientQueueManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
 {
     if (fMasternodeMode) return;
     if (!CCoinJoinClientOptions::IsEnabled()) return;
@@ -53,75 +54,84 @@ void CCoinJoinClientQueueManager::ProcessMessage(CNode* pfrom, const std::string
         CCoinJoinQueue dsq;
         vRecv >> dsq;
 
-        {
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
+        ProcessDSQueue(pfrom->GetId(), dsq, connman);
+    }
+}
 
-            // process every dsq only once
-            for (const auto& q : vecCoinJoinQueue) {
-                if (q == dsq) {
-                    return;
-                }
-                if (q.fReady == dsq.fReady && q.masternodeOutpoint == dsq.masternodeOutpoint) {
-                    // no way the same mn can send another dsq with the same readiness this soon
-                    LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %s is sending WAY too many dsq messages for a masternode with collateral %s\n", pfrom->GetLogString(), dsq.masternodeOutpoint.ToStringShort());
-                    return;
-                }
-            }
-        } // cs_vecqueue
+void CCoinJoinClientQueueManager::ProcessDSQueue(NodeId nodeId, CCoinJoinQueue dsq, CConnman& connman)
+{
+    {
+        TRY_LOCK(cs_vecqueue, lockRecv);
+        if (!lockRecv) return;
 
-        LogPrint(BCLog::COINJOIN, "DSQUEUE -- %s new\n", dsq.ToString());
+        // process every dsq only once
+        for (const auto& q : vecCoinJoinQueue) {
+            if (q == dsq) {
+                return;
+            }
+            if (q.fReady == dsq.fReady && q.masternodeOutpoint == dsq.masternodeOutpoint) {
+                // no way the same mn can send another dsq with the same readiness this soon
+                LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %d is sending WAY too many dsq messages for a masternode with collateral %s\n", nodeId, dsq.masternodeOutpoint.ToStringShort());
+                return;
+            }
+        }
+    } // cs_vecqueue
 
-        if (dsq.IsTimeOutOfBounds()) return;
+    if (dsq.IsTimeOutOfBounds()) return;
 
-        auto mnList = deterministicMNManager->GetListAtChainTip();
-        auto dmn = mnList.GetValidMNByCollateral(dsq.masternodeOutpoint);
-        if (!dmn) return;
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+    auto dmn = mnList.GetValidMNByCollateral(dsq.masternodeOutpoint);
+    if (!dmn) return;
 
-        if (!dsq.CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 10);
-            return;
-        }
+    // unless it was verified recently, the signature is verified in a batch and the dsq is processed again afterwards
+    if (!CheckOrQueueDsqSignature(nodeId, dsq, dmn->pdmnState->pubKeyOperator.Get())) {
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- %s new\n", dsq.ToString());
+        return;
+    }
 
-        // if the queue is ready, submit if we can
-        if (dsq.fReady) {
-            for (auto& pair : coinJoinClientManagers) {
-                if (pair.second->TrySubmitDenominate(dmn->pdmnState->addr, connman)) {
-                    LogPrint(BCLog::COINJOIN, "DSQUEUE -- CoinJoin queue (%s) is ready on masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
-                    return;
-                }
-            }
-        } else {
-            int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
-            int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
-            // don't allow a few nodes to dominate the queuing process
-            if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
-                LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->proTxHash.ToString());
+    // if the queue is ready, submit if we can
+    if (dsq.fReady) {
+        for (auto& pair : coinJoinClientManagers) {
+            if (pair.second->TrySubmitDenominate(dmn->pdmnState->addr, connman)) {
+                LogPrint(BCLog::COINJOIN, "DSQUEUE -- CoinJoin queue (%s) is ready on masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
                 return;
             }
+        }
+    } else {
+        int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
+        int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
+        // don't allow a few nodes to dominate the queuing process
+        if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
+            LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->proTxHash.ToString());
+            return;
+        }
 
-            mmetaman.AllowMixing(dmn->proTxHash);
+        mmetaman.AllowMixing(dmn->proTxHash);
 
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
 
-            for (const auto& pair : coinJoinClientManagers) {
-                if (pair.second->MarkAlreadyJoinedQueueAsTried(dsq)) {
-                    break;
-                }
+        for (const auto& pair : coinJoinClientManagers) {
+            if (pair.second->MarkAlreadyJoinedQueueAsTried(dsq)) {
+                break;
             }
-
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-            vecCoinJoinQueue.push_back(dsq);
-            dsq.Relay(connman);
         }
 
+        TRY_LOCK(cs_vecqueue, lockRecv);
+        if (!lockRecv) return;
+        vecCoinJoinQueue.push_back(dsq);
+        dsq.Relay(connman);
     }
 }
 
-void CCoinJoinClientManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61)
+void CCoinJoinClientQueueManager::ProcessPendingDsqs(CConnman& connman)
+{
+    for (const auto& p : VerifyPendingDsqs()) {
+        ProcessDSQueue(p.first, p.second, connman);
+    }
+}
+
+void CCoinJoinClientManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
 {
     if (fMasternodeMode) return;
     if (!CCoinJoinClientOptions::IsEnabled()) return;
@@ -144,7 +154,7 @@ void CCoinJoinClientManager::ProcessMessage(CNode* pfrom, const std::string& str
     }
 }
 
-void CCoinJoinClientSession::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61)
+void CCoinJoinClientSession::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
 {
     if (fMasternodeMode) return;
     if (!CCoinJoinClientOptions::IsEnabled()) return;
@@ -384,6 +394,16 @@ bool CCoinJoinClientManager::GetMixingMasternodesInfo(std::vector<CDeterministic
     return !vecDmnsRet.empty();
 }
 
+size_t CCoinJoinClientManager::GetMemoryUsage() const
+{
+    LOCK(cs_deqsessions);
+    size_t usage = memusage::DynamicUsage(vecMasternodesUsed) + deqSessions.size() * sizeof(CCoinJoinClientSession);
+    for (const auto& session : deqSessions) {
+        usage += session.GetEntriesMemoryUsage();
+    }
+    return usage;
+}
+
 //
 // Check session timeouts
 //
@@ -585,7 +605,8 @@ bool CCoinJoinClientSession::SignFinalTransaction(const CTransaction& finalTrans
 
     // STEP 2: make sure our own inputs/outputs are present, otherwise refuse to sign
 
-    std::vector<CTxIn> sigs;
+    // pairs of input index and spent output
+    std::vector<std::pair<unsigned int, CTxOut>> vecMyInputs;
 
     for (const auto& entry : vecEntries) {
         // Check that the final transaction has all our outputs
@@ -631,17 +652,29 @@ bool CCoinJoinClientSession::SignFinalTransaction(const CTransaction& finalTrans
                 return false;
             }
 
-            LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- Signing my input %i\n", __func__, nMyInputIndex);
             // TODO we're using amount=0 here but we should use the correct amount. This works because Dash ignores the amount while signing/verifying (only used in Bitcoin/Segwit)
-            if (!SignSignature(mixingWallet, prevPubKey, finalMutableTransaction, nMyInputIndex, 0, int(SIGHASH_ALL | SIGHASH_ANYONECANPAY))) { // changes scriptSig
-                LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- Unable to sign my own transaction!\n", __func__);
-                // not sure what to do here, it will timeout...?
-            }
+            vecMyInputs.emplace_back(nMyInputIndex, CTxOut(0, prevPubKey));
+        }
+    }
 
-            sigs.push_back(finalMutableTransaction.vin[nMyInputIndex]);
-            LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- nMyInputIndex: %d, sigs.size(): %d, scriptSig=%s\n",
-                    __func__, nMyInputIndex, (int)sigs.size(), ScriptToAsmStr(finalMutableTransaction.vin[nMyInputIndex].scriptSig));
+    // Sign all of our inputs at once, sessions with many inputs are signed in parallel
+    std::set<unsigned int> setFailed;
+    {
+        LOCK(mixingWallet.cs_wallet);
+        mixingWallet.SignTransactionInputs(finalMutableTransaction, vecMyInputs, int(SIGHASH_ALL | SIGHASH_ANYONECANPAY), &setFailed); // changes scriptSig
+    }
+
+    std::vector<CTxIn> sigs;
+    for (const auto& myInput : vecMyInputs) {
+        const unsigned int nMyInputIndex = myInput.first;
+        if (setFailed.count(nMyInputIndex)) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- Unable to sign my own transaction! nMyInputIndex: %d\n", __func__, nMyInputIndex);
+            // not sure what to do here, it will timeout...?
         }
+
+        sigs.push_back(finalMutableTransaction.vin[nMyInputIndex]);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- nMyInputIndex: %d, sigs.size(): %d, scriptSig=%s\n",
+                __func__, nMyInputIndex, (int)sigs.size(), ScriptToAsmStr(finalMutableTransaction.vin[nMyInputIndex].scriptSig));
     }
 
     if (sigs.empty()) {
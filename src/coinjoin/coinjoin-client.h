@@ -129,7 +129,7 @@ public:
     {
     }
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61);
 
     void UnlockCoins();
 
@@ -157,9 +157,14 @@ public:
 class CCoinJoinClientQueueManager : public CCoinJoinBaseManager
 {
 public:
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    /// Verify the signatures of the queued DSQUEUE messages in a batch and process the valid ones
+    void ProcessPendingDsqs(CConnman& connman);
 
     void DoMaintenance();
+
+private:
+    void ProcessDSQueue(NodeId nodeId, CCoinJoinQueue dsq, CConnman& connman);
 };
 
 /** Used to keep track of current status of mixing pool
@@ -211,7 +216,7 @@ public:
     {
     }
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61);
 
     bool StartMixing();
     void StopMixing();
@@ -223,6 +228,8 @@ public:
 
     bool GetMixingMasternodesInfo(std::vector<CDeterministicMNCPtr>& vecDmnsRet) const;
 
+    size_t GetMemoryUsage() const;
+
     /// Passively run mixing in the background according to the configuration in settings
     bool DoAutomaticDenominating(CConnman& connman, bool fDryRun = false);
 
@@ -25,7 +25,20 @@
 
 CCoinJoinServer coinJoinServer;
 
-void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61)
+void CCoinJoinServer::Start()
+{
+    int workerCount = std::max(1, std::min(GetNumCores() / 2, 4));
+    workerPool.resize(workerCount);
+    RenameThreadPool(workerPool, "dash-cj-srv");
+}
+
+void CCoinJoinServer::Stop()
+{
+    workerPool.clear_queue();
+    workerPool.stop(true);
+}
+
+void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
 {
     if (!fMasternodeMode) return;
     if (!masternodeSync.IsBlockchainSynced()) return;
@@ -117,55 +130,7 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
         CCoinJoinQueue dsq;
         vRecv >> dsq;
 
-        {
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-
-            // process every dsq only once
-            for (const auto& q : vecCoinJoinQueue) {
-                if (q == dsq) {
-                    return;
-                }
-                if (q.fReady == dsq.fReady && q.masternodeOutpoint == dsq.masternodeOutpoint) {
-                    // no way the same mn can send another dsq with the same readiness this soon
-                    LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %s is sending WAY too many dsq messages for a masternode with collateral %s\n", pfrom->GetLogString(), dsq.masternodeOutpoint.ToStringShort());
-                    return;
-                }
-            }
-        } // cs_vecqueue
-
-        LogPrint(BCLog::COINJOIN, "DSQUEUE -- %s new\n", dsq.ToString());
-
-        if (dsq.IsTimeOutOfBounds()) return;
-
-        auto mnList = deterministicMNManager->GetListAtChainTip();
-        auto dmn = mnList.GetValidMNByCollateral(dsq.masternodeOutpoint);
-        if (!dmn) return;
-
-        if (!dsq.CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 10);
-            return;
-        }
-
-        if (!dsq.fReady) {
-            int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
-            int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
-            //don't allow a few nodes to dominate the queuing process
-            if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
-                LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->pdmnState->addr.ToString());
-                return;
-            }
-            mmetaman.AllowMixing(dmn->proTxHash);
-
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
-
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-            vecCoinJoinQueue.push_back(dsq);
-            dsq.Relay(connman);
-        }
+        ProcessDSQueue(pfrom->GetId(), dsq, connman);
 
     } else if (strCommand == NetMsgType::DSVIN) {
         if (pfrom->nVersion < MIN_COINJOIN_PEER_PROTO_VERSION) {
@@ -218,20 +183,72 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
 
         LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
-        int nTxInIndex = 0;
-        int nTxInsCount = (int)vecTxIn.size();
+        if (!AddScriptSigs(vecTxIn)) {
+            LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSigs() failed, session: %d\n", nSessionID);
+            RelayStatus(STATUS_REJECTED, connman);
+            return;
+        }
+        LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSigs() %d success\n", vecTxIn.size());
+        // all is good
+        CheckPool(connman);
+    }
+}
 
-        for (const auto& txin : vecTxIn) {
-            nTxInIndex++;
-            if (!AddScriptSig(txin)) {
-                LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED, connman);
+void CCoinJoinServer::ProcessDSQueue(NodeId nodeId, CCoinJoinQueue dsq, CConnman& connman)
+{
+    {
+        TRY_LOCK(cs_vecqueue, lockRecv);
+        if (!lockRecv) return;
+
+        // process every dsq only once
+        for (const auto& q : vecCoinJoinQueue) {
+            if (q == dsq) {
+                return;
+            }
+            if (q.fReady == dsq.fReady && q.masternodeOutpoint == dsq.masternodeOutpoint) {
+                // no way the same mn can send another dsq with the same readiness this soon
+                LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %d is sending WAY too many dsq messages for a masternode with collateral %s\n", nodeId, dsq.masternodeOutpoint.ToStringShort());
                 return;
             }
-            LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
         }
-        // all is good
-        CheckPool(connman);
+    } // cs_vecqueue
+
+    if (dsq.IsTimeOutOfBounds()) return;
+
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+    auto dmn = mnList.GetValidMNByCollateral(dsq.masternodeOutpoint);
+    if (!dmn) return;
+
+    // unless it was verified recently, the signature is verified in a batch and the dsq is processed again afterwards
+    if (!CheckOrQueueDsqSignature(nodeId, dsq, dmn->pdmnState->pubKeyOperator.Get())) {
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- %s new\n", dsq.ToString());
+        return;
+    }
+
+    if (!dsq.fReady) {
+        int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
+        int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
+        //don't allow a few nodes to dominate the queuing process
+        if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
+            LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->pdmnState->addr.ToString());
+            return;
+        }
+        mmetaman.AllowMixing(dmn->proTxHash);
+
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
+
+        TRY_LOCK(cs_vecqueue, lockRecv);
+        if (!lockRecv) return;
+        vecCoinJoinQueue.push_back(dsq);
+        dsq.Relay(connman);
+    }
+}
+
+void CCoinJoinServer::ProcessPendingDsqs(CConnman& connman)
+{
+    for (const auto& p : VerifyPendingDsqs()) {
+        ProcessDSQueue(p.first, p.second, connman);
     }
 }
 
@@ -508,46 +525,69 @@ void CCoinJoinServer::CheckForCompleteQueue(CConnman& connman)
     }
 }
 
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CCoinJoinServer::IsInputScriptSigValid(const CTxIn& txin)
+// Check to make sure the given inputs match inputs in the pool and their scriptSigs are valid
+bool CCoinJoinServer::AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
 {
     CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
-
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
+    std::map<COutPoint, std::pair<int, CScript>> mapPoolInputs;
 
     for (const auto& entry : vecEntries) {
         for (const auto& txout : entry.vecTxOut) {
             txNew.vout.push_back(txout);
         }
         for (const auto& txdsin : entry.vecTxDSIn) {
+            mapPoolInputs[txdsin.prevout] = std::make_pair((int)txNew.vin.size(), txdsin.prevPubKey);
             txNew.vin.push_back(txdsin);
+        }
+    }
 
-            if (txdsin.prevout == txin.prevout) {
-                nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
-            }
-            i++;
+    // the signature hash of an input doesn't cover the scriptSigs of the other inputs, so all of them can be
+    // verified against the same transaction
+    std::vector<std::pair<int, CScript>> vecChecks;
+    for (const auto& txin : vecTxIn) {
+        auto it = mapPoolInputs.find(txin.prevout);
+        if (it == mapPoolInputs.end()) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- Failed to find matching input in pool, %s\n", __func__, txin.ToString());
+            return false;
         }
+        txNew.vin[it->second.first].scriptSig = txin.scriptSig;
+        vecChecks.emplace_back(it->second);
     }
 
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
+    const CTransaction txToVerify(txNew);
+    auto verify = [&txToVerify](int nTxInIndex, const CScript& sigPubKey) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AreInputScriptSigsValid -- verifying scriptSig %s\n", ScriptToAsmStr(txToVerify.vin[nTxInIndex].scriptSig).substr(0, 24));
         // TODO we're using amount=0 here but we should use the correct amount. This works because Dash ignores the amount while signing/verifying (only used in Bitcoin/Segwit)
-        if (!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex, 0))) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
+        if (!VerifyScript(txToVerify.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, TransactionSignatureChecker(&txToVerify, nTxInIndex, 0))) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AreInputScriptSigsValid -- VerifyScript() failed on input %d\n", nTxInIndex);
             return false;
         }
+        return true;
+    };
+
+    bool fValid = true;
+    if (workerPool.size() == 0 || vecChecks.size() == 1) {
+        for (const auto& check : vecChecks) {
+            fValid = fValid && verify(check.first, check.second);
+        }
     } else {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+        std::vector<std::future<bool>> vecFutures;
+        vecFutures.reserve(vecChecks.size());
+        for (const auto& check : vecChecks) {
+            vecFutures.emplace_back(workerPool.push([&verify, &check](int threadId) {
+                return verify(check.first, check.second);
+            }));
+        }
+        // wait for all checks, they reference our locals
+        for (auto& future : vecFutures) {
+            fValid = future.get() && fValid;
+        }
+    }
+    if (!fValid) {
         return false;
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- Successfully validated %d inputs and scriptSigs\n", __func__, vecChecks.size());
     return true;
 }
 
@@ -613,24 +653,42 @@ bool CCoinJoinServer::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, P
     return true;
 }
 
-bool CCoinJoinServer::AddScriptSig(const CTxIn& txinNew)
+bool CCoinJoinServer::AddScriptSigs(const std::vector<CTxIn>& vecTxIn)
 {
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+    std::set<COutPoint> setPrevouts;
+    std::set<CScript> setScriptSigs;
+    for (const auto& txinNew : vecTxIn) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- scriptSig=%s\n", __func__, ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
-    for (const auto& entry : vecEntries) {
-        for (const auto& txdsin : entry.vecTxDSIn) {
-            if (txdsin.scriptSig == txinNew.scriptSig) {
-                LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- already exists\n");
-                return false;
+        if (!setPrevouts.emplace(txinNew.prevout).second || !setScriptSigs.emplace(txinNew.scriptSig).second) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- duplicate txin\n", __func__);
+            return false;
+        }
+        for (const auto& entry : vecEntries) {
+            for (const auto& txdsin : entry.vecTxDSIn) {
+                if (txdsin.scriptSig == txinNew.scriptSig) {
+                    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- already exists\n", __func__);
+                    return false;
+                }
             }
         }
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- Invalid scriptSig\n");
+    if (!AreInputScriptSigsValid(vecTxIn)) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- Invalid scriptSig\n", __func__);
         return false;
     }
 
+    for (const auto& txinNew : vecTxIn) {
+        if (!AddScriptSig(txinNew)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CCoinJoinServer::AddScriptSig(const CTxIn& txinNew)
+{
     LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
     for (auto& txin : finalMutableTransaction.vin) {
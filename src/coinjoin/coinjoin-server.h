@@ -8,6 +8,8 @@
 #include <coinjoin/coinjoin.h>
 #include <net.h>
 
+#include <ctpl.h>
+
 class CCoinJoinServer;
 class UniValue;
 
@@ -25,9 +27,14 @@ private:
 
     bool fUnitTest;
 
+    // Verifies the scriptSigs of DSSIGNFINALTX messages in parallel
+    ctpl::thread_pool workerPool;
+
     /// Add a clients entry to the pool
     bool AddEntry(CConnman& connman, const CCoinJoinEntry& entry, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
+    /// Verify the signatures for a set of txins and add them to the pool
+    bool AddScriptSigs(const std::vector<CTxIn>& vecTxIn);
+    /// Add signature to a txin, the signature must have been verified already
     bool AddScriptSig(const CTxIn& txin);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
@@ -52,8 +59,8 @@ private:
 
     /// Check that all inputs are signed. (Are all inputs signed?)
     bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    /// Check to make sure the given inputs match inputs in the pool and their scriptSigs are valid
+    bool AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn);
 
     // Set the 'state' value, with some logging and capturing when the state changed
     void SetState(PoolState nStateNew);
@@ -64,6 +71,8 @@ private:
     void RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID = MSG_NOERR);
     void RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman);
 
+    void ProcessDSQueue(NodeId nodeId, CCoinJoinQueue dsq, CConnman& connman);
+
     void SetNull();
 
 public:
@@ -71,7 +80,12 @@ public:
         vecSessionCollaterals(),
         fUnitTest(false) {}
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    void Start();
+    void Stop();
+
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    /// Verify the signatures of the queued DSQUEUE messages in a batch and process the valid ones
+    void ProcessPendingDsqs(CConnman& connman);
 
     bool HasTimedOut();
     void CheckTimeout(CConnman& connman);
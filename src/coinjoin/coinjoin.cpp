@@ -5,15 +5,18 @@
 #include <coinjoin/coinjoin.h>
 
 #include <core_io.h>
+#include <core_memusage.h>
 #include <consensus/validation.h>
 #include <messagesigner.h>
 #include <netmessagemaker.h>
+#include <net_processing.h>
 #include <script/sign.h>
 #include <txmempool.h>
 #include <util.h>
 #include <utilmoneystr.h>
 #include <validation.h>
 
+#include <bls/bls_batchverifier.h>
 #include <masternode/activemasternode.h>
 #include <masternode/masternode-sync.h>
 
@@ -158,6 +161,25 @@ void CCoinJoinBaseSession::SetNull()
     nTimeLastSuccessfulStep = GetTime();
 }
 
+size_t CCoinJoinBaseSession::GetEntriesMemoryUsage() const
+{
+    LOCK(cs_coinjoin);
+    size_t usage = memusage::DynamicUsage(vecEntries) + RecursiveDynamicUsage(finalMutableTransaction);
+    for (const auto& entry : vecEntries) {
+        usage += memusage::DynamicUsage(entry.vecTxDSIn) + memusage::DynamicUsage(entry.vecTxOut);
+        for (const auto& txdsin : entry.vecTxDSIn) {
+            usage += RecursiveDynamicUsage(txdsin);
+        }
+        for (const auto& txout : entry.vecTxOut) {
+            usage += RecursiveDynamicUsage(txout);
+        }
+        if (entry.txCollateral) {
+            usage += RecursiveDynamicUsage(entry.txCollateral);
+        }
+    }
+    return usage;
+}
+
 void CCoinJoinBaseManager::SetNull()
 {
     LOCK(cs_vecqueue);
@@ -181,6 +203,93 @@ void CCoinJoinBaseManager::CheckQueue()
     }
 }
 
+static uint256 GetVerifiedDsqKey(const CCoinJoinQueue& dsq, const CBLSPublicKey& pubKeyOperator)
+{
+    // the signature is part of the key, relaying an invalid one for a valid queue would get us punished
+    CHashWriter hw(SER_GETHASH, 0);
+    hw << dsq.GetSignatureHash() << dsq.vchSig << pubKeyOperator;
+    return hw.GetHash();
+}
+
+bool CCoinJoinBaseManager::CheckOrQueueDsqSignature(NodeId nodeId, const CCoinJoinQueue& dsq, const CBLSPublicKey& pubKeyOperator)
+{
+    uint256 key = GetVerifiedDsqKey(dsq, pubKeyOperator);
+
+    LOCK(cs_pendingDsqs);
+    if (verifiedDsqs.exists(key)) {
+        return true;
+    }
+    // the same queue from other peers is dropped while a copy is pending, they will relay it to us anyway
+    mapPendingDsqs.emplace(key, PendingDsq{nodeId, dsq, pubKeyOperator});
+    return false;
+}
+
+std::vector<std::pair<NodeId, CCoinJoinQueue>> CCoinJoinBaseManager::VerifyPendingDsqs()
+{
+    std::map<uint256, PendingDsq> mapDsqs;
+    {
+        LOCK(cs_pendingDsqs);
+        mapDsqs.swap(mapPendingDsqs);
+    }
+
+    std::vector<std::pair<NodeId, CCoinJoinQueue>> vecValid;
+    if (mapDsqs.empty()) {
+        return vecValid;
+    }
+
+    int64_t nStart = GetTimeMillis();
+
+    // Insecure batched verification is fine here, every queue is signed with the key of the masternode it names,
+    // so there are no different keys signing the same message, which the rogue public key attack requires
+    CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, true);
+    std::set<uint256> setInvalid;
+    for (const auto& p : mapDsqs) {
+        CBLSSignature sig(p.second.dsq.vchSig);
+        if (!sig.IsValid() || !p.second.pubKeyOperator.IsValid()) {
+            setInvalid.emplace(p.first);
+            continue;
+        }
+        batchVerifier.PushMessage(p.second.nodeId, p.first, p.second.dsq.GetSignatureHash(), sig, p.second.pubKeyOperator);
+    }
+    batchVerifier.Verify();
+
+    std::vector<NodeId> vecBadSigNodes;
+    {
+        LOCK(cs_pendingDsqs);
+        for (auto& p : mapDsqs) {
+            if (setInvalid.count(p.first) || batchVerifier.badMessages.count(p.first)) {
+                vecBadSigNodes.emplace_back(p.second.nodeId);
+                continue;
+            }
+            verifiedDsqs.insert(p.first, true);
+            vecValid.emplace_back(p.second.nodeId, std::move(p.second.dsq));
+        }
+    }
+
+    LogPrint(BCLog::COINJOIN, "CCoinJoinBaseManager::%s -- verified %d dsq signatures, %d valid, %dms\n", __func__,
+        mapDsqs.size(), vecValid.size(), GetTimeMillis() - nStart);
+
+    if (!vecBadSigNodes.empty()) {
+        LOCK(cs_main);
+        for (NodeId nodeId : vecBadSigNodes) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinBaseManager::%s -- invalid dsq signature from peer=%d\n", __func__, nodeId);
+            Misbehaving(nodeId, 10);
+        }
+    }
+
+    return vecValid;
+}
+
+size_t CCoinJoinBaseManager::GetQueueMemoryUsage() const
+{
+    LOCK(cs_vecqueue);
+    size_t usage = memusage::DynamicUsage(vecCoinJoinQueue);
+    for (const auto& dsq : vecCoinJoinQueue) {
+        usage += memusage::DynamicUsage(dsq.vchSig);
+    }
+    return usage;
+}
+
 bool CCoinJoinBaseManager::GetQueueItemAndTry(CCoinJoinQueue& dsqRet)
 {
     TRY_LOCK(cs_vecqueue, lockDS);
@@ -346,20 +455,26 @@ bool CCoinJoin::IsCollateralValid(const CTransaction& txCollateral)
         }
     }
 
-    for (const auto& txin : txCollateral.vin) {
-        Coin coin;
-        auto mempoolTx = mempool.get(txin.prevout.hash);
-        if (mempoolTx != nullptr) {
-            if (mempool.isSpent(txin.prevout) || !llmq::quorumInstantSendManager->IsLocked(txin.prevout.hash)) {
-                LogPrint(BCLog::COINJOIN, "CCoinJoin::IsCollateralValid -- spent or non-locked mempool input! txin=%s\n", txin.ToString());
+    // look up all inputs at once instead of locking cs_main and the mempool for every single one of them
+    std::vector<uint256> vecMempoolParents;
+    {
+        LOCK2(cs_main, mempool.cs);
+        for (const auto& txin : txCollateral.vin) {
+            Coin coin;
+            auto mempoolTx = mempool.get(txin.prevout.hash);
+            if (mempoolTx != nullptr) {
+                if (mempool.isSpent(txin.prevout)) {
+                    LogPrint(BCLog::COINJOIN, "CCoinJoin::IsCollateralValid -- spent or non-locked mempool input! txin=%s\n", txin.ToString());
+                    return false;
+                }
+                nValueIn += mempoolTx->vout[txin.prevout.n].nValue;
+                vecMempoolParents.emplace_back(txin.prevout.hash);
+            } else if (pcoinsTip->GetCoin(txin.prevout, coin) && !coin.IsSpent()) {
+                nValueIn += coin.out.nValue;
+            } else {
+                LogPrint(BCLog::COINJOIN, "CCoinJoin::IsCollateralValid -- Unknown inputs in collateral transaction, txCollateral=%s", txCollateral.ToString()); /* Continued */
                 return false;
             }
-            nValueIn += mempoolTx->vout[txin.prevout.n].nValue;
-        } else if (GetUTXOCoin(txin.prevout, coin)) {
-            nValueIn += coin.out.nValue;
-        } else {
-            LogPrint(BCLog::COINJOIN, "CCoinJoin::IsCollateralValid -- Unknown inputs in collateral transaction, txCollateral=%s", txCollateral.ToString()); /* Continued */
-            return false;
         }
     }
 
@@ -369,6 +484,14 @@ bool CCoinJoin::IsCollateralValid(const CTransaction& txCollateral)
         return false;
     }
 
+    // don't hold cs_main and mempool.cs while asking the instantsend manager
+    for (const auto& hash : vecMempoolParents) {
+        if (!llmq::quorumInstantSendManager->IsLocked(hash)) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoin::IsCollateralValid -- spent or non-locked mempool input! txid=%s\n", hash.ToString());
+            return false;
+        }
+    }
+
     LogPrint(BCLog::COINJOIN, "CCoinJoin::IsCollateralValid -- %s", txCollateral.ToString()); /* Continued */
 
     {
@@ -527,6 +650,16 @@ void CCoinJoin::AddDSTX(const CCoinJoinBroadcastTx& dstx)
     mapDSTX.insert(std::make_pair(dstx.tx->GetHash(), dstx));
 }
 
+size_t CCoinJoin::GetDSTXMemoryUsage()
+{
+    LOCK(cs_mapdstx);
+    size_t usage = memusage::DynamicUsage(mapDSTX);
+    for (const auto& p : mapDSTX) {
+        usage += memusage::DynamicUsage(p.second.vchSig);
+    }
+    return usage;
+}
+
 CCoinJoinBroadcastTx CCoinJoin::GetDSTX(const uint256& hash)
 {
     LOCK(cs_mapdstx);
@@ -14,14 +14,19 @@
 #include <spork.h>
 #include <timedata.h>
 #include <tinyformat.h>
+#include <unordered_lru_cache.h>
 
 class CCoinJoin;
 class CConnman;
 
+typedef int64_t NodeId;
+
 // timeouts
 static const int COINJOIN_AUTO_TIMEOUT_MIN = 5;
 static const int COINJOIN_AUTO_TIMEOUT_MAX = 15;
 static const int COINJOIN_QUEUE_TIMEOUT = 30;
+// DSQUEUEs whose signatures were verified recently, every queue is announced by many peers
+static const size_t COINJOIN_VERIFIED_DSQ_CACHE_SIZE = 1000;
 static const int COINJOIN_SIGNING_TIMEOUT = 15;
 
 static const size_t COINJOIN_ENTRY_MAX_SIZE = 9;
@@ -391,6 +396,7 @@ public:
     std::string GetStateString() const;
 
     int GetEntriesCount() const { return vecEntries.size(); }
+    size_t GetEntriesMemoryUsage() const;
 };
 
 // base class
@@ -402,14 +408,37 @@ protected:
     // The current mixing sessions in progress on the network
     std::vector<CCoinJoinQueue> vecCoinJoinQueue;
 
+    // DSQUEUEs which passed all other checks and wait for their signatures to be verified in a batch, with the
+    // operator key they are checked against
+    struct PendingDsq {
+        NodeId nodeId;
+        CCoinJoinQueue dsq;
+        CBLSPublicKey pubKeyOperator;
+    };
+    mutable CCriticalSection cs_pendingDsqs;
+    std::map<uint256, PendingDsq> mapPendingDsqs GUARDED_BY(cs_pendingDsqs);
+    unordered_lru_cache<uint256, bool, StaticSaltedHasher, COINJOIN_VERIFIED_DSQ_CACHE_SIZE> verifiedDsqs GUARDED_BY(cs_pendingDsqs);
+
     void SetNull();
     void CheckQueue();
 
+    /**
+     * Returns true if the signature of dsq was verified recently against pubKeyOperator. Otherwise dsq is queued for
+     * VerifyPendingDsqs() and false is returned.
+     */
+    bool CheckOrQueueDsqSignature(NodeId nodeId, const CCoinJoinQueue& dsq, const CBLSPublicKey& pubKeyOperator);
+    /**
+     * Verify the signatures of all queued DSQUEUEs in one batch and punish the peers which sent invalid ones.
+     * Returns the valid ones, which pass CheckOrQueueDsqSignature() from now on.
+     */
+    std::vector<std::pair<NodeId, CCoinJoinQueue>> VerifyPendingDsqs();
+
 public:
     CCoinJoinBaseManager() :
         vecCoinJoinQueue() {}
 
     int GetQueueSize() const { return vecCoinJoinQueue.size(); }
+    size_t GetQueueMemoryUsage() const;
     bool GetQueueItemAndTry(CCoinJoinQueue& dsqRet);
 };
 
@@ -460,6 +489,8 @@ public:
 
     static void AddDSTX(const CCoinJoinBroadcastTx& dstx);
     static CCoinJoinBroadcastTx GetDSTX(const uint256& hash);
+    // Memory used by the DSTX map, not including the transactions which are shared with the mempool
+    static size_t GetDSTXMemoryUsage();
 
     static void UpdatedBlockTip(const CBlockIndex* pindex);
     static void NotifyChainLock(const CBlockIndex* pindex);
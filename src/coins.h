@@ -11,6 +11,7 @@
 #include <core_memusage.h>
 #include <hash.h>
 #include <memusage.h>
+#include <support/allocators/pool.h>
 #include <serialize.h>
 #include <uint256.h>
 
@@ -119,7 +120,19 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * Entries of the coins cache are allocated from a pool which is released as a whole when the cache is flushed. The
+ * pool's block size leaves room for the node overhead (next pointer, cached hash) of the unordered_map.
+ */
+typedef std::unordered_map<COutPoint,
+                           CCoinsCacheEntry,
+                           SaltedOutpointHasher,
+                           std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>>
+    CCoinsMap;
+
+typedef CCoinsMap::allocator_type::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -206,6 +219,8 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    /* Must be declared before cacheCoins, as it has to outlive it. */
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -254,6 +269,12 @@ public:
      */
     void AddCoin(const COutPoint& outpoint, Coin&& coin, bool potential_overwrite);
 
+    /**
+     * Add a coin which was read from the base view (e.g. in parallel with other reads), as if it had been fetched
+     * by AccessCoin. Does nothing if the outpoint is already cached.
+     */
+    void EmplaceCoinFromBase(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
@@ -274,6 +295,15 @@ public:
      */
     void Uncache(const COutPoint &outpoint);
 
+    /**
+     * Force a reallocation of the cache map. This is required when downsizing
+     * the cache because the map's allocator may be hanging onto a lot of
+     * memory despite having called .clear().
+     *
+     * See: https://stackoverflow.com/questions/42114044/how-to-release-unordered-map-memory
+     */
+    void ReallocateCache();
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
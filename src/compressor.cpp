@@ -9,6 +9,8 @@
 #include <pubkey.h>
 #include <script/standard.h>
 
+bool fStoreP2PKUncompressed = DEFAULT_STORE_P2PK_UNCOMPRESSED;
+
 bool CScriptCompressor::IsToKeyID(CKeyID &hash) const
 {
     if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160
@@ -45,8 +47,24 @@ bool CScriptCompressor::IsToPubKey(CPubKey &pubkey) const
     return false;
 }
 
-bool CScriptCompressor::Compress(std::vector<unsigned char> &out) const
+bool CScriptCompressor::Compress(CompressedScript &out) const
 {
+    // dispatch on the size first, only one of the special cases can match a script
+    switch (script.size()) {
+    case 25:
+    case 23:
+    case 35:
+        break;
+    case 67:
+        // written as a regular script, which avoids the EC point decompression when reading it back
+        if (fStoreP2PKUncompressed) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
     CKeyID keyID;
     if (IsToKeyID(keyID)) {
         out.resize(21);
@@ -85,7 +103,7 @@ unsigned int CScriptCompressor::GetSpecialSize(unsigned int nSize) const
     return 0;
 }
 
-bool CScriptCompressor::Decompress(unsigned int nSize, const std::vector<unsigned char> &in)
+bool CScriptCompressor::Decompress(unsigned int nSize, const CompressedScript &in)
 {
     switch(nSize) {
     case 0x00:
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_COMPRESSOR_H
 #define BITCOIN_COMPRESSOR_H
 
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
 #include <serialize.h>
@@ -15,6 +16,18 @@ class CKeyID;
 class CPubKey;
 class CScriptID;
 
+/** Default for -storep2pkuncompressed */
+static const bool DEFAULT_STORE_P2PK_UNCOMPRESSED = false;
+
+/**
+ * Whether scripts paying to uncompressed public keys are written as they are instead of the 33 byte special case,
+ * which needs an EC point decompression on every read. Both encodings are always readable.
+ */
+extern bool fStoreP2PKUncompressed;
+
+/** The special cases are compressed to at most 33 bytes, kept on the stack */
+typedef prevector<33, unsigned char> CompressedScript;
+
 /** Compact serializer for scripts.
  *
  *  It detects common cases and encodes them much more efficiently.
@@ -50,15 +63,15 @@ protected:
     bool IsToScriptID(CScriptID &hash) const;
     bool IsToPubKey(CPubKey &pubkey) const;
 
-    bool Compress(std::vector<unsigned char> &out) const;
+    bool Compress(CompressedScript &out) const;
     unsigned int GetSpecialSize(unsigned int nSize) const;
-    bool Decompress(unsigned int nSize, const std::vector<unsigned char> &out);
+    bool Decompress(unsigned int nSize, const CompressedScript &in);
 public:
     explicit CScriptCompressor(CScript &scriptIn) : script(scriptIn) { }
 
     template<typename Stream>
     void Serialize(Stream &s) const {
-        std::vector<unsigned char> compr;
+        CompressedScript compr;
         if (Compress(compr)) {
             s << MakeSpan(compr);
             return;
@@ -73,7 +86,7 @@ public:
         unsigned int nSize = 0;
         s >> VARINT(nSize);
         if (nSize < nSpecialScripts) {
-            std::vector<unsigned char> vch(GetSpecialSize(nSize), 0x00);
+            CompressedScript vch(GetSpecialSize(nSize), 0x00);
             s >> MakeSpan(vch);
             Decompress(nSize, vch);
             return;
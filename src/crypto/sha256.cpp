@@ -22,11 +22,13 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 namespace sha256d64_sse41
 {
 void Transform_4way(unsigned char* out, const unsigned char* in);
+void TransformMulti_4way(uint32_t* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_avx2
 {
 void Transform_8way(unsigned char* out, const unsigned char* in);
+void TransformMulti_8way(uint32_t* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_shani
@@ -416,6 +418,7 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+typedef void (*TransformMultiType)(uint32_t*, const unsigned char* const*);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -461,6 +464,138 @@ TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType TransformMulti_4way = nullptr;
+TransformMultiType TransformMulti_8way = nullptr;
+
+/** Double-SHA256 of count messages of arbitrary length, N at a time with tr.
+ *
+ *  Every lane works through one message (first hash), then through the single padded block
+ *  of its digest (second hash) and is then refilled with the next message, so messages of
+ *  different lengths keep all lanes busy until the last ones. Idle lanes hash a dummy block.
+ */
+template<size_t N>
+void SHA256DMultiWay(TransformMultiType tr, unsigned char* out, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    static const uint32_t init[8] = {
+        0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul
+    };
+    static const unsigned char dummy[64] = {0};
+
+    struct Lane {
+        size_t index;
+        bool active{false};
+        bool second;
+        const unsigned char* data;
+        size_t blocks; // full 64-byte blocks left in data
+        size_t tailPos;
+        size_t tailBlocks;
+        unsigned char tail[128];
+    };
+
+    uint32_t s[8 * N];
+    Lane lanes[N];
+    const unsigned char* chunks[N];
+
+    // Padding of the last partial block, see CSHA256::Finalize()
+    auto setTail = [](Lane& lane, const unsigned char* data, size_t len, size_t totalLen) {
+        memset(lane.tail, 0, sizeof(lane.tail));
+        memcpy(lane.tail, data, len);
+        lane.tail[len] = 0x80;
+        lane.tailBlocks = len + 9 > 64 ? 2 : 1;
+        WriteBE64(lane.tail + lane.tailBlocks * 64 - 8, (uint64_t)totalLen << 3);
+        lane.tailPos = 0;
+    };
+    auto initState = [&](size_t l) {
+        for (size_t i = 0; i < 8; i++) {
+            s[i * N + l] = init[i];
+        }
+    };
+
+    size_t next = 0;
+    size_t active = 0;
+    while (true) {
+        for (size_t l = 0; l < N && next < count; l++) {
+            Lane& lane = lanes[l];
+            if (lane.active) continue;
+            lane.index = next++;
+            lane.active = true;
+            lane.second = false;
+            lane.data = in[lane.index];
+            lane.blocks = lens[lane.index] / 64;
+            setTail(lane, lane.data + lane.blocks * 64, lens[lane.index] % 64, lens[lane.index]);
+            initState(l);
+            active++;
+        }
+        if (!active) {
+            break;
+        }
+
+        for (size_t l = 0; l < N; l++) {
+            const Lane& lane = lanes[l];
+            chunks[l] = !lane.active ? dummy : lane.blocks ? lane.data : lane.tail + lane.tailPos * 64;
+        }
+        tr(s, chunks);
+
+        for (size_t l = 0; l < N; l++) {
+            Lane& lane = lanes[l];
+            if (!lane.active) continue;
+            if (lane.blocks) {
+                lane.data += 64;
+                lane.blocks--;
+                continue;
+            }
+            if (++lane.tailPos != lane.tailBlocks) continue;
+
+            unsigned char digest[32];
+            for (size_t i = 0; i < 8; i++) {
+                WriteBE32(digest + i * 4, s[i * N + l]);
+            }
+            if (!lane.second) {
+                lane.second = true;
+                setTail(lane, digest, sizeof(digest), sizeof(digest));
+                initState(l);
+            } else {
+                memcpy(out + lane.index * 32, digest, sizeof(digest));
+                lane.active = false;
+                active--;
+            }
+        }
+    }
+}
+
+/** Single SHA256 of N 64-byte blobs with tr: the blob itself and then the constant padding block. */
+template<size_t N>
+void SHA256S64Way(TransformMultiType tr, unsigned char* out, const unsigned char* in)
+{
+    static const uint32_t init[8] = {
+        0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul
+    };
+    static const unsigned char padding[64] = {
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0
+    };
+
+    uint32_t s[8 * N];
+    const unsigned char* chunks[N];
+    for (size_t l = 0; l < N; l++) {
+        for (size_t i = 0; i < 8; i++) {
+            s[i * N + l] = init[i];
+        }
+        chunks[l] = in + l * 64;
+    }
+    tr(s, chunks);
+    for (size_t l = 0; l < N; l++) {
+        chunks[l] = padding;
+    }
+    tr(s, chunks);
+    for (size_t l = 0; l < N; l++) {
+        for (size_t i = 0; i < 8; i++) {
+            WriteBE32(out + l * 32 + i * 4, s[i * N + l]);
+        }
+    }
+}
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -544,6 +679,27 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // Test TransformMulti_4way and TransformMulti_8way, if available, against Transform() on a different block per lane.
+    for (auto tr : {std::make_pair(TransformMulti_4way, (size_t)4), std::make_pair(TransformMulti_8way, (size_t)8)}) {
+        if (!tr.first) continue;
+        size_t n = tr.second;
+        uint32_t states[64];
+        const unsigned char* chunks[8];
+        for (size_t l = 0; l < n; ++l) {
+            for (size_t i = 0; i < 8; ++i) states[i * n + l] = result[l][i];
+            chunks[l] = data + 1 + 64 * (7 - l);
+        }
+        tr.first(states, chunks);
+        for (size_t l = 0; l < n; ++l) {
+            uint32_t state[8];
+            std::copy(result[l], result[l] + 8, state);
+            Transform(state, chunks[l], 1);
+            for (size_t i = 0; i < 8; ++i) {
+                if (states[i * n + l] != state[i]) return false;
+            }
+        }
+    }
+
     return true;
 }
 
@@ -622,6 +778,7 @@ std::string SHA256AutoDetect()
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformMulti_4way = sha256d64_sse41::TransformMulti_4way;
         ret += ",sse41(4way)";
 #endif
     }
@@ -629,6 +786,7 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformMulti_8way = sha256d64_avx2::TransformMulti_8way;
         ret += ",avx2(8way)";
     }
 #endif
@@ -728,3 +886,46 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+void SHA256S64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformMulti_8way) {
+        while (blocks >= 8) {
+            SHA256S64Way<8>(TransformMulti_8way, out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformMulti_4way) {
+        while (blocks >= 4) {
+            SHA256S64Way<4>(TransformMulti_4way, out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        CSHA256().Write(in, 64).Finalize(out);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
+
+void SHA256DMulti(unsigned char* out, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    if (TransformMulti_8way && count >= 8) {
+        SHA256DMultiWay<8>(TransformMulti_8way, out, in, lens, count);
+        return;
+    }
+    if (TransformMulti_4way && count >= 4) {
+        SHA256DMultiWay<4>(TransformMulti_4way, out, in, lens, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        unsigned char tmp[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(in[i], lens[i]).Finalize(tmp);
+        CSHA256().Write(tmp, sizeof(tmp)).Finalize(out + i * CSHA256::OUTPUT_SIZE);
+    }
+}
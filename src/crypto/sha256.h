@@ -38,4 +38,21 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+/** Compute multiple (single) SHA256's of 64-byte blobs.
+ *  Uses the 4-way/8-way SIMD transforms when available.
+ *  output:  pointer to a blocks*32 byte output buffer
+ *  input:   pointer to a blocks*64 byte input buffer
+ *  blocks:  the number of hashes to compute.
+ */
+void SHA256S64(unsigned char* output, const unsigned char* input, size_t blocks);
+
+/** Compute multiple double-SHA256's of messages of arbitrary length.
+ *  Uses the 4-way/8-way SIMD transforms when available, interleaving the messages over the lanes.
+ *  output:  pointer to a count*32 byte output buffer
+ *  input:   pointers to the count messages
+ *  lens:    lengths of the count messages
+ *  count:   the number of hashes to compute.
+ */
+void SHA256DMulti(unsigned char* output, const unsigned char* const* input, const size_t* lens, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -0,0 +1,100 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/x11.h>
+#include <crypto/common.h>
+#include <crypto/sph_echo.h>
+#include <crypto/sph_shavite.h>
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace x11_aesni
+{
+void Shavite512_64(unsigned char* output, const unsigned char* input);
+void Echo512_64(unsigned char* output, const unsigned char* input);
+}
+
+namespace {
+
+void Shavite512_64Generic(unsigned char* output, const unsigned char* input)
+{
+    sph_shavite512_context ctx;
+    sph_shavite512_init(&ctx);
+    sph_shavite512(&ctx, input, 64);
+    sph_shavite512_close(&ctx, output);
+}
+
+void Echo512_64Generic(unsigned char* output, const unsigned char* input)
+{
+    sph_echo512_context ctx;
+    sph_echo512_init(&ctx);
+    sph_echo512(&ctx, input, 64);
+    sph_echo512_close(&ctx, output);
+}
+
+typedef void (*Hash64Fn)(unsigned char* output, const unsigned char* input);
+
+Hash64Fn Shavite512_64 = Shavite512_64Generic;
+Hash64Fn Echo512_64 = Echo512_64Generic;
+
+/** Compare the selected implementations against the generic ones. */
+bool SelfTest()
+{
+    unsigned char in[64];
+    unsigned char out1[64];
+    unsigned char out2[64];
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 64; j++) {
+            in[j] = (unsigned char)(i * 64 + j * 7 + 1);
+        }
+        Shavite512_64Generic(out1, in);
+        Shavite512_64(out2, in);
+        if (memcmp(out1, out2, 64) != 0) return false;
+        Echo512_64Generic(out1, in);
+        Echo512_64(out2, in);
+        if (memcmp(out1, out2, 64) != 0) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string X11AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        bool have_sse41 = (ecx >> 19) & 1;
+        bool have_aesni = (ecx >> 25) & 1;
+        if (have_sse41 && have_aesni) {
+            Shavite512_64 = x11_aesni::Shavite512_64;
+            Echo512_64 = x11_aesni::Echo512_64;
+            ret = "aesni(shavite,echo)";
+        }
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void X11Shavite512_64(unsigned char* output, const unsigned char* input)
+{
+    Shavite512_64(output, input);
+}
+
+void X11Echo512_64(unsigned char* output, const unsigned char* input)
+{
+    Echo512_64(output, input);
+}
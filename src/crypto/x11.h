@@ -0,0 +1,29 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_X11_H
+#define BITCOIN_CRYPTO_X11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Autodetect the best available implementations of the X11 stages.
+ *  Returns the name of the implementation.
+ */
+std::string X11AutoDetect();
+
+/** Compute SHAvite-512 of a single 64 byte input, as done by the 9th X11 stage.
+ *  output:  pointer to a 64 byte output buffer
+ *  input:   pointer to a 64 byte input buffer
+ */
+void X11Shavite512_64(unsigned char* output, const unsigned char* input);
+
+/** Compute ECHO-512 of a single 64 byte input, as done by the 11th X11 stage.
+ *  output:  pointer to a 64 byte output buffer
+ *  input:   pointer to a 64 byte input buffer
+ */
+void X11Echo512_64(unsigned char* output, const unsigned char* input);
+
+#endif // BITCOIN_CRYPTO_X11_H
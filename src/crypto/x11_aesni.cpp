@@ -0,0 +1,184 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AES-NI implementations of the X11 stages which are built from AES rounds (SHAvite-512 and ECHO-512).
+// Both only support the X11 case of hashing exactly 64 bytes (the output of the previous stage), which always fits
+// into a single (padded) compression. They must produce the same results as the sphlib implementations in crypto/.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace {
+
+const uint32_t SHAVITE512_IV[16] = {
+    0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC,
+    0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+    0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47,
+    0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+inline __m128i XTime(__m128i x)
+{
+    // multiply each byte by 2 in GF(2^8) with the AES polynomial
+    const __m128i msb = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(msb, _mm_set1_epi8(0x1b)));
+}
+
+} // namespace
+
+namespace x11_aesni {
+
+void Shavite512_64(unsigned char* output, const unsigned char* input)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    // padded message block: 64 bytes of input, 0x80, zeros, bit count (512) at byte 110, output size (512) at byte 126
+    unsigned char block[128] = {0};
+    memcpy(block, input, 64);
+    block[64] = 0x80;
+    WriteLE32(block + 110, 512);
+    block[126] = 0x00;
+    block[127] = 0x02;
+
+    // message expansion, rk[i] holds the round key words 4*i..4*i+3
+    __m128i rk[112];
+    for (int i = 0; i < 8; i++) {
+        rk[i] = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+    }
+    // the block counter is (512, 0, 0, 0) and gets mixed into these round keys (the last word is inverted)
+    const __m128i cnt0 = _mm_set_epi32(~0, 0, 0, 512);
+    const __m128i cnt1 = _mm_set_epi32(~512, 0, 0, 0);
+    const __m128i cnt2 = _mm_set_epi32(~0, 512, 0, 0);
+    const __m128i cnt3 = _mm_set_epi32(~0, 0, 512, 0);
+    int u = 8;
+    for (;;) {
+        for (int s = 0; s < 8; s++) {
+            __m128i x = _mm_shuffle_epi32(rk[u - 8], _MM_SHUFFLE(0, 3, 2, 1));
+            x = _mm_aesenc_si128(x, zero);
+            rk[u] = _mm_xor_si128(x, rk[u - 1]);
+            if (u == 8) {
+                rk[u] = _mm_xor_si128(rk[u], cnt0);
+            } else if (u == 41) {
+                rk[u] = _mm_xor_si128(rk[u], cnt1);
+            } else if (u == 79) {
+                rk[u] = _mm_xor_si128(rk[u], cnt2);
+            } else if (u == 110) {
+                rk[u] = _mm_xor_si128(rk[u], cnt3);
+            }
+            u++;
+        }
+        if (u == 112) {
+            break;
+        }
+        for (int s = 0; s < 8; s++) {
+            rk[u] = _mm_xor_si128(rk[u - 8], _mm_alignr_epi8(rk[u - 1], rk[u - 2], 4));
+            u++;
+        }
+    }
+
+    __m128i h[4];
+    for (int i = 0; i < 4; i++) {
+        h[i] = _mm_loadu_si128((const __m128i*)(SHAVITE512_IV + 4 * i));
+    }
+    __m128i p0 = h[0], p1 = h[1], p2 = h[2], p3 = h[3];
+    const __m128i* k = rk;
+    for (int r = 0; r < 14; r++) {
+        __m128i x = _mm_xor_si128(p1, k[0]);
+        x = _mm_aesenc_si128(x, k[1]);
+        x = _mm_aesenc_si128(x, k[2]);
+        x = _mm_aesenc_si128(x, k[3]);
+        x = _mm_aesenc_si128(x, zero);
+        p0 = _mm_xor_si128(p0, x);
+
+        x = _mm_xor_si128(p3, k[4]);
+        x = _mm_aesenc_si128(x, k[5]);
+        x = _mm_aesenc_si128(x, k[6]);
+        x = _mm_aesenc_si128(x, k[7]);
+        x = _mm_aesenc_si128(x, zero);
+        p2 = _mm_xor_si128(p2, x);
+        k += 8;
+
+        __m128i t = p3;
+        p3 = p2;
+        p2 = p1;
+        p1 = p0;
+        p0 = t;
+    }
+
+    _mm_storeu_si128((__m128i*)(output + 0), _mm_xor_si128(h[0], p0));
+    _mm_storeu_si128((__m128i*)(output + 16), _mm_xor_si128(h[1], p1));
+    _mm_storeu_si128((__m128i*)(output + 32), _mm_xor_si128(h[2], p2));
+    _mm_storeu_si128((__m128i*)(output + 48), _mm_xor_si128(h[3], p3));
+}
+
+void Echo512_64(unsigned char* output, const unsigned char* input)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    // padded message block: 64 bytes of input, 0x80, zeros, output size (512) at byte 110, bit count (512) at byte 112
+    unsigned char block[128] = {0};
+    memcpy(block, input, 64);
+    block[64] = 0x80;
+    WriteLE16(block + 110, 512);
+    WriteLE32(block + 112, 512);
+
+    // the chaining value is initialized with the output size in bits
+    const __m128i iv = _mm_set_epi32(0, 0, 0, 512);
+    __m128i W[16];
+    __m128i msg[8];
+    for (int i = 0; i < 8; i++) {
+        W[i] = iv;
+        msg[i] = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        W[i + 8] = msg[i];
+    }
+
+    // the AES keys are a 128 bit counter starting with the number of message bits
+    uint32_t k0 = 512;
+    for (int r = 0; r < 10; r++) {
+        // BIG.SubWords
+        for (int i = 0; i < 16; i++) {
+            W[i] = _mm_aesenc_si128(W[i], _mm_set_epi32(0, 0, 0, (int)k0));
+            W[i] = _mm_aesenc_si128(W[i], zero);
+            k0++;
+        }
+
+        // BIG.ShiftRows
+        __m128i t;
+        t = W[1]; W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+        t = W[2]; W[2] = W[10]; W[10] = t;
+        t = W[6]; W[6] = W[14]; W[14] = t;
+        t = W[15]; W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+
+        // BIG.MixColumns
+        for (int i = 0; i < 16; i += 4) {
+            const __m128i a = W[i], b = W[i + 1], c = W[i + 2], d = W[i + 3];
+            const __m128i ab = _mm_xor_si128(a, b);
+            const __m128i bc = _mm_xor_si128(b, c);
+            const __m128i cd = _mm_xor_si128(c, d);
+            const __m128i abx = XTime(ab);
+            const __m128i bcx = XTime(bc);
+            const __m128i cdx = XTime(cd);
+            W[i] = _mm_xor_si128(_mm_xor_si128(abx, bc), d);
+            W[i + 1] = _mm_xor_si128(_mm_xor_si128(bcx, a), cd);
+            W[i + 2] = _mm_xor_si128(_mm_xor_si128(cdx, ab), d);
+            W[i + 3] = _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(cdx, ab)), c);
+        }
+    }
+
+    // BIG.Final, only the first half of the chaining value is needed for the 512 bit output
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_xor_si128(iv, msg[i]);
+        v = _mm_xor_si128(v, _mm_xor_si128(W[i], W[i + 8]));
+        _mm_storeu_si128((__m128i*)(output + 16 * i), v);
+    }
+}
+
+} // namespace x11_aesni
+
+#endif
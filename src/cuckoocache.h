@@ -475,6 +475,26 @@ public:
             }
         return false;
     }
+
+    /** for_each calls f for every element which isn't garbage collectable
+     *
+     * Not thread safe with concurrent inserts or erases.
+     *
+     * @param f the function to call with each element
+     */
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (uint32_t i = 0; i < size; ++i)
+            if (!collection_flags.bit_is_set(i))
+                f(table[i]);
+    }
+
+    /** @returns the maximum number of elements storable */
+    uint32_t capacity() const
+    {
+        return size;
+    }
 };
 } // namespace CuckooCache
 
@@ -20,6 +20,8 @@
 #include <memory>
 #include <stdio.h>
 
+#include <boost/algorithm/string.hpp>
+
 #include <event2/buffer.h>
 #include <event2/keyvalq_struct.h>
 #include <support/events.h>
@@ -29,6 +31,7 @@
 static const char DEFAULT_RPCCONNECT[] = "127.0.0.1";
 static const int DEFAULT_HTTP_CLIENT_TIMEOUT=900;
 static const bool DEFAULT_NAMED=false;
+static const int DEFAULT_BATCH_SIZE=1;
 static const int CONTINUE_EXECUTION=-1;
 
 static void SetupCliArgs()
@@ -37,6 +40,10 @@ static void SetupCliArgs()
     const auto testnetBaseParams = CreateBaseChainParams(CBaseChainParams::TESTNET);
 
     gArgs.AddArg("-?", "This help message", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-batch", "Read one command per line from standard input until EOF/Ctrl-D and send them all over a single keep-alive connection. "
+        "A line is the command and its arguments separated by spaces, or a JSON array of them. "
+        "One JSON-RPC reply object is written per command, in input order and with the line number as id.", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-batchsize=<n>", strprintf("Number of -batch commands to send together as one JSON-RPC batch request (default: %d)", DEFAULT_BATCH_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-getinfo", "Get general information from the remote server. Note that unlike server-side RPC calls, the results of -getinfo is the result of multiple non-atomic requests. Some entries in the result may represent results from different states (e.g. wallet balance may be as of a different block from the chain state reported)", false, OptionsCategory::OPTIONS);
@@ -96,6 +103,7 @@ static int AppInitRPC(int argc, char* argv[])
             strUsage += "\nUsage:\n"
                   "  dash-cli [options] <command> [params]  " + strprintf("Send command to %s", PACKAGE_NAME) + "\n" +
                   "  dash-cli [options] -named <command> [name=value] ... " + strprintf("Send command to %s (with named arguments)", PACKAGE_NAME) + "\n" +
+                  "  dash-cli [options] -batch              " + strprintf("Send commands read from standard input to %s", PACKAGE_NAME) + "\n" +
                   "  dash-cli [options] help                List commands\n" +
                   "  dash-cli [options] help <command>      Get help for a command\n";
 
@@ -279,18 +287,21 @@ public:
     }
 };
 
+static UniValue ConvertParams(const std::string& method, const std::vector<std::string>& args)
+{
+    if(gArgs.GetBoolArg("-named", DEFAULT_NAMED)) {
+        return RPCConvertNamedValues(method, args);
+    } else {
+        return RPCConvertValues(method, args);
+    }
+}
+
 /** Process default single requests */
 class DefaultRequestHandler: public BaseRequestHandler {
 public:
     UniValue PrepareRequest(const std::string& method, const std::vector<std::string>& args) override
     {
-        UniValue params;
-        if(gArgs.GetBoolArg("-named", DEFAULT_NAMED)) {
-            params = RPCConvertNamedValues(method, args);
-        } else {
-            params = RPCConvertValues(method, args);
-        }
-        return JSONRPCRequestObj(method, params, 1);
+        return JSONRPCRequestObj(method, ConvertParams(method, args), 1);
     }
 
     UniValue ProcessReply(const UniValue &reply) override
@@ -299,105 +310,242 @@ public:
     }
 };
 
-static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, const std::vector<std::string>& args)
+/**
+ * HTTP connection to the RPC server. With keep-alive, all requests are sent over the same connection, which libevent
+ * reopens if the server closed it in between.
+ */
+class RPCConnection
 {
-    std::string host;
-    // In preference order, we choose the following for the port:
-    //     1. -rpcport
-    //     2. port in -rpcconnect (ie following : in ipv4 or ]: in ipv6)
-    //     3. default port for chain
-    int port = BaseParams().RPCPort();
-    SplitHostPort(gArgs.GetArg("-rpcconnect", DEFAULT_RPCCONNECT), port, host);
-    port = gArgs.GetArg("-rpcport", port);
-
-    // Obtain event base
-    raii_event_base base = obtain_event_base();
-
-    // Synchronously look up hostname
-    raii_evhttp_connection evcon = obtain_evhttp_connection_base(base.get(), host, port);
-    evhttp_connection_set_timeout(evcon.get(), gArgs.GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
-
-    HTTPReply response;
-    raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
-    if (req == nullptr)
-        throw std::runtime_error("create http request failed");
+public:
+    explicit RPCConnection(bool fKeepAliveIn) : fKeepAlive(fKeepAliveIn)
+    {
+        // In preference order, we choose the following for the port:
+        //     1. -rpcport
+        //     2. port in -rpcconnect (ie following : in ipv4 or ]: in ipv6)
+        //     3. default port for chain
+        port = BaseParams().RPCPort();
+        SplitHostPort(gArgs.GetArg("-rpcconnect", DEFAULT_RPCCONNECT), port, host);
+        port = gArgs.GetArg("-rpcport", port);
+
+        // Obtain event base
+        base = obtain_event_base();
+
+        // Synchronously look up hostname
+        evcon = obtain_evhttp_connection_base(base.get(), host, port);
+        evhttp_connection_set_timeout(evcon.get(), gArgs.GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
+
+        // Get credentials
+        if (gArgs.GetArg("-rpcpassword", "") == "") {
+            // Try fall back to cookie-based authentication if no password is provided
+            if (!GetAuthCookie(&strRPCUserColonPass)) {
+                failedToGetAuthCookie = true;
+            }
+        } else {
+            strRPCUserColonPass = gArgs.GetArg("-rpcuser", "") + ":" + gArgs.GetArg("-rpcpassword", "");
+        }
+
+        // check if we should use a special wallet endpoint
+        if (!gArgs.GetArgs("-rpcwallet").empty()) {
+            std::string walletName = gArgs.GetArg("-rpcwallet", "");
+            char *encodedURI = evhttp_uriencode(walletName.c_str(), walletName.size(), false);
+            if (encodedURI) {
+                endpoint = "/wallet/"+ std::string(encodedURI);
+                free(encodedURI);
+            }
+            else {
+                throw CConnectionFailed("uri-encode failed");
+            }
+        }
+    }
+
+    /** Send a request or a batch of requests and return the parsed reply */
+    UniValue Send(const UniValue& request)
+    {
+        HTTPReply response;
+        raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
+        if (req == nullptr)
+            throw std::runtime_error("create http request failed");
 #if LIBEVENT_VERSION_NUMBER >= 0x02010300
-    evhttp_request_set_error_cb(req.get(), http_error_cb);
+        evhttp_request_set_error_cb(req.get(), http_error_cb);
 #endif
 
-    // Get credentials
-    std::string strRPCUserColonPass;
-    bool failedToGetAuthCookie = false;
-    if (gArgs.GetArg("-rpcpassword", "") == "") {
-        // Try fall back to cookie-based authentication if no password is provided
-        if (!GetAuthCookie(&strRPCUserColonPass)) {
-            failedToGetAuthCookie = true;
+        struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
+        assert(output_headers);
+        evhttp_add_header(output_headers, "Host", host.c_str());
+        evhttp_add_header(output_headers, "Connection", fKeepAlive ? "keep-alive" : "close");
+        evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
+
+        // Attach request data
+        std::string strRequest = request.write() + "\n";
+        struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
+        assert(output_buffer);
+        evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
+
+        int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, endpoint.c_str());
+        req.release(); // ownership moved to evcon in above call
+        if (r != 0) {
+            throw CConnectionFailed("send http request failed");
         }
-    } else {
-        strRPCUserColonPass = gArgs.GetArg("-rpcuser", "") + ":" + gArgs.GetArg("-rpcpassword", "");
+
+        event_base_dispatch(base.get());
+
+        if (response.status == 0) {
+            std::string responseErrorMessage;
+            if (response.error != -1) {
+                responseErrorMessage = strprintf(" (error code %d - \"%s\")", response.error, http_errorstring(response.error));
+            }
+            throw CConnectionFailed(strprintf("Could not connect to the server %s:%d%s\n\nMake sure the dashd server is running and that you are connecting to the correct RPC port.", host, port, responseErrorMessage));
+        } else if (response.status == HTTP_UNAUTHORIZED) {
+            if (failedToGetAuthCookie) {
+                throw std::runtime_error(strprintf(
+                    "Could not locate RPC credentials. No authentication cookie could be found, and RPC password is not set.  See -rpcpassword and -stdinrpcpass.  Configuration file: (%s)",
+                    GetConfigFile(gArgs.GetArg("-conf", BITCOIN_CONF_FILENAME)).string().c_str()));
+            } else {
+                throw std::runtime_error("Authorization failed: Incorrect rpcuser or rpcpassword");
+            }
+        } else if (response.status >= 400 && response.status != HTTP_BAD_REQUEST && response.status != HTTP_NOT_FOUND && response.status != HTTP_INTERNAL_SERVER_ERROR)
+            throw std::runtime_error(strprintf("server returned HTTP error %d", response.status));
+        else if (response.body.empty())
+            throw std::runtime_error("no response from server");
+
+        // Parse reply
+        UniValue valReply(UniValue::VSTR);
+        if (!valReply.read(response.body))
+            throw std::runtime_error("couldn't parse reply from server");
+        return valReply;
     }
 
-    struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
-    assert(output_headers);
-    evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
-    evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
-
-    // Attach request data
-    std::string strRequest = rh->PrepareRequest(strMethod, args).write() + "\n";
-    struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
-    assert(output_buffer);
-    evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
-
-    // check if we should use a special wallet endpoint
-    std::string endpoint = "/";
-    if (!gArgs.GetArgs("-rpcwallet").empty()) {
-        std::string walletName = gArgs.GetArg("-rpcwallet", "");
-        char *encodedURI = evhttp_uriencode(walletName.c_str(), walletName.size(), false);
-        if (encodedURI) {
-            endpoint = "/wallet/"+ std::string(encodedURI);
-            free(encodedURI);
-        }
-        else {
-            throw CConnectionFailed("uri-encode failed");
+private:
+    const bool fKeepAlive;
+    std::string host;
+    int port;
+    raii_event_base base;
+    raii_evhttp_connection evcon;
+    std::string strRPCUserColonPass;
+    bool failedToGetAuthCookie{false};
+    std::string endpoint{"/"};
+};
+
+static UniValue CallRPC(BaseRequestHandler *rh, const std::string& strMethod, const std::vector<std::string>& args)
+{
+    RPCConnection connection(false);
+    const UniValue reply = rh->ProcessReply(connection.Send(rh->PrepareRequest(strMethod, args)));
+    if (reply.empty())
+        throw std::runtime_error("expected reply to have result, error and id properties");
+
+    return reply;
+}
+
+/** A -batch command and, once known, its reply */
+struct BatchCommand
+{
+    int nLine;
+    UniValue request;
+    UniValue reply;
+};
+
+static BatchCommand ParseBatchCommand(int nLine, const std::string& line)
+{
+    BatchCommand cmd{nLine, NullUniValue, NullUniValue};
+    try {
+        std::vector<std::string> args;
+        if (line[0] == '[') {
+            UniValue val;
+            if (!val.read(line) || !val.isArray())
+                throw std::runtime_error("Error parsing JSON: " + line);
+            for (size_t i = 0; i < val.size(); i++) {
+                args.emplace_back(val[i].isStr() ? val[i].get_str() : val[i].write());
+            }
+        } else {
+            boost::split(args, line, boost::is_any_of(" \t"), boost::token_compress_on);
         }
+        if (args.empty() || args[0].empty())
+            throw std::runtime_error("too few parameters (need at least command)");
+        const std::string method = args[0];
+        args.erase(args.begin());
+        cmd.request = JSONRPCRequestObj(method, ConvertParams(method, args), NullUniValue);
+    } catch (const std::exception& e) {
+        cmd.reply = JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_PARSE_ERROR, e.what()), NullUniValue);
     }
-    int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, endpoint.c_str());
-    req.release(); // ownership moved to evcon in above call
-    if (r != 0) {
-        throw CConnectionFailed("send http request failed");
-    }
+    return cmd;
+}
 
-    event_base_dispatch(base.get());
+/**
+ * Read commands from stdin until EOF and send them over one keep-alive connection, -batchsize commands per request.
+ * Replies are written as soon as they are received. Returns EXIT_FAILURE if any command failed.
+ */
+static int CommandLineRPCBatch()
+{
+    const size_t nBatchSize = std::max<int64_t>(1, gArgs.GetArg("-batchsize", DEFAULT_BATCH_SIZE));
+    const bool fWait = gArgs.GetBoolArg("-rpcwait", false);
+    RPCConnection connection(true);
+    std::vector<BatchCommand> pending;
+    bool fFailed = false;
+
+    auto flush = [&]() {
+        UniValue batch(UniValue::VARR);
+        std::vector<BatchCommand*> sent;
+        for (auto& cmd : pending) {
+            if (cmd.request.isNull()) {
+                continue;
+            }
+            cmd.request.pushKV("id", (int)sent.size());
+            batch.push_back(cmd.request);
+            sent.push_back(&cmd);
+        }
 
-    if (response.status == 0) {
-        std::string responseErrorMessage;
-        if (response.error != -1) {
-            responseErrorMessage = strprintf(" (error code %d - \"%s\")", response.error, http_errorstring(response.error));
+        if (!sent.empty()) {
+            UniValue reply;
+            do {
+                try {
+                    reply = connection.Send(sent.size() == 1 ? sent[0]->request : batch);
+                    break;
+                } catch (const CConnectionFailed&) {
+                    if (fWait)
+                        MilliSleep(1000);
+                    else
+                        throw;
+                }
+            } while (fWait);
+
+            if (sent.size() == 1) {
+                sent[0]->reply = reply;
+            } else {
+                std::vector<UniValue> replies = JSONRPCProcessBatchReply(reply, sent.size());
+                for (size_t i = 0; i < sent.size(); i++) {
+                    sent[i]->reply = replies[i];
+                }
+            }
         }
-        throw CConnectionFailed(strprintf("Could not connect to the server %s:%d%s\n\nMake sure the dashd server is running and that you are connecting to the correct RPC port.", host, port, responseErrorMessage));
-    } else if (response.status == HTTP_UNAUTHORIZED) {
-        if (failedToGetAuthCookie) {
-            throw std::runtime_error(strprintf(
-                "Could not locate RPC credentials. No authentication cookie could be found, and RPC password is not set.  See -rpcpassword and -stdinrpcpass.  Configuration file: (%s)",
-                GetConfigFile(gArgs.GetArg("-conf", BITCOIN_CONF_FILENAME)).string().c_str()));
-        } else {
-            throw std::runtime_error("Authorization failed: Incorrect rpcuser or rpcpassword");
+
+        for (auto& cmd : pending) {
+            if (!cmd.reply.isObject())
+                throw std::runtime_error("expected reply to have result, error and id properties");
+            cmd.reply.pushKV("id", cmd.nLine);
+            if (!find_value(cmd.reply, "error").isNull())
+                fFailed = true;
+            fprintf(stdout, "%s\n", cmd.reply.write().c_str());
         }
-    } else if (response.status >= 400 && response.status != HTTP_BAD_REQUEST && response.status != HTTP_NOT_FOUND && response.status != HTTP_INTERNAL_SERVER_ERROR)
-        throw std::runtime_error(strprintf("server returned HTTP error %d", response.status));
-    else if (response.body.empty())
-        throw std::runtime_error("no response from server");
-
-    // Parse reply
-    UniValue valReply(UniValue::VSTR);
-    if (!valReply.read(response.body))
-        throw std::runtime_error("couldn't parse reply from server");
-    const UniValue reply = rh->ProcessReply(valReply);
-    if (reply.empty())
-        throw std::runtime_error("expected reply to have result, error and id properties");
+        fflush(stdout);
+        pending.clear();
+    };
+
+    std::string line;
+    int nLine = 0;
+    while (std::getline(std::cin, line)) {
+        nLine++;
+        boost::algorithm::trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        pending.emplace_back(ParseBatchCommand(nLine, line));
+        if (pending.size() >= nBatchSize) {
+            flush();
+        }
+    }
+    flush();
 
-    return reply;
+    return fFailed ? EXIT_FAILURE : 0;
 }
 
 int CommandLineRPC(int argc, char *argv[])
@@ -417,6 +565,12 @@ int CommandLineRPC(int argc, char *argv[])
             }
             gArgs.ForceSetArg("-rpcpassword", rpcPass);
         }
+        if (gArgs.GetBoolArg("-batch", false)) {
+            if (argc > 1 || gArgs.GetBoolArg("-stdin", false) || gArgs.GetBoolArg("-getinfo", false)) {
+                throw std::runtime_error("-batch takes no arguments and can't be combined with -stdin or -getinfo");
+            }
+            return CommandLineRPCBatch();
+        }
         std::vector<std::string> args = std::vector<std::string>(&argv[1], &argv[argc]);
         if (gArgs.GetBoolArg("-stdin", false)) {
             // Read one arg per line from stdin and append
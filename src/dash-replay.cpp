@@ -0,0 +1,275 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/dash-config.h>
+#endif
+
+#include <chainparams.h>
+#include <chainparamsbase.h>
+#include <clientversion.h>
+#include <crypto/sha256.h>
+#include <fs.h>
+#include <hash.h>
+#include <messagecapture.h>
+#include <netbase.h>
+#include <protocol.h>
+#include <util.h>
+#include <utilstrencodings.h>
+#include <utiltime.h>
+
+#include <iostream>
+#include <memory>
+#include <stdio.h>
+#include <thread>
+
+#include <stacktraces.h>
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+static const int CONTINUE_EXECUTION = -1;
+/** Default for -speed, replay at the speed the messages were received */
+static const char* DEFAULT_REPLAY_SPEED = "1";
+
+static void SetupReplayArgs()
+{
+    gArgs.AddArg("-?", "This help message", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-connect=<host>[:<port>]", "Node to replay the messages to (default: 127.0.0.1 on the default port of the chain)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-speed=<factor>", strprintf("Replay at <factor> times the speed the messages were received at, 0 replays as fast as possible (default: %s)", DEFAULT_REPLAY_SPEED), false, OptionsCategory::OPTIONS);
+    SetupChainParamsBaseOptions();
+}
+
+static int AppInitReplay(int argc, char* argv[])
+{
+    SetupReplayArgs();
+    gArgs.ParseParameters(argc, argv);
+
+    // Check for -testnet or -regtest parameter (Params() calls are only valid after this clause)
+    try {
+        SelectParams(gArgs.GetChainName());
+    } catch (const std::exception& e) {
+        tfm::format(std::cerr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    if (argc < 2 || gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help")) {
+        std::string strUsage = strprintf("%s dash-replay utility version", PACKAGE_NAME) + " " + FormatFullVersion() + "\n\n" +
+            "Replay the P2P messages captured by a node running with -capturemessages to another node. Every capture\n"
+            "file is replayed on its own connection, at the time relative to the first message of all files.\n\n" +
+            "Usage:\n"
+            "  dash-replay [options] <capture file>...\n"
+            "\n";
+        strUsage += gArgs.GetHelpMessage();
+        tfm::format(std::cout, "%s", strUsage.c_str());
+
+        if (argc < 2) {
+            tfm::format(std::cerr, "Error: too few parameters\n");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    return CONTINUE_EXECUTION;
+}
+
+/** Replays one capture file over its own connection */
+class CReplayPeer
+{
+public:
+    std::string strFile;
+    std::unique_ptr<CMessageCaptureReader> reader;
+    SOCKET hSocket{INVALID_SOCKET};
+
+    size_t nMessages{0};
+    size_t nBytes{0};
+    std::string strError;
+
+    ~CReplayPeer() { CloseSocket(hSocket); }
+
+    bool Connect(const CService& addrNode)
+    {
+        hSocket = CreateSocket(addrNode);
+        if (hSocket == INVALID_SOCKET || !ConnectSocketDirectly(addrNode, hSocket, nConnectTimeout, true)) {
+            strError = strprintf("can't connect to %s", addrNode.ToString());
+            return false;
+        }
+        // the replay thread blocks while sending, the node's replies are drained by another thread
+        if (!SetSocketNonBlocking(hSocket, false)) {
+            strError = "can't make the socket blocking";
+            return false;
+        }
+        return true;
+    }
+
+    bool Send(const std::vector<unsigned char>& data)
+    {
+        size_t nSent = 0;
+        while (nSent < data.size()) {
+            ssize_t ret = send(hSocket, (const char*)data.data() + nSent, data.size() - nSent, MSG_NOSIGNAL);
+            if (ret <= 0) {
+                strError = strprintf("node disconnected after %d messages: %s", nMessages, NetworkErrorString(WSAGetLastError()));
+                return false;
+            }
+            nSent += ret;
+        }
+        return true;
+    }
+
+    /** Read and discard everything the node sends, so that it never stops processing our messages due to a full send buffer */
+    void DrainReplies()
+    {
+        char buf[0x10000];
+        while (recv(hSocket, buf, sizeof(buf), 0) > 0) {
+        }
+    }
+
+    /** Send all messages, each at nTimeStartMicros + (time received - nFirstTimeMicros) / dSpeed */
+    void Replay(int64_t nFirstTimeMicros, int64_t nTimeStartMicros, double dSpeed)
+    {
+        std::thread drainThread(&CReplayPeer::DrainReplies, this);
+
+        CCapturedMessage msg;
+        int64_t nTimeMicros;
+        while (reader->Read(msg, nTimeMicros)) {
+            if (dSpeed > 0) {
+                int64_t nSendTime = nTimeStartMicros + (int64_t)((nTimeMicros - nFirstTimeMicros) / dSpeed);
+                int64_t nNow = GetTimeMicros();
+                if (nSendTime > nNow) {
+                    MilliSleep((nSendTime - nNow) / 1000);
+                }
+            }
+
+            // rebuild the header with the message start of the network replayed on
+            CMessageHeader hdr(Params().MessageStart(), msg.strCommand.c_str(), msg.vPayload.size());
+            uint256 hash = Hash(msg.vPayload.begin(), msg.vPayload.end());
+            memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+            std::vector<unsigned char> data;
+            CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, data, 0, hdr};
+            data.insert(data.end(), msg.vPayload.begin(), msg.vPayload.end());
+            if (!Send(data)) {
+                break;
+            }
+            nMessages++;
+            nBytes += data.size();
+        }
+
+        // stops the drain thread
+#ifdef WIN32
+        shutdown(hSocket, SD_BOTH);
+#else
+        shutdown(hSocket, SHUT_RDWR);
+#endif
+        drainThread.join();
+    }
+};
+
+static int CommandLineReplay(int argc, char* argv[])
+{
+    // skip the options, the remaining arguments are capture files
+    while (argc > 1 && IsSwitchChar(argv[1][0])) {
+        argc--;
+        argv++;
+    }
+    if (argc < 2) {
+        tfm::format(std::cerr, "Error: no capture files given\n");
+        return EXIT_FAILURE;
+    }
+
+    double dSpeed;
+    if (!ParseDouble(gArgs.GetArg("-speed", DEFAULT_REPLAY_SPEED), &dSpeed) || dSpeed < 0) {
+        tfm::format(std::cerr, "Error: invalid -speed\n");
+        return EXIT_FAILURE;
+    }
+
+    CService addrNode;
+    std::string strConnect = gArgs.GetArg("-connect", "127.0.0.1");
+    if (!Lookup(strConnect.c_str(), addrNode, Params().GetDefaultPort(), true)) {
+        tfm::format(std::cerr, "Error: can't resolve -connect=%s\n", strConnect);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::unique_ptr<CReplayPeer>> vPeers;
+    int64_t nFirstTimeMicros = std::numeric_limits<int64_t>::max();
+    for (int i = 1; i < argc; i++) {
+        std::unique_ptr<CReplayPeer> peer(new CReplayPeer());
+        peer->strFile = argv[i];
+        FILE* file = fsbridge::fopen(peer->strFile, "rb");
+        if (!file) {
+            tfm::format(std::cerr, "Error: can't open %s\n", peer->strFile);
+            return EXIT_FAILURE;
+        }
+        try {
+            peer->reader.reset(new CMessageCaptureReader(file));
+        } catch (const std::exception& e) {
+            tfm::format(std::cerr, "Error: can't read %s: %s\n", peer->strFile, e.what());
+            return EXIT_FAILURE;
+        }
+        nFirstTimeMicros = std::min(nFirstTimeMicros, peer->reader->GetHeader().nTimeStartMicros);
+        vPeers.emplace_back(std::move(peer));
+    }
+
+    for (auto& peer : vPeers) {
+        if (!peer->Connect(addrNode)) {
+            tfm::format(std::cerr, "Error: %s: %s\n", peer->strFile, peer->strError);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int64_t nTimeStartMicros = GetTimeMicros();
+    std::vector<std::thread> vThreads;
+    for (auto& peer : vPeers) {
+        vThreads.emplace_back(&CReplayPeer::Replay, peer.get(), nFirstTimeMicros, nTimeStartMicros, dSpeed);
+    }
+    for (auto& thread : vThreads) {
+        thread.join();
+    }
+    double dSeconds = (GetTimeMicros() - nTimeStartMicros) / 1000000.0;
+
+    int ret = EXIT_SUCCESS;
+    size_t nTotalMessages = 0;
+    size_t nTotalBytes = 0;
+    for (const auto& peer : vPeers) {
+        tfm::format(std::cout, "%s (peer %s): %d messages, %d bytes\n", peer->strFile, peer->reader->GetHeader().strPeerAddr, peer->nMessages, peer->nBytes);
+        if (!peer->strError.empty()) {
+            tfm::format(std::cerr, "Error: %s: %s\n", peer->strFile, peer->strError);
+            ret = EXIT_FAILURE;
+        }
+        nTotalMessages += peer->nMessages;
+        nTotalBytes += peer->nBytes;
+    }
+    tfm::format(std::cout, "replayed %d messages, %d bytes in %.3fs (%.1f messages/s)\n", nTotalMessages, nTotalBytes, dSeconds,
+        dSeconds > 0 ? nTotalMessages / dSeconds : 0.0);
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    RegisterPrettyTerminateHander();
+    RegisterPrettySignalHandlers();
+
+    SetupEnvironment();
+    if (!SetupNetworking()) {
+        tfm::format(std::cerr, "Error: Initializing networking failed\n");
+        return EXIT_FAILURE;
+    }
+    SHA256AutoDetect();
+
+    try {
+        int ret = AppInitReplay(argc, argv);
+        if (ret != CONTINUE_EXECUTION)
+            return ret;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(std::current_exception(), "AppInitReplay()");
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_FAILURE;
+    try {
+        ret = CommandLineReplay(argc, argv);
+    } catch (...) {
+        PrintExceptionContinue(std::current_exception(), "CommandLineReplay()");
+    }
+    return ret;
+}
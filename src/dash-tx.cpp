@@ -21,22 +21,39 @@
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
 #include <memory>
+#include <mutex>
 #include <stdio.h>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 
 #include <stacktraces.h>
 
 static bool fCreateBlank;
-static std::map<std::string,UniValue> registers;
 static const int CONTINUE_EXECUTION=-1;
 
+typedef std::map<std::string,UniValue> Registers;
+
+/** Default for -par, the number of threads to process transactions with in -bulk mode (0 = all cores) */
+static const int DEFAULT_BULK_THREADS = 0;
+/** Maximum number of lines read ahead of the last output in -bulk mode */
+static const size_t MAX_BULK_PENDING = 4096;
+
 static void SetupBitcoinTxArgs()
 {
     gArgs.AddArg("-?", "This help message", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-bulk", "Read one transaction per line from standard input, either as <hex-tx>|-create [commands] separated by spaces "
+        "or as a JSON array of these arguments, and write one result per line, in the same order. Empty lines are ignored. "
+        "Failed transactions are reported on stderr and leave an empty output line. Commands given on the command line must be "
+        "register commands and their registers are used by all transactions.", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-create", "Create new, empty TX.", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-json", "Select JSON output", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-par=<n>", strprintf("Number of threads to process transactions with in -bulk mode (0 = all cores, default: %d)", DEFAULT_BULK_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-txid", "Output only the hex-encoded transaction id of the resultant transaction.", false, OptionsCategory::OPTIONS);
     SetupChainParamsBaseOptions();
 
@@ -97,6 +114,7 @@ static int AppInitRawTx(int argc, char* argv[])
             "Usage:\n"
               "  dash-tx [options] <hex-tx> [commands]  Update hex-encoded dash transaction\n" +
               "  dash-tx [options] -create [commands]   Create hex-encoded dash transaction\n" +
+              "  dash-tx [options] -bulk [register commands]  Process one transaction per line of standard input\n" +
               "\n";
         strUsage += gArgs.GetHelpMessage();
 
@@ -111,7 +129,7 @@ static int AppInitRawTx(int argc, char* argv[])
     return CONTINUE_EXECUTION;
 }
 
-static void RegisterSetJson(const std::string& key, const std::string& rawJson)
+static void RegisterSetJson(Registers& registers, const std::string& key, const std::string& rawJson)
 {
     UniValue val;
     if (!val.read(rawJson)) {
@@ -122,7 +140,7 @@ static void RegisterSetJson(const std::string& key, const std::string& rawJson)
     registers[key] = val;
 }
 
-static void RegisterSet(const std::string& strInput)
+static void RegisterSet(Registers& registers, const std::string& strInput)
 {
     // separate NAME:VALUE in string
     size_t pos = strInput.find(':');
@@ -134,10 +152,10 @@ static void RegisterSet(const std::string& strInput)
     std::string key = strInput.substr(0, pos);
     std::string valStr = strInput.substr(pos + 1, std::string::npos);
 
-    RegisterSetJson(key, valStr);
+    RegisterSetJson(registers, key, valStr);
 }
 
-static void RegisterLoad(const std::string& strInput)
+static void RegisterLoad(Registers& registers, const std::string& strInput)
 {
     // separate NAME:FILENAME in string
     size_t pos = strInput.find(':');
@@ -175,7 +193,7 @@ static void RegisterLoad(const std::string& strInput)
     }
 
     // evaluate as JSON buffer register
-    RegisterSetJson(key, valStr);
+    RegisterSetJson(registers, key, valStr);
 }
 
 static CAmount ExtractAndValidateValue(const std::string& strValue)
@@ -491,7 +509,7 @@ static CAmount AmountFromValue(const UniValue& value)
     return amount;
 }
 
-static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
+static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr, const Registers& registers)
 {
     int nHashType = SIGHASH_ALL;
 
@@ -509,7 +527,7 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
     if (!registers.count("privatekeys"))
         throw std::runtime_error("privatekeys register variable must be set.");
     CBasicKeyStore tempKeystore;
-    UniValue keysObj = registers["privatekeys"];
+    const UniValue& keysObj = registers.at("privatekeys");
 
     for (unsigned int kidx = 0; kidx < keysObj.size(); kidx++) {
         if (!keysObj[kidx].isStr())
@@ -524,7 +542,7 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
     // Add previous txouts given in the RPC call:
     if (!registers.count("prevtxs"))
         throw std::runtime_error("prevtxs register variable must be set.");
-    UniValue prevtxsObj = registers["prevtxs"];
+    const UniValue& prevtxsObj = registers.at("prevtxs");
     {
         for (unsigned int previdx = 0; previdx < prevtxsObj.size(); previdx++) {
             UniValue prevOut = prevtxsObj[previdx];
@@ -619,10 +637,17 @@ public:
     }
 };
 
+// Set in -bulk mode, where ECC is initialized once for all transactions instead of per command
+static std::unique_ptr<Secp256k1Init> globalEcc;
+
 static void MutateTx(CMutableTransaction& tx, const std::string& command,
-                     const std::string& commandVal)
+                     const std::string& commandVal, Registers& registers)
 {
     std::unique_ptr<Secp256k1Init> ecc;
+    auto initEcc = [&]() {
+        if (!globalEcc)
+            ecc.reset(new Secp256k1Init());
+    };
 
     if (command == "nversion")
         MutateTxVersion(tx, commandVal);
@@ -639,10 +664,10 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
     else if (command == "outaddr")
         MutateTxAddOutAddr(tx, commandVal);
     else if (command == "outpubkey") {
-        ecc.reset(new Secp256k1Init());
+        initEcc();
         MutateTxAddOutPubKey(tx, commandVal);
     } else if (command == "outmultisig") {
-        ecc.reset(new Secp256k1Init());
+        initEcc();
         MutateTxAddOutMultiSig(tx, commandVal);
     } else if (command == "outscript")
         MutateTxAddOutScript(tx, commandVal);
@@ -650,51 +675,52 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
         MutateTxAddOutData(tx, commandVal);
 
     else if (command == "sign") {
-        ecc.reset(new Secp256k1Init());
-        MutateTxSign(tx, commandVal);
+        initEcc();
+        MutateTxSign(tx, commandVal, registers);
     }
 
     else if (command == "load")
-        RegisterLoad(commandVal);
+        RegisterLoad(registers, commandVal);
 
     else if (command == "set")
-        RegisterSet(commandVal);
+        RegisterSet(registers, commandVal);
 
     else
         throw std::runtime_error("unknown command");
 }
 
-static void OutputTxJSON(const CTransaction& tx)
+static std::string FormatTxJSON(const CTransaction& tx, unsigned int prettyIndent)
 {
     UniValue entry(UniValue::VOBJ);
     TxToUniv(tx, uint256(), entry);
 
-    std::string jsonOutput = entry.write(4);
-    fprintf(stdout, "%s\n", jsonOutput.c_str());
+    return entry.write(prettyIndent);
 }
 
-static void OutputTxHash(const CTransaction& tx)
+static std::string FormatTxHash(const CTransaction& tx)
 {
-    std::string strHexHash = tx.GetHash().GetHex(); // the hex-encoded transaction hash (aka the transaction id)
-
-    fprintf(stdout, "%s\n", strHexHash.c_str());
+    return tx.GetHash().GetHex(); // the hex-encoded transaction hash (aka the transaction id)
 }
 
-static void OutputTxHex(const CTransaction& tx)
+static std::string FormatTxHex(const CTransaction& tx)
 {
-    std::string strHex = EncodeHexTx(tx);
-
-    fprintf(stdout, "%s\n", strHex.c_str());
+    return EncodeHexTx(tx);
 }
 
-static void OutputTx(const CTransaction& tx)
+// JSON is written on a single line in -bulk mode, so that every transaction results in exactly one output line
+static std::string FormatTx(const CTransaction& tx, bool fSingleLine)
 {
     if (gArgs.GetBoolArg("-json", false))
-        OutputTxJSON(tx);
+        return FormatTxJSON(tx, fSingleLine ? 0 : 4);
     else if (gArgs.GetBoolArg("-txid", false))
-        OutputTxHash(tx);
+        return FormatTxHash(tx);
     else
-        OutputTxHex(tx);
+        return FormatTxHex(tx);
+}
+
+static void OutputTx(const CTransaction& tx)
+{
+    fprintf(stdout, "%s\n", FormatTx(tx, false).c_str());
 }
 
 static std::string readStdin()
@@ -717,6 +743,166 @@ static std::string readStdin()
     return ret;
 }
 
+static void SplitCommand(const std::string& arg, std::string& key, std::string& value)
+{
+    size_t eqpos = arg.find('=');
+    if (eqpos == std::string::npos)
+        key = arg;
+    else {
+        key = arg.substr(0, eqpos);
+        value = arg.substr(eqpos + 1);
+    }
+}
+
+/** Builds the transaction of one -bulk input line and returns its formatted output */
+static std::string ProcessBulkLine(const std::string& line, const Registers& baseRegisters)
+{
+    std::vector<std::string> args;
+    if (line[0] == '[') {
+        UniValue val;
+        if (!val.read(line) || !val.isArray())
+            throw std::runtime_error("invalid JSON arguments");
+        for (size_t i = 0; i < val.size(); i++) {
+            if (!val[i].isStr())
+                throw std::runtime_error("JSON arguments must be strings");
+            args.emplace_back(val[i].get_str());
+        }
+    } else {
+        boost::split(args, line, boost::is_any_of(" \t"), boost::token_compress_on);
+    }
+
+    CMutableTransaction tx;
+    size_t startArg = 0;
+    if (!args.empty() && args[0] == "-create") {
+        startArg = 1;
+    } else if (!fCreateBlank) {
+        if (args.empty())
+            throw std::runtime_error("too few parameters");
+        if (!DecodeHexTx(tx, args[0]))
+            throw std::runtime_error("invalid transaction encoding");
+        startArg = 1;
+    }
+
+    // Registers set by a line only apply to that line
+    Registers registers(baseRegisters);
+    for (size_t i = startArg; i < args.size(); i++) {
+        std::string key, value;
+        SplitCommand(args[i], key, value);
+        MutateTx(tx, key, value, registers);
+    }
+    return FormatTx(tx, true);
+}
+
+/**
+ * Reads transactions from stdin until EOF and processes them on -par threads. Results are written as soon as all
+ * previous lines are written, so that the output order matches the input order.
+ */
+static int BulkRawTx(const Registers& baseRegisters)
+{
+    struct BulkJob {
+        size_t nIndex;
+        size_t nLine;
+        std::string line;
+    };
+    struct BulkResult {
+        size_t nLine;
+        bool fOk;
+        std::string str;
+    };
+
+    int nThreads = gArgs.GetArg("-par", DEFAULT_BULK_THREADS);
+    if (nThreads <= 0) {
+        nThreads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    std::mutex cs;
+    std::condition_variable cvJobs;
+    std::condition_variable cvOutput;
+    std::deque<BulkJob> jobs;
+    std::map<size_t, BulkResult> results;
+    size_t nNextOutput = 0;
+    bool fEof = false;
+    bool fFailed = false;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(cs);
+        while (true) {
+            cvJobs.wait(lock, [&]() { return !jobs.empty() || fEof; });
+            if (jobs.empty()) {
+                return;
+            }
+            BulkJob job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            BulkResult result{job.nLine, false, ""};
+            try {
+                result.str = ProcessBulkLine(job.line, baseRegisters);
+                result.fOk = true;
+            } catch (const std::exception& ex) {
+                result.str = ex.what();
+            } catch (...) {
+                result.str = "unknown error";
+            }
+
+            lock.lock();
+            results.emplace(job.nIndex, std::move(result));
+            for (auto it = results.find(nNextOutput); it != results.end(); it = results.find(nNextOutput)) {
+                if (it->second.fOk) {
+                    fprintf(stdout, "%s\n", it->second.str.c_str());
+                } else {
+                    fprintf(stdout, "\n");
+                    fprintf(stderr, "error: line %u: %s\n", (unsigned int)it->second.nLine, it->second.str.c_str());
+                    fFailed = true;
+                }
+                results.erase(it);
+                nNextOutput++;
+            }
+            fflush(stdout);
+            cvOutput.notify_one();
+        }
+    };
+
+    globalEcc.reset(new Secp256k1Init());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+
+    std::string line;
+    size_t nLine = 0;
+    size_t nIndex = 0;
+    while (std::getline(std::cin, line)) {
+        nLine++;
+        boost::algorithm::trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(cs);
+        cvOutput.wait(lock, [&]() { return nIndex - nNextOutput < MAX_BULK_PENDING; });
+        jobs.push_back({nIndex++, nLine, std::move(line)});
+        cvJobs.notify_one();
+    }
+    bool fReadError = std::cin.bad();
+
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        fEof = true;
+    }
+    cvJobs.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+    globalEcc.reset();
+
+    if (fReadError) {
+        fprintf(stderr, "error: error reading stdin\n");
+        return EXIT_FAILURE;
+    }
+    return fFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static int CommandLineRawTx(int argc, char* argv[])
 {
     std::string strPrint;
@@ -729,7 +915,23 @@ static int CommandLineRawTx(int argc, char* argv[])
             argv++;
         }
 
+        if (gArgs.GetBoolArg("-bulk", false)) {
+            Registers registers;
+            for (int i = 1; i < argc; i++) {
+                std::string key, value;
+                SplitCommand(argv[i], key, value);
+                if (key == "load")
+                    RegisterLoad(registers, value);
+                else if (key == "set")
+                    RegisterSet(registers, value);
+                else
+                    throw std::runtime_error("only register commands are allowed with -bulk");
+            }
+            return BulkRawTx(registers);
+        }
+
         CMutableTransaction tx;
+        Registers registers;
         int startArg;
 
         if (!fCreateBlank) {
@@ -750,17 +952,10 @@ static int CommandLineRawTx(int argc, char* argv[])
             startArg = 1;
 
         for (int i = startArg; i < argc; i++) {
-            std::string arg = argv[i];
             std::string key, value;
-            size_t eqpos = arg.find('=');
-            if (eqpos == std::string::npos)
-                key = arg;
-            else {
-                key = arg.substr(0, eqpos);
-                value = arg.substr(eqpos + 1);
-            }
+            SplitCommand(argv[i], key, value);
 
-            MutateTx(tx, key, value);
+            MutateTx(tx, key, value, registers);
         }
 
         OutputTx(tx);
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <random.h>
+#include <utilmemory.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -13,6 +14,12 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -72,7 +79,95 @@ public:
     }
 };
 
-static void SetMaxOpenFiles(leveldb::Options *options) {
+static const CDBProfile dbProfiles[] = {
+    // name, block cache %, block size, bloom bits, compression, max open files
+    {"default", 50, 4 * 1024, 10, false, 0},
+    // Point lookups of mostly existing keys: more of the cache for blocks and fewer bloom false positives
+    {"readheavy", 75, 16 * 1024, 14, false, 0},
+    // Large batches: bigger write buffers mean fewer and larger level 0 files
+    {"writeheavy", 25, 4 * 1024, 10, false, 0},
+    // Rarely read history: larger blocks compress better and suit its sequential scans
+    {"compressed", 50, 32 * 1024, 10, true, 0},
+    // Small databases don't need many file descriptors
+    {"small", 50, 4 * 1024, 10, false, 64},
+};
+
+static const std::map<std::string, std::string> mapDefaultDBProfiles = {
+    {"index", "readheavy"},
+    {"evodb", "compressed"},
+    {"llmq", "readheavy"},
+    {"governance", "small"},
+};
+
+const CDBProfile* GetDBProfile(const std::string& strName)
+{
+    for (const auto& profile : dbProfiles) {
+        if (profile.name == strName) {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
+
+std::string GetDBProfileNames()
+{
+    std::string strRet;
+    for (const auto& profile : dbProfiles) {
+        strRet += (strRet.empty() ? "" : ", ") + profile.name;
+    }
+    return strRet;
+}
+
+std::string GetDefaultDBProfiles()
+{
+    std::string strRet;
+    for (const auto& p : mapDefaultDBProfiles) {
+        strRet += (strRet.empty() ? "" : ", ") + p.first + ":" + p.second;
+    }
+    return strRet;
+}
+
+static bool ParseDBProfileArg(const std::string& strArg, std::string& strDBNameRet, std::string& strProfileRet)
+{
+    size_t pos = strArg.find(':');
+    if (pos == std::string::npos || pos == 0) {
+        return false;
+    }
+    strDBNameRet = strArg.substr(0, pos);
+    strProfileRet = strArg.substr(pos + 1);
+    return GetDBProfile(strProfileRet) != nullptr;
+}
+
+bool CheckDBProfileArgs(std::string& strError)
+{
+    for (const auto& strArg : gArgs.GetArgs("-dbprofile")) {
+        std::string strDBName, strProfile;
+        if (!ParseDBProfileArg(strArg, strDBName, strProfile)) {
+            strError = strprintf("Invalid -dbprofile '%s', expected <db>:<profile> with one of the profiles %s", strArg, GetDBProfileNames());
+            return false;
+        }
+    }
+    return true;
+}
+
+const CDBProfile& GetDBProfileForDB(const std::string& strDBName)
+{
+    std::string strProfile = "default";
+    auto it = mapDefaultDBProfiles.find(strDBName);
+    if (it != mapDefaultDBProfiles.end()) {
+        strProfile = it->second;
+    }
+    // The last matching argument wins
+    for (const auto& strArg : gArgs.GetArgs("-dbprofile")) {
+        std::string strArgDBName, strArgProfile;
+        if (ParseDBProfileArg(strArg, strArgDBName, strArgProfile) && strArgDBName == strDBName) {
+            strProfile = strArgProfile;
+        }
+    }
+    return *GetDBProfile(strProfile);
+}
+
+static void SetMaxOpenFiles(leveldb::Options *options, int nMaxOpenFiles) {
     // On most platforms the default setting of max_open_files (which is 1000)
     // is optimal. On Windows using a large file count is OK because the handles
     // do not interfere with select() loops. On 64-bit Unix hosts this value is
@@ -93,28 +188,215 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
         options->max_open_files = 64;
     }
 #endif
+    if (nMaxOpenFiles > 0) {
+        options->max_open_files = std::min(options->max_open_files, nMaxOpenFiles);
+    }
     LogPrint(BCLog::LEVELDB, "LevelDB using max_open_files=%d (default=%d)\n",
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBProfile& profile)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.block_cache = leveldb::NewLRUCache(nCacheSize * profile.nBlockCachePercent / 100);
+    // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = nCacheSize * (100 - profile.nBlockCachePercent) / 200;
+    options.block_size = profile.nBlockSize;
+    options.filter_policy = leveldb::NewBloomFilterPolicy(profile.nBloomBits);
+    options.compression = profile.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
         options.paranoid_checks = true;
     }
-    SetMaxOpenFiles(&options);
+    SetMaxOpenFiles(&options, profile.nMaxOpenFiles);
     return options;
 }
 
+/** Copies the changes of a batch into another one */
+class CWriteBatchAppender : public leveldb::WriteBatch::Handler
+{
+private:
+    leveldb::WriteBatch& dst;
+
+public:
+    explicit CWriteBatchAppender(leveldb::WriteBatch& _dst) : dst(_dst) {}
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override { dst.Put(key, value); }
+    void Delete(const leveldb::Slice& key) override { dst.Delete(key); }
+};
+
+class CDBAsyncWriter
+{
+private:
+    struct PendingBatch {
+        leveldb::WriteBatch batch;
+        bool fSync;
+        uint64_t nSeq;
+    };
+    //! newest queued value of a key, erased once the batch which wrote it last was written
+    struct OverlayEntry {
+        uint64_t nSeq;
+        bool fErased;
+        std::string value;
+    };
+    /** Records the changes of a queued batch in the overlay */
+    class OverlayUpdater : public leveldb::WriteBatch::Handler
+    {
+    private:
+        CDBAsyncWriter& writer;
+        const uint64_t nSeq;
+
+    public:
+        OverlayUpdater(CDBAsyncWriter& _writer, uint64_t _nSeq) : writer(_writer), nSeq(_nSeq) {}
+        void Put(const leveldb::Slice& key, const leveldb::Slice& value) override
+        {
+            writer.overlay[key.ToString()] = OverlayEntry{nSeq, false, value.ToString()};
+        }
+        void Delete(const leveldb::Slice& key) override
+        {
+            writer.overlay[key.ToString()] = OverlayEntry{nSeq, true, std::string()};
+        }
+    };
+
+    CDBWrapper& parent;
+
+    mutable std::mutex cs;
+    std::condition_variable condQueued;
+    std::condition_variable condWritten;
+    std::deque<PendingBatch> queue;
+    std::unordered_map<std::string, OverlayEntry> overlay;
+    uint64_t nQueuedSeq{0};
+    uint64_t nWrittenSeq{0};
+    //! message of the first failed write, no more writes are accepted after it
+    std::string strError;
+    bool fStop{false};
+    std::thread thread;
+
+    void ThreadMain()
+    {
+        std::unique_lock<std::mutex> l(cs);
+        while (true) {
+            condQueued.wait(l, [this] { return fStop || !queue.empty(); });
+            if (queue.empty()) {
+                // Only stop once everything is written
+                return;
+            }
+
+            std::deque<PendingBatch> pending;
+            pending.swap(queue);
+            l.unlock();
+
+            leveldb::WriteBatch combined;
+            bool fSync = false;
+            if (pending.size() > 1) {
+                CWriteBatchAppender appender(combined);
+                for (const auto& p : pending) {
+                    p.batch.Iterate(&appender);
+                    fSync |= p.fSync;
+                }
+            }
+            std::string strWriteError;
+            try {
+                // Large batches like the ones of CEvoDB::CommitRootTransactionAsync() are usually alone, don't copy them
+                if (pending.size() == 1) {
+                    parent.WriteLevelDBBatch(pending.front().batch, pending.front().fSync);
+                } else {
+                    parent.WriteLevelDBBatch(combined, fSync);
+                }
+            } catch (const dbwrapper_error& e) {
+                strWriteError = e.what();
+            }
+
+            l.lock();
+            nWrittenSeq = pending.back().nSeq;
+            if (!strWriteError.empty()) {
+                // The overlay is kept, so that reads are at least consistent with what callers wrote
+                LogPrintf("%s -- writing to %s failed: %s\n", __func__, parent.m_name, strWriteError);
+                if (strError.empty()) {
+                    strError = strWriteError;
+                }
+            } else {
+                for (auto it = overlay.begin(); it != overlay.end(); ) {
+                    if (it->second.nSeq <= nWrittenSeq) {
+                        it = overlay.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            condWritten.notify_all();
+        }
+    }
+
+    void ThrowIfFailed() const
+    {
+        if (!strError.empty()) {
+            throw dbwrapper_error(strError);
+        }
+    }
+
+public:
+    explicit CDBAsyncWriter(CDBWrapper& _parent) : parent(_parent)
+    {
+        thread = std::thread(&TraceThread<std::function<void()> >, "dbwriter", std::function<void()>(std::bind(&CDBAsyncWriter::ThreadMain, this)));
+    }
+
+    ~CDBAsyncWriter()
+    {
+        {
+            std::unique_lock<std::mutex> l(cs);
+            fStop = true;
+        }
+        condQueued.notify_one();
+        thread.join();
+    }
+
+    void Write(const leveldb::WriteBatch& batch, bool fSync, bool fWait)
+    {
+        std::unique_lock<std::mutex> l(cs);
+        ThrowIfFailed();
+        uint64_t nSeq = ++nQueuedSeq;
+        OverlayUpdater updater(*this, nSeq);
+        batch.Iterate(&updater);
+        queue.emplace_back(PendingBatch{batch, fSync, nSeq});
+        condQueued.notify_one();
+        if (fWait) {
+            condWritten.wait(l, [&] { return nWrittenSeq >= nSeq; });
+            ThrowIfFailed();
+        }
+    }
+
+    void WaitForWrites()
+    {
+        std::unique_lock<std::mutex> l(cs);
+        uint64_t nSeq = nQueuedSeq;
+        condWritten.wait(l, [&] { return nWrittenSeq >= nSeq; });
+        ThrowIfFailed();
+    }
+
+    //! Returns false if the key has no queued changes, otherwise sets fFoundRet and strValueRet to the newest ones
+    bool Read(const leveldb::Slice& key, bool& fFoundRet, std::string& strValueRet) const
+    {
+        std::unique_lock<std::mutex> l(cs);
+        auto it = overlay.find(key.ToString());
+        if (it == overlay.end()) {
+            return false;
+        }
+        fFoundRet = !it->second.fErased;
+        if (fFoundRet) {
+            strValueRet = it->second.value;
+        }
+        return true;
+    }
+};
+
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+    : CDBWrapper(path, nCacheSize, GetDBProfileForDB(fs::basename(path)), fMemory, fWipe, obfuscate)
+{
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, const CDBProfile& profile, bool fMemory, bool fWipe, bool obfuscate)
     : m_name(fs::basename(path))
 {
     penv = nullptr;
@@ -122,7 +404,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, profile);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -134,7 +416,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
             dbwrapper_private::HandleError(result);
         }
         TryCreateDirectories(path);
-        LogPrintf("Opening LevelDB in %s\n", path.string());
+        LogPrintf("Opening LevelDB in %s (profile %s)\n", path.string(), profile.name);
     }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
@@ -168,6 +450,8 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
 
 CDBWrapper::~CDBWrapper()
 {
+    // Writes everything which is still queued
+    m_async_writer.reset();
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -180,21 +464,69 @@ CDBWrapper::~CDBWrapper()
     options.env = nullptr;
 }
 
+bool CDBWrapper::ReadRaw(const leveldb::Slice& slKey, std::string& strValue) const
+{
+    bool fFound;
+    if (m_async_writer && m_async_writer->Read(slKey, fFound, strValue)) {
+        return fFound;
+    }
+    leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+    if (!status.ok()) {
+        if (status.IsNotFound())
+            return false;
+        LogPrintf("LevelDB read failure: %s\n", status.ToString());
+        dbwrapper_private::HandleError(status);
+    }
+    return true;
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
+{
+    if (m_async_writer) {
+        // Also goes through the writer thread, so that it is ordered after the batches queued before
+        m_async_writer->Write(batch.batch, fSync, true);
+        return true;
+    }
+    WriteLevelDBBatch(batch.batch, fSync);
+    return true;
+}
+
+void CDBWrapper::StartAsyncWriter()
+{
+    assert(!m_async_writer);
+    m_async_writer = MakeUnique<CDBAsyncWriter>(*this);
+}
+
+bool CDBWrapper::WriteBatchAsync(CDBBatch& batch)
+{
+    if (!m_async_writer) {
+        return WriteBatch(batch);
+    }
+    m_async_writer->Write(batch.batch, false, false);
+    return true;
+}
+
+void CDBWrapper::WaitForAsyncWrites()
+{
+    if (m_async_writer) {
+        m_async_writer->WaitForWrites();
+    }
+}
+
+void CDBWrapper::WriteLevelDBBatch(leveldb::WriteBatch& batch, bool fSync)
 {
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
     double mem_before = 0;
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
-    leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch);
     dbwrapper_private::HandleError(status);
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
         LogPrint(BCLog::LEVELDB, "WriteBatch memory usage: db=%s, before=%.1fMiB, after=%.1fMiB\n",
                  m_name, mem_before, mem_after);
     }
-    return true;
 }
 
 size_t CDBWrapper::DynamicMemoryUsage() const {
@@ -214,6 +546,13 @@ const std::string CDBWrapper::OBFUSCATE_KEY_KEY("\000obfuscate_key", 14);
 
 const unsigned int CDBWrapper::OBFUSCATE_KEY_NUM_BYTES = 8;
 
+bool CDBWrapper::IsObfuscateKeyKey(const CDataStream& ssKey)
+{
+    CDataStream ssObfuscateKey(SER_DISK, CLIENT_VERSION);
+    ssObfuscateKey << OBFUSCATE_KEY_KEY;
+    return ssKey.size() == ssObfuscateKey.size() && std::equal(ssKey.begin(), ssKey.end(), ssObfuscateKey.begin());
+}
+
 /**
  * Returns a string (consisting of 8 random bytes) suitable for use as an
  * obfuscating XOR key.
@@ -7,13 +7,18 @@
 
 #include <clientversion.h>
 #include <fs.h>
+#include <memusage.h>
+#include <prevector.h>
+#include <saltedhasher.h>
 #include <serialize.h>
 #include <streams.h>
 #include <util.h>
 #include <utilstrencodings.h>
 #include <version.h>
 
+#include <memory>
 #include <typeindex>
+#include <unordered_map>
 
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
@@ -54,8 +59,9 @@ private:
     const CDBWrapper &parent;
     leveldb::WriteBatch batch;
 
-    CDataStream ssKey;
-    CDataStream ssValue;
+    // Keys and values of databases are public, their buffers don't need to be zeroed
+    CPublicDataStream ssKey;
+    CPublicDataStream ssValue;
 
     size_t size_estimate;
 
@@ -80,8 +86,8 @@ public:
         ssKey.clear();
     }
 
-    template <typename V>
-    void Write(const CDataStream& _ssKey, const V& value)
+    template <typename SerializeData, typename V>
+    void Write(const CBaseDataStream<SerializeData>& _ssKey, const V& value)
     {
         leveldb::Slice slKey(_ssKey.data(), _ssKey.size());
 
@@ -109,7 +115,8 @@ public:
         ssKey.clear();
     }
 
-    void Erase(const CDataStream& _ssKey) {
+    template <typename SerializeData>
+    void Erase(const CBaseDataStream<SerializeData>& _ssKey) {
         leveldb::Slice slKey(_ssKey.data(), _ssKey.size());
 
         batch.Delete(slKey);
@@ -120,6 +127,21 @@ public:
         size_estimate += 2 + (slKey.size() > 127) + slKey.size();
     }
 
+    /**
+     * Write an already serialized key and value. Unlike in Write(), the value must already be obfuscated with the
+     * parent's obfuscation key (see dbwrapper_private::GetObfuscateKey), allowing callers to serialize in parallel.
+     */
+    template <typename KeyData, typename ValueData>
+    void WriteSerialized(const CBaseDataStream<KeyData>& _ssKey, const CBaseDataStream<ValueData>& _ssValue)
+    {
+        leveldb::Slice slKey(_ssKey.data(), _ssKey.size());
+        leveldb::Slice slValue(_ssValue.data(), _ssValue.size());
+
+        batch.Put(slKey, slValue);
+        // See Write() for the formula
+        size_estimate += 3 + (slKey.size() > 127) + slKey.size() + (slValue.size() > 127) + slValue.size();
+    }
+
     size_t SizeEstimate() const { return size_estimate; }
 };
 
@@ -144,13 +166,14 @@ public:
     void SeekToFirst();
 
     template<typename K> void Seek(const K& key) {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         Seek(ssKey);
     }
 
-    void Seek(const CDataStream& ssKey) {
+    template <typename SerializeData>
+    void Seek(const CBaseDataStream<SerializeData>& ssKey) {
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
         piter->Seek(slKey);
     }
@@ -158,8 +181,9 @@ public:
     void Next();
 
     template<typename K> bool GetKey(K& key) {
+        leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey = GetKey();
+            CPublicDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -179,7 +203,7 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CPublicDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
             ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
             ssValue >> value;
         } catch (const std::exception&) {
@@ -188,15 +212,58 @@ public:
         return true;
     }
 
+    CDataStream GetValue() {
+        leveldb::Slice slValue = piter->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        return ssValue;
+    }
+
     unsigned int GetValueSize() {
         return piter->value().size();
     }
 
 };
 
+/**
+ * LevelDB tuning for the access pattern of a database. Databases are assigned a profile by the name of their
+ * directory, which can be overridden with -dbprofile.
+ */
+struct CDBProfile
+{
+    std::string name;
+    //! share of the cache in percent used for the block cache, the rest is split between the two write buffers
+    int nBlockCachePercent;
+    //! approximate size of the uncompressed data in a block
+    size_t nBlockSize;
+    int nBloomBits;
+    //! only has an effect if LevelDB is built with Snappy, otherwise blocks are stored uncompressed
+    bool fCompression;
+    //! upper bound for max_open_files, 0 to keep the default
+    int nMaxOpenFiles;
+};
+
+//! Get a tuning profile by name, nullptr if there is none
+const CDBProfile* GetDBProfile(const std::string& strName);
+
+//! Comma separated names of all tuning profiles
+std::string GetDBProfileNames();
+
+//! Comma separated list of the default <db>:<profile> assignments
+std::string GetDefaultDBProfiles();
+
+//! Check the -dbprofile arguments
+bool CheckDBProfileArgs(std::string& strError);
+
+//! Profile of the database with the given directory name, taking -dbprofile into account
+const CDBProfile& GetDBProfileForDB(const std::string& strDBName);
+
+class CDBAsyncWriter;
+
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend class CDBAsyncWriter;
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -233,6 +300,14 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    //! writer thread and the batches it didn't write yet, only set after StartAsyncWriter()
+    std::unique_ptr<CDBAsyncWriter> m_async_writer;
+
+    /** Get the stored value of a key, taking not yet written batches into account */
+    bool ReadRaw(const leveldb::Slice& slKey, std::string& strValue) const;
+
+    void WriteLevelDBBatch(leveldb::WriteBatch& batch, bool fSync);
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -243,30 +318,29 @@ public:
      *                        with a zero'd byte array.
      */
     CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    /** Same as above, but with the given tuning profile instead of the one from GetDBProfileForDB() */
+    CDBWrapper(const fs::path& path, size_t nCacheSize, const CDBProfile& profile, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
     ~CDBWrapper();
 
-    template <typename K>
-    bool ReadDataStream(const K& key, CDataStream& ssValue) const
+    template <typename K, typename ValueData>
+    bool ReadDataStream(const K& key, CBaseDataStream<ValueData>& ssValue) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return ReadDataStream(ssKey, ssValue);
     }
 
-    bool ReadDataStream(const CDataStream& ssKey, CDataStream& ssValue) const
+    template <typename KeyData, typename ValueData>
+    bool ReadDataStream(const CBaseDataStream<KeyData>& ssKey, CBaseDataStream<ValueData>& ssValue) const
     {
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
+        if (!ReadRaw(slKey, strValue)) {
+            return false;
         }
-        CDataStream ssValueTmp(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        CBaseDataStream<ValueData> ssValueTmp(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
         ssValueTmp.Xor(obfuscate_key);
         ssValue = std::move(ssValueTmp);
         return true;
@@ -275,16 +349,16 @@ public:
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return Read(ssKey, value);
     }
 
-    template <typename V>
-    bool Read(const CDataStream& ssKey, V& value) const
+    template <typename SerializeData, typename V>
+    bool Read(const CBaseDataStream<SerializeData>& ssKey, V& value) const
     {
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssValue(SER_DISK, CLIENT_VERSION);
         if (!ReadDataStream(ssKey, ssValue)) {
             return false;
         }
@@ -308,25 +382,19 @@ public:
     template <typename K>
     bool Exists(const K& key) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return Exists(ssKey);
     }
 
-    bool Exists(const CDataStream& key) const
+    template <typename SerializeData>
+    bool Exists(const CBaseDataStream<SerializeData>& key) const
     {
         leveldb::Slice slKey(key.data(), key.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
-        return true;
+        return ReadRaw(slKey, strValue);
     }
 
     template <typename K>
@@ -339,6 +407,21 @@ public:
 
     bool WriteBatch(CDBBatch& batch, bool fSync = false);
 
+    /**
+     * Start a thread which does all writes from now on. Writes of concurrent callers and of WriteBatchAsync() are
+     * combined into one LevelDB write, and one fsync for all of them if any needs it (group commit).
+     */
+    void StartAsyncWriter();
+
+    /**
+     * Queue the batch for the writer thread and return without waiting for it to be written. Reads see the
+     * changes right away. Without a writer thread this is the same as WriteBatch().
+     */
+    bool WriteBatchAsync(CDBBatch& batch);
+
+    /** Wait until everything queued so far is written to LevelDB */
+    void WaitForAsyncWrites();
+
     // Get an estimate of LevelDB memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
@@ -356,6 +439,8 @@ public:
 
     CDBIterator *NewIterator()
     {
+        // Iterators only see what is written to LevelDB already
+        WaitForAsyncWrites();
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
@@ -364,10 +449,16 @@ public:
      */
     bool IsEmpty();
 
+    /**
+     * Return true if ssKey is the entry holding the obfuscation key, which iterating over all entries visits as well
+     * but which isn't part of the data.
+     */
+    static bool IsObfuscateKeyKey(const CDataStream& ssKey);
+
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
-        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
         ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
@@ -386,7 +477,7 @@ public:
     template<typename K>
     void CompactRange(const K& key_begin, const K& key_end) const
     {
-        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
         ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
@@ -403,6 +494,76 @@ public:
 
 };
 
+/**
+ * Serialized key of a CDBTransaction. Keys of up to DBWRAPPER_PREALLOC_KEY_SIZE bytes, which covers all keys used
+ * with transactions, are stored inline, so serializing a key for a lookup doesn't allocate.
+ */
+class CDBTransactionKey
+{
+private:
+    typedef prevector<DBWRAPPER_PREALLOC_KEY_SIZE, unsigned char> KeyBytes;
+    KeyBytes bytes;
+
+public:
+    CDBTransactionKey() {}
+
+    template<typename K>
+    explicit CDBTransactionKey(const K& key)
+    {
+        ::Serialize(*this, key);
+    }
+
+    template <typename SerializeData>
+    explicit CDBTransactionKey(const CBaseDataStream<SerializeData>& ssKey) : bytes((const unsigned char*)ssKey.data(), (const unsigned char*)ssKey.data() + ssKey.size()) {}
+
+    // Stream interface for serializing keys into this
+    int GetType() const { return SER_DISK; }
+    int GetVersion() const { return CLIENT_VERSION; }
+    void write(const char* pch, size_t nSize)
+    {
+        bytes.insert(bytes.end(), (const unsigned char*)pch, (const unsigned char*)pch + nSize);
+    }
+    template<typename T>
+    CDBTransactionKey& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+
+    // Serializes to the raw key, so that it can be passed to CDBWrapper and CDBBatch like the original key
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)bytes.data(), bytes.size());
+    }
+
+    const unsigned char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(bytes); }
+
+    CDataStream ToDataStream() const
+    {
+        return CDataStream((const char*)bytes.data(), (const char*)bytes.data() + bytes.size(), SER_DISK, CLIENT_VERSION);
+    }
+
+    bool operator==(const CDBTransactionKey& other) const { return bytes == other.bytes; }
+
+    /** Same order as LevelDB's default comparator */
+    static bool Less(const unsigned char* a, size_t aSize, const unsigned char* b, size_t bSize)
+    {
+        return std::lexicographical_compare(a, a + aSize, b, b + bSize);
+    }
+    bool operator<(const CDBTransactionKey& other) const { return Less(data(), size(), other.data(), other.size()); }
+};
+
+struct CDBTransactionKeyHasher
+{
+    size_t operator()(const CDBTransactionKey& key) const
+    {
+        return CSipHasher(StaticSaltedHasher::s.k0, StaticSaltedHasher::s.k1).Write(key.data(), key.size()).Finalize();
+    }
+};
+
 template<typename CDBTransaction>
 class CDBTransactionIterator
 {
@@ -415,22 +576,28 @@ private:
     // At all times, only one of both provides the current value. The decision is made by comparing the current keys
     // of both iterators, so that always the smaller key is the current one. On Next(), the previously chosen iterator
     // is advanced.
-    typename CDBTransaction::WritesMap::iterator transactionIt;
+    // The transaction is iterated through its sorted keys, keys which are added to it while iterating are not seen.
+    size_t transactionPos;
+    const size_t transactionEnd;
     std::unique_ptr<ParentIterator> parentIt;
     CDataStream parentKey;
     bool curIsParent{false};
 
+    const CDBTransactionKey& TransactionKey() const { return *transaction.sortedKeys[transactionPos]; }
+
 public:
     explicit CDBTransactionIterator(CDBTransaction& _transaction) :
             transaction(_transaction),
+            transactionEnd(_transaction.SortKeys()),
             parentKey(SER_DISK, CLIENT_VERSION)
     {
-        transactionIt = transaction.writes.end();
+        transactionPos = transactionEnd;
         parentIt = std::unique_ptr<ParentIterator>(transaction.parent.NewIterator());
     }
 
     void SeekToFirst() {
-        transactionIt = transaction.writes.begin();
+        transactionPos = 0;
+        SkipTransactionDeleted();
         parentIt->SeekToFirst();
         SkipDeletedAndOverwritten();
         DecideCur();
@@ -441,19 +608,24 @@ public:
         Seek(CDBTransaction::KeyToDataStream(key));
     }
 
-    void Seek(const CDataStream& ssKey) {
-        transactionIt = transaction.writes.lower_bound(ssKey);
+    template <typename SerializeData>
+    void Seek(const CBaseDataStream<SerializeData>& ssKey) {
+        auto begin = transaction.sortedKeys.begin();
+        transactionPos = std::lower_bound(begin, begin + transactionEnd, ssKey, [](const CDBTransactionKey* a, const CBaseDataStream<SerializeData>& b) {
+            return CDBTransactionKey::Less(a->data(), a->size(), (const unsigned char*)b.data(), b.size());
+        }) - begin;
+        SkipTransactionDeleted();
         parentIt->Seek(ssKey);
         SkipDeletedAndOverwritten();
         DecideCur();
     }
 
     bool Valid() {
-        return transactionIt != transaction.writes.end() || parentIt->Valid();
+        return transactionPos != transactionEnd || parentIt->Valid();
     }
 
     void Next() {
-        if (transactionIt == transaction.writes.end() && !parentIt->Valid()) {
+        if (transactionPos == transactionEnd && !parentIt->Valid()) {
             return;
         }
         if (curIsParent) {
@@ -461,8 +633,9 @@ public:
             parentIt->Next();
             SkipDeletedAndOverwritten();
         } else {
-            assert(transactionIt != transaction.writes.end());
-            ++transactionIt;
+            assert(transactionPos != transactionEnd);
+            ++transactionPos;
+            SkipTransactionDeleted();
         }
         DecideCur();
     }
@@ -473,25 +646,14 @@ public:
             return false;
         }
 
-        if (curIsParent) {
-            try {
-                // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
-                CDataStream ssKey = parentKey;
-                ssKey >> key;
-            } catch (const std::exception&) {
-                return false;
-            }
-            return true;
-        } else {
-            try {
-                // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
-                CDataStream ssKey = transactionIt->first;
-                ssKey >> key;
-            } catch (const std::exception&) {
-                return false;
-            }
-            return true;
+        try {
+            // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
+            CDataStream ssKey = GetKey();
+            ssKey >> key;
+        } catch (const std::exception&) {
+            return false;
         }
+        return true;
     }
 
     CDataStream GetKey() {
@@ -501,7 +663,7 @@ public:
         if (curIsParent) {
             return parentKey;
         } else {
-            return transactionIt->first;
+            return TransactionKey().ToDataStream();
         }
     }
 
@@ -512,7 +674,7 @@ public:
         if (curIsParent) {
             return parentIt->GetKeySize();
         } else {
-            return transactionIt->first.vKey.size();
+            return TransactionKey().size();
         }
     }
 
@@ -522,17 +684,23 @@ public:
             return false;
         }
         if (curIsParent) {
-            return transaction.Read(parentKey, value);
+            return transaction.Read(CDBTransactionKey(parentKey), value);
         } else {
-            return transaction.Read(transactionIt->first, value);
+            return transaction.Read(TransactionKey(), value);
         }
     };
 
 private:
+    void SkipTransactionDeleted() {
+        while (transactionPos != transactionEnd && !transaction.entries.at(TransactionKey())) {
+            ++transactionPos;
+        }
+    }
+
     void SkipDeletedAndOverwritten() {
         while (parentIt->Valid()) {
             parentKey = parentIt->GetKey();
-            if (!transaction.deletes.count(parentKey) && !transaction.writes.count(parentKey)) {
+            if (!transaction.entries.count(CDBTransactionKey(parentKey))) {
                 break;
             }
             parentIt->Next();
@@ -540,12 +708,13 @@ private:
     }
 
     void DecideCur() {
-        if (transactionIt != transaction.writes.end() && !parentIt->Valid()) {
+        if (transactionPos != transactionEnd && !parentIt->Valid()) {
             curIsParent = false;
-        } else if (transactionIt == transaction.writes.end() && parentIt->Valid()) {
+        } else if (transactionPos == transactionEnd && parentIt->Valid()) {
             curIsParent = true;
-        } else if (transactionIt != transaction.writes.end() && parentIt->Valid()) {
-            if (CDBTransaction::DataStreamCmp::less(transactionIt->first, parentKey)) {
+        } else if (transactionPos != transactionEnd && parentIt->Valid()) {
+            const auto& key = TransactionKey();
+            if (CDBTransactionKey::Less(key.data(), key.size(), (const unsigned char*)parentKey.data(), parentKey.size())) {
                 curIsParent = false;
             } else {
                 curIsParent = true;
@@ -563,22 +732,11 @@ protected:
     CommitTarget &commitTarget;
     ssize_t memoryUsage{0}; // signed, just in case we made an error in the calculations so that we don't get an overflow
 
-    struct DataStreamCmp {
-        static bool less(const CDataStream& a, const CDataStream& b) {
-            return std::lexicographical_compare(
-                    (const uint8_t*)a.data(), (const uint8_t*)a.data() + a.size(),
-                    (const uint8_t*)b.data(), (const uint8_t*)b.data() + b.size());
-        }
-        bool operator()(const CDataStream& a, const CDataStream& b) const {
-            return less(a, b);
-        }
-    };
-
     struct ValueHolder {
         size_t memoryUsage;
         ValueHolder(size_t _memoryUsage) : memoryUsage(_memoryUsage) {}
         virtual ~ValueHolder() = default;
-        virtual void Write(const CDataStream& ssKey, CommitTarget &parent) = 0;
+        virtual void Write(const CDBTransactionKey& key, CommitTarget &parent) = 0;
     };
     typedef std::unique_ptr<ValueHolder> ValueHolderPtr;
 
@@ -586,65 +744,89 @@ protected:
     struct ValueHolderImpl : ValueHolder {
         ValueHolderImpl(const V &_value, size_t _memoryUsage) : ValueHolder(_memoryUsage), value(_value) {}
 
-        virtual void Write(const CDataStream& ssKey, CommitTarget &commitTarget) {
+        virtual void Write(const CDBTransactionKey& key, CommitTarget &commitTarget) {
             // we're moving the value instead of copying it. This means that Write() can only be called once per
             // ValueHolderImpl instance. Commit() clears the write maps, so this ok.
-            commitTarget.Write(ssKey, std::move(value));
+            commitTarget.Write(key, std::move(value));
         }
         V value;
     };
 
     template<typename K>
-    static CDataStream KeyToDataStream(const K& key) {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    static CPublicDataStream KeyToDataStream(const K& key) {
+        CPublicDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return ssKey;
     }
 
-    typedef std::map<CDataStream, ValueHolderPtr, DataStreamCmp> WritesMap;
-    typedef std::set<CDataStream, DataStreamCmp> DeletesSet;
+    //! written values and deletes (nullptr), entries are only removed by Clear()
+    typedef std::unordered_map<CDBTransactionKey, ValueHolderPtr, CDBTransactionKeyHasher> EntriesMap;
+    EntriesMap entries;
+    //! keys of all entries for iterators, only the first nSortedKeys are sorted
+    std::vector<const CDBTransactionKey*> sortedKeys;
+    size_t nSortedKeys{0};
 
-    WritesMap writes;
-    DeletesSet deletes;
+    //! Get the entry of key, with the memory usage of its previous value removed
+    ValueHolderPtr& GetEntry(const CDBTransactionKey& key) {
+        auto p = entries.emplace(key, nullptr);
+        if (p.second) {
+            sortedKeys.emplace_back(&p.first->first);
+            memoryUsage += key.DynamicMemoryUsage();
+        } else if (p.first->second) {
+            memoryUsage -= p.first->second->memoryUsage;
+        }
+        return p.first->second;
+    }
+
+    //! Sort the keys added since the last call and return the number of keys
+    size_t SortKeys() {
+        auto cmp = [](const CDBTransactionKey* a, const CDBTransactionKey* b) { return *a < *b; };
+        std::sort(sortedKeys.begin() + nSortedKeys, sortedKeys.end(), cmp);
+        std::inplace_merge(sortedKeys.begin(), sortedKeys.begin() + nSortedKeys, sortedKeys.end(), cmp);
+        nSortedKeys = sortedKeys.size();
+        return nSortedKeys;
+    }
 
 public:
     CDBTransaction(Parent &_parent, CommitTarget &_commitTarget) : parent(_parent), commitTarget(_commitTarget) {}
 
     template <typename K, typename V>
     void Write(const K& key, const V& v) {
-        Write(KeyToDataStream(key), v);
+        Write(CDBTransactionKey(key), v);
     }
 
-    template <typename V>
-    void Write(const CDataStream& ssKey, const V& v) {
-        auto valueMemoryUsage = ::GetSerializeSize(v, SER_DISK, CLIENT_VERSION);
-
-        if (deletes.erase(ssKey)) {
-            memoryUsage -= ssKey.size();
-        }
-        auto it = writes.emplace(ssKey, nullptr).first;
-        if (it->second) {
-            memoryUsage -= ssKey.size() + it->second->memoryUsage;
-        }
-        it->second = std::make_unique<ValueHolderImpl<V>>(v, valueMemoryUsage);
+    template <typename SerializeData, typename V>
+    void Write(const CBaseDataStream<SerializeData>& ssKey, const V& v) {
+        Write(CDBTransactionKey(ssKey), v);
+    }
 
-        memoryUsage += ssKey.size() + valueMemoryUsage;
+    template <typename V>
+    void Write(const CDBTransactionKey& key, const V& v) {
+        // The serialized size is the closest we get to the dynamic memory usage of arbitrary values
+        auto valueMemoryUsage = memusage::MallocUsage(sizeof(ValueHolderImpl<V>)) + ::GetSerializeSize(v, SER_DISK, CLIENT_VERSION);
+        auto& entry = GetEntry(key);
+        entry = std::make_unique<ValueHolderImpl<V>>(v, valueMemoryUsage);
+        memoryUsage += valueMemoryUsage;
     }
 
     template <typename K, typename V>
     bool Read(const K& key, V& value) {
-        return Read(KeyToDataStream(key), value);
+        return Read(CDBTransactionKey(key), value);
     }
 
-    template <typename V>
-    bool Read(const CDataStream& ssKey, V& value) {
-        if (deletes.count(ssKey)) {
-            return false;
-        }
+    template <typename SerializeData, typename V>
+    bool Read(const CBaseDataStream<SerializeData>& ssKey, V& value) {
+        return Read(CDBTransactionKey(ssKey), value);
+    }
 
-        auto it = writes.find(ssKey);
-        if (it != writes.end()) {
+    template <typename V>
+    bool Read(const CDBTransactionKey& key, V& value) {
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            if (!it->second) {
+                return false;
+            }
             auto *impl = dynamic_cast<ValueHolderImpl<V> *>(it->second.get());
             if (!impl) {
                 throw std::runtime_error("Read called with V != previously written type");
@@ -653,60 +835,63 @@ public:
             return true;
         }
 
-        return parent.Read(ssKey, value);
+        return parent.Read(key, value);
     }
 
     template <typename K>
     bool Exists(const K& key) {
-        return Exists(KeyToDataStream(key));
+        return Exists(CDBTransactionKey(key));
     }
 
-    bool Exists(const CDataStream& ssKey) {
-        if (deletes.count(ssKey)) {
-            return false;
-        }
+    template <typename SerializeData>
+    bool Exists(const CBaseDataStream<SerializeData>& ssKey) {
+        return Exists(CDBTransactionKey(ssKey));
+    }
 
-        if (writes.count(ssKey)) {
-            return true;
+    bool Exists(const CDBTransactionKey& key) {
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            return it->second != nullptr;
         }
 
-        return parent.Exists(ssKey);
+        return parent.Exists(key);
     }
 
     template <typename K>
     void Erase(const K& key) {
-        return Erase(KeyToDataStream(key));
+        return Erase(CDBTransactionKey(key));
     }
 
-    void Erase(const CDataStream& ssKey) {
-        auto it = writes.find(ssKey);
-        if (it != writes.end()) {
-            memoryUsage -= ssKey.size() + it->second->memoryUsage;
-            writes.erase(it);
-        }
-        if (deletes.emplace(ssKey).second) {
-            memoryUsage += ssKey.size();
-        }
+    template <typename SerializeData>
+    void Erase(const CBaseDataStream<SerializeData>& ssKey) {
+        Erase(CDBTransactionKey(ssKey));
+    }
+
+    void Erase(const CDBTransactionKey& key) {
+        GetEntry(key).reset();
     }
 
     void Clear() {
-        writes.clear();
-        deletes.clear();
+        sortedKeys.clear();
+        nSortedKeys = 0;
+        entries.clear();
         memoryUsage = 0;
     }
 
     void Commit() {
-        for (const auto &k : deletes) {
-            commitTarget.Erase(k);
-        }
-        for (auto &p : writes) {
-            p.second->Write(p.first, commitTarget);
+        // A key is either written or deleted, so the order doesn't matter
+        for (auto &p : entries) {
+            if (p.second) {
+                p.second->Write(p.first, commitTarget);
+            } else {
+                commitTarget.Erase(p.first);
+            }
         }
         Clear();
     }
 
     bool IsClean() {
-        return writes.empty() && deletes.empty();
+        return entries.empty();
     }
 
     size_t GetMemoryUsage() const {
@@ -719,7 +904,7 @@ public:
             }
             return 0;
         }
-        return (size_t)memoryUsage;
+        return (size_t)memoryUsage + memusage::DynamicUsage(entries) + memusage::DynamicUsage(sortedKeys);
     }
 
     CDBTransactionIterator<CDBTransaction>* NewIterator() {
@@ -11,14 +11,18 @@
 #include <governance/governance.h>
 #include <masternode/masternode-payments.h>
 #include <masternode/masternode-sync.h>
+#include <miner.h>
+#include <rpc/snapshot.h>
 #include <validation.h>
 
 #include <evo/deterministicmns.h>
 #include <evo/mnauth.h>
+#include <evo/simplifiedmns.h>
 
 #include <llmq/quorums.h>
 #include <llmq/quorums_chainlocks.h>
 #include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_signing.h>
 #include <llmq/quorums_dkgsessionmgr.h>
 
 void CDSNotificationInterface::InitializeCurrentBlockTip()
@@ -41,6 +45,9 @@ void CDSNotificationInterface::NotifyHeaderTip(const CBlockIndex *pindexNew, boo
 
 void CDSNotificationInterface::SynchronousUpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
+    SetRPCChainSnapshotTip(pindexNew);
+    llmq::CSigningManager::UpdatedBlockTip(pindexNew, fInitialDownload);
+
     if (pindexNew == pindexFork) // blocks were disconnected without any new ones
         return;
 
@@ -73,7 +80,12 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
     llmq::quorumManager->UpdatedBlockTip(pindexNew, fInitialDownload);
     llmq::quorumDKGSessionManager->UpdatedBlockTip(pindexNew, fInitialDownload);
 
+    mnListDiffCache.UpdatedBlockTip(pindexNew);
+    UpdateSimplifiedMNListSnapshots(pindexNew);
+
     if (!fDisableGovernance) governance.UpdatedBlockTip(pindexNew, connman);
+
+    PrepareBlockTemplateComponents(pindexNew);
 }
 
 void CDSNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
@@ -116,6 +128,11 @@ void CDSNotificationInterface::NotifyMasternodeListChanged(bool undo, const CDet
     governance.UpdateCachesAndClean();
 }
 
+void CDSNotificationInterface::NotifyTransactionLock(const CTransactionRef& tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
+{
+    llmq::chainLocksHandler->TransactionLocked(tx);
+}
+
 void CDSNotificationInterface::NotifyChainLock(const CBlockIndex* pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
 {
     llmq::quorumInstantSendManager->NotifyChainLock(pindex);
@@ -8,6 +8,7 @@
 #include <base58.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <memusage.h>
 #include <script/standard.h>
 #include <ui_interface.h>
 #include <validation.h>
@@ -18,8 +19,13 @@
 
 #include <univalue.h>
 
+// snapshots in the format of CDeterministicMNList::Serialize. These are not written anymore and are converted by
+// CDeterministicMNManager::MigrateSnapshots, but are still read if found
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
+static const std::string DB_LIST_SNAPSHOT2 = "dmn_S2";
 static const std::string DB_LIST_DIFF = "dmn_D";
+// MN states referenced by hash from snapshots in DB_LIST_SNAPSHOT2
+static const std::string DB_MN_STATE = "dmn_ST";
 
 std::unique_ptr<CDeterministicMNManager> deterministicMNManager;
 
@@ -197,54 +203,54 @@ static int CompareByLastPaid_GetHeight(const CDeterministicMN& dmn)
     return height;
 }
 
-static bool CompareByLastPaid(const CDeterministicMN& _a, const CDeterministicMN& _b)
+static std::pair<int, uint256> GetPaymentQueueKey(const CDeterministicMN& dmn)
 {
-    int ah = CompareByLastPaid_GetHeight(_a);
-    int bh = CompareByLastPaid_GetHeight(_b);
-    if (ah == bh) {
-        return _a.proTxHash < _b.proTxHash;
-    } else {
-        return ah < bh;
+    // MNs are paid in order of their last payment height, with ties broken by proTxHash
+    return std::make_pair(CompareByLastPaid_GetHeight(dmn), dmn.proTxHash);
+}
+
+void CDeterministicMNList::AddToPaymentQueue(const CDeterministicMNCPtr& dmn)
+{
+    if (!IsMNValid(dmn)) {
+        return;
     }
+    auto key = GetPaymentQueueKey(*dmn);
+    auto it = std::lower_bound(mnPaymentQueue.begin(), mnPaymentQueue.end(), key);
+    mnPaymentQueue = mnPaymentQueue.insert(it - mnPaymentQueue.begin(), key);
 }
-static bool CompareByLastPaid(const CDeterministicMNCPtr& _a, const CDeterministicMNCPtr& _b)
+
+void CDeterministicMNList::RemoveFromPaymentQueue(const CDeterministicMNCPtr& dmn)
 {
-    return CompareByLastPaid(*_a, *_b);
+    if (!IsMNValid(dmn)) {
+        return;
+    }
+    auto key = GetPaymentQueueKey(*dmn);
+    auto it = std::lower_bound(mnPaymentQueue.begin(), mnPaymentQueue.end(), key);
+    assert(it != mnPaymentQueue.end() && *it == key);
+    mnPaymentQueue = mnPaymentQueue.erase(it - mnPaymentQueue.begin());
 }
 
 CDeterministicMNCPtr CDeterministicMNList::GetMNPayee() const
 {
-    if (mnMap.size() == 0) {
+    if (mnPaymentQueue.empty()) {
         return nullptr;
     }
-
-    CDeterministicMNCPtr best;
-    ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
-        if (!best || CompareByLastPaid(dmn, best)) {
-            best = dmn;
-        }
-    });
-
-    return best;
+    return GetMN(mnPaymentQueue.front().second);
 }
 
 std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int nCount) const
 {
-    if (nCount > GetValidMNsCount()) {
-        nCount = GetValidMNsCount();
+    size_t count = (size_t)std::max(nCount, 0);
+    if (count > mnPaymentQueue.size()) {
+        count = mnPaymentQueue.size();
     }
 
     std::vector<CDeterministicMNCPtr> result;
-    result.reserve(nCount);
-
-    ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
-        result.emplace_back(dmn);
-    });
-    std::sort(result.begin(), result.end(), [&](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
-        return CompareByLastPaid(a, b);
-    });
+    result.reserve(count);
 
-    result.resize(nCount);
+    for (auto it = mnPaymentQueue.begin(); result.size() < count; ++it) {
+        result.emplace_back(GetMN(it->second));
+    }
 
     return result;
 }
@@ -252,19 +258,20 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int
 std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t maxSize, const uint256& modifier) const
 {
     auto scores = CalculateScores(modifier);
+    size_t resultSize = std::min(maxSize, scores.size());
 
-    // sort is descending order
-    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+    // only the top maxSize entries need to be sorted (descending order)
+    std::partial_sort(scores.begin(), scores.begin() + resultSize, scores.end(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
         if (a.first == b.first) {
             // this should actually never happen, but we should stay compatible with how the non deterministic MNs did the sorting
-            return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            return b.second->collateralOutpoint < a.second->collateralOutpoint;
         }
-        return a.first < b.first;
+        return b.first < a.first;
     });
 
     // take top maxSize entries and return it
     std::vector<CDeterministicMNCPtr> result;
-    result.resize(std::min(maxSize, scores.size()));
+    result.resize(resultSize);
     for (size_t i = 0; i < result.size(); i++) {
         result[i] = std::move(scores[i].second);
     }
@@ -273,28 +280,93 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 
 std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
 {
-    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
-    scores.reserve(GetAllMNsCount());
-    ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
-        if (dmn->pdmnState->confirmedHash.IsNull()) {
+    auto view = GetView();
+
+    // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
+    // Please note that this is not a double-sha256 but a single-sha256
+    // The first part is already precalculated (confirmedHashWithProRegTxHash), so each hash is over one 64 byte block
+    // and all of them are calculated at once by the multi-way SHA256 implementation
+    std::vector<size_t> indexes;
+    std::vector<unsigned char> blocks;
+    indexes.reserve(view->size());
+    blocks.reserve(view->size() * 64);
+    for (size_t i = 0; i < view->size(); i++) {
+        if (!view->IsValid(i) || !view->IsConfirmed(i)) {
             // we only take confirmed MNs into account to avoid hash grinding on the ProRegTxHash to sneak MNs into a
             // future quorums
-            return;
+            continue;
         }
-        // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
-        // Please note that this is not a double-sha256 but a single-sha256
-        // The first part is already precalculated (confirmedHashWithProRegTxHash)
-        // TODO When https://github.com/bitcoin/bitcoin/pull/13191 gets backported, implement something that is similar but for single-sha256
+        const uint256& confirmedHashWithProRegTxHash = view->confirmedHashesWithProRegTxHash[i];
+        blocks.insert(blocks.end(), confirmedHashWithProRegTxHash.begin(), confirmedHashWithProRegTxHash.end());
+        blocks.insert(blocks.end(), modifier.begin(), modifier.end());
+        indexes.emplace_back(i);
+    }
+
+    std::vector<unsigned char> hashes(indexes.size() * 32);
+    SHA256S64(hashes.data(), blocks.data(), indexes.size());
+
+    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
+    scores.reserve(indexes.size());
+    for (size_t j = 0; j < indexes.size(); j++) {
         uint256 h;
-        CSHA256 sha256;
-        sha256.Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), dmn->pdmnState->confirmedHashWithProRegTxHash.size());
-        sha256.Write(modifier.begin(), modifier.size());
-        sha256.Finalize(h.begin());
+        memcpy(h.begin(), hashes.data() + j * 32, 32);
+        scores.emplace_back(UintToArith256(h), view->mns[indexes[j]]);
+    }
 
-        scores.emplace_back(UintToArith256(h), dmn);
+    return scores;
+}
+
+CDeterministicMNListViewCPtr CDeterministicMNList::GetView() const
+{
+    auto view = viewCache.Get();
+    if (view) {
+        return view;
+    }
+
+    // concurrent callers might build the view at the same time, the last one wins
+    auto newView = std::make_shared<CDeterministicMNListView>();
+    newView->mns.reserve(mnMap.size());
+    for (const auto& p : mnMap) {
+        newView->mns.emplace_back(p.second);
+    }
+    std::sort(newView->mns.begin(), newView->mns.end(), [](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+        return a->proTxHash < b->proTxHash;
     });
 
-    return scores;
+    size_t n = newView->mns.size();
+    newView->proTxHashes.reserve(n);
+    newView->confirmedHashesWithProRegTxHash.reserve(n);
+    newView->lastPaidHeights.reserve(n);
+    newView->services.reserve(n);
+    newView->flags.reserve(n);
+    for (const auto& dmn : newView->mns) {
+        const auto& state = *dmn->pdmnState;
+        newView->proTxHashes.emplace_back(dmn->proTxHash);
+        newView->confirmedHashesWithProRegTxHash.emplace_back(state.confirmedHashWithProRegTxHash);
+        newView->lastPaidHeights.emplace_back(state.nLastPaidHeight);
+        newView->services.emplace_back(state.addr);
+        uint8_t flags = 0;
+        if (IsMNValid(dmn)) {
+            flags |= CDeterministicMNListView::FLAG_VALID;
+        }
+        if (!state.confirmedHash.IsNull()) {
+            flags |= CDeterministicMNListView::FLAG_CONFIRMED;
+        }
+        newView->flags.emplace_back(flags);
+    }
+
+    viewCache.Set(newView);
+    return newView;
+}
+
+size_t CDeterministicMNListView::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(mns) +
+           memusage::DynamicUsage(proTxHashes) +
+           memusage::DynamicUsage(confirmedHashesWithProRegTxHash) +
+           memusage::DynamicUsage(lastPaidHeights) +
+           memusage::DynamicUsage(services) +
+           memusage::DynamicUsage(flags);
 }
 
 int CDeterministicMNList::CalcMaxPoSePenalty() const
@@ -474,7 +546,9 @@ void CDeterministicMNList::AddMN(const CDeterministicMNCPtr& dmn, bool fBumpTota
     }
 
     mnMap = mnMap.set(dmn->proTxHash, dmn);
+    viewCache.Reset();
     mnInternalIdMap = mnInternalIdMap.set(dmn->GetInternalId(), dmn->proTxHash);
+    AddToPaymentQueue(dmn);
     if (fBumpTotalCount) {
         // nTotalRegisteredCount acts more like a checkpoint, not as a limit,
         nTotalRegisteredCount = std::max(dmn->GetInternalId() + 1, (uint64_t)nTotalRegisteredCount);
@@ -510,6 +584,9 @@ void CDeterministicMNList::UpdateMN(const CDeterministicMNCPtr& oldDmn, const CD
     }
 
     mnMap = mnMap.set(oldDmn->proTxHash, dmn);
+    viewCache.Reset();
+    RemoveFromPaymentQueue(oldDmn);
+    AddToPaymentQueue(dmn);
 }
 
 void CDeterministicMNList::UpdateMN(const uint256& proTxHash, const CDeterministicMNStateCPtr& pdmnState)
@@ -563,12 +640,107 @@ void CDeterministicMNList::RemoveMN(const uint256& proTxHash)
     }
 
     mnMap = mnMap.erase(proTxHash);
+    viewCache.Reset();
     mnInternalIdMap = mnInternalIdMap.erase(dmn->GetInternalId());
+    RemoveFromPaymentQueue(dmn);
 }
 
+// Walks the nodes of an immer map which were not seen before and calls elemFn for the values stored in them
+template <typename Champ, typename ElemFn>
+static void AddChampNodeUsage(const typename Champ::node_t* node, immer::detail::hamts::count_t depth,
+                              std::unordered_set<const void*>& seen, size_t& usage, ElemFn&& elemFn)
+{
+    using node_t = typename Champ::node_t;
+    using immer::detail::hamts::popcount;
+
+    if (!seen.emplace(node).second) {
+        return;
+    }
+    if (depth < immer::detail::hamts::max_depth<Champ::bits>) {
+        auto nodemap = node->nodemap();
+        auto datamap = node->datamap();
+        usage += memusage::MallocUsage(node_t::sizeof_inner_n(popcount(nodemap)));
+        // values are ref-counted separately from the node and might be shared by multiple nodes
+        if (datamap && seen.emplace(node->impl.d.data.inner.values).second) {
+            auto n = popcount(datamap);
+            usage += memusage::MallocUsage(node_t::sizeof_values_n(n));
+            for (auto it = node->values(); it != node->values() + n; ++it) {
+                elemFn(*it);
+            }
+        }
+        for (auto it = node->children(); it != node->children() + popcount(nodemap); ++it) {
+            AddChampNodeUsage<Champ>(*it, depth + 1, seen, usage, elemFn);
+        }
+    } else {
+        usage += memusage::MallocUsage(node_t::sizeof_collision_n(node->collision_count()));
+        for (auto it = node->collisions(); it != node->collisions() + node->collision_count(); ++it) {
+            elemFn(*it);
+        }
+    }
+}
+
+template <typename Map, typename ElemFn>
+static void AddImmerMapUsage(const Map& m, std::unordered_set<const void*>& seen, size_t& usage, ElemFn&& elemFn)
+{
+    using Champ = typename std::decay<decltype(m.impl())>::type;
+    AddChampNodeUsage<Champ>(m.impl().root, 0, seen, usage, elemFn);
+}
+
+static size_t DMNStateDynamicUsage(const CDeterministicMNState& state)
+{
+    return memusage::DynamicUsage(state.scriptPayout) + memusage::DynamicUsage(state.scriptOperatorPayout);
+}
+
+void CDeterministicMNListMemoryUsage::Add(const CDeterministicMNCPtr& dmn)
+{
+    if (!dmn || !seen.emplace(dmn.get()).second) {
+        return;
+    }
+    usage += memusage::DynamicUsage(dmn);
+    if (dmn->pdmnState && seen.emplace(dmn->pdmnState.get()).second) {
+        usage += memusage::DynamicUsage(dmn->pdmnState) + DMNStateDynamicUsage(*dmn->pdmnState);
+    }
+}
+
+void CDeterministicMNListMemoryUsage::Add(const CDeterministicMNList& mnList)
+{
+    AddImmerMapUsage(mnList.mnMap, seen, usage, [&](const std::pair<uint256, CDeterministicMNCPtr>& p) {
+        Add(p.second);
+    });
+    auto noElemUsage = [](const auto&){};
+    AddImmerMapUsage(mnList.mnInternalIdMap, seen, usage, noElemUsage);
+    AddImmerMapUsage(mnList.mnUniquePropertyMap, seen, usage, noElemUsage);
+
+    // lists which didn't change the payment queue share its root
+    const auto& queue = mnList.mnPaymentQueue.impl();
+    if (seen.emplace(queue.root).second) {
+        usage += memusage::MallocUsage(queue.size * sizeof(CDeterministicMNList::MnPaymentQueue::value_type));
+    }
+
+    auto view = mnList.viewCache.Get();
+    if (view && seen.emplace(view.get()).second) {
+        usage += memusage::DynamicUsage(view) + view->DynamicMemoryUsage();
+    }
+}
+
+void CDeterministicMNListMemoryUsage::Add(const CDeterministicMNListDiff& diff)
+{
+    usage += memusage::DynamicUsage(diff.addedMNs) + memusage::DynamicUsage(diff.updatedMNs) + memusage::DynamicUsage(diff.removedMns);
+    for (const auto& dmn : diff.addedMNs) {
+        Add(dmn);
+    }
+    for (const auto& p : diff.updatedMNs) {
+        usage += DMNStateDynamicUsage(p.second.state);
+    }
+}
+
+const std::vector<int> CDeterministicMNManager::HISTORIC_SNAPSHOT_PERIODS = {16, 144};
+
 CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb) :
     evoDb(_evoDb)
 {
+    int64_t maxUsage = std::max<int64_t>(0, gArgs.GetArg("-dmnlistcache", DEFAULT_HISTORIC_MN_LISTS_CACHE));
+    historicListsCacheMaxUsage = (size_t)maxUsage * 1024 * 1024;
 }
 
 bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& _state, const CCoinsViewCache& view, bool fJustCheck)
@@ -609,7 +781,7 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
 
         evoDb.Write(std::make_pair(DB_LIST_DIFF, newList.GetBlockHash()), diff);
         if ((nHeight % DISK_SNAPSHOT_PERIOD) == 0 || oldList.GetHeight() == -1) {
-            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, newList.GetBlockHash()), newList);
+            WriteSnapshot(evoDb, newList);
             mnListsCache.emplace(newList.GetBlockHash(), newList);
             LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
                 __func__, nHeight, newList.GetAllMNsCount());
@@ -651,21 +823,26 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
     CDeterministicMNList curList;
     CDeterministicMNList prevList;
     CDeterministicMNListDiff diff;
+    bool fNotify;
     {
         LOCK(cs);
         evoDb.Read(std::make_pair(DB_LIST_DIFF, blockHash), diff);
 
-        if (diff.HasChanges()) {
+        fNotify = diff.HasChanges() && !fUndoBatch;
+        if (fNotify) {
             // need to call this before erasing
             curList = GetListForBlock(pindex);
             prevList = GetListForBlock(pindex->pprev);
+        } else if (diff.HasChanges() && !fUndoBatchChanged) {
+            undoBatchList = GetListForBlock(pindex);
+            fUndoBatchChanged = true;
         }
 
         mnListsCache.erase(blockHash);
         mnListDiffsCache.erase(blockHash);
     }
 
-    if (diff.HasChanges()) {
+    if (fNotify) {
         auto inversedDiff = curList.BuildDiff(prevList);
         GetMainSignals().NotifyMasternodeListChanged(true, curList, inversedDiff);
         uiInterface.NotifyMasternodeListChanged(prevList);
@@ -679,6 +856,39 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
     return true;
 }
 
+void CDeterministicMNManager::BeginUndoBatch()
+{
+    LOCK(cs);
+    assert(!fUndoBatch);
+    fUndoBatch = true;
+}
+
+void CDeterministicMNManager::EndUndoBatch(const CBlockIndex* pindexTip)
+{
+    CDeterministicMNList curList;
+    CDeterministicMNList prevList;
+    bool fNotify;
+    {
+        LOCK(cs);
+        assert(fUndoBatch);
+        fNotify = fUndoBatchChanged;
+        if (fNotify) {
+            curList = std::move(undoBatchList);
+            prevList = GetListForBlock(pindexTip);
+        }
+        fUndoBatch = false;
+        fUndoBatchChanged = false;
+        undoBatchList = CDeterministicMNList();
+    }
+
+    if (fNotify) {
+        // one diff over the whole undone range, instead of one per block which governance etc. would each process
+        auto inversedDiff = curList.BuildDiff(prevList);
+        GetMainSignals().NotifyMasternodeListChanged(true, curList, inversedDiff);
+        uiInterface.NotifyMasternodeListChanged(prevList);
+    }
+}
+
 void CDeterministicMNManager::UpdatedBlockTip(const CBlockIndex* pindex)
 {
     LOCK(cs);
@@ -960,6 +1170,7 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 
     CDeterministicMNList snapshot;
     std::list<const CBlockIndex*> listDiffIndexes;
+    bool fHistoricSnapshot{false};
 
     while (true) {
         // try using cache before reading from disk
@@ -969,7 +1180,12 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
             break;
         }
 
-        if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
+        if (GetHistoricSnapshot(pindex->GetBlockHash(), snapshot)) {
+            fHistoricSnapshot = true;
+            break;
+        }
+
+        if (ReadSnapshot(pindex->GetBlockHash(), snapshot)) {
             mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
             break;
         }
@@ -996,14 +1212,30 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
         pindex = pindex->pprev;
     }
 
+    if (!fHistoricSnapshot && !listDiffIndexes.empty()) {
+        historicListsCacheMisses++;
+    }
+
+    size_t changeCount = 0;
     for (const auto& diffIndex : listDiffIndexes) {
         const auto& diff = mnListDiffsCache.at(diffIndex->GetBlockHash());
         if (diff.HasChanges()) {
             snapshot = snapshot.ApplyDiff(diffIndex, diff);
+            changeCount += diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size();
         } else {
             snapshot.SetBlockHash(diffIndex->GetBlockHash());
             snapshot.SetHeight(diffIndex->nHeight);
         }
+        if (diffIndex->nHeight % HISTORIC_SNAPSHOT_PERIODS[0] == 0) {
+            AddHistoricSnapshot(snapshot, changeCount);
+            changeCount = 0;
+        }
+    }
+
+    if (listDiffIndexes.size() > 1) {
+        LogPrint(BCLog::BENCHMARK, "CDeterministicMNManager::%s -- applied %d diffs for height %d. historic lists cache: hits=%d, misses=%d, entries=%d, usage=%d\n",
+                 __func__, listDiffIndexes.size(), snapshot.GetHeight(), historicListsCacheHits, historicListsCacheMisses,
+                 historicListsCache.size(), historicListsCacheUsage);
     }
 
     if (tipIndex) {
@@ -1033,6 +1265,43 @@ CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
     return GetListForBlock(tipIndex);
 }
 
+uint256 CDeterministicMNManager::CalcSMLMerkleRoot(const CDeterministicMNList& mnList, bool* pmutated)
+{
+    LOCK(cs);
+
+    CDeterministicMNListDiff diff;
+    if (smlMerkleTreeInitialized) {
+        diff = smlMerkleTreeList.BuildDiff(mnList);
+    }
+
+    // fall back to a full rebuild if most of the list changed (e.g. on the first call or after a deep reorg)
+    size_t changeCount = diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size();
+    if (!smlMerkleTreeInitialized || changeCount > smlMerkleTree.size() / 2) {
+        smlMerkleTree.Build(CSimplifiedMNList(mnList));
+        smlMerkleTreeInitialized = true;
+    } else if (diff.HasChanges()) {
+        std::vector<std::pair<uint256, uint256>> updated;
+        std::vector<uint256> removed;
+        updated.reserve(diff.addedMNs.size() + diff.updatedMNs.size());
+        removed.reserve(diff.removedMns.size());
+
+        for (const auto& dmn : diff.addedMNs) {
+            updated.emplace_back(dmn->proTxHash, CSimplifiedMNListEntry(*dmn).CalcHash());
+        }
+        for (const auto& p : diff.updatedMNs) {
+            auto dmn = mnList.GetMNByInternalId(p.first);
+            updated.emplace_back(dmn->proTxHash, CSimplifiedMNListEntry(*dmn).CalcHash());
+        }
+        for (const auto& internalId : diff.removedMns) {
+            removed.emplace_back(smlMerkleTreeList.GetMNByInternalId(internalId)->proTxHash);
+        }
+        smlMerkleTree.Update(updated, removed);
+    }
+    smlMerkleTreeList = mnList;
+
+    return smlMerkleTree.GetRoot(pmutated);
+}
+
 bool CDeterministicMNManager::IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n)
 {
     if (tx->nVersion != 3 || tx->nType != TRANSACTION_PROVIDER_REGISTER) {
@@ -1066,6 +1335,139 @@ bool CDeterministicMNManager::IsDIP3Enforced(int nHeight)
     return nHeight >= Params().GetConsensus().DIP0003EnforcementHeight;
 }
 
+size_t CDeterministicMNManager::GetMemoryUsage()
+{
+    LOCK(cs);
+
+    CDeterministicMNListMemoryUsage usage;
+    for (const auto& p : mnListsCache) {
+        usage.Add(p.second);
+    }
+    for (const auto& p : mnListDiffsCache) {
+        usage.Add(p.second);
+    }
+    for (const auto& p : historicListsCache) {
+        usage.Add(p.second.mnList);
+    }
+    usage.Add(smlMerkleTreeList);
+
+    return usage.Get() +
+           memusage::DynamicUsage(mnListsCache) +
+           memusage::DynamicUsage(mnListDiffsCache) +
+           memusage::DynamicUsage(historicListsCache) +
+           mnStateCache.DynamicMemoryUsage();
+}
+
+template<typename Batch>
+void CDeterministicMNManager::WriteSnapshot(Batch& batch, const CDeterministicMNList& mnList)
+{
+    AssertLockHeld(cs);
+
+    CDeterministicMNListSnapshot snapshot;
+    snapshot.blockHash = mnList.GetBlockHash();
+    snapshot.nHeight = mnList.GetHeight();
+    snapshot.nTotalRegisteredCount = mnList.GetTotalRegisteredCount();
+    snapshot.entries.reserve(mnList.GetAllMNsCount());
+
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        uint256 stateHash = ::SerializeHash(*dmn->pdmnState);
+        // Only states which were read from disk are in the cache. States written by this method are not added, as
+        // the write might still be rolled back together with the block
+        if (!mnStateCache.exists(stateHash) && !evoDb.Exists(std::make_pair(DB_MN_STATE, stateHash))) {
+            batch.Write(std::make_pair(DB_MN_STATE, stateHash), *dmn->pdmnState);
+        }
+        snapshot.entries.push_back({dmn->proTxHash, dmn->GetInternalId(), dmn->collateralOutpoint, dmn->nOperatorReward, stateHash});
+    });
+    std::sort(snapshot.entries.begin(), snapshot.entries.end(), [](const CDeterministicMNListSnapshot::Entry& a, const CDeterministicMNListSnapshot::Entry& b) {
+        return a.internalId < b.internalId;
+    });
+
+    batch.Write(std::make_pair(DB_LIST_SNAPSHOT2, mnList.GetBlockHash()), snapshot);
+}
+
+bool CDeterministicMNManager::ReadSnapshot(const uint256& blockHash, CDeterministicMNList& mnListRet)
+{
+    AssertLockHeld(cs);
+
+    CDeterministicMNListSnapshot snapshot;
+    if (!evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT2, blockHash), snapshot)) {
+        return evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, blockHash), mnListRet);
+    }
+
+    CDeterministicMNList mnList(snapshot.blockHash, snapshot.nHeight, snapshot.nTotalRegisteredCount);
+    for (const auto& entry : snapshot.entries) {
+        CDeterministicMNStateCPtr pdmnState;
+        if (!mnStateCache.get(entry.stateHash, pdmnState)) {
+            CDeterministicMNState state;
+            if (!evoDb.Read(std::make_pair(DB_MN_STATE, entry.stateHash), state)) {
+                // let the caller fall back to applying diffs
+                LogPrintf("CDeterministicMNManager::%s -- state %s of snapshot %s not found\n", __func__,
+                    entry.stateHash.ToString(), blockHash.ToString());
+                return false;
+            }
+            pdmnState = std::make_shared<CDeterministicMNState>(std::move(state));
+            mnStateCache.insert(entry.stateHash, pdmnState);
+        }
+
+        auto dmn = std::make_shared<CDeterministicMN>(entry.internalId);
+        dmn->proTxHash = entry.proTxHash;
+        dmn->collateralOutpoint = entry.collateralOutpoint;
+        dmn->nOperatorReward = entry.nOperatorReward;
+        dmn->pdmnState = pdmnState;
+        mnList.AddMN(dmn, false);
+    }
+
+    mnListRet = std::move(mnList);
+    return true;
+}
+
+bool CDeterministicMNManager::GetHistoricSnapshot(const uint256& blockHash, CDeterministicMNList& mnListRet)
+{
+    AssertLockHeld(cs);
+
+    auto it = historicListsCache.find(blockHash);
+    if (it == historicListsCache.end()) {
+        return false;
+    }
+    it->second.lastAccess = historicListsCacheAccessCounter++;
+    mnListRet = it->second.mnList;
+    historicListsCacheHits++;
+    return true;
+}
+
+void CDeterministicMNManager::AddHistoricSnapshot(const CDeterministicMNList& mnList, size_t changeCount)
+{
+    AssertLockHeld(cs);
+
+    if (historicListsCacheMaxUsage == 0 || historicListsCache.count(mnList.GetBlockHash())) {
+        return;
+    }
+
+    size_t tier = 0;
+    for (size_t i = 0; i < HISTORIC_SNAPSHOT_PERIODS.size(); i++) {
+        if (mnList.GetHeight() % HISTORIC_SNAPSHOT_PERIODS[i] == 0) {
+            tier = i;
+        }
+    }
+    size_t cost = HISTORIC_SNAPSHOT_BASE_COST + changeCount * HISTORIC_SNAPSHOT_COST_PER_CHANGE;
+
+    historicListsCache.emplace(mnList.GetBlockHash(), HistoricSnapshot{mnList, tier, cost, historicListsCacheAccessCounter++});
+    historicListsCacheUsage += cost;
+
+    // evict the least recently used snapshots of the finest tier first
+    while (historicListsCacheUsage > historicListsCacheMaxUsage && !historicListsCache.empty()) {
+        auto itEvict = historicListsCache.begin();
+        for (auto it = historicListsCache.begin(); it != historicListsCache.end(); ++it) {
+            if (it->second.tier < itEvict->second.tier ||
+                (it->second.tier == itEvict->second.tier && it->second.lastAccess < itEvict->second.lastAccess)) {
+                itEvict = it;
+            }
+        }
+        historicListsCacheUsage -= itEvict->second.cost;
+        historicListsCache.erase(itEvict);
+    }
+}
+
 void CDeterministicMNManager::CleanupCache(int nHeight)
 {
     AssertLockHeld(cs);
@@ -1173,7 +1575,7 @@ bool CDeterministicMNManager::UpgradeDBIfNeeded()
     }
 
     if (evoDb.GetRawDB().Exists(EVODB_BEST_BLOCK)) {
-        return true;
+        return MigrateSnapshots();
     }
 
     // Removing the old EVODB_BEST_BLOCK value early results in older version to crash immediately, even if the upgrade
@@ -1226,5 +1628,61 @@ bool CDeterministicMNManager::UpgradeDBIfNeeded()
 
     evoDb.GetRawDB().CompactFull();
 
+    return MigrateSnapshots();
+}
+
+bool CDeterministicMNManager::MigrateSnapshots()
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    std::unique_ptr<CDBIterator> it(evoDb.GetRawDB().NewIterator());
+    auto firstKey = std::make_pair(DB_LIST_SNAPSHOT, uint256());
+    it->Seek(firstKey);
+
+    size_t nMigrated = 0;
+    for (; it->Valid(); it->Next()) {
+        decltype(firstKey) curKey;
+        if (!it->GetKey(curKey) || curKey.first != DB_LIST_SNAPSHOT) {
+            break;
+        }
+        if (nMigrated == 0) {
+            LogPrintf("CDeterministicMNManager::%s -- upgrading DB to deduplicated snapshots\n", __func__);
+        }
+
+        CDeterministicMNList mnList;
+        if (!it->GetValue(mnList)) {
+            LogPrintf("CDeterministicMNManager::%s -- failed to read snapshot %s\n", __func__, curKey.second.ToString());
+            return false;
+        }
+
+        // each snapshot is converted atomically, so that an interrupted upgrade is continued on the next start
+        CDBBatch batch(evoDb.GetRawDB());
+        WriteSnapshot(batch, mnList);
+        batch.Erase(curKey);
+        evoDb.GetRawDB().WriteBatch(batch);
+        nMigrated++;
+    }
+
+    if (nMigrated != 0) {
+        LogPrintf("CDeterministicMNManager::%s -- done upgrading %d snapshots\n", __func__, nMigrated);
+        evoDb.GetRawDB().CompactFull();
+    }
+
     return true;
 }
+
+CDeterministicMNUndoBatch::CDeterministicMNUndoBatch()
+{
+    if (deterministicMNManager) {
+        deterministicMNManager->BeginUndoBatch();
+    }
+}
+
+CDeterministicMNUndoBatch::~CDeterministicMNUndoBatch()
+{
+    AssertLockHeld(cs_main);
+    if (deterministicMNManager) {
+        deterministicMNManager->EndUndoBatch(chainActive.Tip());
+    }
+}
@@ -13,11 +13,18 @@
 #include <evo/simplifiedmns.h>
 #include <saltedhasher.h>
 #include <sync.h>
+#include <unordered_lru_cache.h>
 
+#include <immer/flex_vector.hpp>
 #include <immer/map.hpp>
 #include <immer/map_transient.hpp>
+#include <immer/heap/cpp_heap.hpp>
+#include <immer/heap/free_list_heap.hpp>
+#include <immer/heap/thread_local_free_list_heap.hpp>
+#include <immer/heap/with_data.hpp>
 
 #include <unordered_map>
+#include <unordered_set>
 
 class CBlock;
 class CBlockIndex;
@@ -28,6 +35,9 @@ namespace llmq
     class CFinalCommitment;
 } // namespace llmq
 
+// memory budget (in MiB) for in-memory snapshots of historic MN lists
+static const int64_t DEFAULT_HISTORIC_MN_LISTS_CACHE = 32;
+
 class CDeterministicMNState
 {
 private:
@@ -267,19 +277,99 @@ public:
 typedef std::shared_ptr<const CDeterministicMN> CDeterministicMNCPtr;
 
 class CDeterministicMNListDiff;
+class CDeterministicMNListMemoryUsage;
+
+/**
+ * Heap for the nodes of the immer containers of CDeterministicMNList.
+ *
+ * The size of a HAMT node depends on its number of children and values, so immer allocates these nodes through the
+ * unoptimized heap of the memory policy, which is plain malloc with the default policy. This heap rounds sizes up to
+ * size classes and keeps freed blocks in free lists per size class, a thread local one first and then a global
+ * lock-free one, the same way the default policy does it for fixed size nodes. Bigger blocks use the standard heap.
+ */
+class CDeterministicMNListHeap
+{
+public:
+    static const size_t CLASS_GRANULARITY = 32;
+    static const size_t CLASS_COUNT = 64;
+    // blocks kept per size class, in each of the free lists
+    static const size_t FREE_LIST_LIMIT = 1 << 12;
+
+private:
+    template <size_t Size>
+    using ClassHeap = immer::with_free_list_node<
+        immer::thread_local_free_list_heap<Size, FREE_LIST_LIMIT,
+            immer::free_list_heap<Size, FREE_LIST_LIMIT, immer::cpp_heap>>>;
+
+    struct SizeClass {
+        void* (*allocate)(size_t);
+        void (*deallocate)(size_t, void*);
+    };
+
+    template <size_t Size>
+    static void* AllocateClass(size_t size) { return ClassHeap<Size>::allocate(size); }
+    template <size_t Size>
+    static void DeallocateClass(size_t size, void* data) { ClassHeap<Size>::deallocate(size, data); }
+
+    template <size_t... I>
+    static const SizeClass& GetSizeClass(size_t idx, std::index_sequence<I...>)
+    {
+        static const SizeClass classes[] = {{&AllocateClass<(I + 1) * CLASS_GRANULARITY>, &DeallocateClass<(I + 1) * CLASS_GRANULARITY>}...};
+        return classes[idx];
+    }
+
+    static size_t GetSizeClassIndex(size_t size) { return size == 0 ? 0 : (size - 1) / CLASS_GRANULARITY; }
+
+public:
+    template <typename... Tags>
+    static void* allocate(size_t size, Tags... tags)
+    {
+        size_t idx = GetSizeClassIndex(size);
+        if (idx >= CLASS_COUNT) {
+            return immer::cpp_heap::allocate(size, tags...);
+        }
+        return GetSizeClass(idx, std::make_index_sequence<CLASS_COUNT>()).allocate(size);
+    }
+
+    template <typename... Tags>
+    static void deallocate(size_t size, void* data, Tags... tags)
+    {
+        size_t idx = GetSizeClassIndex(size);
+        if (idx >= CLASS_COUNT) {
+            immer::cpp_heap::deallocate(size, data, tags...);
+            return;
+        }
+        GetSizeClass(idx, std::make_index_sequence<CLASS_COUNT>()).deallocate(size, data);
+    }
+};
+
+struct CDeterministicMNListHeapPolicy
+{
+    using type = CDeterministicMNListHeap;
+
+    template <size_t>
+    struct optimized
+    {
+        using type = CDeterministicMNListHeap;
+    };
+};
+
+// Reference counts stay atomic, as lists are copied and released outside of CDeterministicMNManager::cs, e.g. by
+// GetListAtChainTip() callers and by the GUI
+typedef immer::memory_policy<CDeterministicMNListHeapPolicy, immer::refcount_policy> CDeterministicMNListMemoryPolicy;
 
-template <typename Stream, typename K, typename T, typename Hash, typename Equal>
-void SerializeImmerMap(Stream& os, const immer::map<K, T, Hash, Equal>& m)
+template <typename Stream, typename K, typename T, typename Hash, typename Equal, typename MemoryPolicy, immer::detail::hamts::bits_t B>
+void SerializeImmerMap(Stream& os, const immer::map<K, T, Hash, Equal, MemoryPolicy, B>& m)
 {
     WriteCompactSize(os, m.size());
-    for (typename immer::map<K, T, Hash, Equal>::const_iterator mi = m.begin(); mi != m.end(); ++mi)
+    for (auto mi = m.begin(); mi != m.end(); ++mi)
         Serialize(os, (*mi));
 }
 
-template <typename Stream, typename K, typename T, typename Hash, typename Equal>
-void UnserializeImmerMap(Stream& is, immer::map<K, T, Hash, Equal>& m)
+template <typename Stream, typename K, typename T, typename Hash, typename Equal, typename MemoryPolicy, immer::detail::hamts::bits_t B>
+void UnserializeImmerMap(Stream& is, immer::map<K, T, Hash, Equal, MemoryPolicy, B>& m)
 {
-    m = immer::map<K, T, Hash, Equal>();
+    m = immer::map<K, T, Hash, Equal, MemoryPolicy, B>();
     unsigned int nSize = ReadCompactSize(is);
     for (unsigned int i = 0; i < nSize; i++) {
         std::pair<K, T> item;
@@ -290,25 +380,76 @@ void UnserializeImmerMap(Stream& is, immer::map<K, T, Hash, Equal>& m)
 
 // For some reason the compiler is not able to choose the correct Serialize/Deserialize methods without a specialized
 // version of SerReadWrite. It otherwise always chooses the version that calls a.Serialize()
-template<typename Stream, typename K, typename T, typename Hash, typename Equal>
-inline void SerReadWrite(Stream& s, const immer::map<K, T, Hash, Equal>& m, CSerActionSerialize ser_action)
+template<typename Stream, typename K, typename T, typename Hash, typename Equal, typename MemoryPolicy, immer::detail::hamts::bits_t B>
+inline void SerReadWrite(Stream& s, const immer::map<K, T, Hash, Equal, MemoryPolicy, B>& m, CSerActionSerialize ser_action)
 {
     ::SerializeImmerMap(s, m);
 }
 
-template<typename Stream, typename K, typename T, typename Hash, typename Equal>
-inline void SerReadWrite(Stream& s, immer::map<K, T, Hash, Equal>& obj, CSerActionUnserialize ser_action)
+template<typename Stream, typename K, typename T, typename Hash, typename Equal, typename MemoryPolicy, immer::detail::hamts::bits_t B>
+inline void SerReadWrite(Stream& s, immer::map<K, T, Hash, Equal, MemoryPolicy, B>& obj, CSerActionUnserialize ser_action)
 {
     ::UnserializeImmerMap(s, obj);
 }
 
+/**
+ * Struct-of-arrays view of a CDeterministicMNList, with all MNs sorted by proTxHash. Loops which only need a few fields
+ * of each MN iterate over these arrays instead of walking the HAMT and dereferencing each MN and its state. The view
+ * is built lazily by CDeterministicMNList::GetView() and shared by all copies of the same list version.
+ */
+class CDeterministicMNListView
+{
+public:
+    static const uint8_t FLAG_VALID = 1;
+    static const uint8_t FLAG_CONFIRMED = 2;
+
+    std::vector<CDeterministicMNCPtr> mns;
+    std::vector<uint256> proTxHashes;
+    std::vector<uint256> confirmedHashesWithProRegTxHash;
+    std::vector<int> lastPaidHeights;
+    std::vector<CService> services;
+    std::vector<uint8_t> flags;
+
+public:
+    size_t size() const { return mns.size(); }
+    bool IsValid(size_t i) const { return (flags[i] & FLAG_VALID) != 0; }
+    bool IsConfirmed(size_t i) const { return (flags[i] & FLAG_CONFIRMED) != 0; }
+
+    size_t DynamicMemoryUsage() const;
+};
+typedef std::shared_ptr<const CDeterministicMNListView> CDeterministicMNListViewCPtr;
+
+// Holds the view of a list. Copies of the list share the view, which is accessed atomically as copies might be built
+// or read by multiple threads at once
+class CDeterministicMNListViewCache
+{
+private:
+    mutable CDeterministicMNListViewCPtr view;
+
+public:
+    CDeterministicMNListViewCache() = default;
+    CDeterministicMNListViewCache(const CDeterministicMNListViewCache& other) : view(std::atomic_load(&other.view)) {}
+    CDeterministicMNListViewCache& operator=(const CDeterministicMNListViewCache& other)
+    {
+        std::atomic_store(&view, std::atomic_load(&other.view));
+        return *this;
+    }
+
+    CDeterministicMNListViewCPtr Get() const { return std::atomic_load(&view); }
+    void Set(CDeterministicMNListViewCPtr newView) const { std::atomic_store(&view, std::move(newView)); }
+    void Reset() { std::atomic_store(&view, CDeterministicMNListViewCPtr()); }
+};
 
 class CDeterministicMNList
 {
+    friend class CDeterministicMNListMemoryUsage;
+
 public:
-    typedef immer::map<uint256, CDeterministicMNCPtr> MnMap;
-    typedef immer::map<uint64_t, uint256> MnInternalIdMap;
-    typedef immer::map<uint256, std::pair<uint256, uint32_t> > MnUniquePropertyMap;
+    typedef immer::map<uint256, CDeterministicMNCPtr, std::hash<uint256>, std::equal_to<uint256>, CDeterministicMNListMemoryPolicy> MnMap;
+    typedef immer::map<uint64_t, uint256, std::hash<uint64_t>, std::equal_to<uint64_t>, CDeterministicMNListMemoryPolicy> MnInternalIdMap;
+    typedef immer::map<uint256, std::pair<uint256, uint32_t>, std::hash<uint256>, std::equal_to<uint256>, CDeterministicMNListMemoryPolicy> MnUniquePropertyMap;
+    // (payment height, proTxHash) of all valid MNs, sorted in the order in which the MNs will get paid
+    typedef immer::flex_vector<std::pair<int, uint256>, CDeterministicMNListMemoryPolicy> MnPaymentQueue;
 
 private:
     uint256 blockHash;
@@ -321,6 +462,12 @@ private:
     // we keep track of this as checking for duplicates would otherwise be painfully slow
     MnUniquePropertyMap mnUniquePropertyMap;
 
+    // kept in sync with mnMap by AddMN/UpdateMN/RemoveMN, so that payee lookups don't need to sort the whole list
+    MnPaymentQueue mnPaymentQueue;
+
+    // reset whenever mnMap changes
+    CDeterministicMNListViewCache viewCache;
+
 public:
     CDeterministicMNList() = default;
     explicit CDeterministicMNList(const uint256& _blockHash, int _height, uint32_t _totalRegisteredCount) :
@@ -354,6 +501,8 @@ public:
         mnMap = MnMap();
         mnUniquePropertyMap = MnUniquePropertyMap();
         mnInternalIdMap = MnInternalIdMap();
+        mnPaymentQueue = MnPaymentQueue();
+        viewCache.Reset();
 
         SerializationOpBase(s, CSerActionUnserialize());
 
@@ -371,13 +520,7 @@ public:
 
     size_t GetValidMNsCount() const
     {
-        size_t count = 0;
-        for (const auto& p : mnMap) {
-            if (IsMNValid(p.second)) {
-                count++;
-            }
-        }
-        return count;
+        return mnPaymentQueue.size();
     }
 
     template <typename Callback>
@@ -390,6 +533,9 @@ public:
         }
     }
 
+    // Returns the struct-of-arrays view of this list, building it on first use
+    CDeterministicMNListViewCPtr GetView() const;
+
 public:
     const uint256& GetBlockHash() const
     {
@@ -514,6 +660,9 @@ public:
     }
 
 private:
+    void AddToPaymentQueue(const CDeterministicMNCPtr& dmn);
+    void RemoveFromPaymentQueue(const CDeterministicMNCPtr& dmn);
+
     template <typename T>
     NODISCARD bool AddUniqueProperty(const CDeterministicMNCPtr& dmn, const T& v)
     {
@@ -629,6 +778,25 @@ public:
     }
 };
 
+/**
+ * Sums up the memory used by a set of MN lists and diffs. Lists share most of their immer nodes and all MNs and states
+ * which didn't change with each other, so everything reachable from more than one list or diff is only counted once.
+ * The payment queue is approximated by its elements.
+ */
+class CDeterministicMNListMemoryUsage
+{
+private:
+    std::unordered_set<const void*> seen;
+    size_t usage{0};
+
+public:
+    void Add(const CDeterministicMNList& mnList);
+    void Add(const CDeterministicMNListDiff& diff);
+    void Add(const CDeterministicMNCPtr& dmn);
+
+    size_t Get() const { return usage; }
+};
+
 // TODO can be removed in a future version
 class CDeterministicMNListDiff_OldFormat
 {
@@ -663,11 +831,103 @@ public:
     }
 };
 
+/**
+ * On-disk format of MN list snapshots. The states of MNs are not stored inside the snapshot but separately by their
+ * hash, so that states which did not change between two snapshots are stored only once. Entries are ordered by
+ * internalId, which allows delta encoding the ids, and collaterals which are part of the ProRegTx only store the index.
+ */
+class CDeterministicMNListSnapshot
+{
+public:
+    struct Entry {
+        uint256 proTxHash;
+        uint64_t internalId;
+        COutPoint collateralOutpoint;
+        uint16_t nOperatorReward;
+        uint256 stateHash;
+    };
+
+    static const uint8_t ENTRY_FLAG_COLLATERAL_IN_PROTX = 1;
+
+    uint256 blockHash;
+    int nHeight{-1};
+    uint32_t nTotalRegisteredCount{0};
+    std::vector<Entry> entries;
+
+public:
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << blockHash;
+        s << nHeight;
+        s << nTotalRegisteredCount;
+        WriteCompactSize(s, entries.size());
+        uint64_t prevId = 0;
+        for (const auto& e : entries) {
+            uint8_t flags = e.collateralOutpoint.hash == e.proTxHash ? ENTRY_FLAG_COLLATERAL_IN_PROTX : 0;
+            s << flags;
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint64_t>(s, e.internalId - prevId);
+            s << e.proTxHash;
+            if (!(flags & ENTRY_FLAG_COLLATERAL_IN_PROTX)) {
+                s << e.collateralOutpoint.hash;
+            }
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, e.collateralOutpoint.n);
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint16_t>(s, e.nOperatorReward);
+            s << e.stateHash;
+            prevId = e.internalId;
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        entries.clear();
+
+        s >> blockHash;
+        s >> nHeight;
+        s >> nTotalRegisteredCount;
+        size_t cnt = ReadCompactSize(s);
+        entries.resize(cnt);
+        uint64_t prevId = 0;
+        for (auto& e : entries) {
+            uint8_t flags;
+            s >> flags;
+            e.internalId = prevId + ReadVarInt<Stream, VarIntMode::DEFAULT, uint64_t>(s);
+            s >> e.proTxHash;
+            if (flags & ENTRY_FLAG_COLLATERAL_IN_PROTX) {
+                e.collateralOutpoint.hash = e.proTxHash;
+            } else {
+                s >> e.collateralOutpoint.hash;
+            }
+            e.collateralOutpoint.n = ReadVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s);
+            e.nOperatorReward = ReadVarInt<Stream, VarIntMode::DEFAULT, uint16_t>(s);
+            s >> e.stateHash;
+            prevId = e.internalId;
+        }
+    }
+};
+
 class CDeterministicMNManager
 {
     static const int DISK_SNAPSHOT_PERIOD = 576; // once per day
     static const int DISK_SNAPSHOTS = 3; // keep cache for 3 disk snapshots to have 2 full days covered
     static const int LIST_DIFFS_CACHE_SIZE = DISK_SNAPSHOT_PERIOD * DISK_SNAPSHOTS;
+    // while replaying diffs, lists at heights which are a multiple of one of these periods are kept in memory, so that
+    // later queries for historic lists have to apply at most a few diffs. Snapshots of finer tiers are evicted first
+    static const std::vector<int> HISTORIC_SNAPSHOT_PERIODS;
+    // rough estimate of the memory taken by a snapshot. Snapshots share most of their nodes with each other (immer
+    // maps), so only the parts changed by the diffs applied since the previously cached snapshot are accounted
+    static const size_t HISTORIC_SNAPSHOT_BASE_COST = sizeof(CDeterministicMNList) + 512;
+    static const size_t HISTORIC_SNAPSHOT_COST_PER_CHANGE = 1536;
+    // MN states read from snapshots on disk, shared between all lists read from disk
+    static const size_t MN_STATE_CACHE_SIZE = 16384;
+
+    struct HistoricSnapshot {
+        CDeterministicMNList mnList;
+        size_t tier;
+        size_t cost;
+        int64_t lastAccess;
+    };
 
 public:
     CCriticalSection cs;
@@ -679,12 +939,37 @@ private:
     std::unordered_map<uint256, CDeterministicMNListDiff, StaticSaltedHasher> mnListDiffsCache;
     const CBlockIndex* tipIndex{nullptr};
 
+    // merkle tree of the simplified MN list built from smlMerkleTreeList, see CalcSMLMerkleRoot
+    CSimplifiedMNListMerkleTree smlMerkleTree;
+    CDeterministicMNList smlMerkleTreeList;
+    bool smlMerkleTreeInitialized{false};
+
+    std::unordered_map<uint256, HistoricSnapshot, StaticSaltedHasher> historicListsCache;
+    size_t historicListsCacheMaxUsage;
+    size_t historicListsCacheUsage{0};
+    int64_t historicListsCacheAccessCounter{0};
+    uint64_t historicListsCacheHits{0};
+    uint64_t historicListsCacheMisses{0};
+
+    // states in this cache are known to be stored on disk already
+    unordered_lru_cache<uint256, CDeterministicMNStateCPtr, StaticSaltedHasher> mnStateCache{MN_STATE_CACHE_SIZE};
+
+    // see BeginUndoBatch. undoBatchList is the list before the first undone block which changed the list
+    bool fUndoBatch{false};
+    bool fUndoBatchChanged{false};
+    CDeterministicMNList undoBatchList;
+
 public:
     explicit CDeterministicMNManager(CEvoDB& _evoDb);
 
     bool ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck);
     bool UndoBlock(const CBlock& block, const CBlockIndex* pindex);
 
+    // Blocks undone between these calls don't notify about the MN list changes one by one. EndUndoBatch notifies once
+    // about the change from the list before the first undone block to the list of pindexTip, the new tip
+    void BeginUndoBatch();
+    void EndUndoBatch(const CBlockIndex* pindexTip);
+
     void UpdatedBlockTip(const CBlockIndex* pindex);
 
     // the returned list will not contain the correct block hash (we can't know it yet as the coinbase TX is not updated yet)
@@ -695,20 +980,48 @@ public:
     CDeterministicMNList GetListForBlock(const CBlockIndex* pindex);
     CDeterministicMNList GetListAtChainTip();
 
+    // Calculates the merkle root of the simplified MN list of mnList. The merkle tree is kept between calls and only
+    // the leaves of MNs which changed compared to the list of the previous call are updated
+    uint256 CalcSMLMerkleRoot(const CDeterministicMNList& mnList, bool* pmutated = nullptr);
+
     // Test if given TX is a ProRegTx which also contains the collateral at index n
     static bool IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n);
 
     bool IsDIP3Enforced(int nHeight = -1);
 
+    // Memory used by the cached lists and diffs. Shared parts of the lists are only counted once
+    size_t GetMemoryUsage();
+
 public:
     // TODO these can all be removed in a future version
     void UpgradeDiff(CDBBatch& batch, const CBlockIndex* pindexNext, const CDeterministicMNList& curMNList, CDeterministicMNList& newMNList);
     bool UpgradeDBIfNeeded();
 
 private:
+    // converts all snapshots which are still in the format of CDeterministicMNList::Serialize
+    bool MigrateSnapshots();
+
+    template<typename Batch>
+    void WriteSnapshot(Batch& batch, const CDeterministicMNList& mnList);
+    bool ReadSnapshot(const uint256& blockHash, CDeterministicMNList& mnListRet);
+
     void CleanupCache(int nHeight);
+
+    bool GetHistoricSnapshot(const uint256& blockHash, CDeterministicMNList& mnListRet);
+    void AddHistoricSnapshot(const CDeterministicMNList& mnList, size_t changeCount);
 };
 
 extern std::unique_ptr<CDeterministicMNManager> deterministicMNManager;
 
+/**
+ * Undo batch of deterministicMNManager for the lifetime of this object, used while disconnecting multiple blocks in a
+ * row, e.g. during reorgs. The batch ends with the active chain tip, so cs_main must be held until it's destroyed.
+ */
+class CDeterministicMNUndoBatch
+{
+public:
+    CDeterministicMNUndoBatch();
+    ~CDeterministicMNUndoBatch();
+};
+
 #endif // BITCOIN_EVO_DETERMINISTICMNS_H
@@ -37,6 +37,8 @@ CEvoDB::CEvoDB(size_t nCacheSize, bool fMemory, bool fWipe) :
     rootDBTransaction(db, rootBatch),
     curDBTransaction(rootDBTransaction, rootDBTransaction)
 {
+    // Root transactions are written in the background, see CommitRootTransactionAsync()
+    db.StartAsyncWriter();
 }
 
 void CEvoDB::CommitCurTransaction()
@@ -52,15 +54,29 @@ void CEvoDB::RollbackCurTransaction()
 }
 
 bool CEvoDB::CommitRootTransaction()
+{
+    if (!CommitRootTransactionAsync()) {
+        return false;
+    }
+    WaitForCommits();
+    return true;
+}
+
+bool CEvoDB::CommitRootTransactionAsync()
 {
     LOCK(cs);
     assert(curDBTransaction.IsClean());
     rootDBTransaction.Commit();
-    bool ret = db.WriteBatch(rootBatch);
+    bool ret = db.WriteBatchAsync(rootBatch);
     rootBatch.Clear();
     return ret;
 }
 
+void CEvoDB::WaitForCommits()
+{
+    db.WaitForAsyncWrites();
+}
+
 bool CEvoDB::VerifyBestBlock(const uint256& hash)
 {
     // Make sure evodb is consistent.
@@ -98,6 +98,15 @@ public:
 
     bool CommitRootTransaction();
 
+    /**
+     * Hand the root transaction to the writer thread of the db and return without waiting for it. It contains the
+     * best block marker, so the db on disk is always consistent with itself. Reads see the changes right away.
+     */
+    bool CommitRootTransactionAsync();
+
+    /** Wait until all committed root transactions are written, throws dbwrapper_error if writing failed */
+    void WaitForCommits();
+
     bool IsEmpty() { return db.IsEmpty(); }
 
     bool VerifyBestBlock(const uint256& hash);
@@ -4,7 +4,9 @@
 
 #include <evo/mnauth.h>
 
+#include <bls/bls_worker.h>
 #include <evo/deterministicmns.h>
+#include <llmq/quorums_init.h>
 #include <llmq/quorums_utils.h>
 #include <masternode/activemasternode.h>
 #include <masternode/masternode-meta.h>
@@ -54,7 +56,7 @@ void CMNAuth::PushMNAUTH(CNode* pnode, CConnman& connman)
     connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MNAUTH, mnauth));
 }
 
-void CMNAuth::ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
+void CMNAuth::ProcessMessage(CNode* pnode, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman)
 {
     if (!masternodeSync.IsBlockchainSynced()) {
         // we can't verify MNAUTH messages when we don't have the latest MN list
@@ -123,82 +125,114 @@ void CMNAuth::ProcessMessage(CNode* pnode, const std::string& strCommand, CDataS
             LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- constructed signHash for nVersion %d, peer=%d\n", __func__, pnode->nVersion, pnode->GetId());
         }
 
-        if (!mnauth.sig.VerifyInsecure(dmn->pdmnState->pubKeyOperator.Get(), signHash)) {
-            LOCK(cs_main);
-            // Same as above, MN seems to not know its fate yet, so give it a chance to update. If this is a
-            // malicious node (DoSing us), it'll get banned soon.
-            Misbehaving(pnode->GetId(), 10, "mnauth signature verification failed");
+        if (llmq::blsWorker == nullptr) {
+            ProcessVerifiedMNAuth(pnode, mnauth, dmn, mnauth.sig.VerifyInsecure(dmn->pdmnState->pubKeyOperator.Get(), signHash), connman);
             return;
         }
 
-        if (!pnode->fInbound) {
-            mmetaman.GetMetaInfo(mnauth.proRegTxHash)->SetLastOutboundSuccess(GetAdjustedTime());
-            if (pnode->m_masternode_probe_connection) {
-                LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode probe successful for %s, disconnecting. peer=%d\n",
-                         mnauth.proRegTxHash.ToString(), pnode->GetId());
-                pnode->fDisconnect = true;
-                return;
-            }
+        // Verified by the BLS worker, which aggregates the signatures of all MNAUTHs arriving at about the same time.
+        // Further messages of the node are only processed after this one, see ProcessMessages()
+        pnode->fMNAuthPending = true;
+        pnode->AddRef();
+        llmq::blsWorker->AsyncVerifySig(mnauth.sig, dmn->pdmnState->pubKeyOperator.Get(), signHash, [pnode, mnauth, dmn, &connman](bool fValid) {
+            ProcessVerifiedMNAuth(pnode, mnauth, dmn, fValid, connman);
+            pnode->fMNAuthPending = false;
+            connman.WakeMessageHandler(pnode);
+            pnode->Release();
+        });
+    }
+}
+
+void CMNAuth::ProcessVerifiedMNAuth(CNode* pnode, const CMNAuth& mnauth, const CDeterministicMNCPtr& dmn, bool fValid, CConnman& connman)
+{
+    // MNAUTHs are verified on multiple threads, the check for duplicate connections must see all finished ones
+    static CCriticalSection cs_verified;
+    LOCK(cs_verified);
+
+    if (pnode->fDisconnect) {
+        return;
+    }
+
+    if (!fValid) {
+        LOCK(cs_main);
+        // Same as for a missing MN, MN seems to not know its fate yet, so give it a chance to update. If this is a
+        // malicious node (DoSing us), it'll get banned soon.
+        Misbehaving(pnode->GetId(), 10, "mnauth signature verification failed");
+        return;
+    }
+
+    if (!pnode->fInbound) {
+        mmetaman.GetMetaInfo(mnauth.proRegTxHash)->SetLastOutboundSuccess(GetAdjustedTime());
+        if (pnode->m_masternode_probe_connection) {
+            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode probe successful for %s, disconnecting. peer=%d\n",
+                     mnauth.proRegTxHash.ToString(), pnode->GetId());
+            pnode->fDisconnect = true;
+            return;
         }
+    }
 
-        connman.ForEachNode([&](CNode* pnode2) {
-            if (pnode->fDisconnect) {
-                // we've already disconnected the new peer
-                return;
-            }
+    connman.ForEachNode([&](CNode* pnode2) {
+        if (pnode->fDisconnect) {
+            // we've already disconnected the new peer
+            return;
+        }
 
-            if (pnode2->verifiedProRegTxHash == mnauth.proRegTxHash) {
-                if (fMasternodeMode) {
-                    auto deterministicOutbound = llmq::CLLMQUtils::DeterministicOutboundConnection(activeMasternodeInfo.proTxHash, mnauth.proRegTxHash);
-                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, deterministicOutbound=%s. peer=%d\n",
-                             mnauth.proRegTxHash.ToString(), pnode2->GetId(), deterministicOutbound.ToString(), pnode->GetId());
-                    if (deterministicOutbound == activeMasternodeInfo.proTxHash) {
-                        if (pnode2->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping old inbound, peer=%d\n", pnode2->GetId());
-                            pnode2->fDisconnect = true;
-                        } else if (pnode->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping new inbound, peer=%d\n", pnode->GetId());
-                            pnode->fDisconnect = true;
-                        }
-                    } else {
-                        if (!pnode2->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping old outbound, peer=%d\n", pnode2->GetId());
-                            pnode2->fDisconnect = true;
-                        } else if (!pnode->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping new outbound, peer=%d\n", pnode->GetId());
-                            pnode->fDisconnect = true;
-                        }
+        if (pnode2->verifiedProRegTxHash == mnauth.proRegTxHash) {
+            if (fMasternodeMode) {
+                auto deterministicOutbound = llmq::CLLMQUtils::DeterministicOutboundConnection(activeMasternodeInfo.proTxHash, mnauth.proRegTxHash);
+                LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, deterministicOutbound=%s. peer=%d\n",
+                         mnauth.proRegTxHash.ToString(), pnode2->GetId(), deterministicOutbound.ToString(), pnode->GetId());
+                if (deterministicOutbound == activeMasternodeInfo.proTxHash) {
+                    if (pnode2->fInbound) {
+                        LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping old inbound, peer=%d\n", pnode2->GetId());
+                        pnode2->fDisconnect = true;
+                    } else if (pnode->fInbound) {
+                        LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping new inbound, peer=%d\n", pnode->GetId());
+                        pnode->fDisconnect = true;
                     }
                 } else {
-                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, dropping new connection. peer=%d\n",
-                            mnauth.proRegTxHash.ToString(), pnode2->GetId(), pnode->GetId());
-                    pnode->fDisconnect = true;
+                    if (!pnode2->fInbound) {
+                        LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping old outbound, peer=%d\n", pnode2->GetId());
+                        pnode2->fDisconnect = true;
+                    } else if (!pnode->fInbound) {
+                        LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping new outbound, peer=%d\n", pnode->GetId());
+                        pnode->fDisconnect = true;
+                    }
                 }
+            } else {
+                LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, dropping new connection. peer=%d\n",
+                        mnauth.proRegTxHash.ToString(), pnode2->GetId(), pnode->GetId());
+                pnode->fDisconnect = true;
             }
-        });
-
-        if (pnode->fDisconnect) {
-            return;
         }
+    });
 
-        {
-            LOCK(pnode->cs_mnauth);
-            pnode->verifiedProRegTxHash = mnauth.proRegTxHash;
-            pnode->verifiedPubKeyHash = dmn->pdmnState->pubKeyOperator.GetHash();
-        }
+    if (pnode->fDisconnect) {
+        return;
+    }
 
-        if (!pnode->m_masternode_iqr_connection && connman.IsMasternodeQuorumRelayMember(pnode->verifiedProRegTxHash)) {
-            // Tell our peer that we're interested in plain LLMQ recovered signatures.
-            // Otherwise the peer would only announce/send messages resulting from QRECSIG,
-            // e.g. InstantSend locks or ChainLocks. SPV and regular full nodes should not send
-            // this message as they are usually only interested in the higher level messages.
-            const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-            connman.PushMessage(pnode, msgMaker.Make(NetMsgType::QSENDRECSIGS, true));
-            pnode->m_masternode_iqr_connection = true;
-        }
+    {
+        LOCK(pnode->cs_mnauth);
+        pnode->verifiedProRegTxHash = mnauth.proRegTxHash;
+        pnode->verifiedPubKeyHash = dmn->pdmnState->pubKeyOperator.GetHash();
+    }
 
-        LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Valid MNAUTH for %s, peer=%d\n", __func__, mnauth.proRegTxHash.ToString(), pnode->GetId());
+    if (!pnode->m_masternode_iqr_connection && connman.IsMasternodeQuorumRelayMember(pnode->verifiedProRegTxHash)) {
+        // Tell our peer that we're interested in plain LLMQ recovered signatures.
+        // Otherwise the peer would only announce/send messages resulting from QRECSIG,
+        // e.g. InstantSend locks or ChainLocks. SPV and regular full nodes should not send
+        // this message as they are usually only interested in the higher level messages.
+        const CNetMsgMaker msgMaker(pnode->GetSendVersion());
+        connman.PushMessage(pnode, msgMaker.Make(NetMsgType::QSENDRECSIGS, true));
+        pnode->m_masternode_iqr_connection = true;
     }
+
+    if (connman.IsMasternodeFastTransportEnabled() && pnode->m_masternode_connection && !pnode->m_masternode_probe_connection) {
+        // the message handler thread hands the node over to the fast transport thread once it's done with it
+        pnode->fFastTransportPending = true;
+    }
+
+    LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Valid MNAUTH for %s, peer=%d\n", __func__, mnauth.proRegTxHash.ToString(), pnode->GetId());
 }
 
 void CMNAuth::NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff)
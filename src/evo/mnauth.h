@@ -7,9 +7,11 @@
 
 #include <bls/bls.h>
 #include <serialize.h>
+#include <streams.h>
+
+#include <memory>
 
 class CConnman;
-class CDataStream;
 class CDeterministicMN;
 class CDeterministicMNList;
 class CDeterministicMNListDiff;
@@ -50,8 +52,12 @@ public:
     }
 
     static void PushMNAUTH(CNode* pnode, CConnman& connman);
-    static void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    static void ProcessMessage(CNode* pnode, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman);
     static void NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff);
+
+private:
+    // Everything after the signature check, called from the BLS worker threads
+    static void ProcessVerifiedMNAuth(CNode* pnode, const CMNAuth& mnauth, const std::shared_ptr<const CDeterministicMN>& dmn, bool fValid, CConnman& connman);
 };
 
 
@@ -40,9 +40,19 @@ static bool CheckService(const uint256& proTxHash, const ProTx& proTx, CValidati
     return true;
 }
 
+// The signature checks below are deferred into pvSigChecks when it is set. The caller is then responsible for running them
+// and rejecting the TX/block with "bad-protx-sig" if any of them fails
+
 template <typename ProTx>
-static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state)
+static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
+    if (pvSigChecks) {
+        pvSigChecks->emplace_back([proTx, keyID]() {
+            std::string strError;
+            return CHashSigner::VerifyHash(::SerializeHash(proTx), keyID, proTx.vchSig, strError);
+        });
+        return true;
+    }
     std::string strError;
     if (!CHashSigner::VerifyHash(::SerializeHash(proTx), keyID, proTx.vchSig, strError)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
@@ -51,8 +61,15 @@ static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationSta
 }
 
 template <typename ProTx>
-static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state)
+static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
+    if (pvSigChecks) {
+        pvSigChecks->emplace_back([proTx, keyID]() {
+            std::string strError;
+            return CMessageSigner::VerifyMessage(keyID, proTx.vchSig, proTx.MakeSignString(), strError);
+        });
+        return true;
+    }
     std::string strError;
     if (!CMessageSigner::VerifyMessage(keyID, proTx.vchSig, proTx.MakeSignString(), strError)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
@@ -61,8 +78,14 @@ static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationS
 }
 
 template <typename ProTx>
-static bool CheckHashSig(const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state)
+static bool CheckHashSig(const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
+    if (pvSigChecks) {
+        pvSigChecks->emplace_back([proTx, pubKey]() {
+            return proTx.sig.VerifyInsecure(pubKey, ::SerializeHash(proTx));
+        });
+        return true;
+    }
     if (!proTx.sig.VerifyInsecure(pubKey, ::SerializeHash(proTx))) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
     }
@@ -80,7 +103,7 @@ static bool CheckInputsHash(const CTransaction& tx, const ProTx& proTx, CValidat
     return true;
 }
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view)
+bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_REGISTER) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -198,7 +221,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
 
     if (keyForPayloadSig) {
         // collateral is not part of this ProRegTx, so we must verify ownership of the collateral
-        if (!CheckStringSig(ptx, *keyForPayloadSig, state)) {
+        if (!CheckStringSig(ptx, *keyForPayloadSig, state, pvSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -212,7 +235,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
     return true;
 }
 
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_SERVICE) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -259,7 +282,7 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
             // pass the state returned by the function above
             return false;
         }
-        if (!CheckHashSig(ptx, mn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(ptx, mn->pdmnState->pubKeyOperator.Get(), state, pvSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -268,7 +291,7 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
     return true;
 }
 
-bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view)
+bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -343,7 +366,7 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
             // pass the state returned by the function above
             return false;
         }
-        if (!CheckHashSig(ptx, dmn->pdmnState->keyIDOwner, state)) {
+        if (!CheckHashSig(ptx, dmn->pdmnState->keyIDOwner, state, pvSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -352,7 +375,7 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
     return true;
 }
 
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_REVOKE) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -383,7 +406,7 @@ bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
             // pass the state returned by the function above
             return false;
         }
-        if (!CheckHashSig(ptx, dmn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(ptx, dmn->pdmnState->pubKeyOperator.Get(), state, pvSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -7,6 +7,7 @@
 
 #include <bls/bls.h>
 #include <consensus/validation.h>
+#include <evo/specialtx.h>
 #include <primitives/transaction.h>
 
 #include <key_io.h>
@@ -236,9 +237,9 @@ public:
 };
 
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view);
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view);
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, std::vector<CSpecialTxSigCheck>* pvSigChecks = nullptr);
+bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks = nullptr);
+bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, std::vector<CSpecialTxSigCheck>* pvSigChecks = nullptr);
+bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CSpecialTxSigCheck>* pvSigChecks = nullptr);
 
 #endif // BITCOIN_EVO_PROVIDERTX_H
@@ -5,14 +5,18 @@
 #include <evo/cbtx.h>
 #include <core_io.h>
 #include <evo/deterministicmns.h>
+#include <evo/evodb.h>
 #include <llmq/quorums_blockprocessor.h>
 #include <llmq/quorums_commitment.h>
+#include <llmq/quorums_utils.h>
 #include <evo/simplifiedmns.h>
 #include <evo/specialtx.h>
 
 #include <base58.h>
 #include <chainparams.h>
+#include <compat/endian.h>
 #include <consensus/merkle.h>
+#include <streams.h>
 #include <univalue.h>
 #include <validation.h>
 
@@ -65,16 +69,12 @@ CSimplifiedMNList::CSimplifiedMNList(const std::vector<CSimplifiedMNListEntry>&
 
 CSimplifiedMNList::CSimplifiedMNList(const CDeterministicMNList& dmnList)
 {
-    mnList.resize(dmnList.GetAllMNsCount());
-
-    size_t i = 0;
-    dmnList.ForEachMN(false, [this, &i](const CDeterministicMNCPtr& dmn) {
-        mnList[i++] = std::make_unique<CSimplifiedMNListEntry>(*dmn);
-    });
-
-    std::sort(mnList.begin(), mnList.end(), [&](const std::unique_ptr<CSimplifiedMNListEntry>& a, const std::unique_ptr<CSimplifiedMNListEntry>& b) {
-        return a->proRegTxHash.Compare(b->proRegTxHash) < 0;
-    });
+    // the view is already sorted by proTxHash
+    auto view = dmnList.GetView();
+    mnList.resize(view->size());
+    for (size_t i = 0; i < view->size(); i++) {
+        mnList[i] = std::make_unique<CSimplifiedMNListEntry>(*view->mns[i]);
+    }
 }
 
 uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
@@ -87,6 +87,131 @@ uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
     return ComputeMerkleRoot(leaves, pmutated);
 }
 
+CSimplifiedMNListMerkleTree::CSimplifiedMNListMerkleTree()
+{
+    Clear();
+}
+
+void CSimplifiedMNListMerkleTree::Build(const CSimplifiedMNList& sml)
+{
+    Clear();
+    keys.reserve(sml.mnList.size());
+    levels[0].reserve(sml.mnList.size());
+    for (const auto& e : sml.mnList) {
+        keys.emplace_back(e->proRegTxHash);
+        levels[0].emplace_back(e->CalcHash());
+    }
+    RecalcLevels({}, 0);
+}
+
+void CSimplifiedMNListMerkleTree::Update(const std::vector<std::pair<uint256, uint256>>& updated, const std::vector<uint256>& removed)
+{
+    auto& leaves = levels[0];
+
+    // Leaves which only changed their hash keep their position and only need their path up to the root recalculated.
+    // Insertions and removals shift all following leaves, so everything right of the first of these is recalculated.
+    std::set<size_t> dirtyLeaves;
+    size_t dirtyFrom = std::numeric_limits<size_t>::max();
+
+    for (const auto& proTxHash : removed) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), proTxHash);
+        if (it == keys.end() || *it != proTxHash) {
+            continue;
+        }
+        size_t pos = it - keys.begin();
+        keys.erase(it);
+        leaves.erase(leaves.begin() + pos);
+        dirtyFrom = std::min(dirtyFrom, pos);
+    }
+    for (const auto& p : updated) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), p.first);
+        size_t pos = it - keys.begin();
+        if (it != keys.end() && *it == p.first) {
+            if (leaves[pos] != p.second) {
+                leaves[pos] = p.second;
+                dirtyLeaves.emplace(pos);
+            }
+        } else {
+            keys.insert(it, p.first);
+            leaves.insert(leaves.begin() + pos, p.second);
+            dirtyFrom = std::min(dirtyFrom, pos);
+        }
+    }
+
+    if (!dirtyLeaves.empty() || dirtyFrom != std::numeric_limits<size_t>::max()) {
+        RecalcLevels(std::move(dirtyLeaves), dirtyFrom);
+    }
+}
+
+void CSimplifiedMNListMerkleTree::Clear()
+{
+    keys.clear();
+    levels.clear();
+    levels.resize(1);
+}
+
+uint256 CSimplifiedMNListMerkleTree::GetRoot(bool* pmutated) const
+{
+    if (pmutated) {
+        // same check as in ComputeMerkleRoot, a level must not contain identical pairs
+        bool mutation = false;
+        for (size_t i = 0; i + 1 < levels.size() && !mutation; i++) {
+            const auto& level = levels[i];
+            for (size_t pos = 0; pos + 1 < level.size(); pos += 2) {
+                if (level[pos] == level[pos + 1]) {
+                    mutation = true;
+                    break;
+                }
+            }
+        }
+        *pmutated = mutation;
+    }
+    if (levels.back().empty()) {
+        return uint256();
+    }
+    return levels.back()[0];
+}
+
+void CSimplifiedMNListMerkleTree::RecalcLevels(std::set<size_t> dirtyLeaves, size_t dirtyFrom)
+{
+    size_t l = 0;
+    std::set<size_t> dirty = std::move(dirtyLeaves);
+    while (levels[l].size() > 1) {
+        if (levels.size() <= l + 1) {
+            levels.emplace_back();
+        }
+        const auto& cur = levels[l];
+        auto& next = levels[l + 1];
+        size_t nextSize = (cur.size() + 1) / 2;
+        next.resize(nextSize);
+
+        std::set<size_t> nextDirty;
+        for (size_t pos : dirty) {
+            nextDirty.emplace(pos / 2);
+        }
+        dirtyFrom = dirtyFrom == std::numeric_limits<size_t>::max() ? dirtyFrom : dirtyFrom / 2;
+
+        auto calcNode = [&](size_t i) {
+            const auto& a = cur[i * 2];
+            const auto& b = i * 2 + 1 < cur.size() ? cur[i * 2 + 1] : a;
+            next[i] = Hash(a.begin(), a.end(), b.begin(), b.end());
+        };
+        for (size_t i : nextDirty) {
+            if (i >= dirtyFrom || i >= nextSize) {
+                break;
+            }
+            calcNode(i);
+        }
+        for (size_t i = dirtyFrom; i < nextSize; i++) {
+            calcNode(i);
+        }
+
+        dirty = std::move(nextDirty);
+        l++;
+    }
+    levels.resize(l + 1);
+}
+
 CSimplifiedMNListDiff::CSimplifiedMNListDiff() = default;
 
 CSimplifiedMNListDiff::~CSimplifiedMNListDiff() = default;
@@ -244,3 +369,143 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
 
     return true;
 }
+
+CSimplifiedMNListDiffCache mnListDiffCache;
+
+CSimplifiedMNListDiffCache::DiffBytesPtr CSimplifiedMNListDiffCache::Build(const uint256& baseBlockHash, const uint256& blockHash, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    CSimplifiedMNListDiff mnListDiff;
+    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, errorRet)) {
+        return nullptr;
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << mnListDiff;
+    auto diff = std::make_shared<const std::vector<unsigned char>>(ss.begin(), ss.end());
+
+    LOCK(cs);
+    cache.insert(std::make_pair(baseBlockHash, blockHash), diff);
+    return diff;
+}
+
+bool CSimplifiedMNListDiffCache::GetDiff(const uint256& baseBlockHash, const uint256& blockHash, DiffBytesPtr& diffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    auto IsInActiveChain = [](const uint256& hash) {
+        if (hash.IsNull()) {
+            return true;
+        }
+        const CBlockIndex* pindex = LookupBlockIndex(hash);
+        return pindex && chainActive.Contains(pindex);
+    };
+
+    {
+        LOCK(cs);
+        // A diff only depends on the two blocks, but it is only given out while both are in the active chain
+        if (cache.get(std::make_pair(baseBlockHash, blockHash), diffRet) && IsInActiveChain(baseBlockHash) && IsInActiveChain(blockHash)) {
+            return true;
+        }
+    }
+
+    diffRet = Build(baseBlockHash, blockHash, errorRet);
+    return diffRet != nullptr;
+}
+
+void CSimplifiedMNListDiffCache::UpdatedBlockTip(const CBlockIndex* pindexNew)
+{
+    const uint256 blockHash = pindexNew->GetBlockHash();
+
+    std::vector<uint256> vBaseBlockHashes{uint256()};
+    {
+        LOCK(cs);
+        vBaseBlockHashes.insert(vBaseBlockHashes.end(), recentTips.begin(), recentTips.end());
+        recentTips.emplace_front(blockHash);
+        if (recentTips.size() > MNLISTDIFF_CACHE_RECENT_TIPS) {
+            recentTips.pop_back();
+        }
+    }
+
+    for (const auto& baseBlockHash : vBaseBlockHashes) {
+        // cs_main is released in between so that the diffs don't hold up validation for long
+        LOCK(cs_main);
+        // Fails if the old tip was reorged away, which is expected
+        std::string strError;
+        Build(baseBlockHash, blockHash, strError);
+    }
+}
+
+static const std::string DB_SML_SNAPSHOT = "sml_S";
+
+static int GetSimplifiedMNListSnapshotInterval()
+{
+    return llmq::GetLLMQParams(Params().GetConsensus().llmqTypeChainLocks).dkgInterval;
+}
+
+// Big endian heights, so that snapshots are ordered by height in the db
+static std::pair<std::string, uint32_t> BuildSnapshotKey(int nHeight)
+{
+    return std::make_pair(DB_SML_SNAPSHOT, htobe32((uint32_t)nHeight));
+}
+
+void UpdateSimplifiedMNListSnapshots(const CBlockIndex* pindexNew)
+{
+    const int nInterval = GetSimplifiedMNListSnapshotInterval();
+    const int nHeight = pindexNew->nHeight - pindexNew->nHeight % nInterval;
+    if (nHeight <= 0) {
+        return;
+    }
+    const CBlockIndex* pindexSnapshot = pindexNew->GetAncestor(nHeight);
+
+    // Snapshots are derived data and keyed by height, so they're written directly instead of through the block
+    // transactions. After a reorg the snapshot of the other chain is simply replaced.
+    CDBWrapper& db = evoDb->GetRawDB();
+    std::pair<uint256, std::vector<unsigned char>> snapshot;
+    if (db.Read(BuildSnapshotKey(nHeight), snapshot) && snapshot.first == pindexSnapshot->GetBlockHash()) {
+        return;
+    }
+
+    CSimplifiedMNListDiffCache::DiffBytesPtr diff;
+    {
+        LOCK(cs_main);
+        std::string strError;
+        if (!mnListDiffCache.GetDiff(uint256(), pindexSnapshot->GetBlockHash(), diff, strError)) {
+            // The snapshot block was reorged away in the meantime, the next tip will try again
+            return;
+        }
+    }
+
+    CDBBatch batch(db);
+    batch.Write(BuildSnapshotKey(nHeight), std::make_pair(pindexSnapshot->GetBlockHash(), *diff));
+
+    const int nMinHeight = nHeight - (SML_SNAPSHOT_KEEP - 1) * nInterval;
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    for (it->Seek(BuildSnapshotKey(0)); it->Valid(); it->Next()) {
+        std::pair<std::string, uint32_t> key;
+        if (!it->GetKey(key) || key.first != DB_SML_SNAPSHOT || (int)be32toh(key.second) >= nMinHeight) {
+            break;
+        }
+        batch.Erase(key);
+    }
+    db.WriteBatch(batch);
+}
+
+bool GetSimplifiedMNListSnapshot(const CBlockIndex* pindex, const CBlockIndex*& pindexSnapshotRet, std::vector<unsigned char>& snapshotRet)
+{
+    const int nInterval = GetSimplifiedMNListSnapshotInterval();
+    int nHeight = pindex->nHeight - pindex->nHeight % nInterval;
+
+    CDBWrapper& db = evoDb->GetRawDB();
+    for (int i = 0; i < SML_SNAPSHOT_KEEP && nHeight > 0; i++, nHeight -= nInterval) {
+        const CBlockIndex* pindexSnapshot = pindex->GetAncestor(nHeight);
+        std::pair<uint256, std::vector<unsigned char>> snapshot;
+        if (db.Read(BuildSnapshotKey(nHeight), snapshot) && snapshot.first == pindexSnapshot->GetBlockHash()) {
+            pindexSnapshotRet = pindexSnapshot;
+            snapshotRet = std::move(snapshot.second);
+            return true;
+        }
+    }
+    return false;
+}
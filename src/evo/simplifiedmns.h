@@ -9,10 +9,17 @@
 #include <merkleblock.h>
 #include <netaddress.h>
 #include <pubkey.h>
+#include <saltedhasher.h>
 #include <serialize.h>
+#include <sync.h>
+#include <unordered_lru_cache.h>
 #include <version.h>
 
+#include <deque>
+#include <memory>
+
 class UniValue;
+class CBlockIndex;
 class CDeterministicMNList;
 class CDeterministicMN;
 
@@ -84,6 +91,35 @@ public:
     uint256 CalcMerkleRoot(bool* pmutated = nullptr) const;
 };
 
+/**
+ * Keeps all levels of the merkle tree of a simplified MN list, with the leaves sorted by proRegTxHash. This allows to
+ * update the merkle root without re-hashing all entries and inner nodes when only a few entries of the list changed.
+ * The resulting root and mutation flag are identical to CSimplifiedMNList::CalcMerkleRoot.
+ */
+class CSimplifiedMNListMerkleTree
+{
+private:
+    // sorted proRegTxHashes, one per leaf
+    std::vector<uint256> keys;
+    // levels[0] are the leaves (entry hashes), the last level holds the root
+    std::vector<std::vector<uint256>> levels;
+
+public:
+    CSimplifiedMNListMerkleTree();
+
+    void Build(const CSimplifiedMNList& sml);
+    // Sets (adds or replaces) the leaves in "updated" (proRegTxHash -> entry hash) and removes the leaves of "removed"
+    void Update(const std::vector<std::pair<uint256, uint256>>& updated, const std::vector<uint256>& removed);
+    void Clear();
+
+    size_t size() const { return keys.size(); }
+    uint256 GetRoot(bool* pmutated = nullptr) const;
+
+private:
+    // Recalculates all inner nodes above the leaves in "dirtyLeaves" and above all leaves starting at "dirtyFrom"
+    void RecalcLevels(std::set<size_t> dirtyLeaves, size_t dirtyFrom);
+};
+
 /// P2P messages
 
 class CGetSimplifiedMNListDiff
@@ -147,4 +183,46 @@ public:
 
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
 
+/**
+ * LRU cache of serialized diffs, most requests are for the diff of a recent tip or of the genesis block to the
+ * current tip. When the tip changes the diffs to it from the genesis block and the last MNLISTDIFF_CACHE_RECENT_TIPS
+ * tips are built ahead. Diffs are serialized with PROTOCOL_VERSION, which only works for peers which support
+ * LLMQS_PROTO_VERSION.
+ */
+class CSimplifiedMNListDiffCache
+{
+public:
+    static const size_t MNLISTDIFF_CACHE_SIZE = 64;
+    static const size_t MNLISTDIFF_CACHE_RECENT_TIPS = 8;
+
+    typedef std::shared_ptr<const std::vector<unsigned char>> DiffBytesPtr;
+
+private:
+    CCriticalSection cs;
+    unordered_lru_cache<std::pair<uint256, uint256>, DiffBytesPtr, StaticSaltedHasher, MNLISTDIFF_CACHE_SIZE> cache GUARDED_BY(cs);
+    std::deque<uint256> recentTips GUARDED_BY(cs);
+
+    DiffBytesPtr Build(const uint256& baseBlockHash, const uint256& blockHash, std::string& errorRet);
+
+public:
+    /** Same as BuildSimplifiedMNListDiff(), but serialized and from the cache if possible */
+    bool GetDiff(const uint256& baseBlockHash, const uint256& blockHash, DiffBytesPtr& diffRet, std::string& errorRet);
+
+    void UpdatedBlockTip(const CBlockIndex* pindexNew);
+};
+
+extern CSimplifiedMNListDiffCache mnListDiffCache;
+
+//! Number of simplified masternode list snapshots kept in the evo db, one is stored per ChainLocks DKG interval
+static const int SML_SNAPSHOT_KEEP = 7;
+
+/**
+ * Store the snapshot of the last snapshot height at or below pindexNew, if it isn't stored yet, and prune snapshots
+ * which are too old. A snapshot is the serialized diff from the genesis block to its block.
+ */
+void UpdateSimplifiedMNListSnapshots(const CBlockIndex* pindexNew);
+
+/** Get the newest stored snapshot of the chain of pindex at or below pindex */
+bool GetSimplifiedMNListSnapshot(const CBlockIndex* pindex, const CBlockIndex*& pindexSnapshotRet, std::vector<unsigned char>& snapshotRet);
+
 #endif // BITCOIN_EVO_SIMPLIFIEDMNS_H
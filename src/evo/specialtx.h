@@ -9,13 +9,20 @@
 #include <streams.h>
 #include <version.h>
 
+#include <functional>
+
 class CBlock;
 class CBlockIndex;
 class CCoinsViewCache;
 class CValidationState;
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view);
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck, bool fCheckCbTxMerleRoots);
+// A deferred payload signature check of a special TX. Returns false if the signature is invalid.
+// When a vector of these is passed to the Check*/Process* functions, the (expensive) signature checks are not performed
+// inline but added to the vector, so that the caller can run them in parallel, e.g. on the script check queue.
+typedef std::function<bool()> CSpecialTxSigCheck;
+
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, std::vector<CSpecialTxSigCheck>* pvSigChecks = nullptr);
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck, bool fCheckCbTxMerleRoots, std::vector<CSpecialTxSigCheck>* pvSigChecks = nullptr);
 bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex);
 
 template <typename T>
@@ -0,0 +1,95 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_EXPIRYQUEUE_H
+#define BITCOIN_EXPIRYQUEUE_H
+
+#include <memusage.h>
+
+#include <map>
+#include <vector>
+
+/**
+ * Keys ordered by their expiry time, for maps which would otherwise be scanned completely to find expired entries.
+ *
+ * The owner keeps its data in its own container and schedules the key of every entry here. (Re)scheduling and erasing
+ * a key is O(log n) and popping the expired keys is O(expired * log n), independent of the number of pending keys.
+ */
+template<typename Key>
+class expiry_queue
+{
+private:
+    typedef std::multimap<int64_t, Key> QueueType;
+    typedef std::map<Key, typename QueueType::iterator> IndexType;
+
+    QueueType queue;
+    IndexType index;
+
+public:
+    size_t size() const { return index.size(); }
+    bool empty() const { return index.empty(); }
+
+    /** Schedule key to expire at nExpiry, replacing a previously scheduled time */
+    void schedule(const Key& key, int64_t nExpiry)
+    {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            if (it->second->first == nExpiry) {
+                return;
+            }
+            queue.erase(it->second);
+            it->second = queue.emplace(nExpiry, key);
+        } else {
+            index.emplace(key, queue.emplace(nExpiry, key));
+        }
+    }
+
+    bool erase(const Key& key)
+    {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        queue.erase(it->second);
+        index.erase(it);
+        return true;
+    }
+
+    bool get(const Key& key, int64_t& nExpiryRet) const
+    {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        nExpiryRet = it->second->first;
+        return true;
+    }
+
+    /** Remove and return all keys which expire at or before nTime, in order of their expiry */
+    std::vector<Key> pop_expired(int64_t nTime)
+    {
+        std::vector<Key> vecExpired;
+        while (!queue.empty() && queue.begin()->first <= nTime) {
+            auto it = queue.begin();
+            vecExpired.emplace_back(std::move(it->second));
+            index.erase(vecExpired.back());
+            queue.erase(it);
+        }
+        return vecExpired;
+    }
+
+    void clear()
+    {
+        queue.clear();
+        index.clear();
+    }
+
+    size_t DynamicUsage() const
+    {
+        return memusage::MallocUsage(sizeof(memusage::stl_tree_node<typename QueueType::value_type>)) * queue.size() +
+               memusage::DynamicUsage(index);
+    }
+};
+
+#endif // BITCOIN_EXPIRYQUEUE_H
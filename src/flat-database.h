@@ -43,7 +43,7 @@ private:
         int64_t nStart = GetTimeMillis();
 
         // serialize, checksum data up to that point, then append checksum
-        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssObj(SER_DISK, CLIENT_VERSION);
         ssObj << strMagicMessage; // specific magic message for this type of object
         ssObj << Params().MessageStart(); // network specific magic number
         ssObj << objToSave;
@@ -106,7 +106,7 @@ private:
         }
         filein.fclose();
 
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
+        CPublicDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
 
         // verify stored checksum matches input data
         uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
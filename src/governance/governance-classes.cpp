@@ -4,6 +4,7 @@
 
 #include <governance/governance-classes.h>
 #include <core_io.h>
+#include <evo/deterministicmns.h>
 #include <init.h>
 #include <utilstrencodings.h>
 #include <validation.h>
@@ -90,6 +91,47 @@ CAmount ParsePaymentAmount(const std::string& strAmount)
     return nAmount;
 }
 
+/**
+*   Superblock Cache
+*
+*   - Results of CSuperblockManager for a superblock height, valid as long as the trigger manager version is unchanged
+*   - Whether the superblock is triggered also depends on the valid masternode count, which is stored with the result
+*/
+
+struct CSuperblockCacheEntry {
+    bool fHaveBest{false};
+    CSuperblock_sptr pBestSuperblock;
+    bool fHavePayments{false};
+    std::vector<CTxOut> voutPayments;
+    int nTriggeredMnCount{-1};
+    bool fTriggered{false};
+};
+
+static const size_t MAX_SUPERBLOCK_CACHE_SIZE = 8;
+static uint64_t nSuperblockCacheVersion GUARDED_BY(governance.cs) = 0;
+static std::map<int, CSuperblockCacheEntry> mapSuperblockCache GUARDED_BY(governance.cs);
+
+static CSuperblockCacheEntry& GetSuperblockCacheEntry(int nBlockHeight)
+{
+    AssertLockHeld(governance.cs);
+
+    uint64_t nVersion = triggerman.GetVersion();
+    if (nVersion != nSuperblockCacheVersion) {
+        mapSuperblockCache.clear();
+        nSuperblockCacheVersion = nVersion;
+    }
+
+    auto it = mapSuperblockCache.find(nBlockHeight);
+    if (it != mapSuperblockCache.end()) {
+        return it->second;
+    }
+    if (mapSuperblockCache.size() >= MAX_SUPERBLOCK_CACHE_SIZE) {
+        // heights only move forward, so the lowest one is the least likely to be queried again
+        mapSuperblockCache.erase(mapSuperblockCache.begin());
+    }
+    return mapSuperblockCache[nBlockHeight];
+}
+
 /**
 *   Add Governance Object
 */
@@ -120,6 +162,7 @@ bool CGovernanceTriggerManager::AddNewTrigger(uint256 nHash)
     pSuperblock->SetStatus(SEEN_OBJECT_IS_VALID);
 
     mapTrigger.insert(std::make_pair(nHash, pSuperblock));
+    SetDirty();
 
     return true;
 }
@@ -130,10 +173,12 @@ bool CGovernanceTriggerManager::AddNewTrigger(uint256 nHash)
 *
 */
 
-void CGovernanceTriggerManager::CleanAndRemove()
+std::vector<uint256> CGovernanceTriggerManager::CleanAndRemove()
 {
     AssertLockHeld(governance.cs);
 
+    std::vector<uint256> vecChangedHashes;
+
     // Remove triggers that are invalid or expired
     LogPrint(BCLog::GOBJECT, "CGovernanceTriggerManager::CleanAndRemove -- mapTrigger.size() = %d\n", mapTrigger.size());
 
@@ -181,14 +226,18 @@ void CGovernanceTriggerManager::CleanAndRemove()
                 strDataAsPlainString = pObj->GetDataAsPlainString();
                 // mark corresponding object for deletion
                 pObj->PrepareDeletion(GetAdjustedTime());
+                vecChangedHashes.emplace_back(it->first);
             }
             LogPrint(BCLog::GOBJECT, "CGovernanceTriggerManager::CleanAndRemove -- Removing trigger object %s\n", strDataAsPlainString);
             // delete the trigger
             mapTrigger.erase(it++);
+            SetDirty();
         } else {
             ++it;
         }
     }
+
+    return vecChangedHashes;
 }
 
 /**
@@ -228,11 +277,21 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
     }
 
     LOCK(governance.cs);
+
+    // The funding flags are relative to the number of valid masternodes, without any there is nothing to cache
+    int nMnCount = (int)deterministicMNManager->GetListAtChainTip().GetValidMNsCount();
+    CSuperblockCacheEntry& cacheEntry = GetSuperblockCacheEntry(nBlockHeight);
+    if (nMnCount != 0 && cacheEntry.nTriggeredMnCount == nMnCount) {
+        return cacheEntry.fTriggered;
+    }
+
     // GET ALL ACTIVE TRIGGERS
     std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
 
     LogPrint(BCLog::GOBJECT, "CSuperblockManager::IsSuperblockTriggered -- vecTriggers.size() = %d\n", vecTriggers.size());
 
+    bool fTriggered = false;
+
     for (const auto& pSuperblock : vecTriggers) {
         if (!pSuperblock) {
             LogPrintf("CSuperblockManager::IsSuperblockTriggered -- Non-superblock found, continuing\n");
@@ -263,13 +322,18 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
 
         if (pObj->IsSetCachedFunding()) {
             LogPrint(BCLog::GOBJECT, "CSuperblockManager::IsSuperblockTriggered -- fCacheFunding = true, returning true\n");
-            return true;
+            fTriggered = true;
+            break;
         } else {
             LogPrint(BCLog::GOBJECT, "CSuperblockManager::IsSuperblockTriggered -- fCacheFunding = false, continuing\n");
         }
     }
 
-    return false;
+    if (nMnCount != 0) {
+        cacheEntry.nTriggeredMnCount = nMnCount;
+        cacheEntry.fTriggered = fTriggered;
+    }
+    return fTriggered;
 }
 
 
@@ -280,8 +344,18 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
     }
 
     AssertLockHeld(governance.cs);
+    CSuperblockCacheEntry& cacheEntry = GetSuperblockCacheEntry(nBlockHeight);
+    if (cacheEntry.fHaveBest) {
+        if (!cacheEntry.pBestSuperblock) {
+            return false;
+        }
+        pSuperblockRet = cacheEntry.pBestSuperblock;
+        return true;
+    }
+
     std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
     int nYesCount = 0;
+    CSuperblock_sptr pBestSuperblock;
 
     for (const auto& pSuperblock : vecTriggers) {
         if (!pSuperblock || nBlockHeight != pSuperblock->GetBlockHeight()) {
@@ -299,11 +373,17 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
         int nTempYesCount = pObj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING);
         if (nTempYesCount > nYesCount) {
             nYesCount = nTempYesCount;
-            pSuperblockRet = pSuperblock;
+            pBestSuperblock = pSuperblock;
         }
     }
 
-    return nYesCount > 0;
+    cacheEntry.fHaveBest = true;
+    cacheEntry.pBestSuperblock = pBestSuperblock;
+    if (!pBestSuperblock) {
+        return false;
+    }
+    pSuperblockRet = pBestSuperblock;
+    return true;
 }
 
 /**
@@ -324,6 +404,12 @@ bool CSuperblockManager::GetSuperblockPayments(int nBlockHeight, std::vector<CTx
         return false;
     }
 
+    CSuperblockCacheEntry& cacheEntry = GetSuperblockCacheEntry(nBlockHeight);
+    if (cacheEntry.fHavePayments) {
+        voutSuperblockRet = cacheEntry.voutPayments;
+        return true;
+    }
+
     // make sure it's empty, just in case
     voutSuperblockRet.clear();
 
@@ -357,6 +443,8 @@ bool CSuperblockManager::GetSuperblockPayments(int nBlockHeight, std::vector<CTx
         }
     }
 
+    cacheEntry.fHavePayments = true;
+    cacheEntry.voutPayments = voutSuperblockRet;
     return true;
 }
 
@@ -10,6 +10,8 @@
 #include <script/standard.h>
 #include <util.h>
 
+#include <atomic>
+
 class CSuperblock;
 class CGovernanceTriggerManager;
 class CSuperblockManager;
@@ -33,20 +35,30 @@ class CGovernanceTriggerManager
 
 private:
     std::map<uint256, CSuperblock_sptr> mapTrigger;
+    // Incremented whenever the triggers or their funding votes change, see CSuperblockManager
+    std::atomic<uint64_t> nVersion{0};
 
     std::vector<CSuperblock_sptr> GetActiveTriggers();
     bool AddNewTrigger(uint256 nHash);
-    void CleanAndRemove();
+    /// Returns the hashes of the objects which were marked for deletion or as expired
+    std::vector<uint256> CleanAndRemove();
 
 public:
     CGovernanceTriggerManager() :
         mapTrigger() {}
+
+    /// Invalidates the cached superblocks of CSuperblockManager
+    void SetDirty() { ++nVersion; }
+    uint64_t GetVersion() const { return nVersion; }
 };
 
 /**
 *   Superblock Manager
 *
 *   Class for querying superblock information
+*
+*   The best trigger and the payments of a superblock height are cached until the triggers or their funding votes
+*   change, as they are queried for every block template and block check around superblock heights.
 */
 
 class CSuperblockManager
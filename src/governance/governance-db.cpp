@@ -0,0 +1,147 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-db.h>
+
+#include <clientversion.h>
+#include <hash.h>
+#include <util.h>
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+const std::string CGovernanceDb::DB_OBJECT = "gov_o";
+const std::string CGovernanceDb::DB_VOTE = "gov_v";
+const std::string CGovernanceDb::DB_STATE = "gov_s";
+const std::string CGovernanceDb::DB_VERSION = "gov_version";
+
+static const uint32_t CURRENT_VERSION = 1;
+
+CGovernanceDb::CGovernanceDb(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(fMemory ? "" : (GetDataDir() / "governance"), nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CGovernanceDb::HasVersion() const
+{
+    uint32_t nVersion;
+    return Read(DB_VERSION, nVersion) && nVersion == CURRENT_VERSION;
+}
+
+void CGovernanceDb::WriteVersion(CDBBatch& batch) const
+{
+    batch.Write(DB_VERSION, CURRENT_VERSION);
+}
+
+void CGovernanceDb::WriteObject(CDBBatch& batch, const CGovernanceObject& govobj) const
+{
+    batch.Write(std::make_pair(DB_OBJECT, govobj.GetHash()), CGovernanceObject::DiskRecordWithoutVotes(govobj));
+}
+
+void CGovernanceDb::EraseObject(CDBBatch& batch, const uint256& nHash)
+{
+    batch.Erase(std::make_pair(DB_OBJECT, nHash));
+    for (const auto& nVoteHash : GetVoteHashes(nHash)) {
+        EraseVote(batch, nHash, nVoteHash);
+    }
+}
+
+void CGovernanceDb::WriteVote(CDBBatch& batch, const CGovernanceVote& vote) const
+{
+    batch.Write(std::make_tuple(DB_VOTE, vote.GetParentHash(), vote.GetHash()), vote);
+}
+
+void CGovernanceDb::EraseVote(CDBBatch& batch, const uint256& nParentHash, const uint256& nVoteHash) const
+{
+    batch.Erase(std::make_tuple(DB_VOTE, nParentHash, nVoteHash));
+}
+
+std::set<uint256> CGovernanceDb::GetVoteHashes(const uint256& nParentHash)
+{
+    std::set<uint256> setVoteHashes;
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_tuple(DB_VOTE, nParentHash, uint256()));
+    while (pcursor->Valid()) {
+        std::tuple<std::string, uint256, uint256> key;
+        if (!pcursor->GetKey(key) || std::get<0>(key) != DB_VOTE || std::get<1>(key) != nParentHash) {
+            break;
+        }
+        setVoteHashes.emplace(std::get<2>(key));
+        pcursor->Next();
+    }
+
+    return setVoteHashes;
+}
+
+void CGovernanceDb::ReadObjects(std::map<uint256, CGovernanceObject>& mapObjects, std::map<uint256, uint256>& mapRecordHashes)
+{
+    CDBBatch batch(*this);
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_OBJECT, uint256()));
+    while (pcursor->Valid()) {
+        std::pair<std::string, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_OBJECT) {
+            break;
+        }
+        CGovernanceObject& govobj = mapObjects[key.second];
+        CGovernanceObject::DiskRecordWithoutVotes record(govobj);
+        if (pcursor->GetValue(record) && govobj.GetHash() == key.second) {
+            mapRecordHashes.emplace(key.second, GetRecordHash(govobj));
+        } else {
+            LogPrintf("CGovernanceDb::%s -- failed to read governance object %s, dropping it\n", __func__, key.second.ToString());
+            mapObjects.erase(key.second);
+            batch.Erase(key);
+        }
+        pcursor->Next();
+    }
+
+    // Votes are sorted by the hash of their object, so all votes of an object are read in one go. Older votes
+    // of the same masternode and signal are only dropped when a newer one is added, so they are added in
+    // timestamp order
+    std::multimap<int64_t, CGovernanceVote> mapVotesByTime;
+    auto addVotes = [&](const uint256& nParentHash) {
+        auto it = mapObjects.find(nParentHash);
+        for (const auto& p : mapVotesByTime) {
+            if (it == mapObjects.end()) {
+                EraseVote(batch, nParentHash, p.second.GetHash());
+            } else {
+                it->second.LoadVote(p.second);
+            }
+        }
+        mapVotesByTime.clear();
+    };
+
+    uint256 nCurrentParentHash;
+    pcursor->Seek(std::make_tuple(DB_VOTE, uint256(), uint256()));
+    while (pcursor->Valid()) {
+        std::tuple<std::string, uint256, uint256> key;
+        if (!pcursor->GetKey(key) || std::get<0>(key) != DB_VOTE) {
+            break;
+        }
+        if (std::get<1>(key) != nCurrentParentHash) {
+            addVotes(nCurrentParentHash);
+            nCurrentParentHash = std::get<1>(key);
+        }
+        CGovernanceVote vote;
+        if (pcursor->GetValue(vote) && vote.GetHash() == std::get<2>(key)) {
+            mapVotesByTime.emplace(vote.GetTimestamp(), vote);
+        } else {
+            batch.Erase(key);
+        }
+        pcursor->Next();
+    }
+    addVotes(nCurrentParentHash);
+
+    WriteBatch(batch);
+}
+
+uint256 CGovernanceDb::GetRecordHash(const CGovernanceObject& govobj)
+{
+    CHashWriter hw(SER_DISK, CLIENT_VERSION);
+    hw << CGovernanceObject::DiskRecordWithoutVotes(govobj);
+    return hw.GetHash();
+}
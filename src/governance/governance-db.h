@@ -0,0 +1,73 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
+#define BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
+
+#include <dbwrapper.h>
+#include <governance/governance-object.h>
+#include <governance/governance-vote.h>
+#include <uint256.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+/**
+ * Access to the governance database (governance/)
+ *
+ * Every governance object is stored as its own record without its votes ("gov_o" keys), the votes
+ * are stored one by one below the hash of their object ("gov_v" keys). This allows writing votes
+ * as soon as they are accepted and only rewriting the objects which changed. The state of the
+ * governance manager which is not related to a single object is stored in a single record.
+ */
+class CGovernanceDb : public CDBWrapper
+{
+public:
+    static const std::string DB_OBJECT;
+    static const std::string DB_VOTE;
+    static const std::string DB_STATE;
+    static const std::string DB_VERSION;
+
+    explicit CGovernanceDb(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CGovernanceDb(const CGovernanceDb&) = delete;
+    CGovernanceDb& operator=(const CGovernanceDb&) = delete;
+
+    /** Whether the db was written completely at least once */
+    bool HasVersion() const;
+    void WriteVersion(CDBBatch& batch) const;
+
+    template <typename T>
+    bool ReadState(T& state) const
+    {
+        return Read(DB_STATE, state);
+    }
+
+    template <typename T>
+    void WriteState(CDBBatch& batch, const T& state) const
+    {
+        batch.Write(DB_STATE, state);
+    }
+
+    void WriteObject(CDBBatch& batch, const CGovernanceObject& govobj) const;
+    /** Erase an object together with all of its votes */
+    void EraseObject(CDBBatch& batch, const uint256& nHash);
+
+    void WriteVote(CDBBatch& batch, const CGovernanceVote& vote) const;
+    void EraseVote(CDBBatch& batch, const uint256& nParentHash, const uint256& nVoteHash) const;
+    std::set<uint256> GetVoteHashes(const uint256& nParentHash);
+
+    /**
+     * Read all objects and add their votes in timestamp order. mapRecordHashes receives the hash
+     * of each object record as it was stored, see GetRecordHash(). Votes without an object are
+     * erased.
+     */
+    void ReadObjects(std::map<uint256, CGovernanceObject>& mapObjects, std::map<uint256, uint256>& mapRecordHashes);
+
+    /** Hash of the stored record of an object, used to detect objects which need to be rewritten */
+    static uint256 GetRecordHash(const CGovernanceObject& govobj);
+};
+
+#endif // BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
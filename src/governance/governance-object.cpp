@@ -4,10 +4,12 @@
 
 #include <governance/governance-object.h>
 #include <core_io.h>
+#include <governance/governance-classes.h>
 #include <governance/governance-validators.h>
 #include <governance/governance.h>
 #include <masternode/masternode-meta.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <messagesigner.h>
 #include <spork.h>
 #include <validation.h>
@@ -36,6 +38,7 @@ CGovernanceObject::CGovernanceObject() :
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    arrVoteTally(),
     fileVotes()
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
@@ -63,6 +66,7 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    arrVoteTally(),
     fileVotes()
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
@@ -90,6 +94,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
     fExpired(other.fExpired),
     fUnparsable(other.fUnparsable),
     mapCurrentMNVotes(other.mapCurrentMNVotes),
+    arrVoteTally(other.arrVoteTally),
     fileVotes(other.fileVotes)
 {
 }
@@ -97,7 +102,8 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
     const CGovernanceVote& vote,
     CGovernanceException& exception,
-    CConnman& connman)
+    CConnman& connman,
+    bool fSignatureChecked)
 {
     LOCK(cs);
 
@@ -138,8 +144,11 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR, 20);
         return false;
     }
-    auto it2 = voteRecordRef.mapInstances.emplace(vote_instance_m_t::value_type(int(eSignal), vote_instance_t())).first;
-    vote_instance_t& voteInstanceRef = it2->second;
+    auto ret = voteRecordRef.mapInstances.emplace(vote_instance_m_t::value_type(int(eSignal), vote_instance_t()));
+    if (ret.second) {
+        UpdateVoteTally(eSignal, VOTE_OUTCOME_NONE, 1);
+    }
+    vote_instance_t& voteInstanceRef = ret.first->second;
 
     // Reject obsolete votes
     if (vote.GetTimestamp() < voteInstanceRef.nCreationTime) {
@@ -185,7 +194,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     bool onlyVotingKeyAllowed = nObjectType == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
     // Finally check that the vote is actually valid (done last because of cost of signature verification)
-    if (!vote.IsValid(onlyVotingKeyAllowed)) {
+    if (!vote.IsValid(onlyVotingKeyAllowed, !fSignatureChecked)) {
         std::ostringstream ostr;
         ostr << "CGovernanceObject::ProcessVote -- Invalid vote"
              << ", MN outpoint = " << vote.GetMasternodeOutpoint().ToStringShort()
@@ -207,6 +216,8 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         return false;
     }
 
+    UpdateVoteTally(eSignal, voteInstanceRef.eOutcome, -1);
+    UpdateVoteTally(eSignal, vote.GetOutcome(), 1);
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     fileVotes.AddVote(vote);
     fDirtyCache = true;
@@ -215,6 +226,28 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     return true;
 }
 
+void CGovernanceObject::LoadVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+
+    fileVotes.AddVote(vote);
+    if (!fileVotes.HasVote(vote.GetHash())) {
+        return;
+    }
+
+    auto ret = mapCurrentMNVotes[vote.GetMasternodeOutpoint()].mapInstances.emplace(int(vote.GetSignal()), vote_instance_t());
+    if (ret.second) {
+        UpdateVoteTally(vote.GetSignal(), VOTE_OUTCOME_NONE, 1);
+    }
+    vote_instance_t& voteInstanceRef = ret.first->second;
+    if (vote.GetTimestamp() > voteInstanceRef.nCreationTime) {
+        UpdateVoteTally(vote.GetSignal(), voteInstanceRef.eOutcome, -1);
+        UpdateVoteTally(vote.GetSignal(), vote.GetOutcome(), 1);
+        voteInstanceRef = vote_instance_t(vote.GetOutcome(), vote.GetTimestamp(), vote.GetTimestamp());
+        fDirtyCache = true;
+    }
+}
+
 void CGovernanceObject::ClearMasternodeVotes()
 {
     LOCK(cs);
@@ -225,6 +258,7 @@ void CGovernanceObject::ClearMasternodeVotes()
     while (it != mapCurrentMNVotes.end()) {
         if (!mnList.HasMNByCollateral(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
+            RemoveFromVoteTally(it->second);
             mapCurrentMNVotes.erase(it++);
             fDirtyCache = true;
         } else {
@@ -253,6 +287,7 @@ std::set<uint256> CGovernanceObject::RemoveInvalidVotes(const COutPoint& mnOutpo
         CGovernanceVote tmpVote(mnOutpoint, nParentHash, (vote_signal_enum_t)jt->first, jt->second.eOutcome);
         tmpVote.SetTime(jt->second.nCreationTime);
         if (removedVotes.count(tmpVote.GetHash())) {
+            UpdateVoteTally(jt->first, jt->second.eOutcome, -1);
             jt = it->second.mapInstances.erase(jt);
         } else {
             ++jt;
@@ -326,6 +361,17 @@ bool CGovernanceObject::CheckSignature(const CBLSPublicKey& pubKey) const
 
    Returns an empty object on error.
  */
+size_t CGovernanceObject::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t usage = memusage::DynamicUsage(vchData) + memusage::DynamicUsage(vchSig) + memusage::DynamicUsage(mapCurrentMNVotes);
+    for (const auto& p : mapCurrentMNVotes) {
+        usage += memusage::DynamicUsage(p.second.mapInstances);
+    }
+    return usage + fileVotes.DynamicMemoryUsage();
+}
+
 UniValue CGovernanceObject::GetJSONObject()
 {
     UniValue obj(UniValue::VOBJ);
@@ -610,15 +656,42 @@ int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote
 {
     LOCK(cs);
 
-    int nCount = 0;
+    if (eVoteSignalIn < 0 || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL || eVoteOutcomeIn < 0 || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN) {
+        return 0;
+    }
+    return arrVoteTally[eVoteSignalIn][eVoteOutcomeIn];
+}
+
+void CGovernanceObject::UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    AssertLockHeld(cs);
+    // votes with unsupported signals or outcomes are never accepted, so they can't be counted for
+    if (nSignal < 0 || nSignal > MAX_SUPPORTED_VOTE_SIGNAL || eOutcome < 0 || eOutcome > VOTE_OUTCOME_ABSTAIN) {
+        return;
+    }
+    arrVoteTally[nSignal][eOutcome] += nDelta;
+    if (nObjectType == GOVERNANCE_OBJECT_TRIGGER && nSignal == VOTE_SIGNAL_FUNDING) {
+        // the best trigger of a superblock height is the one with the most funding votes
+        triggerman.SetDirty();
+    }
+}
+
+void CGovernanceObject::RemoveFromVoteTally(const vote_rec_t& voteRecord)
+{
+    for (const auto& p : voteRecord.mapInstances) {
+        UpdateVoteTally(p.first, p.second.eOutcome, -1);
+    }
+}
+
+void CGovernanceObject::RebuildVoteTally()
+{
+    LOCK(cs);
+    arrVoteTally = {};
     for (const auto& votepair : mapCurrentMNVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        auto it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if (it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
+        for (const auto& p : votepair.second.mapInstances) {
+            UpdateVoteTally(p.first, p.second.eOutcome, 1);
         }
     }
-    return nCount;
 }
 
 /**
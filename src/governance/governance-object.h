@@ -18,6 +18,8 @@
 
 #include <univalue.h>
 
+#include <array>
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -161,6 +163,9 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Number of entries in mapCurrentMNVotes per signal and outcome, updated together with mapCurrentMNVotes
+    std::array<std::array<int, VOTE_OUTCOME_ABSTAIN + 1>, MAX_SUPPORTED_VOTE_SIGNAL + 1> arrVoteTally;
+
     CGovernanceObjectVoteFile fileVotes;
 
 public:
@@ -237,6 +242,9 @@ public:
         return fileVotes;
     }
 
+    // Memory owned by the object, including its votes
+    size_t DynamicMemoryUsage() const;
+
     // Signature related functions
 
     void SetMasternodeOutpoint(const COutPoint& outpoint);
@@ -297,6 +305,36 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        SerializationOpBase(s, ser_action, true);
+    }
+
+    /**
+     * Serializes the disk state of an object except for its vote file. The governance db
+     * stores the votes of an object one by one, so that they can be written on acceptance.
+     */
+    class DiskRecordWithoutVotes
+    {
+    private:
+        CGovernanceObject& obj;
+
+    public:
+        explicit DiskRecordWithoutVotes(const CGovernanceObject& objIn) :
+            obj(const_cast<CGovernanceObject&>(objIn))
+        {
+        }
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            obj.SerializationOpBase(s, ser_action, false);
+        }
+    };
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOpBase(Stream& s, Operation ser_action, bool fIncludeVoteFile)
     {
         // SERIALIZE DATA FOR SAVING/LOADING OR NETWORK FUNCTIONS
         READWRITE(nHashParent);
@@ -315,8 +353,13 @@ public:
             READWRITE(nDeletionTime);
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
-            READWRITE(fileVotes);
-            LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            if (ser_action.ForRead()) {
+                RebuildVoteTally();
+            }
+            if (fIncludeVoteFile) {
+                READWRITE(fileVotes);
+                LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            }
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
@@ -331,7 +374,15 @@ public:
     bool ProcessVote(CNode* pfrom,
         const CGovernanceVote& vote,
         CGovernanceException& exception,
-        CConnman& connman);
+        CConnman& connman,
+        bool fSignatureChecked = false);
+
+    /**
+     * Add a vote read back from the governance db. Votes must be passed in ascending timestamp order.
+     * A vote which was accepted after the object itself was last written also updates the current
+     * vote of its masternode.
+     */
+    void LoadVote(const CGovernanceVote& vote);
 
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
@@ -341,6 +392,11 @@ public:
     // also for MNs that were removed from the list completely.
     // Returns deleted vote hashes.
     std::set<uint256> RemoveInvalidVotes(const COutPoint& mnOutpoint);
+
+private:
+    void UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+    void RemoveFromVoteTally(const vote_rec_t& voteRecord);
+    void RebuildVoteTally();
 };
 
 
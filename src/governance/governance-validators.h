@@ -22,6 +22,8 @@ public:
 
     bool Validate(bool fCheckExpiration = true);
 
+    bool GetEndEpoch(int64_t& nEndEpochRet) { return GetDataValue("end_epoch", nEndEpochRet); }
+
     const std::string& GetErrorMessages()
     {
         return strErrorMessages;
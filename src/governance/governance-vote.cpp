@@ -5,6 +5,7 @@
 #include <governance/governance-vote.h>
 #include <governance/governance-object.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <messagesigner.h>
 #include <util.h>
 
@@ -149,6 +150,11 @@ void CGovernanceVote::UpdateHash() const
     *const_cast<uint256*>(&hash) = ss.GetHash();
 }
 
+size_t CGovernanceVote::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(vchSig);
+}
+
 uint256 CGovernanceVote::GetHash() const
 {
     return hash;
@@ -241,7 +247,7 @@ bool CGovernanceVote::CheckSignature(const CBLSPublicKey& pubKey) const
     return true;
 }
 
-bool CGovernanceVote::IsValid(bool useVotingKey) const
+bool CGovernanceVote::IsValid(bool useVotingKey, bool fCheckSignature) const
 {
     if (nTime > GetAdjustedTime() + (60 * 60)) {
         LogPrint(BCLog::GOBJECT, "CGovernanceVote::IsValid -- vote is too far ahead of current time - %s - nTime %lli - Max Time %lli\n", GetHash().ToString(), nTime, GetAdjustedTime() + (60 * 60));
@@ -266,6 +272,10 @@ bool CGovernanceVote::IsValid(bool useVotingKey) const
         return false;
     }
 
+    if (!fCheckSignature) {
+        return true;
+    }
+
     if (useVotingKey) {
         return CheckSignature(dmn->pdmnState->keyIDVoting);
     } else {
@@ -94,12 +94,14 @@ public:
     }
 
     void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
+    const std::vector<unsigned char>& GetSignature() const { return vchSig; }
 
     bool Sign(const CKey& key, const CKeyID& keyID);
     bool CheckSignature(const CKeyID& keyID) const;
     bool Sign(const CBLSSecretKey& key);
     bool CheckSignature(const CBLSPublicKey& pubKey) const;
-    bool IsValid(bool useVotingKey) const;
+    /** With fCheckSignature = false, the signature must have been verified by the caller already */
+    bool IsValid(bool useVotingKey, bool fCheckSignature = true) const;
     void Relay(CConnman& connman) const;
 
     const COutPoint& GetMasternodeOutpoint() const { return masternodeOutpoint; }
@@ -115,6 +117,8 @@ public:
 
     std::string ToString() const;
 
+    size_t DynamicMemoryUsage() const;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -4,6 +4,8 @@
 
 #include <governance/governance-votedb.h>
 
+#include <memusage.h>
+
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
     nMemoryVotes(0),
     listVotes(),
@@ -46,6 +48,15 @@ bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDat
     return true;
 }
 
+size_t CGovernanceObjectVoteFile::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(listVotes) + memusage::DynamicUsage(mapVoteIndex);
+    for (const auto& vote : listVotes) {
+        usage += vote.DynamicMemoryUsage();
+    }
+    return usage;
+}
+
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
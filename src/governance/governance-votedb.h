@@ -62,6 +62,8 @@ public:
 
     std::vector<CGovernanceVote> GetVotes() const;
 
+    size_t DynamicMemoryUsage() const;
+
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
     std::set<uint256> RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal);
 
@@ -0,0 +1,110 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-votesketch.h>
+
+#include <hash.h>
+
+#include <algorithm>
+
+CGovernanceVoteSketch::CGovernanceVoteSketch(size_t nCapacity, uint64_t nSaltIn) :
+    nSalt(nSaltIn)
+{
+    // ~1.5 cells per difference make decoding succeed with high probability, small sketches need a bit more
+    size_t nCellsPerHash = std::max<size_t>(8, (nCapacity * 3 / 2 + NUM_HASHES - 1) / NUM_HASHES);
+    vecCells.resize(std::min(MAX_CELLS, nCellsPerHash * NUM_HASHES));
+}
+
+CGovernanceVoteSketch CGovernanceVoteSketch::CreateMatching(const CGovernanceVoteSketch& other)
+{
+    CGovernanceVoteSketch sketch;
+    sketch.nSalt = other.nSalt;
+    sketch.vecCells.resize(other.vecCells.size());
+    return sketch;
+}
+
+bool CGovernanceVoteSketch::IsValid() const
+{
+    return !vecCells.empty() && vecCells.size() <= MAX_CELLS && vecCells.size() % NUM_HASHES == 0;
+}
+
+size_t CGovernanceVoteSketch::GetCellIndex(const uint256& hash, int nHashNum) const
+{
+    // every hash function maps into its own part of the table, so a key always ends up in NUM_HASHES distinct cells
+    size_t nCellsPerHash = vecCells.size() / NUM_HASHES;
+    return nHashNum * nCellsPerHash + SipHashUint256(nSalt, nHashNum, hash) % nCellsPerHash;
+}
+
+uint32_t CGovernanceVoteSketch::GetCheckSum(const uint256& hash) const
+{
+    return (uint32_t)SipHashUint256(nSalt, NUM_HASHES, hash);
+}
+
+void CGovernanceVoteSketch::Update(const uint256& hash, int nDelta)
+{
+    if (!IsValid()) return;
+    uint32_t nCheckSum = GetCheckSum(hash);
+    for (int i = 0; i < NUM_HASHES; i++) {
+        Cell& cell = vecCells[GetCellIndex(hash, i)];
+        cell.nCount += nDelta;
+        for (size_t j = 0; j < hash.size(); j++) {
+            cell.hashKeySum.begin()[j] ^= hash.begin()[j];
+        }
+        cell.nCheckSum ^= nCheckSum;
+    }
+}
+
+bool CGovernanceVoteSketch::Subtract(const CGovernanceVoteSketch& other)
+{
+    if (other.nSalt != nSalt || other.vecCells.size() != vecCells.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < vecCells.size(); i++) {
+        Cell& cell = vecCells[i];
+        const Cell& otherCell = other.vecCells[i];
+        cell.nCount -= otherCell.nCount;
+        for (size_t j = 0; j < cell.hashKeySum.size(); j++) {
+            cell.hashKeySum.begin()[j] ^= otherCell.hashKeySum.begin()[j];
+        }
+        cell.nCheckSum ^= otherCell.nCheckSum;
+    }
+    return true;
+}
+
+bool CGovernanceVoteSketch::Decode(std::vector<uint256>& vecExtra, std::vector<uint256>& vecMissing) const
+{
+    if (!IsValid()) return false;
+
+    CGovernanceVoteSketch sketch(*this);
+    auto isPure = [&](const Cell& cell) {
+        return (cell.nCount == 1 || cell.nCount == -1) && sketch.GetCheckSum(cell.hashKeySum) == cell.nCheckSum;
+    };
+
+    std::vector<size_t> vecPure;
+    for (size_t i = 0; i < sketch.vecCells.size(); i++) {
+        if (isPure(sketch.vecCells[i])) {
+            vecPure.emplace_back(i);
+        }
+    }
+
+    // peel off keys which are the only ones left in a cell until no such cell is left
+    while (!vecPure.empty()) {
+        const Cell& cell = sketch.vecCells[vecPure.back()];
+        vecPure.pop_back();
+        if (!isPure(cell)) continue;
+
+        const uint256 hash = cell.hashKeySum;
+        int nCount = cell.nCount;
+        (nCount > 0 ? vecExtra : vecMissing).emplace_back(hash);
+        sketch.Update(hash, -nCount);
+        for (int i = 0; i < NUM_HASHES; i++) {
+            size_t nIndex = sketch.GetCellIndex(hash, i);
+            if (isPure(sketch.vecCells[nIndex])) {
+                vecPure.emplace_back(nIndex);
+            }
+        }
+    }
+
+    return std::all_of(sketch.vecCells.begin(), sketch.vecCells.end(), [](const Cell& cell) { return cell.IsEmpty(); });
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_GOVERNANCE_GOVERNANCE_VOTESKETCH_H
+#define BITCOIN_GOVERNANCE_GOVERNANCE_VOTESKETCH_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <vector>
+
+/**
+ * Sketch of the set of vote hashes of a single governance object (an invertible bloom lookup table)
+ *
+ * A peer which wants to sync the votes of an object sends a sketch of the votes it already has.
+ * The other side subtracts a sketch of its own votes with the same size and salt and decodes the
+ * difference, which gives the votes the requesting peer is missing, as long as the difference is
+ * not much larger than the capacity the sketch was created with.
+ */
+class CGovernanceVoteSketch
+{
+public:
+    /** Number of cells every key is added to */
+    static const int NUM_HASHES = 4;
+    /** Sketches with more cells than this are rejected */
+    static const size_t MAX_CELLS = 4 * 4096;
+
+private:
+    struct Cell {
+        int32_t nCount{0};
+        uint256 hashKeySum;
+        uint32_t nCheckSum{0};
+
+        bool IsEmpty() const { return nCount == 0 && hashKeySum.IsNull() && nCheckSum == 0; }
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            READWRITE(nCount);
+            READWRITE(hashKeySum);
+            READWRITE(nCheckSum);
+        }
+    };
+
+    uint64_t nSalt{0};
+    std::vector<Cell> vecCells;
+
+    size_t GetCellIndex(const uint256& hash, int nHashNum) const;
+    uint32_t GetCheckSum(const uint256& hash) const;
+    void Update(const uint256& hash, int nDelta);
+
+public:
+    CGovernanceVoteSketch() = default;
+    /** Creates an empty sketch able to decode roughly nCapacity differences */
+    CGovernanceVoteSketch(size_t nCapacity, uint64_t nSaltIn);
+
+    /** Creates an empty sketch with the same size and salt as other */
+    static CGovernanceVoteSketch CreateMatching(const CGovernanceVoteSketch& other);
+
+    /** Whether the sketch can be used, i.e. has a sane number of cells */
+    bool IsValid() const;
+    size_t GetCellCount() const { return vecCells.size(); }
+
+    void Insert(const uint256& hash) { Update(hash, 1); }
+
+    /** Subtracts other (which must have the same size and salt) from this sketch */
+    bool Subtract(const CGovernanceVoteSketch& other);
+
+    /**
+     * Decodes the sketch, which usually is the difference of two sketches. Hashes which were only
+     * inserted into the subtrahend end up in vecMissing, the others in vecExtra. Returns false
+     * when the difference was too large to decode completely.
+     */
+    bool Decode(std::vector<uint256>& vecExtra, std::vector<uint256>& vecMissing) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nSalt);
+        READWRITE(vecCells);
+    }
+};
+
+#endif // BITCOIN_GOVERNANCE_GOVERNANCE_VOTESKETCH_H
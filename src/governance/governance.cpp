@@ -4,11 +4,16 @@
 
 #include <governance/governance.h>
 #include <consensus/validation.h>
+#include <flat-database.h>
 #include <governance/governance-classes.h>
+#include <governance/governance-db.h>
 #include <governance/governance-validators.h>
 #include <init.h>
+#include <bls/bls_batchverifier.h>
+#include <llmq/quorums_init.h>
 #include <masternode/masternode-meta.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <messagesigner.h>
 #include <net_processing.h>
 #include <netfulfilledman.h>
@@ -24,6 +29,14 @@ const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanc
 const int CGovernanceManager::MAX_TIME_FUTURE_DEVIATION = 60 * 60;
 const int CGovernanceManager::RELIABLE_PROPAGATION_TIME = 60;
 
+// Number of vote signatures verified together in one BLS batch or one ECDSA chunk
+static const size_t VOTE_SIG_VERIFY_BATCH_SIZE = 32;
+
+// Capacity of the vote sketches sent to peers, i.e. how many votes we can be missing (or have in addition)
+// before the peer fails to decode it and falls back to announcing all votes of the object
+static const size_t GOVERNANCE_VOTE_SKETCH_MIN_CAPACITY = 64;
+static const size_t GOVERNANCE_VOTE_SKETCH_CAPACITY_DIVISOR = 8;
+
 CGovernanceManager::CGovernanceManager() :
     nTimeLastDiff(0),
     nCachedBlockHeight(0),
@@ -39,6 +52,8 @@ CGovernanceManager::CGovernanceManager() :
 {
 }
 
+CGovernanceManager::~CGovernanceManager() = default;
+
 // Accessors for thread-safe access to maps
 bool CGovernanceManager::HaveObjectForHash(const uint256& nHash) const
 {
@@ -73,6 +88,24 @@ int CGovernanceManager::GetVoteCount() const
     return (int)cmapVoteToObject.GetSize();
 }
 
+bool CGovernanceManager::HasPendingDownloads(const std::vector<CNode*>& vNodes)
+{
+    {
+        LOCK(cs_pendingVotes);
+        if (!vecPendingVotes.empty()) {
+            return true;
+        }
+    }
+
+    LOCK(cs_main);
+    for (const auto& pnode : vNodes) {
+        if (GetRequestedObjectCount(pnode->GetId()) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool CGovernanceManager::SerializeVoteForHash(const uint256& nHash, CDataStream& ss) const
 {
     LOCK(cs);
@@ -81,7 +114,7 @@ bool CGovernanceManager::SerializeVoteForHash(const uint256& nHash, CDataStream&
     return cmapVoteToObject.Get(nHash, pGovobj) && pGovobj->GetVoteFile().SerializeVoteToStream(nHash, ss);
 }
 
-void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61)
+void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
 {
     if (fDisableGovernance) return;
     if (!masternodeSync.IsBlockchainSynced()) return;
@@ -119,6 +152,25 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         LogPrint(BCLog::GOBJECT, "MNGOVERNANCESYNC -- syncing governance objects to our peer %s\n", pfrom->GetLogString());
     }
 
+    // ANOTHER USER IS ASKING US FOR THE VOTES OF AN OBJECT WHICH ARE MISSING IN ITS SKETCH
+    else if (strCommand == NetMsgType::MNGOVERNANCEVOTESKETCH) {
+        // Same as for MNGOVERNANCESYNC, this is a heavy one
+        if (!masternodeSync.IsSynced()) return;
+
+        uint256 nProp;
+        CGovernanceVoteSketch sketch;
+        vRecv >> nProp >> sketch;
+
+        if (!sketch.IsValid()) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        SyncSingleObjVotes(pfrom, nProp, sketch, connman);
+        LogPrint(BCLog::GOBJECT, "MNGOVERNANCEVOTESKETCH -- syncing votes of %s to our peer %s\n", nProp.ToString(), pfrom->GetLogString());
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT) {
         // MAKE SURE WE HAVE A VALID REFERENCE TO THE TIP BEFORE CONTINUING
@@ -237,20 +289,143 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
             return;
         }
 
+        // Verifying the signature is left to ProcessPendingVotes, unless the vote is known already or
+        // waits for its object, which both don't involve the signature
+        if (EnqueueVote(pfrom->GetId(), vote)) {
+            return;
+        }
+
         CGovernanceException exception;
-        if (ProcessVote(pfrom, vote, exception, connman)) {
-            LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
-            masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
-            vote.Relay(connman);
-        } else {
-            LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
-            if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+        bool fAccepted = ProcessVote(pfrom, vote, exception, connman);
+        HandleVoteResult(pfrom->GetId(), vote, fAccepted, exception, connman);
+    }
+}
+
+bool CGovernanceManager::EnqueueVote(NodeId nodeId, const CGovernanceVote& vote)
+{
+    {
+        LOCK(cs);
+        uint256 nHashVote = vote.GetHash();
+        if (cmapVoteToObject.HasKey(nHashVote) || cmapInvalidVotes.HasKey(nHashVote) || !mapObjects.count(vote.GetParentHash())) {
+            return false;
+        }
+    }
+
+    LOCK(cs_pendingVotes);
+    vecPendingVotes.emplace_back(nodeId, vote);
+    return true;
+}
+
+void CGovernanceManager::HandleVoteResult(NodeId nodeId, const CGovernanceVote& vote, bool fAccepted, const CGovernanceException& exception, CConnman& connman)
+{
+    if (fAccepted) {
+        LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- %s new\n", vote.GetHash().ToString());
+        masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
+        vote.Relay(connman);
+    } else {
+        LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
+        if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+            LOCK(cs_main);
+            Misbehaving(nodeId, exception.GetNodePenalty());
+        }
+    }
+}
+
+static std::vector<char> VerifyVoteSignatures(const std::vector<std::pair<NodeId, CGovernanceVote>>& vecVotes, const std::vector<char>& vecUseVotingKey,
+    const CDeterministicMNList& mnList, CBLSWorker& blsWorker)
+{
+    int64_t nStart = GetTimeMillis();
+    std::vector<char> vecSigChecked(vecVotes.size(), 0);
+
+    std::vector<std::pair<size_t, CKeyID>> vecECDSAVotes;
+    CBLSParallelBatchVerifier<NodeId, size_t, int> blsVerifier(blsWorker, false, true, VOTE_SIG_VERIFY_BATCH_SIZE);
+    std::vector<size_t> vecBLSVotes;
+    for (size_t i = 0; i < vecVotes.size(); i++) {
+        const CGovernanceVote& vote = vecVotes[i].second;
+        auto dmn = mnList.GetMNByCollateral(vote.GetMasternodeOutpoint());
+        if (vecUseVotingKey[i] == -1 || !dmn) {
+            // ProcessVote rejects these without looking at the signature
+            continue;
+        }
+        if (vecUseVotingKey[i]) {
+            vecECDSAVotes.emplace_back(i, dmn->pdmnState->keyIDVoting);
+            continue;
+        }
+        CBLSSignature sig(vote.GetSignature());
+        const CBLSPublicKey& pubKey = dmn->pdmnState->pubKeyOperator.Get();
+        if (sig.IsValid() && pubKey.IsValid()) {
+            blsVerifier.PushMessage(0, vecVotes[i].first, i, vote.GetSignatureHash(), sig, pubKey);
+            vecBLSVotes.emplace_back(i);
+        }
+    }
+
+    // Every chunk writes to distinct entries of vecSigChecked only, so they don't need to synchronize
+    std::vector<std::future<void>> futures;
+    for (size_t nChunkStart = 0; nChunkStart < vecECDSAVotes.size(); nChunkStart += VOTE_SIG_VERIFY_BATCH_SIZE) {
+        size_t nChunkEnd = std::min(nChunkStart + VOTE_SIG_VERIFY_BATCH_SIZE, vecECDSAVotes.size());
+        futures.emplace_back(blsWorker.AsyncRun([&vecVotes, &vecECDSAVotes, &vecSigChecked, nChunkStart, nChunkEnd]() {
+            for (size_t j = nChunkStart; j < nChunkEnd; j++) {
+                size_t i = vecECDSAVotes[j].first;
+                vecSigChecked[i] = vecVotes[i].second.CheckSignature(vecECDSAVotes[j].second);
+            }
+        }));
+    }
+    blsVerifier.Verify();
+    for (auto& f : futures) {
+        f.get();
+    }
+    for (size_t i : vecBLSVotes) {
+        vecSigChecked[i] = !blsVerifier.badMessages.count(i);
+    }
+
+    LogPrint(BCLog::GOBJECT, "%s -- verified %d ECDSA and %d BLS vote signatures (%d batches)  %dms\n", __func__,
+        vecECDSAVotes.size(), vecBLSVotes.size(), blsVerifier.GetBatchCount(), GetTimeMillis() - nStart);
+
+    return vecSigChecked;
+}
+
+void CGovernanceManager::ProcessPendingVotes(CConnman& connman)
+{
+    std::vector<std::pair<NodeId, CGovernanceVote>> vecVotes;
+    {
+        LOCK(cs_pendingVotes);
+        vecVotes.swap(vecPendingVotes);
+    }
+    if (vecVotes.empty()) {
+        return;
+    }
+
+    // Signatures are checked against the keys of this list. If the tip moves before the votes are processed,
+    // the keys might have changed and ProcessVote checks the signatures again.
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+
+    // Funding votes on proposals are signed with the ECDSA voting key, all other votes with the BLS operator key
+    std::vector<char> vecUseVotingKey(vecVotes.size(), -1);
+    {
+        LOCK(cs);
+        for (size_t i = 0; i < vecVotes.size(); i++) {
+            const CGovernanceVote& vote = vecVotes[i].second;
+            auto it = mapObjects.find(vote.GetParentHash());
+            if (it != mapObjects.end()) {
+                vecUseVotingKey[i] = it->second.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
             }
-            return;
         }
     }
+
+    std::vector<char> vecSigChecked(vecVotes.size(), 0);
+    if (llmq::blsWorker) {
+        vecSigChecked = VerifyVoteSignatures(vecVotes, vecUseVotingKey, mnList, *llmq::blsWorker);
+    }
+
+    bool fTipChanged = deterministicMNManager->GetListAtChainTip().GetBlockHash() != mnList.GetBlockHash();
+    for (size_t i = 0; i < vecVotes.size(); i++) {
+        const CGovernanceVote& vote = vecVotes[i].second;
+        // Invalid signatures are checked again by ProcessVote, which records the vote as invalid
+        bool fSignatureChecked = vecSigChecked[i] && !fTipChanged;
+        CGovernanceException exception;
+        bool fAccepted = ProcessVote(nullptr, vote, exception, connman, fSignatureChecked);
+        HandleVoteResult(vecVotes[i].first, vote, fAccepted, exception, connman);
+    }
 }
 
 void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernanceException& exception, CConnman& connman)
@@ -270,6 +445,7 @@ void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernance
             fRemove = true;
         } else if (govobj.ProcessVote(nullptr, vote, exception, connman)) {
             vote.Relay(connman);
+            setObjectsToCheck.insert(nHash);
             fRemove = true;
         }
         if (fRemove) {
@@ -307,6 +483,7 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
         LogPrint(BCLog::GOBJECT, "CGovernanceManager::AddGovernanceObject -- already have governance object %s\n", nHash.ToString());
         return;
     }
+    setObjectsToCheck.insert(nHash);
 
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANAGERS?
 
@@ -321,6 +498,13 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
         }
     }
 
+    if (db) {
+        CDBBatch batch(*db);
+        db->WriteObject(batch, objpair.first->second);
+        db->WriteBatch(batch);
+        mapStoredObjectHashes[nHash] = CGovernanceDb::GetRecordHash(objpair.first->second);
+    }
+
     LogPrintf("CGovernanceManager::AddGovernanceObject -- %s new, received from peer %s\n", strHash, pfrom ? pfrom->GetLogString() : "nullptr");
     govobj.Relay(connman);
 
@@ -357,25 +541,38 @@ void CGovernanceManager::UpdateCachesAndClean()
             continue;
         }
         it->second.ClearMasternodeVotes();
+        setObjectsToCheck.insert(nHash);
     }
 
     ScopedLockBool guard(cs, fRateChecksEnabled, false);
 
     // Clean up any expired or invalid triggers
-    triggerman.CleanAndRemove();
+    for (const uint256& nHash : triggerman.CleanAndRemove()) {
+        setObjectsToCheck.insert(nHash);
+    }
 
-    auto it = mapObjects.begin();
     int64_t nNow = GetAdjustedTime();
 
-    while (it != mapObjects.end()) {
-        CGovernanceObject* pObj = &((*it).second);
+    // Only objects which changed or reached their expiration or deletion time have to be looked at
+    while (!setProposalExpiryQueue.empty() && setProposalExpiryQueue.begin()->first <= nNow) {
+        setObjectsToCheck.insert(setProposalExpiryQueue.begin()->second);
+        setProposalExpiryQueue.erase(setProposalExpiryQueue.begin());
+    }
+    while (!setDeletionQueue.empty() && setDeletionQueue.begin()->first <= nNow) {
+        setObjectsToCheck.insert(setDeletionQueue.begin()->second);
+        setDeletionQueue.erase(setDeletionQueue.begin());
+    }
 
-        if (!pObj) {
-            ++it;
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::UpdateCachesAndClean -- checking %d objects\n", setObjectsToCheck.size());
+
+    std::vector<uint256> vecErasedHashes;
+    for (const uint256& nHash : setObjectsToCheck) {
+        auto it = mapObjects.find(nHash);
+        if (it == mapObjects.end()) {
             continue;
         }
+        CGovernanceObject* pObj = &it->second;
 
-        uint256 nHash = it->first;
         std::string strHash = nHash.ToString();
 
         // IF CACHE IS NOT DIRTY, WHY DO THIS?
@@ -396,55 +593,77 @@ void CGovernanceManager::UpdateCachesAndClean()
 
         if ((pObj->IsSetCachedDelete() || pObj->IsSetExpired()) &&
             (nTimeSinceDeletion >= GOVERNANCE_DELETION_DELAY)) {
-            LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
-            mmetaman.RemoveGovernanceObject(pObj->GetHash());
-
-            // Remove vote references
-            const object_ref_cm_t::list_t& listItems = cmapVoteToObject.GetItemList();
-            object_ref_cm_t::list_cit lit = listItems.begin();
-            while (lit != listItems.end()) {
-                if (lit->value == pObj) {
-                    uint256 nKey = lit->key;
-                    ++lit;
-                    cmapVoteToObject.Erase(nKey);
-                } else {
-                    ++lit;
-                }
+            vecErasedHashes.emplace_back(nHash);
+            continue;
+        }
+
+        // NOTE: triggers are handled via triggerman
+        if (!pObj->IsSetCachedDelete() && !pObj->IsSetExpired() && pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
+            CProposalValidator validator(pObj->GetDataAsHexString(), true);
+            int64_t nEndEpoch{0};
+            if (!validator.Validate()) {
+                LogPrintf("CGovernanceManager::UpdateCachesAndClean -- set for deletion expired obj %s\n", strHash);
+                pObj->PrepareDeletion(nNow);
+            } else if (validator.GetEndEpoch(nEndEpoch)) {
+                setProposalExpiryQueue.emplace(nEndEpoch, nHash);
             }
+        }
+
+        if (pObj->IsSetCachedDelete() || pObj->IsSetExpired()) {
+            setDeletionQueue.emplace(pObj->GetDeletionTime() + GOVERNANCE_DELETION_DELAY, nHash);
+        }
+    }
+    setObjectsToCheck.clear();
 
-            int64_t nTimeExpired{0};
+    if (!vecErasedHashes.empty()) {
+        std::set<CGovernanceObject*> setErasedObjects;
+        for (const uint256& nHash : vecErasedHashes) {
+            setErasedObjects.insert(&mapObjects.at(nHash));
+        }
 
-            if (pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-                // keep hashes of deleted proposals forever
-                nTimeExpired = std::numeric_limits<int64_t>::max();
+        // Remove vote references of all erased objects in a single pass
+        const object_ref_cm_t::list_t& listItems = cmapVoteToObject.GetItemList();
+        object_ref_cm_t::list_cit lit = listItems.begin();
+        while (lit != listItems.end()) {
+            if (setErasedObjects.count(lit->value)) {
+                uint256 nKey = lit->key;
+                ++lit;
+                cmapVoteToObject.Erase(nKey);
             } else {
-                int64_t nSuperblockCycleSeconds = Params().GetConsensus().nSuperblockCycle * Params().GetConsensus().nPowTargetSpacing;
-                nTimeExpired = pObj->GetCreationTime() + 2 * nSuperblockCycleSeconds + GOVERNANCE_DELETION_DELAY;
+                ++lit;
             }
+        }
+    }
+
+    for (const uint256& nHash : vecErasedHashes) {
+        auto it = mapObjects.find(nHash);
+        CGovernanceObject* pObj = &it->second;
+
+        LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", nHash.ToString());
+        mmetaman.RemoveGovernanceObject(pObj->GetHash());
 
-            mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
-            mapObjects.erase(it++);
+        int64_t nTimeExpired{0};
+
+        if (pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
+            // keep hashes of deleted proposals forever
+            nTimeExpired = std::numeric_limits<int64_t>::max();
         } else {
-            // NOTE: triggers are handled via triggerman
-            if (pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-                CProposalValidator validator(pObj->GetDataAsHexString(), true);
-                if (!validator.Validate()) {
-                    LogPrintf("CGovernanceManager::UpdateCachesAndClean -- set for deletion expired obj %s\n", strHash);
-                    pObj->PrepareDeletion(nNow);
-                }
-            }
-            ++it;
+            int64_t nSuperblockCycleSeconds = Params().GetConsensus().nSuperblockCycle * Params().GetConsensus().nPowTargetSpacing;
+            nTimeExpired = pObj->GetCreationTime() + 2 * nSuperblockCycleSeconds + GOVERNANCE_DELETION_DELAY;
         }
+
+        if (mapErasedGovernanceObjects.emplace(nHash, nTimeExpired).second) {
+            erasedObjectsExpiry.schedule(nHash, nTimeExpired);
+        }
+        if (pObj->GetObjectType() == GOVERNANCE_OBJECT_TRIGGER) {
+            triggerman.SetDirty();
+        }
+        mapObjects.erase(it);
     }
 
     // forget about expired deleted objects
-    auto s_it = mapErasedGovernanceObjects.begin();
-    while (s_it != mapErasedGovernanceObjects.end()) {
-        if (s_it->second < nNow) {
-            mapErasedGovernanceObjects.erase(s_it++);
-        } else {
-            ++s_it;
-        }
+    for (const uint256& nHash : erasedObjectsExpiry.pop_expired(nNow - 1)) {
+        mapErasedGovernanceObjects.erase(nHash);
     }
 
     LogPrintf("CGovernanceManager::UpdateCachesAndClean -- %s\n", ToString());
@@ -547,6 +766,8 @@ void CGovernanceManager::DoMaintenance(CConnman& connman)
     // CHECK AND REMOVE - REPROCESS GOVERNANCE OBJECTS
 
     UpdateCachesAndClean();
+
+    FlushCache();
 }
 
 bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
@@ -602,26 +823,17 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
     return true;
 }
 
-void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman)
+bool CGovernanceManager::GetSyncableVoteHashes(CNode* pnode, const uint256& nProp, std::vector<uint256>& vecVoteHashes) const
 {
-    // do not provide any data until our node is synced
-    if (!masternodeSync.IsSynced()) return;
-
-    int nVoteCount = 0;
-
-    // SYNC GOVERNANCE OBJECTS WITH OTHER CLIENT
-
-    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- syncing single object to peer=%d, nProp = %s\n", __func__, pnode->GetId(), nProp.ToString());
-
     LOCK2(cs_main, cs);
 
     // single valid object and its valid votes
     auto it = mapObjects.find(nProp);
     if (it == mapObjects.end()) {
         LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- no matching object for hash %s, peer=%d\n", __func__, nProp.ToString(), pnode->GetId());
-        return;
+        return false;
     }
-    CGovernanceObject& govobj = it->second;
+    const CGovernanceObject& govobj = it->second;
     std::string strHash = it->first.ToString();
 
     LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- attempting to sync govobj: %s, peer=%d\n", __func__, strHash, pnode->GetId());
@@ -629,26 +841,87 @@ void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp,
     if (govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
         LogPrintf("CGovernanceManager::%s -- not syncing deleted/expired govobj: %s, peer=%d\n", __func__,
             strHash, pnode->GetId());
-        return;
+        return false;
     }
 
-    auto fileVotes = govobj.GetVoteFile();
-
-    for (const auto& vote : fileVotes.GetVotes()) {
-        uint256 nVoteHash = vote.GetHash();
-
+    for (const auto& vote : govobj.GetVoteFile().GetVotes()) {
         bool onlyVotingKeyAllowed = govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
-        if (filter.contains(nVoteHash) || !vote.IsValid(onlyVotingKeyAllowed)) {
+        if (!vote.IsValid(onlyVotingKeyAllowed)) {
             continue;
         }
+        vecVoteHashes.emplace_back(vote.GetHash());
+    }
+    return true;
+}
+
+void CGovernanceManager::PushVoteInventory(CNode* pnode, const std::vector<uint256>& vecVoteHashes, CConnman& connman) const
+{
+    for (const auto& nVoteHash : vecVoteHashes) {
         pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, nVoteHash));
-        ++nVoteCount;
     }
 
     CNetMsgMaker msgMaker(pnode->GetSendVersion());
-    connman.PushMessage(pnode, msgMaker.Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount));
-    LogPrintf("CGovernanceManager::%s -- sent %d votes to peer=%d\n", __func__, nVoteCount, pnode->GetId());
+    connman.PushMessage(pnode, msgMaker.Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, (int)vecVoteHashes.size()));
+    LogPrintf("CGovernanceManager::%s -- sent %d votes to peer=%d\n", __func__, vecVoteHashes.size(), pnode->GetId());
+}
+
+void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman)
+{
+    // do not provide any data until our node is synced
+    if (!masternodeSync.IsSynced()) return;
+
+    // SYNC GOVERNANCE OBJECTS WITH OTHER CLIENT
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- syncing single object to peer=%d, nProp = %s\n", __func__, pnode->GetId(), nProp.ToString());
+
+    std::vector<uint256> vecVoteHashes;
+    if (!GetSyncableVoteHashes(pnode, nProp, vecVoteHashes)) {
+        return;
+    }
+
+    vecVoteHashes.erase(std::remove_if(vecVoteHashes.begin(), vecVoteHashes.end(), [&](const uint256& nVoteHash) {
+        return filter.contains(nVoteHash);
+    }), vecVoteHashes.end());
+
+    PushVoteInventory(pnode, vecVoteHashes, connman);
+}
+
+void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CGovernanceVoteSketch& sketch, CConnman& connman)
+{
+    // do not provide any data until our node is synced
+    if (!masternodeSync.IsSynced()) return;
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- syncing single object to peer=%d, nProp = %s, cells = %d\n", __func__, pnode->GetId(), nProp.ToString(), sketch.GetCellCount());
+
+    std::vector<uint256> vecVoteHashes;
+    if (!GetSyncableVoteHashes(pnode, nProp, vecVoteHashes)) {
+        return;
+    }
+
+    CGovernanceVoteSketch diff = CGovernanceVoteSketch::CreateMatching(sketch);
+    for (const auto& nVoteHash : vecVoteHashes) {
+        diff.Insert(nVoteHash);
+    }
+    diff.Subtract(sketch);
+
+    // Votes only the peer has are of no interest here, they will reach us through the usual relay
+    std::vector<uint256> vecExtra, vecMissing;
+    if (diff.Decode(vecExtra, vecMissing)) {
+        std::set<uint256> setValid(vecVoteHashes.begin(), vecVoteHashes.end());
+        vecVoteHashes.clear();
+        for (const auto& nVoteHash : vecExtra) {
+            // a corrupted sketch could decode to anything
+            if (setValid.count(nVoteHash)) {
+                vecVoteHashes.emplace_back(nVoteHash);
+            }
+        }
+    } else {
+        // the difference is too large for the sketch, send all votes as if the peer had none and let it skip the known ones
+        LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- failed to decode sketch of peer=%d, nProp = %s\n", __func__, pnode->GetId(), nProp.ToString());
+    }
+
+    PushVoteInventory(pnode, vecVoteHashes, connman);
 }
 
 void CGovernanceManager::SyncObjects(CNode* pnode, CConnman& connman) const
@@ -790,7 +1063,7 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, bo
     return false;
 }
 
-bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman)
+bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman, bool fSignatureChecked)
 {
     ENTER_CRITICAL_SECTION(cs);
     uint256 nHashVote = vote.GetHash();
@@ -839,7 +1112,11 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         return false;
     }
 
-    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman, fSignatureChecked) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    if (fOk) {
+        WriteVoteToDb(vote);
+        setObjectsToCheck.insert(vote.GetParentHash());
+    }
     LEAVE_CRITICAL_SECTION(cs);
     return fOk;
 }
@@ -927,6 +1204,19 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
         LOCK(cs);
         CGovernanceObject* pObj = FindGovernanceObject(nHash);
 
+        if (pObj && pObj->GetVoteFile().GetVoteCount() > 0 && pfrom->nVersion >= GOVERNANCE_VOTE_SKETCH_VERSION) {
+            // A sketch is a fraction of the size of a filter and makes the peer send exactly the votes we're missing
+            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+            size_t nCapacity = std::max(GOVERNANCE_VOTE_SKETCH_MIN_CAPACITY, vecVotes.size() / GOVERNANCE_VOTE_SKETCH_CAPACITY_DIVISOR);
+            CGovernanceVoteSketch sketch(nCapacity, GetRand(std::numeric_limits<uint64_t>::max()));
+            for (const auto& vote : vecVotes) {
+                sketch.Insert(vote.GetHash());
+            }
+            LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObject -- nHash %s nVoteCount %d cells %d peer=%d\n", nHash.ToString(), vecVotes.size(), sketch.GetCellCount(), pfrom->GetId());
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCEVOTESKETCH, nHash, sketch));
+            return;
+        }
+
         if (pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
             std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
@@ -1082,8 +1372,11 @@ void CGovernanceManager::RebuildIndexes()
     LOCK(cs);
 
     cmapVoteToObject.Clear();
+    setProposalExpiryQueue.clear();
+    setDeletionQueue.clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
+        setObjectsToCheck.insert(objPair.first);
         std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
         for (size_t i = 0; i < vecVotes.size(); ++i) {
             cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
@@ -1119,6 +1412,144 @@ void CGovernanceManager::InitOnLoad()
     LogPrintf("     %s\n", ToString());
 }
 
+bool CGovernanceManager::LoadCache(bool fWipe)
+{
+    LOCK(cs);
+
+    int64_t nStart = GetTimeMillis();
+    fs::path pathFlatDB = GetDataDir() / "governance.dat";
+
+    db = MakeUnique<CGovernanceDb>(8 << 20, false, fWipe);
+    mapStoredObjectHashes.clear();
+
+    if (fWipe || !db->HasVersion()) {
+        if (!fWipe) {
+            // Drop whatever an interrupted migration left behind, mapStoredObjectHashes doesn't know about it
+            db.reset();
+            db = MakeUnique<CGovernanceDb>(8 << 20, false, true);
+        }
+        if (!fWipe && fs::exists(pathFlatDB)) {
+            LogPrintf("Migrating governance cache from governance.dat...\n");
+            CFlatDB<CGovernanceManager> flatdb("governance.dat", "magicGovernanceCache");
+            if (!flatdb.Load(*this)) {
+                return false;
+            }
+        }
+        // The version is written last, so that an interrupted migration is started over
+        FlushCache(true);
+        if (fs::exists(pathFlatDB)) {
+            fs::remove(pathFlatDB);
+        }
+        LogPrintf("Governance db initialized  %dms\n", GetTimeMillis() - nStart);
+        return true;
+    }
+
+    Clear();
+    StateWithoutObjects state(*this);
+    if (!db->ReadState(state)) {
+        LogPrintf("CGovernanceManager::%s -- failed to read governance state, starting from scratch\n", __func__);
+        Clear();
+    }
+    db->ReadObjects(mapObjects, mapStoredObjectHashes);
+
+    LogPrintf("Loaded governance db  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("     %s\n", ToString());
+    LogPrintf("%s: Cleaning....\n", __func__);
+    CheckAndRemove();
+    LogPrintf("     %s\n", ToString());
+
+    return true;
+}
+
+void CGovernanceManager::FlushCache(bool fSync)
+{
+    LOCK(cs);
+
+    if (!db) return;
+
+    int64_t nStart = GetTimeMillis();
+    int nObjectsWritten = 0;
+    int nObjectsErased = 0;
+
+    CDBBatch batch(*db);
+    auto writeBatchIfLarge = [&]() {
+        if (batch.SizeEstimate() > (16 << 20)) {
+            db->WriteBatch(batch);
+            batch.Clear();
+        }
+    };
+
+    for (const auto& objPair : mapObjects) {
+        const uint256& nHash = objPair.first;
+        const CGovernanceObject& govobj = objPair.second;
+
+        uint256 nRecordHash = CGovernanceDb::GetRecordHash(govobj);
+        auto itStored = mapStoredObjectHashes.find(nHash);
+        bool fStored = itStored != mapStoredObjectHashes.end();
+        if (fStored && itStored->second == nRecordHash) {
+            // mapCurrentMNVotes is part of the record, so the votes didn't change either
+            continue;
+        }
+
+        db->WriteObject(batch, govobj);
+        // Accepted votes were written already, but votes which were replaced or removed since must go
+        const CGovernanceObjectVoteFile& fileVotes = govobj.GetVoteFile();
+        std::set<uint256> setStoredVotes;
+        if (fStored) {
+            setStoredVotes = db->GetVoteHashes(nHash);
+            for (const auto& nVoteHash : setStoredVotes) {
+                if (!fileVotes.HasVote(nVoteHash)) {
+                    db->EraseVote(batch, nHash, nVoteHash);
+                }
+            }
+        }
+        for (const auto& vote : fileVotes.GetVotes()) {
+            if (!setStoredVotes.count(vote.GetHash())) {
+                db->WriteVote(batch, vote);
+            }
+        }
+        mapStoredObjectHashes[nHash] = nRecordHash;
+        nObjectsWritten++;
+        writeBatchIfLarge();
+    }
+
+    for (auto it = mapStoredObjectHashes.begin(); it != mapStoredObjectHashes.end();) {
+        if (mapObjects.count(it->first)) {
+            ++it;
+            continue;
+        }
+        db->EraseObject(batch, it->first);
+        it = mapStoredObjectHashes.erase(it);
+        nObjectsErased++;
+        writeBatchIfLarge();
+    }
+
+    db->WriteState(batch, StateWithoutObjects(*this));
+    db->WriteVersion(batch);
+    db->WriteBatch(batch, fSync);
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- wrote %d objects, erased %d objects  %dms\n", __func__,
+        nObjectsWritten, nObjectsErased, GetTimeMillis() - nStart);
+}
+
+void CGovernanceManager::CloseCache()
+{
+    LOCK(cs);
+    db.reset();
+    mapStoredObjectHashes.clear();
+}
+
+void CGovernanceManager::WriteVoteToDb(const CGovernanceVote& vote)
+{
+    AssertLockHeld(cs);
+
+    if (!db) return;
+
+    CDBBatch batch(*db);
+    db->WriteVote(batch, vote);
+    db->WriteBatch(batch);
+}
+
 std::string CGovernanceManager::ToString() const
 {
     LOCK(cs);
@@ -1141,10 +1572,54 @@ std::string CGovernanceManager::ToString() const
         }
     }
 
-    return strprintf("Governance Objects: %d (Proposals: %d, Triggers: %d, Other: %d; Erased: %d), Votes: %d",
+    size_t nCacheUsage = cmapVoteToObject.DynamicMemoryUsage() + cmapInvalidVotes.DynamicMemoryUsage() + cmmapOrphanVotes.DynamicMemoryUsage();
+
+    return strprintf("Governance Objects: %d (Proposals: %d, Triggers: %d, Other: %d; Erased: %d), Votes: %d, Vote caches: %.1fkB",
         (int)mapObjects.size(),
         nProposalCount, nTriggerCount, nOtherCount, (int)mapErasedGovernanceObjects.size(),
-        (int)cmapVoteToObject.GetSize());
+        (int)cmapVoteToObject.GetSize(), nCacheUsage * (1.0 / 1000));
+}
+
+size_t CGovernanceManager::GetMemoryUsage() const
+{
+    size_t usage = 0;
+    {
+        LOCK(cs);
+
+        usage += memusage::DynamicUsage(mapObjects) + memusage::DynamicUsage(mapPostponedObjects);
+        for (const auto& p : mapObjects) {
+            usage += p.second.DynamicMemoryUsage();
+        }
+        for (const auto& p : mapPostponedObjects) {
+            usage += p.second.DynamicMemoryUsage();
+        }
+        usage += memusage::DynamicUsage(setObjectsToCheck) +
+                 memusage::DynamicUsage(setProposalExpiryQueue) +
+                 memusage::DynamicUsage(setDeletionQueue) +
+                 memusage::DynamicUsage(mapErasedGovernanceObjects) +
+                 erasedObjectsExpiry.DynamicUsage() +
+                 memusage::DynamicUsage(setAdditionalRelayObjects) +
+                 memusage::DynamicUsage(mapLastMasternodeObject) +
+                 memusage::DynamicUsage(setRequestedObjects) +
+                 memusage::DynamicUsage(setRequestedVotes) +
+                 memusage::DynamicUsage(mapStoredObjectHashes);
+
+        usage += cmapVoteToObject.DynamicMemoryUsage() + cmapInvalidVotes.DynamicMemoryUsage() + cmmapOrphanVotes.DynamicMemoryUsage();
+        for (const auto& item : cmapInvalidVotes.GetItemList()) {
+            usage += item.value.DynamicMemoryUsage();
+        }
+        for (const auto& item : cmmapOrphanVotes.GetItemList()) {
+            usage += item.value.first.DynamicMemoryUsage();
+        }
+    }
+    {
+        LOCK(cs_pendingVotes);
+        usage += memusage::DynamicUsage(vecPendingVotes);
+        for (const auto& p : vecPendingVotes) {
+            usage += p.second.DynamicMemoryUsage();
+        }
+    }
+    return usage;
 }
 
 UniValue CGovernanceManager::ToJson() const
@@ -1280,6 +1755,7 @@ void CGovernanceManager::RemoveInvalidVotes()
             if (removed.empty()) {
                 continue;
             }
+            setObjectsToCheck.insert(p.first);
             for (auto& voteHash : removed) {
                 cmapVoteToObject.Erase(voteHash);
                 cmapInvalidVotes.Erase(voteHash);
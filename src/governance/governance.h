@@ -9,10 +9,13 @@
 #include <cachemap.h>
 #include <cachemultimap.h>
 #include <chain.h>
+#include <expiryqueue.h>
 #include <governance/governance-exceptions.h>
 #include <governance/governance-object.h>
 #include <governance/governance-vote.h>
+#include <governance/governance-votesketch.h>
 #include <net.h>
+#include <saltedhasher.h>
 #include <sync.h>
 #include <timedata.h>
 #include <util.h>
@@ -21,6 +24,9 @@
 
 #include <univalue.h>
 
+#include <memory>
+
+class CGovernanceDb;
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -160,9 +166,9 @@ public: // Types
     };
 
 
-    typedef CacheMap<uint256, CGovernanceObject*> object_ref_cm_t;
+    typedef CacheMap<uint256, CGovernanceObject*, uint32_t, StaticSaltedHasher> object_ref_cm_t;
 
-    typedef CacheMultiMap<uint256, vote_time_pair_t> vote_cmm_t;
+    typedef CacheMultiMap<uint256, vote_time_pair_t, uint32_t, StaticSaltedHasher> vote_cmm_t;
 
     typedef std::map<COutPoint, last_object_rec> txout_m_t;
 
@@ -184,17 +190,27 @@ private:
     // keep track of the scanning errors
     std::map<uint256, CGovernanceObject> mapObjects;
 
+    // objects which may have changed since the last UpdateCachesAndClean and must be checked again
+    hash_s_t setObjectsToCheck;
+
+    // (end epoch, hash) of valid proposals, to check them again once they expire
+    std::set<std::pair<int64_t, uint256>> setProposalExpiryQueue;
+
+    // (earliest erase time, hash) of objects marked for deletion or expired
+    std::set<std::pair<int64_t, uint256>> setDeletionQueue;
+
     // mapErasedGovernanceObjects contains key-value pairs, where
     //   key   - governance object's hash
     //   value - expiration time for deleted objects
     std::map<uint256, int64_t> mapErasedGovernanceObjects;
+    expiry_queue<uint256> erasedObjectsExpiry;
 
     std::map<uint256, CGovernanceObject> mapPostponedObjects;
     hash_s_t setAdditionalRelayObjects;
 
     object_ref_cm_t cmapVoteToObject;
 
-    CacheMap<uint256, CGovernanceVote> cmapInvalidVotes;
+    CacheMap<uint256, CGovernanceVote, uint32_t, StaticSaltedHasher> cmapInvalidVotes;
 
     vote_cmm_t cmmapOrphanVotes;
 
@@ -209,6 +225,15 @@ private:
     // used to check for changed voting keys
     CDeterministicMNList lastMNListForVotingKeys;
 
+    std::unique_ptr<CGovernanceDb> db;
+
+    // votes received from peers which still need their signature verified, see ProcessPendingVotes()
+    mutable CCriticalSection cs_pendingVotes;
+    std::vector<std::pair<NodeId, CGovernanceVote>> vecPendingVotes;
+
+    // hashes of the object records as last written to the governance db, see FlushCache()
+    std::map<uint256, uint256> mapStoredObjectHashes;
+
     class ScopedLockBool
     {
         bool& ref;
@@ -235,7 +260,7 @@ public:
 
     CGovernanceManager();
 
-    virtual ~CGovernanceManager() = default;
+    virtual ~CGovernanceManager();
 
     /**
      * This is called by AlreadyHave in net_processing.cpp as part of the inventory
@@ -245,9 +270,11 @@ public:
     bool ConfirmInventoryRequest(const CInv& inv);
 
     void SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman);
+    /** Only sends the votes which are missing in the sketch of the peer, or all votes if it can't be decoded */
+    void SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CGovernanceVoteSketch& sketch, CConnman& connman);
     void SyncObjects(CNode* pnode, CConnman& connman) const;
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61);
 
     void DoMaintenance(CConnman& connman);
 
@@ -269,7 +296,11 @@ public:
 
         LogPrint(BCLog::GOBJECT, "Governance object manager was cleared\n");
         mapObjects.clear();
+        setObjectsToCheck.clear();
+        setProposalExpiryQueue.clear();
+        setDeletionQueue.clear();
         mapErasedGovernanceObjects.clear();
+        erasedObjectsExpiry.clear();
         cmapVoteToObject.Clear();
         cmapInvalidVotes.Clear();
         cmmapOrphanVotes.Clear();
@@ -279,10 +310,43 @@ public:
     std::string ToString() const;
     UniValue ToJson() const;
 
+    // Memory used by the objects, votes and caches
+    size_t GetMemoryUsage() const;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        SerializationOpBase(s, ser_action, true);
+    }
+
+    /**
+     * Serializes the state of the manager except for the governance objects, which the
+     * governance db stores one by one
+     */
+    class StateWithoutObjects
+    {
+    private:
+        CGovernanceManager& manager;
+
+    public:
+        explicit StateWithoutObjects(const CGovernanceManager& managerIn) :
+            manager(const_cast<CGovernanceManager&>(managerIn))
+        {
+        }
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            manager.SerializationOpBase(s, ser_action, false);
+        }
+    };
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOpBase(Stream& s, Operation ser_action, bool fIncludeObjects)
     {
         LOCK(cs);
         std::string strVersion;
@@ -298,9 +362,17 @@ public:
         }
 
         READWRITE(mapErasedGovernanceObjects);
+        if (ser_action.ForRead()) {
+            erasedObjectsExpiry.clear();
+            for (const auto& p : mapErasedGovernanceObjects) {
+                erasedObjectsExpiry.schedule(p.first, p.second);
+            }
+        }
         READWRITE(cmapInvalidVotes);
         READWRITE(cmmapOrphanVotes);
-        READWRITE(mapObjects);
+        if (fIncludeObjects) {
+            READWRITE(mapObjects);
+        }
         READWRITE(mapLastMasternodeObject);
         READWRITE(lastMNListForVotingKeys);
     }
@@ -318,6 +390,12 @@ public:
 
     int GetVoteCount() const;
 
+    /**
+     * Whether any of the peers still has announced objects which weren't received yet (this includes
+     * non-governance inventory) or received votes are still waiting for signature verification
+     */
+    bool HasPendingDownloads(const std::vector<CNode*>& vNodes);
+
     bool SerializeObjectForHash(const uint256& nHash, CDataStream& ss) const;
 
     bool SerializeVoteForHash(const uint256& nHash, CDataStream& ss) const;
@@ -353,18 +431,46 @@ public:
 
     void InitOnLoad();
 
+    /**
+     * Open the governance db and load all objects and votes from it. A governance.dat left
+     * behind by an older version is migrated into the db and removed. With fWipe, all stored
+     * governance data is dropped instead.
+     */
+    bool LoadCache(bool fWipe);
+    /** Write all objects and votes which changed since the last flush to the governance db */
+    void FlushCache(bool fSync = false);
+    void CloseCache();
+
+    /**
+     * Verify the signatures of all queued votes outside of cs, BLS signatures in batches and ECDSA
+     * signatures in chunks, spread over the BLS worker threads. Only processing the verified votes
+     * happens under cs.
+     */
+    void ProcessPendingVotes(CConnman& connman);
+
     int RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman);
     int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman);
 
 private:
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter = false);
 
+    /// Hashes of the votes of nProp which may be sent to peers, false if the object must not be synced
+    bool GetSyncableVoteHashes(CNode* pnode, const uint256& nProp, std::vector<uint256>& vecVoteHashes) const;
+
+    void PushVoteInventory(CNode* pnode, const std::vector<uint256>& vecVoteHashes, CConnman& connman) const;
+
     void AddInvalidVote(const CGovernanceVote& vote)
     {
         cmapInvalidVotes.Insert(vote.GetHash(), vote);
     }
 
-    bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman);
+    bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman, bool fSignatureChecked = false);
+
+    /// Queue a vote for batched signature verification, returns false if it must be processed right away
+    bool EnqueueVote(NodeId nodeId, const CGovernanceVote& vote);
+
+    /// Relay an accepted vote or punish the peer which sent an invalid one
+    void HandleVoteResult(NodeId nodeId, const CGovernanceVote& vote, bool fAccepted, const CGovernanceException& exception, CConnman& connman);
 
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
@@ -386,6 +492,9 @@ private:
 
     void RemoveInvalidVotes();
 
+    /** Write a vote right after it was accepted, so that a crash doesn't lose it */
+    void WriteVoteToDb(const CGovernanceVote& vote);
+
 };
 
 bool AreSuperblocksEnabled();
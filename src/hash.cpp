@@ -245,3 +245,12 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+void HashX11Headers(uint256* output, const unsigned char* input, size_t count)
+{
+    // The stages are dispatched individually (see X11AutoDetect), so there is nothing to gain from interleaving
+    // multiple headers at this point. Hash them one after another.
+    for (size_t i = 0; i < count; i++) {
+        output[i] = HashX11(input + 80 * i, input + 80 * (i + 1));
+    }
+}
@@ -9,6 +9,7 @@
 
 #include <crypto/ripemd160.h>
 #include <crypto/sha256.h>
+#include <crypto/x11.h>
 #include <prevector.h>
 #include <serialize.h>
 #include <uint256.h>
@@ -22,9 +23,7 @@
 #include <crypto/sph_skein.h>
 #include <crypto/sph_luffa.h>
 #include <crypto/sph_cubehash.h>
-#include <crypto/sph_shavite.h>
 #include <crypto/sph_simd.h>
-#include <crypto/sph_echo.h>
 
 #include <vector>
 
@@ -310,9 +309,7 @@ inline uint256 HashX11(const T1 pbegin, const T1 pend)
     sph_skein512_context     ctx_skein;
     sph_luffa512_context     ctx_luffa;
     sph_cubehash512_context  ctx_cubehash;
-    sph_shavite512_context   ctx_shavite;
     sph_simd512_context      ctx_simd;
-    sph_echo512_context      ctx_echo;
     static unsigned char pblank[1];
 
     uint512 hash[11];
@@ -349,19 +346,21 @@ inline uint256 HashX11(const T1 pbegin, const T1 pend)
     sph_cubehash512 (&ctx_cubehash, static_cast<const void*>(&hash[6]), 64);
     sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash[7]));
 
-    sph_shavite512_init(&ctx_shavite);
-    sph_shavite512(&ctx_shavite, static_cast<const void*>(&hash[7]), 64);
-    sph_shavite512_close(&ctx_shavite, static_cast<void*>(&hash[8]));
+    X11Shavite512_64(reinterpret_cast<unsigned char*>(&hash[8]), reinterpret_cast<const unsigned char*>(&hash[7]));
 
     sph_simd512_init(&ctx_simd);
     sph_simd512 (&ctx_simd, static_cast<const void*>(&hash[8]), 64);
     sph_simd512_close(&ctx_simd, static_cast<void*>(&hash[9]));
 
-    sph_echo512_init(&ctx_echo);
-    sph_echo512 (&ctx_echo, static_cast<const void*>(&hash[9]), 64);
-    sph_echo512_close(&ctx_echo, static_cast<void*>(&hash[10]));
+    X11Echo512_64(reinterpret_cast<unsigned char*>(&hash[10]), reinterpret_cast<const unsigned char*>(&hash[9]));
 
     return hash[10].trim256();
 }
 
+/** Compute the X11 hashes of count consecutive serialized 80 byte block headers.
+ *  output:  pointer to count uint256 outputs
+ *  input:   pointer to count * 80 bytes of serialized headers
+ */
+void HashX11Headers(uint256* output, const unsigned char* input, size_t count);
+
 #endif // BITCOIN_HASH_H
@@ -66,6 +66,30 @@ static std::string strRPCUserColonPass;
 /* Stored RPC timer interface (for unregistration) */
 static std::unique_ptr<HTTPRPCTimerInterface> httpRPCTimerInterface;
 
+/** Streams the result of a JSON-RPC call into the body of the reply, see WriteRPCResult() */
+class HTTPRPCResultSink : public JSONWriterSink
+{
+private:
+    HTTPRequest* m_req;
+    bool m_started{false};
+
+public:
+    explicit HTTPRPCResultSink(HTTPRequest* req) : m_req(req) {}
+
+    bool IsStarted() const { return m_started; }
+
+    void Write(const char* data, size_t len) override
+    {
+        if (!m_started) {
+            // Same layout as JSONRPCReplyObj(), error and id are appended after the result
+            static const std::string strPrefix = "{\"result\":";
+            m_req->WriteBody(strPrefix.data(), strPrefix.size());
+            m_started = true;
+        }
+        m_req->WriteBody(data, len);
+    }
+};
+
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
     // Send error reply from json-rpc error object
@@ -82,6 +106,8 @@ static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const Uni
 
     std::string strReply = JSONRPCReply(NullUniValue, objError, id);
 
+    // Drop the partial result of a call which failed while streaming it
+    req->DiscardBody();
     req->WriteHeader("Content-Type", "application/json");
     req->WriteReply(nStatus, strReply);
 }
@@ -191,14 +217,23 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            HTTPRPCResultSink sink(req);
+            JSONWriter writer(sink);
+            jreq.resultWriter = &writer;
             UniValue result = tableRPC.execute(jreq);
+            jreq.resultWriter = nullptr;
 
             // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            if (sink.IsStarted()) {
+                // The result is in the body already
+                strReply = ",\"error\":null,\"id\":" + jreq.id.write() + "}\n";
+            } else {
+                strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            }
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(jreq, valRequest.get_array());
+            strReply = JSONRPCExecBatch(jreq, valRequest.get_array(), gArgs.GetArg("-rpcbatchconcurrency", DEFAULT_HTTP_BATCH_CONCURRENCY), QueueHTTPWork);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
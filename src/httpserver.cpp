@@ -66,6 +66,20 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item which runs a plain function, used by request handlers to spread their work over the workers */
+class HTTPFunctionWorkItem final : public HTTPClosure
+{
+public:
+    explicit HTTPFunctionWorkItem(std::function<void()> _func) : func(std::move(_func)) {}
+    void operator()() override
+    {
+        func();
+    }
+
+private:
+    std::function<void()> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -276,6 +290,17 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
     }
 }
 
+bool QueueHTTPWork(std::function<void()> func)
+{
+    assert(workQueue);
+    std::unique_ptr<HTTPFunctionWorkItem> item(new HTTPFunctionWorkItem(std::move(func)));
+    if (!workQueue->Enqueue(item.get())) {
+        return false;
+    }
+    item.release(); /* queue took ownership */
+    return true;
+}
+
 /** Callback to reject HTTP requests after shutdown. */
 static void http_reject_request_cb(struct evhttp_request* req, void*)
 {
@@ -577,6 +602,23 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  * Replies must be sent in the main loop in the main http thread,
  * this cannot be done from worker threads.
  */
+void HTTPRequest::WriteBody(const char* data, size_t len)
+{
+    assert(!replySent && req);
+    // The output buffer is only touched by the main http thread after WriteReply
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    evbuffer_add(evb, data, len);
+}
+
+void HTTPRequest::DiscardBody()
+{
+    assert(!replySent && req);
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    evbuffer_drain(evb, evbuffer_get_length(evb));
+}
+
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
     assert(!replySent && req);
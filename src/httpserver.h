@@ -12,6 +12,7 @@
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+static const int DEFAULT_HTTP_BATCH_CONCURRENCY=4;
 
 struct evhttp_request;
 struct event_base;
@@ -32,6 +33,12 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Run func on one of the HTTP worker threads.
+ * Returns false if the work queue is full, in which case func is not run.
+ * May be called from within request handlers only, queued work is dropped on shutdown.
+ */
+bool QueueHTTPWork(std::function<void()> func);
+
 /** Change logging level for libevent. Removes BCLog::LIBEVENT from logCategories if
  * libevent doesn't support debug logging.*/
 bool UpdateHTTPServerLogging(bool enable);
@@ -105,6 +112,17 @@ public:
      */
     void WriteHeader(const std::string& hdr, const std::string& value);
 
+    /**
+     * Append to the body of the reply, which is sent by WriteReply.
+     * Allows writing large replies piecewise without assembling them in a string first.
+     */
+    void WriteBody(const char* data, size_t len);
+
+    /**
+     * Discard everything written with WriteBody so far.
+     */
+    void DiscardBody();
+
     /**
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
@@ -0,0 +1,131 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockfilterindex.h>
+
+#include <chain.h>
+#include <undo.h>
+#include <util.h>
+#include <utilmemory.h>
+#include <validation.h>
+
+/* The index database stores one entry per block, keyed by the block hash.
+ * Each entry holds the filter hash, the filter header and the encoded filter
+ * itself. Basic filters of Dash blocks are small enough to be kept in LevelDB
+ * instead of separate flat files.
+ */
+constexpr char DB_BLOCK_HASH = 's';
+
+namespace {
+
+struct DBVal {
+    uint256 hash;
+    uint256 header;
+    std::vector<unsigned char> encoded_filter;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(header);
+        READWRITE(encoded_filter);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+BlockFilterIndex::BlockFilterIndex(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "blockfilter" / "basic", n_cache_size, f_memory, f_wipe))
+{}
+
+BlockFilterIndex::~BlockFilterIndex() {}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo block_undo;
+    uint256 prev_header;
+
+    if (pindex->nHeight > 0) {
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        DBVal prev_entry;
+        if (!m_db->Read(std::make_pair(DB_BLOCK_HASH, pindex->pprev->GetBlockHash()), prev_entry)) {
+            return error("%s: previous block %s of %s is not indexed", __func__,
+                         pindex->pprev->GetBlockHash().ToString(), pindex->GetBlockHash().ToString());
+        }
+        prev_header = prev_entry.header;
+    }
+
+    BlockFilter filter(BlockFilterType::BASIC_FILTER, block, block_undo);
+
+    DBVal value;
+    value.hash = filter.GetHash();
+    value.header = filter.ComputeHeader(prev_header);
+    value.encoded_filter = filter.GetEncodedFilter();
+    return m_db->Write(std::make_pair(DB_BLOCK_HASH, pindex->GetBlockHash()), value);
+}
+
+BaseIndex::DB& BlockFilterIndex::GetDB() const { return *m_db; }
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
+{
+    DBVal entry;
+    if (!m_db->Read(std::make_pair(DB_BLOCK_HASH, block_index->GetBlockHash()), entry)) {
+        return false;
+    }
+
+    filter_out = BlockFilter(BlockFilterType::BASIC_FILTER, block_index->GetBlockHash(), std::move(entry.encoded_filter));
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
+{
+    DBVal entry;
+    if (!m_db->Read(std::make_pair(DB_BLOCK_HASH, block_index->GetBlockHash()), entry)) {
+        return false;
+    }
+
+    header_out = entry.header;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterRange(int start_height, const CBlockIndex* stop_index,
+                                         std::vector<BlockFilter>& filters_out) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight) {
+        return error("%s: start height %d is out of range [0, %d]", __func__, start_height, stop_index->nHeight);
+    }
+
+    filters_out.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        if (!LookupFilter(pindex, filters_out[pindex->nHeight - start_height])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
+                                             std::vector<uint256>& hashes_out) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight) {
+        return error("%s: start height %d is out of range [0, %d]", __func__, start_height, stop_index->nHeight);
+    }
+
+    hashes_out.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        DBVal entry;
+        if (!m_db->Read(std::make_pair(DB_BLOCK_HASH, pindex->GetBlockHash()), entry)) {
+            return false;
+        }
+        hashes_out[pindex->nHeight - start_height] = entry.hash;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/timestampindex.h>
+
+#include <chain.h>
+#include <spentindex.h>
+#include <util.h>
+#include <utilmemory.h>
+
+constexpr char DB_TIMESTAMPINDEX = 's';
+
+std::unique_ptr<TimestampIndex> g_timestampindex;
+
+TimestampIndex::TimestampIndex(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "timestampindex", n_cache_size, f_memory, f_wipe))
+{}
+
+TimestampIndex::~TimestampIndex() {}
+
+bool TimestampIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return m_db->Write(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())), 0);
+}
+
+BaseIndex::DB& TimestampIndex::GetDB() const { return *m_db; }
+
+static void FindBlockHashes(CDBIterator& cursor, unsigned int high, unsigned int low, std::vector<uint256>& hashes)
+{
+    cursor.Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+
+    while (cursor.Valid()) {
+        std::pair<char, CTimestampIndexKey> key;
+        if (cursor.GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
+            hashes.push_back(key.second.blockHash);
+            cursor.Next();
+        } else {
+            break;
+        }
+    }
+}
+
+bool TimestampIndex::FindBlockHashes(unsigned int high, unsigned int low, std::vector<uint256>& hashes) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    ::FindBlockHashes(*pcursor, high, low, hashes);
+    return true;
+}
+
+bool TimestampIndex::FindBlockHashes(const std::vector<std::pair<unsigned int, unsigned int>>& ranges, std::vector<std::vector<uint256>>& hashesRet) const
+{
+    // creating an iterator takes a snapshot of the db, which is shared by all ranges
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    hashesRet.assign(ranges.size(), std::vector<uint256>());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        ::FindBlockHashes(*pcursor, ranges[i].first, ranges[i].second, hashesRet[i]);
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TIMESTAMPINDEX_H
+#define BITCOIN_INDEX_TIMESTAMPINDEX_H
+
+#include <index/base.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * TimestampIndex maps block timestamps to the hashes of the blocks, it backs
+ * the getblockhashes RPC. It only needs the block index entries, so syncing
+ * doesn't read any block files.
+ */
+class TimestampIndex final : public BaseIndex
+{
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool NeedsBlockData() const override { return false; }
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "timestampindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit TimestampIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~TimestampIndex() override;
+
+    /// Look up the hashes of all indexed blocks with low <= timestamp <= high.
+    bool FindBlockHashes(unsigned int high, unsigned int low, std::vector<uint256>& hashes) const;
+
+    /// Look up the hashes of multiple (high, low) timestamp ranges with a single iterator, hashesRet[i] for ranges[i].
+    bool FindBlockHashes(const std::vector<std::pair<unsigned int, unsigned int>>& ranges, std::vector<std::vector<uint256>>& hashesRet) const;
+};
+
+/// The global timestamp index, used in GetTimestampIndex. May be null.
+extern std::unique_ptr<TimestampIndex> g_timestampindex;
+
+#endif // BITCOIN_INDEX_TIMESTAMPINDEX_H
@@ -13,15 +13,20 @@
 #include <addrman.h>
 #include <amount.h>
 #include <base58.h>
+#include <blockfilemap.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <compressor.h>
 #include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <index/blockfilterindex.h>
+#include <index/timestampindex.h>
 #include <key.h>
 #include <validation.h>
 #include <miner.h>
@@ -31,9 +36,11 @@
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
+#include <profiler.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <rpc/blockchain.h>
+#include <rpc/snapshot.h>
 #include <script/standard.h>
 #include <script/sigcache.h>
 #include <scheduler.h>
@@ -48,6 +55,7 @@
 
 #include <masternode/activemasternode.h>
 #include <coinjoin/coinjoin-server.h>
+#include <ctpl.h>
 #include <dsnotificationinterface.h>
 #include <flat-database.h>
 #include <governance/governance.h>
@@ -62,9 +70,14 @@
 #include <walletinitinterface.h>
 
 #include <evo/deterministicmns.h>
+#include <llmq/quorums.h>
 #include <llmq/quorums_init.h>
 #include <llmq/quorums_blockprocessor.h>
+#include <llmq/quorums_dkgsession.h>
+#include <llmq/quorums_dkgsessionhandler.h>
 #include <llmq/quorums_signing.h>
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_signing_shares.h>
 #include <llmq/quorums_utils.h>
 
 #include <statsd_client.h>
@@ -87,6 +100,7 @@
 #include <openssl/crypto.h>
 
 #if ENABLE_ZMQ
+#include <zmq/zmqabstractnotifier.h>
 #include <zmq/zmqnotificationinterface.h>
 #include <zmq/zmqrpc.h>
 #endif
@@ -220,6 +234,12 @@ void Interrupt()
     InterruptMapPort();
     if (g_connman)
         g_connman->Interrupt();
+    if (g_timestampindex) {
+        g_timestampindex->Interrupt();
+    }
+    if (g_blockfilterindex) {
+        g_blockfilterindex->Interrupt();
+    }
 }
 
 /** Preparing steps before shutting down or restarting the wallet */
@@ -236,6 +256,7 @@ void PrepareShutdown()
     /// Be sure that anything that writes files or flushes caches only does this if the respective
     /// module was initialized.
     RenameThread("dash-shutoff");
+    StopProfiler();
     mempool.AddTransactionsUpdated(1);
     StopHTTPRPC();
     StopREST();
@@ -255,6 +276,7 @@ void PrepareShutdown()
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
+    coinJoinServer.Stop();
     // if (g_txindex) g_txindex->Stop(); //TODO watch out when backporting bitcoin#13033 (don't accidently put the reset here, as we've already backported bitcoin#13894)
 
     StopTorControl();
@@ -263,6 +285,7 @@ void PrepareShutdown()
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    statsClient.Stop();
 
     // After there are no more peers/RPC left to give us new data which may generate
     // CValidationInterface callbacks, flush them...
@@ -270,28 +293,35 @@ void PrepareShutdown()
 
     if (!fRPCInWarmup) {
         // STORE DATA CACHES INTO SERIALIZED DAT FILES
-        CFlatDB<CMasternodeMetaMan> flatdb1("mncache.dat", "magicMasternodeCache");
-        flatdb1.Dump(mmetaman);
+        mmetaman.FlushCache(true);
         CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
         flatdb4.Dump(netfulfilledman);
         CFlatDB<CSporkManager> flatdb6("sporks.dat", "magicSporkCache");
         flatdb6.Dump(sporkManager);
         if (!fDisableGovernance) {
-            CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
-            flatdb3.Dump(governance);
+            governance.FlushCache(true);
         }
     }
+    governance.CloseCache();
+    mmetaman.CloseCache();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     peerLogic.reset();
     g_connman.reset();
+    g_timestampindex.reset();
+    g_blockfilterindex.reset();
     //g_txindex.reset(); //TODO watch out when backporting bitcoin#13033 (re-enable this, was backported via bitcoin#13894)
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
     }
 
+    if (gArgs.GetBoolArg("-persistsigcache", DEFAULT_PERSIST_SIG_CACHE)) {
+        DumpSignatureCache();
+        DumpScriptExecutionCache();
+    }
+
     if (fFeeEstimatesInitialized)
     {
         ::feeEstimator.FlushUnconfirmed();
@@ -319,15 +349,22 @@ void PrepareShutdown()
     // up with our current chain to avoid any strange pruning edge cases and make
     // next startup faster by avoiding rescan.
 
+    StopCoinsPrefetchThreads();
+    StopBackgroundPruneThread();
+    StopSnapshotValidationThread();
+
     {
         LOCK(cs_main);
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
+            DumpBlockIndexSnapshot();
         }
         pcoinsTip.reset();
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
+        g_block_file_maps.reset();
+        SetRPCChainSnapshotTip(nullptr);
         llmq::DestroyLLMQSystem();
         deterministicMNManager.reset();
         evoDb.reset();
@@ -387,6 +424,7 @@ void Shutdown()
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopAsyncLogging();
 }
 
 /**
@@ -469,42 +507,58 @@ void SetupServerArgs()
     // When adding new options to the categories, please keep and ensure alphabetical ordering.
     gArgs.AddArg("-?", "Print this help message and exit", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-assumechainlocked", strprintf("Skip script verification of InstantSend locked transactions in ChainLocked blocks (default: %u)", DEFAULT_ASSUME_CHAINLOCKED), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>", "Specify blocks directory (default: <datadir>/blocks)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockmmapfiles=<n>", strprintf("Keep up to <n> finalized block and undo files memory mapped to speed up reading blocks (0 to disable, default: %u)", DEFAULT_BLOCK_MMAP_FILES), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to operate in a blocks only mode (default: %u)", DEFAULT_BLOCKSONLY), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prefetchcoinsthreads=<n>", strprintf("Number of threads loading the inputs of a block from the database before connecting it (0 to disable, default: %d)", DEFAULT_PREFETCH_COINS_THREADS), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbflushthreads=<n>", strprintf("Number of threads used to serialize coins when flushing the coins cache (0 or 1 to serialize while writing, default: %u)", nDefaultDbFlushThreads), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Set database cache size in megabytes (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbprofile=<db>:<profile>", strprintf("Use the LevelDB tuning profile <profile> for the database in the directory <db>, e.g. chainstate, index, evodb, llmq or governance. Can be specified multiple times. Profiles: %s (default: %s, others use default)", GetDBProfileNames(), GetDefaultDBProfiles()), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dmnlistcache=<n>", strprintf("Maximum memory in MiB used to keep snapshots of historic masternode lists, which speeds up queries for old lists (0 to disable, default: %d)", DEFAULT_HISTORIC_MN_LISTS_CACHE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (0 to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-loadsnapshot=<file>", "Load a UTXO snapshot written by dumptxoutset into a new data directory on startup and validate the blocks below its base in the background. "
+            "Only use snapshots whose hash_serialized_2 matches gettxoutsetinfo of a node you trust at the same height. Incompatible with -prune, -reindex, -reindex-chainstate, "
+            "-addressindex, -addressbalanceindex, -spentindex and -blockfilterindex until the validation is finished", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantxsize=<n>", strprintf("Maximum total size of all orphan transactions in megabytes (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxrecsigsage=<n>", strprintf("Number of seconds to keep LLMQ recovery sigs (default: %u)", llmq::DEFAULT_MAX_RECOVERED_SIGS_AGE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-mnsyncpipelined", strprintf("Request governance data from all peers at once right after reaching the best header and finish the masternode sync as soon as all peers answered instead of waiting for timeouts (default: %u)", DEFAULT_MNSYNC_PIPELINED), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-schedulerthreads=<n>", strprintf("Set the number of threads running scheduled tasks and notifications (minimum: %d, default: %d)", 1 + VALIDATION_DEDICATED_QUEUES, DEFAULT_SCHEDULER_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-persistsigcache", strprintf("Whether to save the signature and script execution caches on shutdown and load them on restart (default: %u)", DEFAULT_PERSIST_SIG_CACHE), false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), false, OptionsCategory::OPTIONS);
 #endif
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex, -rescan and -disablegovernance=false. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prunethrottle=<n>", strprintf("Milliseconds to wait between deleting two pruned block files and between compacting two database slices in the background (0 = no throttling, default: %d)", DEFAULT_PRUNE_THROTTLE_MS), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-storep2pkuncompressed", strprintf("Store coins and undo data paying to uncompressed public keys without compressing the key. This takes 34 more bytes per coin, but saves an EC point decompression whenever such a coin is read. Existing data stays readable either way (default: %u)", DEFAULT_STORE_P2PK_UNCOMPRESSED), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-syncmempool", strprintf("Sync mempool from other nodes on start (default: %u)", DEFAULT_SYNC_MEMPOOL), false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", false, OptionsCategory::OPTIONS);
 #endif
     gArgs.AddArg("-version", "Print version and exit", false, OptionsCategory::OPTIONS);
 
+    gArgs.AddArg("-addressbalanceindex", strprintf("Maintain running balance totals for every address, makes getaddressbalance independent of the address history; requires -addressindex (default: %u)", DEFAULT_ADDRESSBALANCEINDEX), false, OptionsCategory::INDEXING);
+    gArgs.AddArg("-blockfilterindex", strprintf("Maintain an index of BIP 158 basic block filters, built in the background (default: %u)", DEFAULT_BLOCKFILTERINDEX), false, OptionsCategory::INDEXING);
     gArgs.AddArg("-addressindex", strprintf("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)", DEFAULT_ADDRESSINDEX), false, OptionsCategory::INDEXING);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", false, OptionsCategory::INDEXING);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks", false, OptionsCategory::INDEXING);
     gArgs.AddArg("-spentindex", strprintf("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)", DEFAULT_SPENTINDEX), false, OptionsCategory::INDEXING);
-    gArgs.AddArg("-timestampindex", strprintf("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)", DEFAULT_TIMESTAMPINDEX), false, OptionsCategory::INDEXING);
+    gArgs.AddArg("-timestampindex", strprintf("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps. The index is built in the background and can be enabled without -reindex (default: %u)", DEFAULT_TIMESTAMPINDEX), false, OptionsCategory::INDEXING);
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), false, OptionsCategory::INDEXING);
 
     gArgs.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info). This option can be specified multiple times to add multiple nodes.", false, OptionsCategory::CONNECTION);
@@ -516,18 +570,21 @@ void SetupServerArgs()
     gArgs.AddArg("-discover", "Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-dns", strprintf("Allow DNS lookups for -addnode, -seednode and -connect (default: %u)", DEFAULT_NAME_LOOKUP), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-dnsseed", "Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect used)", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-dnstimeout=<n>", strprintf("Specify the timeout for DNS lookups in milliseconds, seeds are looked up in parallel (minimum: 1, default: %d)", DEFAULT_LOOKUP_TIMEOUT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-enablebip61", strprintf("Send reject messages per BIP61 (default: %u)", DEFAULT_ENABLE_BIP61), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-externalip=<ip>", "Specify your own public address", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-forcednsseed", strprintf("Always query for peer addresses via DNS lookup (default: %u)", DEFAULT_FORCEDNSSEED), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listen", "Accept connections from outside (default: 1 if no -proxy or -connect)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listenonion", strprintf("Automatically create Tor hidden service (default: %d)", DEFAULT_LISTEN_ONION), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxconnections=<n>", strprintf("Maintain at most <n> connections to peers (temporary service connections excluded) (default: %u)", DEFAULT_MAX_PEER_CONNECTIONS), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-msghandthreads=<n>", strprintf("Number of threads processing peer messages, peers are assigned to the threads by their id (1 to %d, default: %d)", MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS), true, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxreceivebuffer=<n>", strprintf("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXRECEIVEBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: -proxy)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-peerblockfilters", strprintf("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)", DEFAULT_PEERBLOCKFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peertimeout=<n>", strprintf("Specify p2p connection timeout in seconds. This option determines the amount of time a peer may be inactive before the connection to it is dropped. (minimum: 1, default: %d)", DEFAULT_PEER_CONNECT_TIMEOUT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-permitbaremultisig", strprintf("Relay non-P2SH multisig (default: %u)", DEFAULT_PERMIT_BAREMULTISIG), false, OptionsCategory::CONNECTION);
@@ -560,6 +617,8 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashrecoveredsig=<address>", "Enable publish message hash of recovered signatures (recovered by LLMQs) in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxlock=<address>", "Enable publish hash transaction (locked via InstantSend) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhwm=<n>", strprintf("Set publish outbound message high water mark, messages beyond it are dropped (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubmempooldelta=<address>", "Enable publish batches of mempool and InstantSend lock changes in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawinstantsenddoublespend=<address>", "Enable publish raw transactions of attempted InstantSend double spend in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawrecoveredsig=<address>", "Enable publish raw recovered signatures (recovered by LLMQs) in <address>", false, OptionsCategory::ZMQ);
@@ -567,8 +626,10 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubrawtxlock=<address>", "Enable publish raw transaction (locked via InstantSend) in <address>", false, OptionsCategory::ZMQ);
 #endif
 
+    gArgs.AddArg("-capturemessages", "Capture all received P2P messages to one file per peer in <datadir>/message_capture, which can be replayed with dash-replay", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checkblockstime=<n>", strprintf("Stop checking blocks at startup after this many seconds, to bound the startup time with a large -checkblocks (default: %u, 0 = no limit)", DEFAULT_CHECKBLOCKSTIME), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checklevel=<n>", strprintf("How thorough the block verification of -checkblocks is (0-4, default: %u)", DEFAULT_CHECKLEVEL), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), true, OptionsCategory::DEBUG_TEST);
@@ -582,6 +643,7 @@ void SetupServerArgs()
     gArgs.AddArg("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-vbparams=<deployment>:<start>:<end>(:<window>:<threshold>)", "Use given start/end times for specified version bits deployment (regtest-only). Specifying window and threshold is optional.", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-watchquorums=<n>", strprintf("Watch and validate quorum communication (default: %u)", llmq::DEFAULT_WATCH_QUORUMS), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-watchrecsigs=<n>", strprintf("Receive the recovered signatures of all quorums without watching their DKGs, uses much less bandwidth and CPU than -watchquorums (default: %u)", llmq::DEFAULT_WATCH_RECSIGS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-addrmantest", "Allows to test address relay on localhost", true, OptionsCategory::DEBUG_TEST);
 
     gArgs.AddArg("-debug=<category>", strprintf("Output debugging information (default: %u, supplying <category> is optional)", 0) + ". " +
@@ -595,6 +657,9 @@ void SetupServerArgs()
     gArgs.AddArg("-llmqdevnetparams=<size:threshold>", strprintf("Override the default LLMQ size for the LLMQ_DEVNET quorum (default: %u:%u)", devnetLLMQ.size, devnetLLMQ.threshold), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-llmqinstantsend=<quorum name>", strprintf("Override the default LLMQ type used for InstantSend on a devnet. Allows using InstantSend with smaller LLMQs. (default: %s)", devnetConsensus.llmqs.at(devnetConsensus.llmqTypeInstantSend).name), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-llmqtestparams=<size:threshold>", strprintf("Override the default LLMQ size for the LLMQ_TEST quorum (default: %u:%u)", regtestLLMQ.size, regtestLLMQ.threshold), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logasync", strprintf("Write debug.log from a dedicated thread instead of the logging threads (default: %u)", DEFAULT_LOGASYNC), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logasyncbuffer=<n>", strprintf("Size of the log buffer of each thread in KiB when -logasync is set (default: %u)", DEFAULT_LOGASYNCBUFFER), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logasyncdrop", strprintf("Drop log messages instead of waiting when the log buffer of a thread is full. The number of dropped messages is logged (default: %u)", DEFAULT_LOGASYNCDROP), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logthreadnames", strprintf("Add thread names to debug messages (default: %u)", DEFAULT_LOGTHREADNAMES), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), true, OptionsCategory::DEBUG_TEST);
@@ -609,6 +674,7 @@ void SetupServerArgs()
     gArgs.AddArg("-printpriority", strprintf("Log transaction fee per kB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printtoconsole", "Send trace/debug info to console instead of debug.log file", false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printtodebuglog", strprintf("Send trace/debug info to debug.log file (default: %u)", 1), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-profiler=<n>", strprintf("Sample the stacks of the running threads <n> times per second, for the getprofile RPC. Only supported on Linux builds with stacktraces (0-%d, default: %d)", MAX_PROFILER_FREQUENCY, DEFAULT_PROFILER_FREQUENCY), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-shrinkdebugfile", "Shrink debug.log file on client startup (default: 1 when no -debug)", false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-sporkaddr=<dashaddress>", "Override spork address. Only useful for regtest and devnet. Using this on mainnet or testnet will ban you.", false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-sporkkey=<privatekey>", "Set the private key to be used for signing spork messages.", false, OptionsCategory::DEBUG_TEST);
@@ -617,7 +683,14 @@ void SetupServerArgs()
     SetupChainParamsBaseOptions();
 
     gArgs.AddArg("-llmq-data-recovery=<n>", strprintf("Enable automated quorum data recovery (default: %u)", llmq::DEFAULT_ENABLE_QUORUM_DATA_RECOVERY), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-dkg-early-phase", strprintf("Move on to the next DKG phase as soon as all messages expected for the current phase were received and verified (default: %u)", llmq::DEFAULT_DKG_EARLY_PHASE_COMPLETION), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-dkg-parallel-verify", strprintf("Decrypt and verify received DKG contributions in parallel on all BLS worker threads (default: %u)", llmq::DEFAULT_DKG_PARALLEL_VERIFY), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-fast-transport", strprintf("Process the messages of verified masternode connections on a dedicated thread and push own LLMQ sig shares directly to intra-quorum peers (default: %u)", DEFAULT_MASTERNODE_FAST_TRANSPORT), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-islock-index-mem=<n>", strprintf("Maximum memory in MiB used to keep an index of all InstantSend locks by input and txid in memory (0 to disable, default: %u)", llmq::DEFAULT_ISLOCK_INDEX_MEMORY), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-precompute-pubkeyshares", strprintf("Calculate the public key shares of all members of new quorums in parallel and store them in the database (default: %u)", llmq::DEFAULT_PRECOMPUTE_PUBKEY_SHARES), false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-llmq-qvvec-sync=<quorum_name>:<mode>", strprintf("Defines from which LLMQ type the masternode should sync quorum verification vectors. Can be used multiple times with different LLMQ types. <mode>: %d (sync always from all quorums of the type defined by <quorum_name>), %d (sync from all quorums of the type defined by <quorum_name> if a member of any of the quorums)", (int32_t)llmq::QvvecSyncMode::Always, (int32_t)llmq::QvvecSyncMode::OnlyIfTypeMember), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-signing-max-mem=<n>", strprintf("Maximum memory in MiB used for LLMQ sig shares, signing sessions and not yet verified recovered signatures. Sessions of inactive quorums are evicted first, sessions we signed ourselves never (0 to disable, default: %u)", llmq::DEFAULT_SIGNING_MAX_MEMORY), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-llmq-sigshares-threads=<n>", strprintf("Number of threads used to sign and recover LLMQ signatures. Signing sessions are distributed over these threads by LLMQ type (1 to %d, default: %d)", llmq::MAX_SIGSHARES_THREADS, llmq::DEFAULT_SIGSHARES_THREADS), false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-masternodeblsprivkey=<hex>", "Set the masternode BLS private key and enable the client to act as a masternode", false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-platform-user=<user>", "Set the username for the \"platform user\", a restricted user intended to be used by Dash Platform, to the specified username.", false, OptionsCategory::MASTERNODE);
 
@@ -639,6 +712,7 @@ void SetupServerArgs()
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcuser. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcbatchconcurrency=<n>", strprintf("Maximum number of elements of a JSON-RPC batch request which are executed in parallel, using the threads of -rpcthreads. Limits how much of the RPC thread pool a single connection can occupy, 1 executes them sequentially (default: %d)", DEFAULT_HTTP_BATCH_CONCURRENCY), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpccookiefile=<loc>", "Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", false, OptionsCategory::RPC);
@@ -869,6 +943,45 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
     g_is_mempool_loaded = !fRequestShutdown;
 }
 
+/**
+ * The masternode meta, governance and fulfilled requests caches only depend on the chain tip being known, but not on
+ * each other or on the wallet, so they are loaded in parallel while AppInitMain continues with the wallet. Each task
+ * returns false on failure, the error messages are kept with the futures so that they are reported in the usual order.
+ */
+using CacheLoadTask = std::pair<std::future<bool>, std::string>;
+
+static std::vector<CacheLoadTask> StartLoadCacheData(ctpl::thread_pool& pool, bool fLoadCacheFiles)
+{
+    fs::path pathDB = GetDataDir();
+    std::vector<CacheLoadTask> vTasks;
+
+    vTasks.emplace_back(pool.push([fLoadCacheFiles](int) {
+        return mmetaman.LoadCache(!fLoadCacheFiles);
+    }), _("Failed to load masternode cache from") + "\n" + (pathDB / "mnmeta").string());
+
+    vTasks.emplace_back(pool.push([fLoadCacheFiles](int) {
+        if (!governance.LoadCache(!fLoadCacheFiles || fDisableGovernance)) {
+            return false;
+        }
+        if (fLoadCacheFiles && !fDisableGovernance) {
+            governance.InitOnLoad();
+        }
+        return true;
+    }), _("Failed to load governance cache from") + "\n" + (pathDB / "governance.dat").string());
+
+    std::string strDBName = "netfulfilled.dat";
+    vTasks.emplace_back(pool.push([fLoadCacheFiles, strDBName](int) {
+        CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
+        if (fLoadCacheFiles) {
+            return flatdb4.Load(netfulfilledman);
+        }
+        CNetFulfilledRequestManager netfulfilledmanTmp;
+        return flatdb4.Dump(netfulfilledmanTmp);
+    }), (fLoadCacheFiles ? _("Failed to load fulfilled requests cache from") : _("Failed to clear fulfilled requests cache at")) + "\n" + (pathDB / strDBName).string());
+
+    return vTasks;
+}
+
 void PeriodicStats()
 {
     assert(gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE));
@@ -912,6 +1025,20 @@ void PeriodicStats()
     // No need for cs_main, we never use null tip here
     statsClient.gaugeDouble("network.difficulty", (double)GetDifficulty(tip));
 
+    for (const auto& it : GetMainSignals().GetQueueDepths()) {
+        statsClient.gauge("validationinterface.queueDepth." + it.first, it.second, 1.0f);
+    }
+
+    for (const auto& it : scheduler.getTaskStats()) {
+        const CScheduler::TaskStats& taskStats = it.second;
+        statsClient.gauge("scheduler." + it.first + ".runs", taskStats.nRuns, 1.0f);
+        statsClient.gauge("scheduler." + it.first + ".totalMicros", taskStats.nTotalMicros, 1.0f);
+        statsClient.gauge("scheduler." + it.first + ".maxMicros", taskStats.nMaxMicros, 1.0f);
+        for (size_t i = 0; i < taskStats.vBuckets.size(); i++) {
+            statsClient.gauge(strprintf("scheduler.%s.runtimeBucket%d", it.first, i), taskStats.vBuckets[i], 1.0f);
+        }
+    }
+
     statsClient.gauge("transactions.txCacheSize", pcoinsTip->GetCacheSize(), 1.0f);
     statsClient.gauge("transactions.totalTransactions", tip->nChainTx, 1.0f);
 
@@ -919,6 +1046,29 @@ void PeriodicStats()
     statsClient.gauge("transactions.mempool.totalTxBytes", (int64_t) mempool.GetTotalTxSize(), 1.0f);
     statsClient.gauge("transactions.mempool.memoryUsageBytes", (int64_t) mempool.DynamicMemoryUsage(), 1.0f);
     statsClient.gauge("transactions.mempool.minFeePerKb", mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK(), 1.0f);
+
+    if (g_connman) {
+        for (const auto& p : g_connman->GetTotalMsgProcessStats()) {
+            statsClient.gauge("processing.message." + p.first + ".count", p.second.nCount, 1.0f);
+            statsClient.gauge("processing.message." + p.first + ".totalTimeUs", p.second.nTime, 1.0f);
+            statsClient.gauge("processing.message." + p.first + ".totalCpuTimeUs", p.second.nCPUTime, 1.0f);
+        }
+    }
+
+    std::vector<LockStats> vLockStats = GetLockStats();
+    for (size_t i = 0; i < vLockStats.size() && i < STATSD_MAX_LOCK_SITES; i++) {
+        const LockStats& lockStats = vLockStats[i];
+        std::string strSite = lockStats.strName + "." + fs::path(lockStats.strFile).filename().string() + "_" + std::to_string(lockStats.nLine);
+        for (char& c : strSite) {
+            if (!isalnum((unsigned char)c) && c != '_') c = '_';
+        }
+        statsClient.gauge("locks." + strSite + ".contentions", lockStats.nContentions, 1.0f);
+        statsClient.gauge("locks." + strSite + ".waitTotalUs", lockStats.nWaitTime, 1.0f);
+        statsClient.gauge("locks." + strSite + ".waitMaxUs", lockStats.nMaxWaitTime, 1.0f);
+        statsClient.gauge("locks." + strSite + ".holdSamples", lockStats.nHoldSamples, 1.0f);
+        statsClient.gauge("locks." + strSite + ".holdTotalUs", lockStats.nHoldTime, 1.0f);
+        statsClient.gauge("locks." + strSite + ".holdMaxUs", lockStats.nMaxHoldTime, 1.0f);
+    }
 }
 
 /** Sanity checks
@@ -1047,8 +1197,7 @@ void InitParameterInteraction()
     // (we must reconnect blocks whenever we disconnect them for these indexes to work)
     bool fAdditionalIndexes =
         gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
-        gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+        gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
 
     if (fAdditionalIndexes && gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
         gArgs.ForceSetArg("-checklevel", "4");
@@ -1180,6 +1329,17 @@ bool AppInitParameterInteraction()
         if (!gArgs.GetBoolArg("-disablegovernance", false)) {
             return InitError(_("Prune mode is incompatible with -disablegovernance=false."));
         }
+        if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
+    }
+
+    // Basic filters are the only supported type; serving them requires the index
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS) && !gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+    }
+
+    if (gArgs.GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX) && !gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        return InitError(_("-addressbalanceindex requires -addressindex."));
     }
 
     if (gArgs.IsArgSet("-devnet")) {
@@ -1276,6 +1436,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fStoreP2PKUncompressed = gArgs.GetBoolArg("-storep2pkuncompressed", DEFAULT_STORE_P2PK_UNCOMPRESSED);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1283,6 +1444,10 @@ bool AppInitParameterInteraction()
     else
         LogPrintf("Validating signatures for all blocks.\n");
 
+    fAssumeChainLocked = gArgs.GetBoolArg("-assumechainlocked", DEFAULT_ASSUME_CHAINLOCKED);
+    if (fAssumeChainLocked)
+        LogPrintf("Assuming InstantSend locked transactions in ChainLocked blocks have valid signatures.\n");
+
     if (gArgs.IsArgSet("-minimumchainwork")) {
         const std::string minChainWorkStr = gArgs.GetArg("-minimumchainwork", "");
         if (!IsHexNumber(minChainWorkStr)) {
@@ -1297,6 +1462,11 @@ bool AppInitParameterInteraction()
         LogPrintf("Warning: nMinimumChainWork set below default value of %s\n", chainparams.GetConsensus().nMinimumChainWork.GetHex());
     }
 
+    std::string strDBProfileError;
+    if (!CheckDBProfileArgs(strDBProfileError)) {
+        return InitError(strDBProfileError);
+    }
+
     // mempool limits
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nMempoolSizeMin = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
@@ -1351,6 +1521,11 @@ bool AppInitParameterInteraction()
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
     }
 
+    nLookupTimeout = gArgs.GetArg("-dnstimeout", DEFAULT_LOOKUP_TIMEOUT);
+    if (nLookupTimeout <= 0) {
+        nLookupTimeout = DEFAULT_LOOKUP_TIMEOUT;
+    }
+
     peer_connect_timeout = gArgs.GetArg("-peertimeout", DEFAULT_PEER_CONNECT_TIMEOUT);
     if (peer_connect_timeout <= 0) {
         return InitError("peertimeout cannot be configured with a negative value.");
@@ -1405,6 +1580,9 @@ bool AppInitParameterInteraction()
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS))
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+
     nMaxTipAge = gArgs.GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
     if (gArgs.IsArgSet("-vbparams")) {
@@ -1652,6 +1830,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string x11_algo = X11AutoDetect();
+    LogPrintf("Using the '%s' X11 implementation\n", x11_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1695,6 +1875,10 @@ bool AppInitMain()
         if (!OpenDebugLog()) {
             return InitError(strprintf("Could not open debug log file %s", GetDebugLogPath().string()));
         }
+        if (gArgs.GetBoolArg("-logasync", DEFAULT_LOGASYNC)) {
+            int64_t nBufferSize = std::max<int64_t>(1, gArgs.GetArg("-logasyncbuffer", DEFAULT_LOGASYNCBUFFER));
+            StartAsyncLogging((size_t)nBufferSize * 1024, gArgs.GetBoolArg("-logasyncdrop", DEFAULT_LOGASYNCDROP));
+        }
     }
 
     if (!fLogTimestamps)
@@ -1715,6 +1899,11 @@ bool AppInitMain()
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    if (gArgs.GetBoolArg("-persistsigcache", DEFAULT_PERSIST_SIG_CACHE)) {
+        // Most transactions of the first blocks after a restart were already verified when they entered the mempool
+        LoadSignatureCache();
+        LoadScriptExecutionCache();
+    }
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
@@ -1722,6 +1911,26 @@ bool AppInitMain()
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    int64_t nBlockMmapFiles = gArgs.GetArg("-blockmmapfiles", DEFAULT_BLOCK_MMAP_FILES);
+    if (nBlockMmapFiles > 0) {
+#ifndef WIN32
+        if (sizeof(void*) >= 8) {
+            g_block_file_maps.reset(new CBlockFileMapCache((size_t)nBlockMmapFiles));
+            LogPrintf("Keeping up to %d block files memory mapped\n", nBlockMmapFiles);
+        } else {
+            InitWarning(_("Memory mapping block files (-blockmmapfiles) is only supported on 64 bit systems, ignoring it."));
+        }
+#else
+        InitWarning(_("Memory mapping block files (-blockmmapfiles) is not supported on Windows, ignoring it."));
+#endif
+    }
+
+    int nPrefetchCoinsThreads = std::min<int>(gArgs.GetArg("-prefetchcoinsthreads", DEFAULT_PREFETCH_COINS_THREADS), MAX_SCRIPTCHECK_THREADS);
+    if (nPrefetchCoinsThreads > 0) {
+        StartCoinsPrefetchThreads(nPrefetchCoinsThreads);
+        LogPrintf("Using %d threads for prefetching block inputs\n", nPrefetchCoinsThreads);
+    }
+
     std::vector<std::string> vSporkAddresses;
     if (gArgs.IsArgSet("-sporkaddr")) {
         vSporkAddresses = gArgs.GetArgs("-sporkaddr");
@@ -1746,9 +1955,21 @@ bool AppInitMain()
         }
     }
 
-    // Start the lightweight task scheduler thread
+    const int nProfilerFrequency = gArgs.GetArg("-profiler", DEFAULT_PROFILER_FREQUENCY);
+    if (nProfilerFrequency != 0) {
+        std::string strError;
+        if (!StartProfiler(nProfilerFrequency, strError)) {
+            return InitError(strprintf(_("Can't start the profiler: %s"), strError));
+        }
+    }
+
+    // Start the lightweight task scheduler threads, at least one more than the dedicated validation interface queues so
+    // that a slow subscriber doesn't hold up the others
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    const int nSchedulerThreads = std::max(1 + VALIDATION_DEDICATED_QUEUES, (int)gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS));
+    for (int i = 0; i < nSchedulerThreads; i++) {
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    }
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
@@ -1878,6 +2099,7 @@ bool AppInitMain()
     // see Step 2: parameter interactions for more information about these
     fListen = gArgs.GetBoolArg("-listen", DEFAULT_LISTEN);
     fDiscover = gArgs.GetBoolArg("-discover", true);
+    fCaptureMessages = gArgs.GetBoolArg("-capturemessages", false);
     fRelayTxes = !gArgs.GetBoolArg("-blocksonly", DEFAULT_BLOCKSONLY);
 
     for (const std::string& strAddr : gArgs.GetArgs("-externalip")) {
@@ -1892,7 +2114,7 @@ bool AppInitMain()
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
+        RegisterValidationInterface(g_zmq_notification_interface, VALIDATION_QUEUE_ZMQ);
     }
 #endif
 
@@ -1926,6 +2148,10 @@ bool AppInitMain()
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nTimestampIndexCache = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) ? std::min(nTotalCache / 16, nMaxTimestampIndexCache << 20) : 0;
+    nTotalCache -= nTimestampIndexCache;
+    int64_t nBlockFilterIndexCache = gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX) ? std::min(nTotalCache / 8, nMaxBlockFilterIndexCache << 20) : 0;
+    nTotalCache -= nBlockFilterIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1934,6 +2160,12 @@ bool AppInitMain()
     int64_t nEvoDbCache = 1024 * 1024 * 16; // TODO
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nTimestampIndexCache > 0) {
+        LogPrintf("* Using %.1fMiB for timestamp index database\n", nTimestampIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (nBlockFilterIndexCache > 0) {
+        LogPrintf("* Using %.1fMiB for basic block filter index database\n", nBlockFilterIndexCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1959,6 +2191,12 @@ bool AppInitMain()
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
+                SnapshotMetadata snapshotMetadata;
+                if (fReindexChainState && !fReset && pblocktree->ReadUTXOSnapshotMetadata(snapshotMetadata)) {
+                    // The blocks below the snapshot base may not be there yet, so the chainstate can't be rebuilt from them
+                    return InitError(_("-reindex-chainstate can't be used until the blocks below the loaded UTXO snapshot are validated, use -reindex instead."));
+                }
+                SetRPCChainSnapshotTip(nullptr);
                 llmq::DestroyLLMQSystem();
                 // Same logic as above with pblocktree
                 evoDb.reset();
@@ -2013,9 +2251,9 @@ bool AppInitMain()
                     break;
                 }
 
-                // Check for changed -timestampindex state
-                if (fTimestampIndex != gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -timestampindex");
+                // Check for changed -addressbalanceindex state
+                if (fAddressBalanceIndex != gArgs.GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -addressbalanceindex");
                     break;
                 }
 
@@ -2107,7 +2345,7 @@ bool AppInitMain()
                     }
 
                     if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS), gArgs.GetArg("-checkblockstime", DEFAULT_CHECKBLOCKSTIME))) {
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
@@ -2153,12 +2391,70 @@ bool AppInitMain()
         return false;
     }
 
+    if (gArgs.IsArgSet("-loadsnapshot")) {
+        fs::path snapshotPath = fs::absolute(gArgs.GetArg("-loadsnapshot", ""), GetDataDir());
+        if (chainActive.Height() != 0 || IsSnapshotValidationPending()) {
+            LogPrintf("Not loading UTXO snapshot %s, the chainstate is not empty\n", snapshotPath.string());
+        } else {
+            if (fPruneMode || fReindex || fReindexChainState) {
+                return InitError(_("-loadsnapshot is incompatible with -prune, -reindex and -reindex-chainstate."));
+            }
+            uiInterface.InitMessage(_("Loading UTXO snapshot..."));
+            std::string strError;
+            if (!LoadUTXOSnapshot(snapshotPath, strError)) {
+                if (ShutdownRequested()) {
+                    LogPrintf("Shutdown requested. Exiting.\n");
+                    return false;
+                }
+                return InitError(strError + "\n" + _("Delete the data directory except the wallets before loading the snapshot again."));
+            }
+        }
+    }
+
+    if (IsSnapshotValidationPending()) {
+        // These need all blocks below the snapshot base, or update indexes for every connected block
+        if (fPruneMode || fAddressIndex || fAddressBalanceIndex || fSpentIndex || gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+            return InitError(_("-prune, -addressindex, -addressbalanceindex, -spentindex and -blockfilterindex can't be used until the blocks below the loaded UTXO snapshot are validated."));
+        }
+    }
+
+    // ********************************************************* Step 7c: start loading cache data
+
+    // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE, finished in step 10b
+
+    bool fLoadCacheFiles = !(fReindex || fReindexChainState);
+    {
+        LOCK(cs_main);
+        // was blocks/chainstate deleted?
+        if (chainActive.Tip() == nullptr) {
+            fLoadCacheFiles = false;
+        }
+    }
+    int64_t nLoadCacheStart = GetTimeMillis();
+    std::unique_ptr<ctpl::thread_pool> loadCachePool(new ctpl::thread_pool(3));
+    RenameThreadPool(*loadCachePool, "dash-loadcache");
+    std::vector<CacheLoadTask> vLoadCacheTasks = StartLoadCacheData(*loadCachePool, fLoadCacheFiles);
+
+    // ********************************************************* Step 7d: start indexers
+    if (gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
+        g_timestampindex = MakeUnique<TimestampIndex>(nTimestampIndexCache, false, fReindex);
+        g_timestampindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        g_blockfilterindex = MakeUnique<BlockFilterIndex>(nBlockFilterIndexCache, false, fReindex);
+        g_blockfilterindex->Start();
+    }
+
     fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
     if (!est_filein.IsNull())
         ::feeEstimator.Read(est_filein);
     fFeeEstimatesInitialized = true;
+    // The mempool and block connection only queue the fee estimator updates, they are applied in the background
+    scheduler.scheduleEvery(std::bind(&CBlockPolicyEstimator::ProcessPendingUpdates, std::ref(::feeEstimator)), 100,
+                            CScheduler::Priority::LOW, "feeestimator");
 
     // ********************************************************* Step 8: load wallet
     if (!g_wallet_init_interface.Open()) return false;
@@ -2182,6 +2478,16 @@ bool AppInitMain()
             uiInterface.InitMessage(_("Pruning blockstore..."));
             PruneAndFlush();
         }
+        // Files pruned from now on are deleted in the background
+        StartBackgroundPruneThread(gArgs.GetArg("-prunethrottle", DEFAULT_PRUNE_THROTTLE_MS));
+    }
+
+    // The blocks below the base of a loaded UTXO snapshot are downloaded and validated in the background, they can't
+    // be served to peers before that
+    if (IsSnapshotValidationPending()) {
+        LogPrintf("Unsetting NODE_NETWORK until the blocks below the UTXO snapshot are validated\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+        StartSnapshotValidationThread();
     }
 
     // As PruneAndFlush can take several minutes, it's possible the user
@@ -2226,81 +2532,47 @@ bool AppInitMain()
     g_wallet_init_interface.InitCoinJoinSettings();
     CCoinJoin::InitStandardDenominations();
 
-    // ********************************************************* Step 10b: Load cache data
-
-    // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
-
-    bool fLoadCacheFiles = !(fReindex || fReindexChainState);
-    {
-        LOCK(cs_main);
-        // was blocks/chainstate deleted?
-        if (chainActive.Tip() == nullptr) {
-            fLoadCacheFiles = false;
-        }
-    }
-    fs::path pathDB = GetDataDir();
-    std::string strDBName;
-
-    strDBName = "mncache.dat";
-    uiInterface.InitMessage(_("Loading masternode cache..."));
-    CFlatDB<CMasternodeMetaMan> flatdb1(strDBName, "magicMasternodeCache");
-    if (fLoadCacheFiles) {
-        if(!flatdb1.Load(mmetaman)) {
-            return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
-        }
-    } else {
-        CMasternodeMetaMan mmetamanTmp;
-        if(!flatdb1.Dump(mmetamanTmp)) {
-            return InitError(_("Failed to clear masternode cache at") + "\n" + (pathDB / strDBName).string());
-        }
-    }
-
-    strDBName = "governance.dat";
-    uiInterface.InitMessage(_("Loading governance cache..."));
-    CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
-    if (fLoadCacheFiles && !fDisableGovernance) {
-        if(!flatdb3.Load(governance)) {
-            return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
-        }
-        governance.InitOnLoad();
-    } else {
-        CGovernanceManager governanceTmp;
-        if(!flatdb3.Dump(governanceTmp)) {
-            return InitError(_("Failed to clear governance cache at") + "\n" + (pathDB / strDBName).string());
-        }
-    }
+    // ********************************************************* Step 10b: Wait for cache data
 
-    strDBName = "netfulfilled.dat";
-    uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
-    CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
-    if (fLoadCacheFiles) {
-        if(!flatdb4.Load(netfulfilledman)) {
-            return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / strDBName).string());
-        }
-    } else {
-        CNetFulfilledRequestManager netfulfilledmanTmp;
-        if(!flatdb4.Dump(netfulfilledmanTmp)) {
-            return InitError(_("Failed to clear fulfilled requests cache at") + "\n" + (pathDB / strDBName).string());
+    uiInterface.InitMessage(_("Loading masternode, governance and fulfilled requests caches..."));
+    for (auto& task : vLoadCacheTasks) {
+        if (!task.first.get()) {
+            return InitError(task.second);
         }
     }
+    loadCachePool.reset();
+    LogPrintf("Cache data loaded in the background, %dms since start of loading\n", GetTimeMillis() - nLoadCacheStart);
 
     // ********************************************************* Step 10c: schedule Dash-specific tasks
 
-    scheduler.scheduleEvery(std::bind(&CNetFulfilledRequestManager::DoMaintenance, std::ref(netfulfilledman)), 60 * 1000);
-    scheduler.scheduleEvery(std::bind(&CMasternodeSync::DoMaintenance, std::ref(masternodeSync), std::ref(*g_connman)), 1 * 1000);
-    scheduler.scheduleEvery(std::bind(&CMasternodeUtils::DoMaintenance, std::ref(*g_connman)), 1 * 1000);
+    scheduler.scheduleEvery(std::bind(&CNetFulfilledRequestManager::DoMaintenance, std::ref(netfulfilledman)), 60 * 1000,
+                            CScheduler::Priority::LOW, "netfulfilledman");
+    scheduler.scheduleEvery(std::bind(&CMasternodeMetaMan::FlushCache, std::ref(mmetaman), false), 60 * 1000,
+                            CScheduler::Priority::LOW, "mmetaman");
+    scheduler.scheduleEvery(std::bind(&CMasternodeSync::DoMaintenance, std::ref(masternodeSync), std::ref(*g_connman)), 1 * 1000,
+                            CScheduler::Priority::NORMAL, "masternodesync");
+    scheduler.scheduleEvery(std::bind(&CMasternodeUtils::DoMaintenance, std::ref(*g_connman)), 1 * 1000,
+                            CScheduler::Priority::NORMAL, "masternodeutils");
 
     if (!fDisableGovernance) {
-        scheduler.scheduleEvery(std::bind(&CGovernanceManager::DoMaintenance, std::ref(governance), std::ref(*g_connman)), 60 * 5 * 1000);
+        scheduler.scheduleEvery(std::bind(&CGovernanceManager::DoMaintenance, std::ref(governance), std::ref(*g_connman)), 60 * 5 * 1000,
+                                CScheduler::Priority::LOW, "governance");
+        scheduler.scheduleEvery(std::bind(&CGovernanceManager::ProcessPendingVotes, std::ref(governance), std::ref(*g_connman)), 100,
+                                CScheduler::Priority::NORMAL, "governancevotes");
     }
 
     if (fMasternodeMode) {
-        scheduler.scheduleEvery(std::bind(&CCoinJoinServer::DoMaintenance, std::ref(coinJoinServer), std::ref(*g_connman)), 1 * 1000);
+        coinJoinServer.Start();
+        scheduler.scheduleEvery(std::bind(&CCoinJoinServer::DoMaintenance, std::ref(coinJoinServer), std::ref(*g_connman)), 1 * 1000,
+                                CScheduler::Priority::NORMAL, "coinjoinserver");
+        scheduler.scheduleEvery(std::bind(&CCoinJoinServer::ProcessPendingDsqs, std::ref(coinJoinServer), std::ref(*g_connman)), 100,
+                                CScheduler::Priority::NORMAL, "coinjoinserverdsqs");
     }
 
     if (gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE)) {
+        statsClient.Start();
         int nStatsPeriod = std::min(std::max((int)gArgs.GetArg("-statsperiod", DEFAULT_STATSD_PERIOD), MIN_STATSD_PERIOD), MAX_STATSD_PERIOD);
-        scheduler.scheduleEvery(PeriodicStats, nStatsPeriod * 1000);
+        scheduler.scheduleEvery(PeriodicStats, nStatsPeriod * 1000, CScheduler::Priority::LOW, "stats");
     }
 
     llmq::StartLLMQSystem();
@@ -2354,7 +2626,7 @@ bool AppInitMain()
     //// debug print
     {
         LOCK(cs_main);
-        LogPrintf("mapBlockIndex.size() = %u\n", mapBlockIndex.size());
+        LogPrintf("mapBlockIndex.size() = %u (%u kB)\n", mapBlockIndex.size(), mapBlockIndex.DynamicMemoryUsage() / 1000);
         chain_active_height = chainActive.Height();
     }
     LogPrintf("chainActive.Height() = %d\n",   chain_active_height);
@@ -2380,6 +2652,8 @@ bool AppInitMain()
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
+    connOptions.nMessageHandlerThreads = gArgs.GetArg("-msghandthreads", DEFAULT_MESSAGE_HANDLER_THREADS);
+    connOptions.m_masternode_fast_transport = fMasternodeMode && gArgs.GetBoolArg("-llmq-fast-transport", DEFAULT_MASTERNODE_FAST_TRANSPORT);
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
@@ -178,6 +178,12 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    //! Get hashes of all wallet transactions, sorted like getWalletTxs().
+    virtual std::vector<uint256> getWalletTxHashes() = 0;
+
+    //! Get wallet transactions by hash, skipping hashes which aren't in the wallet (anymore).
+    virtual std::vector<WalletTx> getWalletTxs(const std::vector<uint256>& txids) = 0;
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
@@ -13,6 +13,7 @@
 #include <masternode/activemasternode.h>
 #include <chainparams.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <net.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
@@ -26,6 +27,7 @@ namespace llmq
 
 static const std::string DB_QUORUM_SK_SHARE = "q_Qsk";
 static const std::string DB_QUORUM_QUORUM_VVEC = "q_Qqvvec";
+static const std::string DB_QUORUM_PUBKEY_SHARES = "q_Qpkshares";
 
 CQuorumManager* quorumManager;
 
@@ -75,6 +77,18 @@ bool CQuorum::SetSecretKeyShare(const CBLSSecretKey& secretKeyShare)
     return true;
 }
 
+size_t CQuorum::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(qc.signers) + memusage::DynamicUsage(qc.validMembers) + memusage::DynamicUsage(members);
+    if (quorumVvec) {
+        usage += memusage::DynamicUsage(quorumVvec) + memusage::DynamicUsage(*quorumVvec);
+    }
+    if (fPubKeySharesReady) {
+        usage += memusage::DynamicUsage(pubKeyShares);
+    }
+    return usage + blsCache.DynamicMemoryUsage();
+}
+
 bool CQuorum::IsMember(const uint256& proTxHash) const
 {
     for (auto& dmn : members) {
@@ -100,8 +114,24 @@ CBLSPublicKey CQuorum::GetPubKeyShare(size_t memberIdx) const
     if (quorumVvec == nullptr || memberIdx >= members.size() || !qc.validMembers[memberIdx]) {
         return CBLSPublicKey();
     }
+    if (fPubKeySharesReady) {
+        return pubKeyShares[memberIdx];
+    }
+
     auto& m = members[memberIdx];
-    return blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId(m->proTxHash));
+
+    // blsCache is lost when the quorum is reloaded, so we also keep the (expensive to build) public key shares in the
+    // process wide BLS cache
+    uint256 cacheKey = ::SerializeHash(std::make_pair(qc.quorumVvecHash, m->proTxHash));
+    CBLSPublicKey pubKeyShare;
+    if (CBLSDecompressionCache::Get(cacheKey, pubKeyShare)) {
+        return pubKeyShare;
+    }
+    pubKeyShare = blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId(m->proTxHash));
+    if (pubKeyShare.IsValid()) {
+        CBLSDecompressionCache::Put(cacheKey, pubKeyShare);
+    }
+    return pubKeyShare;
 }
 
 const CBLSSecretKey& CQuorum::GetSkShare() const
@@ -149,10 +179,39 @@ bool CQuorum::ReadContributions(CEvoDB& evoDb)
     return true;
 }
 
+void CQuorum::SetPubKeyShares(std::vector<CBLSPublicKey>&& _pubKeyShares) const
+{
+    assert(_pubKeyShares.size() == members.size());
+    if (fPubKeySharesReady) {
+        return;
+    }
+    pubKeyShares = std::move(_pubKeyShares);
+    fPubKeySharesReady = true;
+}
+
+void CQuorum::WritePubKeyShares(CEvoDB& evoDb) const
+{
+    if (!fPubKeySharesReady) {
+        return;
+    }
+    evoDb.GetRawDB().Write(std::make_pair(DB_QUORUM_PUBKEY_SHARES, MakeQuorumKey(*this)), pubKeyShares);
+}
+
+bool CQuorum::ReadPubKeyShares(CEvoDB& evoDb) const
+{
+    std::vector<CBLSPublicKey> shares;
+    if (!evoDb.Read(std::make_pair(DB_QUORUM_PUBKEY_SHARES, MakeQuorumKey(*this)), shares) || shares.size() != members.size()) {
+        return false;
+    }
+    SetPubKeyShares(std::move(shares));
+    return true;
+}
+
 CQuorumManager::CQuorumManager(CEvoDB& _evoDb, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
     evoDb(_evoDb),
     blsWorker(_blsWorker),
-    dkgManager(_dkgManager)
+    dkgManager(_dkgManager),
+    fPrecomputePubKeyShares(gArgs.GetBoolArg("-llmq-precompute-pubkeyshares", DEFAULT_PRECOMPUTE_PUBKEY_SHARES))
 {
     CLLMQUtils::InitQuorumsCache(mapQuorumsCache);
     CLLMQUtils::InitQuorumsCache(scanQuorumsCache);
@@ -170,6 +229,10 @@ void CQuorumManager::Start()
     workerCount = std::max(std::min(1, workerCount), 4);
     workerPool.resize(workerCount);
     RenameThreadPool(workerPool, "dash-q-mngr");
+    if (fMasternodeMode && CLLMQUtils::QuorumDataRecoveryEnabled()) {
+        dataRecoveryPool.resize(QUORUM_DATA_RECOVERY_THREADS);
+        RenameThreadPool(dataRecoveryPool, "dash-q-recovery");
+    }
 }
 
 void CQuorumManager::Stop()
@@ -177,6 +240,8 @@ void CQuorumManager::Stop()
     quorumThreadInterrupt();
     workerPool.clear_queue();
     workerPool.stop(true);
+    dataRecoveryPool.clear_queue();
+    dataRecoveryPool.stop(true);
 }
 
 void CQuorumManager::TriggerQuorumDataRecoveryThreads(const CBlockIndex* pIndex) const
@@ -319,10 +384,14 @@ CQuorumPtr CQuorumManager::BuildQuorumFromCommitment(const Consensus::LLMQType l
         // pre-populate caches in the background
         // recovering public key shares is quite expensive and would result in serious lags for the first few signing
         // sessions if the shares would be calculated on-demand
-        StartCachePopulatorThread(quorum);
+        if (!fPrecomputePubKeyShares) {
+            StartCachePopulatorThread(quorum);
+        } else if (!quorum->ReadPubKeyShares(evoDb)) {
+            StartPubKeySharesPrecomputeThread(quorum);
+        }
     }
 
-    mapQuorumsCache[llmqType].insert(quorumHash, quorum);
+    mapQuorumsCache.at(llmqType).insert(quorumHash, quorum);
 
     return quorum;
 }
@@ -422,8 +491,7 @@ std::vector<CQuorumCPtr> CQuorumManager::ScanQuorums(Consensus::LLMQType llmqTyp
     std::vector<CQuorumCPtr> vecResultQuorums;
 
     {
-        LOCK(quorumsCacheCs);
-        auto& cache = scanQuorumsCache[llmqType];
+        auto& cache = scanQuorumsCache.at(llmqType);
         fCacheExists = cache.get(pindexStart->GetBlockHash(), vecResultQuorums);
         if (fCacheExists) {
             // We have exactly what requested so just return it
@@ -458,9 +526,8 @@ std::vector<CQuorumCPtr> CQuorumManager::ScanQuorums(Consensus::LLMQType llmqTyp
 
     size_t nCountResult{vecResultQuorums.size()};
     if (nCountResult > 0 && !fCacheExists) {
-        LOCK(quorumsCacheCs);
         // Don't cache more than cache.max_size() elements
-        auto& cache = scanQuorumsCache[llmqType];
+        auto& cache = scanQuorumsCache.at(llmqType);
         size_t nCacheEndIndex = std::min(nCountResult, cache.max_size());
         cache.emplace(pindexStart->GetBlockHash(), {vecResultQuorums.begin(), vecResultQuorums.begin() + nCacheEndIndex});
     }
@@ -469,6 +536,30 @@ std::vector<CQuorumCPtr> CQuorumManager::ScanQuorums(Consensus::LLMQType llmqTyp
     return {vecResultQuorums.begin(), vecResultQuorums.begin() + nResultEndIndex};
 }
 
+size_t CQuorumManager::GetMemoryUsage() const
+{
+    // quorums appear in both caches and in multiple scan results, collect them first so that they are counted once
+    std::set<CQuorumCPtr> quorums;
+    size_t usage = memusage::DynamicUsage(mapQuorumsCache) + memusage::DynamicUsage(scanQuorumsCache);
+    for (const auto& p : mapQuorumsCache) {
+        usage += p.second.DynamicMemoryUsage();
+        p.second.for_each([&](const uint256&, const CQuorumPtr& q) {
+            quorums.emplace(q);
+        });
+    }
+    for (const auto& p : scanQuorumsCache) {
+        usage += p.second.DynamicMemoryUsage();
+        p.second.for_each([&](const uint256&, const std::vector<CQuorumCPtr>& v) {
+            usage += memusage::DynamicUsage(v);
+            quorums.insert(v.begin(), v.end());
+        });
+    }
+    for (const auto& q : quorums) {
+        usage += memusage::DynamicUsage(q) + q->DynamicMemoryUsage();
+    }
+    return usage;
+}
+
 CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const uint256& quorumHash) const
 {
     CBlockIndex* pindexQuorum;
@@ -496,9 +587,15 @@ CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const CBlock
         return nullptr;
     }
 
-    LOCK(quorumsCacheCs);
     CQuorumPtr pQuorum;
-    if (mapQuorumsCache[llmqType].get(quorumHash, pQuorum)) {
+    auto& cache = mapQuorumsCache.at(llmqType);
+    if (cache.get(quorumHash, pQuorum)) {
+        return pQuorum;
+    }
+
+    // another thread might have built the quorum while we were waiting for the lock
+    LOCK(quorumsCacheCs);
+    if (cache.get(quorumHash, pQuorum)) {
         return pQuorum;
     }
 
@@ -507,24 +604,24 @@ CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const CBlock
 
 size_t CQuorumManager::GetQuorumRecoveryStartOffset(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex) const
 {
-    auto mns = deterministicMNManager->GetListForBlock(pIndex);
-    std::vector<uint256> vecProTxHashes;
-    vecProTxHashes.reserve(mns.GetValidMNsCount());
-    mns.ForEachMN(true, [&](const CDeterministicMNCPtr& pMasternode) {
-        vecProTxHashes.emplace_back(pMasternode->proTxHash);
-    });
-    std::sort(vecProTxHashes.begin(), vecProTxHashes.end());
+    // the index of this MN among all valid MNs sorted by proTxHash
+    auto view = deterministicMNManager->GetListForBlock(pIndex).GetView();
     size_t nIndex{0};
-    for (size_t i = 0; i < vecProTxHashes.size(); ++i) {
-        if (activeMasternodeInfo.proTxHash == vecProTxHashes[i]) {
-            nIndex = i;
+    size_t nValidIndex{0};
+    for (size_t i = 0; i < view->size(); ++i) {
+        if (!view->IsValid(i)) {
+            continue;
+        }
+        if (activeMasternodeInfo.proTxHash == view->proTxHashes[i]) {
+            nIndex = nValidIndex;
             break;
         }
+        nValidIndex++;
     }
     return nIndex % pQuorum->qc.validMembers.size();
 }
 
-void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand, CDataStream& vRecv)
+void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     auto strFunc = __func__;
     auto errorHandler = [&](const std::string strError, int nScore = 10) {
@@ -655,12 +752,9 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
         }
 
         CQuorumPtr pQuorum;
-        {
-            LOCK(quorumsCacheCs);
-            if (!mapQuorumsCache[request.GetLLMQType()].get(request.GetQuorumHash(), pQuorum)) {
-                errorHandler("Quorum not found", 0); // Don't bump score because we asked for it
-                return;
-            }
+        if (!mapQuorumsCache.at(request.GetLLMQType()).get(request.GetQuorumHash(), pQuorum)) {
+            errorHandler("Quorum not found", 0); // Don't bump score because we asked for it
+            return;
         }
 
         // Check if request has QUORUM_VERIFICATION_VECTOR data
@@ -669,8 +763,15 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
             BLSVerificationVector verficationVector;
             vRecv >> verficationVector;
 
-            if (pQuorum->SetVerificationVector(verficationVector)) {
-                StartCachePopulatorThread(pQuorum);
+            // Data recovery asks multiple members at the same time, only the first response is used
+            if (pQuorum->quorumVvec != nullptr) {
+                LogPrint(BCLog::LLMQ, "CQuorumManager::%s -- quorumVvec of %s already known\n", __func__, pQuorum->qc.quorumHash.ToString());
+            } else if (pQuorum->SetVerificationVector(verficationVector)) {
+                if (fPrecomputePubKeyShares) {
+                    StartPubKeySharesPrecomputeThread(pQuorum);
+                } else {
+                    StartCachePopulatorThread(pQuorum);
+                }
             } else {
                 errorHandler("Invalid quorum verification vector");
                 return;
@@ -691,16 +792,18 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
                 return;
             }
 
+            if (pQuorum->skShare.IsValid()) {
+                LogPrint(BCLog::LLMQ, "CQuorumManager::%s -- skShare of %s already known\n", __func__, pQuorum->qc.quorumHash.ToString());
+                return;
+            }
+
             std::vector<CBLSIESEncryptedObject<CBLSSecretKey>> vecEncrypted;
             vRecv >> vecEncrypted;
 
             BLSSecretKeyVector vecSecretKeys;
-            vecSecretKeys.resize(vecEncrypted.size());
-            for (size_t i = 0; i < vecEncrypted.size(); ++i) {
-                if (!vecEncrypted[i].Decrypt(memberIdx, *activeMasternodeInfo.blsKeyOperator, vecSecretKeys[i], PROTOCOL_VERSION)) {
-                    errorHandler("Failed to decrypt");
-                    return;
-                }
+            if (!DecryptContributions(vecEncrypted, memberIdx, vecSecretKeys)) {
+                errorHandler("Failed to decrypt");
+                return;
             }
 
             CBLSSecretKey secretKeyShare = blsWorker.AggregateSecretKeys(vecSecretKeys);
@@ -714,6 +817,31 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
     }
 }
 
+bool CQuorumManager::DecryptContributions(const std::vector<CBLSIESEncryptedObject<CBLSSecretKey>>& vecEncrypted, size_t memberIdx, BLSSecretKeyVector& vecSecretKeysRet) const
+{
+    vecSecretKeysRet.resize(vecEncrypted.size());
+
+    // spread the contributions over all BLS worker threads, each thread writes to distinct entries only
+    const size_t workerCount = std::max<size_t>(1, blsWorker.GetWorkerCount());
+    const size_t chunkSize = (vecEncrypted.size() + workerCount - 1) / workerCount;
+    std::atomic<bool> fFailed{false};
+    std::vector<std::future<void>> futures;
+    for (size_t start = 0; start < vecEncrypted.size(); start += chunkSize) {
+        const size_t end = std::min(start + chunkSize, vecEncrypted.size());
+        futures.emplace_back(blsWorker.AsyncRun([&vecEncrypted, &vecSecretKeysRet, &fFailed, memberIdx, start, end]() {
+            for (size_t i = start; i < end && !fFailed; ++i) {
+                if (!vecEncrypted[i].Decrypt(memberIdx, *activeMasternodeInfo.blsKeyOperator, vecSecretKeysRet[i], PROTOCOL_VERSION)) {
+                    fFailed = true;
+                }
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    return !fFailed;
+}
+
 void CQuorumManager::StartCachePopulatorThread(const CQuorumCPtr pQuorum) const
 {
     if (pQuorum->quorumVvec == nullptr) {
@@ -734,6 +862,46 @@ void CQuorumManager::StartCachePopulatorThread(const CQuorumCPtr pQuorum) const
     });
 }
 
+void CQuorumManager::StartPubKeySharesPrecomputeThread(const CQuorumCPtr pQuorum) const
+{
+    if (pQuorum->quorumVvec == nullptr) {
+        return;
+    }
+
+    cxxtimer::Timer t(true);
+    LogPrint(BCLog::LLMQ, "CQuorumManager::StartPubKeySharesPrecomputeThread -- start\n");
+
+    workerPool.push([pQuorum, t, this](int threadId) {
+        const size_t memberCount = pQuorum->members.size();
+        std::vector<CBLSPublicKey> shares(memberCount);
+
+        // spread the members over all BLS worker threads, each thread writes to distinct entries only
+        size_t workerCount = std::max<size_t>(1, blsWorker.GetWorkerCount());
+        size_t chunkSize = (memberCount + workerCount - 1) / workerCount;
+        std::vector<std::future<void>> futures;
+        for (size_t start = 0; start < memberCount; start += chunkSize) {
+            size_t end = std::min(start + chunkSize, memberCount);
+            futures.emplace_back(blsWorker.AsyncRun([pQuorum, &shares, start, end, this]() {
+                for (size_t i = start; i < end && !quorumThreadInterrupt; i++) {
+                    if (pQuorum->qc.validMembers[i]) {
+                        shares[i] = blsWorker.BuildPubKeyShare(pQuorum->quorumVvec, CBLSId(pQuorum->members[i]->proTxHash));
+                    }
+                }
+            }));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+        if (quorumThreadInterrupt) {
+            return;
+        }
+
+        pQuorum->SetPubKeyShares(std::move(shares));
+        pQuorum->WritePubKeyShares(evoDb);
+        LogPrint(BCLog::LLMQ, "CQuorumManager::StartPubKeySharesPrecomputeThread -- done. time=%d\n", t.count());
+    });
+}
+
 void CQuorumManager::StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex, uint16_t nDataMaskIn) const
 {
     if (pQuorum->fQuorumDataRecoveryThreadRunning) {
@@ -742,19 +910,18 @@ void CQuorumManager::StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, co
     }
     pQuorum->fQuorumDataRecoveryThreadRunning = true;
 
-    workerPool.push([pQuorum, pIndex, nDataMaskIn, this](int threadId) {
+    dataRecoveryPool.push([pQuorum, pIndex, nDataMaskIn, this](int threadId) {
         size_t nTries{0};
         uint16_t nDataMask{nDataMaskIn};
-        int64_t nTimeLastSuccess{0};
-        uint256* pCurrentMemberHash{nullptr};
+        // Members which are asked right now, with the time of the connection attempt or of the last request
+        std::map<uint256, int64_t> mapPendingMembers;
         std::vector<uint256> vecMemberHashes;
         const size_t nMyStartOffset{GetQuorumRecoveryStartOffset(pQuorum, pIndex)};
         const int64_t nRequestTimeout{10};
 
-        auto printLog = [&](const std::string& strMessage) {
-            const std::string strMember{pCurrentMemberHash == nullptr ? "nullptr" : pCurrentMemberHash->ToString()};
-            LogPrint(BCLog::LLMQ, "CQuorumManager::StartQuorumDataRecoveryThread -- %s - for llmqType %d, quorumHash %s, nDataMask (%d/%d), pCurrentMemberHash %s, nTries %d\n",
-                strMessage, pQuorum->qc.llmqType, pQuorum->qc.quorumHash.ToString(), nDataMask, nDataMaskIn, strMember, nTries);
+        auto printLog = [&](const std::string& strMessage, const uint256& memberHash = uint256()) {
+            LogPrint(BCLog::LLMQ, "CQuorumManager::StartQuorumDataRecoveryThread -- %s - for llmqType %d, quorumHash %s, nDataMask (%d/%d), memberHash %s, nTries (%d/%d), nPending %d\n",
+                strMessage, pQuorum->qc.llmqType, pQuorum->qc.quorumHash.ToString(), nDataMask, nDataMaskIn, memberHash.ToString(), nTries, vecMemberHashes.size(), mapPendingMembers.size());
         };
         printLog("Start");
 
@@ -763,6 +930,7 @@ void CQuorumManager::StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, co
         }
 
         if (quorumThreadInterrupt) {
+            pQuorum->fQuorumDataRecoveryThreadRunning = false;
             printLog("Aborted");
             return;
         }
@@ -794,56 +962,75 @@ void CQuorumManager::StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, co
                 break;
             }
 
-            if ((GetAdjustedTime() - nTimeLastSuccess) > nRequestTimeout) {
-                if (nTries >= vecMemberHashes.size()) {
-                    printLog("All tried but failed");
-                    break;
+            // Give up on members which didn't connect or respond in time, their slots go to the next members
+            const int64_t nTimeNow = GetAdjustedTime();
+            for (auto it = mapPendingMembers.begin(); it != mapPendingMembers.end();) {
+                if ((nTimeNow - it->second) > nRequestTimeout) {
+                    printLog("Timeout", it->first);
+                    it = mapPendingMembers.erase(it);
+                } else {
+                    ++it;
                 }
+            }
+
+            // Every member is tried once, retries happen with the next recovery which is triggered by the next block
+            bool fSleptForOffset{false};
+            while (mapPendingMembers.size() < QUORUM_DATA_RECOVERY_PARALLEL_REQUESTS && nTries < vecMemberHashes.size() && !quorumThreadInterrupt) {
                 // Access the member list of the quorum with the calculated offset applied to balance the load equally
-                pCurrentMemberHash = &vecMemberHashes[(nMyStartOffset + nTries++) % vecMemberHashes.size()];
+                const uint256& memberHash = vecMemberHashes[(nMyStartOffset + nTries++) % vecMemberHashes.size()];
                 {
                     LOCK(cs_data_requests);
-                    auto it = mapQuorumDataRequests.find(std::make_pair(*pCurrentMemberHash, true));
+                    auto it = mapQuorumDataRequests.find(std::make_pair(memberHash, true));
                     if (it != mapQuorumDataRequests.end() && !it->second.IsExpired()) {
-                        printLog("Already asked");
+                        printLog("Already asked", memberHash);
                         continue;
                     }
                 }
                 // Sleep a bit depending on the start offset to balance out multiple requests to same masternode
-                quorumThreadInterrupt.sleep_for(std::chrono::milliseconds(nMyStartOffset * 100));
-                nTimeLastSuccess = GetAdjustedTime();
-                g_connman->AddPendingMasternode(*pCurrentMemberHash);
-                printLog("Connect");
+                if (!fSleptForOffset) {
+                    quorumThreadInterrupt.sleep_for(std::chrono::milliseconds(nMyStartOffset * 100));
+                    fSleptForOffset = true;
+                }
+                mapPendingMembers.emplace(memberHash, GetAdjustedTime());
+                g_connman->AddPendingMasternode(memberHash);
+                printLog("Connect", memberHash);
             }
 
+            if (mapPendingMembers.empty()) {
+                printLog("All tried but failed");
+                break;
+            }
+
+            std::vector<uint256> vecDone;
             g_connman->ForEachNode([&](CNode* pNode) {
 
-                if (pCurrentMemberHash == nullptr || pNode->verifiedProRegTxHash != *pCurrentMemberHash) {
+                auto itPending = mapPendingMembers.find(pNode->verifiedProRegTxHash);
+                if (pNode->verifiedProRegTxHash.IsNull() || itPending == mapPendingMembers.end()) {
                     return;
                 }
 
                 if (quorumManager->RequestQuorumData(pNode, pQuorum->qc.llmqType, pQuorum->pindexQuorum, nDataMask, activeMasternodeInfo.proTxHash)) {
-                    nTimeLastSuccess = GetAdjustedTime();
-                    printLog("Requested");
+                    itPending->second = GetAdjustedTime();
+                    printLog("Requested", itPending->first);
                 } else {
                     LOCK(cs_data_requests);
                     auto it = mapQuorumDataRequests.find(std::make_pair(pNode->verifiedProRegTxHash, true));
                     if (it == mapQuorumDataRequests.end()) {
-                        printLog("Failed");
+                        printLog("Failed", itPending->first);
                         pNode->fDisconnect = true;
-                        pCurrentMemberHash = nullptr;
-                        return;
+                        vecDone.emplace_back(itPending->first);
                     } else if (it->second.IsProcessed()) {
-                        printLog("Processed");
+                        printLog("Processed", itPending->first);
                         pNode->fDisconnect = true;
-                        pCurrentMemberHash = nullptr;
-                        return;
+                        vecDone.emplace_back(itPending->first);
                     } else {
-                        printLog("Waiting");
-                        return;
+                        printLog("Waiting", itPending->first);
                     }
                 }
             });
+            for (const auto& memberHash : vecDone) {
+                mapPendingMembers.erase(memberHash);
+            }
             quorumThreadInterrupt.sleep_for(std::chrono::seconds(1));
         }
         pQuorum->fQuorumDataRecoveryThreadRunning = false;
@@ -16,6 +16,7 @@
 #include <threadinterrupt.h>
 
 #include <bls/bls.h>
+#include <bls/bls_ies.h>
 #include <bls/bls_worker.h>
 
 #include <ctpl.h>
@@ -27,6 +28,15 @@ namespace llmq
 
 // If true, we will connect to all new quorums and watch their communication
 static const bool DEFAULT_WATCH_QUORUMS = false;
+// If true, we will connect to one member of all quorums to receive their recovered sigs, without watching their DKGs
+static const bool DEFAULT_WATCH_RECSIGS = false;
+// If true, all public key shares of a quorum are calculated in parallel right after the quorum was built and stored in
+// the evo DB, so that they don't have to be recalculated after restarts
+static const bool DEFAULT_PRECOMPUTE_PUBKEY_SHARES = false;
+// Number of members which are asked for the missing data of a quorum at the same time during data recovery
+static const size_t QUORUM_DATA_RECOVERY_PARALLEL_REQUESTS = 3;
+// Number of threads which run data recoveries, each one recovers one quorum at a time
+static const int QUORUM_DATA_RECOVERY_THREADS = 8;
 
 class CDKGSessionManager;
 
@@ -164,6 +174,11 @@ private:
     mutable CBLSWorkerCache blsCache;
     mutable std::atomic<bool> fQuorumDataRecoveryThreadRunning{false};
 
+    // Only filled when public key shares are precomputed (see DEFAULT_PRECOMPUTE_PUBKEY_SHARES). Indexed by member index,
+    // entries for invalid members are invalid. Must not be accessed before fPubKeySharesReady is set
+    mutable std::vector<CBLSPublicKey> pubKeyShares;
+    mutable std::atomic<bool> fPubKeySharesReady{false};
+
 public:
     CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker);
     ~CQuorum();
@@ -179,9 +194,16 @@ public:
     CBLSPublicKey GetPubKeyShare(size_t memberIdx) const;
     const CBLSSecretKey& GetSkShare() const;
 
+    // Memory owned by the quorum. Members are shared with the MN lists and not counted
+    size_t DynamicMemoryUsage() const;
+
 private:
     void WriteContributions(CEvoDB& evoDb);
     bool ReadContributions(CEvoDB& evoDb);
+
+    void SetPubKeyShares(std::vector<CBLSPublicKey>&& _pubKeyShares) const;
+    void WritePubKeyShares(CEvoDB& evoDb) const;
+    bool ReadPubKeyShares(CEvoDB& evoDb) const;
 };
 
 /**
@@ -196,12 +218,18 @@ private:
     CEvoDB& evoDb;
     CBLSWorker& blsWorker;
     CDKGSessionManager& dkgManager;
+    const bool fPrecomputePubKeyShares;
 
+    // only serializes the building of quorums, the caches are thread-safe on their own and the maps are filled once
+    // in the constructor
     mutable CCriticalSection quorumsCacheCs;
-    mutable std::map<Consensus::LLMQType, unordered_lru_cache<uint256, CQuorumPtr, StaticSaltedHasher>> mapQuorumsCache;
-    mutable std::map<Consensus::LLMQType, unordered_lru_cache<uint256, std::vector<CQuorumCPtr>, StaticSaltedHasher>> scanQuorumsCache;
+    mutable std::map<Consensus::LLMQType, concurrent_unordered_lru_cache<uint256, CQuorumPtr, StaticSaltedHasher>> mapQuorumsCache;
+    mutable std::map<Consensus::LLMQType, concurrent_unordered_lru_cache<uint256, std::vector<CQuorumCPtr>, StaticSaltedHasher>> scanQuorumsCache;
 
     mutable ctpl::thread_pool workerPool;
+    // data recovery threads spend most of their time waiting for responses, they get their own pool so that they don't
+    // hold up the other jobs and the recovery of all quorums can run at the same time after a restart
+    mutable ctpl::thread_pool dataRecoveryPool;
     mutable CThreadInterrupt quorumThreadInterrupt;
 
 public:
@@ -215,7 +243,7 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *pindexNew, bool fInitialDownload) const;
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv);
 
     static bool HasQuorum(Consensus::LLMQType llmqType, const uint256& quorumHash);
 
@@ -228,6 +256,9 @@ public:
     // this one is cs_main-free
     std::vector<CQuorumCPtr> ScanQuorums(Consensus::LLMQType llmqType, const CBlockIndex* pindexStart, size_t nCountRequested) const;
 
+    // Memory used by the quorum caches, including the cached quorums
+    size_t GetMemoryUsage() const;
+
 private:
     // all private methods here are cs_main-free
     void EnsureQuorumConnections(Consensus::LLMQType llmqType, const CBlockIndex *pindexNew) const;
@@ -241,7 +272,11 @@ private:
     /// should receive the same number of request if all active llmqType members requests data from one llmqType quorum.
     size_t GetQuorumRecoveryStartOffset(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex) const;
 
+    /// Decrypts the contributions for the member at memberIdx on all BLS worker threads
+    bool DecryptContributions(const std::vector<CBLSIESEncryptedObject<CBLSSecretKey>>& vecEncrypted, size_t memberIdx, BLSSecretKeyVector& vecSecretKeysRet) const;
+
     void StartCachePopulatorThread(const CQuorumCPtr pQuorum) const;
+    void StartPubKeySharesPrecomputeThread(const CQuorumCPtr pQuorum) const;
     void StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex, uint16_t nDataMask) const;
 };
 
@@ -5,6 +5,8 @@
 #include <llmq/quorums_blockprocessor.h>
 #include <llmq/quorums_debug.h>
 
+#include <bls/bls_batchverifier.h>
+
 #include <evo/specialtx.h>
 
 #include <chain.h>
@@ -31,7 +33,7 @@ CQuorumBlockProcessor::CQuorumBlockProcessor(CEvoDB &_evoDb) :
     CLLMQUtils::InitQuorumsCache(mapHasMinedCommitmentCache);
 }
 
-void CQuorumBlockProcessor::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CQuorumBlockProcessor::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     if (strCommand == NetMsgType::QFCOMMITMENT) {
         CFinalCommitment qc;
@@ -161,13 +163,29 @@ bool CQuorumBlockProcessor::ProcessBlock(const CBlock& block, const CBlockIndex*
 
     auto blockHash = block.GetHash();
 
-    for (auto& p : qcs) {
-        auto& qc = p.second;
-        if (!ProcessCommitment(pindex->nHeight, blockHash, qc, state, fJustCheck)) {
+    // The quorum signatures of all commitments are verified in one batch after all other checks have passed
+    CBLSBatchVerifier<uint256, uint256> quorumSigVerifier(true, false);
+    for (const auto& p : qcs) {
+        if (!CheckCommitment(pindex->nHeight, p.second, state, quorumSigVerifier)) {
             return false;
         }
     }
 
+    quorumSigVerifier.Verify();
+    if (!quorumSigVerifier.badSources.empty()) {
+        LogPrint(BCLog::LLMQ, "CQuorumBlockProcessor::%s -- invalid quorum signature in %d commitments\n", __func__,
+                 quorumSigVerifier.badSources.size());
+        return state.DoS(100, false, REJECT_INVALID, "bad-qc-invalid");
+    }
+
+    if (!fJustCheck) {
+        for (const auto& p : qcs) {
+            if (!p.second.IsNull()) {
+                StoreCommitment(pindex->nHeight, blockHash, p.second);
+            }
+        }
+    }
+
     evoDb.Write(DB_BEST_BLOCK_UPGRADE, blockHash);
 
     return true;
@@ -181,7 +199,7 @@ static std::tuple<std::string, Consensus::LLMQType, uint32_t> BuildInversedHeigh
     return std::make_tuple(DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT, llmqType, htobe32(std::numeric_limits<uint32_t>::max() - nMinedHeight));
 }
 
-bool CQuorumBlockProcessor::ProcessCommitment(int nHeight, const uint256& blockHash, const CFinalCommitment& qc, CValidationState& state, bool fJustCheck)
+bool CQuorumBlockProcessor::CheckCommitment(int nHeight, const CFinalCommitment& qc, CValidationState& state, CBLSBatchVerifier<uint256, uint256>& quorumSigVerifier)
 {
     auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)qc.llmqType);
 
@@ -218,13 +236,18 @@ bool CQuorumBlockProcessor::ProcessCommitment(int nHeight, const uint256& blockH
 
     auto quorumIndex = LookupBlockIndex(qc.quorumHash);
 
-    if (!qc.Verify(quorumIndex, true)) {
+    if (!qc.Verify(quorumIndex, true, &quorumSigVerifier)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-qc-invalid");
     }
 
-    if (fJustCheck) {
-        return true;
-    }
+    return true;
+}
+
+void CQuorumBlockProcessor::StoreCommitment(int nHeight, const uint256& blockHash, const CFinalCommitment& qc)
+{
+    const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)qc.llmqType);
+    const auto& quorumHash = qc.quorumHash;
+    auto quorumIndex = LookupBlockIndex(quorumHash);
 
     // Store commitment in DB
     auto cacheKey = std::make_pair(params.type, quorumHash);
@@ -240,8 +263,6 @@ bool CQuorumBlockProcessor::ProcessCommitment(int nHeight, const uint256& blockH
 
     LogPrint(BCLog::LLMQ, "CQuorumBlockProcessor::%s -- processed commitment from block. type=%d, quorumHash=%s, signers=%s, validMembers=%d, quorumPublicKey=%s\n", __func__,
               qc.llmqType, quorumHash.ToString(), qc.CountSigners(), qc.CountValidMembers(), qc.quorumPublicKey.ToString());
-
-    return true;
 }
 
 bool CQuorumBlockProcessor::UndoBlock(const CBlock& block, const CBlockIndex* pindex)
@@ -542,7 +563,7 @@ bool CQuorumBlockProcessor::GetMinableCommitmentByHash(const uint256& commitment
 
 // Will return false if no commitment should be mined
 // Will return true and a null commitment if no minable commitment is known and none was mined yet
-bool CQuorumBlockProcessor::GetMinableCommitment(Consensus::LLMQType llmqType, int nHeight, CFinalCommitment& ret)
+bool CQuorumBlockProcessor::GetRequiredCommitmentQuorum(Consensus::LLMQType llmqType, int nHeight, uint256& quorumHashRet)
 {
     AssertLockHeld(cs_main);
 
@@ -551,24 +572,35 @@ bool CQuorumBlockProcessor::GetMinableCommitment(Consensus::LLMQType llmqType, i
         return false;
     }
 
-    uint256 quorumHash = GetQuorumBlockHash(llmqType, nHeight);
-    if (quorumHash.IsNull()) {
+    quorumHashRet = GetQuorumBlockHash(llmqType, nHeight);
+    return !quorumHashRet.IsNull();
+}
+
+bool CQuorumBlockProcessor::GetMinableCommitment(Consensus::LLMQType llmqType, int nHeight, CFinalCommitment& ret)
+{
+    AssertLockHeld(cs_main);
+
+    uint256 quorumHash;
+    if (!GetRequiredCommitmentQuorum(llmqType, nHeight, quorumHash)) {
         return false;
     }
 
+    ret = GetBestMinableCommitment(llmqType, quorumHash);
+    return true;
+}
+
+CFinalCommitment CQuorumBlockProcessor::GetBestMinableCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash)
+{
     LOCK(minableCommitmentsCs);
 
     auto k = std::make_pair(llmqType, quorumHash);
     auto it = minableCommitmentsByQuorum.find(k);
     if (it == minableCommitmentsByQuorum.end()) {
         // null commitment required
-        ret = CFinalCommitment(Params().GetConsensus().llmqs.at(llmqType), quorumHash);
-        return true;
+        return CFinalCommitment(Params().GetConsensus().llmqs.at(llmqType), quorumHash);
     }
 
-    ret = minableCommitments.at(it->second);
-
-    return true;
+    return minableCommitments.at(it->second);
 }
 
 bool CQuorumBlockProcessor::GetMinableCommitmentTx(Consensus::LLMQType llmqType, int nHeight, CTransactionRef& ret)
@@ -592,4 +624,18 @@ bool CQuorumBlockProcessor::GetMinableCommitmentTx(Consensus::LLMQType llmqType,
     return true;
 }
 
+CTransactionRef CQuorumBlockProcessor::GetMinableCommitmentTx(Consensus::LLMQType llmqType, int nHeight, const uint256& quorumHash)
+{
+    CFinalCommitmentTxPayload qc;
+    qc.commitment = GetBestMinableCommitment(llmqType, quorumHash);
+    qc.nHeight = nHeight;
+
+    CMutableTransaction tx;
+    tx.nVersion = 3;
+    tx.nType = TRANSACTION_QUORUM_COMMITMENT;
+    SetTxPayload(tx, qc);
+
+    return MakeTransactionRef(tx);
+}
+
 } // namespace llmq
@@ -40,7 +40,7 @@ public:
 
     bool UpgradeDB();
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv);
 
     bool ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck);
     bool UndoBlock(const CBlock& block, const CBlockIndex* pindex);
@@ -50,6 +50,11 @@ public:
     bool GetMinableCommitmentByHash(const uint256& commitmentHash, CFinalCommitment& ret);
     bool GetMinableCommitment(Consensus::LLMQType llmqType, int nHeight, CFinalCommitment& ret);
     bool GetMinableCommitmentTx(Consensus::LLMQType llmqType, int nHeight, CTransactionRef& ret);
+    /** Find the quorum a block at nHeight has to mine a (possibly null) commitment for. Only depends on the chain up
+     *  to the previous block, so it can be determined before the commitment itself. */
+    bool GetRequiredCommitmentQuorum(Consensus::LLMQType llmqType, int nHeight, uint256& quorumHashRet);
+    /** Build a commitment tx for a quorum returned by GetRequiredCommitmentQuorum with the best commitment known now */
+    CTransactionRef GetMinableCommitmentTx(Consensus::LLMQType llmqType, int nHeight, const uint256& quorumHash);
 
     bool HasMinedCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash);
     bool GetMinedCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash, CFinalCommitment& ret, uint256& retMinedBlockHash);
@@ -59,10 +64,12 @@ public:
 
 private:
     static bool GetCommitmentsFromBlock(const CBlock& block, const CBlockIndex* pindex, std::map<Consensus::LLMQType, CFinalCommitment>& ret, CValidationState& state);
-    bool ProcessCommitment(int nHeight, const uint256& blockHash, const CFinalCommitment& qc, CValidationState& state, bool fJustCheck);
+    bool CheckCommitment(int nHeight, const CFinalCommitment& qc, CValidationState& state, CBLSBatchVerifier<uint256, uint256>& quorumSigVerifier);
+    void StoreCommitment(int nHeight, const uint256& blockHash, const CFinalCommitment& qc);
     static bool IsMiningPhase(Consensus::LLMQType llmqType, int nHeight);
     bool IsCommitmentRequired(Consensus::LLMQType llmqType, int nHeight);
     static uint256 GetQuorumBlockHash(Consensus::LLMQType llmqType, int nHeight);
+    CFinalCommitment GetBestMinableCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash);
 };
 
 extern CQuorumBlockProcessor* quorumBlockProcessor;
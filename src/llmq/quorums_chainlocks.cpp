@@ -4,6 +4,7 @@
 
 #include <llmq/quorums_chainlocks.h>
 #include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_latency.h>
 #include <llmq/quorums_utils.h>
 
 #include <chain.h>
@@ -54,7 +55,7 @@ void CChainLocksHandler::Start()
         EnforceBestChainLock();
         // regularly retry signing the current chaintip as it might have failed before due to missing islocks
         TrySignChainTip();
-    }, 5000);
+    }, 5000, CScheduler::Priority::HIGH, "chainlocks");
 }
 
 void CChainLocksHandler::Stop()
@@ -88,7 +89,7 @@ CChainLockSig CChainLocksHandler::GetBestChainLock()
     return bestChainLock;
 }
 
-void CChainLocksHandler::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CChainLocksHandler::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     if (!AreChainLocksEnabled()) {
         return;
@@ -175,10 +176,16 @@ void CChainLocksHandler::ProcessNewChainLock(const NodeId from, const llmq::CCha
         return;
     }
 
+    // cheap for CLSIGs of the tip, their quorum comes from the precomputed active quorum sets
+    auto llmqType = Params().GetConsensus().llmqTypeChainLocks;
+    auto quorum = quorumSigningManager->SelectQuorumForSigning(llmqType, requestId, clsig.nHeight);
+    pipelineLatencies.RecordStage(LatencyEvent::BLOCK_RECEIVED, clsig.blockHash, LatencyStage::CL_BLOCK_TO_CLSIG, true,
+                                  llmqType, quorum ? quorum->qc.quorumHash : uint256());
+
     scheduler->scheduleFromNow([&]() {
         CheckActiveState();
         EnforceBestChainLock();
-    }, 0);
+    }, 0, CScheduler::Priority::HIGH, "chainlocks");
 
     LogPrint(BCLog::CHAINLOCKS, "CChainLocksHandler::%s -- processed new CLSIG (%s), peer=%d\n",
               __func__, clsig.ToString(), from);
@@ -186,6 +193,11 @@ void CChainLocksHandler::ProcessNewChainLock(const NodeId from, const llmq::CCha
 
 void CChainLocksHandler::AcceptedBlockHeader(const CBlockIndex* pindexNew)
 {
+    // headers of the initial sync never get a CLSIG of their own
+    if (masternodeSync.IsBlockchainSynced()) {
+        pipelineLatencies.AddEvent(LatencyEvent::BLOCK_RECEIVED, pindexNew->GetBlockHash());
+    }
+
     LOCK(cs);
 
     if (pindexNew->GetBlockHash() == bestChainLock.blockHash) {
@@ -222,7 +234,7 @@ void CChainLocksHandler::UpdatedBlockTip(const CBlockIndex* pindexNew)
         TrySignChainTip();
         LOCK(cs);
         tryLockChainTipScheduled = false;
-    }, 0);
+    }, 0, CScheduler::Priority::HIGH, "chainlocks");
 }
 
 void CChainLocksHandler::CheckActiveState()
@@ -320,27 +332,12 @@ void CChainLocksHandler::TrySignChainTip()
                 break;
             }
 
-            auto txids = GetBlockTxs(pindexWalk->GetBlockHash());
-            if (!txids) {
-                pindexWalk = pindexWalk->pprev;
-                continue;
-            }
-
-            for (auto& txid : *txids) {
-                int64_t txAge = 0;
-                {
-                    LOCK(cs);
-                    auto it = txFirstSeenTime.find(txid);
-                    if (it != txFirstSeenTime.end()) {
-                        txAge = GetAdjustedTime() - it->second;
-                    }
-                }
-
-                if (txAge < WAIT_FOR_ISLOCK_TIMEOUT && !quorumInstantSendManager->IsLocked(txid)) {
-                    LogPrint(BCLog::CHAINLOCKS, "CChainLocksHandler::%s -- not signing block %s due to TX %s not being islocked and not old enough. age=%d\n", __func__,
-                              pindexWalk->GetBlockHash().ToString(), txid.ToString(), txAge);
-                    return;
-                }
+            uint256 unsafeTxid;
+            int64_t txAge;
+            if (!AreBlockTxsSafe(pindexWalk->GetBlockHash(), unsafeTxid, txAge)) {
+                LogPrint(BCLog::CHAINLOCKS, "CChainLocksHandler::%s -- not signing block %s due to TX %s not being islocked and not old enough. age=%d\n", __func__,
+                          pindexWalk->GetBlockHash().ToString(), unsafeTxid.ToString(), txAge);
+                return;
             }
 
             pindexWalk = pindexWalk->pprev;
@@ -374,6 +371,14 @@ void CChainLocksHandler::TransactionAddedToMempool(const CTransactionRef& tx, in
     txFirstSeenTime.emplace(tx->GetHash(), nAcceptTime);
 }
 
+void CChainLocksHandler::TransactionLocked(const CTransactionRef& tx)
+{
+    LOCK(cs);
+    for (auto& p : blockUnsafeTxs) {
+        p.second.erase(tx->GetHash());
+    }
+}
+
 void CChainLocksHandler::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted)
 {
     if (!masternodeSync.IsBlockchainSynced()) {
@@ -384,6 +389,16 @@ void CChainLocksHandler::BlockConnected(const std::shared_ptr<const CBlock>& pbl
     // We need this information later when we try to sign a new tip, so that we can determine if all included TXs are
     // safe.
 
+    // IsLocked must be called without holding cs
+    std::vector<uint256> lockedTxids;
+    if (IsInstantSendEnabled()) {
+        for (const auto& tx : pblock->vtx) {
+            if (!tx->IsCoinBase() && !tx->vin.empty() && quorumInstantSendManager->IsLocked(tx->GetHash())) {
+                lockedTxids.emplace_back(tx->GetHash());
+            }
+        }
+    }
+
     LOCK(cs);
 
     auto it = blockTxs.find(pindex->GetBlockHash());
@@ -405,12 +420,18 @@ void CChainLocksHandler::BlockConnected(const std::shared_ptr<const CBlock>& pbl
         txFirstSeenTime.emplace(tx->GetHash(), curTime);
     }
 
+    auto& unsafeTxids = blockUnsafeTxs[pindex->GetBlockHash()];
+    unsafeTxids = txids;
+    for (const auto& txid : lockedTxids) {
+        unsafeTxids.erase(txid);
+    }
 }
 
 void CChainLocksHandler::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected)
 {
     LOCK(cs);
     blockTxs.erase(pindexDisconnected->GetBlockHash());
+    blockUnsafeTxs.erase(pindexDisconnected->GetBlockHash());
 }
 
 CChainLocksHandler::BlockTxs::mapped_type CChainLocksHandler::GetBlockTxs(const uint256& blockHash)
@@ -462,6 +483,73 @@ CChainLocksHandler::BlockTxs::mapped_type CChainLocksHandler::GetBlockTxs(const
     return ret;
 }
 
+// Returns false if the block contains a TX which is neither islocked nor old enough. In that case, the first such TX
+// and its age are returned. Usually, all TXs of a block were islocked before, in which case this is O(1)
+bool CChainLocksHandler::AreBlockTxsSafe(const uint256& blockHash, uint256& unsafeTxidRet, int64_t& txAgeRet)
+{
+    AssertLockNotHeld(cs);
+
+    std::vector<uint256> toCheck;
+    bool fKnown = false;
+    {
+        LOCK(cs);
+        auto it = blockUnsafeTxs.find(blockHash);
+        if (it != blockUnsafeTxs.end()) {
+            if (it->second.empty()) {
+                return true;
+            }
+            fKnown = true;
+            toCheck.assign(it->second.begin(), it->second.end());
+        }
+    }
+    if (!fKnown) {
+        auto txids = GetBlockTxs(blockHash);
+        if (!txids) {
+            return true;
+        }
+        toCheck.assign(txids->begin(), txids->end());
+    }
+
+    bool ret = true;
+    std::vector<uint256> safeTxids;
+    for (auto& txid : toCheck) {
+        int64_t txAge = 0;
+        {
+            LOCK(cs);
+            auto it = txFirstSeenTime.find(txid);
+            if (it != txFirstSeenTime.end()) {
+                txAge = GetAdjustedTime() - it->second;
+            }
+        }
+
+        if (txAge < WAIT_FOR_ISLOCK_TIMEOUT && !quorumInstantSendManager->IsLocked(txid)) {
+            if (ret) {
+                unsafeTxidRet = txid;
+                txAgeRet = txAge;
+                ret = false;
+            }
+        } else {
+            safeTxids.emplace_back(txid);
+        }
+    }
+
+    LOCK(cs);
+    if (!fKnown) {
+        if (!blockTxs.count(blockHash)) {
+            // got disconnected in the meantime
+            return ret;
+        }
+        blockUnsafeTxs[blockHash].insert(toCheck.begin(), toCheck.end());
+    }
+    auto it = blockUnsafeTxs.find(blockHash);
+    if (it != blockUnsafeTxs.end()) {
+        for (auto& txid : safeTxids) {
+            it->second.erase(txid);
+        }
+    }
+    return ret;
+}
+
 bool CChainLocksHandler::IsTxSafeForMining(const uint256& txid)
 {
     if (!RejectConflictingBlocks()) {
@@ -690,8 +778,10 @@ void CChainLocksHandler::Cleanup()
             for (auto& txid : *it->second) {
                 txFirstSeenTime.erase(txid);
             }
+            blockUnsafeTxs.erase(it->first);
             it = blockTxs.erase(it);
         } else if (InternalHasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+            blockUnsafeTxs.erase(it->first);
             it = blockTxs.erase(it);
         } else {
             ++it;
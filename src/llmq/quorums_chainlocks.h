@@ -77,6 +77,10 @@ private:
     typedef std::unordered_map<uint256, std::shared_ptr<std::unordered_set<uint256, StaticSaltedHasher>>> BlockTxs;
     BlockTxs blockTxs;
     std::unordered_map<uint256, int64_t> txFirstSeenTime;
+    // Subset of blockTxs which was not known to be safe (islocked or old enough) yet. TXs are removed from it when
+    // they get islocked and when a later check finds out that they are safe now, so that TrySignChainTip only has to
+    // look at the remaining TXs. Blocks without an entry here still need a full check
+    std::unordered_map<uint256, std::unordered_set<uint256, StaticSaltedHasher>> blockUnsafeTxs;
 
     std::map<uint256, int64_t> seenChainLocks;
 
@@ -93,11 +97,12 @@ public:
     bool GetChainLockByHash(const uint256& hash, CChainLockSig& ret);
     CChainLockSig GetBestChainLock();
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv);
     void ProcessNewChainLock(NodeId from, const CChainLockSig& clsig, const uint256& hash);
     void AcceptedBlockHeader(const CBlockIndex* pindexNew);
     void UpdatedBlockTip(const CBlockIndex* pindexNew);
     void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime);
+    void TransactionLocked(const CTransactionRef& tx);
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted);
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected);
     void CheckActiveState();
@@ -116,6 +121,7 @@ private:
     bool InternalHasConflictingChainLock(int nHeight, const uint256& blockHash);
 
     BlockTxs::mapped_type GetBlockTxs(const uint256& blockHash);
+    bool AreBlockTxsSafe(const uint256& blockHash, uint256& unsafeTxidRet, int64_t& txAgeRet);
 
     void Cleanup();
 };
@@ -4,6 +4,7 @@
 
 #include <llmq/quorums_commitment.h>
 
+#include <bls/bls_batchverifier.h>
 #include <chainparams.h>
 #include <validation.h>
 
@@ -24,7 +25,7 @@ CFinalCommitment::CFinalCommitment(const Consensus::LLMQParams& params, const ui
     LogPrintStr(strprintf("CFinalCommitment::%s -- %s", __func__, tinyformat::format(__VA_ARGS__))); \
 } while(0)
 
-bool CFinalCommitment::Verify(const CBlockIndex* pQuorumIndex, bool checkSigs) const
+bool CFinalCommitment::Verify(const CBlockIndex* pQuorumIndex, bool checkSigs, CBLSBatchVerifier<uint256, uint256>* quorumSigVerifier) const
 {
     if (nVersion == 0 || nVersion > CURRENT_VERSION) {
         return false;
@@ -94,7 +95,10 @@ bool CFinalCommitment::Verify(const CBlockIndex* pQuorumIndex, bool checkSigs) c
             return false;
         }
 
-        if (!quorumSig.VerifyInsecure(quorumPublicKey, commitmentHash)) {
+        if (quorumSigVerifier) {
+            auto qcHash = ::SerializeHash(*this);
+            quorumSigVerifier->PushMessage(qcHash, qcHash, commitmentHash, quorumSig, quorumPublicKey);
+        } else if (!quorumSig.VerifyInsecure(quorumPublicKey, commitmentHash)) {
             LogPrintfFinalCommitment("invalid quorum signature\n");
             return false;
         }
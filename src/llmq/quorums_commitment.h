@@ -15,6 +15,9 @@
 
 #include <univalue.h>
 
+template<typename SourceId, typename MessageId>
+class CBLSBatchVerifier;
+
 namespace llmq
 {
 
@@ -52,7 +55,9 @@ public:
         return (int)std::count(validMembers.begin(), validMembers.end(), true);
     }
 
-    bool Verify(const CBlockIndex* pQuorumIndex, bool checkSigs) const;
+    // When quorumSigVerifier is set, the quorum signature is not verified but pushed into it (source and message id
+    // are the commitment's hash), so that the caller can verify the quorum signatures of multiple commitments in one batch
+    bool Verify(const CBlockIndex* pQuorumIndex, bool checkSigs, CBLSBatchVerifier<uint256, uint256>* quorumSigVerifier = nullptr) const;
     bool VerifyNull() const;
     bool VerifySizes(const Consensus::LLMQParams& params) const;
 
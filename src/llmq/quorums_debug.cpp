@@ -46,6 +46,26 @@ UniValue CDKGDebugSessionStatus::ToJson(int detailLevel) const
     ret.pushKV("sentPrematureCommitment", sentPrematureCommitment);
     ret.pushKV("aborted", aborted);
 
+    UniValue phaseTimesJson(UniValue::VOBJ);
+    for (const auto& p : phaseTimes) {
+        phaseTimesJson.pushKV(strprintf("%d", p.first), p.second);
+    }
+    ret.pushKV("phaseTimes", phaseTimesJson);
+    UniValue phaseTrafficJson(UniValue::VOBJ);
+    for (const auto& p : phaseTraffic) {
+        UniValue t(UniValue::VOBJ);
+        t.pushKV("messagesReceived", (int)p.second.messagesReceived);
+        t.pushKV("messagesSent", (int)p.second.messagesSent);
+        t.pushKV("bytesReceived", p.second.bytesReceived);
+        t.pushKV("bytesReceivedDuplicate", p.second.bytesReceivedDuplicate);
+        t.pushKV("bytesSent", p.second.bytesSent);
+        phaseTrafficJson.pushKV(strprintf("%d", p.first), t);
+    }
+    ret.pushKV("phaseTraffic", phaseTrafficJson);
+    ret.pushKV("contributionsVerified", (int)contributionsVerified);
+    ret.pushKV("contributionsDecryptTime", contributionsDecryptTime);
+    ret.pushKV("contributionsVerifyTime", contributionsVerifyTime);
+
     struct ArrOrCount {
         int count{0};
         UniValue arr{UniValue::VARR};
@@ -170,6 +190,11 @@ void CDKGDebugManager::InitLocalSessionStatus(Consensus::LLMQType llmqType, cons
     session.statusBitset = 0;
     session.members.clear();
     session.members.resize((size_t)params.size);
+    session.phaseTraffic.clear();
+    session.phaseTimes.clear();
+    session.contributionsDecryptTime = 0;
+    session.contributionsVerifyTime = 0;
+    session.contributionsVerified = 0;
 }
 
 void CDKGDebugManager::UpdateLocalSessionStatus(Consensus::LLMQType llmqType, std::function<bool(CDKGDebugSessionStatus& status)>&& func)
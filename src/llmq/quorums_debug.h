@@ -6,13 +6,14 @@
 #define BITCOIN_LLMQ_QUORUMS_DEBUG_H
 
 #include <consensus/params.h>
+#include <streams.h>
 #include <sync.h>
 #include <univalue.h>
 
 #include <functional>
+#include <map>
 #include <set>
 
-class CDataStream;
 class CInv;
 class CScheduler;
 
@@ -69,6 +70,23 @@ public:
 
     std::vector<CDKGDebugMemberStatus> members;
 
+    struct Traffic {
+        uint32_t messagesReceived{0};
+        uint32_t messagesSent{0};
+        uint64_t bytesReceived{0};
+        // included in bytesReceived, counts messages which we already had
+        uint64_t bytesReceivedDuplicate{0};
+        uint64_t bytesSent{0};
+    };
+    // bandwidth used by DKG messages, indexed by the QuorumPhase which the messages belong to
+    std::map<uint8_t, Traffic> phaseTraffic;
+
+    // timings in milliseconds. phaseTimes is indexed by QuorumPhase and filled when a phase is done
+    std::map<uint8_t, int64_t> phaseTimes;
+    int64_t contributionsDecryptTime{0};
+    int64_t contributionsVerifyTime{0};
+    uint32_t contributionsVerified{0};
+
 public:
     CDKGDebugSessionStatus() : statusBitset(0) {}
 
@@ -15,6 +15,7 @@
 #include <chainparams.h>
 #include <netmessagemaker.h>
 #include <univalue.h>
+#include <util.h>
 #include <validation.h>
 
 #include <cxxtimer.hpp>
@@ -99,6 +100,9 @@ bool CDKGSession::Init(const CBlockIndex* _pindexQuorum, const std::vector<CDete
     receivedSkContributions.resize(members.size());
     vecEncryptedContributions.resize(members.size());
 
+    parallelVerify = gArgs.GetBoolArg("-llmq-dkg-parallel-verify", DEFAULT_DKG_PARALLEL_VERIFY) && blsWorker.GetWorkerCount() > 1;
+    maxPendingContributions = MAX_PENDING_CONTRIBUTIONS_PER_WORKER * (parallelVerify ? blsWorker.GetWorkerCount() : 1);
+
     for (size_t i = 0; i < mns.size(); i++) {
         members[i] = std::make_unique<CDKGMember>(mns[i], i);
         membersMap.emplace(members[i]->dmn->proTxHash, i);
@@ -178,22 +182,23 @@ void CDKGSession::SendContributions(CDKGPendingMessages& pendingMessages)
     qc.vvec = vvecContribution;
 
     cxxtimer::Timer t1(true);
-    qc.contributions = std::make_shared<CBLSIESMultiRecipientObjects<CBLSSecretKey>>();
-    qc.contributions->InitEncrypt(members.size());
-
+    BLSPublicKeyVector recipients;
+    BLSSecretKeyVector skContribs = skContributions;
+    recipients.reserve(members.size());
     for (size_t i = 0; i < members.size(); i++) {
         auto& m = members[i];
-        CBLSSecretKey skContrib = skContributions[i];
+        recipients.emplace_back(m->dmn->pdmnState->pubKeyOperator.Get());
 
         if (i != myIdx && ShouldSimulateError("contribution-lie")) {
             logger.Batch("lying for %s", m->dmn->proTxHash.ToString());
-            skContrib.MakeNewKey();
+            skContribs[i].MakeNewKey();
         }
+    }
 
-        if (!qc.contributions->Encrypt(i, m->dmn->pdmnState->pubKeyOperator.Get(), skContrib, PROTOCOL_VERSION)) {
-            logger.Batch("failed to encrypt contribution for %s", m->dmn->proTxHash.ToString());
-            return;
-        }
+    qc.contributions = std::make_shared<CBLSIESMultiRecipientObjects<CBLSSecretKey>>();
+    if (!blsWorker.EncryptContributions(recipients, skContribs, PROTOCOL_VERSION, *qc.contributions)) {
+        logger.Batch("failed to encrypt contributions");
+        return;
     }
 
     logger.Batch("encrypted contributions. time=%d", t1.count());
@@ -323,7 +328,8 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
 
     bool complain = false;
     CBLSSecretKey skContribution;
-    if (!qc.contributions->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, skContribution, PROTOCOL_VERSION)) {
+    // in parallel mode, skContribution stays invalid here and is decrypted later in VerifyPendingContributions
+    if (!parallelVerify && !qc.contributions->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, skContribution, PROTOCOL_VERSION)) {
         logger.Batch("contribution from %s could not be decrypted", member->dmn->proTxHash.ToString());
         complain = true;
     } else if (member->idx != myIdx && ShouldSimulateError("complain-lie")) {
@@ -340,13 +346,20 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
         return;
     }
 
-    logger.Batch("decrypted our contribution share. time=%d", t2.count());
+    if (!parallelVerify) {
+        int64_t decryptTime = t2.count();
+        logger.Batch("decrypted our contribution share. time=%d", decryptTime);
+        quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+            status.contributionsDecryptTime += decryptTime;
+            return false;
+        });
+    }
 
     bool verifyPending = false;
     receivedSkContributions[member->idx] = skContribution;
     vecEncryptedContributions[member->idx] = qc.contributions;
     pendingContributionVerifications.emplace_back(member->idx);
-    if (pendingContributionVerifications.size() >= 32) {
+    if (pendingContributionVerifications.size() >= maxPendingContributions) {
         verifyPending = true;
     }
 
@@ -373,6 +386,12 @@ void CDKGSession::VerifyPendingContributions()
         return;
     }
 
+    if (parallelVerify) {
+        DecryptPendingContributions(pend);
+    }
+
+    cxxtimer::Timer t2(true);
+
     std::vector<size_t> memberIndexes;
     std::vector<BLSVerificationVectorPtr> vvecs;
     BLSSecretKeyVector skContributions;
@@ -411,7 +430,78 @@ void CDKGSession::VerifyPendingContributions()
         }
     }
 
-    logger.Batch("verified %d pending contributions. time=%d", pend.size(), t1.count());
+    int64_t verifyTime = t2.count();
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        status.contributionsVerifyTime += verifyTime;
+        status.contributionsVerified += (uint32_t)memberIndexes.size();
+        return true;
+    });
+
+    logger.Batch("verified %d pending contributions. verifyTime=%d, time=%d", pend.size(), verifyTime, t1.count());
+}
+
+// Decrypts the secret key contributions of all pending members in parallel on the BLS worker threads.
+// Members for which decryption fails are marked with weComplain
+void CDKGSession::DecryptPendingContributions(const std::vector<size_t>& pend)
+{
+    AssertLockHeld(cs_pending);
+
+    CDKGLogger logger(*this, __func__);
+
+    cxxtimer::Timer t1(true);
+
+    std::vector<size_t> memberIndexes;
+    for (const auto& idx : pend) {
+        auto& m = members[idx];
+        if (m->bad || m->weComplain || receivedSkContributions[idx].IsValid()) {
+            continue;
+        }
+        memberIndexes.emplace_back(idx);
+    }
+    if (memberIndexes.empty()) {
+        return;
+    }
+
+    // split into one chunk per worker thread, each Decrypt involves a scalar multiplication and is quite expensive
+    size_t workerCount = std::max<size_t>(1, blsWorker.GetWorkerCount());
+    size_t chunkSize = (memberIndexes.size() + workerCount - 1) / workerCount;
+
+    // vector<bool> is not thread safe, so we use vector<char> here
+    std::vector<char> decrypted(memberIndexes.size(), 0);
+    std::vector<std::future<void>> futures;
+    for (size_t start = 0; start < memberIndexes.size(); start += chunkSize) {
+        size_t end = std::min(start + chunkSize, memberIndexes.size());
+        futures.emplace_back(blsWorker.AsyncRun([this, &memberIndexes, &decrypted, start, end]() {
+            for (size_t i = start; i < end; i++) {
+                size_t idx = memberIndexes[i];
+                decrypted[i] = vecEncryptedContributions[idx]->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, receivedSkContributions[idx], PROTOCOL_VERSION);
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+
+    for (size_t i = 0; i < memberIndexes.size(); i++) {
+        if (decrypted[i]) {
+            continue;
+        }
+        auto& m = members[memberIndexes[i]];
+        logger.Batch("contribution from %s could not be decrypted", m->dmn->proTxHash.ToString());
+        m->weComplain = true;
+        quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, m->idx, [&](CDKGDebugMemberStatus& status) {
+            status.weComplain = true;
+            return true;
+        });
+    }
+
+    int64_t decryptTime = t1.count();
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        status.contributionsDecryptTime += decryptTime;
+        return false;
+    });
+
+    logger.Batch("decrypted %d pending contributions with %d workers. time=%d", memberIndexes.size(), futures.size(), decryptTime);
 }
 
 void CDKGSession::VerifyAndComplain(CDKGPendingMessages& pendingMessages)
@@ -1300,6 +1390,52 @@ std::vector<CFinalCommitment> CDKGSession::FinalizeCommitments()
     return finalCommitments;
 }
 
+bool CDKGSession::AreAllContributionsVerified()
+{
+    LOCK(cs_pending);
+
+    {
+        LOCK(invCs);
+        for (const auto& m : members) {
+            if (m->bad || m->weComplain || m->contributions.size() != 1) {
+                return false;
+            }
+        }
+    }
+
+    // all contributions are here, so there is no reason to wait for more pending ones to batch
+    VerifyPendingContributions();
+
+    for (const auto& m : members) {
+        if (m->weComplain) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CDKGSession::HasReceivedComplaints() const
+{
+    LOCK(invCs);
+    for (const auto& m : members) {
+        if (m->weComplain || !m->complaints.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CDKGSession::AreAllPrematureCommitmentsVerified() const
+{
+    LOCK(invCs);
+    for (const auto& m : members) {
+        if (m->bad || m->prematureCommitments.size() != 1 || !validCommitments.count(*m->prematureCommitments.begin())) {
+            return false;
+        }
+    }
+    return true;
+}
+
 CDKGMember* CDKGSession::GetMember(const uint256& proTxHash) const
 {
     auto it = membersMap.find(proTxHash);
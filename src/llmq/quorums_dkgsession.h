@@ -26,6 +26,10 @@ class CDKGSession;
 class CDKGSessionManager;
 class CDKGPendingMessages;
 
+static const bool DEFAULT_DKG_PARALLEL_VERIFY = true;
+// number of received contributions per BLS worker thread after which pending contributions are verified
+static const size_t MAX_PENDING_CONTRIBUTIONS_PER_WORKER = 32;
+
 class CDKGLogger : public CBatchedLogger
 {
 public:
@@ -281,6 +285,11 @@ private:
 
     mutable CCriticalSection cs_pending;
     std::vector<size_t> pendingContributionVerifications;
+    // in parallel mode, decryption of contributions is deferred to VerifyPendingContributions and spread over all
+    // BLS worker threads. More contributions are collected before verification then, so that the aggregated
+    // batches of VerifyContributionShares can also keep all worker threads busy
+    bool parallelVerify{false};
+    size_t maxPendingContributions{MAX_PENDING_CONTRIBUTIONS_PER_WORKER};
 
     // filled by ReceivePrematureCommitment and used by FinalizeCommitments
     std::set<uint256> validCommitments;
@@ -312,6 +321,7 @@ public:
     bool PreVerifyMessage(const CDKGContribution& qc, bool& retBan) const;
     void ReceiveMessage(const CDKGContribution& qc, bool& retBan);
     void VerifyPendingContributions();
+    void DecryptPendingContributions(const std::vector<size_t>& pend);
 
     // Phase 2: complaint
     void VerifyAndComplain(CDKGPendingMessages& pendingMessages);
@@ -335,6 +345,12 @@ public:
     // Phase 5: aggregate/finalize
     std::vector<CFinalCommitment> FinalizeCommitments();
 
+    // Used for early phase completion. These return true if everything that could be expected in the corresponding
+    // phase was received and verified, so that waiting for more messages is pointless
+    bool AreAllContributionsVerified();
+    bool HasReceivedComplaints() const;
+    bool AreAllPrematureCommitmentsVerified() const;
+
     bool AreWeMember() const { return !myProTxHash.IsNull(); }
     void MarkBadMember(size_t idx);
 
@@ -12,6 +12,9 @@
 #include <chainparams.h>
 #include <net_processing.h>
 #include <spork.h>
+#include <util.h>
+
+#include <cxxtimer.hpp>
 
 namespace llmq
 {
@@ -22,18 +25,26 @@ CDKGPendingMessages::CDKGPendingMessages(size_t _maxMessagesPerNode, int _invTyp
 {
 }
 
-void CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
+bool CDKGPendingMessages::PushPendingMessage(NodeId from, CPublicDataStream& vRecv)
 {
     // this will also consume the data, even if we bail out early
-    auto pm = std::make_shared<CDataStream>(std::move(vRecv));
+    auto pm = std::make_shared<CPublicDataStream>(std::move(vRecv));
 
     CHashWriter hw(SER_GETHASH, 0);
     hw.write(pm->data(), pm->size());
     uint256 hash = hw.GetHash();
 
     if (from != -1) {
-        LOCK(cs_main);
-        EraseObjectRequest(from, CInv(invType, hash));
+        CInv inv(invType, hash);
+        {
+            LOCK(cs_main);
+            EraseObjectRequest(from, inv);
+        }
+        // the sender obviously has this message, so don't announce it back when we relay it later
+        g_connman->ForNode(from, [&](CNode* pnode) {
+            pnode->AddInventoryKnown(inv);
+            return true;
+        });
     }
 
     LOCK(cs);
@@ -41,16 +52,17 @@ void CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
     if (messagesPerNode[from] >= maxMessagesPerNode) {
         // TODO ban?
         LogPrint(BCLog::LLMQ_DKG, "CDKGPendingMessages::%s -- too many messages, peer=%d\n", __func__, from);
-        return;
+        return false;
     }
     messagesPerNode[from]++;
 
     if (!seenMessages.emplace(hash).second) {
         LogPrint(BCLog::LLMQ_DKG, "CDKGPendingMessages::%s -- already seen %s, peer=%d\n", __func__, hash.ToString(), from);
-        return;
+        return false;
     }
 
     pendingMessages.emplace_back(std::make_pair(from, std::move(pm)));
+    return true;
 }
 
 std::list<CDKGPendingMessages::BinaryMessage> CDKGPendingMessages::PopPendingMessages(size_t maxCount)
@@ -90,7 +102,8 @@ CDKGSessionHandler::CDKGSessionHandler(const Consensus::LLMQParams& _params, CBL
     pendingContributions((size_t)_params.size * 2, MSG_QUORUM_CONTRIB), // we allow size*2 messages as we need to make sure we see bad behavior (double messages)
     pendingComplaints((size_t)_params.size * 2, MSG_QUORUM_COMPLAINT),
     pendingJustifications((size_t)_params.size * 2, MSG_QUORUM_JUSTIFICATION),
-    pendingPrematureCommitments((size_t)_params.size * 2, MSG_QUORUM_PREMATURE_COMMITMENT)
+    pendingPrematureCommitments((size_t)_params.size * 2, MSG_QUORUM_PREMATURE_COMMITMENT),
+    earlyPhaseCompletion(gArgs.GetBoolArg("-llmq-dkg-early-phase", DEFAULT_DKG_EARLY_PHASE_COMPLETION))
 {
     if (params.type == Consensus::LLMQ_NONE) {
         throw std::runtime_error("Can't initialize CDKGSessionHandler with LLMQ_NONE type.");
@@ -121,18 +134,38 @@ void CDKGSessionHandler::UpdatedBlockTip(const CBlockIndex* pindexNew)
             params.name, currentHeight, quorumHeight, oldPhase, phase);
 }
 
-void CDKGSessionHandler::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CDKGSessionHandler::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
+    size_t nBytes = vRecv.size();
+    bool isNew;
+    QuorumPhase msgPhase;
+
     // We don't handle messages in the calling thread as deserialization/processing of these would block everything
     if (strCommand == NetMsgType::QCONTRIB) {
-        pendingContributions.PushPendingMessage(pfrom->GetId(), vRecv);
+        isNew = pendingContributions.PushPendingMessage(pfrom->GetId(), vRecv);
+        msgPhase = QuorumPhase_Contribute;
     } else if (strCommand == NetMsgType::QCOMPLAINT) {
-        pendingComplaints.PushPendingMessage(pfrom->GetId(), vRecv);
+        isNew = pendingComplaints.PushPendingMessage(pfrom->GetId(), vRecv);
+        msgPhase = QuorumPhase_Complain;
     } else if (strCommand == NetMsgType::QJUSTIFICATION) {
-        pendingJustifications.PushPendingMessage(pfrom->GetId(), vRecv);
+        isNew = pendingJustifications.PushPendingMessage(pfrom->GetId(), vRecv);
+        msgPhase = QuorumPhase_Justify;
     } else if (strCommand == NetMsgType::QPCOMMITMENT) {
-        pendingPrematureCommitments.PushPendingMessage(pfrom->GetId(), vRecv);
+        isNew = pendingPrematureCommitments.PushPendingMessage(pfrom->GetId(), vRecv);
+        msgPhase = QuorumPhase_Commit;
+    } else {
+        return;
     }
+
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        auto& traffic = status.phaseTraffic[(uint8_t) msgPhase];
+        traffic.messagesReceived++;
+        traffic.bytesReceived += nBytes;
+        if (!isNew) {
+            traffic.bytesReceivedDuplicate += nBytes;
+        }
+        return false;
+    });
 }
 
 void CDKGSessionHandler::StartThread()
@@ -180,13 +213,16 @@ std::pair<QuorumPhase, uint256> CDKGSessionHandler::GetPhaseAndQuorumHash() cons
 class AbortPhaseException : public std::exception {
 };
 
-void CDKGSessionHandler::WaitForNextPhase(QuorumPhase curPhase,
+bool CDKGSessionHandler::WaitForNextPhase(QuorumPhase curPhase,
                                           QuorumPhase nextPhase,
                                           const uint256& expectedQuorumHash,
-                                          const WhileWaitFunc& runWhileWaiting)
+                                          const WhileWaitFunc& runWhileWaiting,
+                                          bool startedEarly,
+                                          const PhaseCompleteFunc& isPhaseComplete)
 {
     LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - starting, curPhase=%d, nextPhase=%d\n", __func__, params.name, curPhase, nextPhase);
 
+    bool completedEarly = false;
     while (true) {
         if (stopRequested) {
             LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - aborting due to stop/shutdown requested\n", __func__, params.name);
@@ -200,16 +236,26 @@ void CDKGSessionHandler::WaitForNextPhase(QuorumPhase curPhase,
         if (p.first == nextPhase) {
             break;
         }
-        if (curPhase != QuorumPhase_None && p.first != curPhase) {
+        // if we started this phase early, the chain might still be in the previous phase
+        bool expectedPhase = p.first == curPhase || (startedEarly && p.first == curPhase - 1);
+        if (curPhase != QuorumPhase_None && !expectedPhase) {
             LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - aborting due unexpected phase change\n", __func__, params.name);
             throw AbortPhaseException();
         }
-        if (!runWhileWaiting()) {
+        bool didWork = runWhileWaiting();
+        if (isPhaseComplete && isPhaseComplete()) {
+            // we must not skip more than one phase, so only allow completion once the chain reached the current phase
+            if (p.first == curPhase) {
+                completedEarly = true;
+                break;
+            }
+        }
+        if (!didWork) {
             MilliSleep(100);
         }
     }
 
-    LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - done, curPhase=%d, nextPhase=%d\n", __func__, params.name, curPhase, nextPhase);
+    LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - done, curPhase=%d, nextPhase=%d, completedEarly=%d\n", __func__, params.name, curPhase, nextPhase, completedEarly);
 
     if (nextPhase == QuorumPhase_Initialized) {
         quorumDKGDebugManager->ResetLocalSessionStatus(params.type);
@@ -220,6 +266,8 @@ void CDKGSessionHandler::WaitForNextPhase(QuorumPhase curPhase,
             return changed;
         });
     }
+
+    return completedEarly;
 }
 
 void CDKGSessionHandler::WaitForNewQuorum(const uint256& oldQuorumHash)
@@ -309,20 +357,35 @@ void CDKGSessionHandler::SleepBeforePhase(QuorumPhase curPhase,
     LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - done, curPhase=%d\n", __func__, params.name, curPhase);
 }
 
-void CDKGSessionHandler::HandlePhase(QuorumPhase curPhase,
+bool CDKGSessionHandler::HandlePhase(QuorumPhase curPhase,
                                      QuorumPhase nextPhase,
                                      const uint256& expectedQuorumHash,
                                      double randomSleepFactor,
                                      const StartPhaseFunc& startPhaseFunc,
-                                     const WhileWaitFunc& runWhileWaiting)
+                                     const WhileWaitFunc& runWhileWaiting,
+                                     bool startedEarly,
+                                     const PhaseCompleteFunc& isPhaseComplete)
 {
-    LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - starting, curPhase=%d, nextPhase=%d\n", __func__, params.name, curPhase, nextPhase);
+    LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - starting, curPhase=%d, nextPhase=%d, startedEarly=%d\n", __func__, params.name, curPhase, nextPhase, startedEarly);
 
-    SleepBeforePhase(curPhase, expectedQuorumHash, randomSleepFactor, runWhileWaiting);
+    cxxtimer::Timer t1(true);
+    if (!startedEarly) {
+        // when started early, members enter the phase at different times already, so there is no need to spread the load
+        SleepBeforePhase(curPhase, expectedQuorumHash, randomSleepFactor, runWhileWaiting);
+    }
     startPhaseFunc();
-    WaitForNextPhase(curPhase, nextPhase, expectedQuorumHash, runWhileWaiting);
+    bool completedEarly = WaitForNextPhase(curPhase, nextPhase, expectedQuorumHash, runWhileWaiting, startedEarly,
+                                           earlyPhaseCompletion && curSession->AreWeMember() ? isPhaseComplete : nullptr);
 
-    LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - done, curPhase=%d, nextPhase=%d\n", __func__, params.name, curPhase, nextPhase);
+    int64_t phaseTime = t1.count();
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        status.phaseTimes[(uint8_t) curPhase] = phaseTime;
+        return true;
+    });
+
+    LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - done, curPhase=%d, nextPhase=%d, time=%d\n", __func__, params.name, curPhase, nextPhase, phaseTime);
+
+    return completedEarly;
 }
 
 // returns a set of NodeIds which sent invalid messages
@@ -535,7 +598,10 @@ void CDKGSessionHandler::HandleDKGRound()
     auto fContributeWait = [this] {
         return ProcessPendingMessageBatch<CDKGContribution, MSG_QUORUM_CONTRIB>(*curSession, pendingContributions, 8);
     };
-    HandlePhase(QuorumPhase_Contribute, QuorumPhase_Complain, curQuorumHash, 0.05, fContributeStart, fContributeWait);
+    auto fContributeComplete = [this] {
+        return curSession->AreAllContributionsVerified();
+    };
+    bool early = HandlePhase(QuorumPhase_Contribute, QuorumPhase_Complain, curQuorumHash, 0.05, fContributeStart, fContributeWait, false, fContributeComplete);
 
     // Complain
     auto fComplainStart = [this]() {
@@ -544,7 +610,9 @@ void CDKGSessionHandler::HandleDKGRound()
     auto fComplainWait = [this] {
         return ProcessPendingMessageBatch<CDKGComplaint, MSG_QUORUM_COMPLAINT>(*curSession, pendingComplaints, 8);
     };
-    HandlePhase(QuorumPhase_Complain, QuorumPhase_Justify, curQuorumHash, 0.05, fComplainStart, fComplainWait);
+    // complaints are only sent by members which have something to complain about, so we can't know when all of them
+    // were received and must always wait for the end of this phase
+    early = HandlePhase(QuorumPhase_Complain, QuorumPhase_Justify, curQuorumHash, 0.05, fComplainStart, fComplainWait, early, nullptr);
 
     // Justify
     auto fJustifyStart = [this]() {
@@ -553,7 +621,11 @@ void CDKGSessionHandler::HandleDKGRound()
     auto fJustifyWait = [this] {
         return ProcessPendingMessageBatch<CDKGJustification, MSG_QUORUM_JUSTIFICATION>(*curSession, pendingJustifications, 8);
     };
-    HandlePhase(QuorumPhase_Justify, QuorumPhase_Commit, curQuorumHash, 0.05, fJustifyStart, fJustifyWait);
+    auto fJustifyComplete = [this] {
+        // no justifications are expected if nobody complained
+        return !curSession->HasReceivedComplaints();
+    };
+    early = HandlePhase(QuorumPhase_Justify, QuorumPhase_Commit, curQuorumHash, 0.05, fJustifyStart, fJustifyWait, early, fJustifyComplete);
 
     // Commit
     auto fCommitStart = [this]() {
@@ -562,7 +634,10 @@ void CDKGSessionHandler::HandleDKGRound()
     auto fCommitWait = [this] {
         return ProcessPendingMessageBatch<CDKGPrematureCommitment, MSG_QUORUM_PREMATURE_COMMITMENT>(*curSession, pendingPrematureCommitments, 8);
     };
-    HandlePhase(QuorumPhase_Commit, QuorumPhase_Finalize, curQuorumHash, 0.1, fCommitStart, fCommitWait);
+    auto fCommitComplete = [this] {
+        return curSession->AreAllPrematureCommitmentsVerified();
+    };
+    HandlePhase(QuorumPhase_Commit, QuorumPhase_Finalize, curQuorumHash, 0.1, fCommitStart, fCommitWait, early, fCommitComplete);
 
     auto finalCommitments = curSession->FinalizeCommitments();
     for (const auto& fqc : finalCommitments) {
@@ -36,7 +36,7 @@ enum QuorumPhase {
 class CDKGPendingMessages
 {
 public:
-    typedef std::pair<NodeId, std::shared_ptr<CDataStream>> BinaryMessage;
+    typedef std::pair<NodeId, std::shared_ptr<CPublicDataStream>> BinaryMessage;
 
 private:
     mutable CCriticalSection cs;
@@ -49,17 +49,18 @@ private:
 public:
     explicit CDKGPendingMessages(size_t _maxMessagesPerNode, int _invType);
 
-    void PushPendingMessage(NodeId from, CDataStream& vRecv);
+    // returns false if the message was dropped, e.g. because it was already seen before
+    bool PushPendingMessage(NodeId from, CPublicDataStream& vRecv);
     std::list<BinaryMessage> PopPendingMessages(size_t maxCount);
     bool HasSeen(const uint256& hash) const;
     void Clear();
 
     template<typename Message>
-    void PushPendingMessage(NodeId from, Message& msg)
+    bool PushPendingMessage(NodeId from, Message& msg)
     {
-        CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+        CPublicDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
         ds << msg;
-        PushPendingMessage(from, ds);
+        return PushPendingMessage(from, ds);
     }
 
     // Might return nullptr messages, which indicates that deserialization failed for some reason
@@ -87,6 +88,11 @@ public:
     }
 };
 
+// When enabled, members move on to the next phase as soon as all messages expected for the current phase were received
+// and verified, instead of waiting for the block which starts the next phase. This is only done inside the window in
+// which the messages of the next phase are already accepted and relayed by other nodes (see the phase checks in CDKGSessionManager::GetContribution and friends)
+static const bool DEFAULT_DKG_EARLY_PHASE_COMPLETION = false;
+
 /**
  * Handles multiple sequential sessions of one specific LLMQ type. There is one instance of this class per LLMQ type.
  *
@@ -118,12 +124,15 @@ private:
     CDKGPendingMessages pendingJustifications;
     CDKGPendingMessages pendingPrematureCommitments;
 
+    // see DEFAULT_DKG_EARLY_PHASE_COMPLETION
+    const bool earlyPhaseCompletion;
+
 public:
     CDKGSessionHandler(const Consensus::LLMQParams& _params, CBLSWorker& blsWorker, CDKGSessionManager& _dkgManager);
     ~CDKGSessionHandler();
 
     void UpdatedBlockTip(const CBlockIndex *pindexNew);
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv);
 
     void StartThread();
     void StopThread();
@@ -135,10 +144,15 @@ private:
 
     typedef std::function<void()> StartPhaseFunc;
     typedef std::function<bool()> WhileWaitFunc;
-    void WaitForNextPhase(QuorumPhase curPhase, QuorumPhase nextPhase, const uint256& expectedQuorumHash, const WhileWaitFunc& runWhileWaiting);
+    typedef std::function<bool()> PhaseCompleteFunc;
+    // returns true if the phase was completed early, i.e. before the chain reached nextPhase
+    bool WaitForNextPhase(QuorumPhase curPhase, QuorumPhase nextPhase, const uint256& expectedQuorumHash, const WhileWaitFunc& runWhileWaiting,
+                          bool startedEarly = false, const PhaseCompleteFunc& isPhaseComplete = nullptr);
     void WaitForNewQuorum(const uint256& oldQuorumHash);
     void SleepBeforePhase(QuorumPhase curPhase, const uint256& expectedQuorumHash, double randomSleepFactor, const WhileWaitFunc& runWhileWaiting);
-    void HandlePhase(QuorumPhase curPhase, QuorumPhase nextPhase, const uint256& expectedQuorumHash, double randomSleepFactor, const StartPhaseFunc& startPhaseFunc, const WhileWaitFunc& runWhileWaiting);
+    // returns true if the phase was completed early, see WaitForNextPhase
+    bool HandlePhase(QuorumPhase curPhase, QuorumPhase nextPhase, const uint256& expectedQuorumHash, double randomSleepFactor, const StartPhaseFunc& startPhaseFunc,
+                     const WhileWaitFunc& runWhileWaiting, bool startedEarly, const PhaseCompleteFunc& isPhaseComplete);
     void HandleDKGRound();
     void PhaseHandlerThread();
 };
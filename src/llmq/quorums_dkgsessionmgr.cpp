@@ -63,7 +63,7 @@ void CDKGSessionManager::UpdatedBlockTip(const CBlockIndex* pindexNew, bool fIni
     }
 }
 
-void CDKGSessionManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CDKGSessionManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     if (!IsQuorumDKGEnabled())
         return;
@@ -115,6 +115,19 @@ bool CDKGSessionManager::AlreadyHave(const CInv& inv) const
     return false;
 }
 
+// The GetXXX methods below are only used to answer GETDATA requests, so everything returned by them is accounted as sent
+template<typename Message>
+static void AddSentTraffic(Consensus::LLMQType llmqType, QuorumPhase phase, const Message& msg)
+{
+    size_t nBytes = ::GetSerializeSize(msg, SER_NETWORK, PROTOCOL_VERSION);
+    quorumDKGDebugManager->UpdateLocalSessionStatus(llmqType, [&](CDKGDebugSessionStatus& status) {
+        auto& traffic = status.phaseTraffic[(uint8_t) phase];
+        traffic.messagesSent++;
+        traffic.bytesSent += nBytes;
+        return false;
+    });
+}
+
 bool CDKGSessionManager::GetContribution(const uint256& hash, CDKGContribution& ret) const
 {
     if (!IsQuorumDKGEnabled())
@@ -129,6 +142,7 @@ bool CDKGSessionManager::GetContribution(const uint256& hash, CDKGContribution&
         auto it = dkgType.curSession->contributions.find(hash);
         if (it != dkgType.curSession->contributions.end()) {
             ret = it->second;
+            AddSentTraffic(p.first, QuorumPhase_Contribute, ret);
             return true;
         }
     }
@@ -149,6 +163,7 @@ bool CDKGSessionManager::GetComplaint(const uint256& hash, CDKGComplaint& ret) c
         auto it = dkgType.curSession->complaints.find(hash);
         if (it != dkgType.curSession->complaints.end()) {
             ret = it->second;
+            AddSentTraffic(p.first, QuorumPhase_Complain, ret);
             return true;
         }
     }
@@ -169,6 +184,7 @@ bool CDKGSessionManager::GetJustification(const uint256& hash, CDKGJustification
         auto it = dkgType.curSession->justifications.find(hash);
         if (it != dkgType.curSession->justifications.end()) {
             ret = it->second;
+            AddSentTraffic(p.first, QuorumPhase_Justify, ret);
             return true;
         }
     }
@@ -189,6 +205,7 @@ bool CDKGSessionManager::GetPrematureCommitment(const uint256& hash, CDKGPrematu
         auto it = dkgType.curSession->prematureCommitments.find(hash);
         if (it != dkgType.curSession->prematureCommitments.end() && dkgType.curSession->validCommitments.count(hash)) {
             ret = it->second;
+            AddSentTraffic(p.first, QuorumPhase_Commit, ret);
             return true;
         }
     }
@@ -27,16 +27,18 @@ CDBWrapper* llmqDb;
 void InitLLMQSystem(CEvoDB& evoDb, bool unitTests, bool fWipe)
 {
     llmqDb = new CDBWrapper(unitTests ? "" : (GetDataDir() / "llmq"), 8 << 20, unitTests, fWipe);
+    // islocks, recovered sigs and votes are written on hot paths, see CDBWrapper::WriteBatchAsync()
+    llmqDb->StartAsyncWriter();
     blsWorker = new CBLSWorker();
 
     quorumDKGDebugManager = new CDKGDebugManager();
     quorumBlockProcessor = new CQuorumBlockProcessor(evoDb);
     quorumDKGSessionManager = new CDKGSessionManager(*llmqDb, *blsWorker);
     quorumManager = new CQuorumManager(evoDb, *blsWorker, *quorumDKGSessionManager);
-    quorumSigSharesManager = new CSigSharesManager();
+    quorumSigSharesManager = new CSigSharesManager(*blsWorker);
     quorumSigningManager = new CSigningManager(*llmqDb, unitTests);
     chainLocksHandler = new CChainLocksHandler();
-    quorumInstantSendManager = new CInstantSendManager(*llmqDb);
+    quorumInstantSendManager = new CInstantSendManager(*llmqDb, *blsWorker);
 }
 
 void DestroyLLMQSystem()
@@ -47,6 +49,8 @@ void DestroyLLMQSystem()
     chainLocksHandler = nullptr;
     delete quorumSigningManager;
     quorumSigningManager = nullptr;
+    // Drop the precomputed active quorum sets, they keep quorums alive
+    CSigningManager::UpdatedBlockTip(nullptr, false);
     delete quorumSigSharesManager;
     quorumSigSharesManager = nullptr;
     delete quorumManager;
@@ -5,12 +5,16 @@
 #ifndef BITCOIN_LLMQ_QUORUMS_INIT_H
 #define BITCOIN_LLMQ_QUORUMS_INIT_H
 
+class CBLSWorker;
 class CDBWrapper;
 class CEvoDB;
 
 namespace llmq
 {
 
+// BLS worker threads shared by all LLMQ managers, nullptr while the LLMQ system isn't initialized
+extern CBLSWorker* blsWorker;
+
 // Init/destroy LLMQ globals
 void InitLLMQSystem(CEvoDB& evoDb, bool unitTests, bool fWipe = false);
 void DestroyLLMQSystem();
@@ -4,12 +4,14 @@
 
 #include <llmq/quorums_chainlocks.h>
 #include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_latency.h>
 #include <llmq/quorums_utils.h>
 
 #include <bls/bls_batchverifier.h>
 #include <chainparams.h>
 #include <txmempool.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <net_processing.h>
 #include <spork.h>
 #include <validation.h>
@@ -77,6 +79,7 @@ void CInstantSendDb::Upgrade()
                         batch.Erase(std::make_tuple(DB_HASH_BY_OUTPOINT, in));
                     }
                     batch.Erase(curKey);
+                    RemoveFromIndex(islock);
                 }
             }
             it->Next();
@@ -86,22 +89,132 @@ void CInstantSendDb::Upgrade()
     }
 }
 
-void CInstantSendDb::WriteNewInstantSendLock(const uint256& hash, const CInstantSendLock& islock)
+void CInstantSendDb::BuildIndex(size_t maxMemory)
 {
-    CDBBatch batch(db);
-    batch.Write(std::make_tuple(std::string(DB_ISLOCK_BY_HASH), hash), islock);
-    batch.Write(std::make_tuple(std::string(DB_HASH_BY_TXID), islock.txid), hash);
+    DropIndex();
+    indexMaxMemory = maxMemory;
+    if (indexMaxMemory == 0) {
+        return;
+    }
+
+    cxxtimer::Timer timer(true);
+
+    // mark the index as complete while building it, so that AddToIndex does not bail out
+    indexComplete = true;
+
+    CInstantSendLock islock;
+    auto it = std::unique_ptr<CDBIterator>(db.NewIterator());
+    auto firstKey = std::make_tuple(DB_ISLOCK_BY_HASH, uint256());
+    it->Seek(firstKey);
+    decltype(firstKey) curKey;
+
+    while (it->Valid() && indexComplete) {
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_ISLOCK_BY_HASH) {
+            break;
+        }
+        if (it->GetValue(islock)) {
+            AddToIndex(std::get<1>(curKey), islock);
+        }
+        it->Next();
+    }
+
+    if (indexComplete) {
+        LogPrintf("CInstantSendDb::%s -- built islock index. txids=%d, inputs=%d, memory=%d, time=%dms\n", __func__,
+                  indexByTxid.size(), indexByOutpoint.size(), GetIndexMemoryUsage(), timer.count());
+    }
+}
+
+size_t CInstantSendDb::GetIndexMemoryUsage() const
+{
+    return memusage::DynamicUsage(indexByOutpoint) + memusage::DynamicUsage(indexByTxid);
+}
+
+CInstantSendLockEntry::CInstantSendLockEntry(const uint256& _hash, const CInstantSendLockPtr& _islock) :
+    hash(_hash),
+    islock(_islock)
+{
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, bytes, 0, *islock);
+}
+
+static size_t InstantSendLockDynamicUsage(const CInstantSendLockPtr& islock)
+{
+    return islock ? memusage::DynamicUsage(islock) + memusage::DynamicUsage(islock->inputs) : 0;
+}
+
+size_t CInstantSendDb::GetMemoryUsage() const
+{
+    size_t usage = islockCache.DynamicMemoryUsage() + txidCache.DynamicMemoryUsage() + outpointCache.DynamicMemoryUsage();
+    islockCache.for_each([&](const uint256&, const CInstantSendLockPtr& islock) {
+        usage += InstantSendLockDynamicUsage(islock);
+    });
+    // the islocks of the entries are usually shared with islockCache
+    usage += entryCache.DynamicMemoryUsage();
+    entryCache.for_each([&](const uint256&, const CInstantSendLockEntryPtr& entry) {
+        usage += memusage::DynamicUsage(entry) + memusage::DynamicUsage(entry->bytes);
+    });
+    return usage + GetIndexMemoryUsage();
+}
+
+void CInstantSendDb::AddToIndex(const uint256& hash, const CInstantSendLock& islock)
+{
+    if (!indexComplete) {
+        return;
+    }
+
+    indexByTxid[islock.txid] = hash;
     for (auto& in : islock.inputs) {
-        batch.Write(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), in), hash);
+        indexByOutpoint[in] = hash;
+    }
+
+    if (GetIndexMemoryUsage() > indexMaxMemory) {
+        LogPrintf("CInstantSendDb::%s -- islock index exceeds memory budget of %d bytes, falling back to database lookups\n", __func__,
+                  indexMaxMemory);
+        DropIndex();
+    }
+}
+
+void CInstantSendDb::RemoveFromIndex(const CInstantSendLock& islock)
+{
+    if (!indexComplete) {
+        return;
     }
-    db.WriteBatch(batch);
 
-    auto p = std::make_shared<CInstantSendLock>(islock);
-    islockCache.insert(hash, p);
-    txidCache.insert(islock.txid, hash);
+    indexByTxid.erase(islock.txid);
     for (auto& in : islock.inputs) {
+        indexByOutpoint.erase(in);
+    }
+}
+
+void CInstantSendDb::DropIndex()
+{
+    indexComplete = false;
+    indexByOutpoint.clear();
+    indexByOutpoint.rehash(0);
+    indexByTxid.clear();
+    indexByTxid.rehash(0);
+}
+
+void CInstantSendDb::WriteNewInstantSendLock(const uint256& hash, const CInstantSendLockPtr& islock)
+{
+    // serialized once, for the database and for everyone who asks for the islock later
+    auto entry = std::make_shared<const CInstantSendLockEntry>(hash, islock);
+
+    CDBBatch batch(db);
+    batch.Write(std::make_tuple(std::string(DB_ISLOCK_BY_HASH), hash), MakeSpan(entry->bytes));
+    batch.Write(std::make_tuple(std::string(DB_HASH_BY_TXID), islock->txid), hash);
+    for (auto& in : islock->inputs) {
+        batch.Write(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), in), hash);
+    }
+    db.WriteBatchAsync(batch);
+
+    AddToIndex(hash, *islock);
+
+    islockCache.insert(hash, islock);
+    txidCache.insert(islock->txid, hash);
+    for (auto& in : islock->inputs) {
         outpointCache.insert(in, hash);
     }
+    entryCache.insert(islock->txid, entry);
 }
 
 void CInstantSendDb::RemoveInstantSendLock(CDBBatch& batch, const uint256& hash, CInstantSendLockPtr islock, bool keep_cache)
@@ -119,9 +232,12 @@ void CInstantSendDb::RemoveInstantSendLock(CDBBatch& batch, const uint256& hash,
         batch.Erase(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), in));
     }
 
+    RemoveFromIndex(*islock);
+
     if (!keep_cache) {
         islockCache.erase(hash);
         txidCache.erase(islock->txid);
+        entryCache.erase(islock->txid);
         for (auto& in : islock->inputs) {
             outpointCache.erase(in);
         }
@@ -317,7 +433,14 @@ uint256 CInstantSendDb::GetInstantSendLockHashByTxid(const uint256& txid) const
 {
     uint256 islockHash;
     if (!txidCache.get(txid, islockHash)) {
-        db.Read(std::make_tuple(std::string(DB_HASH_BY_TXID), txid), islockHash);
+        if (indexComplete) {
+            auto it = indexByTxid.find(txid);
+            if (it != indexByTxid.end()) {
+                islockHash = it->second;
+            }
+        } else {
+            db.Read(std::make_tuple(std::string(DB_HASH_BY_TXID), txid), islockHash);
+        }
         txidCache.insert(txid, islockHash);
     }
     return islockHash;
@@ -332,12 +455,44 @@ CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByInput(const COutPoint& o
 {
     uint256 islockHash;
     if (!outpointCache.get(outpoint, islockHash)) {
-        db.Read(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), outpoint), islockHash);
+        if (indexComplete) {
+            auto it = indexByOutpoint.find(outpoint);
+            if (it != indexByOutpoint.end()) {
+                islockHash = it->second;
+            }
+        } else {
+            db.Read(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), outpoint), islockHash);
+        }
         outpointCache.insert(outpoint, islockHash);
     }
     return GetInstantSendLockByHash(islockHash);
 }
 
+CInstantSendLockEntryPtr CInstantSendDb::GetInstantSendLockEntryByHash(const uint256& hash) const
+{
+    auto islock = GetInstantSendLockByHash(hash);
+    if (!islock) {
+        return nullptr;
+    }
+
+    CInstantSendLockEntryPtr entry;
+    if (entryCache.get(islock->txid, entry) && entry->hash == hash) {
+        return entry;
+    }
+    entry = std::make_shared<const CInstantSendLockEntry>(hash, islock);
+    entryCache.insert(islock->txid, entry);
+    return entry;
+}
+
+CInstantSendLockEntryPtr CInstantSendDb::GetInstantSendLockEntryByTxid(const uint256& txid) const
+{
+    CInstantSendLockEntryPtr entry;
+    if (entryCache.get(txid, entry)) {
+        return entry;
+    }
+    return GetInstantSendLockEntryByHash(GetInstantSendLockHashByTxid(txid));
+}
+
 std::vector<uint256> CInstantSendDb::GetInstantSendLocksByParent(const uint256& parent) const
 {
     auto it = std::unique_ptr<CDBIterator>(db.NewIterator());
@@ -407,10 +562,14 @@ std::vector<uint256> CInstantSendDb::RemoveChainedInstantSendLocks(const uint256
 
 ////////////////
 
-CInstantSendManager::CInstantSendManager(CDBWrapper& _llmqDb) :
-    db(_llmqDb)
+CInstantSendManager::CInstantSendManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWorker) :
+    db(_llmqDb),
+    blsWorker(_blsWorker)
 {
     workInterrupt.reset();
+
+    int64_t indexMemory = std::max<int64_t>(0, gArgs.GetArg("-llmq-islock-index-mem", DEFAULT_ISLOCK_INDEX_MEMORY));
+    db.BuildIndex((size_t)indexMemory * 1024 * 1024);
 }
 
 CInstantSendManager::~CInstantSendManager() = default;
@@ -532,21 +691,29 @@ bool CInstantSendManager::TrySignInputLocks(const CTransaction& tx, bool fRetroa
     LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: trying to vote on %d inputs\n", __func__,
              tx.GetHash().ToString(), tx.vin.size());
 
-    for (size_t i = 0; i < tx.vin.size(); i++) {
-        auto& in = tx.vin[i];
-        auto& id = ids[i];
-        {
-            LOCK(cs);
-            inputRequestIds.emplace(id);
-        }
-        LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: trying to vote on input %s with id %s. fRetroactive=%d\n", __func__,
-                 tx.GetHash().ToString(), in.prevout.ToStringShort(), id.ToString(), fRetroactive);
-        if (quorumSigningManager->AsyncSignIfMember(llmqType, id, tx.GetHash(), {}, fRetroactive)) {
-            LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: voted on input %s with id %s\n", __func__,
-                     tx.GetHash().ToString(), in.prevout.ToStringShort(), id.ToString());
+    std::vector<std::pair<uint256, uint256>> idsAndMsgHashes;
+    idsAndMsgHashes.reserve(tx.vin.size());
+    {
+        LOCK(cs);
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            inputRequestIds.emplace(ids[i]);
+            idsAndMsgHashes.emplace_back(ids[i], tx.GetHash());
         }
     }
 
+    // the shares of all inputs signed by the same quorum are created and sent together
+    auto results = quorumSigningManager->AsyncSignIfMember(llmqType, idsAndMsgHashes, fRetroactive);
+
+    bool fVoted = false;
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: %s on input %s with id %s. fRetroactive=%d\n", __func__,
+                 tx.GetHash().ToString(), results[i] ? "voted" : "did not vote", tx.vin[i].prevout.ToStringShort(), ids[i].ToString(), fRetroactive);
+        fVoted |= results[i];
+    }
+    if (fVoted) {
+        pipelineLatencies.RecordStage(LatencyEvent::TX_FIRST_SEEN, tx.GetHash(), LatencyStage::IS_TX_TO_INPUT_VOTES);
+    }
+
     return true;
 }
 
@@ -708,6 +875,9 @@ void CInstantSendManager::TrySignInstantSendLock(const CTransaction& tx)
         txToCreatingInstantSendLocks.emplace(tx.GetHash(), &e.first->second);
     }
 
+    pipelineLatencies.RecordStage(LatencyEvent::TX_FIRST_SEEN, tx.GetHash(), LatencyStage::IS_TX_TO_INPUT_LOCKS);
+    pipelineLatencies.AddEvent(LatencyEvent::TX_INPUTS_LOCKED, tx.GetHash());
+
     quorumSigningManager->AsyncSignIfMember(llmqType, id, tx.GetHash());
 }
 
@@ -734,26 +904,37 @@ void CInstantSendManager::HandleNewInstantSendLockRecoveredSig(const llmq::CReco
     }
 
     islock->sig = recoveredSig.sig;
-    ProcessInstantSendLock(-1, ::SerializeHash(*islock), islock);
+    pipelineLatencies.RecordStage(LatencyEvent::TX_INPUTS_LOCKED, islock->txid, LatencyStage::IS_INPUT_LOCKS_TO_ISLOCK, true);
+    ProcessInstantSendLock(-1, ::SerializeHash(*islock), islock, recoveredSig.quorumHash);
 }
 
-void CInstantSendManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CInstantSendManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     if (!IsInstantSendEnabled()) {
         return;
     }
 
     if (strCommand == NetMsgType::ISLOCK) {
+        // Every ISLOCK is usually received from several peers. The hash is taken from the message buffer, so that the
+        // copies we already know are dropped without deserializing them
+        SpanReader reader = MakeSpanReader(vRecv);
+        CInstantSendLockView view;
+        reader >> view;
+        uint256 hash = view.GetHash();
+        if (AlreadyHave(CInv(MSG_ISLOCK, hash))) {
+            LOCK(cs_main);
+            EraseObjectRequest(pfrom->GetId(), CInv(MSG_ISLOCK, hash));
+            return;
+        }
+
         CInstantSendLockPtr islock = std::make_shared<CInstantSendLock>();
-        vRecv >> *islock;
-        ProcessMessageInstantSendLock(pfrom, islock);
+        SpanReader(vRecv.GetType(), vRecv.GetVersion(), view.GetSpan()) >> *islock;
+        ProcessMessageInstantSendLock(pfrom, islock, hash);
     }
 }
 
-void CInstantSendManager::ProcessMessageInstantSendLock(CNode* pfrom, const llmq::CInstantSendLockPtr& islock)
+void CInstantSendManager::ProcessMessageInstantSendLock(CNode* pfrom, const llmq::CInstantSendLockPtr& islock, const uint256& hash)
 {
-    auto hash = ::SerializeHash(*islock);
-
     {
         LOCK(cs_main);
         EraseObjectRequest(pfrom->GetId(), CInv(MSG_ISLOCK, hash));
@@ -805,9 +986,9 @@ bool CInstantSendManager::ProcessPendingInstantSendLocks()
 
     {
         LOCK(cs);
-        // only process a max 32 locks at a time to avoid duplicate verification of recovered signatures which have been
-        // verified by CSigningManager in parallel
-        const size_t maxCount = 32;
+        // only process a max 32 locks per BLS worker thread at a time to avoid duplicate verification of recovered
+        // signatures which have been verified by CSigningManager in parallel
+        const size_t maxCount = MAX_PENDING_INSTANTSEND_LOCKS_PER_WORKER * std::max<size_t>(blsWorker.GetWorkerCount(), 1);
         if (pendingInstantSendLocks.size() <= maxCount) {
             pend = std::move(pendingInstantSendLocks);
         } else {
@@ -855,8 +1036,12 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
 {
     auto llmqType = Params().GetConsensus().llmqTypeInstantSend;
 
-    CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, true, 8);
+    // islocks are grouped by the quorum that signed them and verified in chunks of at most 8 messages, with the chunks
+    // being distributed over the BLS worker threads
+    CBLSParallelBatchVerifier<NodeId, uint256, uint256> batchVerifier(blsWorker, false, true, 8);
     std::unordered_map<uint256, CRecoveredSig> recSigs;
+    // islock hash -> quorum which signed it, for the latency stats
+    std::unordered_map<uint256, uint256, StaticSaltedHasher> islockQuorums;
 
     size_t verifyCount = 0;
     size_t alreadyVerified = 0;
@@ -887,8 +1072,9 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
             // should not happen, but if one fails to select, all others will also fail to select
             return {};
         }
+        islockQuorums.emplace(hash, quorum->qc.quorumHash);
         uint256 signHash = CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, islock->txid);
-        batchVerifier.PushMessage(nodeId, hash, signHash, islock->sig.Get(), quorum->qc.quorumPublicKey);
+        batchVerifier.PushMessage(quorum->qc.quorumHash, nodeId, hash, signHash, islock->sig.Get(), quorum->qc.quorumPublicKey);
         verifyCount++;
 
         // We can reconstruct the CRecoveredSig objects from the islock and pass it to the signing manager, which
@@ -909,8 +1095,8 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
     batchVerifier.Verify();
     verifyTimer.stop();
 
-    LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- verified locks. count=%d, alreadyVerified=%d, vt=%d, nodes=%d\n", __func__,
-            verifyCount, alreadyVerified, verifyTimer.count(), batchVerifier.GetUniqueSourceCount());
+    LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- verified locks. count=%d, alreadyVerified=%d, vt=%d, nodes=%d, batches=%d\n", __func__,
+            verifyCount, alreadyVerified, verifyTimer.count(), batchVerifier.GetUniqueSourceCount(), batchVerifier.GetBatchCount());
 
     std::unordered_set<uint256> badISLocks;
 
@@ -934,7 +1120,8 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
             continue;
         }
 
-        ProcessInstantSendLock(nodeId, hash, islock);
+        auto itQuorum = islockQuorums.find(hash);
+        ProcessInstantSendLock(nodeId, hash, islock, itQuorum != islockQuorums.end() ? itQuorum->second : uint256());
 
         // See comment further on top. We pass a reconstructed recovered sig to the signing manager to avoid
         // double-verification of the sig.
@@ -953,7 +1140,7 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
     return badISLocks;
 }
 
-void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLockPtr& islock)
+void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLockPtr& islock, const uint256& quorumHash)
 {
     {
         LOCK(cs);
@@ -969,6 +1156,10 @@ void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& has
         }
     }
 
+    pipelineLatencies.RecordStage(LatencyEvent::TX_FIRST_SEEN, islock->txid, LatencyStage::IS_TX_TO_ISLOCK, true,
+                                  Params().GetConsensus().llmqTypeInstantSend, quorumHash);
+    pipelineLatencies.EraseEvent(LatencyEvent::TX_INPUTS_LOCKED, islock->txid);
+
     CTransactionRef tx;
     uint256 hashBlock;
     const CBlockIndex* pindexMined{nullptr};
@@ -1003,9 +1194,11 @@ void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& has
             }
         }
 
-        db.WriteNewInstantSendLock(hash, *islock);
+        db.WriteNewInstantSendLock(hash, islock);
         if (pindexMined) {
             db.WriteInstantSendLockMined(hash, pindexMined->nHeight);
+        } else if (tx != nullptr) {
+            AddLockedTxForCompactBlocks(tx);
         }
 
         // This will also add children TXs to pendingRetryTxs
@@ -1042,6 +1235,8 @@ void CInstantSendManager::TransactionAddedToMempool(const CTransactionRef& tx)
         return;
     }
 
+    pipelineLatencies.AddEvent(LatencyEvent::TX_FIRST_SEEN, tx->GetHash());
+
     CInstantSendLockPtr islock{nullptr};
     {
         LOCK(cs);
@@ -1049,15 +1244,16 @@ void CInstantSendManager::TransactionAddedToMempool(const CTransactionRef& tx)
     }
 
     if (islock == nullptr) {
-        ProcessTx(*tx, false, Params().GetConsensus());
         // TX is not locked, so make sure it is tracked
         LOCK(cs);
         AddNonLockedTx(tx, nullptr);
+        pendingSignTxs.emplace_back(tx);
     } else {
         {
             // TX is locked, so make sure we don't track it anymore
             LOCK(cs);
             RemoveNonLockedTx(tx->GetHash(), true);
+            AddLockedTxForCompactBlocks(tx);
         }
         // If the islock was received before the TX, we know we were not able to send
         // the notification at that time, we need to do it now.
@@ -1066,6 +1262,44 @@ void CInstantSendManager::TransactionAddedToMempool(const CTransactionRef& tx)
     }
 }
 
+void CInstantSendManager::LoadMempoolLocks(const std::vector<CInstantSendLockPtr>& vISLocks)
+{
+    if (!IsInstantSendEnabled()) {
+        return;
+    }
+
+    size_t nRestored = 0;
+    size_t nPending = 0;
+    for (const auto& islock : vISLocks) {
+        if (!PreVerifyInstantSendLock(*islock)) {
+            continue;
+        }
+        CTransactionRef tx = mempool.get(islock->txid);
+        if (tx == nullptr) {
+            continue;
+        }
+        uint256 hash = ::SerializeHash(*islock);
+
+        {
+            LOCK(cs);
+            if (!db.KnownInstantSendLock(hash)) {
+                // Not in our db anymore, verify it like a lock received from the network
+                if (pendingInstantSendLocks.emplace(hash, std::make_pair(-1, islock)).second) {
+                    nPending++;
+                }
+                continue;
+            }
+            // TransactionAddedToMempool skips this while the blockchain is not synced
+            RemoveNonLockedTx(tx->GetHash(), true);
+            AddLockedTxForCompactBlocks(tx);
+        }
+        GetMainSignals().NotifyTransactionLock(tx, islock);
+        nRestored++;
+    }
+
+    LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- restored %d locks, %d pending verification\n", __func__, nRestored, nPending);
+}
+
 void CInstantSendManager::TransactionRemovedFromMempool(const CTransactionRef& tx)
 {
     if (tx->vin.empty() || !fUpgradedDB) {
@@ -1104,10 +1338,10 @@ void CInstantSendManager::BlockConnected(const std::shared_ptr<const CBlock>& pb
             }
 
             if (!IsLocked(tx->GetHash()) && !chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
-                ProcessTx(*tx, true, Params().GetConsensus());
                 // TX is not locked, so make sure it is tracked
                 LOCK(cs);
                 AddNonLockedTx(tx, pindex);
+                pendingRetroactiveSignTxs.emplace(std::make_pair(pindex->nHeight, tx->GetHash()), std::make_pair(pindex, tx));
             } else {
                 // TX is locked, so make sure we don't track it anymore
                 LOCK(cs);
@@ -1118,6 +1352,19 @@ void CInstantSendManager::BlockConnected(const std::shared_ptr<const CBlock>& pb
 
     LOCK(cs);
     db.WriteBlockInstantSendLocks(pblock, pindex);
+
+    for (const auto& tx : pblock->vtx) {
+        lockedTxsForCompactBlocks.erase(tx->GetHash());
+    }
+    // Locked TXs which did not get mined for a while are most likely conflicted or were never seen by miners
+    nLockedTxsForCompactBlocksHeight = pindex->nHeight;
+    for (auto it = lockedTxsForCompactBlocks.begin(); it != lockedTxsForCompactBlocks.end(); ) {
+        if (it->second.second + LOCKED_TXS_FOR_COMPACT_BLOCKS_EXPIRY < pindex->nHeight) {
+            it = lockedTxsForCompactBlocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 void CInstantSendManager::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected)
@@ -1183,6 +1430,15 @@ void CInstantSendManager::RemoveNonLockedTx(const uint256& txid, bool retryChild
              txid.ToString(), retryChildren, retryChildrenCount);
 }
 
+void CInstantSendManager::AddLockedTxForCompactBlocks(const CTransactionRef& tx)
+{
+    AssertLockHeld(cs);
+    if (lockedTxsForCompactBlocks.size() >= MAX_LOCKED_TXS_FOR_COMPACT_BLOCKS) {
+        return;
+    }
+    lockedTxsForCompactBlocks.emplace(tx->GetHash(), std::make_pair(tx, nLockedTxsForCompactBlocksHeight));
+}
+
 void CInstantSendManager::RemoveConflictedTx(const CTransaction& tx)
 {
     AssertLockHeld(cs);
@@ -1508,6 +1764,50 @@ void CInstantSendManager::ProcessPendingRetryLockTxs()
     }
 }
 
+bool CInstantSendManager::ProcessPendingSignTxs()
+{
+    // bounds the time fresh mempool TXs might have to wait for retroactive TXs
+    static const size_t MAX_RETROACTIVE_TXS_PER_ROUND = 16;
+
+    std::vector<CTransactionRef> txs;
+    {
+        LOCK(cs);
+        txs.swap(pendingSignTxs);
+    }
+    for (const auto& tx : txs) {
+        ProcessTx(*tx, false, Params().GetConsensus());
+    }
+
+    for (size_t i = 0; i < MAX_RETROACTIVE_TXS_PER_ROUND && !workInterrupt; i++) {
+        const CBlockIndex* pindex;
+        CTransactionRef tx;
+        {
+            LOCK(cs);
+            if (!pendingSignTxs.empty() || pendingRetroactiveSignTxs.empty()) {
+                break;
+            }
+            auto it = pendingRetroactiveSignTxs.begin();
+            std::tie(pindex, tx) = it->second;
+            pendingRetroactiveSignTxs.erase(it);
+        }
+
+        {
+            LOCK(cs_main);
+            if (!chainActive.Contains(pindex)) {
+                // disconnected in the meantime, the TX went back into the mempool or was conflicted
+                continue;
+            }
+        }
+        if (IsLocked(tx->GetHash()) || chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+            continue;
+        }
+        ProcessTx(*tx, true, Params().GetConsensus());
+    }
+
+    LOCK(cs);
+    return !pendingSignTxs.empty() || !pendingRetroactiveSignTxs.empty();
+}
+
 bool CInstantSendManager::AlreadyHave(const CInv& inv) const
 {
     if (!IsInstantSendEnabled()) {
@@ -1554,6 +1854,26 @@ bool CInstantSendManager::GetInstantSendLockHashByTxid(const uint256& txid, uint
     return !ret.IsNull();
 }
 
+CInstantSendLockEntryPtr CInstantSendManager::GetInstantSendLockEntryByHash(const uint256& hash) const
+{
+    if (!IsInstantSendEnabled()) {
+        return nullptr;
+    }
+
+    LOCK(cs);
+    return db.GetInstantSendLockEntryByHash(hash);
+}
+
+CInstantSendLockEntryPtr CInstantSendManager::GetInstantSendLockEntryByTxid(const uint256& txid) const
+{
+    if (!IsInstantSendEnabled()) {
+        return nullptr;
+    }
+
+    LOCK(cs);
+    return db.GetInstantSendLockEntryByTxid(txid);
+}
+
 bool CInstantSendManager::IsLocked(const uint256& txHash) const
 {
     if (!IsInstantSendEnabled()) {
@@ -1594,10 +1914,67 @@ size_t CInstantSendManager::GetInstantSendLockCount() const
     return db.GetInstantSendLockCount();
 }
 
+CInstantSendManager::SignQueueStats CInstantSendManager::GetSignQueueStats() const
+{
+    SignQueueStats stats;
+
+    LOCK(cs);
+    stats.mempoolCount = pendingSignTxs.size();
+    stats.retroactiveCount = pendingRetroactiveSignTxs.size();
+    if (!pendingRetroactiveSignTxs.empty()) {
+        stats.retroactiveMinHeight = pendingRetroactiveSignTxs.begin()->first.first;
+        stats.retroactiveMaxHeight = pendingRetroactiveSignTxs.rbegin()->first.first;
+    }
+    return stats;
+}
+
+size_t CInstantSendManager::GetMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t usage = db.GetMemoryUsage();
+    usage += memusage::DynamicUsage(inputRequestIds) +
+             memusage::DynamicUsage(creatingInstantSendLocks) +
+             memusage::DynamicUsage(txToCreatingInstantSendLocks) +
+             memusage::DynamicUsage(pendingInstantSendLocks) +
+             memusage::DynamicUsage(nonLockedTxs) +
+             memusage::DynamicUsage(nonLockedTxsByOutpoints) +
+             memusage::DynamicUsage(pendingRetryTxs) +
+             memusage::DynamicUsage(pendingSignTxs) +
+             memusage::DynamicUsage(pendingRetroactiveSignTxs) +
+             memusage::DynamicUsage(lockedTxsForCompactBlocks);
+    for (const auto& p : creatingInstantSendLocks) {
+        usage += memusage::DynamicUsage(p.second.inputs);
+    }
+    for (const auto& p : pendingInstantSendLocks) {
+        usage += InstantSendLockDynamicUsage(p.second.second);
+    }
+    for (const auto& p : nonLockedTxs) {
+        usage += memusage::DynamicUsage(p.second.children);
+    }
+    return usage;
+}
+
+std::vector<std::pair<uint256, CTransactionRef>> CInstantSendManager::GetLockedTxsForCompactBlocks() const
+{
+    std::vector<std::pair<uint256, CTransactionRef>> ret;
+    if (!IsInstantSendEnabled()) {
+        return ret;
+    }
+
+    LOCK(cs);
+    ret.reserve(lockedTxsForCompactBlocks.size());
+    for (const auto& p : lockedTxsForCompactBlocks) {
+        ret.emplace_back(p.first, p.second.first);
+    }
+    return ret;
+}
+
 void CInstantSendManager::WorkThreadMain()
 {
     while (!workInterrupt) {
         bool fMoreWork = ProcessPendingInstantSendLocks();
+        fMoreWork |= ProcessPendingSignTxs();
         ProcessPendingRetryLockTxs();
 
         if (!fMoreWork && !workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
@@ -8,15 +8,27 @@
 #include <llmq/quorums_signing.h>
 
 #include <coins.h>
+#include <hash.h>
+#include <streams.h>
 #include <unordered_lru_cache.h>
 #include <primitives/transaction.h>
 
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 
 namespace llmq
 {
 
+// maximum number of pending islocks processed in one go, per BLS worker thread
+static const size_t MAX_PENDING_INSTANTSEND_LOCKS_PER_WORKER = 32;
+// memory budget (in MiB) for the in-memory index of islocks by input and txid, 0 disables the index
+static const int64_t DEFAULT_ISLOCK_INDEX_MEMORY = 0;
+// maximum number of locked but not yet mined TXs kept around for compact block reconstruction
+static const size_t MAX_LOCKED_TXS_FOR_COMPACT_BLOCKS = 10000;
+// number of blocks after which a locked TX that did not get mined is dropped from the compact block reconstruction pool
+static const int LOCKED_TXS_FOR_COMPACT_BLOCKS_EXPIRY = 24;
+
 class CInstantSendLock
 {
 public:
@@ -40,6 +52,46 @@ public:
 
 typedef std::shared_ptr<CInstantSendLock> CInstantSendLockPtr;
 
+// A known islock together with its hash and its serialization. Shared by P2P relay, REST and ZMQ, so that known islocks
+// are not serialized again for every peer and notification
+struct CInstantSendLockEntry
+{
+    uint256 hash;
+    CInstantSendLockPtr islock;
+    std::vector<unsigned char> bytes;
+
+    CInstantSendLockEntry(const uint256& _hash, const CInstantSendLockPtr& _islock);
+};
+typedef std::shared_ptr<const CInstantSendLockEntry> CInstantSendLockEntryPtr;
+
+// Read-only view of a serialized CInstantSendLock. It points into the buffer of the SpanReader it was read from and must
+// thus not outlive that buffer. The hash of an ISLOCK is the hash of its serialization, so it can be computed from the
+// view without deserializing the inputs and the signature
+class CInstantSendLockView
+{
+private:
+    const unsigned char* begin{nullptr};
+    size_t len{0};
+
+public:
+    void Unserialize(SpanReader& s)
+    {
+        const unsigned char* p = s.data();
+        size_t sizeBefore = s.size();
+        uint64_t inputsCount = ReadCompactSize(s);
+        // COutPoint is a hash and an index
+        if (inputsCount > s.size() / (sizeof(uint256) + sizeof(uint32_t))) {
+            throw std::ios_base::failure("CInstantSendLockView: end of data");
+        }
+        s.ignore(inputsCount * (sizeof(uint256) + sizeof(uint32_t)) + sizeof(uint256) + CBLSSignature::SerSize);
+        begin = p;
+        len = sizeBefore - s.size();
+    }
+
+    uint256 GetHash() const { return Hash(begin, begin + len); }
+    Span<const unsigned char> GetSpan() const { return Span<const unsigned char>(begin, len); }
+};
+
 class CInstantSendDb
 {
 private:
@@ -47,19 +99,43 @@ private:
 
     CDBWrapper& db;
 
-    mutable unordered_lru_cache<uint256, CInstantSendLockPtr, StaticSaltedHasher, 10000> islockCache;
-    mutable unordered_lru_cache<uint256, uint256, StaticSaltedHasher, 10000> txidCache;
-    mutable unordered_lru_cache<COutPoint, uint256, SaltedOutpointHasher, 10000> outpointCache;
+    mutable concurrent_unordered_lru_cache<uint256, CInstantSendLockPtr, StaticSaltedHasher, 10000> islockCache;
+    mutable concurrent_unordered_lru_cache<uint256, uint256, StaticSaltedHasher, 10000> txidCache;
+    mutable concurrent_unordered_lru_cache<COutPoint, uint256, SaltedOutpointHasher, 10000> outpointCache;
+    // by txid
+    mutable concurrent_unordered_lru_cache<uint256, CInstantSendLockEntryPtr, StaticSaltedHasher, 10000> entryCache;
+
+    /**
+     * Optional in-memory index of all islocks by input and by txid. While "indexComplete" is set, the index holds
+     * every islock found in the database and lookups of inputs/txids which are not in it don't need to hit the
+     * database. If the index grows beyond "indexMaxMemory", it is dropped and lookups fall back to the database.
+     */
+    size_t indexMaxMemory{0};
+    bool indexComplete{false};
+    std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> indexByOutpoint;
+    std::unordered_map<uint256, uint256, StaticSaltedHasher> indexByTxid;
 
     void WriteInstantSendLockMined(CDBBatch& batch, const uint256& hash, int nHeight);
     void RemoveInstantSendLockMined(CDBBatch& batch, const uint256& hash, int nHeight);
 
+    void AddToIndex(const uint256& hash, const CInstantSendLock& islock);
+    void RemoveFromIndex(const CInstantSendLock& islock);
+    void DropIndex();
+
 public:
     explicit CInstantSendDb(CDBWrapper& _db);
 
     void Upgrade();
 
-    void WriteNewInstantSendLock(const uint256& hash, const CInstantSendLock& islock);
+    /**
+     * (Re)builds the in-memory index from all islocks found in the database. A maxMemory of 0 disables the index.
+     */
+    void BuildIndex(size_t maxMemory);
+    size_t GetIndexMemoryUsage() const;
+    // Memory used by the caches and the index
+    size_t GetMemoryUsage() const;
+
+    void WriteNewInstantSendLock(const uint256& hash, const CInstantSendLockPtr& islock);
     void RemoveInstantSendLock(CDBBatch& batch, const uint256& hash, CInstantSendLockPtr islock, bool keep_cache = true);
 
     void WriteInstantSendLockMined(const uint256& hash, int nHeight);
@@ -75,6 +151,8 @@ public:
     uint256 GetInstantSendLockHashByTxid(const uint256& txid) const;
     CInstantSendLockPtr GetInstantSendLockByTxid(const uint256& txid) const;
     CInstantSendLockPtr GetInstantSendLockByInput(const COutPoint& outpoint) const;
+    CInstantSendLockEntryPtr GetInstantSendLockEntryByHash(const uint256& hash) const;
+    CInstantSendLockEntryPtr GetInstantSendLockEntryByTxid(const uint256& txid) const;
 
     std::vector<uint256> GetInstantSendLocksByParent(const uint256& parent) const;
     std::vector<uint256> RemoveChainedInstantSendLocks(const uint256& islockHash, const uint256& txid, int nHeight);
@@ -85,6 +163,7 @@ class CInstantSendManager : public CRecoveredSigsListener
 private:
     mutable CCriticalSection cs;
     CInstantSendDb db;
+    CBLSWorker& blsWorker;
 
     std::atomic<bool> fUpgradedDB{false};
 
@@ -121,8 +200,24 @@ private:
 
     std::unordered_set<uint256, StaticSaltedHasher> pendingRetryTxs;
 
+    /**
+     * TXs waiting to be processed (and signed) by the worker thread. Mempool TXs always go first. Retroactive signing of
+     * mined TXs only matters for ChainLocks, so these wait until the mempool queue is empty and are then processed in
+     * the order of the blocks, keyed by (height, txid).
+     */
+    std::vector<CTransactionRef> pendingSignTxs;
+    std::map<std::pair<int, uint256>, std::pair<const CBlockIndex*, CTransactionRef>> pendingRetroactiveSignTxs;
+
+    /**
+     * Locked TXs which are not mined yet, together with the tip height at the time they were added. Locked TXs are
+     * almost guaranteed to end up in the next block, so these are used for compact block reconstruction even when the
+     * TX already left (or never entered) our mempool.
+     */
+    std::unordered_map<uint256, std::pair<CTransactionRef, int>, StaticSaltedHasher> lockedTxsForCompactBlocks;
+    int nLockedTxsForCompactBlocksHeight{0};
+
 public:
-    explicit CInstantSendManager(CDBWrapper& _llmqDb);
+    CInstantSendManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWorker);
     ~CInstantSendManager();
 
     void Start();
@@ -144,14 +239,17 @@ public:
     bool TrySignInputLocks(const CTransaction& tx, bool allowResigning, Consensus::LLMQType llmqType);
     void TrySignInstantSendLock(const CTransaction& tx);
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
-    void ProcessMessageInstantSendLock(CNode* pfrom, const CInstantSendLockPtr& islock);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv);
+    void ProcessMessageInstantSendLock(CNode* pfrom, const CInstantSendLockPtr& islock, const uint256& hash);
     static bool PreVerifyInstantSendLock(const CInstantSendLock& islock);
     bool ProcessPendingInstantSendLocks();
     std::unordered_set<uint256> ProcessPendingInstantSendLocks(int signOffset, const std::unordered_map<uint256, std::pair<NodeId, CInstantSendLockPtr>, StaticSaltedHasher>& pend, bool ban);
-    void ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLockPtr& islock);
+    // quorumHash is the quorum which signed the islock, if known
+    void ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLockPtr& islock, const uint256& quorumHash);
 
     void TransactionAddedToMempool(const CTransactionRef& tx);
+    // Restores the locks of the mempool transactions loaded from mempool.dat
+    void LoadMempoolLocks(const std::vector<CInstantSendLockPtr>& vISLocks);
     void TransactionRemovedFromMempool(const CTransactionRef& tx);
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted);
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected);
@@ -159,6 +257,7 @@ public:
     void AddNonLockedTx(const CTransactionRef& tx, const CBlockIndex* pindexMined);
     void RemoveNonLockedTx(const uint256& txid, bool retryChildren);
     void RemoveConflictedTx(const CTransaction& tx);
+    void AddLockedTxForCompactBlocks(const CTransactionRef& tx);
     void TruncateRecoveredSigsForInputs(const CInstantSendLock& islock);
 
     void NotifyChainLock(const CBlockIndex* pindexChainLock);
@@ -171,14 +270,32 @@ public:
     void RemoveConflictingLock(const uint256& islockHash, const CInstantSendLock& islock);
     static void AskNodesForLockedTx(const uint256& txid);
     void ProcessPendingRetryLockTxs();
+    bool ProcessPendingSignTxs();
 
     bool AlreadyHave(const CInv& inv) const;
     bool GetInstantSendLockByHash(const uint256& hash, CInstantSendLock& ret) const;
     CInstantSendLockPtr GetInstantSendLockByTxid(const uint256& txid) const;
     bool GetInstantSendLockHashByTxid(const uint256& txid, uint256& ret) const;
+    CInstantSendLockEntryPtr GetInstantSendLockEntryByHash(const uint256& hash) const;
+    CInstantSendLockEntryPtr GetInstantSendLockEntryByTxid(const uint256& txid) const;
 
     size_t GetInstantSendLockCount() const;
 
+    struct SignQueueStats {
+        size_t mempoolCount{0};
+        size_t retroactiveCount{0};
+        // heights of the lowest and highest block with queued retroactive TXs, -1 if there are none
+        int retroactiveMinHeight{-1};
+        int retroactiveMaxHeight{-1};
+    };
+    SignQueueStats GetSignQueueStats() const;
+
+    std::vector<std::pair<uint256, CTransactionRef>> GetLockedTxsForCompactBlocks() const;
+
+    // Memory used by the in-progress and pending islocks and the db caches. Transactions are shared with the mempool
+    // and blocks and are not counted
+    size_t GetMemoryUsage() const;
+
     void WorkThreadMain();
 };
 
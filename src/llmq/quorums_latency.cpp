@@ -0,0 +1,157 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <llmq/quorums_latency.h>
+
+#include <statsd_client.h>
+#include <tinyformat.h>
+#include <utiltime.h>
+
+#include <univalue.h>
+
+#include <algorithm>
+
+namespace llmq
+{
+
+CLatencyTracker pipelineLatencies;
+
+const std::array<int64_t, 12> CLatencyHistogram::BUCKET_LIMITS{{10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000}};
+
+void CLatencyHistogram::Add(int64_t latencyMillis)
+{
+    latencyMillis = std::max(latencyMillis, (int64_t)0);
+    // the first bucket whose limit is not below the latency, the last one if there is none
+    size_t i = std::lower_bound(BUCKET_LIMITS.begin(), BUCKET_LIMITS.end(), latencyMillis) - BUCKET_LIMITS.begin();
+    buckets[i]++;
+    count++;
+    totalMillis += latencyMillis;
+    maxMillis = std::max(maxMillis, latencyMillis);
+}
+
+UniValue CLatencyHistogram::ToJson() const
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", count);
+    obj.pushKV("avg_ms", count != 0 ? totalMillis / (int64_t)count : 0);
+    obj.pushKV("max_ms", maxMillis);
+    UniValue histogram(UniValue::VOBJ);
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (i < BUCKET_LIMITS.size()) {
+            histogram.pushKV(strprintf("<=%dms", BUCKET_LIMITS[i]), buckets[i]);
+        } else {
+            histogram.pushKV(strprintf(">%dms", BUCKET_LIMITS.back()), buckets[i]);
+        }
+    }
+    obj.pushKV("histogram", histogram);
+    return obj;
+}
+
+const std::array<std::string, (size_t)LatencyStage::COUNT> CLatencyTracker::STAGE_NAMES{{
+    "instantsend.txToInputVotes",
+    "instantsend.txToInputLocks",
+    "instantsend.inputLocksToIslock",
+    "instantsend.txToIslock",
+    "chainlocks.blockToClsig",
+}};
+
+void CLatencyTracker::AddEvent(LatencyEvent event, const uint256& hash)
+{
+    int64_t nNowMillis = GetTimeMillis();
+
+    LOCK(cs);
+    Cleanup(nNowMillis);
+    auto& times = eventTimes[(size_t)event];
+    if (times.size() < MAX_PENDING_EVENTS) {
+        times.emplace(hash, nNowMillis);
+    }
+}
+
+bool CLatencyTracker::RecordStage(LatencyEvent event, const uint256& hash, LatencyStage stage, bool fEraseEvent,
+                                  Consensus::LLMQType llmqType, const uint256& quorumHash)
+{
+    int64_t nLatency;
+    {
+        LOCK(cs);
+        auto& times = eventTimes[(size_t)event];
+        auto it = times.find(hash);
+        if (it == times.end()) {
+            return false;
+        }
+        int64_t nNowMillis = GetTimeMillis();
+        nLatency = std::max(nNowMillis - it->second, (int64_t)0);
+        if (fEraseEvent) {
+            times.erase(it);
+        }
+        histograms[(size_t)stage].Add(nLatency);
+        if (llmqType != Consensus::LLMQ_NONE && !quorumHash.IsNull()) {
+            auto& stats = quorumStats[std::make_tuple(stage, llmqType, quorumHash)];
+            stats.histogram.Add(nLatency);
+            stats.lastTime = nNowMillis;
+        }
+    }
+
+    statsClient.timing(STAGE_NAMES[(size_t)stage], nLatency, 1.0f);
+    return true;
+}
+
+void CLatencyTracker::EraseEvent(LatencyEvent event, const uint256& hash)
+{
+    LOCK(cs);
+    eventTimes[(size_t)event].erase(hash);
+}
+
+void CLatencyTracker::Cleanup(int64_t nNowMillis)
+{
+    if (nNowMillis - lastCleanupTime < CLEANUP_INTERVAL) {
+        return;
+    }
+    lastCleanupTime = nNowMillis;
+
+    for (auto& times : eventTimes) {
+        for (auto it = times.begin(); it != times.end(); ) {
+            if (nNowMillis - it->second > EVENT_TIMEOUT) {
+                it = times.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto it = quorumStats.begin(); it != quorumStats.end(); ) {
+        if (nNowMillis - it->second.lastTime > QUORUM_STATS_TIMEOUT) {
+            it = quorumStats.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::map<std::string, CLatencyHistogram> CLatencyTracker::GetStats()
+{
+    std::map<std::string, CLatencyHistogram> ret;
+    LOCK(cs);
+    for (size_t i = 0; i < histograms.size(); i++) {
+        ret.emplace(STAGE_NAMES[i], histograms[i]);
+    }
+    return ret;
+}
+
+std::map<CLatencyTracker::QuorumStageKey, CLatencyHistogram> CLatencyTracker::GetQuorumStats()
+{
+    std::map<QuorumStageKey, CLatencyHistogram> ret;
+    LOCK(cs);
+    for (const auto& p : quorumStats) {
+        ret.emplace(p.first, p.second.histogram);
+    }
+    return ret;
+}
+
+void CLatencyTracker::Reset()
+{
+    LOCK(cs);
+    histograms.fill(CLatencyHistogram());
+    quorumStats.clear();
+}
+
+} // namespace llmq
@@ -0,0 +1,112 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LLMQ_QUORUMS_LATENCY_H
+#define BITCOIN_LLMQ_QUORUMS_LATENCY_H
+
+#include <consensus/params.h>
+#include <saltedhasher.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <array>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+class UniValue;
+
+namespace llmq
+{
+
+/** Histogram of latencies in milliseconds */
+class CLatencyHistogram
+{
+public:
+    // upper bounds of all but the last bucket, in milliseconds
+    static const std::array<int64_t, 12> BUCKET_LIMITS;
+
+    std::array<uint64_t, 13> buckets{};
+    uint64_t count{0};
+    int64_t totalMillis{0};
+    int64_t maxMillis{0};
+
+    void Add(int64_t latencyMillis);
+    UniValue ToJson() const;
+};
+
+/** Events which start the measurement of one or more pipeline stages */
+enum class LatencyEvent : int {
+    TX_FIRST_SEEN,      // tx entered the mempool
+    TX_INPUTS_LOCKED,   // recovered sigs for all inputs of a tx are known
+    BLOCK_RECEIVED,     // block header was accepted
+    COUNT,
+};
+
+/** Pipeline stages, each ends at a later event of the same tx or block */
+enum class LatencyStage : int {
+    IS_TX_TO_INPUT_VOTES,       // TX_FIRST_SEEN -> we voted on the inputs (TrySignInputLocks)
+    IS_TX_TO_INPUT_LOCKS,       // TX_FIRST_SEEN -> recovered sigs for all inputs (TrySignInstantSendLock)
+    IS_INPUT_LOCKS_TO_ISLOCK,   // TX_INPUTS_LOCKED -> recovered sig for our ISLOCK
+    IS_TX_TO_ISLOCK,            // TX_FIRST_SEEN -> ISLOCK received or produced
+    CL_BLOCK_TO_CLSIG,          // BLOCK_RECEIVED -> CLSIG received or produced
+    COUNT,
+};
+
+/**
+ * Keeps the times of the pipeline events of recent txes and blocks and the latency histograms of the InstantSend and
+ * ChainLocks pipeline stages. Every latency is also sent to statsd as a timing. Stages which end with a signature of a
+ * known quorum are additionally kept per quorum, so that slow quorums can be told apart.
+ */
+class CLatencyTracker
+{
+public:
+    typedef std::tuple<LatencyStage, Consensus::LLMQType, uint256> QuorumStageKey;
+
+private:
+    // events which don't end a stage within this time are forgotten
+    static const int64_t EVENT_TIMEOUT = 10 * 60 * 1000;
+    static const int64_t CLEANUP_INTERVAL = 60 * 1000;
+    // limit per event type, new events are ignored when it's reached
+    static const size_t MAX_PENDING_EVENTS = 20000;
+    // quorums which didn't sign anything within this time are forgotten
+    static const int64_t QUORUM_STATS_TIMEOUT = 60 * 60 * 1000;
+
+    struct QuorumStats {
+        CLatencyHistogram histogram;
+        int64_t lastTime{0};
+    };
+
+    CCriticalSection cs;
+    std::array<std::unordered_map<uint256, int64_t, StaticSaltedHasher>, (size_t)LatencyEvent::COUNT> eventTimes GUARDED_BY(cs);
+    std::array<CLatencyHistogram, (size_t)LatencyStage::COUNT> histograms GUARDED_BY(cs);
+    std::map<QuorumStageKey, QuorumStats> quorumStats GUARDED_BY(cs);
+    int64_t lastCleanupTime GUARDED_BY(cs){0};
+
+    void Cleanup(int64_t nNowMillis) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    static const std::array<std::string, (size_t)LatencyStage::COUNT> STAGE_NAMES;
+
+    /** Remember the time of event for hash, unless it was already seen */
+    void AddEvent(LatencyEvent event, const uint256& hash);
+    /**
+     * Record the time since event for hash as a latency of stage, returns false if the event is not known. If the
+     * quorum which signed is known, the latency is also recorded for it
+     */
+    bool RecordStage(LatencyEvent event, const uint256& hash, LatencyStage stage, bool fEraseEvent = false,
+                     Consensus::LLMQType llmqType = Consensus::LLMQ_NONE, const uint256& quorumHash = uint256());
+    void EraseEvent(LatencyEvent event, const uint256& hash);
+
+    std::map<std::string, CLatencyHistogram> GetStats();
+    std::map<QuorumStageKey, CLatencyHistogram> GetQuorumStats();
+    void Reset();
+};
+
+extern CLatencyTracker pipelineLatencies;
+
+} // namespace llmq
+
+#endif // BITCOIN_LLMQ_QUORUMS_LATENCY_H
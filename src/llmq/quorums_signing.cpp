@@ -9,6 +9,7 @@
 #include <masternode/activemasternode.h>
 #include <bls/bls_batchverifier.h>
 #include <cxxtimer.hpp>
+#include <memusage.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <scheduler.h>
@@ -22,6 +23,20 @@ namespace llmq
 
 CSigningManager* quorumSigningManager;
 
+/**
+ * The signing active quorums of all LLMQ types at a chain tip, for the start heights which result from the sign
+ * offsets 0 and SIGN_HEIGHT_OFFSET. Built once per tip, so that selecting a quorum for an islock, recovered sig or
+ * ChainLock needs neither cs_main nor a scan of the quorums.
+ */
+struct CActiveQuorumSets
+{
+    const CBlockIndex* pindexTip;
+    // (start height, llmqType) -> quorums as returned by ScanQuorums
+    std::map<std::pair<int, Consensus::LLMQType>, std::vector<CQuorumCPtr>> mapSets;
+};
+// only accessed through std::atomic_load/std::atomic_store, nullptr during initial block download
+static std::shared_ptr<const CActiveQuorumSets> activeQuorumSets;
+
 UniValue CRecoveredSig::ToJson() const
 {
     UniValue ret(UniValue::VOBJ);
@@ -39,15 +54,21 @@ CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& _db) :
 {
     if (Params().NetworkIDString() == CBaseChainParams::TESTNET) {
         // TODO this can be completely removed after some time (when we're pretty sure the conversion has been run on most testnet MNs)
-        if (db.Exists(std::string("rs_upgraded"))) {
-            return;
+        if (!db.Exists(std::string("rs_upgraded"))) {
+            ConvertInvalidTimeKeys();
+            AddVoteTimeKeys();
+
+            db.Write(std::string("rs_upgraded"), (uint8_t)1);
         }
+    }
 
-        ConvertInvalidTimeKeys();
-        AddVoteTimeKeys();
+    if (!db.Exists(std::string("rs_windowed"))) {
+        ConvertTimeKeysToTimeWindows();
 
-        db.Write(std::string("rs_upgraded"), (uint8_t)1);
+        db.Write(std::string("rs_windowed"), (uint8_t)1);
     }
+
+    RebuildPrefilter();
 }
 
 // This converts time values in "rs_t" from host endiannes to big endiannes, which is required to have proper ordering of the keys
@@ -123,8 +144,152 @@ void CRecoveredSigsDb::AddVoteTimeKeys()
     LogPrintf("CRecoveredSigsDb::%s -- added %d rs_vt entries\n", __func__, cnt);
 }
 
+// This replaces all "rs_t" keys with "rs_w" keys, which group recovered sigs by time window and store all hashes that
+// are needed to later remove the recovered sig without reading it
+void CRecoveredSigsDb::ConvertTimeKeysToTimeWindows()
+{
+    LogPrintf("CRecoveredSigsDb::%s -- converting rs_t keys to rs_w keys\n", __func__);
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    auto start = std::make_tuple(std::string("rs_t"), (uint32_t)0, (Consensus::LLMQType)0, uint256());
+    pcursor->Seek(start);
+
+    CDBBatch batch(db);
+    size_t cnt = 0;
+    while (pcursor->Valid()) {
+        decltype(start) k;
+
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_t") {
+            break;
+        }
+
+        uint32_t writeTime = be32toh(std::get<1>(k));
+        Consensus::LLMQType llmqType = std::get<2>(k);
+        const uint256& id = std::get<3>(k);
+
+        // if the recovered sig was truncated before, we can't recover the hashes anymore. The remaining byHash key
+        // will then stay in the DB, which is what happened before as well
+        CRecoveredSig recSig;
+        std::tuple<uint256, uint256, uint256> v;
+        if (ReadRecoveredSig(llmqType, id, recSig)) {
+            v = std::make_tuple(recSig.msgHash, recSig.GetHash(), CLLMQUtils::BuildSignHash(recSig));
+        }
+
+        batch.Erase(k);
+        auto k2 = std::make_tuple(std::string("rs_w"), (uint32_t)htobe32(GetTimeWindow(writeTime)), llmqType, id);
+        batch.Write(k2, v);
+
+        cnt++;
+        if (batch.SizeEstimate() >= (1 << 24)) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+
+        pcursor->Next();
+    }
+    pcursor.reset();
+
+    db.WriteBatch(batch);
+
+    LogPrintf("CRecoveredSigsDb::%s -- converted %d rs_t keys\n", __func__, cnt);
+}
+
+void CRecoveredSigsDb::RebuildPrefilter()
+{
+    {
+        LOCK(cs);
+        fRebuildingPrefilter = true;
+        prefilterRebuildQueue.clear();
+    }
+
+    auto start = std::make_tuple(std::string("rs_w"), (uint32_t)0, (Consensus::LLMQType)0, uint256());
+
+    // first pass only counts the entries so that we know how large the new filter must be
+    size_t cnt = 0;
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(start);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_w") {
+            break;
+        }
+        cnt++;
+        pcursor->Next();
+    }
+
+    size_t capacity = std::max(MIN_PREFILTER_ELEMENTS, cnt * 2 * 2);
+    auto newPrefilter = std::make_unique<CRollingBloomFilter>(capacity, PREFILTER_FP_RATE);
+    size_t inserts = 0;
+
+    // recovered sigs written while we iterate are added to prefilterRebuildQueue
+    pcursor->Seek(start);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+        std::tuple<uint256, uint256, uint256> v;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_w") {
+            break;
+        }
+        newPrefilter->insert(GetPrefilterIdKey(std::get<2>(k), std::get<3>(k)));
+        inserts++;
+        if (pcursor->GetValue(v) && !std::get<2>(v).IsNull()) {
+            newPrefilter->insert(std::get<2>(v));
+            inserts++;
+        }
+        pcursor->Next();
+    }
+    pcursor.reset();
+
+    LOCK(cs);
+    for (auto& k : prefilterRebuildQueue) {
+        newPrefilter->insert(k);
+        inserts++;
+    }
+    if (inserts < capacity) {
+        prefilter = std::move(newPrefilter);
+        prefilterCapacity = capacity;
+        prefilterInserts = inserts;
+    } else {
+        prefilter.reset();
+    }
+    fRebuildingPrefilter = false;
+    prefilterRebuildQueue.clear();
+
+    LogPrint(BCLog::LLMQ, "CRecoveredSigsDb::%s -- rebuilt prefilter with %d elements, capacity=%d\n", __func__, inserts, capacity);
+}
+
+bool CRecoveredSigsDb::PrefilterMayContain(const uint256& k)
+{
+    AssertLockHeld(cs);
+    return !prefilter || prefilter->contains(k);
+}
+
+void CRecoveredSigsDb::PrefilterInsert(const uint256& k)
+{
+    AssertLockHeld(cs);
+    if (fRebuildingPrefilter) {
+        prefilterRebuildQueue.emplace_back(k);
+    }
+    if (!prefilter) {
+        return;
+    }
+    if (++prefilterInserts >= prefilterCapacity) {
+        // the filter would start to forget old elements, so we can't use it anymore until the next rebuild
+        prefilter.reset();
+        return;
+    }
+    prefilter->insert(k);
+}
+
 bool CRecoveredSigsDb::HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
+    {
+        LOCK(cs);
+        if (!PrefilterMayContain(GetPrefilterIdKey(llmqType, id))) {
+            return false;
+        }
+    }
+
     auto k = std::make_tuple(std::string("rs_r"), llmqType, id, msgHash);
     return db.Exists(k);
 }
@@ -133,18 +298,19 @@ bool CRecoveredSigsDb::HasRecoveredSigForId(Consensus::LLMQType llmqType, const
 {
     auto cacheKey = std::make_pair(llmqType, id);
     bool ret;
+    if (hasSigForIdCache.get(cacheKey, ret)) {
+        return ret;
+    }
     {
         LOCK(cs);
-        if (hasSigForIdCache.get(cacheKey, ret)) {
-            return ret;
+        if (!PrefilterMayContain(GetPrefilterIdKey(llmqType, id))) {
+            return false;
         }
     }
 
-
     auto k = std::make_tuple(std::string("rs_r"), llmqType, id);
     ret = db.Exists(k);
 
-    LOCK(cs);
     hasSigForIdCache.insert(cacheKey, ret);
     return ret;
 }
@@ -152,17 +318,19 @@ bool CRecoveredSigsDb::HasRecoveredSigForId(Consensus::LLMQType llmqType, const
 bool CRecoveredSigsDb::HasRecoveredSigForSession(const uint256& signHash)
 {
     bool ret;
+    if (hasSigForSessionCache.get(signHash, ret)) {
+        return ret;
+    }
     {
         LOCK(cs);
-        if (hasSigForSessionCache.get(signHash, ret)) {
-            return ret;
+        if (!PrefilterMayContain(signHash)) {
+            return false;
         }
     }
 
     auto k = std::make_tuple(std::string("rs_s"), signHash);
     ret = db.Exists(k);
 
-    LOCK(cs);
     hasSigForSessionCache.insert(signHash, ret);
     return ret;
 }
@@ -170,17 +338,13 @@ bool CRecoveredSigsDb::HasRecoveredSigForSession(const uint256& signHash)
 bool CRecoveredSigsDb::HasRecoveredSigForHash(const uint256& hash)
 {
     bool ret;
-    {
-        LOCK(cs);
-        if (hasSigForHashCache.get(hash, ret)) {
-            return ret;
-        }
+    if (hasSigForHashCache.get(hash, ret)) {
+        return ret;
     }
 
     auto k = std::make_tuple(std::string("rs_h"), hash);
     ret = db.Exists(k);
 
-    LOCK(cs);
     hasSigForHashCache.insert(hash, ret);
     return ret;
 }
@@ -241,18 +405,22 @@ void CRecoveredSigsDb::WriteRecoveredSig(const llmq::CRecoveredSig& recSig)
     auto k4 = std::make_tuple(std::string("rs_s"), signHash);
     batch.Write(k4, (uint8_t)1);
 
-    // store by current time. Allows fast cleanup of old recSigs
-    auto k5 = std::make_tuple(std::string("rs_t"), (uint32_t)htobe32(curTime), recSig.llmqType, recSig.id);
-    batch.Write(k5, (uint8_t)1);
-
-    db.WriteBatch(batch);
+    // store by time window of the current time. Allows fast cleanup of old recSigs
+    auto k5 = std::make_tuple(std::string("rs_w"), (uint32_t)htobe32(GetTimeWindow(curTime)), recSig.llmqType, recSig.id);
+    batch.Write(k5, std::make_tuple(recSig.msgHash, recSig.GetHash(), signHash));
 
     {
+        // must happen before the DB write, otherwise a concurrent lookup might miss the new recovered sig
         LOCK(cs);
-        hasSigForIdCache.insert(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id), true);
-        hasSigForSessionCache.insert(signHash, true);
-        hasSigForHashCache.insert(recSig.GetHash(), true);
+        PrefilterInsert(GetPrefilterIdKey(recSig.llmqType, recSig.id));
+        PrefilterInsert(signHash);
     }
+
+    db.WriteBatchAsync(batch);
+
+    hasSigForIdCache.insert(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id), true);
+    hasSigForSessionCache.insert(signHash, true);
+    hasSigForHashCache.insert(recSig.GetHash(), true);
 }
 
 void CRecoveredSigsDb::RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteHashKey, bool deleteTimeKey)
@@ -283,7 +451,7 @@ void CRecoveredSigsDb::RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType l
         if (db.ReadDataStream(k2, writeTimeDs) && writeTimeDs.size() == sizeof(uint32_t)) {
             uint32_t writeTime;
             writeTimeDs >> writeTime;
-            auto k5 = std::make_tuple(std::string("rs_t"), (uint32_t) htobe32(writeTime), recSig.llmqType, recSig.id);
+            auto k5 = std::make_tuple(std::string("rs_w"), (uint32_t) htobe32(GetTimeWindow(writeTime)), recSig.llmqType, recSig.id);
             batch.Erase(k5);
         }
     }
@@ -316,27 +484,37 @@ void CRecoveredSigsDb::TruncateRecoveredSig(Consensus::LLMQType llmqType, const
 
 void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
 {
+    bool fNeedRebuild;
+    {
+        LOCK(cs);
+        fNeedRebuild = !prefilter || prefilterInserts >= prefilterCapacity * 3 / 4;
+    }
+    if (fNeedRebuild) {
+        RebuildPrefilter();
+    }
+
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
 
-    auto start = std::make_tuple(std::string("rs_t"), (uint32_t)0, (Consensus::LLMQType)0, uint256());
-    uint32_t endTime = (uint32_t)(GetAdjustedTime() - maxAge);
+    auto start = std::make_tuple(std::string("rs_w"), (uint32_t)0, (Consensus::LLMQType)0, uint256());
+    // only windows which are completely older than maxAge are removed
+    uint32_t endWindow = GetTimeWindow((uint32_t)(GetAdjustedTime() - maxAge));
     pcursor->Seek(start);
 
-    std::vector<std::pair<Consensus::LLMQType, uint256>> toDelete;
-    std::vector<decltype(start)> toDelete2;
+    std::vector<std::pair<decltype(start), std::tuple<uint256, uint256, uint256>>> toDelete;
 
     while (pcursor->Valid()) {
         decltype(start) k;
+        std::tuple<uint256, uint256, uint256> v;
 
-        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_t") {
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_w") {
             break;
         }
-        if (be32toh(std::get<1>(k)) >= endTime) {
+        if (be32toh(std::get<1>(k)) >= endWindow) {
             break;
         }
-
-        toDelete.emplace_back(std::get<2>(k), std::get<3>(k));
-        toDelete2.emplace_back(k);
+        if (pcursor->GetValue(v)) {
+            toDelete.emplace_back(k, v);
+        }
 
         pcursor->Next();
     }
@@ -350,7 +528,21 @@ void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
     {
         LOCK(cs);
         for (auto& e : toDelete) {
-            RemoveRecoveredSig(batch, e.first, e.second, true, false);
+            Consensus::LLMQType llmqType = std::get<2>(e.first);
+            const uint256& id = std::get<3>(e.first);
+            const uint256& msgHash = std::get<0>(e.second);
+            const uint256& recSigHash = std::get<1>(e.second);
+            const uint256& signHash = std::get<2>(e.second);
+
+            batch.Erase(std::make_tuple(std::string("rs_r"), llmqType, id));
+            batch.Erase(std::make_tuple(std::string("rs_r"), llmqType, id, msgHash));
+            batch.Erase(std::make_tuple(std::string("rs_h"), recSigHash));
+            batch.Erase(std::make_tuple(std::string("rs_s"), signHash));
+            batch.Erase(e.first);
+
+            hasSigForIdCache.erase(std::make_pair(llmqType, id));
+            hasSigForSessionCache.erase(signHash);
+            hasSigForHashCache.erase(recSigHash);
 
             if (batch.SizeEstimate() >= (1 << 24)) {
                 db.WriteBatch(batch);
@@ -359,10 +551,6 @@ void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
         }
     }
 
-    for (auto& e : toDelete2) {
-        batch.Erase(e);
-    }
-
     db.WriteBatch(batch);
 
     LogPrint(BCLog::LLMQ, "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, toDelete.size());
@@ -389,7 +577,7 @@ void CRecoveredSigsDb::WriteVoteForId(Consensus::LLMQType llmqType, const uint25
     batch.Write(k1, msgHash);
     batch.Write(k2, (uint8_t)1);
 
-    db.WriteBatch(batch);
+    db.WriteBatchAsync(batch);
 }
 
 void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
@@ -467,7 +655,7 @@ bool CSigningManager::GetRecoveredSigForGetData(const uint256& hash, CRecoveredS
     return true;
 }
 
-void CSigningManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CSigningManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     if (strCommand == NetMsgType::QSIGREC) {
         std::shared_ptr<CRecoveredSig> recoveredSig = std::make_shared<CRecoveredSig>();
@@ -601,6 +789,61 @@ void CSigningManager::CollectPendingRecoveredSigsToVerify(
     }
 }
 
+// Memory used by a pending recovered sig, including its list node and the buffer of the lazy signature
+static size_t PendingRecoveredSigDynamicUsage()
+{
+    return memusage::MallocUsage(sizeof(memusage::stl_list_node<std::shared_ptr<const CRecoveredSig>>)) +
+           memusage::MallocUsage(sizeof(CRecoveredSig)) + memusage::MallocUsage(sizeof(memusage::stl_shared_counter)) +
+           memusage::MallocUsage(CBLSSignature::SerSize);
+}
+
+size_t CSigningManager::GetPendingRecoveredSigsMemoryUsage()
+{
+    LOCK(cs);
+    size_t count = 0;
+    for (const auto& p : pendingRecoveredSigs) {
+        count += p.second.size();
+    }
+    count += pendingReconstructedRecoveredSigs.size();
+    return memusage::DynamicUsage(pendingRecoveredSigs) + memusage::DynamicUsage(pendingReconstructedRecoveredSigs) +
+           count * PendingRecoveredSigDynamicUsage();
+}
+
+size_t CSigningManager::EvictPendingRecoveredSigs(size_t bytesToFree, size_t& retEvicted)
+{
+    LOCK(cs);
+    retEvicted = 0;
+    size_t bytesFreed = 0;
+    // Reconstructed sigs are known to be valid, so only the ones received from peers are dropped. Honest peers
+    // announce them again through other connections
+    while (bytesFreed < bytesToFree) {
+        auto itMax = pendingRecoveredSigs.end();
+        for (auto it = pendingRecoveredSigs.begin(); it != pendingRecoveredSigs.end(); ++it) {
+            if (!it->second.empty() && (itMax == pendingRecoveredSigs.end() || it->second.size() > itMax->second.size())) {
+                itMax = it;
+            }
+        }
+        if (itMax == pendingRecoveredSigs.end()) {
+            break;
+        }
+        // down to the size of the next biggest queue, so that the peers with the most pending sigs lose the most
+        size_t nextSize = 0;
+        for (const auto& p : pendingRecoveredSigs) {
+            if (p.first != itMax->first) {
+                nextSize = std::max(nextSize, p.second.size());
+            }
+        }
+        auto& l = itMax->second;
+        do {
+            l.pop_back();
+            bytesFreed += PendingRecoveredSigDynamicUsage();
+            retEvicted++;
+        } while (!l.empty() && l.size() >= nextSize && bytesFreed < bytesToFree);
+    }
+    evictedRecoveredSigsCounter += retEvicted;
+    return bytesFreed;
+}
+
 void CSigningManager::ProcessPendingReconstructedRecoveredSigs()
 {
     decltype(pendingReconstructedRecoveredSigs) m;
@@ -781,6 +1024,55 @@ void CSigningManager::UnregisterRecoveredSigsListener(CRecoveredSigsListener* l)
 
 bool CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash, const uint256& quorumHash, bool allowReSign)
 {
+    CQuorumCPtr quorum;
+    if (!PrepareSignIfMember(llmqType, id, msgHash, quorumHash, allowReSign, quorum)) {
+        return false;
+    }
+    if (!quorum) {
+        return true;
+    }
+
+    if (allowReSign) {
+        // make us re-announce all known shares (other nodes might have run into a timeout)
+        quorumSigSharesManager->ForceReAnnouncement(quorum, llmqType, id, msgHash);
+    }
+    quorumSigSharesManager->AsyncSign(quorum, id, msgHash);
+
+    return true;
+}
+
+std::vector<bool> CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const std::vector<std::pair<uint256, uint256>>& idsAndMsgHashes, bool allowReSign)
+{
+    std::vector<bool> ret(idsAndMsgHashes.size(), false);
+    std::map<uint256, std::pair<CQuorumCPtr, std::vector<std::pair<uint256, uint256>>>> toSign;
+
+    for (size_t i = 0; i < idsAndMsgHashes.size(); i++) {
+        const auto& id = idsAndMsgHashes[i].first;
+        const auto& msgHash = idsAndMsgHashes[i].second;
+        CQuorumCPtr quorum;
+        ret[i] = PrepareSignIfMember(llmqType, id, msgHash, uint256(), allowReSign, quorum);
+        if (!quorum) {
+            continue;
+        }
+        if (allowReSign) {
+            quorumSigSharesManager->ForceReAnnouncement(quorum, llmqType, id, msgHash);
+        }
+        auto& e = toSign[quorum->qc.quorumHash];
+        e.first = quorum;
+        e.second.emplace_back(id, msgHash);
+    }
+
+    for (auto& p : toSign) {
+        quorumSigSharesManager->AsyncSign(p.second.first, std::move(p.second.second));
+    }
+
+    return ret;
+}
+
+bool CSigningManager::PrepareSignIfMember(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash, const uint256& quorumHash, bool allowReSign, CQuorumCPtr& quorumRet)
+{
+    quorumRet = nullptr;
+
     if (!fMasternodeMode || activeMasternodeInfo.proTxHash.IsNull()) {
         return false;
     }
@@ -836,12 +1128,7 @@ bool CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const uint
         }
     }
 
-    if (allowReSign) {
-        // make us re-announce all known shares (other nodes might have run into a timeout)
-        quorumSigSharesManager->ForceReAnnouncement(quorum, llmqType, id, msgHash);
-    }
-    quorumSigSharesManager->AsyncSign(quorum, id, msgHash);
-
+    quorumRet = quorum;
     return true;
 }
 
@@ -894,8 +1181,62 @@ bool CSigningManager::GetVoteForId(Consensus::LLMQType llmqType, const uint256&
     return db.GetVoteForId(llmqType, id, msgHashRet);
 }
 
+void CSigningManager::UpdatedBlockTip(const CBlockIndex* pindexNew, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == nullptr || quorumManager == nullptr) {
+        std::atomic_store(&activeQuorumSets, std::shared_ptr<const CActiveQuorumSets>());
+        return;
+    }
+
+    auto newSets = std::make_shared<CActiveQuorumSets>();
+    newSets->pindexTip = pindexNew;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        for (int signOffset : {0, SIGN_HEIGHT_OFFSET}) {
+            const int startBlockHeight = pindexNew->nHeight - signOffset;
+            if (startBlockHeight < 0) {
+                continue;
+            }
+            auto quorums = quorumManager->ScanQuorums(p.first, pindexNew->GetAncestor(startBlockHeight), (size_t)p.second.signingActiveQuorumCount);
+            newSets->mapSets.emplace(std::make_pair(startBlockHeight, p.first), std::move(quorums));
+        }
+    }
+    std::atomic_store(&activeQuorumSets, std::shared_ptr<const CActiveQuorumSets>(std::move(newSets)));
+}
+
+static CQuorumCPtr SelectQuorumFromSet(Consensus::LLMQType llmqType, const std::vector<CQuorumCPtr>& quorums, const uint256& selectionHash)
+{
+    // The quorum with the lowest score wins, same as sorting by (score, index)
+    const CQuorumCPtr* pBest{nullptr};
+    uint256 bestScore;
+    for (const auto& quorum : quorums) {
+        CHashWriter h(SER_NETWORK, 0);
+        h << llmqType;
+        h << quorum->qc.quorumHash;
+        h << selectionHash;
+        uint256 score = h.GetHash();
+        if (pBest == nullptr || score < bestScore) {
+            pBest = &quorum;
+            bestScore = score;
+        }
+    }
+    return pBest ? *pBest : nullptr;
+}
+
 CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType, const uint256& selectionHash, int signHeight, int signOffset)
 {
+    auto sets = std::atomic_load(&activeQuorumSets);
+    if (sets) {
+        const int tipHeight = sets->pindexTip->nHeight;
+        const int startBlockHeight = (signHeight == -1 ? tipHeight : signHeight) - signOffset;
+        if (startBlockHeight >= 0 && startBlockHeight <= tipHeight) {
+            auto it = sets->mapSets.find(std::make_pair(startBlockHeight, llmqType));
+            if (it != sets->mapSets.end()) {
+                return SelectQuorumFromSet(llmqType, it->second, selectionHash);
+            }
+        }
+    }
+
+    // Not precomputed, e.g. signatures from further in the past
     auto& llmqParams = Params().GetConsensus().llmqs.at(llmqType);
     size_t poolSize = (size_t)llmqParams.signingActiveQuorumCount;
 
@@ -913,21 +1254,7 @@ CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType
     }
 
     auto quorums = quorumManager->ScanQuorums(llmqType, pindexStart, poolSize);
-    if (quorums.empty()) {
-        return nullptr;
-    }
-
-    std::vector<std::pair<uint256, size_t>> scores;
-    scores.reserve(quorums.size());
-    for (size_t i = 0; i < quorums.size(); i++) {
-        CHashWriter h(SER_NETWORK, 0);
-        h << llmqType;
-        h << quorums[i]->qc.quorumHash;
-        h << selectionHash;
-        scores.emplace_back(h.GetHash(), i);
-    }
-    std::sort(scores.begin(), scores.end());
-    return quorums[scores.front().second];
+    return SelectQuorumFromSet(llmqType, quorums, selectionHash);
 }
 
 bool CSigningManager::VerifyRecoveredSig(Consensus::LLMQType llmqType, int signedAtHeight, const uint256& id, const uint256& msgHash, const CBLSSignature& sig, const int signOffset)
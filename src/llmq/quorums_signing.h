@@ -7,11 +7,13 @@
 
 #include <llmq/quorums.h>
 
+#include <bloom.h>
 #include <chainparams.h>
 #include <saltedhasher.h>
 #include <univalue.h>
 #include <unordered_lru_cache.h>
 
+#include <atomic>
 #include <unordered_map>
 
 typedef int64_t NodeId;
@@ -68,18 +70,39 @@ public:
 class CRecoveredSigsDb
 {
 private:
+    // Recovered sigs are indexed by the time window in which they were written ("rs_w" keys). Cleanup only drops
+    // whole windows and gets everything needed to do so from the index entries, so it doesn't need to read the
+    // recovered sigs themselves
+    static const uint32_t TIME_WINDOW_SIZE = 60 * 60;
+
+    // The prefilter is sized for at least this many elements (2 per recovered sig)
+    static const size_t MIN_PREFILTER_ELEMENTS = 200000;
+    static constexpr double PREFILTER_FP_RATE = 0.001;
+
     CDBWrapper& db;
 
     CCriticalSection cs;
-    unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher, 30000> hasSigForIdCache;
-    unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForSessionCache;
-    unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForHashCache;
+    // the caches are thread-safe on their own, cs doesn't need to be held to access them
+    concurrent_unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher, 30000> hasSigForIdCache;
+    concurrent_unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForSessionCache;
+    concurrent_unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForHashCache;
+
+    // Contains the id and sign hash of every recovered sig in the DB (and of some which were removed already), so if
+    // it doesn't contain an element, we can skip the DB lookup. It must be rebuilt before more than prefilterCapacity
+    // elements were inserted, as the rolling filter would otherwise forget about older elements. A null prefilter
+    // means that all lookups must go to the DB
+    std::unique_ptr<CRollingBloomFilter> prefilter;
+    size_t prefilterCapacity{0};
+    size_t prefilterInserts{0};
+    bool fRebuildingPrefilter{false};
+    std::vector<uint256> prefilterRebuildQueue;
 
 public:
     explicit CRecoveredSigsDb(CDBWrapper& _db);
 
     void ConvertInvalidTimeKeys();
     void AddVoteTimeKeys();
+    void ConvertTimeKeysToTimeWindows();
 
     bool HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
     bool HasRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id);
@@ -92,6 +115,7 @@ public:
     void TruncateRecoveredSig(Consensus::LLMQType llmqType, const uint256& id);
 
     void CleanupOldRecoveredSigs(int64_t maxAge);
+    void RebuildPrefilter();
 
     // votes are removed when the recovered sig is written to the db
     bool HasVotedOnId(Consensus::LLMQType llmqType, const uint256& id);
@@ -101,6 +125,12 @@ public:
     void CleanupOldVotes(int64_t maxAge);
 
 private:
+    static uint32_t GetTimeWindow(uint32_t time) { return time - (time % TIME_WINDOW_SIZE); }
+
+    static uint256 GetPrefilterIdKey(Consensus::LLMQType llmqType, const uint256& id) { return ::SerializeHash(std::make_pair(llmqType, id)); }
+    bool PrefilterMayContain(const uint256& k);
+    void PrefilterInsert(const uint256& k);
+
     bool ReadRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret);
     void RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteHashKey, bool deleteTimeKey);
 };
@@ -135,6 +165,7 @@ private:
     FastRandomContext rnd;
 
     int64_t lastCleanupTime{0};
+    std::atomic<uint64_t> evictedRecoveredSigsCounter{0};
 
     std::vector<CRecoveredSigsListener*> recoveredSigsListeners;
 
@@ -144,7 +175,7 @@ public:
     bool AlreadyHave(const CInv& inv);
     bool GetRecoveredSigForGetData(const uint256& hash, CRecoveredSig& ret);
 
-    void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pnode, const std::string& strCommand, CPublicDataStream& vRecv);
 
     // This is called when a recovered signature was was reconstructed from another P2P message and is known to be valid
     // This is the case for example when a signature appears as part of InstantSend or ChainLocks
@@ -168,22 +199,39 @@ private:
     void ProcessRecoveredSig(const std::shared_ptr<const CRecoveredSig>& recoveredSig);
     void Cleanup(); // called from the worker thread of CSigSharesManager
 
+    // Checks if we are a member of the quorum which signs id and records our vote for msgHash. Returns what
+    // AsyncSignIfMember returns and sets quorumRet to the quorum which must sign, which stays null when no signing is
+    // needed
+    bool PrepareSignIfMember(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash, const uint256& quorumHash, bool allowReSign, CQuorumCPtr& quorumRet);
+
+    // Memory used by not yet verified recovered sigs, part of the memory budget of CSigSharesManager
+    size_t GetPendingRecoveredSigsMemoryUsage();
+    // Drops not yet verified recovered sigs, newest first from the peers with the most pending ones, until about
+    // bytesToFree bytes were freed. Returns the number of freed bytes
+    size_t EvictPendingRecoveredSigs(size_t bytesToFree, size_t& retEvicted);
+
 public:
     // public interface
     void RegisterRecoveredSigsListener(CRecoveredSigsListener* l);
     void UnregisterRecoveredSigsListener(CRecoveredSigsListener* l);
 
     bool AsyncSignIfMember(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash, const uint256& quorumHash = uint256(), bool allowReSign = false);
+    // Same as calling AsyncSignIfMember for every (id, msgHash) pair, but the sig shares of each quorum are created
+    // and sent together. Returns the result of AsyncSignIfMember for each pair
+    std::vector<bool> AsyncSignIfMember(Consensus::LLMQType llmqType, const std::vector<std::pair<uint256, uint256>>& idsAndMsgHashes, bool allowReSign = false);
     bool HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
     bool HasRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id);
     bool HasRecoveredSigForSession(const uint256& signHash);
     bool GetRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& retRecSig);
     bool IsConflicting(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
 
+    uint64_t GetEvictedRecoveredSigsCount() const { return evictedRecoveredSigsCounter; }
+
     bool HasVotedOnId(Consensus::LLMQType llmqType, const uint256& id);
     bool GetVoteForId(Consensus::LLMQType llmqType, const uint256& id, uint256& msgHashRet);
 
-    static std::vector<CQuorumCPtr> GetActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight);
+    // Precomputes the active quorum sets of all LLMQ types for the new tip. Called synchronously while cs_main is held
+    static void UpdatedBlockTip(const CBlockIndex* pindexNew, bool fInitialDownload);
     static CQuorumCPtr SelectQuorumForSigning(Consensus::LLMQType llmqType, const uint256& selectionHash, int signHeight = -1 /*chain tip*/, int signOffset = SIGN_HEIGHT_OFFSET);
 
     // Verifies a recovered sig that was signed while the chain tip was at signedAtTip
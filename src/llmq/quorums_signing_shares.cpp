@@ -12,6 +12,7 @@
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <spork.h>
+#include <utilmemory.h>
 #include <validation.h>
 
 #include <cxxtimer.hpp>
@@ -27,6 +28,15 @@ void CSigShare::UpdateKey()
     key.second = quorumMember;
 }
 
+void CSigShare::UpdateKeys(std::vector<CSigShare>& sigShares)
+{
+    auto signHashes = CLLMQUtils::BuildSignHashes(sigShares);
+    for (size_t i = 0; i < sigShares.size(); i++) {
+        sigShares[i].key.first = signHashes[i];
+        sigShares[i].key.second = sigShares[i].quorumMember;
+    }
+}
+
 std::string CSigSesAnn::ToString() const
 {
     return strprintf("sessionId=%d, llmqType=%d, quorumHash=%s, id=%s, msgHash=%s",
@@ -101,6 +111,17 @@ std::string CBatchedSigShares::ToInvString() const
     return inv.ToString();
 }
 
+std::string CBatchedSigSharesView::ToInvString() const
+{
+    CSigSharesInv inv;
+    // we use 400 here no matter what the real size is. We don't really care about that size as we just want to call ToString()
+    inv.Init(400);
+    for (size_t i = 0; i < count; i++) {
+        inv.inv[GetQuorumMember(i)] = true;
+    }
+    return inv.ToString();
+}
+
 template<typename T>
 static void InitSession(CSigSharesNodeState::Session& s, const uint256& signHash, T& from)
 {
@@ -125,9 +146,8 @@ CSigSharesNodeState::Session& CSigSharesNodeState::GetOrCreateSessionFromShare(c
     return s;
 }
 
-CSigSharesNodeState::Session& CSigSharesNodeState::GetOrCreateSessionFromAnn(const llmq::CSigSesAnn& ann)
+CSigSharesNodeState::Session& CSigSharesNodeState::GetOrCreateSessionFromAnn(const llmq::CSigSesAnn& ann, const uint256& signHash)
 {
-    auto signHash = CLLMQUtils::BuildSignHash((Consensus::LLMQType)ann.llmqType, ann.quorumHash, ann.id, ann.msgHash);
     auto& s = sessions[signHash];
     if (s.announced.inv.empty()) {
         InitSession(s, signHash, ann);
@@ -180,11 +200,30 @@ void CSigSharesNodeState::RemoveSession(const uint256& signHash)
     pendingIncomingSigShares.EraseAllForSignHash(signHash);
 }
 
+size_t CSigSharesNodeState::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(sessions) + memusage::DynamicUsage(sessionByRecvId);
+    for (const auto& p : sessions) {
+        usage += p.second.DynamicMemoryUsage();
+    }
+    usage += pendingIncomingSigShares.DynamicMemoryUsage();
+    usage += requestedSigShares.DynamicMemoryUsage();
+    return usage;
+}
+
 //////////////////////
 
-CSigSharesManager::CSigSharesManager()
+CSigSharesManager::CSigSharesManager(CBLSWorker& _blsWorker) :
+    blsWorker(_blsWorker)
 {
     workInterrupt.reset();
+
+    int shardCount = std::max(1, std::min((int)gArgs.GetArg("-llmq-sigshares-threads", DEFAULT_SIGSHARES_THREADS), MAX_SIGSHARES_THREADS));
+    for (int i = 0; i < shardCount; i++) {
+        workerShards.emplace_back(MakeUnique<WorkerShard>());
+    }
+
+    maxMemoryUsage = (size_t)std::max<int64_t>(0, gArgs.GetArg("-llmq-signing-max-mem", DEFAULT_SIGNING_MAX_MEMORY)) * 1024 * 1024;
 }
 
 CSigSharesManager::~CSigSharesManager() = default;
@@ -199,6 +238,13 @@ void CSigSharesManager::StartWorkerThread()
     workThread = std::thread(&TraceThread<std::function<void()> >,
         "sigshares",
         std::function<void()>(std::bind(&CSigSharesManager::WorkThreadMain, this)));
+
+    // jobs which were queued before we started are executed now
+    for (size_t i = 0; i < workerShards.size(); i++) {
+        auto& shard = *workerShards[i];
+        shard.workerPool.resize(1);
+        RenameThreadPool(shard.workerPool, strprintf("dash-sigs-%d", i).c_str());
+    }
 }
 
 void CSigSharesManager::StopWorkerThread()
@@ -211,6 +257,11 @@ void CSigSharesManager::StopWorkerThread()
     if (workThread.joinable()) {
         workThread.join();
     }
+
+    for (auto& shard : workerShards) {
+        shard->workerPool.clear_queue();
+        shard->workerPool.stop(true);
+    }
 }
 
 void CSigSharesManager::RegisterAsRecoveredSigsListener()
@@ -228,14 +279,16 @@ void CSigSharesManager::InterruptWorkerThread()
     workInterrupt();
 }
 
-void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     // non-masternodes are not interested in sigshares
     if (!fMasternodeMode || activeMasternodeInfo.proTxHash.IsNull()) {
         return;
     }
 
-    if (sporkManager.IsSporkActive(SPORK_21_QUORUM_ALL_CONNECTED)) {
+    // Single sig shares are also pushed directly by verified masternodes when -llmq-fast-transport is enabled
+    if (sporkManager.IsSporkActive(SPORK_21_QUORUM_ALL_CONNECTED) ||
+        (g_connman->IsMasternodeFastTransportEnabled() && !pfrom->verifiedProRegTxHash.IsNull())) {
         if (strCommand == NetMsgType::QSIGSHARE) {
             std::vector<CSigShare> sigShares;
             vRecv >> sigShares;
@@ -245,6 +298,7 @@ void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strComma
                 BanNode(pfrom->GetId());
                 return;
             }
+            CSigShare::UpdateKeys(sigShares);
 
             for (auto& sigShare : sigShares) {
                 ProcessMessageSigShare(pfrom->GetId(), sigShare);
@@ -252,54 +306,65 @@ void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strComma
         }
     }
 
+    // Announcements and invs are read one by one from the message buffer, so that the count is checked before
+    // anything is deserialized. Invs reuse a single object, announcements are collected to hash them together
     if (strCommand == NetMsgType::QSIGSESANN) {
-        std::vector<CSigSesAnn> msgs;
-        vRecv >> msgs;
-        if (msgs.size() > MAX_MSGS_CNT_QSIGSESANN) {
-            LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many announcements in QSIGSESANN message. cnt=%d, max=%d, node=%d\n", __func__, msgs.size(), MAX_MSGS_CNT_QSIGSESANN, pfrom->GetId());
+        SpanReader reader = MakeSpanReader(vRecv);
+        VectorElementReader<CSigSesAnn> annReader(reader, CSigSesAnn::MIN_SERIALIZED_SIZE);
+        if (annReader.size() > MAX_MSGS_CNT_QSIGSESANN) {
+            LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many announcements in QSIGSESANN message. cnt=%d, max=%d, node=%d\n", __func__, annReader.size(), MAX_MSGS_CNT_QSIGSESANN, pfrom->GetId());
             BanNode(pfrom->GetId());
             return;
         }
-        for (auto& ann : msgs) {
-            if (!ProcessMessageSigSesAnn(pfrom, ann)) {
+        std::vector<CSigSesAnn> anns(annReader.size());
+        for (auto& ann : anns) {
+            annReader.Next(ann);
+        }
+        auto signHashes = CLLMQUtils::BuildSignHashes(anns);
+        for (size_t i = 0; i < anns.size(); i++) {
+            if (!ProcessMessageSigSesAnn(pfrom, anns[i], signHashes[i])) {
                 BanNode(pfrom->GetId());
                 return;
             }
         }
     } else if (strCommand == NetMsgType::QSIGSHARESINV) {
-        std::vector<CSigSharesInv> msgs;
-        vRecv >> msgs;
-        if (msgs.size() > MAX_MSGS_CNT_QSIGSHARESINV) {
-            LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many invs in QSIGSHARESINV message. cnt=%d, max=%d, node=%d\n", __func__, msgs.size(), MAX_MSGS_CNT_QSIGSHARESINV, pfrom->GetId());
+        SpanReader reader = MakeSpanReader(vRecv);
+        VectorElementReader<CSigSharesInv> invReader(reader, CSigSharesInv::MIN_SERIALIZED_SIZE);
+        if (invReader.size() > MAX_MSGS_CNT_QSIGSHARESINV) {
+            LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many invs in QSIGSHARESINV message. cnt=%d, max=%d, node=%d\n", __func__, invReader.size(), MAX_MSGS_CNT_QSIGSHARESINV, pfrom->GetId());
             BanNode(pfrom->GetId());
             return;
         }
-        for (auto& inv : msgs) {
+        CSigSharesInv inv;
+        while (invReader.Next(inv)) {
             if (!ProcessMessageSigSharesInv(pfrom, inv)) {
                 BanNode(pfrom->GetId());
                 return;
             }
         }
     } else if (strCommand == NetMsgType::QGETSIGSHARES) {
-        std::vector<CSigSharesInv> msgs;
-        vRecv >> msgs;
-        if (msgs.size() > MAX_MSGS_CNT_QGETSIGSHARES) {
-            LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many invs in QGETSIGSHARES message. cnt=%d, max=%d, node=%d\n", __func__, msgs.size(), MAX_MSGS_CNT_QGETSIGSHARES, pfrom->GetId());
+        SpanReader reader = MakeSpanReader(vRecv);
+        VectorElementReader<CSigSharesInv> invReader(reader, CSigSharesInv::MIN_SERIALIZED_SIZE);
+        if (invReader.size() > MAX_MSGS_CNT_QGETSIGSHARES) {
+            LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many invs in QGETSIGSHARES message. cnt=%d, max=%d, node=%d\n", __func__, invReader.size(), MAX_MSGS_CNT_QGETSIGSHARES, pfrom->GetId());
             BanNode(pfrom->GetId());
             return;
         }
-        for (auto& inv : msgs) {
+        CSigSharesInv inv;
+        while (invReader.Next(inv)) {
             if (!ProcessMessageGetSigShares(pfrom, inv)) {
                 BanNode(pfrom->GetId());
                 return;
             }
         }
     } else if (strCommand == NetMsgType::QBSIGSHARES) {
-        std::vector<CBatchedSigShares> msgs;
-        vRecv >> msgs;
+        // The views point into the buffer of vRecv, which stays valid while the message is processed. vRecv itself
+        // is not read from, as CDataStream frees its buffer when it's fully read
+        std::vector<CBatchedSigSharesView> msgs;
+        MakeSpanReader(vRecv) >> msgs;
         size_t totalSigsCount = 0;
         for (auto& bs : msgs) {
-            totalSigsCount += bs.sigShares.size();
+            totalSigsCount += bs.size();
         }
         if (totalSigsCount > MAX_MSGS_TOTAL_BATCHED_SIGS) {
             LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- too many sigs in QBSIGSHARES message. cnt=%d, max=%d, node=%d\n", __func__, msgs.size(), MAX_MSGS_TOTAL_BATCHED_SIGS, pfrom->GetId());
@@ -315,7 +380,7 @@ void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strComma
     }
 }
 
-bool CSigSharesManager::ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann)
+bool CSigSharesManager::ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann, const uint256& signHash)
 {
     auto llmqType = (Consensus::LLMQType)ann.llmqType;
     if (!Params().GetConsensus().llmqs.count(llmqType)) {
@@ -337,7 +402,7 @@ bool CSigSharesManager::ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn&
 
     LOCK(cs);
     auto& nodeState = nodeStates[pfrom->GetId()];
-    auto& session = nodeState.GetOrCreateSessionFromAnn(ann);
+    auto& session = nodeState.GetOrCreateSessionFromAnn(ann, signHash);
     nodeState.sessionByRecvId.erase(session.recvSessionId);
     nodeState.sessionByRecvId.erase(ann.sessionId);
     session.recvSessionId = ann.sessionId;
@@ -424,7 +489,7 @@ bool CSigSharesManager::ProcessMessageGetSigShares(CNode* pfrom, const CSigShare
     return true;
 }
 
-bool CSigSharesManager::ProcessMessageBatchedSigShares(CNode* pfrom, const CBatchedSigShares& batchedSigShares)
+bool CSigSharesManager::ProcessMessageBatchedSigShares(CNode* pfrom, const CBatchedSigSharesView& batchedSigShares)
 {
     CSigSharesNodeState::SessionInfo sessionInfo;
     if (!GetSessionInfoByRecvId(pfrom->GetId(), batchedSigShares.sessionId, sessionInfo)) {
@@ -437,35 +502,39 @@ bool CSigSharesManager::ProcessMessageBatchedSigShares(CNode* pfrom, const CBatc
     }
 
     std::vector<CSigShare> sigShares;
-    sigShares.reserve(batchedSigShares.sigShares.size());
+    sigShares.reserve(batchedSigShares.size());
 
     {
         LOCK(cs);
         auto& nodeState = nodeStates[pfrom->GetId()];
 
-        for (size_t i = 0; i < batchedSigShares.sigShares.size(); i++) {
-            CSigShare sigShare = RebuildSigShare(sessionInfo, batchedSigShares, i);
-            nodeState.requestedSigShares.Erase(sigShare.GetKey());
+        // all shares of the batch belong to the same session and thus the same id
+        bool hasRecoveredSig = quorumSigningManager->HasRecoveredSigForId(sessionInfo.llmqType, sessionInfo.id);
+
+        for (size_t i = 0; i < batchedSigShares.size(); i++) {
+            SigShareKey sigShareKey(sessionInfo.signHash, batchedSigShares.GetQuorumMember(i));
+            nodeState.requestedSigShares.Erase(sigShareKey);
 
             // TODO track invalid sig shares received for PoSe?
             // It's important to only skip seen *valid* sig shares here. If a node sends us a
             // batch of mostly valid sig shares with a single invalid one and thus batched
             // verification fails, we'd skip the valid ones in the future if received from other nodes
-            if (this->sigShares.Has(sigShare.GetKey())) {
+            if (this->sigShares.Has(sigShareKey)) {
                 continue;
             }
 
             // TODO for PoSe, we should consider propagating shares even if we already have a recovered sig
-            if (quorumSigningManager->HasRecoveredSigForId((Consensus::LLMQType)sigShare.llmqType, sigShare.id)) {
+            if (hasRecoveredSig) {
                 continue;
             }
 
-            sigShares.emplace_back(sigShare);
+            // only now copy the signature out of the message buffer
+            sigShares.emplace_back(RebuildSigShare(sessionInfo, batchedSigShares, i));
         }
     }
 
     LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- signHash=%s, shares=%d, new=%d, inv={%s}, node=%d\n", __func__,
-             sessionInfo.signHash.ToString(), batchedSigShares.sigShares.size(), sigShares.size(), batchedSigShares.ToInvString(), pfrom->GetId());
+             sessionInfo.signHash.ToString(), batchedSigShares.size(), sigShares.size(), batchedSigShares.ToInvString(), pfrom->GetId());
 
     if (sigShares.empty()) {
         return true;
@@ -530,7 +599,7 @@ void CSigSharesManager::ProcessMessageSigShare(NodeId fromId, const CSigShare& s
              sigShare.GetSignHash().ToString(), sigShare.id.ToString(), sigShare.msgHash.ToString(), sigShare.quorumMember, fromId);
 }
 
-bool CSigSharesManager::PreVerifyBatchedSigShares(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigShares& batchedSigShares, bool& retBan)
+bool CSigSharesManager::PreVerifyBatchedSigShares(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigSharesView& batchedSigShares, bool& retBan)
 {
     retBan = false;
 
@@ -551,8 +620,8 @@ bool CSigSharesManager::PreVerifyBatchedSigShares(const CSigSharesNodeState::Ses
 
     std::unordered_set<uint16_t> dupMembers;
 
-    for (const auto& sigShare : batchedSigShares.sigShares) {
-        auto quorumMember = sigShare.first;
+    for (size_t i = 0; i < batchedSigShares.size(); i++) {
+        auto quorumMember = batchedSigShares.GetQuorumMember(i);
         if (!dupMembers.emplace(quorumMember).second) {
             retBan = true;
             return false;
@@ -572,6 +641,16 @@ bool CSigSharesManager::PreVerifyBatchedSigShares(const CSigSharesNodeState::Ses
     return true;
 }
 
+size_t CSigSharesManager::GetPendingSigSharesCount()
+{
+    LOCK(cs);
+    size_t count = 0;
+    for (auto& p : nodeStates) {
+        count += p.second.pendingIncomingSigShares.Size();
+    }
+    return count;
+}
+
 void CSigSharesManager::CollectPendingSigSharesToVerify(
         size_t maxUniqueSessions,
         std::unordered_map<NodeId, std::vector<CSigShare>>& retSigShares,
@@ -639,7 +718,13 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
     std::unordered_map<NodeId, std::vector<CSigShare>> sigSharesByNodes;
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher> quorums;
 
-    const size_t nMaxBatchSize{32};
+    // Size the batch from the queue depth. When there is a lot to verify (e.g. an InstantSend spike), we take more
+    // sessions at once and spread them over all BLS worker threads. When the queue is short, we keep batches small
+    // to keep latency low
+    const size_t nWorkerCount = std::max(blsWorker.GetWorkerCount(), (size_t)1);
+    const size_t nPendingCount = GetPendingSigSharesCount();
+    const size_t nMaxBatchSize = std::max(MIN_PENDING_SIG_SHARES_BATCH_SIZE,
+                                          std::min(nPendingCount, MAX_PENDING_SIG_SHARES_BATCH_SIZE_PER_WORKER * nWorkerCount));
     CollectPendingSigSharesToVerify(nMaxBatchSize, sigSharesByNodes, quorums);
     if (sigSharesByNodes.empty()) {
         return false;
@@ -647,13 +732,28 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
 
     // It's ok to perform insecure batched verification here as we verify against the quorum public key shares,
     // which are not craftable by individual entities, making the rogue public key attack impossible
-    CBLSBatchVerifier<NodeId, SigShareKey> batchVerifier(false, true);
+    // Messages are identified by node and key, so that each node's shares are verified with its own signatures.
+    // All shares of a node always end up in the same sub-batch.
+    typedef CBLSBatchVerifier<NodeId, std::pair<NodeId, SigShareKey>> BatchVerifier;
+    const size_t nBatchCount = std::min(nWorkerCount, sigSharesByNodes.size());
+    std::vector<BatchVerifier> batchVerifiers;
+    std::vector<size_t> batchVerifyCounts(nBatchCount, 0);
+    batchVerifiers.reserve(nBatchCount);
+    for (size_t i = 0; i < nBatchCount; i++) {
+        batchVerifiers.emplace_back(false, true);
+    }
 
     cxxtimer::Timer prepareTimer(true);
     size_t verifyCount = 0;
+    size_t nodeIdx = 0;
     for (auto& p : sigSharesByNodes) {
         auto nodeId = p.first;
         auto& v = p.second;
+        size_t batchIdx = (nodeIdx++) % nBatchCount;
+
+        // only keep the shares which were actually pushed for verification
+        std::vector<CSigShare> pushedSigShares;
+        pushedSigShares.reserve(v.size());
 
         for (auto& sigShare : v) {
             if (quorumSigningManager->HasRecoveredSigForId((Consensus::LLMQType)sigShare.llmqType, sigShare.id)) {
@@ -678,34 +778,74 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
                 assert(false);
             }
 
-            batchVerifier.PushMessage(nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
+            batchVerifiers[batchIdx].PushMessage(nodeId, std::make_pair(nodeId, sigShare.GetKey()), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
+            batchVerifyCounts[batchIdx]++;
             verifyCount++;
+            pushedSigShares.emplace_back(sigShare);
         }
+        v = std::move(pushedSigShares);
     }
     prepareTimer.stop();
 
     cxxtimer::Timer verifyTimer(true);
-    batchVerifier.Verify();
+    std::vector<int64_t> batchVerifyTimes(nBatchCount, 0);
+    std::vector<std::future<void>> futures;
+    futures.reserve(nBatchCount);
+    for (size_t i = 0; i < nBatchCount; i++) {
+        if (batchVerifyCounts[i] == 0) {
+            continue;
+        }
+        futures.emplace_back(blsWorker.AsyncRun([&batchVerifiers, &batchVerifyTimes, i]() {
+            cxxtimer::Timer t(true);
+            batchVerifiers[i].Verify();
+            batchVerifyTimes[i] = t.count();
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
     verifyTimer.stop();
 
-    LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- verified sig shares. count=%d, pt=%d, vt=%d, nodes=%d\n", __func__, verifyCount, prepareTimer.count(), verifyTimer.count(), sigSharesByNodes.size());
+    for (size_t i = 0; i < nBatchCount; i++) {
+        if (batchVerifyCounts[i] == 0) {
+            continue;
+        }
+        LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- verified sig share batch. batch=%d, count=%d, badSources=%d, badShares=%d, vt=%d\n", __func__,
+                 i, batchVerifyCounts[i], batchVerifiers[i].badSources.size(), batchVerifiers[i].badMessages.size(), batchVerifyTimes[i]);
+    }
 
+    LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- verified sig shares. count=%d, pending=%d, maxBatchSize=%d, batches=%d, pt=%d, vt=%d, sharesPerSec=%d, nodes=%d\n", __func__,
+             verifyCount, nPendingCount, nMaxBatchSize, futures.size(), prepareTimer.count(), verifyTimer.count(),
+             verifyCount * 1000 / std::max(verifyTimer.count(), (int64_t)1), sigSharesByNodes.size());
+
+    nodeIdx = 0;
     for (auto& p : sigSharesByNodes) {
         auto nodeId = p.first;
         auto& v = p.second;
+        const auto& batchVerifier = batchVerifiers[(nodeIdx++) % nBatchCount];
 
         if (batchVerifier.badSources.count(nodeId)) {
             LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- invalid sig shares from other node, banning peer=%d\n",
                      __func__, nodeId);
             // this will also cause re-requesting of the shares that were sent by this node
             BanNode(nodeId);
+
+            // The failed batch was split up until the invalid shares were found, so the remaining shares of this node
+            // are known to be valid and there is no need to wait for them to arrive from other nodes
+            std::vector<CSigShare> validSigShares;
+            for (auto& sigShare : v) {
+                if (!batchVerifier.badMessages.count(std::make_pair(nodeId, sigShare.GetKey()))) {
+                    validSigShares.emplace_back(sigShare);
+                }
+            }
+            ProcessPendingSigShares(validSigShares, quorums, connman);
             continue;
         }
 
         ProcessPendingSigShares(v, quorums, connman);
     }
 
-    return sigSharesByNodes.size() >= nMaxBatchSize;
+    return nPendingCount > verifyCount;
 }
 
 // It's ensured that no duplicates are passed to this method
@@ -754,7 +894,16 @@ void CSigSharesManager::ProcessSigShare(const CSigShare& sigShare, CConnman& con
         }
 
         // Update the time we've seen the last sigShare
-        timeSeenForSessions[sigShare.GetSignHash()] = GetAdjustedTime();
+        const int64_t nNow = GetAdjustedTime();
+        timeSeenForSessions[sigShare.GetSignHash()] = nNow;
+        sessionTimeouts.schedule(sigShare.GetSignHash(), nNow + SESSION_NEW_SHARES_TIMEOUT);
+
+        const int64_t nNowMillis = GetTimeMillis();
+        const int64_t nFirstSeenMillis = timeFirstSeenForSessions.emplace(sigShare.GetSignHash(), nNowMillis).first->second;
+        const uint256& memberProTxHash = quorum->members[sigShare.quorumMember]->proTxHash;
+        if (memberProTxHash != activeMasternodeInfo.proTxHash) {
+            memberLatencies[memberProTxHash].Add(nNowMillis - nFirstSeenMillis);
+        }
 
         if (!quorumNodes.empty()) {
             // don't announce and wait for other nodes to request this share and directly send it to them
@@ -775,8 +924,34 @@ void CSigSharesManager::ProcessSigShare(const CSigShare& sigShare, CConnman& con
     }
 
     if (canTryRecovery) {
-        TryRecoverSig(quorum, sigShare.id, sigShare.msgHash);
+        AsyncTryRecoverSig(quorum, sigShare.id, sigShare.msgHash);
+    }
+}
+
+CSigSharesManager::WorkerShard& CSigSharesManager::GetWorkerShard(Consensus::LLMQType llmqType)
+{
+    return *workerShards[(size_t)llmqType % workerShards.size()];
+}
+
+void CSigSharesManager::AsyncTryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
+{
+    auto& shard = GetWorkerShard(quorum->params.type);
+    auto signHash = CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash);
+    {
+        LOCK(shard.cs);
+        if (!shard.pendingRecoveries.emplace(signHash).second) {
+            // a recovery attempt for this session is already queued
+            return;
+        }
     }
+
+    shard.workerPool.push([this, &shard, quorum, id, msgHash, signHash](int threadId) {
+        {
+            LOCK(shard.cs);
+            shard.pendingRecoveries.erase(signHash);
+        }
+        TryRecoverSig(quorum, id, msgHash);
+    });
 }
 
 void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
@@ -1289,18 +1464,18 @@ bool CSigSharesManager::GetSessionInfoByRecvId(NodeId nodeId, uint32_t sessionId
     return nodeStates[nodeId].GetSessionInfoByRecvId(sessionId, retInfo);
 }
 
-CSigShare CSigSharesManager::RebuildSigShare(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigShares& batchedSigShares, size_t idx)
+CSigShare CSigSharesManager::RebuildSigShare(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigSharesView& batchedSigShares, size_t idx)
 {
-    assert(idx < batchedSigShares.sigShares.size());
-    auto& s = batchedSigShares.sigShares[idx];
+    assert(idx < batchedSigShares.size());
     CSigShare sigShare;
     sigShare.llmqType = session.llmqType;
     sigShare.quorumHash = session.quorumHash;
-    sigShare.quorumMember = s.first;
+    sigShare.quorumMember = batchedSigShares.GetQuorumMember(idx);
     sigShare.id = session.id;
     sigShare.msgHash = session.msgHash;
-    sigShare.sigShare = s.second;
-    sigShare.UpdateKey();
+    batchedSigShares.GetSigShare(idx, sigShare.sigShare);
+    // the sign hash is already known from the session, no need to re-hash it (see UpdateKey)
+    sigShare.key = SigShareKey(session.signHash, sigShare.quorumMember);
     return sigShare;
 }
 
@@ -1366,16 +1541,7 @@ void CSigSharesManager::Cleanup()
         }
 
         // Remove sessions which timed out
-        std::unordered_set<uint256, StaticSaltedHasher> timeoutSessions;
-        for (auto& p : timeSeenForSessions) {
-            auto& signHash = p.first;
-            int64_t lastSeenTime = p.second;
-
-            if (now - lastSeenTime >= SESSION_NEW_SHARES_TIMEOUT) {
-                timeoutSessions.emplace(signHash);
-            }
-        }
-        for (auto& signHash : timeoutSessions) {
+        for (auto& signHash : sessionTimeouts.pop_expired(now)) {
             size_t count = sigShares.CountForSignHash(signHash);
 
             if (count > 0) {
@@ -1408,6 +1574,26 @@ void CSigSharesManager::Cleanup()
         }
     }
 
+    // Drop the latency stats of members which are not part of any active quorum anymore
+    std::unordered_set<uint256, StaticSaltedHasher> activeMembers;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        for (const auto& quorum : quorumManager->ScanQuorums(p.first, (size_t)p.second.signingActiveQuorumCount + 1)) {
+            for (const auto& dmn : quorum->members) {
+                activeMembers.emplace(dmn->proTxHash);
+            }
+        }
+    }
+    {
+        LOCK(cs);
+        for (auto it = memberLatencies.begin(); it != memberLatencies.end(); ) {
+            if (!activeMembers.count(it->first)) {
+                it = memberLatencies.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
     // Find node states for peers that disappeared from CConnman
     std::unordered_set<NodeId> nodeStatesToDelete;
     {
@@ -1437,6 +1623,145 @@ void CSigSharesManager::Cleanup()
     lastCleanupTime = GetAdjustedTime();
 }
 
+CSigningMemoryUsage CSigSharesManager::GetMemoryUsage()
+{
+    CSigningMemoryUsage usage;
+    {
+        LOCK(cs);
+        usage.sigShares = sigShares.DynamicMemoryUsage();
+        usage.nodeStates = memusage::DynamicUsage(nodeStates);
+        for (const auto& p : nodeStates) {
+            usage.nodeStates += p.second.DynamicMemoryUsage();
+        }
+        usage.sessions = memusage::DynamicUsage(signedSessions) + memusage::DynamicUsage(timeSeenForSessions) + sessionTimeouts.DynamicUsage() + memusage::DynamicUsage(timeFirstSeenForSessions);
+        for (const auto& p : signedSessions) {
+            usage.sessions += SigShareEntryDynamicUsage(p.second.sigShare);
+        }
+        usage.requests = sigSharesRequested.DynamicMemoryUsage() + sigSharesQueuedToAnnounce.DynamicMemoryUsage();
+    }
+    if (quorumSigningManager) {
+        usage.pendingRecoveredSigs = quorumSigningManager->GetPendingRecoveredSigsMemoryUsage();
+    }
+    return usage;
+}
+
+// Frees memory when the signing state grows above -llmq-signing-max-mem, e.g. when peers flood us with sessions or
+// when recovery stalls. Evicted first are sessions of quorums which are not active (anymore), then recovered sigs which
+// are not verified yet, then the least recently active sessions of active quorums. Sessions which we signed ourselves
+// are never evicted
+void CSigSharesManager::EnforceMemoryBudget()
+{
+    if (maxMemoryUsage == 0) {
+        return;
+    }
+    int64_t now = GetTimeMillis();
+    if (now - lastMemoryBudgetCheckTime < MEMORY_BUDGET_CHECK_INTERVAL) {
+        return;
+    }
+    lastMemoryBudgetCheckTime = now;
+
+    size_t totalUsage = GetMemoryUsage().Total();
+    if (totalUsage <= maxMemoryUsage) {
+        return;
+    }
+    size_t bytesToFree = totalUsage - maxMemoryUsage;
+
+    struct SessionEvictionInfo {
+        size_t usage{0};
+        int64_t lastSeenTime{0};
+        bool fHasQuorum{false};
+        std::pair<Consensus::LLMQType, uint256> quorumKey;
+    };
+    std::unordered_map<uint256, SessionEvictionInfo, StaticSaltedHasher> sessions;
+    std::unordered_map<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher> quorumsActive;
+    {
+        LOCK(cs);
+        auto addUsage = [&](const uint256& signHash, size_t usage) {
+            sessions[signHash].usage += usage;
+        };
+        sigShares.ForEachSessionUsage(addUsage);
+        sigSharesRequested.ForEachSessionUsage(addUsage);
+        sigSharesQueuedToAnnounce.ForEachSessionUsage(addUsage);
+        for (auto& p : nodeStates) {
+            auto& ns = p.second;
+            for (const auto& p2 : ns.sessions) {
+                auto& info = sessions[p2.first];
+                info.usage += p2.second.DynamicMemoryUsage();
+                if (!info.fHasQuorum) {
+                    info.fHasQuorum = true;
+                    info.quorumKey = std::make_pair(p2.second.llmqType, p2.second.quorumHash);
+                }
+            }
+            ns.pendingIncomingSigShares.ForEachSessionUsage(addUsage);
+            ns.requestedSigShares.ForEachSessionUsage(addUsage);
+        }
+        for (const auto& p : signedSessions) {
+            sessions.erase(p.first);
+        }
+        for (auto& p : sessions) {
+            auto& info = p.second;
+            if (!info.fHasQuorum) {
+                auto slots = sigShares.GetAllForSignHash(p.first);
+                if (slots && !slots->empty()) {
+                    auto& sigShare = slots->begin()->second;
+                    info.fHasQuorum = true;
+                    info.quorumKey = std::make_pair(sigShare.llmqType, sigShare.quorumHash);
+                }
+            }
+            auto it = timeSeenForSessions.find(p.first);
+            if (it != timeSeenForSessions.end()) {
+                info.lastSeenTime = it->second;
+            }
+            if (info.fHasQuorum) {
+                quorumsActive.emplace(info.quorumKey, false);
+            }
+        }
+    }
+
+    // IsQuorumActive requires cs_main, which must not be locked while cs is held
+    for (auto& p : quorumsActive) {
+        p.second = CLLMQUtils::IsQuorumActive(p.first.first, p.first.second);
+    }
+
+    std::vector<std::pair<int64_t, uint256>> inactiveSessions;
+    std::vector<std::pair<int64_t, uint256>> activeSessions;
+    for (const auto& p : sessions) {
+        const auto& info = p.second;
+        if (info.fHasQuorum && quorumsActive.at(info.quorumKey)) {
+            activeSessions.emplace_back(info.lastSeenTime, p.first);
+        } else {
+            inactiveSessions.emplace_back(info.lastSeenTime, p.first);
+        }
+    }
+    std::sort(inactiveSessions.begin(), inactiveSessions.end());
+    std::sort(activeSessions.begin(), activeSessions.end());
+
+    size_t bytesFreed = 0;
+    size_t evictedSessions = 0;
+    auto evictSessions = [&](const std::vector<std::pair<int64_t, uint256>>& v) {
+        LOCK(cs);
+        for (const auto& p : v) {
+            if (bytesFreed >= bytesToFree) {
+                break;
+            }
+            bytesFreed += sessions.at(p.second).usage;
+            RemoveSigSharesForSession(p.second);
+            evictedSessions++;
+        }
+    };
+
+    evictSessions(inactiveSessions);
+    size_t evictedRecoveredSigs = 0;
+    if (bytesFreed < bytesToFree && quorumSigningManager) {
+        bytesFreed += quorumSigningManager->EvictPendingRecoveredSigs(bytesToFree - bytesFreed, evictedRecoveredSigs);
+    }
+    evictSessions(activeSessions);
+    evictedSessionsCounter += evictedSessions;
+
+    LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- memory usage of %d bytes above budget of %d bytes, evicted %d sessions and %d recovered sigs, freed ~%d bytes\n", __func__,
+             totalUsage, maxMemoryUsage, evictedSessions, evictedRecoveredSigs, bytesFreed);
+}
+
 void CSigSharesManager::RemoveSigSharesForSession(const uint256& signHash)
 {
     AssertLockHeld(cs);
@@ -1451,6 +1776,8 @@ void CSigSharesManager::RemoveSigSharesForSession(const uint256& signHash)
     sigShares.EraseAllForSignHash(signHash);
     signedSessions.erase(signHash);
     timeSeenForSessions.erase(signHash);
+    sessionTimeouts.erase(signHash);
+    timeFirstSeenForSessions.erase(signHash);
 }
 
 void CSigSharesManager::RemoveBannedNodeStates()
@@ -1516,7 +1843,6 @@ void CSigSharesManager::WorkThreadMain()
         RemoveBannedNodeStates();
         fMoreWork |= quorumSigningManager->ProcessPendingRecoveredSigs();
         fMoreWork |= ProcessPendingSigShares(*g_connman);
-        SignPendingSigShares();
 
         if (GetTimeMillis() - lastSendTime > 100) {
             SendMessages();
@@ -1525,6 +1851,7 @@ void CSigSharesManager::WorkThreadMain()
 
         Cleanup();
         quorumSigningManager->Cleanup();
+        EnforceMemoryBudget();
 
         // TODO Wakeup when pending signing is needed?
         if (!fMoreWork && !workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
@@ -1535,38 +1862,91 @@ void CSigSharesManager::WorkThreadMain()
 
 void CSigSharesManager::AsyncSign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
 {
-    LOCK(cs);
-    pendingSigns.emplace_back(quorum, id, msgHash);
+    AsyncSign(quorum, {{id, msgHash}});
 }
 
-void CSigSharesManager::SignPendingSigShares()
+void CSigSharesManager::AsyncSign(const CQuorumCPtr& quorum, std::vector<std::pair<uint256, uint256>> idsAndMsgHashes)
 {
-    std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> v;
-    {
-        LOCK(cs);
-        v = std::move(pendingSigns);
+    if (idsAndMsgHashes.empty()) {
+        return;
     }
+    auto pIdsAndMsgHashes = std::make_shared<std::vector<std::pair<uint256, uint256>>>(std::move(idsAndMsgHashes));
+    GetWorkerShard(quorum->params.type).workerPool.push([this, quorum, pIdsAndMsgHashes](int threadId) {
+        SignAndProcessSigShares(quorum, *pIdsAndMsgHashes);
+    });
+}
 
-    for (auto& t : v) {
-        const CQuorumCPtr pQuorum = std::get<0>(t);
-        CSigShare sigShare = CreateSigShare(pQuorum, std::get<1>(t), std::get<2>(t));
+void CSigSharesManager::SignAndProcessSigShares(const CQuorumCPtr& quorum, const std::vector<std::pair<uint256, uint256>>& idsAndMsgHashes)
+{
+    if (!g_connman) {
+        return;
+    }
 
+    // The BLS library has no batched signing for different messages, so the shares are still created one by one, but
+    // without a worker job, fast transport message and lock round per share
+    std::vector<CSigShare> sigShares;
+    sigShares.reserve(idsAndMsgHashes.size());
+    for (const auto& p : idsAndMsgHashes) {
+        CSigShare sigShare = CreateSigShare(quorum, p.first, p.second);
         if (sigShare.sigShare.Get().IsValid()) {
+            sigShares.emplace_back(std::move(sigShare));
+        }
+    }
+    if (sigShares.empty()) {
+        return;
+    }
 
-            ProcessSigShare(sigShare, *g_connman, pQuorum);
+    for (const auto& sigShare : sigShares) {
+        ProcessSigShare(sigShare, *g_connman, quorum);
+    }
 
-            if (CLLMQUtils::IsAllMembersConnectedEnabled(pQuorum->params.type)) {
-                LOCK(cs);
-                auto& session = signedSessions[sigShare.GetSignHash()];
-                session.sigShare = sigShare;
-                session.quorum = pQuorum;
-                session.nextAttemptTime = 0;
-                session.attempt = 0;
-            }
+    if (g_connman->IsMasternodeFastTransportEnabled()) {
+        PushSigSharesFastTransport(sigShares, *g_connman);
+    }
+
+    if (CLLMQUtils::IsAllMembersConnectedEnabled(quorum->params.type)) {
+        LOCK(cs);
+        for (const auto& sigShare : sigShares) {
+            auto& session = signedSessions[sigShare.GetSignHash()];
+            session.sigShare = sigShare;
+            session.quorum = quorum;
+            session.nextAttemptTime = 0;
+            session.attempt = 0;
         }
     }
 }
 
+// Pushes our own sig shares right away to all intra-quorum connections which are handled by the fast transport thread,
+// instead of waiting for the next SendMessages() round and the announce/request round trips. The regular mechanism
+// stays in place, so peers which don't accept single sig shares still receive them and others just skip the duplicates.
+// All sig shares must belong to the same quorum and are sent in as few messages as possible.
+void CSigSharesManager::PushSigSharesFastTransport(const std::vector<CSigShare>& sigShares, CConnman& connman)
+{
+    const auto& first = sigShares.front();
+    auto quorumNodes = connman.GetMasternodeQuorumNodes((Consensus::LLMQType)first.llmqType, first.quorumHash);
+    for (auto nodeId : quorumNodes) {
+        connman.ForNode(nodeId, [&](CNode* pnode) {
+            if (!pnode->fFastTransport) {
+                return true;
+            }
+            CNetMsgMaker msgMaker(pnode->GetSendVersion());
+            for (size_t i = 0; i < sigShares.size(); i += MAX_MSGS_SIG_SHARES) {
+                std::vector<CSigShare> msgs(sigShares.begin() + i, sigShares.begin() + std::min(sigShares.size(), i + MAX_MSGS_SIG_SHARES));
+                LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- QSIGSHARE count=%d, signHash=%s, node=%d\n", __func__,
+                         msgs.size(), msgs.front().GetSignHash().ToString(), nodeId);
+                connman.PushMessage(pnode, msgMaker.Make(NetMsgType::QSIGSHARE, msgs));
+            }
+            return true;
+        });
+    }
+}
+
+std::map<uint256, CLatencyHistogram> CSigSharesManager::GetMemberLatencies()
+{
+    LOCK(cs);
+    return std::map<uint256, CLatencyHistogram>(memberLatencies.begin(), memberLatencies.end());
+}
+
 CSigShare CSigSharesManager::CreateSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
 {
     cxxtimer::Timer t(true);
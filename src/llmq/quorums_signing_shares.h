@@ -7,16 +7,25 @@
 
 #include <bls/bls.h>
 #include <chainparams.h>
+#include <expiryqueue.h>
+#include <memusage.h>
 #include <net.h>
 #include <random.h>
 #include <saltedhasher.h>
 #include <serialize.h>
+#include <streams.h>
 #include <sync.h>
 #include <tinyformat.h>
 #include <uint256.h>
 
 #include <llmq/quorums.h>
+#include <llmq/quorums_latency.h>
+#include <llmq/quorums_signing.h>
 
+#include <ctpl.h>
+
+#include <array>
+#include <map>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
@@ -27,6 +36,12 @@ class CScheduler;
 
 namespace llmq
 {
+// Signing and recovery of sessions is sharded by LLMQ type over this many threads
+static const int DEFAULT_SIGSHARES_THREADS = 2;
+static const int MAX_SIGSHARES_THREADS = 8;
+// Memory budget in MiB for sig shares, signing sessions and not yet verified recovered sigs
+static const int64_t DEFAULT_SIGNING_MAX_MEMORY = 64;
+
 // <signHash, quorumMember>
 typedef std::pair<uint256, uint16_t> SigShareKey;
 
@@ -44,6 +59,8 @@ public:
 
 public:
     void UpdateKey();
+    // Same as UpdateKey() for all of sigShares, with the sign hashes computed together
+    static void UpdateKeys(std::vector<CSigShare>& sigShares);
     const SigShareKey& GetKey() const
     {
         return key;
@@ -64,10 +81,7 @@ public:
         READWRITE(id);
         READWRITE(msgHash);
         READWRITE(sigShare);
-
-        if (ser_action.ForRead()) {
-            UpdateKey();
-        }
+        // the key is not computed while reading, call UpdateKey() or UpdateKeys() after deserialization
     }
 };
 
@@ -77,6 +91,9 @@ public:
 class CSigSesAnn
 {
 public:
+    // smallest serialized size, with a single byte VARINT sessionId
+    static const size_t MIN_SERIALIZED_SIZE = 1 + sizeof(uint8_t) + 3 * sizeof(uint256);
+
     uint32_t sessionId{(uint32_t)-1};
     Consensus::LLMQType llmqType;
     uint256 quorumHash;
@@ -100,6 +117,9 @@ public:
 class CSigSharesInv
 {
 public:
+    // smallest serialized size: sessionId, invSize and the bitset mode byte of an empty inv
+    static const size_t MIN_SERIALIZED_SIZE = 3;
+
     uint32_t sessionId{(uint32_t)-1};
     std::vector<bool> inv;
 
@@ -124,6 +144,12 @@ public:
 
     size_t CountSet() const;
     std::string ToString() const;
+
+    size_t DynamicMemoryUsage() const
+    {
+        // std::vector<bool> packs the bits
+        return inv.capacity() ? memusage::MallocUsage((inv.capacity() + 7) / 8) : 0;
+    }
 };
 
 // sent through the message QBSIGSHARES as a vector of multiple batches
@@ -146,17 +172,181 @@ public:
     std::string ToInvString() const;
 };
 
+// Read-only view of a serialized CBatchedSigShares. Instead of deserializing all entries, it points into the buffer of
+// the SpanReader it was read from and must thus not outlive that buffer. Signatures are only copied out of the buffer when
+// GetSigShare() is called
+class CBatchedSigSharesView
+{
+public:
+    // serialized size of a (quorumMember, sigShare) entry
+    static const size_t ENTRY_SIZE = sizeof(uint16_t) + CBLSSignature::SerSize;
+
+    uint32_t sessionId{(uint32_t)-1};
+
+private:
+    const uint8_t* entries{nullptr};
+    size_t count{0};
+
+public:
+    void Unserialize(SpanReader& s)
+    {
+        s >> VARINT(sessionId);
+        count = ReadCompactSize(s);
+        if (count > s.size() / ENTRY_SIZE) {
+            throw std::ios_base::failure("CBatchedSigSharesView: end of data");
+        }
+        entries = s.data();
+        s.ignore(count * ENTRY_SIZE);
+    }
+
+    size_t size() const { return count; }
+
+    uint16_t GetQuorumMember(size_t idx) const
+    {
+        assert(idx < count);
+        return ReadLE16(entries + idx * ENTRY_SIZE);
+    }
+
+    void GetSigShare(size_t idx, CBLSLazySignature& sigShareRet) const
+    {
+        assert(idx < count);
+        sigShareRet.SetBuf(entries + idx * ENTRY_SIZE + sizeof(uint16_t));
+    }
+
+    std::string ToInvString() const;
+};
+
+// Heap memory owned by an entry of a SigShareSlots, apart from the entry itself
+static inline size_t SigShareEntryDynamicUsage(const CSigShare& sigShare)
+{
+    // the buffer of the lazy signature
+    return memusage::MallocUsage(CBLSSignature::SerSize);
+}
+template<typename T>
+static inline size_t SigShareEntryDynamicUsage(const T& v)
+{
+    return 0;
+}
+
+// Flat storage for all entries of a single signing session. Entries are stored densely in one contiguous array and
+// an index array, which is indexed by quorum member, points into it. Lookups are O(1) and iteration does not chase
+// pointers. Erasing moves the last entry into the erased one's place, so entry order is not stable
+template<typename T>
+class SigShareSlots
+{
+public:
+    typedef std::pair<uint16_t, T> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+private:
+    // 0 means that the quorum member has no entry, otherwise it is the position in entries + 1
+    std::vector<uint16_t> index;
+    std::vector<value_type> entries;
+
+public:
+    bool Add(uint16_t quorumMember, const T& v)
+    {
+        if (quorumMember >= index.size()) {
+            index.resize((size_t)quorumMember + 1, 0);
+        }
+        if (index[quorumMember] != 0) {
+            return false;
+        }
+        entries.emplace_back(quorumMember, v);
+        index[quorumMember] = (uint16_t)entries.size();
+        return true;
+    }
+
+    void Erase(uint16_t quorumMember)
+    {
+        if (quorumMember >= index.size() || index[quorumMember] == 0) {
+            return;
+        }
+        EraseAt((size_t)index[quorumMember] - 1);
+    }
+
+    // Leaves allocated memory in place, so that the slots can be reused for another session
+    void Clear()
+    {
+        index.clear();
+        entries.clear();
+    }
+
+    T* Get(uint16_t quorumMember)
+    {
+        if (quorumMember >= index.size() || index[quorumMember] == 0) {
+            return nullptr;
+        }
+        return &entries[index[quorumMember] - 1].second;
+    }
+
+    size_t count(uint16_t quorumMember) const
+    {
+        return (quorumMember < index.size() && index[quorumMember] != 0) ? 1 : 0;
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t usage = memusage::DynamicUsage(index) + memusage::DynamicUsage(entries);
+        for (const auto& p : entries) {
+            usage += SigShareEntryDynamicUsage(p.second);
+        }
+        return usage;
+    }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    template<typename F>
+    void EraseIf(F&& f)
+    {
+        for (size_t i = 0; i < entries.size(); ) {
+            if (f(entries[i].first, entries[i].second)) {
+                // the last entry is moved to i, so don't advance
+                EraseAt(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    void EraseAt(size_t pos)
+    {
+        uint16_t quorumMember = entries[pos].first;
+        if (pos != entries.size() - 1) {
+            entries[pos] = entries.back();
+            index[entries[pos].first] = (uint16_t)(pos + 1);
+        }
+        entries.pop_back();
+        index[quorumMember] = 0;
+    }
+};
+
 template<typename T>
 class SigShareMap
 {
 private:
-    std::unordered_map<uint256, std::unordered_map<uint16_t, T>, StaticSaltedHasher> internalMap;
+    // Number of cleared SigShareSlots which are kept for reuse by new sessions
+    static const size_t MAX_POOLED_SLOTS = 4;
+
+    std::unordered_map<uint256, SigShareSlots<T>, StaticSaltedHasher> internalMap;
+    std::vector<SigShareSlots<T>> slotsPool;
 
 public:
     bool Add(const SigShareKey& k, const T& v)
     {
-        auto& m = internalMap[k.first];
-        return m.emplace(k.second, v).second;
+        auto it = internalMap.find(k.first);
+        if (it == internalMap.end()) {
+            it = internalMap.emplace(k.first, AllocSlots()).first;
+        }
+        return it->second.Add(k.second, v);
     }
 
     void Erase(const SigShareKey& k)
@@ -165,9 +355,9 @@ public:
         if (it == internalMap.end()) {
             return;
         }
-        it->second.erase(k.second);
+        it->second.Erase(k.second);
         if (it->second.empty()) {
-            internalMap.erase(it);
+            EraseSession(it);
         }
     }
 
@@ -191,13 +381,7 @@ public:
         if (it == internalMap.end()) {
             return nullptr;
         }
-
-        auto jt = it->second.find(k.second);
-        if (jt == it->second.end()) {
-            return nullptr;
-        }
-
-        return &jt->second;
+        return it->second.Get(k.second);
     }
 
     T& GetOrAdd(const SigShareKey& k)
@@ -241,7 +425,7 @@ public:
         return internalMap.empty();
     }
 
-    const std::unordered_map<uint16_t, T>* GetAllForSignHash(const uint256& signHash)
+    const SigShareSlots<T>* GetAllForSignHash(const uint256& signHash)
     {
         auto it = internalMap.find(signHash);
         if (it == internalMap.end()) {
@@ -252,7 +436,10 @@ public:
 
     void EraseAllForSignHash(const uint256& signHash)
     {
-        internalMap.erase(signHash);
+        auto it = internalMap.find(signHash);
+        if (it != internalMap.end()) {
+            EraseSession(it);
+        }
     }
 
     template<typename F>
@@ -261,16 +448,12 @@ public:
         for (auto it = internalMap.begin(); it != internalMap.end(); ) {
             SigShareKey k;
             k.first = it->first;
-            for (auto jt = it->second.begin(); jt != it->second.end(); ) {
-                k.second = jt->first;
-                if (f(k, jt->second)) {
-                    jt = it->second.erase(jt);
-                } else {
-                    ++jt;
-                }
-            }
+            it->second.EraseIf([&](uint16_t quorumMember, T& v) {
+                k.second = quorumMember;
+                return f(k, v);
+            });
             if (it->second.empty()) {
-                it = internalMap.erase(it);
+                it = EraseSession(it);
             } else {
                 ++it;
             }
@@ -289,6 +472,47 @@ public:
             }
         }
     }
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t usage = memusage::DynamicUsage(internalMap) + memusage::DynamicUsage(slotsPool);
+        for (const auto& p : internalMap) {
+            usage += p.second.DynamicMemoryUsage();
+        }
+        for (const auto& slots : slotsPool) {
+            usage += slots.DynamicMemoryUsage();
+        }
+        return usage;
+    }
+
+    // Calls f(signHash, usage) with the memory used by each session
+    template<typename F>
+    void ForEachSessionUsage(F&& f) const
+    {
+        for (const auto& p : internalMap) {
+            f(p.first, p.second.DynamicMemoryUsage());
+        }
+    }
+
+private:
+    SigShareSlots<T> AllocSlots()
+    {
+        if (slotsPool.empty()) {
+            return SigShareSlots<T>();
+        }
+        SigShareSlots<T> slots = std::move(slotsPool.back());
+        slotsPool.pop_back();
+        return slots;
+    }
+
+    typename decltype(internalMap)::iterator EraseSession(typename decltype(internalMap)::iterator it)
+    {
+        if (slotsPool.size() < MAX_POOLED_SLOTS) {
+            it->second.Clear();
+            slotsPool.emplace_back(std::move(it->second));
+        }
+        return internalMap.erase(it);
+    }
 };
 
 class CSigSharesNodeState
@@ -321,6 +545,11 @@ public:
         CSigSharesInv announced;
         CSigSharesInv requested;
         CSigSharesInv knows;
+
+        size_t DynamicMemoryUsage() const
+        {
+            return announced.DynamicMemoryUsage() + requested.DynamicMemoryUsage() + knows.DynamicMemoryUsage();
+        }
     };
     // TODO limit number of sessions per node
     std::unordered_map<uint256, Session, StaticSaltedHasher> sessions;
@@ -334,12 +563,14 @@ public:
     bool banned{false};
 
     Session& GetOrCreateSessionFromShare(const CSigShare& sigShare);
-    Session& GetOrCreateSessionFromAnn(const CSigSesAnn& ann);
+    Session& GetOrCreateSessionFromAnn(const CSigSesAnn& ann, const uint256& signHash);
     Session* GetSessionBySignHash(const uint256& signHash);
     Session* GetSessionByRecvId(uint32_t sessionId);
     bool GetSessionInfoByRecvId(uint32_t sessionId, SessionInfo& retInfo);
 
     void RemoveSession(const uint256& signHash);
+
+    size_t DynamicMemoryUsage() const;
 };
 
 class CSignedSession
@@ -352,6 +583,26 @@ public:
     int attempt{0};
 };
 
+// Memory used by the LLMQ signing state, in bytes
+struct CSigningMemoryUsage
+{
+    // verified sig shares of all sessions
+    size_t sigShares{0};
+    // per peer sessions, invs and pending and requested sig shares
+    size_t nodeStates{0};
+    // own signed sessions and session times
+    size_t sessions{0};
+    // requested and to be announced sig shares
+    size_t requests{0};
+    // recovered sigs waiting for verification
+    size_t pendingRecoveredSigs{0};
+
+    size_t Total() const
+    {
+        return sigShares + nodeStates + sessions + requests + pendingRecoveredSigs;
+    }
+};
+
 class CSigSharesManager : public CRecoveredSigsListener
 {
     static const int64_t SESSION_NEW_SHARES_TIMEOUT = 60;
@@ -368,32 +619,62 @@ class CSigSharesManager : public CRecoveredSigsListener
     const int64_t MAX_SEND_FOR_RECOVERY_TIMEOUT = 10000;
     const size_t MAX_MSGS_SIG_SHARES = 32;
 
+    // The number of unique sessions verified at once is derived from the number of pending sig shares. The batch is
+    // then split into sub-batches which are verified in parallel on the BLS worker threads
+    const size_t MIN_PENDING_SIG_SHARES_BATCH_SIZE = 32;
+    const size_t MAX_PENDING_SIG_SHARES_BATCH_SIZE_PER_WORKER = 64;
+
+    // Milliseconds between checks of the memory budget
+    const int64_t MEMORY_BUDGET_CHECK_INTERVAL = 1000;
+
 private:
     CCriticalSection cs;
 
+    CBLSWorker& blsWorker;
+
     std::thread workThread;
     CThreadInterrupt workInterrupt;
 
+    // Signing of our own sig shares and recovery of signatures are the most expensive operations per session. These
+    // are sharded by LLMQ type over multiple single threaded workers, each with its own queue and lock, so that large
+    // ChainLock quorums and small InstantSend quorums don't block each other
+    struct WorkerShard {
+        ctpl::thread_pool workerPool;
+        CCriticalSection cs;
+        // signHashes for which a recovery attempt is already queued
+        std::unordered_set<uint256, StaticSaltedHasher> pendingRecoveries;
+    };
+    std::vector<std::unique_ptr<WorkerShard>> workerShards;
+
     SigShareMap<CSigShare> sigShares;
     std::unordered_map<uint256, CSignedSession, StaticSaltedHasher> signedSessions;
 
     // stores time of last receivedSigShare. Used to detect timeouts
     std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeSeenForSessions;
+    // time of last received sig share + SESSION_NEW_SHARES_TIMEOUT, so that timeouts are found without looking at all sessions
+    expiry_queue<uint256> sessionTimeouts;
+    // stores the time (in milliseconds) the first sig share of a session was seen. Used for the latency stats
+    std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeFirstSeenForSessions;
+    // sig share latencies by quorum member (proTxHash)
+    std::unordered_map<uint256, CLatencyHistogram, StaticSaltedHasher> memberLatencies;
 
     std::unordered_map<NodeId, CSigSharesNodeState> nodeStates;
     SigShareMap<std::pair<NodeId, int64_t>> sigSharesRequested;
     SigShareMap<bool> sigSharesQueuedToAnnounce;
 
-    std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> pendingSigns;
-
     // must be protected by cs
     FastRandomContext rnd;
 
     int64_t lastCleanupTime{0};
     std::atomic<uint32_t> recoveredSigsCounter{0};
 
+    // 0 when unlimited
+    size_t maxMemoryUsage{0};
+    int64_t lastMemoryBudgetCheckTime{0};
+    std::atomic<uint64_t> evictedSessionsCounter{0};
+
 public:
-    CSigSharesManager();
+    explicit CSigSharesManager(CBLSWorker& _blsWorker);
     ~CSigSharesManager();
 
     void StartWorkerThread();
@@ -403,9 +684,11 @@ public:
     void InterruptWorkerThread();
 
 public:
-    void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pnode, const std::string& strCommand, CPublicDataStream& vRecv);
 
     void AsyncSign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
+    // Signs all (id, msgHash) pairs with our share of quorum in a single job
+    void AsyncSign(const CQuorumCPtr& quorum, std::vector<std::pair<uint256, uint256>> idsAndMsgHashes);
     CSigShare CreateSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
     void ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
 
@@ -413,17 +696,24 @@ public:
 
     static CDeterministicMNCPtr SelectMemberForRecovery(const CQuorumCPtr& quorum, const uint256& id, int attempt);
 
+    std::map<uint256, CLatencyHistogram> GetMemberLatencies();
+
+    CSigningMemoryUsage GetMemoryUsage();
+    size_t GetMaxMemoryUsage() const { return maxMemoryUsage; }
+    uint64_t GetEvictedSessionsCount() const { return evictedSessionsCounter; }
+
 private:
     // all of these return false when the currently processed message should be aborted (as each message actually contains multiple messages)
-    bool ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann);
+    bool ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann, const uint256& signHash);
     bool ProcessMessageSigSharesInv(CNode* pfrom, const CSigSharesInv& inv);
     bool ProcessMessageGetSigShares(CNode* pfrom, const CSigSharesInv& inv);
-    bool ProcessMessageBatchedSigShares(CNode* pfrom, const CBatchedSigShares& batchedSigShares);
+    bool ProcessMessageBatchedSigShares(CNode* pfrom, const CBatchedSigSharesView& batchedSigShares);
     void ProcessMessageSigShare(NodeId fromId, const CSigShare& sigShare);
 
     static bool VerifySigSharesInv(Consensus::LLMQType llmqType, const CSigSharesInv& inv);
-    static bool PreVerifyBatchedSigShares(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigShares& batchedSigShares, bool& retBan);
+    static bool PreVerifyBatchedSigShares(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigSharesView& batchedSigShares, bool& retBan);
 
+    size_t GetPendingSigSharesCount();
     void CollectPendingSigSharesToVerify(size_t maxUniqueSessions,
             std::unordered_map<NodeId, std::vector<CSigShare>>& retSigShares,
             std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher>& retQuorums);
@@ -434,13 +724,15 @@ private:
             CConnman& connman);
 
     void ProcessSigShare(const CSigShare& sigShare, CConnman& connman, const CQuorumCPtr& quorum);
+    void AsyncTryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
     void TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
 
 private:
     bool GetSessionInfoByRecvId(NodeId nodeId, uint32_t sessionId, CSigSharesNodeState::SessionInfo& retInfo);
-    static CSigShare RebuildSigShare(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigShares& batchedSigShares, size_t idx);
+    static CSigShare RebuildSigShare(const CSigSharesNodeState::SessionInfo& session, const CBatchedSigSharesView& batchedSigShares, size_t idx);
 
     void Cleanup();
+    void EnforceMemoryBudget();
     void RemoveSigSharesForSession(const uint256& signHash);
     void RemoveBannedNodeStates();
 
@@ -451,7 +743,9 @@ private:
     void CollectSigSharesToSend(std::unordered_map<NodeId, std::unordered_map<uint256, CBatchedSigShares, StaticSaltedHasher>>& sigSharesToSend);
     void CollectSigSharesToSendConcentrated(std::unordered_map<NodeId, std::vector<CSigShare>>& sigSharesToSend, const std::vector<CNode*>& vNodes);
     void CollectSigSharesToAnnounce(std::unordered_map<NodeId, std::unordered_map<uint256, CSigSharesInv, StaticSaltedHasher>>& sigSharesToAnnounce);
-    void SignPendingSigShares();
+    WorkerShard& GetWorkerShard(Consensus::LLMQType llmqType);
+    void SignAndProcessSigShares(const CQuorumCPtr& quorum, const std::vector<std::pair<uint256, uint256>>& idsAndMsgHashes);
+    void PushSigSharesFastTransport(const std::vector<CSigShare>& sigShares, CConnman& connman);
     void WorkThreadMain();
 };
 
@@ -6,8 +6,10 @@
 #include <llmq/quorums_utils.h>
 
 #include <chainparams.h>
+#include <crypto/sha256.h>
 #include <random.h>
 #include <spork.h>
+#include <statsd_client.h>
 #include <validation.h>
 
 #include <masternode/masternode-meta.h>
@@ -18,32 +20,86 @@ namespace llmq
 CCriticalSection cs_llmq_vbc;
 VersionBitsCache llmq_versionbitscache;
 
-std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
+namespace {
+// Members of a quorum and everything derived from the member list. Relay members and connections are calculated
+// lazily, only when first queried, as most callers only need the members and usually only our own and a few other
+// members are queried
+struct QuorumMembersInfo {
+    std::vector<CDeterministicMNCPtr> members;
+
+    CCriticalSection cs;
+    // for each member (by index), the members it relays to, see CLLMQUtils::GetQuorumRelayMembers. Empty until the
+    // relay members of any member are queried the first time, as the inbound relay members need all of these
+    std::vector<std::set<uint256>> relayOutbound;
+    // keys are (forMember, onlyOutbound)
+    std::map<std::pair<uint256, bool>, std::set<uint256>> connections;
+    std::map<std::pair<uint256, bool>, std::set<uint256>> relayMembers;
+};
+typedef std::shared_ptr<QuorumMembersInfo> QuorumMembersInfoPtr;
+} // namespace
+
+static CCriticalSection cs_members;
+static std::map<Consensus::LLMQType, unordered_lru_cache<uint256, QuorumMembersInfoPtr, StaticSaltedHasher>> mapQuorumMembers;
+
+static std::set<uint256> CalcRelayOutbound(const std::vector<CDeterministicMNCPtr>& mns, size_t i)
 {
-    static CCriticalSection cs_members;
-    static std::map<Consensus::LLMQType, unordered_lru_cache<uint256, std::vector<CDeterministicMNCPtr>, StaticSaltedHasher>> mapQuorumMembers;
-
-    if (!IsQuorumTypeEnabled(llmqType, pindexQuorum->pprev)) {
-        return {};
+    // Relay to nodes at indexes (i+2^k)%n, where
+    //   k: 0..max(1, floor(log2(n-1))-1)
+    //   n: size of the quorum/ring
+    const uint256& proTxHash = mns[i]->proTxHash;
+    std::set<uint256> r;
+    int gap = 1;
+    int gap_max = (int)mns.size() - 1;
+    int k = 0;
+    while ((gap_max >>= 1) || k <= 1) {
+        size_t idx = (i + gap) % mns.size();
+        auto& otherDmn = mns[idx];
+        // always advance, otherwise lists of 1 or 2 members, where the gap wraps around to ourself, never terminate
+        gap <<= 1;
+        k++;
+        if (otherDmn->proTxHash == proTxHash) {
+            continue;
+        }
+        r.emplace(otherDmn->proTxHash);
     }
-    std::vector<CDeterministicMNCPtr> quorumMembers;
+    return r;
+}
+
+// Returns the cached member info of the quorum, calculating it if needed. "statName" is used to report cache hits and
+// misses per caller to statsd
+static QuorumMembersInfoPtr GetQuorumMembersInfo(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const std::string& statName)
+{
+    QuorumMembersInfoPtr info;
     {
         LOCK(cs_members);
         if (mapQuorumMembers.empty()) {
-            InitQuorumsCache(mapQuorumMembers);
+            CLLMQUtils::InitQuorumsCache(mapQuorumMembers);
         }
-        if (mapQuorumMembers[llmqType].get(pindexQuorum->GetBlockHash(), quorumMembers)) {
-            return quorumMembers;
+        if (mapQuorumMembers[llmqType].get(pindexQuorum->GetBlockHash(), info)) {
+            statsClient.inc(strprintf("llmq.quorumMembersCache.%s.hit", statName), 1.0f);
+            return info;
         }
     }
+    statsClient.inc(strprintf("llmq.quorumMembersCache.%s.miss", statName), 1.0f);
+
+    info = std::make_shared<QuorumMembersInfo>();
 
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
     auto allMns = deterministicMNManager->GetListForBlock(pindexQuorum);
     auto modifier = ::SerializeHash(std::make_pair(llmqType, pindexQuorum->GetBlockHash()));
-    quorumMembers = allMns.CalculateQuorum(params.size, modifier);
+    info->members = allMns.CalculateQuorum(params.size, modifier);
+
     LOCK(cs_members);
-    mapQuorumMembers[llmqType].insert(pindexQuorum->GetBlockHash(), quorumMembers);
-    return quorumMembers;
+    mapQuorumMembers[llmqType].insert(pindexQuorum->GetBlockHash(), info);
+    return info;
+}
+
+std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
+{
+    if (!IsQuorumTypeEnabled(llmqType, pindexQuorum->pprev)) {
+        return {};
+    }
+    return GetQuorumMembersInfo(llmqType, pindexQuorum, "members")->members;
 }
 
 uint256 CLLMQUtils::BuildCommitmentHash(Consensus::LLMQType llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash)
@@ -67,6 +123,31 @@ uint256 CLLMQUtils::BuildSignHash(Consensus::LLMQType llmqType, const uint256& q
     return h.GetHash();
 }
 
+void CLLMQUtils::AppendSignHashInput(std::vector<unsigned char>& buf, Consensus::LLMQType llmqType, const uint256& quorumHash, const uint256& id, const uint256& msgHash)
+{
+    CVectorWriter w(SER_GETHASH, 0, buf, buf.size());
+    w << llmqType;
+    w << quorumHash;
+    w << id;
+    w << msgHash;
+    assert(buf.size() % SIGN_HASH_INPUT_SIZE == 0);
+}
+
+std::vector<uint256> CLLMQUtils::HashSignHashInputs(const std::vector<unsigned char>& buf)
+{
+    size_t count = buf.size() / SIGN_HASH_INPUT_SIZE;
+    std::vector<const unsigned char*> ptrs(count);
+    std::vector<size_t> lens(count, SIGN_HASH_INPUT_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        ptrs[i] = buf.data() + i * SIGN_HASH_INPUT_SIZE;
+    }
+    std::vector<uint256> ret(count);
+    if (count != 0) {
+        SHA256DMulti(ret[0].begin(), ptrs.data(), lens.data(), count);
+    }
+    return ret;
+}
+
 static bool EvalSpork(Consensus::LLMQType llmqType, int64_t spork_value)
 {
     if (spork_value == 0) {
@@ -113,10 +194,20 @@ uint256 CLLMQUtils::DeterministicOutboundConnection(const uint256& proTxHash1, c
 std::set<uint256> CLLMQUtils::GetQuorumConnections(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& forMember, bool onlyOutbound)
 {
     if (IsAllMembersConnectedEnabled(llmqType)) {
-        auto mns = GetAllQuorumMembers(llmqType, pindexQuorum);
-        std::set<uint256> result;
+        if (!IsQuorumTypeEnabled(llmqType, pindexQuorum->pprev)) {
+            return {};
+        }
+        auto info = GetQuorumMembersInfo(llmqType, pindexQuorum, "connections");
 
-        for (auto& dmn : mns) {
+        LOCK(info->cs);
+        auto key = std::make_pair(forMember, onlyOutbound);
+        auto it = info->connections.find(key);
+        if (it != info->connections.end()) {
+            return it->second;
+        }
+
+        std::set<uint256> result;
+        for (auto& dmn : info->members) {
             if (dmn->proTxHash == forMember) {
                 continue;
             }
@@ -128,6 +219,7 @@ std::set<uint256> CLLMQUtils::GetQuorumConnections(Consensus::LLMQType llmqType,
                 result.emplace(dmn->proTxHash);
             }
         }
+        info->connections.emplace(key, result);
         return result;
     } else {
         return GetQuorumRelayMembers(llmqType, pindexQuorum, forMember, onlyOutbound);
@@ -136,43 +228,38 @@ std::set<uint256> CLLMQUtils::GetQuorumConnections(Consensus::LLMQType llmqType,
 
 std::set<uint256> CLLMQUtils::GetQuorumRelayMembers(Consensus::LLMQType llmqType, const CBlockIndex *pindexQuorum, const uint256 &forMember, bool onlyOutbound)
 {
-    auto mns = GetAllQuorumMembers(llmqType, pindexQuorum);
-    std::set<uint256> result;
+    if (!IsQuorumTypeEnabled(llmqType, pindexQuorum->pprev)) {
+        return {};
+    }
+    auto info = GetQuorumMembersInfo(llmqType, pindexQuorum, "relayMembers");
 
-    auto calcOutbound = [&](size_t i, const uint256 proTxHash) {
-        // Relay to nodes at indexes (i+2^k)%n, where
-        //   k: 0..max(1, floor(log2(n-1))-1)
-        //   n: size of the quorum/ring
-        std::set<uint256> r;
-        int gap = 1;
-        int gap_max = (int)mns.size() - 1;
-        int k = 0;
-        while ((gap_max >>= 1) || k <= 1) {
-            size_t idx = (i + gap) % mns.size();
-            auto& otherDmn = mns[idx];
-            if (otherDmn->proTxHash == proTxHash) {
-                continue;
-            }
-            r.emplace(otherDmn->proTxHash);
-            gap <<= 1;
-            k++;
+    LOCK(info->cs);
+    auto key = std::make_pair(forMember, onlyOutbound);
+    auto it = info->relayMembers.find(key);
+    if (it != info->relayMembers.end()) {
+        return it->second;
+    }
+
+    if (info->relayOutbound.empty()) {
+        info->relayOutbound.reserve(info->members.size());
+        for (size_t i = 0; i < info->members.size(); i++) {
+            info->relayOutbound.emplace_back(CalcRelayOutbound(info->members, i));
         }
-        return r;
-    };
+    }
 
-    for (size_t i = 0; i < mns.size(); i++) {
-        auto& dmn = mns[i];
+    std::set<uint256> result;
+    for (size_t i = 0; i < info->members.size(); i++) {
+        auto& dmn = info->members[i];
+        auto& r = info->relayOutbound[i];
         if (dmn->proTxHash == forMember) {
-            auto r = calcOutbound(i, dmn->proTxHash);
             result.insert(r.begin(), r.end());
         } else if (!onlyOutbound) {
-            auto r = calcOutbound(i, dmn->proTxHash);
             if (r.count(forMember)) {
                 result.emplace(dmn->proTxHash);
             }
         }
     }
-
+    info->relayMembers.emplace(key, result);
     return result;
 }
 
@@ -203,7 +290,7 @@ bool CLLMQUtils::EnsureQuorumConnections(Consensus::LLMQType llmqType, const CBl
     auto members = GetAllQuorumMembers(llmqType, pindexQuorum);
     bool isMember = std::find_if(members.begin(), members.end(), [&](const CDeterministicMNCPtr& dmn) { return dmn->proTxHash == myProTxHash; }) != members.end();
 
-    if (!isMember && !CLLMQUtils::IsWatchQuorumsEnabled()) {
+    if (!isMember && !CLLMQUtils::IsWatchQuorumsEnabled() && !CLLMQUtils::IsWatchRecSigsEnabled()) {
         return false;
     }
 
@@ -213,6 +300,8 @@ bool CLLMQUtils::EnsureQuorumConnections(Consensus::LLMQType llmqType, const CBl
         connections = CLLMQUtils::GetQuorumConnections(llmqType, pindexQuorum, myProTxHash, true);
         relayMembers = CLLMQUtils::GetQuorumRelayMembers(llmqType, pindexQuorum, myProTxHash, true);
     } else {
+        // Watchers only connect to a single member. As it's also a relay member, it's asked for recovered sigs (QSENDRECSIGS).
+        // Only full watchers also ask for the DKG messages (QWATCH)
         auto cindexes = CLLMQUtils::CalcDeterministicWatchConnections(llmqType, pindexQuorum, members.size(), 1);
         for (auto idx : cindexes) {
             connections.emplace(members[idx]->proTxHash);
@@ -348,6 +437,12 @@ bool CLLMQUtils::IsWatchQuorumsEnabled()
     return fIsWatchQuroumsEnabled;
 }
 
+bool CLLMQUtils::IsWatchRecSigsEnabled()
+{
+    static bool fIsWatchRecSigsEnabled = gArgs.GetBoolArg("-watchrecsigs", DEFAULT_WATCH_RECSIGS);
+    return fIsWatchRecSigsEnabled;
+}
+
 std::map<Consensus::LLMQType, QvvecSyncMode> CLLMQUtils::GetEnabledQuorumVvecSyncEntries()
 {
     std::map<Consensus::LLMQType, QvvecSyncMode> mapQuorumVvecSyncEntries;
@@ -46,6 +46,23 @@ public:
         return BuildSignHash((Consensus::LLMQType)s.llmqType, s.quorumHash, s.id, s.msgHash);
     }
 
+    // Same as BuildSignHash() for many sig shares, announcements or recovered sigs, all hashed at once with SHA256DMulti()
+    template<typename T>
+    static std::vector<uint256> BuildSignHashes(const std::vector<T>& v)
+    {
+        std::vector<unsigned char> buf;
+        buf.reserve(v.size() * SIGN_HASH_INPUT_SIZE);
+        for (const auto& s : v) {
+            AppendSignHashInput(buf, (Consensus::LLMQType)s.llmqType, s.quorumHash, s.id, s.msgHash);
+        }
+        return HashSignHashInputs(buf);
+    }
+
+    // llmqType, quorumHash, id and msgHash as serialized by BuildSignHash()
+    static const size_t SIGN_HASH_INPUT_SIZE = 1 + 3 * 32;
+    static void AppendSignHashInput(std::vector<unsigned char>& buf, Consensus::LLMQType llmqType, const uint256& quorumHash, const uint256& id, const uint256& msgHash);
+    static std::vector<uint256> HashSignHashInputs(const std::vector<unsigned char>& buf);
+
     static bool IsAllMembersConnectedEnabled(Consensus::LLMQType llmqType);
     static bool IsQuorumPoseEnabled(Consensus::LLMQType llmqType);
     static uint256 DeterministicOutboundConnection(const uint256& proTxHash1, const uint256& proTxHash2);
@@ -65,6 +82,8 @@ public:
 
     /// Returns the state of `-watchquorums`
     static bool IsWatchQuorumsEnabled();
+    /// Returns the state of `-watchrecsigs`
+    static bool IsWatchRecSigsEnabled();
 
     /// Returns the parsed entries given by `-llmq-qvvec-sync`
     static std::map<Consensus::LLMQType, QvvecSyncMode> GetEnabledQuorumVvecSyncEntries();
@@ -7,8 +7,12 @@
 #include <util.h>
 #include <utilstrencodings.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <list>
 #include <mutex>
+#include <thread>
 
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
@@ -49,6 +53,132 @@ static FILE* fileout = nullptr;
 static std::mutex* mutexDebugLog = nullptr;
 static std::list<std::string>* vMsgsBeforeOpenLog;
 
+namespace {
+
+/** Everything about a message which must be captured on the calling thread */
+struct LogRecordHeader
+{
+    int64_t nTimeMicros;
+    int64_t nMockTime;
+    uint32_t nSize; // of the message following the header
+    bool fStartedNewLine;
+    char threadName[16];
+};
+
+/**
+ * Single producer, single consumer ring of log records. Every logging thread writes to its own ring and only the
+ * writer thread reads from them, so the positions are the only shared state and no locks are needed.
+ */
+class LogRing
+{
+private:
+    std::vector<char> vData;
+    // total number of bytes written and read. Only the producer modifies nHead and only the consumer nTail
+    std::atomic<uint64_t> nHead{0};
+    std::atomic<uint64_t> nTail{0};
+
+    void Write(uint64_t nPos, const void* p, size_t nLen)
+    {
+        size_t nOffset = nPos % vData.size();
+        size_t nFirst = std::min(nLen, vData.size() - nOffset);
+        memcpy(vData.data() + nOffset, p, nFirst);
+        memcpy(vData.data(), (const char*)p + nFirst, nLen - nFirst);
+    }
+
+    void Read(uint64_t nPos, void* p, size_t nLen) const
+    {
+        size_t nOffset = nPos % vData.size();
+        size_t nFirst = std::min(nLen, vData.size() - nOffset);
+        memcpy(p, vData.data() + nOffset, nFirst);
+        memcpy((char*)p + nFirst, vData.data(), nLen - nFirst);
+    }
+
+public:
+    // set when the thread exited, the ring is dropped once it's empty
+    std::atomic<bool> fOrphaned{false};
+
+    // only used by the writer: the start of a line which is not complete yet and the time it was logged
+    std::string strPartialLine;
+    int64_t nPartialLineTime{0};
+
+    explicit LogRing(size_t nCapacity) : vData(nCapacity) {}
+
+    size_t Capacity() const { return vData.size(); }
+    size_t Usage() const { return nHead.load() - nTail.load(); }
+    bool IsEmpty() const { return Usage() == 0; }
+
+    bool TryPush(const LogRecordHeader& header, const std::string& str)
+    {
+        uint64_t nPos = nHead.load(std::memory_order_relaxed);
+        if (vData.size() - (nPos - nTail.load(std::memory_order_acquire)) < sizeof(header) + str.size()) {
+            return false;
+        }
+        Write(nPos, &header, sizeof(header));
+        Write(nPos + sizeof(header), str.data(), str.size());
+        nHead.store(nPos + sizeof(header) + str.size(), std::memory_order_release);
+        return true;
+    }
+
+    template <typename Callback>
+    void Consume(Callback&& cb)
+    {
+        uint64_t nPos = nTail.load(std::memory_order_relaxed);
+        uint64_t nEnd = nHead.load(std::memory_order_acquire);
+        LogRecordHeader header;
+        std::string str;
+        while (nPos != nEnd) {
+            Read(nPos, &header, sizeof(header));
+            str.resize(header.nSize);
+            Read(nPos + sizeof(header), &str[0], header.nSize);
+            nPos += sizeof(header) + header.nSize;
+            cb(header, str);
+        }
+        nTail.store(nPos, std::memory_order_release);
+    }
+};
+
+struct AsyncLogger
+{
+    // producers only push while fActive is set. StopAsyncLogging waits for nProducers to drop to 0 after clearing it,
+    // so that no message is pushed after the final drain
+    std::atomic<bool> fActive{false};
+    std::atomic<int> nProducers{0};
+    // incremented on every start, rings of earlier generations are replaced
+    std::atomic<uint64_t> nGeneration{0};
+    size_t nRingSize{0};
+    bool fDropWhenFull{false};
+    std::atomic<uint64_t> nDropped{0};
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<LogRing>> vRings;
+
+    std::mutex writerMutex;
+    std::condition_variable writerCv;
+    bool fStopWriter{false};
+    std::thread writerThread;
+};
+
+struct AsyncLogThreadState
+{
+    std::shared_ptr<LogRing> ring;
+    uint64_t nGeneration{0};
+    bool fStartedNewLine{true};
+    bool fWriter{false};
+
+    ~AsyncLogThreadState()
+    {
+        if (ring) {
+            ring->fOrphaned = true;
+        }
+    }
+};
+
+} // namespace
+
+// leaked on exit for the same reasons as mutexDebugLog
+static AsyncLogger* asyncLogger = nullptr;
+static thread_local AsyncLogThreadState asyncLogThreadState;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -59,6 +189,7 @@ static void DebugPrintInit()
     assert(mutexDebugLog == nullptr);
     mutexDebugLog = new std::mutex();
     vMsgsBeforeOpenLog = new std::list<std::string>;
+    asyncLogger = new AsyncLogger();
 }
 
 fs::path GetDebugLogPath()
@@ -228,22 +359,22 @@ std::string ListActiveLogCategoriesString()
  * fStartedNewLine is a state variable held by the calling context that will
  * suppress printing of the timestamp when multiple calls are made that don't
  * end in a newline. Initialize it to true, and hold it, in the calling context.
+ * The times are those of the call, which is earlier than the write when logging
+ * asynchronously.
  */
-static std::string LogTimestampStr(const std::string &str, std::atomic_bool *fStartedNewLine)
+static std::string LogTimestampStr(const std::string &str, bool fStartedNewLine, int64_t nTimeMicros, int64_t mocktime)
 {
     std::string strStamped;
 
     if (!fLogTimestamps)
         return str;
 
-    if (*fStartedNewLine) {
-        int64_t nTimeMicros = GetTimeMicros();
+    if (fStartedNewLine) {
         strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
         if (fLogTimeMicros) {
             strStamped.pop_back();
             strStamped += strprintf(".%06dZ", nTimeMicros%1000000);
         }
-        int64_t mocktime = GetMockTime();
         if (mocktime) {
             strStamped += " (mocktime: " + FormatISO8601DateTime(mocktime) + ")";
         }
@@ -259,16 +390,14 @@ static std::string LogTimestampStr(const std::string &str, std::atomic_bool *fSt
  * suppress printing of the thread name when multiple calls are made that don't
  * end in a newline. Initialize it to true, and hold/manage it, in the calling context.
  */
-static std::string LogThreadNameStr(const std::string &str, std::atomic_bool *fStartedNewLine)
+static std::string LogThreadNameStr(const std::string &str, bool fStartedNewLine, const std::string& strThreadName)
 {
     std::string strThreadLogged;
 
     if (!fLogThreadNames)
         return str;
 
-    std::string strThreadName = GetThreadName();
-
-    if (*fStartedNewLine)
+    if (fStartedNewLine)
         strThreadLogged = strprintf("%16s | %s", strThreadName.c_str(), str.c_str());
     else
         strThreadLogged = str;
@@ -276,13 +405,225 @@ static std::string LogThreadNameStr(const std::string &str, std::atomic_bool *fS
     return strThreadLogged;
 }
 
+static int DebugLogWriteStr(const std::string& str)
+{
+    std::lock_guard<std::mutex> scoped_lock(*mutexDebugLog);
+
+    // buffer if we haven't opened the log yet
+    if (fileout == nullptr) {
+        assert(vMsgsBeforeOpenLog);
+        vMsgsBeforeOpenLog->push_back(str);
+        return str.length();
+    }
+
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        fs::path pathDebug = GetDebugLogPath();
+        if (fsbridge::freopen(pathDebug,"a",fileout) != nullptr)
+            setbuf(fileout, nullptr); // unbuffered
+    }
+
+    return FileWriteStr(str, fileout);
+}
+
+/** Returns false if the message must be logged on the calling thread */
+static bool AsyncLogPush(const std::string& str)
+{
+    AsyncLogger& logger = *asyncLogger;
+    if (!logger.fActive) {
+        return false;
+    }
+    AsyncLogThreadState& state = asyncLogThreadState;
+    if (state.fWriter) {
+        return false;
+    }
+
+    logger.nProducers++;
+    if (!logger.fActive) {
+        logger.nProducers--;
+        return false;
+    }
+
+    if (!state.ring || state.nGeneration != logger.nGeneration) {
+        if (state.ring) {
+            state.ring->fOrphaned = true;
+        }
+        state.ring = std::make_shared<LogRing>(logger.nRingSize);
+        state.nGeneration = logger.nGeneration;
+        std::lock_guard<std::mutex> lock(logger.ringsMutex);
+        logger.vRings.emplace_back(state.ring);
+    }
+    LogRing& ring = *state.ring;
+
+    if (sizeof(LogRecordHeader) + str.size() > ring.Capacity()) {
+        // too large for the ring, write it ourselves once our earlier messages are out
+        logger.nProducers--;
+        while (!ring.IsEmpty() && logger.fActive) {
+            logger.writerCv.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    LogRecordHeader header;
+    header.nTimeMicros = GetTimeMicros();
+    header.nMockTime = GetMockTime();
+    header.nSize = str.size();
+    header.fStartedNewLine = state.fStartedNewLine;
+    memset(header.threadName, 0, sizeof(header.threadName));
+    if (fLogThreadNames) {
+        strncpy(header.threadName, GetThreadName().c_str(), sizeof(header.threadName) - 1);
+    }
+    state.fStartedNewLine = !str.empty() && str.back() == '\n';
+
+    while (!ring.TryPush(header, str)) {
+        if (logger.fDropWhenFull) {
+            logger.nDropped++;
+            break;
+        }
+        logger.writerCv.notify_one();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    // wake up the writer early when the ring fills up, it otherwise only writes periodically
+    if (ring.Usage() > ring.Capacity() / 2) {
+        logger.writerCv.notify_one();
+    }
+
+    logger.nProducers--;
+    return true;
+}
+
+static void AsyncLogDrain(AsyncLogger& logger, bool fFinal)
+{
+    std::vector<std::pair<int64_t, std::string>> vLines;
+    std::vector<std::shared_ptr<LogRing>> vRings;
+    {
+        std::lock_guard<std::mutex> lock(logger.ringsMutex);
+        // an orphaned ring can't get new messages, so it can be dropped once it's empty. Check fOrphaned first, as
+        // the last message of a thread is pushed before the flag is set
+        logger.vRings.erase(std::remove_if(logger.vRings.begin(), logger.vRings.end(), [&](const std::shared_ptr<LogRing>& ring) {
+            if (!ring->fOrphaned || !ring->IsEmpty()) {
+                return false;
+            }
+            if (!ring->strPartialLine.empty()) {
+                vLines.emplace_back(ring->nPartialLineTime, std::move(ring->strPartialLine));
+            }
+            return true;
+        }), logger.vRings.end());
+        vRings = logger.vRings;
+    }
+
+    for (const auto& ring : vRings) {
+        // lines logged in multiple calls are kept together, so that lines of other threads don't end up in between
+        ring->Consume([&](const LogRecordHeader& header, const std::string& str) {
+            if (ring->strPartialLine.empty()) {
+                ring->nPartialLineTime = header.nTimeMicros;
+            }
+            std::string strThreadLogged = LogThreadNameStr(str, header.fStartedNewLine, header.threadName);
+            ring->strPartialLine += LogTimestampStr(strThreadLogged, header.fStartedNewLine, header.nTimeMicros, header.nMockTime);
+            if (!str.empty() && str.back() == '\n') {
+                vLines.emplace_back(ring->nPartialLineTime, std::move(ring->strPartialLine));
+                ring->strPartialLine.clear();
+            }
+        });
+        if (fFinal && !ring->strPartialLine.empty()) {
+            vLines.emplace_back(ring->nPartialLineTime, std::move(ring->strPartialLine));
+            ring->strPartialLine.clear();
+        }
+    }
+    uint64_t nDropped = logger.nDropped.exchange(0);
+    if (nDropped != 0) {
+        int64_t nTimeMicros = GetTimeMicros();
+        std::string str = strprintf("%d log messages were dropped because log buffers were full\n", nDropped);
+        vLines.emplace_back(nTimeMicros, LogTimestampStr(str, true, nTimeMicros, GetMockTime()));
+    }
+    if (vLines.empty()) {
+        return;
+    }
+
+    // merge the messages of all threads in the order they were logged. The order of each thread is kept
+    std::stable_sort(vLines.begin(), vLines.end(), [](const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) {
+        return a.first < b.first;
+    });
+    std::string strOut;
+    for (const auto& p : vLines) {
+        strOut += p.second;
+    }
+    DebugLogWriteStr(strOut);
+}
+
+static void AsyncLogWriterThread(AsyncLogger& logger)
+{
+    RenameThread("dash-logger");
+    asyncLogThreadState.fWriter = true;
+
+    std::unique_lock<std::mutex> lock(logger.writerMutex);
+    while (!logger.fStopWriter) {
+        logger.writerCv.wait_for(lock, std::chrono::milliseconds(10), [&] { return logger.fStopWriter; });
+        lock.unlock();
+        AsyncLogDrain(logger, false);
+        lock.lock();
+    }
+    lock.unlock();
+    AsyncLogDrain(logger, true);
+}
+
+void StartAsyncLogging(size_t nBufferSize, bool fDropWhenFull)
+{
+    if (fPrintToConsole || !fPrintToDebugLog) {
+        return;
+    }
+    std::call_once(debugPrintInitFlag, &DebugPrintInit);
+    AsyncLogger& logger = *asyncLogger;
+    if (logger.writerThread.joinable()) {
+        return;
+    }
+
+    logger.nRingSize = std::max(nBufferSize, sizeof(LogRecordHeader) * 16);
+    logger.fDropWhenFull = fDropWhenFull;
+    logger.nGeneration++;
+    logger.fStopWriter = false;
+    logger.writerThread = std::thread(AsyncLogWriterThread, std::ref(logger));
+    logger.fActive = true;
+}
+
+void StopAsyncLogging()
+{
+    if (!asyncLogger || !asyncLogger->writerThread.joinable()) {
+        return;
+    }
+    AsyncLogger& logger = *asyncLogger;
+
+    logger.fActive = false;
+    while (logger.nProducers != 0) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> lock(logger.writerMutex);
+        logger.fStopWriter = true;
+    }
+    logger.writerCv.notify_all();
+    logger.writerThread.join();
+
+    std::lock_guard<std::mutex> lock(logger.ringsMutex);
+    logger.vRings.clear();
+}
+
 int LogPrintStr(const std::string &str)
 {
     int ret = 0; // Returns total number of characters written
     static std::atomic_bool fStartedNewLine(true);
 
-    std::string strThreadLogged = LogThreadNameStr(str, &fStartedNewLine);
-    std::string strTimestamped = LogTimestampStr(strThreadLogged, &fStartedNewLine);
+    if (!fPrintToConsole && fPrintToDebugLog) {
+        std::call_once(debugPrintInitFlag, &DebugPrintInit);
+        if (AsyncLogPush(str)) {
+            return str.size();
+        }
+    }
+
+    std::string strThreadLogged = LogThreadNameStr(str, fStartedNewLine, fLogThreadNames ? GetThreadName() : std::string());
+    std::string strTimestamped = LogTimestampStr(strThreadLogged, fStartedNewLine, GetTimeMicros(), GetMockTime());
 
     if (!str.empty() && str[str.size()-1] == '\n')
         fStartedNewLine = true;
@@ -297,27 +638,7 @@ int LogPrintStr(const std::string &str)
     }
     else if (fPrintToDebugLog)
     {
-        std::call_once(debugPrintInitFlag, &DebugPrintInit);
-        std::lock_guard<std::mutex> scoped_lock(*mutexDebugLog);
-
-        // buffer if we haven't opened the log yet
-        if (fileout == nullptr) {
-            assert(vMsgsBeforeOpenLog);
-            ret = strTimestamped.length();
-            vMsgsBeforeOpenLog->push_back(strTimestamped);
-        }
-        else
-        {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                fs::path pathDebug = GetDebugLogPath();
-                if (fsbridge::freopen(pathDebug,"a",fileout) != nullptr)
-                    setbuf(fileout, nullptr); // unbuffered
-            }
-
-            ret = FileWriteStr(strTimestamped, fileout);
-        }
+        ret = DebugLogWriteStr(strTimestamped);
     }
     return ret;
 }
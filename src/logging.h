@@ -18,6 +18,10 @@ static const bool DEFAULT_LOGTIMEMICROS  = false;
 static const bool DEFAULT_LOGIPS         = false;
 static const bool DEFAULT_LOGTIMESTAMPS  = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+static const bool DEFAULT_LOGASYNC       = false;
+static const bool DEFAULT_LOGASYNCDROP   = false;
+// size of the log buffer of each thread in KiB when logging asynchronously
+static const unsigned int DEFAULT_LOGASYNCBUFFER = 256;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fPrintToConsole;
@@ -158,4 +162,13 @@ fs::path GetDebugLogPath();
 bool OpenDebugLog();
 void ShrinkDebugFile();
 
+/**
+ * Write debug.log from a dedicated thread. Logging threads only copy their messages, together with the time and
+ * thread name of the call, into a ring buffer of their own. When a buffer is full, the thread waits for the writer
+ * or, with fDropWhenFull, drops the message. Has no effect when printing to the console.
+ */
+void StartAsyncLogging(size_t nBufferSize, bool fDropWhenFull);
+/** Write all buffered messages and return to logging on the calling threads */
+void StopAsyncLogging();
+
 #endif // BITCOIN_LOGGING_H
@@ -1,27 +1,40 @@
-// Copyright (c) 2014-2020 The Dash Core developers
+// Copyright (c) 2014-2021 The Dash Core developers
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <masternode/masternode-meta.h>
 
+#include <flat-database.h>
+#include <memusage.h>
 #include <timedata.h>
+#include <util.h>
+#include <utiltime.h>
 
 CMasternodeMetaMan mmetaman;
 
 const std::string CMasternodeMetaMan::SERIALIZATION_VERSION_STRING = "CMasternodeMetaMan-Version-2";
 
+const std::string CMasternodeMetaMan::DB_META_INFO = "mm_i";
+const std::string CMasternodeMetaMan::DB_DSQ_COUNT = "mm_dsq";
+const std::string CMasternodeMetaMan::DB_VERSION = "mm_version";
+
+static const uint32_t CURRENT_DB_VERSION = 1;
+
 UniValue CMasternodeMetaInfo::ToJson() const
 {
     UniValue ret(UniValue::VOBJ);
 
     auto now = GetAdjustedTime();
 
-    ret.pushKV("lastDSQ", nLastDsq);
-    ret.pushKV("mixingTxCount", nMixingTxCount);
-    ret.pushKV("lastOutboundAttempt", lastOutboundAttempt);
-    ret.pushKV("lastOutboundAttemptElapsed", now - lastOutboundAttempt);
-    ret.pushKV("lastOutboundSuccess", lastOutboundSuccess);
-    ret.pushKV("lastOutboundSuccessElapsed", now - lastOutboundSuccess);
+    int64_t nLastAttempt = lastOutboundAttempt;
+    int64_t nLastSuccess = lastOutboundSuccess;
+
+    ret.pushKV("lastDSQ", nLastDsq.load());
+    ret.pushKV("mixingTxCount", nMixingTxCount.load());
+    ret.pushKV("lastOutboundAttempt", nLastAttempt);
+    ret.pushKV("lastOutboundAttemptElapsed", now - nLastAttempt);
+    ret.pushKV("lastOutboundSuccess", nLastSuccess);
+    ret.pushKV("lastOutboundSuccessElapsed", now - nLastSuccess);
 
     return ret;
 }
@@ -33,26 +46,30 @@ void CMasternodeMetaInfo::AddGovernanceVote(const uint256& nGovernanceObjectHash
     // ensures the value is in the map.
     const auto& pair = mapGovernanceObjectsVotedOn.emplace(nGovernanceObjectHash, 0);
     pair.first->second++;
+    fDirty = true;
 }
 
 void CMasternodeMetaInfo::RemoveGovernanceObject(const uint256& nGovernanceObjectHash)
 {
     LOCK(cs);
     // Whether or not the govobj hash exists in the map first is irrelevant.
-    mapGovernanceObjectsVotedOn.erase(nGovernanceObjectHash);
+    if (mapGovernanceObjectsVotedOn.erase(nGovernanceObjectHash)) {
+        fDirty = true;
+    }
 }
 
 CMasternodeMetaInfoPtr CMasternodeMetaMan::GetMetaInfo(const uint256& proTxHash, bool fCreate)
 {
-    LOCK(cs);
-    auto it = metaInfos.find(proTxHash);
-    if (it != metaInfos.end()) {
+    auto& shard = GetShard(proTxHash);
+    LOCK(shard.cs);
+    auto it = shard.metaInfos.find(proTxHash);
+    if (it != shard.metaInfos.end()) {
         return it->second;
     }
     if (!fCreate) {
         return nullptr;
     }
-    it = metaInfos.emplace(proTxHash, std::make_shared<CMasternodeMetaInfo>(proTxHash)).first;
+    it = shard.metaInfos.emplace(proTxHash, std::make_shared<CMasternodeMetaInfo>(proTxHash)).first;
     return it->second;
 }
 
@@ -62,7 +79,6 @@ CMasternodeMetaInfoPtr CMasternodeMetaMan::GetMetaInfo(const uint256& proTxHash,
 // masternodes before we ever see a masternode that we know already mixed someone's funds earlier.
 int64_t CMasternodeMetaMan::GetDsqThreshold(const uint256& proTxHash, int nMnCount)
 {
-    LOCK(cs);
     auto metaInfo = GetMetaInfo(proTxHash);
     if (metaInfo == nullptr) {
         // return a threshold which is slightly above nDsqCount i.e. a no-go
@@ -73,26 +89,21 @@ int64_t CMasternodeMetaMan::GetDsqThreshold(const uint256& proTxHash, int nMnCou
 
 void CMasternodeMetaMan::AllowMixing(const uint256& proTxHash)
 {
-    LOCK(cs);
     auto mm = GetMetaInfo(proTxHash);
-    nDsqCount++;
-    LOCK(mm->cs);
-    mm->nLastDsq = nDsqCount;
+    mm->nLastDsq = ++nDsqCount;
     mm->nMixingTxCount = 0;
+    mm->fDirty = true;
 }
 
 void CMasternodeMetaMan::DisallowMixing(const uint256& proTxHash)
 {
-    LOCK(cs);
     auto mm = GetMetaInfo(proTxHash);
-
-    LOCK(mm->cs);
     mm->nMixingTxCount++;
+    mm->fDirty = true;
 }
 
 bool CMasternodeMetaMan::AddGovernanceVote(const uint256& proTxHash, const uint256& nGovernanceObjectHash)
 {
-    LOCK(cs);
     auto mm = GetMetaInfo(proTxHash);
     mm->AddGovernanceVote(nGovernanceObjectHash);
     return true;
@@ -100,9 +111,11 @@ bool CMasternodeMetaMan::AddGovernanceVote(const uint256& proTxHash, const uint2
 
 void CMasternodeMetaMan::RemoveGovernanceObject(const uint256& nGovernanceObjectHash)
 {
-    LOCK(cs);
-    for(auto& p : metaInfos) {
-        p.second->RemoveGovernanceObject(nGovernanceObjectHash);
+    for (auto& shard : shards) {
+        LOCK(shard.cs);
+        for (auto& p : shard.metaInfos) {
+            p.second->RemoveGovernanceObject(nGovernanceObjectHash);
+        }
     }
 }
 
@@ -114,10 +127,109 @@ std::vector<uint256> CMasternodeMetaMan::GetAndClearDirtyGovernanceObjectHashes(
     return vecTmp;
 }
 
+bool CMasternodeMetaMan::LoadCache(bool fWipe)
+{
+    LOCK(cs);
+
+    int64_t nStart = GetTimeMillis();
+    fs::path pathFlatDB = GetDataDir() / "mncache.dat";
+
+    Clear();
+    db = MakeUnique<CDBWrapper>(GetDataDir() / "mnmeta", 1 << 20, false, fWipe);
+
+    uint32_t nVersion{0};
+    if (fWipe || !db->Read(DB_VERSION, nVersion) || nVersion != CURRENT_DB_VERSION) {
+        if (!fWipe) {
+            // Drop whatever an interrupted migration left behind
+            db.reset();
+            db = MakeUnique<CDBWrapper>(GetDataDir() / "mnmeta", 1 << 20, false, true);
+        }
+        if (!fWipe && fs::exists(pathFlatDB)) {
+            LogPrintf("Migrating masternode cache from mncache.dat...\n");
+            CFlatDB<CMasternodeMetaMan> flatdb("mncache.dat", "magicMasternodeCache");
+            if (!flatdb.Load(*this)) {
+                return false;
+            }
+        }
+        // All entries are dirty now and the version is written last, so that an interrupted migration is started over
+        FlushCache(true);
+        if (fs::exists(pathFlatDB)) {
+            fs::remove(pathFlatDB);
+        }
+        LogPrintf("Masternode meta db initialized  %dms\n", GetTimeMillis() - nStart);
+        return true;
+    }
+
+    int64_t nDsqCountTmp{0};
+    db->Read(DB_DSQ_COUNT, nDsqCountTmp);
+    nDsqCount = nDsqCountTmp;
+
+    std::unique_ptr<CDBIterator> pcursor(db->NewIterator());
+    pcursor->Seek(std::make_pair(DB_META_INFO, uint256()));
+    while (pcursor->Valid()) {
+        std::pair<std::string, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_META_INFO) {
+            break;
+        }
+        auto mm = std::make_shared<CMasternodeMetaInfo>();
+        if (pcursor->GetValue(*mm) && mm->GetProTxHash() == key.second) {
+            mm->fDirty = false;
+            auto& shard = GetShard(key.second);
+            LOCK(shard.cs);
+            shard.metaInfos.emplace(key.second, std::move(mm));
+        } else {
+            LogPrintf("CMasternodeMetaMan::%s -- failed to read meta info %s, dropping it\n", __func__, key.second.ToString());
+        }
+        pcursor->Next();
+    }
+
+    LogPrintf("Loaded masternode meta db  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("     %s\n", ToString());
+
+    return true;
+}
+
+void CMasternodeMetaMan::FlushCache(bool fSync)
+{
+    LOCK(cs);
+
+    if (!db) return;
+
+    int64_t nStart = GetTimeMillis();
+    int nWritten = 0;
+
+    CDBBatch batch(*db);
+    for (auto& shard : shards) {
+        LOCK(shard.cs);
+        for (const auto& p : shard.metaInfos) {
+            // Clear the flag before serializing, changes made while writing will be picked up by the next flush
+            if (!p.second->fDirty.exchange(false)) {
+                continue;
+            }
+            batch.Write(std::make_pair(DB_META_INFO, p.first), *p.second);
+            nWritten++;
+        }
+    }
+    batch.Write(DB_DSQ_COUNT, nDsqCount.load());
+    batch.Write(DB_VERSION, CURRENT_DB_VERSION);
+    db->WriteBatch(batch, fSync);
+
+    LogPrint(BCLog::MNSYNC, "CMasternodeMetaMan::%s -- wrote %d meta infos  %dms\n", __func__, nWritten, GetTimeMillis() - nStart);
+}
+
+void CMasternodeMetaMan::CloseCache()
+{
+    LOCK(cs);
+    db.reset();
+}
+
 void CMasternodeMetaMan::Clear()
 {
+    for (auto& shard : shards) {
+        LOCK(shard.cs);
+        shard.metaInfos.clear();
+    }
     LOCK(cs);
-    metaInfos.clear();
     vecDirtyGovernanceObjectHashes.clear();
 }
 
@@ -126,11 +238,36 @@ void CMasternodeMetaMan::CheckAndRemove()
 
 }
 
+size_t CMasternodeMetaMan::GetMetaInfoCount() const
+{
+    size_t nCount{0};
+    for (const auto& shard : shards) {
+        LOCK(shard.cs);
+        nCount += shard.metaInfos.size();
+    }
+    return nCount;
+}
+
+size_t CMasternodeMetaMan::GetMemoryUsage() const
+{
+    size_t usage{0};
+    for (const auto& shard : shards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.metaInfos);
+        for (const auto& p : shard.metaInfos) {
+            LOCK(p.second->cs);
+            usage += memusage::DynamicUsage(p.second) + memusage::DynamicUsage(p.second->mapGovernanceObjectsVotedOn);
+        }
+    }
+    LOCK(cs);
+    return usage + memusage::DynamicUsage(vecDirtyGovernanceObjectHashes);
+}
+
 std::string CMasternodeMetaMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Masternodes: meta infos object count: " << (int)metaInfos.size() <<
+    info << "Masternodes: meta infos object count: " << (int)GetMetaInfoCount() <<
          ", nDsqCount: " << (int)nDsqCount;
     return info.str();
 }
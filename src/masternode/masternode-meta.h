@@ -5,12 +5,15 @@
 #ifndef BITCOIN_MASTERNODE_MASTERNODE_META_H
 #define BITCOIN_MASTERNODE_MASTERNODE_META_H
 
+#include <dbwrapper.h>
 #include <serialize.h>
 
 #include <evo/deterministicmns.h>
 
 #include <univalue.h>
 
+#include <array>
+#include <atomic>
 #include <memory>
 
 class CConnman;
@@ -19,6 +22,8 @@ static const int MASTERNODE_MAX_MIXING_TXES             = 5;
 
 // Holds extra (non-deterministic) information about masternodes
 // This is mostly local information, e.g. about mixing and governance
+// The scalar fields are atomics so that hot readers (connection planning, mixing) don't need to lock,
+// cs only protects mapGovernanceObjectsVotedOn
 class CMasternodeMetaInfo
 {
     friend class CMasternodeMetaMan;
@@ -29,26 +34,30 @@ private:
     uint256 proTxHash;
 
     //the dsq count from the last dsq broadcast of this node
-    int64_t nLastDsq = 0;
-    int nMixingTxCount = 0;
+    std::atomic<int64_t> nLastDsq{0};
+    std::atomic<int> nMixingTxCount{0};
 
     // KEEP TRACK OF GOVERNANCE ITEMS EACH MASTERNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
 
-    int64_t lastOutboundAttempt = 0;
-    int64_t lastOutboundSuccess = 0;
+    std::atomic<int64_t> lastOutboundAttempt{0};
+    std::atomic<int64_t> lastOutboundSuccess{0};
+
+    // Set on every change, cleared when the entry is written by CMasternodeMetaMan::FlushCache
+    std::atomic<bool> fDirty{true};
 
 public:
     CMasternodeMetaInfo() = default;
     explicit CMasternodeMetaInfo(const uint256& _proTxHash) : proTxHash(_proTxHash) {}
     CMasternodeMetaInfo(const CMasternodeMetaInfo& ref) :
         proTxHash(ref.proTxHash),
-        nLastDsq(ref.nLastDsq),
-        nMixingTxCount(ref.nMixingTxCount),
-        mapGovernanceObjectsVotedOn(ref.mapGovernanceObjectsVotedOn),
-        lastOutboundAttempt(ref.lastOutboundAttempt),
-        lastOutboundSuccess(ref.lastOutboundSuccess)
+        nLastDsq(ref.nLastDsq.load()),
+        nMixingTxCount(ref.nMixingTxCount.load()),
+        lastOutboundAttempt(ref.lastOutboundAttempt.load()),
+        lastOutboundSuccess(ref.lastOutboundSuccess.load())
     {
+        LOCK(ref.cs);
+        mapGovernanceObjectsVotedOn = ref.mapGovernanceObjectsVotedOn;
     }
 
     ADD_SERIALIZE_METHODS
@@ -56,20 +65,30 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
         LOCK(cs);
+        int64_t nLastDsqTmp = nLastDsq;
+        int nMixingTxCountTmp = nMixingTxCount;
+        int64_t lastOutboundAttemptTmp = lastOutboundAttempt;
+        int64_t lastOutboundSuccessTmp = lastOutboundSuccess;
         READWRITE(proTxHash);
-        READWRITE(nLastDsq);
-        READWRITE(nMixingTxCount);
+        READWRITE(nLastDsqTmp);
+        READWRITE(nMixingTxCountTmp);
         READWRITE(mapGovernanceObjectsVotedOn);
-        READWRITE(lastOutboundAttempt);
-        READWRITE(lastOutboundSuccess);
+        READWRITE(lastOutboundAttemptTmp);
+        READWRITE(lastOutboundSuccessTmp);
+        if (ser_action.ForRead()) {
+            nLastDsq = nLastDsqTmp;
+            nMixingTxCount = nMixingTxCountTmp;
+            lastOutboundAttempt = lastOutboundAttemptTmp;
+            lastOutboundSuccess = lastOutboundSuccessTmp;
+        }
     }
 
     UniValue ToJson() const;
 
 public:
-    const uint256& GetProTxHash() const { LOCK(cs); return proTxHash; }
-    int64_t GetLastDsq() const { LOCK(cs); return nLastDsq; }
-    int GetMixingTxCount() const { LOCK(cs); return nMixingTxCount; }
+    const uint256& GetProTxHash() const { return proTxHash; }
+    int64_t GetLastDsq() const { return nLastDsq; }
+    int GetMixingTxCount() const { return nMixingTxCount; }
 
     bool IsValidForMixingTxes() const { return GetMixingTxCount() <= MASTERNODE_MAX_MIXING_TXES; }
 
@@ -78,25 +97,47 @@ public:
 
     void RemoveGovernanceObject(const uint256& nGovernanceObjectHash);
 
-    void SetLastOutboundAttempt(int64_t t) { LOCK(cs); lastOutboundAttempt = t; }
-    int64_t GetLastOutboundAttempt() const { LOCK(cs); return lastOutboundAttempt; }
-    void SetLastOutboundSuccess(int64_t t) { LOCK(cs); lastOutboundSuccess = t; }
-    int64_t GetLastOutboundSuccess() const { LOCK(cs); return lastOutboundSuccess; }
+    void SetLastOutboundAttempt(int64_t t) { lastOutboundAttempt = t; fDirty = true; }
+    int64_t GetLastOutboundAttempt() const { return lastOutboundAttempt; }
+    void SetLastOutboundSuccess(int64_t t) { lastOutboundSuccess = t; fDirty = true; }
+    int64_t GetLastOutboundSuccess() const { return lastOutboundSuccess; }
 };
 typedef std::shared_ptr<CMasternodeMetaInfo> CMasternodeMetaInfoPtr;
 
+/**
+ * Meta infos are spread over META_INFO_SHARDS maps with their own locks, picked by proTxHash, so that lookups
+ * from different threads rarely contend.
+ *
+ * They are stored in <datadir>/mnmeta, one record per masternode ("mm_i" keys). FlushCache() only writes the
+ * entries which changed since the last flush. mncache.dat is only read once to migrate it.
+ */
 class CMasternodeMetaMan
 {
 private:
     static const std::string SERIALIZATION_VERSION_STRING;
+    static const size_t META_INFO_SHARDS = 16;
 
-    CCriticalSection cs;
+    static const std::string DB_META_INFO;
+    static const std::string DB_DSQ_COUNT;
+    static const std::string DB_VERSION;
+
+    struct MetaInfoShard {
+        mutable CCriticalSection cs;
+        std::map<uint256, CMasternodeMetaInfoPtr> metaInfos;
+    };
+    std::array<MetaInfoShard, META_INFO_SHARDS> shards;
+
+    // protects vecDirtyGovernanceObjectHashes and db
+    mutable CCriticalSection cs;
 
-    std::map<uint256, CMasternodeMetaInfoPtr> metaInfos;
     std::vector<uint256> vecDirtyGovernanceObjectHashes;
 
+    std::unique_ptr<CDBWrapper> db;
+
     // keep track of dsq count to prevent masternodes from gaming coinjoin queue
-    int64_t nDsqCount = 0;
+    std::atomic<int64_t> nDsqCount{0};
+
+    MetaInfoShard& GetShard(const uint256& proTxHash) { return shards[proTxHash.GetCheapHash() % META_INFO_SHARDS]; }
 
 public:
     ADD_SERIALIZE_METHODS
@@ -104,8 +145,6 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
-        LOCK(cs);
-
         std::string strVersion;
         if(ser_action.ForRead()) {
             Clear();
@@ -122,24 +161,30 @@ public:
         std::vector<CMasternodeMetaInfo> tmpMetaInfo;
         if (ser_action.ForRead()) {
             READWRITE(tmpMetaInfo);
-            metaInfos.clear();
             for (auto& mm : tmpMetaInfo) {
-                metaInfos.emplace(mm.GetProTxHash(), std::make_shared<CMasternodeMetaInfo>(std::move(mm)));
+                auto& shard = GetShard(mm.GetProTxHash());
+                LOCK(shard.cs);
+                shard.metaInfos.emplace(mm.GetProTxHash(), std::make_shared<CMasternodeMetaInfo>(std::move(mm)));
             }
         } else {
-            for (auto& p : metaInfos) {
-                tmpMetaInfo.emplace_back(*p.second);
+            for (auto& shard : shards) {
+                LOCK(shard.cs);
+                for (auto& p : shard.metaInfos) {
+                    tmpMetaInfo.emplace_back(*p.second);
+                }
             }
             READWRITE(tmpMetaInfo);
         }
 
-        READWRITE(nDsqCount);
+        int64_t nDsqCountTmp = nDsqCount;
+        READWRITE(nDsqCountTmp);
+        nDsqCount = nDsqCountTmp;
     }
 
 public:
     CMasternodeMetaInfoPtr GetMetaInfo(const uint256& proTxHash, bool fCreate = true);
 
-    int64_t GetDsqCount() { LOCK(cs); return nDsqCount; }
+    int64_t GetDsqCount() const { return nDsqCount; }
     int64_t GetDsqThreshold(const uint256& proTxHash, int nMnCount);
 
     void AllowMixing(const uint256& proTxHash);
@@ -150,9 +195,18 @@ public:
 
     std::vector<uint256> GetAndClearDirtyGovernanceObjectHashes();
 
+    /** Open <datadir>/mnmeta and read all meta infos, migrating mncache.dat if the db is new */
+    bool LoadCache(bool fWipe);
+    /** Write all meta infos which changed since the last flush */
+    void FlushCache(bool fSync = false);
+    void CloseCache();
+
     void Clear();
     void CheckAndRemove();
 
+    size_t GetMetaInfoCount() const;
+    size_t GetMemoryUsage() const;
+
     std::string ToString() const;
 };
 
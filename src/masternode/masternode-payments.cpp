@@ -8,12 +8,23 @@
 #include <masternode/masternode-sync.h>
 #include <netfulfilledman.h>
 #include <netmessagemaker.h>
+#include <saltedhasher.h>
+#include <unordered_lru_cache.h>
 #include <validation.h>
 
 #include <string>
 
 CMasternodePayments mnpayments;
 
+static CCriticalSection cs_paymentsCache;
+// keyed by the hash of the previous block
+static unordered_lru_cache<uint256, CBlockPayee, StaticSaltedHasher, 128> payeeCache GUARDED_BY(cs_paymentsCache);
+static struct {
+    uint256 blockHash;
+    int nCount{0};
+    std::vector<CDeterministicMNCPtr> payees;
+} projectedPayeesCache GUARDED_BY(cs_paymentsCache);
+
 bool IsOldBudgetBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string& strErrorRet) {
     const Consensus::Params& consensusParams = Params().GetConsensus();
     bool isBlockRewardValueMet = (block.vtx[0]->GetValueOut() <= blockReward);
@@ -206,14 +217,24 @@ bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount bloc
 
 void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet, std::vector<CTxOut>& voutSuperblockPaymentsRet)
 {
+    CBlockPayee payee;
+    CMasternodePayments::GetBlockPayee(nBlockHeight, payee);
+    FillBlockPayments(txNew, payee, blockReward, voutMasternodePaymentsRet, voutSuperblockPaymentsRet);
+}
+
+void FillBlockPayments(CMutableTransaction& txNew, const CBlockPayee& payee, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet, std::vector<CTxOut>& voutSuperblockPaymentsRet)
+{
+    const int nBlockHeight = payee.nBlockHeight;
+
     // only create superblocks if spork is enabled AND if superblock is actually triggered
     // (height should be validated inside)
+    // This is not determined in advance like the payee, triggers can change with every governance vote
     if(AreSuperblocksEnabled() && CSuperblockManager::IsSuperblockTriggered(nBlockHeight)) {
         LogPrint(BCLog::GOBJECT, "%s -- triggered superblock creation at height %d\n", __func__, nBlockHeight);
         CSuperblockManager::GetSuperblockPayments(nBlockHeight, voutSuperblockPaymentsRet);
     }
 
-    if (!CMasternodePayments::GetMasternodeTxOuts(nBlockHeight, blockReward, voutMasternodePaymentsRet)) {
+    if (!CMasternodePayments::GetMasternodeTxOuts(payee, blockReward, voutMasternodePaymentsRet)) {
         LogPrint(BCLog::MNPAYMENTS, "%s -- no masternode to pay (MN list probably empty)\n", __func__);
     }
 
@@ -240,11 +261,18 @@ void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blo
 */
 
 bool CMasternodePayments::GetMasternodeTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet)
+{
+    CBlockPayee payee;
+    GetBlockPayee(nBlockHeight, payee);
+    return GetMasternodeTxOuts(payee, blockReward, voutMasternodePaymentsRet);
+}
+
+bool CMasternodePayments::GetMasternodeTxOuts(const CBlockPayee& payee, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet)
 {
     // make sure it's not filled yet
     voutMasternodePaymentsRet.clear();
 
-    if(!GetBlockTxOuts(nBlockHeight, blockReward, voutMasternodePaymentsRet)) {
+    if(!GetBlockTxOuts(payee, blockReward, voutMasternodePaymentsRet)) {
         LogPrintf("CMasternodePayments::%s -- no payee (deterministic masternode list empty)\n", __func__);
         return false;
     }
@@ -259,26 +287,85 @@ bool CMasternodePayments::GetMasternodeTxOuts(int nBlockHeight, CAmount blockRew
     return true;
 }
 
-bool CMasternodePayments::GetBlockTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet)
+bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CBlockPayee& payeeRet)
 {
-    voutMasternodePaymentsRet.clear();
+    const CBlockIndex* pindexPrev;
+    {
+        LOCK(cs_main);
+        pindexPrev = chainActive[nBlockHeight - 1];
+    }
 
-    const CBlockIndex* pindex;
-    int nReallocActivationHeight{std::numeric_limits<int>::max()};
+    if (pindexPrev == nullptr) {
+        payeeRet = CBlockPayee();
+        payeeRet.nBlockHeight = nBlockHeight;
+        return false;
+    }
+    return GetBlockPayee(pindexPrev, payeeRet);
+}
 
+bool CMasternodePayments::GetBlockPayee(const CBlockIndex* pindexPrev, CBlockPayee& payeeRet)
+{
+    // the payee only depends on the previous block, so cached entries never become stale, not even on reorgs
+    const uint256& blockHash = pindexPrev->GetBlockHash();
     {
-        LOCK(cs_main);
-        pindex = chainActive[nBlockHeight - 1];
+        LOCK(cs_paymentsCache);
+        if (payeeCache.get(blockHash, payeeRet)) {
+            return payeeRet.dmnPayee != nullptr;
+        }
+    }
+
+    payeeRet = CBlockPayee();
+    payeeRet.nBlockHeight = pindexPrev->nHeight + 1;
 
+    {
+        LOCK(cs_main);
         const Consensus::Params& consensusParams = Params().GetConsensus();
-        if (VersionBitsState(pindex, consensusParams, Consensus::DEPLOYMENT_REALLOC, versionbitscache) == ThresholdState::ACTIVE) {
-            nReallocActivationHeight = VersionBitsStateSinceHeight(pindex, consensusParams, Consensus::DEPLOYMENT_REALLOC, versionbitscache);
+        if (VersionBitsState(pindexPrev, consensusParams, Consensus::DEPLOYMENT_REALLOC, versionbitscache) == ThresholdState::ACTIVE) {
+            payeeRet.nReallocActivationHeight = VersionBitsStateSinceHeight(pindexPrev, consensusParams, Consensus::DEPLOYMENT_REALLOC, versionbitscache);
+        }
+    }
+
+    payeeRet.dmnPayee = deterministicMNManager->GetListForBlock(pindexPrev).GetMNPayee();
+
+    LOCK(cs_paymentsCache);
+    payeeCache.insert(blockHash, payeeRet);
+    return payeeRet.dmnPayee != nullptr;
+}
+
+std::vector<CDeterministicMNCPtr> CMasternodePayments::GetProjectedPayees(const CBlockIndex* pindex, int nCount)
+{
+    {
+        LOCK(cs_paymentsCache);
+        // the projection is the payment queue, so a shorter one is a prefix of a longer one
+        if (projectedPayeesCache.blockHash == pindex->GetBlockHash() && projectedPayeesCache.nCount >= nCount) {
+            const auto& payees = projectedPayeesCache.payees;
+            return std::vector<CDeterministicMNCPtr>(payees.begin(), payees.begin() + std::min<size_t>(std::max(nCount, 0), payees.size()));
         }
     }
 
-    CAmount masternodeReward = GetMasternodePayment(nBlockHeight, blockReward, nReallocActivationHeight);
+    auto payees = deterministicMNManager->GetListForBlock(pindex).GetProjectedMNPayees(nCount);
+
+    LOCK(cs_paymentsCache);
+    projectedPayeesCache.blockHash = pindex->GetBlockHash();
+    projectedPayeesCache.nCount = nCount;
+    projectedPayeesCache.payees = payees;
+    return payees;
+}
+
+bool CMasternodePayments::GetBlockTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet)
+{
+    CBlockPayee payee;
+    GetBlockPayee(nBlockHeight, payee);
+    return GetBlockTxOuts(payee, blockReward, voutMasternodePaymentsRet);
+}
+
+bool CMasternodePayments::GetBlockTxOuts(const CBlockPayee& payee, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet)
+{
+    voutMasternodePaymentsRet.clear();
+
+    CAmount masternodeReward = GetMasternodePayment(payee.nBlockHeight, blockReward, payee.nReallocActivationHeight);
 
-    auto dmnPayee = deterministicMNManager->GetListForBlock(pindex).GetMNPayee();
+    const auto& dmnPayee = payee.dmnPayee;
     if (!dmnPayee) {
         return false;
     }
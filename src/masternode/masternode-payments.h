@@ -13,12 +13,23 @@
 
 #include <evo/deterministicmns.h>
 
+#include <limits>
+
 class CMasternodePayments;
 
+/** The masternode payee of a block, which only depends on the previous block and not on the block itself */
+struct CBlockPayee {
+    int nBlockHeight{0};
+    int nReallocActivationHeight{std::numeric_limits<int>::max()};
+    CDeterministicMNCPtr dmnPayee;
+};
+
 /// TODO: all 4 functions do not belong here really, they should be refactored/moved somewhere (main.cpp ?)
 bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string& strErrorRet);
 bool IsBlockPayeeValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward);
 void FillBlockPayments(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet, std::vector<CTxOut>& voutSuperblockPaymentsRet);
+/** Same as above, with a payee determined in advance by CMasternodePayments::GetBlockPayee */
+void FillBlockPayments(CMutableTransaction& txNew, const CBlockPayee& payee, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet, std::vector<CTxOut>& voutSuperblockPaymentsRet);
 
 extern CMasternodePayments mnpayments;
 
@@ -30,10 +41,17 @@ extern CMasternodePayments mnpayments;
 class CMasternodePayments
 {
 public:
+    /// Payees are cached per previous block, as every template, block check and payments RPC asks for them
+    static bool GetBlockPayee(int nBlockHeight, CBlockPayee& payeeRet);
+    static bool GetBlockPayee(const CBlockIndex* pindexPrev, CBlockPayee& payeeRet);
+    /// Cached CDeterministicMNList::GetProjectedMNPayees of the list at pindex
+    static std::vector<CDeterministicMNCPtr> GetProjectedPayees(const CBlockIndex* pindex, int nCount);
     static bool GetBlockTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet);
+    static bool GetBlockTxOuts(const CBlockPayee& payee, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet);
     static bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward);
 
     static bool GetMasternodeTxOuts(int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet);
+    static bool GetMasternodeTxOuts(const CBlockPayee& payee, CAmount blockReward, std::vector<CTxOut>& voutMasternodePaymentsRet);
 };
 
 #endif // BITCOIN_MASTERNODE_MASTERNODE_PAYMENTS_H
@@ -24,6 +24,10 @@ void CMasternodeSync::Reset(bool fForce, bool fNotifyReset)
         nTimeLastBumped = GetTime();
         nTimeLastUpdateBlockTip = 0;
         fReachedBestHeader = false;
+        {
+            LOCK(cs);
+            setPendingGovObjSync.clear();
+        }
         if (fNotifyReset) {
             uiInterface.NotifyAdditionalDataSyncProgressChanged(-1);
         }
@@ -84,7 +88,7 @@ std::string CMasternodeSync::GetSyncStatus() const
     }
 }
 
-void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) const
+void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv)
 {
     if (strCommand == NetMsgType::SYNCSTATUSCOUNT) { //Sync status count
 
@@ -96,6 +100,11 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand
         vRecv >> nItemID >> nCount;
 
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->GetId());
+
+        if (nItemID == MASTERNODE_SYNC_GOVOBJ) {
+            LOCK(cs);
+            setPendingGovObjSync.erase(pfrom->GetId());
+        }
     }
 }
 
@@ -107,6 +116,9 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
     const static int64_t nSyncStart = GetTimeMillis();
     const static std::string strAllow = strprintf("allow-sync-%lld", nSyncStart);
 
+    // In pipelined mode we don't wait for timeouts once the peers answered and request from all peers at once
+    const bool fPipelined = gArgs.GetBoolArg("-mnsyncpipelined", DEFAULT_MNSYNC_PIPELINED);
+
     // reset the sync process if the last call to this function was more than 60 minutes ago (client was in sleep mode)
     static int64_t nTimeLastProcess = GetTime();
     if(GetTime() - nTimeLastProcess > 60*60 && !fMasternodeMode) {
@@ -116,7 +128,8 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
         return;
     }
 
-    if(GetTime() - nTimeLastProcess < MASTERNODE_SYNC_TICK_SECONDS) {
+    int64_t nTickSeconds = (fPipelined && !IsSynced()) ? MASTERNODE_SYNC_PIPELINED_TICK_SECONDS : MASTERNODE_SYNC_TICK_SECONDS;
+    if(GetTime() - nTimeLastProcess < nTickSeconds) {
         // too early, nothing to do here
         return;
     }
@@ -137,6 +150,7 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
     uiInterface.NotifyAdditionalDataSyncProgressChanged(nSyncProgress);
 
     std::vector<CNode*> vNodesCopy = connman.CopyNodeVector(CConnman::FullyConnectedOnly);
+    bool fAllObjectsAsked = false;
 
     for (auto& pnode : vNodesCopy)
     {
@@ -189,7 +203,9 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
             if (nCurrentAsset == MASTERNODE_SYNC_BLOCKCHAIN) {
                 int64_t nTimeSyncTimeout = vNodesCopy.size() > 3 ? MASTERNODE_SYNC_TICK_SECONDS : MASTERNODE_SYNC_TIMEOUT_SECONDS;
-                if (fReachedBestHeader && (GetTime() - nTimeLastBumped > nTimeSyncTimeout)) {
+                // In pipelined mode governance sync starts right when the best header is reached, if it turns out
+                // that we aren't at the tip yet, UpdatedBlockTip resets the sync.
+                if (fReachedBestHeader && (fPipelined || GetTime() - nTimeLastBumped > nTimeSyncTimeout)) {
                     // At this point we know that:
                     // a) there are peers (because we are looping on at least one of them);
                     // b) we waited for at least MASTERNODE_SYNC_TICK_SECONDS/MASTERNODE_SYNC_TIMEOUT_SECONDS
@@ -241,6 +257,13 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 // only request obj sync once from each peer, then request votes on per-obj basis
                 if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
                     int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman);
+                    if (fPipelined) {
+                        // -2 means there are no objects at all
+                        if (nObjsLeftToAsk == 0 || nObjsLeftToAsk == -2) {
+                            fAllObjectsAsked = true;
+                        }
+                        continue;
+                    }
                     static int64_t nTimeNoObjectsLeft = 0;
                     // check for data
                     if(nObjsLeftToAsk == 0) {
@@ -278,15 +301,47 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
                 SendGovernanceSyncRequest(pnode, connman);
 
+                if (fPipelined) {
+                    LOCK(cs);
+                    setPendingGovObjSync.insert(pnode->GetId());
+                    continue;
+                }
+
                 connman.ReleaseNodeVector(vNodesCopy);
                 return; //this will cause each peer to get one request each six seconds for the various assets we need
             }
         }
     }
+
+    if (fPipelined && nCurrentAsset == MASTERNODE_SYNC_GOVERNANCE && fAllObjectsAsked && IsGovernanceSyncComplete(vNodesCopy)) {
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nCurrentAsset %d -- all peers answered, nothing to do\n", nTick, nCurrentAsset);
+        SwitchToNextAsset(connman);
+    }
+
     // looped through all nodes, release them
     connman.ReleaseNodeVector(vNodesCopy);
 }
 
+bool CMasternodeSync::IsGovernanceSyncComplete(const std::vector<CNode*>& vNodesCopy)
+{
+    if (nTriedPeerCount == 0) return false;
+
+    // Inventory is sent after the SYNCSTATUSCOUNT which concludes a request, so make sure nothing
+    // arrived for a moment before trusting that there is nothing left to download
+    if (GetTime() - nTimeLastBumped < MASTERNODE_SYNC_TICK_SECONDS) return false;
+
+    {
+        LOCK(cs);
+        for (const auto& pnode : vNodesCopy) {
+            if (setPendingGovObjSync.count(pnode->GetId())) {
+                return false;
+            }
+        }
+    }
+
+    return !governance.HasPendingDownloads(vNodesCopy);
+}
+
 void CMasternodeSync::SendGovernanceSyncRequest(CNode* pnode, CConnman& connman)
 {
     CNetMsgMaker msgMaker(pnode->GetSendVersion());
@@ -6,6 +6,9 @@
 
 #include <chain.h>
 #include <net.h>
+#include <sync.h>
+
+#include <set>
 
 class CMasternodeSync;
 
@@ -18,6 +21,9 @@ static const int MASTERNODE_SYNC_FINISHED        = 999;
 static const int MASTERNODE_SYNC_TICK_SECONDS    = 6;
 static const int MASTERNODE_SYNC_TIMEOUT_SECONDS = 30; // our blocks are 2.5 minutes so 30 seconds should be fine
 static const int MASTERNODE_SYNC_RESET_SECONDS = 600; // Reset fReachedBestHeader in CMasternodeSync::Reset if UpdateBlockTip hasn't been called for this seconds
+static const int MASTERNODE_SYNC_PIPELINED_TICK_SECONDS = 1;
+
+static const bool DEFAULT_MNSYNC_PIPELINED = false;
 
 extern CMasternodeSync masternodeSync;
 
@@ -43,6 +49,13 @@ private:
     /// Last time UpdateBlockTip has been called
     int64_t nTimeLastUpdateBlockTip{0};
 
+    CCriticalSection cs;
+    /// Peers we've requested the governance object list from which didn't answer yet (pipelined mode only)
+    std::set<NodeId> setPendingGovObjSync;
+
+    /// Whether all peers answered the governance requests we've sent them
+    bool IsGovernanceSyncComplete(const std::vector<CNode*>& vNodesCopy);
+
 public:
     CMasternodeSync() { Reset(true, false); }
 
@@ -61,7 +74,7 @@ public:
     void Reset(bool fForce = false, bool fNotifyReset = true);
     void SwitchToNextAsset(CConnman& connman);
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) const;
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv);
     void ProcessTick(CConnman& connman);
 
     void AcceptedBlockHeader(const CBlockIndex *pindexNew);
@@ -6,9 +6,12 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <prevector.h>
+#include <support/allocators/pool.h>
 
 #include <stdlib.h>
 
+#include <list>
 #include <map>
 #include <memory>
 #include <set>
@@ -72,6 +75,15 @@ private:
     X x;
 };
 
+template<typename X>
+struct stl_list_node
+{
+private:
+    void* next;
+    void* prev;
+    X x;
+};
+
 struct stl_shared_counter
 {
     /* Various platforms use different sized counters here.
@@ -93,6 +105,12 @@ static inline size_t DynamicUsage(const prevector<N, X, S, D>& v)
     return MallocUsage(v.allocated_memory());
 }
 
+template<typename X, typename Y>
+static inline size_t DynamicUsage(const std::list<X, Y>& l)
+{
+    return MallocUsage(sizeof(stl_list_node<X>)) * l.size();
+}
+
 template<typename X, typename Y>
 static inline size_t DynamicUsage(const std::set<X, Y>& s)
 {
@@ -165,6 +183,17 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template <class Key, class T, class Hash, class Pred, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<Key, T, Hash, Pred, PoolAllocator<std::pair<const Key, T>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>>& m)
+{
+    // Nodes live in the chunks of the pool, which are only released when the pool is destroyed, so count the chunks
+    // instead of the nodes. The bucket array is too large for the pool and is allocated separately.
+    auto* pool_resource = m.get_allocator().resource();
+    return pool_resource->NumAllocatedChunks() * MallocUsage(pool_resource->ChunkSizeBytes()) +
+           MallocUsage(pool_resource->ChunksVectorBytes()) +
+           MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
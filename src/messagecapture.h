@@ -0,0 +1,129 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MESSAGECAPTURE_H
+#define BITCOIN_MESSAGECAPTURE_H
+
+#include <clientversion.h>
+#include <serialize.h>
+#include <streams.h>
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** "dcap", the first bytes of every message capture file */
+static const uint32_t MESSAGE_CAPTURE_MAGIC = 0x70616364;
+static const uint32_t MESSAGE_CAPTURE_VERSION = 1;
+
+/** Written once at the beginning of a message capture file, which holds the messages received from one peer */
+struct CMessageCaptureHeader
+{
+    uint32_t nMagic{MESSAGE_CAPTURE_MAGIC};
+    uint32_t nVersion{MESSAGE_CAPTURE_VERSION};
+    std::string strPeerAddr;
+    bool fInbound{false};
+    // time the first captured message was received, the messages store their time relative to the previous one
+    int64_t nTimeStartMicros{0};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nMagic);
+        READWRITE(nVersion);
+        READWRITE(strPeerAddr);
+        READWRITE(fInbound);
+        READWRITE(nTimeStartMicros);
+    }
+};
+
+/**
+ * A received message as stored in a capture file. The message header isn't stored, it is rebuilt with the message
+ * start of the network the messages are replayed on.
+ */
+struct CCapturedMessage
+{
+    // microseconds since the previous message of the same peer (or since nTimeStartMicros)
+    uint64_t nTimeDeltaMicros{0};
+    std::string strCommand;
+    std::vector<unsigned char> vPayload;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(VARINT(nTimeDeltaMicros));
+        READWRITE(LIMITED_STRING(strCommand, 12));
+        READWRITE(vPayload);
+    }
+};
+
+/** Appends the messages received from one peer to a capture file */
+class CMessageCaptureWriter
+{
+private:
+    CAutoFile file;
+    int64_t nLastTimeMicros;
+
+public:
+    CMessageCaptureWriter(FILE* fileIn, const CMessageCaptureHeader& header) :
+        file(fileIn, SER_DISK, CLIENT_VERSION),
+        nLastTimeMicros(header.nTimeStartMicros)
+    {
+        file << header;
+    }
+
+    /** Throws std::ios_base::failure if the file can't be written */
+    void Write(int64_t nTimeMicros, const std::string& strCommand, const char* pchPayload, size_t nPayloadSize)
+    {
+        CCapturedMessage msg;
+        msg.nTimeDeltaMicros = nTimeMicros > nLastTimeMicros ? nTimeMicros - nLastTimeMicros : 0;
+        msg.strCommand = strCommand;
+        msg.vPayload.assign(pchPayload, pchPayload + nPayloadSize);
+        file << msg;
+        nLastTimeMicros += msg.nTimeDeltaMicros;
+    }
+};
+
+/** Reads a capture file written by CMessageCaptureWriter */
+class CMessageCaptureReader
+{
+private:
+    CAutoFile file;
+    CMessageCaptureHeader header;
+    int64_t nTimeMicros;
+
+public:
+    /** Throws std::ios_base::failure if the header can't be read and std::runtime_error if it is not a capture file */
+    explicit CMessageCaptureReader(FILE* fileIn) :
+        file(fileIn, SER_DISK, CLIENT_VERSION)
+    {
+        file >> header;
+        if (header.nMagic != MESSAGE_CAPTURE_MAGIC || header.nVersion != MESSAGE_CAPTURE_VERSION) {
+            throw std::runtime_error("not a message capture file");
+        }
+        nTimeMicros = header.nTimeStartMicros;
+    }
+
+    const CMessageCaptureHeader& GetHeader() const { return header; }
+
+    /** Read the next message and its receive time. Returns false at the end of the file or at a truncated message. */
+    bool Read(CCapturedMessage& msgRet, int64_t& nTimeMicrosRet)
+    {
+        try {
+            file >> msgRet;
+        } catch (const std::exception&) {
+            return false;
+        }
+        nTimeMicros += msgRet.nTimeDeltaMicros;
+        nTimeMicrosRet = nTimeMicros;
+        return true;
+    }
+};
+
+#endif // BITCOIN_MESSAGECAPTURE_H
@@ -7,6 +7,7 @@
 #include <miner.h>
 
 #include <amount.h>
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <coins.h>
@@ -20,6 +21,7 @@
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/transaction.h>
+#include <streams.h>
 #include <script/standard.h>
 #include <timedata.h>
 #include <util.h>
@@ -30,6 +32,7 @@
 
 #include <evo/specialtx.h>
 #include <evo/cbtx.h>
+#include <evo/providertx.h>
 #include <evo/simplifiedmns.h>
 #include <evo/deterministicmns.h>
 
@@ -37,7 +40,10 @@
 #include <llmq/quorums_chainlocks.h>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <queue>
+#include <thread>
 #include <utility>
 
 // Unconfirmed transactions in the memory pool often depend on other
@@ -48,6 +54,134 @@
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 
+namespace {
+/**
+ * Transactions selected for the previous block template. getblocktemplate is called over and over while the tip
+ * stays the same and the mempool mostly grows, so the next template can start from this selection instead of
+ * evaluating every package of the mempool again.
+ *
+ * This is only done if no package was left out for size or sigop limits. In that case the selection contains every
+ * package which was eligible, and as long as all of these transactions are still in the mempool with the same
+ * modified fees, selecting from scratch would choose them again. New packages are then added on top.
+ */
+struct CachedTxSelection {
+    uint256 hashPrevBlock;
+    int nHeight{0};
+    int64_t nLockTimeCutoff{0};
+    unsigned int nBlockMaxSize{0};
+    CFeeRate blockMinFeeRate;
+    std::vector<uint256> vQuorumCommitments;
+    //! Selected transactions in block order together with their modified fees
+    std::vector<std::pair<uint256, CAmount>> vTxs;
+};
+std::unique_ptr<CachedTxSelection> cachedTxSelection GUARDED_BY(cs_main);
+
+/**
+ * Merkle roots of the coinbase payload of the previous block template. Building the masternode list of the new
+ * block and hashing its simplified version are the expensive parts of a template, but the roots only depend on the
+ * tip and on few transactions of the block, see CalcCbTxRelevantTxsHash().
+ */
+struct CachedCbTxMerkleRoots {
+    uint256 hashPrevBlock;
+    int nHeight{0};
+    uint256 hashRelevantTxs;
+    uint256 merkleRootMNList;
+    uint256 merkleRootQuorums;
+};
+std::unique_ptr<CachedCbTxMerkleRoots> cachedCbTxMerkleRoots GUARDED_BY(cs_main);
+
+/** Parts of a block template which only depend on the previous block, see PrepareBlockTemplateComponents() */
+struct BlockTemplateComponents {
+    uint256 hashPrevBlock;
+    CBlockPayee payee;
+    //! Quorums a (possibly null) commitment has to be mined for. The commitment itself is picked when the template
+    //! is created, as better ones might come in at any time.
+    std::vector<std::pair<Consensus::LLMQType, uint256>> vRequiredCommitments;
+};
+CWaitableCriticalSection cs_template_components;
+std::condition_variable cv_template_components;
+std::shared_ptr<const BlockTemplateComponents> templateComponents GUARDED_BY(cs_template_components);
+//! Components are only prepared in advance on nodes which create block templates
+std::atomic<bool> fTemplateComponentsUsed{false};
+
+std::shared_ptr<const BlockTemplateComponents> CalcBlockTemplateComponents(const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+
+    auto components = std::make_shared<BlockTemplateComponents>();
+    components->hashPrevBlock = pindexPrev->GetBlockHash();
+
+    const int nHeight = pindexPrev->nHeight + 1;
+    CMasternodePayments::GetBlockPayee(nHeight, components->payee);
+
+    if (nHeight >= Params().GetConsensus().DIP0003Height) {
+        for (const Consensus::LLMQType& type : llmq::CLLMQUtils::GetEnabledQuorumTypes(pindexPrev)) {
+            uint256 quorumHash;
+            if (llmq::quorumBlockProcessor->GetRequiredCommitmentQuorum(type, nHeight, quorumHash)) {
+                components->vRequiredCommitments.emplace_back(type, quorumHash);
+            }
+        }
+    }
+    return components;
+}
+
+/** Get the components for a block on top of the current tip pindexPrev, calculating them if not prepared yet */
+std::shared_ptr<const BlockTemplateComponents> GetBlockTemplateComponents(const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    fTemplateComponentsUsed = true;
+
+    {
+        WaitableLock lock(cs_template_components);
+        if (templateComponents && templateComponents->hashPrevBlock == pindexPrev->GetBlockHash()) {
+            return templateComponents;
+        }
+    }
+
+    auto components = CalcBlockTemplateComponents(pindexPrev);
+    {
+        WaitableLock lock(cs_template_components);
+        templateComponents = components;
+    }
+    cv_template_components.notify_all();
+    return components;
+}
+
+/**
+ * Hash the transactions of a block which the masternode list and quorum merkle roots of its coinbase depend on:
+ * special transactions and transactions spending masternode collaterals. Collaterals of masternodes registered in
+ * the same block are covered by also hashing all transactions spending outputs of special transactions or external
+ * collaterals of ProRegTxs.
+ */
+uint256 CalcCbTxRelevantTxsHash(const CBlock& block, const CDeterministicMNList& mnList)
+{
+    std::set<uint256> setSpecialTxs;
+    std::set<COutPoint> setNewCollaterals;
+    CHashWriter hw(SER_GETHASH, 0);
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        bool fRelevant = tx.nVersion == 3 && tx.nType != TRANSACTION_NORMAL;
+        for (size_t j = 0; !fRelevant && j < tx.vin.size(); j++) {
+            const COutPoint& prevout = tx.vin[j].prevout;
+            fRelevant = setSpecialTxs.count(prevout.hash) || setNewCollaterals.count(prevout) ||
+                        mnList.GetMNByCollateral(prevout) != nullptr;
+        }
+        if (!fRelevant) {
+            continue;
+        }
+        if (tx.nVersion == 3 && tx.nType != TRANSACTION_NORMAL) {
+            setSpecialTxs.emplace(tx.GetHash());
+            CProRegTx proTx;
+            if (tx.nType == TRANSACTION_PROVIDER_REGISTER && GetTxPayload(tx, proTx)) {
+                setNewCollaterals.emplace(proTx.collateralOutpoint);
+            }
+        }
+        hw << tx.GetHash();
+    }
+    return hw.GetHash();
+}
+} // namespace
+
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
 {
     int64_t nOldTime = pblock->nTime;
@@ -105,6 +239,62 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    fLimitReached = false;
+}
+
+bool BlockAssembler::addCachedTxs(const CBlockIndex* pindexPrev, const std::vector<uint256>& vQuorumCommitments)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    if (!cachedTxSelection || cachedTxSelection->hashPrevBlock != pindexPrev->GetBlockHash() ||
+        cachedTxSelection->nHeight != nHeight || cachedTxSelection->nLockTimeCutoff != nLockTimeCutoff ||
+        cachedTxSelection->nBlockMaxSize != nBlockMaxSize || cachedTxSelection->blockMinFeeRate != blockMinFeeRate ||
+        cachedTxSelection->vQuorumCommitments != vQuorumCommitments) {
+        return false;
+    }
+
+    std::vector<CTxMemPool::txiter> vEntries;
+    vEntries.reserve(cachedTxSelection->vTxs.size());
+    for (const auto& p : cachedTxSelection->vTxs) {
+        auto it = mempool.mapTx.find(p.first);
+        if (it == mempool.mapTx.end() || it->GetModifiedFee() != p.second) {
+            // removed or prioritised since
+            return false;
+        }
+        vEntries.emplace_back(it);
+    }
+    for (const auto& it : vEntries) {
+        AddToBlock(it);
+    }
+    return TestPackage(0, 0);
+}
+
+void BlockAssembler::updateTxCache(const CBlockIndex* pindexPrev, const std::vector<uint256>& vQuorumCommitments, size_t nFirstSelectedTx)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    if (fLimitReached) {
+        cachedTxSelection.reset();
+        return;
+    }
+
+    auto cache = MakeUnique<CachedTxSelection>();
+    cache->hashPrevBlock = pindexPrev->GetBlockHash();
+    cache->nHeight = nHeight;
+    cache->nLockTimeCutoff = nLockTimeCutoff;
+    cache->nBlockMaxSize = nBlockMaxSize;
+    cache->blockMinFeeRate = blockMinFeeRate;
+    cache->vQuorumCommitments = vQuorumCommitments;
+    cache->vTxs.reserve(pblock->vtx.size() - nFirstSelectedTx);
+    for (size_t i = nFirstSelectedTx; i < pblock->vtx.size(); i++) {
+        auto it = mempool.mapTx.find(pblock->vtx[i]->GetHash());
+        assert(it != mempool.mapTx.end());
+        cache->vTxs.emplace_back(it->GetTx().GetHash(), it->GetModifiedFee());
+    }
+    cachedTxSelection = std::move(cache);
 }
 
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
@@ -146,22 +336,48 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
                        ? nMedianTimePast
                        : pblock->GetBlockTime();
 
-    if (fDIP0003Active_context) {
-        for (const Consensus::LLMQType& type : llmq::CLLMQUtils::GetEnabledQuorumTypes(pindexPrev)) {
-            CTransactionRef qcTx;
-            if (llmq::quorumBlockProcessor->GetMinableCommitmentTx(type, nHeight, qcTx)) {
-                pblock->vtx.emplace_back(qcTx);
-                pblocktemplate->vTxFees.emplace_back(0);
-                pblocktemplate->vTxSigOps.emplace_back(0);
-                nBlockSize += qcTx->GetTotalSize();
-                ++nBlockTx;
-            }
-        }
+    const auto components = GetBlockTemplateComponents(pindexPrev);
+
+    std::vector<uint256> vQuorumCommitments;
+    for (const auto& p : components->vRequiredCommitments) {
+        CTransactionRef qcTx = llmq::quorumBlockProcessor->GetMinableCommitmentTx(p.first, nHeight, p.second);
+        pblock->vtx.emplace_back(qcTx);
+        pblocktemplate->vTxFees.emplace_back(0);
+        pblocktemplate->vTxSigOps.emplace_back(0);
+        nBlockSize += qcTx->GetTotalSize();
+        ++nBlockTx;
+        vQuorumCommitments.emplace_back(qcTx->GetHash());
     }
 
+    // Remember where the mempool transactions start, to be able to restart the selection from scratch
+    const size_t nFirstSelectedTx = pblock->vtx.size();
+    const uint64_t nBlockSizeBase = nBlockSize;
+    const uint64_t nBlockTxBase = nBlockTx;
+    auto restartSelection = [&]() {
+        pblock->vtx.resize(nFirstSelectedTx);
+        pblocktemplate->vTxFees.resize(nFirstSelectedTx);
+        pblocktemplate->vTxSigOps.resize(nFirstSelectedTx);
+        resetBlock();
+        nBlockSize = nBlockSizeBase;
+        nBlockTx = nBlockTxBase;
+    };
+
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
+    bool fCachedTxs = addCachedTxs(pindexPrev, vQuorumCommitments);
+    if (!fCachedTxs) {
+        restartSelection();
+    }
+    int nCachedTxs = (int)(pblock->vtx.size() - nFirstSelectedTx);
     addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    if (fCachedTxs && fLimitReached) {
+        // The block got full, packages which were selected before might not make it in anymore
+        restartSelection();
+        nPackagesSelected = 0;
+        nDescendantsUpdated = 0;
+        nCachedTxs = 0;
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -200,14 +416,32 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
         cbTx.nHeight = nHeight;
 
-        CValidationState state;
-        if (!CalcCbTxMerkleRootMNList(*pblock, pindexPrev, cbTx.merkleRootMNList, state, *pcoinsTip.get())) {
-            throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootMNList failed: %s", __func__, FormatStateMessage(state)));
-        }
-        if (fDIP0008Active_context) {
-            if (!CalcCbTxMerkleRootQuorums(*pblock, pindexPrev, cbTx.merkleRootQuorums, state)) {
-                throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootQuorums failed: %s", __func__, FormatStateMessage(state)));
+        const uint256 hashRelevantTxs = CalcCbTxRelevantTxsHash(*pblock, deterministicMNManager->GetListForBlock(pindexPrev));
+        if (cachedCbTxMerkleRoots && cachedCbTxMerkleRoots->hashPrevBlock == pindexPrev->GetBlockHash() &&
+            cachedCbTxMerkleRoots->nHeight == nHeight &&
+            cachedCbTxMerkleRoots->hashRelevantTxs == hashRelevantTxs) {
+            cbTx.merkleRootMNList = cachedCbTxMerkleRoots->merkleRootMNList;
+            if (fDIP0008Active_context) {
+                cbTx.merkleRootQuorums = cachedCbTxMerkleRoots->merkleRootQuorums;
+            }
+        } else {
+            CValidationState state;
+            if (!CalcCbTxMerkleRootMNList(*pblock, pindexPrev, cbTx.merkleRootMNList, state, *pcoinsTip.get())) {
+                throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootMNList failed: %s", __func__, FormatStateMessage(state)));
+            }
+            if (fDIP0008Active_context) {
+                if (!CalcCbTxMerkleRootQuorums(*pblock, pindexPrev, cbTx.merkleRootQuorums, state)) {
+                    throw std::runtime_error(strprintf("%s: CalcCbTxMerkleRootQuorums failed: %s", __func__, FormatStateMessage(state)));
+                }
             }
+
+            auto roots = MakeUnique<CachedCbTxMerkleRoots>();
+            roots->hashPrevBlock = pindexPrev->GetBlockHash();
+            roots->nHeight = nHeight;
+            roots->hashRelevantTxs = hashRelevantTxs;
+            roots->merkleRootMNList = cbTx.merkleRootMNList;
+            roots->merkleRootQuorums = cbTx.merkleRootQuorums;
+            cachedCbTxMerkleRoots = std::move(roots);
         }
 
         SetTxPayload(coinbaseTx, cbTx);
@@ -215,7 +449,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     // Update coinbase transaction with additional info about masternode and governance payments,
     // get some info back to pass to getblocktemplate
-    FillBlockPayments(coinbaseTx, nHeight, blockReward, pblocktemplate->voutMasternodePayments, pblocktemplate->voutSuperblockPayments);
+    FillBlockPayments(coinbaseTx, components->payee, blockReward, pblocktemplate->voutMasternodePayments, pblocktemplate->voutSuperblockPayments);
 
     pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
     pblocktemplate->vTxFees[0] = -nFees;
@@ -230,11 +464,14 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     CValidationState state;
     if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        cachedTxSelection.reset();
+        cachedCbTxMerkleRoots.reset();
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
+    updateTxCache(pindexPrev, vQuorumCommitments, nFirstSelectedTx);
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCHMARK, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCHMARK, "CreateNewBlock() packages: %.2fms (%d cached txs, %d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nCachedTxs, nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
@@ -433,6 +670,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOps)) {
+            fLimitReached = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -487,6 +725,112 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+void PrepareBlockTemplateComponents(const CBlockIndex* pindexNew)
+{
+    if (!fTemplateComponentsUsed) {
+        return;
+    }
+
+    std::shared_ptr<const BlockTemplateComponents> components;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip() != pindexNew) {
+            // Outdated already, the next call will handle the new tip
+            return;
+        }
+        components = CalcBlockTemplateComponents(pindexNew);
+    }
+    {
+        WaitableLock lock(cs_template_components);
+        templateComponents = components;
+    }
+    cv_template_components.notify_all();
+}
+
+bool WaitForBlockTemplateComponents(const uint256& hashPrevBlock, std::chrono::milliseconds timeout)
+{
+    if (!fTemplateComponentsUsed) {
+        return false;
+    }
+    WaitableLock lock(cs_template_components);
+    return cv_template_components.wait_for(lock, timeout, [&hashPrevBlock]() EXCLUSIVE_LOCKS_REQUIRED(cs_template_components) {
+        return templateComponents && templateComponents->hashPrevBlock == hashPrevBlock;
+    });
+}
+
+/** Below this many expected hashes per solution (e.g. on regtest) starting threads costs more than it gains */
+static constexpr uint64_t MIN_EXPECTED_HASHES_FOR_PARALLEL_SOLVING = 1 << 14;
+/** Number of nonces a thread takes at once in the parallel search */
+static constexpr uint32_t SOLVE_NONCES_PER_CHUNK = 1 << 12;
+
+bool SolveBlockHeader(CBlockHeader& header, const Consensus::Params& consensusParams, uint32_t nMaxNonce, uint64_t& nMaxTries, int nThreads)
+{
+    const uint32_t nStartNonce = header.nNonce;
+    if (nStartNonce >= nMaxNonce || nMaxTries == 0) {
+        return false;
+    }
+    // The last nonce which may be tried plus one
+    const uint32_t nEndNonce = (uint32_t)std::min<uint64_t>(nMaxNonce, (uint64_t)nStartNonce + nMaxTries);
+
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(header.nBits);
+    // The expected number of hashes is 2^256 / (target + 1), compare it with the threshold without overflowing
+    const bool fParallel = bnTarget < (~arith_uint256() / MIN_EXPECTED_HASHES_FOR_PARALLEL_SOLVING) &&
+                           nEndNonce - nStartNonce > SOLVE_NONCES_PER_CHUNK;
+    if (nThreads <= 0) {
+        nThreads = GetNumCores();
+    }
+
+    if (!fParallel || nThreads <= 1) {
+        while (header.nNonce < nEndNonce && !CheckProofOfWork(header.GetHash(), header.nBits, consensusParams)) {
+            ++header.nNonce;
+        }
+        nMaxTries -= header.nNonce - nStartNonce;
+        return header.nNonce < nEndNonce;
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << header;
+    assert(ss.size() == 80);
+    const std::vector<unsigned char> vHeader(ss.begin(), ss.end());
+
+    // Chunks of nonces are handed out in ascending order. Threads stop taking chunks which start above the lowest
+    // solution found so far, so the lowest solution overall is found just like by a sequential search.
+    std::atomic<uint64_t> nNextNonce{nStartNonce};
+    std::atomic<uint64_t> nBestNonce{nEndNonce};
+    auto worker = [&]() {
+        std::vector<unsigned char> vData(vHeader);
+        while (true) {
+            const uint64_t nChunkStart = nNextNonce.fetch_add(SOLVE_NONCES_PER_CHUNK);
+            if (nChunkStart >= nBestNonce) {
+                return;
+            }
+            const uint64_t nChunkEnd = std::min<uint64_t>(nChunkStart + SOLVE_NONCES_PER_CHUNK, nEndNonce);
+            for (uint64_t nNonce = nChunkStart; nNonce < nChunkEnd && nNonce < nBestNonce; nNonce++) {
+                WriteLE32(&vData[76], (uint32_t)nNonce);
+                if (CheckProofOfWork(HashX11(vData.begin(), vData.end()), header.nBits, consensusParams)) {
+                    uint64_t nBest = nBestNonce;
+                    while (nNonce < nBest && !nBestNonce.compare_exchange_weak(nBest, nNonce)) {}
+                    break;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    header.nNonce = (uint32_t)nBestNonce;
+    nMaxTries -= header.nNonce - nStartNonce;
+    return header.nNonce < nEndNonce;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -11,6 +11,7 @@
 #include <validation.h>
 
 #include <stdint.h>
+#include <chrono>
 #include <memory>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -142,6 +143,8 @@ private:
     unsigned int nBlockSigOps;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    // Whether a package was left out because it didn't fit anymore
+    bool fLimitReached;
 
     // Chain context for the block
     int nHeight;
@@ -167,6 +170,11 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Add the transactions selected by the previous template again, if that selection is still valid for the
+      * current tip and mempool. Returns false if the selection has to be done from scratch. */
+    bool addCachedTxs(const CBlockIndex* pindexPrev, const std::vector<uint256>& vQuorumCommitments) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+    /** Remember the selection of this block for the next template */
+    void updateTxCache(const CBlockIndex* pindexPrev, const std::vector<uint256>& vQuorumCommitments, size_t nFirstSelectedTx) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -195,6 +203,24 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
+/**
+ * Determine the parts of the template for the block following pindexNew which only depend on pindexNew: the
+ * masternode payee and the quorums a commitment has to be mined for. Called on the validation interface thread for
+ * every new tip once CreateNewBlock was used, so that a template for the new tip doesn't have to wait for these.
+ */
+void PrepareBlockTemplateComponents(const CBlockIndex* pindexNew);
+/** Wait for PrepareBlockTemplateComponents to finish for the new tip hashPrevBlock, at most for timeout. */
+bool WaitForBlockTemplateComponents(const uint256& hashPrevBlock, std::chrono::milliseconds timeout);
+
+/**
+ * Search for a nonce which makes the header satisfy its nBits, trying the nonces from header.nNonce up to (but not
+ * including) nMaxNonce and at most nMaxTries of them. nMaxTries is decreased by the number of unsuccessful tries.
+ * When enough work is expected, the nonces are searched by nThreads threads (0 = number of cores). The result is the
+ * same as when searching one nonce after the other: the lowest solving nonce is returned in header.nNonce, otherwise
+ * header.nNonce is where the search stopped.
+ */
+bool SolveBlockHeader(CBlockHeader& header, const Consensus::Params& consensusParams, uint32_t nMaxNonce, uint64_t& nMaxTries, int nThreads = 0);
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
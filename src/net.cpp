@@ -34,6 +34,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_POLL
@@ -117,6 +118,7 @@ static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // S
 //
 bool fDiscover = true;
 bool fListen = true;
+bool fCaptureMessages = false;
 bool fRelayTxes = true;
 CCriticalSection cs_mapLocalHost;
 std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalHost);
@@ -415,7 +417,7 @@ static CAddress GetBindAddress(SOCKET sock)
     return addr_bind;
 }
 
-CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure, bool manual_connection)
+CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure, bool manual_connection, std::unique_ptr<PendingProxyConnection>* pendingRet)
 {
     if (pszDest == nullptr) {
         bool fAllowLocal = Params().AllowMultiplePorts() && addrConnect.GetPort() != GetListenPort();
@@ -467,6 +469,37 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
         }
     }
 
+    if (pendingRet) {
+        std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+        if (lPendingProxyConnections.size() >= (size_t)MAX_PENDING_PROXY_CONNECTIONS) {
+            // connect in this thread instead
+            pendingRet = nullptr;
+        }
+    }
+
+    // Start connecting to the proxy, the connection is finished by ThreadPendingProxyConnections
+    auto startPending = [&](const proxyType& proxy, const std::string& strProxyDest, int nProxyPort) {
+        std::unique_ptr<PendingProxyConnection> pending(new PendingProxyConnection());
+        pending->hSocket = CreateSocket(proxy.proxy);
+        if (pending->hSocket == INVALID_SOCKET) {
+            return;
+        }
+        SocketConnectStatus status = StartConnectSocket(proxy.proxy, pending->hSocket, true);
+        if (status == SocketConnectStatus::FAILED) {
+            return;
+        }
+        pending->addrConnect = addrConnect;
+        pending->strDest = pszDest ? pszDest : "";
+        pending->proxy = proxy;
+        pending->strProxyDest = strProxyDest;
+        pending->nProxyPort = nProxyPort;
+        pending->fCountFailure = fCountFailure;
+        pending->manual_connection = manual_connection;
+        // no deadline means that the connection to the proxy is established already
+        pending->nDeadlineMillis = status == SocketConnectStatus::CONNECTED ? 0 : GetTimeMillis() + nConnectTimeout;
+        *pendingRet = std::move(pending);
+    };
+
     // Connect
     bool connected = false;
     SOCKET hSocket = INVALID_SOCKET;
@@ -475,6 +508,11 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
         bool proxyConnectionFailed = false;
 
         if (GetProxy(addrConnect.GetNetwork(), proxy)) {
+            if (pendingRet) {
+                // a failure to start connecting to the proxy is not counted as an attempt
+                startPending(proxy, addrConnect.ToStringIP(), addrConnect.GetPort());
+                return nullptr;
+            }
             hSocket = CreateSocket(proxy.proxy);
             if (hSocket == INVALID_SOCKET) {
                 return nullptr;
@@ -494,13 +532,17 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
             addrman.Attempt(addrConnect, fCountFailure);
         }
     } else if (pszDest && GetNameProxy(proxy)) {
+        std::string host;
+        int port = default_port;
+        SplitHostPort(std::string(pszDest), port, host);
+        if (pendingRet) {
+            startPending(proxy, host, port);
+            return nullptr;
+        }
         hSocket = CreateSocket(proxy.proxy);
         if (hSocket == INVALID_SOCKET) {
             return nullptr;
         }
-        std::string host;
-        int port = default_port;
-        SplitHostPort(std::string(pszDest), port, host);
         connected = ConnectThroughProxy(proxy, host, port, hSocket, nConnectTimeout, nullptr);
     }
     if (!connected) {
@@ -508,17 +550,188 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
         return nullptr;
     }
 
-    // Add node
+    return CreateOutboundNode(hSocket, addrConnect, pszDest ? pszDest : "");
+}
+
+CNode* CConnman::CreateOutboundNode(SOCKET hSocket, const CAddress& addrConnect, const std::string& strDest)
+{
     NodeId id = GetNewNodeId();
     uint64_t nonce = GetDeterministicRandomizer(RANDOMIZER_ID_LOCALHOSTNONCE).Write(id).Finalize();
     CAddress addr_bind = GetBindAddress(hSocket);
-    CNode* pnode = new CNode(id, nLocalServices, GetBestHeight(), hSocket, addrConnect, CalculateKeyedNetGroup(addrConnect), nonce, addr_bind, pszDest ? pszDest : "", false);
+    CNode* pnode = new CNode(id, nLocalServices, GetBestHeight(), hSocket, addrConnect, CalculateKeyedNetGroup(addrConnect), nonce, addr_bind, strDest, false);
     pnode->AddRef();
     statsClient.inc("peers.connect", 1.0f);
 
     return pnode;
 }
 
+bool CConnman::ProcessPendingProxyConnection(PendingProxyConnection& pending, bool fReady, int64_t nNowMillis, bool& fConnectedRet)
+{
+    fConnectedRet = false;
+    // If a connection to the node was attempted, and failure (if any) is not caused by a problem connecting to
+    // the proxy, mark this as an attempt.
+    auto finish = [&](bool fAttempted) {
+        if (fAttempted && pending.addrConnect.IsValid()) {
+            addrman.Attempt(pending.addrConnect, pending.fCountFailure);
+        }
+        return false;
+    };
+
+    if (!pending.handshake) {
+        if (pending.nDeadlineMillis != 0) {
+            if (!fReady) {
+                if (nNowMillis >= pending.nDeadlineMillis) {
+                    LogPrint(BCLog::NET, "connection to %s timeout\n", pending.proxy.proxy.ToString());
+                    return finish(false);
+                }
+                return true;
+            }
+            if (!FinishConnectSocket(pending.proxy.proxy, pending.hSocket, true)) {
+                return finish(false);
+            }
+        }
+        LogPrint(BCLog::NET, "SOCKS5 connecting %s\n", pending.strProxyDest);
+        ProxyCredentials random_auth;
+        bool fAuth = GetProxyCredentials(pending.proxy, random_auth);
+        pending.handshake.reset(new Socks5Handshake(pending.strProxyDest, pending.nProxyPort, fAuth ? &random_auth : nullptr));
+        pending.nDeadlineMillis = nNowMillis + SOCKS5_RECV_TIMEOUT;
+    }
+
+    switch (pending.handshake->Advance(pending.hSocket)) {
+    case Socks5Handshake::Status::IN_PROGRESS:
+        if (nNowMillis >= pending.nDeadlineMillis) {
+            // This is very common for Tor, so do not print an error message
+            LogPrint(BCLog::NET, "Socks5() connect to %s:%d failed: timeout\n", pending.strProxyDest, pending.nProxyPort);
+            return finish(true);
+        }
+        return true;
+    case Socks5Handshake::Status::FAILED:
+        LogPrintf("Socks5() connect to %s:%d failed: %s\n", pending.strProxyDest, pending.nProxyPort, pending.handshake->GetError());
+        return finish(true);
+    case Socks5Handshake::Status::SUCCEEDED:
+        break;
+    }
+
+    fConnectedRet = true;
+    return finish(true);
+}
+
+bool CConnman::IsPendingProxyConnection(const CService& addr, bool fIPOnly) const
+{
+    std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+    for (const auto& pending : lPendingProxyConnections) {
+        if (fIPOnly ? static_cast<CNetAddr>(pending->addrConnect) == static_cast<CNetAddr>(addr) : static_cast<CService>(pending->addrConnect) == addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CConnman::IsPendingProxyConnection(const std::string& strDest) const
+{
+    std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+    for (const auto& pending : lPendingProxyConnections) {
+        if (pending->strDest == strDest) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CConnman::ThreadPendingProxyConnections()
+{
+    while (!interruptNet) {
+        std::vector<std::pair<SOCKET, bool>> vSockets;
+        {
+            std::unique_lock<std::mutex> lock(mutexPendingProxyConnections);
+            condPendingProxyConnections.wait(lock, [this] { return !lPendingProxyConnections.empty() || interruptNet; });
+            for (const auto& pending : lPendingProxyConnections) {
+                // wait for writability while connecting to the proxy and while the handshake has data to send
+                vSockets.emplace_back(pending->hSocket, !pending->handshake || pending->handshake->WantsWrite());
+            }
+        }
+        if (interruptNet) {
+            return;
+        }
+
+        // Wait up to 50ms for any socket to become ready, timeouts are checked after each round
+        std::set<SOCKET> setReady;
+#ifdef USE_POLL
+        std::vector<struct pollfd> vPollFds(vSockets.size());
+        for (size_t i = 0; i < vSockets.size(); i++) {
+            vPollFds[i].fd = vSockets[i].first;
+            vPollFds[i].events = vSockets[i].second ? POLLOUT : POLLIN;
+        }
+        if (poll(vPollFds.data(), vPollFds.size(), 50) > 0) {
+            for (const auto& pollfd : vPollFds) {
+                if (pollfd.revents) {
+                    setReady.emplace(pollfd.fd);
+                }
+            }
+        }
+#else
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        SOCKET hSocketMax = 0;
+        for (const auto& p : vSockets) {
+            FD_SET(p.first, p.second ? &fdsetSend : &fdsetRecv);
+            hSocketMax = std::max(hSocketMax, p.first);
+        }
+        struct timeval timeout = MillisToTimeval(50);
+        if (select(hSocketMax + 1, &fdsetRecv, &fdsetSend, nullptr, &timeout) > 0) {
+            for (const auto& p : vSockets) {
+                if (FD_ISSET(p.first, p.second ? &fdsetSend : &fdsetRecv)) {
+                    setReady.emplace(p.first);
+                }
+            }
+        }
+#endif
+
+        // Finished connections are taken out of the list, so that nodes are added without holding the lock
+        std::vector<std::pair<std::unique_ptr<PendingProxyConnection>, bool>> vFinished;
+        {
+            std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+            int64_t nNowMillis = GetTimeMillis();
+            for (auto it = lPendingProxyConnections.begin(); it != lPendingProxyConnections.end(); ) {
+                bool fConnected;
+                if (ProcessPendingProxyConnection(**it, setReady.count((*it)->hSocket) != 0, nNowMillis, fConnected)) {
+                    ++it;
+                    continue;
+                }
+                vFinished.emplace_back(std::move(*it), fConnected);
+                it = lPendingProxyConnections.erase(it);
+            }
+        }
+
+        for (auto& p : vFinished) {
+            auto& pending = *p.first;
+            // the destination may have been connected to by other means in the meantime
+            if (p.second && (pending.strDest.empty() ? FindNode(static_cast<CService>(pending.addrConnect)) : FindNode(pending.strDest))) {
+                LogPrint(BCLog::NET, "Failed to open new connection, already connected\n");
+                continue;
+            }
+            if (!p.second) {
+                LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- connection through proxy failed for %s\n", __func__, fLogIPs ? pending.addrConnect.ToString(false) : std::string("new peer"));
+                if (pending.masternode_connection) {
+                    auto dmn = deterministicMNManager->GetListAtChainTip().GetMNByService(pending.addrConnect);
+                    if (dmn) {
+                        // reset last outbound success
+                        mmetaman.GetMetaInfo(dmn->proTxHash)->SetLastOutboundSuccess(0);
+                    }
+                }
+                continue;
+            }
+            CNode* pnode = CreateOutboundNode(pending.hSocket, pending.addrConnect, pending.strDest);
+            // the socket is owned by the node now
+            pending.hSocket = INVALID_SOCKET;
+            LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- succesfully connected through proxy to %s, sock=%d, peer=%d\n", __func__, fLogIPs ? pending.addrConnect.ToString(false) : std::string("new peer"), pnode->hSocket, pnode->GetId());
+            AddOutboundNode(pnode, &pending.grantOutbound, pending.fOneShot, pending.fFeeler, pending.manual_connection, pending.masternode_connection, pending.masternode_probe_connection);
+        }
+    }
+}
+
 void CConnman::DumpBanlist()
 {
     SweepBanned(); // clean unused entries (if bantime has expired)
@@ -788,6 +1001,8 @@ void CNode::copyStats(CNodeStats &stats)
     {
         LOCK(cs_vSend);
         X(mapSendBytesPerMsgCmd);
+        X(arrSendBytesPerPriority);
+        X(arrSendQueueSize);
         X(nSendBytes);
     }
     {
@@ -795,7 +1010,13 @@ void CNode::copyStats(CNodeStats &stats)
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    {
+        LOCK(cs_vProcessMsg);
+        X(mapProcessStatsPerMsgCmd);
+    }
     X(fWhitelisted);
+    X(nAddrProcessed);
+    X(nAddrRateLimited);
 
     // It is common for nodes with good ping times to suddenly become lagged,
     // due to a new block arriving or other large transfer.
@@ -838,7 +1059,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -874,12 +1095,48 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
 
             msg.nTime = nTimeMicros;
             complete = true;
+
+            if (fCaptureMessages) {
+                CaptureMessage(msg);
+            }
         }
     }
 
     return true;
 }
 
+void CNode::CaptureMessage(const CNetMessage& msg)
+{
+    AssertLockHeld(cs_vRecv);
+    if (fCaptureFailed) {
+        return;
+    }
+    try {
+        if (!captureWriter) {
+            CMessageCaptureHeader header;
+            header.strPeerAddr = addr.ToString();
+            header.fInbound = fInbound;
+            header.nTimeStartMicros = msg.nTime;
+
+            fs::path dir = GetDataDir() / "message_capture";
+            TryCreateDirectories(dir);
+            std::string strFile = strprintf("%d_%s.dat", id, header.strPeerAddr);
+            // keep the file name portable, IPv6 addresses contain colons and brackets
+            std::replace_if(strFile.begin(), strFile.end(), [](char c) { return c == ':' || c == '[' || c == ']'; }, '_');
+            FILE* file = fsbridge::fopen(dir / strFile, "wb");
+            if (!file) {
+                throw std::runtime_error(strprintf("can't open %s", (dir / strFile).string()));
+            }
+            captureWriter.reset(new CMessageCaptureWriter(file, header));
+        }
+        captureWriter->Write(msg.nTime, msg.hdr.GetCommand(), msg.vRecv.data(), msg.vRecv.size());
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to capture messages of peer=%d: %s\n", id, e.what());
+        captureWriter.reset();
+        fCaptureFailed = true;
+    }
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -945,7 +1202,12 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        const unsigned int nNewSize = std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024);
+        if (nDataPos == 0) {
+            CPublicSerializeData buf = CNetMessageBufferPool::Instance().Acquire(nNewSize);
+            vRecv.SwapData(buf);
+        }
+        vRecv.resize(nNewSize);
     }
 
     hasher.Write((const unsigned char*)pch, nCopy);
@@ -955,6 +1217,129 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+void CNetMessage::ReleaseBuffer()
+{
+    CPublicSerializeData buf;
+    vRecv.SwapData(buf);
+    if (buf.capacity() != 0) {
+        CNetMessageBufferPool::Instance().Release(std::move(buf));
+    }
+}
+
+SendPriority GetSendPriority(const std::string& command)
+{
+    static const std::map<std::string, SendPriority> mapPriorities = {
+        {NetMsgType::QFCOMMITMENT, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QCONTRIB, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QCOMPLAINT, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QJUSTIFICATION, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QPCOMMITMENT, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QSIGSESANN, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QSIGSHARESINV, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QGETSIGSHARES, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QBSIGSHARES, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QSIGREC, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::QSIGSHARE, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::CLSIG, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::ISLOCK, SEND_PRIORITY_CRITICAL},
+        {NetMsgType::BLOCK, SEND_PRIORITY_BLOCKS},
+        {NetMsgType::CMPCTBLOCK, SEND_PRIORITY_BLOCKS},
+        {NetMsgType::BLOCKTXN, SEND_PRIORITY_BLOCKS},
+        {NetMsgType::MERKLEBLOCK, SEND_PRIORITY_BLOCKS},
+        {NetMsgType::HEADERS, SEND_PRIORITY_BLOCKS},
+        {NetMsgType::MNGOVERNANCEOBJECT, SEND_PRIORITY_BULK},
+        {NetMsgType::MNGOVERNANCEOBJECTVOTE, SEND_PRIORITY_BULK},
+        {NetMsgType::QDATA, SEND_PRIORITY_BULK},
+    };
+    auto it = mapPriorities.find(command);
+    return it != mapPriorities.end() ? it->second : SEND_PRIORITY_NORMAL;
+}
+
+std::string SendPriorityToString(int priority)
+{
+    switch (priority) {
+    case SEND_PRIORITY_CRITICAL: return "critical";
+    case SEND_PRIORITY_BLOCKS: return "blocks";
+    case SEND_PRIORITY_NORMAL: return "normal";
+    case SEND_PRIORITY_BULK: return "bulk";
+    default: return "unknown";
+    }
+}
+
+CNetMessageBufferPool& CNetMessageBufferPool::Instance()
+{
+    // Intentionally never destroyed, messages might still be released during static deinitialization
+    static CNetMessageBufferPool* pool = new CNetMessageBufferPool();
+    return *pool;
+}
+
+static size_t GetBufferSizeClass(size_t nSize)
+{
+    size_t nClass = 0;
+    while ((CNetMessageBufferPool::MIN_BUFFER_SIZE << nClass) < nSize) {
+        nClass++;
+    }
+    return nClass;
+}
+
+CPublicSerializeData CNetMessageBufferPool::Acquire(size_t nSize)
+{
+    const size_t nClass = GetBufferSizeClass(std::min(std::max(nSize, MIN_BUFFER_SIZE), MAX_BUFFER_SIZE));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!vFree[nClass].empty()) {
+            CPublicSerializeData buf = std::move(vFree[nClass].back());
+            vFree[nClass].pop_back();
+            nPooledBytes -= buf.capacity();
+            nHits++;
+            return buf;
+        }
+        nMisses++;
+    }
+    CPublicSerializeData buf;
+    buf.reserve(MIN_BUFFER_SIZE << nClass);
+    return buf;
+}
+
+void CNetMessageBufferPool::Release(CPublicSerializeData&& buf)
+{
+    const size_t nCapacity = buf.capacity();
+    if (nCapacity < MIN_BUFFER_SIZE || nCapacity > MAX_BUFFER_SIZE) {
+        return;
+    }
+    // Round down, so that every buffer in a class is at least as large as the class size
+    size_t nClass = GetBufferSizeClass(nCapacity);
+    if ((MIN_BUFFER_SIZE << nClass) > nCapacity) {
+        nClass--;
+    }
+    buf.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (nPooledBytes + nCapacity > MAX_POOLED_BYTES) {
+        return;
+    }
+    vFree[nClass].emplace_back(std::move(buf));
+    nPooledBytes += nCapacity;
+}
+
+size_t CNetMessageBufferPool::GetPooledBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nPooledBytes;
+}
+
+uint64_t CNetMessageBufferPool::GetHits()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nHits;
+}
+
+uint64_t CNetMessageBufferPool::GetMisses()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nMisses;
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -963,33 +1348,86 @@ const uint256& CNetMessage::GetMessageHash() const
     return data_hash;
 }
 
+bool CConnman::FillSendMsg(CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend)
+{
+    // Only take a limited amount of data from the queues, so that a higher priority message which is pushed while we
+    // are busy sending doesn't need to wait for a whole queue of lower priority messages
+    size_t nBatchSize = 0;
+    while (pnode->vSendMsg.size() < MAX_SEND_IOVECS && nBatchSize < MAX_SEND_BATCH_SIZE) {
+        auto itQueue = std::find_if(pnode->vSendMsgQueued.begin(), pnode->vSendMsgQueued.end(),
+            [](const std::deque<CNode::QueuedMessage>& queue) { return !queue.empty(); });
+        if (itQueue == pnode->vSendMsgQueued.end()) {
+            break;
+        }
+        CNode::QueuedMessage& queuedMsg = itQueue->front();
+        const size_t nMsgSize = queuedMsg.first.size() + queuedMsg.second.size();
+        nBatchSize += nMsgSize;
+        pnode->arrSendQueueSize[itQueue - pnode->vSendMsgQueued.begin()] -= nMsgSize;
+        pnode->vSendMsg.push_back(std::move(queuedMsg.first));
+        if (!queuedMsg.second.empty()) {
+            pnode->vSendMsg.push_back(std::move(queuedMsg.second));
+        }
+        itQueue->pop_front();
+    }
+    return !pnode->vSendMsg.empty();
+}
+
 size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend)
 {
-    auto it = pnode->vSendMsg.begin();
     size_t nSentSize = 0;
 
-    while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
-        int nBytes = 0;
+    while (!pnode->vSendMsg.empty() || FillSendMsg(pnode)) {
+        auto it = pnode->vSendMsg.begin();
+        assert(it->size() > pnode->nSendOffset);
+        int64_t nBytes = 0;
+        // the number of bytes we tried to send, if less were sent the socket's send buffer is full
+        size_t nTriedSize = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            const auto &data = *it;
+            nTriedSize = data.size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nTriedSize, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Hand as many queued messages as possible to the kernel in one call, which saves a lot of syscalls
+            // for the many small messages (inv, LLMQ messages, ...) masternodes send to each other
+            struct iovec iov[MAX_SEND_IOVECS];
+            size_t nIov = 0;
+            for (auto itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itIov, ++nIov) {
+                const size_t nOffset = nIov == 0 ? pnode->nSendOffset : 0;
+                iov[nIov].iov_base = const_cast<unsigned char*>(itIov->data()) + nOffset;
+                iov[nIov].iov_len = itIov->size() - nOffset;
+                nTriedSize += iov[nIov].iov_len;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
+        nTotalSendCalls++;
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // consume the messages which were sent completely
+            size_t nRemaining = nBytes;
+            while (nRemaining > 0) {
+                const size_t nLeft = it->size() - pnode->nSendOffset;
+                if (nRemaining < nLeft) {
+                    pnode->nSendOffset += nRemaining;
+                    break;
+                }
+                nRemaining -= nLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
-                it++;
-            } else {
-                // could not send full message; stop sending more
+                pnode->nSendSize -= it->size();
+                it = pnode->vSendMsg.erase(it);
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nTriedSize) {
+                // could not send everything; stop sending more
                 pnode->fCanSendData = false;
                 break;
             }
@@ -1009,12 +1447,15 @@ size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs
         }
     }
 
-    if (it == pnode->vSendMsg.end()) {
+    size_t nSendMsgSize = pnode->vSendMsg.size();
+    for (const auto& queue : pnode->vSendMsgQueued) {
+        nSendMsgSize += queue.size();
+    }
+    if (nSendMsgSize == 0) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
-    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
-    pnode->nSendMsgSize = pnode->vSendMsg.size();
+    pnode->nSendMsgSize = nSendMsgSize;
     return nSentSize;
 }
 
@@ -1510,6 +1951,35 @@ void CConnman::InactivityCheck(CNode *pnode)
     }
 }
 
+#ifdef USE_EPOLL
+// epoll_event.data holds either the CNode* of a peer or, for the listening sockets and the wakeup pipe, the socket
+// shifted left by one with the lowest bit set. CNode objects are aligned, so the lowest bit of their address is never set.
+static epoll_data_t EpollDataForNode(CNode* pnode)
+{
+    epoll_data_t data;
+    data.u64 = (uint64_t)(uintptr_t)pnode;
+    return data;
+}
+
+static epoll_data_t EpollDataForSocket(SOCKET hSocket)
+{
+    epoll_data_t data;
+    data.u64 = ((uint64_t)hSocket << 1) | 1;
+    return data;
+}
+
+static CNode* EpollDataToNode(const epoll_data_t& data)
+{
+    return (data.u64 & 1) ? nullptr : (CNode*)(uintptr_t)data.u64;
+}
+
+static SOCKET EpollDataToSocket(const epoll_data_t& data)
+{
+    assert(data.u64 & 1);
+    return (SOCKET)(data.u64 >> 1);
+}
+#endif
+
 bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
     for (const ListenSocket& hListenSocket : vhListenSocket) {
@@ -1590,22 +2060,31 @@ void CConnman::SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
     const size_t maxEvents = 64;
     epoll_event events[maxEvents];
 
+    vEpollNodeEvents.clear();
+
     wakeupSelectNeeded = true;
     int n = epoll_wait(epollfd, events, maxEvents, fOnlyPoll ? 0 : SELECT_TIMEOUT_MILLISECONDS);
     wakeupSelectNeeded = false;
     for (int i = 0; i < n; i++) {
         auto& e = events[i];
+        // Events of peers are passed on directly, so SocketHandler doesn't have to look up their sockets
+        if (CNode* pnode = EpollDataToNode(e.data)) {
+            vEpollNodeEvents.emplace_back(pnode, (uint32_t)e.events);
+            continue;
+        }
+
+        const SOCKET hSocket = EpollDataToSocket(e.data);
         if((e.events & EPOLLERR) || (e.events & EPOLLHUP)) {
-            error_set.insert((SOCKET)e.data.fd);
+            error_set.insert(hSocket);
             continue;
         }
 
         if (e.events & EPOLLIN) {
-            recv_set.insert((SOCKET)e.data.fd);
+            recv_set.insert(hSocket);
         }
 
         if (e.events & EPOLLOUT) {
-            send_set.insert((SOCKET)e.data.fd);
+            send_set.insert(hSocket);
         }
     }
 }
@@ -1773,7 +2252,7 @@ void CConnman::SocketHandler()
             // we must check if at least one of the nodes with pending messages is also sendable, as otherwise a single
             // node would be able to make the network thread busy with polling
             for (auto& p : mapNodesWithDataToSend) {
-                if (mapSendableNodes.count(p.first)) {
+                if (p.second->fCanSendData && mapSendableNodes.count(p.first)) {
                     fOnlyPoll = true;
                     break;
                 }
@@ -1848,6 +2327,30 @@ void CConnman::SocketHandler()
             assert(jt.first->second == it->second);
             it->second->fCanSendData = true;
         }
+#ifdef USE_EPOLL
+        for (const auto& p : vEpollNodeEvents) {
+            CNode* pnode = p.first;
+            {
+                // All nodes with registered events are alive until the next DisconnectNodes() (which runs on this
+                // thread), but the socket might have been closed since epoll_wait returned
+                LOCK(pnode->cs_hSocket);
+                if (pnode->hSocket == INVALID_SOCKET) {
+                    continue;
+                }
+            }
+            if ((p.second & EPOLLERR) || (p.second & EPOLLHUP)) {
+                pnode->AddRef();
+                vErrorNodes.emplace_back(pnode);
+            } else if (p.second & EPOLLIN) {
+                mapReceivableNodes.emplace(pnode->GetId(), pnode);
+                pnode->fHasRecvData = true;
+            }
+            if (p.second & EPOLLOUT) {
+                mapSendableNodes.emplace(pnode->GetId(), pnode);
+                pnode->fCanSendData = true;
+            }
+        }
+#endif
 
         // collect nodes that have a receivable socket
         // also clean up mapReceivableNodes from nodes that were receivable in the last iteration but aren't anymore
@@ -1886,6 +2389,9 @@ void CConnman::SocketHandler()
                 if (it->second->fCanSendData) {
                     it->second->AddRef();
                     vSendableNodes.emplace_back(it->second);
+                } else {
+                    // an optimistic send in PushMessage may have filled the socket's send buffer
+                    mapSendableNodes.erase(it->first);
                 }
                 ++it;
             }
@@ -1925,27 +2431,22 @@ void CConnman::SocketHandler()
         }
     }
 
-    ReleaseNodeVector(vErrorNodes);
-    ReleaseNodeVector(vReceivableNodes);
-    ReleaseNodeVector(vSendableNodes);
-
-    if (interruptNet) {
-        return;
-    }
-
-    {
+    if (!interruptNet) {
         LOCK(cs_vNodes);
         // remove nodes from mapSendableNodes, so that the next iteration knows that there is no work to do
-        // (even if there are pending messages to be sent)
-        for (auto it = mapSendableNodes.begin(); it != mapSendableNodes.end(); ) {
-            if (!it->second->fCanSendData) {
-                LogPrint(BCLog::NET, "%s -- remove mapSendableNodes, peer=%d\n", __func__, it->second->GetId());
-                it = mapSendableNodes.erase(it);
-            } else {
-                ++it;
+        // (even if there are pending messages to be sent). Only the nodes we just tried to send to can have become
+        // unsendable here, the others are handled when collecting vSendableNodes. This avoids walking all
+        // (usually sendable) peers in every iteration.
+        for (CNode* pnode : vSendableNodes) {
+            if (!pnode->fCanSendData && mapSendableNodes.erase(pnode->GetId())) {
+                LogPrint(BCLog::NET, "%s -- remove mapSendableNodes, peer=%d\n", __func__, pnode->GetId());
             }
         }
     }
+
+    ReleaseNodeVector(vErrorNodes);
+    ReleaseNodeVector(vReceivableNodes);
+    ReleaseNodeVector(vSendableNodes);
 }
 
 size_t CConnman::SocketRecvData(CNode *pnode)
@@ -1984,7 +2485,7 @@ size_t CConnman::SocketRecvData(CNode *pnode)
                 pnode->nProcessQueueSize += nSizeAdded;
                 pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
             }
-            WakeMessageHandler();
+            WakeMessageHandler(pnode);
         }
     }
     else if (nBytes == 0)
@@ -2040,9 +2541,34 @@ void CConnman::WakeMessageHandler()
 {
     {
         std::lock_guard<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = true;
+        std::fill(vMsgProcWake.begin(), vMsgProcWake.end(), true);
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
+}
+
+void CConnman::WakeMessageHandler(const CNode* pnode)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexMsgProc);
+        if (vMsgProcWake.empty()) {
+            return;
+        }
+        vMsgProcWake[GetMessageHandlerThread(pnode)] = true;
+    }
+    // all threads wait on the same condition variable, the others go back to sleep right away
+    if (vMsgProcWake.size() == 1) {
+        condMsgProc.notify_one();
+    } else {
+        condMsgProc.notify_all();
+    }
+}
+
+int CConnman::GetMessageHandlerThread(const CNode* pnode) const
+{
+    if (pnode->fFastTransport) {
+        return nMessageHandlerThreads;
+    }
+    return pnode->GetId() % nMessageHandlerThreads;
 }
 
 void CConnman::WakeSelect()
@@ -2219,23 +2745,34 @@ void CConnman::ThreadDNSAddressSeed()
 
     LogPrintf("Loading addresses from DNS seeds (could take a while)\n");
 
-    for (const std::string &seed : vSeeds) {
+    // Query all seeds at once, so that slow seeds don't delay the others
+    ServiceFlags requiredServiceBits = GetDesirableServiceFlags(NODE_NONE);
+    std::vector<std::string> vHosts;
+    std::vector<std::vector<CNetAddr>> vSeedIPs;
+    if (!HaveNameProxy()) {
+        for (const std::string &seed : vSeeds) {
+            vHosts.emplace_back(strprintf("x%x.%s", requiredServiceBits, seed));
+        }
+        unsigned int nMaxIPs = 256; // Limits number of IPs learned from a DNS seed
+        vSeedIPs = LookupHosts(vHosts, nMaxIPs);
+    }
+
+    for (size_t i = 0; i < vSeeds.size(); i++) {
+        const std::string &seed = vSeeds[i];
         if (interruptNet) {
             return;
         }
         if (HaveNameProxy()) {
             AddOneShot(seed);
         } else {
-            std::vector<CNetAddr> vIPs;
+            const std::vector<CNetAddr>& vIPs = vSeedIPs[i];
             std::vector<CAddress> vAdd;
-            ServiceFlags requiredServiceBits = GetDesirableServiceFlags(NODE_NONE);
-            std::string host = strprintf("x%x.%s", requiredServiceBits, seed);
+            const std::string& host = vHosts[i];
             CNetAddr resolveSource;
             if (!resolveSource.SetInternal(host)) {
                 continue;
             }
-            unsigned int nMaxIPs = 256; // Limits number of IPs learned from a DNS seed
-            if (LookupHost(host.c_str(), vIPs, nMaxIPs, true))
+            if (!vIPs.empty())
             {
                 for (const CNetAddr& ip : vIPs)
                 {
@@ -2411,6 +2948,16 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 }
             }
         }
+        if (!Params().AllowMultipleAddressesFromGroup()) {
+            // outbound connections which are still being established through a proxy use their slots already
+            std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+            for (const auto& pending : lPendingProxyConnections) {
+                if (!pending->masternode_connection && !pending->manual_connection) {
+                    setConnected.insert(pending->addrConnect.GetGroup());
+                    nOutbound++;
+                }
+            }
+        }
 
         std::set<uint256> setConnectedMasternodes;
         {
@@ -2623,7 +3170,13 @@ void CConnman::ThreadOpenMasternodeConnections()
         if (didConnect) {
             sleepTime = 100;
         }
-        if (!interruptNet.sleep_for(std::chrono::milliseconds(sleepTime)))
+        {
+            // Sleep until the next retry round or until new connections are wanted
+            std::unique_lock<std::mutex> lock(mutexMasternodeConn);
+            condMasternodeConn.wait_for(lock, std::chrono::milliseconds(sleepTime), [this] { return fMasternodeConnWake || interruptNet; });
+            fMasternodeConnWake = false;
+        }
+        if (interruptNet)
             return;
 
         didConnect = false;
@@ -2631,6 +3184,14 @@ void CConnman::ThreadOpenMasternodeConnections()
         if (!fNetworkActive || !masternodeSync.IsBlockchainSynced())
             continue;
 
+        {
+            // Nothing to plan, avoid walking all nodes and copying the MN list
+            LOCK(cs_vPendingMasternodes);
+            if (vPendingMasternodes.empty() && masternodeQuorumDesired.empty() && masternodePendingProbes.empty()) {
+                continue;
+            }
+        }
+
         std::set<CService> connectedNodes;
         std::map<uint256, bool> connectedProRegTxHashes;
         ForEachNode([&](const CNode* pnode) {
@@ -2639,6 +3200,13 @@ void CConnman::ThreadOpenMasternodeConnections()
                 connectedProRegTxHashes.emplace(pnode->verifiedProRegTxHash, pnode->fInbound);
             }
         });
+        {
+            // connections which are still being established through a proxy count as connected
+            std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+            for (const auto& pending : lPendingProxyConnections) {
+                connectedNodes.emplace(pending->addrConnect);
+            }
+        }
 
         auto mnList = deterministicMNManager->GetListAtChainTip();
 
@@ -2665,21 +3233,23 @@ void CConnman::ThreadOpenMasternodeConnections()
 
             if (!connectToDmn) {
                 std::vector<CDeterministicMNCPtr> pending;
-                for (const auto& group : masternodeQuorumNodes) {
-                    for (const auto& proRegTxHash : group.second) {
-                        auto dmn = mnList.GetMN(proRegTxHash);
-                        if (!dmn) {
+                // Only dial the difference between the desired and the already connected masternodes
+                for (const auto& proRegTxHash : masternodeQuorumDesired) {
+                    if (connectedProRegTxHashes.count(proRegTxHash)) {
+                        continue;
+                    }
+                    auto dmn = mnList.GetMN(proRegTxHash);
+                    if (!dmn) {
+                        continue;
+                    }
+                    const auto& addr2 = dmn->pdmnState->addr;
+                    if (!connectedNodes.count(addr2) && !IsMasternodeOrDisconnectRequested(addr2)) {
+                        int64_t lastAttempt = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastOutboundAttempt();
+                        // back off trying connecting to an address if we already tried recently
+                        if (nANow - lastAttempt < chainParams.LLMQConnectionRetryTimeout()) {
                             continue;
                         }
-                        const auto& addr2 = dmn->pdmnState->addr;
-                        if (!connectedNodes.count(addr2) && !IsMasternodeOrDisconnectRequested(addr2) && !connectedProRegTxHashes.count(proRegTxHash)) {
-                            int64_t lastAttempt = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastOutboundAttempt();
-                            // back off trying connecting to an address if we already tried recently
-                            if (nANow - lastAttempt < chainParams.LLMQConnectionRetryTimeout()) {
-                                continue;
-                            }
-                            pending.emplace_back(dmn);
-                        }
+                        pending.emplace_back(dmn);
                     }
                 }
 
@@ -2734,6 +3304,10 @@ void CConnman::ThreadOpenMasternodeConnections()
         mmetaman.GetMetaInfo(connectToDmn->proTxHash)->SetLastOutboundAttempt(nANow);
 
         OpenMasternodeConnection(CAddress(connectToDmn->pdmnState->addr, NODE_NETWORK), isProbe);
+        if (IsPendingProxyConnection(connectToDmn->pdmnState->addr, false)) {
+            // a failure is handled by ThreadPendingProxyConnections
+            continue;
+        }
         // should be in the list now if connection was opened
         bool connected = ForNode(connectToDmn->pdmnState->addr, CConnman::AllNodes, [&](CNode* pnode) {
             if (pnode->fDisconnect) {
@@ -2773,7 +3347,9 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         if ((!Params().AllowMultiplePorts() && FindNode(static_cast<CNetAddr>(addrConnect))) ||
             (Params().AllowMultiplePorts() && FindNode(static_cast<CService>(addrConnect))))
             return;
-    } else if (FindNode(std::string(pszDest)))
+        if (IsPendingProxyConnection(addrConnect, !Params().AllowMultiplePorts()))
+            return;
+    } else if (FindNode(std::string(pszDest)) || IsPendingProxyConnection(std::string(pszDest)))
         return;
 
     auto getIpStr = [&]() {
@@ -2785,13 +3361,34 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     };
 
     LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- connecting to %s\n", __func__, getIpStr());
-    CNode* pnode = ConnectNode(addrConnect, pszDest, fCountFailure, manual_connection);
-
+    std::unique_ptr<PendingProxyConnection> pending;
+    CNode* pnode = ConnectNode(addrConnect, pszDest, fCountFailure, manual_connection, &pending);
+
+    if (pending) {
+        LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- connecting through proxy to %s in the background\n", __func__, getIpStr());
+        if (grantOutbound)
+            grantOutbound->MoveTo(pending->grantOutbound);
+        pending->fOneShot = fOneShot;
+        pending->fFeeler = fFeeler;
+        pending->masternode_connection = masternode_connection;
+        pending->masternode_probe_connection = masternode_probe_connection;
+        {
+            std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+            lPendingProxyConnections.emplace_back(std::move(pending));
+        }
+        condPendingProxyConnections.notify_one();
+        return;
+    }
     if (!pnode) {
         LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- ConnectNode failed for %s\n", __func__, getIpStr());
         return;
     }
     LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- succesfully connected to %s, sock=%d, peer=%d\n", __func__, getIpStr(), pnode->hSocket, pnode->GetId());
+    AddOutboundNode(pnode, grantOutbound, fOneShot, fFeeler, manual_connection, masternode_connection, masternode_probe_connection);
+}
+
+void CConnman::AddOutboundNode(CNode* pnode, CSemaphoreGrant* grantOutbound, bool fOneShot, bool fFeeler, bool manual_connection, bool masternode_connection, bool masternode_probe_connection)
+{
     if (grantOutbound)
         grantOutbound->MoveTo(pnode->grantOutbound);
     if (fOneShot)
@@ -2823,7 +3420,7 @@ void CConnman::OpenMasternodeConnection(const CAddress &addrConnect, bool probe)
     OpenNetworkConnection(addrConnect, false, nullptr, nullptr, false, false, false, true, probe);
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int nThread)
 {
     int64_t nLastSendMessagesTimeMasternodes = 0;
 
@@ -2841,7 +3438,7 @@ void CConnman::ThreadMessageHandler()
 
         for (CNode* pnode : vNodesCopy)
         {
-            if (pnode->fDisconnect)
+            if (pnode->fDisconnect || GetMessageHandlerThread(pnode) != nThread)
                 continue;
 
             // Receive messages
@@ -2850,22 +3447,28 @@ void CConnman::ThreadMessageHandler()
             if (flagInterruptMsgProc)
                 return;
             // Send messages
-            if (!fSkipSendMessagesForMasternodes || !pnode->m_masternode_connection) {
+            if (!fSkipSendMessagesForMasternodes || !pnode->m_masternode_connection || pnode->fFastTransport) {
                 LOCK(pnode->cs_sendProcessing);
                 m_msgproc->SendMessages(pnode);
             }
 
             if (flagInterruptMsgProc)
                 return;
+
+            // We're done with this node, so nothing of it is processed by two threads at the same time
+            if (pnode->fFastTransportPending && !pnode->fFastTransport) {
+                pnode->fFastTransport = true;
+                WakeMessageHandler(pnode);
+            }
         }
 
         ReleaseNodeVector(vNodesCopy);
 
         std::unique_lock<std::mutex> lock(mutexMsgProc);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
+            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this, nThread] { return vMsgProcWake[nThread]; });
         }
-        fMsgProcWake = false;
+        vMsgProcWake[nThread] = false;
     }
 }
 
@@ -2951,7 +3554,7 @@ bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, b
 #ifdef USE_EPOLL
     if (socketEventsMode == SOCKETEVENTS_EPOLL) {
         epoll_event event;
-        event.data.fd = hListenSocket;
+        event.data = EpollDataForSocket(hListenSocket);
         event.events = EPOLLIN;
         if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket, &event) != 0) {
             strError = strprintf(_("Error: failed to add socket to epollfd (epoll_ctl returned error %s)"), NetworkErrorString(WSAGetLastError()));
@@ -3042,6 +3645,9 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) :
         addrman(Params().AllowMultiplePorts()),
         nSeed0(nSeed0In), nSeed1(nSeed1In)
 {
+    for (const std::string &msg : getAllNetMessageTypes())
+        mapTotalProcessStats[msg];
+    mapTotalProcessStats[NET_MESSAGE_COMMAND_OTHER];
     fNetworkActive = true;
     setBannedIsDirty = false;
     fAddressesInitialized = false;
@@ -3104,6 +3710,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     {
         LOCK(cs_totalBytesSent);
         nTotalBytesSent = 0;
+        nTotalSendCalls = 0;
         nMaxOutboundTotalBytesSentInCycle = 0;
         nMaxOutboundCycleStartTime = 0;
     }
@@ -3193,12 +3800,13 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     //
     assert(m_msgproc);
     InterruptSocks5(false);
+    InterruptLookup(false);
     interruptNet.reset();
     flagInterruptMsgProc = false;
 
     {
         std::unique_lock<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = false;
+        vMsgProcWake.assign(nMessageHandlerThreads + (fMasternodeFastTransport ? 1 : 0), false);
     }
 
 #ifdef USE_WAKEUP_PIPE
@@ -3230,7 +3838,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         if (socketEventsMode == SOCKETEVENTS_EPOLL) {
             epoll_event event;
             event.events = EPOLLIN;
-            event.data.fd = wakeupPipe[0];
+            event.data = EpollDataForSocket(wakeupPipe[0]);
             int r = epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeupPipe[0], &event);
             if (r != 0) {
                 LogPrint(BCLog::NET, "%s -- epoll_ctl(%d, %d, %d, ...) failed. error: %s\n", __func__,
@@ -3267,11 +3875,20 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     // Initiate masternode connections
     threadOpenMasternodeConnections = std::thread(&TraceThread<std::function<void()> >, "mncon", std::function<void()>(std::bind(&CConnman::ThreadOpenMasternodeConnections, this)));
 
+    // Establish connections through proxies in the background
+    threadPendingProxyConnections = std::thread(&TraceThread<std::function<void()> >, "proxycon", std::function<void()>(std::bind(&CConnman::ThreadPendingProxyConnections, this)));
+
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMessageHandlerThreads; i++) {
+        std::string strThreadName = nMessageHandlerThreads == 1 ? "msghand" : strprintf("msghand.%d", i);
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, strThreadName, std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, i)));
+    }
+    if (fMasternodeFastTransport) {
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, "msghand.mn", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, nMessageHandlerThreads)));
+    }
 
     // Dump network addresses
-    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000, CScheduler::Priority::LOW, "dumpdata");
 
     return true;
 }
@@ -3309,6 +3926,13 @@ void CConnman::Interrupt()
 
     interruptNet();
     InterruptSocks5(true);
+    InterruptLookup(true);
+    WakeMasternodeConnections();
+    {
+        // synchronize with the wait in ThreadPendingProxyConnections, so that the wakeup can't get lost
+        std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+    }
+    condPendingProxyConnections.notify_all();
 
     if (semOutbound) {
         for (int i=0; i<(nMaxOutbound + nMaxFeeler); i++) {
@@ -3325,10 +3949,20 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (auto& threadMessageHandler : threadMessageHandlers) {
+        if (threadMessageHandler.joinable())
+            threadMessageHandler.join();
+    }
+    threadMessageHandlers.clear();
     if (threadOpenMasternodeConnections.joinable())
         threadOpenMasternodeConnections.join();
+    if (threadPendingProxyConnections.joinable())
+        threadPendingProxyConnections.join();
+    {
+        // closes the sockets and releases the grants of connections which were not finished
+        std::lock_guard<std::mutex> lock(mutexPendingProxyConnections);
+        lPendingProxyConnections.clear();
+    }
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -3489,15 +4123,50 @@ bool CConnman::AddPendingMasternode(const uint256& proTxHash)
     }
 
     vPendingMasternodes.push_back(proTxHash);
+    WakeMasternodeConnections();
     return true;
 }
 
+void CConnman::WakeMasternodeConnections()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexMasternodeConn);
+        fMasternodeConnWake = true;
+    }
+    condMasternodeConn.notify_one();
+}
+
+void CConnman::UpdateMasternodeQuorumDesired()
+{
+    AssertLockHeld(cs_vPendingMasternodes);
+    masternodeQuorumDesired.clear();
+    for (const auto& p : masternodeQuorumNodes) {
+        masternodeQuorumDesired.insert(p.second.begin(), p.second.end());
+    }
+}
+
 void CConnman::SetMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash, const std::set<uint256>& proTxHashes)
 {
-    LOCK(cs_vPendingMasternodes);
-    auto it = masternodeQuorumNodes.emplace(std::make_pair(llmqType, quorumHash), proTxHashes);
-    if (!it.second) {
-        it.first->second = proTxHashes;
+    bool fNewMembers{false};
+    {
+        LOCK(cs_vPendingMasternodes);
+        auto it = masternodeQuorumNodes.emplace(std::make_pair(llmqType, quorumHash), proTxHashes);
+        if (!it.second) {
+            if (it.first->second == proTxHashes) {
+                return;
+            }
+            it.first->second = proTxHashes;
+        }
+        for (const auto& proTxHash : proTxHashes) {
+            if (!masternodeQuorumDesired.count(proTxHash)) {
+                fNewMembers = true;
+                break;
+            }
+        }
+        UpdateMasternodeQuorumDesired();
+    }
+    if (fNewMembers) {
+        WakeMasternodeConnections();
     }
 }
 
@@ -3569,7 +4238,9 @@ std::set<NodeId> CConnman::GetMasternodeQuorumNodes(Consensus::LLMQType llmqType
 void CConnman::RemoveMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint256& quorumHash)
 {
     LOCK(cs_vPendingMasternodes);
-    masternodeQuorumNodes.erase(std::make_pair(llmqType, quorumHash));
+    if (masternodeQuorumNodes.erase(std::make_pair(llmqType, quorumHash))) {
+        UpdateMasternodeQuorumDesired();
+    }
     masternodeQuorumRelayMembers.erase(std::make_pair(llmqType, quorumHash));
 }
 
@@ -3619,8 +4290,11 @@ bool CConnman::IsMasternodeQuorumRelayMember(const uint256& protxHash)
 
 void CConnman::AddPendingProbeConnections(const std::set<uint256> &proTxHashes)
 {
-    LOCK(cs_vPendingMasternodes);
-    masternodePendingProbes.insert(proTxHashes.begin(), proTxHashes.end());
+    {
+        LOCK(cs_vPendingMasternodes);
+        masternodePendingProbes.insert(proTxHashes.begin(), proTxHashes.end());
+    }
+    WakeMasternodeConnections();
 }
 
 size_t CConnman::GetNodeCount(NumConnections flags)
@@ -3692,6 +4366,10 @@ void CConnman::RelayTransaction(const CTransaction& tx)
 }
 
 void CConnman::RelayInv(CInv &inv, const int minProtoVersion) {
+    if (inv.type == MSG_TX || inv.type == MSG_DSTX) {
+        txAnnouncementQueue.Push(inv.hash);
+        return;
+    }
     LOCK(cs_vNodes);
     for (const auto& pnode : vNodes) {
         if (pnode->nVersion < minProtoVersion || !pnode->CanRelay())
@@ -3729,6 +4407,63 @@ void CConnman::RelayInvFiltered(CInv &inv, const uint256& relatedTxHash, const i
     }
 }
 
+void CTxAnnouncementQueue::Trim()
+{
+    uint64_t nMinCursor = End();
+    for (const auto& p : mapCursors) {
+        nMinCursor = std::min(nMinCursor, p.second);
+    }
+    queue.erase(queue.begin(), queue.begin() + (nMinCursor - nBegin));
+    nBegin = nMinCursor;
+}
+
+void CTxAnnouncementQueue::Push(const uint256& hash)
+{
+    LOCK(cs);
+    if (!mapCursors.empty()) {
+        setBatch.insert(hash);
+    }
+}
+
+void CTxAnnouncementQueue::AddPeer(NodeId id)
+{
+    LOCK(cs);
+    mapCursors.emplace(id, End());
+}
+
+void CTxAnnouncementQueue::RemovePeer(NodeId id)
+{
+    LOCK(cs);
+    mapCursors.erase(id);
+    if (mapCursors.empty()) {
+        // nobody to announce to
+        setBatch.clear();
+    }
+    Trim();
+}
+
+void CTxAnnouncementQueue::SkipPending(NodeId id)
+{
+    LOCK(cs);
+    auto it = mapCursors.find(id);
+    if (it != mapCursors.end()) {
+        it->second = End();
+    }
+}
+
+size_t CTxAnnouncementQueue::GetPendingCount(NodeId id) const
+{
+    LOCK(cs);
+    auto it = mapCursors.find(id);
+    return it != mapCursors.end() ? End() - it->second : 0;
+}
+
+size_t CTxAnnouncementQueue::size() const
+{
+    LOCK(cs);
+    return queue.size();
+}
+
 void CConnman::RecordBytesRecv(uint64_t bytes)
 {
     LOCK(cs_totalBytesRecv);
@@ -3829,6 +4564,34 @@ uint64_t CConnman::GetOutboundTargetBytesLeft()
     return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
 }
 
+void CNode::RecordMsgProcessTime(const std::string& strCommand, int64_t nTime, int64_t nCPUTime)
+{
+    LOCK(cs_vProcessMsg);
+    auto it = mapProcessStatsPerMsgCmd.find(strCommand);
+    if (it == mapProcessStatsPerMsgCmd.end())
+        it = mapProcessStatsPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(it != mapProcessStatsPerMsgCmd.end());
+    it->second.Add(nTime, nCPUTime);
+}
+
+void CConnman::RecordMsgProcessTime(CNode* pnode, const std::string& strCommand, int64_t nTime, int64_t nCPUTime)
+{
+    pnode->RecordMsgProcessTime(strCommand, nTime, nCPUTime);
+
+    LOCK(cs_totalProcessStats);
+    auto it = mapTotalProcessStats.find(strCommand);
+    if (it == mapTotalProcessStats.end())
+        it = mapTotalProcessStats.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(it != mapTotalProcessStats.end());
+    it->second.Add(nTime, nCPUTime);
+}
+
+mapMsgCmdProcessStats CConnman::GetTotalMsgProcessStats()
+{
+    LOCK(cs_totalProcessStats);
+    return mapTotalProcessStats;
+}
+
 uint64_t CConnman::GetTotalBytesRecv()
 {
     LOCK(cs_totalBytesRecv);
@@ -3841,6 +4604,11 @@ uint64_t CConnman::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+uint64_t CConnman::GetTotalSendCalls() const
+{
+    return nTotalSendCalls;
+}
+
 ServiceFlags CConnman::GetLocalServices() const
 {
     return nLocalServices;
@@ -3927,6 +4695,9 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     for (const std::string &msg : getAllNetMessageTypes())
         mapRecvBytesPerMsgCmd[msg] = 0;
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    for (const std::string &msg : getAllNetMessageTypes())
+        mapProcessStatsPerMsgCmd[msg];
+    mapProcessStatsPerMsgCmd[NET_MESSAGE_COMMAND_OTHER];
 
     if (fLogIPs) {
         LogPrint(BCLog::NET, "Added connection to %s peer=%d\n", addrName, id);
@@ -3964,18 +4735,21 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
-        bool hasPendingData = !pnode->vSendMsg.empty();
+        bool hasPendingData = pnode->nSendSize != 0;
+
+        // don't reorder anything before the handshake is done
+        const SendPriority priority = pnode->fSuccessfullyConnected ? GetSendPriority(msg.command) : SEND_PRIORITY_NORMAL;
 
         //log total amount of bytes per command
         pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
+        pnode->arrSendBytesPerPriority[priority] += nTotalSize;
+        pnode->arrSendQueueSize[priority] += nTotalSize;
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
-        pnode->nSendMsgSize = pnode->vSendMsg.size();
+        pnode->vSendMsgQueued[priority].emplace_back(std::move(serializedHeader), std::move(msg.data));
+        pnode->nSendMsgSize++;
 
         {
             LOCK(cs_mapNodesWithDataToSend);
@@ -4115,7 +4889,7 @@ void CConnman::RegisterEvents(CNode *pnode)
     epoll_event e;
     // We're using edge-triggered mode, so it's important that we drain sockets even if no signals come in
     e.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLERR | EPOLLHUP;
-    e.data.fd = pnode->hSocket;
+    e.data = EpollDataForNode(pnode);
 
     int r = epoll_ctl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, &e);
     if (r != 0) {
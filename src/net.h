@@ -13,7 +13,9 @@
 #include <fs.h>
 #include <hash.h>
 #include <limitedmap.h>
+#include <messagecapture.h>
 #include <netaddress.h>
+#include <netbase.h>
 #include <policy/feerate.h>
 #include <protocol.h>
 #include <random.h>
@@ -25,11 +27,13 @@
 #include <threadinterrupt.h>
 #include <consensus/params.h>
 
+#include <array>
 #include <atomic>
 #include <deque>
 #include <stdint.h>
 #include <thread>
 #include <memory>
+#include <mutex>
 #include <condition_variable>
 #include <unordered_set>
 #include <queue>
@@ -68,6 +72,8 @@ static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 static const int MAX_OUTBOUND_CONNECTIONS = 8;
 /** Maximum number of addnode outgoing nodes */
 static const int MAX_ADDNODE_CONNECTIONS = 8;
+/** Maximum number of connections through a proxy which are connected and handshaked in the background at once */
+static const int MAX_PENDING_PROXY_CONNECTIONS = 32;
 /** Eviction protection time for incoming connections  */
 static const int INBOUND_EVICTION_PROTECTION_TIME = 1;
 /** -listen default */
@@ -82,6 +88,16 @@ static const bool DEFAULT_UPNP = false;
  *  Masternodes are forced to accept at least this many connections
  */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
+/** Default number of threads processing peer messages (-msghandthreads) */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 1;
+/** Maximum number of threads processing peer messages */
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
+/** Default for -llmq-fast-transport */
+static const bool DEFAULT_MASTERNODE_FAST_TRANSPORT = false;
+/** Maximum number of queued messages passed to a single sendmsg() call (IOV_MAX is at least 1024 on all supported systems) */
+static const size_t MAX_SEND_IOVECS = 64;
+/** Once this many bytes are queued for the socket, no further messages are taken from the send priority queues */
+static const size_t MAX_SEND_BATCH_SIZE = 64 * 1024;
 /** The default for -maxuploadtarget. 0 = Unlimited */
 static const uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
 /** The default timeframe for -maxuploadtarget. 1 day. */
@@ -118,9 +134,43 @@ struct AddedNodeInfo
     bool fInbound;
 };
 
+/**
+ * Outgoing messages are queued per priority and sent highest priority first, so that e.g. LLMQ signing sessions and
+ * InstantSend/ChainLocks are not delayed behind block uploads or governance syncs. Messages are never split, so a
+ * message only has to wait for the messages which were already handed to the socket.
+ */
+enum SendPriority : int {
+    SEND_PRIORITY_CRITICAL = 0, // LLMQ, InstantSend and ChainLocks messages
+    SEND_PRIORITY_BLOCKS,       // blocks and headers
+    SEND_PRIORITY_NORMAL,       // everything else
+    SEND_PRIORITY_BULK,         // governance sync
+    NUM_SEND_PRIORITIES
+};
+
+/** Returns the priority with which messages of the given type are sent */
+SendPriority GetSendPriority(const std::string& command);
+std::string SendPriorityToString(int priority);
+
 class CNodeStats;
 class CClientUIInterface;
 
+/** Number of processed messages of a command and the time the message handler spent on them, in microseconds */
+struct CMsgProcessStats
+{
+    uint64_t nCount{0};
+    int64_t nTime{0};
+    //! thread CPU time, the difference to nTime is mostly spent waiting for locks
+    int64_t nCPUTime{0};
+
+    void Add(int64_t nTimeIn, int64_t nCPUTimeIn)
+    {
+        nCount++;
+        nTime += nTimeIn;
+        nCPUTime += nCPUTimeIn;
+    }
+};
+typedef std::map<std::string, CMsgProcessStats> mapMsgCmdProcessStats;
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -134,6 +184,78 @@ struct CSerializedNetMsg
     std::string command;
 };
 
+/**
+ * Transactions to announce to all peers, in the order they are announced in.
+ *
+ * Relayed transactions are collected in a batch, which is sorted topologically and by fee rate once, when the first
+ * peer trickles after they were relayed, and then appended to the queue. Every peer keeps a cursor into the queue and
+ * only walks the entries after it, instead of sorting its own set of transactions on every trickle. Entries are
+ * dropped once all peers walked past them.
+ */
+class CTxAnnouncementQueue
+{
+private:
+    mutable CCriticalSection cs;
+    std::set<uint256> setBatch GUARDED_BY(cs);
+    std::deque<uint256> queue GUARDED_BY(cs);
+    // sequence number of queue.front()
+    uint64_t nBegin GUARDED_BY(cs){0};
+    std::map<NodeId, uint64_t> mapCursors GUARDED_BY(cs);
+
+    uint64_t End() const EXCLUSIVE_LOCKS_REQUIRED(cs) { return nBegin + queue.size(); }
+    void Trim() EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    /** Add a transaction to the next batch */
+    void Push(const uint256& hash);
+
+    /** Sort the current batch with sortBatch(std::vector<uint256>&), which may also drop entries, and append it */
+    template<typename SortFunc>
+    void Flush(SortFunc sortBatch)
+    {
+        LOCK(cs);
+        if (setBatch.empty()) {
+            return;
+        }
+        std::vector<uint256> vBatch(setBatch.begin(), setBatch.end());
+        setBatch.clear();
+        sortBatch(vBatch);
+        queue.insert(queue.end(), vBatch.begin(), vBatch.end());
+        Trim();
+    }
+
+    /** Peers only get the transactions which are appended after they were added */
+    void AddPeer(NodeId id);
+    void RemovePeer(NodeId id);
+
+    /**
+     * Call func(hash) for the entries after the cursor of the peer and advance the cursor past them, until func
+     * returns false. The entry for which func returned false was consumed as well.
+     */
+    template<typename Callable>
+    void ForEachPending(NodeId id, Callable&& func)
+    {
+        LOCK(cs);
+        auto it = mapCursors.find(id);
+        if (it == mapCursors.end()) {
+            return;
+        }
+        uint64_t& nCursor = it->second;
+        while (nCursor < End()) {
+            const uint256& hash = queue[nCursor - nBegin];
+            nCursor++;
+            if (!func(hash)) {
+                break;
+            }
+        }
+    }
+
+    /** Drop all pending entries of the peer */
+    void SkipPending(NodeId id);
+    size_t GetPendingCount(NodeId id) const;
+    size_t size() const;
+};
+
 class NetEventsInterface;
 class CConnman
 {
@@ -176,6 +298,8 @@ public:
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
         SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nMessageHandlerThreads = DEFAULT_MESSAGE_HANDLER_THREADS;
+        bool m_masternode_fast_transport = DEFAULT_MASTERNODE_FAST_TRANSPORT;
     };
 
     void Init(const Options& connOptions) {
@@ -202,6 +326,8 @@ public:
             vAddedNodes = connOptions.m_added_nodes;
         }
         socketEventsMode = connOptions.socketEventsMode;
+        nMessageHandlerThreads = std::max(1, std::min(connOptions.nMessageHandlerThreads, MAX_MESSAGE_HANDLER_THREADS));
+        fMasternodeFastTransport = connOptions.m_masternode_fast_transport;
     }
 
     CConnman(uint64_t seed0, uint64_t seed1);
@@ -213,6 +339,8 @@ public:
     bool GetUseAddrmanOutgoing() const { return m_use_addrman_outgoing; };
     void SetNetworkActive(bool active);
     SocketEventsMode GetSocketEventsMode() const { return socketEventsMode; }
+    /** Whether verified masternode connections are handled by a dedicated message handler thread (-llmq-fast-transport) */
+    bool IsMasternodeFastTransportEnabled() const { return fMasternodeFastTransport; }
     void OpenNetworkConnection(const CAddress& addrConnect, bool fCountFailure, CSemaphoreGrant *grantOutbound = nullptr, const char *strDest = nullptr, bool fOneShot = false, bool fFeeler = false, bool manual_connection = false, bool masternode_connection = false, bool masternode_probe_connection = false);
     void OpenMasternodeConnection(const CAddress& addrConnect, bool probe = false);
     bool CheckIncomingNonce(uint64_t nonce);
@@ -362,6 +490,8 @@ public:
     void ReleaseNodeVector(const std::vector<CNode*>& vecNodes);
 
     void RelayTransaction(const CTransaction& tx);
+    CTxAnnouncementQueue& GetTxAnnouncementQueue() { return txAnnouncementQueue; }
+    // Transactions are not pushed to the peers but to the announcement queue, from which all peers announce them
     void RelayInv(CInv &inv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
     void RelayInvFiltered(CInv &inv, const CTransaction &relatedTx, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
     // This overload will not update node filters,  so use it only for the cases when other messages will update related transaction data in filters
@@ -458,6 +588,12 @@ public:
 
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
+    //! Add a processed message to the stats of the peer and the totals
+    void RecordMsgProcessTime(CNode* pnode, const std::string& strCommand, int64_t nTime, int64_t nCPUTime);
+    //! Message processing stats of all peers, including disconnected ones
+    mapMsgCmdProcessStats GetTotalMsgProcessStats();
+    //! Number of send syscalls issued by SocketSendData, each of them may send multiple messages
+    uint64_t GetTotalSendCalls() const;
 
     void SetBestHeight(int height);
     int GetBestHeight() const;
@@ -467,7 +603,10 @@ public:
 
     unsigned int GetReceiveFloodSize() const;
 
+    /** Wake up all message handler threads */
     void WakeMessageHandler();
+    /** Wake up the message handler thread which processes the messages of the given node */
+    void WakeMessageHandler(const CNode* pnode);
     void WakeSelect();
 
     /** Attempts to obfuscate tx time through exponentially distributed emitting.
@@ -491,7 +630,14 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    /**
+     * Process the messages of all nodes assigned to the given thread. Nodes are assigned to the message handler
+     * threads by their id, so the messages of one node are always processed by the same thread and in order.
+     * With -llmq-fast-transport, verified masternode connections are handed over to an additional thread
+     * (nThread == nMessageHandlerThreads) once their MNAUTH was processed.
+     */
+    void ThreadMessageHandler(int nThread);
+    int GetMessageHandlerThread(const CNode* pnode) const;
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
@@ -513,6 +659,9 @@ private:
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenMasternodeConnections();
+    void ThreadPendingProxyConnections();
+    void WakeMasternodeConnections();
+    void UpdateMasternodeQuorumDesired();
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
 
@@ -522,13 +671,52 @@ private:
     CNode* FindNode(const CService& addr, bool fExcludeDisconnecting = true);
 
     bool AttemptToEvictConnection();
-    CNode* ConnectNode(CAddress addrConnect, const char *pszDest = nullptr, bool fCountFailure = false, bool manual_connection = false);
+    /**
+     * An outbound connection through a SOCKS5 proxy, which is connected and handshaked by ThreadPendingProxyConnections
+     * so that slow proxies (e.g. Tor) don't block the threads opening connections.
+     */
+    struct PendingProxyConnection {
+        SOCKET hSocket{INVALID_SOCKET};
+        CAddress addrConnect;
+        std::string strDest;
+        proxyType proxy;
+        // destination as passed to the proxy
+        std::string strProxyDest;
+        int nProxyPort{0};
+        bool fCountFailure{false};
+        bool fOneShot{false};
+        bool fFeeler{false};
+        bool manual_connection{false};
+        bool masternode_connection{false};
+        bool masternode_probe_connection{false};
+        CSemaphoreGrant grantOutbound;
+
+        // null while the connection to the proxy is in progress
+        std::unique_ptr<Socks5Handshake> handshake;
+        int64_t nDeadlineMillis{0};
+
+        ~PendingProxyConnection() { CloseSocket(hSocket); }
+    };
+
+    /**
+     * Connect to addrConnect or pszDest. Connections through a proxy are started and returned in pendingRet instead
+     * of blocking until they are established, if pendingRet is not null and the limit of pending connections allows.
+     */
+    CNode* ConnectNode(CAddress addrConnect, const char *pszDest = nullptr, bool fCountFailure = false, bool manual_connection = false, std::unique_ptr<PendingProxyConnection>* pendingRet = nullptr);
+    CNode* CreateOutboundNode(SOCKET hSocket, const CAddress& addrConnect, const std::string& strDest);
+    void AddOutboundNode(CNode* pnode, CSemaphoreGrant* grantOutbound, bool fOneShot, bool fFeeler, bool manual_connection, bool masternode_connection, bool masternode_probe_connection);
+    /** Advance a pending proxy connection. Returns false when it is finished, fConnectedRet tells whether it succeeded. */
+    bool ProcessPendingProxyConnection(PendingProxyConnection& pending, bool fReady, int64_t nNowMillis, bool& fConnectedRet);
+    bool IsPendingProxyConnection(const CService& addr, bool fIPOnly) const;
+    bool IsPendingProxyConnection(const std::string& strDest) const;
     bool IsWhitelistedRange(const CNetAddr &addr);
 
     void DeleteNode(CNode* pnode);
 
     NodeId GetNewNodeId();
 
+    /** Moves queued messages to vSendMsg, highest priority first. Returns false if there is nothing to send. */
+    bool FillSendMsg(CNode* pnode);
     size_t SocketSendData(CNode *pnode);
     size_t SocketRecvData(CNode* pnode);
     //!check is the banlist has unwritten changes
@@ -556,6 +744,9 @@ private:
     CCriticalSection cs_totalBytesSent;
     uint64_t nTotalBytesRecv GUARDED_BY(cs_totalBytesRecv);
     uint64_t nTotalBytesSent GUARDED_BY(cs_totalBytesSent);
+    std::atomic<uint64_t> nTotalSendCalls{0};
+    CCriticalSection cs_totalProcessStats;
+    mapMsgCmdProcessStats mapTotalProcessStats GUARDED_BY(cs_totalProcessStats);
 
     // outbound limit & stats
     uint64_t nMaxOutboundTotalBytesSentInCycle GUARDED_BY(cs_totalBytesSent);
@@ -588,7 +779,13 @@ private:
     std::map<std::pair<Consensus::LLMQType, uint256>, std::set<uint256>> masternodeQuorumNodes; // protected by cs_vPendingMasternodes
     std::map<std::pair<Consensus::LLMQType, uint256>, std::set<uint256>> masternodeQuorumRelayMembers; // protected by cs_vPendingMasternodes
     std::set<uint256> masternodePendingProbes;
+    // Deduplicated union of all masternodeQuorumNodes sets, this is what ThreadOpenMasternodeConnections dials
+    std::set<uint256> masternodeQuorumDesired; // protected by cs_vPendingMasternodes
     mutable CCriticalSection cs_vPendingMasternodes;
+    std::list<std::unique_ptr<PendingProxyConnection>> lPendingProxyConnections GUARDED_BY(mutexPendingProxyConnections);
+    mutable std::mutex mutexPendingProxyConnections;
+    std::condition_variable condPendingProxyConnections;
+    CTxAnnouncementQueue txAnnouncementQueue;
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
     std::unordered_map<SOCKET, CNode*> mapSocketToNode;
@@ -613,8 +810,12 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
+    /** Number of threads processing peer messages */
+    int nMessageHandlerThreads;
+    bool fMasternodeFastTransport{false};
+
+    /** flags for waking the message processors, one per thread. */
+    std::vector<bool> vMsgProcWake GUARDED_BY(mutexMsgProc);
 
     std::condition_variable condMsgProc;
     std::mutex mutexMsgProc;
@@ -622,6 +823,11 @@ private:
 
     CThreadInterrupt interruptNet;
 
+    /** flag for waking ThreadOpenMasternodeConnections when new masternode connections are wanted */
+    bool fMasternodeConnWake GUARDED_BY(mutexMasternodeConn){false};
+    std::condition_variable condMasternodeConn;
+    std::mutex mutexMasternodeConn;
+
 #ifdef USE_WAKEUP_PIPE
     /** a pipe which is added to select() calls to wakeup before the timeout */
     int wakeupPipe[2]{-1,-1};
@@ -634,6 +840,8 @@ private:
 #endif
 #ifdef USE_EPOLL
     int epollfd{-1};
+    /** Events of peers returned by the last epoll_wait, only used by the socket handler thread */
+    std::vector<std::pair<CNode*, uint32_t>> vEpollNodeEvents;
 #endif
 
     /** Protected by cs_vNodes */
@@ -648,7 +856,8 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadOpenMasternodeConnections;
-    std::thread threadMessageHandler;
+    std::thread threadPendingProxyConnections;
+    std::vector<std::thread> threadMessageHandlers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -731,6 +940,8 @@ CAddress GetLocalAddress(const CNetAddr *paddrPeer, ServiceFlags nLocalServices)
 extern bool fDiscover;
 extern bool fListen;
 extern bool fRelayTxes;
+/** Whether received messages are written to <datadir>/message_capture (-capturemessages) */
+extern bool fCaptureMessages;
 
 /** Subversion as sent to the P2P network in `version` messages */
 extern std::string strSubVersion;
@@ -762,9 +973,14 @@ public:
     int nStartingHeight;
     uint64_t nSendBytes;
     mapMsgCmdSize mapSendBytesPerMsgCmd;
+    std::array<uint64_t, NUM_SEND_PRIORITIES> arrSendBytesPerPriority;
+    std::array<size_t, NUM_SEND_PRIORITIES> arrSendQueueSize;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdProcessStats mapProcessStatsPerMsgCmd;
     bool fWhitelisted;
+    uint64_t nAddrProcessed;
+    uint64_t nAddrRateLimited;
     double dPingTime;
     double dPingWait;
     double dMinPing;
@@ -784,18 +1000,59 @@ public:
 
 
 
+/**
+ * Keeps the buffers of processed CNetMessages around for reuse, so that receiving a message doesn't need to allocate
+ * (and zero on free) a fresh buffer every time. Buffers are kept in power of two size classes from MIN_BUFFER_SIZE to
+ * MAX_BUFFER_SIZE bytes of capacity, larger buffers (e.g. of big blocks) are freed. At most MAX_POOLED_BYTES are kept
+ * in the pool.
+ */
+class CNetMessageBufferPool
+{
+public:
+    static constexpr size_t MIN_BUFFER_SIZE = 256;
+    static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;
+    static constexpr size_t MAX_POOLED_BYTES = 4 * 1024 * 1024;
+
+private:
+    static constexpr size_t NUM_SIZE_CLASSES = 11; // 256 B ... 256 KiB
+    static_assert((MIN_BUFFER_SIZE << (NUM_SIZE_CLASSES - 1)) == MAX_BUFFER_SIZE, "size classes must cover MIN_BUFFER_SIZE to MAX_BUFFER_SIZE");
+
+    std::mutex mutex;
+    std::vector<CPublicSerializeData> vFree[NUM_SIZE_CLASSES];
+    size_t nPooledBytes{0};
+    uint64_t nHits{0};
+    uint64_t nMisses{0};
+
+public:
+    /** Returns the process wide pool */
+    static CNetMessageBufferPool& Instance();
+
+    /** Returns an empty buffer with a capacity of at least min(nSize, MAX_BUFFER_SIZE) bytes */
+    CPublicSerializeData Acquire(size_t nSize);
+    /** Hands a buffer back for reuse, its content is discarded */
+    void Release(CPublicSerializeData&& buf);
+
+    size_t GetPooledBytes();
+    /** Number of Acquire calls which were (not) served from the pool */
+    uint64_t GetHits();
+    uint64_t GetMisses();
+};
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
     mutable uint256 data_hash;
+
+    /** Hands the buffer of vRecv back to CNetMessageBufferPool */
+    void ReleaseBuffer();
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    CPublicDataStream hdrbuf;       // partially received header
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
-    CDataStream vRecv;              // received message data
+    CPublicDataStream vRecv;        // received message data
     unsigned int nDataPos;
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
@@ -808,6 +1065,15 @@ public:
         nTime = 0;
     }
 
+    CNetMessage(CNetMessage&& other) = default;
+    CNetMessage(const CNetMessage&) = delete;
+    CNetMessage& operator=(const CNetMessage&) = delete;
+
+    ~CNetMessage()
+    {
+        ReleaseBuffer();
+    }
+
     bool complete() const
     {
         if (!in_data)
@@ -836,14 +1102,23 @@ public:
     // socket
     std::atomic<ServiceFlags> nServices;
     SOCKET hSocket GUARDED_BY(cs_hSocket);
-    size_t nSendSize; // total size of all vSendMsg entries
+    size_t nSendSize; // total size of all vSendMsg and vSendMsgQueued entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend);
+    // (header, payload) pairs, which are waiting for being moved to vSendMsg
+    typedef std::pair<std::vector<unsigned char>, std::vector<unsigned char>> QueuedMessage;
+    std::array<std::deque<QueuedMessage>, NUM_SEND_PRIORITIES> vSendMsgQueued GUARDED_BY(cs_vSend);
+    // total size of the messages in each of the vSendMsgQueued queues
+    std::array<size_t, NUM_SEND_PRIORITIES> arrSendQueueSize GUARDED_BY(cs_vSend){};
+    // data which is handed to the socket next, in order
     std::list<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
-    std::atomic<size_t> nSendMsgSize;
+    std::atomic<size_t> nSendMsgSize; // number of vSendMsg entries and queued messages
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
+    // received messages are appended to this file with -capturemessages, opened with the first message
+    std::unique_ptr<CMessageCaptureWriter> captureWriter GUARDED_BY(cs_vRecv);
+    bool fCaptureFailed GUARDED_BY(cs_vRecv){false};
 
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
@@ -898,6 +1173,13 @@ public:
     bool m_masternode_probe_connection;
     // If 'true', we identified it as an intra-quorum relay connection
     bool m_masternode_iqr_connection{false};
+    // Set after a valid MNAUTH when -llmq-fast-transport is enabled. The message handler thread which processed the
+    // MNAUTH then hands the node over to the fast transport thread by setting fFastTransport.
+    std::atomic_bool fFastTransportPending{false};
+    std::atomic_bool fFastTransport{false};
+    // Set while the signature of the MNAUTH of this node is verified by the BLS worker, no later messages of the node
+    // are processed until then
+    std::atomic_bool fMNAuthPending{false};
     CSemaphoreGrant grantOutbound;
     CCriticalSection cs_filter;
     std::unique_ptr<CBloomFilter> pfilter PT_GUARDED_BY(cs_filter){nullptr};
@@ -914,25 +1196,34 @@ public:
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
+    std::array<uint64_t, NUM_SEND_PRIORITIES> arrSendBytesPerPriority GUARDED_BY(cs_vSend){};
     mapMsgCmdSize mapRecvBytesPerMsgCmd GUARDED_BY(cs_vRecv);
+    mapMsgCmdProcessStats mapProcessStatsPerMsgCmd GUARDED_BY(cs_vProcessMsg);
 
 public:
     uint256 hashContinue;
     std::atomic<int> nStartingHeight;
 
     // flood relay
-    std::vector<CAddress> vAddrToSend;
-    CRollingBloomFilter addrKnown;
+    // Addresses may be pushed by the message handler threads of other peers, so protect them by a lock
+    CCriticalSection cs_addrToSend;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(cs_addrToSend);
+    CRollingBloomFilter addrKnown GUARDED_BY(cs_addrToSend);
     bool fGetAddr;
+    // Addr rate limiting, only used by the message handler thread: tokens for processing addresses received from the
+    // peer, refilled over time and when we ask for addresses with GETADDR
+    double nAddrTokenBucket{1.0};
+    int64_t nAddrTokenTimestamp{GetTimeMicros()};
+    // Addresses received from the peer which were processed or dropped by the rate limiting
+    std::atomic<uint64_t> nAddrProcessed{0};
+    std::atomic<uint64_t> nAddrRateLimited{0};
     std::set<uint256> setKnown;
     int64_t nNextAddrSend GUARDED_BY(cs_sendProcessing);
     int64_t nNextLocalAddrSend GUARDED_BY(cs_sendProcessing);
 
     // inventory based relay
     CRollingBloomFilter filterInventoryKnown GUARDED_BY(cs_inventory);
-    // Set of transaction ids we still have to announce.
-    // They are sorted by the mempool before relay, so the order is not important.
-    std::set<uint256> setInventoryTxToSend;
+    // Transactions to announce are taken from CConnman's CTxAnnouncementQueue
     // List of block ids we still have announce.
     // There is no final sorting before sending, as they are always sent immediately
     // and in the order requested.
@@ -1023,6 +1314,8 @@ public:
     }
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
+    /** Append a complete received message to the capture file of this peer */
+    void CaptureMessage(const CNetMessage& msg);
 
     void SetRecvVersion(int nVersionIn)
     {
@@ -1054,6 +1347,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrToSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -1062,6 +1356,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrToSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
@@ -1088,14 +1383,7 @@ public:
     void PushInventory(const CInv& inv)
     {
         LOCK(cs_inventory);
-        if (inv.type == MSG_TX || inv.type == MSG_DSTX) {
-            if (!filterInventoryKnown.contains(inv.hash)) {
-                LogPrint(BCLog::NET, "PushInventory --  inv: %s peer=%d\n", inv.ToString(), id);
-                setInventoryTxToSend.insert(inv.hash);
-            } else {
-                LogPrint(BCLog::NET, "PushInventory --  filtered inv: %s peer=%d\n", inv.ToString(), id);
-            }
-        } else if (inv.type == MSG_BLOCK) {
+        if (inv.type == MSG_BLOCK) {
             LogPrint(BCLog::NET, "PushInventory --  inv: %s peer=%d\n", inv.ToString(), id);
             vInventoryBlockToSend.push_back(inv.hash);
         } else {
@@ -1117,6 +1405,7 @@ public:
     void CloseSocketDisconnect(CConnman* connman);
 
     void copyStats(CNodeStats &stats);
+    void RecordMsgProcessTime(const std::string& strCommand, int64_t nTime, int64_t nCPUTime);
 
     ServiceFlags GetLocalServices() const
     {
@@ -11,6 +11,7 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
@@ -21,6 +22,7 @@
 #include <primitives/transaction.h>
 #include <random.h>
 #include <reverse_iterator.h>
+#include <saltedhasher.h>
 #include <scheduler.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -30,7 +32,10 @@
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 
+#include <future>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <spork.h>
 #include <governance/governance.h>
@@ -55,6 +60,8 @@
 
 #include <statsd_client.h>
 
+#include <ctpl.h>
+
 #if defined(NDEBUG)
 # error "Dash Core cannot be compiled without assertions."
 #endif
@@ -75,6 +82,14 @@ static_assert(INBOUND_PEER_TX_DELAY >= MAX_GETDATA_RANDOM_DELAY,
 "To preserve security, MAX_GETDATA_RANDOM_DELAY should not exceed INBOUND_PEER_DELAY");
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
+/** Number of objects announced by short ids to a peer which can still be requested via GETSHORTDATA */
+static const size_t MAX_SHORT_INV_ANNOUNCED = 10000;
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static constexpr int CFCHECKPT_INTERVAL = 1000;
 
 /** Expiration time for orphan transactions in seconds */
 static constexpr int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
@@ -98,12 +113,24 @@ static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
 /** SHA256("main address relay")[0:8] */
 static constexpr uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL;
+/** The average rate at which addresses from a peer are processed, in addresses per second. Addresses received beyond
+ *  that (and the tokens granted by our GETADDR) are dropped, unless the peer is whitelisted. */
+static constexpr double MAX_ADDR_RATE_PER_SECOND = 0.1;
+/** The maximum number of address processing tokens a peer can accumulate, so it can send one full ADDR message after
+ *  being quiet for a long time */
+static constexpr size_t MAX_ADDR_PROCESSING_TOKEN_BUCKET = MAX_ADDR_TO_SEND;
 /// Age after which a stale block will no longer be served if requested as
 /// protection against fingerprinting. Set to one month, denominated in seconds.
 static constexpr int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 /// Age after which a block is considered historical for purposes of rate
 /// limiting block relay. Set to one week, denominated in seconds.
 static constexpr int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
+/** Minimum number of headers in a HEADERS message before their hashes are computed on the header hashing threads */
+static constexpr size_t MIN_HEADERS_FOR_PARALLEL_HASHING = 64;
+/** Minimum number of transactions in a new block before it is matched in advance against the bloom filters of peers */
+static constexpr size_t MIN_TXS_FOR_PRECOMPUTED_MERKLE_BLOCKS = 16;
+/** Maximum number of orphans from the work set of a peer which are tried with one lock of cs_main */
+static constexpr size_t MAX_ORPHANS_PER_PROCESSING_BATCH = 16;
 
 struct COrphanTx {
     // When modifying, adapt the copy of this definition in tests/DoS_tests.
@@ -111,9 +138,20 @@ struct COrphanTx {
     NodeId fromPeer;
     int64_t nTimeExpire;
     size_t nTxSize;
+    size_t list_pos;
 };
+typedef std::unordered_map<uint256, COrphanTx, StaticSaltedHasher> OrphanMap;
 static CCriticalSection g_cs_orphans;
-std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(g_cs_orphans);
+OrphanMap mapOrphanTransactions GUARDED_BY(g_cs_orphans);
+//! All orphans in no particular order, to evict a random one in constant time (COrphanTx::list_pos is the position)
+static std::vector<OrphanMap::iterator> g_orphan_list GUARDED_BY(g_cs_orphans);
+
+//! Number and total size of the orphans each peer gave us
+struct COrphanPeerStats {
+    size_t nCount{0};
+    size_t nSize{0};
+};
+static std::unordered_map<NodeId, COrphanPeerStats> mapOrphanStatsByPeer GUARDED_BY(g_cs_orphans);
 
 size_t nMapOrphanTransactionsSize = 0;
 void EraseOrphansFor(NodeId peer);
@@ -165,6 +203,33 @@ namespace {
      * Memory used: 1.3MB
      */
     std::unique_ptr<CRollingBloomFilter> recentRejects GUARDED_BY(cs_main);
+
+    /**
+     * Worker threads which compute the (X11) hashes of received headers, which is the expensive part of the
+     * context-free header checks. Shared by the message handler threads and only used while not holding cs_main.
+     */
+    std::unique_ptr<ctpl::thread_pool> headerHashPool;
+
+    /**
+     * Worker threads which match new blocks against the bloom filters of SPV peers, see PrecomputeMerkleBlocks().
+     * Only created when bloom filters are supported.
+     */
+    std::unique_ptr<ctpl::thread_pool> bloomMatchPool;
+
+    /**
+     * A merkle block of the most recent block, matched against a copy of the bloom filter of a peer before the peer
+     * asked for it. It is only used if the filter of the peer still equals filterBefore, in which case filterAfter
+     * is exactly the state matching on the live filter would have produced.
+     */
+    struct PrecomputedMerkleBlock {
+        uint256 hashBlock;
+        bool fReady{false};
+        CBloomFilter filterBefore;
+        CBloomFilter filterAfter;
+        CMerkleBlock merkleBlock;
+    };
+    CCriticalSection cs_precomputed_merkle_blocks;
+    std::map<NodeId, PrecomputedMerkleBlock> mapPrecomputedMerkleBlocks GUARDED_BY(cs_precomputed_merkle_blocks);
     uint256 hashRecentRejectsChainTip GUARDED_BY(cs_main);
 
     /** Blocks that are in flight, and that are in the queue to be downloaded. */
@@ -173,6 +238,7 @@ namespace {
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
+        int64_t nTimeRequested;                                  //!< When the block was requested (in microseconds).
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight GUARDED_BY(cs_main);
 
@@ -207,10 +273,12 @@ namespace {
             return &(*a) < &(*b);
         }
     };
-    std::map<COutPoint, std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>> mapOrphanTransactionsByPrev GUARDED_BY(g_cs_orphans);
+    std::unordered_map<COutPoint, std::set<OrphanMap::iterator, IteratorComparator>, SaltedOutpointHasher> mapOrphanTransactionsByPrev GUARDED_BY(g_cs_orphans);
 
     static size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
     static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
+
+    CompactBlockReconstructionStats g_compact_block_stats GUARDED_BY(cs_main);
 } // namespace
 
 namespace {
@@ -260,6 +328,14 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Smoothed time (in microseconds) it takes this peer to deliver one more block while blocks are in flight, or 0.
+    int64_t nBlockDeliveryInterval;
+    //! Smoothed time (in microseconds) between requesting a block from this peer and receiving it, or 0.
+    int64_t nBlockDownloadLatency;
+    //! When we received the last requested block from this peer (in microseconds).
+    int64_t nLastBlockDeliveryTime;
+    //! How many blocks we're willing to have in flight from this peer during parallel block download.
+    int nBlocksInTransitLimit;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -367,6 +443,31 @@ struct CNodeState {
 
     ObjectDownloadState m_object_download;
 
+    //! Whether this peer wants LLMQ objects to be announced by short ids (SENDSHORTINV), and the salt to use for it
+    bool m_wants_short_inv{false};
+    uint64_t m_short_inv_salt{0};
+    //! Objects announced by short ids to this peer, so that GETSHORTDATA can be resolved (oldest first)
+    std::map<uint64_t, CInv> m_short_inv_announced;
+    std::deque<uint64_t> m_short_inv_announced_order;
+
+    /*
+     * Objects announced by short ids by this peer are requested the same way as other objects (see
+     * ObjectDownloadState): every announcing peer queues the short id, and only the first one in line requests it.
+     * The others re-check after GetObjectInterval and request it themselves if it didn't arrive in the meantime.
+     */
+    struct ShortInvDownloadState {
+        //! Track when to attempt download of announced short ids (process time in micros -> short inv)
+        std::multimap<std::chrono::microseconds, CShortInv> m_short_inv_process_time;
+
+        //! Short ids (-> inv type) this peer recently announced and which we didn't receive yet
+        std::map<uint64_t, int> m_short_inv_announced;
+
+        //! Short ids which were requested from this peer, with timestamp
+        std::map<uint64_t, std::chrono::microseconds> m_short_inv_in_flight;
+    };
+
+    ShortInvDownloadState m_short_inv_download;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -382,6 +483,10 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlockDeliveryInterval = 0;
+        nBlockDownloadLatency = 0;
+        nLastBlockDeliveryTime = 0;
+        nBlocksInTransitLimit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -396,6 +501,15 @@ struct CNodeState {
 unordered_limitedmap<uint256, std::chrono::microseconds, StaticSaltedHasher> g_already_asked_for(MAX_INV_SZ, MAX_INV_SZ * 2);
 unordered_limitedmap<uint256, std::chrono::microseconds, StaticSaltedHasher> g_erased_object_requests(MAX_INV_SZ, MAX_INV_SZ * 2);
 
+/** Salt for the short ids our peers use to announce LLMQ objects to us. The same salt is given to all peers, so
+ * that announcements of the same object by multiple peers can be recognized and the object is only requested once */
+uint64_t g_short_inv_salt GUARDED_BY(cs_main){0};
+/** Short ids (with g_short_inv_salt) of the LLMQ objects we have, with the time they were added. This is an exact set
+ * and not a bloom filter, as a false positive would make us ignore the object from all peers which announce it */
+unordered_limitedmap<uint64_t, std::chrono::microseconds> g_short_inv_known GUARDED_BY(cs_main)(50000, 60000);
+/** Short ids which were requested via GETSHORTDATA, with the time of the last request */
+unordered_limitedmap<uint64_t, std::chrono::microseconds> g_short_inv_in_flight GUARDED_BY(cs_main)(MAX_INV_SZ, MAX_INV_SZ * 2);
+
 /** Map maintaining per-node state. */
 static std::map<NodeId, CNodeState> mapNodeState GUARDED_BY(cs_main);
 
@@ -495,7 +609,7 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex *
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr)});
+            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr), GetTimeMicros()});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -511,6 +625,74 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex *
     return true;
 }
 
+/**
+ * Update the block delivery statistics of a peer which sent us a block we requested from it, and derive how many
+ * blocks we're willing to have in flight from it. The limit covers the bandwidth-delay product of the peer (blocks it
+ * delivers per ping round trip) twice, so that the measured delivery rate is not capped by the limit itself.
+ */
+void UpdateBlockDeliveryStats(CNode* pfrom, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    auto itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId()) {
+        return;
+    }
+    CNodeState *state = State(pfrom->GetId());
+    assert(state != nullptr);
+
+    int64_t nNow = GetTimeMicros();
+    int64_t nTimeRequested = itInFlight->second.second->nTimeRequested;
+    // While other blocks were still in flight, the time since the previous delivery is how long the peer needed for
+    // this one. Otherwise the peer was idle in between and only the time since the request counts.
+    int64_t nInterval = std::max<int64_t>(nNow - std::max(nTimeRequested, state->nLastBlockDeliveryTime), 1);
+    int64_t nLatency = std::max<int64_t>(nNow - nTimeRequested, 1);
+    state->nLastBlockDeliveryTime = nNow;
+    auto smooth = [](int64_t nOld, int64_t nSample) { return nOld == 0 ? nSample : (nOld * 7 + nSample) / 8; };
+    state->nBlockDeliveryInterval = smooth(state->nBlockDeliveryInterval, nInterval);
+    state->nBlockDownloadLatency = smooth(state->nBlockDownloadLatency, nLatency);
+
+    int64_t nPingUsec = pfrom->nMinPingUsecTime;
+    if (nPingUsec <= 0 || nPingUsec == std::numeric_limits<int64_t>::max()) {
+        // no ping measured yet
+        return;
+    }
+    int64_t nLimit = MAX_BLOCKS_IN_TRANSIT_PER_PEER + 2 * nPingUsec / state->nBlockDeliveryInterval;
+    state->nBlocksInTransitLimit = (int)std::min<int64_t>(nLimit, MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE);
+}
+
+/** The block download window grows with the number of blocks all our peers together can have in transit. */
+unsigned int GetBlockDownloadWindow() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    int64_t nTotalLimit = 0;
+    for (const auto& entry : mapNodeState) {
+        nTotalLimit += entry.second.nBlocksInTransitLimit;
+    }
+    // The default window is sized for 8 peers with the default number of blocks in transit
+    int64_t nWindow = nTotalLimit * BLOCK_DOWNLOAD_WINDOW / (8 * MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    return (unsigned int)std::max<int64_t>(BLOCK_DOWNLOAD_WINDOW, std::min<int64_t>(nWindow, MAX_BLOCK_DOWNLOAD_WINDOW));
+}
+
+/**
+ * Whether a block which is in flight from the peer stalling our download window should rather be downloaded from
+ * another peer. This is only done if the other peer measurably delivers at least twice as fast, and the block has
+ * been in flight for longer than the other peer usually needs to deliver one.
+ */
+bool ShouldReassignStallingBlock(const CNodeState& state, NodeId staller, const uint256& hash, int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    if (state.nBlockDeliveryInterval == 0) {
+        // We don't know how fast this peer is
+        return false;
+    }
+    auto itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != staller || itInFlight->second.second->partialBlock) {
+        return false;
+    }
+    const CNodeState* stallerState = State(staller);
+    if (stallerState == nullptr) {
+        return false;
+    }
+    if (stallerState->nBlockDeliveryInterval != 0 && stallerState->nBlockDeliveryInterval < 2 * state.nBlockDeliveryInterval) {
+        return false;
+    }
+    return nNow - itInFlight->second.second->nTimeRequested > 2 * state.nBlockDownloadLatency;
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -612,8 +794,9 @@ bool PeerHasHeader(CNodeState *state, const CBlockIndex *pindex) EXCLUSIVE_LOCKS
 }
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
-void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+ *  at most count entries. If the download window can't move, nodeStaller and (if given) pindexStalling are set to
+ *  the peer and the block holding it back. */
+void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams, const CBlockIndex** pindexStalling = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (count == 0)
         return;
@@ -644,12 +827,13 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
 
     std::vector<const CBlockIndex*> vToFetch;
     const CBlockIndex *pindexWalk = state->pindexLastCommonBlock;
-    // Never fetch further than the best block we know the peer has, or more than BLOCK_DOWNLOAD_WINDOW + 1 beyond the last
+    // Never fetch further than the best block we know the peer has, or more than the download window + 1 beyond the last
     // linked block we have in common with this peer. The +1 is so we can detect stalling, namely if we would be able to
     // download that next block if the window were 1 larger.
-    int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
+    int nWindowEnd = state->pindexLastCommonBlock->nHeight + GetBlockDownloadWindow();
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* pindexWaitingFor = nullptr;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -681,6 +865,9 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        if (pindexStalling) {
+                            *pindexStalling = pindexWaitingFor;
+                        }
                     }
                     return;
                 }
@@ -691,18 +878,79 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
 }
+
+/** Add not-in-flight blocks below the base of a loaded UTXO snapshot to vBlocks, in the order they are validated, until
+ *  it has at most count entries. The window starts at the last validated block and only peers which know the base are
+ *  asked. */
+void FindNextSnapshotBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (count == 0)
+        return;
+
+    SnapshotValidationProgress progress = GetSnapshotValidationProgress();
+    if (progress.pindexBase == nullptr)
+        return;
+
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+    if (state->pindexBestKnownBlock == nullptr || state->pindexBestKnownBlock->GetAncestor(progress.pindexBase->nHeight) != progress.pindexBase)
+        return;
+
+    std::vector<const CBlockIndex*> vWindow;
+    int nWindowEnd = std::min<int>(progress.pindexBase->nHeight, progress.nValidatedHeight + GetBlockDownloadWindow());
+    for (const CBlockIndex* pindex = progress.pindexBase->GetAncestor(nWindowEnd); pindex && pindex->nHeight > progress.nValidatedHeight; pindex = pindex->pprev) {
+        vWindow.push_back(pindex);
+    }
+    for (auto it = vWindow.rbegin(); it != vWindow.rend(); ++it) {
+        const CBlockIndex* pindex = *it;
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA) && mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
+            vBlocks.push_back(pindex);
+            if (vBlocks.size() == count)
+                return;
+        }
+    }
+}
 } // namespace
 
+static bool IsShortInvType(int invType)
+{
+    return invType == MSG_QUORUM_RECOVERED_SIG || invType == MSG_CLSIG || invType == MSG_ISLOCK;
+}
+
+static uint64_t GetShortInvId(uint64_t salt, const CInv& inv)
+{
+    return CSipHasher(salt, inv.type).Write(inv.hash.begin(), inv.hash.size()).Finalize();
+}
+
+// Remember that we have this object, so that announcements of it by short id are ignored
+static void MarkShortInvKnown(CNodeState* nodestate, const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    if (!IsShortInvType(inv.type)) {
+        return;
+    }
+    const uint64_t shortId = GetShortInvId(g_short_inv_salt, inv);
+    g_short_inv_known.insert_or_update(std::make_pair(shortId, GetTime<std::chrono::microseconds>()));
+    g_short_inv_in_flight.erase(shortId);
+
+    if (nodestate) {
+        nodestate->m_short_inv_download.m_short_inv_announced.erase(shortId);
+        nodestate->m_short_inv_download.m_short_inv_in_flight.erase(shortId);
+    }
+}
+
 void EraseObjectRequest(CNodeState* nodestate, const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
     LogPrint(BCLog::NET, "%s -- inv=(%s)\n", __func__, inv.ToString());
     g_already_asked_for.erase(inv.hash);
     g_erased_object_requests.insert(std::make_pair(inv.hash, GetTime<std::chrono::microseconds>()));
+    MarkShortInvKnown(nodestate, inv);
 
     if (nodestate) {
         nodestate->m_object_download.m_object_announced.erase(inv);
@@ -828,6 +1076,27 @@ void RequestObject(NodeId nodeId, const CInv& inv, std::chrono::microseconds cur
     RequestObject(state, inv, current_time, fForce);
 }
 
+void RequestShortInv(CNodeState* state, const CShortInv& shortInv, std::chrono::microseconds current_time) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    CNodeState::ShortInvDownloadState& peer_download_state = state->m_short_inv_download;
+    if (peer_download_state.m_short_inv_announced.size() >= MAX_PEER_OBJECT_ANNOUNCEMENTS ||
+            peer_download_state.m_short_inv_process_time.size() >= MAX_PEER_OBJECT_ANNOUNCEMENTS ||
+            !peer_download_state.m_short_inv_announced.emplace(shortInv.shortId, shortInv.type).second) {
+        // Too many queued announcements from this peer, or we already have
+        // this announcement
+        return;
+    }
+
+    // Request right away if nobody else was asked yet, otherwise give the peer which was asked last some time to answer
+    std::chrono::microseconds process_time = current_time;
+    auto it = g_short_inv_in_flight.find(shortInv.shortId);
+    if (it != g_short_inv_in_flight.end()) {
+        process_time = std::max(process_time, it->second + GetObjectInterval(shortInv.type));
+    }
+    peer_download_state.m_short_inv_process_time.emplace(process_time, shortInv);
+}
+
 size_t GetRequestedObjectCount(NodeId nodeId)
 {
     AssertLockHeld(cs_main);
@@ -862,12 +1131,14 @@ void PeerLogicValidation::InitializeNode(CNode *pnode) {
         LOCK(cs_main);
         mapNodeState.emplace_hint(mapNodeState.end(), std::piecewise_construct, std::forward_as_tuple(nodeid), std::forward_as_tuple(addr, std::move(addrName)));
     }
+    connman->GetTxAnnouncementQueue().AddPeer(nodeid);
     if(!pnode->fInbound)
         PushNodeVersion(pnode, connman, GetTime());
 }
 
 void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
     fUpdateConnectionTime = false;
+    connman->GetTxAnnouncementQueue().RemovePeer(nodeid);
     LOCK(cs_main);
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -883,6 +1154,10 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
         mapBlocksInFlight.erase(entry.hash);
     }
     EraseOrphansFor(nodeid);
+    {
+        LOCK(cs_precomputed_merkle_blocks);
+        mapPrecomputedMerkleBlocks.erase(nodeid);
+    }
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
@@ -913,9 +1188,40 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksInTransitLimit = state->nBlocksInTransitLimit;
+    stats.nBlockDeliveryInterval = state->nBlockDeliveryInterval;
+    {
+        LOCK(g_cs_orphans);
+        auto it = mapOrphanStatsByPeer.find(nodeid);
+        if (it != mapOrphanStatsByPeer.end()) {
+            stats.nOrphans = it->second.nCount;
+            stats.nOrphansSize = it->second.nSize;
+        }
+    }
     return true;
 }
 
+CompactBlockReconstructionStats GetCompactBlockReconstructionStats() {
+    LOCK(cs_main);
+    return g_compact_block_stats;
+}
+
+static void RecordCompactBlockReconstruction(const PartiallyDownloadedBlock& partialBlock, size_t nRequested) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    // The per-source counters are lower bounds (see PartiallyDownloadedBlock::InitData), so don't let them underflow
+    // the mempool counter
+    size_t nFromPools = partialBlock.GetExtraCount() + partialBlock.GetISLockCount();
+    g_compact_block_stats.nBlocks++;
+    if (nRequested == 0) {
+        g_compact_block_stats.nBlocksWithoutRoundTrip++;
+    }
+    g_compact_block_stats.nTxPrefilled += partialBlock.GetPrefilledCount();
+    g_compact_block_stats.nTxFromMempool += partialBlock.GetMempoolCount() > nFromPools ? partialBlock.GetMempoolCount() - nFromPools : 0;
+    g_compact_block_stats.nTxFromExtra += partialBlock.GetExtraCount();
+    g_compact_block_stats.nTxFromISLock += partialBlock.GetISLockCount();
+    g_compact_block_stats.nTxRequested += nRequested;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // mapOrphanTransactions
@@ -952,8 +1258,9 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
         return false;
     }
 
-    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz});
+    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz, g_orphan_list.size()});
     assert(ret.second);
+    g_orphan_list.push_back(ret.first);
     for (const CTxIn& txin : tx->vin) {
         mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
     }
@@ -961,6 +1268,9 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
     AddToCompactExtraTransactions(tx);
 
     nMapOrphanTransactionsSize += sz;
+    COrphanPeerStats& peerStats = mapOrphanStatsByPeer[peer];
+    peerStats.nCount++;
+    peerStats.nSize += sz;
 
     LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
              mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
@@ -971,7 +1281,7 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
 
 int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 {
-    std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
+    OrphanMap::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return 0;
     for (const CTxIn& txin : it->second.tx->vin)
@@ -985,6 +1295,24 @@ int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
     }
     assert(nMapOrphanTransactionsSize >= it->second.nTxSize);
     nMapOrphanTransactionsSize -= it->second.nTxSize;
+
+    auto itPeer = mapOrphanStatsByPeer.find(it->second.fromPeer);
+    assert(itPeer != mapOrphanStatsByPeer.end() && itPeer->second.nSize >= it->second.nTxSize);
+    itPeer->second.nSize -= it->second.nTxSize;
+    if (--itPeer->second.nCount == 0) {
+        mapOrphanStatsByPeer.erase(itPeer);
+    }
+
+    // Move the last orphan of g_orphan_list into the position of the erased one
+    size_t old_pos = it->second.list_pos;
+    assert(g_orphan_list[old_pos] == it);
+    if (old_pos + 1 != g_orphan_list.size()) {
+        OrphanMap::iterator it_last = g_orphan_list.back();
+        g_orphan_list[old_pos] = it_last;
+        it_last->second.list_pos = old_pos;
+    }
+    g_orphan_list.pop_back();
+
     mapOrphanTransactions.erase(it);
     statsClient.inc("transactions.orphans.remove", 1.0f);
     statsClient.gauge("transactions.orphans", mapOrphanTransactions.size());
@@ -994,11 +1322,15 @@ int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 void EraseOrphansFor(NodeId peer)
 {
     LOCK(g_cs_orphans);
+    // Most peers never gave us an orphan, don't scan the whole pool for them
+    if (!mapOrphanStatsByPeer.count(peer)) {
+        return;
+    }
     int nErased = 0;
-    std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
+    OrphanMap::iterator iter = mapOrphanTransactions.begin();
     while (iter != mapOrphanTransactions.end())
     {
-        std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
+        OrphanMap::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
         if (maybeErase->second.fromPeer == peer)
         {
             nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
@@ -1019,10 +1351,10 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphansSize)
         // Sweep out expired orphan pool entries:
         int nErased = 0;
         int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
+        OrphanMap::iterator iter = mapOrphanTransactions.begin();
         while (iter != mapOrphanTransactions.end())
         {
-            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
+            OrphanMap::iterator maybeErase = iter++;
             if (maybeErase->second.nTimeExpire <= nNow) {
                 nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
             } else {
@@ -1033,20 +1365,23 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphansSize)
         nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n", nErased);
     }
+    FastRandomContext rng;
     while (!mapOrphanTransactions.empty() && nMapOrphanTransactionsSize > nMaxOrphansSize)
     {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
+        // Evict a random orphan, out of two random candidates the one whose peer uses more of the pool, so that a peer
+        // flooding us with orphans mostly evicts its own
+        OrphanMap::iterator it = g_orphan_list[rng.randrange(g_orphan_list.size())];
+        OrphanMap::iterator it2 = g_orphan_list[rng.randrange(g_orphan_list.size())];
+        if (mapOrphanStatsByPeer.at(it2->second.fromPeer).nSize > mapOrphanStatsByPeer.at(it->second.fromPeer).nSize) {
+            it = it2;
+        }
         EraseOrphanTx(it->first);
         ++nEvicted;
     }
     return nEvicted;
 }
 
-void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans);
+void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set) LOCKS_EXCLUDED(cs_main, g_cs_orphans);
 
 /**
  * Mark a misbehaving peer to be banned depending upon the value of `-banscore`.
@@ -1114,6 +1449,21 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
 
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    {
+        LOCK(cs_main);
+        g_short_inv_salt = GetRand(std::numeric_limits<uint64_t>::max());
+    }
+
+    // Use as many threads for header hashing as for script verification
+    if (nScriptCheckThreads > 0) {
+        headerHashPool.reset(new ctpl::thread_pool(nScriptCheckThreads));
+        RenameThreadPool(*headerHashPool, "dash-hdrhash");
+
+        if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS)) {
+            bloomMatchPool.reset(new ctpl::thread_pool(nScriptCheckThreads));
+            RenameThreadPool(*bloomMatchPool, "dash-bloom");
+        }
+    }
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -1121,7 +1471,20 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000,
+                            CScheduler::Priority::NORMAL, "stalecheck");
+}
+
+PeerLogicValidation::~PeerLogicValidation()
+{
+    if (headerHashPool) {
+        headerHashPool->stop(true);
+        headerHashPool.reset();
+    }
+    if (bloomMatchPool) {
+        bloomMatchPool->stop(true);
+        bloomMatchPool.reset();
+    }
 }
 
 /**
@@ -1129,42 +1492,45 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
  * block. Also save the time of the last tip update.
  */
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) {
-    LOCK2(cs_main, g_cs_orphans);
-
-    std::vector<uint256> vOrphanErase;
     std::set<uint256> orphanWorkSet;
 
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        const CTransaction& tx = *ptx;
+    {
+        LOCK(g_cs_orphans);
+
+        std::vector<uint256> vOrphanErase;
+
+        for (const CTransactionRef& ptx : pblock->vtx) {
+            const CTransaction& tx = *ptx;
 
-        // Which orphan pool entries we should reprocess and potentially try to accept into mempool again?
-        for (size_t i = 0; i < tx.vin.size(); i++) {
-            auto itByPrev = mapOrphanTransactionsByPrev.find(COutPoint(tx.GetHash(), (uint32_t)i));
-            if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-            for (const auto& elem : itByPrev->second) {
-                orphanWorkSet.insert(elem->first);
+            // Which orphan pool entries we should reprocess and potentially try to accept into mempool again?
+            for (size_t i = 0; i < tx.vin.size(); i++) {
+                auto itByPrev = mapOrphanTransactionsByPrev.find(COutPoint(tx.GetHash(), (uint32_t)i));
+                if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
+                for (const auto& elem : itByPrev->second) {
+                    orphanWorkSet.insert(elem->first);
+                }
             }
-        }
 
-        // Which orphan pool entries must we evict?
-        for (const auto& txin : tx.vin) {
-            auto itByPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-            if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-            for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-                const CTransaction& orphanTx = *(*mi)->second.tx;
-                const uint256& orphanHash = orphanTx.GetHash();
-                vOrphanErase.push_back(orphanHash);
+            // Which orphan pool entries must we evict?
+            for (const auto& txin : tx.vin) {
+                auto itByPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
+                if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
+                for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
+                    const CTransaction& orphanTx = *(*mi)->second.tx;
+                    const uint256& orphanHash = orphanTx.GetHash();
+                    vOrphanErase.push_back(orphanHash);
+                }
             }
         }
-    }
 
-    // Erase orphan transactions included or precluded by this block
-    if (vOrphanErase.size()) {
-        int nErased = 0;
-        for (uint256 &orphanHash : vOrphanErase) {
-            nErased += EraseOrphanTx(orphanHash);
+        // Erase orphan transactions included or precluded by this block
+        if (vOrphanErase.size()) {
+            int nErased = 0;
+            for (uint256 &orphanHash : vOrphanErase) {
+                nErased += EraseOrphanTx(orphanHash);
+            }
+            LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx included or conflicted by block\n", nErased);
         }
-        LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx included or conflicted by block\n", nErased);
     }
 
     while (!orphanWorkSet.empty()) {
@@ -1175,12 +1541,108 @@ void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pb
     g_last_tip_update = GetTime();
 }
 
+/**
+ * Keep TXs which left the mempool for other reasons than being mined (e.g. expiry, size limiting or a reorg) around
+ * for compact block reconstruction, as other miners might still include them.
+ */
+void PeerLogicValidation::TransactionRemovedFromMempool(const CTransactionRef& ptx, MemPoolRemovalReason reason) {
+    if (reason == MemPoolRemovalReason::CONFLICT) {
+        // conflicts with an already mined TX, so it can't end up in a block anymore
+        return;
+    }
+    if (RecursiveDynamicUsage(*ptx) >= 100000) {
+        return;
+    }
+    LOCK(g_cs_orphans);
+    AddToCompactExtraTransactions(ptx);
+}
+
 // All of the following cache a recent block, and are protected by cs_most_recent_block
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent_block);
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
 
+/**
+ * Match a new block against the bloom filters of all SPV peers on the bloom matching threads, so that the expected
+ * filtered block requests for it don't have to do this one peer after the other on the message handler thread.
+ * Peers are matched in one batch per worker thread. Matching happens on copies of the filters, the results are
+ * picked up by TakePrecomputedMerkleBlock().
+ */
+static void PrecomputeMerkleBlocks(CConnman* connman, const std::shared_ptr<const CBlock>& pblock, const uint256& hashBlock)
+{
+    if (!bloomMatchPool || pblock->vtx.size() < MIN_TXS_FOR_PRECOMPUTED_MERKLE_BLOCKS) {
+        return;
+    }
+
+    auto jobs = std::make_shared<std::vector<std::pair<NodeId, CBloomFilter>>>();
+    connman->ForEachNode([&jobs](CNode* pnode) {
+        if (pnode->fDisconnect) {
+            return;
+        }
+        LOCK(pnode->cs_filter);
+        if (pnode->pfilter) {
+            jobs->emplace_back(pnode->GetId(), *pnode->pfilter);
+        }
+    });
+    if (jobs->empty()) {
+        return;
+    }
+
+    {
+        LOCK(cs_precomputed_merkle_blocks);
+        for (const auto& job : *jobs) {
+            PrecomputedMerkleBlock& entry = mapPrecomputedMerkleBlocks[job.first];
+            entry = PrecomputedMerkleBlock();
+            entry.hashBlock = hashBlock;
+            entry.filterBefore = job.second;
+        }
+    }
+
+    size_t nChunks = std::min((size_t)bloomMatchPool->size(), jobs->size());
+    size_t nChunkSize = (jobs->size() + nChunks - 1) / nChunks;
+    for (size_t begin = 0; begin < jobs->size(); begin += nChunkSize) {
+        size_t end = std::min(begin + nChunkSize, jobs->size());
+        bloomMatchPool->push([jobs, pblock, hashBlock, begin, end](int threadId) {
+            for (size_t i = begin; i < end; i++) {
+                CBloomFilter& filter = (*jobs)[i].second;
+                CMerkleBlock merkleBlock(*pblock, filter);
+
+                LOCK(cs_precomputed_merkle_blocks);
+                auto it = mapPrecomputedMerkleBlocks.find((*jobs)[i].first);
+                if (it == mapPrecomputedMerkleBlocks.end() || it->second.hashBlock != hashBlock) {
+                    // peer disconnected or a newer block is being matched already
+                    continue;
+                }
+                it->second.filterAfter = std::move(filter);
+                it->second.merkleBlock = std::move(merkleBlock);
+                it->second.fReady = true;
+            }
+        });
+    }
+}
+
+/**
+ * Use the merkle block precomputed for a peer if it is for the requested block and the filter of the peer did not
+ * change in between. Updates the filter as matching it would have done.
+ */
+static bool TakePrecomputedMerkleBlock(NodeId nodeid, const uint256& hashBlock, CBloomFilter& filter, CMerkleBlock& merkleBlockRet)
+{
+    LOCK(cs_precomputed_merkle_blocks);
+    auto it = mapPrecomputedMerkleBlocks.find(nodeid);
+    if (it == mapPrecomputedMerkleBlocks.end() || it->second.hashBlock != hashBlock) {
+        return false;
+    }
+    // Whatever happens, the filter of the peer changes from here on, so the entry becomes useless
+    bool fUsable = it->second.fReady && it->second.filterBefore == filter;
+    if (fUsable) {
+        filter = std::move(it->second.filterAfter);
+        merkleBlockRet = std::move(it->second.merkleBlock);
+    }
+    mapPrecomputedMerkleBlocks.erase(it);
+    return fUsable;
+}
+
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
  * to compatible peers.
@@ -1205,6 +1667,8 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         most_recent_compact_block = pcmpctblock;
     }
 
+    PrecomputeMerkleBlocks(connman, pblock, hashBlock);
+
     connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, &hashBlock](CNode* pnode) {
         AssertLockHeld(cs_main);
         // TODO: Avoid the repeated-serialization here
@@ -1395,40 +1859,60 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
-static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connman)
+/**
+ * Relay a batch of addresses (with whether each is reachable) from one ADDR message. The nodes are collected in a
+ * single pass over the node list and the relay targets of all addresses are picked from that.
+ */
+static void RelayAddresses(const std::vector<std::pair<CAddress, bool>>& vAddrRelay, CConnman* connman)
 {
-    unsigned int nRelayNodes = fReachable ? 2 : 1; // limited relaying of addresses outside our network(s)
+    if (vAddrRelay.empty()) {
+        return;
+    }
 
-    // Relay to a limited number of other nodes
-    // Use deterministic randomness to send to the same nodes for 24 hours
-    // at a time so the addrKnowns of the chosen nodes prevent repeats
-    uint64_t hashAddr = addr.GetHash();
-    const CSipHasher hasher = connman->GetDeterministicRandomizer(RANDOMIZER_ID_ADDRESS_RELAY).Write(hashAddr << 32).Write((GetTime() + hashAddr) / (24*60*60));
+    const CSipHasher hasherBase = connman->GetDeterministicRandomizer(RANDOMIZER_ID_ADDRESS_RELAY);
+    const int64_t nNow = GetTime();
     FastRandomContext insecure_rand;
 
-    std::array<std::pair<uint64_t, CNode*>,2> best{{{0, nullptr}, {0, nullptr}}};
-    assert(nRelayNodes <= best.size());
-
-    auto sortfunc = [&best, &hasher, nRelayNodes](CNode* pnode) {
+    std::vector<CNode*> vNodes;
+    auto collectfunc = [&vNodes](CNode* pnode) {
         if (pnode->nVersion >= CADDR_TIME_VERSION) {
-            uint64_t hashKey = CSipHasher(hasher).Write(pnode->GetId()).Finalize();
-            for (unsigned int i = 0; i < nRelayNodes; i++) {
-                if (hashKey > best[i].first) {
-                    std::copy(best.begin() + i, best.begin() + nRelayNodes - 1, best.begin() + i + 1);
-                    best[i] = std::make_pair(hashKey, pnode);
-                    break;
-                }
-            }
+            vNodes.push_back(pnode);
         }
     };
 
-    auto pushfunc = [&addr, &best, nRelayNodes, &insecure_rand] {
-        for (unsigned int i = 0; i < nRelayNodes && best[i].first != 0; i++) {
-            best[i].second->PushAddress(addr, insecure_rand);
+    // The nodes stay valid until pushfunc returns, as it is called with cs_vNodes still held
+    auto pushfunc = [&vAddrRelay, &vNodes, &hasherBase, nNow, &insecure_rand] {
+        for (const auto& p : vAddrRelay) {
+            const CAddress& addr = p.first;
+            unsigned int nRelayNodes = p.second ? 2 : 1; // limited relaying of addresses outside our network(s)
+
+            // Relay to a limited number of other nodes
+            // Use deterministic randomness to send to the same nodes for 24 hours
+            // at a time so the addrKnowns of the chosen nodes prevent repeats
+            uint64_t hashAddr = addr.GetHash();
+            const CSipHasher hasher = CSipHasher(hasherBase).Write(hashAddr << 32).Write((nNow + hashAddr) / (24*60*60));
+
+            std::array<std::pair<uint64_t, CNode*>,2> best{{{0, nullptr}, {0, nullptr}}};
+            assert(nRelayNodes <= best.size());
+
+            for (CNode* pnode : vNodes) {
+                uint64_t hashKey = CSipHasher(hasher).Write(pnode->GetId()).Finalize();
+                for (unsigned int i = 0; i < nRelayNodes; i++) {
+                    if (hashKey > best[i].first) {
+                        std::copy(best.begin() + i, best.begin() + nRelayNodes - 1, best.begin() + i + 1);
+                        best[i] = std::make_pair(hashKey, pnode);
+                        break;
+                    }
+                }
+            }
+
+            for (unsigned int i = 0; i < nRelayNodes && best[i].first != 0; i++) {
+                best[i].second->PushAddress(addr, insecure_rand);
+            }
         }
     };
 
-    connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
+    connman->ForEachNodeThen(std::move(collectfunc), std::move(pushfunc));
 }
 
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
@@ -1436,11 +1920,13 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     bool send = false;
     std::shared_ptr<const CBlock> a_recent_block;
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
+    uint256 a_recent_block_hash;
     const Consensus::Params& consensusParams = chainparams.GetConsensus();
     {
         LOCK(cs_most_recent_block);
         a_recent_block = most_recent_block;
         a_recent_compact_block = most_recent_compact_block;
+        a_recent_block_hash = most_recent_block_hash;
     }
 
     bool need_activate_chain = false;
@@ -1499,9 +1985,23 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     // it's available before trying to send.
     if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
     {
+        // Old blocks requested as compact blocks are sent as full blocks, see below
+        const bool fSendCompact = inv.type == MSG_CMPCT_BLOCK && CanDirectFetch(consensusParams) &&
+                                  pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
         std::shared_ptr<const CBlock> pblock;
-        if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
+        // Compare against the cached hash instead of calling a_recent_block->GetHash(), which would compute X11
+        if (a_recent_block && a_recent_block_hash == pindex->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (inv.type == MSG_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fSendCompact)) {
+            // Fast-path: in this case it is possible to serve the block directly from disk,
+            // as the network format matches the format on disk. Only filtered and compact
+            // blocks need the deserialized block.
+            std::vector<unsigned char> block_data;
+            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
+                assert(!"cannot load block from disk");
+            }
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
+            // Don't set pblock as we've sent the block
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1519,7 +2019,9 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                     LOCK(pfrom->cs_filter);
                     if (pfrom->pfilter) {
                         sendMerkleBlock = true;
-                        merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
+                        if (!TakePrecomputedMerkleBlock(pfrom->GetId(), pindex->GetBlockHash(), *pfrom->pfilter, merkleBlock)) {
+                            merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
+                        }
                     }
                 }
                 if (sendMerkleBlock) {
@@ -1535,9 +2037,12 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, *pblock->vtx[pair.first]));
                     }
                     for (PairType &pair : merkleBlock.vMatchedTxn) {
-                        auto islock = llmq::quorumInstantSendManager->GetInstantSendLockByTxid(pair.second);
-                        if (islock != nullptr) {
-                            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::ISLOCK, *islock));
+                        auto entry = llmq::quorumInstantSendManager->GetInstantSendLockEntryByTxid(pair.second);
+                        if (entry != nullptr) {
+                            CSerializedNetMsg msg;
+                            msg.command = NetMsgType::ISLOCK;
+                            msg.data = entry->bytes;
+                            connman->PushMessage(pfrom, std::move(msg));
                         }
                     }
                 }
@@ -1548,10 +2053,8 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                 // they won't have a useful mempool to match against a compact block,
                 // and we don't feel like constructing the object for them, so
                 // instead we respond with the full, non-compact block.
-                if (CanDirectFetch(consensusParams) &&
-                    pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                    if (a_recent_compact_block &&
-                        a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
+                if (fSendCompact) {
+                    if (a_recent_compact_block && a_recent_block_hash == pindex->GetBlockHash()) {
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                     } else {
                         CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
@@ -1727,9 +2230,12 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             }
 
             if (!push && (inv.type == MSG_ISLOCK)) {
-                llmq::CInstantSendLock o;
-                if (llmq::quorumInstantSendManager->GetInstantSendLockByHash(inv.hash, o)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::ISLOCK, o));
+                auto entry = llmq::quorumInstantSendManager->GetInstantSendLockEntryByHash(inv.hash);
+                if (entry != nullptr) {
+                    CSerializedNetMsg msg;
+                    msg.command = NetMsgType::ISLOCK;
+                    msg.data = entry->bytes;
+                    connman->PushMessage(pfrom, std::move(msg));
                     push = true;
                 }
             }
@@ -1783,6 +2289,43 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
 }
 
+/**
+ * Compute the hashes of all headers. For larger batches, the work is split between the calling thread and the
+ * header hashing threads. Must not be called while holding cs_main, as this is what the threads are there to avoid.
+ */
+static void CalculateHeaderHashes(const std::vector<CBlockHeader>& headers, std::vector<uint256>& hashesRet)
+{
+    AssertLockNotHeld(cs_main);
+
+    hashesRet.resize(headers.size());
+
+    auto hashRange = [&headers, &hashesRet](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            hashesRet[i] = headers[i].GetHash();
+        }
+    };
+
+    if (!headerHashPool || headers.size() < MIN_HEADERS_FOR_PARALLEL_HASHING) {
+        hashRange(0, headers.size());
+        return;
+    }
+
+    // one chunk per worker thread plus one for the calling thread
+    size_t nChunks = (size_t)headerHashPool->size() + 1;
+    size_t nChunkSize = (headers.size() + nChunks - 1) / nChunks;
+    std::vector<std::future<void>> futures;
+    for (size_t begin = nChunkSize; begin < headers.size(); begin += nChunkSize) {
+        size_t end = std::min(begin + nChunkSize, headers.size());
+        futures.emplace_back(headerHashPool->push([&hashRange, begin, end](int threadId) {
+            hashRange(begin, end);
+        }));
+    }
+    hashRange(0, std::min(nChunkSize, headers.size()));
+    for (auto& f : futures) {
+        f.get();
+    }
+}
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1793,6 +2336,11 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         return true;
     }
 
+    // Computing the header hashes is the expensive part of the context-free checks, do it before locking cs_main.
+    // The remaining PoW check (comparing the hash against the target) is cheap and is done by AcceptBlockHeader.
+    std::vector<uint256> headerHashes;
+    CalculateHeaderHashes(headers, headerHashes);
+
     bool received_new_header = false;
     const CBlockIndex *pindexLast = nullptr;
     {
@@ -1811,14 +2359,14 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
             nodestate->nUnconnectingHeaders++;
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256()));
             LogPrint(BCLog::NET, "received header %s: missing prev block %s, sending getheaders (%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
-                    headers[0].GetHash().ToString(),
+                    headerHashes[0].ToString(),
                     headers[0].hashPrevBlock.ToString(),
                     pindexBestHeader->nHeight,
                     pfrom->GetId(), nodestate->nUnconnectingHeaders);
             // Set hashLastUnknownBlock for this peer, so that if we
             // eventually get the headers - even from a different peer -
             // we can use this peer to download.
-            UpdateBlockAvailability(pfrom->GetId(), headers.back().GetHash());
+            UpdateBlockAvailability(pfrom->GetId(), headerHashes.back());
 
             if (nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0) {
                 Misbehaving(pfrom->GetId(), 20);
@@ -1827,12 +2375,12 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         }
 
         uint256 hashLastBlock;
-        for (const CBlockHeader& header : headers) {
-            if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
+        for (size_t i = 0; i < nCount; i++) {
+            if (!hashLastBlock.IsNull() && headers[i].hashPrevBlock != hashLastBlock) {
                 Misbehaving(pfrom->GetId(), 20, "non-continuous headers sequence");
                 return false;
             }
-            hashLastBlock = header.GetHash();
+            hashLastBlock = headerHashes[i];
         }
 
         // If we don't have the last header, then they'll have given us
@@ -1844,7 +2392,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
 
     CValidationState state;
     CBlockHeader first_invalid_header;
-    if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast, &first_invalid_header)) {
+    if (!ProcessNewBlockHeaders(headers, headerHashes, state, chainparams, &pindexLast, &first_invalid_header)) {
         int nDoS;
         if (state.IsInvalid(nDoS)) {
             LOCK(cs_main);
@@ -1988,99 +2536,430 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
             }
         }
 
-        if (!pfrom->fDisconnect && IsOutboundDisconnectionCandidate(pfrom) && nodestate->pindexBestKnownBlock != nullptr) {
-            // If this is an outbound peer, check to see if we should protect
-            // it from the bad/lagging chain logic.
-            if (g_outbound_peers_with_protect_from_disconnect < MAX_OUTBOUND_PEERS_TO_PROTECT_FROM_DISCONNECT && nodestate->pindexBestKnownBlock->nChainWork >= chainActive.Tip()->nChainWork && !nodestate->m_chain_sync.m_protect) {
-                LogPrint(BCLog::NET, "Protecting outbound peer=%d from eviction\n", pfrom->GetId());
-                nodestate->m_chain_sync.m_protect = true;
-                ++g_outbound_peers_with_protect_from_disconnect;
-            }
+        if (!pfrom->fDisconnect && IsOutboundDisconnectionCandidate(pfrom) && nodestate->pindexBestKnownBlock != nullptr) {
+            // If this is an outbound peer, check to see if we should protect
+            // it from the bad/lagging chain logic.
+            if (g_outbound_peers_with_protect_from_disconnect < MAX_OUTBOUND_PEERS_TO_PROTECT_FROM_DISCONNECT && nodestate->pindexBestKnownBlock->nChainWork >= chainActive.Tip()->nChainWork && !nodestate->m_chain_sync.m_protect) {
+                LogPrint(BCLog::NET, "Protecting outbound peer=%d from eviction\n", pfrom->GetId());
+                nodestate->m_chain_sync.m_protect = true;
+                ++g_outbound_peers_with_protect_from_disconnect;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Try a batch of orphans from the work set, queueing the orphans that depend on accepted ones again. The orphans are
+ * looked up and erased with only g_cs_orphans held, cs_main is just held for accepting them to the mempool.
+ */
+void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set) LOCKS_EXCLUDED(cs_main, g_cs_orphans)
+{
+    struct COrphanResult {
+        uint256 hash;
+        CTransactionRef tx;
+        NodeId fromPeer;
+        bool fAccepted{false};
+        bool fErase{false};
+    };
+    std::vector<COrphanResult> vBatch;
+
+    {
+        LOCK(g_cs_orphans);
+        while (!orphan_work_set.empty() && vBatch.size() < MAX_ORPHANS_PER_PROCESSING_BATCH) {
+            const uint256 orphanHash = *orphan_work_set.begin();
+            orphan_work_set.erase(orphan_work_set.begin());
+
+            auto orphan_it = mapOrphanTransactions.find(orphanHash);
+            if (orphan_it == mapOrphanTransactions.end()) continue;
+            vBatch.push_back(COrphanResult{orphanHash, orphan_it->second.tx, orphan_it->second.fromPeer});
+        }
+    }
+    if (vBatch.empty()) {
+        return;
+    }
+
+    {
+        LOCK(cs_main);
+        std::set<NodeId> setMisbehaving;
+        for (COrphanResult& result : vBatch) {
+            if (setMisbehaving.count(result.fromPeer)) continue;
+            // Another thread may have accepted it since it was taken from the pool
+            if (mempool.exists(result.hash)) {
+                result.fErase = true;
+                continue;
+            }
+
+            bool fMissingInputs2 = false;
+            // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+            // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+            // anyone relaying LegitTxX banned)
+            CValidationState stateDummy;
+
+            if (AcceptToMemoryPool(mempool, stateDummy, result.tx, &fMissingInputs2 /* pfMissingInputs */,
+                    false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+                LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", result.hash.ToString());
+                result.fAccepted = true;
+                result.fErase = true;
+            } else if (!fMissingInputs2) {
+                int nDos = 0;
+                if (stateDummy.IsInvalid(nDos) && nDos > 0) {
+                    // Punish peer that gave us an invalid orphan tx
+                    Misbehaving(result.fromPeer, nDos);
+                    setMisbehaving.insert(result.fromPeer);
+                    LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", result.hash.ToString());
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee
+                LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", result.hash.ToString());
+                if (!stateDummy.CorruptionPossible()) {
+                    assert(recentRejects);
+                    recentRejects->insert(result.hash);
+                }
+                result.fErase = true;
+            }
+        }
+        mempool.check(pcoinsTip.get());
+    }
+
+    LOCK(g_cs_orphans);
+    for (const COrphanResult& result : vBatch) {
+        if (result.fAccepted) {
+            connman->RelayTransaction(*result.tx);
+            for (unsigned int i = 0; i < result.tx->vout.size(); i++) {
+                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(result.hash, i));
+                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                    for (const auto& elem : it_by_prev->second) {
+                        orphan_work_set.insert(elem->first);
+                    }
+                }
+            }
+        }
+        if (result.fErase) {
+            EraseOrphanTx(result.hash);
+        }
+    }
+}
+
+std::string RejectCodeToString(const unsigned char code)
+{
+    if (code == REJECT_MALFORMED)
+        return "malformed";
+    if (code == REJECT_INVALID)
+        return "invalid";
+    if (code == REJECT_OBSOLETE)
+        return "obsolete";
+    if (code == REJECT_DUPLICATE)
+        return "duplicate";
+    if (code == REJECT_NONSTANDARD)
+        return "nonstandard";
+    if (code == REJECT_INSUFFICIENTFEE)
+        return "insufficientfee";
+    if (code == REJECT_CHECKPOINT)
+        return "checkpoint";
+    return "";
+}
+
+/**
+ * Validation logic for compact filters request handling.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   filter_type     The filter type the request is for. Must be basic filters.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ * @return                      True if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chain_params,
+                                      uint8_t filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index)
+{
+    const bool supported_filter_type =
+        (filter_type == BlockFilterType::BASIC_FILTER &&
+         (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS));
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), filter_type);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chain_params.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with " /* Continued */
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    if (!g_blockfilterindex) {
+        LogPrint(BCLog::NET, "Filter index for supported type basic not found\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Handle a cfilters request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFilters(CNode* pfrom, CPublicDataStream& vRecv, const CChainParams& chain_params,
+                               CConnman* connman)
+{
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!g_blockfilterindex->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=basic, start_height=%d, stop_hash=%s\n",
+                 start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const auto& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/**
+ * Handle a cfheaders request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFHeaders(CNode* pfrom, CPublicDataStream& vRecv, const CChainParams& chain_params,
+                                CConnman* connman)
+{
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block =
+            stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!g_blockfilterindex->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=basic, block_hash=%s\n",
+                     prev_block->GetBlockHash().ToString());
+            return;
         }
     }
 
-    return true;
+    std::vector<uint256> filter_hashes;
+    if (!g_blockfilterindex->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=basic, start_height=%d, stop_hash=%s\n",
+                 start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS,
+                                              filter_type,
+                                              stop_index->GetBlockHash(),
+                                              prev_header,
+                                              filter_hashes));
 }
 
-void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+/**
+ * Handle a getcfcheckpt request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFCheckPt(CNode* pfrom, CPublicDataStream& vRecv, const CChainParams& chain_params,
+                                CConnman* connman)
 {
-    AssertLockHeld(cs_main);
-    AssertLockHeld(g_cs_orphans);
-    std::set<NodeId> setMisbehaving;
-    bool done = false;
-    while (!done && !orphan_work_set.empty()) {
-        const uint256 orphanHash = *orphan_work_set.begin();
-        orphan_work_set.erase(orphan_work_set.begin());
-
-        auto orphan_it = mapOrphanTransactions.find(orphanHash);
-        if (orphan_it == mapOrphanTransactions.end()) continue;
-
-        const CTransactionRef porphanTx = orphan_it->second.tx;
-        const CTransaction& orphanTx = *porphanTx;
-        NodeId fromPeer = orphan_it->second.fromPeer;
-        bool fMissingInputs2 = false;
-        // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-        // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-        // anyone relaying LegitTxX banned)
-        CValidationState stateDummy;
-
-        if (setMisbehaving.count(fromPeer)) continue;
-        if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2 /* pfMissingInputs */,
-                false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
-            connman->RelayTransaction(orphanTx);
-            for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
-            EraseOrphanTx(orphanHash);
-            done = true;
-        } else if (!fMissingInputs2) {
-            int nDos = 0;
-            if (stateDummy.IsInvalid(nDos) && nDos > 0) {
-                // Punish peer that gave us an invalid orphan tx
-                Misbehaving(fromPeer, nDos);
-                setMisbehaving.insert(fromPeer);
-                LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", orphanHash.ToString());
-            }
-            // Has inputs but not accepted to mempool
-            // Probably non-standard or insufficient fee
-            LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
-            if (!stateDummy.CorruptionPossible()) {
-                assert(recentRejects);
-                recentRejects->insert(orphanHash);
-            }
-            EraseOrphanTx(orphanHash);
-            done = true;
+    uint8_t filter_type;
+    uint256 stop_hash;
+
+    vRecv >> filter_type >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(),
+                                   stop_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!g_blockfilterindex->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=basic, block_hash=%s\n",
+                     block_index->GetBlockHash().ToString());
+            return;
         }
-        mempool.check(pcoinsTip.get());
     }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT,
+                                              filter_type,
+                                              stop_index->GetBlockHash(),
+                                              headers));
 }
 
-std::string RejectCodeToString(const unsigned char code)
+/** Handler of messages which are processed by one of the Dash managers */
+typedef void (*DashMessageHandler)(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61);
+
+static void ProcessCoinJoinMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
 {
-    if (code == REJECT_MALFORMED)
-        return "malformed";
-    if (code == REJECT_INVALID)
-        return "invalid";
-    if (code == REJECT_OBSOLETE)
-        return "obsolete";
-    if (code == REJECT_DUPLICATE)
-        return "duplicate";
-    if (code == REJECT_NONSTANDARD)
-        return "nonstandard";
-    if (code == REJECT_INSUFFICIENTFEE)
-        return "insufficientfee";
-    if (code == REJECT_CHECKPOINT)
-        return "checkpoint";
-    return "";
+#ifdef ENABLE_WALLET
+    // DSQUEUE is handled by the client on regular nodes and by the server on masternodes, they never both read it
+    coinJoinClientQueueManager.ProcessMessage(pfrom, strCommand, vRecv, connman, enable_bip61);
+    for (auto& pair : coinJoinClientManagers) {
+        pair.second->ProcessMessage(pfrom, strCommand, vRecv, connman, enable_bip61);
+    }
+#endif // ENABLE_WALLET
+    coinJoinServer.ProcessMessage(pfrom, strCommand, vRecv, connman, enable_bip61);
+}
+
+static void ProcessSporkMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    sporkManager.ProcessSpork(pfrom, strCommand, vRecv, connman);
+}
+
+static void ProcessMasternodeSyncMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessGovernanceMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    governance.ProcessMessage(pfrom, strCommand, vRecv, connman, enable_bip61);
+}
+
+static void ProcessMNAuthMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    CMNAuth::ProcessMessage(pfrom, strCommand, vRecv, connman);
+}
+
+static void ProcessQuorumBlockMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::quorumBlockProcessor->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessDKGMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::quorumDKGSessionManager->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessQuorumDataMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::quorumManager->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessSigSharesMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::quorumSigSharesManager->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessRecoveredSigMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::quorumSigningManager->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessChainLockMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::chainLocksHandler->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessInstantSendMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman, bool enable_bip61)
+{
+    llmq::quorumInstantSendManager->ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+/**
+ * Dispatch table of the messages which are processed by the Dash managers. Known messages which are neither in here
+ * nor handled by ProcessMessage itself are ignored.
+ */
+static const std::unordered_map<std::string, DashMessageHandler>& GetDashMessageHandlers()
+{
+    static const std::unordered_map<std::string, DashMessageHandler> handlers{
+        {NetMsgType::DSACCEPT, ProcessCoinJoinMessage},
+        {NetMsgType::DSVIN, ProcessCoinJoinMessage},
+        {NetMsgType::DSFINALTX, ProcessCoinJoinMessage},
+        {NetMsgType::DSSIGNFINALTX, ProcessCoinJoinMessage},
+        {NetMsgType::DSCOMPLETE, ProcessCoinJoinMessage},
+        {NetMsgType::DSSTATUSUPDATE, ProcessCoinJoinMessage},
+        {NetMsgType::DSQUEUE, ProcessCoinJoinMessage},
+        {NetMsgType::SPORK, ProcessSporkMessage},
+        {NetMsgType::GETSPORKS, ProcessSporkMessage},
+        {NetMsgType::SYNCSTATUSCOUNT, ProcessMasternodeSyncMessage},
+        {NetMsgType::MNGOVERNANCESYNC, ProcessGovernanceMessage},
+        {NetMsgType::MNGOVERNANCEVOTESKETCH, ProcessGovernanceMessage},
+        {NetMsgType::MNGOVERNANCEOBJECT, ProcessGovernanceMessage},
+        {NetMsgType::MNGOVERNANCEOBJECTVOTE, ProcessGovernanceMessage},
+        {NetMsgType::MNAUTH, ProcessMNAuthMessage},
+        {NetMsgType::QFCOMMITMENT, ProcessQuorumBlockMessage},
+        {NetMsgType::QCONTRIB, ProcessDKGMessage},
+        {NetMsgType::QCOMPLAINT, ProcessDKGMessage},
+        {NetMsgType::QJUSTIFICATION, ProcessDKGMessage},
+        {NetMsgType::QPCOMMITMENT, ProcessDKGMessage},
+        {NetMsgType::QWATCH, ProcessDKGMessage},
+        {NetMsgType::QGETDATA, ProcessQuorumDataMessage},
+        {NetMsgType::QDATA, ProcessQuorumDataMessage},
+        {NetMsgType::QSIGSESANN, ProcessSigSharesMessage},
+        {NetMsgType::QSIGSHARESINV, ProcessSigSharesMessage},
+        {NetMsgType::QGETSIGSHARES, ProcessSigSharesMessage},
+        {NetMsgType::QBSIGSHARES, ProcessSigSharesMessage},
+        {NetMsgType::QSIGSHARE, ProcessSigSharesMessage},
+        {NetMsgType::QSIGREC, ProcessRecoveredSigMessage},
+        {NetMsgType::CLSIG, ProcessChainLockMessage},
+        {NetMsgType::ISLOCK, ProcessInstantSendMessage},
+    };
+    return handlers;
 }
 
-bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
+bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
     statsClient.inc("message.received." + SanitizeString(strCommand), 1.0f);
@@ -2304,6 +3183,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             {
                 connman->PushMessage(pfrom, CNetMsgMaker(nSendVersion).Make(NetMsgType::GETADDR));
                 pfrom->fGetAddr = true;
+                // The response to our GETADDR should not be rate limited
+                pfrom->nAddrTokenBucket += MAX_ADDR_TO_SEND;
             }
             connman->MarkAddressGood(pfrom->addr);
         }
@@ -2373,6 +3254,16 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
         }
 
+        if (pfrom->CanRelay() && pfrom->nVersion >= SHORT_INV_PROTO_VERSION) {
+            // Tell our peer to announce LLMQ objects to us by short ids
+            uint64_t salt;
+            {
+                LOCK(cs_main);
+                salt = g_short_inv_salt;
+            }
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDSHORTINV, salt));
+        }
+
         if (pfrom->nVersion >= SENDDSQUEUE_PROTO_VERSION) {
             // Tell our peer that he should send us CoinJoin queue messages
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDDSQUEUE, true));
@@ -2410,6 +3301,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
     }
 
+    const auto& dashHandlers = GetDashMessageHandlers();
+    auto itHandler = dashHandlers.find(strCommand);
+    if (itHandler != dashHandlers.end()) {
+        itHandler->second(pfrom, strCommand, vRecv, *connman, enable_bip61);
+        return true;
+    }
+
     if (strCommand == NetMsgType::ADDR) {
         std::vector<CAddress> vAddr;
         vRecv >> vAddr;
@@ -2424,8 +3322,23 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return false;
         }
 
+        // Refill the address processing tokens of the peer for the time since its last ADDR
+        const int64_t nTimeMicros = GetTimeMicros();
+        if (pfrom->nAddrTokenBucket < MAX_ADDR_PROCESSING_TOKEN_BUCKET) {
+            const double fIncrement = std::max<int64_t>(nTimeMicros - pfrom->nAddrTokenTimestamp, 0) * MAX_ADDR_RATE_PER_SECOND / 1000000;
+            pfrom->nAddrTokenBucket = std::min<double>(pfrom->nAddrTokenBucket + fIncrement, MAX_ADDR_PROCESSING_TOKEN_BUCKET);
+        }
+        pfrom->nAddrTokenTimestamp = nTimeMicros;
+        const bool fRateLimited = !pfrom->fWhitelisted;
+
+        // Shuffle so that a peer can't choose which of its addresses are processed when it exceeds its tokens
+        Shuffle(vAddr.begin(), vAddr.end(), FastRandomContext());
+
         // Store the new addresses
         std::vector<CAddress> vAddrOk;
+        std::vector<std::pair<CAddress, bool>> vAddrRelay;
+        uint64_t nProcessed = 0;
+        uint64_t nRateLimited = 0;
         int64_t nNow = GetAdjustedTime();
         int64_t nSince = nNow - 10 * 60;
         for (CAddress& addr : vAddr)
@@ -2433,6 +3346,16 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             if (interruptMsgProc)
                 return true;
 
+            if (pfrom->nAddrTokenBucket < 1.0) {
+                if (fRateLimited) {
+                    nRateLimited++;
+                    continue;
+                }
+            } else {
+                pfrom->nAddrTokenBucket -= 1.0;
+            }
+            nProcessed++;
+
             // We only bother storing full nodes, though this may include
             // things which we would not make an outbound connection to, in
             // part because we may make feeler connections to them.
@@ -2445,12 +3368,23 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             bool fReachable = IsReachable(addr);
             if (addr.nTime > nSince && !pfrom->fGetAddr && vAddr.size() <= 10 && addr.IsRoutable())
             {
-                RelayAddress(addr, fReachable, connman);
+                vAddrRelay.emplace_back(addr, fReachable);
             }
             // Do not store addresses outside our network
             if (fReachable)
                 vAddrOk.push_back(addr);
         }
+        pfrom->nAddrProcessed += nProcessed;
+        pfrom->nAddrRateLimited += nRateLimited;
+        if (nProcessed > 0) {
+            statsClient.count("peers.addrProcessed", nProcessed, 1.0f);
+        }
+        if (nRateLimited > 0) {
+            statsClient.count("peers.addrRateLimited", nRateLimited, 1.0f);
+            LogPrint(BCLog::NET, "Received addr: %u addresses (%u processed, %u rate-limited) from peer=%d\n",
+                     vAddr.size(), nProcessed, nRateLimited, pfrom->GetId());
+        }
+        RelayAddresses(vAddrRelay, connman);
         connman->AddNewAddresses(vAddrOk, pfrom->addr, 2 * 60 * 60);
         if (vAddr.size() < 1000)
             pfrom->fGetAddr = false;
@@ -2497,12 +3431,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
     if (strCommand == NetMsgType::INV) {
-        std::vector<CInv> vInv;
-        vRecv >> vInv;
-        if (vInv.size() > MAX_INV_SZ)
+        // Invs are read one by one straight from the message buffer, oversized messages are rejected before reading any
+        SpanReader reader = MakeSpanReader(vRecv);
+        VectorElementReader<CInv> invReader(reader, CInv::SERIALIZED_SIZE);
+        if (invReader.size() > MAX_INV_SZ)
         {
             LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 20, strprintf("message inv size() = %u", vInv.size()));
+            Misbehaving(pfrom->GetId(), 20, strprintf("message inv size() = %u", invReader.size()));
             return false;
         }
 
@@ -2516,7 +3451,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         const auto current_time = GetTime<std::chrono::microseconds>();
 
-        for (CInv &inv : vInv)
+        CInv inv;
+        while (invReader.Next(inv))
         {
             if(!inv.IsKnownType()) {
                 LogPrint(BCLog::NET, "got inv of unknown type %d: %s peer=%d\n", inv.type, inv.hash.ToString(), pfrom->GetId());
@@ -2580,6 +3516,89 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::SENDSHORTINV) {
+        if (pfrom->nVersion < SHORT_INV_PROTO_VERSION) {
+            return true;
+        }
+        uint64_t salt;
+        vRecv >> salt;
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom->GetId());
+        state->m_wants_short_inv = true;
+        state->m_short_inv_salt = salt;
+        return true;
+    }
+
+    if (strCommand == NetMsgType::SHORTINV) {
+        if (pfrom->nVersion < SHORT_INV_PROTO_VERSION) {
+            return true;
+        }
+        SpanReader reader = MakeSpanReader(vRecv);
+        VectorElementReader<CShortInv> shortInvReader(reader, CShortInv::SERIALIZED_SIZE);
+        if (shortInvReader.size() > MAX_INV_SZ) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, strprintf("message shortinv size() = %u", shortInvReader.size()));
+            return false;
+        }
+
+        if (!fRelayTxes && !(pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY))) {
+            LogPrint(BCLog::NET, "shortinv sent in violation of protocol peer=%d\n", pfrom->GetId());
+            return true;
+        }
+
+        LOCK(cs_main);
+        if (fImporting || fReindex || IsInitialBlockDownload()) {
+            return true;
+        }
+
+        const auto current_time = GetTime<std::chrono::microseconds>();
+        CNodeState* state = State(pfrom->GetId());
+        size_t nNew = 0;
+        CShortInv shortInv;
+        while (shortInvReader.Next(shortInv)) {
+            if (!IsShortInvType(shortInv.type)) {
+                LogPrint(BCLog::NET, "got shortinv of unsupported type %d peer=%d\n", shortInv.type, pfrom->GetId());
+                continue;
+            }
+            if (g_short_inv_known.count(shortInv.shortId)) {
+                continue;
+            }
+            // requested in SendMessages, from this peer or, if it doesn't deliver in time, one of the other announcers
+            RequestShortInv(state, shortInv, current_time);
+            nNew++;
+        }
+        LogPrint(BCLog::NET, "got shortinv (%u items, %u new) peer=%d\n", shortInvReader.size(), nNew, pfrom->GetId());
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETSHORTDATA) {
+        if (pfrom->nVersion < SHORT_INV_PROTO_VERSION) {
+            return true;
+        }
+        std::vector<CShortInv> vShortInv;
+        vRecv >> vShortInv;
+        if (vShortInv.size() > MAX_INV_SZ) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, strprintf("message getshortdata size() = %u", vShortInv.size()));
+            return false;
+        }
+
+        {
+            LOCK(cs_main);
+            CNodeState* state = State(pfrom->GetId());
+            for (const CShortInv& shortInv : vShortInv) {
+                auto it = state->m_short_inv_announced.find(shortInv.shortId);
+                if (it == state->m_short_inv_announced.end() || it->second.type != shortInv.type) {
+                    LogPrint(BCLog::NET, "received getshortdata for unknown short id %016x peer=%d\n", shortInv.shortId, pfrom->GetId());
+                    continue;
+                }
+                pfrom->vRecvGetData.emplace_back(it->second);
+            }
+        }
+        ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
+        return true;
+    }
+
     if (strCommand == NetMsgType::GETDATA) {
         std::vector<CInv> vInv;
         vRecv >> vInv;
@@ -2901,8 +3920,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                      tx.GetHash().ToString(),
                      mempool.size(), mempool.DynamicMemoryUsage() / 1000);
 
-            // Recursively process any orphan transactions that depended on this one
-            ProcessOrphanTx(connman, pfrom->orphan_work_set);
+            // Any orphan transactions that depended on this one are processed in batches by ProcessMessages, after
+            // cs_main was released
         }
         else if (fMissingInputs)
         {
@@ -3028,7 +4047,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // dummy (empty) BLOCKTXN message, to re-use the logic there in
         // completing processing of the putative block (without cs_main).
         bool fProcessBLOCKTXN = false;
-        CDataStream blockTxnMsg(SER_NETWORK, PROTOCOL_VERSION);
+        CPublicDataStream blockTxnMsg(SER_NETWORK, PROTOCOL_VERSION);
 
         // If we end up treating this as a plain headers message, call that as well
         // without cs_main.
@@ -3039,6 +4058,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         bool fBlockReconstructed = false;
 
+        // Locked TXs are almost guaranteed to be in the next block, even if they already left our mempool
+        const auto vLockedTxs = llmq::quorumInstantSendManager->GetLockedTxsForCompactBlocks();
+
         {
         LOCK2(cs_main, g_cs_orphans);
         // If AcceptBlockHeader returned true, it set pindex
@@ -3092,12 +4114,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact, vLockedTxs);
                 if (status == READ_STATUS_INVALID) {
                     MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
                     Misbehaving(pfrom->GetId(), 100, strprintf("Peer %d sent us invalid compact block", pfrom->GetId()));
                     return true;
                 } else if (status == READ_STATUS_FAILED) {
+                    g_compact_block_stats.nBlocksFallback++;
                     // Duplicate txindexes, the block is now in-flight, so just request it
                     std::vector<CInv> vInv(1);
                     vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
@@ -3110,6 +4133,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     if (!partialBlock.IsTxAvailable(i))
                         req.indexes.push_back(i);
                 }
+                RecordCompactBlockReconstruction(partialBlock, req.indexes.size());
                 if (req.indexes.empty()) {
                     // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
                     BlockTransactions txn;
@@ -3127,7 +4151,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
                 PartiallyDownloadedBlock tempBlock(&mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact, vLockedTxs);
                 if (status != READ_STATUS_OK) {
                     // TODO: don't ignore failures
                     return true;
@@ -3225,6 +4249,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 Misbehaving(pfrom->GetId(), 100, strprintf("Peer %d sent us invalid compact block/non-matching block transactions", pfrom->GetId()));
                 return true;
             } else if (status == READ_STATUS_FAILED) {
+                g_compact_block_stats.nBlocksFallback++;
                 // Might have collided, fall back to getdata now :(
                 std::vector<CInv> invs;
                 invs.push_back(CInv(MSG_BLOCK, resp.blockhash));
@@ -3304,7 +4329,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
+        {
+            CTransactionArenaScope arenaScope;
+            vRecv >> *pblock;
+        }
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
@@ -3312,6 +4340,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
+            UpdateBlockDeliveryStats(pfrom, hash);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
             forceProcessing |= MarkBlockAsReceived(hash);
@@ -3349,7 +4378,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrToSend);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr)
@@ -3504,6 +4536,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFCHECKPT) {
+        ProcessGetCFCheckPt(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
 
     if (strCommand == NetMsgType::GETMNLISTDIFF) {
         CGetSimplifiedMNListDiff cmd;
@@ -3511,11 +4558,26 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         LOCK(cs_main);
 
-        CSimplifiedMNListDiff mnListDiff;
+        bool fSuccess;
         std::string strError;
-        if (BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
+        if (pfrom->GetSendVersion() >= LLMQS_PROTO_VERSION) {
+            // Most peers ask for the same diffs, they are answered from the cached serialization
+            CSimplifiedMNListDiffCache::DiffBytesPtr diff;
+            fSuccess = mnListDiffCache.GetDiff(cmd.baseBlockHash, cmd.blockHash, diff, strError);
+            if (fSuccess) {
+                CSerializedNetMsg msg;
+                msg.command = NetMsgType::MNLISTDIFF;
+                msg.data = *diff;
+                connman->PushMessage(pfrom, std::move(msg));
+            }
         } else {
+            CSimplifiedMNListDiff mnListDiff;
+            fSuccess = BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError);
+            if (fSuccess) {
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
+            }
+        }
+        if (!fSuccess) {
             strError = strprintf("getmnlistdiff failed for baseBlockHash=%s, blockHash=%s. error=%s", cmd.baseBlockHash.ToString(), cmd.blockHash.ToString(), strError);
             Misbehaving(pfrom->GetId(), 1, strError);
         }
@@ -3523,6 +4585,55 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    if (strCommand == NetMsgType::GETMNLISTSNAPSHOT) {
+        uint256 blockHash;
+        vRecv >> blockHash;
+
+        if (pfrom->nVersion < MNLIST_SNAPSHOT_VERSION) {
+            return true;
+        }
+
+        LOCK(cs_main);
+
+        // Answered with the diff from genesis to the newest stored snapshot, followed by the diff from the snapshot
+        // to the requested block. Without a stored snapshot, genesis itself is used.
+        std::string strError;
+        const CBlockIndex* pindex = LookupBlockIndex(blockHash);
+        if (!pindex || !chainActive.Contains(pindex)) {
+            strError = "block not found in active chain";
+        } else {
+            const CBlockIndex* pindexSnapshot{nullptr};
+            std::vector<unsigned char> snapshot;
+            CSimplifiedMNListDiffCache::DiffBytesPtr snapshotDiff, diff;
+            if (GetSimplifiedMNListSnapshot(pindex, pindexSnapshot, snapshot)) {
+                snapshotDiff = std::make_shared<const std::vector<unsigned char>>(std::move(snapshot));
+            } else {
+                pindexSnapshot = chainActive.Genesis();
+                mnListDiffCache.GetDiff(uint256(), pindexSnapshot->GetBlockHash(), snapshotDiff, strError);
+            }
+            if (snapshotDiff && mnListDiffCache.GetDiff(pindexSnapshot->GetBlockHash(), blockHash, diff, strError)) {
+                CSerializedNetMsg msg;
+                msg.command = NetMsgType::MNLISTSNAPSHOT;
+                msg.data.reserve(snapshotDiff->size() + diff->size());
+                msg.data.insert(msg.data.end(), snapshotDiff->begin(), snapshotDiff->end());
+                msg.data.insert(msg.data.end(), diff->begin(), diff->end());
+                connman->PushMessage(pfrom, std::move(msg));
+                return true;
+            }
+        }
+        Misbehaving(pfrom->GetId(), 1, strprintf("getmnlistsnap failed for blockHash=%s. error=%s", blockHash.ToString(), strError));
+        return true;
+    }
+
+
+    if (strCommand == NetMsgType::MNLISTSNAPSHOT) {
+        // we have never requested this
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 100, strprintf("received not-requested mnlistsnap. peer=%d", pfrom->GetId()));
+        return true;
+    }
+
+
     if (strCommand == NetMsgType::MNLISTDIFF) {
         // we have never requested this
         LOCK(cs_main);
@@ -3556,36 +4667,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
-    bool found = false;
-    const std::vector<std::string> &allMessages = getAllNetMessageTypes();
-    for (const std::string msg : allMessages) {
-        if(msg == strCommand) {
-            found = true;
-            break;
-        }
-    }
-
-    if (found)
-    {
-        //probably one the extensions
-#ifdef ENABLE_WALLET
-        coinJoinClientQueueManager.ProcessMessage(pfrom, strCommand, vRecv, *connman, enable_bip61);
-        for (auto& pair : coinJoinClientManagers) {
-            pair.second->ProcessMessage(pfrom, strCommand, vRecv, *connman, enable_bip61);
-        }
-#endif // ENABLE_WALLET
-        coinJoinServer.ProcessMessage(pfrom, strCommand, vRecv, *connman, enable_bip61);
-        sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman);
-        masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
-        governance.ProcessMessage(pfrom, strCommand, vRecv, *connman, enable_bip61);
-        CMNAuth::ProcessMessage(pfrom, strCommand, vRecv, *connman);
-        llmq::quorumBlockProcessor->ProcessMessage(pfrom, strCommand, vRecv);
-        llmq::quorumDKGSessionManager->ProcessMessage(pfrom, strCommand, vRecv);
-        llmq::quorumManager->ProcessMessage(pfrom, strCommand, vRecv);
-        llmq::quorumSigSharesManager->ProcessMessage(pfrom, strCommand, vRecv);
-        llmq::quorumSigningManager->ProcessMessage(pfrom, strCommand, vRecv);
-        llmq::chainLocksHandler->ProcessMessage(pfrom, strCommand, vRecv);
-        llmq::quorumInstantSendManager->ProcessMessage(pfrom, strCommand, vRecv);
+    static const std::unordered_set<std::string> setAllMessages(getAllNetMessageTypes().begin(), getAllNetMessageTypes().end());
+    if (setAllMessages.count(strCommand)) {
+        // known message which needs no processing, e.g. a block received while importing
         return true;
     }
 
@@ -3644,7 +4728,6 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
 
     if (!pfrom->orphan_work_set.empty()) {
-        LOCK2(cs_main, g_cs_orphans);
         ProcessOrphanTx(connman, pfrom->orphan_work_set);
     }
 
@@ -3659,6 +4742,10 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     if (pfrom->fPauseSend)
         return false;
 
+    // Later messages might depend on the result of the MNAUTH check, e.g. the quorum messages of verified masternodes
+    if (pfrom->fMNAuthPending)
+        return false;
+
     std::list<CNetMessage> msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
@@ -3693,7 +4780,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     unsigned int nMessageSize = hdr.nMessageSize;
 
     // Checksum
-    CDataStream& vRecv = msg.vRecv;
+    CPublicDataStream& vRecv = msg.vRecv;
     const uint256& hash = msg.GetMessageHash();
     if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
     {
@@ -3706,12 +4793,14 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // Process message
     bool fRet = false;
+    const int64_t nProcessStart = GetTimeMicros();
+    const int64_t nProcessCPUStart = GetThreadCPUTimeMicros();
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
         if (interruptMsgProc)
             return false;
-        if (!pfrom->vRecvGetData.empty())
+        if (!pfrom->vRecvGetData.empty() || !pfrom->orphan_work_set.empty())
             fMoreWork = true;
     }
     catch (const std::ios_base::failure& e)
@@ -3742,6 +4831,8 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         PrintExceptionContinue(std::current_exception(), "ProcessMessages()");
     }
 
+    connman->RecordMsgProcessTime(pfrom, strCommand, GetTimeMicros() - nProcessStart, GetThreadCPUTimeMicros() - nProcessCPUStart);
+
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
     }
@@ -3887,25 +4978,6 @@ void PeerLogicValidation::CheckForStaleTipAndEvictPeers(const Consensus::Params
     }
 }
 
-namespace {
-class CompareInvMempoolOrder
-{
-    CTxMemPool *mp;
-public:
-    explicit CompareInvMempoolOrder(CTxMemPool *_mempool)
-    {
-        mp = _mempool;
-    }
-
-    bool operator()(std::set<uint256>::iterator a, std::set<uint256>::iterator b)
-    {
-        /* As std::make_heap produces a max-heap, we want the entries with the
-         * fewest ancestors/highest fee to sort later. */
-        return mp->CompareDepthAndScore(*b, *a);
-    }
-};
-}
-
 bool PeerLogicValidation::SendMessages(CNode* pto)
 {
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -3962,6 +5034,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->cs_addrToSend);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend)
@@ -4171,8 +5244,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: inventory
         //
         std::vector<CInv> vInv;
+        std::vector<CShortInv> vShortInv;
         {
-            size_t reserve = std::min<size_t>(pto->setInventoryTxToSend.size(), INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK * MaxBlockSize() / 1000000);
+            CTxAnnouncementQueue& txAnnouncementQueue = connman->GetTxAnnouncementQueue();
+            size_t reserve = std::min<size_t>(txAnnouncementQueue.GetPendingCount(pto->GetId()), INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK * MaxBlockSize() / 1000000);
             reserve = std::max<size_t>(reserve, pto->vInventoryBlockToSend.size());
             reserve = std::min<size_t>(reserve, MAX_INV_SZ);
             vInv.reserve(reserve);
@@ -4207,12 +5282,33 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             // Time to send but the peer has requested we not relay transactions.
             if (fSendTrickle) {
                 LOCK(pto->cs_filter);
-                if (!pto->fRelayTxes) pto->setInventoryTxToSend.clear();
+                if (!pto->fRelayTxes || !pto->CanRelay()) txAnnouncementQueue.SkipPending(pto->GetId());
             }
 
-            auto queueAndMaybePushInv = [this, pto, &vInv, &msgMaker](const CInv& invIn) {
+            auto queueAndMaybePushInv = [this, pto, &vInv, &vShortInv, &state, &msgMaker](const CInv& invIn) {
                 AssertLockHeld(pto->cs_inventory);
                 pto->filterInventoryKnown.insert(invIn.hash);
+                if (IsShortInvType(invIn.type)) {
+                    // we have it, so ignore announcements of it
+                    MarkShortInvKnown(&state, invIn);
+                    if (state.m_wants_short_inv) {
+                        const uint64_t shortId = GetShortInvId(state.m_short_inv_salt, invIn);
+                        if (state.m_short_inv_announced.emplace(shortId, invIn).second) {
+                            state.m_short_inv_announced_order.emplace_back(shortId);
+                            if (state.m_short_inv_announced_order.size() > MAX_SHORT_INV_ANNOUNCED) {
+                                state.m_short_inv_announced.erase(state.m_short_inv_announced_order.front());
+                                state.m_short_inv_announced_order.pop_front();
+                            }
+                        }
+                        LogPrint(BCLog::NET, "SendMessages -- queued shortinv: %s  shortid=%016x peer=%d\n", invIn.ToString(), shortId, pto->GetId());
+                        vShortInv.emplace_back(invIn.type, shortId);
+                        if (vShortInv.size() == MAX_INV_SZ) {
+                            connman->PushMessage(pto, msgMaker.Make(NetMsgType::SHORTINV, vShortInv));
+                            vShortInv.clear();
+                        }
+                        return;
+                    }
+                }
                 LogPrint(BCLog::NET, "SendMessages -- queued inv: %s  index=%d peer=%d\n", invIn.ToString(), vInv.size(), pto->GetId());
                 vInv.push_back(invIn);
                 if (vInv.size() == MAX_INV_SZ) {
@@ -4232,7 +5328,6 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 // Send invs for txes and corresponding IS-locks
                 for (const auto& txinfo : vtxinfo) {
                     const uint256& hash = txinfo.tx->GetHash();
-                    pto->setInventoryTxToSend.erase(hash);
                     if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
 
                     int nInvType = CCoinJoin::GetDSTX(hash) ? MSG_DSTX : MSG_TX;
@@ -4255,38 +5350,27 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
 
             // Determine transactions to relay
             if (fSendTrickle) {
-                // Produce a vector with all candidates for sending
-                std::vector<std::set<uint256>::iterator> vInvTx;
-                vInvTx.reserve(pto->setInventoryTxToSend.size());
-                for (std::set<uint256>::iterator it = pto->setInventoryTxToSend.begin(); it != pto->setInventoryTxToSend.end(); it++) {
-                    vInvTx.push_back(it);
-                }
                 // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
-                // A heap is used so that not all items need sorting if only a few are being sent.
-                CompareInvMempoolOrder compareInvMempoolOrder(&mempool);
-                std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
+                // Every batch of relayed transactions is sorted only once, by the first peer which trickles.
+                txAnnouncementQueue.Flush([](std::vector<uint256>& vBatch) {
+                    mempool.SortByDepthAndScore(vBatch);
+                });
                 // No reason to drain out at many times the network's capacity,
                 // especially since we have many peers and some will draw much shorter delays.
+                const unsigned int nMaxRelayedTransactions = INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK * MaxBlockSize() / 1000000;
                 unsigned int nRelayedTransactions = 0;
                 LOCK(pto->cs_filter);
-                while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK * MaxBlockSize() / 1000000) {
-                    // Fetch the top element from the heap
-                    std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                    std::set<uint256>::iterator it = vInvTx.back();
-                    vInvTx.pop_back();
-                    uint256 hash = *it;
-                    // Remove it from the to-be-sent set
-                    pto->setInventoryTxToSend.erase(it);
+                txAnnouncementQueue.ForEachPending(pto->GetId(), [&](const uint256& hash) {
                     // Check if not in the filter already
                     if (pto->filterInventoryKnown.contains(hash)) {
-                        continue;
+                        return true;
                     }
                     // Not in the mempool anymore? don't bother sending it.
                     auto txinfo = mempool.info(hash);
                     if (!txinfo.tx) {
-                        continue;
+                        return true;
                     }
-                    if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                    if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) return true;
                     // Send
                     nRelayedTransactions++;
                     {
@@ -4304,7 +5388,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     }
                     int nInvType = CCoinJoin::GetDSTX(hash) ? MSG_DSTX : MSG_TX;
                     queueAndMaybePushInv(CInv(nInvType, hash));
-                }
+                    return nRelayedTransactions < nMaxRelayedTransactions;
+                });
             }
 
             // Send non-tx/non-block inventory items
@@ -4318,6 +5403,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         }
         if (!vInv.empty())
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+        if (!vShortInv.empty())
+            connman->PushMessage(pto, msgMaker.Make(NetMsgType::SHORTINV, vShortInv));
 
         // Detect whether we're stalling
         current_time = GetTime<std::chrono::microseconds>();
@@ -4387,10 +5474,23 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && pto->CanRelay() && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fClient && pto->CanRelay() && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlocksInTransitLimit) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            const CBlockIndex* pindexStalling = nullptr;
+            FindNextBlocksToDownload(pto->GetId(), state.nBlocksInTransitLimit - state.nBlocksInFlight, vToDownload, staller, consensusParams, &pindexStalling);
+            if (vToDownload.empty() && staller != -1 && pindexStalling != nullptr && ShouldReassignStallingBlock(state, staller, pindexStalling->GetBlockHash(), nNow)) {
+                // Rather than waiting for the slow peer to deliver (or to be disconnected for stalling), move the block
+                // which holds back the download window to this peer, which has been delivering faster
+                LogPrint(BCLog::NET, "Reassigning stalling block %s (%d) from peer=%d to peer=%d\n", pindexStalling->GetBlockHash().ToString(),
+                    pindexStalling->nHeight, staller, pto->GetId());
+                vToDownload.push_back(pindexStalling);
+                staller = -1;
+            }
+            if (vToDownload.empty() && !pto->m_limited_node) {
+                // The blocks below the base of a loaded UTXO snapshot come after the ones the active chain waits for
+                FindNextSnapshotBlocksToDownload(pto->GetId(), state.nBlocksInTransitLimit - state.nBlocksInFlight, vToDownload);
+            }
             for (const CBlockIndex *pindex : vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), pindex);
@@ -4424,6 +5524,19 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     ++it;
                 }
             }
+            auto& short_inv_download = state.m_short_inv_download;
+            for (auto it = short_inv_download.m_short_inv_in_flight.begin(); it != short_inv_download.m_short_inv_in_flight.end();) {
+                auto itType = short_inv_download.m_short_inv_announced.find(it->first);
+                if (itType == short_inv_download.m_short_inv_announced.end() || it->second <= current_time - GetObjectExpiryInterval(itType->second)) {
+                    LogPrint(BCLog::NET, "timeout of inflight short id %016x from peer=%d\n", it->first, pto->GetId());
+                    if (itType != short_inv_download.m_short_inv_announced.end()) {
+                        short_inv_download.m_short_inv_announced.erase(itType);
+                    }
+                    short_inv_download.m_short_inv_in_flight.erase(it++);
+                } else {
+                    ++it;
+                }
+            }
             // On average, we do this check every GetObjectExpiryInterval. Randomize
             // so that we're not doing this for all peers at the same time.
             state.m_object_download.m_check_expiry_timer = current_time + GetObjectExpiryInterval(MSG_TX)/2 + GetRandMicros(GetObjectExpiryInterval(MSG_TX));
@@ -4478,6 +5591,40 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             LogPrint(BCLog::NET, "SendMessages -- GETDATA -- pushed size = %lu peer=%d\n", vGetData.size(), pto->GetId());
         }
 
+        //
+        // Message: getshortdata
+        //
+        std::vector<CShortInv> vGetShortData;
+        auto& short_inv_download = state.m_short_inv_download;
+        auto& short_inv_process_time = short_inv_download.m_short_inv_process_time;
+        while (!short_inv_process_time.empty() && short_inv_process_time.begin()->first <= current_time && short_inv_download.m_short_inv_in_flight.size() < MAX_PEER_OBJECT_IN_FLIGHT) {
+            const CShortInv shortInv = short_inv_process_time.begin()->second;
+            short_inv_process_time.erase(short_inv_process_time.begin());
+            if (g_short_inv_known.count(shortInv.shortId)) {
+                // Received in the meantime, from this or another peer
+                short_inv_download.m_short_inv_announced.erase(shortInv.shortId);
+                short_inv_download.m_short_inv_in_flight.erase(shortInv.shortId);
+                continue;
+            }
+            auto it = g_short_inv_in_flight.find(shortInv.shortId);
+            if (it == g_short_inv_in_flight.end() || it->second <= current_time - GetObjectInterval(shortInv.type)) {
+                LogPrint(BCLog::NET, "Requesting short id %016x peer=%d\n", shortInv.shortId, pto->GetId());
+                vGetShortData.push_back(shortInv);
+                if (vGetShortData.size() >= MAX_GETDATA_SZ) {
+                    connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETSHORTDATA, vGetShortData));
+                    vGetShortData.clear();
+                }
+                g_short_inv_in_flight.insert_or_update(std::make_pair(shortInv.shortId, current_time));
+                short_inv_download.m_short_inv_in_flight.emplace(shortInv.shortId, current_time);
+            } else {
+                // In flight from another announcer, try again when that request timed out
+                short_inv_process_time.emplace(it->second + GetObjectInterval(shortInv.type), shortInv);
+            }
+        }
+        if (!vGetShortData.empty()) {
+            connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETSHORTDATA, vGetShortData));
+        }
+
     }
     return true;
 }
@@ -16,7 +16,7 @@ extern CCriticalSection cs_main;
 
 /** Default for -maxorphantxsize, maximum size in megabytes the orphan map can grow before entries are removed */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 10; // this allows around 100 TXs of max size (and many more of normal size)
-/** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
+/** Default number of orphan+rejected+recently-removed txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61 = true;
@@ -27,11 +27,16 @@ private:
 
 public:
     explicit PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler, bool enable_bip61);
+    ~PeerLogicValidation();
 
     /**
      * Overridden from CValidationInterface.
      */
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
+    /**
+     * Overridden from CValidationInterface.
+     */
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx, MemPoolRemovalReason reason) override;
     /**
      * Overridden from CValidationInterface.
      */
@@ -83,10 +88,27 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    int nBlocksInTransitLimit = 0;
+    int64_t nBlockDeliveryInterval = 0;
+    size_t nOrphans = 0;
+    size_t nOrphansSize = 0;
+};
+
+/** Counters for the reconstruction of compact blocks we requested */
+struct CompactBlockReconstructionStats {
+    uint64_t nBlocks = 0;                 //! compact blocks we tried to reconstruct
+    uint64_t nBlocksWithoutRoundTrip = 0; //! compact blocks which were reconstructed without a GETBLOCKTXN
+    uint64_t nBlocksFallback = 0;         //! compact blocks for which we had to fall back to a full block download
+    uint64_t nTxPrefilled = 0;
+    uint64_t nTxFromMempool = 0;
+    uint64_t nTxFromExtra = 0;            //! orphans, rejected and recently removed TXs
+    uint64_t nTxFromISLock = 0;           //! InstantSend locked TXs which were not in the mempool
+    uint64_t nTxRequested = 0;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
+CompactBlockReconstructionStats GetCompactBlockReconstructionStats();
 bool IsBanned(NodeId nodeid);
 
 // Upstream moved this into net_processing.cpp (13417), however since we use Misbehaving in a number of dash specific
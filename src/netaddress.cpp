@@ -586,6 +586,11 @@ std::vector<unsigned char> CService::GetKey() const
     return key;
 }
 
+uint64_t CService::GetSaltedHash(uint64_t k0, uint64_t k1) const
+{
+    return CSipHasher(k0, k1).Write(ip, sizeof(ip)).Write(((uint64_t)m_net << 16) | port).Finalize();
+}
+
 std::string CService::ToStringPort() const
 {
     return strprintf("%u", port);
@@ -214,6 +214,8 @@ class CService : public CNetAddr
         friend bool operator!=(const CService& a, const CService& b) { return !(a == b); }
         friend bool operator<(const CService& a, const CService& b);
         std::vector<unsigned char> GetKey() const;
+        //! Salted hash of the address and port for hash tables, consistent with operator==
+        uint64_t GetSaltedHash(uint64_t k0, uint64_t k1) const;
         std::string ToString(bool fUseGetnameinfo = true) const;
         std::string ToStringPort() const;
         std::string ToStringIPPort(bool fUseGetnameinfo = true) const;
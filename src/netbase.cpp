@@ -14,6 +14,11 @@
 #include <utilstrencodings.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #ifndef WIN32
 #include <fcntl.h>
@@ -33,11 +38,19 @@ static CCriticalSection cs_proxyInfos;
 static proxyType proxyInfo[NET_MAX] GUARDED_BY(cs_proxyInfos);
 static proxyType nameProxy GUARDED_BY(cs_proxyInfos);
 int nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
+int nLookupTimeout = DEFAULT_LOOKUP_TIMEOUT;
 bool fNameLookup = DEFAULT_NAME_LOOKUP;
 
-// Need ample time for negotiation for very slow proxies such as Tor (milliseconds)
-static const int SOCKS5_RECV_TIMEOUT = 20 * 1000;
 static std::atomic<bool> interruptSocks5Recv(false);
+static std::atomic<bool> interruptLookup(false);
+
+// Time successful name lookups are cached (seconds)
+static const int64_t LOOKUP_CACHE_TTL = 5 * 60;
+static const size_t MAX_LOOKUP_CACHE_SIZE = 1000;
+// Maximum number of resolver threads used by one set of lookups
+static const size_t MAX_PARALLEL_LOOKUPS = 16;
+// Maximum number of addresses kept per name lookup
+static const unsigned int MAX_LOOKUP_SOLUTIONS = 256;
 
 enum Network ParseNetwork(std::string net) {
     boost::to_lower(net);
@@ -61,18 +74,11 @@ std::string GetNetworkName(enum Network net) {
     }
 }
 
-bool static LookupIntern(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
+/** Resolve pszName with getaddrinfo, blocking until the resolver answered */
+static bool ResolveName(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
 {
     vIP.clear();
 
-    {
-        CNetAddr addr;
-        if (addr.SetSpecial(std::string(pszName))) {
-            vIP.push_back(addr);
-            return true;
-        }
-    }
-
     struct addrinfo aiHint;
     memset(&aiHint, 0, sizeof(struct addrinfo));
 
@@ -118,18 +124,216 @@ bool static LookupIntern(const char *pszName, std::vector<CNetAddr>& vIP, unsign
     return (vIP.size() > 0);
 }
 
-bool LookupHost(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
+/**
+ * Successful name lookups, so that names which are resolved repeatedly (e.g. -addnode) don't wait for the resolver
+ * every time. Allocated once and never freed, as resolver threads which timed out may still use it at shutdown.
+ */
+struct LookupCacheEntry {
+    std::vector<CNetAddr> vIP;
+    int64_t nExpiry;
+};
+static CCriticalSection& GetLookupCacheLock()
 {
-    std::string strHost(pszName);
-    if (strHost.empty())
+    static CCriticalSection* cs = new CCriticalSection();
+    return *cs;
+}
+static std::map<std::string, LookupCacheEntry>& GetLookupCache()
+{
+    static auto* cache = new std::map<std::string, LookupCacheEntry>();
+    return *cache;
+}
+
+static bool GetCachedLookup(const std::string& strName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions)
+{
+    LOCK(GetLookupCacheLock());
+    auto& cache = GetLookupCache();
+    auto it = cache.find(strName);
+    if (it == cache.end()) {
         return false;
-    if (strHost.front() == '[' && strHost.back() == ']') {
+    }
+    if (it->second.nExpiry < GetTime()) {
+        cache.erase(it);
+        return false;
+    }
+    size_t nCount = nMaxSolutions == 0 ? it->second.vIP.size() : std::min<size_t>(nMaxSolutions, it->second.vIP.size());
+    vIP.assign(it->second.vIP.begin(), it->second.vIP.begin() + nCount);
+    return true;
+}
+
+static void AddCachedLookup(const std::string& strName, const std::vector<CNetAddr>& vIP)
+{
+    LOCK(GetLookupCacheLock());
+    auto& cache = GetLookupCache();
+    int64_t nNow = GetTime();
+    if (cache.size() >= MAX_LOOKUP_CACHE_SIZE && !cache.count(strName)) {
+        for (auto it = cache.begin(); it != cache.end(); ) {
+            if (it->second.nExpiry < nNow) {
+                it = cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (cache.size() >= MAX_LOOKUP_CACHE_SIZE) {
+            cache.erase(cache.begin());
+        }
+    }
+    cache[strName] = {vIP, nNow + LOOKUP_CACHE_TTL};
+}
+
+void ClearLookupCache()
+{
+    LOCK(GetLookupCacheLock());
+    GetLookupCache().clear();
+}
+
+/** State of a set of lookups, shared with the resolver threads, which may outlive the waiting caller */
+struct ParallelLookup {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::string> vNames;
+    std::vector<std::vector<CNetAddr>> vResults;
+    size_t nNext{0};
+    size_t nPending{0};
+};
+
+static void ParallelLookupWorker(std::shared_ptr<ParallelLookup> state)
+{
+    while (true) {
+        std::string strName;
+        size_t i;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            // stop taking new names after the caller gave up
+            if (state->nNext >= state->vNames.size() || interruptLookup) {
+                return;
+            }
+            i = state->nNext++;
+            strName = state->vNames[i];
+        }
+        // cache the unlimited result, callers apply their own limit
+        std::vector<CNetAddr> vIP;
+        if (ResolveName(strName.c_str(), vIP, MAX_LOOKUP_SOLUTIONS, true)) {
+            AddCachedLookup(strName, vIP);
+        }
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->vResults[i] = std::move(vIP);
+            state->nPending--;
+        }
+        state->cond.notify_all();
+    }
+}
+
+/**
+ * Resolve names which are neither special nor cached on up to MAX_PARALLEL_LOOKUPS resolver threads at once,
+ * waiting at most nLookupTimeout milliseconds. Names which were not resolved in time get an empty result.
+ */
+static std::vector<std::vector<CNetAddr>> ResolveNamesParallel(const std::vector<std::string>& vNames)
+{
+    auto state = std::make_shared<ParallelLookup>();
+    state->vNames = vNames;
+    state->vResults.resize(vNames.size());
+    state->nPending = vNames.size();
+
+    size_t nThreads = std::min<size_t>(vNames.size(), MAX_PARALLEL_LOOKUPS);
+    for (size_t i = 0; i < nThreads; i++) {
+        // getaddrinfo can't be cancelled, so the threads are not joined and finish on their own after a timeout
+        std::thread(ParallelLookupWorker, state).detach();
+    }
+
+    int64_t nEndTime = GetTimeMillis() + nLookupTimeout;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (state->nPending > 0 && !interruptLookup) {
+        int64_t nNow = GetTimeMillis();
+        if (nNow >= nEndTime) {
+            LogPrintf("%s: %d of %d name lookups timed out\n", __func__, state->nPending, vNames.size());
+            break;
+        }
+        // wake up regularly to notice interruption
+        state->cond.wait_for(lock, std::chrono::milliseconds(std::min<int64_t>(nEndTime - nNow, 100)));
+    }
+    // the threads which are still resolving write their result into the shared state, not into the returned copy
+    state->nNext = state->vNames.size();
+    return state->vResults;
+}
+
+bool static LookupIntern(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
+{
+    vIP.clear();
+
+    {
+        CNetAddr addr;
+        if (addr.SetSpecial(std::string(pszName))) {
+            vIP.push_back(addr);
+            return true;
+        }
+    }
+
+    // numeric hosts are resolved without asking the resolver
+    if (ResolveName(pszName, vIP, nMaxSolutions, false) || !fAllowLookup) {
+        return vIP.size() > 0;
+    }
+
+    if (GetCachedLookup(pszName, vIP, nMaxSolutions)) {
+        return true;
+    }
+    std::vector<CNetAddr> vResolved = ResolveNamesParallel({std::string(pszName)})[0];
+    size_t nCount = nMaxSolutions == 0 ? vResolved.size() : std::min<size_t>(nMaxSolutions, vResolved.size());
+    vIP.assign(vResolved.begin(), vResolved.begin() + nCount);
+    return (vIP.size() > 0);
+}
+
+/** Strip the brackets around an IPv6 address */
+static std::string LookupHostName(const char *pszName)
+{
+    std::string strHost(pszName);
+    if (!strHost.empty() && strHost.front() == '[' && strHost.back() == ']') {
         strHost = strHost.substr(1, strHost.size() - 2);
     }
+    return strHost;
+}
+
+bool LookupHost(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup)
+{
+    std::string strHost = LookupHostName(pszName);
+    if (strHost.empty())
+        return false;
 
     return LookupIntern(strHost.c_str(), vIP, nMaxSolutions, fAllowLookup);
 }
 
+std::vector<std::vector<CNetAddr>> LookupHosts(const std::vector<std::string>& vNames, unsigned int nMaxSolutions)
+{
+    std::vector<std::vector<CNetAddr>> vResults(vNames.size());
+    // names which need the resolver, with their index in vNames
+    std::vector<std::string> vResolve;
+    std::vector<size_t> vResolveIndexes;
+    for (size_t i = 0; i < vNames.size(); i++) {
+        std::string strHost = LookupHostName(vNames[i].c_str());
+        if (strHost.empty()) {
+            continue;
+        }
+        CNetAddr addr;
+        if (addr.SetSpecial(strHost)) {
+            vResults[i].push_back(addr);
+        } else if (!ResolveName(strHost.c_str(), vResults[i], nMaxSolutions, false) && !GetCachedLookup(strHost, vResults[i], nMaxSolutions)) {
+            vResolve.emplace_back(strHost);
+            vResolveIndexes.emplace_back(i);
+        }
+    }
+    if (vResolve.empty()) {
+        return vResults;
+    }
+
+    std::vector<std::vector<CNetAddr>> vResolved = ResolveNamesParallel(vResolve);
+    for (size_t j = 0; j < vResolved.size(); j++) {
+        auto& vIP = vResults[vResolveIndexes[j]];
+        size_t nCount = nMaxSolutions == 0 ? vResolved[j].size() : std::min<size_t>(nMaxSolutions, vResolved[j].size());
+        vIP.assign(vResolved[j].begin(), vResolved[j].begin() + nCount);
+    }
+    return vResults;
+}
+
 bool LookupHost(const char *pszName, CNetAddr& addr, bool fAllowLookup)
 {
     std::vector<CNetAddr> vIP;
@@ -227,80 +431,27 @@ enum SOCKS5Atyp: uint8_t {
     IPV6 = 0x04,
 };
 
-/** Status codes that can be returned by InterruptibleRecv */
-enum class IntrRecvError {
-    OK,
-    Timeout,
-    Disconnected,
-    NetworkError,
-    Interrupted
-};
-
 /**
- * Read bytes from socket. This will either read the full number of bytes requested
- * or return False on error or timeout.
- * This function can be interrupted by calling InterruptSocks5()
+ * Wait until a socket is readable (or, if fWrite, writable), or until the timeout passes.
  *
- * @param data Buffer to receive into
- * @param len  Length of data to receive
- * @param timeout  Timeout in milliseconds for receive operation
- *
- * @note This function requires that hSocket is in non-blocking mode.
+ * @return the number of ready sockets (0 or 1), or SOCKET_ERROR
  */
-static IntrRecvError InterruptibleRecv(uint8_t* data, size_t len, int timeout, const SOCKET& hSocket)
+static int WaitForSocket(const SOCKET& hSocket, bool fWrite, int64_t timeout_ms)
 {
-    int64_t curTime = GetTimeMillis();
-    int64_t endTime = curTime + timeout;
-    // Maximum time to wait in one select call. It will take up until this time (in millis)
-    // to break off in case of an interruption.
-    const int64_t maxWait = 1000;
-    while (len > 0 && curTime < endTime) {
-        ssize_t ret = recv(hSocket, (char*)data, len, 0); // Optimistically try the recv first
-        if (ret > 0) {
-            len -= ret;
-            data += ret;
-        } else if (ret == 0) { // Unexpected disconnection
-            return IntrRecvError::Disconnected;
-        } else { // Other error or blocking
-            int nErr = WSAGetLastError();
-            if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL) {
-                if (!IsSelectableSocket(hSocket)) {
-                    return IntrRecvError::NetworkError;
-                }
-                int timeout_ms = std::min(endTime - curTime, maxWait);
 #ifdef USE_POLL
-                struct pollfd pollfd = {};
-                pollfd.fd = hSocket;
-                pollfd.events = POLLIN | POLLOUT;
-                int nRet = poll(&pollfd, 1, timeout_ms);
+    struct pollfd pollfd = {};
+    pollfd.fd = hSocket;
+    pollfd.events = fWrite ? POLLOUT : POLLIN;
+    return poll(&pollfd, 1, timeout_ms);
 #else
-                struct timeval tval = MillisToTimeval(timeout_ms);
-                fd_set fdset;
-                FD_ZERO(&fdset);
-                FD_SET(hSocket, &fdset);
-                int nRet = select(hSocket + 1, &fdset, nullptr, nullptr, &tval);
+    struct timeval tval = MillisToTimeval(timeout_ms);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(hSocket, &fdset);
+    return select(hSocket + 1, fWrite ? nullptr : &fdset, fWrite ? &fdset : nullptr, nullptr, &tval);
 #endif
-                if (nRet == SOCKET_ERROR) {
-                    return IntrRecvError::NetworkError;
-                }
-            } else {
-                return IntrRecvError::NetworkError;
-            }
-        }
-        if (interruptSocks5Recv)
-            return IntrRecvError::Interrupted;
-        curTime = GetTimeMillis();
-    }
-    return len == 0 ? IntrRecvError::OK : IntrRecvError::Timeout;
 }
 
-/** Credentials for proxy authentication */
-struct ProxyCredentials
-{
-    std::string username;
-    std::string password;
-};
-
 /** Convert SOCKS5 reply to an error message */
 std::string Socks5ErrorString(uint8_t err)
 {
@@ -326,123 +477,216 @@ std::string Socks5ErrorString(uint8_t err)
     }
 }
 
-/** Connect using SOCKS5 (as described in RFC1928) */
-static bool Socks5(const std::string& strDest, int port, const ProxyCredentials *auth, const SOCKET& hSocket)
+Socks5Handshake::Socks5Handshake(const std::string& _strDest, int _port, const ProxyCredentials* _auth) :
+    strDest(_strDest),
+    port(_port)
 {
-    IntrRecvError recvr;
-    LogPrint(BCLog::NET, "SOCKS5 connecting %s\n", strDest);
     if (strDest.size() > 255) {
-        return error("Hostname too long");
+        Fail("Hostname too long");
+        return;
+    }
+    if (_auth) {
+        auth = *_auth;
+        fAuth = true;
     }
     // Accepted authentication methods
-    std::vector<uint8_t> vSocks5Init;
-    vSocks5Init.push_back(SOCKSVersion::SOCKS5);
-    if (auth) {
-        vSocks5Init.push_back(0x02); // Number of methods
-        vSocks5Init.push_back(SOCKS5Method::NOAUTH);
-        vSocks5Init.push_back(SOCKS5Method::USER_PASS);
+    vSend.push_back(SOCKSVersion::SOCKS5);
+    if (fAuth) {
+        vSend.push_back(0x02); // Number of methods
+        vSend.push_back(SOCKS5Method::NOAUTH);
+        vSend.push_back(SOCKS5Method::USER_PASS);
     } else {
-        vSocks5Init.push_back(0x01); // Number of methods
-        vSocks5Init.push_back(SOCKS5Method::NOAUTH);
+        vSend.push_back(0x01); // Number of methods
+        vSend.push_back(SOCKS5Method::NOAUTH);
     }
-    ssize_t ret = send(hSocket, (const char*)vSocks5Init.data(), vSocks5Init.size(), MSG_NOSIGNAL);
-    if (ret != (ssize_t)vSocks5Init.size()) {
-        return error("Error sending to proxy");
+    Expect(State::METHOD, 2);
+}
+
+void Socks5Handshake::Expect(State nextState, size_t nBytes)
+{
+    state = nextState;
+    vRecv.clear();
+    nRecvNeeded = nBytes;
+}
+
+Socks5Handshake::Status Socks5Handshake::Fail(const std::string& strError)
+{
+    state = State::FAILED;
+    strErrorRet = strError;
+    vSend.clear();
+    vRecv.clear();
+    nRecvNeeded = 0;
+    return Status::FAILED;
+}
+
+Socks5Handshake::Status Socks5Handshake::GetStatus() const
+{
+    switch (state) {
+    case State::SUCCEEDED: return Status::SUCCEEDED;
+    case State::FAILED: return Status::FAILED;
+    default: return Status::IN_PROGRESS;
     }
-    uint8_t pchRet1[2];
-    if ((recvr = InterruptibleRecv(pchRet1, 2, SOCKS5_RECV_TIMEOUT, hSocket)) != IntrRecvError::OK) {
-        LogPrintf("Socks5() connect to %s:%d failed: InterruptibleRecv() timeout or other failure\n", strDest, port);
-        return false;
+}
+
+size_t Socks5Handshake::BytesNeeded() const
+{
+    // Every request is answered by the proxy, so nothing is read before the request is sent completely
+    if (!vSend.empty()) {
+        return 0;
     }
-    if (pchRet1[0] != SOCKSVersion::SOCKS5) {
-        return error("Proxy failed to initialize");
-    }
-    if (pchRet1[1] == SOCKS5Method::USER_PASS && auth) {
-        // Perform username/password authentication (as described in RFC1929)
-        std::vector<uint8_t> vAuth;
-        vAuth.push_back(0x01); // Current (and only) version of user/pass subnegotiation
-        if (auth->username.size() > 255 || auth->password.size() > 255)
-            return error("Proxy username or password too long");
-        vAuth.push_back(auth->username.size());
-        vAuth.insert(vAuth.end(), auth->username.begin(), auth->username.end());
-        vAuth.push_back(auth->password.size());
-        vAuth.insert(vAuth.end(), auth->password.begin(), auth->password.end());
-        ret = send(hSocket, (const char*)vAuth.data(), vAuth.size(), MSG_NOSIGNAL);
-        if (ret != (ssize_t)vAuth.size()) {
-            return error("Error sending authentication to proxy");
+    return nRecvNeeded - vRecv.size();
+}
+
+void Socks5Handshake::Sent(size_t nBytes)
+{
+    assert(nBytes <= vSend.size());
+    vSend.erase(vSend.begin(), vSend.begin() + nBytes);
+}
+
+Socks5Handshake::Status Socks5Handshake::Received(const uint8_t* data, size_t len)
+{
+    assert(len <= BytesNeeded());
+    vRecv.insert(vRecv.end(), data, data + len);
+    if (vRecv.size() < nRecvNeeded) {
+        return GetStatus();
+    }
+
+    switch (state) {
+    case State::METHOD:
+        if (vRecv[0] != SOCKSVersion::SOCKS5) {
+            return Fail("Proxy failed to initialize");
         }
-        LogPrint(BCLog::PROXY, "SOCKS5 sending proxy authentication %s:%s\n", auth->username, auth->password);
-        uint8_t pchRetA[2];
-        if ((recvr = InterruptibleRecv(pchRetA, 2, SOCKS5_RECV_TIMEOUT, hSocket)) != IntrRecvError::OK) {
-            return error("Error reading proxy authentication response");
+        if (vRecv[1] == SOCKS5Method::USER_PASS && fAuth) {
+            // Perform username/password authentication (as described in RFC1929)
+            if (auth.username.size() > 255 || auth.password.size() > 255) {
+                return Fail("Proxy username or password too long");
+            }
+            vSend.push_back(0x01); // Current (and only) version of user/pass subnegotiation
+            vSend.push_back(auth.username.size());
+            vSend.insert(vSend.end(), auth.username.begin(), auth.username.end());
+            vSend.push_back(auth.password.size());
+            vSend.insert(vSend.end(), auth.password.begin(), auth.password.end());
+            LogPrint(BCLog::PROXY, "SOCKS5 sending proxy authentication %s:%s\n", auth.username, auth.password);
+            Expect(State::AUTH, 2);
+            return Status::IN_PROGRESS;
+        } else if (vRecv[1] == SOCKS5Method::NOAUTH) {
+            // Perform no authentication
+            SendConnect();
+            return Status::IN_PROGRESS;
         }
-        if (pchRetA[0] != 0x01 || pchRetA[1] != 0x00) {
-            return error("Proxy authentication unsuccessful");
+        return Fail(strprintf("Proxy requested wrong authentication method %02x", vRecv[1]));
+    case State::AUTH:
+        if (vRecv[0] != 0x01 || vRecv[1] != 0x00) {
+            return Fail("Proxy authentication unsuccessful");
         }
-    } else if (pchRet1[1] == SOCKS5Method::NOAUTH) {
-        // Perform no authentication
-    } else {
-        return error("Proxy requested wrong authentication method %02x", pchRet1[1]);
-    }
-    std::vector<uint8_t> vSocks5;
-    vSocks5.push_back(SOCKSVersion::SOCKS5); // VER protocol version
-    vSocks5.push_back(SOCKS5Command::CONNECT); // CMD CONNECT
-    vSocks5.push_back(0x00); // RSV Reserved must be 0
-    vSocks5.push_back(SOCKS5Atyp::DOMAINNAME); // ATYP DOMAINNAME
-    vSocks5.push_back(strDest.size()); // Length<=255 is checked at beginning of function
-    vSocks5.insert(vSocks5.end(), strDest.begin(), strDest.end());
-    vSocks5.push_back((port >> 8) & 0xFF);
-    vSocks5.push_back((port >> 0) & 0xFF);
-    ret = send(hSocket, (const char*)vSocks5.data(), vSocks5.size(), MSG_NOSIGNAL);
-    if (ret != (ssize_t)vSocks5.size()) {
-        return error("Error sending to proxy");
-    }
-    uint8_t pchRet2[4];
-    if ((recvr = InterruptibleRecv(pchRet2, 4, SOCKS5_RECV_TIMEOUT, hSocket)) != IntrRecvError::OK) {
-        if (recvr == IntrRecvError::Timeout) {
-            /* If a timeout happens here, this effectively means we timed out while connecting
-             * to the remote node. This is very common for Tor, so do not print an
-             * error message. */
-            return false;
-        } else {
-            return error("Error while reading proxy response");
+        SendConnect();
+        return Status::IN_PROGRESS;
+    case State::CONNECT:
+        if (vRecv[0] != SOCKSVersion::SOCKS5) {
+            return Fail("Proxy failed to accept request");
         }
-    }
-    if (pchRet2[0] != SOCKSVersion::SOCKS5) {
-        return error("Proxy failed to accept request");
-    }
-    if (pchRet2[1] != SOCKS5Reply::SUCCEEDED) {
-        // Failures to connect to a peer that are not proxy errors
-        LogPrintf("Socks5() connect to %s:%d failed: %s\n", strDest, port, Socks5ErrorString(pchRet2[1]));
-        return false;
-    }
-    if (pchRet2[2] != 0x00) { // Reserved field must be 0
-        return error("Error: malformed proxy response");
-    }
-    uint8_t pchRet3[256];
-    switch (pchRet2[3])
-    {
-        case SOCKS5Atyp::IPV4: recvr = InterruptibleRecv(pchRet3, 4, SOCKS5_RECV_TIMEOUT, hSocket); break;
-        case SOCKS5Atyp::IPV6: recvr = InterruptibleRecv(pchRet3, 16, SOCKS5_RECV_TIMEOUT, hSocket); break;
-        case SOCKS5Atyp::DOMAINNAME:
-        {
-            recvr = InterruptibleRecv(pchRet3, 1, SOCKS5_RECV_TIMEOUT, hSocket);
-            if (recvr != IntrRecvError::OK) {
-                return error("Error reading from proxy");
+        if (vRecv[1] != SOCKS5Reply::SUCCEEDED) {
+            // Failures to connect to a peer that are not proxy errors
+            fDestinationFailure = true;
+            return Fail(Socks5ErrorString(vRecv[1]));
+        }
+        if (vRecv[2] != 0x00) { // Reserved field must be 0
+            return Fail("Error: malformed proxy response");
+        }
+        // The bound address and port follow, which are not needed
+        switch (vRecv[3]) {
+        case SOCKS5Atyp::IPV4: Expect(State::BOUND_ADDR, 4 + 2); break;
+        case SOCKS5Atyp::IPV6: Expect(State::BOUND_ADDR, 16 + 2); break;
+        case SOCKS5Atyp::DOMAINNAME: Expect(State::BOUND_ADDR_LEN, 1); break;
+        default: return Fail("Error: malformed proxy response");
+        }
+        return Status::IN_PROGRESS;
+    case State::BOUND_ADDR_LEN:
+        Expect(State::BOUND_ADDR, vRecv[0] + 2);
+        return Status::IN_PROGRESS;
+    case State::BOUND_ADDR:
+        Expect(State::SUCCEEDED, 0);
+        LogPrint(BCLog::NET, "SOCKS5 connected %s\n", strDest);
+        return Status::SUCCEEDED;
+    case State::SUCCEEDED:
+    case State::FAILED:
+        break;
+    }
+    return GetStatus();
+}
+
+void Socks5Handshake::SendConnect()
+{
+    vSend.push_back(SOCKSVersion::SOCKS5); // VER protocol version
+    vSend.push_back(SOCKS5Command::CONNECT); // CMD CONNECT
+    vSend.push_back(0x00); // RSV Reserved must be 0
+    vSend.push_back(SOCKS5Atyp::DOMAINNAME); // ATYP DOMAINNAME
+    vSend.push_back(strDest.size()); // Length<=255 is checked in the constructor
+    vSend.insert(vSend.end(), strDest.begin(), strDest.end());
+    vSend.push_back((port >> 8) & 0xFF);
+    vSend.push_back((port >> 0) & 0xFF);
+    Expect(State::CONNECT, 4);
+}
+
+Socks5Handshake::Status Socks5Handshake::Advance(const SOCKET& hSocket)
+{
+    while (GetStatus() == Status::IN_PROGRESS) {
+        if (!vSend.empty()) {
+            ssize_t ret = send(hSocket, (const char*)vSend.data(), vSend.size(), MSG_NOSIGNAL);
+            if (ret > 0) {
+                Sent(ret);
+                continue;
+            }
+        } else {
+            uint8_t buf[256];
+            ssize_t ret = recv(hSocket, (char*)buf, std::min(BytesNeeded(), sizeof(buf)), 0);
+            if (ret > 0) {
+                Received(buf, ret);
+                continue;
+            }
+            if (ret == 0) { // Unexpected disconnection
+                return Fail("Proxy closed the connection");
             }
-            int nRecv = pchRet3[0];
-            recvr = InterruptibleRecv(pchRet3, nRecv, SOCKS5_RECV_TIMEOUT, hSocket);
+        }
+        int nErr = WSAGetLastError();
+        if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL) {
             break;
         }
-        default: return error("Error: malformed proxy response");
+        return Fail(strprintf("Error communicating with proxy: %s", NetworkErrorString(nErr)));
     }
-    if (recvr != IntrRecvError::OK) {
-        return error("Error reading from proxy");
+    return GetStatus();
+}
+
+/** Connect using SOCKS5 (as described in RFC1928), waiting until the handshake finished */
+static bool Socks5(const std::string& strDest, int port, const ProxyCredentials *auth, const SOCKET& hSocket)
+{
+    LogPrint(BCLog::NET, "SOCKS5 connecting %s\n", strDest);
+    Socks5Handshake handshake(strDest, port, auth);
+
+    int64_t curTime = GetTimeMillis();
+    int64_t endTime = curTime + SOCKS5_RECV_TIMEOUT;
+    // Maximum time to wait in one select call. It will take up until this time (in millis)
+    // to break off in case of an interruption.
+    const int64_t maxWait = 1000;
+    while (handshake.Advance(hSocket) == Socks5Handshake::Status::IN_PROGRESS) {
+        if (interruptSocks5Recv) {
+            return false;
+        }
+        if (curTime >= endTime) {
+            /* A timeout while waiting for the reply to the connect request effectively means we timed out while
+             * connecting to the remote node. This is very common for Tor, so do not print an error message. */
+            LogPrint(BCLog::NET, "Socks5() connect to %s:%d failed: timeout\n", strDest, port);
+            return false;
+        }
+        if (!IsSelectableSocket(hSocket) || WaitForSocket(hSocket, handshake.WantsWrite(), std::min(endTime - curTime, maxWait)) == SOCKET_ERROR) {
+            return error("Error while communicating with proxy");
+        }
+        curTime = GetTimeMillis();
     }
-    if ((recvr = InterruptibleRecv(pchRet3, 2, SOCKS5_RECV_TIMEOUT, hSocket)) != IntrRecvError::OK) {
-        return error("Error reading from proxy");
+    if (handshake.GetStatus() == Socks5Handshake::Status::FAILED) {
+        LogPrintf("Socks5() connect to %s:%d failed: %s\n", strDest, port, handshake.GetError());
+        return false;
     }
-    LogPrint(BCLog::NET, "SOCKS5 connected %s\n", strDest);
     return true;
 }
 
@@ -492,17 +736,17 @@ static void LogConnectFailure(bool manual_connection, const char* fmt, const Arg
     }
 }
 
-bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET& hSocket, int nTimeout, bool manual_connection)
+SocketConnectStatus StartConnectSocket(const CService &addrConnect, const SOCKET& hSocket, bool manual_connection)
 {
     struct sockaddr_storage sockaddr;
     socklen_t len = sizeof(sockaddr);
     if (hSocket == INVALID_SOCKET) {
         LogPrintf("Cannot connect to %s: invalid socket\n", addrConnect.ToString());
-        return false;
+        return SocketConnectStatus::FAILED;
     }
     if (!addrConnect.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
         LogPrintf("Cannot connect to %s: unsupported network\n", addrConnect.ToString());
-        return false;
+        return SocketConnectStatus::FAILED;
     }
     if (connect(hSocket, (struct sockaddr*)&sockaddr, len) == SOCKET_ERROR)
     {
@@ -510,39 +754,7 @@ bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET& hSocket, i
         // WSAEINVAL is here because some legacy version of winsock uses it
         if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL)
         {
-#ifdef USE_POLL
-            struct pollfd pollfd = {};
-            pollfd.fd = hSocket;
-            pollfd.events = POLLIN | POLLOUT;
-            int nRet = poll(&pollfd, 1, nTimeout);
-#else
-            struct timeval timeout = MillisToTimeval(nTimeout);
-            fd_set fdset;
-            FD_ZERO(&fdset);
-            FD_SET(hSocket, &fdset);
-            int nRet = select(hSocket + 1, nullptr, &fdset, nullptr, &timeout);
-#endif
-            if (nRet == 0)
-            {
-                LogPrint(BCLog::NET, "connection to %s timeout\n", addrConnect.ToString());
-                return false;
-            }
-            if (nRet == SOCKET_ERROR)
-            {
-                LogPrintf("select() for %s failed: %s\n", addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
-                return false;
-            }
-            socklen_t nRetSize = sizeof(nRet);
-            if (getsockopt(hSocket, SOL_SOCKET, SO_ERROR, (sockopt_arg_type)&nRet, &nRetSize) == SOCKET_ERROR)
-            {
-                LogPrintf("getsockopt() for %s failed: %s\n", addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
-                return false;
-            }
-            if (nRet != 0)
-            {
-                LogConnectFailure(manual_connection, "connect() to %s failed after select(): %s", addrConnect.ToString(), NetworkErrorString(nRet));
-                return false;
-            }
+            return SocketConnectStatus::IN_PROGRESS;
         }
 #ifdef WIN32
         else if (WSAGetLastError() != WSAEISCONN)
@@ -551,12 +763,54 @@ bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET& hSocket, i
 #endif
         {
             LogConnectFailure(manual_connection, "connect() to %s failed: %s", addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
-            return false;
+            return SocketConnectStatus::FAILED;
         }
     }
+    return SocketConnectStatus::CONNECTED;
+}
+
+bool FinishConnectSocket(const CService &addrConnect, const SOCKET& hSocket, bool manual_connection)
+{
+    int nRet;
+    socklen_t nRetSize = sizeof(nRet);
+    if (getsockopt(hSocket, SOL_SOCKET, SO_ERROR, (sockopt_arg_type)&nRet, &nRetSize) == SOCKET_ERROR)
+    {
+        LogPrintf("getsockopt() for %s failed: %s\n", addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    if (nRet != 0)
+    {
+        LogConnectFailure(manual_connection, "connect() to %s failed after select(): %s", addrConnect.ToString(), NetworkErrorString(nRet));
+        return false;
+    }
     return true;
 }
 
+bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET& hSocket, int nTimeout, bool manual_connection)
+{
+    switch (StartConnectSocket(addrConnect, hSocket, manual_connection)) {
+    case SocketConnectStatus::CONNECTED:
+        return true;
+    case SocketConnectStatus::FAILED:
+        return false;
+    case SocketConnectStatus::IN_PROGRESS:
+        break;
+    }
+
+    int nRet = WaitForSocket(hSocket, true, nTimeout);
+    if (nRet == 0)
+    {
+        LogPrint(BCLog::NET, "connection to %s timeout\n", addrConnect.ToString());
+        return false;
+    }
+    if (nRet == SOCKET_ERROR)
+    {
+        LogPrintf("select() for %s failed: %s\n", addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    return FinishConnectSocket(addrConnect, hSocket, manual_connection);
+}
+
 bool SetProxy(enum Network net, const proxyType &addrProxy) {
     assert(net >= 0 && net < NET_MAX);
     if (!addrProxy.IsValid())
@@ -614,18 +868,18 @@ bool ConnectThroughProxy(const proxyType &proxy, const std::string& strDest, int
         return false;
     }
     // do socks negotiation
-    if (proxy.randomize_credentials) {
-        ProxyCredentials random_auth;
-        static std::atomic_int counter(0);
-        random_auth.username = random_auth.password = strprintf("%i", counter++);
-        if (!Socks5(strDest, (unsigned short)port, &random_auth, hSocket)) {
-            return false;
-        }
-    } else {
-        if (!Socks5(strDest, (unsigned short)port, 0, hSocket)) {
-            return false;
-        }
+    ProxyCredentials random_auth;
+    bool fAuth = GetProxyCredentials(proxy, random_auth);
+    return Socks5(strDest, (unsigned short)port, fAuth ? &random_auth : nullptr, hSocket);
+}
+
+bool GetProxyCredentials(const proxyType& proxy, ProxyCredentials& credentialsRet)
+{
+    if (!proxy.randomize_credentials) {
+        return false;
     }
+    static std::atomic_int counter(0);
+    credentialsRet.username = credentialsRet.password = strprintf("%i", counter++);
     return true;
 }
 
@@ -755,3 +1009,8 @@ void InterruptSocks5(bool interrupt)
 {
     interruptSocks5Recv = interrupt;
 }
+
+void InterruptLookup(bool interrupt)
+{
+    interruptLookup = interrupt;
+}
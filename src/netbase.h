@@ -18,10 +18,13 @@
 #include <vector>
 
 extern int nConnectTimeout;
+extern int nLookupTimeout;
 extern bool fNameLookup;
 
 //! -timeout default
 static const int DEFAULT_CONNECT_TIMEOUT = 5000;
+//! -dnstimeout default
+static const int DEFAULT_LOOKUP_TIMEOUT = 10000;
 //! -dns default
 static const int DEFAULT_NAME_LOOKUP = true;
 static const bool DEFAULT_ALLOWPRIVATENET = false;
@@ -38,6 +41,85 @@ public:
     bool randomize_credentials;
 };
 
+/** Credentials for proxy authentication */
+struct ProxyCredentials
+{
+    std::string username;
+    std::string password;
+};
+
+// Need ample time for negotiation for very slow proxies such as Tor (milliseconds)
+static const int SOCKS5_RECV_TIMEOUT = 20 * 1000;
+
+/**
+ * Client side of a SOCKS5 (RFC1928) handshake to connect to strDest:port through a proxy.
+ *
+ * The handshake does not block: Advance sends and receives whatever is possible on a non-blocking socket and returns
+ * IN_PROGRESS until it either succeeded or failed, so that it can be continued once the socket is ready again. The
+ * protocol itself can also be driven without a socket, through GetSendBuffer/Sent and BytesNeeded/Received.
+ */
+class Socks5Handshake
+{
+public:
+    enum class Status {
+        IN_PROGRESS,
+        SUCCEEDED,
+        FAILED
+    };
+
+    Socks5Handshake(const std::string& strDest, int port, const ProxyCredentials* auth);
+
+    Status Advance(const SOCKET& hSocket);
+
+    Status GetStatus() const;
+    /** Error message after the handshake FAILED */
+    const std::string& GetError() const { return strErrorRet; }
+    /** Whether the proxy refused to connect to the destination, as opposed to a failure of the proxy itself */
+    bool IsDestinationFailure() const { return fDestinationFailure; }
+    /** Whether data is waiting to be sent, so that the socket has to become writable to make progress */
+    bool WantsWrite() const { return !vSend.empty(); }
+
+    const std::vector<uint8_t>& GetSendBuffer() const { return vSend; }
+    void Sent(size_t nBytes);
+    /** Number of bytes to be received before the handshake can continue, 0 while data is waiting to be sent */
+    size_t BytesNeeded() const;
+    /** Process received data, which must not be more than BytesNeeded() */
+    Status Received(const uint8_t* data, size_t len);
+
+private:
+    enum class State {
+        METHOD,
+        AUTH,
+        CONNECT,
+        BOUND_ADDR_LEN,
+        BOUND_ADDR,
+        SUCCEEDED,
+        FAILED
+    };
+
+    std::string strDest;
+    int port;
+    ProxyCredentials auth;
+    bool fAuth{false};
+
+    State state{State::FAILED};
+    std::vector<uint8_t> vSend;
+    std::vector<uint8_t> vRecv;
+    size_t nRecvNeeded{0};
+    std::string strErrorRet;
+    bool fDestinationFailure{false};
+
+    void Expect(State nextState, size_t nBytes);
+    Status Fail(const std::string& strError);
+    void SendConnect();
+};
+
+enum class SocketConnectStatus {
+    CONNECTED,
+    IN_PROGRESS,
+    FAILED
+};
+
 enum Network ParseNetwork(std::string net);
 std::string GetNetworkName(enum Network net);
 bool SetProxy(enum Network net, const proxyType &addrProxy);
@@ -48,13 +130,26 @@ bool HaveNameProxy();
 bool GetNameProxy(proxyType &nameProxyOut);
 bool LookupHost(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions, bool fAllowLookup);
 bool LookupHost(const char *pszName, CNetAddr& addr, bool fAllowLookup);
+/**
+ * Look up several host names in parallel, waiting at most nLookupTimeout milliseconds for all of them.
+ * The result has one entry per name, which is empty if the name could not be resolved (in time).
+ */
+std::vector<std::vector<CNetAddr>> LookupHosts(const std::vector<std::string>& vNames, unsigned int nMaxSolutions);
+/** Forget cached name lookups */
+void ClearLookupCache();
 bool Lookup(const char *pszName, CService& addr, int portDefault, bool fAllowLookup);
 bool Lookup(const char *pszName, std::vector<CService>& vAddr, int portDefault, bool fAllowLookup, unsigned int nMaxSolutions);
 CService LookupNumeric(const char *pszName, int portDefault = 0);
 bool LookupSubNet(const char *pszName, CSubNet& subnet);
 SOCKET CreateSocket(const CService &addrConnect);
 bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET& hSocketRet, int nTimeout, bool manual_connection);
+/** Start connecting a non-blocking socket. When IN_PROGRESS, call FinishConnectSocket once the socket is writable. */
+SocketConnectStatus StartConnectSocket(const CService &addrConnect, const SOCKET& hSocket, bool manual_connection);
+/** Check the result of a connect which was IN_PROGRESS, after the socket became writable */
+bool FinishConnectSocket(const CService &addrConnect, const SOCKET& hSocket, bool manual_connection);
 bool ConnectThroughProxy(const proxyType &proxy, const std::string& strDest, int port, const SOCKET& hSocketRet, int nTimeout, bool *outProxyConnectionFailed);
+/** Get the credentials to use for a new connection through proxy. Returns false if no credentials are needed. */
+bool GetProxyCredentials(const proxyType& proxy, ProxyCredentials& credentialsRet);
 /** Return readable error string for a network error code */
 std::string NetworkErrorString(int err);
 /** Close socket and set hSocket to INVALID_SOCKET */
@@ -68,5 +163,7 @@ bool SetSocketNoDelay(const SOCKET& hSocket);
  */
 struct timeval MillisToTimeval(int64_t nTimeout);
 void InterruptSocks5(bool interrupt);
+/** Make pending and new lookups through the resolver fail immediately */
+void InterruptLookup(bool interrupt);
 
 #endif // BITCOIN_NETBASE_H
@@ -13,7 +13,9 @@ void CNetFulfilledRequestManager::AddFulfilledRequest(const CService& addr, cons
 {
     LOCK(cs_mapFulfilledRequests);
     CService addrSquashed = Params().AllowMultiplePorts() ? addr : CService(addr, 0);
-    mapFulfilledRequests[addrSquashed][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    int64_t nExpiry = GetTime() + Params().FulfilledRequestExpireTime();
+    mapFulfilledRequests[addrSquashed][strRequest] = nExpiry;
+    requestsExpiry.schedule(std::make_pair(addrSquashed, strRequest), nExpiry);
 }
 
 bool CNetFulfilledRequestManager::HasFulfilledRequest(const CService& addr, const std::string& strRequest)
@@ -35,6 +37,11 @@ void CNetFulfilledRequestManager::RemoveFulfilledRequest(const CService& addr, c
 
     if (it != mapFulfilledRequests.end()) {
         it->second.erase(strRequest);
+        requestsExpiry.erase(std::make_pair(addrSquashed, strRequest));
+        // CheckAndRemove only looks at the addresses of expired requests, so empty entries are not left behind
+        if (it->second.empty()) {
+            mapFulfilledRequests.erase(it);
+        }
     }
 }
 
@@ -45,6 +52,9 @@ void CNetFulfilledRequestManager::RemoveAllFulfilledRequests(const CService& add
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addrSquashed);
 
     if (it != mapFulfilledRequests.end()) {
+        for (const auto& p : it->second) {
+            requestsExpiry.erase(std::make_pair(addrSquashed, p.first));
+        }
         mapFulfilledRequests.erase(it++);
     }
 }
@@ -53,22 +63,15 @@ void CNetFulfilledRequestManager::CheckAndRemove()
 {
     LOCK(cs_mapFulfilledRequests);
 
-    int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
-
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
-            } else {
-                ++it_entry;
-            }
+    // requests are kept until the second after their expiry time
+    for (const auto& key : requestsExpiry.pop_expired(GetTime() - 1)) {
+        fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(key.first);
+        if (it == mapFulfilledRequests.end()) {
+            continue;
         }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
+        it->second.erase(key.second);
+        if (it->second.empty()) {
+            mapFulfilledRequests.erase(it);
         }
     }
 }
@@ -77,6 +80,7 @@ void CNetFulfilledRequestManager::Clear()
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests.clear();
+    requestsExpiry.clear();
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_NETFULFILLEDMAN_H
 #define BITCOIN_NETFULFILLEDMAN_H
 
+#include <expiryqueue.h>
 #include <netaddress.h>
 #include <serialize.h>
 #include <sync.h>
@@ -22,6 +23,8 @@ private:
 
     //keep track of what node has/was asked for and when
     fulfilledreqmap_t mapFulfilledRequests;
+    // expiry times of mapFulfilledRequests, so that CheckAndRemove doesn't have to look at all requests
+    expiry_queue<std::pair<CService, std::string>> requestsExpiry;
     CCriticalSection cs_mapFulfilledRequests;
 
     void RemoveFulfilledRequest(const CService& addr, const std::string& strRequest);
@@ -35,6 +38,14 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         LOCK(cs_mapFulfilledRequests);
         READWRITE(mapFulfilledRequests);
+        if (ser_action.ForRead()) {
+            requestsExpiry.clear();
+            for (const auto& p : mapFulfilledRequests) {
+                for (const auto& p2 : p.second) {
+                    requestsExpiry.schedule(std::make_pair(p.first, p2.first), p2.second);
+                }
+            }
+        }
     }
 
     void AddFulfilledRequest(const CService& addr, const std::string& strRequest);
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
+#define BITCOIN_NODE_UTXO_SNAPSHOT_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+/**
+ * Metadata describing a serialized version of a UTXO set and the matching evo DB state (deterministic masternode
+ * lists, quorum commitments, ...) from which an assumed-valid chainstate can be constructed.
+ *
+ * The file written by dumptxoutset consists of this metadata, followed by the headers of the blocks 1 to
+ * m_base_height, followed by m_coins_count (COutPoint, Coin) pairs, followed by m_evodb_count raw evo DB (key, value)
+ * pairs. It can be loaded into an empty datadir with -loadsnapshot, the blocks below the base are then downloaded and
+ * validated in the background.
+ */
+class SnapshotMetadata
+{
+public:
+    //! The hash of the block that reflects the tip of the chain for the UTXO set and evo DB contained in this
+    //! snapshot.
+    uint256 m_base_blockhash;
+
+    //! The height of the base block.
+    int m_base_height{0};
+
+    //! Whether the base block was ChainLocked when the snapshot was created.
+    bool m_base_chainlocked{false};
+
+    //! The number of coins in the UTXO set contained in this snapshot. Used during snapshot load to estimate
+    //! progress of UTXO set reconstruction.
+    uint64_t m_coins_count{0};
+
+    //! The hash_serialized_2 of the UTXO set as reported by gettxoutsetinfo, used to verify the loaded coins.
+    uint256 m_utxo_hash;
+
+    //! The number of raw evo DB entries contained in this snapshot.
+    uint64_t m_evodb_count{0};
+
+    //! The number of transactions up to and including the base block, the nChainTx of the base which can't be
+    //! calculated before all blocks below it were downloaded.
+    uint64_t m_base_chain_tx{0};
+
+    SnapshotMetadata() { }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(m_base_blockhash);
+        READWRITE(m_base_height);
+        READWRITE(m_base_chainlocked);
+        READWRITE(m_coins_count);
+        READWRITE(m_utxo_hash);
+        READWRITE(m_evodb_count);
+        READWRITE(m_base_chain_tx);
+    }
+};
+
+#endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
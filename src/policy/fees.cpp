@@ -228,16 +228,25 @@ void TxConfirmStats::Record(int blocksToConfirm, double val)
     avg[bucketindex] += val;
 }
 
+static void DecayAverages(std::vector<double>& v, double decay)
+{
+    // contiguous and without dependencies between the elements, so the compiler vectorizes it
+    for (double& x : v) {
+        x *= decay;
+    }
+}
+
 void TxConfirmStats::UpdateMovingAverages()
 {
-    for (unsigned int j = 0; j < buckets.size(); j++) {
-        for (unsigned int i = 0; i < confAvg.size(); i++)
-            confAvg[i][j] = confAvg[i][j] * decay;
-        for (unsigned int i = 0; i < failAvg.size(); i++)
-            failAvg[i][j] = failAvg[i][j] * decay;
-        avg[j] = avg[j] * decay;
-        txCtAvg[j] = txCtAvg[j] * decay;
+    // row by row instead of bucket by bucket, which walked all rows for every bucket
+    for (auto& row : confAvg) {
+        DecayAverages(row, decay);
     }
+    for (auto& row : failAvg) {
+        DecayAverages(row, decay);
+    }
+    DecayAverages(avg, decay);
+    DecayAverages(txCtAvg, decay);
 }
 
 // returns -1 on error conditions
@@ -509,9 +518,20 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
 // tracked. Txs that were part of a block have already been removed in
 // processBlockTx to ensure they are never double tracked, but it is
 // of no harm to try to remove them again.
-bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
+void CBlockPolicyEstimator::removeTx(const uint256& hash, bool inBlock)
 {
-    LOCK(cs_feeEstimator);
+    PendingUpdate update;
+    update.type = PendingUpdate::Type::TX_REMOVED;
+    update.flag = inBlock;
+    update.hash = hash;
+
+    LOCK(cs_pendingUpdates);
+    pendingUpdates.emplace_back(update);
+}
+
+bool CBlockPolicyEstimator::_removeTx(const uint256& hash, bool inBlock)
+{
+    AssertLockHeld(cs_feeEstimator);
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
@@ -547,10 +567,58 @@ CBlockPolicyEstimator::~CBlockPolicyEstimator()
 }
 
 void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate)
+{
+    PendingUpdate update;
+    update.type = PendingUpdate::Type::TX_ADDED;
+    update.flag = validFeeEstimate;
+    update.height = entry.GetHeight();
+    // Feerates are stored and reported as BTC-per-kb:
+    update.feeRate = CFeeRate(entry.GetFee(), entry.GetTxSize());
+    update.hash = entry.GetTx().GetHash();
+
+    LOCK(cs_pendingUpdates);
+    pendingUpdates.emplace_back(update);
+}
+
+void CBlockPolicyEstimator::ProcessPendingUpdates()
 {
     LOCK(cs_feeEstimator);
-    unsigned int txHeight = entry.GetHeight();
-    uint256 hash = entry.GetTx().GetHash();
+
+    // taken while holding cs_feeEstimator, so that concurrent calls apply the updates in order
+    std::vector<PendingUpdate> updates;
+    {
+        LOCK(cs_pendingUpdates);
+        updates.swap(pendingUpdates);
+    }
+
+    for (size_t i = 0; i < updates.size(); i++) {
+        const auto& update = updates[i];
+        switch (update.type) {
+        case PendingUpdate::Type::TX_ADDED:
+            _processTransaction(update.hash, update.height, update.feeRate, update.flag);
+            break;
+        case PendingUpdate::Type::TX_REMOVED:
+            _removeTx(update.hash, update.flag);
+            break;
+        case PendingUpdate::Type::BLOCK:
+            assert(i + update.blockTxCount < updates.size());
+            _processBlock(update.height, &updates[i + 1], update.blockTxCount);
+            i += update.blockTxCount;
+            break;
+        case PendingUpdate::Type::BLOCK_TX:
+            assert(false);
+        }
+    }
+}
+
+void CBlockPolicyEstimator::ApplyPendingUpdates() const
+{
+    const_cast<CBlockPolicyEstimator*>(this)->ProcessPendingUpdates();
+}
+
+void CBlockPolicyEstimator::_processTransaction(const uint256& hash, unsigned int txHeight, const CFeeRate& feeRate, bool validFeeEstimate)
+{
+    AssertLockHeld(cs_feeEstimator);
     if (mapMemPoolTxs.count(hash)) {
         LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy error mempool tx %s already being tracked\n", hash.ToString());
         return;
@@ -572,9 +640,6 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
     trackedTxs++;
 
-    // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
-
     mapMemPoolTxs[hash].blockHeight = txHeight;
     unsigned int bucketIndex = feeStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     mapMemPoolTxs[hash].bucketIndex = bucketIndex;
@@ -584,9 +649,9 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     assert(bucketIndex == bucketIndex3);
 }
 
-bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
+bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const PendingUpdate& blockTx)
 {
-    if (!removeTx(entry->GetTx().GetHash(), true)) {
+    if (!_removeTx(blockTx.hash, true)) {
         // This transaction wasn't being tracked for fee estimation
         return false;
     }
@@ -594,7 +659,7 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
-    int blocksToConfirm = nBlockHeight - entry->GetHeight();
+    int blocksToConfirm = nBlockHeight - blockTx.height;
     if (blocksToConfirm <= 0) {
         // This can't happen because we don't process transactions from a block with a height
         // lower than our greatest seen height
@@ -602,19 +667,36 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
-    // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
-
-    feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+    feeStats->Record(blocksToConfirm, (double)blockTx.feeRate.GetFeePerK());
+    shortStats->Record(blocksToConfirm, (double)blockTx.feeRate.GetFeePerK());
+    longStats->Record(blocksToConfirm, (double)blockTx.feeRate.GetFeePerK());
     return true;
 }
 
 void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
                                          std::vector<const CTxMemPoolEntry*>& entries)
 {
-    LOCK(cs_feeEstimator);
+    PendingUpdate update;
+    update.type = PendingUpdate::Type::BLOCK;
+    update.height = nBlockHeight;
+    update.blockTxCount = entries.size();
+
+    LOCK(cs_pendingUpdates);
+    pendingUpdates.reserve(pendingUpdates.size() + 1 + entries.size());
+    pendingUpdates.emplace_back(update);
+    for (const auto& entry : entries) {
+        update.type = PendingUpdate::Type::BLOCK_TX;
+        update.height = entry->GetHeight();
+        // Feerates are stored and reported as BTC-per-kb:
+        update.feeRate = CFeeRate(entry->GetFee(), entry->GetTxSize());
+        update.hash = entry->GetTx().GetHash();
+        pendingUpdates.emplace_back(update);
+    }
+}
+
+void CBlockPolicyEstimator::_processBlock(unsigned int nBlockHeight, const PendingUpdate* blockTxs, size_t count)
+{
+    AssertLockHeld(cs_feeEstimator);
     if (nBlockHeight <= nBestSeenHeight) {
         // Ignore side chains and re-orgs; assuming they are random
         // they don't affect the estimate.
@@ -641,8 +723,8 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
-    for (const auto& entry : entries) {
-        if (processBlockTx(nBlockHeight, entry))
+    for (size_t i = 0; i < count; i++) {
+        if (processBlockTx(nBlockHeight, blockTxs[i]))
             countedTxs++;
     }
 
@@ -653,7 +735,7 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
 
 
     LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy estimates updated by %u of %u block txs, since last block %u of %u tracked, mempool map size %u, max target %u from %s\n",
-             countedTxs, entries.size(), trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size(),
+             countedTxs, count, trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size(),
              MaxUsableEstimate(), HistoricalBlockSpan() > BlockSpan() ? "historical" : "current");
 
     trackedTxs = 0;
@@ -692,6 +774,7 @@ CFeeRate CBlockPolicyEstimator::estimateRawFee(int confTarget, double successThr
     }
     }
 
+    ApplyPendingUpdates();
     LOCK(cs_feeEstimator);
     // Return failure if trying to analyze a target we're not tracking
     if (confTarget <= 0 || (unsigned int)confTarget > stats->GetMaxConfirms())
@@ -818,6 +901,7 @@ double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget,
  */
 CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
 {
+    ApplyPendingUpdates();
     LOCK(cs_feeEstimator);
 
     if (feeCalc) {
@@ -898,6 +982,7 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
 bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
     try {
+        ApplyPendingUpdates();
         LOCK(cs_feeEstimator);
         fileout << 140100; // version required to read: 0.14.1 or later
         fileout << CLIENT_VERSION; // version that wrote the file
@@ -982,12 +1067,13 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
 
 void CBlockPolicyEstimator::FlushUnconfirmed() {
     int64_t startclear = GetTimeMicros();
+    ProcessPendingUpdates();
     LOCK(cs_feeEstimator);
     size_t num_entries = mapMemPoolTxs.size();
     // Remove every entry in mapMemPoolTxs
     while (!mapMemPoolTxs.empty()) {
         auto mi = mapMemPoolTxs.begin();
-        removeTx(mi->first, false); // this calls erase() on mapMemPoolTxs
+        _removeTx(mi->first, false); // this calls erase() on mapMemPoolTxs
     }
     int64_t endclear = GetTimeMicros();
     LogPrint(BCLog::ESTIMATEFEE, "Recorded %u unconfirmed txs from mempool in %ld micros\n", num_entries, endclear - startclear);
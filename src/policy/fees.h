@@ -191,6 +191,10 @@ public:
     CBlockPolicyEstimator();
     ~CBlockPolicyEstimator();
 
+    /**
+     * The following three only queue the update, so that the mempool and block connection don't wait for the stats to
+     * be updated. Queued updates are applied in order by ProcessPendingUpdates.
+     */
     /** Process all the transactions that have been included in a block */
     void processBlock(unsigned int nBlockHeight,
                       std::vector<const CTxMemPoolEntry*>& entries);
@@ -199,7 +203,10 @@ public:
     void processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate);
 
     /** Remove a transaction from the mempool tracking stats*/
-    bool removeTx(uint256 hash, bool inBlock);
+    void removeTx(const uint256& hash, bool inBlock);
+
+    /** Apply the queued updates. Called periodically from the scheduler and before every estimate */
+    void ProcessPendingUpdates();
 
     /** DEPRECATED. Return a feerate estimate */
     CFeeRate estimateFee(int confTarget) const;
@@ -258,8 +265,38 @@ private:
 
     mutable CCriticalSection cs_feeEstimator;
 
+    struct PendingUpdate
+    {
+        enum class Type : uint8_t {
+            TX_ADDED,
+            TX_REMOVED,
+            // followed by one BLOCK_TX update per transaction of the block
+            BLOCK,
+            BLOCK_TX,
+        };
+        Type type;
+        // validFeeEstimate of TX_ADDED, inBlock of TX_REMOVED
+        bool flag{false};
+        // entry height of a transaction, or the height of a BLOCK
+        unsigned int height{0};
+        // number of transactions of a BLOCK
+        unsigned int blockTxCount{0};
+        CFeeRate feeRate;
+        uint256 hash;
+    };
+    // only held to add or take updates, cs_feeEstimator is never taken while holding it
+    mutable CCriticalSection cs_pendingUpdates;
+    std::vector<PendingUpdate> pendingUpdates;
+
+    /** Reads catch up with the updates which already happened, so they are logically const */
+    void ApplyPendingUpdates() const;
+
+    void _processBlock(unsigned int nBlockHeight, const PendingUpdate* blockTxs, size_t count);
+    void _processTransaction(const uint256& hash, unsigned int txHeight, const CFeeRate& feeRate, bool validFeeEstimate);
+    bool _removeTx(const uint256& hash, bool inBlock);
+
     /** Process a transaction confirmed in a block*/
-    bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry);
+    bool processBlockTx(unsigned int nBlockHeight, const PendingUpdate& blockTx);
 
     /** Helper for estimateSmartFee */
     double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const;
@@ -10,14 +10,80 @@
 #include <tinyformat.h>
 #include <utilstrencodings.h>
 #include <crypto/common.h>
+#include <crypto/sha256.h>
 
 uint256 CBlockHeader::GetHash() const
 {
-    std::vector<unsigned char> vch(80);
+    std::vector<unsigned char> vch(SERIALIZED_SIZE);
     CVectorWriter ss(SER_GETHASH, PROTOCOL_VERSION, vch, 0);
     ss << *this;
-    return HashX11((const char *)vch.data(), (const char *)vch.data() + vch.size());
+
+    auto cached = std::atomic_load(&cachedHash);
+    if (cached && memcmp(cached->header, vch.data(), SERIALIZED_SIZE) == 0) {
+        return cached->hash;
+    }
+
+    auto newCached = std::make_shared<CachedHash>();
+    memcpy(newCached->header, vch.data(), SERIALIZED_SIZE);
+    newCached->hash = HashX11((const char *)vch.data(), (const char *)vch.data() + vch.size());
+    std::atomic_store(&cachedHash, std::shared_ptr<const CachedHash>(newCached));
+    return newCached->hash;
+}
+
+void SerReadWriteBlockTransactions(SpanReader& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx)
+{
+    uint64_t nSize = ReadCompactSize(s);
+    // every transaction takes at least one byte, don't let the announced count allocate more than that
+    std::vector<CMutableTransaction> txs;
+    txs.reserve(std::min<uint64_t>(nSize, s.size()));
+    std::vector<const unsigned char*> ptrs;
+    std::vector<size_t> lens;
+    ptrs.reserve(txs.capacity());
+    lens.reserve(txs.capacity());
+    for (uint64_t i = 0; i < nSize; i++) {
+        const unsigned char* begin = s.data();
+        size_t nAvailable = s.size();
+        txs.emplace_back(deserialize, s);
+        ptrs.emplace_back(begin);
+        lens.emplace_back(nAvailable - s.size());
+    }
+
+    std::vector<uint256> hashes(txs.size());
+    if (!hashes.empty()) {
+        SHA256DMulti(hashes[0].begin(), ptrs.data(), lens.data(), txs.size());
+    }
+
+    std::shared_ptr<CTransactionArena> arena;
+    if (CTransactionArenaScope::IsActive()) {
+        arena = std::make_shared<CTransactionArena>(txs.size());
+    }
+
+    vtx.clear();
+    vtx.reserve(txs.size());
+    for (size_t i = 0; i < txs.size(); i++) {
+        // A negative nVersion does not survive the nVersion/nType split (see CMutableTransaction::SerializationOp), so
+        // re-serializing these gives different bytes than what we hashed
+        if (txs[i].nVersion < 0) {
+            vtx.emplace_back(arena ? MakeArenaTransactionRef(arena, std::move(txs[i])) : MakeTransactionRef(std::move(txs[i])));
+        } else if (arena) {
+            vtx.emplace_back(MakeArenaTransactionRef(arena, std::move(txs[i]), hashes[i], lens[i]));
+        } else {
+            vtx.emplace_back(std::make_shared<const CTransaction>(std::move(txs[i]), hashes[i], lens[i]));
+        }
+    }
+}
+
+template <typename SerializeData>
+void SerReadWriteBlockTransactions(CBaseDataStream<SerializeData>& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx)
+{
+    // CBaseDataStream drops its buffer once everything was read, so parse from a view and skip the bytes afterwards
+    SpanReader reader = MakeSpanReader(s);
+    size_t nAvailable = reader.size();
+    SerReadWriteBlockTransactions(reader, ser_action, vtx);
+    s.ignore(nAvailable - reader.size());
 }
+template void SerReadWriteBlockTransactions(CDataStream& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx);
+template void SerReadWriteBlockTransactions(CPublicDataStream& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx);
 
 std::string CBlock::ToString() const
 {
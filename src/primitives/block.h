@@ -10,6 +10,11 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <memory>
+
+class SpanReader;
+template <typename SerializeData> class CBaseDataStream;
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -20,6 +25,8 @@
 class CBlockHeader
 {
 public:
+    static const size_t SERIALIZED_SIZE = 80;
+
     // header
     int32_t nVersion;
     uint256 hashPrevBlock;
@@ -28,11 +35,39 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+private:
+    // Memory only. The X11 hash of the last GetHash() call together with the header it was computed for. The fields
+    // above are public and can be changed anywhere, so the cache is only used while the header still matches.
+    struct CachedHash {
+        unsigned char header[SERIALIZED_SIZE];
+        uint256 hash;
+    };
+    // only accessed through std::atomic_load/std::atomic_store, GetHash() can be called from multiple threads
+    mutable std::shared_ptr<const CachedHash> cachedHash;
+
+public:
     CBlockHeader()
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other)
+    {
+        nVersion = other.nVersion;
+        hashPrevBlock = other.hashPrevBlock;
+        hashMerkleRoot = other.hashMerkleRoot;
+        nTime = other.nTime;
+        nBits = other.nBits;
+        nNonce = other.nNonce;
+        std::atomic_store(&cachedHash, std::atomic_load(&other.cachedHash));
+        return *this;
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -69,6 +104,32 @@ public:
 };
 
 
+/** Serialization of the transactions of a block. Blocks read from memory get all their txids computed
+ *  together with SHA256DMulti() instead of one by one in the CTransaction constructor. While a
+ *  CTransactionArenaScope is active, the transactions are allocated from a CTransactionArena. */
+template <typename Stream, typename Operation>
+inline void SerReadWriteBlockTransactions(Stream& s, Operation ser_action, std::vector<CTransactionRef>& vtx)
+{
+    READWRITE(vtx);
+}
+template <typename Stream>
+inline void SerReadWriteBlockTransactions(Stream& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx)
+{
+    if (!CTransactionArenaScope::IsActive()) {
+        READWRITE(vtx);
+        return;
+    }
+    uint64_t nSize = ReadCompactSize(s);
+    auto arena = std::make_shared<CTransactionArena>(nSize);
+    vtx.clear();
+    for (uint64_t i = 0; i < nSize; i++) {
+        vtx.emplace_back(MakeArenaTransactionRef(arena, CMutableTransaction(deserialize, s)));
+    }
+}
+void SerReadWriteBlockTransactions(SpanReader& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx);
+template <typename SerializeData>
+void SerReadWriteBlockTransactions(CBaseDataStream<SerializeData>& s, CSerActionUnserialize ser_action, std::vector<CTransactionRef>& vtx);
+
 class CBlock : public CBlockHeader
 {
 public:
@@ -94,7 +155,7 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITEAS(CBlockHeader, *this);
-        READWRITE(vtx);
+        SerReadWriteBlockTransactions(s, ser_action, vtx);
     }
 
     void SetNull()
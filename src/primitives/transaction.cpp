@@ -90,10 +90,19 @@ uint256 CTransaction::ComputeHash() const
     return SerializeHash(*this);
 }
 
+unsigned int CTransaction::ComputeTotalSize() const
+{
+    // the generic Serialize(), Serialize(CSizeComputer&) only returns the cached result
+    CSizeComputer s(SER_NETWORK, PROTOCOL_VERSION);
+    Serialize<CSizeComputer>(s);
+    return s.size();
+}
+
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
-CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), nLockTime(0), hash() {}
-CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()) {}
-CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()) {}
+CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), nLockTime(0), hash(), nTotalSize(ComputeTotalSize()) {}
+CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()), nTotalSize(ComputeTotalSize()) {}
+CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(std::move(tx.vExtraPayload)), hash(ComputeHash()), nTotalSize(ComputeTotalSize()) {}
+CTransaction::CTransaction(CMutableTransaction &&tx, const uint256& hashIn, unsigned int nTotalSizeIn) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(std::move(tx.vExtraPayload)), hash(hashIn), nTotalSize(nTotalSizeIn) {}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -106,11 +115,6 @@ CAmount CTransaction::GetValueOut() const
     return nValueOut;
 }
 
-unsigned int CTransaction::GetTotalSize() const
-{
-    return ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
-}
-
 std::string CTransaction::ToString() const
 {
     std::string str;
@@ -128,3 +132,42 @@ std::string CTransaction::ToString() const
         str += "    " + tx_out.ToString() + "\n";
     return str;
 }
+
+/** Share of a chunk per transaction, for the CTransaction and its shared_ptr control block */
+static const size_t TRANSACTION_ARENA_SLOT_SIZE = sizeof(CTransaction) + 64;
+/** Transactions per chunk at most, the transaction count of a block is not trusted before the block was parsed */
+static const size_t TRANSACTION_ARENA_MAX_CHUNK_TXS = 1024;
+
+CTransactionArena::CTransactionArena(size_t nTxCount) :
+    nChunkSize(std::max<size_t>(1, std::min(nTxCount, TRANSACTION_ARENA_MAX_CHUNK_TXS)) * TRANSACTION_ARENA_SLOT_SIZE),
+    nChunkUsed(0)
+{
+}
+
+void* CTransactionArena::Allocate(size_t nSize, size_t nAlign)
+{
+    size_t nOffset = (nChunkUsed + nAlign - 1) & ~(nAlign - 1);
+    if (vChunks.empty() || nOffset + nSize > nChunkSize) {
+        vChunks.emplace_back(new char[std::max(nChunkSize, nSize)]);
+        nOffset = 0;
+    }
+    nChunkUsed = nOffset + nSize;
+    return vChunks.back().get() + nOffset;
+}
+
+static thread_local int g_transaction_arena_scopes = 0;
+
+CTransactionArenaScope::CTransactionArenaScope()
+{
+    g_transaction_arena_scopes++;
+}
+
+CTransactionArenaScope::~CTransactionArenaScope()
+{
+    g_transaction_arena_scopes--;
+}
+
+bool CTransactionArenaScope::IsActive()
+{
+    return g_transaction_arena_scopes > 0;
+}
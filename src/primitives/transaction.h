@@ -11,6 +11,9 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <memory>
+#include <new>
+
 /** Transaction types */
 enum {
     TRANSACTION_NORMAL = 0,
@@ -219,8 +222,10 @@ public:
 private:
     /** Memory only. */
     const uint256 hash;
+    const unsigned int nTotalSize;
 
     uint256 ComputeHash() const;
+    unsigned int ComputeTotalSize() const;
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -229,6 +234,9 @@ public:
     /** Convert a CMutableTransaction into a CTransaction. */
     CTransaction(const CMutableTransaction &tx);
     CTransaction(CMutableTransaction &&tx);
+    /** Convert a CMutableTransaction whose hash and size were already computed by the caller, hashIn must be
+     *  SerializeHash(tx) and nTotalSizeIn its serialized size */
+    CTransaction(CMutableTransaction &&tx, const uint256& hashIn, unsigned int nTotalSizeIn);
 
     template <typename Stream>
     inline void Serialize(Stream& s) const {
@@ -241,6 +249,11 @@ public:
             s << vExtraPayload;
     }
 
+    /** GetSerializeSize() doesn't need to walk the transaction, the size is known since construction */
+    void Serialize(CSizeComputer& s) const {
+        s.seek(nTotalSize);
+    }
+
     /** This deserializing constructor is provided instead of an Unserialize method.
      *  Unserialize is not possible, since it would require overwriting const fields. */
     template <typename Stream>
@@ -264,7 +277,9 @@ public:
      * "Total Size" defined in BIP141 and BIP144.
      * @return Total transaction size in bytes
      */
-    unsigned int GetTotalSize() const;
+    unsigned int GetTotalSize() const {
+        return nTotalSize;
+    }
 
     bool IsCoinBase() const
     {
@@ -343,6 +358,80 @@ typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+/**
+ * Memory for the transactions of a block which is deserialized to be validated.
+ *
+ * The CTransaction objects of the block and their shared_ptr control blocks are placed in a few large chunks instead
+ * of one allocation per transaction, and all chunks are released together once the last transaction of the block is
+ * released. The vectors and scripts in the transactions still live on the heap. Allocation is not thread-safe, it
+ * only happens while the block is deserialized.
+ */
+class CTransactionArena
+{
+private:
+    std::vector<std::unique_ptr<char[]>> vChunks;
+    size_t nChunkSize;
+    size_t nChunkUsed;
+
+public:
+    /** Deleter of the transactions in an arena, the memory is released with the arena */
+    struct Deleter {
+        void operator()(const CTransaction* tx) const { tx->~CTransaction(); }
+    };
+
+    template <typename T>
+    struct Allocator {
+        typedef T value_type;
+        std::shared_ptr<CTransactionArena> arena;
+
+        explicit Allocator(std::shared_ptr<CTransactionArena> arenaIn) : arena(std::move(arenaIn)) {}
+        template <typename U>
+        Allocator(const Allocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t n) { return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T*, size_t) {}
+
+        template <typename U>
+        bool operator==(const Allocator<U>& other) const { return arena == other.arena; }
+        template <typename U>
+        bool operator!=(const Allocator<U>& other) const { return arena != other.arena; }
+    };
+
+    /** nTxCount is only used to size the first chunk */
+    explicit CTransactionArena(size_t nTxCount);
+
+    void* Allocate(size_t nSize, size_t nAlign);
+    size_t GetChunkCount() const { return vChunks.size(); }
+};
+
+/** Construct a transaction in the arena, from the arguments of any CTransaction constructor */
+template <typename... Args>
+CTransactionRef MakeArenaTransactionRef(const std::shared_ptr<CTransactionArena>& arena, Args&&... args)
+{
+    void* p = arena->Allocate(sizeof(CTransaction), alignof(CTransaction));
+    const CTransaction* tx = new (p) CTransaction(std::forward<Args>(args)...);
+    return CTransactionRef(tx, CTransactionArena::Deleter(), CTransactionArena::Allocator<CTransaction>(arena));
+}
+
+/** Whether the transaction lives in a CTransactionArena, holders which keep it longer than its block should copy it */
+static inline bool IsArenaTransaction(const CTransactionRef& tx)
+{
+    return std::get_deleter<CTransactionArena::Deleter>(tx) != nullptr;
+}
+
+/**
+ * While an instance is alive, the transactions of every block deserialized on this thread use a CTransactionArena.
+ * Only for blocks which are deserialized to be validated, see IsArenaTransaction().
+ */
+class CTransactionArenaScope
+{
+public:
+    CTransactionArenaScope();
+    ~CTransactionArenaScope();
+
+    static bool IsActive();
+};
+
 /** Implementation of BIP69
  * https://github.com/bitcoin/bips/blob/master/bip-0069.mediawiki
  */
@@ -0,0 +1,387 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/dash-config.h>
+#endif
+
+#include <profiler.h>
+
+#include <logging.h>
+#include <stacktraces.h>
+#include <sync.h>
+#include <threadinterrupt.h>
+#include <tinyformat.h>
+#include <util.h>
+#include <utiltime.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(ENABLE_STACKTRACES)
+#include <execinfo.h>
+#define PROFILER_SUPPORTED 1
+#endif
+#endif
+
+bool IsProfilerSupported()
+{
+#ifdef PROFILER_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(__linux__)
+struct ThreadStat {
+    std::string strName;
+    char state;
+    uint64_t nUserTicks;
+    uint64_t nSystemTicks;
+};
+
+static std::vector<int> ListThreadIds()
+{
+    std::vector<int> vThreadIds;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) {
+        return vThreadIds;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        int nThreadId = atoi(entry->d_name);
+        if (nThreadId > 0) {
+            vThreadIds.emplace_back(nThreadId);
+        }
+    }
+    closedir(dir);
+    return vThreadIds;
+}
+
+static bool ReadThreadStat(int nThreadId, ThreadStat& statRet)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", nThreadId);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        // the thread exited in the meantime
+        return false;
+    }
+    char buf[1024];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    buf[n] = '\0';
+
+    // the name is in parentheses and may itself contain spaces and parentheses, so the other fields start after the last ')'
+    const char* pszNameBegin = strchr(buf, '(');
+    const char* pszNameEnd = strrchr(buf, ')');
+    if (!pszNameBegin || !pszNameEnd || pszNameEnd < pszNameBegin) {
+        return false;
+    }
+    statRet.strName.assign(pszNameBegin + 1, pszNameEnd);
+
+    // state is field 3, utime and stime are fields 14 and 15, see proc(5)
+    unsigned long nUserTicks, nSystemTicks;
+    if (sscanf(pszNameEnd + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+            &statRet.state, &nUserTicks, &nSystemTicks) != 3) {
+        return false;
+    }
+    statRet.nUserTicks = nUserTicks;
+    statRet.nSystemTicks = nSystemTicks;
+    return true;
+}
+#endif // __linux__
+
+bool GetThreadCPUUsage(std::vector<CThreadCPUUsage>& vUsageRet)
+{
+    vUsageRet.clear();
+#if defined(__linux__)
+    static const int64_t nMicrosPerTick = 1000000 / sysconf(_SC_CLK_TCK);
+    for (int nThreadId : ListThreadIds()) {
+        ThreadStat stat;
+        if (ReadThreadStat(nThreadId, stat)) {
+            vUsageRet.push_back({nThreadId, stat.strName, (int64_t)stat.nUserTicks * nMicrosPerTick, (int64_t)stat.nSystemTicks * nMicrosPerTick});
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string FormatFoldedStacks(const std::vector<CProfileStack>& vStacks)
+{
+    std::string strFolded;
+    for (const auto& stack : vStacks) {
+        strFolded += stack.strThreadName;
+        for (const auto& strFrame : stack.vFrames) {
+            strFolded += ';';
+            strFolded += strFrame;
+        }
+        strFolded += strprintf(" %d\n", stack.nCount);
+    }
+    return strFolded;
+}
+
+#ifdef PROFILER_SUPPORTED
+static const int MAX_SAMPLE_FRAMES = 64;
+// ProfilerSignalHandler and its own signal trampoline
+static const int SAMPLE_SKIP_FRAMES = 2;
+// how long a running thread gets to handle SIGPROF before the sample is dropped
+static const int64_t SAMPLE_TIMEOUT_MICROS = 100 * 1000;
+
+// Only one thread is sampled at a time. The sampler moves the state from IDLE to REQUESTED and signals the thread, the
+// signal handler moves it to RUNNING, records the stack and moves it to DONE. A sample which is not picked up in time is
+// cancelled by moving it back from REQUESTED to IDLE, so that a late signal handler never writes into the next sample.
+enum SampleState {
+    SAMPLE_IDLE,
+    SAMPLE_REQUESTED,
+    SAMPLE_RUNNING,
+    SAMPLE_DONE,
+};
+static std::atomic<int> g_sampleState{SAMPLE_IDLE};
+static void* g_sampleFrames[MAX_SAMPLE_FRAMES];
+static int g_sampleFrameCount{0};
+
+static void ProfilerSignalHandler(int)
+{
+    int nSavedErrno = errno;
+    int expected = SAMPLE_REQUESTED;
+    if (g_sampleState.compare_exchange_strong(expected, SAMPLE_RUNNING)) {
+        g_sampleFrameCount = backtrace(g_sampleFrames, MAX_SAMPLE_FRAMES);
+        g_sampleState.store(SAMPLE_DONE);
+    }
+    errno = nSavedErrno;
+}
+
+class CProfiler
+{
+public:
+    const int nFrequency;
+
+private:
+    CThreadInterrupt interrupt;
+    std::thread thread;
+
+    CCriticalSection cs;
+    // raw return addresses, innermost first, of the stacks sampled per thread name
+    std::map<std::pair<std::string, std::vector<uint64_t>>, uint64_t> mapStacks GUARDED_BY(cs);
+    uint64_t nSamples GUARDED_BY(cs){0};
+
+public:
+    explicit CProfiler(int nFrequencyIn) : nFrequency(nFrequencyIn) {}
+
+    bool Start(std::string& strErrorRet)
+    {
+        // the first call of backtrace() loads libgcc, which is not async-signal-safe, so it must not happen in the handler
+        void* frames[1];
+        backtrace(frames, 1);
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = ProfilerSignalHandler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        if (sigaction(SIGPROF, &sa, nullptr) != 0) {
+            strErrorRet = strprintf("can't install the SIGPROF handler: %s", strerror(errno));
+            return false;
+        }
+
+        interrupt.reset();
+        thread = std::thread(&TraceThread<std::function<void()>>, "profiler", std::function<void()>(std::bind(&CProfiler::ThreadSample, this)));
+        return true;
+    }
+
+    void Stop()
+    {
+        interrupt();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        // a cancelled sample may still be pending in a thread which blocks signals, and the default action of SIGPROF
+        // terminates the process
+        signal(SIGPROF, SIG_IGN);
+    }
+
+    void GetStacks(bool fReset, std::map<std::pair<std::string, std::vector<uint64_t>>, uint64_t>& mapStacksRet, uint64_t& nSamplesRet)
+    {
+        LOCK(cs);
+        mapStacksRet = mapStacks;
+        nSamplesRet = nSamples;
+        if (fReset) {
+            mapStacks.clear();
+            nSamples = 0;
+        }
+    }
+
+private:
+    bool SampleThread(int nThreadId, std::vector<uint64_t>& vFramesRet)
+    {
+        g_sampleState.store(SAMPLE_REQUESTED);
+        if (syscall(SYS_tgkill, getpid(), nThreadId, SIGPROF) != 0) {
+            // the thread exited in the meantime
+            g_sampleState.store(SAMPLE_IDLE);
+            return false;
+        }
+
+        int64_t nTimeout = GetTimeMicros() + SAMPLE_TIMEOUT_MICROS;
+        while (g_sampleState.load() != SAMPLE_DONE) {
+            if (GetTimeMicros() > nTimeout) {
+                int expected = SAMPLE_REQUESTED;
+                if (g_sampleState.compare_exchange_strong(expected, SAMPLE_IDLE)) {
+                    return false;
+                }
+                // the handler is running already, it's done soon
+            }
+            std::this_thread::yield();
+        }
+
+        vFramesRet.clear();
+        for (int i = SAMPLE_SKIP_FRAMES; i < g_sampleFrameCount; i++) {
+            uint64_t pc = (uint64_t)g_sampleFrames[i];
+            // all frames but the interrupted one are return addresses, which point behind the call
+            vFramesRet.emplace_back(i == SAMPLE_SKIP_FRAMES ? pc : pc - 1);
+        }
+        g_sampleState.store(SAMPLE_IDLE);
+        return !vFramesRet.empty();
+    }
+
+    void ThreadSample()
+    {
+        const int nOwnThreadId = (int)syscall(SYS_gettid);
+        const auto interval = std::chrono::milliseconds(std::max(1, 1000 / nFrequency));
+
+        while (interrupt.sleep_for(interval)) {
+            for (int nThreadId : ListThreadIds()) {
+                ThreadStat stat;
+                // only threads which are on a CPU are sampled, threads which are waiting are neither recorded nor woken up
+                if (nThreadId == nOwnThreadId || !ReadThreadStat(nThreadId, stat) || stat.state != 'R') {
+                    continue;
+                }
+                std::vector<uint64_t> vFrames;
+                if (!SampleThread(nThreadId, vFrames)) {
+                    continue;
+                }
+                LOCK(cs);
+                mapStacks[std::make_pair(std::move(stat.strName), std::move(vFrames))]++;
+                nSamples++;
+            }
+        }
+    }
+};
+
+static std::mutex g_profiler_mutex;
+static std::unique_ptr<CProfiler> g_profiler;
+#endif // PROFILER_SUPPORTED
+
+bool StartProfiler(int nFrequency, std::string& strErrorRet)
+{
+#ifdef PROFILER_SUPPORTED
+    if (nFrequency <= 0 || nFrequency > MAX_PROFILER_FREQUENCY) {
+        strErrorRet = strprintf("the sampling frequency must be between 1 and %d", MAX_PROFILER_FREQUENCY);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_profiler_mutex);
+    if (g_profiler) {
+        strErrorRet = "the profiler is running already";
+        return false;
+    }
+    std::unique_ptr<CProfiler> profiler(new CProfiler(nFrequency));
+    if (!profiler->Start(strErrorRet)) {
+        return false;
+    }
+    g_profiler = std::move(profiler);
+    LogPrintf("%s: sampling running threads %d times per second\n", __func__, nFrequency);
+    return true;
+#else
+    strErrorRet = "sampling profiles is only supported on Linux builds with --enable-stacktraces";
+    return false;
+#endif
+}
+
+void StopProfiler()
+{
+#ifdef PROFILER_SUPPORTED
+    std::lock_guard<std::mutex> lock(g_profiler_mutex);
+    if (g_profiler) {
+        g_profiler->Stop();
+        g_profiler.reset();
+    }
+#endif
+}
+
+bool IsProfilerRunning()
+{
+#ifdef PROFILER_SUPPORTED
+    std::lock_guard<std::mutex> lock(g_profiler_mutex);
+    return g_profiler != nullptr;
+#else
+    return false;
+#endif
+}
+
+int GetProfilerFrequency()
+{
+#ifdef PROFILER_SUPPORTED
+    std::lock_guard<std::mutex> lock(g_profiler_mutex);
+    return g_profiler ? g_profiler->nFrequency : 0;
+#else
+    return 0;
+#endif
+}
+
+std::vector<CProfileStack> GetProfileStacks(bool fReset, uint64_t& nSamplesRet)
+{
+    nSamplesRet = 0;
+    std::vector<CProfileStack> vStacks;
+#ifdef PROFILER_SUPPORTED
+    std::map<std::pair<std::string, std::vector<uint64_t>>, uint64_t> mapStacks;
+    {
+        std::lock_guard<std::mutex> lock(g_profiler_mutex);
+        if (!g_profiler) {
+            return vStacks;
+        }
+        g_profiler->GetStacks(fReset, mapStacks, nSamplesRet);
+    }
+
+    // symbolizing is slow, so it happens without holding any lock and only once per distinct address. Stacks which only
+    // differ in addresses within the same functions are merged
+    std::map<uint64_t, std::vector<std::string>> mapSymbols;
+    std::map<std::pair<std::string, std::vector<std::string>>, uint64_t> mapSymbolizedStacks;
+    for (const auto& p : mapStacks) {
+        std::vector<std::string> vFunctions;
+        const auto& vFrames = p.first.second;
+        for (auto it = vFrames.rbegin(); it != vFrames.rend(); ++it) {
+            auto itSymbols = mapSymbols.find(*it);
+            if (itSymbols == mapSymbols.end()) {
+                itSymbols = mapSymbols.emplace(*it, GetStackFrameFunctionNames(*it)).first;
+            }
+            if (itSymbols->second.empty()) {
+                vFunctions.emplace_back(strprintf("0x%x", *it));
+                continue;
+            }
+            // inlined functions come innermost first
+            vFunctions.insert(vFunctions.end(), itSymbols->second.rbegin(), itSymbols->second.rend());
+        }
+        mapSymbolizedStacks[std::make_pair(p.first.first, std::move(vFunctions))] += p.second;
+    }
+
+    vStacks.reserve(mapSymbolizedStacks.size());
+    for (auto& p : mapSymbolizedStacks) {
+        vStacks.push_back({p.first.first, std::move(p.first.second), p.second});
+    }
+#endif
+    return vStacks;
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PROFILER_H
+#define BITCOIN_PROFILER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Default for -profiler, the number of stack samples per second taken of every running thread. 0 disables sampling */
+static const int DEFAULT_PROFILER_FREQUENCY = 0;
+static const int MAX_PROFILER_FREQUENCY = 1000;
+
+struct CThreadCPUUsage {
+    int nThreadId;
+    std::string strName;
+    int64_t nUserMicros;
+    int64_t nSystemMicros;
+};
+
+/** Stacks sampled from one thread name, outermost frame first, with the number of times they were sampled */
+struct CProfileStack {
+    std::string strThreadName;
+    std::vector<std::string> vFrames;
+    uint64_t nCount;
+};
+
+/** Whether CPU usage and stack sampling are available on this platform */
+bool IsProfilerSupported();
+
+/** CPU time each thread of this process used since it was started. Returns false if not supported on this platform */
+bool GetThreadCPUUsage(std::vector<CThreadCPUUsage>& vUsageRet);
+
+/**
+ * Start sampling the stacks of all threads nFrequency times per second.
+ *
+ * Only threads which are running at the time of a sample are interrupted (with SIGPROF) and have their stack recorded,
+ * so the samples form a CPU profile and threads waiting on locks, sockets or condition variables are not disturbed.
+ * Samples are aggregated per thread name and stack, so memory usage only grows with the number of distinct stacks.
+ */
+bool StartProfiler(int nFrequency, std::string& strErrorRet);
+void StopProfiler();
+bool IsProfilerRunning();
+int GetProfilerFrequency();
+
+/** Aggregated stacks sampled since the profiler was started or last reset, with symbolized frames */
+std::vector<CProfileStack> GetProfileStacks(bool fReset, uint64_t& nSamplesRet);
+
+/** Stacks in the folded format of flamegraph.pl and speedscope: one "thread;outer;...;inner count" line per stack */
+std::string FormatFoldedStacks(const std::vector<CProfileStack>& vStacks);
+
+#endif // BITCOIN_PROFILER_H
@@ -233,6 +233,42 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70209 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * getcfilters requests compact filters for a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is a response to a getcfilters request containing a single compact
+ * filter.
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests a compact filter header and the filter hashes for a
+ * range of blocks, which can then be used to reconstruct the filter headers
+ * for those blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is a response to a getcfheaders request containing a filter header
+ * and a vector of filter hashes for each subsequent block in the requested range.
+ */
+extern const char *CFHEADERS;
+/**
+ * getcfcheckpt requests evenly spaced compact filter headers, enabling
+ * parallelized download and validation of the headers between them.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * cfcheckpt is a response to a getcfcheckpt request containing a vector of
+ * evenly spaced filter headers for blocks on the requested chain.
+ */
+extern const char *CFCHECKPT;
 
 // Dash message types
 // NOTE: do NOT declare non-implmented here, we don't want them to be exposed to the outside
@@ -251,10 +287,13 @@ extern const char *DSQUEUE;
 extern const char *SENDDSQUEUE;
 extern const char *SYNCSTATUSCOUNT;
 extern const char *MNGOVERNANCESYNC;
+extern const char *MNGOVERNANCEVOTESKETCH;
 extern const char *MNGOVERNANCEOBJECT;
 extern const char *MNGOVERNANCEOBJECTVOTE;
 extern const char *GETMNLISTDIFF;
 extern const char *MNLISTDIFF;
+extern const char *GETMNLISTSNAPSHOT;
+extern const char *MNLISTSNAPSHOT;
 extern const char *QSENDRECSIGS;
 extern const char *QFCOMMITMENT;
 extern const char *QCONTRIB;
@@ -273,6 +312,20 @@ extern const char* QDATA;
 extern const char *CLSIG;
 extern const char *ISLOCK;
 extern const char *MNAUTH;
+/**
+ * Contains a uint64_t salt. Indicates that a node wants InstantSend locks, ChainLocks and recovered signatures to be
+ * announced via "shortinv" messages, using short ids salted with the given salt. Only sent to and accepted from peers
+ * with SHORT_INV_PROTO_VERSION or higher, the same applies to "shortinv" and "getshortdata".
+ */
+extern const char *SENDSHORTINV;
+/**
+ * Contains a vector of CShortInv objects, announcing objects by short ids instead of their full hashes.
+ */
+extern const char *SHORTINV;
+/**
+ * Contains a vector of CShortInv objects, requesting objects which were announced via "shortinv".
+ */
+extern const char *GETSHORTDATA;
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -296,6 +349,10 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_FILTERS means the node will service basic block filter
+    // requests.
+    // See BIP157 and BIP158 for details on how this is implemented.
+    NODE_COMPACT_FILTERS = (1 << 6),
     // NODE_NETWORK_LIMITED means the same as NODE_NETWORK with the limitation of only
     // serving the last 288 blocks
     // See BIP159 for details on how this is implemented.
@@ -431,6 +488,9 @@ enum GetDataMsg {
 class CInv
 {
 public:
+    // serialized size of an inv, type and hash
+    static const size_t SERIALIZED_SIZE = sizeof(int32_t) + sizeof(uint256);
+
     CInv();
     CInv(int typeIn, const uint256& hashIn);
 
@@ -458,5 +518,27 @@ public:
     uint256 hash;
 };
 
+/** Announcement of an object by a salted 64 bit short id (12 instead of 36 bytes per item), see SENDSHORTINV */
+class CShortInv
+{
+public:
+    // serialized size of a short inv, type and short id
+    static const size_t SERIALIZED_SIZE = sizeof(int32_t) + sizeof(uint64_t);
+
+    CShortInv() : type(0), shortId(0) {}
+    CShortInv(int typeIn, uint64_t shortIdIn) : type(typeIn), shortId(shortIdIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(type);
+        READWRITE(shortId);
+    }
+
+    int type;
+    uint64_t shortId;
+};
 
 #endif // BITCOIN_PROTOCOL_H
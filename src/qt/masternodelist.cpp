@@ -3,15 +3,15 @@
 
 #include <qt/clientmodel.h>
 #include <clientversion.h>
-#include <coins.h>
 #include <qt/guiutil.h>
-#include <netbase.h>
+#include <qt/masternodetablemodel.h>
 #include <qt/walletmodel.h>
+#include <utiltime.h>
 
 #include <univalue.h>
 
+#include <QHeaderView>
 #include <QMessageBox>
-#include <QTableWidgetItem>
 #include <QtGui/QClipboard>
 
 int GetOffsetFromUtc()
@@ -25,29 +25,13 @@ int GetOffsetFromUtc()
 #endif
 }
 
-template <typename T>
-class CMasternodeListWidgetItem : public QTableWidgetItem
-{
-    T itemData;
-
-public:
-    explicit CMasternodeListWidgetItem(const QString& text, const T& data, int type = Type) :
-        QTableWidgetItem(text, type),
-        itemData(data) {}
-
-    bool operator<(const QTableWidgetItem& other) const
-    {
-        return itemData < ((CMasternodeListWidgetItem*)&other)->itemData;
-    }
-};
-
 MasternodeList::MasternodeList(QWidget* parent) :
     QWidget(parent),
     ui(new Ui::MasternodeList),
     clientModel(0),
     walletModel(0),
-    fFilterUpdatedDIP3(true),
-    nTimeFilterUpdatedDIP3(0),
+    mnTableModel(0),
+    mnFilterProxy(0),
     nTimeUpdatedDIP3(0),
     mnListChanged(true)
 {
@@ -58,36 +42,10 @@ MasternodeList::MasternodeList(QWidget* parent) :
                      }, GUIUtil::FontWeight::Bold, 14);
     GUIUtil::setFont({ui->label_filter_2}, GUIUtil::FontWeight::Normal, 15);
 
-    int columnAddressWidth = 200;
-    int columnStatusWidth = 80;
-    int columnPoSeScoreWidth = 80;
-    int columnRegisteredWidth = 80;
-    int columnLastPaidWidth = 80;
-    int columnNextPaymentWidth = 100;
-    int columnPayeeWidth = 130;
-    int columnOperatorRewardWidth = 130;
-    int columnCollateralWidth = 130;
-    int columnOwnerWidth = 130;
-    int columnVotingWidth = 130;
-
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_SERVICE, columnAddressWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_STATUS, columnStatusWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_POSE, columnPoSeScoreWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_REGISTERED, columnRegisteredWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_LAST_PAYMENT, columnLastPaidWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_NEXT_PAYMENT, columnNextPaymentWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_PAYOUT_ADDRESS, columnPayeeWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_OPERATOR_REWARD, columnOperatorRewardWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_COLLATERAL_ADDRESS, columnCollateralWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_OWNER_ADDRESS, columnOwnerWidth);
-    ui->tableWidgetMasternodesDIP3->setColumnWidth(COLUMN_VOTING_ADDRESS, columnVotingWidth);
-
-    // dummy column for proTxHash
-    // TODO use a proper table model for the MN list
-    ui->tableWidgetMasternodesDIP3->insertColumn(COLUMN_PROTX_HASH);
-    ui->tableWidgetMasternodesDIP3->setColumnHidden(COLUMN_PROTX_HASH, true);
-
-    ui->tableWidgetMasternodesDIP3->setContextMenuPolicy(Qt::CustomContextMenu);
+    // All rows have the same height, so the view never has to measure rows which aren't visible
+    ui->tableViewMasternodesDIP3->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    ui->tableViewMasternodesDIP3->verticalHeader()->hide();
+    ui->tableViewMasternodesDIP3->setContextMenuPolicy(Qt::CustomContextMenu);
 
     ui->filterLineEditDIP3->setPlaceholderText(tr("Filter by any property (e.g. address or protx hash)"));
 
@@ -96,8 +54,8 @@ MasternodeList::MasternodeList(QWidget* parent) :
     contextMenuDIP3 = new QMenu(this);
     contextMenuDIP3->addAction(copyProTxHashAction);
     contextMenuDIP3->addAction(copyCollateralOutpointAction);
-    connect(ui->tableWidgetMasternodesDIP3, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(showContextMenuDIP3(const QPoint&)));
-    connect(ui->tableWidgetMasternodesDIP3, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(extraInfoDIP3_clicked()));
+    connect(ui->tableViewMasternodesDIP3, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(showContextMenuDIP3(const QPoint&)));
+    connect(ui->tableViewMasternodesDIP3, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(extraInfoDIP3_clicked()));
     connect(copyProTxHashAction, SIGNAL(triggered()), this, SLOT(copyProTxHash_clicked()));
     connect(copyCollateralOutpointAction, SIGNAL(triggered()), this, SLOT(copyCollateralOutpoint_clicked()));
 
@@ -117,6 +75,33 @@ void MasternodeList::setClientModel(ClientModel* model)
 {
     this->clientModel = model;
     if (model) {
+        mnTableModel = new MasternodeTableModel(model->node(), this);
+        mnTableModel->setWalletModel(walletModel);
+        mnFilterProxy = new MasternodeFilterProxy(this);
+        mnFilterProxy->setSourceModel(mnTableModel);
+        mnFilterProxy->setFilterFixedString(ui->filterLineEditDIP3->text());
+        mnFilterProxy->setMineOnly(ui->checkBoxMyMasternodesOnly->isChecked());
+        connect(mnFilterProxy, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(updateCountLabel()));
+        connect(mnFilterProxy, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(updateCountLabel()));
+        connect(mnFilterProxy, SIGNAL(modelReset()), this, SLOT(updateCountLabel()));
+        connect(mnFilterProxy, SIGNAL(layoutChanged()), this, SLOT(updateCountLabel()));
+
+        ui->tableViewMasternodesDIP3->setModel(mnFilterProxy);
+        ui->tableViewMasternodesDIP3->sortByColumn(MasternodeTableModel::Service, Qt::AscendingOrder);
+
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::Service, 200);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::Status, 80);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::PoSeScore, 80);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::Registered, 80);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::LastPayment, 80);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::NextPayment, 100);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::PayoutAddress, 130);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::OperatorReward, 130);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::CollateralAddress, 130);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::OwnerAddress, 130);
+        ui->tableViewMasternodesDIP3->setColumnWidth(MasternodeTableModel::VotingAddress, 130);
+        ui->tableViewMasternodesDIP3->setColumnHidden(MasternodeTableModel::ProTxHash, true);
+
         // try to update list when masternode count changes
         connect(clientModel, SIGNAL(masternodeListChanged()), this, SLOT(handleMasternodeListChanged()));
     }
@@ -125,40 +110,30 @@ void MasternodeList::setClientModel(ClientModel* model)
 void MasternodeList::setWalletModel(WalletModel* model)
 {
     this->walletModel = model;
+    if (mnTableModel) {
+        mnTableModel->setWalletModel(model);
+    }
 }
 
 void MasternodeList::showContextMenuDIP3(const QPoint& point)
 {
-    QTableWidgetItem* item = ui->tableWidgetMasternodesDIP3->itemAt(point);
-    if (item) contextMenuDIP3->exec(QCursor::pos());
+    QModelIndex index = ui->tableViewMasternodesDIP3->indexAt(point);
+    if (index.isValid()) contextMenuDIP3->exec(QCursor::pos());
 }
 
 void MasternodeList::handleMasternodeListChanged()
 {
-    LOCK(cs_dip3list);
     mnListChanged = true;
 }
 
 void MasternodeList::updateDIP3ListScheduled()
 {
-    TRY_LOCK(cs_dip3list, fLockAcquired);
-    if (!fLockAcquired) return;
-
     if (!clientModel || clientModel->node().shutdownRequested()) {
         return;
     }
 
-    // To prevent high cpu usage update only once in MASTERNODELIST_FILTER_COOLDOWN_SECONDS seconds
-    // after filter was last changed unless we want to force the update.
-    if (fFilterUpdatedDIP3) {
-        int64_t nSecondsToWait = nTimeFilterUpdatedDIP3 - GetTime() + MASTERNODELIST_FILTER_COOLDOWN_SECONDS;
-        ui->countLabelDIP3->setText(tr("Please wait...") + " " + QString::number(nSecondsToWait));
-
-        if (nSecondsToWait <= 0) {
-            updateDIP3List();
-            fFilterUpdatedDIP3 = false;
-        }
-    } else if (mnListChanged) {
+    // To prevent high cpu usage apply a new list only once in MASTERNODELIST_UPDATE_SECONDS seconds
+    if (mnListChanged) {
         int64_t nMnListUpdateSecods = clientModel->masternodeSync().isBlockchainSynced() ? MASTERNODELIST_UPDATE_SECONDS : MASTERNODELIST_UPDATE_SECONDS * 10;
         int64_t nSecondsToWait = nTimeUpdatedDIP3 - GetTime() + nMnListUpdateSecods;
 
@@ -171,165 +146,43 @@ void MasternodeList::updateDIP3ListScheduled()
 
 void MasternodeList::updateDIP3List()
 {
-    if (!clientModel || clientModel->node().shutdownRequested()) {
+    if (!clientModel || !mnTableModel || clientModel->node().shutdownRequested()) {
         return;
     }
 
-    auto mnList = clientModel->getMasternodeList();
-    std::map<uint256, CTxDestination> mapCollateralDests;
-
-    {
-        // Get all UTXOs for each MN collateral in one go so that we can reduce locking overhead for cs_main
-        // We also do this outside of the below Qt list update loop to reduce cs_main locking time to a minimum
-        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
-            CTxDestination collateralDest;
-            Coin coin;
-            if (clientModel->node().getUnspentOutput(dmn->collateralOutpoint, coin) && ExtractDestination(coin.out.scriptPubKey, collateralDest)) {
-                mapCollateralDests.emplace(dmn->proTxHash, collateralDest);
-            }
-        });
-    }
-
-    LOCK(cs_dip3list);
-
-    QString strToFilter;
-    ui->countLabelDIP3->setText(tr("Updating..."));
-    ui->tableWidgetMasternodesDIP3->setSortingEnabled(false);
-    ui->tableWidgetMasternodesDIP3->clearContents();
-    ui->tableWidgetMasternodesDIP3->setRowCount(0);
-
     nTimeUpdatedDIP3 = GetTime();
 
-    auto projectedPayees = mnList.GetProjectedMNPayees(mnList.GetValidMNsCount());
-    std::map<uint256, int> nextPayments;
-    for (size_t i = 0; i < projectedPayees.size(); i++) {
-        const auto& dmn = projectedPayees[i];
-        nextPayments.emplace(dmn->proTxHash, mnList.GetHeight() + (int)i + 1);
-    }
+    // Only the rows of masternodes which changed since the last applied list are touched
+    mnTableModel->setMasternodeList(clientModel->getMasternodeList());
+    updateCountLabel();
+}
 
-    std::set<COutPoint> setOutpts;
-    if (walletModel && ui->checkBoxMyMasternodesOnly->isChecked()) {
-        std::vector<COutPoint> vOutpts;
-        walletModel->wallet().listProTxCoins(vOutpts);
-        for (const auto& outpt : vOutpts) {
-            setOutpts.emplace(outpt);
-        }
+void MasternodeList::updateCountLabel()
+{
+    if (mnFilterProxy) {
+        ui->countLabelDIP3->setText(QString::number(mnFilterProxy->rowCount()));
     }
-
-    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
-        if (walletModel && ui->checkBoxMyMasternodesOnly->isChecked()) {
-            bool fMyMasternode = setOutpts.count(dmn->collateralOutpoint) ||
-                walletModel->wallet().isSpendable(dmn->pdmnState->keyIDOwner) ||
-                walletModel->wallet().isSpendable(dmn->pdmnState->keyIDVoting) ||
-                walletModel->wallet().isSpendable(dmn->pdmnState->scriptPayout) ||
-                walletModel->wallet().isSpendable(dmn->pdmnState->scriptOperatorPayout);
-            if (!fMyMasternode) return;
-        }
-        // populate list
-        // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        auto addr_key = dmn->pdmnState->addr.GetKey();
-        QByteArray addr_ba(reinterpret_cast<const char*>(addr_key.data()), addr_key.size());
-        QTableWidgetItem* addressItem = new CMasternodeListWidgetItem<QByteArray>(QString::fromStdString(dmn->pdmnState->addr.ToString()), addr_ba);
-        QTableWidgetItem* statusItem = new QTableWidgetItem(mnList.IsMNValid(dmn) ? tr("ENABLED") : (mnList.IsMNPoSeBanned(dmn) ? tr("POSE_BANNED") : tr("UNKNOWN")));
-        QTableWidgetItem* PoSeScoreItem = new CMasternodeListWidgetItem<int>(QString::number(dmn->pdmnState->nPoSePenalty), dmn->pdmnState->nPoSePenalty);
-        QTableWidgetItem* registeredItem = new CMasternodeListWidgetItem<int>(QString::number(dmn->pdmnState->nRegisteredHeight), dmn->pdmnState->nRegisteredHeight);
-        QTableWidgetItem* lastPaidItem = new CMasternodeListWidgetItem<int>(QString::number(dmn->pdmnState->nLastPaidHeight), dmn->pdmnState->nLastPaidHeight);
-
-        QString strNextPayment = "UNKNOWN";
-        int nNextPayment = 0;
-        if (nextPayments.count(dmn->proTxHash)) {
-            nNextPayment = nextPayments[dmn->proTxHash];
-            strNextPayment = QString::number(nNextPayment);
-        }
-        QTableWidgetItem* nextPaymentItem = new CMasternodeListWidgetItem<int>(strNextPayment, nNextPayment);
-
-        CTxDestination payeeDest;
-        QString payeeStr = tr("UNKNOWN");
-        if (ExtractDestination(dmn->pdmnState->scriptPayout, payeeDest)) {
-            payeeStr = QString::fromStdString(EncodeDestination(payeeDest));
-        }
-        QTableWidgetItem* payeeItem = new QTableWidgetItem(payeeStr);
-
-        QString operatorRewardStr = tr("NONE");
-        if (dmn->nOperatorReward) {
-            operatorRewardStr = QString::number(dmn->nOperatorReward / 100.0, 'f', 2) + "% ";
-
-            if (dmn->pdmnState->scriptOperatorPayout != CScript()) {
-                CTxDestination operatorDest;
-                if (ExtractDestination(dmn->pdmnState->scriptOperatorPayout, operatorDest)) {
-                    operatorRewardStr += tr("to %1").arg(QString::fromStdString(EncodeDestination(operatorDest)));
-                } else {
-                    operatorRewardStr += tr("to UNKNOWN");
-                }
-            } else {
-                operatorRewardStr += tr("but not claimed");
-            }
-        }
-        QTableWidgetItem* operatorRewardItem = new CMasternodeListWidgetItem<uint16_t>(operatorRewardStr, dmn->nOperatorReward);
-
-        QString collateralStr = tr("UNKNOWN");
-        auto collateralDestIt = mapCollateralDests.find(dmn->proTxHash);
-        if (collateralDestIt != mapCollateralDests.end()) {
-            collateralStr = QString::fromStdString(EncodeDestination(collateralDestIt->second));
-        }
-        QTableWidgetItem* collateralItem = new QTableWidgetItem(collateralStr);
-
-        QString ownerStr = QString::fromStdString(EncodeDestination(dmn->pdmnState->keyIDOwner));
-        QTableWidgetItem* ownerItem = new QTableWidgetItem(ownerStr);
-
-        QString votingStr = QString::fromStdString(EncodeDestination(dmn->pdmnState->keyIDVoting));
-        QTableWidgetItem* votingItem = new QTableWidgetItem(votingStr);
-
-        QTableWidgetItem* proTxHashItem = new QTableWidgetItem(QString::fromStdString(dmn->proTxHash.ToString()));
-
-        if (strCurrentFilterDIP3 != "") {
-            strToFilter = addressItem->text() + " " +
-                          statusItem->text() + " " +
-                          PoSeScoreItem->text() + " " +
-                          registeredItem->text() + " " +
-                          lastPaidItem->text() + " " +
-                          nextPaymentItem->text() + " " +
-                          payeeItem->text() + " " +
-                          operatorRewardItem->text() + " " +
-                          collateralItem->text() + " " +
-                          ownerItem->text() + " " +
-                          votingItem->text() + " " +
-                          proTxHashItem->text();
-            if (!strToFilter.contains(strCurrentFilterDIP3)) return;
-        }
-
-        ui->tableWidgetMasternodesDIP3->insertRow(0);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_SERVICE, addressItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_STATUS, statusItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_POSE, PoSeScoreItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_REGISTERED, registeredItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_LAST_PAYMENT, lastPaidItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_NEXT_PAYMENT, nextPaymentItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_PAYOUT_ADDRESS, payeeItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_OPERATOR_REWARD, operatorRewardItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_COLLATERAL_ADDRESS, collateralItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_OWNER_ADDRESS, ownerItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_VOTING_ADDRESS, votingItem);
-        ui->tableWidgetMasternodesDIP3->setItem(0, COLUMN_PROTX_HASH, proTxHashItem);
-    });
-
-    ui->countLabelDIP3->setText(QString::number(ui->tableWidgetMasternodesDIP3->rowCount()));
-    ui->tableWidgetMasternodesDIP3->setSortingEnabled(true);
 }
 
 void MasternodeList::on_filterLineEditDIP3_textChanged(const QString& strFilterIn)
 {
-    strCurrentFilterDIP3 = strFilterIn;
-    nTimeFilterUpdatedDIP3 = GetTime();
-    fFilterUpdatedDIP3 = true;
-    ui->countLabelDIP3->setText(tr("Please wait...") + " " + QString::number(MASTERNODELIST_FILTER_COOLDOWN_SECONDS));
+    if (!mnFilterProxy) {
+        return;
+    }
+    // Filtering runs over the preformatted texts of the model, so it's cheap enough to not need a cooldown
+    mnFilterProxy->setFilterFixedString(strFilterIn);
+    updateCountLabel();
 }
 
 void MasternodeList::on_checkBoxMyMasternodesOnly_stateChanged(int state)
 {
-    // no cooldown
-    nTimeFilterUpdatedDIP3 = GetTime() - MASTERNODELIST_FILTER_COOLDOWN_SECONDS;
-    fFilterUpdatedDIP3 = true;
+    if (!mnFilterProxy) {
+        return;
+    }
+    // The wallet might have learned about new keys since the rows were filled
+    mnTableModel->refreshIsMine();
+    mnFilterProxy->setMineOnly(state == Qt::Checked);
+    updateCountLabel();
 }
 
 CDeterministicMNCPtr MasternodeList::GetSelectedDIP3MN()
@@ -338,19 +191,15 @@ CDeterministicMNCPtr MasternodeList::GetSelectedDIP3MN()
         return nullptr;
     }
 
-    std::string strProTxHash;
-    {
-        LOCK(cs_dip3list);
-
-        QItemSelectionModel* selectionModel = ui->tableWidgetMasternodesDIP3->selectionModel();
-        QModelIndexList selected = selectionModel->selectedRows();
+    QItemSelectionModel* selectionModel = ui->tableViewMasternodesDIP3->selectionModel();
+    if (!selectionModel) {
+        return nullptr;
+    }
+    QModelIndexList selected = selectionModel->selectedRows();
 
-        if (selected.count() == 0) return nullptr;
+    if (selected.count() == 0) return nullptr;
 
-        QModelIndex index = selected.at(0);
-        int nSelectedRow = index.row();
-        strProTxHash = ui->tableWidgetMasternodesDIP3->item(nSelectedRow, COLUMN_PROTX_HASH)->text().toStdString();
-    }
+    std::string strProTxHash = selected.at(0).data(MasternodeTableModel::ProTxHashRole).toString().toStdString();
 
     uint256 proTxHash;
     proTxHash.SetHex(strProTxHash);
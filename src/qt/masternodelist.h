@@ -1,10 +1,6 @@
 #ifndef BITCOIN_QT_MASTERNODELIST_H
 #define BITCOIN_QT_MASTERNODELIST_H
 
-#include <primitives/transaction.h>
-#include <sync.h>
-#include <util.h>
-
 #include <evo/deterministicmns.h>
 
 #include <QMenu>
@@ -12,7 +8,6 @@
 #include <QWidget>
 
 #define MASTERNODELIST_UPDATE_SECONDS 3
-#define MASTERNODELIST_FILTER_COOLDOWN_SECONDS 3
 
 namespace Ui
 {
@@ -20,6 +15,8 @@ class MasternodeList;
 }
 
 class ClientModel;
+class MasternodeFilterProxy;
+class MasternodeTableModel;
 class WalletModel;
 
 QT_BEGIN_NAMESPACE
@@ -35,39 +32,19 @@ public:
     explicit MasternodeList(QWidget* parent = 0);
     ~MasternodeList();
 
-    enum {
-        COLUMN_SERVICE,
-        COLUMN_STATUS,
-        COLUMN_POSE,
-        COLUMN_REGISTERED,
-        COLUMN_LAST_PAYMENT,
-        COLUMN_NEXT_PAYMENT,
-        COLUMN_PAYOUT_ADDRESS,
-        COLUMN_OPERATOR_REWARD,
-        COLUMN_COLLATERAL_ADDRESS,
-        COLUMN_OWNER_ADDRESS,
-        COLUMN_VOTING_ADDRESS,
-        COLUMN_PROTX_HASH,
-    };
-
     void setClientModel(ClientModel* clientModel);
     void setWalletModel(WalletModel* walletModel);
 
 private:
     QMenu* contextMenuDIP3;
-    int64_t nTimeFilterUpdatedDIP3;
     int64_t nTimeUpdatedDIP3;
-    bool fFilterUpdatedDIP3;
 
     QTimer* timer;
     Ui::MasternodeList* ui;
     ClientModel* clientModel;
     WalletModel* walletModel;
-
-    // Protects tableWidgetMasternodesDIP3
-    CCriticalSection cs_dip3list;
-
-    QString strCurrentFilterDIP3;
+    MasternodeTableModel* mnTableModel;
+    MasternodeFilterProxy* mnFilterProxy;
 
     bool mnListChanged;
 
@@ -89,5 +66,6 @@ private Q_SLOTS:
 
     void handleMasternodeListChanged();
     void updateDIP3ListScheduled();
+    void updateCountLabel();
 };
 #endif // BITCOIN_QT_MASTERNODELIST_H
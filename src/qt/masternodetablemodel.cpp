@@ -0,0 +1,333 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qt/masternodetablemodel.h>
+
+#include <qt/walletmodel.h>
+
+#include <coins.h>
+#include <interfaces/node.h>
+#include <interfaces/wallet.h>
+#include <key_io.h>
+#include <script/standard.h>
+#include <utilstrencodings.h>
+
+#include <algorithm>
+
+MasternodeTableModel::MasternodeTableModel(interfaces::Node& node, QObject* parent) :
+    QAbstractTableModel(parent),
+    m_node(node)
+{
+    columns << tr("Service") << tr("Status") << tr("PoSe Score") << tr("Registered") << tr("Last Paid") << tr("Next Payment")
+            << tr("Payout Address") << tr("Operator Reward") << tr("Collateral Address") << tr("Owner Address") << tr("Voting Address")
+            << tr("ProTx Hash");
+}
+
+MasternodeTableModel::~MasternodeTableModel()
+{
+    // Intentionally left empty
+}
+
+void MasternodeTableModel::setWalletModel(WalletModel* _walletModel)
+{
+    walletModel = _walletModel;
+    refreshIsMine();
+}
+
+void MasternodeTableModel::setMasternodeList(const CDeterministicMNList& newList)
+{
+    if (newList.GetBlockHash() == mnList.GetBlockHash()) {
+        return;
+    }
+
+    CDeterministicMNListDiff diff = mnList.BuildDiff(newList);
+    const std::set<COutPoint> setProTxCoins = getProTxCoins();
+
+    for (uint64_t internalId : diff.removedMns) {
+        auto dmn = mnList.GetMNByInternalId(internalId);
+        if (dmn) {
+            mapCollateralAddresses.erase(dmn->proTxHash);
+        }
+    }
+
+    // Signalling every row on its own is slower than a reset when most of them changed, e.g. for the first list
+    size_t nChanges = diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size();
+    if (nChanges > rows.size() / 2) {
+        beginResetModel();
+        mnList = newList;
+        rows.clear();
+        mapRows.clear();
+        rows.reserve(mnList.GetAllMNsCount());
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            rows.emplace_back();
+            fillRow(rows.back(), dmn, setProTxCoins);
+            mapRows.emplace(dmn->proTxHash, (int)rows.size() - 1);
+        });
+        updateNextPayments(false);
+        endResetModel();
+        return;
+    }
+
+    if (!diff.removedMns.empty()) {
+        std::vector<int> vecRemovedRows;
+        for (uint64_t internalId : diff.removedMns) {
+            auto dmn = mnList.GetMNByInternalId(internalId);
+            auto it = dmn ? mapRows.find(dmn->proTxHash) : mapRows.end();
+            if (it != mapRows.end()) {
+                vecRemovedRows.emplace_back(it->second);
+            }
+        }
+        // from the last row on, so that the rows of the other removed masternodes don't move
+        std::sort(vecRemovedRows.rbegin(), vecRemovedRows.rend());
+        for (int nRow : vecRemovedRows) {
+            beginRemoveRows(QModelIndex(), nRow, nRow);
+            rows.erase(rows.begin() + nRow);
+            endRemoveRows();
+        }
+        mapRows.clear();
+        for (size_t i = 0; i < rows.size(); i++) {
+            mapRows.emplace(rows[i].proTxHash, (int)i);
+        }
+    }
+
+    mnList = newList;
+
+    for (const auto& p : diff.updatedMNs) {
+        auto dmn = mnList.GetMNByInternalId(p.first);
+        auto it = dmn ? mapRows.find(dmn->proTxHash) : mapRows.end();
+        if (it == mapRows.end()) {
+            continue;
+        }
+        fillRow(rows[it->second], dmn, setProTxCoins);
+        Q_EMIT dataChanged(index(it->second, 0), index(it->second, COLUMN_COUNT - 1));
+    }
+
+    if (!diff.addedMNs.empty()) {
+        beginInsertRows(QModelIndex(), rows.size(), rows.size() + diff.addedMNs.size() - 1);
+        for (const auto& dmn : diff.addedMNs) {
+            rows.emplace_back();
+            fillRow(rows.back(), dmn, setProTxCoins);
+            mapRows.emplace(dmn->proTxHash, (int)rows.size() - 1);
+        }
+        endInsertRows();
+    }
+
+    updateNextPayments(true);
+}
+
+void MasternodeTableModel::refreshIsMine()
+{
+    const std::set<COutPoint> setProTxCoins = getProTxCoins();
+    for (size_t i = 0; i < rows.size(); i++) {
+        auto dmn = mnList.GetMN(rows[i].proTxHash);
+        bool fMine = dmn && isMine(dmn, setProTxCoins);
+        if (fMine != rows[i].fMine) {
+            rows[i].fMine = fMine;
+            Q_EMIT dataChanged(index(i, 0), index(i, COLUMN_COUNT - 1));
+        }
+    }
+}
+
+int MasternodeTableModel::rowCount(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return rows.size();
+}
+
+int MasternodeTableModel::columnCount(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return COLUMN_COUNT;
+}
+
+QVariant MasternodeTableModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= (int)rows.size() || index.column() < 0 || index.column() >= COLUMN_COUNT) {
+        return QVariant();
+    }
+
+    const Row& row = rows[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        return row.texts[index.column()];
+    case SortRole:
+        return row.sortKeys[index.column()];
+    case FilterRole:
+        return row.filterText;
+    case IsMineRole:
+        return row.fMine;
+    case ProTxHashRole:
+        return row.texts[ProTxHash];
+    }
+    return QVariant();
+}
+
+QVariant MasternodeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < columns.size()) {
+        return columns[section];
+    }
+    return QVariant();
+}
+
+Qt::ItemFlags MasternodeTableModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid()) {
+        return 0;
+    }
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+void MasternodeTableModel::fillRow(Row& row, const CDeterministicMNCPtr& dmn, const std::set<COutPoint>& setProTxCoins)
+{
+    auto setColumn = [&](int nColumn, const QString& strText, const QVariant& sortKey) {
+        row.texts[nColumn] = strText;
+        row.sortKeys[nColumn] = sortKey;
+    };
+
+    row.proTxHash = dmn->proTxHash;
+
+    // the hex of the key sorts like the key, which sorts by ip and port
+    auto addr_key = dmn->pdmnState->addr.GetKey();
+    setColumn(Service, QString::fromStdString(dmn->pdmnState->addr.ToString()), QString::fromStdString(HexStr(addr_key)));
+
+    QString strStatus = CDeterministicMNList::IsMNValid(dmn) ? tr("ENABLED") : (CDeterministicMNList::IsMNPoSeBanned(dmn) ? tr("POSE_BANNED") : tr("UNKNOWN"));
+    setColumn(Status, strStatus, strStatus);
+    setColumn(PoSeScore, QString::number(dmn->pdmnState->nPoSePenalty), dmn->pdmnState->nPoSePenalty);
+    setColumn(Registered, QString::number(dmn->pdmnState->nRegisteredHeight), dmn->pdmnState->nRegisteredHeight);
+    setColumn(LastPayment, QString::number(dmn->pdmnState->nLastPaidHeight), dmn->pdmnState->nLastPaidHeight);
+
+    CTxDestination payeeDest;
+    QString strPayee = tr("UNKNOWN");
+    if (ExtractDestination(dmn->pdmnState->scriptPayout, payeeDest)) {
+        strPayee = QString::fromStdString(EncodeDestination(payeeDest));
+    }
+    setColumn(PayoutAddress, strPayee, strPayee);
+
+    QString strOperatorReward = tr("NONE");
+    if (dmn->nOperatorReward) {
+        strOperatorReward = QString::number(dmn->nOperatorReward / 100.0, 'f', 2) + "% ";
+
+        if (dmn->pdmnState->scriptOperatorPayout != CScript()) {
+            CTxDestination operatorDest;
+            if (ExtractDestination(dmn->pdmnState->scriptOperatorPayout, operatorDest)) {
+                strOperatorReward += tr("to %1").arg(QString::fromStdString(EncodeDestination(operatorDest)));
+            } else {
+                strOperatorReward += tr("to UNKNOWN");
+            }
+        } else {
+            strOperatorReward += tr("but not claimed");
+        }
+    }
+    setColumn(OperatorReward, strOperatorReward, (int)dmn->nOperatorReward);
+
+    auto itCollateral = mapCollateralAddresses.find(dmn->proTxHash);
+    if (itCollateral == mapCollateralAddresses.end()) {
+        CTxDestination collateralDest;
+        Coin coin;
+        if (m_node.getUnspentOutput(dmn->collateralOutpoint, coin) && ExtractDestination(coin.out.scriptPubKey, collateralDest)) {
+            itCollateral = mapCollateralAddresses.emplace(dmn->proTxHash, QString::fromStdString(EncodeDestination(collateralDest))).first;
+        }
+    }
+    QString strCollateral = itCollateral != mapCollateralAddresses.end() ? itCollateral->second : tr("UNKNOWN");
+    setColumn(CollateralAddress, strCollateral, strCollateral);
+
+    QString strOwner = QString::fromStdString(EncodeDestination(dmn->pdmnState->keyIDOwner));
+    setColumn(OwnerAddress, strOwner, strOwner);
+    QString strVoting = QString::fromStdString(EncodeDestination(dmn->pdmnState->keyIDVoting));
+    setColumn(VotingAddress, strVoting, strVoting);
+    QString strProTxHash = QString::fromStdString(dmn->proTxHash.ToString());
+    setColumn(ProTxHash, strProTxHash, strProTxHash);
+
+    row.fMine = isMine(dmn, setProTxCoins);
+    updateFilterText(row);
+}
+
+void MasternodeTableModel::updateNextPayments(bool fSignal)
+{
+    auto projectedPayees = mnList.GetProjectedMNPayees(mnList.GetValidMNsCount());
+    std::map<uint256, int> mapNextPayments;
+    for (size_t i = 0; i < projectedPayees.size(); i++) {
+        mapNextPayments.emplace(projectedPayees[i]->proTxHash, mnList.GetHeight() + (int)i + 1);
+    }
+
+    int nFirstChanged = -1;
+    int nLastChanged = -1;
+    for (size_t i = 0; i < rows.size(); i++) {
+        Row& row = rows[i];
+        auto it = mapNextPayments.find(row.proTxHash);
+        int nNextPayment = it != mapNextPayments.end() ? it->second : 0;
+        if (!row.texts[NextPayment].isEmpty() && row.sortKeys[NextPayment].toInt() == nNextPayment) {
+            continue;
+        }
+        row.texts[NextPayment] = nNextPayment ? QString::number(nNextPayment) : tr("UNKNOWN");
+        row.sortKeys[NextPayment] = nNextPayment;
+        updateFilterText(row);
+        if (nFirstChanged == -1) {
+            nFirstChanged = i;
+        }
+        nLastChanged = i;
+    }
+
+    if (fSignal && nFirstChanged != -1) {
+        Q_EMIT dataChanged(index(nFirstChanged, NextPayment), index(nLastChanged, NextPayment));
+    }
+}
+
+void MasternodeTableModel::updateFilterText(Row& row)
+{
+    QStringList texts;
+    for (const auto& strText : row.texts) {
+        texts << strText;
+    }
+    row.filterText = texts.join(" ");
+}
+
+std::set<COutPoint> MasternodeTableModel::getProTxCoins() const
+{
+    std::set<COutPoint> setProTxCoins;
+    if (walletModel) {
+        std::vector<COutPoint> vOutpts;
+        walletModel->wallet().listProTxCoins(vOutpts);
+        setProTxCoins.insert(vOutpts.begin(), vOutpts.end());
+    }
+    return setProTxCoins;
+}
+
+bool MasternodeTableModel::isMine(const CDeterministicMNCPtr& dmn, const std::set<COutPoint>& setProTxCoins) const
+{
+    if (!walletModel) {
+        return false;
+    }
+    return setProTxCoins.count(dmn->collateralOutpoint) ||
+           walletModel->wallet().isSpendable(dmn->pdmnState->keyIDOwner) ||
+           walletModel->wallet().isSpendable(dmn->pdmnState->keyIDVoting) ||
+           walletModel->wallet().isSpendable(dmn->pdmnState->scriptPayout) ||
+           walletModel->wallet().isSpendable(dmn->pdmnState->scriptOperatorPayout);
+}
+
+MasternodeFilterProxy::MasternodeFilterProxy(QObject* parent) :
+    QSortFilterProxyModel(parent)
+{
+    setSortRole(MasternodeTableModel::SortRole);
+    setFilterRole(MasternodeTableModel::FilterRole);
+    setDynamicSortFilter(true);
+}
+
+void MasternodeFilterProxy::setMineOnly(bool _fMineOnly)
+{
+    fMineOnly = _fMineOnly;
+    invalidateFilter();
+}
+
+bool MasternodeFilterProxy::filterAcceptsRow(int source_row, const QModelIndex& source_parent) const
+{
+    if (fMineOnly) {
+        QModelIndex index = sourceModel()->index(source_row, 0, source_parent);
+        if (!index.data(MasternodeTableModel::IsMineRole).toBool()) {
+            return false;
+        }
+    }
+    return QSortFilterProxyModel::filterAcceptsRow(source_row, source_parent);
+}
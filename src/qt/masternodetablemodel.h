@@ -0,0 +1,129 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_QT_MASTERNODETABLEMODEL_H
+#define BITCOIN_QT_MASTERNODETABLEMODEL_H
+
+#include <evo/deterministicmns.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QStringList>
+
+class WalletModel;
+
+namespace interfaces {
+class Node;
+}
+
+/**
+ * Qt model of the deterministic masternode list, used by the masternode list page.
+ *
+ * The model keeps one row per masternode with all texts and sort keys formatted, so that views and proxies never
+ * format anything. A new list is applied through the diff to the previously applied list: only the rows of added,
+ * removed or updated masternodes are touched, plus the next payment of all rows, which moves with every block.
+ */
+class MasternodeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit MasternodeTableModel(interfaces::Node& node, QObject* parent = nullptr);
+    ~MasternodeTableModel();
+
+    enum ColumnIndex {
+        Service = 0,
+        Status,
+        PoSeScore,
+        Registered,
+        LastPayment,
+        NextPayment,
+        PayoutAddress,
+        OperatorReward,
+        CollateralAddress,
+        OwnerAddress,
+        VotingAddress,
+        ProTxHash,
+        COLUMN_COUNT
+    };
+
+    /** Roles to get specific information from a masternode row. These are independent of column, except for SortRole. */
+    enum RoleIndex {
+        /** Value to sort the column by */
+        SortRole = Qt::UserRole,
+        /** All texts of the row, for filtering */
+        FilterRole,
+        /** Whether the masternode is related to the wallet */
+        IsMineRole,
+        /** ProTx hash as hex string */
+        ProTxHashRole
+    };
+
+    void setWalletModel(WalletModel* walletModel);
+
+    /** Apply a new list. Does nothing if it's the one applied already. */
+    void setMasternodeList(const CDeterministicMNList& mnList);
+    const CDeterministicMNList& getMasternodeList() const { return mnList; }
+
+    /** Check again which masternodes are related to the wallet */
+    void refreshIsMine();
+
+    /** @name Methods overridden from QAbstractTableModel
+        @{*/
+    int rowCount(const QModelIndex& parent) const override;
+    int columnCount(const QModelIndex& parent) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    /*@}*/
+
+private:
+    struct Row {
+        uint256 proTxHash;
+        QString texts[COLUMN_COUNT];
+        QVariant sortKeys[COLUMN_COUNT];
+        QString filterText;
+        bool fMine{false};
+    };
+
+    interfaces::Node& m_node;
+    WalletModel* walletModel{nullptr};
+    QStringList columns;
+
+    CDeterministicMNList mnList;
+    std::vector<Row> rows;
+    std::map<uint256, int> mapRows;
+    // collateral addresses don't change for a masternode, so they are looked up only once per masternode
+    std::map<uint256, QString> mapCollateralAddresses;
+
+    void fillRow(Row& row, const CDeterministicMNCPtr& dmn, const std::set<COutPoint>& setProTxCoins);
+    void updateNextPayments(bool fSignal);
+    void updateFilterText(Row& row);
+    std::set<COutPoint> getProTxCoins() const;
+    bool isMine(const CDeterministicMNCPtr& dmn, const std::set<COutPoint>& setProTxCoins) const;
+};
+
+/** Filters the masternode list by text and, optionally, by relation to the wallet */
+class MasternodeFilterProxy : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit MasternodeFilterProxy(QObject* parent = nullptr);
+
+    void setMineOnly(bool fMineOnly);
+
+protected:
+    bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const override;
+
+private:
+    bool fMineOnly{false};
+};
+
+#endif // BITCOIN_QT_MASTERNODETABLEMODEL_H
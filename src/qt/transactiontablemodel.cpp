@@ -4,6 +4,7 @@
 
 #include <qt/transactiontablemodel.h>
 
+#include <qt/guiconstants.h>
 #include <qt/guiutil.h>
 #include <qt/optionsmodel.h>
 #include <qt/transactiondesc.h>
@@ -18,11 +19,19 @@
 #include <uint256.h>
 #include <util.h>
 
+#include <atomic>
+#include <map>
+#include <thread>
+
 #include <QColor>
 #include <QDateTime>
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+#include <QTimer>
+
+/** Number of wallet transactions which are loaded and decomposed at once in the background */
+static const size_t TRANSACTION_LOAD_BATCH_SIZE = 1000;
 
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
@@ -60,6 +69,11 @@ public:
     {
     }
 
+    ~TransactionTablePriv()
+    {
+        stopLoading();
+    }
+
     TransactionTableModel *parent;
 
     /* Local cache of wallet.
@@ -68,18 +82,145 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
+    /* Whether the wallet is still being loaded in the background. GUI thread only. */
+    bool fLoading{false};
+    std::thread loadingThread;
+    std::atomic<bool> fLoadingInterrupted{false};
+
+    /* Records decomposed by the loading thread, waiting to be appended to cachedWallet */
+    CCriticalSection cs_loaded;
+    QList<TransactionRecord> loadedRecords;
+    bool fLoadingFinished{false};
+
+    /* Transaction changes notified while loading, applied once the wallet is loaded completely */
+    struct QueuedUpdate {
+        uint256 hash;
+        int status;
+        bool showTransaction;
+    };
+    std::vector<QueuedUpdate> vQueuedUpdates;
+
+    /* Transaction changes notified by the wallet, waiting to be applied in one batch */
+    CCriticalSection cs_pending;
+    std::vector<QueuedUpdate> vPendingUpdates;
+    /* Index of the last pending update per transaction */
+    std::map<uint256, size_t> mapPendingUpdates;
+
+    /* Queue a transaction change, returns true if it's the first one of a new batch. Thread safe. */
+    bool queueUpdate(const uint256& hash, int status, bool showTransaction)
+    {
+        LOCK(cs_pending);
+        auto it = mapPendingUpdates.find(hash);
+        if (it != mapPendingUpdates.end() && status == CT_UPDATED) {
+            const QueuedUpdate& last = vPendingUpdates[it->second];
+            // An update after an addition or another update of the same transaction doesn't change anything, as the
+            // status of the transaction is read from the wallet only when it's displayed
+            if (last.status != CT_DELETED && last.showTransaction == showTransaction) {
+                return false;
+            }
+        }
+        mapPendingUpdates[hash] = vPendingUpdates.size();
+        vPendingUpdates.push_back({hash, status, showTransaction});
+        return vPendingUpdates.size() == 1;
+    }
+
+    std::vector<QueuedUpdate> takePendingUpdates()
+    {
+        LOCK(cs_pending);
+        std::vector<QueuedUpdate> vUpdates;
+        vUpdates.swap(vPendingUpdates);
+        mapPendingUpdates.clear();
+        return vUpdates;
+    }
+
     /* Query entire wallet anew from core.
+     *
+     * Transactions are fetched and decomposed in batches in a background thread, so that big wallets don't block
+     * the GUI for minutes. The batches come in sorted by hash and are appended to cachedWallet as they arrive.
      */
     void refreshWallet(interfaces::Wallet& wallet)
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
+        stopLoading();
         cachedWallet.clear();
-        {
-            for (const auto& wtx : wallet.getWalletTxs()) {
+        loadedRecords.clear();
+        fLoadingFinished = false;
+        fLoadingInterrupted = false;
+        fLoading = true;
+        loadingThread = std::thread([this, &wallet] { loadWallet(wallet); });
+    }
+
+    void stopLoading()
+    {
+        fLoadingInterrupted = true;
+        if (loadingThread.joinable()) {
+            loadingThread.join();
+        }
+    }
+
+    /* Runs in the loading thread */
+    void loadWallet(interfaces::Wallet& wallet)
+    {
+        RenameThread("dash-qt-txload");
+
+        std::vector<uint256> vHashes = wallet.getWalletTxHashes();
+        for (size_t i = 0; i < vHashes.size() && !fLoadingInterrupted; i += TRANSACTION_LOAD_BATCH_SIZE) {
+            std::vector<uint256> vBatch(vHashes.begin() + i, vHashes.begin() + std::min(i + TRANSACTION_LOAD_BATCH_SIZE, vHashes.size()));
+            QList<TransactionRecord> records;
+            for (const auto& wtx : wallet.getWalletTxs(vBatch)) {
                 if (TransactionRecord::showTransaction()) {
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, wtx));
+                    records.append(TransactionRecord::decomposeTransaction(wallet, wtx));
                 }
             }
+            {
+                LOCK(cs_loaded);
+                loadedRecords.append(records);
+            }
+            QMetaObject::invokeMethod(parent, "processLoadedRecords", Qt::QueuedConnection);
+        }
+        {
+            LOCK(cs_loaded);
+            fLoadingFinished = true;
+        }
+        QMetaObject::invokeMethod(parent, "processLoadedRecords", Qt::QueuedConnection);
+    }
+
+    /* Append what the loading thread has decomposed so far */
+    void processLoadedRecords(interfaces::Wallet& wallet)
+    {
+        if (!fLoading) {
+            return;
+        }
+
+        QList<TransactionRecord> records;
+        bool fFinished;
+        {
+            LOCK(cs_loaded);
+            records.swap(loadedRecords);
+            fFinished = fLoadingFinished;
+        }
+
+        if (!records.isEmpty()) {
+            // These are no new transactions, so they must not result in notifications
+            bool fProcessingQueuedTransactions = parent->processingQueuedTransactions();
+            parent->setProcessingQueuedTransactions(true);
+            parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + records.size() - 1);
+            cachedWallet.append(records);
+            parent->endInsertRows();
+            parent->setProcessingQueuedTransactions(fProcessingQueuedTransactions);
+        }
+
+        if (fFinished) {
+            qDebug() << "TransactionTablePriv::processLoadedRecords: loaded " + QString::number(cachedWallet.size()) + " records";
+            fLoading = false;
+            stopLoading();
+            std::vector<QueuedUpdate> vUpdates;
+            vUpdates.swap(vQueuedUpdates);
+            for (const auto& update : vUpdates) {
+                // A transaction which was added while loading might have been loaded already, so treat it as
+                // updated, which adds it only if it's not in the model
+                updateWallet(wallet, update.hash, update.status == CT_NEW ? CT_UPDATED : update.status, update.showTransaction);
+            }
         }
     }
 
@@ -92,6 +233,11 @@ public:
     {
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        if (fLoading) {
+            vQueuedUpdates.push_back({hash, status, showTransaction});
+            return;
+        }
+
         // Find bounds of this transaction in model
         QList<TransactionRecord>::iterator lower = qLowerBound(
             cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
@@ -233,6 +379,11 @@ TransactionTableModel::TransactionTableModel(WalletModel *parent):
         fProcessingQueuedTransactions(false),
         cachedChainLockHeight(-1)
 {
+    queuedUpdatesTimer = new QTimer(this);
+    queuedUpdatesTimer->setSingleShot(true);
+    queuedUpdatesTimer->setInterval(MODEL_UPDATE_DELAY);
+    connect(queuedUpdatesTimer, SIGNAL(timeout()), this, SLOT(processQueuedUpdates()));
+
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Address / Label") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
     priv->refreshWallet(walletModel->wallet());
 
@@ -262,6 +413,28 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
 }
 
+void TransactionTableModel::queueTransactionUpdate(const uint256& hash, int status, bool showTransaction)
+{
+    if (priv->queueUpdate(hash, status, showTransaction)) {
+        // the timer lives in the GUI thread
+        QMetaObject::invokeMethod(queuedUpdatesTimer, "start", Qt::QueuedConnection);
+    }
+}
+
+void TransactionTableModel::processQueuedUpdates()
+{
+    std::vector<TransactionTablePriv::QueuedUpdate> vUpdates = priv->takePendingUpdates();
+    qDebug() << "TransactionTableModel::processQueuedUpdates: " + QString::number(vUpdates.size()) + " updates";
+    for (const auto& update : vUpdates) {
+        priv->updateWallet(walletModel->wallet(), update.hash, update.status, update.showTransaction);
+    }
+}
+
+void TransactionTableModel::processLoadedRecords()
+{
+    priv->processLoadedRecords(walletModel->wallet());
+}
+
 void TransactionTableModel::updateAddressBook(const QString& address, const QString& label, bool isMine,
                                               const QString& purpose, int status)
 {
@@ -772,14 +945,14 @@ static void NotifyTransactionChanged(TransactionTableModel *ttm, const uint256 &
     // Determine whether to show transaction or not (determine this here so that no relocking is needed in GUI thread)
     bool showTransaction = TransactionRecord::showTransaction();
 
-    TransactionNotification notification(hash, status, showTransaction);
-
     if (fQueueNotifications)
     {
+        TransactionNotification notification(hash, status, showTransaction);
         vQueueNotifications.push_back(notification);
         return;
     }
-    notification.invoke(ttm);
+    // Batched, so that bursts of notifications (e.g. while mixing) don't flood the GUI event loop
+    ttm->queueTransactionUpdate(hash, status, showTransaction);
 }
 
 static void NotifyAddressBookChanged(TransactionTableModel *ttm, const CTxDestination &address, const std::string &label, bool isMine, const std::string &purpose, ChangeType status)
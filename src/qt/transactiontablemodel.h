@@ -19,6 +19,11 @@ class Handler;
 class TransactionRecord;
 class TransactionTablePriv;
 class WalletModel;
+class uint256;
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 /** UI model for the transaction table of a wallet.
  */
@@ -85,6 +90,9 @@ public:
     bool processingQueuedTransactions() const { return fProcessingQueuedTransactions; }
     void updateChainLockHeight(int chainLockHeight);
     int getChainLockHeight() const;
+    /** Queue a transaction change notified by the wallet, to be applied with all others which come in within
+        MODEL_UPDATE_DELAY ms. Thread safe. */
+    void queueTransactionUpdate(const uint256& hash, int status, bool showTransaction);
 
 private:
     WalletModel *walletModel;
@@ -95,6 +103,7 @@ private:
     TransactionTablePriv *priv;
     bool fProcessingQueuedTransactions;
     int cachedChainLockHeight;
+    QTimer* queuedUpdatesTimer;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -123,6 +132,10 @@ public Q_SLOTS:
     void updateAmountColumnTitle();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /* Called through a QueuedConnection when the background loading of the wallet made progress */
+    void processLoadedRecords();
+    /* Apply the transaction changes queued by queueTransactionUpdate */
+    void processQueuedUpdates();
 
     friend class TransactionTablePriv;
 };
@@ -456,16 +456,18 @@ static void NotifyAddressBookChanged(WalletModel *walletmodel,
                               Q_ARG(int, status));
 }
 
+// These two only set flags which the poll timer picks up, so there is no need to queue an event for every
+// notification, which floods the event loop while mixing or when many islocks come in at once
 static void NotifyTransactionChanged(WalletModel *walletmodel, const uint256 &hash, ChangeType status)
 {
     Q_UNUSED(hash);
     Q_UNUSED(status);
-    QMetaObject::invokeMethod(walletmodel, "updateTransaction", Qt::QueuedConnection);
+    walletmodel->updateTransaction();
 }
 
 static void NotifyISLockReceived(WalletModel *walletmodel)
 {
-    QMetaObject::invokeMethod(walletmodel, "updateNumISLocks", Qt::QueuedConnection);
+    walletmodel->updateNumISLocks();
 }
 
 static void NotifyChainLockReceived(WalletModel *walletmodel, int chainLockHeight)
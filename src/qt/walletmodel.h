@@ -16,6 +16,7 @@
 #include <interfaces/wallet.h>
 #include <support/allocators/secure.h>
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -225,7 +226,9 @@ private:
     interfaces::Node& m_node;
 
     bool fHaveWatchOnly;
-    bool fForceCheckBalanceChanged;
+    // Set from core threads, picked up by the next pollBalanceChanged, so that bursts of transaction
+    // notifications result in one balance check
+    std::atomic<bool> fForceCheckBalanceChanged;
 
     // Wallet has an options model for wallet-specific options
     // (transaction fee, for example)
@@ -239,7 +242,7 @@ private:
     interfaces::WalletBalances m_cached_balances;
     EncryptionStatus cachedEncryptionStatus;
     int cachedNumBlocks;
-    int cachedNumISLocks;
+    std::atomic<int> cachedNumISLocks;
     int cachedCoinJoinRounds;
 
     QTimer *pollTimer;
@@ -278,9 +281,9 @@ Q_SIGNALS:
 public Q_SLOTS:
     /* Wallet status might have changed */
     void updateStatus();
-    /* New transaction, or transaction changed status */
+    /* New transaction, or transaction changed status. Thread safe. */
     void updateTransaction();
-    /* IS-Lock received */
+    /* IS-Lock received. Thread safe. */
     void updateNumISLocks();
     /* ChainLock received */
     void updateChainLockHeight(int chainLockHeight);
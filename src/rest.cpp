@@ -4,14 +4,20 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <attributes.h>
+#include <blockview.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <evo/simplifiedmns.h>
 #include <httpserver.h>
+#include <llmq/quorums.h>
+#include <llmq/quorums_chainlocks.h>
+#include <llmq/quorums_instantsend.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
+#include <rpc/snapshot.h>
 #include <streams.h>
 #include <sync.h>
 #include <txmempool.h>
@@ -208,7 +214,6 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = nullptr;
     {
         LOCK(cs_main);
@@ -219,36 +224,41 @@ static bool rest_block(HTTPRequest* req,
 
         if (IsBlockPruned(pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
-
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
+    // the transactions are only deserialized for the transaction details, all other formats only need the serialized
+    // block and txids
+    std::unique_ptr<CBlockView> view;
+    if (!ReadBlockViewFromDisk(view, pblockindex, Params()))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    const auto& vData = view->GetData();
 
     switch (rf) {
     case RetFormat::BINARY: {
-        std::string binaryBlock = ssBlock.str();
+        std::string binaryBlock(vData.begin(), vData.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RetFormat::HEX: {
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::string strHex = HexStr(vData.begin(), vData.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
     }
 
     case RetFormat::JSON: {
-        UniValue objBlock;
-        {
-            LOCK(cs_main);
-            objBlock = blockToJSON(block, pblockindex, showTxDetails);
+        std::string strJSON;
+        JSONStringSink sink(strJSON);
+        JSONWriter writer(sink);
+        if (showTxDetails) {
+            blockToJSON(writer, view->GetBlock(), pblockindex, *GetRPCChainSnapshot(), true);
+        } else {
+            blockToJSON(writer, *view, pblockindex, *GetRPCChainSnapshot());
         }
-        std::string strJSON = objBlock.write() + "\n";
+        writer.Flush();
+        strJSON += "\n";
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strJSON);
         return true;
@@ -327,9 +337,12 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
+        std::string strJSON;
+        JSONStringSink sink(strJSON);
+        JSONWriter writer(sink);
+        mempoolToJSON(writer, true);
+        writer.Flush();
+        strJSON += "\n";
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strJSON);
         return true;
@@ -573,6 +586,164 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
 }
 
+/**
+ * The Dash specific objects are only available in the formats of the P2P messages, they are serialized
+ * directly instead of converting them to JSON first.
+ */
+static bool CheckBinaryFormat(HTTPRequest* req, RetFormat rf)
+{
+    if (rf != RetFormat::BINARY && rf != RetFormat::HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+    return true;
+}
+
+template <typename T>
+static bool WriteBinaryReply(HTTPRequest* req, RetFormat rf, const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+
+    if (rf == RetFormat::BINARY) {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ss.str());
+    } else {
+        std::string strHex = HexStr(ss.begin(), ss.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+    }
+    return true;
+}
+
+static bool WriteMNListDiffReply(HTTPRequest* req, RetFormat rf, const uint256& baseBlockHash, const uint256& blockHash)
+{
+    // Serialized the same way as the cached P2P messages
+    CSimplifiedMNListDiffCache::DiffBytesPtr diff;
+    std::string strError;
+    {
+        LOCK(cs_main);
+        if (!mnListDiffCache.GetDiff(baseBlockHash, blockHash, diff, strError))
+            return RESTERR(req, HTTP_NOT_FOUND, strError);
+    }
+
+    if (rf == RetFormat::BINARY) {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, std::string(diff->begin(), diff->end()));
+    } else {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(*diff) + "\n");
+    }
+    return true;
+}
+
+static bool rest_mnlist(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!CheckBinaryFormat(req, rf))
+        return false;
+
+    // The full list is the diff to the genesis block, of the tip if no block is given
+    uint256 blockHash;
+    if (param.empty()) {
+        LOCK(cs_main);
+        blockHash = chainActive.Tip()->GetBlockHash();
+    } else if (param[0] != '/' || !ParseHashStr(param.substr(1), blockHash)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + param);
+    }
+
+    return WriteMNListDiffReply(req, rf, uint256(), blockHash);
+}
+
+static bool rest_mnlistdiff(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!CheckBinaryFormat(req, rf))
+        return false;
+
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No base block hash and block hash specified. Use /rest/mnlistdiff/<base-block-hash>/<block-hash>.<ext>");
+
+    uint256 baseBlockHash, blockHash;
+    if (!ParseHashStr(path[0], baseBlockHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[0]);
+    if (!ParseHashStr(path[1], blockHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    return WriteMNListDiffReply(req, rf, baseBlockHash, blockHash);
+}
+
+static bool rest_quorum(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!CheckBinaryFormat(req, rf))
+        return false;
+
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No LLMQ type and quorum hash specified. Use /rest/quorum/<llmq-type>/<quorum-hash>.<ext>");
+
+    int32_t nType;
+    if (!ParseInt32(path[0], &nType) || !Params().GetConsensus().llmqs.count((Consensus::LLMQType)nType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid LLMQ type: " + path[0]);
+    uint256 quorumHash;
+    if (!ParseHashStr(path[1], quorumHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    auto quorum = llmq::quorumManager->GetQuorum((Consensus::LLMQType)nType, quorumHash);
+    if (!quorum)
+        return RESTERR(req, HTTP_NOT_FOUND, path[1] + " not found");
+
+    // The final commitment defines the quorum, the members can be derived from it and the quorum hash
+    return WriteBinaryReply(req, rf, quorum->qc);
+}
+
+static bool rest_islock(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+    if (!CheckBinaryFormat(req, rf))
+        return false;
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    auto entry = llmq::quorumInstantSendManager->GetInstantSendLockEntryByTxid(hash);
+    if (!entry)
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+    return WriteBinaryReply(req, rf, MakeSpan(entry->bytes));
+}
+
+static bool rest_clsig(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!CheckBinaryFormat(req, rf))
+        return false;
+
+    llmq::CChainLockSig clsig = llmq::chainLocksHandler->GetBestChainLock();
+    if (clsig.IsNull())
+        return RESTERR(req, HTTP_NOT_FOUND, "no chainlock known");
+
+    return WriteBinaryReply(req, rf, clsig);
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -585,6 +756,11 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/mnlistdiff/", rest_mnlistdiff},
+      {"/rest/mnlist", rest_mnlist},
+      {"/rest/quorum/", rest_quorum},
+      {"/rest/islock/", rest_islock},
+      {"/rest/clsig", rest_clsig},
 };
 
 bool StartREST()
@@ -7,18 +7,24 @@
 #include <rpc/blockchain.h>
 
 #include <amount.h>
+#include <blockview.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <coins.h>
 #include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <core_io.h>
 #include <consensus/validation.h>
+#include <index/blockfilterindex.h>
+#include <index/timestampindex.h>
 #include <validation.h>
 // #include <rpc/index/txindex.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
 #include <rpc/server.h>
+#include <rpc/snapshot.h>
+#include <script/sigcache.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
@@ -31,6 +37,7 @@
 
 #include <evo/specialtx.h>
 #include <evo/cbtx.h>
+#include <evo/evodb.h>
 
 #include <llmq/quorums_chainlocks.h>
 #include <llmq/quorums_instantsend.h>
@@ -56,7 +63,7 @@ static std::mutex cs_blockchange;
 static std::condition_variable cond_blockchange;
 static CUpdatedBlock latestblock;
 
-extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
+extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry, const CRPCChainSnapshot& chain);
 
 /* Calculate the difficulty for a given block index.
  */
@@ -118,63 +125,85 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+// Writes everything but the transactions, which are written by writeTxs as they are listed differently depending on
+// the verbosity. coinbaseTx may be null if the caller has no transactions
+static void blockToJSON(JSONWriter& writer, const CBlockHeader& header, size_t nSize, const CTransaction* coinbaseTx,
+                        const CBlockIndex* blockindex, const CRPCChainSnapshot& chain, const std::function<void(bool)>& writeTxs)
 {
-    AssertLockHeld(cs_main);
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", blockindex->GetBlockHash().GetHex());
+    writer.BeginObject();
+    writer.KV("hash", blockindex->GetBlockHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("versionHex", strprintf("%08x", block.nVersion));
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    if (chain.Contains(blockindex))
+        confirmations = chain.Height() - blockindex->nHeight + 1;
+    writer.KV("confirmations", confirmations);
+    writer.KV("size", (int)nSize);
+    writer.KV("height", blockindex->nHeight);
+    writer.KV("version", header.nVersion);
+    writer.KV("versionHex", strprintf("%08x", header.nVersion));
+    writer.KV("merkleroot", header.hashMerkleRoot.GetHex());
     bool chainLock = llmq::chainLocksHandler->HasChainLock(blockindex->nHeight, blockindex->GetBlockHash());
-    UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToUniv(*tx, uint256(), objTx, true);
-            bool fLocked = llmq::quorumInstantSendManager->IsLocked(tx->GetHash());
-            objTx.pushKV("instantlock", fLocked || chainLock);
-            objTx.pushKV("instantlock_internal", fLocked);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx->GetHash().GetHex());
-    }
-    result.pushKV("tx", txs);
-    if (!block.vtx[0]->vExtraPayload.empty()) {
+    writer.Key("tx");
+    writer.BeginArray();
+    writeTxs(chainLock);
+    writer.EndArray();
+    if (coinbaseTx && !coinbaseTx->vExtraPayload.empty()) {
         CCbTx cbTx;
-        if (GetTxPayload(block.vtx[0]->vExtraPayload, cbTx)) {
+        if (GetTxPayload(coinbaseTx->vExtraPayload, cbTx)) {
             UniValue cbTxObj;
             cbTx.ToJson(cbTxObj);
-            result.pushKV("cbTx", cbTxObj);
+            writer.KV("cbTx", cbTxObj);
         }
     }
-    result.pushKV("time", block.GetBlockTime());
-    result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-    result.pushKV("nTx", (uint64_t)blockindex->nTx);
+    writer.KV("time", header.GetBlockTime());
+    writer.KV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+    writer.KV("nonce", (uint64_t)header.nNonce);
+    writer.KV("bits", strprintf("%08x", header.nBits));
+    writer.KV("difficulty", GetDifficulty(blockindex));
+    writer.KV("chainwork", blockindex->nChainWork.GetHex());
+    writer.KV("nTx", (uint64_t)blockindex->nTx);
 
     if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+        writer.KV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+    const CBlockIndex* pnext = chain.Next(blockindex);
     if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+        writer.KV("nextblockhash", pnext->GetBlockHash().GetHex());
 
-    result.pushKV("chainlock", chainLock);
+    writer.KV("chainlock", chainLock);
+    writer.EndObject();
+}
 
-    return result;
+void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* blockindex, const CRPCChainSnapshot& chain, bool txDetails)
+{
+    size_t nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    blockToJSON(writer, block, nSize, block.vtx[0].get(), blockindex, chain, [&](bool chainLock) {
+        for(const auto& tx : block.vtx)
+        {
+            if(txDetails)
+            {
+                // Only one transaction is held as UniValue at a time
+                UniValue objTx(UniValue::VOBJ);
+                TxToUniv(*tx, uint256(), objTx, true);
+                bool fLocked = llmq::quorumInstantSendManager->IsLocked(tx->GetHash());
+                objTx.pushKV("instantlock", fLocked || chainLock);
+                objTx.pushKV("instantlock_internal", fLocked);
+                writer.Value(objTx);
+            }
+            else
+                writer.Value(tx->GetHash().GetHex());
+        }
+    });
+}
+
+void blockToJSON(JSONWriter& writer, const CBlockView& view, const CBlockIndex* blockindex, const CRPCChainSnapshot& chain)
+{
+    // only the coinbase is deserialized, for its cbTx payload
+    CTransactionRef coinbaseTx = view.GetTxCount() != 0 ? view.GetTx(0) : nullptr;
+    blockToJSON(writer, view.GetHeader(), view.GetSerializeSize(), coinbaseTx.get(), blockindex, chain, [&](bool chainLock) {
+        for (size_t i = 0; i < view.GetTxCount(); i++) {
+            writer.Value(view.GetTxHash(i).GetHex());
+        }
+    });
 }
 
 UniValue getblockcount(const JSONRPCRequest& request)
@@ -484,31 +513,30 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCKS_REQUI
     info.pushKV("instantlock", llmq::quorumInstantSendManager->IsLocked(tx.GetHash()));
 }
 
-UniValue mempoolToJSON(bool fVerbose)
+void mempoolToJSON(JSONWriter& writer, bool fVerbose)
 {
     if (fVerbose)
     {
         LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
+        writer.BeginObject();
         for (const CTxMemPoolEntry& e : mempool.mapTx)
         {
             const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
             entryToJSON(info, e);
-            o.pushKV(hash.ToString(), info);
+            writer.KV(hash.ToString(), info);
         }
-        return o;
+        writer.EndObject();
     }
     else
     {
         std::vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        writer.BeginArray();
         for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            writer.Value(hash.ToString());
+        writer.EndArray();
     }
 }
 
@@ -541,7 +569,9 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        mempoolToJSON(writer, fVerbose);
+    });
 }
 
 UniValue getmempoolancestors(const JSONRPCRequest& request)
@@ -707,10 +737,11 @@ UniValue getmempoolentry(const JSONRPCRequest& request)
 
 UniValue getblockhashes(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 2)
+    if (request.fHelp || !((request.params.size() == 2 && !request.params[0].isArray()) || (request.params.size() == 1 && request.params[0].isArray())))
         throw std::runtime_error(
             "getblockhashes timestamp\n"
             "\nReturns array of hashes of blocks within the timestamp range provided.\n"
+            "Multiple ranges can be passed as an array of [high, low] pairs instead, which are looked up together.\n"
             "\nArguments:\n"
             "1. high         (numeric, required) The newer block timestamp\n"
             "2. low          (numeric, required) The older block timestamp\n"
@@ -718,16 +749,54 @@ UniValue getblockhashes(const JSONRPCRequest& request)
             "[\n"
             "  \"hash\"         (string) The block hash\n"
             "]\n"
+            "\nResult (for an array of ranges):\n"
+            "[\n"
+            "  [\"hash\", ...],   (array) The block hashes of the range at the same position\n"
+            "  ,...\n"
+            "]\n"
             "\nExamples:\n"
             + HelpExampleCli("getblockhashes", "1231614698 1231024505")
+            + HelpExampleCli("getblockhashes", "'[[1231614698, 1231024505], [1231714698, 1231624505]]'")
             + HelpExampleRpc("getblockhashes", "1231614698, 1231024505")
         );
 
+    if (!g_timestampindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Timestamp index not enabled");
+    }
+
+    if (request.params[0].isArray()) {
+        const UniValue& arr = request.params[0].get_array();
+        std::vector<std::pair<unsigned int, unsigned int>> ranges;
+        for (size_t i = 0; i < arr.size(); i++) {
+            if (!arr[i].isArray() || arr[i].size() != 2) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected [high, low] pairs");
+            }
+            ranges.emplace_back(arr[i][0].get_int(), arr[i][1].get_int());
+        }
+
+        std::vector<std::vector<uint256>> rangeHashes;
+        g_timestampindex->BlockUntilSyncedToCurrentChain();
+        if (!g_timestampindex->FindBlockHashes(ranges, rangeHashes)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
+        }
+
+        UniValue result(UniValue::VARR);
+        for (const auto& hashes : rangeHashes) {
+            UniValue arrHashes(UniValue::VARR);
+            for (const auto& hash : hashes) {
+                arrHashes.push_back(hash.GetHex());
+            }
+            result.push_back(arrHashes);
+        }
+        return result;
+    }
+
     unsigned int high = request.params[0].get_int();
     unsigned int low = request.params[1].get_int();
     std::vector<uint256> blockHashes;
 
-    if (!GetTimestampIndex(high, low, blockHashes)) {
+    g_timestampindex->BlockUntilSyncedToCurrentChain();
+    if (!g_timestampindex->FindBlockHashes(high, low, blockHashes)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
 
@@ -739,6 +808,106 @@ UniValue getblockhashes(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue getindexinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getindexinfo\n"
+            "\nReturns the status of the indexes which are built in the background.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                 (object) One entry per enabled index\n"
+            "    \"synced\": xxxx,          (boolean) Whether the index caught up with the active chain\n"
+            "    \"best_block_height\": xx  (numeric) The height of the last block processed by the index\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+        );
+
+    UniValue result(UniValue::VOBJ);
+    if (g_timestampindex) {
+        UniValue info(UniValue::VOBJ);
+        info.pushKV("synced", g_timestampindex->IsSynced());
+        info.pushKV("best_block_height", g_timestampindex->GetBestHeight());
+        result.pushKV("timestampindex", info);
+    }
+    if (g_blockfilterindex) {
+        UniValue info(UniValue::VOBJ);
+        info.pushKV("synced", g_blockfilterindex->IsSynced());
+        info.pushKV("best_block_height", g_blockfilterindex->GetBestHeight());
+        result.pushKV("blockfilterindex", info);
+    }
+    return result;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\"\n"
+            "\nRetrieve the BIP 158 basic content filter for a particular block.\n"
+            "Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"    (string, required) The hash of the block\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hex\"    (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+        );
+
+    if (!g_blockfilterindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype basic");
+    }
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = g_blockfilterindex->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!g_blockfilterindex->LookupFilter(block_index, filter) ||
+        !g_blockfilterindex->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
 UniValue getblockhash(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -885,7 +1054,7 @@ UniValue getblockheaders(const JSONRPCRequest& request)
     if (!request.params[2].isNull())
         fVerbose = request.params[2].get_bool();
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = LookupBlockIndex(hash);
 
     UniValue arrHeaders(UniValue::VARR);
 
@@ -916,8 +1085,11 @@ UniValue getblockheaders(const JSONRPCRequest& request)
 static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
 {
     CBlock block;
-    if (IsBlockPruned(pblockindex)) {
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    {
+        LOCK(cs_main);
+        if (IsBlockPruned(pblockindex)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        }
     }
 
     if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
@@ -932,6 +1104,24 @@ static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
     return block;
 }
 
+static std::unique_ptr<CBlockView> GetBlockViewChecked(const CBlockIndex* pblockindex)
+{
+    {
+        LOCK(cs_main);
+        if (IsBlockPruned(pblockindex)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        }
+    }
+
+    std::unique_ptr<CBlockView> view;
+    if (!ReadBlockViewFromDisk(view, pblockindex, Params())) {
+        // See GetBlockChecked
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    }
+
+    return view;
+}
+
 
 UniValue getmerkleblocks(const JSONRPCRequest& request)
 {
@@ -979,7 +1169,7 @@ UniValue getmerkleblocks(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Count is out of range");
     }
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = LookupBlockIndex(hash);
     CBlock block = GetBlockChecked(pblockindex);
 
     UniValue arrMerkleBlocks(UniValue::VARR);
@@ -1064,8 +1254,6 @@ UniValue getblock(const JSONRPCRequest& request)
             + HelpExampleRpc("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -1077,22 +1265,36 @@ UniValue getblock(const JSONRPCRequest& request)
             verbosity = request.params[1].get_bool() ? 1 : 0;
     }
 
-    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
+    const CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        pblockindex = LookupBlockIndex(hash);
+    }
     if (!pblockindex) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
 
-    const CBlock block = GetBlockChecked(pblockindex);
+    // the transactions are only deserialized for verbosity 2, the other verbosities only need the serialized block and txids
+    const std::unique_ptr<CBlockView> view = GetBlockViewChecked(pblockindex);
 
     if (verbosity <= 0)
     {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        const auto& vData = view->GetData();
+        std::string strHex = HexStr(vData.begin(), vData.end());
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    auto snapshot = GetRPCChainSnapshot(request);
+    if (verbosity == 1) {
+        return WriteRPCResult(request, [&](JSONWriter& writer) {
+            blockToJSON(writer, *view, pblockindex, *snapshot);
+        });
+    }
+
+    const CBlock block = view->GetBlock();
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        blockToJSON(writer, block, pblockindex, *snapshot, true);
+    });
 }
 
 UniValue pruneblockchain(const JSONRPCRequest& request)
@@ -1293,6 +1495,95 @@ UniValue verifychain(const JSONRPCRequest& request)
     return CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), nCheckLevel, nCheckDepth);
 }
 
+UniValue replayblocks(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "replayblocks nblocks ( iterations )\n"
+            "\nDisconnects the last nblocks blocks into memory and connects them again, iterations times, for profiling\n"
+            "ConnectBlock. Nothing is written to the chainstate or the evo database. The node does not process anything\n"
+            "else while replaying, so this should only be used on a copy of a datadir (e.g. synced with -stopatheight).\n"
+            "\nArguments:\n"
+            "1. nblocks       (numeric, required) The number of blocks below the tip to replay\n"
+            "2. iterations    (numeric, optional, default=1) How often to replay the blocks\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": n,           (numeric) The number of replayed blocks\n"
+            "  \"transactions\": n,     (numeric) The number of transactions in the replayed blocks\n"
+            "  \"iterations\": [ x, ... ], (array) The time (in ms) it took to connect all blocks, per iteration\n"
+            "  \"stages\": {            (json object) The average time (in ms per block) of the ConnectBlock stages, as logged with -debug=bench\n"
+            "    \"checks\": x.xxx,\n"
+            "    \"forks\": x.xxx,\n"
+            "    \"process_special_txs\": x.xxx,\n"
+            "    \"connect_txs\": x.xxx,\n"
+            "    \"verify_txins\": x.xxx,  (includes process_special_txs and connect_txs)\n"
+            "    \"is_filter\": x.xxx,\n"
+            "    \"block_subsidy\": x.xxx,\n"
+            "    \"block_value\": x.xxx,\n"
+            "    \"block_payee\": x.xxx,\n"
+            "    \"dash_specific\": x.xxx, (includes is_filter, block_subsidy, block_value and block_payee)\n"
+            "    \"index_writing\": x.xxx,\n"
+            "    \"callbacks\": x.xxx\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("replayblocks", "100 5")
+            + HelpExampleRpc("replayblocks", "100, 5")
+        );
+
+    int nBlocks = request.params[0].get_int();
+    int nIterations = request.params[1].isNull() ? 1 : request.params[1].get_int();
+    if (nBlocks <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "nblocks must be positive");
+    }
+    if (nIterations <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "iterations must be positive");
+    }
+
+    LOCK(cs_main);
+
+    nBlocks = std::min(nBlocks, chainActive.Height());
+    size_t nTransactions = 0;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && chainActive.Height() - pindex->nHeight < nBlocks; pindex = pindex->pprev) {
+        nTransactions += pindex->nTx;
+    }
+
+    std::vector<int64_t> vIterationTimes;
+    ConnectBlockTimings timings;
+    std::string strError;
+    if (!ReplayTipBlocks(Params(), nBlocks, nIterations, vIterationTimes, timings, strError)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, strError);
+    }
+
+    UniValue iterations(UniValue::VARR);
+    for (int64_t nTime : vIterationTimes) {
+        iterations.push_back(nTime * 0.001);
+    }
+
+    // per block averages
+    double nFactor = timings.nBlocks > 0 ? 0.001 / timings.nBlocks : 0;
+    UniValue stages(UniValue::VOBJ);
+    stages.pushKV("checks", timings.nCheck * nFactor);
+    stages.pushKV("forks", timings.nForks * nFactor);
+    stages.pushKV("process_special_txs", timings.nProcessSpecial * nFactor);
+    stages.pushKV("connect_txs", timings.nConnect * nFactor);
+    stages.pushKV("verify_txins", timings.nVerify * nFactor);
+    stages.pushKV("is_filter", timings.nISFilter * nFactor);
+    stages.pushKV("block_subsidy", timings.nSubsidy * nFactor);
+    stages.pushKV("block_value", timings.nValueValid * nFactor);
+    stages.pushKV("block_payee", timings.nPayeeValid * nFactor);
+    stages.pushKV("dash_specific", timings.nDashSpecific * nFactor);
+    stages.pushKV("index_writing", timings.nIndex * nFactor);
+    stages.pushKV("callbacks", timings.nCallbacks * nFactor);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("blocks", nBlocks);
+    ret.pushKV("transactions", (uint64_t)nTransactions);
+    ret.pushKV("iterations", iterations);
+    ret.pushKV("stages", stages);
+    return ret;
+}
+
 /** Implementation of IsSuperMajority with better feedback */
 static UniValue SoftForkMajorityDesc(int version, CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
@@ -1387,6 +1678,17 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"pruneheight\": xxxxxx,        (numeric) lowest-height complete block stored (only present if pruning is enabled)\n"
             "  \"automatic_pruning\": xx,      (boolean) whether automatic pruning is enabled (only present if pruning is enabled)\n"
             "  \"prune_target_size\": xxxxxx,  (numeric) the target size used by pruning (only present if automatic pruning is enabled)\n"
+            "  \"prune_progress\": {           (json object) progress of the background deletion of pruned files (only present if pruning is enabled)\n"
+            "     \"files_pending\": xx,        (numeric) number of pruned block files waiting to be deleted\n"
+            "     \"files_deleted\": xx,        (numeric) number of pruned block files deleted since startup\n"
+            "     \"compacting\": xx,           (boolean) whether the block index and chainstate are being compacted right now\n"
+            "     \"last_compaction\": xxxxxx,  (numeric) the time of the last compaction after pruning, 0 if none happened yet\n"
+            "  },\n"
+            "  \"snapshot_validation\": {      (json object) progress of the validation of the blocks below a UTXO snapshot loaded with -loadsnapshot (only present until it is finished)\n"
+            "     \"base_hash\": \"hash\",       (string) the hash of the snapshot base\n"
+            "     \"base_height\": xx,          (numeric) the height of the snapshot base\n"
+            "     \"validated_height\": xx,     (numeric) the height up to which the blocks below the base are validated\n"
+            "  },\n"
             "  \"softforks\": [                (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",           (string) name of softfork\n"
@@ -1450,6 +1752,23 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
         if (automatic_pruning) {
             obj.pushKV("prune_target_size",  nPruneTarget);
         }
+
+        BackgroundPruneProgress pruneProgress = GetBackgroundPruneProgress();
+        UniValue pruneProgressObj(UniValue::VOBJ);
+        pruneProgressObj.pushKV("files_pending", (uint64_t)pruneProgress.nFilesPending);
+        pruneProgressObj.pushKV("files_deleted", pruneProgress.nFilesDeleted);
+        pruneProgressObj.pushKV("compacting", pruneProgress.fCompacting);
+        pruneProgressObj.pushKV("last_compaction", pruneProgress.nLastCompactionTime);
+        obj.pushKV("prune_progress",     pruneProgressObj);
+    }
+
+    SnapshotValidationProgress snapshotProgress = GetSnapshotValidationProgress();
+    if (snapshotProgress.pindexBase) {
+        UniValue snapshotProgressObj(UniValue::VOBJ);
+        snapshotProgressObj.pushKV("base_hash", snapshotProgress.pindexBase->GetBlockHash().GetHex());
+        snapshotProgressObj.pushKV("base_height", snapshotProgress.pindexBase->nHeight);
+        snapshotProgressObj.pushKV("validated_height", snapshotProgress.nValidatedHeight);
+        obj.pushKV("snapshot_validation", snapshotProgressObj);
     }
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -1655,6 +1974,48 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+static UniValue SignatureCacheStatsToJSON(const CSignatureCacheStats& stats)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("capacity", stats.nCapacity);
+    ret.pushKV("entries", stats.nEntries);
+    ret.pushKV("hits", stats.nHits);
+    ret.pushKV("misses", stats.nMisses);
+    uint64_t nLookups = stats.nHits + stats.nMisses;
+    ret.pushKV("hitrate", nLookups ? (double)stats.nHits / nLookups : 0.0);
+    return ret;
+}
+
+UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getsigcacheinfo\n"
+            "\nReturns the usage of the signature and script execution caches since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"sigcache\": {           (json object) Cache of valid signatures\n"
+            "    \"capacity\": xxxxx,    (numeric) Maximum number of entries\n"
+            "    \"entries\": xxxxx,     (numeric) Current number of entries\n"
+            "    \"hits\": xxxxx,        (numeric) Number of lookups which found an entry\n"
+            "    \"misses\": xxxxx,      (numeric) Number of lookups which didn't find an entry\n"
+            "    \"hitrate\": x.xxx      (numeric) Share of lookups which found an entry\n"
+            "  },\n"
+            "  \"scriptcache\": {        (json object) Cache of transactions with valid scripts, same fields as above\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("sigcache", SignatureCacheStatsToJSON(GetSignatureCacheStats()));
+    ret.pushKV("scriptcache", SignatureCacheStatsToJSON(GetScriptExecutionCacheStats()));
+    return ret;
+}
+
 UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1939,7 +2300,7 @@ static UniValue getblockstats(const JSONRPCRequest& request)
         const uint256 hash = ParseHashV(request.params[0], "parameter 1");
         if (mapBlockIndex.count(hash) == 0)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-        pindex = mapBlockIndex[hash];
+        pindex = LookupBlockIndex(hash);
         // pindex = LookupBlockIndex(hash);
         // if (!pindex) {
         //     throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
@@ -2164,8 +2525,9 @@ UniValue getspecialtxes(const JSONRPCRequest& request)
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = LookupBlockIndex(hash);
     const CBlock block = GetBlockChecked(pblockindex);
+    auto snapshot = GetRPCChainSnapshot(request);
 
     int nTxNum = 0;
     UniValue result(UniValue::VARR);
@@ -2187,7 +2549,7 @@ UniValue getspecialtxes(const JSONRPCRequest& request)
             case 2 :
                 {
                     UniValue objTx(UniValue::VOBJ);
-                    TxToJSON(*tx, uint256(), objTx);
+                    TxToJSON(*tx, uint256(), objTx, *snapshot);
                     result.push_back(objTx);
                     break;
                 }
@@ -2221,6 +2583,168 @@ UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue WriteUTXOSnapshot(CAutoFile& afile)
+{
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::unique_ptr<CDBIterator> pevocursor;
+    CCoinsStats stats;
+    SnapshotMetadata metadata;
+    std::vector<const CBlockIndex*> vHeaderIndexes;
+
+    {
+        // We need to lock cs_main to ensure that the coins and evo DB cursors see the same state, both
+        // iterate over a consistent leveldb snapshot after cs_main is released.
+        LOCK(cs_main);
+
+        FlushStateToDisk();
+
+        if (!GetUTXOStats(pcoinsdbview.get(), stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        const CBlockIndex* tip = LookupBlockIndex(stats.hashBlock);
+        assert(tip);
+        if (!evoDb->VerifyBestBlock(stats.hashBlock) && tip->nHeight >= Params().GetConsensus().DIP0003Height) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "evo DB is not at the UTXO set tip");
+        }
+
+        pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
+        pevocursor = std::unique_ptr<CDBIterator>(evoDb->GetRawDB().NewIterator());
+
+        metadata.m_base_blockhash = stats.hashBlock;
+        metadata.m_base_height = tip->nHeight;
+        metadata.m_base_chainlocked = llmq::chainLocksHandler->HasChainLock(tip->nHeight, tip->GetBlockHash());
+        metadata.m_coins_count = stats.nTransactionOutputs;
+        metadata.m_utxo_hash = stats.hashSerialized;
+        metadata.m_base_chain_tx = tip->nChainTx;
+
+        // The headers of block index entries never change, they are written after cs_main is released
+        vHeaderIndexes.resize(tip->nHeight);
+        for (const CBlockIndex* pindex = tip; pindex->pprev; pindex = pindex->pprev) {
+            vHeaderIndexes[pindex->nHeight - 1] = pindex;
+        }
+    }
+
+    // The evo DB is small compared to the UTXO set, count its entries beforehand so the metadata can be
+    // written first
+    for (pevocursor->SeekToFirst(); pevocursor->Valid(); pevocursor->Next()) {
+        if (!CDBWrapper::IsObfuscateKeyKey(pevocursor->GetKey())) {
+            metadata.m_evodb_count++;
+        }
+    }
+
+    afile << metadata;
+
+    for (const CBlockIndex* pindex : vHeaderIndexes) {
+        afile << pindex->GetBlockHeader();
+    }
+
+    COutPoint key;
+    Coin coin;
+    uint64_t coins_written{0};
+    while (pcursor->Valid()) {
+        if (coins_written % 1000 == 0) {
+            boost::this_thread::interruption_point();
+        }
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            afile << key;
+            afile << coin;
+            coins_written++;
+        }
+        pcursor->Next();
+    }
+    if (coins_written != metadata.m_coins_count) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unexpected number of coins written");
+    }
+
+    uint64_t evodb_written{0};
+    for (pevocursor->SeekToFirst(); pevocursor->Valid(); pevocursor->Next()) {
+        CDataStream ssKey = pevocursor->GetKey();
+        if (CDBWrapper::IsObfuscateKeyKey(ssKey)) {
+            // Every database has its own
+            continue;
+        }
+        CDataStream ssValue = pevocursor->GetValue();
+        afile << std::vector<unsigned char>(ssKey.begin(), ssKey.end());
+        afile << std::vector<unsigned char>(ssValue.begin(), ssValue.end());
+        evodb_written++;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_written", coins_written);
+    result.pushKV("evodb_entries", evodb_written);
+    result.pushKV("base_hash", metadata.m_base_blockhash.ToString());
+    result.pushKV("base_height", metadata.m_base_height);
+    result.pushKV("chainlocked", metadata.m_base_chainlocked);
+    result.pushKV("hash_serialized_2", metadata.m_utxo_hash.ToString());
+    return result;
+}
+
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the serialized UTXO set, the evo DB state and the block headers up to the current tip to disk.\n"
+            "The snapshot should be taken at a ChainLocked tip, which is reported in the result. It can be loaded\n"
+            "into a new datadir with -loadsnapshot.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) Path to the output file. If relative, will be prefixed by datadir.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,      (numeric) The number of coins written in the snapshot\n"
+            "  \"evodb_entries\": n,      (numeric) The number of evo DB entries written in the snapshot\n"
+            "  \"base_hash\": \"hex\",     (string) The hash of the base of the snapshot\n"
+            "  \"base_height\": n,        (numeric) The height of the base of the snapshot\n"
+            "  \"chainlocked\": true|false, (boolean) Whether the base of the snapshot is ChainLocked\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash of the UTXO set, see gettxoutsetinfo\n"
+            "  \"path\": \"path\"          (string) The absolute path that the snapshot was written to\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary path and then move into `path` on completion
+    // to avoid confusion due to an interruption.
+    fs::path temppath = fs::absolute(request.params[0].get_str() + ".incomplete", GetDataDir());
+
+    if (fs::exists(path)) {
+        throw JSONRPCError(
+            RPC_INVALID_PARAMETER,
+            path.string() + " already exists. If you are sure this is what you want, "
+            "move it out of the way first");
+    }
+
+    FILE* file{fsbridge::fopen(temppath, "wb")};
+    CAutoFile afile{file, SER_DISK, CLIENT_VERSION};
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unable to open " + temppath.string() + " for writing");
+    }
+
+    UniValue result;
+    try {
+        result = WriteUTXOSnapshot(afile);
+    } catch (...) {
+        // Don't leave the partial snapshot behind, it can't be used and is about as large as the UTXO set
+        afile.fclose();
+        try {
+            fs::remove(temppath);
+        } catch (const fs::filesystem_error& e) {
+            LogPrintf("%s: Unable to remove %s: %s\n", __func__, temppath.string(), e.what());
+        }
+        throw;
+    }
+
+    afile.fclose();
+    fs::rename(temppath, path);
+
+    result.pushKV("path", path.string());
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -2230,19 +2754,22 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
     { "blockchain",         "getbestchainlock",       &getbestchainlock,       {} },
     { "blockchain",         "getblockcount",          &getblockcount,          {} },
-    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
+    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"}, true },
     { "blockchain",         "getblockhashes",         &getblockhashes,         {"high","low"} },
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
     { "blockchain",         "getblockheaders",        &getblockheaders,        {"blockhash","count","verbose"} },
     { "blockchain",         "getmerkleblocks",        &getmerkleblocks,        {"filter","blockhash","count"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {"count","branchlen"} },
+    { "blockchain",         "getindexinfo",           &getindexinfo,           {} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash"} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
+    { "blockchain",         "getsigcacheinfo",        &getsigcacheinfo,        {} },
     { "blockchain",         "getspecialtxes",         &getspecialtxes,         {"blockhash", "type", "count", "skip", "verbosity"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
@@ -2251,6 +2778,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
@@ -2259,6 +2787,7 @@ static const CRPCCommand commands[] =
     { "hidden",             "waitforblock",           &waitforblock,           {"blockhash","timeout"} },
     { "hidden",             "waitforblockheight",     &waitforblockheight,     {"height","timeout"} },
     { "hidden",             "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, {} },
+    { "hidden",             "replayblocks",           &replayblocks,           {"nblocks","iterations"} },
 };
 
 void RegisterBlockchainRPCCommands(CRPCTable &t)
@@ -7,6 +7,9 @@
 
 class CBlock;
 class CBlockIndex;
+class CBlockView;
+class CRPCChainSnapshot;
+class JSONWriter;
 class UniValue;
 
 /**
@@ -22,13 +25,15 @@ double GetDifficulty(const CBlockIndex* blockindex);
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 /** Block description to JSON */
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* blockindex, const CRPCChainSnapshot& chain, bool txDetails = false);
+/** Block description to JSON with txids only, from a view of the serialized block */
+void blockToJSON(JSONWriter& writer, const CBlockView& view, const CBlockIndex* blockindex, const CRPCChainSnapshot& chain);
 
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
-UniValue mempoolToJSON(bool fVerbose = false);
+void mempoolToJSON(JSONWriter& writer, bool fVerbose = false);
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
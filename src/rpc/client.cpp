@@ -142,6 +142,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importmulti", 1, "options" },
     { "verifychain", 0, "checklevel" },
     { "verifychain", 1, "nblocks" },
+    { "replayblocks", 0, "nblocks" },
+    { "replayblocks", 1, "iterations" },
     { "getblockstats", 0, "hash_or_height" },
     { "getblockstats", 1, "stats" },
     { "pruneblockchain", 0, "height" },
@@ -158,6 +160,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "setcoinjoinamount", 0, "amount" },
     { "getmempoolancestors", 1, "verbose" },
     { "getmempooldescendants", 1, "verbose" },
+    { "getlockstats", 0, "count" },
+    { "getlockstats", 1, "reset" },
+    { "getprofile", 1, "reset" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
     { "spork", 1, "value" },
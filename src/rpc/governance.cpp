@@ -671,10 +671,8 @@ UniValue gobject_vote_alias(const JSONRPCRequest& request)
 }
 #endif
 
-UniValue ListObjects(const std::string& strCachedSignal, const std::string& strType, int nStartTime)
+void ListObjects(JSONWriter& writer, const std::string& strCachedSignal, const std::string& strType, int nStartTime)
 {
-    UniValue objResult(UniValue::VOBJ);
-
     // GET MATCHING GOVERNANCE OBJECTS
 
     LOCK2(cs_main, governance.cs);
@@ -684,6 +682,7 @@ UniValue ListObjects(const std::string& strCachedSignal, const std::string& strT
 
     // CREATE RESULTS FOR USER
 
+    writer.BeginObject();
     for (const auto& pGovObj : objs) {
         if (strCachedSignal == "valid" && !pGovObj->IsSetCachedValid()) continue;
         if (strCachedSignal == "funding" && !pGovObj->IsSetCachedFunding()) continue;
@@ -693,37 +692,36 @@ UniValue ListObjects(const std::string& strCachedSignal, const std::string& strT
         if (strType == "proposals" && pGovObj->GetObjectType() != GOVERNANCE_OBJECT_PROPOSAL) continue;
         if (strType == "triggers" && pGovObj->GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) continue;
 
-        UniValue bObj(UniValue::VOBJ);
-        bObj.pushKV("DataHex",  pGovObj->GetDataAsHexString());
-        bObj.pushKV("DataString",  pGovObj->GetDataAsPlainString());
-        bObj.pushKV("Hash",  pGovObj->GetHash().ToString());
-        bObj.pushKV("CollateralHash",  pGovObj->GetCollateralHash().ToString());
-        bObj.pushKV("ObjectType", pGovObj->GetObjectType());
-        bObj.pushKV("CreationTime", pGovObj->GetCreationTime());
+        writer.Key(pGovObj->GetHash().ToString());
+        writer.BeginObject();
+        writer.KV("DataHex",  pGovObj->GetDataAsHexString());
+        writer.KV("DataString",  pGovObj->GetDataAsPlainString());
+        writer.KV("Hash",  pGovObj->GetHash().ToString());
+        writer.KV("CollateralHash",  pGovObj->GetCollateralHash().ToString());
+        writer.KV("ObjectType", pGovObj->GetObjectType());
+        writer.KV("CreationTime", pGovObj->GetCreationTime());
         const COutPoint& masternodeOutpoint = pGovObj->GetMasternodeOutpoint();
         if (masternodeOutpoint != COutPoint()) {
-            bObj.pushKV("SigningMasternode", masternodeOutpoint.ToStringShort());
+            writer.KV("SigningMasternode", masternodeOutpoint.ToStringShort());
         }
 
         // REPORT STATUS FOR FUNDING VOTES SPECIFICALLY
-        bObj.pushKV("AbsoluteYesCount",  pGovObj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING));
-        bObj.pushKV("YesCount",  pGovObj->GetYesCount(VOTE_SIGNAL_FUNDING));
-        bObj.pushKV("NoCount",  pGovObj->GetNoCount(VOTE_SIGNAL_FUNDING));
-        bObj.pushKV("AbstainCount",  pGovObj->GetAbstainCount(VOTE_SIGNAL_FUNDING));
+        writer.KV("AbsoluteYesCount",  pGovObj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING));
+        writer.KV("YesCount",  pGovObj->GetYesCount(VOTE_SIGNAL_FUNDING));
+        writer.KV("NoCount",  pGovObj->GetNoCount(VOTE_SIGNAL_FUNDING));
+        writer.KV("AbstainCount",  pGovObj->GetAbstainCount(VOTE_SIGNAL_FUNDING));
 
         // REPORT VALIDITY AND CACHING FLAGS FOR VARIOUS SETTINGS
         std::string strError = "";
-        bObj.pushKV("fBlockchainValidity",  pGovObj->IsValidLocally(strError, false));
-        bObj.pushKV("IsValidReason",  strError.c_str());
-        bObj.pushKV("fCachedValid",  pGovObj->IsSetCachedValid());
-        bObj.pushKV("fCachedFunding",  pGovObj->IsSetCachedFunding());
-        bObj.pushKV("fCachedDelete",  pGovObj->IsSetCachedDelete());
-        bObj.pushKV("fCachedEndorsed",  pGovObj->IsSetCachedEndorsed());
-
-        objResult.pushKV(pGovObj->GetHash().ToString(), bObj);
+        writer.KV("fBlockchainValidity",  pGovObj->IsValidLocally(strError, false));
+        writer.KV("IsValidReason",  strError);
+        writer.KV("fCachedValid",  pGovObj->IsSetCachedValid());
+        writer.KV("fCachedFunding",  pGovObj->IsSetCachedFunding());
+        writer.KV("fCachedDelete",  pGovObj->IsSetCachedDelete());
+        writer.KV("fCachedEndorsed",  pGovObj->IsSetCachedEndorsed());
+        writer.EndObject();
     }
-
-    return objResult;
+    writer.EndObject();
 }
 
 void gobject_list_help()
@@ -756,7 +754,9 @@ UniValue gobject_list(const JSONRPCRequest& request)
     if (strType != "proposals" && strType != "triggers" && strType != "all")
         return "Invalid type, should be 'proposals', 'triggers' or 'all'";
 
-    return ListObjects(strCachedSignal, strType, 0);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        ListObjects(writer, strCachedSignal, strType, 0);
+    });
 }
 
 void gobject_diff_help()
@@ -789,7 +789,9 @@ UniValue gobject_diff(const JSONRPCRequest& request)
     if (strType != "proposals" && strType != "triggers" && strType != "all")
         return "Invalid type, should be 'proposals', 'triggers' or 'all'";
 
-    return ListObjects(strCachedSignal, strType, governance.GetLastDiffTime());
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        ListObjects(writer, strCachedSignal, strType, governance.GetLastDiffTime());
+    });
 }
 
 void gobject_get_help()
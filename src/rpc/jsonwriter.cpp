@@ -0,0 +1,166 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonwriter.h>
+
+#include <univalue.h>
+
+#include <assert.h>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+
+JSONWriter::JSONWriter(JSONWriterSink& sink) : m_sink(sink)
+{
+    m_buf.reserve(JSONWRITER_CHUNK_SIZE * 2);
+}
+
+void JSONWriter::BeginValue()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (!m_nonempty.empty()) {
+        if (m_nonempty.back()) {
+            m_buf += ',';
+        }
+        m_nonempty.back() = true;
+    }
+}
+
+void JSONWriter::WriteEscaped(const char* str, size_t len)
+{
+    // Same escaping as in UniValue::write()
+    static const char* hexDigits = "0123456789abcdef";
+    m_buf += '"';
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = str[i];
+        switch (ch) {
+        case '"': m_buf += "\\\""; break;
+        case '\\': m_buf += "\\\\"; break;
+        case '\b': m_buf += "\\b"; break;
+        case '\t': m_buf += "\\t"; break;
+        case '\n': m_buf += "\\n"; break;
+        case '\f': m_buf += "\\f"; break;
+        case '\r': m_buf += "\\r"; break;
+        default:
+            if (ch < 0x20 || ch == 0x7f) {
+                m_buf += "\\u00";
+                m_buf += hexDigits[ch >> 4];
+                m_buf += hexDigits[ch & 0xf];
+            } else {
+                m_buf += ch;
+            }
+        }
+    }
+    m_buf += '"';
+}
+
+void JSONWriter::BeginObject()
+{
+    BeginValue();
+    m_buf += '{';
+    m_nonempty.push_back(false);
+}
+
+void JSONWriter::EndObject()
+{
+    assert(!m_nonempty.empty() && !m_after_key);
+    m_nonempty.pop_back();
+    m_buf += '}';
+    MaybeFlush();
+}
+
+void JSONWriter::BeginArray()
+{
+    BeginValue();
+    m_buf += '[';
+    m_nonempty.push_back(false);
+}
+
+void JSONWriter::EndArray()
+{
+    assert(!m_nonempty.empty() && !m_after_key);
+    m_nonempty.pop_back();
+    m_buf += ']';
+    MaybeFlush();
+}
+
+void JSONWriter::Key(const std::string& key)
+{
+    assert(!m_after_key);
+    BeginValue();
+    WriteEscaped(key.data(), key.size());
+    m_buf += ':';
+    m_after_key = true;
+}
+
+void JSONWriter::Null()
+{
+    BeginValue();
+    m_buf += "null";
+    MaybeFlush();
+}
+
+void JSONWriter::Value(const std::string& val)
+{
+    BeginValue();
+    WriteEscaped(val.data(), val.size());
+    MaybeFlush();
+}
+
+void JSONWriter::Value(const char* val)
+{
+    BeginValue();
+    WriteEscaped(val, strlen(val));
+    MaybeFlush();
+}
+
+void JSONWriter::Value(bool val)
+{
+    BeginValue();
+    m_buf += val ? "true" : "false";
+    MaybeFlush();
+}
+
+void JSONWriter::Value(int64_t val)
+{
+    BeginValue();
+    m_buf += std::to_string(val);
+    MaybeFlush();
+}
+
+void JSONWriter::Value(uint64_t val)
+{
+    BeginValue();
+    m_buf += std::to_string(val);
+    MaybeFlush();
+}
+
+void JSONWriter::Value(double val)
+{
+    // Same formatting as UniValue::setFloat()
+    std::ostringstream oss;
+    oss << std::setprecision(16) << val;
+    BeginValue();
+    m_buf += oss.str();
+    MaybeFlush();
+}
+
+void JSONWriter::Value(const UniValue& val)
+{
+    BeginValue();
+    m_buf += val.write();
+    MaybeFlush();
+}
+
+void JSONWriter::Flush()
+{
+    if (m_buf.empty()) {
+        return;
+    }
+    m_sink.Write(m_buf.data(), m_buf.size());
+    m_buf.clear();
+}
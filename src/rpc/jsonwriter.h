@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONWRITER_H
+#define BITCOIN_RPC_JSONWRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class UniValue;
+
+//! Output of a JSONWriter is handed to the sink in chunks of about this size
+static const size_t JSONWRITER_CHUNK_SIZE = 64 * 1024;
+
+/** Destination of the output of a JSONWriter */
+class JSONWriterSink
+{
+public:
+    virtual ~JSONWriterSink() {}
+    virtual void Write(const char* data, size_t len) = 0;
+};
+
+/** Sink which appends to a string */
+class JSONStringSink : public JSONWriterSink
+{
+private:
+    std::string& m_str;
+
+public:
+    explicit JSONStringSink(std::string& str) : m_str(str) {}
+    void Write(const char* data, size_t len) override { m_str.append(data, len); }
+};
+
+/**
+ * Serializes JSON incrementally instead of building a UniValue tree and writing it out at the end, so large
+ * results only ever exist once, in their serialized form. The output is the same as UniValue::write() without
+ * indentation.
+ *
+ * Callers are responsible for producing well formed JSON: every Begin*() needs its End*() and every value
+ * inside of an object needs a Key() in front of it. Values which are already available as UniValue, e.g.
+ * the entries of a list, can be written with Value(const UniValue&).
+ */
+class JSONWriter
+{
+private:
+    JSONWriterSink& m_sink;
+    std::string m_buf;
+    //! for every open object or array, whether anything was written into it yet
+    std::vector<bool> m_nonempty;
+    //! whether the next value belongs to a key which was just written
+    bool m_after_key{false};
+
+    void BeginValue();
+    void WriteEscaped(const char* str, size_t len);
+    void MaybeFlush() { if (m_buf.size() >= JSONWRITER_CHUNK_SIZE) Flush(); }
+
+public:
+    explicit JSONWriter(JSONWriterSink& sink);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    void Key(const std::string& key);
+
+    void Null();
+    void Value(const std::string& val);
+    void Value(const char* val);
+    void Value(bool val);
+    void Value(int val) { Value((int64_t)val); }
+    void Value(unsigned int val) { Value((uint64_t)val); }
+    void Value(int64_t val);
+    void Value(uint64_t val);
+    void Value(double val);
+    void Value(const UniValue& val);
+
+    template<typename T>
+    void KV(const std::string& key, const T& val)
+    {
+        Key(key);
+        Value(val);
+    }
+
+    /** Hand everything written so far to the sink */
+    void Flush();
+};
+
+#endif // BITCOIN_RPC_JSONWRITER_H
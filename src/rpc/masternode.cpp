@@ -129,8 +129,13 @@ UniValue masternode_count(const JSONRPCRequest& request)
 
 UniValue GetNextMasternodeForPayment(int heightShift)
 {
-    auto mnList = deterministicMNManager->GetListAtChainTip();
-    auto payees = mnList.GetProjectedMNPayees(heightShift);
+    const CBlockIndex* pindexTip{nullptr};
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+        if (!pindexTip) return "unknown";
+    }
+    auto payees = CMasternodePayments::GetProjectedPayees(pindexTip, heightShift);
     if (payees.empty())
         return "unknown";
     auto payee = payees.back();
@@ -141,7 +146,7 @@ UniValue GetNextMasternodeForPayment(int heightShift)
 
     UniValue obj(UniValue::VOBJ);
 
-    obj.pushKV("height",        mnList.GetHeight() + heightShift);
+    obj.pushKV("height",        pindexTip->nHeight + heightShift);
     obj.pushKV("IP:port",       payee->pdmnState->addr.ToString());
     obj.pushKV("proTxHash",     payee->proTxHash.ToString());
     obj.pushKV("outpoint",      payee->collateralOutpoint.ToStringShort());
@@ -339,13 +344,14 @@ UniValue masternode_winners(const JSONRPCRequest& request)
     int nStartHeight = std::max(nChainTipHeight - nCount, 1);
 
     for (int h = nStartHeight; h <= nChainTipHeight; h++) {
-        auto payee = deterministicMNManager->GetListForBlock(pindexTip->GetAncestor(h - 1)).GetMNPayee();
-        std::string strPayments = GetRequiredPaymentsString(h, payee);
+        CBlockPayee payee;
+        CMasternodePayments::GetBlockPayee(pindexTip->GetAncestor(h - 1), payee);
+        std::string strPayments = GetRequiredPaymentsString(h, payee.dmnPayee);
         if (strFilter != "" && strPayments.find(strFilter) == std::string::npos) continue;
         obj.pushKV(strprintf("%d", h), strPayments);
     }
 
-    auto projection = deterministicMNManager->GetListForBlock(pindexTip).GetProjectedMNPayees(20);
+    auto projection = CMasternodePayments::GetProjectedPayees(pindexTip, 20);
     for (size_t i = 0; i < projection.size(); i++) {
         int h = nChainTipHeight + 1 + i;
         std::string strPayments = GetRequiredPaymentsString(h, projection[i]);
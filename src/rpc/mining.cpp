@@ -136,14 +136,10 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (pblock->nNonce == nInnerLoopCount) {
+        if (!SolveBlockHeader(*pblock, Params().GetConsensus(), nInnerLoopCount, nMaxTries)) {
+            if (nMaxTries == 0) {
+                break;
+            }
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -515,6 +511,12 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
                     checktxtime += std::chrono::seconds(10);
                 }
             }
+            hashWatchedChain = g_best_block;
+        }
+        // A new tip: the parts of the template which only depend on it are prepared by the validation interface
+        // thread right now, don't compete with it for cs_main.
+        if (IsRPCRunning()) {
+            WaitForBlockTemplateComponents(hashWatchedChain, std::chrono::milliseconds(500));
         }
         ENTER_CRITICAL_SECTION(cs_main);
 
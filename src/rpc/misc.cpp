@@ -14,6 +14,7 @@
 #include <key_io.h>
 #include <net.h>
 #include <netbase.h>
+#include <profiler.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
@@ -22,6 +23,7 @@
 #include <util.h>
 #include <utilstrencodings.h>
 #include <validation.h>
+#include <validationinterface.h>
 #ifdef ENABLE_WALLET
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
@@ -29,6 +31,18 @@
 #endif
 #include <warnings.h>
 
+#include <coinjoin/coinjoin.h>
+#include <coinjoin/coinjoin-server.h>
+#ifdef ENABLE_WALLET
+#include <coinjoin/coinjoin-client.h>
+#endif
+#include <coins.h>
+#include <evo/deterministicmns.h>
+#include <governance/governance.h>
+#include <llmq/quorums.h>
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_signing_shares.h>
+#include <masternode/masternode-meta.h>
 #include <masternode/masternode-sync.h>
 #include <spork.h>
 
@@ -529,6 +543,105 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Returns the page size requested by an address index call, 0 if the results are not paginated */
+static size_t getLimitFromParams(const UniValue& params)
+{
+    if (!params[0].isObject()) {
+        return 0;
+    }
+    const UniValue& limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNull()) {
+        return 0;
+    }
+    int64_t nLimit = limitValue.get_int64();
+    if (nLimit <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be greater than 0");
+    }
+    return (size_t)nLimit;
+}
+
+/** Cursors are the hex encoded index key of the first entry of the next page */
+template <typename Key>
+static bool getCursorFromParams(const UniValue& params, Key& key)
+{
+    if (!params[0].isObject()) {
+        return false;
+    }
+    const UniValue& cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (cursorValue.isNull()) {
+        return false;
+    }
+    if (!cursorValue.isStr() || !IsHex(cursorValue.get_str())) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor must be a hex string");
+    }
+    std::vector<unsigned char> data(ParseHex(cursorValue.get_str()));
+    CDataStream ssKey(data, SER_DISK, CLIENT_VERSION);
+    try {
+        ssKey >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    return true;
+}
+
+template <typename Key>
+static std::string getCursorString(const Key& key)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << key;
+    return HexStr(ssKey.begin(), ssKey.end());
+}
+
+/** Returns the position of the address a cursor continues from */
+template <typename Key>
+static size_t getCursorAddressPos(const std::vector<std::pair<uint160, int> >& addresses, const Key& key)
+{
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (addresses[i].first == key.hashBytes && addresses[i].second == (int)key.type) {
+            return i;
+        }
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to any of the addresses");
+}
+
+static UniValue unspentToJSON(const CAddressUnspentKey& key, const CAddressUnspentValue& value)
+{
+    std::string address;
+    if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue output(UniValue::VOBJ);
+    output.pushKV("address", address);
+    output.pushKV("txid", key.txhash.GetHex());
+    output.pushKV("outputIndex", (int)key.index);
+    output.pushKV("script", HexStr(value.script.begin(), value.script.end()));
+    output.pushKV("satoshis", value.satoshis);
+    output.pushKV("height", value.blockHeight);
+    return output;
+}
+
+static UniValue deltaToJSON(const CAddressIndexKey& key, CAmount amount)
+{
+    std::string address;
+    if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.pushKV("satoshis", amount);
+    delta.pushKV("txid", key.txhash.GetHex());
+    delta.pushKV("index", (int)key.index);
+    delta.pushKV("blockindex", (int)key.txindex);
+    delta.pushKV("height", key.blockHeight);
+    delta.pushKV("address", address);
+    return delta;
+}
+
+static const std::string addressPageHelp =
+    "  \"limit\" (number, optional) Return at most this many entries, sorted by the index key instead of height\n"
+    "  \"cursor\" (string, optional) The cursor returned by the previous page\n";
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -613,6 +726,7 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            + addressPageHelp +
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -625,8 +739,14 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"utxos\": [...],  (array) The outputs as above\n"
+            "  \"cursor\": \"hex\"  (string) The cursor of the next page, null if this is the last one\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -636,34 +756,54 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    size_t nLimit = getLimitFromParams(request.params);
+    CAddressUnspentKey cursorKey;
+    bool fCursor = getCursorFromParams(request.params, cursorKey);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (nLimit == 0 && !fCursor) {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-    }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
 
-    UniValue result(UniValue::VARR);
+        UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
-        UniValue output(UniValue::VOBJ);
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
+            result.push_back(unspentToJSON(it->first, it->second));
         }
 
-        output.pushKV("address", address);
-        output.pushKV("txid", it->first.txhash.GetHex());
-        output.pushKV("outputIndex", (int)it->first.index);
-        output.pushKV("script", HexStr(it->second.script.begin(), it->second.script.end()));
-        output.pushKV("satoshis", it->second.satoshis);
-        output.pushKV("height", it->second.blockHeight);
-        result.push_back(output);
+        return result;
     }
 
+    // Paginated results are built straight from the index iterator, so only one page is ever held in memory
+    UniValue utxos(UniValue::VARR);
+    UniValue nextCursor(UniValue::VNULL);
+    auto fn = [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        if (nLimit != 0 && utxos.size() == nLimit) {
+            nextCursor = getCursorString(key);
+            return false;
+        }
+        utxos.push_back(unspentToJSON(key, value));
+        return true;
+    };
+
+    size_t nFirst = fCursor ? getCursorAddressPos(addresses, cursorKey) : 0;
+    for (size_t i = nFirst; i < addresses.size() && nextCursor.isNull(); i++) {
+        const CAddressUnspentKey* pstart = (fCursor && i == nFirst) ? &cursorKey : nullptr;
+        if (!GetAddressUnspent(addresses[i].first, addresses[i].second, pstart, fn)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("utxos", utxos);
+    result.pushKV("cursor", nextCursor);
+
     return result;
 }
 
@@ -682,6 +822,7 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            + addressPageHelp +
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -694,6 +835,11 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"deltas\": [...],  (array) The deltas as above\n"
+            "  \"cursor\": \"hex\"  (string) The cursor of the next page, null if this is the last one\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -720,38 +866,42 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (start <= 0 || end <= 0) {
+        // a height range is only applied when both ends are given
+        start = end = 0;
     }
 
-    UniValue result(UniValue::VARR);
+    size_t nLimit = getLimitFromParams(request.params);
+    CAddressIndexKey cursorKey;
+    bool fCursor = getCursorFromParams(request.params, cursorKey);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    UniValue deltas(UniValue::VARR);
+    UniValue nextCursor(UniValue::VNULL);
+    auto fn = [&](const CAddressIndexKey& key, CAmount amount) {
+        if (nLimit != 0 && deltas.size() == nLimit) {
+            nextCursor = getCursorString(key);
+            return false;
+        }
+        deltas.push_back(deltaToJSON(key, amount));
+        return true;
+    };
+
+    size_t nFirst = fCursor ? getCursorAddressPos(addresses, cursorKey) : 0;
+    for (size_t i = nFirst; i < addresses.size() && nextCursor.isNull(); i++) {
+        const CAddressIndexKey* pstart = (fCursor && i == nFirst) ? &cursorKey : nullptr;
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, pstart, start, end, fn)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+    }
 
-        UniValue delta(UniValue::VOBJ);
-        delta.pushKV("satoshis", it->second);
-        delta.pushKV("txid", it->first.txhash.GetHex());
-        delta.pushKV("index", (int)it->first.index);
-        delta.pushKV("blockindex", (int)it->first.txindex);
-        delta.pushKV("height", it->first.blockHeight);
-        delta.pushKV("address", address);
-        result.push_back(delta);
+    if (nLimit == 0 && !fCursor) {
+        return deltas;
     }
 
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("deltas", deltas);
+    result.pushKV("cursor", nextCursor);
+
     return result;
 }
 
@@ -761,6 +911,7 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw std::runtime_error(
             "getaddressbalance\n"
             "\nReturns the balance for an address(es) (requires addressindex to be enabled).\n"
+            "With -addressbalanceindex the totals are read from the balance index instead of the address history.\n"
             "\nArguments:\n"
             "{\n"
             "  \"addresses\"\n"
@@ -787,35 +938,61 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
-    int nHeight;
-    {
-        LOCK(cs_main);
-        nHeight = chainActive.Height();
-    }
-
     CAmount balance = 0;
     CAmount balance_spendable = 0;
     CAmount balance_immature = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    if (fAddressBalanceIndex) {
+        // Totals come from the balance index, only the deltas of the last COINBASE_MATURITY blocks have to be
+        // scanned for immature coinbase outputs. cs_main keeps both consistent with the same tip.
+        LOCK(cs_main);
+        int nHeight = chainActive.Height();
+        int nStart = std::max(1, nHeight - COINBASE_MATURITY + 1);
+
+        auto fn = [&](const CAddressIndexKey& key, CAmount amount) {
+            if (key.txindex == 0) {
+                balance_immature += amount;
+            }
+            return true;
+        };
+
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            CAddressBalanceValue value;
+            if (!GetAddressBalance((*it).first, (*it).second, value) ||
+                !GetAddressIndex((*it).first, (*it).second, nullptr, nStart, nHeight, fn)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+            balance += value.balance;
+            received += value.received;
         }
-        if (it->first.txindex == 0 && nHeight - it->first.blockHeight < COINBASE_MATURITY) {
-            balance_immature += it->second;
-        } else {
-            balance_spendable += it->second;
+        balance_spendable = balance - balance_immature;
+    } else {
+        int nHeight;
+        {
+            LOCK(cs_main);
+            nHeight = chainActive.Height();
+        }
+
+        // Sum up the deltas while iterating the index instead of loading all of them first
+        auto fn = [&](const CAddressIndexKey& key, CAmount amount) {
+            if (amount > 0) {
+                received += amount;
+            }
+            if (key.txindex == 0 && nHeight - key.blockHeight < COINBASE_MATURITY) {
+                balance_immature += amount;
+            } else {
+                balance_spendable += amount;
+            }
+            balance += amount;
+            return true;
+        };
+
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressIndex((*it).first, (*it).second, nullptr, 0, 0, fn)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-        balance += it->second;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -843,12 +1020,18 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            + addressPageHelp +
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit or cursor):\n"
+            "{\n"
+            "  \"txids\": [...],  (array) The txids of each address in index order, a txid can repeat for multiple addresses\n"
+            "  \"cursor\": \"hex\"  (string) The cursor of the next page, null if this is the last one\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -871,6 +1054,49 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
+    if (start <= 0 || end <= 0) {
+        // a height range is only applied when both ends are given
+        start = end = 0;
+    }
+
+    size_t nLimit = getLimitFromParams(request.params);
+    CAddressIndexKey cursorKey;
+    bool fCursor = getCursorFromParams(request.params, cursorKey);
+
+    if (nLimit != 0 || fCursor) {
+        UniValue txids(UniValue::VARR);
+        UniValue nextCursor(UniValue::VNULL);
+        uint256 lastTxHash;
+        auto fn = [&](const CAddressIndexKey& key, CAmount) {
+            // All deltas of a transaction are next to each other, never split them over two pages
+            if (key.txhash == lastTxHash) {
+                return true;
+            }
+            if (nLimit != 0 && txids.size() == nLimit) {
+                nextCursor = getCursorString(key);
+                return false;
+            }
+            lastTxHash = key.txhash;
+            txids.push_back(key.txhash.GetHex());
+            return true;
+        };
+
+        size_t nFirst = fCursor ? getCursorAddressPos(addresses, cursorKey) : 0;
+        for (size_t i = nFirst; i < addresses.size() && nextCursor.isNull(); i++) {
+            const CAddressIndexKey* pstart = (fCursor && i == nFirst) ? &cursorKey : nullptr;
+            lastTxHash.SetNull();
+            if (!GetAddressIndex(addresses[i].first, addresses[i].second, pstart, start, end, fn)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("txids", txids);
+        result.pushKV("cursor", nextCursor);
+
+        return result;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -911,51 +1137,96 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
 
 }
 
+static CSpentIndexKey ParseSpentIndexKey(const UniValue& obj)
+{
+    if (!obj.isObject()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an object with txid and index");
+    }
+    UniValue txidValue = find_value(obj.get_obj(), "txid");
+    UniValue indexValue = find_value(obj.get_obj(), "index");
+
+    if (!txidValue.isStr() || !indexValue.isNum()) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid txid or index");
+    }
+
+    uint256 txid = ParseHashV(txidValue, "txid");
+    int outputIndex = indexValue.get_int();
+
+    return CSpentIndexKey(txid, outputIndex);
+}
+
+static UniValue SpentIndexValueToJSON(const CSpentIndexValue& value)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("txid", value.txid.GetHex());
+    obj.pushKV("index", (int)value.inputIndex);
+    obj.pushKV("height", value.blockHeight);
+    return obj;
+}
+
 UniValue getspentinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
+    if (request.fHelp || request.params.size() != 1 || !(request.params[0].isObject() || request.params[0].isArray()))
         throw std::runtime_error(
             "getspentinfo\n"
             "\nReturns the txid and index where an output is spent.\n"
+            "Multiple outputs can be passed as an array, which are looked up together. This is much faster than one\n"
+            "call per output, e.g. for all outputs of a transaction.\n"
             "\nArguments:\n"
             "{\n"
             "  \"txid\" (string) The hex string of the txid\n"
             "  \"index\" (number) The start block height\n"
             "}\n"
+            "or\n"
+            "[\n"
+            "  {\"txid\": \"txid\", \"index\": n},  (object) An output as above\n"
+            "  ,...\n"
+            "]\n"
             "\nResult:\n"
             "{\n"
             "  \"txid\"  (string) The transaction id\n"
             "  \"index\"  (number) The spending input index\n"
             "  ,...\n"
             "}\n"
+            "\nResult (for an array):\n"
+            "[\n"
+            "  {...},  (object) The result for the output at the same position as above, null if it's not spent\n"
+            "  ,...\n"
+            "]\n"
             "\nExamples:\n"
             + HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'")
+            + HelpExampleCli("getspentinfo", "'[{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}, {\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 1}]'")
             + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
         );
 
-    UniValue txidValue = find_value(request.params[0].get_obj(), "txid");
-    UniValue indexValue = find_value(request.params[0].get_obj(), "index");
+    if (request.params[0].isArray()) {
+        const UniValue& arr = request.params[0].get_array();
+        std::vector<CSpentIndexKey> keys;
+        keys.reserve(arr.size());
+        for (size_t i = 0; i < arr.size(); i++) {
+            keys.emplace_back(ParseSpentIndexKey(arr[i]));
+        }
 
-    if (!txidValue.isStr() || !indexValue.isNum()) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid txid or index");
-    }
+        std::vector<CSpentIndexValue> values;
+        if (!GetSpentIndex(keys, values)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+        }
 
-    uint256 txid = ParseHashV(txidValue, "txid");
-    int outputIndex = indexValue.get_int();
+        UniValue result(UniValue::VARR);
+        for (const auto& value : values) {
+            result.push_back(value.IsNull() ? NullUniValue : SpentIndexValueToJSON(value));
+        }
+        return result;
+    }
 
-    CSpentIndexKey key(txid, outputIndex);
+    CSpentIndexKey key = ParseSpentIndexKey(request.params[0]);
     CSpentIndexValue value;
 
     if (!GetSpentIndex(key, value)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
     }
 
-    UniValue obj(UniValue::VOBJ);
-    obj.pushKV("txid", value.txid.GetHex());
-    obj.pushKV("index", (int)value.inputIndex);
-    obj.pushKV("height", value.blockHeight);
-
-    return obj;
+    return SpentIndexValueToJSON(value);
 }
 
 static UniValue RPCLockedMemoryInfo()
@@ -990,6 +1261,41 @@ static std::string RPCMallocInfo()
 }
 #endif
 
+static UniValue RPCDetailedMemoryInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    size_t nTotal = 0;
+    auto push = [&](const std::string& name, size_t usage) {
+        obj.pushKV(name, (uint64_t)usage);
+        nTotal += usage;
+    };
+
+    push("mempool", mempool.DynamicMemoryUsage());
+    {
+        LOCK(cs_main);
+        push("coinstip", pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0);
+        push("blockindex", mapBlockIndex.DynamicMemoryUsage());
+    }
+    push("mnlists", deterministicMNManager ? deterministicMNManager->GetMemoryUsage() : 0);
+    push("quorums", llmq::quorumManager ? llmq::quorumManager->GetMemoryUsage() : 0);
+    push("governance", governance.GetMemoryUsage());
+    push("instantsend", llmq::quorumInstantSendManager ? llmq::quorumInstantSendManager->GetMemoryUsage() : 0);
+    push("sigshares", llmq::quorumSigSharesManager ? llmq::quorumSigSharesManager->GetMemoryUsage().Total() : 0);
+    push("mnmeta", mmetaman.GetMemoryUsage());
+
+    size_t nCoinJoinUsage = CCoinJoin::GetDSTXMemoryUsage() + coinJoinServer.GetQueueMemoryUsage() + coinJoinServer.GetEntriesMemoryUsage();
+#ifdef ENABLE_WALLET
+    nCoinJoinUsage += coinJoinClientQueueManager.GetQueueMemoryUsage();
+    for (const auto& p : coinJoinClientManagers) {
+        nCoinJoinUsage += p.second->GetMemoryUsage();
+    }
+#endif
+    push("coinjoin", nCoinJoinUsage);
+
+    obj.pushKV("total", (uint64_t)nTotal);
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -1002,6 +1308,7 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "\nArguments:\n"
             "1. \"mode\"     (string, optional, default: \"stats\") Determines what kind of information is returned.\n"
             "  - \"stats\" returns general statistics about memory usage in the daemon.\n"
+            "  - \"detailed\" returns the general statistics plus the memory used by the main data structures of the daemon.\n"
             "  - \"mallocinfo\" returns an XML string describing low-level heap state (only available if compiled with glibc 2.10+).\n"
             "\nResult (mode \"stats\"):\n"
             "{\n"
@@ -1012,6 +1319,28 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"validationqueues\": {     (json object) Number of notifications waiting in the validation interface queues\n"
+            "    \"name\": xxxxx,          (numeric) Number of notifications waiting in the queue \"name\" (\"main\" for the main queue)\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nResult (mode \"detailed\"):\n"
+            "{\n"
+            "  \"locked\": { ... },          (json object) Same as in mode \"stats\"\n"
+            "  \"validationqueues\": { ... }, (json object) Same as in mode \"stats\"\n"
+            "  \"detailed\": {               (json object) Estimated dynamic memory usage in bytes\n"
+            "    \"mempool\": xxxxx,         (numeric) Transactions in the mempool and their indexes\n"
+            "    \"coinstip\": xxxxx,        (numeric) Coins cache\n"
+            "    \"blockindex\": xxxxx,      (numeric) Block index\n"
+            "    \"mnlists\": xxxxx,         (numeric) Cached deterministic masternode lists and diffs\n"
+            "    \"quorums\": xxxxx,         (numeric) Cached LLMQ quorums\n"
+            "    \"governance\": xxxxx,      (numeric) Governance objects, votes and vote caches\n"
+            "    \"instantsend\": xxxxx,     (numeric) Pending and in-progress islocks, islock caches and index\n"
+            "    \"sigshares\": xxxxx,       (numeric) LLMQ signing sessions and sig shares\n"
+            "    \"mnmeta\": xxxxx,          (numeric) Masternode meta information\n"
+            "    \"coinjoin\": xxxxx,        (numeric) CoinJoin queues, sessions and broadcast transactions\n"
+            "    \"total\": xxxxx            (numeric) Sum of the above\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -1022,9 +1351,17 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
         );
 
     std::string mode = request.params[0].isNull() ? "stats" : request.params[0].get_str();
-    if (mode == "stats") {
+    if (mode == "stats" || mode == "detailed") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        UniValue queues(UniValue::VOBJ);
+        for (const auto& it : GetMainSignals().GetQueueDepths()) {
+            queues.pushKV(it.first, (uint64_t)it.second);
+        }
+        obj.pushKV("validationqueues", queues);
+        if (mode == "detailed") {
+            obj.pushKV("detailed", RPCDetailedMemoryInfo());
+        }
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -1037,6 +1374,180 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue LockTimeHistogramToJSON(const std::vector<uint64_t>& vHistogram)
+{
+    UniValue histogram(UniValue::VARR);
+    for (uint64_t nCount : vHistogram) {
+        histogram.push_back(nCount);
+    }
+    return histogram;
+}
+
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "getlockstats ( count reset )\n"
+            "Returns lock contention statistics of the LOCK sites in the daemon, sorted by total wait time.\n"
+            "Every contended acquisition of a lock is counted, the hold time is sampled on one in " + std::to_string(LOCK_STATS_SAMPLE_RATE) + " acquisitions.\n"
+            "All times are in microseconds. Entry 0 of a histogram counts the durations below 1us, entry i those\n"
+            "below 2^i us and the last entry all longer ones.\n"
+            "\nArguments:\n"
+            "1. count     (numeric, optional, default=20) Return the count sites with the most wait time, 0 returns all of them\n"
+            "2. reset     (boolean, optional, default=false) Reset the statistics after returning them\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",         (string) The name of the lock\n"
+            "    \"file\": \"xxxx\",         (string) The source file of the site\n"
+            "    \"line\": n,              (numeric) The source line of the site\n"
+            "    \"contentions\": n,       (numeric) Number of acquisitions which had to wait\n"
+            "    \"wait_total\": n,        (numeric) Total time spent waiting\n"
+            "    \"wait_max\": n,          (numeric) Longest wait\n"
+            "    \"wait_histogram\": [...], (array of numeric) Histogram of the wait times\n"
+            "    \"hold_samples\": n,      (numeric) Number of sampled acquisitions\n"
+            "    \"hold_total\": n,        (numeric) Total hold time of the sampled acquisitions\n"
+            "    \"hold_max\": n,          (numeric) Longest sampled hold time\n"
+            "    \"hold_histogram\": [...], (array of numeric) Histogram of the sampled hold times\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "0 true")
+            + HelpExampleRpc("getlockstats", "10")
+        );
+
+    int nCount = request.params[0].isNull() ? 20 : request.params[0].get_int();
+    if (nCount < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must not be negative");
+    }
+    bool fReset = request.params[1].isNull() ? false : request.params[1].get_bool();
+
+    std::vector<LockStats> vStats = GetLockStats();
+    if (fReset) {
+        ResetLockStats();
+    }
+    if (nCount > 0 && vStats.size() > (size_t)nCount) {
+        vStats.resize(nCount);
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const LockStats& stats : vStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", stats.strName);
+        obj.pushKV("file", stats.strFile);
+        obj.pushKV("line", stats.nLine);
+        obj.pushKV("contentions", stats.nContentions);
+        obj.pushKV("wait_total", stats.nWaitTime);
+        obj.pushKV("wait_max", stats.nMaxWaitTime);
+        obj.pushKV("wait_histogram", LockTimeHistogramToJSON(stats.vWaitHistogram));
+        obj.pushKV("hold_samples", stats.nHoldSamples);
+        obj.pushKV("hold_total", stats.nHoldTime);
+        obj.pushKV("hold_max", stats.nMaxHoldTime);
+        obj.pushKV("hold_histogram", LockTimeHistogramToJSON(stats.vHoldHistogram));
+        result.push_back(obj);
+    }
+    return result;
+}
+
+UniValue getprofile(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "getprofile ( \"format\" reset )\n"
+            "Returns the CPU time used by every thread of the daemon and, when started with -profiler, the stacks sampled\n"
+            "from the running threads since the start or the last reset, most sampled first.\n"
+            "All times are in microseconds. Only supported on Linux, stack sampling needs a build with --enable-stacktraces.\n"
+            "\nArguments:\n"
+            "1. \"format\"  (string, optional, default=\"json\") \"json\" or \"folded\". \"folded\" returns only the stacks, as one\n"
+            "             \"thread;outer;...;inner count\" line per stack, as used by flamegraph.pl, speedscope and pprof converters\n"
+            "2. reset     (boolean, optional, default=false) Reset the sampled stacks after returning them\n"
+            "\nResult (format \"json\"):\n"
+            "{\n"
+            "  \"sampling\": true|false,   (boolean) Whether stacks are being sampled\n"
+            "  \"frequency\": n,           (numeric) Samples per second of every running thread\n"
+            "  \"samples\": n,             (numeric) Number of stacks sampled\n"
+            "  \"threads\": [              (array of json objects) All threads, by CPU time used\n"
+            "    {\n"
+            "      \"id\": n,              (numeric) The thread id\n"
+            "      \"name\": \"xxxx\",       (string) The thread name\n"
+            "      \"user\": n,            (numeric) CPU time used in user mode\n"
+            "      \"system\": n           (numeric) CPU time used in kernel mode\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"stacks\": [               (array of json objects) The sampled stacks\n"
+            "    {\n"
+            "      \"thread\": \"xxxx\",     (string) The name of the thread the stack was sampled from\n"
+            "      \"frames\": [...],      (array of string) The functions of the stack, outermost first\n"
+            "      \"count\": n            (numeric) How often the stack was sampled\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nResult (format \"folded\"):\n"
+            "\"thread;outer;...;inner count\\n...\"\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getprofile", "")
+            + HelpExampleCli("getprofile", "\"folded\" true")
+            + HelpExampleRpc("getprofile", "\"folded\"")
+        );
+
+    std::string strFormat = request.params[0].isNull() ? "json" : request.params[0].get_str();
+    if (strFormat != "json" && strFormat != "folded") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "format must be \"json\" or \"folded\"");
+    }
+    bool fReset = request.params[1].isNull() ? false : request.params[1].get_bool();
+
+    std::vector<CThreadCPUUsage> vUsage;
+    if (!GetThreadCPUUsage(vUsage)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Profiling is not supported on this platform");
+    }
+
+    uint64_t nSamples;
+    std::vector<CProfileStack> vStacks = GetProfileStacks(fReset, nSamples);
+    std::sort(vStacks.begin(), vStacks.end(), [](const CProfileStack& a, const CProfileStack& b) {
+        return a.nCount > b.nCount;
+    });
+    if (strFormat == "folded") {
+        return FormatFoldedStacks(vStacks);
+    }
+
+    std::sort(vUsage.begin(), vUsage.end(), [](const CThreadCPUUsage& a, const CThreadCPUUsage& b) {
+        return a.nUserMicros + a.nSystemMicros > b.nUserMicros + b.nSystemMicros;
+    });
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("sampling", IsProfilerRunning());
+    result.pushKV("frequency", GetProfilerFrequency());
+    result.pushKV("samples", nSamples);
+    UniValue threads(UniValue::VARR);
+    for (const auto& usage : vUsage) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("id", usage.nThreadId);
+        obj.pushKV("name", usage.strName);
+        obj.pushKV("user", usage.nUserMicros);
+        obj.pushKV("system", usage.nSystemMicros);
+        threads.push_back(obj);
+    }
+    result.pushKV("threads", threads);
+    UniValue stacks(UniValue::VARR);
+    for (const auto& stack : vStacks) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("thread", stack.strThreadName);
+        UniValue frames(UniValue::VARR);
+        for (const auto& strFrame : stack.vFrames) {
+            frames.push_back(strFrame);
+        }
+        obj.pushKV("frames", frames);
+        obj.pushKV("count", stack.nCount);
+        stacks.push_back(obj);
+    }
+    result.pushKV("stacks", stacks);
+    return result;
+}
+
 uint64_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint64_t mask = 0;
@@ -1155,6 +1666,8 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "debug",                  &debug,                  {} },
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getlockstats",           &getlockstats,           {"count","reset"} },
+    { "control",            "getprofile",             &getprofile,             {"format","reset"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
@@ -66,6 +66,21 @@ UniValue ping(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue MsgProcessStatsToJSON(const mapMsgCmdProcessStats& mapStats)
+{
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& p : mapStats) {
+        if (p.second.nCount == 0)
+            continue;
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", p.second.nCount);
+        obj.pushKV("time_us", p.second.nTime);
+        obj.pushKV("cputime_us", p.second.nCPUTime);
+        ret.pushKV(p.first, obj);
+    }
+    return ret;
+}
+
 UniValue getpeerinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -109,14 +124,36 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"inflight_limit\": n,       (numeric) How many blocks we're willing to ask from this peer at once during parallel block download\n"
+            "    \"block_delivery_time\": n,  (numeric) Smoothed time in seconds this peer needs to deliver one more block, 0 if unknown\n"
+            "    \"orphans\": n,              (numeric) The number of orphan transactions from this peer we hold\n"
+            "    \"orphans_bytes\": n,        (numeric) The total size of the orphan transactions from this peer we hold\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
+            "    \"addr_processed\": n,      (numeric) The total number of addresses received from this peer and processed\n"
+            "    \"addr_rate_limited\": n,   (numeric) The total number of addresses received from this peer and dropped due to rate limiting\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes sent aggregated by message type\n"
             "       ...\n"
             "    },\n"
+            "    \"bytessent_per_priority\": {\n"
+            "       \"critical\": n,          (numeric) The total bytes sent since the connection was opened, aggregated by send priority (critical, blocks, normal, bulk)\n"
+            "       ...\n"
+            "    },\n"
+            "    \"bytesqueued_per_priority\": {\n"
+            "       \"critical\": n,          (numeric) The bytes currently queued and waiting to be sent, aggregated by send priority\n"
+            "       ...\n"
+            "    },\n"
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"processtime_per_msg\": {\n"
+            "       \"addr\": {             (json object) Processing stats of the messages of a type received from this peer\n"
+            "         \"count\": n,         (numeric) Number of processed messages\n"
+            "         \"time_us\": n,       (numeric) Total processing time in microseconds\n"
+            "         \"cputime_us\": n     (numeric) Total CPU time of the message handler thread in microseconds, 0 if unsupported\n"
+            "       },\n"
+            "       ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -182,8 +219,14 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("inflight_limit", statestats.nBlocksInTransitLimit);
+            obj.pushKV("block_delivery_time", ((double)statestats.nBlockDeliveryInterval) / 1e6);
+            obj.pushKV("orphans", (uint64_t)statestats.nOrphans);
+            obj.pushKV("orphans_bytes", (uint64_t)statestats.nOrphansSize);
         }
         obj.pushKV("whitelisted", stats.fWhitelisted);
+        obj.pushKV("addr_processed", stats.nAddrProcessed);
+        obj.pushKV("addr_rate_limited", stats.nAddrRateLimited);
 
         UniValue sendPerMsgCmd(UniValue::VOBJ);
         for (const mapMsgCmdSize::value_type &i : stats.mapSendBytesPerMsgCmd) {
@@ -192,12 +235,25 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("bytessent_per_msg", sendPerMsgCmd);
 
+        UniValue sendPerPriority(UniValue::VOBJ);
+        for (int i = 0; i < NUM_SEND_PRIORITIES; i++) {
+            sendPerPriority.pushKV(SendPriorityToString(i), stats.arrSendBytesPerPriority[i]);
+        }
+        obj.pushKV("bytessent_per_priority", sendPerPriority);
+
+        UniValue queuedPerPriority(UniValue::VOBJ);
+        for (int i = 0; i < NUM_SEND_PRIORITIES; i++) {
+            queuedPerPriority.pushKV(SendPriorityToString(i), (uint64_t)stats.arrSendQueueSize[i]);
+        }
+        obj.pushKV("bytesqueued_per_priority", queuedPerPriority);
+
         UniValue recvPerMsgCmd(UniValue::VOBJ);
         for (const mapMsgCmdSize::value_type &i : stats.mapRecvBytesPerMsgCmd) {
             if (i.second > 0)
                 recvPerMsgCmd.pushKV(i.first, i.second);
         }
         obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
+        obj.pushKV("processtime_per_msg", MsgProcessStatsToJSON(stats.mapProcessStatsPerMsgCmd));
 
         ret.push_back(obj);
     }
@@ -374,6 +430,8 @@ UniValue getnettotals(const JSONRPCRequest& request)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
+            "  \"totalsendcalls\": n,   (numeric) Total number of send syscalls, each of them may send multiple messages\n"
+            "  \"avgbytespersendcall\": n, (numeric) Average number of bytes sent per send syscall\n"
             "  \"timemillis\": t,       (numeric) Current UNIX time in milliseconds\n"
             "  \"uploadtarget\":\n"
             "  {\n"
@@ -383,6 +441,14 @@ UniValue getnettotals(const JSONRPCRequest& request)
             "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
             "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"processtime_per_msg\": {       (json object) Processing stats by message type, including disconnected peers\n"
+            "    \"addr\": {\n"
+            "      \"count\": n,                 (numeric) Number of processed messages\n"
+            "      \"time_us\": n,               (numeric) Total processing time in microseconds\n"
+            "      \"cputime_us\": n             (numeric) Total CPU time of the message handler thread in microseconds, 0 if unsupported\n"
+            "    },\n"
+            "    ...\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -394,7 +460,11 @@ UniValue getnettotals(const JSONRPCRequest& request)
 
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("totalbytesrecv", g_connman->GetTotalBytesRecv());
-    obj.pushKV("totalbytessent", g_connman->GetTotalBytesSent());
+    const uint64_t nTotalBytesSent = g_connman->GetTotalBytesSent();
+    const uint64_t nTotalSendCalls = g_connman->GetTotalSendCalls();
+    obj.pushKV("totalbytessent", nTotalBytesSent);
+    obj.pushKV("totalsendcalls", nTotalSendCalls);
+    obj.pushKV("avgbytespersendcall", nTotalSendCalls ? (double)nTotalBytesSent / nTotalSendCalls : 0.0);
     obj.pushKV("timemillis", GetTimeMillis());
 
     UniValue outboundLimit(UniValue::VOBJ);
@@ -405,6 +475,7 @@ UniValue getnettotals(const JSONRPCRequest& request)
     outboundLimit.pushKV("bytes_left_in_cycle", g_connman->GetOutboundTargetBytesLeft());
     outboundLimit.pushKV("time_left_in_cycle", g_connman->GetMaxOutboundTimeLeftInCycle());
     obj.pushKV("uploadtarget", outboundLimit);
+    obj.pushKV("processtime_per_msg", MsgProcessStatsToJSON(g_connman->GetTotalMsgProcessStats()));
     return obj;
 }
 
@@ -467,6 +538,16 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
             "  }\n"
             "  ,...\n"
             "  ]\n"
+            "  \"compactblocks\": {                    (json object) reconstruction statistics of compact blocks we requested\n"
+            "    \"blocks\": n,                         (numeric) number of compact blocks we tried to reconstruct\n"
+            "    \"blocks_without_roundtrip\": n,       (numeric) number of compact blocks reconstructed without asking for missing transactions\n"
+            "    \"blocks_fallback\": n,                (numeric) number of compact blocks for which the full block had to be downloaded\n"
+            "    \"tx_prefilled\": n,                   (numeric) number of transactions prefilled by the sender\n"
+            "    \"tx_mempool\": n,                     (numeric) number of transactions found in the mempool\n"
+            "    \"tx_extra\": n,                       (numeric) number of transactions found in the orphan, rejected and recently removed transactions\n"
+            "    \"tx_islock\": n,                      (numeric) number of InstantSend locked transactions found outside of the mempool\n"
+            "    \"tx_requested\": n,                   (numeric) number of transactions that had to be requested\n"
+            "  }\n"
             "  \"warnings\": \"...\"                    (string) any network and blockchain warnings\n"
             "}\n"
             "\nExamples:\n"
@@ -522,6 +603,17 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
         }
     }
     obj.pushKV("localaddresses", localAddresses);
+    CompactBlockReconstructionStats cmpctStats = GetCompactBlockReconstructionStats();
+    UniValue cmpctObj(UniValue::VOBJ);
+    cmpctObj.pushKV("blocks", cmpctStats.nBlocks);
+    cmpctObj.pushKV("blocks_without_roundtrip", cmpctStats.nBlocksWithoutRoundTrip);
+    cmpctObj.pushKV("blocks_fallback", cmpctStats.nBlocksFallback);
+    cmpctObj.pushKV("tx_prefilled", cmpctStats.nTxPrefilled);
+    cmpctObj.pushKV("tx_mempool", cmpctStats.nTxFromMempool);
+    cmpctObj.pushKV("tx_extra", cmpctStats.nTxFromExtra);
+    cmpctObj.pushKV("tx_islock", cmpctStats.nTxFromISLock);
+    cmpctObj.pushKV("tx_requested", cmpctStats.nTxRequested);
+    obj.pushKV("compactblocks",  cmpctObj);
     obj.pushKV("warnings",       GetWarnings("statusbar"));
     return obj;
 }
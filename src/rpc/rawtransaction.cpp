@@ -19,6 +19,7 @@
 #include <primitives/transaction.h>
 #include <rpc/rawtransaction.h>
 #include <rpc/server.h>
+#include <rpc/snapshot.h>
 #include <script/script.h>
 #include <script/script_error.h>
 #include <script/sign.h>
@@ -44,7 +45,7 @@
 #include <univalue.h>
 
 
-void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
+void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry, const CRPCChainSnapshot& chain)
 {
     // Call into TxToUniv() in bitcoin-common to decode the transaction hex.
     //
@@ -54,22 +55,23 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 
     uint256 txid = tx.GetHash();
 
-    // Add spent information if spentindex is enabled
+    // Add spent information if spentindex is enabled, all inputs and outputs are looked up together
     CSpentIndexTxInfo txSpentInfo;
-    for (const auto& txin : tx.vin) {
-        if (!tx.IsCoinBase()) {
-            CSpentIndexValue spentInfo;
-            CSpentIndexKey spentKey(txin.prevout.hash, txin.prevout.n);
-            if (GetSpentIndex(spentKey, spentInfo)) {
-                txSpentInfo.mSpentInfo.emplace(spentKey, spentInfo);
-            }
+    std::vector<CSpentIndexKey> spentKeys;
+    if (!tx.IsCoinBase()) {
+        for (const auto& txin : tx.vin) {
+            spentKeys.emplace_back(txin.prevout.hash, txin.prevout.n);
         }
     }
     for (unsigned int i = 0; i < tx.vout.size(); i++) {
-        CSpentIndexValue spentInfo;
-        CSpentIndexKey spentKey(txid, i);
-        if (GetSpentIndex(spentKey, spentInfo)) {
-            txSpentInfo.mSpentInfo.emplace(spentKey, spentInfo);
+        spentKeys.emplace_back(txid, i);
+    }
+    std::vector<CSpentIndexValue> spentInfos;
+    if (GetSpentIndex(spentKeys, spentInfos)) {
+        for (size_t i = 0; i < spentKeys.size(); i++) {
+            if (!spentInfos[i].IsNull()) {
+                txSpentInfo.mSpentInfo.emplace(spentKeys[i], spentInfos[i]);
+            }
         }
     }
 
@@ -78,11 +80,15 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
     bool chainLock = false;
     if (!hashBlock.IsNull()) {
         entry.pushKV("blockhash", hashBlock.GetHex());
-        CBlockIndex* pindex = LookupBlockIndex(hashBlock);
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = LookupBlockIndex(hashBlock);
+        }
         if (pindex) {
-            if (chainActive.Contains(pindex)) {
+            if (chain.Contains(pindex)) {
                 entry.pushKV("height", pindex->nHeight);
-                entry.pushKV("confirmations", 1 + chainActive.Height() - pindex->nHeight);
+                entry.pushKV("confirmations", 1 + chain.Height() - pindex->nHeight);
                 entry.pushKV("time", pindex->GetBlockTime());
                 entry.pushKV("blocktime", pindex->GetBlockTime());
 
@@ -182,7 +188,7 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             + HelpExampleCli("getrawtransaction", "\"mytxid\" true \"myblockhash\"")
         );
 
-    LOCK(cs_main);
+    auto snapshot = GetRPCChainSnapshot(request);
 
     bool in_active_chain = true;
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
@@ -201,11 +207,14 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
 
     if (!request.params[2].isNull()) {
         uint256 blockhash = ParseHashV(request.params[2], "parameter 3");
-        blockindex = LookupBlockIndex(blockhash);
+        {
+            LOCK(cs_main);
+            blockindex = LookupBlockIndex(blockhash);
+        }
         if (!blockindex) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block hash not found");
         }
-        in_active_chain = chainActive.Contains(blockindex);
+        in_active_chain = snapshot->Contains(blockindex);
     }
 
     CTransactionRef tx;
@@ -213,6 +222,7 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
     if (!GetTransaction(hash, tx, Params().GetConsensus(), hash_block, true, blockindex)) {
         std::string errmsg;
         if (blockindex) {
+            LOCK(cs_main);
             if (!(blockindex->nStatus & BLOCK_HAVE_DATA)) {
                 throw JSONRPCError(RPC_MISC_ERROR, "Block not available");
             }
@@ -231,7 +241,7 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
 
     UniValue result(UniValue::VOBJ);
     if (blockindex) result.pushKV("in_active_chain", in_active_chain);
-    TxToJSON(*tx, hash_block, result);
+    TxToJSON(*tx, hash_block, result, *snapshot);
     return result;
 }
 
@@ -8,6 +8,7 @@
 #include <init.h>
 #include <messagesigner.h>
 #include <rpc/server.h>
+#include <rpc/snapshot.h>
 #include <txmempool.h>
 #include <utilmoneystr.h>
 #include <validation.h>
@@ -978,10 +979,6 @@ UniValue protx_list(const JSONRPCRequest& request)
         type = request.params[1].get_str();
     }
 
-    UniValue ret(UniValue::VARR);
-
-    LOCK(cs_main);
-
     if (type == "wallet") {
         if (!pwallet) {
             throw std::runtime_error("\"protx list wallet\" not supported when wallet is disabled");
@@ -1008,14 +1005,18 @@ UniValue protx_list(const JSONRPCRequest& request)
         }
 
         CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
-        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
-            if (setOutpts.count(dmn->collateralOutpoint) ||
-                CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDOwner) ||
-                CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDVoting) ||
-                CheckWalletOwnsScript(pwallet, dmn->pdmnState->scriptPayout) ||
-                CheckWalletOwnsScript(pwallet, dmn->pdmnState->scriptOperatorPayout)) {
-                ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
-            }
+        return WriteRPCResult(request, [&](JSONWriter& writer) {
+            writer.BeginArray();
+            mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+                if (setOutpts.count(dmn->collateralOutpoint) ||
+                    CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDOwner) ||
+                    CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDVoting) ||
+                    CheckWalletOwnsScript(pwallet, dmn->pdmnState->scriptPayout) ||
+                    CheckWalletOwnsScript(pwallet, dmn->pdmnState->scriptOperatorPayout)) {
+                    writer.Value(BuildDMNListEntry(pwallet, dmn, detailed));
+                }
+            });
+            writer.EndArray();
         });
 #endif
     } else if (type == "valid" || type == "registered") {
@@ -1023,25 +1024,27 @@ UniValue protx_list(const JSONRPCRequest& request)
             protx_list_help();
         }
 
-        LOCK(cs_main);
+        auto snapshot = GetRPCChainSnapshot(request);
 
         bool detailed = !request.params[2].isNull() ? ParseBoolV(request.params[2], "detailed") : false;
 
-        int height = !request.params[3].isNull() ? ParseInt32V(request.params[3], "height") : chainActive.Height();
-        if (height < 1 || height > chainActive.Height()) {
+        int height = !request.params[3].isNull() ? ParseInt32V(request.params[3], "height") : snapshot->Height();
+        if (height < 1 || height > snapshot->Height()) {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
         }
 
-        CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
+        CDeterministicMNList mnList = height == snapshot->Height() ? snapshot->mnList : deterministicMNManager->GetListForBlock((*snapshot)[height]);
         bool onlyValid = type == "valid";
-        mnList.ForEachMN(onlyValid, [&](const CDeterministicMNCPtr& dmn) {
-            ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
+        return WriteRPCResult(request, [&](JSONWriter& writer) {
+            writer.BeginArray();
+            mnList.ForEachMN(onlyValid, [&](const CDeterministicMNCPtr& dmn) {
+                writer.Value(BuildDMNListEntry(pwallet, dmn, detailed));
+            });
+            writer.EndArray();
         });
-    } else {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid type specified");
     }
 
-    return ret;
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid type specified");
 }
 
 void protx_info_help()
@@ -1073,8 +1076,7 @@ UniValue protx_info(const JSONRPCRequest& request)
 #endif
 
     uint256 proTxHash = ParseHashV(request.params[1], "proTxHash");
-    auto mnList = deterministicMNManager->GetListAtChainTip();
-    auto dmn = mnList.GetMN(proTxHash);
+    auto dmn = GetRPCChainSnapshot(request)->mnList.GetMN(proTxHash);
     if (!dmn) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s not found", proTxHash.ToString()));
     }
@@ -1290,7 +1292,7 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)
   //  --------------------- ------------------------  -----------------------
     { "evo",                "bls",                    &_bls,                   {}  },
-    { "evo",                "protx",                  &protx,                  {}  },
+    { "evo",                "protx",                  &protx,                  {}, true },
 };
 
 void RegisterEvoRPCCommands(CRPCTable &tableRPC)
@@ -4,6 +4,7 @@
 
 #include <chainparams.h>
 #include <rpc/server.h>
+#include <rpc/snapshot.h>
 #include <validation.h>
 
 #include <masternode/activemasternode.h>
@@ -12,6 +13,8 @@
 #include <llmq/quorums_blockprocessor.h>
 #include <llmq/quorums_debug.h>
 #include <llmq/quorums_dkgsession.h>
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_latency.h>
 #include <llmq/quorums_signing.h>
 #include <llmq/quorums_signing_shares.h>
 
@@ -46,8 +49,6 @@ UniValue quorum_list(const JSONRPCRequest& request)
     if (request.fHelp || (request.params.size() != 1 && request.params.size() != 2))
         quorum_list_help();
 
-    LOCK(cs_main);
-
     int count = -1;
     if (!request.params[1].isNull()) {
         count = ParseInt32V(request.params[1], "count");
@@ -56,22 +57,23 @@ UniValue quorum_list(const JSONRPCRequest& request)
         }
     }
 
-    UniValue ret(UniValue::VOBJ);
+    auto snapshot = GetRPCChainSnapshot(request);
 
-    for (auto& type : llmq::CLLMQUtils::GetEnabledQuorumTypes(chainActive.Tip())) {
-        const auto& params = llmq::GetLLMQParams(type);
-        UniValue v(UniValue::VARR);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        writer.BeginObject();
+        for (const auto& p : snapshot->quorums) {
+            const auto& params = llmq::GetLLMQParams(p.first);
 
-        auto quorums = llmq::quorumManager->ScanQuorums(type, chainActive.Tip(), count > -1 ? count : params.signingActiveQuorumCount);
-        for (auto& q : quorums) {
-            v.push_back(q->qc.quorumHash.ToString());
+            auto quorums = count > -1 ? llmq::quorumManager->ScanQuorums(p.first, snapshot->tip, count) : p.second;
+            writer.Key(params.name);
+            writer.BeginArray();
+            for (auto& q : quorums) {
+                writer.Value(q->qc.quorumHash.ToString());
+            }
+            writer.EndArray();
         }
-
-        ret.pushKV(params.name, v);
-    }
-
-
-    return ret;
+        writer.EndObject();
+    });
 }
 
 void quorum_info_help()
@@ -127,8 +129,6 @@ UniValue quorum_info(const JSONRPCRequest& request)
     if (request.fHelp || (request.params.size() != 3 && request.params.size() != 4))
         quorum_info_help();
 
-    LOCK(cs_main);
-
     Consensus::LLMQType llmqType = (Consensus::LLMQType)ParseInt32V(request.params[1], "llmqType");
     if (!Params().GetConsensus().llmqs.count(llmqType)) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid LLMQ type");
@@ -517,6 +517,194 @@ UniValue quorum_selectquorum(const JSONRPCRequest& request)
     return ret;
 }
 
+void quorum_sigsharelatency_help()
+{
+    throw std::runtime_error(
+            "quorum sigsharelatency\n"
+            "Returns the latencies of the sig shares received from other quorum members. The latency of a sig share\n"
+            "is measured from the time this node verified the first sig share of the signing session until it verified\n"
+            "this share. It is not the network latency to the member: the member whose share arrived first always has a\n"
+            "latency close to 0 and the verification queue of this node adds to all latencies.\n"
+            "Only members of currently active quorums are listed.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"proTxHash\": {               (json object) The quorum member\n"
+            "    \"count\": n,                (numeric) Number of sig shares received from this member\n"
+            "    \"avg_ms\": n,               (numeric) Average latency in milliseconds\n"
+            "    \"max_ms\": n,               (numeric) Maximum latency in milliseconds\n"
+            "    \"histogram\": {             (json object) Number of sig shares by latency\n"
+            "      \"<=10ms\": n,\n"
+            "      ...\n"
+            "      \">60000ms\": n\n"
+            "    }\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+    );
+}
+
+UniValue quorum_sigsharelatency(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_sigsharelatency_help();
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& p : llmq::quorumSigSharesManager->GetMemberLatencies()) {
+        ret.pushKV(p.first.ToString(), p.second.ToJson());
+    }
+    return ret;
+}
+
+void quorum_memusage_help()
+{
+    throw std::runtime_error(
+            "quorum memusage\n"
+            "Returns the memory used by the LLMQ signing state, in bytes, and how much of it was evicted to stay within\n"
+            "the budget set by -llmq-signing-max-mem.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"budget\": n,               (numeric) Memory budget, 0 when unlimited\n"
+            "  \"total\": n,                (numeric) Total memory used\n"
+            "  \"sigshares\": n,            (numeric) Verified sig shares\n"
+            "  \"node_states\": n,          (numeric) Sessions, invs and pending sig shares of peers\n"
+            "  \"sessions\": n,             (numeric) Own signed sessions and session times\n"
+            "  \"requests\": n,             (numeric) Requested and to be announced sig shares\n"
+            "  \"pending_recsigs\": n,      (numeric) Recovered sigs waiting for verification\n"
+            "  \"evicted_sessions\": n,     (numeric) Number of signing sessions evicted since startup\n"
+            "  \"evicted_recsigs\": n       (numeric) Number of pending recovered sigs evicted since startup\n"
+            "}\n"
+    );
+}
+
+UniValue quorum_memusage(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_memusage_help();
+    }
+
+    llmq::CSigningMemoryUsage usage = llmq::quorumSigSharesManager->GetMemoryUsage();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("budget", (uint64_t)llmq::quorumSigSharesManager->GetMaxMemoryUsage());
+    ret.pushKV("total", (uint64_t)usage.Total());
+    ret.pushKV("sigshares", (uint64_t)usage.sigShares);
+    ret.pushKV("node_states", (uint64_t)usage.nodeStates);
+    ret.pushKV("sessions", (uint64_t)usage.sessions);
+    ret.pushKV("requests", (uint64_t)usage.requests);
+    ret.pushKV("pending_recsigs", (uint64_t)usage.pendingRecoveredSigs);
+    ret.pushKV("evicted_sessions", llmq::quorumSigSharesManager->GetEvictedSessionsCount());
+    ret.pushKV("evicted_recsigs", llmq::quorumSigningManager->GetEvictedRecoveredSigsCount());
+    return ret;
+}
+
+void quorum_pipelinelatency_help()
+{
+    throw std::runtime_error(
+            "quorum pipelinelatency ( reset )\n"
+            "Returns the latencies of the InstantSend and ChainLocks pipeline stages seen by this node.\n"
+            "Input votes and input locks are only measured on masternodes which take part in signing.\n"
+            "\nArguments:\n"
+            "1. reset        (boolean, optional, default=false) Reset the histograms after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"instantsend.txToInputVotes\": {     (json object) Tx entered the mempool until we voted on its inputs\n"
+            "    \"count\": n,                (numeric) Number of measurements\n"
+            "    \"avg_ms\": n,               (numeric) Average latency in milliseconds\n"
+            "    \"max_ms\": n,               (numeric) Maximum latency in milliseconds\n"
+            "    \"histogram\": {             (json object) Number of measurements by latency\n"
+            "      \"<=10ms\": n,\n"
+            "      ...\n"
+            "      \">60000ms\": n\n"
+            "    }\n"
+            "  },\n"
+            "  \"instantsend.txToInputLocks\": {...},     (json object) Tx entered the mempool until all inputs were locked\n"
+            "  \"instantsend.inputLocksToIslock\": {...}, (json object) All inputs were locked until our ISLOCK was recovered\n"
+            "  \"instantsend.txToIslock\": {...},         (json object) Tx entered the mempool until an ISLOCK was received or produced\n"
+            "  \"chainlocks.blockToClsig\": {...},        (json object) Block header was accepted until a CLSIG was received or produced\n"
+            "  \"quorums\": [                   (json array) The stages ending with an ISLOCK or CLSIG, per quorum which signed.\n"
+            "                                 Quorums which didn't sign anything for an hour are omitted\n"
+            "    {\n"
+            "      \"stage\": \"name\",           (string) Name of the stage, e.g. \"instantsend.txToIslock\"\n"
+            "      \"llmqType\": n,             (numeric) Type of the quorum\n"
+            "      \"quorumHash\": \"hash\",      (string) Hash of the quorum\n"
+            "      \"count\": n, ...            Same as the histograms above\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+    );
+}
+
+UniValue quorum_pipelinelatency(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2) {
+        quorum_pipelinelatency_help();
+    }
+
+    bool fReset = !request.params[1].isNull() && ParseBoolV(request.params[1], "reset");
+
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& p : llmq::pipelineLatencies.GetStats()) {
+        ret.pushKV(p.first, p.second.ToJson());
+    }
+    UniValue quorums(UniValue::VARR);
+    for (const auto& p : llmq::pipelineLatencies.GetQuorumStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("stage", llmq::CLatencyTracker::STAGE_NAMES[(size_t)std::get<0>(p.first)]);
+        obj.pushKV("llmqType", (int)std::get<1>(p.first));
+        obj.pushKV("quorumHash", std::get<2>(p.first).ToString());
+        obj.pushKVs(p.second.ToJson());
+        quorums.push_back(obj);
+    }
+    ret.pushKV("quorums", quorums);
+    if (fReset) {
+        llmq::pipelineLatencies.Reset();
+    }
+    return ret;
+}
+
+void quorum_signqueues_help()
+{
+    throw std::runtime_error(
+            "quorum signqueues\n"
+            "Returns the transactions waiting to be processed for InstantSend signing. Mempool transactions are always\n"
+            "processed first, mined transactions which are neither locked nor ChainLocked are then processed retroactively\n"
+            "in the order of their blocks.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"mempool\": {\n"
+            "    \"count\": n              (numeric) Number of queued mempool transactions\n"
+            "  },\n"
+            "  \"retroactive\": {\n"
+            "    \"count\": n,             (numeric) Number of queued mined transactions\n"
+            "    \"min_height\": n,        (numeric) Lowest height of the queued transactions, -1 if there are none\n"
+            "    \"max_height\": n         (numeric) Highest height of the queued transactions, -1 if there are none\n"
+            "  }\n"
+            "}\n"
+    );
+}
+
+UniValue quorum_signqueues(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_signqueues_help();
+    }
+
+    auto stats = llmq::quorumInstantSendManager->GetSignQueueStats();
+
+    UniValue mempoolQueue(UniValue::VOBJ);
+    mempoolQueue.pushKV("count", (uint64_t)stats.mempoolCount);
+    UniValue retroactiveQueue(UniValue::VOBJ);
+    retroactiveQueue.pushKV("count", (uint64_t)stats.retroactiveCount);
+    retroactiveQueue.pushKV("min_height", stats.retroactiveMinHeight);
+    retroactiveQueue.pushKV("max_height", stats.retroactiveMaxHeight);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("mempool", mempoolQueue);
+    ret.pushKV("retroactive", retroactiveQueue);
+    return ret;
+}
+
 void quorum_dkgsimerror_help()
 {
     throw std::runtime_error(
@@ -620,6 +808,10 @@ UniValue quorum_getdata(const JSONRPCRequest& request)
             "  getrecsig         - Get a recovered signature\n"
             "  isconflicting     - Test if a conflict exists\n"
             "  selectquorum      - Return the quorum that would/should sign a request\n"
+            "  sigsharelatency   - Return the latencies of the sig shares received from other quorum members\n"
+            "  pipelinelatency   - Return the latencies of the InstantSend and ChainLocks pipelines\n"
+            "  memusage          - Return the memory used by the LLMQ signing state\n"
+            "  signqueues        - Return the transactions waiting for InstantSend signing\n"
             "  getdata           - Request quorum data from other masternodes in the quorum\n"
     );
 }
@@ -647,6 +839,14 @@ UniValue quorum(const JSONRPCRequest& request)
         return quorum_sigs_cmd(request);
     } else if (command == "selectquorum") {
         return quorum_selectquorum(request);
+    } else if (command == "sigsharelatency") {
+        return quorum_sigsharelatency(request);
+    } else if (command == "pipelinelatency") {
+        return quorum_pipelinelatency(request);
+    } else if (command == "memusage") {
+        return quorum_memusage(request);
+    } else if (command == "signqueues") {
+        return quorum_signqueues(request);
     } else if (command == "dkgsimerror") {
         return quorum_dkgsimerror(request);
     } else if (command == "getdata") {
@@ -758,7 +958,7 @@ UniValue verifyislock(const JSONRPCRequest& request)
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)
   //  --------------------- ------------------------  -----------------------
-    { "evo",                "quorum",                 &quorum,                 {}  },
+    { "evo",                "quorum",                 &quorum,                 {}, true },
     { "evo",                "verifychainlock",        &verifychainlock,        {"blockHash", "signature", "blockHeight"} },
     { "evo",                "verifyislock",           &verifyislock,           {"id", "txid", "signature", "maxHeight"}  },
 };
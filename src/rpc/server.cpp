@@ -10,6 +10,7 @@
 #include <init.h>
 #include <key_io.h>
 #include <random.h>
+#include <rpc/snapshot.h>
 #include <sync.h>
 #include <ui_interface.h>
 #include <util.h>
@@ -22,7 +23,10 @@
 #include <boost/algorithm/string/split.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
 #include <unordered_map>
 
 static CCriticalSection cs_rpcWarmup;
@@ -463,6 +467,26 @@ void JSONRPCRequest::parse(const UniValue& valRequest)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array or object");
 }
 
+UniValue WriteRPCResult(const JSONRPCRequest& request, const std::function<void(JSONWriter& writer)>& fn)
+{
+    if (request.resultWriter) {
+        fn(*request.resultWriter);
+        request.resultWriter->Flush();
+        return NullUniValue;
+    }
+
+    std::string strResult;
+    JSONStringSink sink(strResult);
+    JSONWriter writer(sink);
+    fn(writer);
+    writer.Flush();
+    UniValue result;
+    if (!result.read(strResult)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to parse result");
+    }
+    return result;
+}
+
 bool IsDeprecatedRPCEnabled(const std::string& method)
 {
     const std::vector<std::string> enabled_methods = gArgs.GetArgs("-deprecatedrpc");
@@ -493,12 +517,63 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+/** Elements of a batch which is executed by several threads */
+struct RPCBatchState
+{
+    const JSONRPCRequest* jreq;
+    const UniValue* vReq;
+    const size_t nSize;
+    std::vector<UniValue> vResults;
+    //! index of the next element to be executed
+    std::atomic<size_t> nNext{0};
+
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nDone{0};
+
+    RPCBatchState(const JSONRPCRequest& jreqIn, const UniValue& vReqIn) :
+        jreq(&jreqIn), vReq(&vReqIn), nSize(vReqIn.size()), vResults(nSize) {}
+};
+
+static void JSONRPCExecBatchElements(RPCBatchState& state)
+{
+    // jreq and vReq may only be accessed after claiming an element, the caller waits for all of them to finish
+    size_t nIdx;
+    while ((nIdx = state.nNext++) < state.nSize) {
+        state.vResults[nIdx] = JSONRPCExecOne(*state.jreq, (*state.vReq)[nIdx]);
+        std::lock_guard<std::mutex> lock(state.cs);
+        if (++state.nDone == state.nSize) {
+            state.cond.notify_all();
+        }
+    }
+}
+
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, int nMaxConcurrency, const std::function<bool(std::function<void()>)>& spawn)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    if (nMaxConcurrency <= 1 || vReq.size() <= 1 || !spawn) {
+        for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+            ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
 
+        return ret.write() + "\n";
+    }
+
+    // Helpers claim elements until none are left. The calling thread takes part as well, so the batch completes
+    // even if no helper gets to run, and it never waits for elements which weren't started yet.
+    auto state = std::make_shared<RPCBatchState>(jreq, vReq);
+    size_t nHelpers = std::min<size_t>(nMaxConcurrency - 1, vReq.size() - 1);
+    for (size_t i = 0; i < nHelpers; i++) {
+        if (!spawn([state] { JSONRPCExecBatchElements(*state); })) {
+            break;
+        }
+    }
+    JSONRPCExecBatchElements(*state);
+    {
+        std::unique_lock<std::mutex> lock(state->cs);
+        state->cond.wait(lock, [&] { return state->nDone == state->nSize; });
+    }
+
+    ret.push_backV(state->vResults);
     return ret.write() + "\n";
 }
 
@@ -619,6 +694,13 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
 
     try
     {
+        if (pcmd->useSnapshot) {
+            // All reads of the call see the same chain state, even when blocks get connected meanwhile
+            JSONRPCRequest snapshotRequest = request.params.isObject() ? transformNamedArguments(request, pcmd->argNames) : request;
+            snapshotRequest.chainSnapshot = GetRPCChainSnapshot();
+            return pcmd->actor(snapshotRequest);
+        }
+
         // Execute, convert arguments to array if necessary
         if (request.params.isObject()) {
             return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
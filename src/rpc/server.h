@@ -7,16 +7,20 @@
 #define BITCOIN_RPC_SERVER_H
 
 #include <amount.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/protocol.h>
 #include <uint256.h>
 
+#include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <string>
 
 #include <univalue.h>
 
+class CRPCChainSnapshot;
 class CRPCCommand;
 
 namespace RPCServer
@@ -44,11 +48,23 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    /** If set, the result may be streamed into this writer instead of being returned, see WriteRPCResult() */
+    JSONWriter* resultWriter;
+    /** Chain state the call reads from, pinned by CRPCTable::execute() for commands which use snapshots */
+    std::shared_ptr<const CRPCChainSnapshot> chainSnapshot;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), resultWriter(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
+/**
+ * Produce the result of an RPC call with a JSONWriter. When the caller of the RPC supports it, the result is
+ * streamed directly into the reply and the returned value is null, otherwise it's parsed into a UniValue.
+ * Meant for calls with large results, where building the UniValue tree is most of the work. Errors should be
+ * thrown before writing anything where possible, the caller discards partially written results however.
+ */
+UniValue WriteRPCResult(const JSONRPCRequest& request, const std::function<void(JSONWriter& writer)>& fn);
+
 /** Query whether RPC is running */
 bool IsRPCRunning();
 
@@ -133,6 +149,8 @@ public:
     std::string name;
     rpcfn_type actor;
     std::vector<std::string> argNames;
+    //! whether the command reads the chain from a CRPCChainSnapshot instead of holding cs_main for the whole call
+    bool useSnapshot = false;
 };
 
 /**
@@ -206,6 +224,11 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+/**
+ * Execute a batch of requests, returning the serialized array of replies in the order of the requests.
+ * Up to nMaxConcurrency elements are executed at once: spawn is asked to run helper functions on other threads
+ * and returns false if it can't, whatever isn't picked up by helpers is executed by the calling thread.
+ */
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, int nMaxConcurrency = 1, const std::function<bool(std::function<void()>)>& spawn = nullptr);
 
 #endif // BITCOIN_RPC_SERVER_H
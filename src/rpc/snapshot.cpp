@@ -0,0 +1,87 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/snapshot.h>
+
+#include <llmq/quorums.h>
+#include <llmq/quorums_utils.h>
+#include <sync.h>
+#include <validation.h>
+
+#include <atomic>
+
+static std::atomic<const CBlockIndex*> rpcSnapshotTip{nullptr};
+
+static CCriticalSection cs_rpcSnapshot;
+static CRPCChainSnapshotPtr rpcSnapshot GUARDED_BY(cs_rpcSnapshot);
+
+static CDeterministicMNList GetSnapshotMNList(const CBlockIndex* tip)
+{
+    if (!tip || !deterministicMNManager) {
+        return CDeterministicMNList();
+    }
+    return deterministicMNManager->GetListForBlock(tip);
+}
+
+static std::map<Consensus::LLMQType, std::vector<llmq::CQuorumCPtr>> GetSnapshotQuorums(const CBlockIndex* tip)
+{
+    std::map<Consensus::LLMQType, std::vector<llmq::CQuorumCPtr>> ret;
+    if (!tip || !llmq::quorumManager) {
+        return ret;
+    }
+    for (auto& type : llmq::CLLMQUtils::GetEnabledQuorumTypes(tip)) {
+        ret.emplace(type, llmq::quorumManager->ScanQuorums(type, tip, llmq::GetLLMQParams(type).signingActiveQuorumCount));
+    }
+    return ret;
+}
+
+CRPCChainSnapshot::CRPCChainSnapshot(const CBlockIndex* tipIn) :
+    tip(tipIn),
+    mnList(GetSnapshotMNList(tipIn)),
+    quorums(GetSnapshotQuorums(tipIn))
+{
+}
+
+void SetRPCChainSnapshotTip(const CBlockIndex* pindex)
+{
+    rpcSnapshotTip = pindex;
+    if (!pindex) {
+        // The old tip might get freed, don't keep it around
+        LOCK(cs_rpcSnapshot);
+        rpcSnapshot.reset();
+    }
+}
+
+CRPCChainSnapshotPtr GetRPCChainSnapshot()
+{
+    const CBlockIndex* tip = rpcSnapshotTip;
+    if (!tip) {
+        // The tip isn't known yet during startup, such snapshots aren't cached
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+
+    {
+        LOCK(cs_rpcSnapshot);
+        if (rpcSnapshot && rpcSnapshot->tip == tip) {
+            return rpcSnapshot;
+        }
+    }
+
+    // Built without holding cs_rpcSnapshot, this reads from the evo db which is locked during block connects
+    auto snapshot = std::make_shared<const CRPCChainSnapshot>(tip);
+    LOCK(cs_rpcSnapshot);
+    if (tip == rpcSnapshotTip) {
+        rpcSnapshot = snapshot;
+    }
+    return snapshot;
+}
+
+CRPCChainSnapshotPtr GetRPCChainSnapshot(const JSONRPCRequest& request)
+{
+    if (request.chainSnapshot) {
+        return request.chainSnapshot;
+    }
+    return GetRPCChainSnapshot();
+}
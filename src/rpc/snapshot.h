@@ -0,0 +1,72 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_SNAPSHOT_H
+#define BITCOIN_RPC_SNAPSHOT_H
+
+#include <chain.h>
+#include <consensus/params.h>
+#include <evo/deterministicmns.h>
+#include <rpc/server.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace llmq
+{
+class CQuorum;
+typedef std::shared_ptr<const CQuorum> CQuorumCPtr;
+} // namespace llmq
+
+/**
+ * Immutable view of the chain at a tip, for RPCs which would otherwise hold cs_main for the whole call.
+ * Block index entries are never freed while the node runs and the ancestors of a block never change, so
+ * everything about the active chain can be answered from its tip alone.
+ */
+class CRPCChainSnapshot
+{
+public:
+    //! the tip of the chain, nullptr before the block index is loaded
+    const CBlockIndex* const tip;
+    //! the deterministic masternode list at tip
+    const CDeterministicMNList mnList;
+    //! the signing active quorums at tip of all enabled LLMQ types, newest first
+    const std::map<Consensus::LLMQType, std::vector<llmq::CQuorumCPtr>> quorums;
+
+    explicit CRPCChainSnapshot(const CBlockIndex* tipIn);
+
+    int Height() const { return tip ? tip->nHeight : -1; }
+
+    /** Same as CChain::Contains() */
+    bool Contains(const CBlockIndex* pindex) const
+    {
+        return pindex && tip && tip->GetAncestor(pindex->nHeight) == pindex;
+    }
+
+    /** Same as CChain::operator[] */
+    const CBlockIndex* operator[](int nHeight) const
+    {
+        return tip ? tip->GetAncestor(nHeight) : nullptr;
+    }
+
+    /** Same as CChain::Next() */
+    const CBlockIndex* Next(const CBlockIndex* pindex) const
+    {
+        return Contains(pindex) ? (*this)[pindex->nHeight + 1] : nullptr;
+    }
+};
+
+typedef std::shared_ptr<const CRPCChainSnapshot> CRPCChainSnapshotPtr;
+
+/** Called whenever the active chain changes, or with nullptr before the block index is unloaded */
+void SetRPCChainSnapshotTip(const CBlockIndex* pindex);
+
+/** Get a snapshot of the current tip, it is shared by all calls until the tip changes */
+CRPCChainSnapshotPtr GetRPCChainSnapshot();
+
+/** Get the snapshot pinned for the call by CRPCTable::execute(), or a new one */
+CRPCChainSnapshotPtr GetRPCChainSnapshot(const JSONRPCRequest& request);
+
+#endif // BITCOIN_RPC_SNAPSHOT_H
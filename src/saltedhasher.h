@@ -30,6 +30,15 @@ struct SaltedHasherImpl<std::pair<N, uint256>>
     }
 };
 
+template<>
+struct SaltedHasherImpl<std::pair<uint256, uint256>>
+{
+    static std::size_t CalcHash(const std::pair<uint256, uint256>& v, uint64_t k0, uint64_t k1)
+    {
+        return CSipHasher(k0, k1).Write(v.first.begin(), v.first.size()).Write(v.second.begin(), v.second.size()).Finalize();
+    }
+};
+
 template<>
 struct SaltedHasherImpl<uint256>
 {
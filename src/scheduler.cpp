@@ -6,12 +6,15 @@
 
 #include <random.h>
 #include <reverselock.h>
+#include <utiltime.h>
 
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
 
-CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
+constexpr std::array<int64_t, 5> CScheduler::RUNTIME_BUCKET_BOUNDS;
+
+CScheduler::CScheduler() : nThreadsServicingQueue(0), nLowPriorityRunning(0), stopRequested(false), stopWhenEmpty(false)
 {
 }
 
@@ -30,6 +33,43 @@ static boost::system_time toPosixTime(const boost::chrono::system_clock::time_po
 }
 #endif
 
+CScheduler::TaskQueue::iterator CScheduler::findRunnableTask(boost::chrono::system_clock::time_point now, bool& fHaveNext, boost::chrono::system_clock::time_point& nextTime)
+{
+    // Low priority tasks may not use the last thread which isn't running one already
+    const bool fLowAllowed = nThreadsServicingQueue <= 1 || nLowPriorityRunning + 1 < nThreadsServicingQueue;
+    fHaveNext = false;
+    TaskQueue::iterator best = taskQueue.end();
+    for (auto it = taskQueue.begin(); it != taskQueue.end(); ++it) {
+        if (it->second.priority == Priority::LOW && !fLowAllowed) {
+            continue;
+        }
+        if (it->first > now) {
+            if (best == taskQueue.end()) {
+                fHaveNext = true;
+                nextTime = it->first;
+            }
+            break;
+        }
+        if (best == taskQueue.end() || it->second.priority < best->second.priority) {
+            best = it;
+        }
+    }
+    return best;
+}
+
+void CScheduler::recordRuntime(const std::string& strName, int64_t nMicros)
+{
+    TaskStats& stats = mapTaskStats[strName.empty() ? "other" : strName];
+    stats.nRuns++;
+    stats.nTotalMicros += nMicros;
+    stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+    size_t nBucket = 0;
+    while (nBucket < RUNTIME_BUCKET_BOUNDS.size() && nMicros >= RUNTIME_BUCKET_BOUNDS[nBucket]) {
+        nBucket++;
+    }
+    stats.vBuckets[nBucket]++;
+}
+
 void CScheduler::serviceQueue()
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
@@ -45,42 +85,57 @@ void CScheduler::serviceQueue()
                 // Use this chance to get a tiny bit more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
-
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
 
+            // Wait until there is a task this thread may run and it is due. New tasks and finished low priority
+            // tasks are notified, as they can change which task that is.
+            TaskQueue::iterator taskIt = taskQueue.end();
+            while (!shouldStop()) {
+                bool fHaveNext;
+                boost::chrono::system_clock::time_point nextTime;
+                taskIt = findRunnableTask(boost::chrono::system_clock::now(), fHaveNext, nextTime);
+                if (taskIt != taskQueue.end()) {
+                    break;
+                }
+                if (!fHaveNext) {
+                    newTaskScheduled.wait(lock);
+                } else {
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                    newTaskScheduled.timed_wait(lock, toPosixTime(nextTime));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                    // Some boost versions have a conflicting overload of wait_until that returns void.
+                    // Explicitly use a template here to avoid hitting that overload.
+                    newTaskScheduled.wait_until<>(lock, nextTime);
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+                }
+            }
+            if (shouldStop())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            Task task = std::move(taskIt->second);
+            taskQueue.erase(taskIt);
 
-            {
+            const bool fLowPriority = task.priority == Priority::LOW;
+            if (fLowPriority) {
+                ++nLowPriorityRunning;
+            }
+            int64_t nStart = GetTimeMicros();
+            try {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                task.f();
+            } catch (...) {
+                if (fLowPriority) {
+                    --nLowPriorityRunning;
+                }
+                throw;
+            }
+            recordRuntime(task.strName, GetTimeMicros() - nStart);
+            if (fLowPriority) {
+                --nLowPriorityRunning;
+                // Threads waiting for a task may be allowed to run a low priority one now
+                newTaskScheduled.notify_all();
             }
         } catch (...) {
             --nThreadsServicingQueue;
@@ -103,29 +158,30 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, Priority priority, const std::string& strName)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.insert(std::make_pair(t, Task{std::move(f), priority, strName}));
     }
-    newTaskScheduled.notify_one();
+    // Waiting threads may not be allowed to run this task, so wake them all
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, Priority priority, const std::string& strName)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), priority, strName);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, CScheduler::Priority priority, const std::string& strName)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds, priority, strName), deltaMilliSeconds, priority, strName);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, Priority priority, const std::string& strName)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds, priority, strName), deltaMilliSeconds, priority, strName);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
@@ -145,6 +201,12 @@ bool CScheduler::AreThreadsServicingQueue() const {
     return nThreadsServicingQueue;
 }
 
+std::map<std::string, CScheduler::TaskStats> CScheduler::getTaskStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return mapTaskStats;
+}
+
 
 void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
     {
@@ -155,7 +217,7 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this));
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now(), m_priority, m_name);
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue() {
@@ -12,7 +12,9 @@
 //
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <array>
 #include <map>
+#include <string>
 
 #include <sync.h>
 
@@ -34,6 +36,15 @@
 // delete s; // Must be done after thread is interrupted/joined.
 //
 
+// The tasks can be serviced by several threads. Of the tasks which are due,
+// the one with the highest priority runs first, and low priority tasks never
+// occupy the last thread, so that long maintenance tasks can't hold up the
+// others. The runtime of the tasks is recorded by name.
+//
+
+//! Default number of threads running serviceQueue
+static const int DEFAULT_SCHEDULER_THREADS = 4;
+
 class CScheduler
 {
 public:
@@ -42,18 +53,34 @@ public:
 
     typedef std::function<void(void)> Function;
 
-    // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    enum class Priority {
+        HIGH,
+        NORMAL,
+        LOW,
+    };
+
+    //! Upper bounds (in microseconds) of the runtime histogram buckets, the last bucket is for longer runs
+    static constexpr std::array<int64_t, 5> RUNTIME_BUCKET_BOUNDS{{1000, 10 * 1000, 100 * 1000, 1000 * 1000, 10 * 1000 * 1000}};
+
+    struct TaskStats {
+        uint64_t nRuns{0};
+        int64_t nTotalMicros{0};
+        int64_t nMaxMicros{0};
+        std::array<uint64_t, RUNTIME_BUCKET_BOUNDS.size() + 1> vBuckets{};
+    };
+
+    // Call func at/after time t. strName is the name the runtime of f is recorded by
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(), Priority priority=Priority::NORMAL, const std::string& strName="");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, Priority priority=Priority::NORMAL, const std::string& strName="");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, Priority priority=Priority::NORMAL, const std::string& strName="");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -74,14 +101,33 @@ public:
     // Returns true if there are threads actively running in serviceQueue()
     bool AreThreadsServicingQueue() const;
 
+    // Returns the runtime statistics of the tasks which ran so far, by name ("other" for the unnamed ones)
+    std::map<std::string, TaskStats> getTaskStats() const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        Function f;
+        Priority priority;
+        std::string strName;
+    };
+    typedef std::multimap<boost::chrono::system_clock::time_point, Task> TaskQueue;
+
+    TaskQueue taskQueue;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
+    int nLowPriorityRunning;
     bool stopRequested;
     bool stopWhenEmpty;
+    std::map<std::string, TaskStats> mapTaskStats;
     bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+
+    /**
+     * The due task with the highest priority which may run now, or end(). In that case, fHaveNext tells whether
+     * there is a task which may run later, at nextTime.
+     */
+    TaskQueue::iterator findRunnableTask(boost::chrono::system_clock::time_point now, bool& fHaveNext, boost::chrono::system_clock::time_point& nextTime);
+    void recordRuntime(const std::string& strName, int64_t nMicros);
 };
 
 /**
@@ -102,11 +148,15 @@ private:
     std::list<std::function<void (void)>> m_callbacks_pending GUARDED_BY(m_cs_callbacks_pending);
     bool m_are_callbacks_running GUARDED_BY(m_cs_callbacks_pending) = false;
 
+    const CScheduler::Priority m_priority;
+    const std::string m_name;
+
     void MaybeScheduleProcessQueue();
     void ProcessQueue();
 
 public:
-    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn) : m_pscheduler(pschedulerIn) {}
+    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn, CScheduler::Priority priority = CScheduler::Priority::HIGH, const std::string& name = "callbacks") :
+        m_pscheduler(pschedulerIn), m_priority(priority), m_name(name) {}
 
     /**
      * Add a callback to be executed. Callbacks are executed serially
@@ -5,11 +5,17 @@
 
 #include <script/dashconsensus.h>
 
+#include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <pubkey.h>
 #include <script/interpreter.h>
 #include <version.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -62,6 +68,48 @@ inline int set_error(dashconsensus_error* ret, dashconsensus_error serror)
     return 0;
 }
 
+struct InputCheck
+{
+    const CTransaction* tx;
+    const PrecomputedTransactionData* txdata;
+    unsigned int nIn;
+};
+
+/** Verifies checks[i] against spentScriptPubKeys[i], on up to nThreads threads. Returns 1 if all inputs are valid */
+int verify_inputs(const std::vector<InputCheck>& checks, const unsigned char* const* spentScriptPubKeys, const unsigned int* spentScriptPubKeyLens,
+                  unsigned int flags, unsigned int nThreads, int* results)
+{
+    std::vector<int> valid(checks.size(), 0);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < checks.size(); i = next++) {
+            const auto& check = checks[i];
+            CScript scriptPubKey(spentScriptPubKeys[i], spentScriptPubKeys[i] + spentScriptPubKeyLens[i]);
+            CAmount am(0);
+            valid[i] = VerifyScript(check.tx->vin[check.nIn].scriptSig, scriptPubKey, flags,
+                                    TransactionSignatureChecker(check.tx, check.nIn, am, *check.txdata), nullptr);
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(std::max(nThreads, 1U), checks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    int ret = 1;
+    for (size_t i = 0; i < valid.size(); i++) {
+        if (results)
+            results[i] = valid[i];
+        ret &= valid[i];
+    }
+    return ret;
+}
+
 struct ECCryptoClosure
 {
     ECCVerifyHandle handle;
@@ -102,6 +150,75 @@ int dashconsensus_verify_script(const unsigned char *scriptPubKey, unsigned int
     }
 }
 
+int dashconsensus_verify_script_batch(const unsigned char* const* spentScriptPubKeys, const unsigned int* spentScriptPubKeyLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *txTo        , unsigned int txToLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, dashconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, dashconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        CTransaction tx(deserialize, stream);
+        if (GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+            return set_error(err, dashconsensus_ERR_TX_SIZE_MISMATCH);
+        if (nSpentOutputs != tx.vin.size())
+            return set_error(err, dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        // Regardless of the verification result, the tx did not error.
+        set_error(err, dashconsensus_ERR_OK);
+
+        PrecomputedTransactionData txdata(tx);
+        std::vector<InputCheck> checks;
+        checks.reserve(tx.vin.size());
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            checks.push_back({&tx, &txdata, i});
+        }
+        return verify_inputs(checks, spentScriptPubKeys, spentScriptPubKeyLens, flags, nThreads, results);
+    } catch (const std::exception&) {
+        return set_error(err, dashconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
+int dashconsensus_verify_block_scripts(const unsigned char* const* spentScriptPubKeys, const unsigned int* spentScriptPubKeyLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *block       , unsigned int blockLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, dashconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, dashconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, block, blockLen);
+        CBlock blk;
+        stream >> blk;
+        if (GetSerializeSize(blk, SER_NETWORK, PROTOCOL_VERSION) != blockLen)
+            return set_error(err, dashconsensus_ERR_BLOCK_SIZE_MISMATCH);
+
+        std::vector<PrecomputedTransactionData> txdata;
+        txdata.reserve(blk.vtx.size());
+        std::vector<InputCheck> checks;
+        for (const auto& tx : blk.vtx) {
+            if (tx->IsCoinBase())
+                continue;
+            txdata.emplace_back(*tx);
+            for (unsigned int i = 0; i < tx->vin.size(); i++) {
+                checks.push_back({tx.get(), &txdata.back(), i});
+            }
+        }
+        if (nSpentOutputs != checks.size())
+            return set_error(err, dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        // Regardless of the verification result, the block did not error.
+        set_error(err, dashconsensus_ERR_OK);
+
+        return verify_inputs(checks, spentScriptPubKeys, spentScriptPubKeyLens, flags, nThreads, results);
+    } catch (const std::exception&) {
+        return set_error(err, dashconsensus_ERR_BLOCK_DESERIALIZE); // Error deserializing
+    }
+}
+
 unsigned int dashconsensus_version()
 {
     // Just use the API version for now
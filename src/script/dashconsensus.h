@@ -33,7 +33,7 @@
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 0
+#define BITCOINCONSENSUS_API_VER 1
 
 typedef enum dashconsensus_error_t
 {
@@ -42,6 +42,9 @@ typedef enum dashconsensus_error_t
     dashconsensus_ERR_TX_SIZE_MISMATCH,
     dashconsensus_ERR_TX_DESERIALIZE,
     dashconsensus_ERR_INVALID_FLAGS,
+    dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH,
+    dashconsensus_ERR_BLOCK_SIZE_MISMATCH,
+    dashconsensus_ERR_BLOCK_DESERIALIZE,
 } dashconsensus_error;
 
 /** Script verification flags */
@@ -66,6 +69,25 @@ EXPORT_SYMBOL int dashconsensus_verify_script(const unsigned char *scriptPubKey,
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, dashconsensus_error* err);
 
+/// Verifies all inputs of the serialized transaction pointed to by txTo, which is deserialized only once.
+/// spentScriptPubKeys and spentScriptPubKeyLens point to the scriptPubKeys of the outputs spent by the inputs, in the
+/// order of the inputs. nSpentOutputs must be the number of inputs.
+/// With nThreads > 1, up to nThreads threads verify the inputs in parallel.
+/// Returns 1 if all inputs are valid. If not nullptr, results will contain 1 or 0 for every input and err will
+/// contain an error/success code for the operation
+EXPORT_SYMBOL int dashconsensus_verify_script_batch(const unsigned char* const* spentScriptPubKeys, const unsigned int* spentScriptPubKeyLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *txTo        , unsigned int txToLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, dashconsensus_error* err);
+
+/// Same as dashconsensus_verify_script_batch, but for all inputs of all transactions of the serialized block pointed
+/// to by block, except the coinbase. The spent outputs and the results are in the order of the transactions, then of
+/// their inputs
+EXPORT_SYMBOL int dashconsensus_verify_block_scripts(const unsigned char* const* spentScriptPubKeys, const unsigned int* spentScriptPubKeyLens,
+                                    unsigned int nSpentOutputs,
+                                    const unsigned char *block       , unsigned int blockLen,
+                                    unsigned int flags, unsigned int nThreads, int* results, dashconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int dashconsensus_version();
 
 #ifdef __cplusplus
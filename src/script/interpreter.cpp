@@ -12,7 +12,7 @@
 #include <script/script.h>
 #include <uint256.h>
 
-typedef std::vector<unsigned char> valtype;
+typedef CScriptStackElement valtype;
 
 namespace {
 
@@ -60,7 +60,8 @@ static inline void popstack(std::vector<valtype>& stack)
     stack.pop_back();
 }
 
-bool static IsCompressedOrUncompressedPubKey(const valtype &vchPubKey) {
+template<typename T>
+static bool IsCompressedOrUncompressedPubKey(const T &vchPubKey) {
     if (vchPubKey.size() < CPubKey::COMPRESSED_PUBLIC_KEY_SIZE) {
         //  Non-canonical public key: too short
         return false;
@@ -92,7 +93,8 @@ bool static IsCompressedOrUncompressedPubKey(const valtype &vchPubKey) {
  *
  * This function is consensus-critical since BIP66.
  */
-bool static IsValidSignatureEncoding(const std::vector<unsigned char> &sig) {
+template<typename T>
+static bool IsValidSignatureEncoding(const T &sig) {
     // Format: 0x30 [total-length] 0x02 [R-length] [R] 0x02 [S-length] [S] [sighash]
     // * total-length: 1-byte length descriptor of everything that follows,
     //   excluding the sighash byte.
@@ -157,7 +159,8 @@ bool static IsValidSignatureEncoding(const std::vector<unsigned char> &sig) {
     return true;
 }
 
-bool static IsLowDERSignature(const valtype &vchSig, ScriptError* serror) {
+template<typename T>
+static bool IsLowDERSignature(const T &vchSig, ScriptError* serror) {
     if (!IsValidSignatureEncoding(vchSig)) {
         return set_error(serror, SCRIPT_ERR_SIG_DER);
     }
@@ -174,7 +177,8 @@ bool static IsLowDERSignature(const valtype &vchSig, ScriptError* serror) {
     return true;
 }
 
-bool static IsDefinedHashtypeSignature(const valtype &vchSig) {
+template<typename T>
+static bool IsDefinedHashtypeSignature(const T &vchSig) {
     if (vchSig.size() == 0) {
         return false;
     }
@@ -185,7 +189,8 @@ bool static IsDefinedHashtypeSignature(const valtype &vchSig) {
     return true;
 }
 
-bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror) {
+template<typename T>
+bool CheckSignatureEncoding(const T &vchSig, unsigned int flags, ScriptError* serror) {
     // Empty signature. Not strictly DER encoded, but allowed to provide a
     // compact way to provide an invalid signature for use with CHECK(MULTI)SIG
     if (vchSig.size() == 0) {
@@ -202,14 +207,21 @@ bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned i
     return true;
 }
 
-bool static CheckPubKeyEncoding(const valtype &vchSig, unsigned int flags, ScriptError* serror) {
+template bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
+template bool CheckSignatureEncoding(const CScriptStackElement &vchSig, unsigned int flags, ScriptError* serror);
+
+template<typename T>
+bool CheckPubKeyEncoding(const T &vchSig, unsigned int flags, ScriptError* serror) {
     if ((flags & SCRIPT_VERIFY_STRICTENC) != 0 && !IsCompressedOrUncompressedPubKey(vchSig)) {
         return set_error(serror, SCRIPT_ERR_PUBKEYTYPE);
     }
     return true;
 }
 
-bool static CheckMinimalPush(const valtype& data, opcodetype opcode) {
+template bool CheckPubKeyEncoding(const std::vector<unsigned char> &vchPubKey, unsigned int flags, ScriptError* serror);
+template bool CheckPubKeyEncoding(const CScriptStackElement &vchPubKey, unsigned int flags, ScriptError* serror);
+
+bool static CheckMinimalPush(const std::vector<unsigned char>& data, opcodetype opcode) {
     // Excludes OP_1NEGATE, OP_1-16 since they are by definition minimal
     assert(0 <= opcode && opcode <= OP_PUSHDATA4);
     if (data.size() == 0) {
@@ -262,21 +274,21 @@ int FindAndDelete(CScript& script, const CScript& b)
     return nFound;
 }
 
-bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
+bool EvalScript(CScriptStack& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
 {
     static const CScriptNum bnZero(0);
     static const CScriptNum bnOne(1);
     // static const CScriptNum bnFalse(0);
     // static const CScriptNum bnTrue(1);
-    static const valtype vchFalse(0);
+    static const valtype vchFalse;
     // static const valtype vchZero(0);
-    static const valtype vchTrue(1, 1);
+    static const valtype vchTrue(1, (unsigned char)1);
 
     CScript::const_iterator pc = script.begin();
     CScript::const_iterator pend = script.end();
     CScript::const_iterator pbegincodehash = script.begin();
     opcodetype opcode;
-    valtype vchPushValue;
+    std::vector<unsigned char> vchPushValue;
     std::vector<bool> vfExec;
     std::vector<valtype> altstack;
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
@@ -332,7 +344,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                 if (fRequireMinimal && !CheckMinimalPush(vchPushValue, opcode)) {
                     return set_error(serror, SCRIPT_ERR_MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                stack.emplace_back(vchPushValue.begin(), vchPushValue.end());
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF))
             switch (opcode)
             {
@@ -359,7 +371,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                 {
                     // ( -- value)
                     CScriptNum bn((int)opcode - (int)(OP_1 - 1));
-                    stack.push_back(bn.getvch());
+                    stack.push_back(bn.getvch<valtype>());
                     // The result of these opcodes should always be the minimal way to push the data
                     // they push, so no need for a CheckMinimalPush here.
                 }
@@ -596,8 +608,8 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     // (x1 x2 x3 x4 -- x3 x4 x1 x2)
                     if (stack.size() < 4)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    swap(stacktop(-4), stacktop(-2));
-                    swap(stacktop(-3), stacktop(-1));
+                    std::swap(stacktop(-4), stacktop(-2));
+                    std::swap(stacktop(-3), stacktop(-1));
                 }
                 break;
 
@@ -616,7 +628,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                 {
                     // -- stacksize
                     CScriptNum bn(stack.size());
-                    stack.push_back(bn.getvch());
+                    stack.push_back(bn.getvch<valtype>());
                 }
                 break;
 
@@ -683,8 +695,8 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     //  x2 x3 x1  after second swap
                     if (stack.size() < 3)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    swap(stacktop(-3), stacktop(-2));
-                    swap(stacktop(-2), stacktop(-1));
+                    std::swap(stacktop(-3), stacktop(-2));
+                    std::swap(stacktop(-2), stacktop(-1));
                 }
                 break;
 
@@ -693,7 +705,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     // (x1 x2 -- x2 x1)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    swap(stacktop(-2), stacktop(-1));
+                    std::swap(stacktop(-2), stacktop(-1));
                 }
                 break;
 
@@ -714,7 +726,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     CScriptNum bn(stacktop(-1).size());
-                    stack.push_back(bn.getvch());
+                    stack.push_back(bn.getvch<valtype>());
                 }
                 break;
 
@@ -817,7 +829,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     default:            assert(!"invalid opcode"); break;
                     }
                     popstack(stack);
-                    stack.push_back(bn.getvch());
+                    stack.push_back(bn.getvch<valtype>());
                 }
                 break;
 
@@ -884,7 +896,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     }
                     popstack(stack);
                     popstack(stack);
-                    stack.push_back(bn.getvch());
+                    stack.push_back(bn.getvch<valtype>());
 
                     if (opcode == OP_NUMEQUALVERIFY)
                     {
@@ -926,7 +938,8 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     valtype& vch = stacktop(-1);
-                    valtype vchHash((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
+                    valtype vchHash;
+                    vchHash.resize((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
                     if (opcode == OP_RIPEMD160)
                         CRIPEMD160().Write(vch.data(), vch.size()).Finalize(vchHash.data());
                     else if (opcode == OP_SHA1)
@@ -956,8 +969,9 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
 
-                    valtype& vchSig    = stacktop(-2);
-                    valtype& vchPubKey = stacktop(-1);
+                    // Copied as the signature checker takes vectors
+                    std::vector<unsigned char> vchSig(ToByteVector(stacktop(-2)));
+                    std::vector<unsigned char> vchPubKey(ToByteVector(stacktop(-1)));
 
                     // Subset of script starting at the most recent codeseparator
                     CScript scriptCode(pbegincodehash, pend);
@@ -1007,11 +1021,11 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
 
                     bool fSuccess = false;
                     if (vchSig.size()) {
-                        valtype vchHash(32);
+                        uint256 hash;
                         CSHA256()
                             .Write(vchMessage.data(), vchMessage.size())
-                            .Finalize(vchHash.data());
-                        fSuccess = checker.VerifySignature(vchSig, CPubKey(vchPubKey), uint256(vchHash));
+                            .Finalize(hash.begin());
+                        fSuccess = checker.VerifySignature(ToByteVector(vchSig), CPubKey(vchPubKey.begin(), vchPubKey.end()), hash);
                     }
 
                     if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size()) {
@@ -1071,7 +1085,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     {
                         valtype& vchSig = stacktop(-isig-k);
                         if (sigversion == SigVersion::BASE) {
-                            FindAndDelete(scriptCode, CScript(vchSig));
+                            FindAndDelete(scriptCode, CScript(ToByteVector(vchSig)));
                         }
                     }
 
@@ -1090,7 +1104,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                         }
 
                         // Check signature
-                        bool fOk = checker.CheckSig(vchSig, vchPubKey, scriptCode, sigversion);
+                        bool fOk = checker.CheckSig(ToByteVector(vchSig), ToByteVector(vchPubKey), scriptCode, sigversion);
 
                         if (fOk) {
                             isig++;
@@ -1190,8 +1204,8 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                         valtype vchOut1, vchOut2;
                         vchOut1.insert(vchOut1.end(), vch.begin(), vch.begin() + nPosition);
                         vchOut2.insert(vchOut2.end(), vch.begin() + nPosition, vch.end());
-                        stack.emplace_back(move(vchOut1));
-                        stack.emplace_back(move(vchOut2));
+                        stack.emplace_back(std::move(vchOut1));
+                        stack.emplace_back(std::move(vchOut2));
                     }
                 }
                 break;
@@ -1279,6 +1293,22 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
     return set_success(serror);
 }
 
+bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
+{
+    CScriptStack stackTmp;
+    stackTmp.reserve(stack.size());
+    for (const auto& vch : stack) {
+        stackTmp.emplace_back(vch.begin(), vch.end());
+    }
+    bool ret = EvalScript(stackTmp, script, flags, checker, sigversion, serror);
+    stack.clear();
+    stack.reserve(stackTmp.size());
+    for (const auto& vch : stackTmp) {
+        stack.emplace_back(vch.begin(), vch.end());
+    }
+    return ret;
+}
+
 namespace {
 
 /**
@@ -1379,37 +1409,111 @@ public:
     }
 };
 
-uint256 GetPrevoutHash(const CTransaction& txTo) {
-    CHashWriter ss(SER_GETHASH, 0);
-    for (const auto& txin : txTo.vin) {
-        ss << txin.prevout;
-    }
-    return ss.GetHash();
-}
+/** Size of an input in the serialization of CTransactionSignatureSerializer when its script is blanked out */
+const size_t BLANKED_INPUT_SIZE = 32 + 4 + 1 + 4; // prevout, empty script and nSequence
 
-uint256 GetSequenceHash(const CTransaction& txTo) {
-    CHashWriter ss(SER_GETHASH, 0);
-    for (const auto& txin : txTo.vin) {
-        ss << txin.nSequence;
+/** Stream which appends to a byte vector */
+class CSigHashVectorWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+
+public:
+    explicit CSigHashVectorWriter(std::vector<unsigned char>& vchIn) : vch(vchIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char* pch, size_t size) { vch.insert(vch.end(), pch, pch + size); }
+
+    template<typename T>
+    CSigHashVectorWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
     }
-    return ss.GetHash();
-}
+};
 
-uint256 GetOutputsHash(const CTransaction& txTo) {
-    CHashWriter ss(SER_GETHASH, 0);
-    for (const auto& txout : txTo.vout) {
-        ss << txout;
+/** Stream which hashes into a SHA256 state, so that it can be resumed from a midstate */
+class CSigHashSHA256Writer
+{
+private:
+    CSHA256& sha;
+
+public:
+    explicit CSigHashSHA256Writer(CSHA256& shaIn) : sha(shaIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char* pch, size_t size) { sha.Write((const unsigned char*)pch, size); }
+
+    template<typename T>
+    CSigHashSHA256Writer& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
     }
-    return ss.GetHash();
-}
+};
 
 } // namespace
 
 PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
 {
-    hashPrevouts = GetPrevoutHash(txTo);
-    hashSequence = GetSequenceHash(txTo);
-    hashOutputs = GetOutputsHash(txTo);
+    if (txTo.vin.size() < 2) {
+        // Nothing to share between inputs
+        return;
+    }
+
+    // Serialized for SIGHASH_ALL as if signing an input which doesn't exist, so that all scripts are blanked out
+    const CScript scriptCodeEmpty;
+    CTransactionSignatureSerializer txTmp(txTo, scriptCodeEmpty, txTo.vin.size(), SIGHASH_ALL);
+    CSigHashVectorWriter(vchBlankedTx) << txTmp;
+
+    const size_t nHeaderSize = 4 + GetSizeOfCompactSize(txTo.vin.size());
+    assert(vchBlankedTx.size() >= nHeaderSize + BLANKED_INPUT_SIZE * txTo.vin.size());
+
+    vInputMidstates.reserve(txTo.vin.size());
+    CSHA256 sha;
+    sha.Write(vchBlankedTx.data(), nHeaderSize);
+    for (size_t i = 0; i < txTo.vin.size(); i++) {
+        vInputMidstates.emplace_back(sha);
+        sha.Write(vchBlankedTx.data() + nHeaderSize + BLANKED_INPUT_SIZE * i, BLANKED_INPUT_SIZE);
+    }
+}
+
+/**
+ * Same as the serialization of CTransactionSignatureSerializer for SIGHASH_ALL (with or without
+ * SIGHASH_ANYONECANPAY), but only the input being signed is serialized. Everything else is hashed from the blanked
+ * serialization in cache, and the inputs in front of the signed one are not hashed again at all.
+ */
+static uint256 SignatureHashCached(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData& cache)
+{
+    const std::vector<unsigned char>& vch = cache.vchBlankedTx;
+    const size_t nHeaderSize = 4 + GetSizeOfCompactSize(txTo.vin.size());
+
+    CSHA256 sha;
+    size_t nSuffixPos;
+    if (nHashType & SIGHASH_ANYONECANPAY) {
+        // nVersion, followed by a single input and all outputs
+        sha.Write(vch.data(), 4);
+        CSigHashSHA256Writer s(sha);
+        ::WriteCompactSize(s, 1);
+        nSuffixPos = nHeaderSize + BLANKED_INPUT_SIZE * txTo.vin.size();
+    } else {
+        sha = cache.vInputMidstates[nIn];
+        nSuffixPos = nHeaderSize + BLANKED_INPUT_SIZE * (nIn + 1);
+    }
+
+    CSigHashSHA256Writer s(sha);
+    CTransactionSignatureSerializer(txTo, scriptCode, nIn, nHashType).SerializeInput(s, nIn);
+    sha.Write(vch.data() + nSuffixPos, vch.size() - nSuffixPos);
+    s << nHashType;
+
+    uint256 hash;
+    sha.Finalize(hash.begin());
+    CSHA256().Write(hash.begin(), CSHA256::OUTPUT_SIZE).Finalize(hash.begin());
+    return hash;
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1426,6 +1530,10 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
         }
     }
 
+    if (cache && !cache->vchBlankedTx.empty() && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        return SignatureHashCached(scriptCode, txTo, nIn, nHashType, *cache);
+    }
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
@@ -1551,7 +1659,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         return set_error(serror, SCRIPT_ERR_SIG_PUSHONLY);
     }
 
-    std::vector<std::vector<unsigned char> > stack, stackCopy;
+    CScriptStack stack, stackCopy;
     if (!EvalScript(stack, scriptSig, flags, checker, SigVersion::BASE, serror))
         // serror is set
         return false;
@@ -1581,7 +1689,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         assert(!stack.empty());
 
         const valtype& pubKeySerialized = stack.back();
-        CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
+        CScript pubKey2(pubKeySerialized.data(), pubKeySerialized.data() + pubKeySerialized.size());
         popstack(stack);
 
         if (!EvalScript(stack, pubKey2, flags, checker, SigVersion::BASE, serror))
@@ -6,6 +6,8 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include <crypto/sha256.h>
+#include <script/script.h>
 #include <script/script_error.h>
 #include <primitives/transaction.h>
 
@@ -100,11 +102,23 @@ enum
     SCRIPT_ENABLE_DIP0020_OPCODES = (1U << 15),
 };
 
-bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
+//! Implemented for std::vector<unsigned char> and CScriptStackElement
+template<typename T>
+bool CheckSignatureEncoding(const T &vchSig, unsigned int flags, ScriptError* serror);
+//! Implemented for std::vector<unsigned char> and CScriptStackElement
+template<typename T>
+bool CheckPubKeyEncoding(const T &vchPubKey, unsigned int flags, ScriptError* serror);
 
+/**
+ * Data shared by the signature hashes of all inputs of a transaction. Without it, every SIGHASH_ALL input serializes
+ * and hashes the whole transaction again, which is quadratic in the size of transactions with many inputs.
+ */
 struct PrecomputedTransactionData
 {
-    uint256 hashPrevouts, hashSequence, hashOutputs;
+    //! The transaction as serialized for SIGHASH_ALL with all input scripts blanked out, empty for a single input
+    std::vector<unsigned char> vchBlankedTx;
+    //! SHA256 states after hashing the part of vchBlankedTx in front of every input
+    std::vector<CSHA256> vInputMidstates;
 
     explicit PrecomputedTransactionData(const CTransaction& tx);
 };
@@ -166,6 +180,11 @@ public:
     MutableTransactionSignatureChecker(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amount) : TransactionSignatureChecker(&txTo, nInIn, amount), txTo(*txToIn) {}
 };
 
+/** Stack of the script interpreter, its elements are stored inline up to SCRIPT_STACK_ELEMENT_INLINE_SIZE */
+typedef std::vector<CScriptStackElement> CScriptStack;
+
+bool EvalScript(CScriptStack& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = nullptr);
+/** Same as above for callers which keep the stack as vectors, the elements are copied in and back out */
 bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = nullptr);
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* error = nullptr);
 
@@ -312,7 +312,8 @@ bool GetScriptOp(CScriptBase::const_iterator& pc, CScriptBase::const_iterator en
     return true;
 }
 
-bool CScriptNum::IsMinimallyEncoded(const std::vector<uint8_t>& vch, const size_t nMaxNumSize)
+template<typename T>
+bool CScriptNum::IsMinimallyEncoded(const T& vch, const size_t nMaxNumSize)
 {
     if (vch.size() > nMaxNumSize) {
         return false;
@@ -340,7 +341,11 @@ bool CScriptNum::IsMinimallyEncoded(const std::vector<uint8_t>& vch, const size_
     return true;
 }
 
-bool CScriptNum::MinimallyEncode(std::vector<uint8_t>& data)
+template bool CScriptNum::IsMinimallyEncoded(const std::vector<uint8_t>& vch, const size_t nMaxNumSize);
+template bool CScriptNum::IsMinimallyEncoded(const CScriptStackElement& vch, const size_t nMaxNumSize);
+
+template<typename T>
+bool CScriptNum::MinimallyEncode(T& data)
 {
     if (data.size() == 0) {
         return false;
@@ -386,3 +391,6 @@ bool CScriptNum::MinimallyEncode(std::vector<uint8_t>& data)
     data = {};
     return true;
 }
+
+template bool CScriptNum::MinimallyEncode(std::vector<uint8_t>& data);
+template bool CScriptNum::MinimallyEncode(CScriptStackElement& data);
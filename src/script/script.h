@@ -34,6 +34,13 @@ static const int MAX_SCRIPT_SIZE = 10000;
 // Maximum number of values on script interpreter stack
 static const int MAX_STACK_SIZE = 1000;
 
+// Stack elements of up to this size are stored inline, this covers every direct push (signatures, public keys,
+// hashes and numbers). Only larger elements need a heap allocation.
+static const unsigned int SCRIPT_STACK_ELEMENT_INLINE_SIZE = 75;
+
+/** Element of the script interpreter stack */
+typedef prevector<SCRIPT_STACK_ELEMENT_INLINE_SIZE, unsigned char> CScriptStackElement;
+
 // Threshold for nLockTime: below this value it is interpreted as block number,
 // otherwise as UNIX timestamp.
 static const unsigned int LOCKTIME_THRESHOLD = 500000000; // Tue Nov  5 00:53:20 1985 UTC
@@ -226,7 +233,9 @@ public:
 
     static const size_t nDefaultMaxNumSize = 4;
 
-    explicit CScriptNum(const std::vector<unsigned char>& vch, bool fRequireMinimal,
+    /** Decode a number from a std::vector<unsigned char> or a CScriptStackElement */
+    template<typename T>
+    explicit CScriptNum(const T& vch, bool fRequireMinimal,
                         const size_t nMaxNumSize = nDefaultMaxNumSize)
     {
         if (vch.size() > nMaxNumSize) {
@@ -238,11 +247,15 @@ public:
         m_value = set_vch(vch);
     }
 
+    //! Implemented for std::vector<uint8_t> and CScriptStackElement
+    template<typename T>
     static bool IsMinimallyEncoded(
-        const std::vector<uint8_t>& vch,
+        const T& vch,
         const size_t nMaxNumSize = nDefaultMaxNumSize);
 
-    static bool MinimallyEncode(std::vector<uint8_t> &data);
+    //! Implemented for std::vector<uint8_t> and CScriptStackElement
+    template<typename T>
+    static bool MinimallyEncode(T& data);
 
     inline bool operator==(const int64_t& rhs) const    { return m_value == rhs; }
     inline bool operator!=(const int64_t& rhs) const    { return m_value != rhs; }
@@ -319,17 +332,19 @@ public:
         return m_value;
     }
 
-    std::vector<unsigned char> getvch() const
+    template<typename T = std::vector<unsigned char>>
+    T getvch() const
     {
-        return serialize(m_value);
+        return serialize<T>(m_value);
     }
 
-    static std::vector<unsigned char> serialize(const int64_t& value)
+    template<typename T = std::vector<unsigned char>>
+    static T serialize(const int64_t& value)
     {
         if(value == 0)
-            return std::vector<unsigned char>();
+            return T();
 
-        std::vector<unsigned char> result;
+        T result;
         const bool neg = value < 0;
         uint64_t absvalue = neg ? -value : value;
 
@@ -358,7 +373,8 @@ public:
     }
 
 private:
-    static int64_t set_vch(const std::vector<unsigned char>& vch)
+    template<typename T>
+    static int64_t set_vch(const T& vch)
     {
       if (vch.empty())
           return 0;
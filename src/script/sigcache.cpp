@@ -5,15 +5,95 @@
 
 #include <script/sigcache.h>
 
+#include <clientversion.h>
 #include <memusage.h>
 #include <pubkey.h>
 #include <random.h>
+#include <streams.h>
 #include <uint256.h>
 #include <util.h>
+#include <utiltime.h>
 
 #include <cuckoocache.h>
 #include <boost/thread.hpp>
 
+static const uint64_t SIG_CACHE_DUMP_VERSION = 1;
+
+CSignatureCacheStats GetSignatureCacheStats(const SignatureCacheMap& cache, const std::atomic<uint64_t>& nHits, const std::atomic<uint64_t>& nMisses)
+{
+    CSignatureCacheStats stats;
+    stats.nCapacity = cache.capacity();
+    cache.for_each([&](const uint256&) { stats.nEntries++; });
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    return stats;
+}
+
+bool DumpSignatureCacheFile(const SignatureCacheMap& cache, const uint256& nonce, const fs::path& path)
+{
+    int64_t nStart = GetTimeMillis();
+    fs::path pathTmp = path;
+    pathTmp += ".new";
+    try {
+        CAutoFile file(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return false;
+        }
+        uint64_t nEntries = 0;
+        cache.for_each([&](const uint256&) { nEntries++; });
+        file << SIG_CACHE_DUMP_VERSION << nonce << nEntries;
+        cache.for_each([&](const uint256& entry) { file << entry; });
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+        file.fclose();
+        RenameOver(pathTmp, path);
+        LogPrintf("Dumped %u entries to %s in %dms\n", nEntries, path.filename().string(), GetTimeMillis() - nStart);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump %s: %s. Continuing anyway.\n", path.filename().string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadSignatureCacheFile(SignatureCacheMap& cache, uint256& nonceRet, const fs::path& path)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open %s. Continuing anyway.\n", path.filename().string());
+        return false;
+    }
+    uint64_t nEntries = 0;
+    try {
+        uint64_t nVersion;
+        file >> nVersion;
+        if (nVersion != SIG_CACHE_DUMP_VERSION) {
+            return false;
+        }
+        uint256 nonce;
+        file >> nonce >> nEntries;
+        // Only switch to the nonce of the file if it can be read completely
+        std::vector<uint256> entries;
+        entries.reserve(std::min<uint64_t>(nEntries, cache.capacity()));
+        uint256 entry;
+        for (uint64_t i = 0; i < nEntries; i++) {
+            file >> entry;
+            if (entries.size() < cache.capacity()) {
+                entries.emplace_back(entry);
+            }
+        }
+        nonceRet = nonce;
+        for (auto& entry : entries) {
+            cache.insert(entry);
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize %s: %s. Continuing anyway.\n", path.filename().string(), e.what());
+        return false;
+    }
+    LogPrintf("Loaded %u entries from %s\n", nEntries, path.filename().string());
+    return true;
+}
+
 namespace {
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
@@ -30,6 +110,9 @@ private:
     boost::shared_mutex cs_sigcache;
 
 public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
     CSignatureCache()
     {
         GetRandBytes(nonce.begin(), 32);
@@ -57,6 +140,24 @@ public:
     {
         return setValid.setup_bytes(n);
     }
+
+    bool Dump(const fs::path& path)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return DumpSignatureCacheFile(setValid, nonce, path);
+    }
+
+    bool Load(const fs::path& path)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        return LoadSignatureCacheFile(setValid, nonce, path);
+    }
+
+    CSignatureCacheStats GetStats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return GetSignatureCacheStats(setValid, nHits, nMisses);
+    }
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -84,11 +185,29 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
 {
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
-    if (signatureCache.Get(entry, !store))
+    if (signatureCache.Get(entry, !store)) {
+        signatureCache.nHits.fetch_add(1, std::memory_order_relaxed);
         return true;
+    }
+    signatureCache.nMisses.fetch_add(1, std::memory_order_relaxed);
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
     if (store)
         signatureCache.Set(entry);
     return true;
 }
+
+bool DumpSignatureCache()
+{
+    return signatureCache.Dump(GetDataDir() / "sigcache.dat");
+}
+
+bool LoadSignatureCache()
+{
+    return signatureCache.Load(GetDataDir() / "sigcache.dat");
+}
+
+CSignatureCacheStats GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
+}
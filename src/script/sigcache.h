@@ -6,8 +6,11 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include <cuckoocache.h>
+#include <fs.h>
 #include <script/interpreter.h>
 
+#include <atomic>
 #include <vector>
 
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
@@ -16,6 +19,8 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+//! Default for -persistsigcache
+static const bool DEFAULT_PERSIST_SIG_CACHE = false;
 
 class CPubKey;
 
@@ -40,6 +45,28 @@ public:
     }
 };
 
+typedef CuckooCache::cache<uint256, SignatureCacheHasher> SignatureCacheMap;
+
+/** Usage of the signature or script execution cache */
+struct CSignatureCacheStats
+{
+    uint64_t nCapacity{0};
+    uint64_t nEntries{0};
+    uint64_t nHits{0};
+    uint64_t nMisses{0};
+};
+
+CSignatureCacheStats GetSignatureCacheStats(const SignatureCacheMap& cache, const std::atomic<uint64_t>& nHits, const std::atomic<uint64_t>& nMisses);
+
+/**
+ * Write the entries of a cache and the nonce they are computed with to a file. The nonce is as secret as the
+ * entries are, so it's fine to store it next to them.
+ */
+bool DumpSignatureCacheFile(const SignatureCacheMap& cache, const uint256& nonce, const fs::path& path);
+
+/** Read a file written by DumpSignatureCacheFile(), the entries are only valid with nonceRet */
+bool LoadSignatureCacheFile(SignatureCacheMap& cache, uint256& nonceRet, const fs::path& path);
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -53,4 +80,10 @@ public:
 
 void InitSignatureCache();
 
+/** Save the signature cache to the data directory, for -persistsigcache */
+bool DumpSignatureCache();
+/** Load the signature cache saved by DumpSignatureCache(), must be called before the cache is used */
+bool LoadSignatureCache();
+CSignatureCacheStats GetSignatureCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -34,20 +34,21 @@ CSporkManager::CSporkManager()
         sporkDefsById.emplace(sporkDef.sporkId, &sporkDef);
         sporkDefsByName.emplace(sporkDef.name, &sporkDef);
     }
+
+    // no spork messages are known yet, so all sporks start with their default values
+    auto newSnapshot = std::make_shared<CSporkSnapshot>();
+    for (const auto& sporkDef : sporkDefs) {
+        newSnapshot->mapEntries.emplace(std::piecewise_construct, std::forward_as_tuple(sporkDef.sporkId), std::forward_as_tuple(sporkDef.defaultValue));
+    }
+    snapshot = std::move(newSnapshot);
 }
 
 bool CSporkManager::SporkValueIsActive(SporkId nSporkID, int64_t &nActiveValueRet) const
 {
-    LOCK(cs);
+    AssertLockHeld(cs);
 
     if (!mapSporksActive.count(nSporkID)) return false;
 
-    auto it = mapSporksCachedValues.find(nSporkID);
-    if (it != mapSporksCachedValues.end()) {
-        nActiveValueRet = it->second;
-        return true;
-    }
-
     // calc how many values we have and how many signers vote for every value
     std::unordered_map<int64_t, int> mapValueCounts;
     for (const auto& pair: mapSporksActive.at(nSporkID)) {
@@ -56,7 +57,6 @@ bool CSporkManager::SporkValueIsActive(SporkId nSporkID, int64_t &nActiveValueRe
             // nMinSporkKeys is always more than the half of the max spork keys number,
             // so there is only one such value and we can stop here
             nActiveValueRet = pair.second.nValue;
-            mapSporksCachedValues[nSporkID] = nActiveValueRet;
             return true;
         }
     }
@@ -64,11 +64,25 @@ bool CSporkManager::SporkValueIsActive(SporkId nSporkID, int64_t &nActiveValueRe
     return false;
 }
 
+void CSporkManager::UpdateSnapshot()
+{
+    AssertLockHeld(cs);
+
+    auto newSnapshot = std::make_shared<CSporkSnapshot>();
+    for (const auto& sporkDef : sporkDefs) {
+        int64_t nValue = sporkDef.defaultValue;
+        SporkValueIsActive(sporkDef.sporkId, nValue);
+        newSnapshot->mapEntries.emplace(std::piecewise_construct, std::forward_as_tuple(sporkDef.sporkId), std::forward_as_tuple(nValue));
+    }
+    std::atomic_store(&snapshot, std::shared_ptr<const CSporkSnapshot>(std::move(newSnapshot)));
+}
+
 void CSporkManager::Clear()
 {
     LOCK(cs);
     mapSporksActive.clear();
     mapSporksByHash.clear();
+    UpdateSnapshot();
     // sporkPubKeyID and sporkPrivKey should be set in init.cpp,
     // we should not alter them here.
 }
@@ -114,9 +128,11 @@ void CSporkManager::CheckAndRemove()
         }
         ++itByHash;
     }
+
+    UpdateSnapshot();
 }
 
-void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
+void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman)
 {
 
     if (strCommand == NetMsgType::SPORK) {
@@ -173,9 +189,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             LOCK(cs); // make sure to not lock this together with cs_main
             mapSporksByHash[hash] = spork;
             mapSporksActive[spork.nSporkID][keyIDSigner] = spork;
-            // Clear cached values on new spork being processed
-            mapSporksCachedActive.erase(spork.nSporkID);
-            mapSporksCachedValues.erase(spork.nSporkID);
+            UpdateSnapshot();
         }
         spork.Relay(connman);
 
@@ -211,9 +225,7 @@ bool CSporkManager::UpdateSpork(SporkId nSporkID, int64_t nValue, CConnman& conn
         LOCK(cs);
         mapSporksByHash[spork.GetHash()] = spork;
         mapSporksActive[nSporkID][keyIDSigner] = spork;
-        // Clear cached values on new spork being processed
-        mapSporksCachedActive.erase(spork.nSporkID);
-        mapSporksCachedValues.erase(spork.nSporkID);
+        UpdateSnapshot();
     }
 
     spork.Relay(connman);
@@ -222,35 +234,32 @@ bool CSporkManager::UpdateSpork(SporkId nSporkID, int64_t nValue, CConnman& conn
 
 bool CSporkManager::IsSporkActive(SporkId nSporkID) const
 {
-    LOCK(cs);
-    // If nSporkID is cached, and the cached value is true, then return early true
-    auto it = mapSporksCachedActive.find(nSporkID);
-    if (it != mapSporksCachedActive.end() && it->second) {
+    auto currentSnapshot = std::atomic_load(&snapshot);
+    auto it = currentSnapshot->mapEntries.find(nSporkID);
+    if (it == currentSnapshot->mapEntries.end()) {
+        return GetSporkValue(nSporkID) < GetAdjustedTime();
+    }
+
+    const auto& entry = it->second;
+    if (entry.fActive) {
         return true;
     }
 
-    int64_t nSporkValue = GetSporkValue(nSporkID);
     // Get time is somewhat costly it looks like
-    bool ret = nSporkValue < GetAdjustedTime();
+    bool ret = entry.nValue < GetAdjustedTime();
     // Only cache true values
     if (ret) {
-        mapSporksCachedActive[nSporkID] = ret;
+        entry.fActive = true;
     }
     return ret;
 }
 
 int64_t CSporkManager::GetSporkValue(SporkId nSporkID) const
 {
-    LOCK(cs);
-
-    int64_t nSporkValue = -1;
-    if (SporkValueIsActive(nSporkID, nSporkValue)) {
-        return nSporkValue;
-    }
-
-    auto it = sporkDefsById.find(nSporkID);
-    if (it != sporkDefsById.end()) {
-        return it->second->defaultValue;
+    auto currentSnapshot = std::atomic_load(&snapshot);
+    auto it = currentSnapshot->mapEntries.find(nSporkID);
+    if (it != currentSnapshot->mapEntries.end()) {
+        return it->second.nValue;
     }
 
     LogPrint(BCLog::SPORK, "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
@@ -310,7 +319,9 @@ bool CSporkManager::SetMinSporkKeys(int minSporkKeys)
         LogPrintf("CSporkManager::SetMinSporkKeys -- Invalid min spork signers number: %d\n", minSporkKeys);
         return false;
     }
+    LOCK(cs);
     nMinSporkKeys = minSporkKeys;
+    UpdateSnapshot();
     return true;
 }
 
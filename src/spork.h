@@ -10,6 +10,8 @@
 #include <utilstrencodings.h>
 #include <key.h>
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -156,8 +158,25 @@ private:
     std::unordered_map<SporkId, CSporkDef*> sporkDefsById;
     std::unordered_map<std::string, CSporkDef*> sporkDefsByName;
 
-    mutable std::unordered_map<SporkId, bool> mapSporksCachedActive;
-    mutable std::unordered_map<SporkId, int64_t> mapSporksCachedValues;
+    /**
+     * Immutable snapshot of the values of all sporks, hot paths read it without taking cs. A new snapshot is built
+     * and swapped in whenever the set of spork messages changes.
+     */
+    struct CSporkSnapshot
+    {
+        struct Entry
+        {
+            int64_t nValue;
+            // time based sporks never become inactive again (as long as the value doesn't change), so once we saw
+            // it active we can skip the GetAdjustedTime() call for it
+            mutable std::atomic<bool> fActive{false};
+
+            explicit Entry(int64_t nValueIn) : nValue(nValueIn) {}
+        };
+        std::unordered_map<SporkId, Entry> mapEntries;
+    };
+    // only accessed through std::atomic_load/std::atomic_store
+    std::shared_ptr<const CSporkSnapshot> snapshot;
 
     mutable CCriticalSection cs;
     std::unordered_map<uint256, CSporkMessage> mapSporksByHash;
@@ -173,6 +192,12 @@ private:
      */
     bool SporkValueIsActive(SporkId nSporkID, int64_t& nActiveValueRet) const;
 
+    /**
+     * UpdateSnapshot rebuilds the spork snapshot from the current spork messages
+     * and publishes it to readers of IsSporkActive and GetSporkValue.
+     */
+    void UpdateSnapshot();
+
 public:
 
     CSporkManager();
@@ -198,6 +223,9 @@ public:
         READWRITE(mapSporksByHash);
         READWRITE(mapSporksActive);
         // we don't serialize private key to prevent its leakage
+        if (ser_action.ForRead()) {
+            UpdateSnapshot();
+        }
     }
 
     /**
@@ -225,7 +253,7 @@ public:
      * it validates the spork and adds it to the internal spork storage and
      * performs any necessary processing.
      */
-    void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    void ProcessSpork(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, CConnman& connman);
 
     /**
      * UpdateSpork is used by the spork RPC command to set a new spork value, sign
@@ -371,6 +371,18 @@ static std::vector<stackframe_info> GetStackFrameInfos(const std::vector<uint64_
 }
 #endif // ENABLE_STACKTRACES
 
+std::vector<std::string> GetStackFrameFunctionNames(uint64_t pc)
+{
+    std::vector<std::string> names;
+    for (const auto& si : GetStackFrameInfos({pc})) {
+        if (si.function.empty()) {
+            break;
+        }
+        names.emplace_back(si.function);
+    }
+    return names;
+}
+
 struct crash_info_header
 {
     std::string magic;
@@ -5,9 +5,11 @@
 #ifndef BITCOIN_STACKTRACES_H
 #define BITCOIN_STACKTRACES_H
 
+#include <stdint.h>
 #include <string>
 #include <sstream>
 #include <exception>
+#include <vector>
 
 #include <cxxabi.h>
 
@@ -15,6 +17,9 @@
 
 std::string DemangleSymbol(const std::string& name);
 
+/** Demangled names of the function at pc and of the functions inlined into it, innermost first. Empty without debug info */
+std::vector<std::string> GetStackFrameFunctionNames(uint64_t pc);
+
 std::string GetPrettyExceptionStr(const std::exception_ptr& e);
 std::string GetCrashInfoStrFromSerializedStr(const std::string& ciStr);
 
@@ -40,6 +40,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 statsd::StatsdClient statsClient;
 
 namespace statsd {
@@ -63,6 +72,35 @@ inline bool should_send(float sample_rate)
     return sample_rate > p;
 }
 
+/**
+ * Metrics of one thread which were not sent yet. Counters are summed up, timings are kept one by one so the statsd
+ * server can still compute percentiles, for gauges only the last value matters. Keys stay in the maps after a flush,
+ * so adding to a known counter or timing doesn't allocate.
+ */
+struct StatsdBuffer {
+    std::mutex mutex;
+    //! set when the thread exited, the buffer is dropped after its next flush
+    bool orphaned{false};
+
+    std::unordered_map<std::string, int64_t> counts;
+    std::unordered_map<std::string, std::vector<std::pair<size_t, float>>> timings;
+    std::unordered_map<std::string, std::string> gauges;
+};
+
+struct StatsdThreadBuffer {
+    std::shared_ptr<StatsdBuffer> buffer;
+
+    ~StatsdThreadBuffer()
+    {
+        if (buffer) {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            buffer->orphaned = true;
+        }
+    }
+};
+
+static thread_local StatsdThreadBuffer g_thread_buffer;
+
 struct _StatsdClientData {
     SOCKET  sock;
     struct  sockaddr_in server;
@@ -74,6 +112,15 @@ struct _StatsdClientData {
     bool    init;
 
     char    errmsg[1024];
+
+    std::atomic<bool> batching{false};
+    std::mutex buffers_mutex;
+    std::vector<std::shared_ptr<StatsdBuffer>> buffers;
+
+    std::thread flush_thread;
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+    bool stop{false};
 };
 
 StatsdClient::StatsdClient(const std::string& host, int port, const std::string& ns)
@@ -85,6 +132,7 @@ StatsdClient::StatsdClient(const std::string& host, int port, const std::string&
 
 StatsdClient::~StatsdClient()
 {
+    Stop();
     // close socket
     CloseSocket(d->sock);
     delete d;
@@ -100,6 +148,122 @@ void StatsdClient::config(const std::string& host, int port, const std::string&
     CloseSocket(d->sock);
 }
 
+void StatsdClient::Start()
+{
+    if (d->flush_thread.joinable()) {
+        return;
+    }
+    d->stop = false;
+    d->batching = true;
+    d->flush_thread = std::thread(&TraceThread<std::function<void()> >, "statsd", std::function<void()>(std::bind(&StatsdClient::threadFlush, this)));
+}
+
+void StatsdClient::Stop()
+{
+    if (!d->flush_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(d->flush_mutex);
+        d->stop = true;
+    }
+    d->flush_cv.notify_all();
+    d->flush_thread.join();
+    d->batching = false;
+    // metrics which were added while the thread was stopping
+    flush();
+}
+
+void StatsdClient::threadFlush()
+{
+    std::unique_lock<std::mutex> lock(d->flush_mutex);
+    while (!d->stop) {
+        d->flush_cv.wait_for(lock, std::chrono::milliseconds(STATSD_FLUSH_INTERVAL), [this] { return d->stop; });
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+StatsdBuffer* StatsdClient::threadBuffer()
+{
+    if (!g_thread_buffer.buffer) {
+        g_thread_buffer.buffer = std::make_shared<StatsdBuffer>();
+        std::lock_guard<std::mutex> lock(d->buffers_mutex);
+        d->buffers.emplace_back(g_thread_buffer.buffer);
+    }
+    return g_thread_buffer.buffer.get();
+}
+
+void StatsdClient::flush()
+{
+    std::unordered_map<std::string, int64_t> counts;
+    std::unordered_map<std::string, std::vector<std::pair<size_t, float>>> timings;
+    std::unordered_map<std::string, std::string> gauges;
+    {
+        std::lock_guard<std::mutex> lock(d->buffers_mutex);
+        for (auto it = d->buffers.begin(); it != d->buffers.end(); ) {
+            StatsdBuffer& buffer = **it;
+            bool fOrphaned;
+            {
+                std::lock_guard<std::mutex> bufferLock(buffer.mutex);
+                for (auto& p : buffer.counts) {
+                    if (p.second != 0) {
+                        counts[p.first] += p.second;
+                        p.second = 0;
+                    }
+                }
+                for (auto& p : buffer.timings) {
+                    if (!p.second.empty()) {
+                        auto& samples = timings[p.first];
+                        samples.insert(samples.end(), p.second.begin(), p.second.end());
+                        p.second.clear();
+                    }
+                }
+                for (auto& p : buffer.gauges) {
+                    gauges[p.first] = std::move(p.second);
+                }
+                buffer.gauges.clear();
+                fOrphaned = buffer.orphaned;
+            }
+            it = fOrphaned ? d->buffers.erase(it) : std::next(it);
+        }
+    }
+
+    if (counts.empty() && timings.empty() && gauges.empty()) {
+        return;
+    }
+    if (init()) {
+        return;
+    }
+
+    std::string packet;
+    auto add = [&](const std::string& line) {
+        if (!packet.empty() && packet.size() + 1 + line.size() > STATSD_MAX_PACKET_SIZE) {
+            send(packet);
+            packet.clear();
+        }
+        if (!packet.empty()) {
+            packet += '\n';
+        }
+        packet += line;
+    };
+    for (const auto& p : counts) {
+        add(format(p.first, std::to_string(p.second), "c", 1.0));
+    }
+    for (const auto& p : timings) {
+        for (const auto& sample : p.second) {
+            add(format(p.first, std::to_string(sample.first), "ms", sample.second));
+        }
+    }
+    for (const auto& p : gauges) {
+        add(format(p.first, p.second, "g", 1.0));
+    }
+    if (!packet.empty()) {
+        send(packet);
+    }
+}
+
 int StatsdClient::init()
 {
     static bool fEnabled = gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE);
@@ -156,22 +320,81 @@ int StatsdClient::inc(const std::string& key, float sample_rate)
 
 int StatsdClient::count(const std::string& key, size_t value, float sample_rate)
 {
-    return send(key, value, "c", sample_rate);
+    if (!d->batching) {
+        return send(key, value, "c", sample_rate);
+    }
+    if (!should_send(sample_rate)) {
+        return 0;
+    }
+
+    StatsdBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    // sampled counts are scaled up, so the aggregated count is sent without a sample rate
+    buffer->counts[key] += fequal(sample_rate, 1.0) ? (int64_t)value : llround((int64_t)value / sample_rate);
+    return 0;
 }
 
 int StatsdClient::gauge(const std::string& key, size_t value, float sample_rate)
 {
-    return send(key, value, "g", sample_rate);
+    if (!d->batching) {
+        return send(key, value, "g", sample_rate);
+    }
+    if (!should_send(sample_rate)) {
+        return 0;
+    }
+
+    StatsdBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->gauges[key] = std::to_string((int64_t)value);
+    return 0;
 }
 
 int StatsdClient::gaugeDouble(const std::string& key, double value, float sample_rate)
 {
-    return sendDouble(key, value, "g", sample_rate);
+    if (!d->batching) {
+        return sendDouble(key, value, "g", sample_rate);
+    }
+    if (!should_send(sample_rate)) {
+        return 0;
+    }
+
+    StatsdBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->gauges[key] = std::to_string(value);
+    return 0;
 }
 
 int StatsdClient::timing(const std::string& key, size_t ms, float sample_rate)
 {
-    return send(key, ms, "ms", sample_rate);
+    if (!d->batching) {
+        return send(key, ms, "ms", sample_rate);
+    }
+    if (!should_send(sample_rate)) {
+        return 0;
+    }
+
+    StatsdBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    auto& samples = buffer->timings[key];
+    if (samples.size() < STATSD_MAX_TIMINGS_PER_KEY) {
+        samples.emplace_back(ms, sample_rate);
+    }
+    return 0;
+}
+
+std::string StatsdClient::format(std::string key, const std::string& value, const std::string& type, float sample_rate)
+{
+    // partition stats by node name if set
+    if (!d->nodename.empty())
+        key = key + "." + d->nodename;
+
+    cleanup(key);
+
+    std::string line = d->ns + key + ":" + value + "|" + type;
+    if (!fequal(sample_rate, 1.0)) {
+        line += strprintf("|@%.2f", sample_rate);
+    }
+    return line;
 }
 
 int StatsdClient::send(std::string key, size_t value, const std::string& type, float sample_rate)
@@ -13,16 +13,35 @@ static const std::string DEFAULT_STATSD_NAMESPACE = "";
 static const int DEFAULT_STATSD_PERIOD = 60;
 static const int MIN_STATSD_PERIOD = 5;
 static const int MAX_STATSD_PERIOD = 60 * 60;
+//! number of lock sites, the ones with the most wait time, which are reported every period
+static const size_t STATSD_MAX_LOCK_SITES = 20;
+
+// batching: metrics are aggregated per thread and sent in packets of up to STATSD_MAX_PACKET_SIZE bytes every
+// STATSD_FLUSH_INTERVAL milliseconds
+static const int64_t STATSD_FLUSH_INTERVAL = 1000;
+static const size_t STATSD_MAX_PACKET_SIZE = 1432;
+//! timings of a single key kept per flush interval and thread, further ones are dropped
+static const size_t STATSD_MAX_TIMINGS_PER_KEY = 1000;
 
 namespace statsd {
 
 struct _StatsdClientData;
+struct StatsdBuffer;
 
 class StatsdClient {
     public:
         StatsdClient(const std::string& host = DEFAULT_STATSD_HOST, int port = DEFAULT_STATSD_PORT, const std::string& ns = DEFAULT_STATSD_NAMESPACE);
         ~StatsdClient();
 
+    public:
+        /**
+         * Start aggregating metrics in per thread buffers which a background thread flushes as multi-metric packets.
+         * Before Start and after Stop every metric is sent right away.
+         */
+        void Start();
+        /** Flush the buffered metrics and stop the background thread */
+        void Stop();
+
     public:
         // you can config at anytime; client will use new address (useful for Singleton)
         void config(const std::string& host, int port, const std::string& ns = DEFAULT_STATSD_NAMESPACE);
@@ -54,6 +73,11 @@ class StatsdClient {
     protected:
         int init();
         void cleanup(std::string& key);
+        std::string format(std::string key, const std::string& value, const std::string& type, float sample_rate);
+
+        StatsdBuffer* threadBuffer();
+        void threadFlush();
+        void flush();
 
     protected:
         struct _StatsdClientData* d;
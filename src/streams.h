@@ -8,6 +8,7 @@
 
 #include <support/allocators/zeroafterfree.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -169,15 +170,107 @@ public:
     }
 };
 
+/** Minimal stream for reading from an unowned, contiguous buffer. Other than CDataStream, reading does not modify or
+ * free the underlying buffer, so pointers into it obtained through data() stay valid as long as the buffer does.
+ */
+class SpanReader
+{
+private:
+    const int m_type;
+    const int m_version;
+    Span<const unsigned char> m_data;
+    size_t m_pos = 0;
+
+public:
+    SpanReader(int type, int version, Span<const unsigned char> data)
+        : m_type(type), m_version(version), m_data(data)
+    {
+    }
+
+    template<typename T>
+    SpanReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return m_version; }
+    int GetType() const { return m_type; }
+
+    size_t size() const { return m_data.size() - m_pos; }
+    bool empty() const { return size() == 0; }
+    const unsigned char* data() const { return m_data.data() + m_pos; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        if (n > size()) {
+            throw std::ios_base::failure("SpanReader::read(): end of data");
+        }
+        memcpy(dst, data(), n);
+        m_pos += n;
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > size()) {
+            throw std::ios_base::failure("SpanReader::ignore(): end of data");
+        }
+        m_pos += n;
+    }
+};
+
+/** Reads the elements of a serialized vector one at a time from a SpanReader instead of materializing the whole
+ * vector. The element count is known before any element is read, so the caller can reject oversized messages before
+ * anything is allocated. When nMinElementSize is given, counts which can't possibly fit into the remaining data are
+ * rejected right away as well.
+ */
+template<typename T>
+class VectorElementReader
+{
+private:
+    SpanReader& m_reader;
+    size_t m_count;
+    size_t m_read = 0;
+
+public:
+    explicit VectorElementReader(SpanReader& reader, size_t nMinElementSize = 0)
+        : m_reader(reader), m_count(ReadCompactSize(reader))
+    {
+        if (nMinElementSize != 0 && m_count > reader.size() / nMinElementSize) {
+            throw std::ios_base::failure("VectorElementReader: end of data");
+        }
+    }
+
+    size_t size() const { return m_count; }
+
+    /** Deserialize the next element into obj, which can be reused between calls. Returns false once all elements were read */
+    bool Next(T& obj)
+    {
+        if (m_read == m_count) {
+            return false;
+        }
+        m_reader >> obj;
+        m_read++;
+        return true;
+    }
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
  * Fills with data in linear time; some stringstream implementations take N^2 time.
+ *
+ * SerializeData is the type of the buffer, see CDataStream and CPublicDataStream below.
  */
-class CDataStream
+template <typename SerializeData>
+class CBaseDataStream
 {
 protected:
-    typedef CSerializeData vector_type;
+    typedef SerializeData vector_type;
     vector_type vch;
     unsigned int nReadPos;
 
@@ -185,48 +278,45 @@ protected:
     int nVersion;
 public:
 
-    typedef vector_type::allocator_type   allocator_type;
-    typedef vector_type::size_type        size_type;
-    typedef vector_type::difference_type  difference_type;
-    typedef vector_type::reference        reference;
-    typedef vector_type::const_reference  const_reference;
-    typedef vector_type::value_type       value_type;
-    typedef vector_type::iterator         iterator;
-    typedef vector_type::const_iterator   const_iterator;
-    typedef vector_type::reverse_iterator reverse_iterator;
+    typedef typename vector_type::allocator_type   allocator_type;
+    typedef typename vector_type::size_type        size_type;
+    typedef typename vector_type::difference_type  difference_type;
+    typedef typename vector_type::reference        reference;
+    typedef typename vector_type::const_reference  const_reference;
+    typedef typename vector_type::value_type       value_type;
+    typedef typename vector_type::iterator         iterator;
+    typedef typename vector_type::const_iterator   const_iterator;
+    typedef typename vector_type::reverse_iterator reverse_iterator;
 
-    explicit CDataStream(int nTypeIn, int nVersionIn)
+    explicit CBaseDataStream(int nTypeIn, int nVersionIn)
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const_iterator pbegin, const_iterator pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
+    CBaseDataStream(const_iterator pbegin, const_iterator pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const char* pbegin, const char* pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
+    CBaseDataStream(const char* pbegin, const char* pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const vector_type& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
+    // Accepts the buffers of both stream types
+    template <typename Alloc>
+    CBaseDataStream(const std::vector<char, Alloc>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const std::vector<char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
-    {
-        Init(nTypeIn, nVersionIn);
-    }
-
-    CDataStream(const std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
+    CBaseDataStream(const std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
     {
         Init(nTypeIn, nVersionIn);
     }
 
     template <typename... Args>
-    CDataStream(int nTypeIn, int nVersionIn, Args&&... args)
+    CBaseDataStream(int nTypeIn, int nVersionIn, Args&&... args)
     {
         Init(nTypeIn, nVersionIn);
         ::SerializeMany(*this, std::forward<Args>(args)...);
@@ -239,15 +329,15 @@ public:
         nVersion = nVersionIn;
     }
 
-    CDataStream& operator+=(const CDataStream& b)
+    CBaseDataStream& operator+=(const CBaseDataStream& b)
     {
         vch.insert(vch.end(), b.begin(), b.end());
         return *this;
     }
 
-    friend CDataStream operator+(const CDataStream& a, const CDataStream& b)
+    friend CBaseDataStream operator+(const CBaseDataStream& a, const CBaseDataStream& b)
     {
-        CDataStream ret = a;
+        CBaseDataStream ret = a;
         ret += b;
         return (ret);
     }
@@ -362,7 +452,7 @@ public:
     // Stream subset
     //
     bool eof() const             { return size() == 0; }
-    CDataStream* rdbuf()         { return this; }
+    CBaseDataStream* rdbuf()         { return this; }
     int in_avail() const         { return size(); }
 
     void SetType(int n)          { nType = n; }
@@ -422,7 +512,7 @@ public:
     }
 
     template<typename T>
-    CDataStream& operator<<(const T& obj)
+    CBaseDataStream& operator<<(const T& obj)
     {
         // Serialize to this stream
         ::Serialize(*this, obj);
@@ -430,18 +520,24 @@ public:
     }
 
     template<typename T>
-    CDataStream& operator>>(T&& obj)
+    CBaseDataStream& operator>>(T&& obj)
     {
         // Unserialize from this stream
         ::Unserialize(*this, obj);
         return (*this);
     }
 
-    void GetAndClear(CSerializeData &d) {
+    void GetAndClear(vector_type &d) {
         d.insert(d.end(), begin(), end());
         clear();
     }
 
+    /** Exchange the underlying buffer with d (including its capacity) and reset the read position */
+    void SwapData(vector_type &d) {
+        vch.swap(d);
+        nReadPos = 0;
+    }
+
     /**
      * XOR the contents of this stream with a certain key.
      *
@@ -466,6 +562,27 @@ public:
     }
 };
 
+/** Stream for data which may contain secrets, e.g. keys and wallet records. Its buffer is zeroed when freed. */
+typedef CBaseDataStream<CSerializeData> CDataStream;
+
+/** Buffer of a CPublicDataStream */
+typedef std::vector<char> CPublicSerializeData;
+
+/**
+ * Stream for public data, e.g. network messages and database records which don't contain secrets. Its buffer is not
+ * zeroed when freed, which saves a pass over the memory on every free.
+ */
+typedef CBaseDataStream<CPublicSerializeData> CPublicDataStream;
+
+/** SpanReader over the unread part of a CDataStream. The stream itself is left untouched, so views obtained through
+ * the reader stay valid as long as the stream isn't modified
+ */
+template <typename SerializeData>
+inline SpanReader MakeSpanReader(const CBaseDataStream<SerializeData>& s)
+{
+    return SpanReader(s.GetType(), s.GetVersion(), Span<const unsigned char>((const unsigned char*)s.data(), s.size()));
+}
+
 template <typename IStream>
 class BitStreamReader
 {
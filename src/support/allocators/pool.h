@@ -0,0 +1,190 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+//
+// Memory resource which serves small allocations out of large chunks, keeping one free list per allocation size.
+// Memory is only returned to the system when the resource is destroyed, which makes it a good fit for node based
+// containers which are cleared as a whole from time to time (e.g. the coins cache on flush): the nodes are not
+// freed one by one and they don't fragment the heap. Allocations which are larger than MAX_BLOCK_SIZE_BYTES or
+// more strictly aligned than ALIGN_BYTES (e.g. the bucket array of an unordered_map) are forwarded to ::operator new.
+// This resource is NOT thread safe.
+//
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource final
+{
+    static_assert(ALIGN_BYTES > 0, "ALIGN_BYTES must be nonzero");
+    static_assert((ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    /** Freed blocks are kept in singly linked lists, the link is stored in the freed memory itself */
+    struct ListNode {
+        ListNode* next;
+    };
+
+    /** All block sizes are a multiple of this, which is large enough to hold a ListNode */
+    static constexpr std::size_t ELEM_ALIGN_BYTES = std::max(alignof(ListNode), ALIGN_BYTES);
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "a ListNode must fit into the smallest block");
+    static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "chunks from ::operator new must be aligned enough");
+
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static constexpr bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<void*> m_allocated_chunks;
+    //! m_free_lists[n] holds freed blocks of n * ELEM_ALIGN_BYTES bytes
+    std::array<ListNode*, MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1> m_free_lists{};
+    //! Not yet used part of the most recently allocated chunk
+    char* m_available_memory_it{nullptr};
+    char* m_available_memory_end{nullptr};
+
+    void PushFree(void* p, std::size_t num_alignments)
+    {
+        ListNode* node = new (p) ListNode{m_free_lists[num_alignments]};
+        m_free_lists[num_alignments] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Make the remainder of the current chunk available through its free list, so no memory is lost
+        if (m_available_memory_it != m_available_memory_end) {
+            const std::size_t remaining = m_available_memory_end - m_available_memory_it;
+            PushFree(m_available_memory_it, remaining / ELEM_ALIGN_BYTES);
+        }
+        void* chunk = ::operator new(m_chunk_size_bytes);
+        m_allocated_chunks.emplace_back(chunk);
+        m_available_memory_it = static_cast<char*>(chunk);
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+    }
+
+public:
+    /** chunk_size_bytes is rounded down to a multiple of ELEM_ALIGN_BYTES and must be able to hold the largest block */
+    explicit PoolResource(std::size_t chunk_size_bytes = 1 << 18)
+        : m_chunk_size_bytes(chunk_size_bytes / ELEM_ALIGN_BYTES * ELEM_ALIGN_BYTES)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+    }
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        if (m_free_lists[num_alignments] != nullptr) {
+            ListNode* node = m_free_lists[num_alignments];
+            m_free_lists[num_alignments] = node->next;
+            return node;
+        }
+        const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if ((std::size_t)(m_available_memory_end - m_available_memory_it) < round_bytes) {
+            AllocateChunk();
+        }
+        void* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        PushFree(p, NumElemAlignBytes(bytes));
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+    //! Memory used for the bookkeeping of the chunks, not including the chunks themselves
+    std::size_t ChunksVectorBytes() const { return m_allocated_chunks.capacity() * sizeof(void*); }
+};
+
+//
+// Allocator for std containers which allocates from a PoolResource. The resource must outlive all containers and
+// allocators using it.
+//
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    using value_type = T;
+    using ResourceType = PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    PoolAllocator(const PoolAllocator& other) noexcept = default;
+    PoolAllocator& operator=(const PoolAllocator& other) noexcept = default;
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept
+    {
+        return m_resource;
+    }
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -9,9 +9,13 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <set>
+#include <tuple>
 
 #ifdef DEBUG_LOCKCONTENTION
 #if !defined(HAVE_THREAD_LOCAL)
@@ -23,6 +27,161 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+//
+// Lock contention profiling.
+// Sites are identified by the lock name and the source location of the LOCK, the registry maps them to their
+// counters. Every thread caches the sites it has used by the (static) string pointers, so looking up a site only
+// takes the registry mutex the first time a thread uses it.
+//
+
+struct LockSiteStats {
+    std::string strName;
+    std::string strFile;
+    int nLine;
+
+    std::atomic<uint64_t> nContentions{0};
+    std::atomic<uint64_t> nWaitTime{0};
+    std::atomic<uint64_t> nMaxWaitTime{0};
+    std::atomic<uint64_t> vWaitHistogram[LOCK_STATS_HISTOGRAM_BUCKETS];
+
+    std::atomic<uint64_t> nHoldSamples{0};
+    std::atomic<uint64_t> nHoldTime{0};
+    std::atomic<uint64_t> nMaxHoldTime{0};
+    std::atomic<uint64_t> vHoldHistogram[LOCK_STATS_HISTOGRAM_BUCKETS];
+
+    LockSiteStats(const std::string& strNameIn, const std::string& strFileIn, int nLineIn) :
+        strName(strNameIn), strFile(strFileIn), nLine(nLineIn)
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        nContentions = 0;
+        nWaitTime = 0;
+        nMaxWaitTime = 0;
+        nHoldSamples = 0;
+        nHoldTime = 0;
+        nMaxHoldTime = 0;
+        for (int i = 0; i < LOCK_STATS_HISTOGRAM_BUCKETS; i++) {
+            vWaitHistogram[i] = 0;
+            vHoldHistogram[i] = 0;
+        }
+    }
+};
+
+struct LockStatsRegistry {
+    std::mutex mutex;
+    std::map<std::tuple<std::string, int, std::string>, std::unique_ptr<LockSiteStats>> mapSites;
+};
+
+static LockStatsRegistry& GetLockStatsRegistry()
+{
+    // Never destroyed, locks are still taken by global destructors and threads which outlive main
+    static LockStatsRegistry* registry = new LockStatsRegistry();
+    return *registry;
+}
+
+static int GetLockStatsBucket(uint64_t nTime)
+{
+    int nBucket = 0;
+    while (nTime > 0 && nBucket < LOCK_STATS_HISTOGRAM_BUCKETS - 1) {
+        nTime >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+static void RecordLockTime(std::atomic<uint64_t>& nTotal, std::atomic<uint64_t>& nMax, std::atomic<uint64_t>* vHistogram, int64_t nTime)
+{
+    const uint64_t nTimeU = nTime > 0 ? nTime : 0;
+    nTotal.fetch_add(nTimeU, std::memory_order_relaxed);
+    uint64_t nPrevMax = nMax.load(std::memory_order_relaxed);
+    while (nTimeU > nPrevMax && !nMax.compare_exchange_weak(nPrevMax, nTimeU, std::memory_order_relaxed)) {}
+    vHistogram[GetLockStatsBucket(nTimeU)].fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t GetLockStatsTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SampleLockHoldTime()
+{
+    static thread_local uint32_t nLocks = 0;
+    return ++nLocks % LOCK_STATS_SAMPLE_RATE == 0;
+}
+
+LockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine)
+{
+    static thread_local std::map<std::tuple<const char*, int, const char*>, LockSiteStats*> mapCache;
+    LockSiteStats*& site = mapCache[std::make_tuple(pszFile, nLine, pszName)];
+    if (!site) {
+        LockStatsRegistry& registry = GetLockStatsRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto& entry = registry.mapSites[std::make_tuple(std::string(pszFile), nLine, std::string(pszName))];
+        if (!entry) {
+            entry.reset(new LockSiteStats(pszName, pszFile, nLine));
+        }
+        site = entry.get();
+    }
+    return site;
+}
+
+void RecordLockWaitTime(LockSiteStats* site, int64_t nWaitTime)
+{
+    site->nContentions.fetch_add(1, std::memory_order_relaxed);
+    RecordLockTime(site->nWaitTime, site->nMaxWaitTime, site->vWaitHistogram, nWaitTime);
+}
+
+void RecordLockHoldTime(LockSiteStats* site, int64_t nHoldTime)
+{
+    site->nHoldSamples.fetch_add(1, std::memory_order_relaxed);
+    RecordLockTime(site->nHoldTime, site->nMaxHoldTime, site->vHoldHistogram, nHoldTime);
+}
+
+std::vector<LockStats> GetLockStats()
+{
+    std::vector<LockStats> vStats;
+    LockStatsRegistry& registry = GetLockStatsRegistry();
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        vStats.reserve(registry.mapSites.size());
+        for (const auto& entry : registry.mapSites) {
+            const LockSiteStats& site = *entry.second;
+            LockStats stats;
+            stats.strName = site.strName;
+            stats.strFile = site.strFile;
+            stats.nLine = site.nLine;
+            stats.nContentions = site.nContentions.load(std::memory_order_relaxed);
+            stats.nWaitTime = site.nWaitTime.load(std::memory_order_relaxed);
+            stats.nMaxWaitTime = site.nMaxWaitTime.load(std::memory_order_relaxed);
+            stats.nHoldSamples = site.nHoldSamples.load(std::memory_order_relaxed);
+            stats.nHoldTime = site.nHoldTime.load(std::memory_order_relaxed);
+            stats.nMaxHoldTime = site.nMaxHoldTime.load(std::memory_order_relaxed);
+            for (int i = 0; i < LOCK_STATS_HISTOGRAM_BUCKETS; i++) {
+                stats.vWaitHistogram.push_back(site.vWaitHistogram[i].load(std::memory_order_relaxed));
+                stats.vHoldHistogram.push_back(site.vHoldHistogram[i].load(std::memory_order_relaxed));
+            }
+            vStats.push_back(std::move(stats));
+        }
+    }
+    std::sort(vStats.begin(), vStats.end(), [](const LockStats& a, const LockStats& b) {
+        return a.nWaitTime > b.nWaitTime;
+    });
+    return vStats;
+}
+
+void ResetLockStats()
+{
+    // Sites stay registered as the per thread caches point to them
+    LockStatsRegistry& registry = GetLockStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto& entry : registry.mapSites) {
+        entry.second->Reset();
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -9,8 +9,11 @@
 #include <threadsafety.h>
 
 #include <condition_variable>
+#include <stdint.h>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 
 /////////////////////////////////////////////////
@@ -112,23 +115,73 @@ typedef std::unique_lock<std::mutex> WaitableLock;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Lock contention profiling of LOCK/LOCK2/TRY_LOCK sites. Every contended acquisition records how long it waited,
+ * one in LOCK_STATS_SAMPLE_RATE acquisitions records how long the lock was held. Uncontended, unsampled
+ * acquisitions only pay for a thread local counter.
+ */
+//! Histogram bucket 0 counts the durations below 1us, bucket i those below 2^i us, the last one all longer ones
+static const int LOCK_STATS_HISTOGRAM_BUCKETS = 24;
+static const uint32_t LOCK_STATS_SAMPLE_RATE = 64;
+
+struct LockSiteStats;
+
+/** Statistics of one lock site, times are in microseconds */
+struct LockStats
+{
+    std::string strName;
+    std::string strFile;
+    int nLine;
+
+    uint64_t nContentions;
+    uint64_t nWaitTime;
+    uint64_t nMaxWaitTime;
+    std::vector<uint64_t> vWaitHistogram;
+
+    uint64_t nHoldSamples;
+    uint64_t nHoldTime;
+    uint64_t nMaxHoldTime;
+    std::vector<uint64_t> vHoldHistogram;
+};
+
+int64_t GetLockStatsTime();
+bool SampleLockHoldTime();
+LockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine);
+void RecordLockWaitTime(LockSiteStats* site, int64_t nWaitTime);
+void RecordLockHoldTime(LockSiteStats* site, int64_t nHoldTime);
+/** Get the statistics of all lock sites, sorted by descending total wait time */
+std::vector<LockStats> GetLockStats();
+void ResetLockStats();
+
 /** Wrapper around std::unique_lock<CCriticalSection> */
 class SCOPED_LOCKABLE CCriticalBlock
 {
 private:
     std::unique_lock<CCriticalSection> lock;
+    //! set if this acquisition's hold time is sampled
+    LockSiteStats* statsSite{nullptr};
+    int64_t nLockedSince{0};
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
+        bool fSample = SampleLockHoldTime();
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            int64_t nWaitStart = GetLockStatsTime();
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            nLockedSince = GetLockStatsTime();
+            statsSite = GetLockSiteStats(pszName, pszFile, nLine);
+            RecordLockWaitTime(statsSite, nLockedSince - nWaitStart);
+            if (!fSample) {
+                statsSite = nullptr;
+            }
+        } else if (fSample) {
+            nLockedSince = GetLockStatsTime();
+            statsSite = GetLockSiteStats(pszName, pszFile, nLine);
         }
-#endif
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
@@ -137,6 +190,10 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else if (SampleLockHoldTime()) {
+            nLockedSince = GetLockStatsTime();
+            statsSite = GetLockSiteStats(pszName, pszFile, nLine);
+        }
         return lock.owns_lock();
     }
 
@@ -164,6 +221,8 @@ public:
     {
         if (lock.owns_lock())
             LeaveCritical();
+        if (statsSite)
+            RecordLockHoldTime(statsSite, GetLockStatsTime() - nLockedSince);
     }
 
     operator bool()
@@ -228,6 +228,26 @@ BOOST_AUTO_TEST_CASE(addrman_select)
     BOOST_CHECK_EQUAL(ports.size(), 3);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_select_positions)
+{
+    CAddrManTest addrman;
+
+    // Test: Select only returns addresses still in the tables while entries are moved to tried, evicted from it and
+    //  replaced in new.
+    for (unsigned int i = 1; i < 1024; i++) {
+        std::string strAddr = "250." + std::to_string(i % 4) + "." + std::to_string(i >> 2) + ".1";
+        CAddress addr = CAddress(ResolveService(strAddr, 8333), NODE_NONE);
+        addr.nTime = GetAdjustedTime();
+        addrman.Add(addr, ResolveIP("252.2.2." + std::to_string(i % 8)));
+        if (i % 3 == 0) {
+            addrman.Good(addr, false);
+        }
+
+        BOOST_CHECK(addrman.Find(addrman.Select()) != nullptr);
+        BOOST_CHECK(addrman.Find(addrman.Select(true)) != nullptr);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(addrman_new_collisions)
 {
     CAddrManTest addrman;
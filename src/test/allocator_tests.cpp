@@ -4,10 +4,13 @@
 
 #include <util.h>
 
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_dash.h>
+#include <memusage.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -233,4 +236,64 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+
+    // small allocations are served from a chunk
+    void* a = resource.Allocate(8, 8);
+    void* b = resource.Allocate(20, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL((char*)b - (char*)a, 8);
+
+    // freed blocks are reused for allocations which round up to the same size
+    resource.Deallocate(b, 20, 8);
+    void* c = resource.Allocate(24, 8);
+    BOOST_CHECK(c == b);
+
+    // large or overaligned allocations do not touch the chunks
+    void* large = resource.Allocate(65, 8);
+    resource.Deallocate(large, 65, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // a full chunk makes the resource allocate a new one
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 1024 / 64 + 1; i++) {
+        ptrs.push_back(resource.Allocate(64, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    for (void* p : ptrs) {
+        resource.Deallocate(p, 64, 8);
+    }
+    resource.Deallocate(a, 8, 8);
+    resource.Deallocate(c, 24, 8);
+    // memory is only returned when the resource is destroyed
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_unordered_map_tests)
+{
+    using Alloc = PoolAllocator<std::pair<const int, int>, sizeof(std::pair<const int, int>) + sizeof(void*) * 4>;
+    using Map = std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Alloc>;
+    Alloc::ResourceType resource;
+    {
+        Map m{0, Map::hasher{}, Map::key_equal{}, &resource};
+        for (int i = 0; i < 10000; i++) {
+            m[i] = i * 2;
+        }
+        for (int i = 0; i < 10000; i += 2) {
+            m.erase(i);
+        }
+        BOOST_CHECK_EQUAL(m.size(), 5000U);
+        for (const auto& entry : m) {
+            BOOST_CHECK_EQUAL(entry.second, entry.first * 2);
+        }
+        BOOST_CHECK(resource.NumAllocatedChunks() > 0);
+        BOOST_CHECK(memusage::DynamicUsage(m) >= resource.NumAllocatedChunks() * resource.ChunkSizeBytes());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
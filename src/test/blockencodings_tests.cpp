@@ -318,6 +318,42 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ExtraAndISLockedTxnTest)
+{
+    CTxMemPool pool;
+    CBlock block(BuildBlockTestCase());
+
+    // Neither TX is in the mempool, one is found in the extra pool and one in the islocked pool
+    std::vector<std::pair<uint256, CTransactionRef>> extra_pool{{block.vtx[1]->GetHash(), block.vtx[1]}, {uint256(), nullptr}};
+    std::vector<std::pair<uint256, CTransactionRef>> islocked_pool{{block.vtx[2]->GetHash(), block.vtx[2]}};
+
+    CBlockHeaderAndShortTxIDs shortIDs(block);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs, extra_pool, islocked_pool) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+    BOOST_CHECK_EQUAL(partialBlock.GetPrefilledCount(), 1);
+    BOOST_CHECK_EQUAL(partialBlock.GetMempoolCount(), 2);
+    BOOST_CHECK_EQUAL(partialBlock.GetExtraCount(), 1);
+    BOOST_CHECK_EQUAL(partialBlock.GetISLockCount(), 1);
+
+    CBlock block2;
+    std::vector<CTransactionRef> vtx_missing;
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+
+    // A TX which is in both pools is only counted once
+    PartiallyDownloadedBlock partialBlock2(&pool);
+    islocked_pool.emplace_back(block.vtx[1]->GetHash(), block.vtx[1]);
+    BOOST_CHECK(partialBlock2.InitData(shortIDs, extra_pool, islocked_pool) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock2.IsTxAvailable(1));
+    BOOST_CHECK_EQUAL(partialBlock2.GetMempoolCount(), 2);
+    BOOST_CHECK_EQUAL(partialBlock2.GetExtraCount(), 1);
+    BOOST_CHECK_EQUAL(partialBlock2.GetISLockCount(), 1);
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -0,0 +1,74 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, BasicTestingSetup)
+
+static fs::path WriteTestFile(const fs::path& dir, const std::string& name, size_t size)
+{
+    fs::path path = dir / name;
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    for (size_t i = 0; i < size; i++) {
+        fputc((int)(i & 0xff), file);
+    }
+    fclose(file);
+    return path;
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(blockfilemap_ranges)
+{
+    fs::path dir = SetDataDir("blockfilemap_ranges");
+    fs::path path = WriteTestFile(dir, "blk00000.dat", 1000);
+
+    CBlockFileMapCache cache(2);
+    auto mapping = cache.Get(path, 0, false);
+    BOOST_REQUIRE(mapping);
+
+    auto range = mapping->GetRange(10, 20);
+    BOOST_CHECK_EQUAL(range.size(), 20);
+    BOOST_CHECK_EQUAL(range.data()[0], 10);
+    BOOST_CHECK_EQUAL(mapping->GetRange(980, 20).size(), 20);
+    BOOST_CHECK_EQUAL(mapping->GetRange(990, 20).size(), 0);
+    BOOST_CHECK_EQUAL(mapping->GetRange(2000, 1).size(), 0);
+
+    // the same file is only mapped once
+    BOOST_CHECK(cache.Get(path, 0, false) == mapping);
+
+    // missing files can't be mapped
+    BOOST_CHECK(!cache.Get(dir / "blk00001.dat", 1, false));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_eviction)
+{
+    fs::path dir = SetDataDir("blockfilemap_eviction");
+    fs::path path0 = WriteTestFile(dir, "blk00000.dat", 100);
+    fs::path path1 = WriteTestFile(dir, "blk00001.dat", 100);
+    fs::path path2 = WriteTestFile(dir, "rev00001.dat", 100);
+
+    CBlockFileMapCache cache(2);
+    auto mapping0 = cache.Get(path0, 0, false);
+    auto mapping1 = cache.Get(path1, 1, false);
+    BOOST_REQUIRE(mapping0 && mapping1);
+
+    // mapping the undo file evicts the least recently used mapping, which stays valid while referenced
+    auto mapping2 = cache.Get(path2, 1, true);
+    BOOST_REQUIRE(mapping2);
+    BOOST_CHECK(cache.Get(path1, 1, false) == mapping1);
+    BOOST_CHECK(cache.Get(path0, 0, false) != mapping0);
+    BOOST_CHECK_EQUAL(mapping0->GetRange(99, 1).data()[0], 99);
+
+    // removing a file removes both the block and undo mappings
+    auto mapping1b = cache.Get(path1, 1, false);
+    cache.Remove(1);
+    BOOST_CHECK(cache.Get(path1, 1, false) != mapping1b);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <txdb.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+struct BlockIndexSnapshotSetup : public BasicTestingSetup {
+    BlockIndexSnapshotSetup() : BasicTestingSetup(CBaseChainParams::REGTEST)
+    {
+        SetDataDir("blockindex_snapshot");
+        ClearDatadirCache();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(blockindex_snapshot_tests, BlockIndexSnapshotSetup)
+
+// A chain of entries with hashes which are valid proof of work on regtest
+static void BuildChain(std::vector<uint256>& hashes, std::vector<CBlockIndex>& indexes, size_t count)
+{
+    hashes.resize(count);
+    indexes.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = ArithToUint256(arith_uint256(i + 1));
+        CBlockIndex& index = indexes[i];
+        index.phashBlock = &hashes[i];
+        index.pprev = i ? &indexes[i - 1] : nullptr;
+        index.nHeight = (int)i;
+        index.nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+        index.nTx = 1 + i % 3;
+        index.nFile = 0;
+        index.nDataPos = 100 * i;
+        index.nUndoPos = 50 * i;
+        index.nVersion = 0x20000000;
+        index.hashMerkleRoot = ArithToUint256(arith_uint256(1000 + i));
+        index.nTime = 1600000000 + i;
+        index.nBits = 0x207fffff;
+        index.nNonce = i;
+    }
+}
+
+static std::vector<const CBlockIndex*> Pointers(const std::vector<CBlockIndex>& indexes, size_t begin, size_t end)
+{
+    std::vector<const CBlockIndex*> ret;
+    for (size_t i = begin; i < end; i++) {
+        ret.push_back(&indexes[i]);
+    }
+    return ret;
+}
+
+static void CheckLoad(CBlockTreeDB& db, const std::vector<uint256>& hashes, const std::vector<CBlockIndex>& indexes)
+{
+    std::map<uint256, std::unique_ptr<CBlockIndex>> mapLoaded;
+    BOOST_CHECK(db.LoadBlockIndexGuts(Params().GetConsensus(), [&](const uint256& hash) -> CBlockIndex* {
+        if (hash.IsNull()) return nullptr;
+        auto it = mapLoaded.emplace(hash, nullptr).first;
+        if (!it->second) {
+            it->second.reset(new CBlockIndex());
+            it->second->phashBlock = &it->first;
+        }
+        return it->second.get();
+    }));
+    BOOST_REQUIRE_EQUAL(mapLoaded.size(), indexes.size());
+    for (size_t i = 0; i < indexes.size(); i++) {
+        const CBlockIndex& expected = indexes[i];
+        const CBlockIndex* pindex = mapLoaded.at(hashes[i]).get();
+        BOOST_CHECK(pindex->pprev == (i ? mapLoaded.at(hashes[i - 1]).get() : nullptr));
+        BOOST_CHECK_EQUAL(pindex->nHeight, expected.nHeight);
+        BOOST_CHECK_EQUAL(pindex->nStatus, expected.nStatus);
+        BOOST_CHECK_EQUAL(pindex->nTx, expected.nTx);
+        BOOST_CHECK_EQUAL(pindex->nDataPos, expected.nDataPos);
+        BOOST_CHECK_EQUAL(pindex->nUndoPos, expected.nUndoPos);
+        BOOST_CHECK(pindex->hashMerkleRoot == expected.hashMerkleRoot);
+        BOOST_CHECK_EQUAL(pindex->nTime, expected.nTime);
+        BOOST_CHECK_EQUAL(pindex->nNonce, expected.nNonce);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockindex_snapshot_roundtrip)
+{
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> indexes;
+    BuildChain(hashes, indexes, 20);
+    CBlockFileInfo fileInfo;
+    fileInfo.nBlocks = 10;
+
+    {
+        CBlockTreeDB db(1 << 20, false, true);
+        BOOST_CHECK(db.WriteBatchSync({{0, &fileInfo}}, 0, Pointers(indexes, 0, 10)));
+        BOOST_CHECK(db.NeedsBlockIndexSnapshot());
+        BOOST_CHECK(db.WriteBlockIndexSnapshot(Pointers(indexes, 0, 10)));
+        BOOST_CHECK(!db.NeedsBlockIndexSnapshot());
+
+        // Written entries are appended
+        indexes[3].nStatus |= BLOCK_FAILED_VALID;
+        fileInfo.nBlocks = 12;
+        std::vector<const CBlockIndex*> vWrite = Pointers(indexes, 10, 12);
+        vWrite.push_back(&indexes[3]);
+        BOOST_CHECK(db.WriteBatchSync({{0, &fileInfo}}, 0, vWrite));
+    }
+    BuildChain(hashes, indexes, 12);
+    indexes[3].nStatus |= BLOCK_FAILED_VALID;
+    {
+        CBlockTreeDB db(1 << 20, false, false);
+        CheckLoad(db, hashes, indexes);
+        BOOST_CHECK(!db.NeedsBlockIndexSnapshot());
+
+        // The appended entries make up more than a quarter of the snapshot now
+        fileInfo.nBlocks = 20;
+        BOOST_CHECK(db.WriteBatchSync({{0, &fileInfo}}, 0, Pointers(indexes, 0, 12)));
+        BOOST_CHECK(db.NeedsBlockIndexSnapshot());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockindex_snapshot_fallback)
+{
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> indexes;
+    BuildChain(hashes, indexes, 10);
+    CBlockFileInfo fileInfo;
+    fileInfo.nBlocks = 10;
+
+    {
+        CBlockTreeDB db(1 << 20, false, true);
+        BOOST_CHECK(db.WriteBatchSync({{0, &fileInfo}}, 0, Pointers(indexes, 0, 10)));
+        BOOST_CHECK(db.WriteBlockIndexSnapshot(Pointers(indexes, 0, 10)));
+    }
+
+    // Damage the last entry of the snapshot, the entries of the db are loaded instead
+    fs::path path = GetBlocksDir() / "indexsnapshot.dat";
+    FILE* file = fsbridge::fopen(path, "r+b");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE(fseek(file, -36, SEEK_END) == 0);
+    fputc(0xff, file);
+    fclose(file);
+    {
+        CBlockTreeDB db(1 << 20, false, false);
+        CheckLoad(db, hashes, indexes);
+        BOOST_CHECK(db.NeedsBlockIndexSnapshot());
+        BOOST_CHECK(db.WriteBlockIndexSnapshot(Pointers(indexes, 0, 10)));
+    }
+
+    // Entries which don't follow their pprev can't be written
+    {
+        CBlockTreeDB db(1 << 20, false, false);
+        CheckLoad(db, hashes, indexes);
+        BOOST_CHECK(!db.WriteBlockIndexSnapshot(Pointers(indexes, 5, 10)));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
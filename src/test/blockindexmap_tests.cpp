@@ -0,0 +1,68 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockindexmap.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockindexmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockindexmap_insert_find)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> hashes(10000);
+    for (auto& hash : hashes) {
+        hash = rng.rand256();
+    }
+
+    CBlockIndexMap map;
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(hashes[0]) == map.end());
+
+    std::vector<CBlockIndex*> indexes;
+    for (size_t i = 0; i < hashes.size(); i++) {
+        CBlockHeader header;
+        header.nTime = i;
+        auto inserted = map.emplace(hashes[i], header);
+        BOOST_REQUIRE(inserted.second);
+        CBlockIndex* pindex = inserted.first->second;
+        BOOST_CHECK(inserted.first->first == hashes[i]);
+        BOOST_CHECK(pindex->phashBlock == &inserted.first->first);
+        BOOST_CHECK_EQUAL(pindex->nTime, i);
+        indexes.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(map.size(), hashes.size());
+
+    // Entries keep their address while the table grows, a second insert returns the existing entry
+    for (size_t i = 0; i < hashes.size(); i++) {
+        auto it = map.find(hashes[i]);
+        BOOST_REQUIRE(it != map.end());
+        BOOST_CHECK(it->second == indexes[i]);
+        BOOST_CHECK(*it->second->phashBlock == hashes[i]);
+        BOOST_CHECK_EQUAL(map.count(hashes[i]), 1);
+    }
+    auto inserted = map.emplace(hashes[42]);
+    BOOST_CHECK(!inserted.second);
+    BOOST_CHECK(inserted.first->second == indexes[42]);
+    BOOST_CHECK_EQUAL(map.count(rng.rand256()), 0);
+
+    // Iteration is in insertion order
+    size_t i = 0;
+    for (const auto& item : map) {
+        BOOST_CHECK(item.first == hashes[i]);
+        BOOST_CHECK(item.second == indexes[i]);
+        i++;
+    }
+    BOOST_CHECK_EQUAL(i, hashes.size());
+    BOOST_CHECK(map.DynamicMemoryUsage() >= hashes.size() * sizeof(CBlockIndex));
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(hashes[0]) == map.end());
+    BOOST_CHECK(map.emplace(hashes[0]).second);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockview.h>
+#include <streams.h>
+#include <version.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockview_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockview)
+{
+    CBlock block;
+    block.nVersion = 0x20000000;
+    block.hashPrevBlock = InsecureRand256();
+    block.nTime = 1600000000;
+    block.nBits = 0x207fffff;
+    for (int i = 0; i < 100; i++) {
+        CMutableTransaction mtx;
+        for (int j = 0; j <= i % 3; j++) {
+            mtx.vin.emplace_back(COutPoint(InsecureRand256(), j), CScript() << std::vector<unsigned char>(i % 50));
+        }
+        mtx.vout.emplace_back(i, CScript() << OP_RETURN << std::vector<unsigned char>(i % 30));
+        mtx.nLockTime = i;
+        if (i % 4 == 0) {
+            // special transaction with payload
+            mtx.nVersion = 3;
+            mtx.nType = i == 0 ? TRANSACTION_COINBASE : TRANSACTION_PROVIDER_UPDATE_SERVICE;
+            mtx.vExtraPayload.assign(i + 1, 1);
+        } else if (i % 4 == 1) {
+            // version 3 transactions without a type don't have a payload
+            mtx.nVersion = 3;
+        }
+        block.vtx.emplace_back(MakeTransactionRef(std::move(mtx)));
+    }
+    std::vector<unsigned char> vch;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, vch, 0) << block;
+
+    CBlockView view{std::vector<unsigned char>(vch)};
+    BOOST_CHECK(view.GetHeader().GetHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(view.GetSerializeSize(), vch.size());
+    BOOST_CHECK(view.GetData() == vch);
+    BOOST_REQUIRE_EQUAL(view.GetTxCount(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        BOOST_CHECK(view.GetTxHash(i) == block.vtx[i]->GetHash());
+        // cached
+        BOOST_CHECK(view.GetTxHash(i) == block.vtx[i]->GetHash());
+        BOOST_CHECK_EQUAL((size_t)view.GetTxData(i).size(), block.vtx[i]->GetTotalSize());
+    }
+    CTransactionRef tx = view.GetTx(4);
+    BOOST_CHECK(tx->GetHash() == block.vtx[4]->GetHash());
+    BOOST_CHECK(tx->vExtraPayload == block.vtx[4]->vExtraPayload);
+    BOOST_CHECK(view.GetBlock().GetHash() == block.GetHash());
+    BOOST_CHECK(view.GetBlock().vtx.back()->GetHash() == block.vtx.back()->GetHash());
+
+    // truncated and oversized blocks are rejected
+    std::vector<unsigned char> vchTruncated(vch.begin(), vch.end() - 1);
+    BOOST_CHECK_THROW(CBlockView{std::move(vchTruncated)}, std::ios_base::failure);
+    std::vector<unsigned char> vchTrailing(vch);
+    vchTrailing.push_back(0);
+    BOOST_CHECK_THROW(CBlockView{std::move(vchTrailing)}, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -54,6 +54,27 @@ BOOST_AUTO_TEST_CASE(bloom_create_insert_serialize)
     BOOST_CHECK_MESSAGE( !filter.contains(ParseHex("99108ad8ed9bb6274d3980bab5a85c048f0950c8")), "Bloom filter should be empty!");
 }
 
+BOOST_AUTO_TEST_CASE(bloom_match_on_copy)
+{
+    CBloomFilter filter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    uint160 hash = uint160(ParseHex("99108ad8ed9bb6274d3980bab5a85c048f0950c8"));
+    filter.insert(std::vector<unsigned char>(hash.begin(), hash.end()));
+
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(uint256S("0x01"), 0));
+    tx.vout.emplace_back(COIN, GetScriptForDestination(CKeyID(hash)));
+
+    // Matching on a copy leaves the copy in the state matching on the filter itself produces
+    CBloomFilter filterBefore(filter);
+    CBloomFilter filterCopy(filter);
+    BOOST_CHECK(filterCopy == filter);
+    BOOST_CHECK(filterCopy.IsRelevantAndUpdate(tx));
+    BOOST_CHECK(filterCopy != filterBefore);
+    BOOST_CHECK(filter.IsRelevantAndUpdate(tx));
+    BOOST_CHECK(filterCopy == filter);
+    BOOST_CHECK(filter.contains(COutPoint(tx.GetHash(), 0)));
+}
+
 BOOST_AUTO_TEST_CASE(bloom_create_insert_serialize_with_tweak)
 {
     // Same test as bloom_create_insert_serialize, but we add a nTweak of 100
@@ -152,6 +152,13 @@ BOOST_AUTO_TEST_CASE(batch_verifier_tests)
     // last message invalid from one source
     AddMessage(msgs, 1, 7, 1, false);
     Verify(msgs);
+
+    msgs.clear();
+    // many messages from the same source with a few invalid ones, so that the failed batch is split up multiple times
+    for (uint32_t i = 0; i < 32; i++) {
+        AddMessage(msgs, 1, i, i, i != 3 && i != 17 && i != 18);
+    }
+    Verify(msgs);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
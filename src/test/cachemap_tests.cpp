@@ -131,6 +131,20 @@ BOOST_AUTO_TEST_CASE(cachemap_test)
     CacheMap<int,int> mapTest4;
     mapTest4 = cmapTest1;
     BOOST_CHECK(Compare(cmapTest1, mapTest4));
+
+    // the copies have their own index
+    mapTest4.Erase(0);
+    BOOST_CHECK(cmapTest1.HasKey(0));
+    BOOST_CHECK(!mapTest4.HasKey(0));
+    BOOST_CHECK(mapTest3.HasKey(0));
+
+    // test memory usage accounting
+    size_t nUsage = cmapTest1.DynamicMemoryUsage();
+    BOOST_CHECK(nUsage > 0);
+    cmapTest1.Erase(1);
+    BOOST_CHECK(cmapTest1.DynamicMemoryUsage() < nUsage);
+    cmapTest1.Clear();
+    BOOST_CHECK(cmapTest1.DynamicMemoryUsage() < nUsage);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -171,6 +171,19 @@ BOOST_AUTO_TEST_CASE(cachemultimap_test)
     CacheMultiMap<int,int> mapTest4;
     mapTest4 = cmmapTest1;
     BOOST_CHECK(Compare(cmmapTest1, mapTest4));
+
+    // the copies have their own index
+    mapTest4.Erase(5);
+    BOOST_CHECK(cmmapTest1.HasKey(5));
+    BOOST_CHECK(!mapTest4.HasKey(5));
+    BOOST_CHECK(cmmapTest3.HasKey(5));
+    BOOST_CHECK(Compare(cmmapTest1, cmmapTest3));
+
+    // test memory usage accounting
+    size_t nUsage = cmmapTest1.DynamicMemoryUsage();
+    BOOST_CHECK(nUsage > 0);
+    cmmapTest1.Erase(5, 1);
+    BOOST_CHECK(cmmapTest1.DynamicMemoryUsage() < nUsage);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_dash.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -586,7 +587,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
     InsertCoinsMapEntry(map, value, flags);
     view.BatchWrite(map, {});
 }
@@ -855,4 +857,66 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(coinsdb_parallel_flush)
+{
+    // Flushing with and without the parallel serialization must result in the same database contents
+    for (int64_t flushThreads : {0, 4}) {
+        gArgs.ForceSetArg("-dbflushthreads", std::to_string(flushThreads));
+        CCoinsViewDB db(1 << 20, true, true);
+
+        std::vector<COutPoint> outpoints;
+        {
+            CCoinsViewCache cache(&db);
+            for (int i = 0; i < 1000; i++) {
+                COutPoint outpoint(InsecureRand256(), InsecureRandRange(10));
+                Coin coin;
+                coin.out.nValue = InsecureRand32();
+                coin.out.scriptPubKey.assign(InsecureRandBits(6), 0);
+                coin.nHeight = 1;
+                cache.AddCoin(outpoint, std::move(coin), false);
+                outpoints.push_back(outpoint);
+            }
+            cache.SetBestBlock(InsecureRand256());
+            BOOST_CHECK(cache.Flush());
+        }
+        {
+            // spend every other coin and flush again, which erases them from the database
+            CCoinsViewCache cache(&db);
+            for (size_t i = 0; i < outpoints.size(); i += 2) {
+                BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+            }
+            cache.SetBestBlock(InsecureRand256());
+            BOOST_CHECK(cache.Flush());
+        }
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            BOOST_CHECK_EQUAL(db.HaveCoin(outpoints[i]), i % 2 == 1);
+        }
+    }
+    gArgs.ForceSetArg("-dbflushthreads", std::to_string(nDefaultDbFlushThreads));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_emplace_from_base)
+{
+    CCoinsView base;
+    CCoinsViewCacheTest cache(&base);
+    COutPoint outpoint(InsecureRand256(), 0);
+
+    Coin coin;
+    coin.out.nValue = 1;
+    coin.nHeight = 1;
+    cache.EmplaceCoinFromBase(outpoint, std::move(coin));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoint).out.nValue, 1);
+    // coins loaded from the base are clean
+    BOOST_CHECK_EQUAL(cache.map().at(outpoint).flags, 0);
+
+    // an already cached coin is not replaced
+    Coin coin2;
+    coin2.out.nValue = 2;
+    coin2.nHeight = 1;
+    cache.EmplaceCoinFromBase(outpoint, std::move(coin2));
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoint).out.nValue, 1);
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
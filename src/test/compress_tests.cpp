@@ -3,6 +3,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <compressor.h>
+#include <key.h>
+#include <script/standard.h>
+#include <streams.h>
 #include <util.h>
 #include <test/test_dash.h>
 
@@ -62,4 +65,51 @@ BOOST_AUTO_TEST_CASE(compress_amounts)
         BOOST_CHECK(TestDecode(i));
 }
 
+// Serializes script compressed, checks the size of the encoding and that it reads back as the same script
+static bool TestScriptRoundtrip(const CScript& script, size_t nExpectedSize)
+{
+    CScript scriptIn(script);
+    CDataStream ss(SER_DISK, 0);
+    ss << CScriptCompressor(scriptIn);
+    if (ss.size() != nExpectedSize) {
+        return false;
+    }
+    CScript scriptOut;
+    CScriptCompressor scriptCompressor(scriptOut);
+    ss >> scriptCompressor;
+    return ss.empty() && scriptOut == script;
+}
+
+BOOST_AUTO_TEST_CASE(compress_scripts)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CKey keyUncompressed;
+    keyUncompressed.MakeNewKey(false);
+
+    CScript scriptP2PKUncompressed = GetScriptForRawPubKey(keyUncompressed.GetPubKey());
+    BOOST_CHECK(TestScriptRoundtrip(GetScriptForDestination(key.GetPubKey().GetID()), 21));
+    BOOST_CHECK(TestScriptRoundtrip(GetScriptForDestination(CScriptID(CScript() << OP_TRUE)), 21));
+    BOOST_CHECK(TestScriptRoundtrip(GetScriptForRawPubKey(key.GetPubKey()), 33));
+    BOOST_CHECK(TestScriptRoundtrip(scriptP2PKUncompressed, 33));
+    BOOST_CHECK(TestScriptRoundtrip(CScript() << OP_RETURN << std::vector<unsigned char>(40, 0x01), 1 + 42));
+    // not a valid public key, so it can't be compressed
+    CScript scriptInvalidKey = CScript() << std::vector<unsigned char>(65, 0x04) << OP_CHECKSIG;
+    BOOST_CHECK(TestScriptRoundtrip(scriptInvalidKey, 1 + 67));
+
+    // written as is when asked to, the compressed encoding stays readable
+    CScript scriptIn(scriptP2PKUncompressed);
+    CDataStream ssCompressed(SER_DISK, 0);
+    ssCompressed << CScriptCompressor(scriptIn);
+
+    fStoreP2PKUncompressed = true;
+    BOOST_CHECK(TestScriptRoundtrip(scriptP2PKUncompressed, 1 + 67));
+    BOOST_CHECK(TestScriptRoundtrip(GetScriptForRawPubKey(key.GetPubKey()), 33));
+    CScript scriptOut;
+    CScriptCompressor scriptCompressor(scriptOut);
+    ssCompressed >> scriptCompressor;
+    BOOST_CHECK(scriptOut == scriptP2PKUncompressed);
+    fStoreP2PKUncompressed = DEFAULT_STORE_P2PK_UNCOMPRESSED;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
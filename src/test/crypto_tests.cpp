@@ -824,4 +824,44 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256s64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            CSHA256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256S64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha256d_multi)
+{
+    // Counts below and above the lane counts, lengths around the padding and block boundaries
+    for (int i = 0; i <= 40; ++i) {
+        std::vector<std::vector<unsigned char>> msgs(i);
+        std::vector<const unsigned char*> ptrs;
+        std::vector<size_t> lens;
+        for (auto& msg : msgs) {
+            msg.resize(InsecureRandBool() ? InsecureRandRange(130) : InsecureRandRange(2000));
+            for (auto& c : msg) {
+                c = InsecureRandBits(8);
+            }
+            ptrs.emplace_back(msg.data());
+            lens.emplace_back(msg.size());
+        }
+        std::vector<unsigned char> out1(32 * i), out2(32 * i);
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(ptrs[j], lens[j]).Finalize(out1.data() + 32 * j);
+        }
+        SHA256DMulti(out2.data(), ptrs.data(), lens.data(), i);
+        BOOST_CHECK(out1 == out2);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
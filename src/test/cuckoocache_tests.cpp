@@ -377,4 +377,36 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+BOOST_FIXTURE_TEST_CASE(cuckoocache_dump_load, BasicTestingSetup)
+{
+    local_rand_ctx = FastRandomContext(true);
+    SignatureCacheMap cache;
+    cache.setup(1024);
+    std::vector<uint256> entries(100);
+    for (auto& entry : entries) {
+        insecure_GetRandHash(entry);
+        cache.insert(entry);
+    }
+    // Erased entries aren't visited and not dumped
+    BOOST_CHECK(cache.contains(entries[0], true));
+    size_t nCount = 0;
+    cache.for_each([&](const uint256&) { nCount++; });
+    BOOST_CHECK_EQUAL(nCount, 99U);
+
+    uint256 nonce, nonceLoaded;
+    insecure_GetRandHash(nonce);
+    fs::path path = SetDataDir("cuckoocache_dump_load") / "sigcache.dat";
+    BOOST_CHECK(DumpSignatureCacheFile(cache, nonce, path));
+
+    SignatureCacheMap cacheLoaded;
+    cacheLoaded.setup(1024);
+    BOOST_CHECK(LoadSignatureCacheFile(cacheLoaded, nonceLoaded, path));
+    BOOST_CHECK(nonceLoaded == nonce);
+    BOOST_CHECK(!cacheLoaded.contains(entries[0], false));
+    for (size_t i = 1; i < entries.size(); i++) {
+        BOOST_CHECK(cacheLoaded.contains(entries[i], false));
+    }
+    BOOST_CHECK(!LoadSignatureCacheFile(cacheLoaded, nonceLoaded, path.string() + ".missing"));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -120,6 +120,27 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 }
 
 // Test that we do not obfuscation if there is existing data.
+BOOST_AUTO_TEST_CASE(dbwrapper_iterator_obfuscate_key)
+{
+    for (bool obfuscate : {false, true}) {
+        fs::path ph = SetDataDir(std::string("dbwrapper_iterator_obfuscate_key").append(obfuscate ? "_true" : "_false"));
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+        BOOST_CHECK(dbw.Write('j', InsecureRand256()));
+
+        // The obfuscation key is only stored when obfuscating, next to the data
+        size_t nEntries = 0, nObfuscateKeys = 0;
+        std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            nEntries++;
+            if (CDBWrapper::IsObfuscateKeyKey(it->GetKey())) {
+                nObfuscateKeys++;
+            }
+        }
+        BOOST_CHECK_EQUAL(nEntries, obfuscate ? 2U : 1U);
+        BOOST_CHECK_EQUAL(nObfuscateKeys, obfuscate ? 1U : 0U);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 {
     // We're going to share this fs::path between two wrappers
@@ -317,6 +338,127 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_profiles)
+{
+    BOOST_CHECK_EQUAL(GetDBProfileForDB("chainstate").name, "default");
+    BOOST_CHECK_EQUAL(GetDBProfileForDB("evodb").name, "compressed");
+    BOOST_CHECK(GetDBProfile("nonexistent") == nullptr);
+
+    std::string strError;
+    gArgs.ForceSetArg("-dbprofile", "evodb:small");
+    BOOST_CHECK(CheckDBProfileArgs(strError));
+    BOOST_CHECK_EQUAL(GetDBProfileForDB("evodb").name, "small");
+    BOOST_CHECK_EQUAL(GetDBProfileForDB("chainstate").name, "default");
+
+    for (const char* strArg : {"evodb", "evodb:nonexistent", ":small"}) {
+        gArgs.ForceSetArg("-dbprofile", strArg);
+        BOOST_CHECK(!CheckDBProfileArgs(strError));
+        BOOST_CHECK_EQUAL(GetDBProfileForDB("evodb").name, "compressed");
+    }
+    gArgs.ForceSetArg("-dbprofile", "");
+
+    // All profiles result in a working database
+    for (const auto& strProfile : {"default", "readheavy", "writeheavy", "compressed", "small"}) {
+        CDBWrapper dbw("", 1 << 20, *GetDBProfile(strProfile), true);
+        uint256 in = InsecureRand256();
+        uint256 res;
+        BOOST_CHECK(dbw.Write('k', in));
+        BOOST_CHECK(dbw.Read('k', res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_async_writer)
+{
+    CDBWrapper dbw("", 1 << 20, true, false, false);
+    dbw.StartAsyncWriter();
+
+    // Reads see queued writes and erases
+    uint256 res;
+    for (int i = 0; i < 100; i++) {
+        CDBBatch batch(dbw);
+        batch.Write(i, uint256S(strprintf("%x", i)));
+        batch.Erase(i - 1);
+        BOOST_CHECK(dbw.WriteBatchAsync(batch));
+        BOOST_CHECK(dbw.Read(i, res));
+        BOOST_CHECK(res == uint256S(strprintf("%x", i)));
+        BOOST_CHECK(!dbw.Exists(i - 1));
+    }
+
+    // Synchronous writes are ordered after the queued ones
+    CDBBatch batch(dbw);
+    batch.Write(99, uint256S("1234"));
+    BOOST_CHECK(dbw.WriteBatchAsync(batch));
+    BOOST_CHECK(dbw.Write(99, uint256S("5678")));
+    dbw.WaitForAsyncWrites();
+    BOOST_CHECK(dbw.Read(99, res));
+    BOOST_CHECK(res == uint256S("5678"));
+
+    // Iterators see everything written before
+    std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+    int nCount = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        int key;
+        if (it->GetKey(key)) {
+            BOOST_CHECK_EQUAL(key, 99);
+            nCount++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nCount, 1);
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_transaction)
+{
+    typedef CDBTransaction<CDBWrapper, CDBBatch> RootTransaction;
+    typedef CDBTransaction<RootTransaction, RootTransaction> CurTransaction;
+
+    CDBWrapper dbw("", 1 << 20, true, false, false);
+    CDBBatch rootBatch(dbw);
+    RootTransaction rootTx(dbw, rootBatch);
+    CurTransaction curTx(rootTx, rootTx);
+
+    // Even keys are in the db, odd ones in the root transaction, multiples of 3 get erased by the current one
+    for (int i = 0; i < 20; i += 2) {
+        BOOST_CHECK(dbw.Write(std::make_pair('k', i), i));
+    }
+    for (int i = 1; i < 20; i += 2) {
+        rootTx.Write(std::make_pair('k', i), i);
+    }
+    for (int i = 0; i < 20; i += 3) {
+        curTx.Erase(std::make_pair('k', i));
+    }
+    BOOST_CHECK(curTx.GetMemoryUsage() > 0);
+
+    int value;
+    BOOST_CHECK(curTx.Read(std::make_pair('k', 4), value) && value == 4);
+    BOOST_CHECK(curTx.Read(std::make_pair('k', 5), value) && value == 5);
+    BOOST_CHECK(!curTx.Exists(std::make_pair('k', 6)));
+    BOOST_CHECK(rootTx.Exists(std::make_pair('k', 6)));
+
+    // Iterators merge all layers in key order
+    curTx.Write(std::make_pair('k', 6), 66);
+    std::vector<int> values;
+    auto it = curTx.NewIteratorUniquePtr();
+    for (it->Seek(std::make_pair('k', 0)); it->Valid(); it->Next()) {
+        std::pair<char, int> key;
+        BOOST_CHECK(it->GetKey(key));
+        BOOST_CHECK(it->GetValue(value));
+        values.emplace_back(value);
+    }
+    BOOST_CHECK(values == std::vector<int>({1, 2, 4, 5, 66, 7, 8, 10, 11, 13, 14, 16, 17, 19}));
+
+    // Committing both transactions writes the same to the db
+    size_t nMemoryUsage = curTx.GetMemoryUsage();
+    curTx.Commit();
+    BOOST_CHECK(curTx.IsClean());
+    BOOST_CHECK(curTx.GetMemoryUsage() < nMemoryUsage);
+    rootTx.Commit();
+    BOOST_CHECK(dbw.WriteBatch(rootBatch));
+    BOOST_CHECK(dbw.Read(std::make_pair('k', 6), value) && value == 66);
+    BOOST_CHECK(dbw.Read(std::make_pair('k', 7), value) && value == 7);
+    BOOST_CHECK(!dbw.Exists(std::make_pair('k', 9)));
+}
+
 
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <net.h>
 #include <net_processing.h>
 #include <pow.h>
+#include <saltedhasher.h>
 #include <script/sign.h>
 #include <serialize.h>
 #include <util.h>
@@ -17,6 +18,7 @@
 #include <test/test_dash.h>
 
 #include <stdint.h>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -31,8 +33,10 @@ struct COrphanTx {
     CTransactionRef tx;
     NodeId fromPeer;
     int64_t nTimeExpire;
+    size_t nTxSize;
+    size_t list_pos;
 };
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern std::unordered_map<uint256, COrphanTx, StaticSaltedHasher> mapOrphanTransactions;
 
 CService ip(uint32_t i)
 {
@@ -325,11 +329,9 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
 
 CTransactionRef RandomOrphan()
 {
-    std::map<uint256, COrphanTx>::iterator it;
     LOCK(cs_main);
-    it = mapOrphanTransactions.lower_bound(InsecureRand256());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
+    auto it = mapOrphanTransactions.begin();
+    std::advance(it, InsecureRandRange(mapOrphanTransactions.size()));
     return it->second.tx;
 }
 
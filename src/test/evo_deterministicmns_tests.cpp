@@ -15,10 +15,15 @@
 #include <keystore.h>
 #include <spork.h>
 #include <txmempool.h>
+#include <ui_interface.h>
 
 #include <evo/specialtx.h>
 #include <evo/providertx.h>
 #include <evo/deterministicmns.h>
+#include <evo/simplifiedmns.h>
+#include <llmq/quorums_commitment.h>
+#include <llmq/quorums_utils.h>
+#include <masternode/masternode-payments.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -315,8 +320,25 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
     nHeight++;
 
     // check MN reward payments
+    auto projectedPayees = deterministicMNManager->GetListAtChainTip().GetProjectedMNPayees(20);
+    BOOST_CHECK_EQUAL(projectedPayees.size(), deterministicMNManager->GetListAtChainTip().GetValidMNsCount());
+    // cached projections must match the list, also when a shorter one is served from a longer one
+    for (int nCount : {20, 3, 20}) {
+        auto cachedPayees = CMasternodePayments::GetProjectedPayees(chainActive.Tip(), nCount);
+        BOOST_REQUIRE_EQUAL(cachedPayees.size(), std::min<size_t>(nCount, projectedPayees.size()));
+        for (size_t i = 0; i < cachedPayees.size(); i++) {
+            BOOST_CHECK_EQUAL(cachedPayees[i]->proTxHash.ToString(), projectedPayees[i]->proTxHash.ToString());
+        }
+    }
     for (size_t i = 0; i < 20; i++) {
         auto dmnExpectedPayee = deterministicMNManager->GetListAtChainTip().GetMNPayee();
+        // the second call is served from the payee cache
+        for (size_t j = 0; j < 2; j++) {
+            CBlockPayee payee;
+            BOOST_REQUIRE(CMasternodePayments::GetBlockPayee(chainActive.Height() + 1, payee));
+            BOOST_CHECK_EQUAL(payee.nBlockHeight, chainActive.Height() + 1);
+            BOOST_CHECK_EQUAL(payee.dmnPayee->proTxHash.ToString(), dmnExpectedPayee->proTxHash.ToString());
+        }
 
         CBlock block = CreateAndProcessBlock({}, coinbaseKey);
         deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
@@ -325,6 +347,10 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
         auto dmnPayout = FindPayoutDmn(block);
         BOOST_ASSERT(dmnPayout != nullptr);
         BOOST_CHECK_EQUAL(dmnPayout->proTxHash.ToString(), dmnExpectedPayee->proTxHash.ToString());
+        if (i < projectedPayees.size()) {
+            // the first payment cycle must follow the projection
+            BOOST_CHECK_EQUAL(dmnPayout->proTxHash.ToString(), projectedPayees[i]->proTxHash.ToString());
+        }
 
         nHeight++;
     }
@@ -648,4 +674,225 @@ BOOST_FIXTURE_TEST_CASE(dip3_verify_db, TestChainDIP3Setup)
     BOOST_ASSERT(CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), 4, 2));
 }
 
+BOOST_FIXTURE_TEST_CASE(dip3_mnlistdiff_cache, TestChainDIP3Setup)
+{
+    CSimplifiedMNListDiffCache cache;
+    const uint256 prevTipHash = chainActive.Tip()->pprev->GetBlockHash();
+    const uint256 tipHash = chainActive.Tip()->GetBlockHash();
+
+    // Diffs are built ahead for the new tip, from the genesis block and the previous tips
+    cache.UpdatedBlockTip(chainActive.Tip()->pprev);
+    cache.UpdatedBlockTip(chainActive.Tip());
+
+    LOCK(cs_main);
+    for (const auto& baseBlockHash : {uint256(), prevTipHash}) {
+        CSimplifiedMNListDiff mnListDiff;
+        std::string strError;
+        BOOST_CHECK(BuildSimplifiedMNListDiff(baseBlockHash, tipHash, mnListDiff, strError));
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << mnListDiff;
+
+        CSimplifiedMNListDiffCache::DiffBytesPtr diff, diff2;
+        BOOST_CHECK(cache.GetDiff(baseBlockHash, tipHash, diff, strError));
+        BOOST_CHECK(std::vector<unsigned char>(ss.begin(), ss.end()) == *diff);
+        BOOST_CHECK(cache.GetDiff(baseBlockHash, tipHash, diff2, strError));
+        BOOST_CHECK(diff == diff2);
+    }
+
+    // Errors are the same as for BuildSimplifiedMNListDiff()
+    CSimplifiedMNListDiffCache::DiffBytesPtr diff;
+    std::string strError;
+    BOOST_CHECK(!cache.GetDiff(tipHash, prevTipHash, diff, strError));
+    BOOST_CHECK(!cache.GetDiff(uint256S("1"), tipHash, diff, strError));
+    BOOST_CHECK(!diff);
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_mnlist_snapshots, TestChainDIP3Setup)
+{
+    const int nInterval = llmq::GetLLMQParams(Params().GetConsensus().llmqTypeChainLocks).dkgInterval;
+    const CBlockIndex* pindexTip = chainActive.Tip();
+
+    UpdateSimplifiedMNListSnapshots(pindexTip);
+
+    // The snapshot is the diff from genesis to the last interval boundary
+    const CBlockIndex* pindexSnapshot{nullptr};
+    std::vector<unsigned char> snapshot;
+    BOOST_CHECK(GetSimplifiedMNListSnapshot(pindexTip, pindexSnapshot, snapshot));
+    BOOST_CHECK(pindexSnapshot == pindexTip->GetAncestor(pindexTip->nHeight - pindexTip->nHeight % nInterval));
+
+    LOCK(cs_main);
+    CSimplifiedMNListDiff mnListDiff;
+    std::string strError;
+    BOOST_CHECK(BuildSimplifiedMNListDiff(uint256(), pindexSnapshot->GetBlockHash(), mnListDiff, strError));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << mnListDiff;
+    BOOST_CHECK(std::vector<unsigned char>(ss.begin(), ss.end()) == snapshot);
+
+    // Blocks before the snapshot don't see it
+    const CBlockIndex* pindexSnapshot2{nullptr};
+    BOOST_CHECK(!GetSimplifiedMNListSnapshot(pindexSnapshot->pprev, pindexSnapshot2, snapshot));
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_mnlist_view, TestChainDIP3Setup)
+{
+    auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
+    for (int port = 1; port <= 3; port++) {
+        CKey ownerKey;
+        CBLSSecretKey operatorKey;
+        auto tx = CreateProRegTx(utxos, port, GenerateRandomAddress(), coinbaseKey, ownerKey, operatorKey);
+        CreateAndProcessBlock({tx}, coinbaseKey);
+        deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    }
+
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+    BOOST_REQUIRE(mnList.GetAllMNsCount() > 1);
+
+    auto view = mnList.GetView();
+    BOOST_REQUIRE_EQUAL(view->size(), mnList.GetAllMNsCount());
+    size_t nValid = 0;
+    for (size_t i = 0; i < view->size(); i++) {
+        const auto& dmn = view->mns[i];
+        BOOST_CHECK(mnList.GetMN(dmn->proTxHash) == dmn);
+        BOOST_CHECK(view->proTxHashes[i] == dmn->proTxHash);
+        BOOST_CHECK(view->confirmedHashesWithProRegTxHash[i] == dmn->pdmnState->confirmedHashWithProRegTxHash);
+        BOOST_CHECK_EQUAL(view->lastPaidHeights[i], dmn->pdmnState->nLastPaidHeight);
+        BOOST_CHECK(view->services[i] == dmn->pdmnState->addr);
+        BOOST_CHECK_EQUAL(view->IsValid(i), CDeterministicMNList::IsMNValid(dmn));
+        BOOST_CHECK_EQUAL(view->IsConfirmed(i), !dmn->pdmnState->confirmedHash.IsNull());
+        if (i > 0) {
+            BOOST_CHECK(view->proTxHashes[i - 1] < view->proTxHashes[i]);
+        }
+        nValid += view->IsValid(i);
+    }
+    BOOST_CHECK_EQUAL(nValid, mnList.GetValidMNsCount());
+
+    // copies share the view until they are modified
+    auto mnList2 = mnList;
+    BOOST_CHECK(mnList2.GetView() == view);
+    mnList2.RemoveMN(view->proTxHashes[0]);
+    auto view2 = mnList2.GetView();
+    BOOST_CHECK(view2 != view);
+    BOOST_CHECK_EQUAL(view2->size(), view->size() - 1);
+    BOOST_CHECK(mnList.GetView() == view);
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_undo_batch, TestChainDIP3Setup)
+{
+    auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
+    std::vector<uint256> dmnHashes;
+    for (int port = 1; port <= 3; port++) {
+        CKey ownerKey;
+        CBLSSecretKey operatorKey;
+        auto tx = CreateProRegTx(utxos, port, GenerateRandomAddress(), coinbaseKey, ownerKey, operatorKey);
+        dmnHashes.emplace_back(tx.GetHash());
+        CreateAndProcessBlock({tx}, coinbaseKey);
+        deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    }
+    CBlockIndex* pindexFirst = chainActive[chainActive.Height() - 2];
+
+    std::vector<CDeterministicMNList> vecNotified;
+    auto connection = uiInterface.NotifyMasternodeListChanged.connect([&](const CDeterministicMNList& newList) {
+        vecNotified.emplace_back(newList);
+    });
+
+    // disconnecting all 3 blocks is announced once, with the list of the new tip
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), pindexFirst));
+        BOOST_CHECK(chainActive.Tip() == pindexFirst->pprev);
+    }
+    connection.disconnect();
+
+    BOOST_REQUIRE_EQUAL(vecNotified.size(), 1);
+    BOOST_CHECK(vecNotified[0].GetBlockHash() == pindexFirst->pprev->GetBlockHash());
+    for (const auto& proTxHash : dmnHashes) {
+        BOOST_CHECK(!vecNotified[0].HasMN(proTxHash));
+    }
+
+    deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    BOOST_CHECK_EQUAL(deterministicMNManager->GetListAtChainTip().GetAllMNsCount(), vecNotified[0].GetAllMNsCount());
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_calculate_quorum, BasicTestingSetup)
+{
+    // unconfirmed and banned MNs are never quorum members
+    CDeterministicMNList mnList(uint256(), 1000, 0);
+    for (uint64_t i = 0; i < 100; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>(i);
+        dmn->proTxHash = InsecureRand256();
+        dmn->collateralOutpoint = COutPoint(InsecureRand256(), 0);
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->keyIDOwner = CKeyID(uint160(std::vector<unsigned char>(20, (unsigned char)(i + 1))));
+        if (i % 10 != 0) {
+            state->UpdateConfirmedHash(dmn->proTxHash, InsecureRand256());
+        }
+        if (i % 7 == 0) {
+            state->BanIfNotBanned(900);
+        }
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    }
+
+    // reference implementation: hash each MN separately and sort all of them
+    uint256 modifier = InsecureRand256();
+    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
+    mnList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
+        if (dmn->pdmnState->confirmedHash.IsNull()) {
+            return;
+        }
+        uint256 h;
+        CSHA256().Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), 32).Write(modifier.begin(), 32).Finalize(h.begin());
+        scores.emplace_back(UintToArith256(h), dmn);
+    });
+    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+        return a.first < b.first;
+    });
+
+    for (size_t maxSize : {10, 50, 200}) {
+        auto members = mnList.CalculateQuorum(maxSize, modifier);
+        BOOST_REQUIRE_EQUAL(members.size(), std::min(maxSize, scores.size()));
+        for (size_t i = 0; i < members.size(); i++) {
+            BOOST_CHECK(members[i] == scores[i].second);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dip3_dmnlist_snapshot_format)
+{
+    CDeterministicMNListSnapshot snapshot;
+    snapshot.blockHash = uint256S("aa");
+    snapshot.nHeight = 1000;
+    snapshot.nTotalRegisteredCount = 12;
+    // one MN with the collateral in the ProRegTx and one with an external collateral
+    snapshot.entries.push_back({uint256S("01"), 3, COutPoint(uint256S("01"), 1), 0, uint256S("f1")});
+    snapshot.entries.push_back({uint256S("02"), 11, COutPoint(uint256S("03"), 70000), 5000, uint256S("f2")});
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << snapshot;
+    const size_t nSize = ss.size();
+
+    CDeterministicMNListSnapshot snapshot2;
+    ss >> snapshot2;
+    BOOST_CHECK_EQUAL(snapshot2.blockHash.ToString(), snapshot.blockHash.ToString());
+    BOOST_CHECK_EQUAL(snapshot2.nHeight, snapshot.nHeight);
+    BOOST_CHECK_EQUAL(snapshot2.nTotalRegisteredCount, snapshot.nTotalRegisteredCount);
+    BOOST_REQUIRE_EQUAL(snapshot2.entries.size(), snapshot.entries.size());
+    for (size_t i = 0; i < snapshot.entries.size(); i++) {
+        const auto& a = snapshot.entries[i];
+        const auto& b = snapshot2.entries[i];
+        BOOST_CHECK(a.proTxHash == b.proTxHash);
+        BOOST_CHECK_EQUAL(a.internalId, b.internalId);
+        BOOST_CHECK(a.collateralOutpoint == b.collateralOutpoint);
+        BOOST_CHECK_EQUAL(a.nOperatorReward, b.nOperatorReward);
+        BOOST_CHECK(a.stateHash == b.stateHash);
+    }
+
+    // the collateral hash is only stored for the external collateral
+    ss.clear();
+    snapshot.entries[0].collateralOutpoint.hash = uint256S("04");
+    ss << snapshot;
+    BOOST_CHECK_EQUAL(ss.size(), nSize + 32);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
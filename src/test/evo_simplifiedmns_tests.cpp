@@ -7,6 +7,7 @@
 #include <bls/bls.h>
 #include <evo/simplifiedmns.h>
 #include <netbase.h>
+#include <random.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -67,4 +68,66 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
 
     BOOST_CHECK(expectedMerkleRoot == calculatedMerkleRoot);
 }
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkletree_incremental)
+{
+    FastRandomContext rng;
+
+    auto makeEntry = [&]() {
+        CSimplifiedMNListEntry smle;
+        smle.proRegTxHash = rng.rand256();
+        smle.confirmedHash = rng.rand256();
+        smle.isValid = true;
+        return smle;
+    };
+
+    std::vector<CSimplifiedMNListEntry> entries;
+    for (size_t i = 0; i < 37; i++) {
+        entries.emplace_back(makeEntry());
+    }
+
+    CSimplifiedMNListMerkleTree tree;
+    tree.Build(CSimplifiedMNList(entries));
+    BOOST_CHECK(tree.GetRoot() == CSimplifiedMNList(entries).CalcMerkleRoot());
+
+    for (size_t round = 0; round < 100; round++) {
+        std::vector<std::pair<uint256, uint256>> updated;
+        std::vector<uint256> removed;
+
+        // a few updates, additions and removals per round, similar to what a block does to the list
+        size_t changeCount = rng.randrange(4);
+        for (size_t i = 0; i < changeCount && !entries.empty(); i++) {
+            auto& e = entries[rng.randrange(entries.size())];
+            e.confirmedHash = rng.rand256();
+            updated.emplace_back(e.proRegTxHash, e.CalcHash());
+        }
+        if (rng.randbool()) {
+            entries.emplace_back(makeEntry());
+            updated.emplace_back(entries.back().proRegTxHash, entries.back().CalcHash());
+        }
+        if (rng.randbool() && !entries.empty()) {
+            size_t idx = rng.randrange(entries.size());
+            // don't remove an entry which was updated in the same round
+            if (std::none_of(updated.begin(), updated.end(), [&](const std::pair<uint256, uint256>& p) { return p.first == entries[idx].proRegTxHash; })) {
+                removed.emplace_back(entries[idx].proRegTxHash);
+                entries.erase(entries.begin() + idx);
+            }
+        }
+
+        tree.Update(updated, removed);
+
+        bool mutated1, mutated2;
+        BOOST_CHECK_EQUAL(tree.size(), entries.size());
+        BOOST_CHECK(tree.GetRoot(&mutated1) == CSimplifiedMNList(entries).CalcMerkleRoot(&mutated2));
+        BOOST_CHECK_EQUAL(mutated1, mutated2);
+    }
+
+    // removing all entries results in an empty tree
+    std::vector<uint256> removed;
+    for (const auto& e : entries) {
+        removed.emplace_back(e.proRegTxHash);
+    }
+    tree.Update({}, removed);
+    BOOST_CHECK(tree.GetRoot().IsNull());
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,66 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <expiryqueue.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+BOOST_FIXTURE_TEST_SUITE(expiryqueue_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(expiryqueue_pop_expired)
+{
+    expiry_queue<std::string> queue;
+    queue.schedule("c", 30);
+    queue.schedule("a", 10);
+    queue.schedule("b", 20);
+    queue.schedule("d", 20);
+    BOOST_CHECK_EQUAL(queue.size(), 4U);
+
+    BOOST_CHECK(queue.pop_expired(9).empty());
+    BOOST_CHECK(queue.pop_expired(10) == std::vector<std::string>({"a"}));
+    BOOST_CHECK_EQUAL(queue.size(), 3U);
+
+    // keys with the same expiry time are popped together, in the order they were scheduled in
+    BOOST_CHECK(queue.pop_expired(25) == std::vector<std::string>({"b", "d"}));
+    BOOST_CHECK_EQUAL(queue.size(), 1U);
+
+    BOOST_CHECK(queue.pop_expired(100) == std::vector<std::string>({"c"}));
+    BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(expiryqueue_reschedule_and_erase)
+{
+    expiry_queue<int> queue;
+    queue.schedule(1, 10);
+    queue.schedule(2, 20);
+    queue.schedule(3, 30);
+
+    // rescheduling replaces the previous time, in both directions
+    queue.schedule(1, 25);
+    queue.schedule(3, 5);
+    BOOST_CHECK_EQUAL(queue.size(), 3U);
+    int64_t nExpiry;
+    BOOST_CHECK(queue.get(1, nExpiry));
+    BOOST_CHECK_EQUAL(nExpiry, 25);
+
+    BOOST_CHECK(queue.erase(2));
+    BOOST_CHECK(!queue.erase(2));
+    BOOST_CHECK(!queue.get(2, nExpiry));
+
+    BOOST_CHECK(queue.pop_expired(20) == std::vector<int>({3}));
+    BOOST_CHECK(queue.pop_expired(30) == std::vector<int>({1}));
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK_EQUAL(queue.DynamicUsage(), 0U);
+
+    queue.schedule(4, 40);
+    queue.clear();
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(queue.pop_expired(100).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-db.h>
+#include <utilstrencodings.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_db_tests, BasicTestingSetup)
+
+static CGovernanceVote MakeVote(const COutPoint& outpoint, const uint256& nParentHash, vote_outcome_enum_t eOutcome, int64_t nTime)
+{
+    CGovernanceVote vote(outpoint, nParentHash, VOTE_SIGNAL_FUNDING, eOutcome);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(governance_db_roundtrip)
+{
+    CGovernanceDb db(1 << 20, true);
+    BOOST_CHECK(!db.HasVersion());
+
+    std::string strData = HexStr(std::string("[[\"proposal\",{\"name\":\"test\"}]]"));
+    CGovernanceObject govobj(uint256(), 1, 1000, uint256S("01"), strData);
+    const uint256 nHash = govobj.GetHash();
+
+    COutPoint outpoint1(uint256S("aa"), 0);
+    COutPoint outpoint2(uint256S("bb"), 0);
+    CGovernanceVote vote1 = MakeVote(outpoint1, nHash, VOTE_OUTCOME_NO, 2000);
+    CGovernanceVote vote2 = MakeVote(outpoint1, nHash, VOTE_OUTCOME_YES, 3000);
+    CGovernanceVote vote3 = MakeVote(outpoint2, nHash, VOTE_OUTCOME_YES, 2500);
+    CGovernanceVote voteOrphan = MakeVote(outpoint1, uint256S("cc"), VOTE_OUTCOME_YES, 2000);
+
+    // Votes are written one by one, as if they were accepted after the object was written
+    CDBBatch batch(db);
+    db.WriteObject(batch, govobj);
+    db.WriteVote(batch, vote2);
+    db.WriteVote(batch, vote1);
+    db.WriteVote(batch, vote3);
+    db.WriteVote(batch, voteOrphan);
+    db.WriteVersion(batch);
+    db.WriteBatch(batch);
+    BOOST_CHECK(db.HasVersion());
+    BOOST_CHECK_EQUAL(db.GetVoteHashes(nHash).size(), 3U);
+
+    std::map<uint256, CGovernanceObject> mapObjects;
+    std::map<uint256, uint256> mapRecordHashes;
+    db.ReadObjects(mapObjects, mapRecordHashes);
+    BOOST_CHECK_EQUAL(mapObjects.size(), 1U);
+    BOOST_CHECK(mapObjects.count(nHash));
+    BOOST_CHECK(mapRecordHashes[nHash] == CGovernanceDb::GetRecordHash(govobj));
+
+    // The older vote of the first masternode is dropped no matter in which order the votes are stored
+    const CGovernanceObject& loaded = mapObjects.at(nHash);
+    BOOST_CHECK_EQUAL(loaded.GetVoteFile().GetVoteCount(), 2);
+    BOOST_CHECK(!loaded.GetVoteFile().HasVote(vote1.GetHash()));
+    BOOST_CHECK(loaded.GetVoteFile().HasVote(vote2.GetHash()));
+    BOOST_CHECK(loaded.GetVoteFile().HasVote(vote3.GetHash()));
+    BOOST_CHECK_EQUAL(loaded.GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(loaded.GetNoCount(VOTE_SIGNAL_FUNDING), 0);
+
+    // The vote tally is rebuilt when the object is deserialized
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << loaded;
+    CGovernanceObject reloaded;
+    ss >> reloaded;
+    BOOST_CHECK_EQUAL(reloaded.GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(reloaded.GetAbstainCount(VOTE_SIGNAL_FUNDING), 0);
+
+    // The votes weren't part of the stored record yet, so the loaded object differs from it
+    BOOST_CHECK(mapRecordHashes[nHash] != CGovernanceDb::GetRecordHash(loaded));
+
+    // Votes without an object are dropped
+    BOOST_CHECK(db.GetVoteHashes(uint256S("cc")).empty());
+
+    batch.Clear();
+    db.EraseObject(batch, nHash);
+    db.WriteBatch(batch);
+    BOOST_CHECK(db.GetVoteHashes(nHash).empty());
+    mapObjects.clear();
+    mapRecordHashes.clear();
+    db.ReadObjects(mapObjects, mapRecordHashes);
+    BOOST_CHECK(mapObjects.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
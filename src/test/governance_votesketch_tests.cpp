@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-votesketch.h>
+#include <random.h>
+#include <streams.h>
+#include <version.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votesketch_tests, BasicTestingSetup)
+
+static std::vector<uint256> MakeHashes(size_t nCount)
+{
+    std::vector<uint256> vecHashes;
+    for (size_t i = 0; i < nCount; i++) {
+        vecHashes.emplace_back(InsecureRand256());
+    }
+    return vecHashes;
+}
+
+static bool Contains(const std::vector<uint256>& vecHashes, const uint256& hash)
+{
+    return std::find(vecHashes.begin(), vecHashes.end(), hash) != vecHashes.end();
+}
+
+BOOST_AUTO_TEST_CASE(votesketch_decode)
+{
+    std::vector<uint256> vecCommon = MakeHashes(1000);
+    std::vector<uint256> vecOurs = MakeHashes(30);
+    std::vector<uint256> vecTheirs = MakeHashes(20);
+
+    CGovernanceVoteSketch theirSketch(128, insecure_rand_ctx.rand64());
+    for (const auto& hash : vecCommon) theirSketch.Insert(hash);
+    for (const auto& hash : vecTheirs) theirSketch.Insert(hash);
+
+    // The sketch goes over the wire
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << theirSketch;
+    CGovernanceVoteSketch received;
+    ss >> received;
+    BOOST_CHECK(received.IsValid());
+    BOOST_CHECK_EQUAL(received.GetCellCount(), theirSketch.GetCellCount());
+
+    CGovernanceVoteSketch diff = CGovernanceVoteSketch::CreateMatching(received);
+    for (const auto& hash : vecCommon) diff.Insert(hash);
+    for (const auto& hash : vecOurs) diff.Insert(hash);
+    BOOST_CHECK(diff.Subtract(received));
+
+    std::vector<uint256> vecExtra, vecMissing;
+    BOOST_CHECK(diff.Decode(vecExtra, vecMissing));
+    BOOST_CHECK_EQUAL(vecExtra.size(), vecOurs.size());
+    BOOST_CHECK_EQUAL(vecMissing.size(), vecTheirs.size());
+    for (const auto& hash : vecOurs) BOOST_CHECK(Contains(vecExtra, hash));
+    for (const auto& hash : vecTheirs) BOOST_CHECK(Contains(vecMissing, hash));
+
+    // Equal sets decode to nothing
+    CGovernanceVoteSketch same = CGovernanceVoteSketch::CreateMatching(theirSketch);
+    BOOST_CHECK(same.Subtract(theirSketch));
+    BOOST_CHECK(!same.Subtract(CGovernanceVoteSketch(256, 0)));
+    vecExtra.clear();
+    vecMissing.clear();
+    for (const auto& hash : vecCommon) same.Insert(hash);
+    for (const auto& hash : vecTheirs) same.Insert(hash);
+    BOOST_CHECK(same.Decode(vecExtra, vecMissing));
+    BOOST_CHECK(vecExtra.empty() && vecMissing.empty());
+}
+
+BOOST_AUTO_TEST_CASE(votesketch_overflow)
+{
+    // A difference much larger than the capacity can't be decoded
+    CGovernanceVoteSketch sketch(16, insecure_rand_ctx.rand64());
+    for (const auto& hash : MakeHashes(500)) sketch.Insert(hash);
+
+    std::vector<uint256> vecExtra, vecMissing;
+    BOOST_CHECK(!sketch.Decode(vecExtra, vecMissing));
+
+    BOOST_CHECK(!CGovernanceVoteSketch().IsValid());
+    BOOST_CHECK(CGovernanceVoteSketch(1000000, 0).IsValid());
+    BOOST_CHECK_EQUAL(CGovernanceVoteSketch(1000000, 0).GetCellCount(), CGovernanceVoteSketch::MAX_CELLS);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
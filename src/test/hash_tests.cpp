@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <hash.h>
+#include <primitives/block.h>
+#include <streams.h>
 #include <utilstrencodings.h>
 #include <test/test_dash.h>
 
@@ -149,4 +151,35 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(blockheader_cached_hash)
+{
+    CBlockHeader header;
+    header.nVersion = 0x20000000;
+    header.hashPrevBlock = SerializeHash(1);
+    header.hashMerkleRoot = SerializeHash(2);
+    header.nTime = 1600000000;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 42;
+
+    std::vector<unsigned char> vch(CBlockHeader::SERIALIZED_SIZE);
+    CVectorWriter(SER_GETHASH, PROTOCOL_VERSION, vch, 0) << header;
+    const uint256 hash = HashX11((const char*)vch.data(), (const char*)vch.data() + vch.size());
+
+    BOOST_CHECK(header.GetHash() == hash);
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // Any change of the header invalidates the cached hash, changing it back makes it match again
+    header.nNonce++;
+    BOOST_CHECK(header.GetHash() != hash);
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // Copies carry the cache, but don't share it
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    block.nTime++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK(header.GetHash() == hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <llmq/quorums_latency.h>
+#include <utiltime.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+BOOST_FIXTURE_TEST_SUITE(llmq_latency_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(latency_histogram)
+{
+    CLatencyHistogram histogram;
+    histogram.Add(-5);
+    histogram.Add(10);
+    histogram.Add(11);
+    histogram.Add(120000);
+    BOOST_CHECK_EQUAL(histogram.count, 4U);
+    BOOST_CHECK_EQUAL(histogram.totalMillis, 120021);
+    BOOST_CHECK_EQUAL(histogram.maxMillis, 120000);
+    BOOST_CHECK_EQUAL(histogram.buckets[0], 2U);
+    BOOST_CHECK_EQUAL(histogram.buckets[1], 1U);
+    BOOST_CHECK_EQUAL(histogram.buckets.back(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(latency_tracker)
+{
+    CLatencyTracker tracker;
+    uint256 txid = InsecureRand256();
+    const std::string& strName = CLatencyTracker::STAGE_NAMES[(size_t)LatencyStage::IS_TX_TO_ISLOCK];
+
+    // Stages of unknown events are not recorded
+    BOOST_CHECK(!tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid, LatencyStage::IS_TX_TO_ISLOCK));
+
+    tracker.AddEvent(LatencyEvent::TX_FIRST_SEEN, txid);
+    MilliSleep(20);
+    // Later events don't move the start of the measurement
+    tracker.AddEvent(LatencyEvent::TX_FIRST_SEEN, txid);
+    BOOST_CHECK(tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid, LatencyStage::IS_TX_TO_INPUT_VOTES));
+    BOOST_CHECK(tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid, LatencyStage::IS_TX_TO_ISLOCK, true));
+    BOOST_CHECK(!tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid, LatencyStage::IS_TX_TO_ISLOCK));
+
+    auto stats = tracker.GetStats();
+    BOOST_CHECK_EQUAL(stats.size(), (size_t)LatencyStage::COUNT);
+    BOOST_CHECK_EQUAL(stats[strName].count, 1U);
+    BOOST_CHECK(stats[strName].maxMillis >= 20);
+    BOOST_CHECK_EQUAL(stats[CLatencyTracker::STAGE_NAMES[(size_t)LatencyStage::IS_TX_TO_INPUT_VOTES]].count, 1U);
+    BOOST_CHECK_EQUAL(stats[CLatencyTracker::STAGE_NAMES[(size_t)LatencyStage::CL_BLOCK_TO_CLSIG]].count, 0U);
+
+    tracker.AddEvent(LatencyEvent::BLOCK_RECEIVED, txid);
+    tracker.EraseEvent(LatencyEvent::BLOCK_RECEIVED, txid);
+    BOOST_CHECK(!tracker.RecordStage(LatencyEvent::BLOCK_RECEIVED, txid, LatencyStage::CL_BLOCK_TO_CLSIG));
+
+    tracker.Reset();
+    BOOST_CHECK_EQUAL(tracker.GetStats()[strName].count, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(latency_tracker_quorums)
+{
+    CLatencyTracker tracker;
+    uint256 txid1 = InsecureRand256();
+    uint256 txid2 = InsecureRand256();
+    uint256 txid3 = InsecureRand256();
+    uint256 quorumHash = InsecureRand256();
+
+    tracker.AddEvent(LatencyEvent::TX_FIRST_SEEN, txid1);
+    tracker.AddEvent(LatencyEvent::TX_FIRST_SEEN, txid2);
+    tracker.AddEvent(LatencyEvent::TX_FIRST_SEEN, txid3);
+    BOOST_CHECK(tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid1, LatencyStage::IS_TX_TO_ISLOCK, true, Consensus::LLMQ_50_60, quorumHash));
+    BOOST_CHECK(tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid2, LatencyStage::IS_TX_TO_ISLOCK, true, Consensus::LLMQ_50_60, quorumHash));
+    // Without a known quorum only the overall histogram is updated
+    BOOST_CHECK(tracker.RecordStage(LatencyEvent::TX_FIRST_SEEN, txid3, LatencyStage::IS_TX_TO_ISLOCK, true));
+
+    auto quorumStats = tracker.GetQuorumStats();
+    BOOST_REQUIRE_EQUAL(quorumStats.size(), 1U);
+    BOOST_CHECK(quorumStats.begin()->first == std::make_tuple(LatencyStage::IS_TX_TO_ISLOCK, Consensus::LLMQ_50_60, quorumHash));
+    BOOST_CHECK_EQUAL(quorumStats.begin()->second.count, 2U);
+    BOOST_CHECK_EQUAL(tracker.GetStats()[CLatencyTracker::STAGE_NAMES[(size_t)LatencyStage::IS_TX_TO_ISLOCK]].count, 3U);
+
+    tracker.Reset();
+    BOOST_CHECK(tracker.GetQuorumStats().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
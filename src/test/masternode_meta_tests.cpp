@@ -0,0 +1,79 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <flat-database.h>
+#include <masternode/masternode-meta.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternode_meta_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(masternode_meta_db_roundtrip)
+{
+    SetDataDir("masternode_meta_db_roundtrip");
+    const uint256 proTxHash1 = InsecureRand256();
+    const uint256 proTxHash2 = InsecureRand256();
+    const uint256 govHash = InsecureRand256();
+
+    {
+        CMasternodeMetaMan metaman;
+        BOOST_REQUIRE(metaman.LoadCache(false));
+        BOOST_CHECK(metaman.GetMetaInfo(proTxHash1, false) == nullptr);
+        metaman.GetMetaInfo(proTxHash1)->SetLastOutboundAttempt(1000);
+        metaman.AllowMixing(proTxHash2);
+        metaman.DisallowMixing(proTxHash2);
+        metaman.AddGovernanceVote(proTxHash2, govHash);
+        metaman.FlushCache(true);
+
+        // Only changed entries are written, but the later change must still end up in the db
+        metaman.GetMetaInfo(proTxHash1)->SetLastOutboundSuccess(2000);
+        metaman.FlushCache(true);
+        metaman.CloseCache();
+    }
+
+    CMasternodeMetaMan metaman;
+    BOOST_REQUIRE(metaman.LoadCache(false));
+    BOOST_CHECK_EQUAL(metaman.GetMetaInfoCount(), 2U);
+    BOOST_CHECK_EQUAL(metaman.GetDsqCount(), 1);
+    auto mm1 = metaman.GetMetaInfo(proTxHash1, false);
+    BOOST_REQUIRE(mm1 != nullptr);
+    BOOST_CHECK_EQUAL(mm1->GetLastOutboundAttempt(), 1000);
+    BOOST_CHECK_EQUAL(mm1->GetLastOutboundSuccess(), 2000);
+    auto mm2 = metaman.GetMetaInfo(proTxHash2, false);
+    BOOST_REQUIRE(mm2 != nullptr);
+    BOOST_CHECK_EQUAL(mm2->GetLastDsq(), 1);
+    BOOST_CHECK_EQUAL(mm2->GetMixingTxCount(), 1);
+    metaman.CloseCache();
+
+    // Wiping drops everything
+    BOOST_REQUIRE(metaman.LoadCache(true));
+    BOOST_CHECK_EQUAL(metaman.GetMetaInfoCount(), 0U);
+    metaman.CloseCache();
+}
+
+BOOST_AUTO_TEST_CASE(masternode_meta_migrate_flatdb)
+{
+    fs::path dir = SetDataDir("masternode_meta_migrate_flatdb");
+    const uint256 proTxHash = InsecureRand256();
+
+    {
+        CMasternodeMetaMan metaman;
+        metaman.GetMetaInfo(proTxHash)->SetLastOutboundSuccess(3000);
+        CFlatDB<CMasternodeMetaMan> flatdb("mncache.dat", "magicMasternodeCache");
+        BOOST_REQUIRE(flatdb.Dump(metaman));
+    }
+    BOOST_REQUIRE(fs::exists(dir / "mncache.dat"));
+
+    CMasternodeMetaMan metaman;
+    BOOST_REQUIRE(metaman.LoadCache(false));
+    BOOST_CHECK(!fs::exists(dir / "mncache.dat"));
+    auto mm = metaman.GetMetaInfo(proTxHash, false);
+    BOOST_REQUIRE(mm != nullptr);
+    BOOST_CHECK_EQUAL(mm->GetLastOutboundSuccess(), 3000);
+    metaman.CloseCache();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
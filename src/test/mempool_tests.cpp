@@ -751,4 +751,57 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolChainRemoveForBlockTest)
+{
+    size_t ancestors, descendants;
+
+    CTxMemPool pool;
+    LOCK(pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // [tx1].0 <- [tx2].0 <- [tx3].0 <- [tx5]
+    //   |                              |
+    //   \---1 <- [tx4].0 ------>-------/
+    //
+    CTransactionRef tx1 = make_tx(MK_OUTPUTS(5 * COIN, 5 * COIN));
+    CTransactionRef tx2 = make_tx(MK_OUTPUTS(490 * CENT), MK_INPUTS(tx1));
+    CTransactionRef tx3 = make_tx(MK_OUTPUTS(480 * CENT), MK_INPUTS(tx2));
+    CTransactionRef tx4 = make_tx(MK_OUTPUTS(490 * CENT), MK_INPUTS(tx1), MK_INPUT_IDX(1));
+    CTransactionRef tx5 = make_tx(MK_OUTPUTS(960 * CENT), MK_INPUTS(tx3, tx4));
+    pool.addUnchecked(tx1->GetHash(), entry.Fee(10000LL).FromTx(*tx1));
+    pool.addUnchecked(tx2->GetHash(), entry.Fee(20000LL).FromTx(*tx2));
+    pool.addUnchecked(tx3->GetHash(), entry.Fee(30000LL).FromTx(*tx3));
+    pool.addUnchecked(tx4->GetHash(), entry.Fee(40000LL).FromTx(*tx4));
+    pool.addUnchecked(tx5->GetHash(), entry.Fee(50000LL).FromTx(*tx5));
+
+    // Mine tx1 and tx2 together, their package statistics are applied to the
+    // remaining transactions at once
+    pool.removeForBlock({tx1, tx2}, 1);
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+
+    pool.GetTransactionAncestry(tx3->GetHash(), ancestors, descendants);
+    BOOST_CHECK_EQUAL(ancestors, 1ULL);
+    BOOST_CHECK_EQUAL(descendants, 2ULL);
+    pool.GetTransactionAncestry(tx4->GetHash(), ancestors, descendants);
+    BOOST_CHECK_EQUAL(ancestors, 1ULL);
+    BOOST_CHECK_EQUAL(descendants, 2ULL);
+    pool.GetTransactionAncestry(tx5->GetHash(), ancestors, descendants);
+    BOOST_CHECK_EQUAL(ancestors, 3ULL);
+    BOOST_CHECK_EQUAL(descendants, 1ULL);
+
+    CTxMemPool::txiter it3 = pool.mapTx.find(tx3->GetHash());
+    CTxMemPool::txiter it4 = pool.mapTx.find(tx4->GetHash());
+    CTxMemPool::txiter it5 = pool.mapTx.find(tx5->GetHash());
+    BOOST_CHECK_EQUAL(it3->GetSizeWithAncestors(), it3->GetTxSize());
+    BOOST_CHECK_EQUAL(it3->GetModFeesWithAncestors(), 30000LL);
+    BOOST_CHECK_EQUAL(it3->GetSigOpCountWithAncestors(), it3->GetSigOpCount());
+    BOOST_CHECK_EQUAL(it3->GetSizeWithDescendants(), it3->GetTxSize() + it5->GetTxSize());
+    BOOST_CHECK_EQUAL(it3->GetModFeesWithDescendants(), 80000LL);
+    BOOST_CHECK_EQUAL(it5->GetSizeWithAncestors(), it3->GetTxSize() + it4->GetTxSize() + it5->GetTxSize());
+    BOOST_CHECK_EQUAL(it5->GetModFeesWithAncestors(), 120000LL);
+    BOOST_CHECK(pool.GetMemPoolParents(it3).empty());
+    BOOST_CHECK(pool.GetMemPoolParents(it4).empty());
+    BOOST_CHECK_EQUAL(pool.GetMemPoolParents(it5).size(), 2U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -206,6 +206,22 @@ void TestPackageSelection(const CChainParams& chainparams, const CScript& script
     mempool.addUnchecked(tx.GetHash(), entry.Fee(10000).FromTx(tx));
     pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
+
+    // The next template starts from the selection of the previous one, which must give the same block
+    std::unique_ptr<CBlockTemplate> pblocktemplate2 = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate2->block.vtx.size(), pblocktemplate->block.vtx.size());
+    for (size_t i = 1; i < pblocktemplate->block.vtx.size(); ++i) {
+        BOOST_CHECK(pblocktemplate2->block.vtx[i]->GetHash() == pblocktemplate->block.vtx[i]->GetHash());
+    }
+
+    // Deprioritising a selected transaction below the block min tx fee must not keep it in the block
+    mempool.PrioritiseTransaction(hashMediumFeeTx, -10000);
+    pblocktemplate2 = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate2->block.vtx.size(), pblocktemplate->block.vtx.size() - 1);
+    for (size_t i = 0; i < pblocktemplate2->block.vtx.size(); ++i) {
+        BOOST_CHECK(pblocktemplate2->block.vtx[i]->GetHash() != hashMediumFeeTx);
+    }
+    mempool.PrioritiseTransaction(hashMediumFeeTx, 10000);
 }
 
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
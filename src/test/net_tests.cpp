@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include <addrman.h>
+#include <messagecapture.h>
 #include <test/test_dash.h>
 #include <string>
 #include <boost/test/unit_test.hpp>
@@ -189,6 +190,64 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(netmessage_buffer_pool)
+{
+    CNetMessageBufferPool pool;
+
+    CPublicSerializeData buf = pool.Acquire(1000);
+    BOOST_CHECK_GE(buf.capacity(), 1000U);
+    BOOST_CHECK(buf.empty());
+    BOOST_CHECK_EQUAL(pool.GetMisses(), 1U);
+    buf.resize(1000, 'x');
+    const size_t nCapacity = buf.capacity();
+    const char* pData = buf.data();
+    pool.Release(std::move(buf));
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), nCapacity);
+
+    // the released buffer is handed out again, cleared
+    CPublicSerializeData buf2 = pool.Acquire(800);
+    BOOST_CHECK_EQUAL(pool.GetHits(), 1U);
+    BOOST_CHECK(buf2.data() == pData);
+    BOOST_CHECK(buf2.empty());
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), 0U);
+
+    // a larger request is not served from a smaller buffer
+    pool.Release(std::move(buf2));
+    CPublicSerializeData buf3 = pool.Acquire(4000);
+    BOOST_CHECK_GE(buf3.capacity(), 4000U);
+    BOOST_CHECK_EQUAL(pool.GetMisses(), 2U);
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), nCapacity);
+
+    // oversized buffers are freed instead of pooled
+    CPublicSerializeData bufLarge;
+    bufLarge.reserve(CNetMessageBufferPool::MAX_BUFFER_SIZE + 1);
+    pool.Release(std::move(bufLarge));
+    BOOST_CHECK_EQUAL(pool.GetPooledBytes(), nCapacity);
+
+    // the pool doesn't grow beyond MAX_POOLED_BYTES
+    for (size_t i = 0; i < 2 * CNetMessageBufferPool::MAX_POOLED_BYTES / CNetMessageBufferPool::MAX_BUFFER_SIZE; i++) {
+        CPublicSerializeData b;
+        b.reserve(CNetMessageBufferPool::MAX_BUFFER_SIZE);
+        pool.Release(std::move(b));
+    }
+    BOOST_CHECK_LE(pool.GetPooledBytes(), CNetMessageBufferPool::MAX_POOLED_BYTES);
+}
+
+BOOST_AUTO_TEST_CASE(send_priorities)
+{
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::QSIGSHARE), SEND_PRIORITY_CRITICAL);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::ISLOCK), SEND_PRIORITY_CRITICAL);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::CLSIG), SEND_PRIORITY_CRITICAL);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::BLOCK), SEND_PRIORITY_BLOCKS);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::HEADERS), SEND_PRIORITY_BLOCKS);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::MNGOVERNANCEOBJECT), SEND_PRIORITY_BULK);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::INV), SEND_PRIORITY_NORMAL);
+    BOOST_CHECK_EQUAL(GetSendPriority("unknown"), SEND_PRIORITY_NORMAL);
+    for (int i = 0; i < NUM_SEND_PRIORITIES; i++) {
+        BOOST_CHECK(SendPriorityToString(i) != "unknown");
+    }
+}
+
 BOOST_AUTO_TEST_CASE(PoissonNextSend)
 {
     g_mock_deterministic_tests = true;
@@ -241,4 +300,95 @@ BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
     BOOST_CHECK(1);
 }
 
+BOOST_AUTO_TEST_CASE(tx_announcement_queue)
+{
+    CTxAnnouncementQueue queue;
+    auto collect = [&queue](NodeId id, size_t nMax) {
+        std::vector<uint256> vHashes;
+        queue.ForEachPending(id, [&](const uint256& hash) {
+            vHashes.push_back(hash);
+            return vHashes.size() < nMax;
+        });
+        return vHashes;
+    };
+    auto reverse = [](std::vector<uint256>& vBatch) { std::reverse(vBatch.begin(), vBatch.end()); };
+
+    // without peers nothing is queued
+    queue.Push(uint256S("1"));
+    queue.Flush(reverse);
+    BOOST_CHECK_EQUAL(queue.size(), 0U);
+
+    queue.AddPeer(1);
+    queue.Push(uint256S("1"));
+    queue.Push(uint256S("2"));
+    queue.Push(uint256S("1"));
+    // nothing is pending before the batch is flushed, and the batch is sorted by the flushing function
+    BOOST_CHECK_EQUAL(queue.GetPendingCount(1), 0U);
+    queue.Flush(reverse);
+    BOOST_CHECK_EQUAL(queue.GetPendingCount(1), 2U);
+
+    // peers only get what is flushed after they were added
+    queue.AddPeer(2);
+    queue.Push(uint256S("3"));
+    queue.Flush(reverse);
+    BOOST_CHECK_EQUAL(queue.GetPendingCount(1), 3U);
+    BOOST_CHECK_EQUAL(queue.GetPendingCount(2), 1U);
+
+    BOOST_CHECK(collect(1, 1) == std::vector<uint256>({uint256S("2")}));
+    BOOST_CHECK(collect(1, 10) == std::vector<uint256>({uint256S("1"), uint256S("3")}));
+    BOOST_CHECK_EQUAL(queue.GetPendingCount(1), 0U);
+
+    // entries are kept until all peers walked past them
+    queue.Push(uint256S("4"));
+    queue.Flush(reverse);
+    BOOST_CHECK_EQUAL(queue.size(), 2U);
+    queue.SkipPending(2);
+    BOOST_CHECK_EQUAL(queue.GetPendingCount(2), 0U);
+    queue.RemovePeer(1);
+    BOOST_CHECK_EQUAL(queue.size(), 0U);
+    BOOST_CHECK(collect(1, 10).empty());
+}
+
+BOOST_AUTO_TEST_CASE(message_capture_roundtrip)
+{
+    fs::path path = GetDataDir() / "capture_test.dat";
+    const std::string strPayload1 = "payload";
+    const std::string strPayload2 = "";
+
+    CMessageCaptureHeader header;
+    header.strPeerAddr = "1.2.3.4:9999";
+    header.fInbound = true;
+    header.nTimeStartMicros = 1000000;
+    {
+        CMessageCaptureWriter writer(fsbridge::fopen(path, "wb"), header);
+        writer.Write(1000500, "inv", strPayload1.data(), strPayload1.size());
+        // out of order times are stored as received at the time of the previous message
+        writer.Write(1000400, "ping", strPayload2.data(), strPayload2.size());
+    }
+
+    CMessageCaptureReader reader(fsbridge::fopen(path, "rb"));
+    BOOST_CHECK_EQUAL(reader.GetHeader().strPeerAddr, header.strPeerAddr);
+    BOOST_CHECK(reader.GetHeader().fInbound);
+    BOOST_CHECK_EQUAL(reader.GetHeader().nTimeStartMicros, header.nTimeStartMicros);
+
+    CCapturedMessage msg;
+    int64_t nTimeMicros;
+    BOOST_CHECK(reader.Read(msg, nTimeMicros));
+    BOOST_CHECK_EQUAL(msg.strCommand, "inv");
+    BOOST_CHECK(msg.vPayload == std::vector<unsigned char>(strPayload1.begin(), strPayload1.end()));
+    BOOST_CHECK_EQUAL(nTimeMicros, 1000500);
+    BOOST_CHECK(reader.Read(msg, nTimeMicros));
+    BOOST_CHECK_EQUAL(msg.strCommand, "ping");
+    BOOST_CHECK(msg.vPayload.empty());
+    BOOST_CHECK_EQUAL(nTimeMicros, 1000500);
+    BOOST_CHECK(!reader.Read(msg, nTimeMicros));
+
+    // anything else is rejected
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        file << std::string("not a capture");
+    }
+    BOOST_CHECK_THROW(CMessageCaptureReader(fsbridge::fopen(path, "rb")), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -316,4 +316,89 @@ BOOST_AUTO_TEST_CASE(netbase_getgroup)
     BOOST_CHECK(CreateInternal("baz.net").GetGroup() == internal_group);
 }
 
+BOOST_AUTO_TEST_CASE(netbase_lookuphosts)
+{
+    // names which don't need the resolver are answered in place, in the order they were passed
+    std::vector<std::vector<CNetAddr>> vResults = LookupHosts({"127.0.0.1", "", "[::1]", "5wyqrzbvrdsumnok.onion"}, 0);
+    BOOST_CHECK_EQUAL(vResults.size(), 4U);
+    BOOST_CHECK(vResults[0] == std::vector<CNetAddr>({ResolveIP("127.0.0.1")}));
+    BOOST_CHECK(vResults[1].empty());
+    BOOST_CHECK(vResults[2] == std::vector<CNetAddr>({ResolveIP("::1")}));
+    BOOST_CHECK_EQUAL(vResults[3].size(), 1U);
+    BOOST_CHECK(vResults[3][0].IsTor());
+
+    BOOST_CHECK(LookupHosts({}, 0).empty());
+}
+
+static void Socks5Reply(Socks5Handshake& handshake, const std::string& strHex)
+{
+    std::vector<unsigned char> data = ParseHex(strHex);
+    // feed the reply in pieces, as it may arrive from the socket
+    for (unsigned char c : data) {
+        BOOST_CHECK(handshake.BytesNeeded() > 0);
+        handshake.Received(&c, 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(netbase_socks5_handshake)
+{
+    {
+        Socks5Handshake handshake("example.com", 9999, nullptr);
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::IN_PROGRESS);
+        BOOST_CHECK_EQUAL(HexStr(handshake.GetSendBuffer()), "050100");
+        // nothing is received before the request was sent completely
+        BOOST_CHECK_EQUAL(handshake.BytesNeeded(), 0U);
+        handshake.Sent(2);
+        BOOST_CHECK(handshake.WantsWrite());
+        handshake.Sent(1);
+        BOOST_CHECK(!handshake.WantsWrite());
+        BOOST_CHECK_EQUAL(handshake.BytesNeeded(), 2U);
+
+        Socks5Reply(handshake, "0500");
+        BOOST_CHECK_EQUAL(HexStr(handshake.GetSendBuffer()), "050100030b6578616d706c652e636f6d270f");
+        handshake.Sent(handshake.GetSendBuffer().size());
+        // succeeded, bound to a domain name and port
+        Socks5Reply(handshake, "05000003");
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::IN_PROGRESS);
+        Socks5Reply(handshake, "0361626300");
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::IN_PROGRESS);
+        Socks5Reply(handshake, "01");
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::SUCCEEDED);
+        BOOST_CHECK_EQUAL(handshake.BytesNeeded(), 0U);
+    }
+    {
+        ProxyCredentials auth;
+        auth.username = "u";
+        auth.password = "pw";
+        Socks5Handshake handshake("a.onion", 80, &auth);
+        BOOST_CHECK_EQUAL(HexStr(handshake.GetSendBuffer()), "05020002");
+        handshake.Sent(handshake.GetSendBuffer().size());
+        Socks5Reply(handshake, "0502");
+        BOOST_CHECK_EQUAL(HexStr(handshake.GetSendBuffer()), "010175027077");
+        handshake.Sent(handshake.GetSendBuffer().size());
+        Socks5Reply(handshake, "0100");
+        BOOST_CHECK_EQUAL(HexStr(handshake.GetSendBuffer()), "0501000307612e6f6e696f6e0050");
+        handshake.Sent(handshake.GetSendBuffer().size());
+        // host unreachable
+        Socks5Reply(handshake, "05040001");
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::FAILED);
+        BOOST_CHECK(handshake.IsDestinationFailure());
+        BOOST_CHECK_EQUAL(handshake.GetError(), "host unreachable");
+    }
+    {
+        // the proxy requires authentication without credentials being offered
+        Socks5Handshake handshake("example.com", 9999, nullptr);
+        handshake.Sent(handshake.GetSendBuffer().size());
+        Socks5Reply(handshake, "0502");
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::FAILED);
+        BOOST_CHECK(!handshake.IsDestinationFailure());
+        BOOST_CHECK(!handshake.WantsWrite());
+    }
+    {
+        Socks5Handshake handshake(std::string(256, 'a'), 9999, nullptr);
+        BOOST_CHECK(handshake.GetStatus() == Socks5Handshake::Status::FAILED);
+        BOOST_CHECK_EQUAL(handshake.GetError(), "Hostname too long");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <miner.h>
 #include <pow.h>
 #include <random.h>
 #include <util.h>
@@ -201,4 +202,40 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+
+BOOST_AUTO_TEST_CASE(solve_block_header)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = chainParams->GetConsensus();
+
+    // About 2^15 hashes per solution, enough for the parallel search to be used
+    CBlockHeader header = chainParams->GenesisBlock().GetBlockHeader();
+    header.nBits = 0x1f020000;
+    header.nNonce = 0;
+
+    CBlockHeader headerSequential = header;
+    uint64_t nTriesSequential = std::numeric_limits<uint64_t>::max();
+    uint64_t nTriesParallel = std::numeric_limits<uint64_t>::max();
+    bool fSequential = SolveBlockHeader(headerSequential, params, std::numeric_limits<uint32_t>::max(), nTriesSequential, 1);
+    bool fParallel = SolveBlockHeader(header, params, std::numeric_limits<uint32_t>::max(), nTriesParallel, 4);
+    BOOST_CHECK(fSequential && fParallel);
+    BOOST_CHECK_EQUAL(header.nNonce, headerSequential.nNonce);
+    BOOST_CHECK_EQUAL(nTriesParallel, nTriesSequential);
+    BOOST_CHECK(CheckProofOfWork(header.GetHash(), header.nBits, params));
+    BOOST_CHECK_EQUAL(std::numeric_limits<uint64_t>::max() - nTriesParallel, (uint64_t)header.nNonce);
+
+    // Running out of tries stops where a sequential search would have stopped
+    header.nNonce = 0;
+    uint64_t nTries = headerSequential.nNonce;
+    BOOST_CHECK(!SolveBlockHeader(header, params, std::numeric_limits<uint32_t>::max(), nTries, 4));
+    BOOST_CHECK_EQUAL(nTries, 0U);
+    BOOST_CHECK_EQUAL(header.nNonce, headerSequential.nNonce);
+
+    // Same for the nonce limit
+    header.nNonce = 0;
+    nTries = std::numeric_limits<uint64_t>::max();
+    BOOST_CHECK(!SolveBlockHeader(header, params, headerSequential.nNonce, nTries, 4));
+    BOOST_CHECK_EQUAL(header.nNonce, headerSequential.nNonce);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
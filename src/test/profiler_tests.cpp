@@ -0,0 +1,52 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <profiler.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(profiler_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(profiler_folded_stacks)
+{
+    std::vector<CProfileStack> vStacks;
+    vStacks.push_back({"dash-msghand", {"main", "ProcessMessages", "operator()(int) const"}, 3});
+    vStacks.push_back({"dash-net", {}, 1});
+    BOOST_CHECK_EQUAL(FormatFoldedStacks(vStacks), "dash-msghand;main;ProcessMessages;operator()(int) const 3\ndash-net 1\n");
+}
+
+BOOST_AUTO_TEST_CASE(profiler_thread_cpu_usage)
+{
+    std::vector<CThreadCPUUsage> vUsage;
+    if (!GetThreadCPUUsage(vUsage)) {
+        return;
+    }
+    BOOST_CHECK(!vUsage.empty());
+    for (const auto& usage : vUsage) {
+        BOOST_CHECK(usage.nThreadId > 0);
+        BOOST_CHECK(usage.nUserMicros >= 0 && usage.nSystemMicros >= 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(profiler_start_stop)
+{
+    std::string strError;
+    BOOST_CHECK(!StartProfiler(0, strError));
+    BOOST_CHECK(!StartProfiler(MAX_PROFILER_FREQUENCY + 1, strError));
+    BOOST_CHECK(!IsProfilerRunning());
+    if (!IsProfilerSupported()) {
+        return;
+    }
+    BOOST_CHECK(StartProfiler(100, strError));
+    BOOST_CHECK(IsProfilerRunning());
+    BOOST_CHECK_EQUAL(GetProfilerFrequency(), 100);
+    // only one profiler at a time
+    BOOST_CHECK(!StartProfiler(100, strError));
+    StopProfiler();
+    BOOST_CHECK(!IsProfilerRunning());
+    BOOST_CHECK_EQUAL(GetProfilerFrequency(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
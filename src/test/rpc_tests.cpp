@@ -4,10 +4,12 @@
 
 #include <rpc/server.h>
 #include <rpc/client.h>
+#include <rpc/snapshot.h>
 
 #include <core_io.h>
 #include <key_io.h>
 #include <netbase.h>
+#include <validation.h>
 
 #include <test/test_dash.h>
 
@@ -16,6 +18,8 @@
 
 #include <univalue.h>
 
+#include <thread>
+
 UniValue CallRPC(std::string args)
 {
     std::vector<std::string> vArgs;
@@ -228,6 +232,129 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(json_writer)
+{
+    // The streamed result is the same as what UniValue writes
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("str", "quote\" backslash\\ ctrl\n\x01\x7f");
+    obj.pushKV("int", -5);
+    obj.pushKV("uint", (uint64_t)18446744073709551615ULL);
+    obj.pushKV("real", 1.0 / 3);
+    obj.pushKV("bool", true);
+    obj.pushKV("null", NullUniValue);
+    UniValue arr(UniValue::VARR);
+    arr.push_back(UniValue(UniValue::VARR));
+    arr.push_back(UniValue(UniValue::VOBJ));
+    arr.push_back("x");
+    obj.pushKV("arr", arr);
+
+    std::string strWritten;
+    JSONStringSink sink(strWritten);
+    JSONWriter writer(sink);
+    writer.BeginObject();
+    writer.KV("str", "quote\" backslash\\ ctrl\n\x01\x7f");
+    writer.KV("int", -5);
+    writer.KV("uint", (uint64_t)18446744073709551615ULL);
+    writer.KV("real", 1.0 / 3);
+    writer.KV("bool", true);
+    writer.Key("null");
+    writer.Null();
+    writer.Key("arr");
+    writer.BeginArray();
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Value(UniValue(UniValue::VOBJ));
+    writer.Value(std::string("x"));
+    writer.EndArray();
+    writer.EndObject();
+    BOOST_CHECK(strWritten.empty());
+    writer.Flush();
+    BOOST_CHECK_EQUAL(strWritten, obj.write());
+
+    // Without a writer in the request the result is returned as UniValue
+    JSONRPCRequest request;
+    UniValue result = WriteRPCResult(request, [&](JSONWriter& w) { w.Value(obj); });
+    BOOST_CHECK_EQUAL(result.write(), obj.write());
+
+    // Large results are handed to the sink in chunks
+    std::string strLarge;
+    JSONStringSink sinkLarge(strLarge);
+    JSONWriter writerLarge(sinkLarge);
+    request.resultWriter = &writerLarge;
+    result = WriteRPCResult(request, [&](JSONWriter& w) {
+        w.BeginArray();
+        for (int i = 0; i < 100000; i++) {
+            w.Value(i);
+            if (i == 50000) BOOST_CHECK(!strLarge.empty());
+        }
+        w.EndArray();
+    });
+    BOOST_CHECK(result.isNull());
+    UniValue parsed;
+    BOOST_CHECK(parsed.read(strLarge));
+    BOOST_CHECK_EQUAL(parsed.size(), 100000U);
+    BOOST_CHECK_EQUAL(parsed[99999].get_int(), 99999);
+}
+
+BOOST_FIXTURE_TEST_CASE(rpc_chain_snapshot, TestChain100Setup)
+{
+    CRPCChainSnapshotPtr snapshot = GetRPCChainSnapshot();
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(snapshot->tip == chainActive.Tip());
+        BOOST_CHECK_EQUAL(snapshot->Height(), chainActive.Height());
+        for (int nHeight : {0, 1, 50, chainActive.Height()}) {
+            BOOST_CHECK((*snapshot)[nHeight] == chainActive[nHeight]);
+            BOOST_CHECK(snapshot->Contains(chainActive[nHeight]));
+            BOOST_CHECK(snapshot->Next(chainActive[nHeight]) == chainActive.Next(chainActive[nHeight]));
+        }
+        BOOST_CHECK((*snapshot)[snapshot->Height() + 1] == nullptr);
+    }
+    BOOST_CHECK(GetRPCChainSnapshot()->tip == snapshot->tip);
+
+    // A snapshot keeps its view of the chain when new blocks are connected, new snapshots see them
+    CreateAndProcessBlock({}, coinbaseKey);
+    LOCK(cs_main);
+    BOOST_CHECK(!snapshot->Contains(chainActive.Tip()));
+    BOOST_CHECK(snapshot->Next(snapshot->tip) == nullptr);
+    BOOST_CHECK(GetRPCChainSnapshot()->tip == chainActive.Tip());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch_parallel)
+{
+    UniValue vReq(UniValue::VARR);
+    for (int i = 0; i < 50; i++) {
+        UniValue req(UniValue::VOBJ);
+        req.pushKV("id", i);
+        req.pushKV("method", "getblockcount");
+        req.pushKV("params", UniValue(UniValue::VARR));
+        vReq.push_back(req);
+    }
+    JSONRPCRequest jreq;
+    std::string strSequential = JSONRPCExecBatch(jreq, vReq);
+
+    // Replies are in the order of the requests, no matter which thread executed them
+    std::vector<std::thread> threads;
+    std::string strParallel = JSONRPCExecBatch(jreq, vReq, 4, [&](std::function<void()> func) {
+        threads.emplace_back(func);
+        return true;
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(threads.size(), 3U);
+    BOOST_CHECK_EQUAL(strParallel, strSequential);
+    UniValue replies;
+    BOOST_CHECK(replies.read(strParallel));
+    BOOST_CHECK_EQUAL(replies.size(), vReq.size());
+    for (size_t i = 0; i < replies.size(); i++) {
+        BOOST_CHECK_EQUAL(find_value(replies[i], "id").get_int(), (int)i);
+    }
+
+    // If no helpers can be started the calling thread executes everything
+    BOOST_CHECK_EQUAL(JSONRPCExecBatch(jreq, vReq, 4, [](std::function<void()>) { return false; }), strSequential);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(std::string("clearbanned")));
@@ -11,6 +11,9 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <future>
+
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
 static void microTask(CScheduler& s, boost::mutex& mutex, int& counter, int delta, boost::chrono::system_clock::time_point rescheduleTime)
@@ -154,4 +157,69 @@ BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
     BOOST_CHECK_EQUAL(counter2, 100);
 }
 
+BOOST_AUTO_TEST_CASE(scheduler_priorities)
+{
+    CScheduler scheduler;
+
+    // Of the tasks which are due, the ones with a higher priority run first
+    std::vector<int> order;
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    scheduler.schedule([&order] { order.push_back(2); }, now, CScheduler::Priority::LOW, "low");
+    scheduler.schedule([&order] { order.push_back(1); }, now, CScheduler::Priority::NORMAL, "normal");
+    scheduler.schedule([&order] { order.push_back(0); }, now + boost::chrono::microseconds(1), CScheduler::Priority::HIGH, "high");
+    MicroSleep(1000);
+
+    boost::thread thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    scheduler.stop(true);
+    thread.join();
+
+    BOOST_CHECK(order == std::vector<int>({0, 1, 2}));
+
+    auto stats = scheduler.getTaskStats();
+    BOOST_CHECK_EQUAL(stats.size(), 3);
+    for (const auto& it : stats) {
+        BOOST_CHECK_EQUAL(it.second.nRuns, 1);
+        uint64_t nBucketRuns = 0;
+        for (uint64_t n : it.second.vBuckets) {
+            nBucketRuns += n;
+        }
+        BOOST_CHECK_EQUAL(nBucketRuns, 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_low_priority_reserve)
+{
+    CScheduler scheduler;
+    boost::thread_group threads;
+    for (int i = 0; i < 2; ++i) {
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+
+    // With two threads only one of them runs low priority tasks, the other one stays available
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> nLowRunning{0};
+    std::atomic<int> nLowMax{0};
+    std::atomic<int> nLowDone{0};
+    auto lowTask = [&] {
+        nLowMax = std::max<int>(nLowMax, ++nLowRunning);
+        released.wait();
+        nLowRunning--;
+        nLowDone++;
+    };
+    scheduler.schedule(lowTask, boost::chrono::system_clock::now(), CScheduler::Priority::LOW);
+    scheduler.schedule(lowTask, boost::chrono::system_clock::now(), CScheduler::Priority::LOW);
+
+    std::promise<void> normalDone;
+    scheduler.scheduleFromNow([&normalDone] { normalDone.set_value(); }, 10);
+    BOOST_CHECK(normalDone.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(nLowMax, 1);
+
+    release.set_value();
+    scheduler.stop(true);
+    threads.join_all();
+    BOOST_CHECK_EQUAL(nLowDone, 2);
+    BOOST_CHECK_EQUAL(nLowMax, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,8 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <key.h>
+#include <policy/policy.h>
+#include <script/interpreter.h>
 #include <script/script.h>
+#include <script/sigcache.h>
 #include <test/test_dash.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -54,4 +59,139 @@ BOOST_AUTO_TEST_CASE(IsPayToPublicKeyHash)
 
 }
 
+static CMutableTransaction SpendP2PKH(const CScript& scriptPubKey, const CKey& key, int nHashType, bool fCorrupt = false)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, nHashType, 0, SigVersion::BASE);
+    if (fCorrupt) {
+        *hash.begin() ^= 1;
+    }
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)nHashType);
+    tx.vin[0].scriptSig << vchSig << ToByteVector(key.GetPubKey());
+    return tx;
+}
+
+static bool RunP2PKHCheck(const CTransaction& tx, const CScript& scriptPubKey, unsigned int flags, bool& fFastPathRet)
+{
+    PrecomputedTransactionData txdata(tx);
+    CTxOut txout(0, scriptPubKey);
+    CScriptCheck check(txout, tx, 0, flags, false, &txdata);
+    fFastPathRet = check.IsP2PKHSpend() && check.VerifyP2PKHSignature();
+    bool fResult = check();
+    // The fast path must never accept what the interpreter would reject
+    ScriptError err;
+    bool fInterpreter = VerifyScript(tx.vin[0].scriptSig, scriptPubKey, flags, TransactionSignatureChecker(&tx, 0, 0), &err);
+    BOOST_CHECK_EQUAL(fResult, fInterpreter);
+    if (fFastPathRet) {
+        BOOST_CHECK(fInterpreter);
+    }
+    return fResult;
+}
+
+BOOST_AUTO_TEST_CASE(p2pkh_fast_path)
+{
+    CKey key, key2, keyUncompressed;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    keyUncompressed.MakeNewKey(false);
+    auto p2pkh = [](const CKey& k) { return GetScriptForDestination(k.GetPubKey().GetID()); };
+
+    const unsigned int flagsList[] = {SCRIPT_VERIFY_NONE, MANDATORY_SCRIPT_VERIFY_FLAGS, STANDARD_SCRIPT_VERIFY_FLAGS};
+    for (unsigned int flags : flagsList) {
+        bool fFastPath;
+
+        // Valid spends are accepted without the interpreter
+        BOOST_CHECK(RunP2PKHCheck(SpendP2PKH(p2pkh(key), key, SIGHASH_ALL), p2pkh(key), flags, fFastPath));
+        BOOST_CHECK(fFastPath);
+        BOOST_CHECK(RunP2PKHCheck(SpendP2PKH(p2pkh(keyUncompressed), keyUncompressed, SIGHASH_ALL | SIGHASH_ANYONECANPAY), p2pkh(keyUncompressed), flags, fFastPath));
+        BOOST_CHECK(fFastPath);
+
+        // Wrong signature or pubkey
+        BOOST_CHECK(!RunP2PKHCheck(SpendP2PKH(p2pkh(key), key, SIGHASH_ALL, true), p2pkh(key), flags, fFastPath));
+        BOOST_CHECK(!fFastPath);
+        BOOST_CHECK(!RunP2PKHCheck(SpendP2PKH(p2pkh(key), key2, SIGHASH_ALL), p2pkh(key), flags, fFastPath));
+        BOOST_CHECK(!fFastPath);
+
+        // Undefined hash type, only valid without SCRIPT_VERIFY_STRICTENC
+        RunP2PKHCheck(SpendP2PKH(p2pkh(key), key, 0), p2pkh(key), flags, fFastPath);
+        BOOST_CHECK_EQUAL(fFastPath, (flags & SCRIPT_VERIFY_STRICTENC) == 0);
+
+        // Non-minimal push of the signature is left to the interpreter
+        CMutableTransaction tx = SpendP2PKH(p2pkh(key), key, SIGHASH_ALL);
+        std::vector<unsigned char> vchSig(tx.vin[0].scriptSig.begin() + 1, tx.vin[0].scriptSig.begin() + 1 + tx.vin[0].scriptSig[0]);
+        tx.vin[0].scriptSig = CScript() << OP_PUSHDATA1;
+        tx.vin[0].scriptSig.push_back((unsigned char)vchSig.size());
+        tx.vin[0].scriptSig.insert(tx.vin[0].scriptSig.end(), vchSig.begin(), vchSig.end());
+        tx.vin[0].scriptSig << ToByteVector(key.GetPubKey());
+        BOOST_CHECK_EQUAL(RunP2PKHCheck(tx, p2pkh(key), flags, fFastPath), (flags & SCRIPT_VERIFY_MINIMALDATA) == 0);
+        BOOST_CHECK(!fFastPath);
+
+        // Extra pushes are left to the interpreter as well
+        tx = SpendP2PKH(p2pkh(key), key, SIGHASH_ALL);
+        CScript scriptSig = CScript() << OP_1;
+        scriptSig.insert(scriptSig.end(), tx.vin[0].scriptSig.begin(), tx.vin[0].scriptSig.end());
+        tx.vin[0].scriptSig = scriptSig;
+        RunP2PKHCheck(tx, p2pkh(key), flags, fFastPath);
+        BOOST_CHECK(!fFastPath);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sig_batch_collector)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    const size_t nSpends = SIG_BATCH_SIZE * 2 + 10;
+    std::vector<CTransaction> txs;
+    std::vector<PrecomputedTransactionData> txdata;
+    txs.reserve(nSpends + 1);
+    txdata.reserve(nSpends + 1);
+    for (size_t i = 0; i < nSpends; i++) {
+        txs.emplace_back(SpendP2PKH(scriptPubKey, key, SIGHASH_ALL, i == nSpends - 1));
+        txdata.emplace_back(txs.back());
+    }
+    // A P2PK spend, which is not batched
+    CScript scriptP2PK = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction txP2PK;
+    txP2PK.vin.resize(1);
+    txP2PK.vout.resize(1);
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(SignatureHash(scriptP2PK, txP2PK, 0, SIGHASH_ALL, 0, SigVersion::BASE), vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    txP2PK.vin[0].scriptSig << vchSig;
+    txs.emplace_back(txP2PK);
+    txdata.emplace_back(txs.back());
+
+    CTxOut txout(0, scriptPubKey);
+    CTxOut txoutP2PK(0, scriptP2PK);
+    std::vector<CScriptCheck> vChecks;
+    for (size_t i = 0; i < txs.size(); i++) {
+        vChecks.emplace_back(i < nSpends ? txout : txoutP2PK, txs[i], 0, MANDATORY_SCRIPT_VERIFY_FLAGS, false, &txdata[i]);
+    }
+
+    CSigBatchCollector collector;
+    collector.Add(vChecks);
+    // The P2PK check followed by the jobs of the two completed batches
+    BOOST_CHECK_EQUAL(vChecks.size(), 3U);
+    collector.Flush(vChecks);
+    BOOST_CHECK_EQUAL(vChecks.size(), 4U);
+    collector.Flush(vChecks);
+    BOOST_CHECK_EQUAL(vChecks.size(), 4U);
+
+    // Only the last batch holds the corrupted signature
+    BOOST_CHECK(vChecks[0]());
+    BOOST_CHECK(vChecks[1]());
+    BOOST_CHECK(vChecks[2]());
+    BOOST_CHECK(!vChecks[3]());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 #include <core_io.h>
 #include <key.h>
 #include <keystore.h>
+#include <primitives/block.h>
 #include <script/script.h>
 #include <script/script_error.h>
 #include <script/sign.h>
@@ -1410,4 +1411,86 @@ BOOST_AUTO_TEST_CASE(script_can_append_self)
     BOOST_CHECK(s == d);
 }
 
+BOOST_AUTO_TEST_CASE(script_stack_elements)
+{
+    // Elements up to SCRIPT_STACK_ELEMENT_INLINE_SIZE are stored inline, larger ones on the heap, both have to
+    // come out of the interpreter unchanged
+    std::vector<unsigned char> vchSmall(SCRIPT_STACK_ELEMENT_INLINE_SIZE, 0x01);
+    std::vector<unsigned char> vchLarge(MAX_SCRIPT_ELEMENT_SIZE, 0x02);
+    CScript script = CScript() << vchSmall << vchLarge << OP_SWAP << OP_DUP << OP_CAT << OP_SWAP;
+
+    BaseSignatureChecker checker;
+    ScriptError err;
+    CScriptStack stack;
+    BOOST_CHECK(EvalScript(stack, script, SCRIPT_ENABLE_DIP0020_OPCODES, checker, SigVersion::BASE, &err));
+    BOOST_CHECK_EQUAL(err, SCRIPT_ERR_OK);
+    BOOST_REQUIRE_EQUAL(stack.size(), 2U);
+    std::vector<unsigned char> vchCat(vchSmall);
+    vchCat.insert(vchCat.end(), vchSmall.begin(), vchSmall.end());
+    BOOST_CHECK(ToByteVector(stack[0]) == vchCat);
+    BOOST_CHECK(ToByteVector(stack[1]) == vchLarge);
+
+    // Same result through the overload for stacks of std::vector
+    std::vector<std::vector<unsigned char>> vstack;
+    BOOST_CHECK(EvalScript(vstack, script, SCRIPT_ENABLE_DIP0020_OPCODES, checker, SigVersion::BASE, &err));
+    BOOST_CHECK_EQUAL(err, SCRIPT_ERR_OK);
+    BOOST_REQUIRE_EQUAL(vstack.size(), 2U);
+    BOOST_CHECK(vstack[0] == vchCat);
+    BOOST_CHECK(vstack[1] == vchLarge);
+}
+
+#if defined(HAVE_CONSENSUS_LIB)
+BOOST_AUTO_TEST_CASE(script_dashconsensus_batch)
+{
+    std::vector<CScript> scriptPubKeys{CScript() << OP_1, CScript() << OP_0, CScript() << OP_1};
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    for (size_t i = 0; i < scriptPubKeys.size(); i++) {
+        tx.vin.emplace_back(COutPoint(InsecureRand256(), i));
+    }
+    tx.vout.emplace_back(0, CScript() << OP_1);
+
+    std::vector<const unsigned char*> spent;
+    std::vector<unsigned int> spentLens;
+    for (const auto& script : scriptPubKeys) {
+        spent.push_back(script.data());
+        spentLens.push_back(script.size());
+    }
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << tx;
+    for (unsigned int nThreads : {0, 1, 2, 8}) {
+        std::vector<int> results(scriptPubKeys.size(), -1);
+        dashconsensus_error err;
+        BOOST_CHECK_EQUAL(dashconsensus_verify_script_batch(spent.data(), spentLens.data(), spent.size(), (const unsigned char*)&stream[0], stream.size(), dashconsensus_SCRIPT_FLAGS_VERIFY_NONE, nThreads, results.data(), &err), 0);
+        BOOST_CHECK_EQUAL(err, dashconsensus_ERR_OK);
+        BOOST_CHECK(results == std::vector<int>({1, 0, 1}));
+    }
+    BOOST_CHECK_EQUAL(dashconsensus_verify_script_batch(spent.data(), spentLens.data(), 1, (const unsigned char*)&stream[0], stream.size(), dashconsensus_SCRIPT_FLAGS_VERIFY_NONE, 2, nullptr, nullptr), 1);
+
+    // A block with a coinbase, which is skipped, and the transaction
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << OP_0 << OP_0;
+    coinbase.vout.emplace_back(0, CScript() << OP_1);
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(tx));
+    CDataStream blockStream(SER_NETWORK, PROTOCOL_VERSION);
+    blockStream << block;
+
+    std::vector<int> results(scriptPubKeys.size(), -1);
+    dashconsensus_error err;
+    BOOST_CHECK_EQUAL(dashconsensus_verify_block_scripts(spent.data(), spentLens.data(), spent.size(), (const unsigned char*)&blockStream[0], blockStream.size(), dashconsensus_SCRIPT_FLAGS_VERIFY_NONE, 2, results.data(), &err), 0);
+    BOOST_CHECK_EQUAL(err, dashconsensus_ERR_OK);
+    BOOST_CHECK(results == std::vector<int>({1, 0, 1}));
+
+    BOOST_CHECK_EQUAL(dashconsensus_verify_block_scripts(spent.data(), spentLens.data(), 2, (const unsigned char*)&blockStream[0], blockStream.size(), dashconsensus_SCRIPT_FLAGS_VERIFY_NONE, 2, nullptr, &err), 0);
+    BOOST_CHECK_EQUAL(err, dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+    BOOST_CHECK_EQUAL(dashconsensus_verify_block_scripts(spent.data(), spentLens.data(), spent.size(), (const unsigned char*)&blockStream[0], blockStream.size() - 1, dashconsensus_SCRIPT_FLAGS_VERIFY_NONE, 2, nullptr, &err), 0);
+    BOOST_CHECK_EQUAL(err, dashconsensus_ERR_BLOCK_DESERIALIZE);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -208,4 +208,39 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
     }
 }
+// The signature hashes computed from PrecomputedTransactionData must be the same as without it
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    SeedInsecureRand(false);
+
+    const int hashTypes[] = {SIGHASH_ALL, SIGHASH_ALL | SIGHASH_ANYONECANPAY, SIGHASH_NONE, SIGHASH_SINGLE | SIGHASH_ANYONECANPAY, 0, 4};
+    for (int i = 0; i < 5000; i++) {
+        int nHashType = (i % 2) ? hashTypes[InsecureRandRange(sizeof(hashTypes) / sizeof(hashTypes[0]))] : (int)InsecureRand32();
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        if (i % 3 == 0) {
+            // Special transaction with a payload
+            txTo.nVersion = 3;
+            txTo.nType = TRANSACTION_PROVIDER_UPDATE_SERVICE;
+            txTo.vExtraPayload.resize(InsecureRandRange(100));
+            for (auto& b : txTo.vExtraPayload) {
+                b = InsecureRandBits(8);
+            }
+        }
+        const CTransaction tx(txTo);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK_EQUAL(txdata.vchBlankedTx.empty(), tx.vin.size() < 2);
+        BOOST_CHECK_EQUAL(txdata.vInputMidstates.size(), tx.vin.size() < 2 ? 0 : tx.vin.size());
+
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+            uint256 sh = SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE);
+            uint256 shCached = SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE, &txdata);
+            BOOST_CHECK(sh == shCached);
+            BOOST_CHECK(sh == SignatureHashOld(scriptCode, tx, nIn, nHashType));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <spentindex.h>
+#include <txdb.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(spentindex_tests, BasicTestingSetup)
+
+static CSpentIndexValue MakeSpentValue(int n)
+{
+    return CSpentIndexValue(uint256S(strprintf("%x", 0x1000 + n)), n, 100 + n, n * COIN, 1, uint160());
+}
+
+static bool SpentValuesEqual(const CSpentIndexValue& a, const CSpentIndexValue& b)
+{
+    return a.txid == b.txid && a.inputIndex == b.inputIndex && a.blockHeight == b.blockHeight;
+}
+
+BOOST_AUTO_TEST_CASE(spentindex_batched_read)
+{
+    CBlockTreeDB db(1 << 20, true);
+
+    // outputs 0, 1, 3 and 256 of txid are spent. 256 comes right after 0 in the index, its index is little endian
+    uint256 txid = uint256S("0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9");
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>> vecSpent;
+    for (unsigned int n : {0, 1, 3, 256}) {
+        vecSpent.emplace_back(CSpentIndexKey(txid, n), MakeSpentValue(n));
+    }
+    BOOST_REQUIRE(db.UpdateSpentIndex(vecSpent));
+
+    std::vector<CSpentIndexKey> keys;
+    for (unsigned int n : {256, 3, 2, 0, 1, 1, 4}) {
+        keys.emplace_back(txid, n);
+    }
+    keys.emplace_back(uint256S("1"), 0);
+
+    // the same results uncached and cached
+    for (int i = 0; i < 2; i++) {
+        std::vector<CSpentIndexValue> values;
+        db.ReadSpentIndex(keys, values);
+        BOOST_REQUIRE_EQUAL(values.size(), keys.size());
+        for (size_t j = 0; j < keys.size(); j++) {
+            unsigned int n = keys[j].outputIndex;
+            bool fSpent = keys[j].txid == txid && (n == 0 || n == 1 || n == 3 || n == 256);
+            BOOST_CHECK_EQUAL(!values[j].IsNull(), fSpent);
+            if (fSpent) {
+                BOOST_CHECK(SpentValuesEqual(values[j], MakeSpentValue(n)));
+            }
+
+            CSpentIndexKey key = keys[j];
+            CSpentIndexValue value;
+            BOOST_CHECK_EQUAL(db.ReadSpentIndex(key, value), fSpent);
+        }
+    }
+
+    // updates are visible, also for keys which were cached before
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>> vecUpdate;
+    vecUpdate.emplace_back(CSpentIndexKey(txid, 0), CSpentIndexValue());
+    vecUpdate.emplace_back(CSpentIndexKey(txid, 2), MakeSpentValue(2));
+    BOOST_REQUIRE(db.UpdateSpentIndex(vecUpdate));
+
+    std::vector<CSpentIndexValue> values;
+    db.ReadSpentIndex({CSpentIndexKey(txid, 0), CSpentIndexKey(txid, 2)}, values);
+    BOOST_CHECK(values[0].IsNull());
+    BOOST_CHECK(SpentValuesEqual(values[1], MakeSpentValue(2)));
+    CSpentIndexKey key(txid, 2);
+    CSpentIndexValue value;
+    BOOST_CHECK(db.ReadSpentIndex(key, value));
+    BOOST_CHECK(SpentValuesEqual(value, MakeSpentValue(2)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
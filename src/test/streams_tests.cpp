@@ -2,6 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_signing_shares.h>
+#include <protocol.h>
 #include <streams.h>
 #include <support/allocators/zeroafterfree.h>
 #include <test/test_dash.h>
@@ -203,4 +206,128 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));
 }
 
+BOOST_AUTO_TEST_CASE(streams_vector_element_reader)
+{
+    std::vector<CInv> vInv;
+    for (int i = 0; i < 3; i++) {
+        vInv.emplace_back(MSG_TX, InsecureRand256());
+    }
+    CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+    ds << vInv;
+    size_t nSize = ds.size();
+
+    SpanReader reader = MakeSpanReader(ds);
+    VectorElementReader<CInv> invReader(reader, CInv::SERIALIZED_SIZE);
+    BOOST_CHECK_EQUAL(invReader.size(), 3U);
+    CInv inv;
+    for (const auto& expected : vInv) {
+        BOOST_REQUIRE(invReader.Next(inv));
+        BOOST_CHECK(inv.type == expected.type && inv.hash == expected.hash);
+    }
+    BOOST_CHECK(!invReader.Next(inv));
+    BOOST_CHECK(reader.empty());
+    // The stream itself was not read from
+    BOOST_CHECK_EQUAL(ds.size(), nSize);
+
+    // A count which can't fit into the remaining data is rejected before reading any element
+    CDataStream dsTruncated(ds.begin(), ds.end() - 1, SER_NETWORK, PROTOCOL_VERSION);
+    SpanReader readerTruncated = MakeSpanReader(dsTruncated);
+    BOOST_CHECK_THROW(VectorElementReader<CInv>(readerTruncated, CInv::SERIALIZED_SIZE), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(streams_span_reader_wrappers)
+{
+    CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+    ds << VARINT(uint64_t(1234567)) << COMPACTSIZE(uint64_t(70000));
+
+    // serialization wrappers are temporaries and must bind to operator>> as well
+    SpanReader reader = MakeSpanReader(ds);
+    uint64_t nVarInt, nCompactSize;
+    reader >> VARINT(nVarInt) >> COMPACTSIZE(nCompactSize);
+    BOOST_CHECK_EQUAL(nVarInt, 1234567U);
+    BOOST_CHECK_EQUAL(nCompactSize, 70000U);
+    BOOST_CHECK(reader.empty());
+}
+
+BOOST_AUTO_TEST_CASE(streams_vector_element_reader_sigsharesinv)
+{
+    std::vector<llmq::CSigSharesInv> vInvs(2);
+    vInvs[0].sessionId = 1;
+    vInvs[0].Init(50);
+    vInvs[0].Set(3, true);
+    vInvs[1].sessionId = 300;
+    vInvs[1].Init(400);
+    vInvs[1].SetAll(true);
+
+    CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+    ds << vInvs;
+
+    // QSIGSHARESINV/QGETSIGSHARES are read this way, through VARINT, COMPACTSIZE and AUTOBITSET wrappers
+    SpanReader reader = MakeSpanReader(ds);
+    VectorElementReader<llmq::CSigSharesInv> invReader(reader, llmq::CSigSharesInv::MIN_SERIALIZED_SIZE);
+    BOOST_CHECK_EQUAL(invReader.size(), 2U);
+    llmq::CSigSharesInv inv;
+    for (const auto& expected : vInvs) {
+        BOOST_REQUIRE(invReader.Next(inv));
+        BOOST_CHECK_EQUAL(inv.sessionId, expected.sessionId);
+        BOOST_CHECK(inv.inv == expected.inv);
+    }
+    BOOST_CHECK(!invReader.Next(inv));
+    BOOST_CHECK(reader.empty());
+}
+
+BOOST_AUTO_TEST_CASE(streams_islock_view)
+{
+    llmq::CInstantSendLock islock;
+    islock.inputs.emplace_back(InsecureRand256(), 0);
+    islock.inputs.emplace_back(InsecureRand256(), 1);
+    islock.txid = InsecureRand256();
+
+    CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+    ds << islock;
+    // Trailing data is not part of the lock
+    ds << uint8_t(0);
+
+    llmq::CInstantSendLockView view;
+    MakeSpanReader(ds) >> view;
+    BOOST_CHECK(view.GetHash() == ::SerializeHash(islock));
+    BOOST_CHECK_EQUAL(view.GetSpan().size(), (std::ptrdiff_t)(ds.size() - 1));
+
+    llmq::CInstantSendLock islock2;
+    SpanReader(SER_NETWORK, PROTOCOL_VERSION, view.GetSpan()) >> islock2;
+    BOOST_CHECK(islock2.txid == islock.txid);
+    BOOST_CHECK(islock2.inputs == islock.inputs);
+
+    CDataStream dsTruncated(ds.begin(), ds.end() - 2, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_THROW(MakeSpanReader(dsTruncated) >> view, std::ios_base::failure);
+
+    // The shared serialization of a known lock is the same as the one sent over P2P
+    llmq::CInstantSendLockEntry entry(view.GetHash(), std::make_shared<llmq::CInstantSendLock>(islock));
+    BOOST_CHECK(entry.bytes == std::vector<unsigned char>(view.GetSpan().data(), view.GetSpan().data() + view.GetSpan().size()));
+}
+
+BOOST_AUTO_TEST_CASE(streams_public_datastream)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPublicDataStream ssPublic(SER_NETWORK, PROTOCOL_VERSION);
+    ss << std::string("dash") << (uint32_t)42;
+    ssPublic << std::string("dash") << (uint32_t)42;
+    BOOST_CHECK_EQUAL(ss.str(), ssPublic.str());
+
+    // Both stream types can be built from the other's buffer
+    CPublicDataStream ssCopy(std::vector<char>(ss.begin(), ss.end()), SER_NETWORK, PROTOCOL_VERSION);
+    CDataStream ssCopy2(CSerializeData(ssPublic.begin(), ssPublic.end()), SER_NETWORK, PROTOCOL_VERSION);
+    std::string str;
+    uint32_t n;
+    ssCopy >> str >> n;
+    BOOST_CHECK_EQUAL(str, "dash");
+    BOOST_CHECK_EQUAL(n, 42U);
+    BOOST_CHECK_EQUAL(ssCopy2.str(), ssPublic.str());
+
+    CPublicSerializeData vch;
+    ssPublic.GetAndClear(vch);
+    BOOST_CHECK(ssPublic.empty());
+    BOOST_CHECK_EQUAL(std::string(vch.begin(), vch.end()), ss.str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
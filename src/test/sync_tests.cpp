@@ -0,0 +1,79 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <sync.h>
+#include <utiltime.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <thread>
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+//! Sum up the statistics of all sites of the lock strName
+static LockStats SumLockStats(const std::string& strName)
+{
+    LockStats total{strName, "", 0, 0, 0, 0, std::vector<uint64_t>(LOCK_STATS_HISTOGRAM_BUCKETS), 0, 0, 0, std::vector<uint64_t>(LOCK_STATS_HISTOGRAM_BUCKETS)};
+    for (const auto& stats : GetLockStats()) {
+        if (stats.strName != strName) continue;
+        total.nContentions += stats.nContentions;
+        total.nWaitTime += stats.nWaitTime;
+        total.nMaxWaitTime = std::max(total.nMaxWaitTime, stats.nMaxWaitTime);
+        total.nHoldSamples += stats.nHoldSamples;
+        total.nHoldTime += stats.nHoldTime;
+        total.nMaxHoldTime = std::max(total.nMaxHoldTime, stats.nMaxHoldTime);
+        for (int i = 0; i < LOCK_STATS_HISTOGRAM_BUCKETS; i++) {
+            total.vWaitHistogram[i] += stats.vWaitHistogram[i];
+            total.vHoldHistogram[i] += stats.vHoldHistogram[i];
+        }
+    }
+    return total;
+}
+
+BOOST_AUTO_TEST_CASE(lock_stats)
+{
+    CCriticalSection cs_lockstats_test;
+    ResetLockStats();
+
+    std::thread waiter;
+    {
+        LOCK(cs_lockstats_test);
+        waiter = std::thread([&] {
+            LOCK(cs_lockstats_test);
+        });
+        MilliSleep(50);
+    }
+    waiter.join();
+
+    // Enough uncontended acquisitions to sample the hold time at least once
+    for (uint32_t i = 0; i < LOCK_STATS_SAMPLE_RATE; i++) {
+        LOCK(cs_lockstats_test);
+    }
+
+    LockStats stats = SumLockStats("cs_lockstats_test");
+    BOOST_CHECK_EQUAL(stats.nContentions, 1U);
+    BOOST_CHECK(stats.nWaitTime >= 10000);
+    BOOST_CHECK_EQUAL(stats.nMaxWaitTime, stats.nWaitTime);
+    uint64_t nWaitCount = 0;
+    for (uint64_t nCount : stats.vWaitHistogram) nWaitCount += nCount;
+    BOOST_CHECK_EQUAL(nWaitCount, 1U);
+    BOOST_CHECK(stats.nHoldSamples >= 1);
+
+    // Sites are sorted by total wait time
+    std::vector<LockStats> vStats = GetLockStats();
+    for (size_t i = 1; i < vStats.size(); i++) {
+        BOOST_CHECK(vStats[i - 1].nWaitTime >= vStats[i].nWaitTime);
+        BOOST_CHECK_EQUAL(vStats[i].vWaitHistogram.size(), (size_t)LOCK_STATS_HISTOGRAM_BUCKETS);
+    }
+
+    ResetLockStats();
+    stats = SumLockStats("cs_lockstats_test");
+    BOOST_CHECK_EQUAL(stats.nContentions, 0U);
+    BOOST_CHECK_EQUAL(stats.nHoldSamples, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
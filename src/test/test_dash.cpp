@@ -8,6 +8,7 @@
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <crypto/x11.h>
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
@@ -56,6 +57,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     : m_path_root(fs::temp_directory_path() / "test_dash" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)(InsecureRandRange(1 << 30))))
 {
     SHA256AutoDetect();
+    X11AutoDetect();
     RandomInit();
     ECC_Start();
     BLSInit();
@@ -121,6 +123,7 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        StartCoinsPrefetchThreads(2);
         peerLogic.reset(new PeerLogicValidation(connman, scheduler, /*enable_bip61=*/true));
 }
 
@@ -130,6 +133,7 @@ TestingSetup::~TestingSetup()
         llmq::StopLLMQSystem();
         threadGroup.interrupt_all();
         threadGroup.join_all();
+        StopCoinsPrefetchThreads();
         GetMainSignals().FlushBackgroundCallbacks();
         GetMainSignals().UnregisterBackgroundSignalScheduler();
         g_connman.reset();
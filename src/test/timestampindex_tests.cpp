@@ -0,0 +1,89 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/timestampindex.h>
+#include <script/standard.h>
+#include <test/test_dash.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(timestampindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(timestampindex_initial_sync, TestChain100Setup)
+{
+    TimestampIndex timestamp_index(1 << 20, true);
+
+    std::vector<uint256> hashes;
+
+    // Blocks are not indexed before the index is started
+    BOOST_CHECK(timestamp_index.FindBlockHashes(std::numeric_limits<unsigned int>::max(), 0, hashes));
+    BOOST_CHECK(hashes.empty());
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started
+    BOOST_CHECK(!timestamp_index.BlockUntilSyncedToCurrentChain());
+
+    timestamp_index.Start();
+
+    // Allow the index to catch up with the block index
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!timestamp_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+    BOOST_CHECK_EQUAL(timestamp_index.GetBestHeight(), chainActive.Height());
+
+    // All blocks of the chain are found by their timestamps
+    BOOST_CHECK(timestamp_index.FindBlockHashes(std::numeric_limits<unsigned int>::max(), 0, hashes));
+    BOOST_CHECK_EQUAL(hashes.size(), (size_t)chainActive.Height() + 1); // including genesis
+    hashes.clear();
+    const CBlockIndex* pindex = chainActive[50];
+    BOOST_CHECK(timestamp_index.FindBlockHashes(pindex->nTime, pindex->nTime, hashes));
+    BOOST_CHECK(std::find(hashes.begin(), hashes.end(), pindex->GetBlockHash()) != hashes.end());
+
+    // Multiple ranges give the same results as one lookup per range
+    std::vector<std::pair<unsigned int, unsigned int>> ranges{
+        {chainActive[60]->nTime, chainActive[40]->nTime},
+        {pindex->nTime, pindex->nTime},
+        {chainActive[20]->nTime, chainActive[30]->nTime},
+    };
+    std::vector<std::vector<uint256>> rangeHashes;
+    BOOST_CHECK(timestamp_index.FindBlockHashes(ranges, rangeHashes));
+    BOOST_REQUIRE_EQUAL(rangeHashes.size(), ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        std::vector<uint256> rangeHashes2;
+        BOOST_CHECK(timestamp_index.FindBlockHashes(ranges[i].first, ranges[i].second, rangeHashes2));
+        BOOST_CHECK(rangeHashes[i] == rangeHashes2);
+    }
+    BOOST_CHECK(!rangeHashes[0].empty());
+
+    // Check that new blocks get indexed
+    CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    for (int i = 0; i < 10; i++) {
+        std::vector<CMutableTransaction> no_txns;
+        const CBlock& block = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+        BOOST_REQUIRE(timestamp_index.BlockUntilSyncedToCurrentChain());
+
+        hashes.clear();
+        BOOST_CHECK(timestamp_index.FindBlockHashes(block.nTime, block.nTime, hashes));
+        BOOST_CHECK(std::find(hashes.begin(), hashes.end(), block.GetHash()) != hashes.end());
+    }
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    timestamp_index.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -254,6 +254,41 @@ BOOST_AUTO_TEST_CASE(basic_transaction_tests)
     BOOST_CHECK_MESSAGE(!CheckTransaction(tx, state) || !state.IsValid(), "Transaction with duplicate txins should be invalid.");
 }
 
+BOOST_AUTO_TEST_CASE(transaction_cached_size)
+{
+    CMutableTransaction mtx;
+    BOOST_CHECK_EQUAL(CTransaction().GetTotalSize(), ::GetSerializeSize(mtx, SER_NETWORK, PROTOCOL_VERSION));
+
+    mtx.vin.resize(3);
+    mtx.vout.resize(2);
+    mtx.vout[0].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(300, 0x42);
+    mtx.nVersion = 3;
+    mtx.nType = TRANSACTION_PROVIDER_REGISTER;
+    mtx.vExtraPayload.resize(100);
+    CTransaction tx(mtx);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tx;
+    BOOST_CHECK_EQUAL(tx.GetTotalSize(), ss.size());
+    BOOST_CHECK_EQUAL(::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION), ss.size());
+    BOOST_CHECK_EQUAL(::GetSerializeSize(MakeTransactionRef(tx), SER_NETWORK, PROTOCOL_VERSION), ss.size());
+
+    // Deserialized transactions (including those of a block) get the same size
+    CTransactionRef tx2;
+    ss >> tx2;
+    BOOST_CHECK_EQUAL(tx2->GetTotalSize(), tx.GetTotalSize());
+    CBlock block;
+    block.vtx.emplace_back(tx2);
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    size_t nBlockSize = ssBlock.size();
+    CBlock block2;
+    ssBlock >> block2;
+    BOOST_CHECK_EQUAL(block2.vtx[0]->GetTotalSize(), tx.GetTotalSize());
+    BOOST_CHECK(block2.vtx[0]->GetHash() == tx.GetHash());
+    BOOST_CHECK_EQUAL(::GetSerializeSize(block2, SER_NETWORK, PROTOCOL_VERSION), nBlockSize);
+}
+
 //
 // Helper: create two dummy transactions, each with
 // two outputs.  The first has 11 and 50 CENT outputs
@@ -409,4 +444,62 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(t, reason));
 }
 
+BOOST_AUTO_TEST_CASE(transaction_arena)
+{
+    CBlock block;
+    for (int i = 0; i < 3000; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(InsecureRand256(), i), CScript() << std::vector<unsigned char>(i % 200));
+        mtx.vout.emplace_back(i, CScript() << OP_RETURN);
+        if (i % 2) {
+            mtx.nVersion = 3;
+            mtx.nType = TRANSACTION_COINBASE;
+            mtx.vExtraPayload.assign(i % 100, 1);
+        }
+        block.vtx.emplace_back(MakeTransactionRef(std::move(mtx)));
+    }
+    std::vector<unsigned char> vch;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, vch, 0) << block;
+
+    // blocks read from memory (SpanReader) and from other streams
+    CTransactionRef txKept;
+    for (int nStream = 0; nStream < 2; nStream++) {
+        CBlock block2;
+        {
+            CTransactionArenaScope arenaScope;
+            if (nStream == 0) {
+                SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(vch.data(), vch.size())) >> block2;
+            } else {
+                VectorReader(SER_NETWORK, PROTOCOL_VERSION, vch, 0) >> block2;
+            }
+        }
+        BOOST_REQUIRE_EQUAL(block2.vtx.size(), block.vtx.size());
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            BOOST_CHECK(IsArenaTransaction(block2.vtx[i]));
+            BOOST_CHECK(block2.vtx[i]->GetHash() == block.vtx[i]->GetHash());
+            BOOST_CHECK(block2.vtx[i]->vExtraPayload == block.vtx[i]->vExtraPayload);
+            BOOST_CHECK_EQUAL(block2.vtx[i]->GetTotalSize(), block.vtx[i]->GetTotalSize());
+        }
+        // a transaction outlives its block
+        txKept = block2.vtx.back();
+    }
+    BOOST_CHECK(txKept->GetHash() == block.vtx.back()->GetHash());
+    BOOST_CHECK(!IsArenaTransaction(MakeTransactionRef(*txKept)));
+
+    // without a scope, every transaction is allocated on its own
+    CBlock block3;
+    SpanReader(SER_NETWORK, PROTOCOL_VERSION, Span<const unsigned char>(vch.data(), vch.size())) >> block3;
+    BOOST_CHECK(!IsArenaTransaction(block3.vtx[0]));
+
+    CTransactionArena arena(1);
+    void* p1 = arena.Allocate(1, 1);
+    void* p2 = arena.Allocate(8, 8);
+    BOOST_CHECK_EQUAL((uintptr_t)p2 % 8, 0U);
+    BOOST_CHECK((char*)p2 > (char*)p1);
+    BOOST_CHECK_EQUAL(arena.GetChunkCount(), 1U);
+    // allocations larger than a chunk get their own
+    arena.Allocate(1024 * 1024, 8);
+    BOOST_CHECK_EQUAL(arena.GetChunkCount(), 2U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,141 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <unordered_lru_cache.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+
+BOOST_FIXTURE_TEST_SUITE(unordered_lru_cache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lru_eviction)
+{
+    unordered_lru_cache<int, int, std::hash<int>> cache(3);
+    cache.insert(1, 10);
+    cache.insert(2, 20);
+    cache.insert(3, 30);
+
+    // touching 1 makes 2 the least recently used entry
+    int value;
+    BOOST_CHECK(cache.get(1, value));
+    BOOST_CHECK_EQUAL(value, 10);
+    cache.insert(4, 40);
+    BOOST_CHECK_EQUAL(cache.size(), 3U);
+    BOOST_CHECK(!cache.exists(2));
+    BOOST_CHECK(cache.exists(1));
+    BOOST_CHECK(cache.exists(3));
+    BOOST_CHECK(cache.exists(4));
+
+    // overwriting an entry makes it the most recently used one
+    cache.insert(1, 11);
+    cache.insert(5, 50);
+    BOOST_CHECK(!cache.exists(3));
+    BOOST_CHECK(cache.get(1, value));
+    BOOST_CHECK_EQUAL(value, 11);
+
+    cache.erase(1);
+    BOOST_CHECK(!cache.exists(1));
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+
+    BOOST_CHECK_EQUAL(cache.hits(), 5U);
+    BOOST_CHECK_EQUAL(cache.misses(), 3U);
+
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    cache.insert(6, 60);
+    BOOST_CHECK(cache.exists(6));
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_lru)
+{
+    // small caches end up with a single stripe and behave exactly like unordered_lru_cache
+    concurrent_unordered_lru_cache<int, int, std::hash<int>> small(3);
+    BOOST_CHECK_EQUAL(small.stripe_count(), 1U);
+    small.insert(1, 10);
+    small.insert(2, 20);
+    small.insert(3, 30);
+    BOOST_CHECK(small.exists(1));
+    small.insert(4, 40);
+    BOOST_CHECK(!small.exists(2));
+    BOOST_CHECK_EQUAL(small.size(), 3U);
+    BOOST_CHECK_EQUAL(small.max_size(), 3U);
+
+    concurrent_unordered_lru_cache<int, int, std::hash<int>, 10000> cache;
+    BOOST_CHECK_EQUAL(cache.stripe_count(), 16U);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&cache, t]() {
+            for (int i = 0; i < 1000; i++) {
+                int key = t * 1000 + i;
+                cache.insert(key, key * 2);
+                int value;
+                if (cache.get(key, value)) {
+                    assert(value == key * 2);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(cache.size(), 4000U);
+    BOOST_CHECK_EQUAL(cache.hits(), 4000U);
+    BOOST_CHECK_EQUAL(cache.misses(), 0U);
+
+    int value;
+    BOOST_CHECK(cache.get(2500, value));
+    BOOST_CHECK_EQUAL(value, 5000);
+    cache.erase(2500);
+    BOOST_CHECK(!cache.exists(2500));
+    BOOST_CHECK_EQUAL(cache.misses(), 1U);
+
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(lru_memusage)
+{
+    unordered_lru_cache<int, int, std::hash<int>, 10> cache;
+    size_t emptyUsage = cache.DynamicMemoryUsage();
+    for (int i = 0; i < 10; i++) {
+        cache.insert(i, i * 2);
+    }
+    BOOST_CHECK_GT(cache.DynamicMemoryUsage(), emptyUsage);
+
+    // for_each visits the entries from most to least recently used and doesn't touch the LRU order
+    cache.exists(3);
+    std::vector<int> keys;
+    int sum = 0;
+    cache.for_each([&](int key, int value) {
+        keys.emplace_back(key);
+        sum += value;
+    });
+    BOOST_CHECK_EQUAL(keys.size(), 10U);
+    BOOST_CHECK_EQUAL(keys.front(), 3);
+    BOOST_CHECK_EQUAL(keys.back(), 0);
+    BOOST_CHECK_EQUAL(sum, 90);
+    cache.insert(10, 20);
+    BOOST_CHECK(!cache.exists(0));
+
+    concurrent_unordered_lru_cache<int, int, std::hash<int>, 10000> concurrent;
+    size_t emptyConcurrentUsage = concurrent.DynamicMemoryUsage();
+    BOOST_CHECK_GT(emptyConcurrentUsage, 0U);
+    for (int i = 0; i < 1000; i++) {
+        concurrent.insert(i, i);
+    }
+    BOOST_CHECK_GT(concurrent.DynamicMemoryUsage(), emptyConcurrentUsage + 1000 * sizeof(int) * 2);
+    size_t count = 0;
+    concurrent.for_each([&](int key, int value) {
+        BOOST_CHECK_EQUAL(key, value);
+        count++;
+    });
+    BOOST_CHECK_EQUAL(count, 1000U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
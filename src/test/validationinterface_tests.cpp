@@ -0,0 +1,80 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <scheduler.h>
+#include <utiltime.h>
+#include <validationinterface.h>
+
+#include <test/test_dash.h>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <future>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
+
+class TestSubscriber : public CValidationInterface
+{
+public:
+    std::atomic<int> nCalls{0};
+    std::shared_future<void> release;
+
+protected:
+    void NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig) override
+    {
+        if (release.valid()) {
+            release.wait();
+        }
+        nCalls++;
+    }
+};
+
+static bool WaitFor(const std::function<bool()>& pred)
+{
+    for (int i = 0; i < 1000 && !pred(); i++) {
+        MilliSleep(10);
+    }
+    return pred();
+}
+
+BOOST_AUTO_TEST_CASE(dedicated_queue)
+{
+    // A second thread for the dedicated queue
+    threadGroup.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    std::promise<void> promise;
+    TestSubscriber slow;
+    slow.release = promise.get_future().share();
+    TestSubscriber fast;
+    RegisterValidationInterface(&slow, "test");
+    RegisterValidationInterface(&fast);
+
+    GetMainSignals().NotifyRecoveredSig(nullptr);
+    GetMainSignals().NotifyRecoveredSig(nullptr);
+
+    // The main queue isn't held up by the slow subscriber, which still has the second callback waiting
+    BOOST_CHECK(WaitFor([&] { return fast.nCalls == 2; }));
+    BOOST_CHECK_EQUAL(slow.nCalls, 0);
+    BOOST_CHECK(WaitFor([&] { return GetMainSignals().GetQueueDepths().at("test") == 1; }));
+    BOOST_CHECK_EQUAL(GetMainSignals().GetQueueDepths().at("main"), 0);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 1);
+
+    // Syncing waits for all queues
+    promise.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(slow.nCalls, 2);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0);
+
+    // No more callbacks after unregistering
+    UnregisterValidationInterface(&slow);
+    UnregisterValidationInterface(&fast);
+    GetMainSignals().NotifyRecoveredSig(nullptr);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(slow.nCalls, 2);
+    BOOST_CHECK_EQUAL(fast.nCalls, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <txdb.h>
 
 #include <chainparams.h>
+#include <crypto/sha256.h>
 #include <hash.h>
 #include <random.h>
 #include <pow.h>
@@ -13,8 +14,11 @@
 #include <util.h>
 #include <ui_interface.h>
 #include <init.h>
+#include <node/utxo_snapshot.h>
 
 #include <stdint.h>
+#include <algorithm>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -24,7 +28,7 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
-static const char DB_TIMESTAMPINDEX = 's';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
@@ -33,6 +37,17 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'S';
+static const char DB_UTXO_SNAPSHOT = 'U';
+
+//! Start of the block index snapshot file
+static const uint32_t BLOCK_INDEX_SNAPSHOT_MAGIC = 0x78646962;
+static const uint32_t BLOCK_INDEX_SNAPSHOT_VERSION = 1;
+//! Entries of full dump chunks reference their pprev by position in the dump, entries of appended chunks by hash
+static const uint8_t SNAPSHOT_CHUNK_FULL = 1;
+static const uint8_t SNAPSHOT_CHUNK_APPEND = 2;
+//! Full dumps are split into chunks of about this size
+static const size_t SNAPSHOT_CHUNK_SIZE = 16 << 20;
 
 namespace {
 
@@ -58,7 +73,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, const std::string& strName) : db(GetDataDir() / strName, nCacheSize, fMemory, fWipe, true)
 {
 }
 
@@ -85,12 +100,69 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
+namespace {
+
+/** A coins DB entry serialized by SerializeCoinEntries */
+struct SerializedCoinEntry
+{
+    CDataStream ssKey{SER_DISK, CLIENT_VERSION};
+    //! empty if the coin is spent and should be erased
+    CDataStream ssValue{SER_DISK, CLIENT_VERSION};
+    bool fErase{false};
+};
+
+//! Number of dirty entries which are serialized, sorted and written together in the parallel flush mode. Bounds the
+//! additional memory needed for the serialized entries.
+static const size_t PARALLEL_FLUSH_CHUNK_SIZE = 1 << 18;
+
+/** Serializes (and obfuscates) the given dirty entries on nThreads threads */
+void SerializeCoinEntries(const std::vector<CCoinsMap::const_iterator>& entries, std::vector<SerializedCoinEntry>& serializedRet, const std::vector<unsigned char>& obfuscateKey, size_t nThreads)
+{
+    serializedRet.clear();
+    serializedRet.resize(entries.size());
+
+    auto serializeRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& it = entries[i];
+            auto& out = serializedRet[i];
+            out.ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+            out.ssKey << CoinEntry(&it->first);
+            if (it->second.coin.IsSpent()) {
+                out.fErase = true;
+            } else {
+                out.ssValue.reserve(DBWRAPPER_PREALLOC_VALUE_SIZE);
+                out.ssValue << it->second.coin;
+                out.ssValue.Xor(obfuscateKey);
+            }
+        }
+    };
+
+    size_t nChunkSize = (entries.size() + nThreads - 1) / nThreads;
+    std::vector<std::thread> threads;
+    for (size_t begin = nChunkSize; begin < entries.size(); begin += nChunkSize) {
+        threads.emplace_back(serializeRange, begin, std::min(begin + nChunkSize, entries.size()));
+    }
+    serializeRange(0, std::min(nChunkSize, entries.size()));
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // LevelDB keeps keys sorted, so writing in key order makes inserting the batch into the memtable cheaper
+    std::sort(serializedRet.begin(), serializedRet.end(), [](const SerializedCoinEntry& a, const SerializedCoinEntry& b) {
+        return std::lexicographical_compare((const unsigned char*)a.ssKey.data(), (const unsigned char*)a.ssKey.data() + a.ssKey.size(),
+                                            (const unsigned char*)b.ssKey.data(), (const unsigned char*)b.ssKey.data() + b.ssKey.size());
+    });
+}
+
+} // namespace
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+    size_t nFlushThreads = (size_t)std::max<int64_t>(0, std::min<int64_t>(gArgs.GetArg("-dbflushthreads", nDefaultDbFlushThreads), GetNumCores()));
     assert(!hashBlock.IsNull());
 
     uint256 old_tip = GetBestBlock();
@@ -110,18 +182,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
-        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.coin.IsSpent())
-                batch.Erase(entry);
-            else
-                batch.Write(entry, it->second.coin);
-            changed++;
-        }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+    auto writePartialBatchIfNeeded = [&]() {
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -134,6 +195,50 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
                 }
             }
         }
+    };
+
+    if (nFlushThreads > 1) {
+        // Parallel mode: serialize chunks of dirty entries on multiple threads, then write them sorted by key
+        std::vector<CCoinsMap::const_iterator> entries;
+        std::vector<SerializedCoinEntry> serialized;
+        entries.reserve(std::min(mapCoins.size(), PARALLEL_FLUSH_CHUNK_SIZE));
+        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+            entries.clear();
+            CCoinsMap::iterator itChunkBegin = it;
+            for (; it != mapCoins.end() && entries.size() < PARALLEL_FLUSH_CHUNK_SIZE; ++it) {
+                if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+                    entries.emplace_back(it);
+                }
+                count++;
+            }
+            changed += entries.size();
+            SerializeCoinEntries(entries, serialized, dbwrapper_private::GetObfuscateKey(db), nFlushThreads);
+            // everything needed is serialized now, free the memory of the cache entries as early as possible
+            mapCoins.erase(itChunkBegin, it);
+            for (const auto& e : serialized) {
+                if (e.fErase) {
+                    batch.Erase(e.ssKey);
+                } else {
+                    batch.WriteSerialized(e.ssKey, e.ssValue);
+                }
+                writePartialBatchIfNeeded();
+            }
+        }
+    }
+
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
+            else
+                batch.Write(entry, it->second.coin);
+            changed++;
+        }
+        count++;
+        CCoinsMap::iterator itOld = it++;
+        mapCoins.erase(itOld);
+        writePartialBatchIfNeeded();
     }
 
     // In the last batch, mark the database as consistent with hashBlock again.
@@ -151,7 +256,29 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe), mapHasTxIndexCache(10000, 20000) {
+void CCoinsViewDB::CompactCoins(unsigned char nTxidPrefix) const
+{
+    uint256 begin, end;
+    std::fill(end.begin(), end.end(), 0xff);
+    *begin.begin() = nTxidPrefix;
+    *end.begin() = nTxidPrefix;
+    db.CompactRange(std::make_pair(DB_COIN, begin), std::make_pair(DB_COIN, end));
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe),
+    mapHasTxIndexCache(10000, 20000),
+    spentIndexCache(SPENT_INDEX_CACHE_SIZE),
+    pathSnapshot((gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" : GetBlocksDir()) / "indexsnapshot.dat"),
+    fSnapshotEnabled(!fMemory)
+{
+    if (!fSnapshotEnabled) {
+        return;
+    }
+    if (fWipe && fs::exists(pathSnapshot)) {
+        fs::remove(pathSnapshot);
+    }
+    fHaveSnapshotInfo = Read(DB_BLOCK_INDEX_SNAPSHOT, snapshotInfo);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,6 +297,23 @@ bool CBlockTreeDB::ReadReindexing(bool &fReindexing) {
     return true;
 }
 
+bool CBlockTreeDB::WriteUTXOSnapshotMetadata(const SnapshotMetadata& metadata) {
+    return Write(DB_UTXO_SNAPSHOT, metadata, true);
+}
+
+bool CBlockTreeDB::ReadUTXOSnapshotMetadata(SnapshotMetadata& metadata) {
+    return Read(DB_UTXO_SNAPSHOT, metadata);
+}
+
+bool CBlockTreeDB::EraseUTXOSnapshotMetadata() {
+    return Erase(DB_UTXO_SNAPSHOT, true);
+}
+
+void CBlockTreeDB::CompactBlockIndex() const {
+    CompactRange(DB_BLOCK_FILES, (char)(DB_BLOCK_FILES+1));
+    CompactRange(DB_BLOCK_INDEX, (char)(DB_BLOCK_INDEX+1));
+}
+
 bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
@@ -237,6 +381,23 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    if (fSnapshotValid) {
+        CBlockFileInfo lastFileInfo;
+        auto it = std::find_if(fileInfo.begin(), fileInfo.end(), [&](const std::pair<int, const CBlockFileInfo*>& p) { return p.first == nLastFile; });
+        if (it != fileInfo.end()) {
+            lastFileInfo = *it->second;
+        } else {
+            ReadBlockFileInfo(nLastFile, lastFileInfo);
+        }
+        if (!AppendBlockIndexSnapshot(batch, nLastFile, lastFileInfo, blockinfo)) {
+            fSnapshotValid = false;
+        }
+    }
+    if (!fSnapshotValid && fHaveSnapshotInfo) {
+        // The snapshot doesn't match the written entries anymore
+        batch.Erase(DB_BLOCK_INDEX_SNAPSHOT);
+        fHaveSnapshotInfo = false;
+    }
     return WriteBatch(batch, true);
 }
 
@@ -274,7 +435,82 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
 }
 
 bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+    uint64_t nUpdates;
+    {
+        LOCK(cs);
+        CSpentIndexValue valueCached;
+        if (spentIndexCache.get(key, valueCached)) {
+            if (valueCached.IsNull()) {
+                return false;
+            }
+            value = valueCached;
+            return true;
+        }
+        nUpdates = nSpentIndexUpdates;
+    }
+    CSpentIndexValue valueRead;
+    bool r = Read(std::make_pair(DB_SPENTINDEX, key), valueRead);
+    if (r) {
+        value = valueRead;
+    } else {
+        valueRead.SetNull();
+    }
+    LOCK(cs);
+    if (nUpdates == nSpentIndexUpdates) {
+        spentIndexCache.insert(key, valueRead);
+    }
+    return r;
+}
+
+void CBlockTreeDB::ReadSpentIndex(const std::vector<CSpentIndexKey>& keys, std::vector<CSpentIndexValue>& valuesRet) {
+    valuesRet.assign(keys.size(), CSpentIndexValue());
+
+    std::vector<size_t> vecMissing;
+    uint64_t nUpdates;
+    {
+        LOCK(cs);
+        nUpdates = nSpentIndexUpdates;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (!spentIndexCache.get(keys[i], valuesRet[i])) {
+                vecMissing.emplace_back(i);
+            }
+        }
+    }
+    if (vecMissing.empty()) {
+        return;
+    }
+
+    // The outputs of a transaction are adjacent in the index, so after reading one output the iterator is often
+    // positioned at the next requested one already and doesn't need to seek
+    std::sort(vecMissing.begin(), vecMissing.end(), [&](size_t a, size_t b) {
+        return CSpentIndexKeyCompare()(keys[a], keys[b]);
+    });
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    bool fPositioned = false;
+    std::pair<char, CSpentIndexKey> key;
+    auto isAtKey = [&](const CSpentIndexKey& target) {
+        return pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_SPENTINDEX && key.second == target;
+    };
+    for (size_t i : vecMissing) {
+        if (!fPositioned || !isAtKey(keys[i])) {
+            pcursor->Seek(std::make_pair(DB_SPENTINDEX, keys[i]));
+            fPositioned = true;
+            if (!isAtKey(keys[i])) {
+                continue;
+            }
+        }
+        if (!pcursor->GetValue(valuesRet[i])) {
+            valuesRet[i].SetNull();
+        }
+        pcursor->Next();
+    }
+
+    LOCK(cs);
+    if (nUpdates == nSpentIndexUpdates) {
+        for (size_t i : vecMissing) {
+            spentIndexCache.insert(keys[i], valuesRet[i]);
+        }
+    }
 }
 
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
@@ -286,7 +522,13 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey,
             batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    bool ret = WriteBatch(batch);
+    LOCK(cs);
+    nSpentIndexUpdates++;
+    for (const auto& p : vect) {
+        spentIndexCache.erase(p.first);
+    }
+    return ret;
 }
 
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
@@ -303,18 +545,32 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ReadAddressUnspentIndex(addressHash, type, nullptr, [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        unspentOutputs.emplace_back(key, value);
+        return true;
+    });
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, const CAddressUnspentKey* pstart,
+                                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pstart) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, *pstart));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && (int)key.second.type == type && key.second.hashBytes == addressHash) {
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                if (!fn(key.second, nValue)) {
+                    break;
+                }
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -344,10 +600,20 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    return ReadAddressIndex(addressHash, type, nullptr, start, end, [&](const CAddressIndexKey& key, CAmount value) {
+        addressIndex.emplace_back(key, value);
+        return true;
+    });
+}
+
+bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pstart, int start, int end,
+                                    const std::function<bool(const CAddressIndexKey&, CAmount)>& fn) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pstart) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, *pstart));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
@@ -356,13 +622,15 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && (int)key.second.type == type && key.second.hashBytes == addressHash) {
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
+                if (!fn(key.second, nValue)) {
+                    break;
+                }
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -375,29 +643,44 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
-
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+bool CBlockTreeDB::UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo) {
+    // sum up the deltas per address first so every address is read and written once per block
+    std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue> mapDeltas;
+    for (const auto& p : vect) {
+        CAddressBalanceValue& delta = mapDeltas[std::make_pair(p.first.type, p.first.hashBytes)];
+        delta.balance += p.second;
+        if (p.second > 0) {
+            delta.received += p.second;
+        }
+    }
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
-            pcursor->Next();
+    CDBBatch batch(*this);
+    for (const auto& p : mapDeltas) {
+        const auto key = std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(p.first.first, p.first.second));
+        CAddressBalanceValue value;
+        if (!Read(key, value)) {
+            value.SetNull();
+        }
+        if (fUndo) {
+            value.balance -= p.second.balance;
+            value.received -= p.second.received;
         } else {
-            break;
+            value.balance += p.second.balance;
+            value.received += p.second.received;
+        }
+        if (value.IsNull()) {
+            batch.Erase(key);
+        } else {
+            batch.Write(key, value);
         }
     }
+    return WriteBatch(batch);
+}
 
+bool CBlockTreeDB::ReadAddressBalanceIndex(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    if (!Read(std::make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value)) {
+        value.SetNull();
+    }
     return true;
 }
 
@@ -413,8 +696,330 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+//! Copy what is stored for a block index entry, everything but the hashes and pprev
+static void CopyBlockIndexFields(CBlockIndex* pindexNew, const CBlockIndex& index)
+{
+    pindexNew->nHeight        = index.nHeight;
+    pindexNew->nFile          = index.nFile;
+    pindexNew->nDataPos       = index.nDataPos;
+    pindexNew->nUndoPos       = index.nUndoPos;
+    pindexNew->nVersion       = index.nVersion;
+    pindexNew->hashMerkleRoot = index.hashMerkleRoot;
+    pindexNew->nTime          = index.nTime;
+    pindexNew->nBits          = index.nBits;
+    pindexNew->nNonce         = index.nNonce;
+    pindexNew->nStatus        = index.nStatus;
+    pindexNew->nTx            = index.nTx;
+}
+
+//! Snapshot entries hold the same data as CDiskBlockIndex, followed by the reference to pprev
+template<typename Stream>
+static void SerializeSnapshotEntry(Stream& s, const CBlockIndex& index)
+{
+    s << VARINT(index.nHeight, VarIntMode::NONNEGATIVE_SIGNED) << VARINT(index.nStatus) << VARINT(index.nTx);
+    if (index.nStatus & (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO))
+        s << VARINT(index.nFile, VarIntMode::NONNEGATIVE_SIGNED);
+    if (index.nStatus & BLOCK_HAVE_DATA)
+        s << VARINT(index.nDataPos);
+    if (index.nStatus & BLOCK_HAVE_UNDO)
+        s << VARINT(index.nUndoPos);
+    s << index.GetBlockHash() << index.nVersion << index.hashMerkleRoot << index.nTime << index.nBits << index.nNonce;
+}
+
+template<typename Stream>
+static void UnserializeSnapshotEntry(Stream& s, CBlockIndex& index, uint256& hash)
+{
+    s >> VARINT(index.nHeight, VarIntMode::NONNEGATIVE_SIGNED) >> VARINT(index.nStatus) >> VARINT(index.nTx);
+    if (index.nStatus & (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO))
+        s >> VARINT(index.nFile, VarIntMode::NONNEGATIVE_SIGNED);
+    if (index.nStatus & BLOCK_HAVE_DATA)
+        s >> VARINT(index.nDataPos);
+    if (index.nStatus & BLOCK_HAVE_UNDO)
+        s >> VARINT(index.nUndoPos);
+    s >> hash >> index.nVersion >> index.hashMerkleRoot >> index.nTime >> index.nBits >> index.nNonce;
+}
+
+//! A chunk is its type, the number of entries, the size of the entries and the SHA256 of them
+template<typename Stream>
+static void WriteSnapshotChunk(Stream& s, uint8_t nType, uint32_t nCount, const CPublicDataStream& entries)
+{
+    uint256 checksum;
+    CSHA256().Write((const unsigned char*)entries.data(), entries.size()).Finalize(checksum.begin());
+    s << nType << nCount << (uint32_t)entries.size();
+    s.write(entries.data(), entries.size());
+    s << checksum;
+}
+
+bool CBlockTreeDB::AppendBlockIndexSnapshot(CDBBatch& batch, int nLastFile, const CBlockFileInfo& lastFileInfo, const std::vector<const CBlockIndex*>& blockinfo)
+{
+    CBlockIndexSnapshotInfo newInfo = snapshotInfo;
+    newInfo.nLastFile = nLastFile;
+    newInfo.lastFileInfo = lastFileInfo;
+
+    if (!blockinfo.empty()) {
+        CPublicDataStream entries(SER_DISK, CLIENT_VERSION);
+        for (const CBlockIndex* pindex : blockinfo) {
+            SerializeSnapshotEntry(entries, *pindex);
+            entries << (pindex->pprev ? pindex->pprev->GetBlockHash() : uint256());
+        }
+        CPublicDataStream chunk(SER_DISK, CLIENT_VERSION);
+        WriteSnapshotChunk(chunk, SNAPSHOT_CHUNK_APPEND, (uint32_t)blockinfo.size(), entries);
+
+        // Whatever follows the valid part was written before a crash and is overwritten
+        FILE* file = fsbridge::fopen(pathSnapshot, "r+b");
+        if (!file) {
+            return error("%s: failed to open %s", __func__, pathSnapshot.string());
+        }
+        bool fOk = fseek(file, snapshotInfo.nSize, SEEK_SET) == 0 &&
+                   fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size() &&
+                   TruncateFile(file, snapshotInfo.nSize + chunk.size()) &&
+                   FileCommit(file);
+        fclose(file);
+        if (!fOk) {
+            return error("%s: failed to append to %s", __func__, pathSnapshot.string());
+        }
+        newInfo.nSize += chunk.size();
+    }
+
+    // The file is synced before the batch refers to the new size
+    batch.Write(DB_BLOCK_INDEX_SNAPSHOT, newInfo);
+    snapshotInfo = newInfo;
+    return true;
+}
+
+bool CBlockTreeDB::ReadBlockIndexSnapshot(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool& fLoaded)
+{
+    fLoaded = false;
+    int64_t nStart = GetTimeMillis();
+
+    int nLastFile = 0;
+    CBlockFileInfo lastFileInfo;
+    ReadLastBlockFile(nLastFile);
+    ReadBlockFileInfo(nLastFile, lastFileInfo);
+    if (nLastFile != snapshotInfo.nLastFile || SerializeHash(lastFileInfo) != SerializeHash(snapshotInfo.lastFileInfo)) {
+        LogPrintf("%s: block files changed since the snapshot was written, not using it\n", __func__);
+        return true;
+    }
+
+    // One sequential read of the whole snapshot
+    std::vector<unsigned char> vData;
+    {
+        FILE* file = fsbridge::fopen(pathSnapshot, "rb");
+        if (!file) {
+            LogPrintf("%s: failed to open %s, not using it\n", __func__, pathSnapshot.string());
+            return true;
+        }
+        bool fOk = fs::file_size(pathSnapshot) >= snapshotInfo.nSize;
+        if (fOk) {
+            vData.resize(snapshotInfo.nSize);
+            fOk = fread(vData.data(), 1, vData.size(), file) == vData.size();
+        }
+        fclose(file);
+        if (!fOk) {
+            LogPrintf("%s: %s is truncated, not using it\n", __func__, pathSnapshot.string());
+            return true;
+        }
+    }
+
+    // Verify all chunks before touching the block index, so that a damaged snapshot can fall back to the db
+    struct Chunk {
+        uint8_t nType;
+        uint32_t nCount;
+        Span<const unsigned char> entries;
+    };
+    std::vector<Chunk> vChunks;
+    try {
+        SpanReader s(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(vData.data(), vData.size()));
+        uint32_t nMagic, nVersion;
+        s >> nMagic >> nVersion;
+        if (nMagic != BLOCK_INDEX_SNAPSHOT_MAGIC || nVersion != BLOCK_INDEX_SNAPSHOT_VERSION) {
+            LogPrintf("%s: unknown snapshot format, not using it\n", __func__);
+            return true;
+        }
+        while (!s.empty()) {
+            Chunk chunk;
+            uint32_t nEntriesSize;
+            s >> chunk.nType >> chunk.nCount >> nEntriesSize;
+            if (nEntriesSize > s.size() || (chunk.nType != SNAPSHOT_CHUNK_FULL && chunk.nType != SNAPSHOT_CHUNK_APPEND)) {
+                throw std::ios_base::failure("invalid chunk");
+            }
+            chunk.entries = Span<const unsigned char>(s.data(), nEntriesSize);
+            s.ignore(nEntriesSize);
+            uint256 checksum, hash;
+            s >> checksum;
+            CSHA256().Write(chunk.entries.data(), chunk.entries.size()).Finalize(hash.begin());
+            if (hash != checksum) {
+                throw std::ios_base::failure("checksum mismatch");
+            }
+            vChunks.emplace_back(chunk);
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s is damaged (%s), not using it\n", __func__, pathSnapshot.string(), e.what());
+        return true;
+    }
+
+    size_t nEntries = 0;
+    try {
+        std::vector<CBlockIndex*> vFull;
+        for (const Chunk& chunk : vChunks) {
+            boost::this_thread::interruption_point();
+            SpanReader s(SER_DISK, CLIENT_VERSION, chunk.entries);
+            for (uint32_t i = 0; i < chunk.nCount; i++) {
+                CBlockIndex index;
+                uint256 hash;
+                UnserializeSnapshotEntry(s, index, hash);
+
+                // Construct block index object
+                CBlockIndex* pindexNew = insertBlockIndex(hash);
+                if (chunk.nType == SNAPSHOT_CHUNK_FULL) {
+                    uint32_t nPrevPos;
+                    s >> VARINT(nPrevPos);
+                    if (nPrevPos > vFull.size()) {
+                        throw std::ios_base::failure("invalid pprev");
+                    }
+                    pindexNew->pprev = nPrevPos ? vFull[nPrevPos - 1] : nullptr;
+                    vFull.push_back(pindexNew);
+                } else {
+                    uint256 hashPrev;
+                    s >> hashPrev;
+                    pindexNew->pprev = insertBlockIndex(hashPrev);
+                }
+                CopyBlockIndexFields(pindexNew, index);
+
+                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
+                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+            }
+            if (!s.empty()) {
+                throw std::ios_base::failure("trailing data");
+            }
+            nEntries += chunk.nCount;
+        }
+    } catch (const std::ios_base::failure& e) {
+        // Chunks with a valid checksum are written by us, the block index is partially loaded now
+        return error("%s: failed to read %s: %s", __func__, pathSnapshot.string(), e.what());
+    }
+
+    fLoaded = true;
+    fSnapshotValid = true;
+    LogPrintf("%s: loaded %u entries from %s in %dms\n", __func__, nEntries, pathSnapshot.string(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CBlockTreeDB::NeedsBlockIndexSnapshot() const
+{
+    return fSnapshotEnabled && (!fSnapshotValid || snapshotInfo.nSize - snapshotInfo.nFullSize > snapshotInfo.nFullSize / 4);
+}
+
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& vIndexes)
+{
+    if (!fSnapshotEnabled) {
+        return false;
+    }
+    int64_t nStart = GetTimeMillis();
+
+    // Position of each entry in the dump, looked up when it is the pprev of a later one
+    std::vector<std::pair<const CBlockIndex*, uint32_t>> vPositions;
+    vPositions.reserve(vIndexes.size());
+    for (size_t i = 0; i < vIndexes.size(); i++) {
+        vPositions.emplace_back(vIndexes[i], (uint32_t)i);
+    }
+    std::sort(vPositions.begin(), vPositions.end());
+
+    fs::path pathTmp = pathSnapshot;
+    pathTmp += ".new";
+    CBlockIndexSnapshotInfo newInfo;
+    try {
+        CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull()) {
+            return error("%s: failed to open %s", __func__, pathTmp.string());
+        }
+        fileout << BLOCK_INDEX_SNAPSHOT_MAGIC << BLOCK_INDEX_SNAPSHOT_VERSION;
+        newInfo.nSize = 2 * sizeof(uint32_t);
+
+        CPublicDataStream entries(SER_DISK, CLIENT_VERSION);
+        uint32_t nCount = 0;
+        auto writeChunk = [&]() {
+            CPublicDataStream chunk(SER_DISK, CLIENT_VERSION);
+            WriteSnapshotChunk(chunk, SNAPSHOT_CHUNK_FULL, nCount, entries);
+            fileout.write(chunk.data(), chunk.size());
+            newInfo.nSize += chunk.size();
+            entries.clear();
+            nCount = 0;
+        };
+        for (size_t i = 0; i < vIndexes.size(); i++) {
+            const CBlockIndex* pindex = vIndexes[i];
+            uint32_t nPrevPos = 0;
+            if (pindex->pprev) {
+                auto it = std::lower_bound(vPositions.begin(), vPositions.end(), std::make_pair((const CBlockIndex*)pindex->pprev, uint32_t(0)));
+                if (it == vPositions.end() || it->first != pindex->pprev || it->second >= i) {
+                    fileout.fclose();
+                    fs::remove(pathTmp);
+                    return error("%s: %s doesn't follow its pprev", __func__, pindex->ToString());
+                }
+                nPrevPos = it->second + 1;
+            }
+            SerializeSnapshotEntry(entries, *pindex);
+            entries << VARINT(nPrevPos);
+            nCount++;
+            if (entries.size() >= SNAPSHOT_CHUNK_SIZE) {
+                writeChunk();
+            }
+        }
+        if (nCount) {
+            writeChunk();
+        }
+        if (!FileCommit(fileout.Get())) {
+            fileout.fclose();
+            fs::remove(pathTmp);
+            return error("%s: failed to commit %s", __func__, pathTmp.string());
+        }
+    } catch (const std::exception& e) {
+        fs::remove(pathTmp);
+        return error("%s: failed to write %s: %s", __func__, pathTmp.string(), e.what());
+    }
+    newInfo.nFullSize = newInfo.nSize;
+    ReadLastBlockFile(newInfo.nLastFile);
+    ReadBlockFileInfo(newInfo.nLastFile, newInfo.lastFileInfo);
+
+    // The old info must not describe the new file, even if it is replaced without writing the new info
+    fSnapshotValid = false;
+    if (fHaveSnapshotInfo) {
+        if (!Erase(DB_BLOCK_INDEX_SNAPSHOT, true)) {
+            return false;
+        }
+        fHaveSnapshotInfo = false;
+    }
+    if (!RenameOver(pathTmp, pathSnapshot)) {
+        fs::remove(pathTmp);
+        return error("%s: failed to rename %s", __func__, pathTmp.string());
+    }
+    if (!Write(DB_BLOCK_INDEX_SNAPSHOT, newInfo, true)) {
+        return false;
+    }
+    fHaveSnapshotInfo = true;
+    fSnapshotValid = true;
+    snapshotInfo = newInfo;
+    LogPrintf("%s: wrote %u entries (%u bytes) to %s in %dms\n", __func__, vIndexes.size(), newInfo.nSize, pathSnapshot.string(), GetTimeMillis() - nStart);
+    return true;
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
+    if (fHaveSnapshotInfo) {
+        bool fLoaded;
+        if (!ReadBlockIndexSnapshot(consensusParams, insertBlockIndex, fLoaded)) {
+            return false;
+        }
+        if (fLoaded) {
+            return true;
+        }
+        // Stale or damaged, load the entries from the db and write a new snapshot at shutdown
+        if (!Erase(DB_BLOCK_INDEX_SNAPSHOT, true)) {
+            return error("%s: failed to erase the block index snapshot info", __func__);
+        }
+        fHaveSnapshotInfo = false;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
@@ -429,17 +1034,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 // Construct block index object
                 CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
+                CopyBlockIndexFields(pindexNew, diskindex);
 
                 if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
                     return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
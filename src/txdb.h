@@ -12,7 +12,9 @@
 #include <limitedmap.h>
 #include <spentindex.h>
 #include <sync.h>
+#include <unordered_lru_cache.h>
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -22,6 +24,7 @@
 class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
+class SnapshotMetadata;
 
 //! No need to periodic flush if at least this much space still available.
 static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
@@ -29,6 +32,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 300;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbflushthreads default, number of threads serializing coins when flushing (0 = serialize while writing)
+static const int64_t nDefaultDbFlushThreads = 4;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -39,6 +44,12 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+//! Number of recently read spent index entries kept in memory, explorers look up the same outputs repeatedly
+static const size_t SPENT_INDEX_CACHE_SIZE = 20000;
+//! Max memory allocated to the timestamp index DB specific cache (MiB)
+static const int64_t nMaxTimestampIndexCache = 8;
+//! Max memory allocated to the block filter index DB specific cache (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -67,13 +78,38 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/**
+ * How much of the block index snapshot file (blocks/indexsnapshot.dat) is valid, stored in the block tree db. The
+ * snapshot is an append-only copy of the block index entries: a full dump followed by the entries which were written
+ * since. The last block file and its info guard against the block index having been changed by a version which doesn't
+ * know about the snapshot.
+ */
+struct CBlockIndexSnapshotInfo
+{
+    uint64_t nSize{0};
+    uint64_t nFullSize{0};
+    int nLastFile{0};
+    CBlockFileInfo lastFileInfo;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nSize);
+        READWRITE(nFullSize);
+        READWRITE(nLastFile);
+        READWRITE(lastFileInfo);
+    }
+};
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
 public:
-    explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    //! strName is the directory in the datadir, the chainstate validated below a loaded UTXO snapshot has its own
+    explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const std::string& strName = "chainstate");
 
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
@@ -86,6 +122,8 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+    //! Compact the coins of all txids starting with the given byte. Used to compact the whole database in slices.
+    void CompactCoins(unsigned char nTxidPrefix) const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -116,6 +154,21 @@ class CBlockTreeDB : public CDBWrapper
 private:
     CCriticalSection cs;
     unordered_limitedmap<uint256, bool> mapHasTxIndexCache;
+    // recently read spent index entries, with null values for outputs which are not spent. UpdateSpentIndex erases
+    // the entries it changes, reads which raced with an update aren't cached, see nSpentIndexUpdates
+    unordered_lru_cache<CSpentIndexKey, CSpentIndexValue, StaticSaltedHasher> spentIndexCache;
+    uint64_t nSpentIndexUpdates{0};
+
+    const fs::path pathSnapshot;
+    const bool fSnapshotEnabled;
+    //! Whether the db has a snapshot info, which might be stale until LoadBlockIndexGuts checked it
+    bool fHaveSnapshotInfo{false};
+    //! Whether the snapshot matches the block index entries, so that written entries are appended to it
+    bool fSnapshotValid{false};
+    CBlockIndexSnapshotInfo snapshotInfo;
+
+    bool ReadBlockIndexSnapshot(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool& fLoaded);
+    bool AppendBlockIndexSnapshot(CDBBatch& batch, int nLastFile, const CBlockFileInfo& lastFileInfo, const std::vector<const CBlockIndex*>& blockinfo);
 
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
@@ -126,26 +179,48 @@ public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
+    //! Compact the block index and block file info, which get rewritten when block files are pruned
+    void CompactBlockIndex() const;
     bool WriteReindexing(bool fReindexing);
     bool ReadReindexing(bool &fReindexing);
+    //! The metadata of a UTXO snapshot loaded with -loadsnapshot, as long as the blocks below its base aren't validated
+    bool WriteUTXOSnapshotMetadata(const SnapshotMetadata& metadata);
+    bool ReadUTXOSnapshotMetadata(SnapshotMetadata& metadata);
+    bool EraseUTXOSnapshotMetadata();
     bool HasTxIndex(const uint256 &txid);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    /** Look up multiple keys with a single iterator. valuesRet[i] is null if keys[i] is not spent */
+    void ReadSpentIndex(const std::vector<CSpentIndexKey>& keys, std::vector<CSpentIndexValue>& valuesRet);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    /** Visit the unspent outputs of an address in index order, starting at pstart (when set) instead of the first
+     *  entry. Iteration stops early when fn returns false. */
+    bool ReadAddressUnspentIndex(uint160 addressHash, int type, const CAddressUnspentKey* pstart,
+                                 const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    /** Visit the deltas of an address in index order, see ReadAddressUnspentIndex. */
+    bool ReadAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pstart, int start, int end,
+                          const std::function<bool(const CAddressIndexKey&, CAmount)>& fn);
+    /** Apply (or with fUndo, revert) the deltas of a block to the per address totals */
+    bool UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo);
+    bool ReadAddressBalanceIndex(uint160 addressHash, int type, CAddressBalanceValue &value);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    /** Load the block index from the snapshot when it is valid, and from the block index entries otherwise */
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    //! Whether there is no valid snapshot or enough entries were appended to it to make rewriting it worthwhile
+    bool NeedsBlockIndexSnapshot() const;
+    /** Replace the snapshot with a full dump of the block index. All entries must have been written to the db already
+     *  and each entry's pprev has to precede it in vIndexes. */
+    bool WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& vIndexes);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -57,6 +57,15 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints& lp)
     lockPoints = lp;
 }
 
+/** Accumulated package statistics change of a single in-mempool entry */
+struct PackageDelta
+{
+    int64_t nSize{0};
+    CAmount nFee{0};
+    int64_t nCount{0};
+    int nSigOps{0};
+};
+
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
@@ -252,7 +261,11 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants)
 {
     // For each entry, walk back all ancestors and decrement size associated with this
-    // transaction
+    // transaction. The changes are accumulated per surviving entry first and applied
+    // with a single mapTx.modify() each, as every modify re-sorts the entry in all
+    // indexes. Entries which are removed as well are skipped, their state is discarded
+    // anyway. This matters when long chains are removed together, e.g. chains of
+    // CoinJoin or InstantSend locked transactions being mined in the same block.
     const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
     if (updateDescendants) {
         // updateDescendants should be true whenever we're not recursively
@@ -261,18 +274,26 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // Here we only update statistics and not data in mapLinks (which
         // we need to preserve until we're finished with all operations that
         // need to traverse the mempool).
+        std::map<txiter, PackageDelta, CompareIteratorByHash> mapAncestorDeltas;
         for (txiter removeIt : entriesToRemove) {
             setEntries setDescendants;
             CalculateDescendants(removeIt, setDescendants);
-            setDescendants.erase(removeIt); // don't update state for self
-            int64_t modifySize = -((int64_t)removeIt->GetTxSize());
-            CAmount modifyFee = -removeIt->GetModifiedFee();
-            int modifySigOps = -removeIt->GetSigOpCount();
             for (txiter dit : setDescendants) {
-                mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, -1, modifySigOps));
+                if (entriesToRemove.count(dit)) {
+                    continue; // don't update state for self or other removed entries
+                }
+                PackageDelta& delta = mapAncestorDeltas[dit];
+                delta.nSize -= removeIt->GetTxSize();
+                delta.nFee -= removeIt->GetModifiedFee();
+                delta.nCount -= 1;
+                delta.nSigOps -= removeIt->GetSigOpCount();
             }
         }
+        for (const auto& p : mapAncestorDeltas) {
+            mapTx.modify(p.first, update_ancestor_state(p.second.nSize, p.second.nFee, p.second.nCount, p.second.nSigOps));
+        }
     }
+    std::map<txiter, PackageDelta, CompareIteratorByHash> mapDescendantDeltas;
     for (txiter removeIt : entriesToRemove) {
         setEntries setAncestors;
         const CTxMemPoolEntry &entry = *removeIt;
@@ -295,9 +316,25 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // and it's important that we use the mapLinks[] notion of ancestor
         // transactions as the set of things to update for removal.
         CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        for (txiter ait : setAncestors) {
+            if (entriesToRemove.count(ait)) {
+                continue;
+            }
+            PackageDelta& delta = mapDescendantDeltas[ait];
+            delta.nSize -= removeIt->GetTxSize();
+            delta.nFee -= removeIt->GetModifiedFee();
+            delta.nCount -= 1;
+        }
+    }
+    for (const auto& p : mapDescendantDeltas) {
+        mapTx.modify(p.first, update_descendant_state(p.second.nSize, p.second.nFee, p.second.nCount));
+    }
+    // Sever the child links that point to each removed entry in the entries for
+    // its parents. This has to wait until all ancestor sets have been calculated.
+    for (txiter removeIt : entriesToRemove) {
+        for (txiter piter : GetMemPoolParents(removeIt)) {
+            UpdateChild(piter, removeIt, false);
+        }
     }
     // After updating all the ancestor sizes, we can now sever the link between each
     // transaction being removed and any mempool children (ie, update setMemPoolParents
@@ -468,6 +505,10 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
     std::vector<CMempoolAddressDeltaKey> inserted;
+    auto addDelta = [&](const CMempoolAddressDeltaKey& key, const CMempoolAddressDelta& delta) {
+        mapAddress[CMempoolAddressKey(key.addressBytes, key.type)].emplace_back(key, delta);
+        inserted.push_back(key);
+    };
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -478,20 +519,17 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(key, delta);
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(key, delta);
         } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(key, delta);
         }
     }
 
@@ -500,24 +538,19 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    mapAddressInserted.emplace(txhash, std::move(inserted));
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
@@ -525,10 +558,9 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+        addressDeltaMap::const_iterator ait = mapAddress.find(*it);
+        if (ait != mapAddress.end()) {
+            results.insert(results.end(), ait->second.begin(), ait->second.end());
         }
     }
     return true;
@@ -540,9 +572,20 @@ bool CTxMemPool::removeAddressIndex(const uint256 txhash)
     addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
 
     if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+        for (const CMempoolAddressDeltaKey& key : it->second) {
+            addressDeltaMap::iterator ait = mapAddress.find(CMempoolAddressKey(key.addressBytes, key.type));
+            if (ait == mapAddress.end()) {
+                // all deltas of this address were already removed for an earlier key of the same TX
+                continue;
+            }
+            // Remove all deltas of this TX for the address in one pass
+            addressDeltas& deltas = ait->second;
+            deltas.erase(std::remove_if(deltas.begin(), deltas.end(), [&](const addressDeltas::value_type& d) {
+                return d.first.txhash == txhash;
+            }), deltas.end());
+            if (deltas.empty()) {
+                mapAddress.erase(ait);
+            }
         }
         mapAddressInserted.erase(it);
     }
@@ -582,12 +625,12 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
         CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
+        mapSpent.emplace(key, value);
         inserted.push_back(key);
 
     }
 
-    mapSpentInserted.insert(make_pair(txhash, inserted));
+    mapSpentInserted.emplace(txhash, std::move(inserted));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -609,9 +652,8 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
     mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
 
     if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
+        for (const CSpentIndexKey& key : it->second) {
+            mapSpent.erase(key);
         }
         mapSpentInserted.erase(it);
     }
@@ -982,14 +1024,19 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    // Remove all of the block's transactions in one go, so chains of them being
+    // mined together don't update each other's package statistics repeatedly.
+    setEntries stage;
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
         if (it != mapTx.end()) {
-            setEntries stage;
             stage.insert(it);
-            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
         }
+    }
+    RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+    for (const auto& tx : vtx)
+    {
         removeConflicts(*tx);
         removeProTxConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
@@ -1194,6 +1241,25 @@ std::vector<CTxMemPool::indexed_transaction_set::const_iterator> CTxMemPool::Get
     return iters;
 }
 
+void CTxMemPool::SortByDepthAndScore(std::vector<uint256>& vHashes) const
+{
+    LOCK(cs);
+    std::vector<indexed_transaction_set::const_iterator> iters;
+    iters.reserve(vHashes.size());
+    for (const uint256& hash : vHashes) {
+        auto it = mapTx.find(hash);
+        if (it != mapTx.end()) {
+            iters.push_back(it);
+        }
+    }
+    std::sort(iters.begin(), iters.end(), DepthAndScoreComparator());
+
+    vHashes.clear();
+    for (auto it : iters) {
+        vHashes.push_back(it->GetTx().GetHash());
+    }
+}
+
 void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
 {
     LOCK(cs);
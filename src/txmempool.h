@@ -9,6 +9,7 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -20,6 +21,8 @@
 #include <indirectmap.h>
 #include <policy/feerate.h>
 #include <primitives/transaction.h>
+#include <saltedhasher.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 #include <random.h>
 #include <netaddress.h>
@@ -516,17 +519,28 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
+    /**
+     * The address and spent indexes are hash maps whose nodes are allocated from indexMemoryResource, so that adding
+     * and removing index entries only touches free lists instead of the heap. All deltas of an address are kept
+     * together in one vector, which is what getAddressIndex scans.
+     */
+    typedef PoolResource<256, alignof(void*)> indexMemoryResource;
+    template <typename K, typename V>
+    using indexMap = std::unordered_map<K, V, StaticSaltedHasher, std::equal_to<K>, PoolAllocator<std::pair<const K, V>, 256, alignof(void*)>>;
+    indexMemoryResource m_index_memory_resource;
+
+    typedef std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > addressDeltas;
+    typedef indexMap<CMempoolAddressKey, addressDeltas> addressDeltaMap;
+    addressDeltaMap mapAddress{0, StaticSaltedHasher(), addressDeltaMap::key_equal(), &m_index_memory_resource};
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
+    typedef indexMap<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    addressDeltaMapInserted mapAddressInserted{0, StaticSaltedHasher(), addressDeltaMapInserted::key_equal(), &m_index_memory_resource};
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
-    mapSpentIndex mapSpent;
+    typedef indexMap<CSpentIndexKey, CSpentIndexValue> mapSpentIndex;
+    mapSpentIndex mapSpent{0, StaticSaltedHasher(), mapSpentIndex::key_equal(), &m_index_memory_resource};
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
+    typedef indexMap<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    mapSpentIndexInserted mapSpentInserted{0, StaticSaltedHasher(), mapSpentIndexInserted::key_equal(), &m_index_memory_resource};
 
     std::multimap<uint256, uint256> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
     std::map<CService, uint256> mapProTxAddresses;
@@ -589,6 +603,8 @@ public:
     void clear();
     void _clear() EXCLUSIVE_LOCKS_REQUIRED(cs); //lock free
     bool CompareDepthAndScore(const uint256& hasha, const uint256& hashb);
+    /** Drop the hashes of transactions which are not in the mempool and sort the others like queryHashes */
+    void SortByDepthAndScore(std::vector<uint256>& vHashes) const;
     void queryHashes(std::vector<uint256>& vtxid);
     bool isSpent(const COutPoint& outpoint) const;
     unsigned int GetTransactionsUpdated() const;
@@ -5,46 +5,60 @@
 #ifndef BITCOIN_UNORDERED_LRU_CACHE_H
 #define BITCOIN_UNORDERED_LRU_CACHE_H
 
+#include <memusage.h>
+#include <sync.h>
+
+#include <algorithm>
+#include <cassert>
+#include <list>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
-template<typename Key, typename Value, typename Hasher, size_t MaxSize = 0, size_t TruncateThreshold = 0>
+template<typename Key, typename Value, typename Hasher, size_t MaxSize = 0>
 class unordered_lru_cache
 {
 private:
-    typedef std::unordered_map<Key, std::pair<Value, int64_t>, Hasher> MapType;
+    // most recently used entries are at the front of the list
+    typedef std::list<std::pair<Key, Value>> ListType;
+    typedef std::unordered_map<Key, typename ListType::iterator, Hasher> MapType;
 
+    ListType cacheList;
     MapType cacheMap;
     size_t maxSize;
-    size_t truncateThreshold;
-    int64_t accessCounter{0};
+    uint64_t nHits{0};
+    uint64_t nMisses{0};
 
 public:
-    explicit unordered_lru_cache(size_t _maxSize = MaxSize, size_t _truncateThreshold = TruncateThreshold) :
-        maxSize(_maxSize),
-        truncateThreshold(_truncateThreshold == 0 ? _maxSize * 2 : _truncateThreshold)
+    explicit unordered_lru_cache(size_t _maxSize = MaxSize) :
+        maxSize(_maxSize)
     {
         // either specify maxSize through template arguments or the contructor and fail otherwise
         assert(_maxSize != 0);
     }
 
     size_t max_size() const { return maxSize; }
+    size_t size() const { return cacheMap.size(); }
+    uint64_t hits() const { return nHits; }
+    uint64_t misses() const { return nMisses; }
 
     template<typename Value2>
     void _emplace(const Key& key, Value2&& v)
     {
-        truncate_if_needed();
         auto it = cacheMap.find(key);
         if (it == cacheMap.end()) {
-            cacheMap.emplace(key, std::make_pair(std::forward<Value2>(v), accessCounter++));
+            cacheList.emplace_front(key, std::forward<Value2>(v));
+            cacheMap.emplace(key, cacheList.begin());
+            evict_if_needed();
         } else {
-            it->second.first = std::forward<Value2>(v);
-            it->second.second = accessCounter++;
+            it->second->second = std::forward<Value2>(v);
+            cacheList.splice(cacheList.begin(), cacheList, it->second);
         }
     }
 
     void emplace(const Key& key, Value&& v)
     {
-        _emplace(key, v);
+        _emplace(key, std::move(v));
     }
 
     void insert(const Key& key, const Value& v)
@@ -56,10 +70,12 @@ public:
     {
         auto it = cacheMap.find(key);
         if (it != cacheMap.end()) {
-            it->second.second = accessCounter++;
-            value = it->second.first;
+            nHits++;
+            cacheList.splice(cacheList.begin(), cacheList, it->second);
+            value = it->second->second;
             return true;
         }
+        nMisses++;
         return false;
     }
 
@@ -67,43 +83,192 @@ public:
     {
         auto it = cacheMap.find(key);
         if (it != cacheMap.end()) {
-            it->second.second = accessCounter++;
+            nHits++;
+            cacheList.splice(cacheList.begin(), cacheList, it->second);
             return true;
         }
+        nMisses++;
         return false;
     }
 
     void erase(const Key& key)
     {
-        cacheMap.erase(key);
+        auto it = cacheMap.find(key);
+        if (it != cacheMap.end()) {
+            cacheList.erase(it->second);
+            cacheMap.erase(it);
+        }
     }
 
     void clear()
     {
         cacheMap.clear();
+        cacheList.clear();
+    }
+
+    /** Memory used by the cache itself, not including memory owned by keys and values */
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::DynamicUsage(cacheList) + memusage::DynamicUsage(cacheMap);
+    }
+
+    /** Calls cb(key, value) for every entry, from most to least recently used. Doesn't affect the LRU order */
+    template<typename Callback>
+    void for_each(Callback&& cb) const
+    {
+        for (const auto& p : cacheList) {
+            cb(p.first, p.second);
+        }
     }
 
 private:
-    void truncate_if_needed()
+    void evict_if_needed()
     {
-        typedef typename MapType::iterator Iterator;
+        while (cacheMap.size() > maxSize) {
+            cacheMap.erase(cacheList.back().first);
+            cacheList.pop_back();
+        }
+    }
+};
+
+/**
+ * Thread-safe variant of unordered_lru_cache. Keys are distributed over independently locked stripes so that
+ * threads working on different keys don't contend on a single lock. Every stripe is a LRU cache of its own, so
+ * eviction is only least-recently-used within a stripe. Small caches use fewer stripes (down to a single one) so that
+ * no stripe ends up with less than MIN_STRIPE_SIZE entries.
+ */
+template<typename Key, typename Value, typename Hasher, size_t MaxSize = 0, size_t NumStripes = 16>
+class concurrent_unordered_lru_cache
+{
+private:
+    static const size_t MIN_STRIPE_SIZE = 256;
+
+    typedef unordered_lru_cache<Key, Value, Hasher> CacheType;
 
-        if (cacheMap.size() <= truncateThreshold) {
-            return;
+    struct Stripe {
+        mutable CCriticalSection cs;
+        CacheType cache;
+
+        explicit Stripe(size_t _maxSize) : cache(_maxSize) {}
+    };
+
+    std::vector<std::unique_ptr<Stripe>> stripes;
+    size_t maxSize;
+    Hasher hasher;
+
+    Stripe& GetStripe(const Key& key) const
+    {
+        return *stripes[hasher(key) % stripes.size()];
+    }
+
+public:
+    explicit concurrent_unordered_lru_cache(size_t _maxSize = MaxSize) :
+        maxSize(_maxSize)
+    {
+        static_assert(NumStripes != 0, "at least one stripe is needed");
+        assert(_maxSize != 0);
+
+        size_t nStripes = std::max<size_t>(1, std::min(NumStripes, _maxSize / MIN_STRIPE_SIZE));
+        size_t nStripeSize = (_maxSize + nStripes - 1) / nStripes;
+        stripes.reserve(nStripes);
+        for (size_t i = 0; i < nStripes; i++) {
+            stripes.emplace_back(std::make_unique<Stripe>(nStripeSize));
         }
+    }
+
+    size_t max_size() const { return maxSize; }
+    size_t stripe_count() const { return stripes.size(); }
 
-        std::vector<Iterator> vec;
-        vec.reserve(cacheMap.size());
-        for (auto it = cacheMap.begin(); it != cacheMap.end(); ++it) {
-            vec.emplace_back(it);
+    size_t size() const
+    {
+        size_t nSize = 0;
+        for (const auto& stripe : stripes) {
+            LOCK(stripe->cs);
+            nSize += stripe->cache.size();
         }
-        // sort by last access time (descending order)
-        std::sort(vec.begin(), vec.end(), [](const Iterator& it1, const Iterator& it2) {
-            return it1->second.second > it2->second.second;
-        });
+        return nSize;
+    }
 
-        for (size_t i = maxSize; i < vec.size(); i++) {
-            cacheMap.erase(vec[i]);
+    uint64_t hits() const
+    {
+        uint64_t nHits = 0;
+        for (const auto& stripe : stripes) {
+            LOCK(stripe->cs);
+            nHits += stripe->cache.hits();
+        }
+        return nHits;
+    }
+
+    uint64_t misses() const
+    {
+        uint64_t nMisses = 0;
+        for (const auto& stripe : stripes) {
+            LOCK(stripe->cs);
+            nMisses += stripe->cache.misses();
+        }
+        return nMisses;
+    }
+
+    void emplace(const Key& key, Value&& v)
+    {
+        Stripe& stripe = GetStripe(key);
+        LOCK(stripe.cs);
+        stripe.cache.emplace(key, std::move(v));
+    }
+
+    void insert(const Key& key, const Value& v)
+    {
+        Stripe& stripe = GetStripe(key);
+        LOCK(stripe.cs);
+        stripe.cache.insert(key, v);
+    }
+
+    bool get(const Key& key, Value& value)
+    {
+        Stripe& stripe = GetStripe(key);
+        LOCK(stripe.cs);
+        return stripe.cache.get(key, value);
+    }
+
+    bool exists(const Key& key)
+    {
+        Stripe& stripe = GetStripe(key);
+        LOCK(stripe.cs);
+        return stripe.cache.exists(key);
+    }
+
+    void erase(const Key& key)
+    {
+        Stripe& stripe = GetStripe(key);
+        LOCK(stripe.cs);
+        stripe.cache.erase(key);
+    }
+
+    void clear()
+    {
+        for (auto& stripe : stripes) {
+            LOCK(stripe->cs);
+            stripe->cache.clear();
+        }
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t nUsage = memusage::DynamicUsage(stripes) + stripes.size() * memusage::MallocUsage(sizeof(Stripe));
+        for (const auto& stripe : stripes) {
+            LOCK(stripe->cs);
+            nUsage += stripe->cache.DynamicMemoryUsage();
+        }
+        return nUsage;
+    }
+
+    /** Calls cb(key, value) for every entry while holding the lock of the entry's stripe */
+    template<typename Callback>
+    void for_each(Callback&& cb) const
+    {
+        for (const auto& stripe : stripes) {
+            LOCK(stripe->cs);
+            stripe->cache.for_each(cb);
         }
     }
 };
@@ -20,6 +20,8 @@ int64_t GetTime();
 int64_t GetTimeMillis();
 /** Returns the system time (not mockable) */
 int64_t GetTimeMicros();
+/** CPU time used by the calling thread in microseconds, 0 if the platform can't tell */
+int64_t GetThreadCPUTimeMicros();
 /** Returns the system time (not mockable) */
 int64_t GetSystemTimeInSeconds(); // Like GetTime(), but not mockable
 
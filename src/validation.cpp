@@ -7,6 +7,8 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockfilemap.h>
+#include <blockview.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -15,18 +17,24 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <cuckoocache.h>
 #include <hash.h>
 #include <init.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <pubkey.h>
 #include <reverse_iterator.h>
+#include <saltedhasher.h>
 #include <script/script.h>
 #include <script/sigcache.h>
 #include <script/standard.h>
+#include <threadinterrupt.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -41,6 +49,8 @@
 
 #include <masternode/masternode-payments.h>
 
+#include <evo/cbtx.h>
+#include <evo/evodb.h>
 #include <evo/specialtx.h>
 #include <evo/deterministicmns.h>
 
@@ -49,8 +59,12 @@
 
 #include <statsd_client.h>
 
+#include <ctpl.h>
+
+#include <deque>
 #include <future>
 #include <sstream>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -166,8 +180,9 @@ public:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
+     * hash must be block.GetHash(), it's passed in by callers which already computed it.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
@@ -190,13 +205,16 @@ public:
 
     void PruneBlockIndexCandidates();
 
+    /** Make the base of a loaded UTXO snapshot the tip, its ancestors don't need to have been downloaded */
+    void ActivateSnapshotBase(CBlockIndex* pindexBase, uint64_t nChainTx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     void UnloadBlockIndex();
 
 private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace);
     bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool);
 
-    CBlockIndex* AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus = BLOCK_VALID_TREE) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256& hash, enum BlockStatus nStatus = BLOCK_VALID_TREE) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /**
@@ -222,6 +240,9 @@ BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
 PrevBlockMap& mapPrevBlockIndex = g_chainstate.mapPrevBlockIndex;
 CChain& chainActive = g_chainstate.chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
+/** The base of the UTXO snapshot loaded with -loadsnapshot, as long as the blocks below it aren't validated */
+static CBlockIndex* pindexUTXOSnapshotBase GUARDED_BY(cs_main) = nullptr;
+static SnapshotMetadata utxoSnapshotMetadata GUARDED_BY(cs_main);
 CWaitableCriticalSection g_best_block_mutex;
 CConditionVariable g_best_block_cv;
 uint256 g_best_block;
@@ -230,7 +251,7 @@ std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = true;
 bool fAddressIndex = false;
-bool fTimestampIndex = false;
+bool fAddressBalanceIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
@@ -239,6 +260,7 @@ bool fRequireStandard = true;
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fAssumeChainLocked = DEFAULT_ASSUME_CHAINLOCKED;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -917,27 +939,43 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), bypass_limits, nAbsurdFee, fDryRun);
 }
 
-bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
+bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    if (!fTimestampIndex)
-        return error("Timestamp index not enabled");
+    if (!fSpentIndex)
+        return false;
+
+    if (mempool.getSpentIndex(key, value))
+        return true;
 
-    if (!pblocktree->ReadTimestampIndex(high, low, hashes))
-        return error("Unable to get hashes for timestamps");
+    if (!pblocktree->ReadSpentIndex(key, value))
+        return false;
 
     return true;
 }
 
-bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
+bool GetSpentIndex(const std::vector<CSpentIndexKey>& keys, std::vector<CSpentIndexValue>& valuesRet)
 {
     if (!fSpentIndex)
         return false;
 
-    if (mempool.getSpentIndex(key, value))
-        return true;
+    valuesRet.assign(keys.size(), CSpentIndexValue());
 
-    if (!pblocktree->ReadSpentIndex(key, value))
-        return false;
+    // outputs spent in the mempool are not in the block tree db, all others are looked up there together
+    std::vector<CSpentIndexKey> vecDbKeys;
+    std::vector<size_t> vecDbPositions;
+    for (size_t i = 0; i < keys.size(); i++) {
+        CSpentIndexKey key = keys[i];
+        if (!mempool.getSpentIndex(key, valuesRet[i])) {
+            vecDbKeys.emplace_back(key);
+            vecDbPositions.emplace_back(i);
+        }
+    }
+
+    std::vector<CSpentIndexValue> vecDbValues;
+    pblocktree->ReadSpentIndex(vecDbKeys, vecDbValues);
+    for (size_t i = 0; i < vecDbPositions.size(); i++) {
+        valuesRet[vecDbPositions[i]] = vecDbValues[i];
+    }
 
     return true;
 }
@@ -966,6 +1004,41 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value)
+{
+    if (!fAddressBalanceIndex)
+        return error("address balance index not enabled");
+
+    if (!pblocktree->ReadAddressBalanceIndex(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
+bool GetAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pstart, int start, int end,
+                     const std::function<bool(const CAddressIndexKey&, CAmount)>& fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndex(addressHash, type, pstart, start, end, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspent(uint160 addressHash, int type, const CAddressUnspentKey* pstart,
+                       const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, pstart, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -974,7 +1047,7 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
 {
     CBlockIndex* pindexSlow = blockIndex;
 
-    LOCK(cs_main);
+    // cs_main is only taken for the index lookups, not while reading from disk
 
     if (!blockIndex) {
         CTransactionRef ptx = mempool.get(hash);
@@ -1000,6 +1073,7 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
                 hashBlock = header.GetHash();
                 if (txOut->GetHash() != hash)
                     return error("%s: txid mismatch", __func__);
+                LOCK(cs_main);
                 if (!mapBlockIndex.count(hashBlock)) {
                     return error("%s: hashBlock %s not in mapBlockIndex", __func__, hashBlock.ToString());
                 }
@@ -1011,6 +1085,7 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
         }
 
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+            LOCK(cs_main);
             const Coin& coin = AccessByTxid(*pcoinsTip, hash);
             if (!coin.IsSpent()) pindexSlow = chainActive[coin.nHeight];
         }
@@ -1063,21 +1138,71 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
+/**
+ * Returns the memory mapping of the block (or undo) file of pos, if block file mapping is enabled (-blockmmapfiles)
+ * and the file is safe to map.
+ */
+static CBlockFileMapCache::MappingPtr GetMappedBlockFile(const CDiskBlockPos& pos, bool fUndo)
+{
+    if (!g_block_file_maps) {
+        return nullptr;
+    }
+    {
+        LOCK(cs_LastBlockFile);
+        // The last block file is still written to and gets truncated when it's finalized, which must not happen
+        // while it's mapped. Older files are only ever appended to (undo data), which is safe.
+        if (pos.nFile >= nLastBlockFile) {
+            return nullptr;
+        }
+    }
+    return g_block_file_maps->Get(GetBlockPosFilename(pos, fUndo ? "rev" : "blk"), pos.nFile, fUndo);
+}
+
+/**
+ * Returns the serialized record (block or block undo) at pos plus nExtra following bytes from the mapping.
+ * Returns an empty span if the record is not (completely) covered by the mapping.
+ */
+static Span<const unsigned char> GetMappedRecord(const CBlockFileMapCache::MappingPtr& mapping, const CDiskBlockPos& pos, size_t nExtra)
+{
+    // Records are prefixed with the message start and their size
+    if (pos.nPos < 8) {
+        return Span<const unsigned char>();
+    }
+    Span<const unsigned char> sizeSpan = mapping->GetRange(pos.nPos - 4, 4);
+    if (sizeSpan.size() != 4) {
+        return Span<const unsigned char>();
+    }
+    return mapping->GetRange(pos.nPos, (size_t)ReadLE32(sizeSpan.data()) + nExtra);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CBlockFileMapCache::MappingPtr mapping = GetMappedBlockFile(pos, false);
+    Span<const unsigned char> mapped = mapping ? GetMappedRecord(mapping, pos, 0) : Span<const unsigned char>();
+    if (mapped.size() != 0) {
+        // Read block from the mapped file
+        try {
+            SpanReader reader(SER_DISK, CLIENT_VERSION, mapped);
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1103,6 +1228,92 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    block.clear();
+
+    if (pos.nPos < 8) {
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+    }
+
+    CBlockFileMapCache::MappingPtr mapping = GetMappedBlockFile(pos, false);
+    Span<const unsigned char> mapped = mapping ? GetMappedRecord(mapping, pos, 0) : Span<const unsigned char>();
+    if (mapped.size() != 0) {
+        if (memcmp(mapping->GetRange(pos.nPos - 8, 4).data(), message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+        }
+        block.assign(mapped.data(), mapped.data() + mapped.size());
+        return true;
+    }
+
+    CDiskBlockPos hpos(pos.nFile, pos.nPos - 8); // Seek back 8 bytes for meta header
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    }
+
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+
+        filein >> blk_start >> blk_size;
+
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+        }
+
+        if (blk_size > MAX_SIZE) {
+            return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__,
+                    pos.ToString(), blk_size, MAX_SIZE);
+        }
+
+        block.resize(blk_size); // Zeroing of memory is intentional here
+        filein.read((char*)block.data(), blk_size);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+
+    return ReadRawBlockFromDisk(block, blockPos, message_start);
+}
+
+bool ReadBlockViewFromDisk(std::unique_ptr<CBlockView>& viewRet, const CBlockIndex* pindex, const CChainParams& chainparams)
+{
+    viewRet.reset();
+
+    std::vector<unsigned char> vData;
+    if (!ReadRawBlockFromDisk(vData, pindex, chainparams.MessageStart())) {
+        return false;
+    }
+
+    std::unique_ptr<CBlockView> view;
+    try {
+        view.reset(new CBlockView(std::move(vData)));
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s for %s", __func__, e.what(), pindex->ToString());
+    }
+
+    uint256 hash = view->GetHeader().GetHash();
+    if (!CheckProofOfWork(hash, view->GetHeader().nBits, chainparams.GetConsensus())) {
+        return error("%s: Errors in block header for %s", __func__, pindex->ToString());
+    }
+    if (hash != pindex->GetBlockHash()) {
+        return error("%s: GetHash() doesn't match index for %s", __func__, pindex->ToString());
+    }
+    viewRet = std::move(view);
+    return true;
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1431,9 +1642,114 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 }
 
 bool CScriptCheck::operator()() {
+    if (payloadSigCheck) {
+        return payloadSigCheck();
+    }
+    if (IsP2PKHSpend() && VerifyP2PKHSignature()) {
+        error = SCRIPT_ERR_OK;
+        return true;
+    }
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    PrecomputedTransactionData txdata(*ptxTo);
-    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, txdata, cacheStore), &error);
+    if (txdata) {
+        return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, *txdata, cacheStore), &error);
+    }
+    PrecomputedTransactionData txdataTmp(*ptxTo);
+    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, txdataTmp, cacheStore), &error);
+}
+
+bool CScriptCheck::IsP2PKHSpend() const
+{
+    if (payloadSigCheck || !ptxTo || !m_tx_out.scriptPubKey.IsPayToPublicKeyHash()) {
+        return false;
+    }
+    // <sig> <pubkey>, pushed without OP_PUSHDATA* so that both pushes are minimal. Signatures with up to 20 bytes
+    // are left to the interpreter, FindAndDelete() would remove them from the scriptCode if they match the pubkey hash.
+    const CScript& scriptSig = ptxTo->vin[nIn].scriptSig;
+    if (scriptSig.empty()) {
+        return false;
+    }
+    size_t nSigSize = scriptSig[0];
+    if (nSigSize <= 20 || nSigSize >= OP_PUSHDATA1 || scriptSig.size() < nSigSize + 2) {
+        return false;
+    }
+    size_t nPubKeySize = scriptSig[nSigSize + 1];
+    return (nPubKeySize == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE || nPubKeySize == CPubKey::PUBLIC_KEY_SIZE) &&
+           scriptSig.size() == nSigSize + nPubKeySize + 2;
+}
+
+bool CScriptCheck::VerifyP2PKHSignature() const
+{
+    const CScript& scriptSig = ptxTo->vin[nIn].scriptSig;
+    const CScript& scriptPubKey = m_tx_out.scriptPubKey;
+    size_t nSigSize = scriptSig[0];
+    std::vector<unsigned char> vchSig(scriptSig.begin() + 1, scriptSig.begin() + 1 + nSigSize);
+    std::vector<unsigned char> vchPubKey(scriptSig.begin() + 2 + nSigSize, scriptSig.end());
+
+    // OP_DUP OP_HASH160 <pubkey hash> OP_EQUALVERIFY
+    uint160 pubKeyHash = Hash160(vchPubKey.begin(), vchPubKey.end());
+    if (memcmp(pubKeyHash.begin(), &scriptPubKey[3], pubKeyHash.size()) != 0) {
+        return false;
+    }
+    // OP_CHECKSIG, with the whole scriptPubKey as scriptCode as it has no OP_CODESEPARATOR. A successful check leaves
+    // a single true on the stack, which also satisfies SCRIPT_VERIFY_CLEANSTACK.
+    if (!CheckSignatureEncoding(vchSig, nFlags, nullptr) || !CheckPubKeyEncoding(vchPubKey, nFlags, nullptr)) {
+        return false;
+    }
+    if (txdata) {
+        return CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, *txdata, cacheStore).CheckSig(vchSig, vchPubKey, scriptPubKey, SigVersion::BASE);
+    }
+    PrecomputedTransactionData txdataTmp(*ptxTo);
+    return CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, txdataTmp, cacheStore).CheckSig(vchSig, vchPubKey, scriptPubKey, SigVersion::BASE);
+}
+
+void CSigBatchCollector::PushBatch(std::vector<CScriptCheck>& vChecks)
+{
+    if (vBatch.empty()) {
+        return;
+    }
+    auto batch = std::make_shared<std::vector<CScriptCheck>>(std::move(vBatch));
+    vBatch.clear();
+    vChecks.emplace_back([batch]() {
+        for (auto& check : *batch) {
+            if (!check()) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void CSigBatchCollector::Add(std::vector<CScriptCheck>& vChecks)
+{
+    std::vector<CScriptCheck> vJobs;
+    size_t nKept = 0;
+    for (size_t i = 0; i < vChecks.size(); i++) {
+        if (!vChecks[i].IsP2PKHSpend()) {
+            if (nKept != i) {
+                vChecks[nKept].swap(vChecks[i]);
+            }
+            nKept++;
+            continue;
+        }
+        if (vBatch.empty()) {
+            vBatch.reserve(SIG_BATCH_SIZE);
+        }
+        vBatch.emplace_back();
+        vBatch.back().swap(vChecks[i]);
+        if (vBatch.size() >= SIG_BATCH_SIZE) {
+            PushBatch(vJobs);
+        }
+    }
+    vChecks.resize(nKept);
+    for (auto& job : vJobs) {
+        vChecks.emplace_back();
+        vChecks.back().swap(job);
+    }
+}
+
+void CSigBatchCollector::Flush(std::vector<CScriptCheck>& vChecks)
+{
+    PushBatch(vChecks);
 }
 
 int GetSpendHeight(const CCoinsViewCache& inputs)
@@ -1446,6 +1762,8 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
+static std::atomic<uint64_t> nScriptExecutionCacheHits{0};
+static std::atomic<uint64_t> nScriptExecutionCacheMisses{0};
 
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
@@ -1456,6 +1774,24 @@ void InitScriptExecutionCache() {
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+bool DumpScriptExecutionCache()
+{
+    LOCK(cs_main);
+    return DumpSignatureCacheFile(scriptExecutionCache, scriptExecutionCacheNonce, GetDataDir() / "scriptcache.dat");
+}
+
+bool LoadScriptExecutionCache()
+{
+    LOCK(cs_main);
+    return LoadSignatureCacheFile(scriptExecutionCache, scriptExecutionCacheNonce, GetDataDir() / "scriptcache.dat");
+}
+
+CSignatureCacheStats GetScriptExecutionCacheStats()
+{
+    LOCK(cs_main);
+    return GetSignatureCacheStats(scriptExecutionCache, nScriptExecutionCacheHits, nScriptExecutionCacheMisses);
+}
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set.
@@ -1500,8 +1836,10 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                nScriptExecutionCacheHits++;
                 return true;
             }
+            nScriptExecutionCacheMisses++;
 
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
@@ -1590,13 +1928,37 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
 
+    // The undo data is followed by its checksum
+    CBlockFileMapCache::MappingPtr mapping = GetMappedBlockFile(pos, true);
+    Span<const unsigned char> mapped = mapping ? GetMappedRecord(mapping, pos, sizeof(uint256)) : Span<const unsigned char>();
+    if (mapped.size() != 0) {
+        SpanReader reader(SER_DISK, CLIENT_VERSION, mapped);
+        uint256 hashChecksum;
+        CHashVerifier<SpanReader> verifier(&reader);
+        try {
+            verifier << pindex->pprev->GetBlockHash();
+            verifier >> blockundo;
+            reader >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s", __func__, e.what());
+        }
+
+        if (hashChecksum != verifier.GetHash())
+            return error("%s: Checksum mismatch", __func__);
+
+        return true;
+    }
+
     // Open history file to read
     CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
@@ -1621,6 +1983,8 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1808,8 +2172,12 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
 
                     } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
                         uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, false), prevout.nValue));
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, j), CAddressUnspentValue()));
+
+                        // undo spending activity
+                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
+
+                        // restore unspent index
+                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
                     } else {
                         continue;
                     }
@@ -1837,6 +2205,10 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             AbortNode("Failed to write address unspent index");
             return DISCONNECT_FAILED;
         }
+        if (fAddressBalanceIndex && !pblocktree->UpdateAddressBalanceIndex(addressIndex, true)) {
+            AbortNode("Failed to write address balance index");
+            return DISCONNECT_FAILED;
+        }
     }
 
     // move best block pointer to prevout block
@@ -2127,6 +2499,12 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
     }
 
+    // A ChainLock means that the majority of an LLMQ had this block as its tip, so it was fully validated by them
+    const bool fChainLocked = pindex->phashBlock && llmq::chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash());
+    // Transactions which were also IS locked had their scripts verified by the IS quorum members as well, so they are
+    // not verified again. This speeds up catching up after short outages, when the islocks arrived before the blocks
+    const bool fSkipISLockedScripts = fScriptChecks && fAssumeChainLocked && fChainLocked && !fJustCheck;
+
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
     LogPrint(BCLog::BENCHMARK, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
 
@@ -2208,11 +2586,24 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     bool fDIP0001Active_context = pindex->nHeight >= Params().GetConsensus().DIP0001Height;
 
+    // P2PKH spends are handed to the script check threads in batches, see CSigBatchCollector
+    CSigBatchCollector sigBatch;
+
     // MUST process special txes before updating UTXO to ensure consistency between mempool and block processing
-    if (!ProcessSpecialTxsInBlock(block, pindex, state, view, fJustCheck, fScriptChecks)) {
+    // Payload signatures are verified on the script check threads in parallel with the input scripts (if enabled)
+    std::vector<CSpecialTxSigCheck> vSpecialTxSigChecks;
+    if (!ProcessSpecialTxsInBlock(block, pindex, state, view, fJustCheck, fScriptChecks, fScriptChecks && nScriptCheckThreads ? &vSpecialTxSigChecks : nullptr)) {
         return error("ConnectBlock(DASH): ProcessSpecialTxsInBlock for block %s failed with %s",
                      pindex->GetBlockHash().ToString(), FormatStateMessage(state));
     }
+    if (!vSpecialTxSigChecks.empty()) {
+        std::vector<CScriptCheck> vChecks;
+        vChecks.reserve(vSpecialTxSigChecks.size());
+        for (auto& sigCheck : vSpecialTxSigChecks) {
+            vChecks.emplace_back(std::move(sigCheck));
+        }
+        control.Add(vChecks);
+    }
 
     int64_t nTime2_1 = GetTimeMicros(); nTimeProcessSpecial += nTime2_1 - nTime2;
     LogPrint(BCLog::BENCHMARK, "      - ProcessSpecialTxsInBlock: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2_1 - nTime2), nTimeProcessSpecial * MICRO, nTimeProcessSpecial * MILLI / nBlocksTotal);
@@ -2305,9 +2696,13 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            // Special transactions are always verified, only normal transactions can be covered by an islock
+            bool fTxScriptChecks = fScriptChecks && !(fSkipISLockedScripts && tx.nType == TRANSACTION_NORMAL &&
+                                                      llmq::quorumInstantSendManager->IsLocked(tx.GetHash()));
+            if (!CheckInputs(tx, state, view, fTxScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
+            sigBatch.Add(vChecks);
             control.Add(vChecks);
         }
 
@@ -2350,6 +2745,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
+    {
+        std::vector<CScriptCheck> vChecks;
+        sigBatch.Flush(vChecks);
+        control.Add(vChecks);
+    }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCHMARK, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
 
@@ -2378,7 +2778,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             if (!conflictLock) {
                 continue;
             }
-            if (llmq::chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+            if (fChainLocked) {
                 llmq::quorumInstantSendManager->RemoveConflictingLock(::SerializeHash(*conflictLock), *conflictLock);
                 assert(llmq::quorumInstantSendManager->GetConflictingLock(*tx) == nullptr);
             } else {
@@ -2447,16 +2847,16 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
+
+        if (fAddressBalanceIndex && !pblocktree->UpdateAddressBalanceIndex(addressIndex, false)) {
+            return AbortNode(state, "Failed to write address balance index");
+        }
     }
 
     if (fSpentIndex)
         if (!pblocktree->UpdateSpentIndex(spentIndex))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2570,7 +2970,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             }
             // Finally remove any pruned files
             if (fFlushForPrune)
-                UnlinkPrunedFiles(setFilesToPrune);
+                UnlinkPrunedFilesInBackground(setFilesToPrune);
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2582,12 +2982,16 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
+            // Write the evodb in the background while the chainstate is flushed
+            if (!evoDb->CommitRootTransactionAsync()) {
+                return AbortNode(state, "Failed to commit EvoDB");
+            }
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
-            if (!evoDb->CommitRootTransaction()) {
-                return AbortNode(state, "Failed to commit EvoDB");
-            }
+            // Both need to be written before the flush is done, as the evodb best block has to match the chainstate
+            // after a crash. Write errors are thrown as dbwrapper_error.
+            evoDb->WaitForCommits();
             nLastFlush = nNow;
         }
     }
@@ -2752,6 +3156,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetchInputs = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2822,6 +3227,87 @@ public:
     }
 };
 
+static std::unique_ptr<ctpl::thread_pool> coinsPrefetchPool;
+/** Below this number of inputs which are not cached yet, it's not worth to hand them to the prefetch threads */
+static const size_t MIN_INPUTS_FOR_PARALLEL_PREFETCH = 16;
+
+void StartCoinsPrefetchThreads(int nThreads)
+{
+    assert(!coinsPrefetchPool);
+    coinsPrefetchPool.reset(new ctpl::thread_pool(nThreads));
+    RenameThreadPool(*coinsPrefetchPool, "dash-coinsprefetch");
+}
+
+void StopCoinsPrefetchThreads()
+{
+    if (coinsPrefetchPool) {
+        coinsPrefetchPool->stop(true);
+        coinsPrefetchPool.reset();
+    }
+}
+
+/**
+ * Load the inputs of block which are not in cache yet from base into cache, reading them in parallel. ConnectBlock
+ * would otherwise read them one after another, waiting for the database each time (which is what limits reindexing
+ * and catching up on a cold cache).
+ *
+ * base must be the database cache is (indirectly) backed by, without any unflushed changes in between. Coins which
+ * are already in cache are never read from base, so spent but not yet flushed coins are handled correctly.
+ * This is only an optimization, coins which fail to load are simply fetched again by ConnectBlock.
+ */
+static void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& base)
+{
+    AssertLockHeld(cs_main);
+
+    std::unordered_set<uint256, StaticSaltedHasher> blockTxids;
+    blockTxids.reserve(block.vtx.size());
+    std::vector<COutPoint> vOutpoints;
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                // outputs created in this block are not in the database yet
+                if (!blockTxids.count(txin.prevout.hash) && !cache.HaveCoinInCache(txin.prevout)) {
+                    vOutpoints.emplace_back(txin.prevout);
+                }
+            }
+        }
+        blockTxids.emplace(tx->GetHash());
+    }
+    if (vOutpoints.size() < MIN_INPUTS_FOR_PARALLEL_PREFETCH) {
+        return;
+    }
+
+    std::vector<Coin> vCoins(vOutpoints.size());
+    std::vector<char> vFound(vOutpoints.size(), 0);
+    const size_t nChunks = std::min<size_t>(coinsPrefetchPool->size(), vOutpoints.size() / (MIN_INPUTS_FOR_PARALLEL_PREFETCH / 2));
+    const size_t nChunkSize = (vOutpoints.size() + nChunks - 1) / nChunks;
+    std::vector<std::future<void>> vFutures;
+    vFutures.reserve(nChunks);
+    for (size_t nBegin = 0; nBegin < vOutpoints.size(); nBegin += nChunkSize) {
+        const size_t nEnd = std::min(nBegin + nChunkSize, vOutpoints.size());
+        vFutures.emplace_back(coinsPrefetchPool->push([&, nBegin, nEnd](int) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                try {
+                    vFound[i] = base.GetCoin(vOutpoints[i], vCoins[i]);
+                } catch (const std::exception& e) {
+                    // leave database errors to the regular code path, which knows how to handle them
+                    LogPrint(BCLog::BENCHMARK, "PrefetchBlockInputs -- failed to read coin %s: %s\n", vOutpoints[i].ToStringShort(), e.what());
+                    return;
+                }
+            }
+        }));
+    }
+    for (auto& f : vFutures) {
+        f.get();
+    }
+
+    for (size_t i = 0; i < vOutpoints.size(); i++) {
+        if (vFound[i]) {
+            cache.EmplaceCoinFromBase(vOutpoints[i], std::move(vCoins[i]));
+        }
+    }
+}
+
 /**
  * Connect a new block to chainActive. pblock is either nullptr or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -2848,6 +3334,12 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCHMARK, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    if (coinsPrefetchPool && pcoinsdbview) {
+        PrefetchBlockInputs(blockConnecting, *pcoinsTip, *pcoinsdbview);
+        int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetchInputs += nTimePrefetched - nTime2;
+        LogPrint(BCLog::BENCHMARK, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * MILLI, nTimePrefetchInputs * MICRO);
+        nTime2 = nTimePrefetched;
+    }
     {
         auto dbTx = evoDb->BeginTransaction();
 
@@ -2978,14 +3470,18 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
-    while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
-            // This is likely a fatal error, but keep the mempool consistent,
-            // just in case. Only remove from the mempool in this case.
-            UpdateMempoolForReorg(disconnectpool, false);
-            return false;
+    {
+        // the MN list change of all disconnected blocks is announced at once, before the new blocks are connected
+        CDeterministicMNUndoBatch mnUndoBatch;
+        while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
+            if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+                // This is likely a fatal error, but keep the mempool consistent,
+                // just in case. Only remove from the mempool in this case.
+                UpdateMempoolForReorg(disconnectpool, false);
+                return false;
+            }
+            fBlocksDisconnected = true;
         }
-        fBlocksDisconnected = true;
     }
 
     // Build list of new blocks to connect.
@@ -3236,20 +3732,23 @@ bool CChainState::InvalidateBlock(CValidationState& state, const CChainParams& c
     }
 
     DisconnectedBlockTransactions disconnectpool;
-    while (chainActive.Contains(pindex)) {
-        const CBlockIndex* pindexOldTip = chainActive.Tip();
-        pindex_was_in_chain = true;
-        // ActivateBestChain considers blocks already in chainActive
-        // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
-            // It's probably hopeless to try to make the mempool consistent
-            // here if DisconnectTip failed, but we can try.
-            UpdateMempoolForReorg(disconnectpool, false);
-            return false;
-        }
-        if (pindexOldTip == pindexBestHeader) {
-            pindexBestInvalid = pindexBestHeader;
-            pindexBestHeader = pindexBestHeader->pprev;
+    {
+        CDeterministicMNUndoBatch mnUndoBatch;
+        while (chainActive.Contains(pindex)) {
+            const CBlockIndex* pindexOldTip = chainActive.Tip();
+            pindex_was_in_chain = true;
+            // ActivateBestChain considers blocks already in chainActive
+            // unconditionally valid already, so force disconnect away from it.
+            if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+                // It's probably hopeless to try to make the mempool consistent
+                // here if DisconnectTip failed, but we can try.
+                UpdateMempoolForReorg(disconnectpool, false);
+                return false;
+            }
+            if (pindexOldTip == pindexBestHeader) {
+                pindexBestInvalid = pindexBestHeader;
+                pindexBestHeader = pindexBestHeader->pprev;
+            }
         }
     }
 
@@ -3311,21 +3810,24 @@ bool CChainState::MarkConflictingBlock(CValidationState& state, const CChainPara
     }
 
     DisconnectedBlockTransactions disconnectpool;
-    while (chainActive.Contains(pindex)) {
-        const CBlockIndex* pindexOldTip = chainActive.Tip();
-        pindex_was_in_chain = true;
-        // ActivateBestChain considers blocks already in chainActive
-        // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
-            // It's probably hopeless to try to make the mempool consistent
-            // here if DisconnectTip failed, but we can try.
-            UpdateMempoolForReorg(disconnectpool, false);
-            return false;
-        }
-        if (pindexOldTip == pindexBestHeader) {
-            pindexBestHeader = pindexBestHeader->pprev;
-        }
-    }
+    {
+        CDeterministicMNUndoBatch mnUndoBatch;
+        while (chainActive.Contains(pindex)) {
+            const CBlockIndex* pindexOldTip = chainActive.Tip();
+            pindex_was_in_chain = true;
+            // ActivateBestChain considers blocks already in chainActive
+            // unconditionally valid already, so force disconnect away from it.
+            if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+                // It's probably hopeless to try to make the mempool consistent
+                // here if DisconnectTip failed, but we can try.
+                UpdateMempoolForReorg(disconnectpool, false);
+                return false;
+            }
+            if (pindexOldTip == pindexBestHeader) {
+                pindexBestHeader = pindexBestHeader->pprev;
+            }
+        }
+    }
 
     // Now mark the blocks we just disconnected as descendants conflicting
     // (note this may not be all descendants).
@@ -3427,25 +3929,22 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex) {
     return g_chainstate.ResetBlockFailureFlags(pindex);
 }
 
-CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus)
+CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, const uint256& hash, enum BlockStatus nStatus)
 {
     assert(!(nStatus & BLOCK_FAILED_MASK)); // no failed blocks alowed
     AssertLockHeld(cs_main);
 
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = mapBlockIndex.emplace(hash, block).first->second;
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
-    BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
-    pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
     {
@@ -3478,7 +3977,6 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, enum BlockS
 void CChainState::ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pindexNew, const CDiskBlockPos& pos)
 {
     pindexNew->nTx = block.vtx.size();
-    pindexNew->nChainTx = 0;
     pindexNew->nFile = pos.nFile;
     pindexNew->nDataPos = pos.nPos;
     pindexNew->nUndoPos = 0;
@@ -3486,6 +3984,13 @@ void CChainState::ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pi
     pindexNew->RaiseValidity(BLOCK_VALID_TRANSACTIONS);
     setDirtyBlockIndex.insert(pindexNew);
 
+    if (pindexNew == pindexUTXOSnapshotBase) {
+        // The snapshot base is in the active chain already, it keeps the nChainTx of the snapshot and its place in
+        // setBlockIndexCandidates (which depends on nSequenceId)
+        return;
+    }
+    pindexNew->nChainTx = 0;
+
     if (pindexNew->pprev == nullptr || pindexNew->pprev->nChainTx) {
         // If pindexNew is the genesis block or all parents are BLOCK_VALID_TRANSACTIONS.
         std::deque<CBlockIndex*> queue;
@@ -3608,16 +4113,16 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(hash, block.nBits, consensusParams))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     // Check DevNet
     if (!consensusParams.hashDevnetGenesisBlock.IsNull() &&
             block.hashPrevBlock == consensusParams.hashGenesisBlock &&
-            block.GetHash() != consensusParams.hashDevnetGenesisBlock) {
+            hash != consensusParams.hashDevnetGenesisBlock) {
         return state.DoS(100, error("CheckBlockHeader(): wrong devnet genesis"),
                          REJECT_INVALID, "devnet-genesis");
     }
@@ -3636,7 +4141,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    if (!CheckBlockHeader(block, block.GetHash(), state, consensusParams, fCheckPOW))
         return false;
 
     // Check the merkle root.
@@ -3817,11 +4322,10 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
 
@@ -3839,7 +4343,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, hash, state, chainparams.GetConsensus()))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3880,13 +4384,13 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 
         if (llmq::chainLocksHandler->HasConflictingChainLock(pindexPrev->nHeight + 1, hash)) {
             if (pindex == nullptr) {
-                AddToBlockIndex(block, BLOCK_CONFLICT_CHAINLOCK);
+                AddToBlockIndex(block, hash, BLOCK_CONFLICT_CHAINLOCK);
             }
             return state.DoS(10, error("%s: header %s conflicts with chainlock", __func__, hash.ToString()), REJECT_INVALID, "bad-chainlock");
         }
     }
     if (pindex == nullptr)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3902,12 +4406,24 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
+    std::vector<uint256> hashes;
+    hashes.reserve(headers.size());
+    for (const CBlockHeader& header : headers) {
+        hashes.emplace_back(header.GetHash());
+    }
+    return ProcessNewBlockHeaders(headers, hashes, state, chainparams, ppindex, first_invalid);
+}
+
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, const std::vector<uint256>& hashes, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
+{
+    assert(headers.size() == hashes.size());
     if (first_invalid != nullptr) first_invalid->SetNull();
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, hashes[i], state, chainparams, &pindex)) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3952,7 +4468,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, block.GetHash(), state, chainparams, &pindex))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -4146,14 +4662,565 @@ void PruneOneBlockFile(const int fileNumber)
 }
 
 
+static void UnlinkPrunedFile(int fileNumber)
+{
+    CDiskBlockPos pos(fileNumber, 0);
+    if (g_block_file_maps) {
+        g_block_file_maps->Remove(fileNumber);
+    }
+    fs::remove(GetBlockPosFilename(pos, "blk"));
+    fs::remove(GetBlockPosFilename(pos, "rev"));
+    LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, fileNumber);
+}
+
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
-        CDiskBlockPos pos(*it, 0);
-        fs::remove(GetBlockPosFilename(pos, "blk"));
-        fs::remove(GetBlockPosFilename(pos, "rev"));
-        LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
+        UnlinkPrunedFile(*it);
+    }
+}
+
+/**
+ * Deleting many block files at once (e.g. when lowering -prune or calling pruneblockchain) and compacting the
+ * databases afterwards causes I/O spikes which would otherwise stall FlushStateToDisk and block validation (which
+ * holds cs_main the whole time). The files are already marked as pruned in the block index when queued here.
+ */
+static std::mutex cs_pruneQueue;
+static std::condition_variable condPruneQueue;
+static std::deque<int> pruneQueue GUARDED_BY(cs_pruneQueue);
+static bool fPruneThreadRunning GUARDED_BY(cs_pruneQueue) = false;
+static std::thread pruneThread;
+static CThreadInterrupt pruneInterrupt;
+static std::atomic<uint64_t> nPrunedFilesDeleted{0};
+static std::atomic<bool> fPruneCompacting{false};
+static std::atomic<int64_t> nLastPruneCompactionTime{0};
+
+static void CompactDatabasesAfterPrune(std::chrono::milliseconds throttle)
+{
+    LogPrintf("Prune: compacting block index and chainstate\n");
+    fPruneCompacting = true;
+    pblocktree->CompactBlockIndex();
+    // Compact the chainstate in slices, so that other database users get their turn in between
+    for (int i = 0; i < 256; i++) {
+        if (throttle.count() > 0 && !pruneInterrupt.sleep_for(throttle)) {
+            break;
+        }
+        pcoinsdbview->CompactCoins((unsigned char)i);
+    }
+    fPruneCompacting = false;
+    nLastPruneCompactionTime = GetTime();
+    LogPrintf("Prune: compacted block index and chainstate\n");
+}
+
+static void ThreadPruneBlockFiles(std::chrono::milliseconds throttle)
+{
+    bool fCompactionPending = false;
+    while (!pruneInterrupt) {
+        int fileNumber;
+        {
+            std::unique_lock<std::mutex> lock(cs_pruneQueue);
+            if (pruneQueue.empty() && fCompactionPending && GetTime() - nLastPruneCompactionTime >= PRUNE_COMPACTION_INTERVAL) {
+                lock.unlock();
+                fCompactionPending = false;
+                CompactDatabasesAfterPrune(throttle);
+                continue;
+            }
+            // Wake up once in a while to check whether a pending compaction is due
+            condPruneQueue.wait_for(lock, std::chrono::seconds(60), [] { return !pruneQueue.empty() || pruneInterrupt; });
+            if (pruneQueue.empty()) {
+                continue;
+            }
+            fileNumber = pruneQueue.front();
+            pruneQueue.pop_front();
+        }
+        UnlinkPrunedFile(fileNumber);
+        nPrunedFilesDeleted++;
+        fCompactionPending = true;
+        if (throttle.count() > 0) {
+            pruneInterrupt.sleep_for(throttle);
+        }
+    }
+}
+
+void UnlinkPrunedFilesInBackground(const std::set<int>& setFilesToPrune)
+{
+    {
+        std::unique_lock<std::mutex> lock(cs_pruneQueue);
+        if (fPruneThreadRunning) {
+            pruneQueue.insert(pruneQueue.end(), setFilesToPrune.begin(), setFilesToPrune.end());
+            condPruneQueue.notify_one();
+            return;
+        }
+    }
+    UnlinkPrunedFiles(setFilesToPrune);
+}
+
+void StartBackgroundPruneThread(int64_t nThrottleMs)
+{
+    std::unique_lock<std::mutex> lock(cs_pruneQueue);
+    assert(!fPruneThreadRunning);
+    pruneInterrupt.reset();
+    std::chrono::milliseconds throttle(std::max<int64_t>(nThrottleMs, 0));
+    pruneThread = std::thread(&TraceThread<std::function<void()> >, "prune", std::function<void()>(std::bind(&ThreadPruneBlockFiles, throttle)));
+    fPruneThreadRunning = true;
+}
+
+void StopBackgroundPruneThread()
+{
+    std::deque<int> remaining;
+    {
+        std::unique_lock<std::mutex> lock(cs_pruneQueue);
+        if (!fPruneThreadRunning) {
+            return;
+        }
+        fPruneThreadRunning = false;
+        pruneInterrupt();
+        condPruneQueue.notify_all();
+    }
+    pruneThread.join();
+    {
+        std::unique_lock<std::mutex> lock(cs_pruneQueue);
+        remaining.swap(pruneQueue);
+    }
+    // The block index doesn't know about these files anymore, so they would stay on disk forever
+    for (int fileNumber : remaining) {
+        UnlinkPrunedFile(fileNumber);
+        nPrunedFilesDeleted++;
+    }
+}
+
+BackgroundPruneProgress GetBackgroundPruneProgress()
+{
+    BackgroundPruneProgress progress;
+    {
+        std::unique_lock<std::mutex> lock(cs_pruneQueue);
+        progress.nFilesPending = pruneQueue.size();
+    }
+    progress.nFilesDeleted = nPrunedFilesDeleted;
+    progress.fCompacting = fPruneCompacting;
+    progress.nLastCompactionTime = nLastPruneCompactionTime;
+    return progress;
+}
+
+void CChainState::ActivateSnapshotBase(CBlockIndex* pindexBase, uint64_t nChainTx)
+{
+    AssertLockHeld(cs_main);
+
+    pindexBase->nChainTx = nChainTx;
+    pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+    setDirtyBlockIndex.insert(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    chainActive.SetTip(pindexBase);
+    PruneBlockIndexCandidates();
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, std::string& strErrorRet)
+{
+    const CChainParams& chainparams = Params();
+
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strErrorRet = strprintf(_("Unable to open UTXO snapshot %s"), path.string());
+        return false;
+    }
+
+    try {
+        SnapshotMetadata metadata;
+        file >> metadata;
+
+        LogPrintf("%s: loading UTXO snapshot %s with base %s (height %d, %s), %u coins, hash_serialized_2 %s\n", __func__,
+            path.string(), metadata.m_base_blockhash.ToString(), metadata.m_base_height,
+            metadata.m_base_chainlocked ? "ChainLocked" : "not ChainLocked", metadata.m_coins_count, metadata.m_utxo_hash.ToString());
+
+        // The headers are processed in the same batches as they arrive from peers, without holding cs_main
+        std::vector<CBlockHeader> vHeaders;
+        vHeaders.reserve(MAX_HEADERS_RESULTS);
+        for (int nHeight = 1; nHeight <= metadata.m_base_height; nHeight++) {
+            vHeaders.emplace_back();
+            file >> vHeaders.back();
+            if (vHeaders.size() == MAX_HEADERS_RESULTS || nHeight == metadata.m_base_height) {
+                CValidationState state;
+                if (!ProcessNewBlockHeaders(vHeaders, state, chainparams)) {
+                    strErrorRet = strprintf(_("Invalid header in UTXO snapshot: %s"), FormatStateMessage(state));
+                    return false;
+                }
+                vHeaders.clear();
+            }
+        }
+
+        LOCK(cs_main);
+
+        CBlockIndex* pindexBase = LookupBlockIndex(metadata.m_base_blockhash);
+        if (!pindexBase || pindexBase->nHeight != metadata.m_base_height || (pindexBase->nStatus & BLOCK_FAILED_MASK)) {
+            strErrorRet = _("The headers of the UTXO snapshot don't lead to its base");
+            return false;
+        }
+        if (chainActive.Height() != 0 || pindexUTXOSnapshotBase) {
+            strErrorRet = _("A UTXO snapshot can only be loaded into a new data directory");
+            return false;
+        }
+
+        // Until the snapshot is loaded completely the chainstate is unusable, see LoadBlockIndexDB
+        if (!pblocktree->WriteFlag("utxosnapshotloading", true)) {
+            strErrorRet = _("Failed to write to the block index database");
+            return false;
+        }
+
+        for (uint64_t i = 0; i < metadata.m_coins_count; i++) {
+            COutPoint outpoint;
+            Coin coin;
+            file >> outpoint;
+            file >> coin;
+            if (coin.IsSpent() || coin.nHeight > (uint32_t)metadata.m_base_height) {
+                strErrorRet = strprintf(_("Invalid coin %s in UTXO snapshot"), outpoint.ToStringShort());
+                return false;
+            }
+            // Duplicates in the file throw here or, if the first one was flushed already, make the hash check below fail
+            pcoinsTip->AddCoin(outpoint, std::move(coin), false);
+
+            if (i % 100000 == 0) {
+                if (ShutdownRequested()) {
+                    return false;
+                }
+                if (pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage && !pcoinsTip->Flush()) {
+                    strErrorRet = _("Failed to write to coin database");
+                    return false;
+                }
+                if (i > 0) {
+                    LogPrintf("%s: loaded %u of %u coins\n", __func__, i, metadata.m_coins_count);
+                }
+            }
+        }
+        pcoinsTip->SetBestBlock(metadata.m_base_blockhash);
+        if (!pcoinsTip->Flush()) {
+            strErrorRet = _("Failed to write to coin database");
+            return false;
+        }
+
+        // This only protects against corrupted files, the coins are validated against the chain in the background
+        CCoinsStats stats;
+        if (!GetUTXOStats(pcoinsdbview.get(), stats) || stats.hashSerialized != metadata.m_utxo_hash ||
+            stats.nTransactionOutputs != metadata.m_coins_count) {
+            strErrorRet = _("The coins of the UTXO snapshot don't match its hash");
+            return false;
+        }
+
+        // The evo DB of a new datadir only has the entries written while connecting the genesis block, the snapshot
+        // replaces them with the raw entries of the donor
+        evoDb->WaitForCommits();
+        CDBWrapper& evoRawDb = evoDb->GetRawDB();
+        CDBBatch batch(evoRawDb);
+        {
+            std::unique_ptr<CDBIterator> pcursor(evoRawDb.NewIterator());
+            for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+                CDataStream ssKey = pcursor->GetKey();
+                if (!CDBWrapper::IsObfuscateKeyKey(ssKey)) {
+                    batch.Erase(ssKey);
+                }
+            }
+        }
+        const std::vector<unsigned char>& obfuscateKey = dbwrapper_private::GetObfuscateKey(evoRawDb);
+        for (uint64_t i = 0; i < metadata.m_evodb_count; i++) {
+            std::vector<unsigned char> vKey, vValue;
+            file >> vKey;
+            file >> vValue;
+            CDataStream ssKey(vKey, SER_DISK, CLIENT_VERSION);
+            if (CDBWrapper::IsObfuscateKeyKey(ssKey)) {
+                continue;
+            }
+            CDataStream ssValue(vValue, SER_DISK, CLIENT_VERSION);
+            ssValue.Xor(obfuscateKey);
+            batch.WriteSerialized(ssKey, ssValue);
+            if (batch.SizeEstimate() > (size_t)nDefaultDbBatchSize) {
+                evoRawDb.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        evoRawDb.WriteBatch(batch, true);
+        if (!evoDb->VerifyBestBlock(pindexBase->GetBlockHash()) && pindexBase->nHeight >= chainparams.GetConsensus().DIP0003Height) {
+            strErrorRet = _("The evo DB of the UTXO snapshot is not at its base");
+            return false;
+        }
+
+        g_chainstate.ActivateSnapshotBase(pindexBase, metadata.m_base_chain_tx);
+        pindexUTXOSnapshotBase = pindexBase;
+        utxoSnapshotMetadata = metadata;
+        if (!pblocktree->WriteUTXOSnapshotMetadata(metadata)) {
+            strErrorRet = _("Failed to write to the block index database");
+            return false;
+        }
+        FlushStateToDisk();
+        if (!pblocktree->WriteFlag("utxosnapshotloading", false)) {
+            strErrorRet = _("Failed to write to the block index database");
+            return false;
+        }
+
+        LogPrintf("%s: loaded UTXO snapshot, new tip %s (height %d)\n", __func__, pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+    } catch (const std::exception& e) {
+        strErrorRet = strprintf(_("Error reading UTXO snapshot %s: %s"), path.string(), e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool IsSnapshotValidationPending()
+{
+    LOCK(cs_main);
+    return pindexUTXOSnapshotBase != nullptr;
+}
+
+/**
+ * The blocks below the base of a loaded UTXO snapshot are connected to a separate chainstate in the datadir, which
+ * has to end up with the coins of the snapshot. The special transactions of these blocks are not processed again, the
+ * evo DB at the base is checked against the CbTx of the base and every block connected on top of it instead. The same
+ * goes for the block rewards and masternode payments, which need the evo DB and governance state below the base.
+ */
+static const char* const SNAPSHOT_VALIDATION_DB_NAME = "chainstate_background";
+static const size_t SNAPSHOT_VALIDATION_DB_CACHE = 8 << 20;
+
+static std::thread snapshotValidationThread;
+static CThreadInterrupt snapshotValidationInterrupt;
+static std::atomic<int> nSnapshotValidatedHeight{0};
+
+static bool ConnectSnapshotValidationBlock(const CBlock& block, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, CValidationState& state)
+{
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+
+    int nLockTimeFlags = 0;
+    unsigned int flags;
+    {
+        LOCK(cs_main);
+        if (VersionBitsState(pindex->pprev, consensusParams, Consensus::DEPLOYMENT_CSV, versionbitscache) == ThresholdState::ACTIVE) {
+            nLockTimeFlags |= LOCKTIME_VERIFY_SEQUENCE;
+        }
+        flags = GetBlockScriptFlags(pindex, consensusParams);
+    }
+    const bool fDIP0001Active_context = pindex->nHeight >= consensusParams.DIP0001Height;
+
+    CBlockUndo blockundo;
+    blockundo.vtxundo.reserve(block.vtx.size() - 1);
+    std::vector<int> prevheights;
+    CAmount nFees = 0;
+    unsigned int nSigOps = 0;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+
+        if (!tx.IsCoinBase()) {
+            CAmount txfee = 0;
+            if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee)) {
+                return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+            }
+            nFees += txfee;
+            if (!MoneyRange(nFees)) {
+                return state.DoS(100, error("%s: accumulated fee in the block out of range.", __func__),
+                                 REJECT_INVALID, "bad-txns-accumulated-fee-outofrange");
+            }
+
+            prevheights.resize(tx.vin.size());
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                prevheights[j] = view.AccessCoin(tx.vin[j].prevout).nHeight;
+            }
+            if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
+                return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
+                                 REJECT_INVALID, "bad-txns-nonfinal");
+            }
+        }
+
+        nSigOps += GetTransactionSigOpCount(tx, view, flags);
+        if (nSigOps > MaxBlockSigOps(fDIP0001Active_context)) {
+            return state.DoS(100, error("%s: too many sigops", __func__), REJECT_INVALID, "bad-blk-sigops");
+        }
+
+        if (!tx.IsCoinBase()) {
+            // The scripts are checked on this thread, the script check threads are left to the active chainstate
+            PrecomputedTransactionData txdata(tx);
+            if (!CheckInputs(tx, state, view, true, flags, false, false, txdata)) {
+                return error("%s: CheckInputs on %s failed with %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+            }
+        }
+
+        CTxUndo undoDummy;
+        if (i > 0) {
+            blockundo.vtxundo.push_back(CTxUndo());
+        }
+        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
+    }
+
+    // With the undo data the blocks below the base can be disconnected like any other once they are validated
+    LOCK(cs_main);
+    return WriteUndoDataForBlock(blockundo, state, pindex, chainparams) && WriteTxIndexDataForBlock(block, state, pindex);
+}
+
+/** Check the evo DB loaded from the snapshot against the CbTx of the base block */
+static bool CheckSnapshotBaseCbTx(const CBlock& block, const CBlockIndex* pindexBase)
+{
+    if (block.vtx[0]->nType != TRANSACTION_COINBASE) {
+        return true;
+    }
+    CCbTx cbTx;
+    if (!GetTxPayload(*block.vtx[0], cbTx)) {
+        return false;
     }
+    bool mutated = false;
+    uint256 merkleRootMNList = deterministicMNManager->CalcSMLMerkleRoot(deterministicMNManager->GetListForBlock(pindexBase), &mutated);
+    return !mutated && merkleRootMNList == cbTx.merkleRootMNList;
+}
+
+/** Validate the blocks below the snapshot base as they arrive, returns true once the base was reached and matched */
+static bool ValidateSnapshotBlocks(CCoinsViewDB& coinsdb, CBlockIndex* pindexBase, const SnapshotMetadata& metadata)
+{
+    const CChainParams& chainparams = Params();
+
+    int nHeight = 0;
+    uint256 hashBestBlock = coinsdb.GetBestBlock();
+    if (!hashBestBlock.IsNull()) {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(hashBestBlock);
+        if (!pindex || pindexBase->GetAncestor(pindex->nHeight) != pindex) {
+            return AbortNode(strprintf("%s: the best block %s of the snapshot validation chainstate is not below the snapshot base", __func__, hashBestBlock.ToString()));
+        }
+        nHeight = pindex->nHeight;
+    }
+    nSnapshotValidatedHeight = nHeight;
+    LogPrintf("Snapshot validation: validating blocks %d to %d\n", nHeight + 1, pindexBase->nHeight);
+
+    CCoinsViewCache view(&coinsdb);
+    while (nHeight < pindexBase->nHeight) {
+        if (snapshotValidationInterrupt) {
+            // Blocks validated since the last flush are validated again on the next start
+            return false;
+        }
+
+        CBlockIndex* pindex = pindexBase->GetAncestor(nHeight + 1);
+        CDiskBlockPos pos;
+        {
+            LOCK(cs_main);
+            if (pindex->nStatus & BLOCK_HAVE_DATA) {
+                pos = pindex->GetBlockPos();
+            }
+        }
+        if (pos.IsNull()) {
+            // The block is not downloaded yet, see FindNextSnapshotBlocksToDownload
+            snapshotValidationInterrupt.sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos, chainparams.GetConsensus()) || block.GetHash() != pindex->GetBlockHash()) {
+            return AbortNode(strprintf("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString()));
+        }
+        CValidationState state;
+        if (!ConnectSnapshotValidationBlock(block, pindex, view, chainparams, state)) {
+            if (state.IsInvalid()) {
+                return AbortNode(strprintf("Snapshot validation: block %s (height %d) is invalid: %s", pindex->GetBlockHash().ToString(), pindex->nHeight, FormatStateMessage(state)),
+                                 _("The loaded UTXO snapshot is based on an invalid chain. Delete the data directory except the wallets and start again without -loadsnapshot."));
+            }
+            return AbortNode(strprintf("Snapshot validation: failed to connect block %s: %s", pindex->GetBlockHash().ToString(), FormatStateMessage(state)));
+        }
+        nHeight = pindex->nHeight;
+
+        if (nHeight == pindexBase->nHeight && !CheckSnapshotBaseCbTx(block, pindexBase)) {
+            return AbortNode("Snapshot validation: the evo DB of the snapshot doesn't match the CbTx of its base",
+                             _("The loaded UTXO snapshot is invalid. Delete the data directory except the wallets and start again without -loadsnapshot."));
+        }
+        if (nHeight == pindexBase->nHeight || view.DynamicMemoryUsage() > nCoinCacheUsage / 4) {
+            view.SetBestBlock(pindex->GetBlockHash());
+            if (!view.Flush()) {
+                return AbortNode("Snapshot validation: failed to write the chainstate");
+            }
+        }
+        nSnapshotValidatedHeight = nHeight;
+    }
+
+    CCoinsStats stats;
+    if (!GetUTXOStats(&coinsdb, stats)) {
+        return AbortNode("Snapshot validation: failed to read the chainstate");
+    }
+    if (stats.hashSerialized != metadata.m_utxo_hash) {
+        return AbortNode(strprintf("Snapshot validation: the UTXO set hash %s at the snapshot base doesn't match the snapshot hash %s", stats.hashSerialized.ToString(), metadata.m_utxo_hash.ToString()),
+                         _("The loaded UTXO snapshot is invalid. Delete the data directory except the wallets and start again without -loadsnapshot."));
+    }
+
+    LOCK(cs_main);
+    uint64_t nChainTx = 0;
+    for (CBlockIndex* pindex = pindexBase; pindex; pindex = pindex->pprev) {
+        nChainTx += pindex->nTx;
+        if (pindex->RaiseValidity(BLOCK_VALID_SCRIPTS)) {
+            setDirtyBlockIndex.insert(pindex);
+        }
+    }
+    if (nChainTx != metadata.m_base_chain_tx) {
+        // Only used for statistics and progress estimates, it is calculated from the blocks after a restart
+        LogPrintf("Snapshot validation: the snapshot has %u instead of %u transactions up to its base\n", metadata.m_base_chain_tx, nChainTx);
+    }
+    pindexUTXOSnapshotBase = nullptr;
+    utxoSnapshotMetadata = SnapshotMetadata();
+    if (!pblocktree->EraseUTXOSnapshotMetadata()) {
+        return AbortNode("Snapshot validation: failed to write to the block index database");
+    }
+    FlushStateToDisk();
+    LogPrintf("Snapshot validation: the blocks up to the snapshot base %s (height %d) are valid\n", pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+    return true;
+}
+
+static void ThreadValidateSnapshot()
+{
+    CBlockIndex* pindexBase;
+    SnapshotMetadata metadata;
+    {
+        LOCK(cs_main);
+        pindexBase = pindexUTXOSnapshotBase;
+        metadata = utxoSnapshotMetadata;
+    }
+    if (!pindexBase) {
+        return;
+    }
+
+    try {
+        bool fValidated;
+        {
+            // An interrupted flush leaves the chainstate inconsistent, validation starts over at the first block then
+            bool fWipe = !CCoinsViewDB(SNAPSHOT_VALIDATION_DB_CACHE, false, false, SNAPSHOT_VALIDATION_DB_NAME).GetHeadBlocks().empty();
+            if (fWipe) {
+                LogPrintf("Snapshot validation: the chainstate was not written completely, starting over\n");
+            }
+            CCoinsViewDB coinsdb(SNAPSHOT_VALIDATION_DB_CACHE, false, fWipe, SNAPSHOT_VALIDATION_DB_NAME);
+            fValidated = ValidateSnapshotBlocks(coinsdb, pindexBase, metadata);
+        }
+        if (fValidated) {
+            fs::remove_all(GetDataDir() / SNAPSHOT_VALIDATION_DB_NAME);
+        }
+    } catch (const std::exception& e) {
+        AbortNode(strprintf("Snapshot validation: %s", e.what()));
+    }
+}
+
+void StartSnapshotValidationThread()
+{
+    assert(!snapshotValidationThread.joinable());
+    snapshotValidationInterrupt.reset();
+    snapshotValidationThread = std::thread(&TraceThread<std::function<void()> >, "snapshot", std::function<void()>(&ThreadValidateSnapshot));
+}
+
+void StopSnapshotValidationThread()
+{
+    if (!snapshotValidationThread.joinable()) {
+        return;
+    }
+    snapshotValidationInterrupt();
+    snapshotValidationThread.join();
+}
+
+SnapshotValidationProgress GetSnapshotValidationProgress()
+{
+    SnapshotValidationProgress progress;
+    {
+        LOCK(cs_main);
+        progress.pindexBase = pindexUTXOSnapshotBase;
+    }
+    progress.nValidatedHeight = nSnapshotValidatedHeight;
+    return progress;
 }
 
 /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
@@ -4320,11 +5387,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
-    pindexNew->phashBlock = &((*mi).first);
-
-    return pindexNew;
+    return mapBlockIndex.emplace(hash).first->second;
 }
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
@@ -4334,6 +5397,8 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
 
     boost::this_thread::interruption_point();
 
+    const bool fUTXOSnapshotPending = blocktree.ReadUTXOSnapshotMetadata(utxoSnapshotMetadata);
+
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -4367,6 +5432,20 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
                 pindex->nChainTx = pindex->nTx;
             }
         }
+        if (fUTXOSnapshotPending && pindex->GetBlockHash() == utxoSnapshotMetadata.m_base_blockhash) {
+            // The blocks below the base of a loaded UTXO snapshot may not have been downloaded yet, see LoadUTXOSnapshot
+            if (pindex->nChainTx == 0) {
+                auto range = mapBlocksUnlinked.equal_range(pindex->pprev);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second == pindex) {
+                        mapBlocksUnlinked.erase(it);
+                        break;
+                    }
+                }
+                pindex->nChainTx = utxoSnapshotMetadata.m_base_chain_tx;
+            }
+            pindexUTXOSnapshotBase = pindex;
+        }
         if (!(pindex->nStatus & BLOCK_FAILED_MASK) && pindex->pprev && (pindex->pprev->nStatus & BLOCK_FAILED_MASK)) {
             pindex->nStatus |= BLOCK_FAILED_CHILD;
             setDirtyBlockIndex.insert(pindex);
@@ -4429,6 +5508,20 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     if (fHavePruned)
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
 
+    // An interrupted LoadUTXOSnapshot leaves an incomplete chainstate behind
+    bool fUTXOSnapshotLoading = false;
+    pblocktree->ReadFlag("utxosnapshotloading", fUTXOSnapshotLoading);
+    if (fUTXOSnapshotLoading) {
+        return error("%s: loading a UTXO snapshot was interrupted, the chainstate is incomplete", __func__);
+    }
+    if (!utxoSnapshotMetadata.m_base_blockhash.IsNull()) {
+        if (!pindexUTXOSnapshotBase) {
+            return error("%s: the base %s of the loaded UTXO snapshot is missing", __func__, utxoSnapshotMetadata.m_base_blockhash.ToString());
+        }
+        LogPrintf("%s: the blocks below the UTXO snapshot base %s (height %d) are not validated yet\n", __func__,
+            pindexUTXOSnapshotBase->GetBlockHash().ToString(), pindexUTXOSnapshotBase->nHeight);
+    }
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -4442,9 +5535,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
-    // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
+    // Check whether we have an address balance index
+    pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+    LogPrintf("%s: address balance index %s\n", __func__, fAddressBalanceIndex ? "enabled" : "disabled");
 
     // Check whether we have a spent index
     pblocktree->ReadFlag("spentindex", fSpentIndex);
@@ -4496,7 +5589,39 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100, false);
 }
 
-bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
+/** Number of blocks VerifyDB reads and checks ahead of the block it disconnects, per thread */
+static const int VERIFYDB_PREFETCH_PER_THREAD = 2;
+/** Size of the disconnected blocks VerifyDB keeps for reconnecting them at check level 4, instead of reading them again */
+static const size_t VERIFYDB_MAX_KEPT_BLOCKS_SIZE = 64 * 1024 * 1024;
+
+/**
+ * The checks of VerifyDB which only depend on the block and its undo data (levels 0 to 2). They run on the VerifyDB
+ * threads while the calling thread holds cs_main, so the block position is read by the caller.
+ */
+static std::string VerifyDBCheckBlock(CBlock& block, const CBlockIndex* pindex, const CDiskBlockPos& pos, int nCheckLevel, const Consensus::Params& consensusParams)
+{
+    // check level 0: read from disk
+    CTransactionArenaScope arenaScope;
+    if (!ReadBlockFromDisk(block, pos, consensusParams) || block.GetHash() != pindex->GetBlockHash())
+        return strprintf("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+    // check level 1: verify block validity
+    CValidationState state;
+    if (nCheckLevel >= 1 && !CheckBlock(block, state, consensusParams))
+        return strprintf("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
+                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+    // check level 2: verify undo validity
+    if (nCheckLevel >= 2) {
+        CBlockUndo undo;
+        if (!pindex->GetUndoPos().IsNull()) {
+            if (!UndoReadFromDisk(undo, pindex)) {
+                return strprintf("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+            }
+        }
+    }
+    return "";
+}
+
+bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth, int64_t nCheckTime)
 {
     LOCK(cs_main);
     if (chainActive.Tip() == nullptr || chainActive.Tip()->pprev == nullptr)
@@ -4510,15 +5635,58 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+
+    // The blocks to verify, from the tip down
+    std::vector<std::pair<CBlockIndex*, CDiskBlockPos>> vToVerify;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
+        if (pindex->nHeight <= chainActive.Height()-nCheckDepth)
+            break;
+        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            // If pruning, only go back as far as we have data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+            break;
+        }
+        if (pindexUTXOSnapshotBase && pindex->nHeight <= pindexUTXOSnapshotBase->nHeight) {
+            // There is no undo data for the blocks up to the base of a loaded UTXO snapshot until they were validated
+            LogPrintf("VerifyDB(): block verification stopping at height %d (UTXO snapshot base)\n", pindex->nHeight);
+            break;
+        }
+        vToVerify.emplace_back(pindex, pindex->GetBlockPos());
+    }
+
+    // The blocks are read and checked by a few threads ahead of the disconnects below, which need to be done in order
+    const int nThreads = std::max(1, nScriptCheckThreads);
+    ctpl::thread_pool pool(nThreads);
+    RenameThreadPool(pool, "dash-verifydb");
+    struct CheckedBlock {
+        std::future<std::string> result;
+        std::shared_ptr<CBlock> block;
+    };
+    std::deque<CheckedBlock> queue;
+    size_t nScheduled = 0;
+    auto scheduleChecks = [&]() {
+        while (nScheduled < vToVerify.size() && queue.size() < (size_t)(nThreads * VERIFYDB_PREFETCH_PER_THREAD)) {
+            const auto& toVerify = vToVerify[nScheduled++];
+            auto block = std::make_shared<CBlock>();
+            auto result = pool.push([block, toVerify, nCheckLevel, &chainparams](int) {
+                return VerifyDBCheckBlock(*block, toVerify.first, toVerify.second, nCheckLevel, chainparams.GetConsensus());
+            });
+            queue.push_back(CheckedBlock{std::move(result), std::move(block)});
+        }
+    };
+
+    const int64_t nStart = GetTimeMillis();
     CCoinsViewCache coins(coinsview);
-    CBlockIndex* pindex;
+    CBlockIndex* pindex = chainActive.Tip();
     CBlockIndex* pindexFailure = nullptr;
     int nGoodTransactions = 0;
-    CValidationState state;
     int reportDone = 0;
+    std::map<const CBlockIndex*, std::shared_ptr<CBlock>> mapKeptBlocks;
+    size_t nKeptBlocksSize = 0;
     LogPrintf("[0%%]..."); /* Continued */
-    for (pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
+    for (size_t i = 0; i < vToVerify.size(); i++) {
         boost::this_thread::interruption_point();
+        assert(pindex == vToVerify[i].first);
         int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
         if (reportDone < percentageDone/10) {
             // report every 10% step
@@ -4526,30 +5694,17 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             reportDone = percentageDone/10;
         }
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
-        if (pindex->nHeight <= chainActive.Height()-nCheckDepth)
-            break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+        if (nCheckTime > 0 && i > 0 && GetTimeMillis() - nStart > nCheckTime * 1000) {
+            LogPrintf("VerifyDB(): block verification stopping at height %d (time limit of %ds reached)\n", pindex->nHeight, nCheckTime);
             break;
         }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            if (!pindex->GetUndoPos().IsNull()) {
-                if (!UndoReadFromDisk(undo, pindex)) {
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-                }
-            }
-        }
+        scheduleChecks();
+        CheckedBlock checked = std::move(queue.front());
+        queue.pop_front();
+        const std::string strError = checked.result.get();
+        if (!strError.empty())
+            return error("%s", strError);
+        const CBlock& block = *checked.block;
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         if (nCheckLevel >= 3 && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             assert(coins.GetBestBlock() == pindex->GetBlockHash());
@@ -4563,9 +5718,20 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             } else {
                 nGoodTransactions += block.vtx.size();
             }
+            if (nCheckLevel >= 4) {
+                size_t nBlockSize = 0;
+                for (const auto& tx : block.vtx) {
+                    nBlockSize += tx->GetTotalSize();
+                }
+                if (nKeptBlocksSize + nBlockSize <= VERIFYDB_MAX_KEPT_BLOCKS_SIZE) {
+                    nKeptBlocksSize += nBlockSize;
+                    mapKeptBlocks.emplace(pindex, checked.block);
+                }
+            }
         }
         if (ShutdownRequested())
             return true;
+        pindex = pindex->pprev;
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
@@ -4575,14 +5741,23 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
 
     // check level 4: try reconnecting blocks
     if (nCheckLevel >= 4) {
+        CValidationState state;
         while (pindex != chainActive.Tip()) {
             boost::this_thread::interruption_point();
             uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))), false);
             pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!g_chainstate.ConnectBlock(block, state, pindex, coins, chainparams))
+            std::shared_ptr<CBlock> block;
+            auto it = mapKeptBlocks.find(pindex);
+            if (it != mapKeptBlocks.end()) {
+                block = std::move(it->second);
+                mapKeptBlocks.erase(it);
+            } else {
+                block = std::make_shared<CBlock>();
+                CTransactionArenaScope arenaScope;
+                if (!ReadBlockFromDisk(*block, pindex, chainparams.GetConsensus()))
+                    return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            }
+            if (!g_chainstate.ConnectBlock(*block, state, pindex, coins, chainparams))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
         }
     }
@@ -4593,6 +5768,88 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+ConnectBlockTimings GetConnectBlockTimings()
+{
+    AssertLockHeld(cs_main);
+
+    ConnectBlockTimings timings;
+    timings.nBlocks = nBlocksTotal;
+    timings.nCheck = nTimeCheck;
+    timings.nForks = nTimeForks;
+    timings.nProcessSpecial = nTimeProcessSpecial;
+    timings.nConnect = nTimeConnect;
+    timings.nVerify = nTimeVerify;
+    timings.nISFilter = nTimeISFilter;
+    timings.nSubsidy = nTimeSubsidy;
+    timings.nValueValid = nTimeValueValid;
+    timings.nPayeeValid = nTimePayeeValid;
+    timings.nDashSpecific = nTimeDashSpecific;
+    timings.nIndex = nTimeIndex;
+    timings.nCallbacks = nTimeCallbacks;
+    return timings;
+}
+
+bool ReplayTipBlocks(const CChainParams& chainparams, int nBlocks, int nIterations, std::vector<int64_t>& vIterationTimesRet,
+                     ConnectBlockTimings& timingsRet, std::string& strErrorRet)
+{
+    AssertLockHeld(cs_main);
+
+    // begin tx and let it rollback, like VerifyDB
+    auto dbTx = evoDb->BeginTransaction();
+
+    // The blocks to replay, from the tip down
+    std::vector<std::pair<CBlockIndex*, std::shared_ptr<CBlock>>> vBlocks;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev && (int)vBlocks.size() < nBlocks; pindex = pindex->pprev) {
+        auto block = std::make_shared<CBlock>();
+        CTransactionArenaScope arenaScope;
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA) || !ReadBlockFromDisk(*block, pindex, chainparams.GetConsensus())) {
+            strErrorRet = strprintf("failed to read block %s at height %d", pindex->GetBlockHash().ToString(), pindex->nHeight);
+            return false;
+        }
+        vBlocks.emplace_back(pindex, std::move(block));
+    }
+
+    CCoinsViewCache coins(pcoinsTip.get());
+    const ConnectBlockTimings timingsStart = GetConnectBlockTimings();
+    vIterationTimesRet.clear();
+    for (int i = 0; i < nIterations; i++) {
+        for (const auto& p : vBlocks) {
+            if (g_chainstate.DisconnectBlock(*p.second, p.first, coins) != DISCONNECT_OK) {
+                strErrorRet = strprintf("failed to disconnect block %s at height %d", p.first->GetBlockHash().ToString(), p.first->nHeight);
+                return false;
+            }
+        }
+        int64_t nTimeStart = GetTimeMicros();
+        for (auto it = vBlocks.rbegin(); it != vBlocks.rend(); ++it) {
+            CValidationState state;
+            if (!g_chainstate.ConnectBlock(*it->second, state, it->first, coins, chainparams)) {
+                strErrorRet = strprintf("failed to connect block %s at height %d (%s)", it->first->GetBlockHash().ToString(), it->first->nHeight, FormatStateMessage(state));
+                return false;
+            }
+        }
+        vIterationTimesRet.emplace_back(GetTimeMicros() - nTimeStart);
+        if (ShutdownRequested()) {
+            break;
+        }
+    }
+
+    const ConnectBlockTimings timingsEnd = GetConnectBlockTimings();
+    timingsRet.nBlocks = timingsEnd.nBlocks - timingsStart.nBlocks;
+    timingsRet.nCheck = timingsEnd.nCheck - timingsStart.nCheck;
+    timingsRet.nForks = timingsEnd.nForks - timingsStart.nForks;
+    timingsRet.nProcessSpecial = timingsEnd.nProcessSpecial - timingsStart.nProcessSpecial;
+    timingsRet.nConnect = timingsEnd.nConnect - timingsStart.nConnect;
+    timingsRet.nVerify = timingsEnd.nVerify - timingsStart.nVerify;
+    timingsRet.nISFilter = timingsEnd.nISFilter - timingsStart.nISFilter;
+    timingsRet.nSubsidy = timingsEnd.nSubsidy - timingsStart.nSubsidy;
+    timingsRet.nValueValid = timingsEnd.nValueValid - timingsStart.nValueValid;
+    timingsRet.nPayeeValid = timingsEnd.nPayeeValid - timingsStart.nPayeeValid;
+    timingsRet.nDashSpecific = timingsEnd.nDashSpecific - timingsStart.nDashSpecific;
+    timingsRet.nIndex = timingsEnd.nIndex - timingsStart.nIndex;
+    timingsRet.nCallbacks = timingsEnd.nCallbacks - timingsStart.nCallbacks;
+    return true;
+}
+
 /** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
 bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
 {
@@ -4642,13 +5899,13 @@ bool CChainState::ReplayBlocks(const CChainParams& params, CCoinsView* view)
     if (mapBlockIndex.count(hashHeads[0]) == 0) {
         return error("ReplayBlocks(): reorganization to unknown block requested");
     }
-    pindexNew = mapBlockIndex[hashHeads[0]];
+    pindexNew = LookupBlockIndex(hashHeads[0]);
 
     if (!hashHeads[1].IsNull()) { // The old tip is allowed to be 0, indicating it's the first flush.
         if (mapBlockIndex.count(hashHeads[1]) == 0) {
             return error("ReplayBlocks(): reorganization from unknown block requested");
         }
-        pindexOld = mapBlockIndex[hashHeads[1]];
+        pindexOld = LookupBlockIndex(hashHeads[1]);
         pindexFork = LastCommonAncestor(pindexOld, pindexNew);
         assert(pindexFork != nullptr);
     }
@@ -4718,6 +5975,9 @@ void UnloadBlockIndex()
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    if (g_block_file_maps) {
+        g_block_file_maps->Clear();
+    }
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
     versionbitscache.Clear();
@@ -4725,11 +5985,10 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
     fHavePruned = false;
+    pindexUTXOSnapshotBase = nullptr;
+    utxoSnapshotMetadata = SnapshotMetadata();
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4760,9 +6019,9 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
         pblocktree->WriteFlag("addressindex", fAddressIndex);
 
-        // Use the provided setting for -timestampindex in the new database
-        fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-        pblocktree->WriteFlag("timestampindex", fTimestampIndex);
+        // Use the provided setting for -addressbalanceindex in the new database
+        fAddressBalanceIndex = gArgs.GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX);
+        pblocktree->WriteFlag("addressbalanceindex", fAddressBalanceIndex);
 
         // Use the provided setting for -spentindex in the new database
         fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
@@ -4776,7 +6035,7 @@ bool CChainState::AddGenesisBlock(const CChainParams& chainparams, const CBlock&
     CDiskBlockPos blockPos = SaveBlockToDisk(block, 0, chainparams, nullptr);
     if (blockPos.IsNull())
         return error("%s: writing genesis block to disk failed (%s)", __func__, FormatStateMessage(state));
-    CBlockIndex *pindex = AddToBlockIndex(block);
+    CBlockIndex *pindex = AddToBlockIndex(block, block.GetHash());
     ReceivedBlockTransactions(block, pindex, blockPos);
     return true;
 }
@@ -4863,7 +6122,10 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
                 CBlock& block = *pblock;
-                blkdat >> block;
+                {
+                    CTransactionArenaScope arenaScope;
+                    blkdat >> block;
+                }
                 nRewind = blkdat.GetPos();
 
                 uint256 hash = block.GetHash();
@@ -4913,7 +6175,12 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                     while (range.first != range.second) {
                         std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
                         std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+                        bool fRead;
+                        {
+                            CTransactionArenaScope arenaScope;
+                            fRead = ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus());
+                        }
+                        if (fRead)
                         {
                             LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
                                     head.ToString());
@@ -4950,6 +6217,11 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
 
     LOCK(cs_main);
 
+    // The blocks below the base of a loaded UTXO snapshot are neither linked nor valid until they were validated
+    if (pindexUTXOSnapshotBase) {
+        return;
+    }
+
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
     // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
     // iterating the block tree require that chainActive has been initialized.)
@@ -5164,6 +6436,49 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+//! Number of loaded mempool transactions whose scripts are verified on the script check threads at once
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+
+/**
+ * Verify the scripts of loaded mempool transactions on the script check threads, against the UTXO set or the outputs
+ * of other loaded transactions, so that the signatures are in the signature cache when AcceptToMemoryPool checks the
+ * transactions one by one. Failures are reported by AcceptToMemoryPool, not here.
+ */
+static void PreVerifyMempoolScripts(const std::vector<CTransactionRef>& vtx, const std::unordered_map<uint256, CTransactionRef, StaticSaltedHasher>& mapLoaded)
+{
+    std::vector<PrecomputedTransactionData> vTxData;
+    vTxData.reserve(vtx.size());
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK(cs_main);
+        for (const auto& tx : vtx) {
+            vTxData.emplace_back(*tx);
+            for (unsigned int i = 0; i < tx->vin.size(); i++) {
+                const COutPoint& prevout = tx->vin[i].prevout;
+                CTxOut txout;
+                auto it = mapLoaded.find(prevout.hash);
+                if (it != mapLoaded.end()) {
+                    if (prevout.n >= it->second->vout.size()) continue;
+                    txout = it->second->vout[prevout.n];
+                } else {
+                    const Coin& coin = pcoinsTip->AccessCoin(prevout);
+                    if (coin.IsSpent()) continue;
+                    txout = coin.out;
+                }
+                CScriptCheck check(txout, *tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true /* cacheStore */, &vTxData.back());
+                // An invalid transaction must not make the queue skip the checks of the others
+                vChecks.emplace_back([check]() mutable {
+                    check();
+                    return true;
+                });
+            }
+        }
+    }
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 bool LoadMempool(void)
 {
     const CChainParams& chainparams = Params();
@@ -5181,6 +6496,14 @@ bool LoadMempool(void)
     int64_t already_there = 0;
     int64_t nNow = GetTime();
 
+    struct LoadedTx {
+        CTransactionRef tx;
+        int64_t nTime;
+        int64_t nFeeDelta;
+    };
+    std::vector<LoadedTx> vLoaded;
+    std::map<uint256, CAmount> mapDeltas;
+    std::vector<llmq::CInstantSendLockPtr> vISLocks;
     try {
         uint64_t version;
         file >> version;
@@ -5190,56 +6513,119 @@ bool LoadMempool(void)
         uint64_t num;
         file >> num;
         while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
+            LoadedTx loaded;
+            file >> loaded.tx;
+            file >> loaded.nTime;
+            file >> loaded.nFeeDelta;
+            if (loaded.nTime + nExpiryTimeout > nNow) {
+                vLoaded.emplace_back(std::move(loaded));
+            } else {
+                ++expired;
+            }
+        }
+        file >> mapDeltas;
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    try {
+        // Older versions didn't write the islocks of the transactions, and ignore them
+        uint64_t nISLocks = ReadCompactSize(file);
+        while (nISLocks--) {
+            auto islock = std::make_shared<llmq::CInstantSendLock>();
+            file >> *islock;
+            vISLocks.emplace_back(std::move(islock));
+        }
+    } catch (const std::ios_base::failure&) {
+        vISLocks.clear();
+    }
+
+    std::unordered_map<uint256, CTransactionRef, StaticSaltedHasher> mapLoaded;
+    if (nScriptCheckThreads) {
+        for (const auto& loaded : vLoaded) {
+            mapLoaded.emplace(loaded.tx->GetHash(), loaded.tx);
+        }
+    }
+
+    for (size_t nBatchStart = 0; nBatchStart < vLoaded.size(); nBatchStart += MEMPOOL_LOAD_BATCH_SIZE) {
+        const size_t nBatchEnd = std::min(nBatchStart + MEMPOOL_LOAD_BATCH_SIZE, vLoaded.size());
+        if (nScriptCheckThreads) {
+            std::vector<CTransactionRef> vtx;
+            for (size_t i = nBatchStart; i < nBatchEnd; i++) {
+                vtx.emplace_back(vLoaded[i].tx);
+            }
+            PreVerifyMempoolScripts(vtx, mapLoaded);
+        }
+
+        for (size_t i = nBatchStart; i < nBatchEnd; i++) {
+            const CTransactionRef& tx = vLoaded[i].tx;
+            CAmount amountdelta = vLoaded[i].nFeeDelta;
             if (amountdelta) {
                 mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
+            {
                 LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
+                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, vLoaded[i].nTime,
                                            false /* bypass_limits */, 0 /* nAbsurdFee */);
-                if (state.IsValid()) {
-                    ++count;
+            }
+            if (state.IsValid()) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (mempool.exists(tx->GetHash())) {
+                    ++already_there;
                 } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (mempool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
+                    ++failed;
                 }
-            } else {
-                ++expired;
             }
             if (ShutdownRequested())
                 return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
+    }
 
-        for (const auto& i : mapDeltas) {
-            mempool.PrioritiseTransaction(i.first, i.second);
-        }
-    } catch (const std::exception& e) {
-        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
-        return false;
+    for (const auto& i : mapDeltas) {
+        mempool.PrioritiseTransaction(i.first, i.second);
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    if (llmq::quorumInstantSendManager) {
+        llmq::quorumInstantSendManager->LoadMempoolLocks(vISLocks);
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i islocks\n", count, failed, expired, already_there, vISLocks.size());
     return true;
 }
 
+void DumpBlockIndexSnapshot()
+{
+    LOCK(cs_main);
+    if (!pblocktree || !pblocktree->NeedsBlockIndexSnapshot()) {
+        return;
+    }
+    if (!setDirtyBlockIndex.empty()) {
+        // The snapshot has to match the entries in the db
+        LogPrintf("%s: block index is not flushed, not writing a snapshot\n", __func__);
+        return;
+    }
+
+    // Entries which are only known as the pprev of another entry aren't in the db either
+    const uint256& hashGenesisBlock = Params().GetConsensus().hashGenesisBlock;
+    std::vector<const CBlockIndex*> vIndexes;
+    vIndexes.reserve(mapBlockIndex.size());
+    for (const auto& item : mapBlockIndex) {
+        if (item.second->pprev || item.first == hashGenesisBlock) {
+            vIndexes.push_back(item.second);
+        }
+    }
+    std::sort(vIndexes.begin(), vIndexes.end(), [](const CBlockIndex* a, const CBlockIndex* b) {
+        return a->nHeight < b->nHeight;
+    });
+    pblocktree->WriteBlockIndexSnapshot(vIndexes);
+}
+
 bool DumpMempool(void)
 {
     int64_t start = GetTimeMicros();
@@ -5255,6 +6641,17 @@ bool DumpMempool(void)
         vinfo = mempool.infoAll();
     }
 
+    // Restored with the transactions, so that they are known to be locked right away
+    std::vector<llmq::CInstantSendLockPtr> vISLocks;
+    if (llmq::quorumInstantSendManager) {
+        for (const auto& i : vinfo) {
+            auto islock = llmq::quorumInstantSendManager->GetInstantSendLockByTxid(i.tx->GetHash());
+            if (islock) {
+                vISLocks.emplace_back(islock);
+            }
+        }
+    }
+
     int64_t mid = GetTimeMicros();
 
     try {
@@ -5277,6 +6674,10 @@ bool DumpMempool(void)
         }
 
         file << mapDeltas;
+        WriteCompactSize(file, vISLocks.size());
+        for (const auto& islock : vISLocks) {
+            file << *islock;
+        }
         if (!FileCommit(file.Get()))
             throw std::runtime_error("FileCommit failed");
         file.fclose();
@@ -5315,9 +6716,6 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
@@ -12,6 +12,7 @@
 #endif
 
 #include <amount.h>
+#include <blockindexmap.h>
 #include <coins.h>
 #include <fs.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
@@ -23,6 +24,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -35,6 +37,8 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
+class CBlockView;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
@@ -45,6 +49,7 @@ class CTxMemPool;
 class CValidationState;
 class PrecomputedTransactionData;
 struct ChainTxData;
+struct CSignatureCacheStats;
 
 struct LockPoints;
 
@@ -85,6 +90,8 @@ static const int MAX_SCRIPTCHECK_THREADS = 16;
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Upper bound for the per-peer number of blocks in transit, once a peer proved to deliver blocks fast enough. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE = 128;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -100,6 +107,8 @@ static const int MAX_BLOCKTXN_DEPTH = 10;
  *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
  *  want to make this a per-peer adaptive value at some point. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+/** Upper bound for the block download window, which grows with the number of blocks our peers can have in transit. */
+static const unsigned int MAX_BLOCK_DOWNLOAD_WINDOW = 4 * BLOCK_DOWNLOAD_WINDOW;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
@@ -119,13 +128,24 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -assumechainlocked */
+static const bool DEFAULT_ASSUME_CHAINLOCKED = false;
 static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_ADDRESSBALANCEINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -blockmmapfiles, the number of finalized block/undo files kept memory mapped for reading (0 = disabled) */
+static const unsigned int DEFAULT_BLOCK_MMAP_FILES = 0;
+/** Default for -prefetchcoinsthreads, the number of threads loading the inputs of a block before connecting it (0 = disabled) */
+static const int DEFAULT_PREFETCH_COINS_THREADS = 4;
+/** -prunethrottle default, milliseconds to wait between two background deletions of pruned block files */
+static const int64_t DEFAULT_PRUNE_THROTTLE_MS = 250;
+/** Minimum time (in seconds) between two background compactions of the block index and chainstate after pruning */
+static const int64_t PRUNE_COMPACTION_INTERVAL = 60 * 60;
 /** Default for -syncmempool */
 static const bool DEFAULT_SYNC_MEMPOOL = true;
 
@@ -136,6 +156,8 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
 
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
@@ -150,7 +172,7 @@ extern CCriticalSection cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
 extern std::atomic_bool g_is_mempool_loaded;
-typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+typedef CBlockIndexMap BlockMap;
 typedef std::unordered_multimap<uint256, CBlockIndex*, BlockHasher> PrevBlockMap;
 extern BlockMap& mapBlockIndex;
 extern PrevBlockMap& mapPrevBlockIndex;
@@ -165,13 +187,15 @@ extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fAddressIndex;
-extern bool fTimestampIndex;
+extern bool fAddressBalanceIndex;
 extern bool fSpentIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Skip script checks of IS locked transactions in ChainLocked blocks */
+extern bool fAssumeChainLocked;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
@@ -211,6 +235,7 @@ static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+static const int64_t DEFAULT_CHECKBLOCKSTIME = 0;
 
 // Require that user allocate at least 945MB for block & undo files (blk???.dat and rev???.dat)
 // At 2MB per block, 288 blocks = 576MB.
@@ -258,6 +283,12 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  */
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex = nullptr, CBlockHeader* first_invalid = nullptr) LOCKS_EXCLUDED(cs_main);
 
+/** Same as above, but with the hashes of the headers already computed by the caller (e.g. while checking that
+ *  they form a continuous chain), so that the expensive X11 hashes are not computed again. hashes[i] must be
+ *  headers[i].GetHash().
+ */
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, const std::vector<uint256>& hashes, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex = nullptr, CBlockHeader* first_invalid = nullptr) LOCKS_EXCLUDED(cs_main);
+
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0, bool blocks_dir = false);
 /** Open a block file (blk?????.dat) */
@@ -277,6 +308,10 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Start nThreads threads which load the inputs of blocks from pcoinsdbview into pcoinsTip before connecting them */
+void StartCoinsPrefetchThreads(int nThreads);
+/** Stop the coins prefetch threads */
+void StopCoinsPrefetchThreads();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -309,6 +344,44 @@ void PruneOneBlockFile(const int fileNumber);
  */
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
+/**
+ *  Hand the specified files to the background prune thread, or unlink them right away if it is not running
+ */
+void UnlinkPrunedFilesInBackground(const std::set<int>& setFilesToPrune);
+
+/** Start the thread which deletes pruned block files and compacts the databases afterwards, throttled by nThrottleMs */
+void StartBackgroundPruneThread(int64_t nThrottleMs);
+/** Stop the background prune thread, deleting all files still queued without throttling */
+void StopBackgroundPruneThread();
+
+struct BackgroundPruneProgress {
+    size_t nFilesPending{0};
+    uint64_t nFilesDeleted{0};
+    bool fCompacting{false};
+    int64_t nLastCompactionTime{0};
+};
+BackgroundPruneProgress GetBackgroundPruneProgress();
+
+/**
+ * Load a UTXO snapshot written by dumptxoutset into the empty chainstate of a new datadir. The headers of the snapshot
+ * are processed, the coins and evo DB entries are written and checked against the hashes of the metadata, and the base
+ * of the snapshot becomes the tip. The blocks below the base are then downloaded and validated in the background.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, std::string& strErrorRet) LOCKS_EXCLUDED(cs_main);
+/** Whether a UTXO snapshot was loaded and the blocks below its base are not validated yet */
+bool IsSnapshotValidationPending();
+/** Start the thread which validates the blocks below the base of the loaded UTXO snapshot as they arrive */
+void StartSnapshotValidationThread();
+void StopSnapshotValidationThread();
+
+struct SnapshotValidationProgress {
+    //! The base of the loaded UTXO snapshot, null if no validation is pending
+    const CBlockIndex* pindexBase{nullptr};
+    //! The height up to which the blocks below the base were validated
+    int nValidatedHeight{0};
+};
+SnapshotValidationProgress GetSnapshotValidationProgress();
+
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
@@ -386,14 +459,27 @@ private:
     bool cacheStore;
     ScriptError error;
     PrecomputedTransactionData *txdata;
+    // DASH: when set, this is a special TX payload signature check instead of a script check
+    std::function<bool()> payloadSigCheck;
 
 public:
     CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
     CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
         m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+    explicit CScriptCheck(std::function<bool()> payloadSigCheckIn) :
+        ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), payloadSigCheck(std::move(payloadSigCheckIn)) { }
 
     bool operator()();
 
+    /** Whether this checks the spend of a P2PKH output by a scriptSig of two direct pushes */
+    bool IsP2PKHSpend() const;
+    /**
+     * Verify a P2PKH spend without running the script interpreter, by doing the same checks on the two pushes
+     * which the interpreter would do. Only returns true if VerifyScript() would succeed, a false result is
+     * confirmed by running the script so the script error gets set. Requires IsP2PKHSpend().
+     */
+    bool VerifyP2PKHSignature() const;
+
     void swap(CScriptCheck &check) {
         std::swap(ptxTo, check.ptxTo);
         std::swap(m_tx_out, check.m_tx_out);
@@ -402,25 +488,68 @@ public:
         std::swap(cacheStore, check.cacheStore);
         std::swap(error, check.error);
         std::swap(txdata, check.txdata);
+        std::swap(payloadSigCheck, check.payloadSigCheck);
     }
 
     ScriptError GetScriptError() const { return error; }
 };
 
-bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
+/** Maximum number of P2PKH spends which are verified by one job of CSigBatchCollector */
+static const unsigned int SIG_BATCH_SIZE = 64;
+
+/**
+ * Collects the P2PKH spends of a block and hands them to the script check queue in jobs of SIG_BATCH_SIZE
+ * spends, instead of one job per input. Most inputs of a block (and all CoinJoin inputs) are P2PKH and only
+ * need a single signature check, which makes the per job overhead of the queue noticeable for large blocks.
+ * All other checks are passed through unchanged.
+ */
+class CSigBatchCollector
+{
+private:
+    std::vector<CScriptCheck> vBatch;
+
+    void PushBatch(std::vector<CScriptCheck>& vChecks);
+
+public:
+    /** Moves the P2PKH spends out of vChecks, a job for every completed batch is appended to it */
+    void Add(std::vector<CScriptCheck>& vChecks);
+    /** Append a job for the spends which were collected since the last completed batch to vChecks */
+    void Flush(std::vector<CScriptCheck>& vChecks);
+};
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+/** Look up multiple outputs at once, valuesRet[i] is null if keys[i] is not spent. Returns false if there's no spent index */
+bool GetSpentIndex(const std::vector<CSpentIndexKey>& keys, std::vector<CSpentIndexValue>& valuesRet);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Read the running totals of an address, requires -addressbalanceindex */
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+/** Streaming variants of the above which hand every entry to fn instead of collecting them, see CBlockTreeDB */
+bool GetAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pstart, int start, int end,
+                     const std::function<bool(const CAddressIndexKey&, CAmount)>& fn);
+bool GetAddressUnspent(uint160 addressHash, int type, const CAddressUnspentKey* pstart,
+                       const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
+/** Save the script-execution cache to the data directory, for -persistsigcache */
+bool DumpScriptExecutionCache();
+/** Load the script-execution cache saved by DumpScriptExecutionCache(), must be called before the cache is used */
+bool LoadScriptExecutionCache();
+CSignatureCacheStats GetScriptExecutionCacheStats();
 
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Read the block at pos as serialized on disk, without deserializing it. Used to send blocks to peers. */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+/** Read the block of pindex into a CBlockView, with the checks of ReadBlockFromDisk but without deserializing the transactions */
+bool ReadBlockViewFromDisk(std::unique_ptr<CBlockView>& viewRet, const CBlockIndex* pindex, const CChainParams& chainparams);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -435,12 +564,41 @@ class CVerifyDB {
 public:
     CVerifyDB();
     ~CVerifyDB();
-    bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
+    /** nCheckTime is the number of seconds after which no more blocks are verified (0 = no limit) */
+    bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth, int64_t nCheckTime = 0);
 };
 
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 
+/** Time (in microseconds) spent in the stages of ConnectBlock, summed over all connected blocks (see -debug=bench) */
+struct ConnectBlockTimings {
+    int64_t nBlocks{0};
+    int64_t nCheck{0};
+    int64_t nForks{0};
+    int64_t nProcessSpecial{0};
+    int64_t nConnect{0};
+    int64_t nVerify{0};
+    int64_t nISFilter{0};
+    int64_t nSubsidy{0};
+    int64_t nValueValid{0};
+    int64_t nPayeeValid{0};
+    int64_t nDashSpecific{0};
+    int64_t nIndex{0};
+    int64_t nCallbacks{0};
+};
+
+ConnectBlockTimings GetConnectBlockTimings() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/**
+ * Disconnects the last nBlocks blocks of the active chain into a memory-only coins cache and connects them again,
+ * nIterations times. Nothing is written to the chainstate and the EvoDB changes are rolled back, so this can profile
+ * ConnectBlock (including ProcessSpecialTxsInBlock) on a copy of a real datadir. Returns the time (in microseconds)
+ * of connecting all blocks in every iteration and the ConnectBlock stage timings of all iterations together.
+ */
+bool ReplayTipBlocks(const CChainParams& chainparams, int nBlocks, int nIterations, std::vector<int64_t>& vIterationTimesRet,
+                     ConnectBlockTimings& timingsRet, std::string& strErrorRet) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 inline CBlockIndex* LookupBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -516,6 +674,10 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Write a snapshot of the flushed block index for the next startup, when the current one is missing or has grown
+ *  too much. */
+void DumpBlockIndexSnapshot();
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
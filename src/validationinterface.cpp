@@ -19,12 +19,13 @@
 #include <llmq/quorums_instantsend.h>
 
 #include <list>
+#include <map>
 #include <atomic>
 #include <future>
 
 #include <boost/signals2/signal.hpp>
 
-struct MainSignalsInstance {
+struct ValidationSignals {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> SynchronousUpdatedBlockTip;
     boost::signals2::signal<void (const CTransactionRef &, int64_t)> TransactionAddedToMempool;
@@ -44,12 +45,55 @@ struct MainSignalsInstance {
     boost::signals2::signal<void (const CTransactionRef& currentTx, const CTransactionRef& previousTx)>NotifyInstantSendDoubleSpendAttempt;
     boost::signals2::signal<void (bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff)>NotifyMasternodeListChanged;
     boost::signals2::signal<void (const std::shared_ptr<const llmq::CRecoveredSig>& sig)>NotifyRecoveredSig;
+};
+
+/**
+ * A queue for the background callbacks of the subscribers registered with its name. Only the signals of the
+ * background callbacks are used, the others are always connected to the MainSignalsInstance.
+ */
+struct DedicatedValidationQueue {
+    ValidationSignals m_signals;
+    SingleThreadedSchedulerClient m_schedulerClient;
+
+    DedicatedValidationQueue(CScheduler *pscheduler, const std::string& strName) :
+        m_schedulerClient(pscheduler, CScheduler::Priority::NORMAL, "validationinterface." + strName) {}
+};
+
+struct MainSignalsInstance : public ValidationSignals {
     // We are not allowed to assume the scheduler only runs in one thread,
     // but must ensure all callbacks happen in-order, so we end up creating
     // our own queue here :(
     SingleThreadedSchedulerClient m_schedulerClient;
+    CScheduler *m_pscheduler;
+
+    // Queues are only added, so they can be used without holding m_cs_queues once they were found
+    CCriticalSection m_cs_queues;
+    std::map<std::string, std::unique_ptr<DedicatedValidationQueue>> m_dedicatedQueues GUARDED_BY(m_cs_queues);
+
+    explicit MainSignalsInstance(CScheduler *pscheduler) :
+        m_schedulerClient(pscheduler, CScheduler::Priority::HIGH, "validationinterface"), m_pscheduler(pscheduler) {}
+
+    DedicatedValidationQueue& GetDedicatedQueue(const std::string& strName)
+    {
+        LOCK(m_cs_queues);
+        auto& queue = m_dedicatedQueues[strName];
+        if (!queue) {
+            queue.reset(new DedicatedValidationQueue(m_pscheduler, strName));
+        }
+        return *queue;
+    }
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    /** Queue a background callback, which emits one of the signals of each queue */
+    template <typename Callable>
+    void Enqueue(Callable func)
+    {
+        m_schedulerClient.AddToProcessQueue([this, func] { func(*static_cast<ValidationSignals*>(this)); });
+        LOCK(m_cs_queues);
+        for (const auto& it : m_dedicatedQueues) {
+            DedicatedValidationQueue* queue = it.second.get();
+            queue->m_schedulerClient.AddToProcessQueue([queue, func] { func(queue->m_signals); });
+        }
+    }
 };
 
 static CMainSignals g_signals;
@@ -66,12 +110,32 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
         m_internals->m_schedulerClient.EmptyQueue();
+        LOCK(m_internals->m_cs_queues);
+        for (const auto& it : m_internals->m_dedicatedQueues) {
+            it.second->m_schedulerClient.EmptyQueue();
+        }
     }
 }
 
 size_t CMainSignals::CallbacksPending() {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    size_t nPending = m_internals->m_schedulerClient.CallbacksPending();
+    LOCK(m_internals->m_cs_queues);
+    for (const auto& it : m_internals->m_dedicatedQueues) {
+        nPending += it.second->m_schedulerClient.CallbacksPending();
+    }
+    return nPending;
+}
+
+std::map<std::string, size_t> CMainSignals::GetQueueDepths() {
+    std::map<std::string, size_t> mapDepths;
+    if (!m_internals) return mapDepths;
+    mapDepths.emplace("main", m_internals->m_schedulerClient.CallbacksPending());
+    LOCK(m_internals->m_cs_queues);
+    for (const auto& it : m_internals->m_dedicatedQueues) {
+        mapDepths.emplace(it.first, it.second->m_schedulerClient.CallbacksPending());
+    }
+    return mapDepths;
 }
 
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
@@ -87,25 +151,27 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strQueue) {
+    // The background callbacks are delivered through the queue of the subscriber, the others on the calling thread
+    ValidationSignals& queue = strQueue.empty() ? *g_signals.m_internals : g_signals.m_internals->GetDedicatedQueue(strQueue).m_signals;
     g_signals.m_internals->AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
     g_signals.m_internals->NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+    queue.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->SynchronousUpdatedBlockTip.connect(boost::bind(&CValidationInterface::SynchronousUpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1, _2));
-    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyChainLock.connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1, _2));
-    g_signals.m_internals->TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
-    g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+    queue.TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1, _2));
+    queue.BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
+    queue.BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
+    queue.NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1, _2));
+    queue.NotifyChainLock.connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1, _2));
+    queue.TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+    queue.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.m_internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
     g_signals.m_internals->BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.m_internals->NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
-    g_signals.m_internals->NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
-    g_signals.m_internals->NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyRecoveredSig.connect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
+    queue.NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
+    queue.NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
+    queue.NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
+    queue.NotifyRecoveredSig.connect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
     g_signals.m_internals->NotifyMasternodeListChanged.connect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
 }
 
@@ -129,6 +195,21 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->NotifyInstantSendDoubleSpendAttempt.disconnect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
     g_signals.m_internals->NotifyRecoveredSig.disconnect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
     g_signals.m_internals->NotifyMasternodeListChanged.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+    LOCK(g_signals.m_internals->m_cs_queues);
+    for (const auto& it : g_signals.m_internals->m_dedicatedQueues) {
+        it.second->m_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
+        it.second->m_signals.NotifyChainLock.disconnect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1, _2));
+        it.second->m_signals.NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1, _2));
+        it.second->m_signals.TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1, _2));
+        it.second->m_signals.BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
+        it.second->m_signals.BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
+        it.second->m_signals.TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
+        it.second->m_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
+        it.second->m_signals.NotifyGovernanceObject.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
+        it.second->m_signals.NotifyGovernanceVote.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
+        it.second->m_signals.NotifyInstantSendDoubleSpendAttempt.disconnect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
+        it.second->m_signals.NotifyRecoveredSig.disconnect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
+    }
 }
 
 void UnregisterAllValidationInterfaces() {
@@ -154,10 +235,42 @@ void UnregisterAllValidationInterfaces() {
     g_signals.m_internals->NotifyInstantSendDoubleSpendAttempt.disconnect_all_slots();
     g_signals.m_internals->NotifyRecoveredSig.disconnect_all_slots();
     g_signals.m_internals->NotifyMasternodeListChanged.disconnect_all_slots();
+    LOCK(g_signals.m_internals->m_cs_queues);
+    for (const auto& it : g_signals.m_internals->m_dedicatedQueues) {
+        it.second->m_signals.SetBestChain.disconnect_all_slots();
+        it.second->m_signals.NotifyTransactionLock.disconnect_all_slots();
+        it.second->m_signals.NotifyChainLock.disconnect_all_slots();
+        it.second->m_signals.TransactionAddedToMempool.disconnect_all_slots();
+        it.second->m_signals.BlockConnected.disconnect_all_slots();
+        it.second->m_signals.BlockDisconnected.disconnect_all_slots();
+        it.second->m_signals.TransactionRemovedFromMempool.disconnect_all_slots();
+        it.second->m_signals.UpdatedBlockTip.disconnect_all_slots();
+        it.second->m_signals.NotifyGovernanceObject.disconnect_all_slots();
+        it.second->m_signals.NotifyGovernanceVote.disconnect_all_slots();
+        it.second->m_signals.NotifyInstantSendDoubleSpendAttempt.disconnect_all_slots();
+        it.second->m_signals.NotifyRecoveredSig.disconnect_all_slots();
+    }
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_cs_queues);
+    if (internals.m_dedicatedQueues.empty()) {
+        internals.m_schedulerClient.AddToProcessQueue(std::move(func));
+        return;
+    }
+    // func is called by the last queue to get there, when all of them processed the earlier callbacks
+    auto remaining = std::make_shared<std::atomic<size_t>>(internals.m_dedicatedQueues.size() + 1);
+    auto sharedFunc = std::make_shared<std::function<void ()>>(std::move(func));
+    auto countDown = [remaining, sharedFunc] {
+        if (--*remaining == 0) {
+            (*sharedFunc)();
+        }
+    };
+    internals.m_schedulerClient.AddToProcessQueue(countDown);
+    for (const auto& it : internals.m_dedicatedQueues) {
+        it.second->m_schedulerClient.AddToProcessQueue(countDown);
+    }
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -183,8 +296,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    m_internals->Enqueue([pindexNew, pindexFork, fInitialDownload](ValidationSignals& signals) {
+        signals.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     });
 }
 
@@ -193,26 +306,26 @@ void CMainSignals::SynchronousUpdatedBlockTip(const CBlockIndex *pindexNew, cons
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx, int64_t nAcceptTime) {
-    m_internals->m_schedulerClient.AddToProcessQueue([ptx, nAcceptTime, this] {
-        m_internals->TransactionAddedToMempool(ptx, nAcceptTime);
+    m_internals->Enqueue([ptx, nAcceptTime](ValidationSignals& signals) {
+        signals.TransactionAddedToMempool(ptx, nAcceptTime);
     });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
-        m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
+    m_internals->Enqueue([pblock, pindex, pvtxConflicted](ValidationSignals& signals) {
+        signals.BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex* pindexDisconnected) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindexDisconnected, this] {
-        m_internals->BlockDisconnected(pblock, pindexDisconnected);
+    m_internals->Enqueue([pblock, pindexDisconnected](ValidationSignals& signals) {
+        signals.BlockDisconnected(pblock, pindexDisconnected);
     });
 }
 
 void CMainSignals::SetBestChain(const CBlockLocator &locator) {
-    m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
-        m_internals->SetBestChain(locator);
+    m_internals->Enqueue([locator](ValidationSignals& signals) {
+        signals.SetBestChain(locator);
     });
 }
 
@@ -237,38 +350,38 @@ void CMainSignals::NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDo
 }
 
 void CMainSignals::NotifyTransactionLock(const CTransactionRef &tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock) {
-    m_internals->m_schedulerClient.AddToProcessQueue([tx, islock, this] {
-        m_internals->NotifyTransactionLock(tx, islock);
+    m_internals->Enqueue([tx, islock](ValidationSignals& signals) {
+        signals.NotifyTransactionLock(tx, islock);
     });
 }
 
 void CMainSignals::NotifyChainLock(const CBlockIndex* pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pindex, clsig, this] {
-        m_internals->NotifyChainLock(pindex, clsig);
+    m_internals->Enqueue([pindex, clsig](ValidationSignals& signals) {
+        signals.NotifyChainLock(pindex, clsig);
     });
 }
 
 void CMainSignals::NotifyGovernanceVote(const std::shared_ptr<const CGovernanceVote>& vote) {
-    m_internals->m_schedulerClient.AddToProcessQueue([vote, this] {
-        m_internals->NotifyGovernanceVote(vote);
+    m_internals->Enqueue([vote](ValidationSignals& signals) {
+        signals.NotifyGovernanceVote(vote);
     });
 }
 
 void CMainSignals::NotifyGovernanceObject(const std::shared_ptr<const CGovernanceObject>& object) {
-    m_internals->m_schedulerClient.AddToProcessQueue([object, this] {
-        m_internals->NotifyGovernanceObject(object);
+    m_internals->Enqueue([object](ValidationSignals& signals) {
+        signals.NotifyGovernanceObject(object);
     });
 }
 
 void CMainSignals::NotifyInstantSendDoubleSpendAttempt(const CTransactionRef& currentTx, const CTransactionRef& previousTx) {
-    m_internals->m_schedulerClient.AddToProcessQueue([currentTx, previousTx, this] {
-        m_internals->NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx);
+    m_internals->Enqueue([currentTx, previousTx](ValidationSignals& signals) {
+        signals.NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx);
     });
 }
 
 void CMainSignals::NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig) {
-    m_internals->m_schedulerClient.AddToProcessQueue([sig, this] {
-        m_internals->NotifyRecoveredSig(sig);
+    m_internals->Enqueue([sig](ValidationSignals& signals) {
+        signals.NotifyRecoveredSig(sig);
     });
 }
 
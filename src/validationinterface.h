@@ -9,7 +9,9 @@
 #include <primitives/transaction.h> // CTransaction(Ref)
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <string>
 
 class CBlock;
 class CBlockIndex;
@@ -35,8 +37,18 @@ namespace llmq {
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/** Names of the dedicated queues of the subscribers which may be slow to handle callbacks */
+static const char* const VALIDATION_QUEUE_WALLET = "wallet";
+static const char* const VALIDATION_QUEUE_ZMQ = "zmq";
+static const char* const VALIDATION_QUEUE_INDEX = "index";
+/** Number of dedicated queues used by the node, each of them gets a scheduler thread */
+static const int VALIDATION_DEDICATED_QUEUES = 3;
+
+/**
+ * Register a wallet to receive updates from core. The background callbacks are delivered through the dedicated queue
+ * named by strQueue (shared with the other subscribers registered with the same name), or through the main queue.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strQueue = "");
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -75,7 +87,8 @@ void SyncWithValidationInterfaceQueue();
  * UpdatedBlockTip() callback may depend on an operation performed in
  * the BlockConnected() callback without worrying about explicit
  * synchronization. No ordering should be assumed across
- * ValidationInterface() subscribers.
+ * ValidationInterface() subscribers, in particular not across the
+ * subscribers registered on different queues.
  */
 class CValidationInterface {
 protected:
@@ -152,7 +165,7 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -162,7 +175,7 @@ class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
@@ -177,7 +190,10 @@ public:
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** Total number of background callbacks waiting in all queues */
     size_t CallbacksPending();
+    /** Number of background callbacks waiting in each queue, by name ("main" for the main queue) */
+    std::map<std::string, size_t> GetQueueDepths();
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
     void RegisterWithMempoolSignals(CTxMemPool& pool);
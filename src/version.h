@@ -11,7 +11,7 @@
  */
 
 
-static const int PROTOCOL_VERSION = 70219;
+static const int PROTOCOL_VERSION = 70222;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -48,4 +48,13 @@ static const int MNAUTH_NODE_VER_VERSION = 70218;
 //! introduction of QGETDATA/QDATA messages
 static const int LLMQ_DATA_MESSAGES_VERSION = 70219;
 
+//! introduction of GOVSKETCH
+static const int GOVERNANCE_VOTE_SKETCH_VERSION = 70220;
+
+//! introduction of GETMNLISTSNAP/MNLISTSNAP messages
+static const int MNLIST_SNAPSHOT_VERSION = 70221;
+
+//! introduction of SENDSHORTINV/SHORTINV/GETSHORTDATA messages
+static const int SHORT_INV_PROTO_VERSION = 70222;
+
 #endif // BITCOIN_VERSION_H
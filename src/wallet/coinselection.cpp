@@ -39,14 +39,13 @@ struct {
  * the unexplored UTXOs. A subtree is not explored if the lookahead indicates that the target range
  * cannot be reached. Further, it is unnecessary to test equivalent combinations. This allows us
  * to skip testing the inclusion of UTXOs that match the effective value and waste of an omitted
- * predecessor.
+ * predecessor. UTXOs which exceed the target range on their own are not explored at all.
  *
  * The Branch and Bound algorithm is described in detail in Murch's Master Thesis:
  * https://murch.one/wp-content/uploads/2016/11/erhardt2016coinselection.pdf
  *
- * @param const std::vector<CInputCoin>& utxo_pool The set of UTXOs that we are choosing from.
- *        These UTXOs will be sorted in descending order by effective value and the CInputCoins'
- *        values are their effective values.
+ * @param const CoinSelectionIndex& index The set of UTXOs that we are choosing from, sorted in descending
+ *        order by effective value. The CInputCoins' values are their effective values.
  * @param const CAmount& target_value This is the value that we want to select. It is the lower
  *        bound of the range.
  * @param const CAmount& cost_of_change This is the cost of creating and spending a change output.
@@ -61,40 +60,55 @@ struct {
 
 static const size_t TOTAL_TRIES = 100000;
 
-bool SelectCoinsBnB(std::vector<CInputCoin>& utxo_pool, const CAmount& target_value, const CAmount& cost_of_change, std::set<CInputCoin>& out_set, CAmount& value_ret, CAmount not_input_fees)
+CoinSelectionIndex::CoinSelectionIndex(std::vector<CInputCoin> coins) : m_coins(std::move(coins))
 {
-    out_set.clear();
-    CAmount curr_value = 0;
-
-    std::vector<bool> curr_selection; // select the utxo at this index
-    curr_selection.reserve(utxo_pool.size());
-    CAmount actual_target = not_input_fees + target_value;
-
-    // Calculate curr_available_value
-    CAmount curr_available_value = 0;
-    for (const CInputCoin& utxo : utxo_pool) {
+    std::sort(m_coins.begin(), m_coins.end(), descending);
+    m_prefix_sums.reserve(m_coins.size() + 1);
+    m_prefix_sums.push_back(0);
+    for (const CInputCoin& coin : m_coins) {
         // Assert that this utxo is not negative. It should never be negative, effective value calculation should have removed it
-        assert(utxo.effective_value > 0);
-        curr_available_value += utxo.effective_value;
+        assert(coin.effective_value > 0);
+        m_prefix_sums.push_back(m_prefix_sums.back() + coin.effective_value);
     }
-    if (curr_available_value < actual_target) {
+}
+
+size_t CoinSelectionIndex::FindFirstAtMost(CAmount value) const
+{
+    auto it = std::partition_point(m_coins.begin(), m_coins.end(), [value](const CInputCoin& coin) { return coin.effective_value > value; });
+    return it - m_coins.begin();
+}
+
+bool SelectCoinsBnB(const CoinSelectionIndex& index, const CAmount& target_value, const CAmount& cost_of_change, std::set<CInputCoin>& out_set, CAmount& value_ret, CAmount not_input_fees)
+{
+    out_set.clear();
+    CAmount actual_target = not_input_fees + target_value;
+    if (index.empty() || index.GetTotalValue() < actual_target) {
         return false;
     }
 
-    // Sort the utxo_pool
-    std::sort(utxo_pool.begin(), utxo_pool.end(), descending);
+    // Coins which exceed the target range on their own can never be part of a solution, the search starts below them
+    const size_t first_pos = index.FindFirstAtMost(actual_target + cost_of_change);
+    const bool waste_increases = index[0].fee - index[0].long_term_fee > 0;
 
+    // The search position is the index of the next utxo to include or omit, the ones before it which are
+    // included are listed in curr_selection. curr_available_value is the lookahead.
+    size_t pos = first_pos;
+    CAmount curr_value = 0;
     CAmount curr_waste = 0;
-    std::vector<bool> best_selection;
+    std::vector<size_t> curr_selection;
+    std::vector<size_t> best_selection;
+    bool found = false;
     CAmount best_waste = MAX_MONEY;
 
     // Depth First search loop for choosing the UTXOs
     for (size_t i = 0; i < TOTAL_TRIES; ++i) {
+        CAmount curr_available_value = index.GetValue(pos, index.size());
+
         // Conditions for starting a backtrack
         bool backtrack = false;
         if (curr_value + curr_available_value < actual_target ||                // Cannot possibly reach target with the amount remaining in the curr_available_value.
             curr_value > actual_target + cost_of_change ||    // Selected value is out of range, go back and try other branch
-            (curr_waste > best_waste && (utxo_pool.at(0).fee - utxo_pool.at(0).long_term_fee) > 0)) { // Don't select things which we know will be more wasteful if the waste is increasing
+            (curr_waste > best_waste && waste_increases)) { // Don't select things which we know will be more wasteful if the waste is increasing
             backtrack = true;
         } else if (curr_value >= actual_target) {       // Selected value is within range
             curr_waste += (curr_value - actual_target); // This is the excess value which is added to the waste for the below comparison
@@ -104,8 +118,8 @@ bool SelectCoinsBnB(std::vector<CInputCoin>& utxo_pool, const CAmount& target_va
             // explore any more UTXOs to avoid burning money like that.
             if (curr_waste <= best_waste) {
                 best_selection = curr_selection;
-                best_selection.resize(utxo_pool.size());
                 best_waste = curr_waste;
+                found = true;
             }
             curr_waste -= (curr_value - actual_target); // Remove the excess value as we will be selecting different coins now
             backtrack = true;
@@ -113,59 +127,57 @@ bool SelectCoinsBnB(std::vector<CInputCoin>& utxo_pool, const CAmount& target_va
 
         // Backtracking, moving backwards
         if (backtrack) {
-            // Walk backwards to find the last included UTXO that still needs to have its omission branch traversed.
-            while (!curr_selection.empty() && !curr_selection.back()) {
-                curr_selection.pop_back();
-                curr_available_value += utxo_pool.at(curr_selection.size()).effective_value;
-            }
-
+            // The omission branches of the UTXOs after the last included one have all been traversed
             if (curr_selection.empty()) { // We have walked back to the first utxo and no branch is untraversed. All solutions searched
                 break;
             }
 
             // Output was included on previous iterations, try excluding now.
-            curr_selection.back() = false;
-            CInputCoin& utxo = utxo_pool.at(curr_selection.size() - 1);
+            const size_t last_pos = curr_selection.back();
+            curr_selection.pop_back();
+            const CInputCoin& utxo = index[last_pos];
             curr_value -= utxo.effective_value;
             curr_waste -= utxo.fee - utxo.long_term_fee;
+            pos = last_pos + 1;
         } else { // Moving forwards, continuing down this branch
-            CInputCoin& utxo = utxo_pool.at(curr_selection.size());
-
-            // Remove this utxo from the curr_available_value utxo amount
-            curr_available_value -= utxo.effective_value;
+            const CInputCoin& utxo = index[pos];
 
             // Avoid searching a branch if the previous UTXO has the same value and same waste and was excluded. Since the ratio of fee to
             // long term fee is the same, we only need to check if one of those values match in order to know that the waste is the same.
-            if (!curr_selection.empty() && !curr_selection.back() &&
-                utxo.effective_value == utxo_pool.at(curr_selection.size() - 1).effective_value &&
-                utxo.fee == utxo_pool.at(curr_selection.size() - 1).fee) {
-                curr_selection.push_back(false);
+            if (pos > first_pos && (curr_selection.empty() || curr_selection.back() != pos - 1) &&
+                utxo.effective_value == index[pos - 1].effective_value &&
+                utxo.fee == index[pos - 1].fee) {
+                // omit it
             } else {
                 // Inclusion branch first (Largest First Exploration)
-                curr_selection.push_back(true);
+                curr_selection.push_back(pos);
                 curr_value += utxo.effective_value;
                 curr_waste += utxo.fee - utxo.long_term_fee;
             }
+            ++pos;
         }
     }
 
     // Check for solution
-    if (best_selection.empty()) {
+    if (!found) {
         return false;
     }
 
     // Set output set
     value_ret = 0;
-    for (size_t i = 0; i < best_selection.size(); ++i) {
-        if (best_selection.at(i)) {
-            out_set.insert(utxo_pool.at(i));
-            value_ret += utxo_pool.at(i).txout.nValue;
-        }
+    for (size_t pos_selected : best_selection) {
+        out_set.insert(index[pos_selected]);
+        value_ret += index[pos_selected].txout.nValue;
     }
 
     return true;
 }
 
+bool SelectCoinsBnB(std::vector<CInputCoin>& utxo_pool, const CAmount& target_value, const CAmount& cost_of_change, std::set<CInputCoin>& out_set, CAmount& value_ret, CAmount not_input_fees)
+{
+    return SelectCoinsBnB(CoinSelectionIndex(utxo_pool), target_value, cost_of_change, out_set, value_ret, not_input_fees);
+}
+
 static void ApproximateBestSubset(const std::vector<CInputCoin>& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   std::vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
 {
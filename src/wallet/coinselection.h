@@ -49,6 +49,34 @@ public:
     int Priority() const;
 };
 
+/**
+ * A UTXO pool sorted by descending effective value, together with the prefix sums of the effective values.
+ * Building it costs one sort of the pool, it can then be searched any number of times without copying or
+ * re-sorting the coins.
+ */
+class CoinSelectionIndex
+{
+public:
+    explicit CoinSelectionIndex(std::vector<CInputCoin> coins);
+
+    size_t size() const { return m_coins.size(); }
+    bool empty() const { return m_coins.empty(); }
+    const CInputCoin& operator[](size_t pos) const { return m_coins[pos]; }
+
+    //! Total effective value of the coins at positions [begin, end)
+    CAmount GetValue(size_t begin, size_t end) const { return m_prefix_sums[end] - m_prefix_sums[begin]; }
+    CAmount GetTotalValue() const { return m_prefix_sums.back(); }
+
+    //! Position of the largest coin with an effective value of at most value, size() if there is none
+    size_t FindFirstAtMost(CAmount value) const;
+
+private:
+    std::vector<CInputCoin> m_coins;
+    //! m_prefix_sums[i] is the total effective value of the i largest coins
+    std::vector<CAmount> m_prefix_sums;
+};
+
+bool SelectCoinsBnB(const CoinSelectionIndex& index, const CAmount& target_value, const CAmount& cost_of_change, std::set<CInputCoin>& out_set, CAmount& value_ret, CAmount not_input_fees);
 bool SelectCoinsBnB(std::vector<CInputCoin>& utxo_pool, const CAmount& target_value, const CAmount& cost_of_change, std::set<CInputCoin>& out_set, CAmount& value_ret, CAmount not_input_fees);
 
 // Original coin selection algorithm as a fallback
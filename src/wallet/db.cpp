@@ -459,7 +459,8 @@ void BerkeleyEnvironment::CheckpointLSN(const std::string& strFile)
 }
 
 
-BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode, bool fFlushOnCloseIn) : pdb(nullptr), activeTxn(nullptr)
+BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode, bool fFlushOnCloseIn) :
+    pdb(nullptr), activeTxn(nullptr), m_cursor(nullptr), m_cursor_seek(false), m_cursor_seek_key(SER_DISK, CLIENT_VERSION)
 {
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
     fFlushOnClose = fFlushOnCloseIn;
@@ -551,15 +552,154 @@ void BerkeleyBatch::Flush()
     env->dbenv->txn_checkpoint(nMinutes ? gArgs.GetArg("-dblogsize", DEFAULT_WALLET_DBLOGSIZE) * 1024 : 0, nMinutes, 0);
 }
 
-void BerkeleyDatabase::IncrementUpdateCounter()
+void WalletDatabase::IncrementUpdateCounter()
 {
     ++nUpdateCounter;
 }
 
+bool WalletDatabase::GroupSync(int64_t nMaxDelayMs)
+{
+    const uint64_t nTicket = ++m_group_tickets;
+    WaitableLock lock(cs_group_sync);
+    while (m_group_synced < nTicket) {
+        if (m_group_syncing) {
+            // We are covered by the running sync or the next one
+            m_group_sync_cv.wait(lock);
+            continue;
+        }
+
+        m_group_syncing = true;
+        if (nMaxDelayMs > 0) {
+            // Give concurrent writers the chance to join this sync
+            m_group_sync_cv.wait_for(lock, std::chrono::milliseconds(nMaxDelayMs));
+        }
+        const uint64_t nSyncTicket = m_group_tickets;
+        lock.unlock();
+        const bool fSynced = SyncWrites();
+        lock.lock();
+        m_group_syncing = false;
+        if (fSynced) {
+            m_group_synced = std::max(m_group_synced, nSyncTicket);
+        }
+        m_group_sync_cv.notify_all();
+        if (!fSynced) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BerkeleyBatch::ReadKey(CDataStream&& ssKey, CDataStream& ssValue)
+{
+    if (!pdb)
+        return false;
+
+    Dbt datKey(ssKey.data(), ssKey.size());
+
+    // Read
+    Dbt datValue;
+    datValue.set_flags(DB_DBT_MALLOC);
+    int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
+    bool success = false;
+    if (datValue.get_data() != nullptr) {
+        ssValue.SetType(SER_DISK);
+        ssValue.clear();
+        ssValue.write((char*)datValue.get_data(), datValue.get_size());
+        success = true;
+
+        // Clear and free memory
+        memory_cleanse(datValue.get_data(), datValue.get_size());
+        free(datValue.get_data());
+    }
+    return ret == 0 && success;
+}
+
+bool BerkeleyBatch::WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite)
+{
+    if (!pdb)
+        return true;
+    if (fReadOnly)
+        assert(!"Write called on database in read-only mode");
+
+    Dbt datKey(ssKey.data(), ssKey.size());
+    Dbt datValue(ssValue.data(), ssValue.size());
+
+    // Write
+    int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+    return (ret == 0);
+}
+
+bool BerkeleyBatch::EraseKey(CDataStream&& ssKey)
+{
+    if (!pdb)
+        return false;
+    if (fReadOnly)
+        assert(!"Erase called on database in read-only mode");
+
+    Dbt datKey(ssKey.data(), ssKey.size());
+
+    // Erase
+    int ret = pdb->del(activeTxn, &datKey, 0);
+    return (ret == 0 || ret == DB_NOTFOUND);
+}
+
+bool BerkeleyBatch::HasKey(CDataStream&& ssKey)
+{
+    if (!pdb)
+        return false;
+
+    Dbt datKey(ssKey.data(), ssKey.size());
+
+    // Exists
+    int ret = pdb->exists(activeTxn, &datKey, 0);
+    return (ret == 0);
+}
+
+bool BerkeleyBatch::StartCursor()
+{
+    assert(!m_cursor);
+    m_cursor = GetCursor();
+    m_cursor_seek = false;
+    return m_cursor != nullptr;
+}
+
+bool BerkeleyBatch::SeekCursor(const CDataStream& ssKey)
+{
+    if (!StartCursor())
+        return false;
+    m_cursor_seek = true;
+    m_cursor_seek_key = ssKey;
+    return true;
+}
+
+bool BerkeleyBatch::ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete)
+{
+    fComplete = false;
+    if (!m_cursor)
+        return false;
+    if (m_cursor_seek)
+        ssKey = m_cursor_seek_key;
+    int ret = ReadAtCursor(m_cursor, ssKey, ssValue, m_cursor_seek);
+    m_cursor_seek = false;
+    if (ret == DB_NOTFOUND) {
+        fComplete = true;
+    }
+    return ret == 0 || ret == DB_NOTFOUND;
+}
+
+void BerkeleyBatch::CloseCursor()
+{
+    if (!m_cursor)
+        return;
+    m_cursor->close();
+    m_cursor = nullptr;
+}
+
 void BerkeleyBatch::Close()
 {
     if (!pdb)
         return;
+    CloseCursor();
     if (activeTxn)
         activeTxn->abort();
     activeTxn = nullptr;
@@ -789,6 +929,25 @@ bool BerkeleyBatch::PeriodicFlush(BerkeleyDatabase& database)
     return ret;
 }
 
+std::unique_ptr<DatabaseBatch> BerkeleyDatabase::MakeBatch(const char* pszMode, bool fFlushOnClose)
+{
+    return MakeUnique<BerkeleyBatch>(*this, pszMode, fFlushOnClose);
+}
+
+bool BerkeleyDatabase::PeriodicFlush()
+{
+    return BerkeleyBatch::PeriodicFlush(*this);
+}
+
+bool BerkeleyDatabase::SyncWrites()
+{
+    if (IsDummy()) {
+        return true;
+    }
+    // Transactions are committed with DB_TXN_WRITE_NOSYNC, flushing the log makes them durable
+    return env->dbenv->log_flush(nullptr) == 0;
+}
+
 bool BerkeleyDatabase::Rewrite(const char* pszSkip)
 {
     return BerkeleyBatch::Rewrite(*this, pszSkip);
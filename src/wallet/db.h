@@ -31,6 +31,173 @@ struct WalletDatabaseFileId {
     bool operator==(const WalletDatabaseFileId& rhs) const;
 };
 
+class DatabaseBatch;
+
+/** An instance of this class represents one wallet database, independent of the backend it is stored in.
+ * The BerkeleyDB backend is the default one, see wallet/db_leveldb.h for the LevelDB one.
+ **/
+class WalletDatabase
+{
+public:
+    WalletDatabase() : nUpdateCounter(0), nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0) {}
+    virtual ~WalletDatabase() {}
+
+    WalletDatabase(const WalletDatabase&) = delete;
+    WalletDatabase& operator=(const WalletDatabase&) = delete;
+
+    /** Return object for accessing database at specified path, in the backend the wallet is stored in
+     * or, for new wallets, the one selected by -walletdbbackend. */
+    static std::unique_ptr<WalletDatabase> Create(const fs::path& path);
+
+    /** Return object for accessing dummy database with no read/write capabilities. */
+    static std::unique_ptr<WalletDatabase> CreateDummy();
+
+    /** Return object for accessing temporary in-memory database. */
+    static std::unique_ptr<WalletDatabase> CreateMock();
+
+    /** Make a batch to read from and write to the database. */
+    virtual std::unique_ptr<DatabaseBatch> MakeBatch(const char* pszMode = "r+", bool fFlushOnClose = true) = 0;
+
+    /** Rewrite the entire database on disk, with the exception of key pszSkip if non-zero
+     */
+    virtual bool Rewrite(const char* pszSkip = nullptr) = 0;
+
+    /** Back up the entire database to a file.
+     */
+    virtual bool Backup(const std::string& strDest) = 0;
+
+    /** Make sure all changes are flushed to disk.
+     */
+    virtual void Flush(bool shutdown) = 0;
+
+    /* flush the wallet passively, ideal to be called periodically.
+       Returns false if the database could not be flushed right now */
+    virtual bool PeriodicFlush() = 0;
+
+    virtual void ReloadDbEnv() = 0;
+
+    /** Make the writes of all committed transactions durable, without closing anything. */
+    virtual bool SyncWrites() = 0;
+
+    /**
+     * Wait until everything the caller committed is durable (group commit). The first waiting caller
+     * leads a group: it waits up to nMaxDelayMs for concurrent writers to join, then one sync covers
+     * all of them.
+     */
+    bool GroupSync(int64_t nMaxDelayMs);
+
+    void IncrementUpdateCounter();
+
+    std::atomic<unsigned int> nUpdateCounter;
+    unsigned int nLastSeen;
+    unsigned int nLastFlushed;
+    int64_t nLastWalletUpdate;
+
+private:
+    //! GroupSync callers get increasing tickets, a sync started after a ticket was taken covers it
+    std::atomic<uint64_t> m_group_tickets{0};
+    CWaitableCriticalSection cs_group_sync;
+    CConditionVariable m_group_sync_cv;
+    uint64_t m_group_synced GUARDED_BY(cs_group_sync){0};
+    bool m_group_syncing GUARDED_BY(cs_group_sync){false};
+};
+
+/** RAII class that provides access to a wallet database, independent of its backend */
+class DatabaseBatch
+{
+private:
+    virtual bool ReadKey(CDataStream&& ssKey, CDataStream& ssValue) = 0;
+    virtual bool WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite = true) = 0;
+    virtual bool EraseKey(CDataStream&& ssKey) = 0;
+    virtual bool HasKey(CDataStream&& ssKey) = 0;
+
+public:
+    DatabaseBatch() {}
+    virtual ~DatabaseBatch() {}
+
+    DatabaseBatch(const DatabaseBatch&) = delete;
+    DatabaseBatch& operator=(const DatabaseBatch&) = delete;
+
+    virtual void Flush() = 0;
+    virtual void Close() = 0;
+
+    template <typename K, typename T>
+    bool Read(const K& key, T& value)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(1000);
+        ssKey << key;
+
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        if (!ReadKey(std::move(ssKey), ssValue)) {
+            return false;
+        }
+        try {
+            ssValue >> value;
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    template <typename K, typename T>
+    bool Write(const K& key, const T& value, bool fOverwrite = true)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(1000);
+        ssKey << key;
+
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue.reserve(10000);
+        ssValue << value;
+
+        return WriteKey(std::move(ssKey), std::move(ssValue), fOverwrite);
+    }
+
+    template <typename K>
+    bool Erase(const K& key)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(1000);
+        ssKey << key;
+
+        return EraseKey(std::move(ssKey));
+    }
+
+    template <typename K>
+    bool Exists(const K& key)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(1000);
+        ssKey << key;
+
+        return HasKey(std::move(ssKey));
+    }
+
+    /** Start iterating over all records, in key order */
+    virtual bool StartCursor() = 0;
+    /** Start iterating at the first record whose key is not smaller than ssKey */
+    virtual bool SeekCursor(const CDataStream& ssKey) = 0;
+    /** Read the next record, sets fComplete once there are no records left. Returns false on errors */
+    virtual bool ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete) = 0;
+    virtual void CloseCursor() = 0;
+
+    virtual bool TxnBegin() = 0;
+    virtual bool TxnCommit() = 0;
+    virtual bool TxnAbort() = 0;
+
+    bool ReadVersion(int& nVersion)
+    {
+        nVersion = 0;
+        return Read(std::string("version"), nVersion);
+    }
+
+    bool WriteVersion(int nVersion)
+    {
+        return Write(std::string("version"), nVersion);
+    }
+};
+
 class BerkeleyDatabase;
 
 class BerkeleyEnvironment
@@ -107,18 +274,17 @@ BerkeleyEnvironment* GetWalletEnv(const fs::path& wallet_path, std::string& data
 /** An instance of this class represents one database.
  * For BerkeleyDB this is just a (env, strFile) tuple.
  **/
-class BerkeleyDatabase
+class BerkeleyDatabase : public WalletDatabase
 {
     friend class BerkeleyBatch;
 public:
     /** Create dummy DB handle */
-    BerkeleyDatabase() : nUpdateCounter(0), nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0), env(nullptr)
+    BerkeleyDatabase() : env(nullptr)
     {
     }
 
     /** Create DB handle to real database */
-    BerkeleyDatabase(const fs::path& wallet_path, bool mock = false) :
-        nUpdateCounter(0), nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0)
+    BerkeleyDatabase(const fs::path& wallet_path, bool mock = false)
     {
         env = GetWalletEnv(wallet_path, strFile);
         auto inserted = env->m_databases.emplace(strFile, std::ref(*this));
@@ -130,51 +296,32 @@ public:
         }
     }
 
-    ~BerkeleyDatabase() {
+    ~BerkeleyDatabase() override {
         if (env) {
             size_t erased = env->m_databases.erase(strFile);
             assert(erased == 1);
         }
     }
 
-    /** Return object for accessing database at specified path. */
-    static std::unique_ptr<BerkeleyDatabase> Create(const fs::path& path)
-    {
-        return MakeUnique<BerkeleyDatabase>(path);
-    }
-
-    /** Return object for accessing dummy database with no read/write capabilities. */
-    static std::unique_ptr<BerkeleyDatabase> CreateDummy()
-    {
-        return MakeUnique<BerkeleyDatabase>();
-    }
-
-    /** Return object for accessing temporary in-memory database. */
-    static std::unique_ptr<BerkeleyDatabase> CreateMock()
-    {
-        return MakeUnique<BerkeleyDatabase>("", true /* mock */);
-    }
+    std::unique_ptr<DatabaseBatch> MakeBatch(const char* pszMode = "r+", bool fFlushOnClose = true) override;
 
     /** Rewrite the entire database on disk, with the exception of key pszSkip if non-zero
      */
-    bool Rewrite(const char* pszSkip=nullptr);
+    bool Rewrite(const char* pszSkip=nullptr) override;
 
     /** Back up the entire database to a file.
      */
-    bool Backup(const std::string& strDest);
+    bool Backup(const std::string& strDest) override;
 
     /** Make sure all changes are flushed to disk.
      */
-    void Flush(bool shutdown);
+    void Flush(bool shutdown) override;
 
-    void IncrementUpdateCounter();
+    bool PeriodicFlush() override;
 
-    void ReloadDbEnv();
+    void ReloadDbEnv() override;
 
-    std::atomic<unsigned int> nUpdateCounter;
-    unsigned int nLastSeen;
-    unsigned int nLastFlushed;
-    int64_t nLastWalletUpdate;
+    bool SyncWrites() override;
 
     /** Database pointer. This is initialized lazily and reset during flushes, so it can be null. */
     std::unique_ptr<Db> m_db;
@@ -193,25 +340,32 @@ private:
 
 
 /** RAII class that provides access to a Berkeley database */
-class BerkeleyBatch
+class BerkeleyBatch : public DatabaseBatch
 {
+private:
+    bool ReadKey(CDataStream&& ssKey, CDataStream& ssValue) override;
+    bool WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite = true) override;
+    bool EraseKey(CDataStream&& ssKey) override;
+    bool HasKey(CDataStream&& ssKey) override;
+
 protected:
     Db* pdb;
     std::string strFile;
     DbTxn* activeTxn;
+    Dbc* m_cursor;
+    //! set by SeekCursor, the next ReadAtCursor positions the cursor at this key
+    bool m_cursor_seek;
+    CDataStream m_cursor_seek_key;
     bool fReadOnly;
     bool fFlushOnClose;
     BerkeleyEnvironment *env;
 
 public:
     explicit BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode = "r+", bool fFlushOnCloseIn=true);
-    ~BerkeleyBatch() { Close(); }
-
-    BerkeleyBatch(const BerkeleyBatch&) = delete;
-    BerkeleyBatch& operator=(const BerkeleyBatch&) = delete;
+    ~BerkeleyBatch() override { Close(); }
 
-    void Flush();
-    void Close();
+    void Flush() override;
+    void Close() override;
     static bool Recover(const fs::path& file_path, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue), std::string& out_backup_filename);
 
     /* flush the wallet passively (TRY_LOCK)
@@ -222,113 +376,12 @@ public:
     /* verifies the database file */
     static bool VerifyDatabaseFile(const fs::path& file_path, std::string& warningStr, std::string& errorStr, BerkeleyEnvironment::recoverFunc_type recoverFunc);
 
-public:
-    template <typename K, typename T>
-    bool Read(const K& key, T& value)
-    {
-        if (!pdb)
-            return false;
-
-        // Key
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
-        ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
-
-        // Read
-        Dbt datValue;
-        datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        bool success = false;
-        if (datValue.get_data() != nullptr) {
-            // Unserialize value
-            try {
-                CDataStream ssValue((char*)datValue.get_data(), (char*)datValue.get_data() + datValue.get_size(), SER_DISK, CLIENT_VERSION);
-                ssValue >> value;
-                success = true;
-            } catch (const std::exception&) {
-                // In this case success remains 'false'
-            }
-
-            // Clear and free memory
-            memory_cleanse(datValue.get_data(), datValue.get_size());
-            free(datValue.get_data());
-        }
-        return ret == 0 && success;
-    }
-
-    template <typename K, typename T>
-    bool Write(const K& key, const T& value, bool fOverwrite = true)
-    {
-        if (!pdb)
-            return true;
-        if (fReadOnly)
-            assert(!"Write called on database in read-only mode");
-
-        // Key
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
-        ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
-
-        // Value
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        ssValue.reserve(10000);
-        ssValue << value;
-        Dbt datValue(ssValue.data(), ssValue.size());
-
-        // Write
-        int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
-
-        // Clear memory in case it was a private key
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        memory_cleanse(datValue.get_data(), datValue.get_size());
-        return (ret == 0);
-    }
-
-    template <typename K>
-    bool Erase(const K& key)
-    {
-        if (!pdb)
-            return false;
-        if (fReadOnly)
-            assert(!"Erase called on database in read-only mode");
-
-        // Key
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
-        ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
-
-        // Erase
-        int ret = pdb->del(activeTxn, &datKey, 0);
-
-        // Clear memory
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        return (ret == 0 || ret == DB_NOTFOUND);
-    }
-
-    template <typename K>
-    bool Exists(const K& key)
-    {
-        if (!pdb)
-            return false;
-
-        // Key
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
-        ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
-
-        // Exists
-        int ret = pdb->exists(activeTxn, &datKey, 0);
-
-        // Clear memory
-        memory_cleanse(datKey.get_data(), datKey.get_size());
-        return (ret == 0);
-    }
+    bool StartCursor() override;
+    bool SeekCursor(const CDataStream& ssKey) override;
+    bool ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete) override;
+    void CloseCursor() override;
 
+    /** BerkeleyDB specific cursor access, the cursor must be closed by the caller */
     Dbc* GetCursor()
     {
         if (!pdb)
@@ -375,8 +428,7 @@ public:
         return 0;
     }
 
-public:
-    bool TxnBegin()
+    bool TxnBegin() override
     {
         if (!pdb || activeTxn)
             return false;
@@ -387,7 +439,7 @@ public:
         return true;
     }
 
-    bool TxnCommit()
+    bool TxnCommit() override
     {
         if (!pdb || !activeTxn)
             return false;
@@ -396,7 +448,7 @@ public:
         return (ret == 0);
     }
 
-    bool TxnAbort()
+    bool TxnAbort() override
     {
         if (!pdb || !activeTxn)
             return false;
@@ -405,17 +457,6 @@ public:
         return (ret == 0);
     }
 
-    bool ReadVersion(int& nVersion)
-    {
-        nVersion = 0;
-        return Read(std::string("version"), nVersion);
-    }
-
-    bool WriteVersion(int nVersion)
-    {
-        return Write(std::string("version"), nVersion);
-    }
-
     bool static Rewrite(BerkeleyDatabase& database, const char* pszSkip = nullptr);
 };
 
@@ -0,0 +1,370 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/db_leveldb.h>
+
+#include <util.h>
+#include <utiltime.h>
+
+#include <string.h>
+
+//! batches written while copying a database are flushed to the backup once they grow larger than this
+static const size_t BACKUP_BATCH_SIZE = 1 << 20;
+
+bool IsLevelDBWallet(const fs::path& wallet_path)
+{
+    return fs::is_directory(GetLevelDBWalletPath(wallet_path));
+}
+
+fs::path GetLevelDBWalletPath(const fs::path& wallet_path)
+{
+    return wallet_path / "wallet.ldb";
+}
+
+//
+// LevelDBDatabase
+//
+
+LevelDBDatabase::LevelDBDatabase(const fs::path& wallet_path, bool fMemory) :
+    m_path(GetLevelDBWalletPath(wallet_path))
+{
+    try {
+        m_db = MakeUnique<CDBWrapper>(m_path, WALLET_LEVELDB_CACHE_SIZE, fMemory, false /* fWipe */, false /* obfuscate */);
+    } catch (const dbwrapper_error& e) {
+        // Batches on a database which could not be opened fail all reads and writes, so loading the wallet
+        // reports it as corrupted
+        LogPrintf("LevelDBDatabase: Failed to open %s: %s\n", m_path.string(), e.what());
+    }
+}
+
+LevelDBDatabase::~LevelDBDatabase()
+{
+    Flush(true);
+}
+
+std::unique_ptr<DatabaseBatch> LevelDBDatabase::MakeBatch(const char* pszMode, bool fFlushOnClose)
+{
+    return MakeUnique<LevelDBBatch>(*this, pszMode, fFlushOnClose);
+}
+
+bool LevelDBDatabase::Sync()
+{
+    if (!m_db) {
+        return true;
+    }
+
+    const uint64_t nWriteSeq = m_write_seq;
+    LOCK(cs_sync);
+    if (m_synced_seq >= nWriteSeq) {
+        // Our writes were covered by a sync which ran while we were waiting
+        return true;
+    }
+
+    // Everything written up to here, including the writes of batches queued behind us, goes to disk with
+    // this sync
+    const uint64_t nSyncSeq = m_write_seq;
+    int64_t nStart = GetTimeMillis();
+    try {
+        m_db->Sync();
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("LevelDBDatabase::Sync: Failed to sync %s: %s\n", m_path.string(), e.what());
+        return false;
+    }
+    LogPrint(BCLog::DB, "Synced %s (%d writes) %dms\n", m_path.string(), nSyncSeq - m_synced_seq, GetTimeMillis() - nStart);
+    m_synced_seq = nSyncSeq;
+    return true;
+}
+
+bool LevelDBDatabase::PeriodicFlush()
+{
+    return Sync();
+}
+
+void LevelDBDatabase::Flush(bool shutdown)
+{
+    Sync();
+    if (shutdown) {
+        m_db.reset();
+    }
+}
+
+bool LevelDBDatabase::Rewrite(const char* pszSkip)
+{
+    if (!m_db) {
+        return false;
+    }
+
+    LogPrintf("LevelDBDatabase::Rewrite: Rewriting %s...\n", m_path.string());
+    try {
+        CDBBatch batch(*m_db);
+        if (pszSkip) {
+            // pszSkip is a raw key prefix, like in BerkeleyBatch::Rewrite
+            const size_t nSkipLen = strlen(pszSkip);
+            std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+            for (pcursor->Seek(CDataStream(pszSkip, pszSkip + nSkipLen, SER_DISK, CLIENT_VERSION)); pcursor->Valid(); pcursor->Next()) {
+                CDataStream ssKey = pcursor->GetKey();
+                if (ssKey.size() < nSkipLen || memcmp(ssKey.data(), pszSkip, nSkipLen) != 0) {
+                    break;
+                }
+                batch.Erase(ssKey);
+            }
+        }
+        batch.Write(std::string("version"), CLIENT_VERSION);
+        m_db->WriteBatch(batch, true);
+        ++m_write_seq;
+
+        // Compaction drops erased and overwritten records as well as the log they were written to, which is
+        // what removes unencrypted keys from disk after encrypting the wallet
+        m_db->CompactFull();
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("LevelDBDatabase::Rewrite: Failed to rewrite %s: %s\n", m_path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LevelDBDatabase::Backup(const std::string& strDest)
+{
+    if (!m_db) {
+        return false;
+    }
+
+    fs::path pathDest(strDest);
+    try {
+        if (fs::is_directory(pathDest) && !fs::exists(pathDest / "CURRENT")) {
+            pathDest /= m_path.filename();
+        }
+        if (fs::exists(pathDest)) {
+            if (fs::equivalent(m_path, pathDest)) {
+                LogPrintf("cannot backup to wallet source directory %s\n", pathDest.string());
+                return false;
+            }
+            // Only replace earlier backups, never anything else which happens to be there
+            if (!fs::exists(pathDest / "CURRENT")) {
+                LogPrintf("cannot backup to %s, it exists and is not a LevelDB directory\n", pathDest.string());
+                return false;
+            }
+            fs::remove_all(pathDest);
+        }
+
+        // The iterator reads from an implicit snapshot, so the copy is consistent even with concurrent writers
+        CDBWrapper dbDest(pathDest, WALLET_LEVELDB_CACHE_SIZE, false /* fMemory */, false /* fWipe */, false /* obfuscate */);
+        CDBBatch batch(dbDest);
+        std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+        size_t nRecords = 0;
+        for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+            batch.WriteSerialized(pcursor->GetKey(), pcursor->GetValue());
+            nRecords++;
+            if (batch.SizeEstimate() > BACKUP_BATCH_SIZE) {
+                dbDest.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        dbDest.WriteBatch(batch, true);
+        LogPrintf("copied %s (%d records) to %s\n", m_path.string(), nRecords, pathDest.string());
+        return true;
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("error copying %s to %s - %s\n", m_path.string(), pathDest.string(), e.what());
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("error copying %s to %s - %s\n", m_path.string(), pathDest.string(), e.what());
+    }
+    return false;
+}
+
+//
+// LevelDBBatch
+//
+
+LevelDBBatch::LevelDBBatch(LevelDBDatabase& database, const char* pszMode, bool fFlushOnCloseIn) :
+    m_database(database),
+    m_db(database.m_db.get())
+{
+    fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
+    fFlushOnClose = fFlushOnCloseIn;
+
+    bool fCreate = strchr(pszMode, 'c') != nullptr;
+    if (m_db && fCreate && !Exists(std::string("version"))) {
+        bool fTmp = fReadOnly;
+        fReadOnly = false;
+        WriteVersion(CLIENT_VERSION);
+        fReadOnly = fTmp;
+    }
+}
+
+bool LevelDBBatch::WriteBatch(CDBBatch& batch)
+{
+    try {
+        m_db->WriteBatch(batch);
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("LevelDBBatch: Write to %s failed: %s\n", m_database.m_path.string(), e.what());
+        return false;
+    }
+    ++m_database.m_write_seq;
+    m_dirty = true;
+    return true;
+}
+
+bool LevelDBBatch::ReadKey(CDataStream&& ssKey, CDataStream& ssValue)
+{
+    if (!m_db)
+        return false;
+
+    if (m_txn) {
+        auto it = m_txn_writes.find(CSerializeData(ssKey.begin(), ssKey.end()));
+        if (it != m_txn_writes.end()) {
+            if (!it->second) {
+                return false;
+            }
+            ssValue = CDataStream(it->second->begin(), it->second->end(), SER_DISK, CLIENT_VERSION);
+            return true;
+        }
+    }
+
+    try {
+        return m_db->ReadDataStream(ssKey, ssValue);
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("LevelDBBatch: Read from %s failed: %s\n", m_database.m_path.string(), e.what());
+        return false;
+    }
+}
+
+bool LevelDBBatch::WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite)
+{
+    if (!m_db)
+        return false;
+    if (fReadOnly)
+        assert(!"Write called on database in read-only mode");
+
+    if (!fOverwrite && HasKey(CDataStream(ssKey))) {
+        return false;
+    }
+
+    if (m_txn) {
+        m_txn->WriteSerialized(ssKey, ssValue);
+        m_txn_writes[CSerializeData(ssKey.begin(), ssKey.end())] = MakeUnique<CSerializeData>(ssValue.begin(), ssValue.end());
+        return true;
+    }
+
+    CDBBatch batch(*m_db);
+    batch.WriteSerialized(ssKey, ssValue);
+    return WriteBatch(batch);
+}
+
+bool LevelDBBatch::EraseKey(CDataStream&& ssKey)
+{
+    if (!m_db)
+        return false;
+    if (fReadOnly)
+        assert(!"Erase called on database in read-only mode");
+
+    if (m_txn) {
+        m_txn->Erase(ssKey);
+        m_txn_writes[CSerializeData(ssKey.begin(), ssKey.end())] = nullptr;
+        return true;
+    }
+
+    CDBBatch batch(*m_db);
+    batch.Erase(ssKey);
+    return WriteBatch(batch);
+}
+
+bool LevelDBBatch::HasKey(CDataStream&& ssKey)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    return ReadKey(std::move(ssKey), ssValue);
+}
+
+void LevelDBBatch::Flush()
+{
+    if (m_txn || !m_dirty)
+        return;
+
+    if (m_database.Sync()) {
+        m_dirty = false;
+    }
+}
+
+void LevelDBBatch::Close()
+{
+    if (!m_db)
+        return;
+    CloseCursor();
+    TxnAbort();
+
+    if (fFlushOnClose)
+        Flush();
+    m_db = nullptr;
+}
+
+bool LevelDBBatch::StartCursor()
+{
+    assert(!m_cursor);
+    if (!m_db)
+        return false;
+    m_cursor.reset(m_db->NewIterator());
+    m_cursor->SeekToFirst();
+    return true;
+}
+
+bool LevelDBBatch::SeekCursor(const CDataStream& ssKey)
+{
+    if (!StartCursor())
+        return false;
+    m_cursor->Seek(ssKey);
+    return true;
+}
+
+bool LevelDBBatch::ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete)
+{
+    fComplete = false;
+    if (!m_cursor)
+        return false;
+
+    try {
+        if (!m_cursor->Valid()) {
+            fComplete = true;
+            return true;
+        }
+        ssKey = m_cursor->GetKey();
+        ssValue = m_cursor->GetValue();
+        m_cursor->Next();
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("LevelDBBatch: Read from %s failed: %s\n", m_database.m_path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+void LevelDBBatch::CloseCursor()
+{
+    m_cursor.reset();
+}
+
+bool LevelDBBatch::TxnBegin()
+{
+    if (!m_db || m_txn)
+        return false;
+    m_txn = MakeUnique<CDBBatch>(*m_db);
+    return true;
+}
+
+bool LevelDBBatch::TxnCommit()
+{
+    if (!m_db || !m_txn)
+        return false;
+    // The transaction is a single LevelDB batch, so it is applied atomically
+    bool ret = WriteBatch(*m_txn);
+    m_txn.reset();
+    m_txn_writes.clear();
+    return ret;
+}
+
+bool LevelDBBatch::TxnAbort()
+{
+    if (!m_db || !m_txn)
+        return false;
+    m_txn.reset();
+    m_txn_writes.clear();
+    return true;
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_DB_LEVELDB_H
+#define BITCOIN_WALLET_DB_LEVELDB_H
+
+#include <dbwrapper.h>
+#include <wallet/db.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+static const std::string DEFAULT_WALLET_DB_BACKEND = "bdb";
+//! LevelDB cache size of a wallet database, in bytes
+static const size_t WALLET_LEVELDB_CACHE_SIZE = 8 << 20;
+
+/** Return whether the wallet at wallet_path is stored in LevelDB */
+bool IsLevelDBWallet(const fs::path& wallet_path);
+
+/** Get the LevelDB directory of the wallet at wallet_path */
+fs::path GetLevelDBWalletPath(const fs::path& wallet_path);
+
+/**
+ * Wallet database stored in LevelDB, meant for wallets with many keys and transactions where BerkeleyDB
+ * spends most of its time in page splits and log checkpoints.
+ *
+ * Writes are not synced individually. A batch which was written to syncs the database when it is closed,
+ * concurrent batches share a single sync (group commit), so a transaction which touches many records, e.g.
+ * a sendmany, costs one fsync instead of one per record.
+ */
+class LevelDBDatabase : public WalletDatabase
+{
+    friend class LevelDBBatch;
+public:
+    /** Create DB handle to the database at wallet_path, or a temporary in-memory one */
+    LevelDBDatabase(const fs::path& wallet_path, bool fMemory = false);
+    ~LevelDBDatabase() override;
+
+    std::unique_ptr<DatabaseBatch> MakeBatch(const char* pszMode = "r+", bool fFlushOnClose = true) override;
+
+    /** Erase all keys starting with pszSkip and compact the database */
+    bool Rewrite(const char* pszSkip = nullptr) override;
+
+    /** Copy the database into a new LevelDB directory at strDest */
+    bool Backup(const std::string& strDest) override;
+
+    void Flush(bool shutdown) override;
+    bool PeriodicFlush() override;
+    void ReloadDbEnv() override {}
+    bool SyncWrites() override { return Sync(); }
+
+    /** Make all writes done so far durable. Writers queued behind a running sync are covered by the next one. */
+    bool Sync();
+
+private:
+    fs::path m_path;
+    std::unique_ptr<CDBWrapper> m_db;
+
+    CCriticalSection cs_sync;
+    //! number of (unsynced) writes done so far
+    std::atomic<uint64_t> m_write_seq{0};
+    //! value of m_write_seq which is known to be on disk
+    uint64_t m_synced_seq GUARDED_BY(cs_sync){0};
+};
+
+/** RAII class that provides access to a LevelDB wallet database */
+class LevelDBBatch : public DatabaseBatch
+{
+private:
+    bool ReadKey(CDataStream&& ssKey, CDataStream& ssValue) override;
+    bool WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite = true) override;
+    bool EraseKey(CDataStream&& ssKey) override;
+    bool HasKey(CDataStream&& ssKey) override;
+
+    /** Commit batch to the database, without syncing it */
+    bool WriteBatch(CDBBatch& batch);
+
+    LevelDBDatabase& m_database;
+    CDBWrapper* m_db;
+    bool fReadOnly;
+    bool fFlushOnClose;
+    //! whether anything was written since the last sync
+    bool m_dirty{false};
+
+    std::unique_ptr<CDBBatch> m_txn;
+    //! the records written inside the running transaction, erased ones are mapped to nullptr
+    std::map<CSerializeData, std::unique_ptr<CSerializeData>> m_txn_writes;
+
+    std::unique_ptr<CDBIterator> m_cursor;
+
+public:
+    explicit LevelDBBatch(LevelDBDatabase& database, const char* pszMode = "r+", bool fFlushOnCloseIn = true);
+    ~LevelDBBatch() override { Close(); }
+
+    void Flush() override;
+    void Close() override;
+
+    bool StartCursor() override;
+    bool SeekCursor(const CDataStream& ssKey) override;
+    bool ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete) override;
+    void CloseCursor() override;
+
+    bool TxnBegin() override;
+    bool TxnCommit() override;
+    bool TxnAbort() override;
+};
+
+#endif // BITCOIN_WALLET_DB_LEVELDB_H
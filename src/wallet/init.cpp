@@ -11,6 +11,7 @@
 #include <utilmoneystr.h>
 #include <validation.h>
 #include <walletinitinterface.h>
+#include <wallet/db_leveldb.h>
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
@@ -66,15 +67,18 @@ void WalletInit::AddWalletOptions() const
     gArgs.AddArg("-createwalletbackups=<n>", strprintf("Number of automatic wallet backups (default: %u)", nWalletBackups), false, OptionsCategory::WALLET);
     gArgs.AddArg("-disablewallet", "Do not load the wallet and disable wallet RPC calls", false, OptionsCategory::WALLET);
     gArgs.AddArg("-instantsendnotify=<cmd>", "Execute command when a wallet InstantSend transaction is successfully locked (%s in cmd is replaced by TxID)", false, OptionsCategory::WALLET);
-    gArgs.AddArg("-keypool=<n>", strprintf("Set key pool size to <n> (default: %u)", DEFAULT_KEYPOOL_SIZE), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-keypool=<n>", strprintf("Set key pool size to <n>, keys beyond the first %u are generated in the background (default: %u)", MAX_KEYPOOL_FOREGROUND_SIZE, DEFAULT_KEYPOOL_SIZE), false, OptionsCategory::WALLET);
     gArgs.AddArg("-rescan=<mode>", "Rescan the block chain for missing wallet transactions on startup"
                                             " (1 = start from wallet creation time, 2 = start from genesis block)", false, OptionsCategory::WALLET);
+    gArgs.AddArg("-rescanthreads=<n>", strprintf("Number of threads reading and matching blocks during wallet rescans (0 = one per core up to %d, default: %d)", MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS), false, OptionsCategory::WALLET);
     gArgs.AddArg("-salvagewallet", "Attempt to recover private keys from a corrupt wallet on startup", false, OptionsCategory::WALLET);
     gArgs.AddArg("-spendzeroconfchange", strprintf("Spend unconfirmed change when sending transactions (default: %u)", DEFAULT_SPEND_ZEROCONF_CHANGE), false, OptionsCategory::WALLET);
     gArgs.AddArg("-upgradewallet", "Upgrade wallet to latest format on startup", false, OptionsCategory::WALLET);
     gArgs.AddArg("-wallet=<path>", "Specify wallet database path. Can be specified multiple times to load multiple wallets. Path is interpreted relative to <walletdir> if it is not absolute, and will be created if it does not exist (as a directory containing a wallet.dat file and log files). For backwards compatibility this will also accept names of existing data files in <walletdir>.)", false, OptionsCategory::WALLET);
     gArgs.AddArg("-walletbackupsdir=<dir>", "Specify full path to directory for automatic wallet backups (must exist)", false, OptionsCategory::WALLET);
     gArgs.AddArg("-walletbroadcast", strprintf("Make the wallet broadcast transactions (default: %u)", DEFAULT_WALLETBROADCAST), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-walletcommitdelay=<ms>", strprintf("Sync the wallet database for transactions sent concurrently together, waiting up to <ms> milliseconds for other sends to join a sync (0-%d, 0 = sync every transaction on its own, default: %d)", MAX_WALLET_COMMIT_DELAY, DEFAULT_WALLET_COMMIT_DELAY), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-walletdbbackend=<backend>", strprintf("Database backend new wallets are created in, existing wallets always stay in the one they were created in (bdb or leveldb, default: %s)", DEFAULT_WALLET_DB_BACKEND), false, OptionsCategory::WALLET);
     gArgs.AddArg("-walletdir=<dir>", "Specify directory to hold wallets (default: <datadir>/wallets if it exists, otherwise <datadir>)", false, OptionsCategory::WALLET);
     gArgs.AddArg("-walletnotify=<cmd>", "Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)", false, OptionsCategory::WALLET);
     gArgs.AddArg("-zapwallettxes=<mode>", "Delete all wallet transactions and only recover those parts of the blockchain through -rescan on startup"
@@ -146,6 +150,11 @@ bool WalletInit::ParameterInteraction() const
         }
     }
 
+    const std::string strDbBackend = gArgs.GetArg("-walletdbbackend", DEFAULT_WALLET_DB_BACKEND);
+    if (strDbBackend != "bdb" && strDbBackend != "leveldb") {
+        return InitError(strprintf(_("Unknown -walletdbbackend value: %s"), strDbBackend));
+    }
+
     bool zapwallettxes = gArgs.GetBoolArg("-zapwallettxes", false);
     // -zapwallettxes implies dropping the mempool on startup
     if (zapwallettxes && gArgs.SoftSetBoolArg("-persistmempool", false)) {
@@ -416,10 +425,13 @@ void WalletInit::Start(CScheduler& scheduler) const
     }
 
     // Run a thread to flush wallet periodically
-    scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
+    scheduler.scheduleEvery(MaybeCompactWalletDB, 500, CScheduler::Priority::LOW, "walletflush");
 
     if (!fMasternodeMode && CCoinJoinClientOptions::IsEnabled()) {
-        scheduler.scheduleEvery(std::bind(&DoCoinJoinMaintenance, std::ref(*g_connman)), 1 * 1000);
+        scheduler.scheduleEvery(std::bind(&DoCoinJoinMaintenance, std::ref(*g_connman)), 1 * 1000,
+                                CScheduler::Priority::NORMAL, "coinjoinclient");
+        scheduler.scheduleEvery(std::bind(&CCoinJoinClientQueueManager::ProcessPendingDsqs, std::ref(coinJoinClientQueueManager), std::ref(*g_connman)), 100,
+                                CScheduler::Priority::NORMAL, "coinjoinclientdsqs");
     }
 }
 
@@ -640,112 +640,116 @@ UniValue importelectrumwallet(const JSONRPCRequest& request)
     if (fPruneMode)
         throw JSONRPCError(RPC_WALLET_ERROR, "Importing wallets is disabled in pruned mode");
 
-    LOCK2(cs_main, pwallet->cs_wallet);
-
-    EnsureWalletIsUnlocked(pwallet);
+    bool fGood = true;
+    CBlockIndex* pindexStart;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
 
-    std::ifstream file;
-    std::string strFileName = request.params[0].get_str();
-    size_t nDotPos = strFileName.find_last_of(".");
-    if(nDotPos == std::string::npos)
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "File has no extension, should be .json or .csv");
+        EnsureWalletIsUnlocked(pwallet);
 
-    std::string strFileExt = strFileName.substr(nDotPos+1);
-    if(strFileExt != "json" && strFileExt != "csv")
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "File has wrong extension, should be .json or .csv");
+        std::ifstream file;
+        std::string strFileName = request.params[0].get_str();
+        size_t nDotPos = strFileName.find_last_of(".");
+        if(nDotPos == std::string::npos)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "File has no extension, should be .json or .csv");
 
-    file.open(strFileName.c_str(), std::ios::in | std::ios::ate);
-    if (!file.is_open())
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open Electrum wallet export file");
+        std::string strFileExt = strFileName.substr(nDotPos+1);
+        if(strFileExt != "json" && strFileExt != "csv")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "File has wrong extension, should be .json or .csv");
 
-    bool fGood = true;
+        file.open(strFileName.c_str(), std::ios::in | std::ios::ate);
+        if (!file.is_open())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open Electrum wallet export file");
 
-    int64_t nFilesize = std::max((int64_t)1, (int64_t)file.tellg());
-    file.seekg(0, file.beg);
+        int64_t nFilesize = std::max((int64_t)1, (int64_t)file.tellg());
+        file.seekg(0, file.beg);
 
-    pwallet->ShowProgress(_("Importing..."), 0); // show progress dialog in GUI
+        pwallet->ShowProgress(_("Importing..."), 0); // show progress dialog in GUI
 
-    if(strFileExt == "csv") {
-        while (file.good()) {
-            pwallet->ShowProgress("", std::max(1, std::min(99, (int)(((double)file.tellg() / (double)nFilesize) * 100))));
-            std::string line;
-            std::getline(file, line);
-            if (line.empty() || line == "address,private_key")
-                continue;
-            std::vector<std::string> vstr;
-            boost::split(vstr, line, boost::is_any_of(","));
-            if (vstr.size() < 2)
-                continue;
-            CKey key = DecodeSecret(vstr[1]);
-            if (!key.IsValid()) {
-                continue;
-            }
-            CPubKey pubkey = key.GetPubKey();
-            assert(key.VerifyPubKey(pubkey));
-            CKeyID keyid = pubkey.GetID();
-            if (pwallet->HaveKey(keyid)) {
-                LogPrintf("Skipping import of %s (key already present)\n", EncodeDestination(keyid));
-                continue;
-            }
-            LogPrintf("Importing %s...\n", EncodeDestination(keyid));
-            if (!pwallet->AddKeyPubKey(key, pubkey)) {
-                fGood = false;
-                continue;
-            }
-        }
-    } else {
-        // json
-        char* buffer = new char [nFilesize];
-        file.read(buffer, nFilesize);
-        UniValue data(UniValue::VOBJ);
-        if(!data.read(buffer))
-            throw JSONRPCError(RPC_TYPE_ERROR, "Cannot parse Electrum wallet export file");
-        delete[] buffer;
-
-        std::vector<std::string> vKeys = data.getKeys();
-
-        for (size_t i = 0; i < data.size(); i++) {
-            pwallet->ShowProgress("", std::max(1, std::min(99, int(i*100/data.size()))));
-            if(!data[vKeys[i]].isStr())
-                continue;
-            CKey key = DecodeSecret(data[vKeys[i]].get_str());
-            if (!key.IsValid()) {
-                continue;
-            }
-            CPubKey pubkey = key.GetPubKey();
-            assert(key.VerifyPubKey(pubkey));
-            CKeyID keyid = pubkey.GetID();
-            if (pwallet->HaveKey(keyid)) {
-                LogPrintf("Skipping import of %s (key already present)\n", EncodeDestination(keyid));
-                continue;
+        if(strFileExt == "csv") {
+            while (file.good()) {
+                pwallet->ShowProgress("", std::max(1, std::min(99, (int)(((double)file.tellg() / (double)nFilesize) * 100))));
+                std::string line;
+                std::getline(file, line);
+                if (line.empty() || line == "address,private_key")
+                    continue;
+                std::vector<std::string> vstr;
+                boost::split(vstr, line, boost::is_any_of(","));
+                if (vstr.size() < 2)
+                    continue;
+                CKey key = DecodeSecret(vstr[1]);
+                if (!key.IsValid()) {
+                    continue;
+                }
+                CPubKey pubkey = key.GetPubKey();
+                assert(key.VerifyPubKey(pubkey));
+                CKeyID keyid = pubkey.GetID();
+                if (pwallet->HaveKey(keyid)) {
+                    LogPrintf("Skipping import of %s (key already present)\n", EncodeDestination(keyid));
+                    continue;
+                }
+                LogPrintf("Importing %s...\n", EncodeDestination(keyid));
+                if (!pwallet->AddKeyPubKey(key, pubkey)) {
+                    fGood = false;
+                    continue;
+                }
             }
-            LogPrintf("Importing %s...\n", EncodeDestination(keyid));
-            if (!pwallet->AddKeyPubKey(key, pubkey)) {
-                fGood = false;
-                continue;
+        } else {
+            // json
+            char* buffer = new char [nFilesize];
+            file.read(buffer, nFilesize);
+            UniValue data(UniValue::VOBJ);
+            if(!data.read(buffer))
+                throw JSONRPCError(RPC_TYPE_ERROR, "Cannot parse Electrum wallet export file");
+            delete[] buffer;
+
+            std::vector<std::string> vKeys = data.getKeys();
+
+            for (size_t i = 0; i < data.size(); i++) {
+                pwallet->ShowProgress("", std::max(1, std::min(99, int(i*100/data.size()))));
+                if(!data[vKeys[i]].isStr())
+                    continue;
+                CKey key = DecodeSecret(data[vKeys[i]].get_str());
+                if (!key.IsValid()) {
+                    continue;
+                }
+                CPubKey pubkey = key.GetPubKey();
+                assert(key.VerifyPubKey(pubkey));
+                CKeyID keyid = pubkey.GetID();
+                if (pwallet->HaveKey(keyid)) {
+                    LogPrintf("Skipping import of %s (key already present)\n", EncodeDestination(keyid));
+                    continue;
+                }
+                LogPrintf("Importing %s...\n", EncodeDestination(keyid));
+                if (!pwallet->AddKeyPubKey(key, pubkey)) {
+                    fGood = false;
+                    continue;
+                }
             }
         }
-    }
-    file.close();
-    pwallet->ShowProgress("", 100); // hide progress dialog in GUI
+        file.close();
+        pwallet->ShowProgress("", 100); // hide progress dialog in GUI
 
-    // Whether to perform rescan after import
-    int nStartHeight = 0;
-    if (!request.params[1].isNull())
-        nStartHeight = request.params[1].get_int();
-    if (chainActive.Height() < nStartHeight)
-        nStartHeight = chainActive.Height();
+        // Whether to perform rescan after import
+        int nStartHeight = 0;
+        if (!request.params[1].isNull())
+            nStartHeight = request.params[1].get_int();
+        if (chainActive.Height() < nStartHeight)
+            nStartHeight = chainActive.Height();
+
+        // Assume that electrum wallet was created at that block
+        int nTimeBegin = chainActive[nStartHeight]->GetBlockTime();
+        pwallet->UpdateTimeFirstKey(nTimeBegin);
 
-    // Assume that electrum wallet was created at that block
-    int nTimeBegin = chainActive[nStartHeight]->GetBlockTime();
-    pwallet->UpdateTimeFirstKey(nTimeBegin);
+        LogPrintf("Rescanning %i blocks\n", chainActive.Height() - nStartHeight + 1);
+        pindexStart = chainActive[nStartHeight];
+    }
 
-    LogPrintf("Rescanning %i blocks\n", chainActive.Height() - nStartHeight + 1);
     WalletRescanReserver reserver(pwallet);
     if (!reserver.reserve()) {
         throw JSONRPCError(RPC_WALLET_ERROR, "Wallet is currently rescanning. Abort existing rescan or wait.");
     }
-    pwallet->ScanForWalletTransactions(chainActive[nStartHeight], nullptr, reserver, true);
+    pwallet->ScanForWalletTransactions(pindexStart, nullptr, reserver, true);
 
     if (!fGood)
         throw JSONRPCError(RPC_WALLET_ERROR, "Error adding some keys to wallet");
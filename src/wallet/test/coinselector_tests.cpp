@@ -224,6 +224,41 @@ BOOST_AUTO_TEST_CASE(bnb_search_test)
     BOOST_CHECK(!testWallet.SelectCoinsMinConf( 1 * CENT, filter_standard, vCoins, setCoinsRet, nValueRet, coin_selection_params_bnb, bnb_used));
 }
 
+BOOST_AUTO_TEST_CASE(coin_selection_index_test)
+{
+    std::vector<CInputCoin> utxo_pool;
+    for (int i = 1; i <= 5; ++i) {
+        add_coin(i * CENT, i, utxo_pool);
+    }
+    add_coin(20 * CENT, 20, utxo_pool);
+
+    CoinSelectionIndex index(utxo_pool);
+    BOOST_CHECK_EQUAL(index.size(), 6U);
+    BOOST_CHECK_EQUAL(index[0].effective_value, 20 * CENT);
+    BOOST_CHECK_EQUAL(index[5].effective_value, 1 * CENT);
+    BOOST_CHECK_EQUAL(index.GetTotalValue(), 35 * CENT);
+    BOOST_CHECK_EQUAL(index.GetValue(1, 3), 9 * CENT);
+    BOOST_CHECK_EQUAL(index.GetValue(2, 2), 0);
+    BOOST_CHECK_EQUAL(index.FindFirstAtMost(100 * CENT), 0U);
+    BOOST_CHECK_EQUAL(index.FindFirstAtMost(4 * CENT), 2U);
+    BOOST_CHECK_EQUAL(index.FindFirstAtMost(CENT / 2), 6U);
+
+    // The index can be searched repeatedly, coins larger than the target range are never selected
+    CoinSet selection, actual_selection;
+    CAmount value_ret = 0;
+    add_coin(4 * CENT, 4, actual_selection);
+    add_coin(3 * CENT, 3, actual_selection);
+    BOOST_CHECK(SelectCoinsBnB(index, 7 * CENT, 0, selection, value_ret, 0));
+    BOOST_CHECK(equal_sets(selection, actual_selection));
+    BOOST_CHECK_EQUAL(value_ret, 7 * CENT);
+    BOOST_CHECK(SelectCoinsBnB(index, 15 * CENT, 0, selection, value_ret, 0));
+    BOOST_CHECK_EQUAL(value_ret, 15 * CENT);
+    BOOST_CHECK_EQUAL(selection.count(index[0]), 0U);
+    BOOST_CHECK(!SelectCoinsBnB(index, 36 * CENT, 0, selection, value_ret, 0));
+
+    BOOST_CHECK(!SelectCoinsBnB(CoinSelectionIndex({}), 1 * CENT, 0, selection, value_ret, 0));
+}
+
 BOOST_AUTO_TEST_CASE(knapsack_solver_test)
 {
     CoinSet setCoinsRet, setCoinsRet2;
@@ -0,0 +1,111 @@
+// Copyright (c) 2014-2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/db_leveldb.h>
+#include <wallet/wallet.h>
+#include <wallet/walletdb.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(db_leveldb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(leveldb_batch)
+{
+    fs::path wallet_path = SetDataDir("leveldb_batch");
+    LevelDBDatabase database(wallet_path);
+    BOOST_CHECK(IsLevelDBWallet(wallet_path));
+
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch("cr+");
+    int nVersion;
+    BOOST_CHECK(batch->ReadVersion(nVersion));
+    BOOST_CHECK_EQUAL(nVersion, CLIENT_VERSION);
+
+    std::string strValue;
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("name"), std::string("a")), std::string("1")));
+    BOOST_CHECK(!batch->Write(std::make_pair(std::string("name"), std::string("a")), std::string("2"), false));
+    BOOST_CHECK(batch->Read(std::make_pair(std::string("name"), std::string("a")), strValue));
+    BOOST_CHECK_EQUAL(strValue, "1");
+
+    // Inside a transaction reads see the transaction's own writes, other batches don't see them before the commit
+    std::unique_ptr<DatabaseBatch> other = database.MakeBatch();
+    BOOST_CHECK(batch->TxnBegin());
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("name"), std::string("b")), std::string("3")));
+    BOOST_CHECK(batch->Erase(std::make_pair(std::string("name"), std::string("a"))));
+    BOOST_CHECK(batch->Exists(std::make_pair(std::string("name"), std::string("b"))));
+    BOOST_CHECK(!batch->Exists(std::make_pair(std::string("name"), std::string("a"))));
+    BOOST_CHECK(!other->Exists(std::make_pair(std::string("name"), std::string("b"))));
+    BOOST_CHECK(batch->TxnAbort());
+    BOOST_CHECK(batch->Exists(std::make_pair(std::string("name"), std::string("a"))));
+    BOOST_CHECK(!batch->Exists(std::make_pair(std::string("name"), std::string("b"))));
+
+    BOOST_CHECK(batch->TxnBegin());
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("name"), std::string("b")), std::string("3")));
+    BOOST_CHECK(batch->TxnCommit());
+    BOOST_CHECK(other->Read(std::make_pair(std::string("name"), std::string("b")), strValue));
+    BOOST_CHECK_EQUAL(strValue, "3");
+
+    // The cursor returns the records in key order, starting at the seek position
+    CDataStream ssStart(SER_DISK, CLIENT_VERSION);
+    ssStart << std::make_pair(std::string("name"), std::string("b"));
+    BOOST_CHECK(batch->SeekCursor(ssStart));
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION);
+    bool fComplete;
+    BOOST_CHECK(batch->ReadAtCursor(ssKey, ssValue, fComplete) && !fComplete);
+    std::pair<std::string, std::string> key;
+    ssKey >> key;
+    ssValue >> strValue;
+    BOOST_CHECK(key.second == "b" && strValue == "3");
+    BOOST_CHECK(batch->ReadAtCursor(ssKey, ssValue, fComplete) && !fComplete);
+    ssKey >> key.first;
+    BOOST_CHECK_EQUAL(key.first, "version");
+    BOOST_CHECK(batch->ReadAtCursor(ssKey, ssValue, fComplete) && fComplete);
+    batch->CloseCursor();
+}
+
+BOOST_AUTO_TEST_CASE(leveldb_walletbatch)
+{
+    fs::path wallet_path = SetDataDir("leveldb_walletbatch");
+    LevelDBDatabase database(wallet_path);
+
+    {
+        WalletBatch batch(database, "cr+");
+        CAccountingEntry acentry;
+        acentry.nCreditDebit = 1;
+        for (const char* strAccount : {"a", "b", "a"}) {
+            acentry.strAccount = strAccount;
+            BOOST_CHECK(batch.WriteAccountingEntry(acentry.nCreditDebit++, acentry));
+        }
+        BOOST_CHECK(batch.WritePool(1, CKeyPool()));
+        BOOST_CHECK(batch.WritePool(2, CKeyPool()));
+    }
+    BOOST_CHECK_EQUAL(database.nUpdateCounter.load(), 5U);
+
+    WalletBatch batch(database);
+    BOOST_CHECK_EQUAL(batch.GetAccountCreditDebit("a"), 4);
+    BOOST_CHECK_EQUAL(batch.GetAccountCreditDebit("b"), 2);
+    BOOST_CHECK_EQUAL(batch.GetAccountCreditDebit("*"), 6);
+
+    // Rewriting drops the skipped prefix only
+    BOOST_CHECK(database.Rewrite("\x04pool"));
+    CKeyPool keypool;
+    BOOST_CHECK(!batch.ReadPool(1, keypool));
+    BOOST_CHECK(!batch.ReadPool(2, keypool));
+    BOOST_CHECK_EQUAL(batch.GetAccountCreditDebit("*"), 6);
+
+    // Backups go into a new LevelDB directory which can be opened as a wallet
+    fs::path backup_path = SetDataDir("leveldb_walletbatch_backup");
+    BOOST_CHECK(database.Backup(backup_path.string()));
+    BOOST_CHECK(IsLevelDBWallet(backup_path));
+    BOOST_CHECK(!database.Backup(GetLevelDBWalletPath(wallet_path).string()));
+    {
+        LevelDBDatabase backup(backup_path);
+        BOOST_CHECK_EQUAL(WalletBatch(backup, "r").GetAccountCreditDebit("*"), 6);
+    }
+    // Backing up into an earlier backup replaces it
+    BOOST_CHECK(database.Backup(backup_path.string()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
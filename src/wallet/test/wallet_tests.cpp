@@ -8,11 +8,13 @@
 #include <memory>
 #include <set>
 #include <stdint.h>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <consensus/validation.h>
 #include <key_io.h>
+#include <policy/policy.h>
 #include <rpc/server.h>
 #include <test/test_dash.h>
 #include <validation.h>
@@ -112,6 +114,47 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+// Verify that the rescan finds the same transactions no matter how many threads read
+// and match the blocks, including transactions spending the found ones.
+BOOST_FIXTURE_TEST_CASE(rescan_threads, TestChain100Setup)
+{
+    // Spend one of the coinbases so that the last block has a tx which is only found through its input
+    CMutableTransaction spend;
+    spend.vin.emplace_back(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.emplace_back(coinbaseTxns[0].vout[0].nValue - 1000, CScript() << OP_TRUE);
+    std::vector<unsigned char> vchSig;
+    uint256 sighash = SignatureHash(coinbaseTxns[0].vout[0].scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(sighash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock({spend}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    LOCK(cs_main);
+
+    std::set<uint256> setFirstScan;
+    for (int nThreads : {1, 4}) {
+        gArgs.ForceSetArg("-rescanthreads", std::to_string(nThreads));
+        CWallet wallet(WalletLocation(), WalletDatabase::CreateDummy());
+        AddKey(wallet, coinbaseKey);
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        BOOST_CHECK(wallet.ScanForWalletTransactions(chainActive.Genesis(), nullptr, reserver) == nullptr);
+
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(wallet.mapWallet.size(), 102U);
+        BOOST_CHECK(wallet.mapWallet.count(spend.GetHash()));
+        std::set<uint256> setFound;
+        for (const auto& entry : wallet.mapWallet) {
+            setFound.emplace(entry.first);
+        }
+        if (setFirstScan.empty()) {
+            setFirstScan = setFound;
+        }
+        BOOST_CHECK(setFound == setFirstScan);
+    }
+    gArgs.ForceSetArg("-rescanthreads", std::to_string(DEFAULT_RESCAN_THREADS));
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
@@ -200,6 +243,43 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup)
     BOOST_CHECK_EQUAL(wtx.GetImmatureCredit(), 500*COIN);
 }
 
+// Check that IsMine finds outputs to all kinds of keys and scripts known to the wallet while
+// outputs of the prefiltered kinds which are not ours are rejected.
+BOOST_AUTO_TEST_CASE(ismine_script_pubkey_hashes)
+{
+    CKey key, otherKey, watchKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    watchKey.MakeNewKey(true);
+
+    CScript scriptKey = GetScriptForDestination(key.GetPubKey().GetID());
+    CScript scriptOther = GetScriptForDestination(otherKey.GetPubKey().GetID());
+    CScript scriptWatch = GetScriptForDestination(watchKey.GetPubKey().GetID());
+    CScript scriptRedeem = GetScriptForMultisig(1, {key.GetPubKey()});
+    CScript scriptP2SH = GetScriptForDestination(CScriptID(scriptRedeem));
+    CScript scriptOtherP2SH = GetScriptForDestination(CScriptID(GetScriptForMultisig(1, {otherKey.GetPubKey()})));
+
+    auto isMine = [&](const CScript& script) { return m_wallet.IsMine(CTxOut(1 * COIN, script)); };
+    BOOST_CHECK_EQUAL(isMine(scriptKey), ISMINE_NO);
+    BOOST_CHECK_EQUAL(isMine(scriptP2SH), ISMINE_NO);
+
+    LOCK(m_wallet.cs_wallet);
+    BOOST_CHECK(m_wallet.AddKeyPubKey(key, key.GetPubKey()));
+    BOOST_CHECK(m_wallet.AddCScript(scriptRedeem));
+    BOOST_CHECK(m_wallet.AddWatchOnly(scriptWatch, 0));
+
+    BOOST_CHECK_EQUAL(isMine(scriptKey), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(isMine(GetScriptForRawPubKey(key.GetPubKey())), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(isMine(scriptP2SH), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(isMine(scriptWatch), ISMINE_WATCH_UNSOLVABLE);
+    BOOST_CHECK_EQUAL(isMine(scriptOther), ISMINE_NO);
+    BOOST_CHECK_EQUAL(isMine(scriptOtherP2SH), ISMINE_NO);
+
+    // Keys loaded from the database are known as well
+    BOOST_CHECK(m_wallet.LoadKey(otherKey, otherKey.GetPubKey()));
+    BOOST_CHECK_EQUAL(isMine(scriptOther), ISMINE_SPENDABLE);
+}
+
 static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64_t blockTime)
 {
     CMutableTransaction tx;
@@ -208,12 +288,10 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
         LOCK(cs_main);
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        auto inserted = mapBlockIndex.emplace(GetRandHash());
         assert(inserted.second);
-        const uint256& hash = inserted.first->first;
         block = inserted.first->second;
         block->nTime = blockTime;
-        block->phashBlock = &hash;
     }
 
     CWalletTx wtx(&wallet, MakeTransactionRef(tx));
@@ -804,6 +882,199 @@ BOOST_FIXTURE_TEST_CASE(CreateTransactionTest, CreateTransactionTestSetup)
     }
 }
 
+// Check that the cached wallet balances are refreshed by wallet and chain events
+BOOST_FIXTURE_TEST_CASE(cached_balances, ListCoinsTestingSetup)
+{
+    // Check initial balance from one mature coinbase transaction.
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), 500 * COIN);
+    BOOST_CHECK_EQUAL(wallet->GetUnconfirmedBalance(), 0);
+    const CAmount nImmature = wallet->GetImmatureBalance();
+    BOOST_CHECK(nImmature > 0);
+
+    // A committed transaction is picked up right away, its change is trusted as it is in the mempool
+    CTransactionRef tx;
+    CReserveKey reservekey(wallet.get());
+    CAmount fee;
+    int changePos = -1;
+    std::string error;
+    CCoinControl dummy;
+    BOOST_CHECK(wallet->CreateTransaction({CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */}},
+                                        tx, reservekey, fee, changePos, error, dummy));
+    CValidationState state;
+    BOOST_CHECK(wallet->CommitTransaction(tx, {}, {}, {}, reservekey, nullptr, state));
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), 499 * COIN - fee);
+    BOOST_CHECK_EQUAL(wallet->GetBalance(ISMINE_SPENDABLE, 1), 0);
+    BOOST_CHECK_EQUAL(wallet->GetImmatureBalance(), nImmature);
+
+    // Connecting a block refreshes the depth dependent balances
+    CreateAndProcessBlock({CMutableTransaction(*tx)}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindexTip, Params().GetConsensus()));
+    wallet->BlockConnected(std::make_shared<const CBlock>(block), pindexTip, {});
+    BOOST_CHECK_EQUAL(wallet->GetBalance(ISMINE_SPENDABLE, 1), 499 * COIN - fee + 500 * COIN);
+    BOOST_CHECK_EQUAL(wallet->GetImmatureBalance(), nImmature);
+}
+
+/** Database which only counts its syncs */
+class SyncCountingDatabase : public WalletDatabase
+{
+public:
+    std::atomic<int> nSyncs{0};
+
+    std::unique_ptr<DatabaseBatch> MakeBatch(const char* pszMode, bool fFlushOnClose) override { return nullptr; }
+    bool Rewrite(const char* pszSkip) override { return true; }
+    bool Backup(const std::string& strDest) override { return false; }
+    void Flush(bool shutdown) override {}
+    bool PeriodicFlush() override { return true; }
+    void ReloadDbEnv() override {}
+    bool SyncWrites() override
+    {
+        MilliSleep(20);
+        ++nSyncs;
+        return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(group_sync)
+{
+    SyncCountingDatabase database;
+    BOOST_CHECK(database.GroupSync(0));
+    BOOST_CHECK_EQUAL(database.nSyncs, 1);
+
+    // Concurrent writers share syncs
+    std::vector<std::thread> threads;
+    std::atomic<int> nSynced{0};
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&] {
+            if (database.GroupSync(100)) ++nSynced;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(nSynced, 8);
+    BOOST_CHECK(database.nSyncs < 8);
+}
+
+BOOST_FIXTURE_TEST_CASE(group_commit, ListCoinsTestingSetup)
+{
+    gArgs.ForceSetArg("-walletcommitdelay", "10");
+
+    CTransactionRef tx;
+    CReserveKey reservekey(wallet.get());
+    CAmount fee;
+    int changePos = -1;
+    std::string error;
+    CCoinControl dummy;
+    BOOST_CHECK(wallet->CreateTransaction({CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */}},
+                                        tx, reservekey, fee, changePos, error, dummy));
+    CValidationState state;
+    BOOST_CHECK(wallet->CommitTransaction(tx, {}, {}, {}, reservekey, nullptr, state));
+
+    // The transaction was written in one database transaction and synced before CommitTransaction returned
+    std::vector<uint256> vTxHash;
+    std::vector<CWalletTx> vWtx;
+    WalletBatch batch(wallet->GetDBHandle());
+    BOOST_CHECK(batch.FindWalletTx(vTxHash, vWtx) == DBErrors::LOAD_OK);
+    BOOST_CHECK(std::find(vTxHash.begin(), vTxHash.end(), tx->GetHash()) != vTxHash.end());
+
+    gArgs.ForceSetArg("-walletcommitdelay", "0");
+}
+
+BOOST_AUTO_TEST_CASE(sign_transaction_inputs)
+{
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    CScript scriptRedeem = GetScriptForMultisig(1, {key.GetPubKey()});
+    const std::vector<CScript> vScripts{GetScriptForDestination(key.GetPubKey().GetID()), GetScriptForRawPubKey(key.GetPubKey()),
+                                        GetScriptForDestination(CScriptID(scriptRedeem))};
+    LOCK(m_wallet.cs_wallet);
+    BOOST_CHECK(m_wallet.AddKeyPubKey(key, key.GetPubKey()));
+    BOOST_CHECK(m_wallet.AddCScript(scriptRedeem));
+
+    // Enough inputs to be signed in parallel, one of them we can't sign
+    const unsigned int nInputs = PARALLEL_SIGN_MIN_INPUTS * 2;
+    const unsigned int nForeignInput = 7;
+    CMutableTransaction tx;
+    std::vector<std::pair<unsigned int, CTxOut>> vInputs;
+    for (unsigned int i = 0; i < nInputs; i++) {
+        tx.vin.emplace_back(COutPoint(InsecureRand256(), i));
+        CScript scriptPubKey = i == nForeignInput ? GetScriptForDestination(otherKey.GetPubKey().GetID()) : vScripts[i % vScripts.size()];
+        vInputs.emplace_back(i, CTxOut(1 * COIN, scriptPubKey));
+    }
+    tx.vout.emplace_back(1 * COIN, GetScriptForDestination(otherKey.GetPubKey().GetID()));
+
+    std::set<unsigned int> setFailed;
+    CMutableTransaction txParallel(tx);
+    BOOST_CHECK(!m_wallet.SignTransactionInputs(txParallel, vInputs, SIGHASH_ALL, &setFailed));
+    BOOST_CHECK(setFailed == std::set<unsigned int>{nForeignInput});
+    BOOST_CHECK(txParallel.vin[nForeignInput].scriptSig.empty());
+    for (const auto& input : vInputs) {
+        if (input.first == nForeignInput) continue;
+        BOOST_CHECK(VerifyScript(txParallel.vin[input.first].scriptSig, input.second.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS,
+                                 MutableTransactionSignatureChecker(&txParallel, input.first, input.second.nValue), nullptr));
+    }
+
+    // Signatures are deterministic, so signing a few inputs at a time (sequentially) gives the same result
+    CMutableTransaction txSequential(tx);
+    for (size_t i = 0; i < vInputs.size(); i += PARALLEL_SIGN_MIN_INPUTS - 1) {
+        std::vector<std::pair<unsigned int, CTxOut>> vSome(vInputs.begin() + i, vInputs.begin() + std::min(vInputs.size(), i + PARALLEL_SIGN_MIN_INPUTS - 1));
+        m_wallet.SignTransactionInputs(txSequential, vSome);
+    }
+    BOOST_CHECK(CTransaction(txSequential).GetHash() == CTransaction(txParallel).GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(keypool_topup_hd)
+{
+    CHDChain hdChain;
+    BOOST_CHECK(hdChain.SetMnemonic(SecureString(), SecureString(), true));
+    const size_t nSize = KEYPOOL_BATCH_SIZE + 10;
+    {
+        LOCK(m_wallet.cs_wallet);
+        BOOST_CHECK(m_wallet.SetHDChainSingle(hdChain, false));
+
+        // Keys are derived in batches, they are the ones which are derived one at a time
+        BOOST_CHECK(m_wallet.TopUpKeyPool(nSize));
+        BOOST_CHECK_EQUAL(m_wallet.KeypoolCountExternalKeys(), nSize);
+        BOOST_CHECK_EQUAL(m_wallet.KeypoolCountInternalKeys(), nSize);
+        for (bool fInternal : {false, true}) {
+            for (uint32_t nChild : {(uint32_t)0, (uint32_t)KEYPOOL_BATCH_SIZE, (uint32_t)nSize - 1}) {
+                CExtKey extKey;
+                hdChain.DeriveChildExtKey(0, fInternal, nChild, extKey);
+                BOOST_CHECK(m_wallet.GetAllReserveKeys().count(extKey.key.GetPubKey().GetID()));
+            }
+        }
+        CHDChain hdChainCurrent;
+        CHDAccount acc;
+        BOOST_CHECK(m_wallet.GetHDChain(hdChainCurrent) && hdChainCurrent.GetAccount(0, acc));
+        BOOST_CHECK_EQUAL(acc.nExternalChainCounter, nSize);
+        BOOST_CHECK_EQUAL(acc.nInternalChainCounter, nSize);
+    }
+
+    // Keys beyond the foreground size are added in the background
+    gArgs.ForceSetArg("-keypool", std::to_string(nSize + 10));
+    BOOST_CHECK(m_wallet.TopUpKeyPool());
+    for (int i = 0; i < 1000; i++) {
+        {
+            LOCK(m_wallet.cs_wallet);
+            if (m_wallet.KeypoolCountInternalKeys() == nSize + 10) break;
+        }
+        MilliSleep(10);
+    }
+    {
+        LOCK(m_wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(m_wallet.KeypoolCountExternalKeys(), nSize + 10);
+        BOOST_CHECK_EQUAL(m_wallet.KeypoolCountInternalKeys(), nSize + 10);
+    }
+    gArgs.ForceRemoveArg("-keypool");
+}
+
 // Check SelectCoinsGroupedByAddresses() behaviour
 BOOST_FIXTURE_TEST_CASE(select_coins_grouped_by_addresses, ListCoinsTestingSetup)
 {
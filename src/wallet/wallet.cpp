@@ -11,6 +11,7 @@
 #include <wallet/coinselection.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <ctpl.h>
 #include <fs.h>
 #include <init.h>
 #include <key.h>
@@ -27,6 +28,7 @@
 #include <timedata.h>
 #include <txmempool.h>
 #include <utilmoneystr.h>
+#include <wallet/db_leveldb.h>
 #include <wallet/fees.h>
 
 #include <coinjoin/coinjoin-client.h>
@@ -114,6 +116,7 @@ CFeeRate CWallet::m_discard_rate = CFeeRate(DEFAULT_DISCARD_FEE);
 static void ReleaseWallet(CWallet* wallet)
 {
     LogPrintf("Releasing wallet %s\n", wallet->GetName());
+    wallet->StopKeyPoolTopUp();
     wallet->BlockUntilSyncedToCurrentChain();
     wallet->Flush();
     delete wallet;
@@ -198,8 +201,7 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, uint32_t nAccountIndex, bool
     CPubKey pubkey;
     // use HD key derivation if HD was enabled during wallet creation
     if (IsHDEnabled()) {
-        DeriveNewChildKey(batch, metadata, secret, nAccountIndex, fInternal);
-        pubkey = secret.GetPubKey();
+        pubkey = DeriveNewChildKeys(batch, metadata, nAccountIndex, fInternal, 1).front();
     } else {
         secret.MakeNewKey(fCompressed);
 
@@ -222,7 +224,7 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, uint32_t nAccountIndex, bool
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal)
+std::vector<CPubKey> CWallet::DeriveNewChildKeys(WalletBatch &batch, const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, unsigned int nCount)
 {
     CHDChain hdChainTmp;
     if (!GetHDChain(hdChainTmp)) {
@@ -239,24 +241,36 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata
     if (!hdChainTmp.GetAccount(nAccountIndex, acc))
         throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
 
-    // derive child key at next index, skip keys already known to the wallet
-    CExtKey childKey;
+    // derive the keys from m/purpose'/coin_type'/account'/change, which is the same for all of them
+    CExtKey changeKey;
+    hdChainTmp.DeriveChangeExtKey(nAccountIndex, fInternal, changeKey);
+
+    // derive child keys at the next indexes, skip keys already known to the wallet
+    std::vector<CPubKey> vPubKeys;
+    vPubKeys.reserve(nCount);
     uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
-    do {
-        hdChainTmp.DeriveChildExtKey(nAccountIndex, fInternal, nChildIndex, childKey);
+    while (vPubKeys.size() < nCount) {
+        CExtKey childKey;
+        changeKey.Derive(childKey, nChildIndex);
         // increment childkey index
         nChildIndex++;
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secretRet = childKey.key;
 
-    CPubKey pubkey = secretRet.GetPubKey();
-    assert(secretRet.VerifyPubKey(pubkey));
+        CExtPubKey childPubKey = childKey.Neuter();
+        if (HaveKey(childPubKey.pubkey.GetID())) {
+            continue;
+        }
+        assert(childKey.key.VerifyPubKey(childPubKey.pubkey));
+
+        // store metadata
+        mapKeyMetadata[childPubKey.pubkey.GetID()] = metadata;
 
-    // store metadata
-    mapKeyMetadata[pubkey.GetID()] = metadata;
+        if (!AddHDPubKey(batch, childPubKey, fInternal))
+            throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+        vPubKeys.push_back(childPubKey.pubkey);
+    }
     UpdateTimeFirstKey(metadata.nCreateTime);
 
-    // update the chain model in the database
+    // update the chain model in the database, once for all derived keys
     CHDChain hdChainCurrent;
     GetHDChain(hdChainCurrent);
 
@@ -279,8 +293,7 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata
             throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
     }
 
-    if (!AddHDPubKey(batch, childKey.Neuter(), fInternal))
-        throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+    return vPubKeys;
 }
 
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
@@ -333,11 +346,23 @@ bool CWallet::HaveKey(const CKeyID &address) const
     return CCryptoKeyStore::HaveKey(address);
 }
 
+uint64_t CWallet::GetScriptPubKeyHash(const CScript& script) const
+{
+    return CSipHasher(scriptPubKeyHashSalt.k0, scriptPubKeyHashSalt.k1).Write(script.data(), script.size()).Finalize();
+}
+
+void CWallet::AddScriptPubKeyHash(const CScript& script)
+{
+    LOCK(cs_KeyStore);
+    setScriptPubKeyHashes.emplace(GetScriptPubKeyHash(script));
+}
+
 bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
 {
     AssertLockHeld(cs_wallet);
 
     mapHdPubKeys[hdPubKey.extPubKey.pubkey.GetID()] = hdPubKey;
+    AddScriptPubKeyHash(GetScriptForDestination(hdPubKey.extPubKey.pubkey.GetID()));
     return true;
 }
 
@@ -353,6 +378,7 @@ bool CWallet::AddHDPubKey(WalletBatch &batch, const CExtPubKey &extPubKey, bool
     hdPubKey.hdchainID = hdChainCurrent.GetID();
     hdPubKey.nChangeIndex = fInternal ? 1 : 0;
     mapHdPubKeys[extPubKey.pubkey.GetID()] = hdPubKey;
+    AddScriptPubKeyHash(GetScriptForDestination(extPubKey.pubkey.GetID()));
 
     // check if we need to remove from watch-only
     CScript script;
@@ -382,6 +408,7 @@ bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const C
         return false;
     }
     if (needsDB) encrypted_batch = nullptr;
+    AddScriptPubKeyHash(GetScriptForDestination(pubkey.GetID()));
     // check if we need to remove from watch-only
     CScript script;
     script = GetScriptForDestination(pubkey.GetID());
@@ -409,11 +436,20 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     return CWallet::AddKeyPubKeyWithDB(batch, secret, pubkey);
 }
 
+bool CWallet::LoadKey(const CKey& key, const CPubKey &pubkey)
+{
+    if (!CCryptoKeyStore::AddKeyPubKey(key, pubkey))
+        return false;
+    AddScriptPubKeyHash(GetScriptForDestination(pubkey.GetID()));
+    return true;
+}
+
 bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
                             const std::vector<unsigned char> &vchCryptedSecret)
 {
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
+    AddScriptPubKeyHash(GetScriptForDestination(vchPubKey.GetID()));
     {
         LOCK(cs_wallet);
         if (encrypted_batch)
@@ -445,7 +481,10 @@ bool CWallet::LoadScriptMetadata(const CScriptID& script_id, const CKeyMetadata
 
 bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
-    return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
+    if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
+        return false;
+    AddScriptPubKeyHash(GetScriptForDestination(vchPubKey.GetID()));
+    return true;
 }
 
 /**
@@ -474,6 +513,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    AddScriptPubKeyHash(GetScriptForDestination(CScriptID(redeemScript)));
     return WalletBatch(*database).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
@@ -490,13 +530,17 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
-    return CCryptoKeyStore::AddCScript(redeemScript);
+    if (!CCryptoKeyStore::AddCScript(redeemScript))
+        return false;
+    AddScriptPubKeyHash(GetScriptForDestination(CScriptID(redeemScript)));
+    return true;
 }
 
 bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    AddScriptPubKeyHash(dest);
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -524,7 +568,10 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
 
 bool CWallet::LoadWatchOnly(const CScript &dest)
 {
-    return CCryptoKeyStore::AddWatchOnly(dest);
+    if (!CCryptoKeyStore::AddWatchOnly(dest))
+        return false;
+    AddScriptPubKeyHash(dest);
+    return true;
 }
 
 bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool fForMixingOnly)
@@ -713,6 +760,9 @@ std::set<uint256> CWallet::GetConflicts(const uint256& txid) const
 
 void CWallet::Flush(bool shutdown)
 {
+    if (shutdown) {
+        StopKeyPoolTopUp();
+    }
     database->Flush(shutdown);
 }
 
@@ -779,10 +829,65 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+CWallet::WalletUTXOType CWallet::GetWalletUTXOType(CAmount nValue)
+{
+    if (CCoinJoin::IsDenominatedAmount(nValue)) {
+        return UTXO_DENOMINATED;
+    }
+    if (CCoinJoin::IsCollateralAmount(nValue)) {
+        return UTXO_COINJOIN_COLLATERAL;
+    }
+    if (nValue == 1000 * COIN) {
+        return UTXO_MASTERNODE_COLLATERAL;
+    }
+    return UTXO_OTHER;
+}
+
+bool CWallet::AddWalletUTXO(const COutPoint& outpoint, CAmount nValue)
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!setWalletUTXO.insert(outpoint).second) {
+        return false;
+    }
+    arrWalletUTXOByType[GetWalletUTXOType(nValue)].insert(outpoint);
+    return true;
+}
+
+void CWallet::EraseWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+
+    if (setWalletUTXO.erase(outpoint) == 0) {
+        return;
+    }
+    for (auto& setUTXO : arrWalletUTXOByType) {
+        if (setUTXO.erase(outpoint) != 0) {
+            break;
+        }
+    }
+}
+
+void CWallet::RestoreWalletUTXOs(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+
+    for (const CTxIn& txin : wtx.tx->vin) {
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it == mapWallet.end() || txin.prevout.n >= it->second.tx->vout.size()) {
+            continue;
+        }
+        const CTxOut& txout = it->second.tx->vout[txin.prevout.n];
+        if (IsMine(txout) && !IsSpent(txin.prevout.hash, txin.prevout.n)) {
+            AddWalletUTXO(txin.prevout, txout.nValue);
+        }
+    }
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    EraseWalletUTXO(outpoint);
 
     setLockedCoins.erase(outpoint);
 
@@ -1100,19 +1205,21 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        MarkBalancesDirty();
     }
-
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
+{
+    WalletBatch batch(*database, "r+", fFlushOnClose);
+    return AddToWallet(wtxIn, batch);
+}
+
+bool CWallet::AddToWallet(const CWalletTx& wtxIn, WalletBatch& batch)
 {
     AssertLockHeld(cs_main); // detect potential deadlocks which might be caused by GetListAtChainTip and IsSpent below
     LOCK(cs_wallet);
 
-    WalletBatch batch(*database, "r+", fFlushOnClose);
-
     uint256 hash = wtxIn.GetHash();
 
     // Inserts only if not already there, returns tx inserted or tx found
@@ -1126,11 +1233,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
+        // outputs of this transaction might already have been looked at while it was missing
+        InvalidateCoinJoinRounds(hash, batch);
 
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i].nValue);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1167,7 +1276,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                bool new_utxo = setWalletUTXO.insert(COutPoint(hash, i)).second;
+                bool new_utxo = AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i].nValue);
                 if (new_utxo && (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i)))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1200,8 +1309,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         t.detach(); // thread runs free
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 
     return true;
 }
@@ -1300,7 +1408,8 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
                 }
             }
 
-            CWalletTx wtx(this, ptx);
+            // don't keep the whole arena of a block alive for one transaction
+            CWalletTx wtx(this, IsArenaTransaction(ptx) ? MakeTransactionRef(*ptx) : ptx);
 
             // Get merkle branch if transaction was found in a block
             if (pIndex != nullptr)
@@ -1374,11 +1483,11 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                     it->second.MarkDirty();
                 }
             }
+            RestoreWalletUTXOs(wtx);
         }
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 
     return true;
 }
@@ -1438,11 +1547,11 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
                     it->second.MarkDirty();
                 }
             }
+            RestoreWalletUTXOs(wtx);
         }
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pindex, int posInBlock) {
@@ -1461,8 +1570,7 @@ void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pin
         }
     }
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime) {
@@ -1472,6 +1580,7 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcc
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        MarkBalancesDirty();
     }
 }
 
@@ -1481,6 +1590,7 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolR
         auto it = mapWallet.find(ptx->GetHash());
         if (it != mapWallet.end()) {
             it->second.fInMempool = false;
+            MarkBalancesDirty();
         }
     }
 }
@@ -1536,8 +1646,7 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
     hashPrevBestCoinbase = pblock->vtx[0]->GetHash();
 
     // reset cache to make sure no longer immature coins are included
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected) {
@@ -1549,8 +1658,7 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, con
     }
 
     // reset cache to make sure no longer mature coins are excluded
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 
@@ -1613,11 +1721,39 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
     return 0;
 }
 
-// Recursively determine the rounds of a given input (How deep is the CoinJoin chain for a given input)
-int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRounds) const
+// Values which don't depend on whether some transaction is missing can be persisted
+static bool IsPersistentCoinJoinRounds(int nRounds)
+{
+    return nRounds >= -3 && nRounds != -1;
+}
+
+int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint) const
 {
     LOCK(cs_wallet);
 
+    std::vector<COutPoint> vecNewOutpoints;
+    int nRoundsRet = GetRealOutpointCoinJoinRounds(outpoint, 0, vecNewOutpoints);
+
+    // store everything we calculated on the way so that we don't have to walk the chain again after a restart
+    const int nRoundsMax = MAX_COINJOIN_ROUNDS + CCoinJoinClientOptions::GetRandomRounds();
+    std::unique_ptr<WalletBatch> batch;
+    for (const auto& newOutpoint : vecNewOutpoints) {
+        int nRounds = mapOutpointRoundsCache.at(newOutpoint);
+        if (!IsPersistentCoinJoinRounds(nRounds)) continue;
+        if (!batch) {
+            batch = MakeUnique<WalletBatch>(*database);
+        }
+        batch->WriteCoinJoinRounds(newOutpoint, nRoundsMax, nRounds);
+    }
+
+    return nRoundsRet;
+}
+
+// Recursively determine the rounds of a given input (How deep is the CoinJoin chain for a given input)
+int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRounds, std::vector<COutPoint>& vecNewOutpointsRet) const
+{
+    AssertLockHeld(cs_wallet);
+
     const int nRoundsMax = MAX_COINJOIN_ROUNDS + CCoinJoinClientOptions::GetRandomRounds();
 
     if (nRounds >= nRoundsMax) {
@@ -1631,6 +1767,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
         // we already processed it, just return what we have
         return *nRoundsRef;
     }
+    vecNewOutpointsRet.emplace_back(outpoint);
 
     // TODO wtx should refer to a CWalletTx object, not a pointer, based on surrounding code
     const CWalletTx* wtx = GetWalletTx(outpoint.hash);
@@ -1679,7 +1816,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
     // only denoms here so let's look up
     for (const auto& txinNext : wtx->tx->vin) {
         if (IsMine(txinNext)) {
-            int n = GetRealOutpointCoinJoinRounds(txinNext.prevout, nRounds + 1);
+            int n = GetRealOutpointCoinJoinRounds(txinNext.prevout, nRounds + 1, vecNewOutpointsRet);
             // denom found, find the shortest chain or initially assign nShortest with the first found value
             if(n >= 0 && (n < nShortest || nShortest == -10)) {
                 nShortest = n;
@@ -1694,6 +1831,44 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
     return *nRoundsRef;
 }
 
+void CWallet::InvalidateCoinJoinRounds(const uint256& hashTx, WalletBatch& batch)
+{
+    AssertLockHeld(cs_wallet);
+
+    std::set<uint256> setVisited;
+    std::vector<uint256> vecToVisit{hashTx};
+    while (!vecToVisit.empty()) {
+        uint256 hash = vecToVisit.back();
+        vecToVisit.pop_back();
+        if (!setVisited.emplace(hash).second) {
+            continue;
+        }
+
+        auto it = mapOutpointRoundsCache.lower_bound(COutPoint(hash, 0));
+        while (it != mapOutpointRoundsCache.end() && it->first.hash == hash) {
+            if (IsPersistentCoinJoinRounds(it->second)) {
+                batch.EraseCoinJoinRounds(it->first);
+            }
+            it = mapOutpointRoundsCache.erase(it);
+        }
+
+        // the rounds of spending transactions were calculated from the ones of this transaction (or without it)
+        for (auto itSpend = mapTxSpends.lower_bound(COutPoint(hash, 0)); itSpend != mapTxSpends.end() && itSpend->first.hash == hash; ++itSpend) {
+            vecToVisit.emplace_back(itSpend->second);
+        }
+    }
+}
+
+void CWallet::LoadCoinJoinRounds(const COutPoint& outpoint, int nRoundsMax, int nRounds)
+{
+    AssertLockHeld(cs_wallet);
+
+    // values calculated with a different maximum are recalculated
+    if (nRoundsMax == MAX_COINJOIN_ROUNDS + CCoinJoinClientOptions::GetRandomRounds()) {
+        mapOutpointRoundsCache.emplace(outpoint, nRounds);
+    }
+}
+
 // respect current settings
 int CWallet::GetCappedOutpointCoinJoinRounds(const COutPoint& outpoint) const
 {
@@ -1743,6 +1918,13 @@ bool CWallet::IsFullyMixed(const COutPoint& outpoint) const
 
 isminetype CWallet::IsMine(const CTxOut& txout) const
 {
+    // P2PKH and P2SH outputs can only be ours if their script is one of setScriptPubKeyHashes
+    if (txout.scriptPubKey.IsPayToPublicKeyHash() || txout.scriptPubKey.IsPayToScriptHash()) {
+        LOCK(cs_KeyStore);
+        if (!setScriptPubKeyHashes.count(GetScriptPubKeyHash(txout.scriptPubKey))) {
+            return ISMINE_NO;
+        }
+    }
     return ::IsMine(*this, txout.scriptPubKey);
 }
 
@@ -2191,6 +2373,9 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
  */
 CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlockIndex* pindexStop, const WalletRescanReserver &reserver, bool fUpdate)
 {
+    // the block matchers need cs_wallet for key lookups
+    AssertLockNotHeld(cs_wallet);
+
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
@@ -2204,6 +2389,49 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
 
     if (pindex) LogPrintf("Rescan started from block %d...\n", pindex->nHeight);
 
+    // Blocks are read from disk and matched against our keys by a pool of workers, ahead of
+    // the position of the scan. The results are applied to the wallet in block order.
+    struct ScanBlock {
+        CBlockIndex* pindex;
+        std::future<bool> fRead;
+        CBlock block;
+        std::vector<bool> vMatched;
+        int64_t nKeyPoolIndex{0};
+    };
+
+    int nThreads = gArgs.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if (nThreads <= 0) {
+        nThreads = GetNumCores();
+    }
+    nThreads = std::max(1, std::min(nThreads, MAX_RESCAN_THREADS));
+
+    auto readAndMatch = [this, &chainParams](ScanBlock& scanBlock) {
+        if (!ReadBlockFromDisk(scanBlock.block, scanBlock.pindex, chainParams.GetConsensus())) {
+            return false;
+        }
+        {
+            // Keys are only added together with the keypool index, see TopUpKeyPool. If the
+            // index changed when the block is applied, the matches have to be redone.
+            LOCK(cs_wallet);
+            scanBlock.nKeyPoolIndex = m_max_keypool_index;
+        }
+        scanBlock.vMatched.reserve(scanBlock.block.vtx.size());
+        for (const auto& tx : scanBlock.block.vtx) {
+            scanBlock.vMatched.emplace_back(IsMine(*tx));
+        }
+        return true;
+    };
+
+    // Transactions which don't pay to us can still be ours (spending our coins) or conflict with ours
+    auto isRelevant = [this](const CTransaction& tx) {
+        AssertLockHeld(cs_wallet);
+        if (mapWallet.count(tx.GetHash())) return true;
+        for (const CTxIn& txin : tx.vin) {
+            if (mapTxSpends.count(txin.prevout) || mapWallet.count(txin.prevout.hash)) return true;
+        }
+        return false;
+    };
+
     {
         fAbortRescan = false;
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
@@ -2221,6 +2449,33 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             }
         }
         double progress_current = progress_begin;
+
+        const size_t nMaxPrefetch = nThreads * RESCAN_PREFETCH_BLOCKS_PER_THREAD;
+        std::deque<std::unique_ptr<ScanBlock>> queue;
+        CBlockIndex* pindexNextRead = pindex;
+        // declared after the queue so that it is stopped before the queued blocks go away
+        ctpl::thread_pool workerPool(nThreads);
+        RenameThreadPool(workerPool, "dash-rescan");
+        auto prefetch = [&]() {
+            while (pindexNextRead && queue.size() < nMaxPrefetch) {
+                std::unique_ptr<ScanBlock> scanBlock = MakeUnique<ScanBlock>();
+                scanBlock->pindex = pindexNextRead;
+                ScanBlock* pScanBlock = scanBlock.get();
+                scanBlock->fRead = workerPool.push([&readAndMatch, pScanBlock](int) { return readAndMatch(*pScanBlock); });
+                queue.emplace_back(std::move(scanBlock));
+                if (pindexNextRead == pindexStop) {
+                    pindexNextRead = nullptr;
+                    break;
+                }
+                LOCK(cs_main);
+                pindexNextRead = chainActive.Next(pindexNextRead);
+            }
+        };
+
+        int64_t nTimeStart = GetTimeMillis();
+        int64_t nScannedBlocks = 0;
+        int64_t nScannedTxs = 0;
+        prefetch();
         while (pindex && !fAbortRescan && !ShutdownRequested())
         {
             m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
@@ -2229,11 +2484,18 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             }
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, progress_current);
+                double nSeconds = std::max<int64_t>(1, GetTimeMillis() - nTimeStart) * 0.001;
+                LogPrintf("Still rescanning. At block %d. Progress=%f (%.1f blocks/s, %.1f txs/s)\n", pindex->nHeight, progress_current,
+                          nScannedBlocks / nSeconds, nScannedTxs / nSeconds);
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            assert(!queue.empty() && queue.front()->pindex == pindex);
+            std::unique_ptr<ScanBlock> scanBlock = std::move(queue.front());
+            queue.pop_front();
+            prefetch();
+
+            if (scanBlock->fRead.get()) {
+                const CBlock& block = scanBlock->block;
                 LOCK2(cs_main, cs_wallet);
                 if (pindex && !chainActive.Contains(pindex)) {
                     // Abort scan if current block is no longer active, to prevent
@@ -2242,11 +2504,17 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                     break;
                 }
                 for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                    // new keys may have been added to the keypool by transactions found since the block was matched
+                    bool fMatched = scanBlock->vMatched[posInBlock] || scanBlock->nKeyPoolIndex != m_max_keypool_index;
+                    if (fMatched || isRelevant(*block.vtx[posInBlock])) {
+                        AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                    }
                 }
+                nScannedTxs += block.vtx.size();
             } else {
                 ret = pindex;
             }
+            nScannedBlocks++;
             if (pindex == pindexStop) {
                 break;
             }
@@ -2260,7 +2528,24 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                     progress_end = GuessVerificationProgress(chainParams.TxData(), tip);
                 }
             }
+            if (pindex && (queue.empty() || queue.front()->pindex != pindex)) {
+                // the tip moved after the last block was queued or the chain was reorganized
+                // below the blocks we read ahead, start over from here
+                workerPool.clear_queue();
+                for (auto& queued : queue) {
+                    if (queued->fRead.valid()) queued->fRead.wait();
+                }
+                queue.clear();
+                pindexNextRead = pindex;
+                prefetch();
+            }
         }
+        workerPool.clear_queue();
+        workerPool.stop(true);
+
+        int64_t nTime = GetTimeMillis() - nTimeStart;
+        LogPrintf("Rescan processed %d blocks with %d transactions using %d threads in %dms (%.1f blocks/s)\n",
+                  nScannedBlocks, nScannedTxs, nThreads, nTime, nScannedBlocks * 1000.0 / std::max<int64_t>(1, nTime));
         if (pindex && fAbortRescan) {
             LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, progress_current);
         } else if (pindex && ShutdownRequested()) {
@@ -2692,19 +2977,38 @@ std::unordered_set<const CWalletTx*, WalletTxHasher> CWallet::GetSpendableTXs()
     return ret;
 }
 
+void CWallet::MarkBalancesDirty() const
+{
+    AssertLockHeld(cs_wallet);
+    fAnonymizableTallyCached = false;
+    fAnonymizableTallyCachedNonDenom = false;
+    mapBalanceCache.clear();
+}
+
+CAmount CWallet::GetCachedBalance(const BalanceCacheKey& key, const std::function<CAmount()>& calc) const
+{
+    AssertLockHeld(cs_wallet);
+    auto it = mapBalanceCache.find(key);
+    if (it != mapBalanceCache.end()) {
+        return it->second;
+    }
+    CAmount nTotal = calc();
+    mapBalanceCache.emplace(key, nTotal);
+    return nTotal;
+}
+
 CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth, const bool fAddLocked) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalance(BalanceCacheKey{BalanceType::TRUSTED, filter, min_depth, fAddLocked}, [&]() {
+        CAmount nTotal = 0;
         for (auto pcoin : GetSpendableTXs()) {
             if (pcoin->IsTrusted() && ((pcoin->GetDepthInMainChain() >= min_depth) || (fAddLocked && pcoin->IsLockedByInstantSend()))) {
                 nTotal += pcoin->GetAvailableCredit(true, filter);
             }
         }
-    }
-
-    return nTotal;
+        return nTotal;
+    });
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -2733,15 +3037,22 @@ CAmount CWallet::GetAnonymizedBalance(const CCoinControl* coinControl) const
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
 
-    for (auto pcoin : GetSpendableTXs()) {
-        nTotal += pcoin->GetAnonymizedCredit(coinControl);
-    }
+    auto calc = [&]() {
+        CAmount nTotal = 0;
+        for (auto pcoin : GetSpendableTXs()) {
+            nTotal += pcoin->GetAnonymizedCredit(coinControl);
+        }
+        return nTotal;
+    };
 
-    return nTotal;
+    // the result depends on the selected coins, so only the plain balance is cached
+    if (coinControl != nullptr) {
+        return calc();
+    }
+    // the number of rounds can be changed at runtime (setcoinjoinrounds), make it part of the key
+    return GetCachedBalance(BalanceCacheKey{BalanceType::ANONYMIZED, ISMINE_SPENDABLE, CCoinJoinClientOptions::GetRounds(), false}, calc);
 }
 
 // Note: calculated including unconfirmed,
@@ -2794,65 +3105,64 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
-
-    for (auto pcoin : GetSpendableTXs()) {
-        nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-    }
-
-    return nTotal;
+    return GetCachedBalance(BalanceCacheKey{BalanceType::DENOMINATED, ISMINE_SPENDABLE, 0, unconfirmed}, [&]() {
+        CAmount nTotal = 0;
+        for (auto pcoin : GetSpendableTXs()) {
+            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
+        }
+        return nTotal;
+    });
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalance(BalanceCacheKey{BalanceType::UNCONFIRMED, ISMINE_SPENDABLE, 0, false}, [&]() {
+        CAmount nTotal = 0;
         for (auto pcoin : GetSpendableTXs()) {
             if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit();
         }
-    }
-    return nTotal;
+        return nTotal;
+    });
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalance(BalanceCacheKey{BalanceType::IMMATURE, ISMINE_SPENDABLE, 0, false}, [&]() {
+        CAmount nTotal = 0;
         for (auto pcoin : GetSpendableTXs()) {
             nTotal += pcoin->GetImmatureCredit();
         }
-    }
-    return nTotal;
+        return nTotal;
+    });
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalance(BalanceCacheKey{BalanceType::UNCONFIRMED_WATCH_ONLY, ISMINE_WATCH_ONLY, 0, false}, [&]() {
+        CAmount nTotal = 0;
         for (auto pcoin : GetSpendableTXs()) {
             if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit(true, ISMINE_WATCH_ONLY);
         }
-    }
-    return nTotal;
+        return nTotal;
+    });
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalance(BalanceCacheKey{BalanceType::IMMATURE_WATCH_ONLY, ISMINE_WATCH_ONLY, 0, false}, [&]() {
+        CAmount nTotal = 0;
         for (auto pcoin : GetSpendableTXs()) {
             nTotal += pcoin->GetImmatureWatchOnlyCredit();
         }
-    }
-    return nTotal;
+        return nTotal;
+    });
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2923,8 +3233,43 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
 
     CAmount nTotal = 0;
 
-    for (auto pcoin : GetSpendableTXs()) {
-        const uint256& wtxid = pcoin->GetHash();
+    // only look at unspent outputs of the requested kind instead of every output of every transaction
+    std::vector<COutPoint> vecCandidates;
+    auto addCandidates = [&](WalletUTXOType nType) {
+        vecCandidates.insert(vecCandidates.end(), arrWalletUTXOByType[nType].begin(), arrWalletUTXOByType[nType].end());
+    };
+    switch (nCoinType) {
+    case CoinType::ONLY_FULLY_MIXED:
+    case CoinType::ONLY_READY_TO_MIX:
+        addCandidates(UTXO_DENOMINATED);
+        break;
+    case CoinType::ONLY_NONDENOMINATED:
+        addCandidates(UTXO_MASTERNODE_COLLATERAL);
+        addCandidates(UTXO_OTHER);
+        break;
+    case CoinType::ONLY_MASTERNODE_COLLATERAL:
+        addCandidates(UTXO_MASTERNODE_COLLATERAL);
+        break;
+    case CoinType::ONLY_COINJOIN_COLLATERAL:
+        addCandidates(UTXO_COINJOIN_COLLATERAL);
+        break;
+    default:
+        vecCandidates.assign(setWalletUTXO.begin(), setWalletUTXO.end());
+        break;
+    }
+    // keep the outputs of a transaction next to each other, so that the checks per transaction run only once
+    std::sort(vecCandidates.begin(), vecCandidates.end());
+
+    for (auto itCandidate = vecCandidates.begin(); itCandidate != vecCandidates.end(); ) {
+        const uint256 wtxid = itCandidate->hash;
+        auto itTxEnd = std::find_if(itCandidate, vecCandidates.end(), [&wtxid](const COutPoint& outpoint) { return outpoint.hash != wtxid; });
+        auto itTxBegin = itCandidate;
+        itCandidate = itTxEnd;
+
+        auto itWallet = mapWallet.find(wtxid);
+        if (itWallet == mapWallet.end())
+            continue;
+        const CWalletTx* pcoin = &itWallet->second;
 
         if (!CheckFinalTx(*pcoin->tx))
             continue;
@@ -2948,22 +3293,15 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
         if (nDepth < nMinDepth || nDepth > nMaxDepth)
             continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
+        for (auto itOutpoint = itTxBegin; itOutpoint != itTxEnd; ++itOutpoint) {
+            unsigned int i = itOutpoint->n;
             bool found = false;
             if (nCoinType == CoinType::ONLY_FULLY_MIXED) {
-                if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
                 found = IsFullyMixed(COutPoint(wtxid, i));
             } else if(nCoinType == CoinType::ONLY_READY_TO_MIX) {
-                if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
                 found = !IsFullyMixed(COutPoint(wtxid, i));
-            } else if(nCoinType == CoinType::ONLY_NONDENOMINATED) {
-                if (CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
-                found = !CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-            } else if(nCoinType == CoinType::ONLY_MASTERNODE_COLLATERAL) {
-                found = pcoin->tx->vout[i].nValue == 1000*COIN;
-            } else if(nCoinType == CoinType::ONLY_COINJOIN_COLLATERAL) {
-                found = CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue);
             } else {
+                // everything else is fully determined by the type index
                 found = true;
             }
             if(!found) continue;
@@ -3152,7 +3490,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibil
         // Calculate the fees for things that aren't inputs
         CAmount not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
         bnb_used = true;
-        return SelectCoinsBnB(utxo_pool, nTargetValue, cost_of_change, setCoinsRet, nValueRet, not_input_fees);
+        return SelectCoinsBnB(CoinSelectionIndex(std::move(utxo_pool)), nTargetValue, cost_of_change, setCoinsRet, nValueRet, not_input_fees);
     } else {
         // Filter by the min conf specs and add to utxo_pool
         for (const COutput &output : vCoins)
@@ -3259,6 +3597,134 @@ bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAm
     return res;
 }
 
+namespace {
+/**
+ * Signing provider which remembers the keys and scripts it looked up in its source. Once frozen it only serves
+ * what it remembered and can be shared by signing threads, which must not call into the wallet while the caller
+ * holds cs_wallet.
+ */
+class SigningProviderSnapshot : public SigningProvider
+{
+private:
+    const SigningProvider* m_source;
+    mutable std::map<CScriptID, CScript> m_scripts;
+    mutable std::map<CKeyID, CPubKey> m_pubkeys;
+    mutable std::map<CKeyID, CKey> m_keys;
+
+    template <typename Id, typename T>
+    bool Lookup(std::map<Id, T>& map, const Id& id, T& out, bool (SigningProvider::*get)(const Id&, T&) const) const
+    {
+        auto it = map.find(id);
+        if (it != map.end()) {
+            out = it->second;
+            return true;
+        }
+        if (!m_source || !(m_source->*get)(id, out)) {
+            return false;
+        }
+        map.emplace(id, out);
+        return true;
+    }
+
+public:
+    explicit SigningProviderSnapshot(const SigningProvider& source) : m_source(&source) {}
+
+    //! Stop looking things up in the source
+    void Freeze() { m_source = nullptr; }
+
+    bool GetCScript(const CScriptID& scriptid, CScript& script) const override { return Lookup(m_scripts, scriptid, script, &SigningProvider::GetCScript); }
+    bool GetPubKey(const CKeyID& address, CPubKey& pubkey) const override { return Lookup(m_pubkeys, address, pubkey, &SigningProvider::GetPubKey); }
+    bool GetKey(const CKeyID& address, CKey& key) const override { return Lookup(m_keys, address, key, &SigningProvider::GetKey); }
+};
+
+/** Signature creator which produces dummy signatures, but only for keys its provider has */
+class KeyLookupSignatureCreator : public DummySignatureCreator
+{
+public:
+    explicit KeyLookupSignatureCreator(const SigningProvider* provider) : DummySignatureCreator(provider) {}
+
+    bool CreateSig(std::vector<unsigned char>& vchSig, const CKeyID& keyid, const CScript& scriptCode, SigVersion sigversion) const override
+    {
+        CKey key;
+        return Provider().GetKey(keyid, key) && DummySignatureCreator::CreateSig(vchSig, keyid, scriptCode, sigversion);
+    }
+};
+} // namespace
+
+bool CWallet::SignTransactionInputs(CMutableTransaction& tx, const std::vector<std::pair<unsigned int, CTxOut>>& vInputs, int nHashType, std::set<unsigned int>* psetFailed)
+{
+    AssertLockHeld(cs_wallet);
+
+    // Inputs are signed against the unsigned transaction, scriptSigs are not covered by the signature hash
+    const CTransaction txConst(tx);
+    std::vector<SignatureData> vSigData(vInputs.size());
+    // not a vector<bool>, its elements are written concurrently
+    std::vector<char> vSigned(vInputs.size(), false);
+    auto sign = [&](const SigningProvider& provider, size_t i) {
+        const CTxOut& txout = vInputs[i].second;
+        vSigned[i] = ProduceSignature(TransactionSignatureCreator(&provider, &txConst, vInputs[i].first, txout.nValue, nHashType), txout.scriptPubKey, vSigData[i]);
+    };
+
+    const int nThreads = std::min(GetNumCores(), MAX_SIGN_THREADS);
+    if (vInputs.size() < PARALLEL_SIGN_MIN_INPUTS || nThreads <= 1) {
+        for (size_t i = 0; i < vInputs.size(); i++) {
+            sign(*this, i);
+        }
+    } else {
+        // Key lookups lock cs_wallet and may derive HD keys, so they are done here, with a dry run producing
+        // dummy signatures. The signing threads only get to see the snapshot.
+        SigningProviderSnapshot snapshot(*this);
+        for (const auto& input : vInputs) {
+            SignatureData sigdata;
+            ProduceSignature(KeyLookupSignatureCreator(&snapshot), input.second.scriptPubKey, sigdata);
+        }
+        snapshot.Freeze();
+
+        int64_t nStart = GetTimeMillis();
+        ctpl::thread_pool workerPool(nThreads);
+        RenameThreadPool(workerPool, "dash-sign");
+        std::vector<std::future<void>> vFutures;
+        for (int nThread = 0; nThread < nThreads; nThread++) {
+            vFutures.emplace_back(workerPool.push([&, nThread](int) {
+                for (size_t i = nThread; i < vInputs.size(); i += nThreads) {
+                    sign(snapshot, i);
+                }
+            }));
+        }
+        for (auto& future : vFutures) {
+            future.get();
+        }
+        LogPrint(BCLog::BENCHMARK, "%s: signed %d inputs on %d threads in %dms\n", __func__, vInputs.size(), nThreads, GetTimeMillis() - nStart);
+    }
+
+    bool fSignedAll = true;
+    for (size_t i = 0; i < vInputs.size(); i++) {
+        if (vSigned[i]) {
+            UpdateTransaction(tx, vInputs[i].first, vSigData[i]);
+        } else {
+            fSignedAll = false;
+            if (psetFailed) psetFailed->insert(vInputs[i].first);
+        }
+    }
+    return fSignedAll;
+}
+
+bool CWallet::SignTransaction(CMutableTransaction& tx)
+{
+    AssertLockHeld(cs_wallet); // mapWallet
+
+    std::vector<std::pair<unsigned int, CTxOut>> vInputs;
+    for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+        const COutPoint& prevout = tx.vin[nIn].prevout;
+        auto mi = mapWallet.find(prevout.hash);
+        if (mi == mapWallet.end() || prevout.n >= mi->second.tx->vout.size()) {
+            return false;
+        }
+        vInputs.emplace_back(nIn, mi->second.tx->vout[prevout.n]);
+    }
+    return SignTransactionInputs(tx, vInputs);
+}
+
 bool CWallet::FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl coinControl)
 {
     std::vector<CRecipient> vecSend;
@@ -3924,22 +4390,13 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CTransac
 
         if (sign)
         {
-            CTransaction txNewConst(txNew);
-            int nIn = 0;
-            for(const auto& coin : vecCoins)
-            {
-                const CScript& scriptPubKey = coin.txout.scriptPubKey;
-                SignatureData sigdata;
-
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL), scriptPubKey, sigdata))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                } else {
-                    UpdateTransaction(txNew, nIn, sigdata);
-                }
-
-                nIn++;
+            std::vector<std::pair<unsigned int, CTxOut>> vInputs;
+            for (const auto& coin : vecCoins) {
+                vInputs.emplace_back(vInputs.size(), coin.txout);
+            }
+            if (!SignTransactionInputs(txNew, vInputs)) {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
         }
 
@@ -3980,6 +4437,7 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CTransac
  */
 bool CWallet::CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::vector<std::pair<std::string, std::string>> orderForm, std::string fromAccount, CReserveKey& reservekey, CConnman* connman, CValidationState& state)
 {
+    const int64_t nCommitDelay = std::max<int64_t>(0, std::min(gArgs.GetArg("-walletcommitdelay", DEFAULT_WALLET_COMMIT_DELAY), MAX_WALLET_COMMIT_DELAY));
     {
         LOCK2(cs_main, mempool.cs);
         LOCK(cs_wallet);
@@ -3993,12 +4451,21 @@ bool CWallet::CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::ve
 
         LogPrintf("CommitTransaction:\n%s", wtxNew.tx->ToString()); /* Continued */
         {
+            // All records of the transaction are written in one database transaction. With -walletcommitdelay
+            // it isn't synced on its own but together with the ones of concurrent senders, see below.
+            WalletBatch batch(*database, "r+", nCommitDelay == 0);
+            bool fTxn = batch.TxnBegin();
+
             // Take key pair from key pool so it won't be used again
-            reservekey.KeepKey();
+            reservekey.KeepKey(batch);
 
             // Add tx to wallet, because if it has change it's also ours,
             // otherwise just for transaction history.
-            AddToWallet(wtxNew);
+            AddToWallet(wtxNew, batch);
+
+            if (fTxn && !batch.TxnCommit()) {
+                LogPrintf("CommitTransaction(): Failed to write transaction %s to the wallet database\n", wtxNew.GetHash().ToString());
+            }
 
             // Notify that old coins are spent
             std::set<uint256> updated_hahes;
@@ -4029,6 +4496,11 @@ bool CWallet::CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::ve
             }
         }
     }
+
+    // Wait until the transaction is durable, the sync is shared with everyone who committed meanwhile
+    if (nCommitDelay > 0 && !database->GroupSync(nCommitDelay)) {
+        LogPrintf("CommitTransaction(): Failed to sync the wallet database\n");
+    }
     return true;
 }
 
@@ -4088,10 +4560,22 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         for (auto& pair : mapWallet) {
             for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
                 if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
+                    AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i].nValue);
                 }
             }
         }
+
+        // transactions might have been zapped, so drop everything calculated from them
+        WalletBatch batch(*database);
+        std::vector<uint256> vecMissing;
+        for (const auto& pair : mapOutpointRoundsCache) {
+            if (!mapWallet.count(pair.first.hash) && (vecMissing.empty() || vecMissing.back() != pair.first.hash)) {
+                vecMissing.emplace_back(pair.first.hash);
+            }
+        }
+        for (const auto& hash : vecMissing) {
+            InvalidateCoinJoinRounds(hash, batch);
+        }
     }
 
     InitCoinJoinSalt();
@@ -4124,7 +4608,9 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
 {
     AssertLockHeld(cs_wallet); // mapWallet
     DBErrors nZapSelectTxRet = WalletBatch(*database,"cr+").ZapSelectTx(vHashIn, vHashOut);
+    WalletBatch batch(*database);
     for (uint256 hash : vHashOut) {
+        InvalidateCoinJoinRounds(hash, batch);
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
         mapWallet.erase(it);
@@ -4291,48 +4777,50 @@ size_t CWallet::KeypoolCountInternalKeys()
     return setInternalKeyPool.size();
 }
 
-bool CWallet::TopUpKeyPool(unsigned int kpSize)
+int64_t CWallet::FillKeyPool(unsigned int nTargetSize, int64_t nMaxKeys, bool fShowProgress)
 {
-    {
-        LOCK(cs_wallet);
-
-        if (IsLocked(true))
-            return false;
+    AssertLockHeld(cs_wallet);
 
-        // Top up key pool
-        unsigned int nTargetSize;
-        if (kpSize > 0)
-            nTargetSize = kpSize;
-        else
-            nTargetSize = std::max(gArgs.GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
+    // count amount of available keys (internal, external)
+    // make sure the keypool of external and internal keys fits the user selected target (-keypool)
+    int64_t amountExternal = setExternalKeyPool.size();
+    int64_t amountInternal = setInternalKeyPool.size();
+    int64_t missingExternal = std::max(std::max((int64_t) nTargetSize, (int64_t) 1) - amountExternal, (int64_t) 0);
+    int64_t missingInternal = std::max(std::max((int64_t) nTargetSize, (int64_t) 1) - amountInternal, (int64_t) 0);
 
-        // count amount of available keys (internal, external)
-        // make sure the keypool of external and internal keys fits the user selected target (-keypool)
-        int64_t amountExternal = setExternalKeyPool.size();
-        int64_t amountInternal = setInternalKeyPool.size();
-        int64_t missingExternal = std::max(std::max((int64_t) nTargetSize, (int64_t) 1) - amountExternal, (int64_t) 0);
-        int64_t missingInternal = std::max(std::max((int64_t) nTargetSize, (int64_t) 1) - amountInternal, (int64_t) 0);
+    if (!IsHDEnabled())
+    {
+        // don't create extra internal keys
+        missingInternal = 0;
+    }
+    const int64_t nMissing = missingInternal + missingExternal;
+    const int64_t nToAdd = std::min(nMissing, nMaxKeys);
+    if (nToAdd <= 0) {
+        return nMissing;
+    }
 
-        if (!IsHDEnabled())
-        {
-            // don't create extra internal keys
-            missingInternal = 0;
+    int64_t nStart = GetTimeMillis();
+    int64_t nAddedInternal = 0;
+    WalletBatch batch(*database);
+    // external keys first, then internal ones
+    for (int64_t nAdded = 0; nAdded < nToAdd;) {
+        bool fInternal = nAdded >= missingExternal;
+        int64_t nBatch = std::min(std::min(nToAdd - nAdded, KEYPOOL_BATCH_SIZE), fInternal ? nToAdd - nAdded : missingExternal - nAdded);
+
+        // dummy databases have no transactions
+        bool fTxn = batch.TxnBegin();
+        std::vector<CPubKey> vPubKeys;
+        if (IsHDEnabled()) {
+            // TODO: implement keypools for all accounts?
+            vPubKeys = DeriveNewChildKeys(batch, CKeyMetadata(GetTime()), 0, fInternal, nBatch);
         } else {
-            nTargetSize *= 2;
-        }
-        bool fInternal = false;
-        WalletBatch batch(*database);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            if (i < missingInternal) {
-                fInternal = true;
+            for (int64_t i = 0; i < nBatch; i++) {
+                vPubKeys.push_back(GenerateNewKey(batch, 0, fInternal));
             }
-
+        }
+        for (const CPubKey& pubkey : vPubKeys) {
             assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
             int64_t index = ++m_max_keypool_index;
-
-            // TODO: implement keypools for all accounts?
-            CPubKey pubkey(GenerateNewKey(batch, 0, fInternal));
             if (!batch.WritePool(index, CKeyPool(pubkey, fInternal))) {
                 throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
             }
@@ -4344,20 +4832,105 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             }
 
             m_pool_key_to_index[pubkey.GetID()] = index;
-            if (missingInternal + missingExternal > 0) {
-                LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n",
-                          missingInternal + missingExternal, missingInternal,
-                          setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
-            }
+        }
+        if (fTxn && !batch.TxnCommit()) {
+            throw std::runtime_error(std::string(__func__) + ": writing generated keys failed");
+        }
+        nAdded += nBatch;
+        if (fInternal) {
+            nAddedInternal += nBatch;
+        }
 
-            double dProgress = 100.f * index / (nTargetSize + 1);
+        if (fShowProgress) {
+            double dProgress = 100.f * nAdded / nToAdd;
             std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
             uiInterface.InitMessage(strMsg);
         }
     }
+    LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal) in %dms\n",
+              nToAdd, nAddedInternal,
+              setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size(), GetTimeMillis() - nStart);
+
+    return nMissing - nToAdd;
+}
+
+bool CWallet::TopUpKeyPool(unsigned int kpSize)
+{
+    {
+        LOCK(cs_wallet);
+
+        if (IsLocked(true))
+            return false;
+
+        // Top up key pool
+        unsigned int nTargetSize;
+        if (kpSize > 0)
+            nTargetSize = kpSize;
+        else
+            nTargetSize = std::max(gArgs.GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
+
+        // Explicitly requested sizes are filled right away
+        unsigned int nForegroundSize = kpSize > 0 ? nTargetSize : std::min(nTargetSize, MAX_KEYPOOL_FOREGROUND_SIZE);
+        FillKeyPool(nForegroundSize, std::numeric_limits<int64_t>::max(), true);
+        if (nForegroundSize < nTargetSize) {
+            StartKeyPoolTopUp(nTargetSize);
+        }
+    }
     return true;
 }
 
+void CWallet::StartKeyPoolTopUp(unsigned int nTargetSize)
+{
+    AssertLockHeld(cs_wallet);
+
+    m_keypool_topup_target = std::max(m_keypool_topup_target, nTargetSize);
+    if (m_keypool_topup_running || m_keypool_interrupt) {
+        return;
+    }
+    if (m_keypool_thread.joinable()) {
+        // the previous top-up is done, it only has to return after releasing cs_wallet
+        m_keypool_thread.join();
+    }
+    m_keypool_topup_running = true;
+    m_keypool_thread = std::thread(&TraceThread<std::function<void()> >, "keypool", std::function<void()>(std::bind(&CWallet::ThreadTopUpKeyPool, this)));
+}
+
+void CWallet::ThreadTopUpKeyPool()
+{
+    int64_t nStart = GetTimeMillis();
+    while (true) {
+        {
+            LOCK(cs_wallet);
+            int64_t nMissing = 0;
+            if (!m_keypool_interrupt && !IsLocked(true)) {
+                try {
+                    nMissing = FillKeyPool(m_keypool_topup_target, KEYPOOL_BATCH_SIZE, false);
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Topping up keypool of %s failed: %s\n", __func__, GetName(), e.what());
+                }
+            }
+            if (nMissing == 0) {
+                // Done, interrupted or locked, an unlock starts over
+                LogPrint(BCLog::BENCHMARK, "%s: Keypool of %s topped up towards %u keys in %dms\n", __func__, GetName(), m_keypool_topup_target, GetTimeMillis() - nStart);
+                m_keypool_topup_running = false;
+                m_keypool_topup_target = 0;
+                return;
+            }
+        }
+        // give other threads waiting for cs_wallet a chance between batches
+        MilliSleep(1);
+    }
+}
+
+void CWallet::StopKeyPoolTopUp()
+{
+    AssertLockNotHeld(cs_wallet);
+    m_keypool_interrupt = true;
+    if (m_keypool_thread.joinable()) {
+        m_keypool_thread.join();
+    }
+}
+
 void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fInternal)
 {
     nIndex = -1;
@@ -4397,8 +4970,13 @@ void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fIn
 
 void CWallet::KeepKey(int64_t nIndex)
 {
-    // Remove from key pool
     WalletBatch batch(*database);
+    KeepKey(nIndex, batch);
+}
+
+void CWallet::KeepKey(int64_t nIndex, WalletBatch& batch)
+{
+    // Remove from key pool
     if (batch.ErasePool(nIndex))
         --nKeysLeftSinceAutoBackup;
     if (!nWalletBackups)
@@ -4655,6 +5233,15 @@ void CReserveKey::KeepKey()
     vchPubKey = CPubKey();
 }
 
+void CReserveKey::KeepKey(WalletBatch& batch)
+{
+    if (nIndex != -1) {
+        pwallet->KeepKey(nIndex, batch);
+    }
+    nIndex = -1;
+    vchPubKey = CPubKey();
+}
+
 void CReserveKey::ReturnKey()
 {
     if (nIndex != -1) {
@@ -4705,8 +5292,7 @@ void CWallet::LockCoin(const COutPoint& output)
     std::map<uint256, CWalletTx>::iterator it = mapWallet.find(output.hash);
     if (it != mapWallet.end()) it->second.MarkDirty(); // recalculate all credits for this tx
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
@@ -4716,8 +5302,7 @@ void CWallet::UnlockCoin(const COutPoint& output)
     std::map<uint256, CWalletTx>::iterator it = mapWallet.find(output.hash);
     if (it != mapWallet.end()) it->second.MarkDirty(); // recalculate all credits for this tx
 
-    fAnonymizableTallyCached = false;
-    fAnonymizableTallyCachedNonDenom = false;
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockAllCoins()
@@ -5222,7 +5807,7 @@ std::shared_ptr<CWallet> CWallet::CreateWalletFromFile(const WalletLocation& loc
     uiInterface.LoadWallet(walletInstance);
 
     // Register with the validation interface. It's ok to do this after rescan since we're still holding cs_main.
-    RegisterValidationInterface(walletInstance.get());
+    RegisterValidationInterface(walletInstance.get(), VALIDATION_QUEUE_WALLET);
 
     walletInstance->SetBroadcastTransactions(gArgs.GetBoolArg("-walletbroadcast", DEFAULT_WALLETBROADCAST));
 
@@ -5323,11 +5908,7 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
         }
     } else {
         // ... strWalletName file
-        std::string strSourceFile;
-        BerkeleyEnvironment* env = GetWalletEnv(wallet_path, strSourceFile);
-        fs::path sourceFile = env->Directory() / strSourceFile;
         fs::path backupFile = backupsDir / (strWalletName + dateTimeStr);
-        sourceFile.make_preferred();
         backupFile.make_preferred();
         if (fs::exists(backupFile))
         {
@@ -5335,16 +5916,31 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
             LogPrintf("%s\n", strBackupWarningRet);
             return false;
         }
-        if(fs::exists(sourceFile)) {
-            try {
-                fs::copy_file(sourceFile, backupFile);
-                LogPrintf("Creating backup of %s -> %s\n", sourceFile.string(), backupFile.string());
-            } catch(fs::filesystem_error &error) {
-                strBackupWarningRet = strprintf(_("Failed to create backup, error: %s"), error.what());
+        if (IsLevelDBWallet(wallet_path)) {
+            // A LevelDB wallet is a directory of files which must be copied consistently, let the database do it
+            if (!database->Backup(backupFile.string())) {
+                strBackupWarningRet = strprintf(_("Failed to create backup %s!"), backupFile.string());
                 LogPrintf("%s\n", strBackupWarningRet);
                 nWalletBackups = -1;
                 return false;
             }
+            LogPrintf("Creating backup of %s -> %s\n", GetLevelDBWalletPath(wallet_path).string(), backupFile.string());
+        } else {
+            std::string strSourceFile;
+            BerkeleyEnvironment* env = GetWalletEnv(wallet_path, strSourceFile);
+            fs::path sourceFile = env->Directory() / strSourceFile;
+            sourceFile.make_preferred();
+            if(fs::exists(sourceFile)) {
+                try {
+                    fs::copy_file(sourceFile, backupFile);
+                    LogPrintf("Creating backup of %s -> %s\n", sourceFile.string(), backupFile.string());
+                } catch(fs::filesystem_error &error) {
+                    strBackupWarningRet = strprintf(_("Failed to create backup, error: %s"), error.what());
+                    LogPrintf("%s\n", strBackupWarningRet);
+                    nWalletBackups = -1;
+                    return false;
+                }
+            }
         }
     }
 
@@ -5356,8 +5952,8 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
     fs::path currentFile;
     for (fs::directory_iterator dir_iter(backupsDir); dir_iter != end_iter; ++dir_iter)
     {
-        // Only check regular files
-        if ( fs::is_regular_file(dir_iter->status()))
+        // Only check regular files, and directories of LevelDB wallet backups
+        if (fs::is_regular_file(dir_iter->status()) || fs::exists(dir_iter->path() / "CURRENT"))
         {
             currentFile = dir_iter->path().filename();
             // Only add the backups for the current wallet, e.g. wallet.dat.*
@@ -5376,7 +5972,7 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
         {
             // More than nWalletBackups backups: delete oldest one(s)
             try {
-                fs::remove(file.second);
+                fs::remove_all(file.second);
                 LogPrintf("Old backup deleted: %s\n", file.second);
             } catch(fs::filesystem_error &error) {
                 strBackupWarningRet = strprintf(_("Failed to delete backup, error: %s"), error.what());
@@ -5396,6 +5992,8 @@ void CWallet::NotifyTransactionLock(const CTransactionRef &tx, const std::shared
     uint256 txHash = tx->GetHash();
     std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txHash);
     if (mi != mapWallet.end()){
+        // the tx is trusted now, which moves its outputs from the unconfirmed to the trusted balance
+        MarkBalancesDirty();
         NotifyTransactionChanged(this, txHash, CT_UPDATED);
         NotifyISLockReceived();
         // notify an external script
@@ -5523,6 +6121,10 @@ bool CWalletTx::AcceptToMemoryPool(const CAmount& nAbsurdFee, CValidationState&
     // unavailable as we're not yet aware that it is in the mempool.
     bool ret = ::AcceptToMemoryPool(mempool, state, tx, nullptr /* pfMissingInputs */,
                                 false /* bypass_limits */, nAbsurdFee);
-    fInMempool |= ret;
+    if (ret && !fInMempool) {
+        fInMempool = true;
+        // the tx and its change are trusted now
+        pwallet->MarkBalancesDirty();
+    }
     return ret;
 }
@@ -27,14 +27,19 @@
 #include <governance/governance-object.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -52,6 +57,10 @@ extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Implicit keypool top-ups add at most this many keys on the calling thread, larger keypools are filled in the background
+static const unsigned int MAX_KEYPOOL_FOREGROUND_SIZE = DEFAULT_KEYPOOL_SIZE;
+//! Keys are added to the keypool in database transactions of this many keys
+static const int64_t KEYPOOL_BATCH_SIZE = 1000;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -76,6 +85,20 @@ static const int64_t TIMESTAMP_MIN = 0;
 //! if set, all keys will be derived by using BIP39/BIP44
 static const bool DEFAULT_USE_HD_WALLET = false;
 
+//! -rescanthreads default, 0 = one per core up to MAX_RESCAN_THREADS
+static const int DEFAULT_RESCAN_THREADS = 0;
+static const int MAX_RESCAN_THREADS = 8;
+//! Number of blocks read and matched ahead of the rescan position per rescan thread
+static const int RESCAN_PREFETCH_BLOCKS_PER_THREAD = 4;
+
+//! Transactions with at least this many inputs to sign are signed on a thread pool
+static const size_t PARALLEL_SIGN_MIN_INPUTS = 16;
+static const int MAX_SIGN_THREADS = 8;
+
+//! -walletcommitdelay default, 0 = every sent transaction syncs the wallet database on its own
+static const int64_t DEFAULT_WALLET_COMMIT_DELAY = 0;
+static const int64_t MAX_WALLET_COMMIT_DELAY = 1000;
+
 class CBlockIndex;
 class CCoinControl;
 class CKey;
@@ -746,6 +769,26 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom = false;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /** The balance getters whose results are kept in mapBalanceCache */
+    enum class BalanceType {
+        TRUSTED,
+        UNCONFIRMED,
+        IMMATURE,
+        UNCONFIRMED_WATCH_ONLY,
+        IMMATURE_WATCH_ONLY,
+        ANONYMIZED,
+        DENOMINATED,
+    };
+    /** Getter, filter and the getter's own depth/rounds and flag arguments */
+    typedef std::tuple<BalanceType, isminefilter, int, bool> BalanceCacheKey;
+    /**
+     * Wallet balances, computed on first use and dropped by MarkBalancesDirty() on every tx,
+     * block, coin lock and islock event instead of walking mapWallet on every call.
+     */
+    mutable std::map<BalanceCacheKey, CAmount> mapBalanceCache;
+
+    CAmount GetCachedBalance(const BalanceCacheKey& key, const std::function<CAmount()>& calc) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -757,8 +800,31 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    /** The outpoints of setWalletUTXO grouped by the kind of their amount, lets AvailableCoins skip everything else */
+    enum WalletUTXOType {
+        UTXO_DENOMINATED,
+        UTXO_COINJOIN_COLLATERAL,
+        UTXO_MASTERNODE_COLLATERAL,
+        UTXO_OTHER,
+        UTXO_TYPE_COUNT
+    };
+    std::array<std::set<COutPoint>, UTXO_TYPE_COUNT> arrWalletUTXOByType;
+    static WalletUTXOType GetWalletUTXOType(CAmount nValue);
+    /** Adds an outpoint to setWalletUTXO and its type index, returns false if it was there already */
+    bool AddWalletUTXO(const COutPoint& outpoint, CAmount nValue) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void EraseWalletUTXO(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Re-adds the outputs spent by wtx which are unspent again because wtx got abandoned or conflicted */
+    void RestoreWalletUTXOs(const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * CoinJoin rounds of outpoints. Values which only depend on the wallet's own transactions
+     * are persisted as "cj_rounds" records and loaded on startup, see GetRealOutpointCoinJoinRounds.
+     */
     mutable std::map<COutPoint, int> mapOutpointRoundsCache;
 
+    int GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRounds, std::vector<COutPoint>& vecNewOutpointsRet) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* Forget the CoinJoin rounds of the outputs of a transaction and of all in-wallet transactions spending them. */
+    void InvalidateCoinJoinRounds(const uint256& hashTx, WalletBatch& batch) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
@@ -768,14 +834,29 @@ private:
      * Should be called with pindexBlock and posInBlock if this is for a transaction that is included in a block. */
     void SyncTransaction(const CTransactionRef& tx, const CBlockIndex *pindex = nullptr, int posInBlock = 0) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
-    /* HD derive new child key (on internal or external chain) */
-    void DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* HD derive nCount new child keys (on internal or external chain), the account's parent key is derived only once */
+    std::vector<CPubKey> DeriveNewChildKeys(WalletBatch &batch, const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, unsigned int nCount) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * Add up to nMaxKeys keys to the keypool towards nTargetSize keys per chain, in batches of KEYPOOL_BATCH_SIZE
+     * keys which are written in one database transaction each.
+     * @return the number of keys still missing
+     */
+    int64_t FillKeyPool(unsigned int nTargetSize, int64_t nMaxKeys, bool fShowProgress) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Fill the keypool up to nTargetSize keys on the keypool thread, which takes cs_wallet for one batch at a time */
+    void StartKeyPoolTopUp(unsigned int nTargetSize) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void ThreadTopUpKeyPool();
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
     int64_t m_max_keypool_index = 0;
     std::map<CKeyID, int64_t> m_pool_key_to_index;
 
+    std::thread m_keypool_thread;
+    std::atomic<bool> m_keypool_interrupt{false};
+    bool m_keypool_topup_running GUARDED_BY(cs_wallet){false};
+    unsigned int m_keypool_topup_target GUARDED_BY(cs_wallet){0};
+
     int64_t nTimeFirstKey = 0;
 
     /**
@@ -789,6 +870,16 @@ private:
      */
     bool AddWatchOnly(const CScript& dest) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Salted hashes of the P2PKH scripts of all our keys, the P2SH scripts of all our redeem scripts
+     * and of all watch-only scripts. It only ever grows, so IsMine can reject P2PKH and P2SH outputs
+     * which are not in it with a single hash instead of solving them and looking up their keys.
+     */
+    std::unordered_set<uint64_t> setScriptPubKeyHashes GUARDED_BY(cs_KeyStore);
+    const SaltedHasherBase scriptPubKeyHashSalt;
+    uint64_t GetScriptPubKeyHash(const CScript& script) const;
+    void AddScriptPubKeyHash(const CScript& script);
+
     /** Wallet location which includes wallet name (see WalletLocation). */
     WalletLocation m_location;
 
@@ -868,6 +959,7 @@ public:
 
     ~CWallet()
     {
+        StopKeyPoolTopUp();
         delete encrypted_batch;
         encrypted_batch = nullptr;
     }
@@ -928,7 +1020,7 @@ public:
     int  CountInputsWithAmount(CAmount nInputAmount) const;
 
     // get the CoinJoin chain depth for a given input
-    int GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRounds = 0) const;
+    int GetRealOutpointCoinJoinRounds(const COutPoint& outpoint) const;
     // respect current settings
     int GetCappedOutpointCoinJoinRounds(const COutPoint& outpoint) const;
 
@@ -972,7 +1064,7 @@ public:
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& key, const CPubKey &pubkey) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    bool LoadKey(const CKey& key, const CPubKey &pubkey);
     //! Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CKeyID& keyID, const CKeyMetadata &metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool LoadScriptMetadata(const CScriptID& script_id, const CKeyMetadata &metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -1026,8 +1118,13 @@ public:
     bool GetLabelDestination(CTxDestination &dest, const std::string& label, bool bForceNew = false);
 
     void MarkDirty();
+    /** Drops the cached anonymizable tallies and balances, the per-tx credit caches are kept */
+    void MarkBalancesDirty() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
+    bool AddToWallet(const CWalletTx& wtxIn, WalletBatch& batch);
     bool LoadToWallet(const CWalletTx& wtxIn);
+    //! Adds a persisted CoinJoin rounds value to the cache (used by LoadWallet)
+    void LoadCoinJoinRounds(const COutPoint& outpoint, int nRoundsMax, int nRounds);
     void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected) override;
@@ -1061,6 +1158,14 @@ public:
      */
     bool FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl);
     bool SignTransaction(CMutableTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * Sign the inputs of tx given by vInputs as pairs of input index and spent output. Transactions with many
+     * inputs are signed on a thread pool, the signatures are merged into tx afterwards. Inputs which couldn't be
+     * signed are left untouched and added to psetFailed.
+     * @return true if all inputs were signed
+     */
+    bool SignTransactionInputs(CMutableTransaction& tx, const std::vector<std::pair<unsigned int, CTxOut>>& vInputs, int nHashType = SIGHASH_ALL,
+                               std::set<unsigned int>* psetFailed = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /**
      * Create a new transaction paying the recipients with a set of coins
@@ -1090,9 +1195,16 @@ public:
     bool NewKeyPool();
     size_t KeypoolCountExternalKeys() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     size_t KeypoolCountInternalKeys() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * Top up the keypool to kpSize keys per chain, or to -keypool keys if kpSize is 0. In the latter case
+     * only the first MAX_KEYPOOL_FOREGROUND_SIZE keys are added right away, the rest in the background.
+     */
     bool TopUpKeyPool(unsigned int kpSize = 0);
+    //! Stop a running background top-up, must not be called with cs_wallet held
+    void StopKeyPoolTopUp();
     void ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fInternal);
     void KeepKey(int64_t nIndex);
+    void KeepKey(int64_t nIndex, WalletBatch& batch);
     void ReturnKey(int64_t nIndex, bool fInternal, const CPubKey& pubkey);
     bool GetKeyFromPool(CPubKey &key, bool fInternal /*= false*/);
     int64_t GetOldestKeyPoolTime();
@@ -1293,6 +1405,8 @@ public:
     void ReturnKey();
     bool GetReservedKey(CPubKey &pubkey, bool fInternalIn /*= false*/);
     void KeepKey();
+    //! Same, but removes the key from the key pool in batch
+    void KeepKey(WalletBatch& batch);
     void KeepScript() override { KeepKey(); }
 };
 
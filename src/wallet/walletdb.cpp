@@ -16,6 +16,7 @@
 #include <sync.h>
 #include <util.h>
 #include <utiltime.h>
+#include <wallet/db_leveldb.h>
 #include <wallet/wallet.h>
 #include <validation.h>
 
@@ -129,8 +130,8 @@ bool WalletBatch::WriteBestBlock(const CBlockLocator& locator)
 
 bool WalletBatch::ReadBestBlock(CBlockLocator& locator)
 {
-    if (m_batch.Read(std::string("bestblock"), locator) && !locator.vHave.empty()) return true;
-    return m_batch.Read(std::string("bestblock_nomerkle"), locator);
+    if (m_batch->Read(std::string("bestblock"), locator) && !locator.vHave.empty()) return true;
+    return m_batch->Read(std::string("bestblock_nomerkle"), locator);
 }
 
 bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
@@ -140,7 +141,7 @@ bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
 
 bool WalletBatch::ReadPool(int64_t nPool, CKeyPool& keypool)
 {
-    return m_batch.Read(std::make_pair(std::string("pool"), nPool), keypool);
+    return m_batch->Read(std::make_pair(std::string("pool"), nPool), keypool);
 }
 
 bool WalletBatch::WritePool(int64_t nPool, const CKeyPool& keypool)
@@ -161,7 +162,7 @@ bool WalletBatch::WriteMinVersion(int nVersion)
 bool WalletBatch::ReadAccount(const std::string& strAccount, CAccount& account)
 {
     account.SetNull();
-    return m_batch.Read(std::make_pair(std::string("acc"), strAccount), account);
+    return m_batch->Read(std::make_pair(std::string("acc"), strAccount), account);
 }
 
 bool WalletBatch::WriteAccount(const std::string& strAccount, const CAccount& account)
@@ -182,7 +183,7 @@ bool WalletBatch::WriteAccountingEntry(const uint64_t nAccEntryNum, const CAccou
 bool WalletBatch::ReadCoinJoinSalt(uint256& salt, bool fLegacy)
 {
     // TODO: Remove legacy checks after few major releases
-    return m_batch.Read(std::string(fLegacy ? "ps_salt" : "cj_salt"), salt);
+    return m_batch->Read(std::string(fLegacy ? "ps_salt" : "cj_salt"), salt);
 }
 
 bool WalletBatch::WriteCoinJoinSalt(const uint256& salt)
@@ -190,6 +191,16 @@ bool WalletBatch::WriteCoinJoinSalt(const uint256& salt)
     return WriteIC(std::string("cj_salt"), salt);
 }
 
+bool WalletBatch::WriteCoinJoinRounds(const COutPoint& outpoint, int nRoundsMax, int nRounds)
+{
+    return WriteIC(std::make_pair(std::string("cj_rounds"), outpoint), std::make_pair(nRoundsMax, nRounds));
+}
+
+bool WalletBatch::EraseCoinJoinRounds(const COutPoint& outpoint)
+{
+    return EraseIC(std::make_pair(std::string("cj_rounds"), outpoint));
+}
+
 bool WalletBatch::WriteGovernanceObject(const CGovernanceObject& obj)
 {
     return WriteIC(std::make_pair(std::string("gobject"), obj.GetHash()), obj, false);
@@ -211,26 +222,23 @@ void WalletBatch::ListAccountCreditDebit(const std::string& strAccount, std::lis
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = m_batch.GetCursor();
-    if (!pcursor)
+    CDataStream ssStart(SER_DISK, CLIENT_VERSION);
+    ssStart << std::make_pair(std::string("acentry"), std::make_pair((fAllAccounts ? std::string("") : strAccount), uint64_t(0)));
+    if (!m_batch->SeekCursor(ssStart))
         throw std::runtime_error(std::string(__func__) + ": cannot create DB cursor");
-    bool setRange = true;
     while (true)
     {
         // Read next record
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        if (setRange)
-            ssKey << std::make_pair(std::string("acentry"), std::make_pair((fAllAccounts ? std::string("") : strAccount), uint64_t(0)));
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue, setRange);
-        setRange = false;
-        if (ret == DB_NOTFOUND)
-            break;
-        else if (ret != 0)
+        bool fComplete;
+        if (!m_batch->ReadAtCursor(ssKey, ssValue, fComplete))
         {
-            pcursor->close();
+            m_batch->CloseCursor();
             throw std::runtime_error(std::string(__func__) + ": error scanning DB");
         }
+        if (fComplete)
+            break;
 
         // Unserialize
         std::string strType;
@@ -247,7 +255,7 @@ void WalletBatch::ListAccountCreditDebit(const std::string& strAccount, std::lis
         entries.push_back(acentry);
     }
 
-    pcursor->close();
+    m_batch->CloseCursor();
 }
 
 class CWalletScanState {
@@ -564,6 +572,12 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
                 strErr = "Error reading wallet database: LoadHDPubKey failed";
                 return false;
             }
+        } else if (strType == "cj_rounds") {
+            COutPoint outpoint;
+            int nRoundsMax, nRounds;
+            ssKey >> outpoint;
+            ssValue >> nRoundsMax >> nRounds;
+            pwallet->LoadCoinJoinRounds(outpoint, nRoundsMax, nRounds);
         } else if (strType == "gobject") {
             uint256 nObjectHash;
             CGovernanceObject obj;
@@ -606,7 +620,7 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
     LOCK2(cs_main, pwallet->cs_wallet);
     try {
         int nMinVersion = 0;
-        if (m_batch.Read((std::string)"minversion", nMinVersion))
+        if (m_batch->Read((std::string)"minversion", nMinVersion))
         {
             if (nMinVersion > FEATURE_LATEST)
                 return DBErrors::TOO_NEW;
@@ -614,8 +628,7 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = m_batch.GetCursor();
-        if (!pcursor)
+        if (!m_batch->StartCursor())
         {
             LogPrintf("Error getting wallet database cursor\n");
             return DBErrors::CORRUPT;
@@ -626,14 +639,15 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            bool fComplete;
+            if (!m_batch->ReadAtCursor(ssKey, ssValue, fComplete))
             {
                 LogPrintf("Error reading next record from wallet database\n");
+                m_batch->CloseCursor();
                 return DBErrors::CORRUPT;
             }
+            if (fComplete)
+                break;
 
             // Try to be tolerant of single corrupt records:
             std::string strType, strErr;
@@ -655,7 +669,7 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
         }
-        pcursor->close();
+        m_batch->CloseCursor();
 
         // Store initial external keypool size since we mostly use external keys in mixing
         pwallet->nKeysLeftSinceAutoBackup = pwallet->KeypoolCountExternalKeys();
@@ -714,15 +728,14 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
 
     try {
         int nMinVersion = 0;
-        if (m_batch.Read((std::string)"minversion", nMinVersion))
+        if (m_batch->Read((std::string)"minversion", nMinVersion))
         {
             if (nMinVersion > FEATURE_LATEST)
                 return DBErrors::TOO_NEW;
         }
 
         // Get cursor
-        Dbc* pcursor = m_batch.GetCursor();
-        if (!pcursor)
+        if (!m_batch->StartCursor())
         {
             LogPrintf("Error getting wallet database cursor\n");
             return DBErrors::CORRUPT;
@@ -733,14 +746,15 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            bool fComplete;
+            if (!m_batch->ReadAtCursor(ssKey, ssValue, fComplete))
             {
                 LogPrintf("Error reading next record from wallet database\n");
+                m_batch->CloseCursor();
                 return DBErrors::CORRUPT;
             }
+            if (fComplete)
+                break;
 
             std::string strType;
             ssKey >> strType;
@@ -755,7 +769,7 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
                 vWtx.push_back(wtx);
             }
         }
-        pcursor->close();
+        m_batch->CloseCursor();
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -843,7 +857,7 @@ void MaybeCompactWalletDB()
         }
 
         if (dbh.nLastFlushed != nUpdateCounter && GetTime() - dbh.nLastWalletUpdate >= 2) {
-            if (BerkeleyBatch::PeriodicFlush(dbh)) {
+            if (dbh.PeriodicFlush()) {
                 dbh.nLastFlushed = nUpdateCounter;
             }
         }
@@ -852,11 +866,51 @@ void MaybeCompactWalletDB()
     fOneThread = false;
 }
 
+//
+// WalletDatabase
+//
+
+/** Whether the wallet at wallet_path is (or, for new wallets, will be) stored in LevelDB */
+static bool UseLevelDB(const fs::path& wallet_path)
+{
+    if (IsLevelDBWallet(wallet_path)) {
+        return true;
+    }
+    // Existing BerkeleyDB wallets always stay where they are
+    if (fs::is_regular_file(wallet_path) || fs::exists(wallet_path / "wallet.dat")) {
+        return false;
+    }
+    return gArgs.GetArg("-walletdbbackend", DEFAULT_WALLET_DB_BACKEND) == "leveldb";
+}
+
+std::unique_ptr<WalletDatabase> WalletDatabase::Create(const fs::path& path)
+{
+    if (UseLevelDB(path)) {
+        return MakeUnique<LevelDBDatabase>(path);
+    }
+    return MakeUnique<BerkeleyDatabase>(path);
+}
+
+std::unique_ptr<WalletDatabase> WalletDatabase::CreateDummy()
+{
+    return MakeUnique<BerkeleyDatabase>();
+}
+
+std::unique_ptr<WalletDatabase> WalletDatabase::CreateMock()
+{
+    return MakeUnique<BerkeleyDatabase>("", true /* mock */);
+}
+
 //
 // Try to (very carefully!) recover wallet file if there is a problem.
 //
 bool WalletBatch::Recover(const fs::path& wallet_path, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue), std::string& out_backup_filename)
 {
+    if (IsLevelDBWallet(wallet_path)) {
+        // LevelDB checksums all records and recovers its own log on open, there are no pages to salvage
+        LogPrintf("Salvage: %s is stored in LevelDB, which can't be salvaged\n", wallet_path.string());
+        return false;
+    }
     return BerkeleyBatch::Recover(wallet_path, callbackDataIn, recoverKVcallback, out_backup_filename);
 }
 
@@ -892,11 +946,19 @@ bool WalletBatch::RecoverKeysOnlyFilter(void *callbackData, CDataStream ssKey, C
 
 bool WalletBatch::VerifyEnvironment(const fs::path& wallet_path, std::string& errorStr)
 {
+    if (UseLevelDB(wallet_path)) {
+        // LevelDB wallets don't share a database environment
+        return true;
+    }
     return BerkeleyBatch::VerifyEnvironment(wallet_path, errorStr);
 }
 
 bool WalletBatch::VerifyDatabaseFile(const fs::path& wallet_path, std::string& warningStr, std::string& errorStr)
 {
+    if (UseLevelDB(wallet_path)) {
+        // Checksums are verified on every read, a corrupted record fails loading the wallet
+        return true;
+    }
     return BerkeleyBatch::VerifyDatabaseFile(wallet_path, warningStr, errorStr, WalletBatch::Recover);
 }
 
@@ -935,25 +997,25 @@ bool WalletBatch::WriteHDPubKey(const CHDPubKey& hdPubKey, const CKeyMetadata& k
 
 bool WalletBatch::TxnBegin()
 {
-    return m_batch.TxnBegin();
+    return m_batch->TxnBegin();
 }
 
 bool WalletBatch::TxnCommit()
 {
-    return m_batch.TxnCommit();
+    return m_batch->TxnCommit();
 }
 
 bool WalletBatch::TxnAbort()
 {
-    return m_batch.TxnAbort();
+    return m_batch->TxnAbort();
 }
 
 bool WalletBatch::ReadVersion(int& nVersion)
 {
-    return m_batch.ReadVersion(nVersion);
+    return m_batch->ReadVersion(nVersion);
 }
 
 bool WalletBatch::WriteVersion(int nVersion)
 {
-    return m_batch.WriteVersion(nVersion);
+    return m_batch->WriteVersion(nVersion);
 }
@@ -23,10 +23,14 @@
  * - WalletBatch is an abstract modifier object for the wallet database, and encapsulates a database
  *   batch update as well as methods to act on the database. It should be agnostic to the database implementation.
  *
+ * - WalletDatabase represents a wallet database, DatabaseBatch is a low-level database batch update. Both are
+ *   interfaces which are implemented by the storage backends.
+ *
  * The following classes are implementation specific:
  * - BerkeleyEnvironment is an environment in which the database exists.
  * - BerkeleyDatabase represents a wallet database.
  * - BerkeleyBatch is a low-level database batch update.
+ * - LevelDBDatabase and LevelDBBatch are the same for wallets stored in LevelDB (see -walletdbbackend).
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
@@ -37,15 +41,13 @@ struct CBlockLocator;
 class CGovernanceObject;
 class CKeyPool;
 class CMasterKey;
+class COutPoint;
 class CScript;
 class CWallet;
 class CWalletTx;
 class uint160;
 class uint256;
 
-/** Backend-agnostic database type. */
-using WalletDatabase = BerkeleyDatabase;
-
 /** Error statuses for the wallet database */
 enum class DBErrors
 {
@@ -100,7 +102,7 @@ private:
     template <typename K, typename T>
     bool WriteIC(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!m_batch.Write(key, value, fOverwrite)) {
+        if (!m_batch->Write(key, value, fOverwrite)) {
             return false;
         }
         m_database.IncrementUpdateCounter();
@@ -110,7 +112,7 @@ private:
     template <typename K>
     bool EraseIC(const K& key)
     {
-        if (!m_batch.Erase(key)) {
+        if (!m_batch->Erase(key)) {
             return false;
         }
         m_database.IncrementUpdateCounter();
@@ -119,7 +121,7 @@ private:
 
 public:
     explicit WalletBatch(WalletDatabase& database, const char* pszMode = "r+", bool _fFlushOnClose = true) :
-        m_batch(database, pszMode, _fFlushOnClose),
+        m_batch(database.MakeBatch(pszMode, _fFlushOnClose)),
         m_database(database)
     {
     }
@@ -167,6 +169,9 @@ public:
     bool ReadCoinJoinSalt(uint256& salt, bool fLegacy = false);
     bool WriteCoinJoinSalt(const uint256& salt);
 
+    bool WriteCoinJoinRounds(const COutPoint& outpoint, int nRoundsMax, int nRounds);
+    bool EraseCoinJoinRounds(const COutPoint& outpoint);
+
     /** Write a CGovernanceObject to the database */
     bool WriteGovernanceObject(const CGovernanceObject& obj);
 
@@ -211,11 +216,11 @@ public:
     //! Write wallet version
     bool WriteVersion(int nVersion);
 private:
-    BerkeleyBatch m_batch;
+    std::unique_ptr<DatabaseBatch> m_batch;
     WalletDatabase& m_database;
 };
 
-//! Compacts BDB state so that wallet.dat is self-contained (if there are changes)
+//! Compacts BDB state so that wallet.dat is self-contained, or syncs LevelDB wallets (if there are changes)
 void MaybeCompactWalletDB();
 
 #endif // BITCOIN_WALLET_WALLETDB_H
@@ -7,10 +7,13 @@
 
 #include <zmq/zmqconfig.h>
 
+#include <atomic>
+
 class CBlockIndex;
 class CGovernanceObject;
 class CGovernanceVote;
 class CZMQAbstractNotifier;
+enum class MemPoolRemovalReason;
 
 namespace llmq {
     class CChainLockSig;
@@ -20,10 +23,13 @@ namespace llmq {
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+//! Default for -zmqpubhwm, the number of outbound messages a publisher queues before dropping them
+static const int DEFAULT_ZMQ_SNDHWM{1000};
+
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(nullptr) { }
+    CZMQAbstractNotifier() : psocket(nullptr), outbound_message_high_water_mark(DEFAULT_ZMQ_SNDHWM) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -36,13 +42,20 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    int GetOutboundMessageHighWaterMark() const { return outbound_message_high_water_mark; }
+    void SetOutboundMessageHighWaterMark(int sndhwm) { outbound_message_high_water_mark = sndhwm; }
+    uint64_t GetDroppedMessages() const { return nDroppedMessages; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
-    virtual bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig);
+    // pblock is the block at pindex if it is still in memory, nullptr otherwise
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock);
+    virtual bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    // Unlike NotifyTransaction() these are only called for transactions entering or leaving the mempool
+    virtual bool NotifyMempoolTransactionAdded(const CTransactionRef& transaction);
+    virtual bool NotifyMempoolTransactionRemoved(const CTransactionRef& transaction, MemPoolRemovalReason reason);
     virtual bool NotifyTransactionLock(const CTransactionRef& transaction, const std::shared_ptr<const llmq::CInstantSendLock>& islock);
     virtual bool NotifyGovernanceVote(const std::shared_ptr<const CGovernanceVote>& vote);
     virtual bool NotifyGovernanceObject(const std::shared_ptr<const CGovernanceObject>& object);
@@ -53,6 +66,9 @@ protected:
     void *psocket;
     std::string type;
     std::string address;
+    int outbound_message_high_water_mark; // aka SNDHWM
+    //! messages which were not published because the high water mark was exceeded
+    std::atomic<uint64_t> nDroppedMessages{0};
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
@@ -5,6 +5,7 @@
 #include <zmq/zmqnotificationinterface.h>
 #include <zmq/zmqpublishnotifier.h>
 
+#include <txmempool.h>
 #include <version.h>
 #include <validation.h>
 #include <streams.h>
@@ -62,6 +63,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubrawgovernanceobject"] = CZMQAbstractNotifier::Create<CZMQPublishRawGovernanceObjectNotifier>;
     factories["pubrawinstantsenddoublespend"] = CZMQAbstractNotifier::Create<CZMQPublishRawInstantSendDoubleSpendNotifier>;
     factories["pubrawrecoveredsig"] = CZMQAbstractNotifier::Create<CZMQPublishRawRecoveredSigNotifier>;
+    factories["pubmempooldelta"] = CZMQAbstractNotifier::Create<CZMQPublishMempoolDeltaNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -73,6 +75,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(entry.first);
             notifier->SetAddress(address);
+            notifier->SetOutboundMessageHighWaterMark(static_cast<int>(gArgs.GetArg("-zmqpubhwm", DEFAULT_ZMQ_SNDHWM)));
             notifiers.push_back(notifier);
         }
     }
@@ -126,6 +129,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    StartZMQPublisher();
+
     return true;
 }
 
@@ -135,6 +140,7 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        StopZMQPublisher();
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -147,6 +153,11 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
+std::shared_ptr<const CBlock> CZMQNotificationInterface::GetConnectedBlock(const CBlockIndex* pindex) const
+{
+    return pindex == pindexConnected ? pblockConnected : nullptr;
+}
+
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
@@ -155,7 +166,7 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notifier->NotifyBlock(pindexNew, GetConnectedBlock(pindexNew)))
         {
             i++;
         }
@@ -172,7 +183,7 @@ void CZMQNotificationInterface::NotifyChainLock(const CBlockIndex *pindex, const
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyChainLock(pindex, clsig))
+        if (notifier->NotifyChainLock(pindex, GetConnectedBlock(pindex), clsig))
         {
             i++;
         }
@@ -184,9 +195,9 @@ void CZMQNotificationInterface::NotifyChainLock(const CBlockIndex *pindex, const
     }
 }
 
-void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
+void CZMQNotificationInterface::NotifyTransaction(const CTransactionRef& ptx)
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
+    // Used by TransactionAddedToMempool, BlockConnected and BlockDisconnected, because they're
     // all the same external callback.
     const CTransaction& tx = *ptx;
 
@@ -205,11 +216,50 @@ void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef&
     }
 }
 
-void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
+void CZMQNotificationInterface::NotifyMempoolTransactionRemoved(const CTransactionRef& ptx, MemPoolRemovalReason reason)
+{
+    for (auto it = notifiers.begin(); it != notifiers.end();) {
+        CZMQAbstractNotifier *notifier = *it;
+        if (notifier->NotifyMempoolTransactionRemoved(ptx, reason)) {
+            ++it;
+        } else {
+            notifier->Shutdown();
+            it = notifiers.erase(it);
+        }
+    }
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
 {
+    NotifyTransaction(ptx);
+
+    for (auto it = notifiers.begin(); it != notifiers.end();) {
+        CZMQAbstractNotifier *notifier = *it;
+        if (notifier->NotifyMempoolTransactionAdded(ptx)) {
+            ++it;
+        } else {
+            notifier->Shutdown();
+            it = notifiers.erase(it);
+        }
+    }
+}
+
+void CZMQNotificationInterface::TransactionRemovedFromMempool(const CTransactionRef& ptx, MemPoolRemovalReason reason)
+{
+    NotifyMempoolTransactionRemoved(ptx, reason);
+}
+
+void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted)
+{
+    // Callbacks are delivered in order by a single thread, the last connected block is usually the new tip
+    pblockConnected = pblock;
+    pindexConnected = pindex;
+
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx, 0);
+        NotifyTransaction(ptx);
+        // Removals for blocks are not signaled by the mempool, transactions which were not in it are reported as well
+        NotifyMempoolTransactionRemoved(ptx, MemPoolRemovalReason::BLOCK);
     }
 }
 
@@ -217,7 +267,7 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx, 0);
+        NotifyTransaction(ptx);
     }
 }
 
@@ -28,7 +28,8 @@ protected:
 
     // CValidationInterface
     void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override;
-    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     void NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
@@ -41,8 +42,17 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    void NotifyTransaction(const CTransactionRef& tx);
+    void NotifyMempoolTransactionRemoved(const CTransactionRef& tx, MemPoolRemovalReason reason);
+
+    //! pblockConnected if it's the block at pindex
+    std::shared_ptr<const CBlock> GetConnectedBlock(const CBlockIndex* pindex) const;
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! the last connected block, so raw block notifications don't need to read it from disk again
+    std::shared_ptr<const CBlock> pblockConnected;
+    const CBlockIndex* pindexConnected{nullptr};
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
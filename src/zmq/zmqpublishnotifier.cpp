@@ -4,10 +4,21 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <llmq/quorums_instantsend.h>
+#include <txmempool.h>
 #include <streams.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util.h>
+#include <utilmemory.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -29,48 +40,255 @@ static const char *MSG_RAWGVOTE      = "rawgovernancevote";
 static const char *MSG_RAWGOBJ       = "rawgovernanceobject";
 static const char *MSG_RAWISCON      = "rawinstantsenddoublespend";
 static const char *MSG_RAWRECSIG     = "rawrecoveredsig";
+static const char *MSG_MEMPOOLDELTA  = "mempooldelta";
+
+/** A message waiting for the publisher thread */
+struct CZMQPublishMessage
+{
+    CZMQAbstractPublishNotifier* notifier;
+    //! a string literal, so zmq can reference it without copying
+    const char* command;
+    //! handed to zmq when sending, which frees it once it no longer needs it
+    std::unique_ptr<CDataStream> data;
+    unsigned char msgseq[sizeof(uint32_t)];
+};
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+static void FreeZMQData(void* /*data*/, void* hint)
 {
-    va_list args;
-    va_start(args, size);
+    delete static_cast<CDataStream*>(hint);
+}
 
-    while (1)
+// Internal function to send one part of a multipart message
+static bool zmq_send_part(void *sock, zmq_msg_t& msg, int flags)
+{
+    if (zmq_msg_send(&msg, sock, flags) == -1)
     {
-        zmq_msg_t msg;
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msg);
+        return false;
+    }
+    return true;
+}
 
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            va_end(args);
-            return -1;
+/**
+ * Messages are published by a separate thread, the validation interface callbacks only queue them. The queue of
+ * each notifier is bounded by its high water mark, just like the queue zmq keeps for every subscriber.
+ * Notifiers which collect batches are asked for them every ZMQ_BATCH_INTERVAL_MS.
+ */
+class CZMQPublishQueue
+{
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<CZMQPublishMessage> queue;
+    //! notifiers which implement FlushBatch() and the command of their messages
+    std::vector<std::pair<CZMQAbstractPublishNotifier*, const char*>> vBatchNotifiers;
+    bool fStop{false};
+    //! held while messages are sent, so that sockets are not closed under the publisher thread
+    std::mutex cs_send;
+    std::thread thread;
+
+    //! Returns false if the message was dropped, cs must be held
+    bool Enqueue(CZMQPublishMessage& msg);
+    void LogDropped(const CZMQPublishMessage& msg);
+    void FlushBatches();
+    bool Send(CZMQPublishMessage& msg);
+    void ThreadMain();
+
+public:
+    void Push(CZMQPublishMessage&& msg);
+    void AddBatchNotifier(CZMQAbstractPublishNotifier* notifier, const char* command);
+    //! Drop the queued messages of a notifier and wait until it's no longer used by the publisher thread
+    void Remove(CZMQAbstractPublishNotifier* notifier);
+    void Start();
+    void Stop();
+};
+
+static CZMQPublishQueue publishQueue;
+
+bool CZMQPublishQueue::Send(CZMQPublishMessage& msg)
+{
+    void* sock = msg.notifier->psocket;
+    zmq_msg_t part;
+
+    if (zmq_msg_init_data(&part, const_cast<char*>(msg.command), strlen(msg.command), nullptr, nullptr) != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    if (!zmq_send_part(sock, part, ZMQ_SNDMORE))
+        return false;
+
+    CDataStream* ss = msg.data.get();
+    if (zmq_msg_init_data(&part, ss->data(), ss->size(), FreeZMQData, ss) != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    msg.data.release();
+    if (!zmq_send_part(sock, part, ZMQ_SNDMORE))
+        return false;
+
+    if (zmq_msg_init_size(&part, sizeof(msg.msgseq)) != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    memcpy(zmq_msg_data(&part), msg.msgseq, sizeof(msg.msgseq));
+    return zmq_send_part(sock, part, 0);
+}
+
+void CZMQPublishQueue::FlushBatches()
+{
+    for (const auto& p : vBatchNotifiers) {
+        CZMQAbstractPublishNotifier* notifier = p.first;
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        if (!notifier->FlushBatch(ss)) {
+            continue;
         }
+        CZMQPublishMessage msg;
+        msg.notifier = notifier;
+        msg.command = p.second;
+        msg.data = MakeUnique<CDataStream>(std::move(ss));
+        WriteLE32(&msg.msgseq[0], notifier->nSequence++);
+        if (!Enqueue(msg)) {
+            LogDropped(msg);
+        }
+    }
+}
 
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
+void CZMQPublishQueue::ThreadMain()
+{
+    const auto interval = std::chrono::milliseconds(ZMQ_BATCH_INTERVAL_MS);
+    auto nextBatch = std::chrono::steady_clock::now() + interval;
+
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        auto pred = [this] { return fStop || !queue.empty(); };
+        if (vBatchNotifiers.empty()) {
+            cond.wait(lock, pred);
+        } else {
+            cond.wait_until(lock, nextBatch, pred);
+        }
+        if (fStop) {
+            return;
+        }
+        if (std::chrono::steady_clock::now() >= nextBatch) {
+            FlushBatches();
+            nextBatch = std::chrono::steady_clock::now() + interval;
+        }
+        if (queue.empty()) {
+            continue;
+        }
 
-        data = va_arg(args, const void*);
+        std::deque<CZMQPublishMessage> batch;
+        batch.swap(queue);
+        for (const auto& msg : batch) {
+            msg.notifier->nQueuedMessages--;
+        }
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
-        {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            va_end(args);
-            return -1;
+        std::unique_lock<std::mutex> sendLock(cs_send);
+        lock.unlock();
+        for (auto& msg : batch) {
+            Send(msg);
         }
+        sendLock.unlock();
+        lock.lock();
+    }
+}
 
-        zmq_msg_close(&msg);
+bool CZMQPublishQueue::Enqueue(CZMQPublishMessage& msg)
+{
+    CZMQAbstractPublishNotifier* notifier = msg.notifier;
+    const int hwm = notifier->GetOutboundMessageHighWaterMark();
+    // Same as for ZMQ_SNDHWM, 0 means no limit
+    if (hwm > 0 && notifier->nQueuedMessages >= (size_t)hwm) {
+        return false;
+    }
+    notifier->nQueuedMessages++;
+    queue.emplace_back(std::move(msg));
+    cond.notify_one();
+    return true;
+}
 
-        if (!data)
-            break;
+void CZMQPublishQueue::LogDropped(const CZMQPublishMessage& msg)
+{
+    CZMQAbstractPublishNotifier* notifier = msg.notifier;
+    uint64_t nDropped = ++notifier->nDroppedMessages;
+    LogPrint(BCLog::ZMQ, "zmq: Publish queue of %s is full (hwm = %d), dropped %s message (%d dropped in total)\n",
+        notifier->GetType(), notifier->GetOutboundMessageHighWaterMark(), msg.command, nDropped);
+}
+
+void CZMQPublishQueue::Push(CZMQPublishMessage&& msg)
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (Enqueue(msg)) {
+            return;
+        }
+    }
+    LogDropped(msg);
+}
+
+void CZMQPublishQueue::AddBatchNotifier(CZMQAbstractPublishNotifier* notifier, const char* command)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    vBatchNotifiers.emplace_back(notifier, command);
+    cond.notify_one();
+}
+
+void CZMQPublishQueue::Remove(CZMQAbstractPublishNotifier* notifier)
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        for (auto it = queue.begin(); it != queue.end(); ) {
+            if (it->notifier == notifier) {
+                it = queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        notifier->nQueuedMessages = 0;
+        vBatchNotifiers.erase(std::remove_if(vBatchNotifiers.begin(), vBatchNotifiers.end(),
+            [notifier](const std::pair<CZMQAbstractPublishNotifier*, const char*>& p) { return p.first == notifier; }), vBatchNotifiers.end());
+    }
+    // Messages of the notifier which were taken off the queue before are being sent while this is held
+    std::unique_lock<std::mutex> sendLock(cs_send);
+}
 
-        size = va_arg(args, size_t);
+void CZMQPublishQueue::Start()
+{
+    assert(!thread.joinable());
+    fStop = false;
+    thread = std::thread(&TraceThread<std::function<void()> >, "zmqpub", std::function<void()>(std::bind(&CZMQPublishQueue::ThreadMain, this)));
+}
+
+void CZMQPublishQueue::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (thread.joinable()) {
+        thread.join();
     }
-    va_end(args);
-    return 0;
+
+    std::unique_lock<std::mutex> lock(cs);
+    for (const auto& msg : queue) {
+        msg.notifier->nQueuedMessages--;
+    }
+    queue.clear();
+}
+
+void StartZMQPublisher()
+{
+    publishQueue.Start();
+}
+
+void StopZMQPublisher()
+{
+    publishQueue.Stop();
 }
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
@@ -89,7 +307,17 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &outbound_message_high_water_mark, sizeof(outbound_message_high_water_mark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -116,6 +344,8 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    publishQueue.Remove(this);
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -143,23 +373,31 @@ void CZMQAbstractPublishNotifier::Shutdown()
 }
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.write((const char*)data, size);
+    return SendMessage(command, std::move(ss));
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, CDataStream&& ss)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1)
-        return false;
+    CZMQPublishMessage msg;
+    msg.notifier = this;
+    msg.command = command;
+    msg.data = MakeUnique<CDataStream>(std::move(ss));
+    WriteLE32(&msg.msgseq[0], nSequence);
 
-    /* increment memory only sequence number after sending */
+    /* increment memory only sequence number, dropped messages leave a gap */
     nSequence++;
 
+    publishQueue.Push(std::move(msg));
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -169,7 +407,7 @@ bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     return SendMessage(MSG_HASHBLOCK, data, 32);
 }
 
-bool CZMQPublishHashChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+bool CZMQPublishHashChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashchainlock %s\n", hash.GetHex());
@@ -241,68 +479,61 @@ bool CZMQPublishHashRecoveredSigNotifier::NotifyRecoveredSig(const std::shared_p
     return SendMessage(MSG_HASHRECSIG, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+// Serialize the block at pindex, from memory if possible
+static bool WriteBlock(CDataStream& ss, const CBlockIndex* pindex, const std::shared_ptr<const CBlock>& pblock)
 {
-    LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
+    if (pblock)
+    {
+        ss << *pblock;
+        return true;
+    }
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
     {
         LOCK(cs_main);
-        CBlock block;
         if(!ReadBlockFromDisk(block, pindex, consensusParams))
         {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
     }
+    ss << block;
+    return true;
+}
+
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    if (!WriteBlock(ss, pindex, pblock))
+        return false;
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, std::move(ss));
 }
 
-bool CZMQPublishRawChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+bool CZMQPublishRawChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawchainlock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
-    }
+    if (!WriteBlock(ss, pindex, pblock))
+        return false;
 
-    return SendMessage(MSG_RAWCHAINLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWCHAINLOCK, std::move(ss));
 }
 
-bool CZMQPublishRawChainLockSigNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+bool CZMQPublishRawChainLockSigNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawchainlocksig %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
-        ss << *clsig;
-    }
+    if (!WriteBlock(ss, pindex, pblock))
+        return false;
+    ss << *clsig;
 
-    return SendMessage(MSG_RAWCLSIG, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWCLSIG, std::move(ss));
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -311,7 +542,7 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtx %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTX, std::move(ss));
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransactionRef& transaction, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
@@ -320,7 +551,19 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtxlock %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTXLOCK, std::move(ss));
+}
+
+// Known islocks are written from the serialization shared with P2P relay. The entry must be for the very same islock
+// object, a different islock might have replaced the notified one in the meantime
+static void WriteInstantSendLock(CDataStream& ss, const llmq::CInstantSendLock& islock)
+{
+    auto entry = llmq::quorumInstantSendManager ? llmq::quorumInstantSendManager->GetInstantSendLockEntryByTxid(islock.txid) : nullptr;
+    if (entry != nullptr && entry->islock.get() == &islock) {
+        ss << MakeSpan(entry->bytes);
+    } else {
+        ss << islock;
+    }
 }
 
 bool CZMQPublishRawTransactionLockSigNotifier::NotifyTransactionLock(const CTransactionRef& transaction, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
@@ -329,8 +572,8 @@ bool CZMQPublishRawTransactionLockSigNotifier::NotifyTransactionLock(const CTran
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtxlocksig %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *transaction;
-    ss << *islock;
-    return SendMessage(MSG_RAWTXLOCKSIG, &(*ss.begin()), ss.size());
+    WriteInstantSendLock(ss, *islock);
+    return SendMessage(MSG_RAWTXLOCKSIG, std::move(ss));
 }
 
 bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const std::shared_ptr<const CGovernanceVote>& vote)
@@ -339,7 +582,7 @@ bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const std::share
     LogPrint(BCLog::ZMQ, "zmq: Publish rawgovernanceobject: hash = %s, vote = %d\n", nHash.ToString(), vote->ToString());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *vote;
-    return SendMessage(MSG_RAWGVOTE, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWGVOTE, std::move(ss));
 }
 
 bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const std::shared_ptr<const CGovernanceObject>& govobj)
@@ -348,7 +591,7 @@ bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const std::s
     LogPrint(BCLog::ZMQ, "zmq: Publish rawgovernanceobject: hash = %s, type = %d\n", nHash.ToString(), govobj->GetObjectType());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *govobj;
-    return SendMessage(MSG_RAWGOBJ, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWGOBJ, std::move(ss));
 }
 
 bool CZMQPublishRawInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpendAttempt(const CTransactionRef& currentTx, const CTransactionRef& previousTx)
@@ -357,8 +600,8 @@ bool CZMQPublishRawInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpendA
     CDataStream ssCurrent(SER_NETWORK, PROTOCOL_VERSION), ssPrevious(SER_NETWORK, PROTOCOL_VERSION);
     ssCurrent << *currentTx;
     ssPrevious << *previousTx;
-    return SendMessage(MSG_RAWISCON, &(*ssCurrent.begin()), ssCurrent.size())
-        && SendMessage(MSG_RAWISCON, &(*ssPrevious.begin()), ssPrevious.size());
+    return SendMessage(MSG_RAWISCON, std::move(ssCurrent))
+        && SendMessage(MSG_RAWISCON, std::move(ssPrevious));
 }
 
 bool CZMQPublishRawRecoveredSigNotifier::NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig)
@@ -368,6 +611,66 @@ bool CZMQPublishRawRecoveredSigNotifier::NotifyRecoveredSig(const std::shared_pt
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *sig;
 
-    return SendMessage(MSG_RAWRECSIG, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWRECSIG, std::move(ss));
+}
+
+
+bool CZMQPublishMempoolDeltaNotifier::Initialize(void *pcontext)
+{
+    if (!CZMQAbstractPublishNotifier::Initialize(pcontext))
+        return false;
+
+    publishQueue.AddBatchNotifier(this, MSG_MEMPOOLDELTA);
+    return true;
+}
+
+bool CZMQPublishMempoolDeltaNotifier::NotifyMempoolTransactionAdded(const CTransactionRef& transaction)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    vEntries.push_back({DeltaType::ADDED, transaction, MemPoolRemovalReason::UNKNOWN, nullptr});
+    return true;
+}
+
+bool CZMQPublishMempoolDeltaNotifier::NotifyMempoolTransactionRemoved(const CTransactionRef& transaction, MemPoolRemovalReason reason)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    vEntries.push_back({DeltaType::REMOVED, transaction, reason, nullptr});
+    return true;
 }
 
+bool CZMQPublishMempoolDeltaNotifier::NotifyTransactionLock(const CTransactionRef& transaction, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    vEntries.push_back({DeltaType::ISLOCK, transaction, MemPoolRemovalReason::UNKNOWN, islock});
+    return true;
+}
+
+bool CZMQPublishMempoolDeltaNotifier::FlushBatch(CDataStream& ss)
+{
+    std::vector<Entry> entries;
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        entries.swap(vEntries);
+    }
+    if (entries.empty()) {
+        return false;
+    }
+
+    LogPrint(BCLog::ZMQ, "zmq: Publish mempooldelta with %d entries\n", entries.size());
+    WriteCompactSize(ss, entries.size());
+    for (const auto& entry : entries) {
+        ss << (uint8_t)entry.type << entry.tx->GetHash();
+        switch (entry.type) {
+        case DeltaType::ADDED:
+            ss << *entry.tx;
+            break;
+        case DeltaType::REMOVED:
+            ss << (uint8_t)entry.reason;
+            break;
+        case DeltaType::ISLOCK:
+            WriteInstantSendLock(ss, *entry.islock);
+            break;
+        }
+    }
+    return true;
+}
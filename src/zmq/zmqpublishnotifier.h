@@ -7,39 +7,64 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+#include <streams.h>
+
+#include <mutex>
+#include <vector>
+
 class CBlockIndex;
 class CGovernanceVote;
 class CGovernanceObject;
 
+//! Interval in which notifiers publish the batches they collected
+static const int64_t ZMQ_BATCH_INTERVAL_MS = 500;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
+    friend class CZMQPublishQueue;
+
 private:
-    uint32_t nSequence; //!< upcounting per message sequence number
+    uint32_t nSequence{0}; //!< upcounting per message sequence number
+    size_t nQueuedMessages{0}; //!< messages waiting in the publish queue, guarded by its mutex
 
 public:
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the publisher thread
        parts:
           * command
           * data
           * message sequence number
+       If the high water mark is exceeded the message is dropped, its sequence number is skipped
+       so subscribers can tell.
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    /* same as above, the serialized data is handed to zmq without copying it */
+    bool SendMessage(const char *command, CDataStream&& ss);
+
+    /* notifiers which collect batches serialize and clear the batch, false if there is nothing to publish.
+       Called by the publisher thread every ZMQ_BATCH_INTERVAL_MS once the notifier registered itself.
+    */
+    virtual bool FlushBatch(CDataStream& ss) { return false; }
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
 };
 
+/** Start the thread which writes queued messages to the publisher sockets */
+void StartZMQPublisher();
+/** Stop the publisher thread, messages which weren't sent yet are discarded */
+void StopZMQPublisher();
+
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
 };
 
 class CZMQPublishHashChainLockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
+    bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -81,19 +106,19 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
 };
 
 class CZMQPublishRawChainLockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
+    bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
 };
 
 class CZMQPublishRawChainLockSigNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
+    bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const llmq::CChainLockSig>& clsig) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -137,4 +162,40 @@ class CZMQPublishRawRecoveredSigNotifier : public CZMQAbstractPublishNotifier
 public:
     bool NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig> &sig) override;
 };
+
+/**
+ * Publishes the changes to the mempool and the InstantSend locks of the last ZMQ_BATCH_INTERVAL_MS as one message:
+ * the number of entries as compact size, then for every entry its type, the txid and
+ *   ADDED:   the transaction
+ *   REMOVED: the MemPoolRemovalReason, BLOCK is also reported for block transactions which were not in the mempool
+ *   ISLOCK:  the InstantSend lock
+ */
+class CZMQPublishMempoolDeltaNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    enum class DeltaType : uint8_t {
+        ADDED = 0,
+        REMOVED = 1,
+        ISLOCK = 2,
+    };
+
+private:
+    struct Entry
+    {
+        DeltaType type;
+        CTransactionRef tx;
+        MemPoolRemovalReason reason;
+        std::shared_ptr<const llmq::CInstantSendLock> islock;
+    };
+
+    std::mutex cs;
+    std::vector<Entry> vEntries;
+
+public:
+    bool Initialize(void *pcontext) override;
+    bool NotifyMempoolTransactionAdded(const CTransactionRef& transaction) override;
+    bool NotifyMempoolTransactionRemoved(const CTransactionRef& transaction, MemPoolRemovalReason reason) override;
+    bool NotifyTransactionLock(const CTransactionRef& transaction, const std::shared_ptr<const llmq::CInstantSendLock>& islock) override;
+    bool FlushBatch(CDataStream& ss) override;
+};
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
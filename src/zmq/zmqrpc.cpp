@@ -22,7 +22,9 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             "[\n"
             "  {                        (json object)\n"
             "    \"type\": \"pubhashtx\",   (string) Type of notification\n"
-            "    \"address\": \"...\"       (string) Address of the publisher\n"
+            "    \"address\": \"...\",      (string) Address of the publisher\n"
+            "    \"hwm\": n,              (numeric) Outbound message high water mark\n"
+            "    \"dropped\": n           (numeric) Number of messages dropped because the high water mark was exceeded\n"
             "  },\n"
             "  ...\n"
             "]\n"
@@ -38,6 +40,8 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             UniValue obj(UniValue::VOBJ);
             obj.pushKV("type", n->GetType());
             obj.pushKV("address", n->GetAddress());
+            obj.pushKV("hwm", n->GetOutboundMessageHighWaterMark());
+            obj.pushKV("dropped", n->GetDroppedMessages());
             result.push_back(obj);
         }
     }
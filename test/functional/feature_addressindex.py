@@ -26,7 +26,7 @@ class AddressIndexTest(BitcoinTestFramework):
         self.start_node(1, ["-addressindex"])
         # Nodes 2/3 are used for testing
         self.start_node(2, ["-addressindex", "-relaypriority=0"])
-        self.start_node(3, ["-addressindex"])
+        self.start_node(3, ["-addressindex", "-addressbalanceindex"])
         connect_nodes(self.nodes[0], 1)
         connect_nodes(self.nodes[0], 2)
         connect_nodes(self.nodes[0], 3)
@@ -145,6 +145,30 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(len(txidsmany), 4)
         assert_equal(txidsmany[3], sent_txid)
 
+        # Check that results can be paged through with a cursor
+        self.log.info("Testing pagination...")
+        paged_txids = []
+        cursor = None
+        while True:
+            query = {"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 1}
+            if cursor is not None:
+                query["cursor"] = cursor
+            page = self.nodes[1].getaddresstxids(query)
+            assert len(page["txids"]) <= 1
+            paged_txids += page["txids"]
+            cursor = page["cursor"]
+            if cursor is None:
+                break
+        assert_equal(sorted(paged_txids), sorted(txidsmany))
+
+        deltasmany = self.nodes[1].getaddressdeltas({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"]})
+        page = self.nodes[1].getaddressdeltas({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 2})
+        assert_equal(page["deltas"], deltasmany[:2])
+        page = self.nodes[1].getaddressdeltas({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "cursor": page["cursor"]})
+        assert_equal(page["deltas"], deltasmany[2:])
+        assert_equal(page["cursor"], None)
+        assert_raises_rpc_error(-8, "Invalid cursor", self.nodes[1].getaddressdeltas, {"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "cursor": "00"})
+
         # Check that balances are correct
         self.log.info("Testing balances...")
         balance0 = self.nodes[1].getaddressbalance("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
@@ -224,6 +248,7 @@ class AddressIndexTest(BitcoinTestFramework):
 
         balance4 = self.nodes[1].getaddressbalance(address2)
         assert_equal(balance4, balance1)
+        assert_equal(self.nodes[3].getaddressbalance(address2), balance4)
 
         utxos2 = self.nodes[1].getaddressutxos({"addresses": [address2]})
         assert_equal(len(utxos2), 1)
@@ -240,6 +265,10 @@ class AddressIndexTest(BitcoinTestFramework):
 
         utxos3 = self.nodes[1].getaddressutxos({"addresses": [address2]})
         assert_equal(len(utxos3), 3)
+
+        # Check that the balance index agrees with the full history
+        for address in [address2, mining_address, "93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"]:
+            assert_equal(self.nodes[3].getaddressbalance(address), self.nodes[1].getaddressbalance(address))
         assert_equal(utxos3[0]["height"], 114)
         assert_equal(utxos3[1]["height"], 264)
         assert_equal(utxos3[2]["height"], 265)
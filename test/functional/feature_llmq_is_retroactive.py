@@ -5,7 +5,7 @@
 
 from test_framework.mininode import *
 from test_framework.test_framework import DashTestFramework
-from test_framework.util import set_node_times, isolate_node, reconnect_isolated_node
+from test_framework.util import set_node_times, isolate_node, reconnect_isolated_node, wait_until
 
 '''
 feature_llmq_is_retroactive.py
@@ -117,6 +117,15 @@ class LLMQ_IS_RetroactiveSigning(DashTestFramework):
         assert(txid in self.nodes[0].getblock(block, 1)['tx'])
         self.wait_for_chainlocked_block_all_nodes(block)
 
+        self.log.info("checking that the sign queues are drained")
+        def check_sign_queues_empty():
+            for node in self.nodes:
+                queues = node.quorum("signqueues")
+                if queues["mempool"]["count"] != 0 or queues["retroactive"]["count"] != 0:
+                    return False
+            return True
+        wait_until(check_sign_queues_empty, timeout=10, sleep=0.5)
+
         self.log.info("testing retroactive signing with partially known TX and all nodes session timeout")
         self.test_all_nodes_session_timeout(False)
         self.log.info("repeating test, but with cycled LLMQs")
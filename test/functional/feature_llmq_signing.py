@@ -16,7 +16,11 @@ Checks LLMQs signing sessions
 
 class LLMQSigningTest(DashTestFramework):
     def set_test_params(self):
-        self.set_dash_test_params(6, 5, fast_dip3_enforcement=True)
+        # let some of the masternodes use the fast transport so that it's tested together with regular masternodes
+        extra_args = [[]] * 6
+        extra_args[1] = ["-llmq-fast-transport"]
+        extra_args[2] = ["-llmq-fast-transport"]
+        self.set_dash_test_params(6, 5, extra_args=extra_args, fast_dip3_enforcement=True)
         self.set_dash_llmq_test_params(5, 3)
 
     def add_options(self, parser):
@@ -105,6 +109,15 @@ class LLMQSigningTest(DashTestFramework):
 
         wait_for_sigs(True, False, True, 15)
 
+        # the members which didn't sign received sig shares from the others
+        latencies = {}
+        for m in self.mninfo:
+            latencies.update(m.node.quorum("sigsharelatency"))
+        assert len(latencies) > 0
+        for stats in latencies.values():
+            assert_equal(sum(stats["histogram"].values()), stats["count"])
+            assert_greater_than_or_equal(stats["max_ms"], stats["avg_ms"])
+
         if self.options.spork21:
             mn.node.disconnect_p2ps()
             network_thread_join()
@@ -33,17 +33,20 @@ class TimestampIndexTest(BitcoinTestFramework):
         self.sync_all()
 
     def run_test(self):
-        self.log.info("Test that settings can't be changed without -reindex...")
+        self.log.info("Test that the index can be enabled and disabled without -reindex...")
         self.stop_node(1)
-        self.nodes[1].assert_start_raises_init_error(["-timestampindex=0"], "You need to rebuild the database using -reindex to change -timestampindex", partial_match=True)
-        self.start_node(1, ["-timestampindex=0", "-reindex"])
+        self.start_node(1, ["-timestampindex=0"])
+        assert_equal(self.nodes[1].getindexinfo(), {})
+        assert_raises_rpc_error(-1, "Timestamp index not enabled", self.nodes[1].getblockhashes, 0, 0)
         connect_nodes(self.nodes[0], 1)
+        self.nodes[0].generate(2)
         self.sync_all()
         self.stop_node(1)
-        self.nodes[1].assert_start_raises_init_error(["-timestampindex"], "You need to rebuild the database using -reindex to change -timestampindex", partial_match=True)
-        self.start_node(1, ["-timestampindex", "-reindex"])
+        self.start_node(1, ["-timestampindex"])
         connect_nodes(self.nodes[0], 1)
         self.sync_all()
+        wait_until(lambda: self.nodes[1].getindexinfo()["timestampindex"]["synced"])
+        assert_equal(self.nodes[1].getindexinfo()["timestampindex"]["best_block_height"], self.nodes[1].getblockcount())
 
         self.log.info("Mining 5 blocks...")
         blockhashes = self.nodes[0].generate(5)
@@ -52,8 +55,18 @@ class TimestampIndexTest(BitcoinTestFramework):
         self.sync_all()
         self.log.info("Checking timestamp index...")
         hashes = self.nodes[1].getblockhashes(high, low)
-        assert_equal(len(hashes), 5)
-        assert_equal(sorted(blockhashes), sorted(hashes))
+        assert set(blockhashes).issubset(set(hashes))
+
+        self.log.info("Checking that the index resumes after a restart...")
+        self.stop_node(1)
+        self.start_node(1, ["-timestampindex"])
+        connect_nodes(self.nodes[0], 1)
+        blockhashes = self.nodes[0].generate(2)
+        self.sync_all()
+        wait_until(lambda: self.nodes[1].getindexinfo()["timestampindex"]["best_block_height"] == self.nodes[1].getblockcount())
+        low = self.nodes[0].getblock(blockhashes[0])["time"]
+        high = self.nodes[0].getblock(blockhashes[1])["time"]
+        assert set(blockhashes).issubset(set(self.nodes[1].getblockhashes(high, low)))
         self.log.info("Passed")
 
 
@@ -3,6 +3,9 @@
 # Distributed under the MIT software license, see the accompanying
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 """Test dash-cli"""
+import json
+import subprocess
+
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import assert_equal, assert_raises_process_error, get_auth_cookie
 
@@ -35,6 +38,22 @@ class TestBitcoinCli(BitcoinTestFramework):
         assert_equal(["foo", "bar"], self.nodes[0].cli('-rpcuser=%s' % user, '-stdin', '-stdinrpcpass', input=password + "\nfoo\nbar").echo())
         assert_raises_process_error(1, "Incorrect rpcuser or rpcpassword", self.nodes[0].cli('-rpcuser=%s' % user, '-stdin', '-stdinrpcpass', input="foo").echo)
 
+        self.log.info("Test -batch")
+        commands = ["getblockcount", "", "echo foo bar", '["echo", "foo bar", 3]', "getblockhash 1000000", "getblockhash 0"]
+        for batchsize in [1, 2, 10]:
+            process = subprocess.run([self.nodes[0].cli.binary, "-datadir=" + self.nodes[0].datadir, "-batch", "-batchsize=%d" % batchsize],
+                                     input="\n".join(commands), stdout=subprocess.PIPE, universal_newlines=True)
+            # getblockhash 1000000 fails
+            assert_equal(process.returncode, 1)
+            replies = [json.loads(line) for line in process.stdout.splitlines()]
+            assert_equal([r['id'] for r in replies], [1, 3, 4, 5, 6])
+            assert_equal(replies[0]['result'], 0)
+            assert_equal(replies[1]['result'], ["foo", "bar"])
+            assert_equal(replies[2]['result'], ["foo bar", "3"])
+            assert_equal(replies[3]['error']['code'], -8)
+            assert_equal(replies[4]['result'], self.nodes[0].getblockhash(0))
+        assert_raises_process_error(1, "-batch takes no arguments", self.nodes[0].cli('-batch').getblockcount)
+
         self.log.info("Test connecting to a non-existing server")
         assert_raises_process_error(1, "Could not connect to the server", self.nodes[0].cli('-rpcport=1').echo)
 
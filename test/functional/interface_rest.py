@@ -350,5 +350,24 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(json_string)
         assert_equal(json_obj['bestblockhash'], bb_hash)
 
+        #test the masternode list, it is the diff to the genesis block
+        genesis_hash = self.nodes[0].getblockhash(0)
+        mnlist_hex = http_get_call(url.hostname, url.port, '/rest/mnlist'+self.FORMAT_SEPARATOR+'hex')
+        assert_equal(mnlist_hex, http_get_call(url.hostname, url.port, '/rest/mnlist/'+bb_hash+self.FORMAT_SEPARATOR+'hex'))
+        assert_equal(mnlist_hex, http_get_call(url.hostname, url.port, '/rest/mnlistdiff/'+genesis_hash+'/'+bb_hash+self.FORMAT_SEPARATOR+'hex'))
+        response = http_get_call(url.hostname, url.port, '/rest/mnlist'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(encode(response.read(), "hex_codec").decode('ascii')+"\n", mnlist_hex)
+
+        #Dash specific objects are only available in binary formats
+        response = http_get_call(url.hostname, url.port, '/rest/mnlist'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+        response = http_get_call(url.hostname, url.port, '/rest/mnlistdiff/'+bb_hash+'/'+genesis_hash+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 404)
+        response = http_get_call(url.hostname, url.port, '/rest/islock/'+txs[0]+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 404)
+        response = http_get_call(url.hostname, url.port, '/rest/clsig'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 404)
+
 if __name__ == '__main__':
     RESTTest ().main ()
@@ -93,7 +93,12 @@ class BlockchainTest(BitcoinTestFramework):
         res = self.nodes[0].getblockchaininfo()
 
         # result should have these additional pruning keys if manual pruning is enabled
-        assert_equal(sorted(res.keys()), sorted(['pruneheight', 'automatic_pruning'] + keys))
+        assert_equal(sorted(res.keys()), sorted(['pruneheight', 'automatic_pruning', 'prune_progress'] + keys))
+
+        # nothing was pruned yet, so there is nothing to delete in the background
+        assert_equal(res['prune_progress']['files_pending'], 0)
+        assert_equal(res['prune_progress']['files_deleted'], 0)
+        assert not res['prune_progress']['compacting']
 
         # size_on_disk should be > 0
         assert_greater_than(res['size_on_disk'], 0)
@@ -113,7 +118,7 @@ class BlockchainTest(BitcoinTestFramework):
         self.restart_node(0, ['-stopatheight=207', '-prune=550', '-txindex=0'])
         res = self.nodes[0].getblockchaininfo()
         # result should have these additional pruning keys if prune=550
-        assert_equal(sorted(res.keys()), sorted(['pruneheight', 'automatic_pruning', 'prune_target_size'] + keys))
+        assert_equal(sorted(res.keys()), sorted(['pruneheight', 'automatic_pruning', 'prune_target_size', 'prune_progress'] + keys))
 
         # check related fields
         assert res['pruned']
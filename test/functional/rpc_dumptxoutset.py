@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Dash Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the generation of UTXO snapshots using `dumptxoutset` and loading them with -loadsnapshot.
+"""
+
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error, connect_nodes, wait_until
+
+
+class DumptxoutsetTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        # The second node loads the snapshot and must not sync the chain before
+        self.setup_nodes()
+
+    def run_test(self):
+        """Test a trivial usage of the dumptxoutset RPC command."""
+        node = self.nodes[0]
+        node.generate(100)
+
+        FILENAME = 'txoutset.dat'
+        out = node.dumptxoutset(FILENAME)
+        expected_path = os.path.join(node.datadir, 'regtest', FILENAME)
+
+        assert_equal(out['coins_written'], node.gettxoutsetinfo()['txouts'])
+        assert_equal(out['base_height'], 100)
+        assert_equal(out['path'], expected_path)
+        assert_equal(out['base_hash'], node.getbestblockhash())
+        assert_equal(out['chainlocked'], False)
+        assert_equal(out['hash_serialized_2'], node.gettxoutsetinfo()['hash_serialized_2'])
+        assert os.path.exists(expected_path)
+        assert not os.path.exists(expected_path + '.incomplete')
+
+        # Specifying a path to an existing file will fail.
+        assert_raises_rpc_error(
+            -8, '{} already exists'.format(FILENAME), node.dumptxoutset, FILENAME)
+
+        self.log.info("Load the snapshot into a new data directory")
+        self.restart_node(1, extra_args=['-loadsnapshot={}'.format(expected_path)])
+        snapshot_node = self.nodes[1]
+        assert_equal(snapshot_node.getbestblockhash(), out['base_hash'])
+        assert_equal(snapshot_node.gettxoutsetinfo()['hash_serialized_2'], out['hash_serialized_2'])
+        snapshot_validation = snapshot_node.getblockchaininfo()['snapshot_validation']
+        assert_equal(snapshot_validation['base_hash'], out['base_hash'])
+        assert_equal(snapshot_validation['base_height'], 100)
+
+        self.log.info("Validate the blocks below the snapshot base in the background")
+        connect_nodes(snapshot_node, 0)
+        wait_until(lambda: 'snapshot_validation' not in snapshot_node.getblockchaininfo(), timeout=60)
+        assert not os.path.exists(os.path.join(snapshot_node.datadir, 'regtest', 'chainstate_background'))
+        assert_equal(snapshot_node.getblock(snapshot_node.getblockhash(1))['hash'], node.getblockhash(1))
+
+        node.generate(10)
+        self.sync_blocks()
+
+        self.log.info("A node with a chain ignores -loadsnapshot")
+        self.restart_node(1, extra_args=['-loadsnapshot={}'.format(expected_path)])
+        assert_equal(self.nodes[1].getblockcount(), 110)
+        assert 'snapshot_validation' not in self.nodes[1].getblockchaininfo()
+
+
+if __name__ == '__main__':
+    DumptxoutsetTest().main()
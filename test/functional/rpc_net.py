@@ -10,6 +10,7 @@ Tests correspond to code in rpc/net.cpp.
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import (
     assert_equal,
+    assert_greater_than,
     assert_greater_than_or_equal,
     assert_raises_rpc_error,
     connect_nodes_bi,
@@ -56,6 +57,10 @@ class NetTest(BitcoinTestFramework):
         assert_greater_than_or_equal(peers_sent, net_totals_before['totalbytessent'])
         assert_greater_than_or_equal(net_totals_after['totalbytessent'], peers_sent)
 
+        # a send syscall may send multiple messages
+        assert_greater_than(net_totals_after['totalsendcalls'], 0)
+        assert_greater_than(net_totals_after['avgbytespersendcall'], 0)
+
         # test getnettotals and getpeerinfo by doing a ping
         # the bytes sent/received should change
         # note ping and pong are 32 bytes each
@@ -72,6 +77,11 @@ class NetTest(BitcoinTestFramework):
         assert_equal(self.nodes[0].getnetworkinfo()['networkactive'], True)
         assert_equal(self.nodes[0].getnetworkinfo()['connections'], 2)
 
+        cmpct_stats = self.nodes[0].getnetworkinfo()['compactblocks']
+        assert_equal(sorted(cmpct_stats.keys()), ['blocks', 'blocks_fallback', 'blocks_without_roundtrip', 'tx_extra',
+                                                  'tx_islock', 'tx_mempool', 'tx_prefilled', 'tx_requested'])
+        assert_greater_than_or_equal(cmpct_stats['blocks'], cmpct_stats['blocks_without_roundtrip'])
+
         self.nodes[0].setnetworkactive(False)
         assert_equal(self.nodes[0].getnetworkinfo()['networkactive'], False)
         # Wait a bit for all sockets to close
@@ -101,6 +111,14 @@ class NetTest(BitcoinTestFramework):
         # the address bound to on one side will be the source address for the other node
         assert_equal(peer_info[0][0]['addrbind'], peer_info[1][0]['addr'])
         assert_equal(peer_info[1][0]['addrbind'], peer_info[0][0]['addr'])
+        # every sent byte is accounted to exactly one send priority
+        for peer in peer_info[0]:
+            assert_equal(sorted(peer['bytessent_per_priority'].keys()), ['blocks', 'bulk', 'critical', 'normal'])
+            assert_equal(sum(peer['bytessent_per_priority'].values()), sum(peer['bytessent_per_msg'].values()))
+            assert_equal(sorted(peer['bytesqueued_per_priority'].keys()), ['blocks', 'bulk', 'critical', 'normal'])
+            # the number of blocks in transit only ever grows beyond the default
+            assert_greater_than_or_equal(peer['inflight_limit'], 16)
+            assert_greater_than_or_equal(peer['block_delivery_time'], 0)
 
 if __name__ == '__main__':
     NetTest().main()
@@ -56,10 +56,13 @@ MESSAGEMAP = {
     # Dash Specific
     b"clsig": msg_clsig,
     b"getmnlistd": msg_getmnlistd,
+    b"getmnlistsnap": None,
     b"getsporks": None,
+    b"govsketch": None,
     b"govsync": None,
     b"islock": msg_islock,
     b"mnlistdiff": msg_mnlistdiff,
+    b"mnlistsnap": None,
     b"notfound": None,
     b"qfcommit": None,
     b"qsendrecsigs": None,
@@ -67,6 +70,7 @@ MESSAGEMAP = {
     b"qdata": msg_qdata,
     b"qwatch" : None,
     b"senddsq": None,
+    b"sendshortinv": None,
     b"spork": None,
 }
 
@@ -105,6 +105,7 @@ BASE_SCRIPTS= [
     'wallet_txn_doublespend.py --mineblock',
     'wallet_txn_clone.py',
     'rpc_getchaintips.py',
+    'rpc_getblockfilter.py',
     'interface_rest.py',
     'mempool_spend_coinbase.py',
     'mempool_reorg.py',
@@ -120,6 +121,7 @@ BASE_SCRIPTS= [
     'feature_spentindex.py',
     'rpc_decodescript.py',
     'rpc_blockchain.py',
+    'rpc_dumptxoutset.py',
     'rpc_deprecated.py',
     'wallet_disable.py',
     'rpc_net.py',
@@ -103,6 +103,9 @@ EXPECTED_CIRCULAR_DEPENDENCIES=(
     "governance/governance-classes -> init -> masternode/masternode-payments -> governance/governance-classes"
     "httprpc -> httpserver -> init -> httprpc"
     "httpserver -> init -> httpserver"
+    "index/base -> init -> index/timestampindex -> index/base"
+    "index/base -> init -> index/blockfilterindex -> index/base"
+    "blockfilter -> evo/specialtx -> llmq/quorums_blockprocessor -> net_processing -> index/blockfilterindex -> blockfilter"
     "init -> llmq/quorums_init -> llmq/quorums_signing_shares -> init"
     "llmq/quorums_chainlocks -> net_processing -> validationinterface -> llmq/quorums_chainlocks"
     "llmq/quorums_dkgsession -> llmq/quorums_dkgsessionmgr -> llmq/quorums_dkgsessionhandler -> llmq/quorums_dkgsession"
@@ -172,7 +172,7 @@ def parse_output(a, fmt):
     if fmt == 'json':  # json: compare parsed data
         return json.loads(a)
     elif fmt == 'hex':  # hex: parse and compare binary data
-        return binascii.a2b_hex(a.strip())
+        return binascii.a2b_hex(''.join(a.split()))  # -bulk writes one hex transaction per line
     else:
         raise NotImplementedError("Don't know how to compare %s" % fmt)
 